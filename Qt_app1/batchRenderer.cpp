@@ -0,0 +1,89 @@
+#include "batchRenderer.h"
+#include <QFileInfo>
+#include <QDir>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+
+std::vector<BatchRenderer::View> BatchRenderer::orbit(int n, double beta, double distance)
+{
+    std::vector<View> views;
+    for (int i = 0; i < n; i++)
+    {
+        View v = { 360.0 * i / n, beta, distance };
+        views.push_back(v);
+    }
+    return views;
+}
+
+bool BatchRenderer::read_views(const std::string & fname)
+{
+    std::ifstream in(fname);
+    if (!in) return false;
+    views.clear();
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        View v;
+        if (fields >> v.alpha >> v.beta >> v.distance) views.push_back(v);
+    }
+    return true;
+}
+
+bool BatchRenderer::read_jobs(const std::string & fname, std::vector<Job> & jobs)
+{
+    std::ifstream in(fname);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        Job job;
+        if (fields >> job.mesh)
+        {
+            fields >> job.texture;
+            jobs.push_back(job);
+        }
+    }
+    return true;
+}
+
+int BatchRenderer::run(MeshRenderer & renderer, const std::vector<Job> & jobs)
+{
+    renderer.startOffscreen(width, height);
+    QDir().mkpath(QString::fromStdString(output_dir));
+
+    int failed = 0;
+    for (const Job & job : jobs)
+    {
+        if (!renderer.uploadMesh(job.mesh))
+        {
+            failed++;
+            continue;
+        }
+        if (!renderer.deviceReady())
+        {
+            std::cout << "Cannot create an OpenGL context" << std::endl;
+            return (int)jobs.size();
+        }
+        bool ok = renderer.uploadTexture(job.texture);
+
+        const QString name = QFileInfo(QString::fromStdString(job.mesh)).completeBaseName();
+        for (size_t i = 0; i < views.size(); i++)
+        {
+            const View & v = views[i];
+            char suffix[16];
+            snprintf(suffix, sizeof(suffix), "_%03d.png", (int)i);
+            const QString file = QDir(QString::fromStdString(output_dir)).filePath(name + suffix);
+            if (!renderer.drawView(v).save(file))
+            {
+                std::cout << "Cannot write " << file.toStdString() << std::endl;
+                ok = false;
+            }
+        }
+        if (!ok) failed++;
+    }
+    return failed;
+}
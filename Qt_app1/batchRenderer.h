@@ -0,0 +1,39 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <vector>
+#include <string>
+#include "meshRenderer.h"
+
+/*! renders views of a list of meshes to PNG files without showing a window.
+    one MeshRenderer, GlWidget, its context and its programs serve the whole list. without a
+    display run it on a headless platform, -platform offscreen, or minimalegl
+    and eglfs for EGL. */
+class BatchRenderer
+{
+public:
+    /*! a camera of the orbit, as the mouse sets it in GlWidget */
+    using View = MeshRenderer::Camera;
+    /*! a mesh and its texture, which may be empty */
+    struct Job { std::string mesh; std::string texture; };
+
+    /*! size of the images in pixels */
+    int width = 512;
+    int height = 512;
+    /*! the images are written to output_dir/name_000.png, name_001.png, ... */
+    std::string output_dir = ".";
+    /*! the views of every mesh */
+    std::vector<View> views = orbit(8);
+
+    /*! n views evenly around the vertical axis */
+    static std::vector<View> orbit(int n, double beta = 0, double distance = 2.5);
+    /*! read views, an "alpha beta distance" line each, false if the file cannot be read */
+    bool read_views(const std::string & fname);
+    /*! read jobs, a mesh and optionally its texture per line, false if the file cannot be read */
+    static bool read_jobs(const std::string & fname, std::vector<Job> & jobs);
+
+    /*! render all views of all jobs with renderer, returns the number of jobs that failed */
+    int run(MeshRenderer & renderer, const std::vector<Job> & jobs);
+};
+
+#endif // BATCHRENDERER_H
@@ -0,0 +1,128 @@
+#include "cameraPath.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+
+bool CameraPath::read(const std::string & fname)
+{
+    std::ifstream in(fname);
+    if (!in) return false;
+    keys.clear();
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        Key k;
+        if (fields >> k.alpha >> k.beta >> k.distance) keys.push_back(k);
+    }
+    return !keys.empty();
+}
+
+CameraPath::Key CameraPath::at(int frame) const
+{
+    if (keys.size() == 1 || frames <= 1) return keys[0];
+    const double t = (double)frame / (frames - 1) * (keys.size() - 1);
+    const size_t i = std::min((size_t)t, keys.size() - 2);
+    const double s = t - i;
+    const Key & a = keys[i];
+    const Key & b = keys[i + 1];
+    Key k = { a.alpha + s * (b.alpha - a.alpha), a.beta + s * (b.beta - a.beta), a.distance + s * (b.distance - a.distance) };
+    return k;
+}
+
+// the p-th percentile of sorted values, nearest rank
+static double percentile(const std::vector<double> & sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    const size_t rank = (size_t)std::ceil(p / 100 * sorted.size());
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+static void report(const char * name, std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    printf("%-6s %8.3f %8.3f %8.3f %8.3f %8.3f\n", name, percentile(values, 50), percentile(values, 90),
+        percentile(values, 95), percentile(values, 99), values.empty() ? 0 : values.back());
+}
+
+int CameraPath::run(MeshRenderer & renderer, const std::string & mesh, const std::string & texture, const std::string & csv)
+{
+    if (keys.empty()) return 1;
+    renderer.startOffscreen(width, height);
+    if (!renderer.uploadMesh(mesh)) return 1;
+    if (!renderer.deviceReady())
+    {
+        std::cout << "Cannot create an OpenGL context" << std::endl;
+        return 1;
+    }
+    if (!renderer.uploadTexture(texture))
+        std::cout << "Cannot read the texture " << texture << std::endl;
+
+    const Key first = at(0);
+    for (int i = 0; i < warmup; i++) renderer.drawView(first);
+
+    std::vector<double> wall;
+    wall.reserve(frames);
+    renderer.startTiming();
+    QElapsedTimer clock;
+    for (int i = 0; i < frames; i++)
+    {
+        const Key k = at(i);
+        clock.start();
+        renderer.drawView(k);
+        wall.push_back(clock.nsecsElapsed() * 1e-6);
+    }
+    std::vector<MeshRenderer::FrameTime> samples;
+    const bool gpuTimed = renderer.stopTiming(samples);
+
+    std::vector<double> cpu, gpu;
+    for (const MeshRenderer::FrameTime & s : samples)
+    {
+        cpu.push_back(s.cpu);
+        gpu.push_back(s.gpu);
+    }
+    printf("%d frames at %dx%d, milliseconds\n", frames, width, height);
+    printf("%-6s %8s %8s %8s %8s %8s\n", "", "p50", "p90", "p95", "p99", "max");
+    report("frame", wall);
+    report("cpu", cpu);
+    if (gpuTimed) report("gpu", gpu);
+    else printf("gpu    no timer queries\n");
+
+    if (!csv.empty())
+    {
+        FILE * fp = fopen(csv.c_str(), "w");
+        if (!fp)
+        {
+            std::cout << "Cannot write " << csv << std::endl;
+            return 1;
+        }
+        fprintf(fp, "frame,alpha,beta,distance,frame_ms,cpu_ms,gpu_ms\n");
+        // the samples are in frame order, a frame the profiler did not finish has none
+        for (int i = 0; i < frames; i++)
+        {
+            const Key k = at(i);
+            const bool timed = i < (int)samples.size();
+            fprintf(fp, "%d,%.4f,%.4f,%.4f,%.4f,", i, k.alpha, k.beta, k.distance, wall[i]);
+            if (timed) fprintf(fp, "%.4f,%.4f\n", samples[i].cpu, samples[i].gpu);
+            else fprintf(fp, ",\n");
+        }
+        fclose(fp);
+    }
+
+    if (budget > 0)
+    {
+        std::vector<double> gated = gpuTimed ? gpu : cpu;
+        std::sort(gated.begin(), gated.end());
+        const double p95 = percentile(gated, 95);
+        if (p95 > budget)
+        {
+            printf("p95 %s time %.3f ms is over the budget of %.3f ms\n", gpuTimed ? "GPU" : "CPU", p95, budget);
+            return 2;
+        }
+    }
+    return 0;
+}
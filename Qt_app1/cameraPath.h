@@ -0,0 +1,41 @@
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <vector>
+#include <string>
+#include "meshRenderer.h"
+
+/*! plays a scripted camera path through a MeshRenderer, GlWidget, and reports the frame times, a repeatable
+    workload for the frame time work. the keyframes are "alpha beta distance" lines, as the
+    views of BatchRenderer, spread evenly over the frames and interpolated linearly. every
+    frame is drawn into the framebuffer of the widget and read back like renderView, so the
+    path plays without a window, on a headless platform with -platform offscreen, and the
+    frame times include the readback; the GPU times of FrameProfiler do not. */
+class CameraPath
+{
+public:
+    using Key = MeshRenderer::Camera;
+
+    std::vector<Key> keys;
+    /*! frames timed, after the warm up frames at the first key */
+    int frames = 600;
+    int warmup = 10;
+    /*! size of the framebuffer in pixels */
+    int width = 1280;
+    int height = 720;
+    /*! run() fails if the 95th percentile of the GPU time, of the CPU time without timer
+        queries, is above this many milliseconds, 0 for no budget */
+    double budget = 0;
+
+    /*! read the keyframes, false if the file cannot be read or has none */
+    bool read(const std::string & fname);
+    /*! the camera at frame i of frames */
+    Key at(int frame) const;
+
+    /*! play the path over mesh and texture, empty for the maps of its materials or none, print the
+        percentiles and write a line per frame to csv unless it is empty. returns 0, 1 if it cannot
+        run, 2 if the budget is exceeded */
+    int run(MeshRenderer & renderer, const std::string & mesh, const std::string & texture, const std::string & csv);
+};
+
+#endif // CAMERAPATH_H
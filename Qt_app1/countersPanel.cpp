@@ -0,0 +1,84 @@
+#include "countersPanel.h"
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include "parser/counters.h"
+
+// bytes are shown in megabytes
+static QString format(const std::string & name, double value)
+{
+    const bool bytes = name.size() > 6 && name.compare(name.size() - 6, 6, "_bytes") == 0;
+    if (bytes) return QString("%1 MB").arg(value / (1 << 20), 0, 'f', 2);
+    return QString::number(value, 'f', value == (int64_t)value ? 0 : 2);
+}
+
+CountersPanel::CountersPanel(QWidget *parent, int interval) : QWidget(parent)
+{
+    table = new QTableWidget(0, 3, this);
+    table->setHorizontalHeaderLabels(QStringList() << "counter" << "value" << "per second");
+    table->verticalHeader()->hide();
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    QVBoxLayout * layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(table);
+
+    connect(&timer, &QTimer::timeout, this, &CountersPanel::refresh);
+    clock.start();
+    timer.start(interval);
+    refresh();
+}
+
+void CountersPanel::setRow(int row, const QString & name, const QString & value, const QString & rate)
+{
+    if (row >= table->rowCount()) table->setRowCount(row + 1);
+    const QString texts[3] = { name, value, rate };
+    for (int c = 0; c < 3; c++)
+    {
+        QTableWidgetItem * item = table->item(row, c);
+        if (!item) table->setItem(row, c, item = new QTableWidgetItem());
+        item->setText(texts[c]);
+        if (c > 0) item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    }
+}
+
+void CountersPanel::refresh()
+{
+    const std::vector<MeshLib::CCounters::CValue> values = MeshLib::CCounters::snapshot();
+    const qint64 now = clock.elapsed();
+    const double seconds = (now - lastTime) * 1e-3;
+
+    int row = 0;
+    std::map<std::string, int64_t> counts;
+    for (const MeshLib::CCounters::CValue & v : values)
+    {
+        QString rate;
+        if (v.kind == MeshLib::CCounter::COUNT)
+        {
+            counts[v.name] = v.value;
+            auto before = last.find(v.name);
+            if (before != last.end() && seconds > 0) rate = format(v.name, (v.value - before->second) / seconds);
+        }
+        setRow(row++, QString::fromStdString(v.name), format(v.name, (double)v.value), rate);
+    }
+
+    // the derived rows, over all loads and over the last interval
+    if (counts["loader.milliseconds"] > 0)
+        setRow(row++, "loader throughput", QString("%1 MB/s").arg(counts["loader.bytes"] / (double)(1 << 20) / (counts["loader.milliseconds"] * 1e-3), 0, 'f', 1), "");
+    const int64_t seen = counts["texture.tiles_seen"] - last["texture.tiles_seen"];
+    if (seen > 0)
+    {
+        const int64_t missed = counts["texture.tiles_missed"] - last["texture.tiles_missed"];
+        setRow(row++, "tile cache hit rate", QString("%1 %").arg(100.0 * (seen - missed) / seen, 0, 'f', 1), "");
+    }
+    const int64_t drawn = counts["mesh.tiles_drawn"] - last["mesh.tiles_drawn"];
+    if (drawn > 0)
+    {
+        const int64_t missed = counts["mesh.tiles_missed"] - last["mesh.tiles_missed"];
+        setRow(row++, "mesh tile misses", QString("%1 %").arg(100.0 * missed / drawn, 0, 'f', 1), "");
+    }
+    table->setRowCount(row);
+
+    last = counts;
+    lastTime = now;
+}
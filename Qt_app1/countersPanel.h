@@ -0,0 +1,37 @@
+#ifndef COUNTERSPANEL_H
+#define COUNTERSPANEL_H
+
+#include <QWidget>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <map>
+#include <string>
+#include <cstdint>
+
+class QTableWidget;
+
+/*! the counters of MeshLib::CCounters, read every interval milliseconds. a count shows its
+    total and its rate per second since the last read, a gauge its level, and the rows of
+    the loader throughput and the hit rate of the tile cache are worked out of the counts */
+class CountersPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit CountersPanel(QWidget *parent = 0, int interval = 500);
+
+private slots:
+    void refresh();
+
+private:
+    void setRow(int row, const QString & name, const QString & value, const QString & rate);
+
+    QTableWidget * table;
+    QTimer timer;
+    QElapsedTimer clock;
+    //! the counts at the last read, and when it was
+    std::map<std::string, int64_t> last;
+    qint64 lastTime = 0;
+};
+
+#endif // COUNTERSPANEL_H
@@ -0,0 +1,202 @@
+#include "frameProfiler.h"
+
+// weight of the newest frame in the averages of the overlay
+static const double smoothing = 0.1;
+
+const char * FrameProfiler::name(int phase)
+{
+    static const char * names[Phases] = { "upload", "setup", "bind", "draw", "feedback", "pick" };
+    return names[phase];
+}
+
+FrameProfiler::FrameProfiler()
+{
+    for (Frame & f : ring)
+    {
+        for (int p = 0; p < Phases; p++)
+        {
+            f.cpu[p] = 0;
+            f.timed[p] = false;
+            f.gpu[p] = NULL;
+        }
+    }
+    for (int p = 0; p < Phases; p++) cpuAverage[p] = gpuAverage[p] = 0;
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    if (log) fclose(log);
+}
+
+void FrameProfiler::initializeGL()
+{
+    // every query of a frame is reused four frames later
+    gpuTimers = true;
+    for (Frame & f : ring)
+    {
+        for (int p = 0; p < Phases && gpuTimers; p++)
+        {
+            f.gpu[p] = new QOpenGLTimerQuery();
+            gpuTimers = f.gpu[p]->create();
+        }
+    }
+    if (!gpuTimers) releaseGL();
+    active = true;
+    clock.start();
+}
+
+void FrameProfiler::releaseGL()
+{
+    for (Frame & f : ring)
+    {
+        for (int p = 0; p < Phases; p++)
+        {
+            delete f.gpu[p];
+            f.gpu[p] = NULL;
+        }
+        f.pending = false;
+    }
+    gpuTimers = false;
+}
+
+bool FrameProfiler::openLog(const std::string & fname)
+{
+    if (log) fclose(log);
+    log = fopen(fname.c_str(), "w");
+    if (!log) return false;
+    fprintf(log, "frame");
+    for (int p = 0; p < Phases; p++) fprintf(log, ",cpu_%s_ms,gpu_%s_ms", name(p), name(p));
+    fprintf(log, "\n");
+    return true;
+}
+
+void FrameProfiler::beginFrame(Phase first)
+{
+    if (!active) return;
+    // the frames whose results are in, oldest first so that the log stays in order,
+    // the one whose queries are reused now waits for them
+    for (int k = 1; k <= frames; k++)
+    {
+        Frame & f = ring[(current + k + frames) % frames];
+        if (f.pending && !finish(f, k == 1)) break;
+    }
+    current = (current + 1) % frames;
+    Frame & f = ring[current];
+    f.number = frameNumber++;
+    for (int p = 0; p < Phases; p++)
+    {
+        f.cpu[p] = 0;
+        f.timed[p] = false;
+    }
+    f.pending = true;
+    phase = -1;
+    begin(first);
+}
+
+void FrameProfiler::begin(Phase next)
+{
+    if (!active || current < 0) return;
+    endPhase();
+    Frame & f = ring[current];
+    phase = next;
+    // a query times one interval, a phase entered again is only timed on the CPU
+    if (gpuTimers && !f.timed[phase])
+    {
+        f.gpu[phase]->begin();
+        querying = true;
+    }
+    f.timed[phase] = true;
+}
+
+void FrameProfiler::endFrame()
+{
+    if (!active || current < 0) return;
+    endPhase();
+}
+
+void FrameProfiler::endPhase()
+{
+    const qint64 now = clock.nsecsElapsed();
+    if (phase >= 0)
+    {
+        Frame & f = ring[current];
+        f.cpu[phase] += (now - phaseStart) * 1e-6;
+        if (querying) f.gpu[phase]->end();
+    }
+    phase = -1;
+    phaseStart = now;
+    querying = false;
+}
+
+bool FrameProfiler::finish(Frame & f, bool wait)
+{
+    // the queries of a frame finish in order, the last one decides
+    int last = -1;
+    for (int p = 0; p < Phases; p++) if (gpuTimers && f.timed[p]) last = p;
+    if (!wait && last >= 0 && !f.gpu[last]->isResultAvailable()) return false;
+
+    double gpu[Phases];
+    for (int p = 0; p < Phases; p++)
+    {
+        gpu[p] = gpuTimers && f.timed[p] ? f.gpu[p]->waitForResult() * 1e-6 : 0;
+        cpuAverage[p] += smoothing * (f.cpu[p] - cpuAverage[p]);
+        gpuAverage[p] += smoothing * (gpu[p] - gpuAverage[p]);
+    }
+    f.pending = false;
+
+    if (recording && f.number >= recordFrom)
+    {
+        Sample sample = { f.number, 0, 0 };
+        for (int p = 0; p < Phases; p++)
+        {
+            sample.cpu += f.cpu[p];
+            sample.gpu += gpu[p];
+        }
+        recorded.push_back(sample);
+    }
+
+    if (!log) return true;
+    fprintf(log, "%lld", (long long)f.number);
+    for (int p = 0; p < Phases; p++)
+    {
+        if (gpuTimers) fprintf(log, ",%.4f,%.4f", f.cpu[p], gpu[p]);
+        else fprintf(log, ",%.4f,", f.cpu[p]);
+    }
+    fprintf(log, "\n");
+    return true;
+}
+
+void FrameProfiler::startRecording()
+{
+    recorded.clear();
+    recording = true;
+    recordFrom = frameNumber;
+}
+
+void FrameProfiler::stopRecording()
+{
+    // oldest first, as beginFrame finishes them
+    for (int k = 1; k <= frames; k++)
+    {
+        Frame & f = ring[(current + k + frames) % frames];
+        if (current >= 0 && f.pending) finish(f, true);
+    }
+    recording = false;
+}
+
+QString FrameProfiler::summary() const
+{
+    QString text = gpuTimers ? "ms       cpu    gpu\n" : "ms       cpu\n";
+    double cpu = 0, gpu = 0;
+    for (int p = 0; p < Phases; p++)
+    {
+        text += QString("%1 %2").arg(QString::fromLatin1(name(p)), -8).arg(cpuAverage[p], 6, 'f', 2);
+        if (gpuTimers) text += QString(" %1").arg(gpuAverage[p], 6, 'f', 2);
+        text += "\n";
+        cpu += cpuAverage[p];
+        gpu += gpuAverage[p];
+    }
+    text += QString("%1 %2").arg(QString::fromLatin1("frame"), -8).arg(cpu, 6, 'f', 2);
+    if (gpuTimers) text += QString(" %1").arg(gpu, 6, 'f', 2);
+    return text;
+}
@@ -0,0 +1,94 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QElapsedTimer>
+#include <QOpenGLTimerQuery>
+#include <QString>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*! CPU and GPU time of the phases of a frame. the GPU times are GL_TIME_ELAPSED
+    queries, read back a few frames later so that nothing waits for them; they
+    need OpenGL 3.3 or ARB_timer_query, without it only the CPU is timed.
+    the calls do nothing until initializeGL. */
+class FrameProfiler
+{
+public:
+    enum Phase
+    {
+        Upload,     //!< texture and tile uploads
+        Setup,      //!< matrices, uniforms and culling
+        Bind,       //!< vertex array object or attributes
+        Draw,       //!< the draw calls
+        Feedback,   //!< the feedback pass of a virtual texture
+        Pick,       //!< the ID pass and its readback
+        Phases
+    };
+    static const char * name(int phase);
+
+    FrameProfiler();
+    ~FrameProfiler();
+
+    /*! create the queries with the context current */
+    void initializeGL();
+    void releaseGL();
+    bool enabled() const { return active; }
+    /*! write a line per frame to a CSV file once its GPU times are known, false if it cannot be written */
+    bool openLog(const std::string & fname);
+
+    /*! start a frame with its first phase */
+    void beginFrame(Phase phase);
+    /*! end the phase running and start the next */
+    void begin(Phase phase);
+    void endFrame();
+
+    /*! milliseconds of every phase, averaged over the last frames, for the overlay */
+    QString summary() const;
+
+    /*! the CPU and GPU milliseconds of all phases of a frame */
+    struct Sample { qint64 frame; double cpu; double gpu; };
+    /*! keep a sample of every frame from the next one on, see samples */
+    void startRecording();
+    /*! wait for the frames whose queries are running, with the context current, and keep no more */
+    void stopRecording();
+    const std::vector<Sample> & samples() const { return recorded; }
+    /*! whether the GPU is timed, otherwise the GPU times are 0 */
+    bool gpuTimed() const { return gpuTimers; }
+
+private:
+    //! the frames whose queries may still be running
+    static const int frames = 4;
+    struct Frame
+    {
+        qint64 number = 0;
+        double cpu[Phases];
+        bool timed[Phases];
+        QOpenGLTimerQuery * gpu[Phases];
+        bool pending = false;
+    };
+    void endPhase();
+    /*! average and log a frame, false if its GPU times are not in yet and wait is false */
+    bool finish(Frame & frame, bool wait);
+
+    bool active = false;
+    bool gpuTimers = false;
+    Frame ring[frames];
+    int current = -1;
+    int phase = -1;
+    //! whether the phase running has a query running
+    bool querying = false;
+    qint64 frameNumber = 0;
+    QElapsedTimer clock;
+    qint64 phaseStart = 0;
+    //! moving averages in milliseconds
+    double cpuAverage[Phases];
+    double gpuAverage[Phases];
+    FILE * log = NULL;
+    bool recording = false;
+    //! frames before this one are not recorded
+    qint64 recordFrom = 0;
+    std::vector<Sample> recorded;
+};
+
+#endif // FRAMEPROFILER_H
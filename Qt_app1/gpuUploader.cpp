@@ -0,0 +1,169 @@
+#include "gpuUploader.h"
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <cstring>
+#include <algorithm>
+#include "parser/counters.h"
+#include "parser/trace.h"
+
+GpuUploader::GpuUploader(QObject * parent)
+    : QThread(parent)
+{
+    qRegisterMetaType<UploadedResources>("UploadedResources");
+}
+
+GpuUploader::~GpuUploader()
+{
+    stop();
+}
+
+bool GpuUploader::initialize(QOpenGLContext * share)
+{
+    // the surface belongs to the GUI thread, the context moves to the uploader once it shares
+    surface = new QOffscreenSurface();
+    surface->setFormat(share->format());
+    surface->create();
+    context = new QOpenGLContext();
+    context->setFormat(share->format());
+    context->setShareContext(share);
+    if (!surface->isValid() || !context->create() || !QOpenGLContext::areSharing(context, share))
+    {
+        delete context;
+        delete surface;
+        context = NULL;
+        surface = NULL;
+        return false;
+    }
+    context->moveToThread(this);
+    start();
+    return true;
+}
+
+void GpuUploader::stop()
+{
+    {
+        QMutexLocker lock(&mutex);
+        stopping = true;
+        requests.clear();
+    }
+    wake.wakeAll();
+    wait();
+    // run handed the context back to this thread
+    delete context;
+    delete surface;
+    context = NULL;
+    surface = NULL;
+}
+
+void GpuUploader::upload(int ticket, const QVector<Span> & spans, std::shared_ptr<const void> owner)
+{
+    Request request;
+    request.ticket = ticket;
+    request.spans = spans;
+    request.owner = owner;
+    {
+        QMutexLocker lock(&mutex);
+        requests.append(request);
+    }
+    wake.wakeOne();
+}
+
+void GpuUploader::upload(int ticket, const TextureImage & image)
+{
+    Request request;
+    request.ticket = ticket;
+    request.image = image;
+    {
+        QMutexLocker lock(&mutex);
+        requests.append(request);
+    }
+    wake.wakeOne();
+}
+
+void GpuUploader::run()
+{
+    MESHLIB_TRACE_THREAD("gpu uploader");
+    context->makeCurrent(surface);
+    QOpenGLFunctions_4_5_Core * gl = context->versionFunctions<QOpenGLFunctions_4_5_Core>();
+    if (gl && !gl->initializeOpenGLFunctions()) gl = NULL;
+    while (gl)
+    {
+        Request request;
+        {
+            QMutexLocker lock(&mutex);
+            while (requests.isEmpty() && !stopping) wake.wait(&mutex);
+            if (stopping) break;
+            request = requests.takeFirst();
+        }
+        UploadedResources resources = process(gl, request);
+        // the arrays may go once they are copied
+        request = Request();
+        emit uploaded(resources);
+    }
+    context->doneCurrent();
+    context->moveToThread(QCoreApplication::instance()->thread());
+}
+
+UploadedResources GpuUploader::process(QOpenGLFunctions_4_5_Core * gl, const Request & request)
+{
+    MESHLIB_TRACE_ZONE("gpu upload");
+    UploadedResources resources;
+    resources.ticket = request.ticket;
+    for (const Span & span : request.spans)
+    {
+        // the storage and the mapping GlWidget::allocateBuffer gives, so that the buffer can be written on after
+        GLuint id = 0;
+        void * mapped = NULL;
+        if (span.size > 0)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            gl->glCreateBuffers(1, &id);
+            gl->glNamedBufferStorage(id, span.size, NULL, flags);
+            mapped = gl->glMapNamedBufferRange(id, 0, span.size, flags);
+            memcpy(mapped, span.data, span.size);
+            MESHLIB_GAUGE_ADD("gpu.buffer_bytes", span.size);
+        }
+        resources.buffers.append(id);
+        resources.capacities.append(id ? span.size : 0);
+        resources.mapped.append(mapped);
+    }
+
+    const TextureImage & image = request.image;
+    const int levels = image.levels.size();
+    if (levels > 0)
+    {
+        const GLenum format = image.compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+        gl->glCreateTextures(GL_TEXTURE_2D, 1, &resources.texture);
+        gl->glTextureStorage2D(resources.texture, levels, format, image.width, image.height);
+        for (int l = 0; l < levels; l++)
+        {
+            const int w = std::max(1, image.width >> l), h = std::max(1, image.height >> l);
+            const QByteArray & data = image.levels[l];
+            if (image.compressed) gl->glCompressedTextureSubImage2D(resources.texture, l, 0, 0, w, h, format, data.size(), data.constData());
+            else gl->glTextureSubImage2D(resources.texture, l, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data.constData());
+            resources.textureBytes += data.size();
+        }
+        gl->glTextureParameteri(resources.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        gl->glTextureParameteri(resources.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // flushed, so that the render context can wait on the fence
+    resources.fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gl->glFlush();
+    MESHLIB_COUNTER_ADD("gpu.uploads", 1);
+    return resources;
+}
+
+void GpuUploader::release(QOpenGLFunctions_4_5_Core * gl, UploadedResources & resources)
+{
+    if (resources.fence) gl->glDeleteSync(resources.fence);
+    for (int i = 0; i < resources.buffers.size(); i++)
+    {
+        if (!resources.buffers[i]) continue;
+        gl->glUnmapNamedBuffer(resources.buffers[i]);
+        gl->glDeleteBuffers(1, &resources.buffers[i]);
+        MESHLIB_GAUGE_ADD("gpu.buffer_bytes", -resources.capacities[i]);
+    }
+    gl->glDeleteTextures(1, &resources.texture);
+    resources = UploadedResources();
+}
@@ -0,0 +1,92 @@
+#ifndef GPUUPLOADER_H
+#define GPUUPLOADER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QMetaType>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QOpenGLFunctions_4_5_Core>
+#include <memory>
+#include "textureLoader.h"
+
+/*! the buffers or the texture of an upload, created in the share group of the widget, and the
+    fence of their copies, which the render thread waits on with glWaitSync before it draws
+    from them */
+struct UploadedResources
+{
+    int ticket = 0;
+    //! one per array asked for, persistently mapped as GlWidget::allocateBuffer maps them, 0 for an empty array
+    QVector<GLuint> buffers;
+    QVector<int> capacities;
+    QVector<void *> mapped;
+    GLuint texture = 0;
+    //! the bytes of the texture, for the gpu.texture_bytes gauge
+    qint64 textureBytes = 0;
+    GLsync fence = 0;
+};
+Q_DECLARE_METATYPE(UploadedResources)
+
+/*! creates buffers and textures on a thread of its own, in an OpenGL context that shares its
+    objects with the one of the widget, so that the copies of a large mesh or texture do not stall
+    the frames. the render thread hands over the arrays, keeps drawing what it has and swaps in
+    the resources once uploaded arrives. needs OpenGL 4.5, the fences and the direct state
+    access, available() is false otherwise */
+class GpuUploader : public QThread
+{
+    Q_OBJECT
+
+public:
+    //! an array to copy into a buffer of its own, owner keeps the bytes alive until it is copied
+    struct Span
+    {
+        const void * data;
+        int size;
+    };
+
+    GpuUploader(QObject * parent = 0);
+    ~GpuUploader();
+
+    /*! the context of the thread, sharing with share, which is current on this, the GUI, thread.
+        false if the platform cannot share, the thread is not started then */
+    bool initialize(QOpenGLContext * share);
+    bool available() const { return context != NULL; }
+    /*! drop the requests not started, wait for the thread and release its context */
+    void stop();
+
+    /*! copy every span into a new buffer, emitted as ticket */
+    void upload(int ticket, const QVector<Span> & spans, std::shared_ptr<const void> owner);
+    /*! create a texture with all levels of image, emitted as ticket */
+    void upload(int ticket, const TextureImage & image);
+
+    /*! delete what a stale upload created, with a context of the share group current */
+    static void release(QOpenGLFunctions_4_5_Core * gl, UploadedResources & resources);
+
+signals:
+    void uploaded(const UploadedResources & resources);
+
+protected:
+    void run();
+
+private:
+    struct Request
+    {
+        int ticket = 0;
+        QVector<Span> spans;
+        std::shared_ptr<const void> owner;
+        TextureImage image;
+    };
+    /*! the objects of request, fenced */
+    UploadedResources process(QOpenGLFunctions_4_5_Core * gl, const Request & request);
+
+    QOpenGLContext * context = NULL;
+    QOffscreenSurface * surface = NULL;
+    QMutex mutex;
+    QWaitCondition wake;
+    QVector<Request> requests;
+    bool stopping = false;
+};
+
+#endif // GPUUPLOADER_H
@@ -0,0 +1,172 @@
+#include "hyperbolicTiling.h"
+#include <QFile>
+#include <QVector2D>
+#include <QColor>
+#include <algorithm>
+#include <cmath>
+
+static QByteArray readResource(const char * name)
+{
+    QFile file(name);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+}
+
+void HyperbolicTiling::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    if (!gl) return;
+    const QByteArray version = "#version 450 core\n";
+    const QByteArray vertex = readResource(":/tilingShader.vsh"), fragment = readResource(":/tilingShader.fsh");
+    tileProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, version + vertex);
+    tileProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + fragment);
+    lineProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, version + "#define LINES\n" + vertex);
+    lineProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + "#define LINES\n" + fragment);
+    if (!tileProgram.link() || !lineProgram.link())
+    {
+        releaseGL();
+        return;
+    }
+    gl->glCreateVertexArrays(1, &vertexArray);
+}
+
+void HyperbolicTiling::releaseGL()
+{
+    if (!gl) return;
+    clear();
+    gl->glDeleteVertexArrays(1, &vertexArray);
+    vertexArray = 0;
+    tileProgram.removeAllShaders();
+    lineProgram.removeAllShaders();
+    gl = NULL;
+}
+
+void HyperbolicTiling::clear()
+{
+    if (!gl) return;
+    gl->glDeleteBuffers(1, &cornerBuffer);
+    gl->glDeleteBuffers(1, &lineBuffer);
+    gl->glDeleteBuffers(1, &tileBuffer);
+    cornerBuffer = lineBuffer = tileBuffer = 0;
+    cornerCount = sideCount = axisCount = circleCount = tileCount = 0;
+}
+
+bool HyperbolicTiling::upload(CMesh * mesh, int maxLength, int maxCount)
+{
+    clear();
+    group = MeshLib::CMobiusGroup();
+    if (!gl || !mesh || mesh->faces().size() == 0) return false;
+    if (group.add_side_pairings(*mesh) == 0) return false;
+
+    // the faces as fans of triangles, and the sides, the halfedges on the mesh boundary or whose
+    // twin has other uvs at its ends, from their source to their target
+    std::vector<QVector2D> corners, lines;
+    auto uv = [](const CPoint2 & p) { return QVector2D((float)p[0], (float)p[1]); };
+    for (CFace * f : mesh->faces())
+    {
+        CHalfEdge * first = f->halfedge();
+        for (CHalfEdge * he = first->next(); he->next() != first; he = he->next())
+        {
+            for (CHalfEdge * c : { first, he, he->next() }) corners.push_back(uv(c->uv()));
+        }
+    }
+    for (CHalfEdge * he : mesh->halfedges())
+    {
+        const CPoint2 a = he->prev()->uv(), b = he->uv();
+        CHalfEdge * twin = he->dual();
+        if (twin && (twin->uv() - a).norm() + (twin->prev()->uv() - b).norm() < 1e-6) continue;
+        lines.push_back(uv(a));
+        lines.push_back(uv(b));
+    }
+    sideCount = (int)lines.size();
+
+    // the axes and the circle through the identity, from the disk back to the uvs
+    auto disk = [](const MeshLib::Complex & z) { return QVector2D((float)(z.real() + 1) / 2, (float)(z.imag() + 1) / 2); };
+    std::vector<std::vector<MeshLib::Complex>> axes;
+    group.axes(arcPoints, axes);
+    for (const std::vector<MeshLib::Complex> & axis : axes)
+    {
+        for (size_t i = 1; i < axis.size(); i++)
+        {
+            lines.push_back(disk(axis[i - 1]));
+            lines.push_back(disk(axis[i]));
+        }
+    }
+    axisCount = (int)lines.size() - sideCount;
+    for (int i = 0; i < arcPoints; i++)
+    {
+        for (int k : { i, i + 1 }) lines.push_back(disk(std::polar(1.0, 2 * M_PI * k / arcPoints)));
+    }
+    circleCount = (int)lines.size() - sideCount - axisCount;
+
+    // the words from the first face, inside the domain, whose image tells the copies apart
+    MeshLib::Complex base(0, 0);
+    CHalfEdge * first = (*mesh->faces().begin())->halfedge();
+    for (CHalfEdge * c : { first, first->next(), first->next()->next() })
+        base += MeshLib::Complex(2 * c->uv()[0] - 1, 2 * c->uv()[1] - 1) / 3.0;
+    group.enumerate(base, (size_t)std::max(maxLength, 0), (size_t)std::max(maxCount, 1));
+    std::vector<GLfloat> tiles;
+    tiles.reserve(12 * group.elements().size());
+    for (size_t i = 0; i < group.elements().size(); i++)
+    {
+        MeshLib::Complex m[2][2];
+        group.elements()[i].matrix(m);
+        for (const MeshLib::Complex & e : { m[0][0], m[0][1], m[1][0], m[1][1] })
+        {
+            tiles.push_back((GLfloat)e.real());
+            tiles.push_back((GLfloat)e.imag());
+        }
+        tiles.push_back((GLfloat)group.lengths()[i]);
+        tiles.insert(tiles.end(), 3, 0.0f);
+    }
+    cornerCount = (int)corners.size();
+    tileCount = (int)group.elements().size();
+
+    gl->glCreateBuffers(1, &cornerBuffer);
+    gl->glNamedBufferStorage(cornerBuffer, corners.size() * sizeof(QVector2D), corners.data(), 0);
+    gl->glCreateBuffers(1, &lineBuffer);
+    gl->glNamedBufferStorage(lineBuffer, lines.size() * sizeof(QVector2D), lines.data(), 0);
+    gl->glCreateBuffers(1, &tileBuffer);
+    gl->glNamedBufferStorage(tileBuffer, tiles.size() * sizeof(GLfloat), tiles.data(), 0);
+    return true;
+}
+
+void HyperbolicTiling::draw(const QMatrix4x4 & mvp, GLuint texture, bool lines)
+{
+    if (!gl || !tileCount) return;
+
+    // a layout may run either way round, both faces of the tiles are drawn
+    tileProgram.bind();
+    tileProgram.setUniformValue("mvpMatrix", mvp);
+    tileProgram.setUniformValue("textureMap", 0);
+    tileProgram.setUniformValue("textured", texture != 0);
+    gl->glBindTextureUnit(0, texture);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, cornerBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tileBuffer);
+    gl->glDisable(GL_CULL_FACE);
+    gl->glBindVertexArray(vertexArray);
+    gl->glDrawArraysInstanced(GL_TRIANGLES, 0, cornerCount, tileCount);
+
+    if (lines)
+    {
+        // the sides and the axes of every copy, the circle once, through the identity of the first
+        lineProgram.bind();
+        lineProgram.setUniformValue("mvpMatrix", mvp);
+        gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lineBuffer);
+        gl->glDisable(GL_DEPTH_TEST);
+        lineProgram.setUniformValue("lineColor", QColor(40, 40, 40));
+        if (sideCount) gl->glDrawArraysInstanced(GL_LINES, 0, sideCount, tileCount);
+        lineProgram.setUniformValue("lineColor", QColor(230, 40, 20));
+        if (axisCount) gl->glDrawArraysInstanced(GL_LINES, sideCount, axisCount, tileCount);
+        lineProgram.setUniformValue("lineColor", QColor(10, 10, 10));
+        gl->glDrawArraysInstanced(GL_LINES, sideCount + axisCount, circleCount, 1);
+        gl->glEnable(GL_DEPTH_TEST);
+    }
+
+    gl->glBindVertexArray(0);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, 0);
+    gl->glBindTextureUnit(0, 0);
+    gl->glEnable(GL_CULL_FACE);
+    lineProgram.release();
+}
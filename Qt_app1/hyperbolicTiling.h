@@ -0,0 +1,66 @@
+#ifndef HYPERBOLICTILING_H
+#define HYPERBOLICTILING_H
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <vector>
+#include "viewerMesh.h"
+#include "Mobius/MobiusGroup.h"
+
+/*! the tiling of the Poincare disk by the copies of a fundamental domain, a mesh laid out in the
+    disk by its uvs as a hyperbolic uniformization cuts it open, see MeshLib::CRicciFlow::layout.
+    the triangles of the domain are uploaded once and every copy is an instance, drawn through its
+    Mobius transformation, a complex 2x2 matrix the vertex shader applies, see tilingShader.vsh, so
+    thousands of tiles cost one draw and no vertex work on the CPU. the copies are the words in the
+    side pairings of the domain, enumerated shortest first without repeats by MeshLib::CMobiusGroup.
+    the sides of the domain and the axes of the pairings, the closed geodesics of the surface they
+    move along, CHyperbolicLine arcs, are drawn over every copy as lines. needs OpenGL 4.5, the
+    calls do nothing until initializeGL */
+class HyperbolicTiling
+{
+public:
+    /*! build the programs with the context current, unavailable if they do not link */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    bool available() const { return gl != NULL; }
+
+    /*! the faces of mesh as the fundamental domain, its side pairings and the copies of the words
+        of at most maxLength of them, at most maxCount copies, in place of those uploaded before.
+        false and nothing to draw if the mesh has no uvs that pair its sides */
+    bool upload(CMesh * mesh, int maxLength, int maxCount);
+    /*! drop the tiles */
+    void clear();
+    bool loaded() const { return tileCount > 0; }
+    /*! the copies and the side pairings of the last upload */
+    int tiles() const { return tileCount; }
+    int generators() const { return (int)group.generators().size(); }
+
+    /*! every copy into the bound framebuffer, the disk in the plane z = 0 of the coordinates mvp
+        takes, textured by its uvs unless texture is 0, and the sides, the axes and the unit circle
+        over them with lines */
+    void draw(const QMatrix4x4 & mvp, GLuint texture, bool lines);
+
+    //! points of an axis and of the unit circle
+    static const int arcPoints = 64;
+
+private:
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    QOpenGLShaderProgram tileProgram;
+    QOpenGLShaderProgram lineProgram;
+    MeshLib::CMobiusGroup group;
+    //! the uvs of the corners of the triangles, and of the ends of the lines: the sides, the axes, the circle
+    GLuint cornerBuffer = 0;
+    GLuint lineBuffer = 0;
+    //! the matrix and the word length of every copy, three vec4 each
+    GLuint tileBuffer = 0;
+    //! no attributes, the vertex shader reads the buffers by gl_VertexID and gl_InstanceID
+    GLuint vertexArray = 0;
+    int cornerCount = 0;
+    int sideCount = 0;
+    int axisCount = 0;
+    int circleCount = 0;
+    int tileCount = 0;
+};
+
+#endif // HYPERBOLICTILING_H
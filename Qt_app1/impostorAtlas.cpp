@@ -0,0 +1,194 @@
+#include "impostorAtlas.h"
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+
+static QByteArray readResource(const char * name)
+{
+    QFile file(name);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+}
+
+void ImpostorAtlas::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    if (!gl) return;
+    const QByteArray version = "#version 450 core\n";
+    program.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, version + readResource(":/impostorShader.vsh"));
+    program.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + readResource(":/impostorShader.fsh"));
+    if (!program.link())
+    {
+        releaseGL();
+        return;
+    }
+    // no mipmaps, the images are captured about as large as they are drawn
+    gl->glCreateTextures(GL_TEXTURE_2D, 1, &atlas);
+    gl->glTextureStorage2D(atlas, 1, GL_RGBA8, atlasSize, atlasSize);
+    gl->glTextureParameteri(atlas, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl->glTextureParameteri(atlas, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTextureParameteri(atlas, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTextureParameteri(atlas, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    gl->glCreateRenderbuffers(1, &depth);
+    gl->glNamedRenderbufferStorage(depth, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+    gl->glCreateFramebuffers(1, &framebuffer);
+    gl->glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, atlas, 0);
+    gl->glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    if (gl->glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        releaseGL();
+        return;
+    }
+    gl->glCreateBuffers(1, &billboardBuffer);
+    gl->glCreateVertexArrays(1, &vertexArray);
+    reset(0);
+}
+
+void ImpostorAtlas::releaseGL()
+{
+    if (!gl) return;
+    gl->glDeleteFramebuffers(1, &framebuffer);
+    gl->glDeleteTextures(1, &atlas);
+    gl->glDeleteRenderbuffers(1, &depth);
+    gl->glDeleteBuffers(1, &billboardBuffer);
+    gl->glDeleteVertexArrays(1, &vertexArray);
+    framebuffer = atlas = depth = billboardBuffer = vertexArray = 0;
+    program.removeAllShaders();
+    slots.clear();
+    cells.clear();
+    requests.clear();
+    billboardData.clear();
+    gl = NULL;
+}
+
+void ImpostorAtlas::reset(int instances)
+{
+    if (!gl) return;
+    slots.fill(Tile(), instances);
+    cells.fill(-1, (atlasSize / cellSize) * (atlasSize / cellSize));
+    requests.clear();
+    billboardData.clear();
+}
+
+int ImpostorAtlas::tiles() const
+{
+    return (int)std::count_if(cells.begin(), cells.end(), [](int slot) { return slot >= 0; });
+}
+
+void ImpostorAtlas::begin(float maxAngle)
+{
+    frame++;
+    minCosine = std::cos(maxAngle * (float)M_PI / 180);
+    requests.clear();
+    billboardData.clear();
+}
+
+bool ImpostorAtlas::use(int slot, const QVector3D & center, float radius, const QVector3D & eye, float pixels)
+{
+    if (!gl || slot < 0 || slot >= slots.size()) return false;
+    const QVector3D direction = (eye - center).normalized();
+    Tile & tile = slots[slot];
+    // an image drawn at up to 1.5 times its pixels or down to half of them, finer or coarser ones are taken again
+    const bool good = tile.cell >= 0 && QVector3D::dotProduct(direction, tile.direction) >= minCosine
+        && pixels <= 1.5f * tile.pixels && 2 * pixels >= tile.pixels;
+    if (!good)
+    {
+        requests.append({ slot, pixels, center, radius, direction });
+        return false;
+    }
+    tile.used = frame;
+    const int columns = atlasSize / cellSize;
+    const float x = (float)((tile.cell % columns) * cellSize + 1) / atlasSize;
+    const float y = (float)((tile.cell / columns) * cellSize + 1) / atlasSize;
+    const float size = (float)tile.pixels / atlasSize;
+    const QVector3D right = radius * tile.right, up = radius * tile.up;
+    const GLfloat billboard[16] = { center.x(), center.y(), center.z(), 0, right.x(), right.y(), right.z(), 0,
+        up.x(), up.y(), up.z(), 0, x, y, size, size };
+    for (GLfloat v : billboard) billboardData.append(v);
+    return true;
+}
+
+int ImpostorAtlas::allocate(int slot)
+{
+    int best = -1;
+    for (int c = 0; c < cells.size(); c++)
+    {
+        if (cells[c] < 0)
+        {
+            best = c;
+            break;
+        }
+        const int used = slots[cells[c]].used;
+        if (used < frame && (best < 0 || used < slots[cells[best]].used)) best = c;
+    }
+    if (best < 0) return -1;
+    if (cells[best] >= 0) slots[cells[best]].cell = -1;
+    cells[best] = slot;
+    return best;
+}
+
+int ImpostorAtlas::capture(int budget, GLuint target, const std::function<void(int, const QMatrix4x4 &)> & draw)
+{
+    if (!gl || requests.isEmpty() || budget <= 0)
+    {
+        requests.clear();
+        return 0;
+    }
+    // the largest on screen first, they show the most while drawn as meshes
+    std::sort(requests.begin(), requests.end(), [](const Request & a, const Request & b) { return a.pixels > b.pixels; });
+    GLint viewport[4];
+    gl->glGetIntegerv(GL_VIEWPORT, viewport);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl->glEnable(GL_SCISSOR_TEST);
+    const GLfloat clear[4] = { 0, 0, 0, 0 }, farthest = 1;
+    const int columns = atlasSize / cellSize;
+    int captured = 0;
+    for (const Request & r : requests)
+    {
+        if (captured == budget) break;
+        Tile & tile = slots[r.slot];
+        if (tile.cell < 0) tile.cell = allocate(r.slot);
+        if (tile.cell < 0) break;
+
+        // an orthographic view of the sphere along the direction to the eye, upright unless it looks
+        // straight down or up, one pixel of the cell left clear around the image for the filtering
+        tile.direction = r.direction;
+        const QVector3D axis = std::abs(r.direction.y()) < 0.99f ? QVector3D(0, 1, 0) : QVector3D(0, 0, 1);
+        tile.right = QVector3D::crossProduct(axis, r.direction).normalized();
+        tile.up = QVector3D::crossProduct(r.direction, tile.right);
+        tile.pixels = std::min(std::max((int)std::ceil(r.pixels), 4), cellSize - 2);
+        QMatrix4x4 viewProjection;
+        viewProjection.ortho(-r.radius, r.radius, -r.radius, r.radius, r.radius, 3 * r.radius);
+        viewProjection.lookAt(r.center + 2 * r.radius * r.direction, r.center, tile.up);
+
+        const int x = (tile.cell % columns) * cellSize, y = (tile.cell / columns) * cellSize;
+        gl->glScissor(x, y, cellSize, cellSize);
+        gl->glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear);
+        gl->glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &farthest);
+        gl->glViewport(x + 1, y + 1, tile.pixels, tile.pixels);
+        draw(r.slot, viewProjection);
+        captured++;
+    }
+    gl->glDisable(GL_SCISSOR_TEST);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, target);
+    gl->glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    requests.clear();
+    return captured;
+}
+
+void ImpostorAtlas::draw(const QMatrix4x4 & mvp)
+{
+    if (!gl || billboardData.isEmpty()) return;
+    gl->glNamedBufferData(billboardBuffer, billboardData.size() * sizeof(GLfloat), billboardData.constData(), GL_STREAM_DRAW);
+    program.bind();
+    program.setUniformValue("mvpMatrix", mvp);
+    program.setUniformValue("atlas", 0);
+    gl->glBindTextureUnit(0, atlas);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, billboardBuffer);
+    gl->glBindVertexArray(vertexArray);
+    gl->glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, billboards());
+    gl->glBindVertexArray(0);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    gl->glBindTextureUnit(0, 0);
+    program.release();
+}
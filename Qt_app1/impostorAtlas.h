@@ -0,0 +1,93 @@
+#ifndef IMPOSTORATLAS_H
+#define IMPOSTORATLAS_H
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+#include <functional>
+
+/*! the distant instances of a scene as billboards of themselves, images of their bounding spheres
+    captured into the cells of one atlas texture and drawn in one instanced draw, see impostorShader.vsh.
+    a cell is good while the direction from the instance to the eye turns less than an angle from the
+    one it was captured along and the instance covers about as many pixels as the image has, the
+    others are drawn as meshes and queued, and capture takes the largest of them on screen first, a
+    budget a frame, so the images catch up over a few frames while the view turns. the cells go to
+    the instances drawn last longest ago once the atlas is full. needs OpenGL 4.5, the calls do
+    nothing until initializeGL */
+class ImpostorAtlas
+{
+public:
+    /*! build the program, the atlas and its framebuffer with the context current, unavailable if
+        either fails */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    bool available() const { return gl != NULL; }
+
+    /*! forget the images, for instance slots [0, instances) */
+    void reset(int instances);
+    /*! start the billboards of a frame, the images are good within maxAngle degrees */
+    void begin(float maxAngle);
+    /*! whether instance slot, the sphere of radius at center covering pixels on screen, is drawn by
+        its image from eye this frame, its billboard is added then. queues a capture otherwise */
+    bool use(int slot, const QVector3D & center, float radius, const QVector3D & eye, float pixels);
+    /*! capture at most budget of the queued instances into their cells of the atlas, drawn by
+        draw(slot, viewProjection) into the bound framebuffer and viewport with the depth test on,
+        then bind framebuffer and the viewport back. drops the queue \return the instances captured */
+    int capture(int budget, GLuint framebuffer, const std::function<void(int, const QMatrix4x4 &)> & draw);
+    /*! the billboards of this frame into the bound framebuffer, in the coordinates mvp takes */
+    void draw(const QMatrix4x4 & mvp);
+    int billboards() const { return billboardData.size() / 16; }
+    /*! the cells holding an image */
+    int tiles() const;
+
+    //! pixels of the atlas and of a cell, an instance covering more is too large for an image
+    static const int atlasSize = 2048;
+    static const int cellSize = 128;
+
+private:
+    //! a free cell, else that of the image drawn longest ago, not this frame, for slot, -1 if none
+    int allocate(int slot);
+
+    //! the image of an instance slot
+    struct Tile
+    {
+        //! -1 without one
+        int cell = -1;
+        //! the frame it was drawn last
+        int used = -1;
+        //! the pixels of its image, square
+        int pixels = 0;
+        QVector3D direction;
+        QVector3D right;
+        QVector3D up;
+    };
+    struct Request
+    {
+        int slot;
+        float pixels;
+        QVector3D center;
+        float radius;
+        QVector3D direction;
+    };
+
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    QOpenGLShaderProgram program;
+    GLuint atlas = 0;
+    GLuint depth = 0;
+    GLuint framebuffer = 0;
+    //! the center, the right and up half sides and the rectangle in the atlas of every billboard, four vec4 each
+    GLuint billboardBuffer = 0;
+    //! no attributes, the vertex shader reads the billboards by gl_InstanceID
+    GLuint vertexArray = 0;
+    QVector<Tile> slots;
+    //! the slot of every cell, -1 for a free one
+    QVector<int> cells;
+    QVector<Request> requests;
+    QVector<GLfloat> billboardData;
+    int frame = 0;
+    float minCosine = 1;
+};
+
+#endif // IMPOSTORATLAS_H
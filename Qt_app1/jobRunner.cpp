@@ -0,0 +1,423 @@
+#include "jobRunner.h"
+#include "viewerMesh.h"
+#include "materialAtlas.h"
+#include "parser/parallel.h"
+#include "Mesh/distance.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QSysInfo>
+#include <QElapsedTimer>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+#include <mutex>
+#include <algorithm>
+
+bool JobRunner::parseStages(const std::string & list, int & stages)
+{
+    stages = 0;
+    std::istringstream in(list);
+    std::string name;
+    while (std::getline(in, name, ','))
+    {
+        if (name == "decimate") stages |= Decimate;
+        else if (name == "compare") stages |= Compare;
+        else if (name == "atlas") stages |= Atlas;
+        else if (name == "normals") stages |= Normals;
+        else if (name == "normalize") stages |= Normalize;
+        else if (name == "bake") stages |= Bake;
+        else if (name == "write") stages |= Write;
+        else if (name == "thumbnail") stages |= Thumbnail;
+        else if (name != "read") return false;
+    }
+    return true;
+}
+
+bool JobRunner::parseShard(const std::string & shard, int & index, int & count)
+{
+    char rest;
+    if (sscanf(shard.c_str(), "%d/%d%c", &index, &count, &rest) != 2) return false;
+    return count > 0 && index >= 0 && index < count;
+}
+
+// the texture the occlusion is multiplied into, the map of the single material of the mesh without one
+static std::string bakeBase(const std::string & meshfile, const std::string & texture)
+{
+    if (!texture.empty()) return texture;
+    // several materials are laid out in an atlas of their own, only their occlusion is baked
+    MaterialAtlas atlas;
+    atlas.read(meshfile);
+    return atlas.tiled() ? "" : atlas.texture();
+}
+
+bool JobRunner::bake(ViewerMesh & mesh, const std::string & meshfile, const std::string & texture, int size, int rays,
+                     QImage & out, int threads)
+{
+    if (!mesh.mesh_with_uv)
+    {
+        std::cout << meshfile << " has no uvs to bake into" << std::endl;
+        return false;
+    }
+    const std::string basefile = bakeBase(meshfile, texture);
+    QImage base;
+    if (!basefile.empty() && !base.load(QString::fromStdString(basefile)))
+    {
+        std::cout << "Cannot read the texture " << basefile << std::endl;
+        return false;
+    }
+    if (size <= 0 && base.isNull()) size = 1024;
+    const int width = size > 0 ? size : base.width();
+    const int height = size > 0 ? size : base.height();
+
+    QElapsedTimer clock;
+    clock.start();
+    std::vector<float> ao;
+    const size_t covered = mesh.bake_occlusion(width, height, rays, ao, threads);
+    std::cout << "Baked " << covered << " texels of " << width << "x" << height << " with " << rays << " rays in "
+              << clock.nsecsElapsed() * 1e-6 << " ms" << std::endl;
+
+    // the rows of the image top down, those of the bake from v = 0 up
+    out = base.isNull() ? QImage(width, height, QImage::Format_RGB32)
+                        : base.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(QImage::Format_ARGB32);
+    for (int y = 0; y < height; y++)
+    {
+        QRgb * row = (QRgb *)out.scanLine(y);
+        const float * occlusion = &ao[(size_t)(height - 1 - y) * width];
+        for (int x = 0; x < width; x++)
+        {
+            const float a = occlusion[x];
+            if (base.isNull()) row[x] = qRgb((int)(255 * a + 0.5f), (int)(255 * a + 0.5f), (int)(255 * a + 0.5f));
+            else row[x] = qRgba((int)(qRed(row[x]) * a + 0.5f), (int)(qGreen(row[x]) * a + 0.5f), (int)(qBlue(row[x]) * a + 0.5f), qAlpha(row[x]));
+        }
+    }
+    return true;
+}
+
+bool JobRunner::bakeNormals(ViewerMesh & mesh, const std::vector<MeshLib::CBakeCorner> & high, const std::string & meshfile, int size,
+                            QImage & out, int threads)
+{
+    if (!mesh.mesh_with_uv)
+    {
+        std::cout << meshfile << " has no uvs to bake into" << std::endl;
+        return false;
+    }
+    if (size <= 0) size = 1024;
+
+    QElapsedTimer clock;
+    clock.start();
+    std::vector<uint32_t> normals;
+    const size_t covered = mesh.bake_normals(high, size, size, normals, threads);
+    std::cout << "Baked the normals of " << high.size() / 3 << " triangles into " << covered << " texels of " << size << "x"
+              << size << " in " << clock.nsecsElapsed() * 1e-6 << " ms" << std::endl;
+
+    // the rows of the image top down, those of the bake from v = 0 up
+    out = QImage(size, size, QImage::Format_RGB32);
+    for (int y = 0; y < size; y++) std::memcpy(out.scanLine(y), &normals[(size_t)(size - 1 - y) * size], 4 * (size_t)size);
+    return true;
+}
+
+bool JobRunner::rebake(ViewerMesh & mesh, const std::vector<MeshLib::CRebakeCorner> & source, const std::string & meshfile,
+                       const std::string & texture, int padding, QImage & out, int threads)
+{
+    const std::string basefile = bakeBase(meshfile, texture);
+    if (!mesh.mesh_with_uv || basefile.empty())
+    {
+        std::cout << meshfile << " has no uvs or no texture to repack" << std::endl;
+        return false;
+    }
+    QImage base;
+    if (!base.load(QString::fromStdString(basefile)))
+    {
+        std::cout << "Cannot read the texture " << basefile << std::endl;
+        return false;
+    }
+    base = base.convertToFormat(QImage::Format_ARGB32);
+
+    QElapsedTimer clock;
+    clock.start();
+    int width, height;
+    const size_t charts = mesh.repack_atlas(CPoint2(base.width(), base.height()), padding, width, height, threads);
+    if (width <= 0 || height <= 0)
+    {
+        std::cout << "Cannot pack the charts of " << meshfile << std::endl;
+        return false;
+    }
+    // the rows of the images top down, those of the atlases from v = 0 up
+    std::vector<uint32_t> texels((size_t)base.width() * base.height());
+    for (int y = 0; y < base.height(); y++)
+        std::memcpy(&texels[(size_t)(base.height() - 1 - y) * base.width()], base.constScanLine(y), 4 * (size_t)base.width());
+    std::vector<MeshLib::CRebakeCorner> target;
+    mesh.texture_corners(target);
+    std::vector<uint32_t> atlas;
+    MeshLib::CTextureRebaker rebaker;
+    rebaker.bake(source.size() / 3, [&](size_t t, int k) { return source[3 * t + k]; }, texels.data(), base.width(), base.height(),
+                 target.size() / 3, [&](size_t t, int k) { return target[3 * t + k]; }, width, height, atlas, threads);
+    out = QImage(width, height, QImage::Format_ARGB32);
+    for (int y = 0; y < height; y++) std::memcpy(out.scanLine(y), &atlas[(size_t)(height - 1 - y) * width], 4 * (size_t)width);
+    std::cout << "Repacked " << charts << " charts from " << base.width() << "x" << base.height() << " to " << width << "x"
+              << height << " texels in " << clock.nsecsElapsed() * 1e-6 << " ms" << std::endl;
+    return true;
+}
+
+int JobRunner::run(MeshRenderer & renderer, const std::vector<Job> & jobs)
+{
+    std::vector<Job> mine;
+    for (size_t i = (size_t)shard_index; i < jobs.size(); i += (size_t)std::max(shard_count, 1)) mine.push_back(jobs[i]);
+    const QDir dir(QString::fromStdString(output_dir));
+    // the caches apart, the one of a mesh read from output_dir stays mapped while it is processed
+    const QDir caches(dir.filePath("cache"));
+    QDir().mkpath(caches.absolutePath());
+
+    char name[32];
+    snprintf(name, sizeof(name), "report_%d.csv", shard_index);
+    std::ofstream report(dir.filePath(name).toStdString());
+    if (!report)
+    {
+        std::cout << "Cannot write " << dir.filePath(name).toStdString() << std::endl;
+        return (int)mine.size();
+    }
+    report << "node,shard,mesh,stage,ms,ok,stored\n";
+    // the distances of the decimated surfaces to the ones read, a row per direction
+    std::ofstream distances;
+    if (stages & Compare)
+    {
+        snprintf(name, sizeof(name), "distance_%d.csv", shard_index);
+        distances.open(dir.filePath(name).toStdString());
+        if (!distances)
+        {
+            std::cout << "Cannot write " << dir.filePath(name).toStdString() << std::endl;
+            return (int)mine.size();
+        }
+        distances << "node,shard,mesh,direction,samples,max,mean,rms\n";
+    }
+    const std::string node = QSysInfo::machineHostName().toStdString();
+    std::mutex reportMutex;
+    auto row = [&](const std::string & mesh, const char * stage, const QElapsedTimer & clock, bool ok, bool stored = false)
+    {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        report << node << ',' << shard_index << ",\"" << mesh << "\"," << stage << ',' << clock.nsecsElapsed() * 1e-6 << ','
+               << (ok ? 1 : 0) << ',' << (stored ? 1 : 0) << '\n';
+        report.flush();
+    };
+    auto distance = [&](const std::string & mesh, const char * direction, const MeshLib::CSurfaceDistance & d)
+    {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        distances << node << ',' << shard_index << ",\"" << mesh << "\"," << direction << ',' << d.samples() << ','
+                  << d.hausdorff() << ',' << d.mean() << ',' << d.rms() << '\n';
+        distances.flush();
+    };
+
+    // the CPU stages, workers meshes at once sharing the threads, each mesh ends as its binary cache
+    const int pool = MeshLib::resolve_threads(0);
+    const int meshes = std::max(1, std::min(workers > 0 ? workers : pool, (int)std::max<size_t>(mine.size(), 1)));
+    const int threads = std::max(1, pool / meshes);
+    std::vector<char> done(mine.size(), 0);
+    std::vector<std::string> textures(mine.size());
+    MeshLib::CJob batch(MeshLib::PRIORITY_BATCH);
+    MeshLib::CJobScope scope(&batch);
+    MeshLib::parallel_for(mine.size(), meshes, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            const Job & job = mine[i];
+            const QString base = QFileInfo(QString::fromStdString(job.mesh)).completeBaseName();
+            const std::string stem = dir.filePath(base).toStdString();
+            const std::string cacheFile = caches.filePath(base + ".smv").toStdString();
+            const std::string atlasFile = stem + "_atlas.png";
+            const std::string normalFile = stem + "_normal.png";
+            const std::string bakeFile = stem + "_ao.png";
+            const std::string writeFile = stem + write_extension;
+            const bool decimating = (stages & Decimate) && decimate_ratio < 1;
+            textures[i] = job.texture;
+            QElapsedTimer clock;
+            clock.start();
+
+            // the key of the mesh after the stages chains the bytes read and every stage, the
+            // texture repacked too, atlas, normals, bake and write chain theirs onto it, the texture baked into too
+            MeshLib::CStoreKey key, atlasKey, normalKey, bakeKey, writeKey;
+            bool keyed = store.enabled() && MeshLib::CContentStore::hash_file(job.mesh, key, threads);
+            char text[64];
+            if (keyed)
+            {
+                key = MeshLib::CContentStore::hash("read " + std::to_string(keep_components) + (repair ? " repair" : ""), key);
+                snprintf(text, sizeof(text), "weld %.17g", weld);
+                if (weld >= 0) key = MeshLib::CContentStore::hash(text, key);
+                if (reorder) key = MeshLib::CContentStore::hash("reorder", key);
+                snprintf(text, sizeof(text), "decimate %.17g", decimate_ratio);
+                if (decimating) key = MeshLib::CContentStore::hash(text, key);
+                if (stages & Atlas)
+                {
+                    const std::string repacked = bakeBase(job.mesh, job.texture);
+                    MeshLib::CStoreKey t;
+                    keyed = !repacked.empty() && MeshLib::CContentStore::hash_file(repacked, t, threads);
+                    snprintf(text, sizeof(text), "atlas %d", atlas_padding);
+                    key = MeshLib::CContentStore::hash(&t, sizeof(t), MeshLib::CContentStore::hash(text, key));
+                    atlasKey = MeshLib::CContentStore::hash("atlas texture", key);
+                }
+                snprintf(text, sizeof(text), "normals %d", normal_size);
+                normalKey = MeshLib::CContentStore::hash(text, key);
+                if (stages & Normalize) key = MeshLib::CContentStore::hash("normalize", key);
+                snprintf(text, sizeof(text), "bake %d %d", bake_size, bake_rays);
+                bakeKey = MeshLib::CContentStore::hash(text, key);
+                writeKey = MeshLib::CContentStore::hash("write", key);
+            }
+            bool bakeKeyed = keyed && (stages & Bake);
+            // a repacked texture is in the key already
+            const std::string texture = bakeKeyed && !(stages & Atlas) ? bakeBase(job.mesh, job.texture) : "";
+            if (!texture.empty())
+            {
+                MeshLib::CStoreKey t;
+                bakeKeyed = MeshLib::CContentStore::hash_file(texture, t, threads);
+                bakeKey = MeshLib::CContentStore::hash(&t, sizeof(t), bakeKey);
+            }
+            // an output in the store is copied out, the mesh is only read and processed for the others
+            auto fetch = [&](bool use, const MeshLib::CStoreKey & k, const std::string & ext, const std::string & file)
+            {
+                std::string path;
+                return use && store.find(k, ext, path) && MeshLib::CContentStore::copy_file(path, file);
+            };
+            // the stored mesh has the uvs of the stored atlas, one without the other is made again, as
+            // is a mesh without its normal map, which is baked from the mesh before decimate
+            const bool atlased = fetch(keyed && (stages & Atlas), atlasKey, ".png", atlasFile);
+            const bool normaled = fetch(keyed && (stages & Normals), normalKey, ".png", normalFile);
+            const bool cached = (atlased || !(stages & Atlas)) && (normaled || !(stages & Normals)) && fetch(keyed, key, ".smv", cacheFile);
+            bool baked = fetch(bakeKeyed, bakeKey, ".png", bakeFile);
+            bool written = fetch(keyed && (stages & Write), writeKey, write_extension, writeFile);
+            if (atlased) textures[i] = atlasFile;
+            if (baked) textures[i] = bakeFile;
+            if (cached && (baked || !(stages & Bake)) && (written || !(stages & Write)))
+            {
+                row(job.mesh, "store", clock, true, true);
+                done[i] = 1;
+                continue;
+            }
+
+            // held until the mesh is dropped, the meshes of the shard wait for each other past the budget
+            const QFileInfo read(QString::fromStdString(cached ? cacheFile : job.mesh));
+            MeshLib::CMemoryGrant grant((size_t)(read.size() * memory_per_byte));
+            ViewerMesh mesh;
+            mesh.keep_positions = true;
+            mesh.keep_components = keep_components;
+            mesh.use_cache = use_cache;
+            mesh.repair = repair;
+            mesh.weld = weld;
+            mesh.reorder = reorder;
+            mesh.store = store.enabled() ? &store : NULL;
+            // the stored cache is the mesh after the stages, as they left its points
+            bool ok = mesh.input_obj(cached ? cacheFile : job.mesh, threads) == 0;
+            row(job.mesh, "read", clock, ok, cached);
+            // the texture is resampled from the surface as read, and the decimated one compared to it,
+            // its normals baked into the atlas of the decimated one
+            std::vector<MeshLib::CRebakeCorner> source;
+            if (ok && !cached && (stages & (Atlas | Compare))) mesh.texture_corners(source);
+            std::vector<MeshLib::CBakeCorner> high;
+            if (ok && !cached && (stages & Normals)) mesh.bake_corners(high);
+            if (ok && !cached && decimating)
+            {
+                clock.restart();
+                mesh.decimate(decimate_ratio, threads);
+                row(job.mesh, "decimate", clock, true);
+            }
+            if (ok && !cached && (stages & Compare))
+            {
+                clock.restart();
+                MeshLib::CMeshDistance<CMesh> compared(*mesh.m_mesh(), "distance", threads);
+                compared.measure_triangles(source.size() / 3, [&](size_t t, int k) { return source[3 * t + k].point; }, compare_samples);
+                mesh.m_mesh()->remove_vertex_property("distance");
+                distance(job.mesh, "decimated", compared.to());
+                distance(job.mesh, "read", compared.from());
+                row(job.mesh, "compare", clock, true);
+            }
+            if (ok && !cached && (stages & Atlas))
+            {
+                clock.restart();
+                QImage atlas;
+                ok = rebake(mesh, source, job.mesh, job.texture, atlas_padding, atlas, threads) && atlas.save(QString::fromStdString(atlasFile));
+                if (ok && keyed) store.put_file(atlasKey, ".png", atlasFile);
+                row(job.mesh, "atlas", clock, ok);
+                if (ok) textures[i] = atlasFile;
+            }
+            std::vector<MeshLib::CRebakeCorner>().swap(source);
+            if (ok && !cached && (stages & Normals))
+            {
+                clock.restart();
+                QImage normals;
+                // in the uvs of the repacked atlas if there is one
+                ok = bakeNormals(mesh, high, job.mesh, normal_size, normals, threads) && normals.save(QString::fromStdString(normalFile));
+                if (ok && keyed) store.put_file(normalKey, ".png", normalFile);
+                row(job.mesh, "normals", clock, ok);
+            }
+            std::vector<MeshLib::CBakeCorner>().swap(high);
+            if (ok && !cached && (stages & Normalize))
+            {
+                clock.restart();
+                mesh.keep_positions = false;
+                ok = mesh.normalize() == 0;
+                row(job.mesh, "normalize", clock, ok);
+            }
+            if (ok && !baked && (stages & Bake))
+            {
+                clock.restart();
+                QImage ao;
+                // over the repacked texture if there is one
+                ok = bake(mesh, job.mesh, (stages & Atlas) ? atlasFile : job.texture, bake_size, bake_rays, ao, threads)
+                     && ao.save(QString::fromStdString(bakeFile));
+                if (ok && bakeKeyed) store.put_file(bakeKey, ".png", bakeFile);
+                row(job.mesh, "bake", clock, ok);
+                // the thumbnails show the baked texture
+                if (ok) textures[i] = bakeFile;
+            }
+            if (ok && !written && (stages & Write))
+            {
+                clock.restart();
+                ok = mesh.output(writeFile, threads) == 0;
+                if (ok && keyed) store.put_file(writeKey, write_extension, writeFile);
+                row(job.mesh, "write", clock, ok);
+            }
+            if (ok && !cached)
+            {
+                clock.restart();
+                ok = mesh.output(cacheFile, threads) == 0;
+                if (ok && keyed) store.put_file(key, ".smv", cacheFile);
+                row(job.mesh, "cache", clock, ok);
+            }
+            if (!ok) std::cout << "Failed " << job.mesh << std::endl;
+            done[i] = ok ? 1 : 0;
+        }
+    }, 1);
+
+    // the thumbnails from the caches, the maps of the materials of the mesh if it has no texture
+    if ((stages & Thumbnail) && std::count(done.begin(), done.end(), 1) > 0)
+    {
+        std::vector<Job> cached;
+        std::vector<size_t> index;
+        for (size_t i = 0; i < mine.size(); i++)
+        {
+            if (!done[i]) continue;
+            std::string texture = textures[i];
+            if (texture.empty())
+            {
+                MaterialAtlas atlas;
+                if (atlas.read(mine[i].mesh) && !atlas.tiled()) texture = atlas.texture();
+            }
+            const QString base = QFileInfo(QString::fromStdString(mine[i].mesh)).completeBaseName();
+            cached.push_back(Job{ caches.filePath(base + ".smv").toStdString(), texture });
+            index.push_back(i);
+        }
+        for (size_t k = 0; k < cached.size(); k++)
+        {
+            QElapsedTimer clock;
+            clock.start();
+            const bool ok = thumbnails.run(renderer, std::vector<Job>(1, cached[k])) == 0;
+            row(mine[index[k]].mesh, "thumbnail", clock, ok);
+            if (!ok) done[index[k]] = 0;
+        }
+    }
+
+    const int failed = (int)std::count(done.begin(), done.end(), 0);
+    std::cout << "Shard " << shard_index << "/" << shard_count << ": " << mine.size() - failed << " of " << mine.size()
+              << " meshes done, see " << dir.filePath(name).toStdString() << std::endl;
+    return failed;
+}
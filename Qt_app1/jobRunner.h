@@ -0,0 +1,100 @@
+#ifndef JOBRUNNER_H
+#define JOBRUNNER_H
+
+#include <QImage>
+#include <vector>
+#include <string>
+#include "batchRenderer.h"
+#include "parser/store.h"
+#include "Geometry/TextureRebaker.h"
+
+class ViewerMesh;
+
+/*! runs the stages of a nightly batch over a list of meshes in one process: read, decimate,
+    compare, atlas, normals, normalize, bake, write and thumbnails. a mesh is read once and goes
+    from stage to stage in memory, then is left as output_dir/cache/name.smv, the binary cache, for
+    the thumbnails and later runs. a node takes every shard_count-th job of the list from shard_index,
+    so the nodes of a farm share one list without talking to each other. the CPU stages of workers
+    meshes run at once, each on its share of the threads, the thumbnails are drawn on this thread.
+    every stage of every job is a row of output_dir/report_<shard_index>.csv, with the node and the
+    milliseconds, so an output directory the nodes share collects all of the timing. with a store
+    the outputs are filed under the hash of the mesh and of the stages that made them, and a job
+    whose outputs are all there is only copied out of it, a stored row. compare measures how far
+    the decimated surface is from the one read, both ways, as rows of
+    output_dir/distance_<shard_index>.csv, only when the mesh is made and not taken from a store.
+    the stages run as a job of the batch priority, within the workers and the memory the shared
+    pool grants it, behind whatever else the process does */
+class JobRunner
+{
+public:
+    using Job = BatchRenderer::Job;
+    enum Stage { Decimate = 1, Normalize = 2, Bake = 4, Write = 8, Thumbnail = 16, Atlas = 32, Compare = 64, Normals = 128 };
+
+    /*! the stages to run, Stage flags, the mesh is always read */
+    int stages = Normalize | Thumbnail;
+    int shard_index = 0;
+    int shard_count = 1;
+    /*! meshes in the CPU stages at once, 0 for one per hardware thread */
+    int workers = 1;
+    std::string output_dir = ".";
+    /*! the bytes of memory a mesh in the CPU stages is taken to need per byte of its file, it waits
+        for them within the memory of the batch priority, see MeshLib::CThreadPool::set_memory */
+    double memory_per_byte = 8;
+    /*! how the meshes are read */
+    bool use_cache = true;
+    size_t keep_components = 0;
+    /*! see ViewerMesh::repair */
+    bool repair = false;
+    /*! see ViewerMesh::weld */
+    double weld = -1;
+    /*! see ViewerMesh::reorder */
+    bool reorder = false;
+    /*! where the outputs are filed and looked up, see MeshLib::CContentStore, none without a directory */
+    MeshLib::CContentStore store;
+    /*! Decimate keeps this fraction of the triangles */
+    double decimate_ratio = 1;
+    /*! Compare samples each surface this many times, 0 for one per triangle, see MeshLib::CMeshDistance */
+    size_t compare_samples = 0;
+    /*! Atlas repacks the uv charts of the decimated mesh and writes its texture resampled into them
+        as name_atlas.png, the charts this many texels apart, see rebake */
+    int atlas_padding = 2;
+    /*! Normals bakes the normals of the mesh as read into the uv atlas of the decimated one as
+        name_normal.png, normal_size texels square, see bakeNormals */
+    int normal_size = 1024;
+    /*! Bake writes name_ao.png, bake_size texels square, the size of the texture if 0 */
+    int bake_size = 0;
+    int bake_rays = 64;
+    /*! Write writes name plus this extension, in any format of ViewerMesh::output */
+    std::string write_extension = ".obj";
+    /*! the views, size and directory of the thumbnails */
+    BatchRenderer thumbnails;
+
+    /*! stages from a list such as "decimate,normalize,bake", false for an unknown one */
+    static bool parseStages(const std::string & list, int & stages);
+    /*! "index/count", false if it is not one */
+    static bool parseShard(const std::string & shard, int & index, int & count);
+
+    /*! the ambient occlusion of mesh, read from meshfile, multiplied into texture or the map of its
+        single material, at their size unless size is given, 1024 without. false with a message
+        if there is nothing to bake into or the texture cannot be read */
+    static bool bake(ViewerMesh & mesh, const std::string & meshfile, const std::string & texture, int size, int rays,
+                     QImage & out, int threads = 0);
+
+    /*! the normals of high, the bake_corners of the mesh before it was decimated, in the tangent
+        frames of the uv atlas of mesh, size texels square, see ViewerMesh::bake_normals. false with
+        a message if mesh has no uvs */
+    static bool bakeNormals(ViewerMesh & mesh, const std::vector<MeshLib::CBakeCorner> & high, const std::string & meshfile, int size,
+                            QImage & out, int threads = 0);
+
+    /*! pack the uv charts of mesh into a new atlas and resample texture, or the map of the single
+        material of meshfile, from the surface of source into it, see ViewerMesh::texture_corners.
+        the charts keep the texels per uv of the texture, so the atlas only loses the space between
+        them. false with a message if there are no uvs or no texture, or it cannot be read */
+    static bool rebake(ViewerMesh & mesh, const std::vector<MeshLib::CRebakeCorner> & source, const std::string & meshfile,
+                       const std::string & texture, int padding, QImage & out, int threads = 0);
+
+    /*! run the stages over the jobs of this shard, the number of jobs that failed */
+    int run(MeshRenderer & renderer, const std::vector<Job> & jobs);
+};
+
+#endif // JOBRUNNER_H
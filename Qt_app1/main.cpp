@@ -1,17 +1,663 @@
-
 #include <QApplication>
+#include <QMainWindow>
+#include <QDockWidget>
+#include <QTimer>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QElapsedTimer>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
 #include "viewer.h"
 #include "viewerMesh.h"
+#include "batchRenderer.h"
+#include "jobRunner.h"
+#include "cameraPath.h"
+#include "startupProfiler.h"
+#include "countersPanel.h"
+#include "renderMesh.h"
+#include "materialAtlas.h"
+#include "meshServer.h"
+#include "parser/parallel.h"
+#include "parser/pages.h"
+#include "parser/counters.h"
+#include "parser/trace.h"
+
+
+static void usage()
+{
+    std::cout << "usage: Qt_app1 mesh [texture|-] [mesh [texture|-] ...] [options]" << std::endl
+              << "       Qt_app1 --scene file [options]" << std::endl
+              << "       Qt_app1 --batch list outdir [options]" << std::endl
+              << "       Qt_app1 --jobs list outdir [--stages list] [--shard i/n] [options]" << std::endl
+              << "       Qt_app1 --serve port dir [options]" << std::endl
+              << "       Qt_app1 --connect host:port mesh [texture] [options]" << std::endl
+              << "  --cache, --no-cache   read and write the mapped cache of a mesh or not" << std::endl
+              << "  --store dir           file the caches and job outputs by the hash of their inputs" << std::endl
+              << "  --decimate r          simplify the meshes to r of their triangles" << std::endl
+              << "  --repair              drop non-manifold and degenerate faces as the meshes are built" << std::endl
+              << "  --weld tol            merge the points of the meshes at most tol apart as they are built" << std::endl
+              << "  --reorder             lay out the meshes along a space filling curve as they are built" << std::endl
+              << "  --patches n           group the faces into compact patches of at most n for culling" << std::endl
+              << "  --report              print the counts, components, genus and bounds of every mesh read" << std::endl
+              << "  --sequence fps        play the meshes numbered as the mesh as an animation" << std::endl
+              << "  --threads n           threads of the parsers and the layout, 0 for all" << std::endl
+              << "  --headless outdir     render the meshes to outdir without a window" << std::endl
+              << "  --output file         write the single mesh, decimated, and quit" << std::endl
+              << "  --bench               time the stages of every mesh and quit" << std::endl
+              << "  --bake-ao file        bake the ambient occlusion of the single mesh into its texture and quit" << std::endl
+              << "  see main.cpp for the options of the view" << std::endl;
+}
+
+// the levels of --viewport-lods, a comma separated list, false if an entry is not a number
+static bool parseLevels(const std::string & list, std::vector<int> & levels)
+{
+    levels.clear();
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        const size_t end = std::min(list.find(',', start), list.size());
+        const std::string entry = list.substr(start, end - start);
+        char * rest = NULL;
+        const long level = strtol(entry.c_str(), &rest, 10);
+        if (entry.empty() || *rest != 0) return false;
+        levels.push_back((int)std::max(-1L, level));
+        start = end + 1;
+    }
+    return true;
+}
+
+// a texture follows its mesh on the command line, told apart by its extension
+static bool isImageFile(const std::string & fname)
+{
+    const QByteArray suffix = QFileInfo(QString::fromStdString(fname)).suffix().toLower().toLatin1();
+    return !suffix.isEmpty() && QImageReader::supportedImageFormats().contains(suffix);
+}
 
+// the settings of the view that change what is read
+static void readSettings(const GlWidget & w, ViewerMesh & mesh)
+{
+    mesh.keep_positions = w.keepPositions;
+    mesh.keep_components = (size_t)w.keepComponents;
+    mesh.use_cache = w.useCache;
+    mesh.repair = w.repairInput;
+    mesh.weld = w.weldTolerance;
+    mesh.reorder = w.reorderInput;
+    mesh.patches = (size_t)w.patchSize;
+    mesh.store = w.store.enabled() ? &w.store : NULL;
+    mesh.decimate_ratio = w.decimateRatio;
+    mesh.print_report = w.printReport;
+}
+
+// read mesh, decimated, and write it to fname with its points as read
+static int writeInput(const GlWidget & w, const std::string & meshfile, const std::string & fname)
+{
+    ViewerMesh mesh;
+    readSettings(w, mesh);
+    mesh.keep_positions = true;
+    if (mesh.input_obj(meshfile))
+    {
+        std::cout << "Cannot read the mesh " << meshfile << std::endl;
+        return 1;
+    }
+    if (mesh.output(fname))
+    {
+        std::cout << "Cannot write " << fname << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// bake the ambient occlusion of mesh into its uv atlas, multiplied into texture, or the map of its
+// single material, at their size unless size is given, 1024 without, and write it to fname
+static int bakeInput(const GlWidget & w, const std::string & meshfile, const std::string & texture, const std::string & fname,
+                     int size, int rays)
+{
+    ViewerMesh mesh;
+    readSettings(w, mesh);
+    if (mesh.input_obj(meshfile))
+    {
+        std::cout << "Cannot read the mesh " << meshfile << std::endl;
+        return 1;
+    }
+    QImage out;
+    if (!JobRunner::bake(mesh, meshfile, texture, size, rays, out)) return 1;
+    if (!out.save(QString::fromStdString(fname)))
+    {
+        std::cout << "Cannot write " << fname << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// read, decimate, lay out and write every input on this thread, printing the milliseconds of each
+static int benchInputs(const GlWidget & w, const std::vector<BatchRenderer::Job> & inputs, const std::string & fname)
+{
+    int failed = 0;
+    for (const BatchRenderer::Job & input : inputs)
+    {
+        ViewerMesh mesh;
+        readSettings(w, mesh);
+        mesh.decimate_ratio = 1;
+        QElapsedTimer clock;
+        clock.start();
+        if (mesh.input_obj(input.mesh))
+        {
+            std::cout << "Cannot read the mesh " << input.mesh << std::endl;
+            failed++;
+            continue;
+        }
+        std::cout << input.mesh << ": read " << clock.nsecsElapsed() * 1e-6 << " ms";
+        if (w.decimateRatio < 1)
+        {
+            clock.restart();
+            mesh.decimate(w.decimateRatio);
+            std::cout << ", decimate " << clock.nsecsElapsed() * 1e-6 << " ms";
+        }
+        clock.restart();
+        RenderMesh prepared;
+        prepared.prepare(&mesh, w.renderOptions());
+        std::cout << ", layout " << clock.nsecsElapsed() * 1e-6 << " ms";
+        if (!fname.empty())
+        {
+            clock.restart();
+            if (mesh.output(fname)) failed++;
+            std::cout << ", write " << clock.nsecsElapsed() * 1e-6 << " ms";
+        }
+        std::cout << std::endl;
+    }
+    return failed ? 1 : 0;
+}
+
+// serve the meshes under dir to --connect viewers until the process is stopped
+static int serveMeshes(QApplication & a, const GlWidget & w, int port, const std::string & dir)
+{
+    MeshServer server(dir);
+    server.use_cache = w.useCache;
+    server.store = w.store;
+    server.keep_components = (size_t)w.keepComponents;
+    server.decimate_ratio = w.decimateRatio;
+    if (!server.listen(QHostAddress::Any, (quint16)port))
+    {
+        std::cout << "Cannot listen on port " << port << std::endl;
+        return 1;
+    }
+    std::cout << "Serving the meshes under " << dir << " on port " << port << std::endl;
+    return a.exec();
+}
 
 int main(int argc, char *argv[])
 {
+    // the stages are timed from here
+    StartupProfiler::instance();
     QApplication a(argc, argv);
 
     GlWidget w;
-    w.meshfile = argv[1];
-    w.textfile = argv[2];
-    w.v_mesh()->input_obj(w.meshfile);
-    w.show();
-    return a.exec();
+    // mesh [texture] ... shows the meshes, side by side as a scene if there are several, a texture
+    // is recognized by its image extension. without one, or with -, the diffuse maps of the .mtl
+    // materials of an .obj are drawn, several packed into one atlas
+    // --batch list outdir renders the meshes of list, a mesh and optionally its texture per line,
+    // to outdir without a window, from the views of --views file, "alpha beta distance" per line,
+    // or --orbit n views around the mesh, at --size WxH pixels, --headless outdir does the same
+    // for the meshes of the command line
+    // --scene file shows the meshes of a scene file, see Scene::read, in place of the meshes
+    // --cache and --no-cache read and write the mapped cache of a mesh or not, see
+    // ViewerMesh::use_cache, --decimate r simplifies the meshes to r of their triangles as they
+    // are read, see ViewerMesh::decimate, --threads n parses and lays out the meshes on n threads,
+    // all hardware threads by default, see MeshLib::default_threads, --repair drops the faces that
+    // are not manifold, repeated or without area and splits the vertices where fans meet as the
+    // meshes are built, for scans that would not build otherwise, see MeshLib::CMeshRepair, --weld
+    // tol merges the points at most tol apart first, 0 for equal ones, for meshes exported with a
+    // vertex per face corner, STL and some OBJ files, see MeshLib::CPointWelder, --reorder lays
+    // out the vertices and faces along the Morton curve after that, and numbers them so, for files
+    // whose order is not local, see MeshLib::CMortonOrder. --patches n groups the faces into
+    // patches of at most n, compact and turning little, lists them patch by patch in the cache
+    // and builds the meshlets of the finest level from the patches of its triangles, so that the
+    // culling and a cache read in ranges take whole patches, see MeshLib::CSegmentation
+    // --report prints a line per mesh read with its counts, boundary loops, components, Euler
+    // characteristic, genus, valences and bounds, folded in one sweep of each kind of element as
+    // the mesh is built and kept in its cache, see MeshLib::CMeshAnalysis, and what the layout for
+    // drawing came to, the welded vertices, levels of detail, meshlets, creases and splats
+    // --store dir files the caches in dir by the hash of the bytes of the meshes instead of next to
+    // them, and the outputs of --jobs by the hashes of their inputs and stages, --shared-store dir
+    // adds a directory the nodes of a farm share, a network mount, whose hits are copied to --store,
+    // see MeshLib::CContentStore. a copied, renamed or touched mesh finds its outputs, an edited one
+    // or other parameters miss
+    // --output file writes the single mesh, decimated, to file, its points as read, in the format
+    // of its extension, see ViewerMesh::output, and quits, --bench times the stages of every mesh,
+    // read, decimate, the layout of the buffers and --output, on this thread and quits
+    // --output file.mtx cuts the mesh into a hierarchy of simplified tiles, see MeshLib::write_mtx_file,
+    // and mesh.mtx is then drawn from the tiles the view needs, read as it moves and kept within
+    // --tile-memory MB of video memory, 512 by default, see TiledMesh
+    // --bake-ao file.png bakes the ambient occlusion of the single mesh into its uv atlas, see
+    // MeshLib::COcclusionBaker, multiplied into its texture or the map of its material, at their
+    // size or --ao-size n texels square, --ao-rays n per texel, 64 by default, and quits. drawn
+    // as the texture of the mesh it shades the view without any lighting per frame
+    // --quantize picks the compact vertex layout, --compress a BC1 texture, --virtual a tiled texture
+    // streamed by what is visible, --legacy the OpenGL 3.0 path for old drivers, --lit shading with
+    // the vertex normals, --wireframe and --boundary the overlays, toggled by W and B, --keep-positions
+    // normalization by the model matrix, --progressive coarse levels while the camera moves, --splats
+    // points sampled on an octree, toggled by S, the points themselves for a scan without faces,
+    // lit with --lit by the normals fitted to their nearest points, see MeshLib::CPointNormals, --hud the frame times over the view and --profile
+    // file.csv them in a log, --components n only the n largest connected parts, --fetch reads the
+    // files in large blocks ahead of the parser instead of mapping them, for a network store,
+    // --startup file.csv times the stages from launch to the first complete frame and quits then,
+    // --trace file.json writes the zones of all threads until the window closes, in a build with
+    // MESHLIB_TRACE defined, for chrome://tracing or ui.perfetto.dev
+    // --pages transparent or --pages huge maps the arenas and property arrays of the meshes of 2 MB
+    // and more on huge pages, the reserved ones first for huge, --first-touch faults their pages in
+    // on the threads of the parallel passes and --interleave spreads them over the NUMA nodes, for
+    // the large meshes of machines with several sockets, see MeshLib::CPages. on Windows huge takes
+    // large pages, with the lock pages privilege, and transparent the small ones, it has none
+    // --watch reads the mesh again whenever its file is written, --watch-delay ms after the last
+    // write, 200 by default. an .obj file exported again with the same faces only moves the points
+    // of its blocks that changed, in the buffers too, see ViewerMesh::update_obj, any other change
+    // reads it in full
+    // --checkpoint file.ckp writes the mesh as it is in memory, slots, touched flags and properties
+    // included, to the file on K and every --checkpoint-every seconds while it changes, taken in a
+    // pass over its arrays and written on a thread of its own, so a long edit goes back to it by
+    // opening the .ckp file as the mesh, see ViewerMesh::checkpoint. --output to a .ckp writes one
+    // --features draws the creases of the single mesh and its silhouette over it, toggled by F, the
+    // creases where the normals turn by more than --crease-angle degrees, 40 by default. they are
+    // classified once as the mesh is laid out and the silhouette is found by a geometry shader from
+    // the adjacency of the triangles, so the lines follow the camera at no cost on the CPU, see
+    // MeshLib::CFeatureEdges, core backend only
+    // --viewports n splits the window into n views side by side, drawn from the buffers and textures
+    // uploaded once, so that they cost no memory or loading of their own, --viewport-lods list the
+    // level every view draws, a comma separated list, -1 picks it by the error on screen, so that
+    // 0,2 shows the mesh read beside its second simplification. the
+    // views turn together, --unlink-cameras gives every view its own camera, L toggles it, see
+    // GlWidget::viewportCount
+    // --path keys.txt plays a camera path, "alpha beta distance" keyframes, over --frames n frames
+    // without a window, at --size WxH, prints the frame time percentiles, writes every frame to
+    // --path-log file.csv and fails with 2 if the 95th percentile of the GPU time is above
+    // --budget ms, see CameraPath
+    // --cpu-culling culls the meshlets, picks the level of detail and computes the normals of edits
+    // on the CPU instead of in the compute shaders of the core backend, see MeshCompute
+    // --sync-upload creates the buffers of a loaded mesh and its texture on the thread that draws,
+    // in place of the upload thread with a context sharing its objects, whose copies are fenced and
+    // swapped in while the preview is drawn, see GpuUploader, the legacy backend always does
+    // --occlusion skips the instances of a scene hidden behind others in the depth of the last
+    // frames, read back and reduced into a pyramid on the CPU, see OcclusionCuller, core backend only
+    // --impostors px draws the instances of a scene covering at most px pixels, 128 at most, by images
+    // of themselves captured into an atlas and drawn as billboards in one call, good while the direction
+    // to the eye turns less than --impostor-angle deg, 4 by default, at most --impostor-budget n of them
+    // captured a frame, 8 by default, the others drawn as meshes meanwhile, see ImpostorAtlas, core
+    // backend only
+    // --visibility draws the triangle under every pixel first and shades every pixel once from it
+    // after, for meshes with many triangles below a pixel, see GlWidget::visibilityRendering
+    // --volume draws a volume mesh as a translucent volume of a scalar per tet, toggled by V, the
+    // value of the tet trait --volume-field key, "value" by default, or the radius ratio of the tets
+    // without it, see TetVolume, core backend only
+    // --tiling draws the copies of a surface laid out in the Poincare disk by its uvs, cut open into a
+    // fundamental domain by a hyperbolic uniformization, under the group its side pairings generate,
+    // toggled by T, with the sides and the axes of the pairings over them with --boundary. the domain
+    // is uploaded once and every copy is an instance moved by its Mobius transformation in the vertex
+    // shader, the copies are the words of at most --tiling-length n pairings, 12 by default, and at
+    // most --tiling-count n of them, 4096 by default, found without repeats on the CPU, see
+    // MeshLib::CMobiusGroup and HyperbolicTiling, core backend only
+    // --counters shows the counters of the viewer and MeshLib in a dock beside the view, and
+    // --counters-json file.json writes them every --counters-interval ms, 1000 by default, for a
+    // monitoring agent, see MeshLib::CCounters
+    // --jobs list outdir runs the stages of --stages, a comma separated list of decimate, compare,
+    // atlas, normals, normalize, bake, write and thumbnail, normalize,thumbnail by default, over the meshes of list in this
+    // process without a window, see JobRunner. a mesh is read once, goes through the stages in
+    // memory and is left in outdir/cache as its binary cache, the thumbnails are drawn from that as
+    // --batch draws them. --shard i/n takes every n-th mesh of the list from the i-th, for n nodes
+    // sharing the list, --workers n processes n meshes at once on the threads of --threads, 1 by
+    // default, 0 for one per thread, --job-format .ext is the format of write, .obj by default.
+    // --decimate, --ao-size and --ao-rays apply. atlas packs the uv charts of the decimated mesh
+    // tighter, --atlas-padding n texels apart, 2 by default, and resamples its texture into them as
+    // outdir/name_atlas.png, which the bake and the thumbnails then use, see JobRunner::rebake. the
+    // stages of every mesh are timed in outdir/report_i.csv, with the name of the node. compare
+    // measures the Hausdorff, mean and RMS distances between the decimated surface and the one read,
+    // both ways, on --compare-samples n points of each, one per triangle by default, into
+    // outdir/distance_i.csv, see MeshLib::CMeshDistance. normals bakes the normals of the mesh read
+    // into the uv atlas of the decimated one, the repacked one after atlas, as the tangent space
+    // normal map outdir/name_normal.png, --normal-size n texels square, 1024 by default, see
+    // MeshLib::CNormalBaker
+    // --normal-map file.png shades the decimated mesh with --lit by that map in place of its vertex
+    // normals, in the tangent frames the fragment shader takes from the derivatives of the position
+    // and the uv, so the detail simplified away still catches the light, single meshes only
+    // --batch-threads n runs the batch work, the stages of --jobs, on at most n workers of the
+    // pool at once and --batch-memory mb keeps the meshes in them to about mb megabytes, a mesh
+    // counted at 8 times its file, so that they leave room for anything else on the node, see
+    // MeshLib::CThreadPool::set_budget, all of them and no limit by default
+    // --compare file colors the mesh by the distance of its vertices to the surface of file, in
+    // place of the texture, from blue at none to red at the largest, file moved as the mesh is
+    // normalized, so the mesh itself with --decimate shows where the simplification moved it
+    // --serve port dir serves the meshes under dir without a window, read as the view reads them and
+    // simplified into progressive meshes, see MeshServer, to viewers started with --connect host:port
+    // and the name of a mesh under that directory. the coarse base is drawn as soon as it arrives and
+    // refined while its error on screen is above the level of detail error, so the bytes sent follow
+    // the view, see StreamedMesh
+    // --sequence fps plays frame_0001.obj and the other files numbered as the mesh, all of one
+    // topology, as an animation at fps frames a second, see MeshSequence. only their points are
+    // read, on a thread a few frames ahead, into frame_.seq beside them, which the later passes
+    // and runs map instead. the points are kept as read, --weld, --reorder, --decimate, --repair
+    // and --components would renumber them and do not apply
+    std::vector<BatchRenderer::Job> inputs;
+    std::string batchList;
+    std::string sceneFile;
+    std::string outputFile;
+    bool bench = false;
+    std::string bakeFile;
+    int bakeSize = 0;
+    int bakeRays = 64;
+    BatchRenderer renderer;
+    bool headless = false;
+    std::string startupLog;
+    std::string traceFile;
+    CameraPath path;
+    std::string pathLog;
+    bool showCounters = false;
+    std::string countersJson;
+    int countersInterval = 1000;
+    int servePort = 0;
+    std::string jobList;
+    JobRunner jobs;
+    int batchThreads = 0;
+    size_t batchMemory = 0;
+    std::string serveDir;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool value = i + 1 < argc;
+        if (arg.size() < 2 || arg.compare(0, 2, "--") != 0)
+        {
+            if (!inputs.empty() && inputs.back().texture.empty() && (arg == "-" || isImageFile(arg)))
+                inputs.back().texture = arg == "-" ? "" : arg;
+            else inputs.push_back(BatchRenderer::Job{ arg, "" });
+        }
+        else if (arg == "--batch" && i + 2 < argc)
+        {
+            batchList = argv[++i];
+            renderer.output_dir = argv[++i];
+        }
+        else if (arg == "--headless" && value)
+        {
+            headless = true;
+            renderer.output_dir = argv[++i];
+        }
+        else if (arg == "--scene" && value) sceneFile = argv[++i];
+        else if (arg == "--serve" && i + 2 < argc)
+        {
+            servePort = atoi(argv[++i]);
+            serveDir = argv[++i];
+        }
+        else if (arg == "--connect" && value) w.meshServer = argv[++i];
+        else if (arg == "--jobs" && i + 2 < argc)
+        {
+            jobList = argv[++i];
+            jobs.output_dir = argv[++i];
+        }
+        else if (arg == "--stages" && value)
+        {
+            if (!JobRunner::parseStages(argv[++i], jobs.stages))
+            {
+                std::cout << "Unknown stage in " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--shard" && value)
+        {
+            if (!JobRunner::parseShard(argv[++i], jobs.shard_index, jobs.shard_count))
+            {
+                std::cout << "The shard is index/count, not " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--workers" && value) jobs.workers = std::max(0, atoi(argv[++i]));
+        else if (arg == "--batch-threads" && value) batchThreads = std::max(0, atoi(argv[++i]));
+        else if (arg == "--batch-memory" && value) batchMemory = (size_t)std::max(0, atoi(argv[++i]));
+        else if (arg == "--job-format" && value) jobs.write_extension = argv[++i];
+        else if (arg == "--cache") w.useCache = true;
+        else if (arg == "--no-cache") w.useCache = false;
+        else if (arg == "--repair") w.repairInput = true;
+        else if (arg == "--weld" && value) w.weldTolerance = std::max(0.0, atof(argv[++i]));
+        else if (arg == "--reorder") w.reorderInput = true;
+        else if (arg == "--patches" && value) w.patchSize = std::max(0, atoi(argv[++i]));
+        else if (arg == "--report") w.printReport = true;
+        else if (arg == "--store" && value) w.store.local = argv[++i];
+        else if (arg == "--shared-store" && value) w.store.shared = argv[++i];
+        else if (arg == "--decimate" && value) w.decimateRatio = std::min(1.0, std::max(0.0, atof(argv[++i])));
+        else if (arg == "--threads" && value) MeshLib::default_threads() = std::max(0, atoi(argv[++i]));
+        else if (arg == "--output" && value) outputFile = argv[++i];
+        else if (arg == "--bench") bench = true;
+        else if (arg == "--bake-ao" && value) bakeFile = argv[++i];
+        else if (arg == "--ao-size" && value) bakeSize = std::max(0, atoi(argv[++i]));
+        else if (arg == "--ao-rays" && value) bakeRays = std::max(1, atoi(argv[++i]));
+        else if (arg == "--compare-samples" && value) jobs.compare_samples = (size_t)std::max(0, atoi(argv[++i]));
+        else if (arg == "--compare" && value) w.compareFile = argv[++i];
+        else if (arg == "--atlas-padding" && value) jobs.atlas_padding = std::max(0, atoi(argv[++i]));
+        else if (arg == "--normal-size" && value) jobs.normal_size = std::max(1, atoi(argv[++i]));
+        else if (arg == "--normal-map" && value) w.normalMapFile = argv[++i];
+        else if (arg == "--tile-memory" && value) w.tileMemory = std::max(1, atoi(argv[++i]));
+        else if (arg == "--quantize") w.vertexFormat = GlWidget::QuantizedVertices;
+        else if (arg == "--compress") w.compressTexture = true;
+        else if (arg == "--virtual") w.virtualTexturing = true;
+        else if (arg == "--legacy") w.setBackend(GlWidget::LegacyBackend);
+        else if (arg == "--lit") w.lighting = true;
+        else if (arg == "--wireframe") w.showWireframe = true;
+        else if (arg == "--boundary") w.showBoundary = true;
+        else if (arg == "--features") w.showFeatures = true;
+        else if (arg == "--crease-angle" && value) w.creaseAngle = (float)std::min(180.0, std::max(0.0, atof(argv[++i])));
+        else if (arg == "--keep-positions") w.keepPositions = true;
+        else if (arg == "--sequence" && value)
+        {
+            w.sequenceFps = std::max(1, atoi(argv[++i]));
+            w.keepPositions = true;
+        }
+        else if (arg == "--progressive") w.coarseWhileMoving = true;
+        else if (arg == "--splats") w.showSplats = true;
+        else if (arg == "--hud") w.showHud = true;
+        else if (arg == "--viewports" && value) w.viewportCount = std::max(1, atoi(argv[++i]));
+        else if (arg == "--viewport-lods" && value)
+        {
+            if (!parseLevels(argv[++i], w.viewportLods))
+            {
+                std::cout << "The levels are a comma separated list, not " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--unlink-cameras") w.linkCameras = false;
+        else if (arg == "--cpu-culling") w.computeCulling = false;
+        else if (arg == "--sync-upload") w.uploadThread = false;
+        else if (arg == "--occlusion") w.occlusionCulling = true;
+        else if (arg == "--impostors" && value) w.impostorPixels = std::max(0, atoi(argv[++i]));
+        else if (arg == "--impostor-angle" && value) w.impostorAngle = (float)std::min(90.0, std::max(0.0, atof(argv[++i])));
+        else if (arg == "--impostor-budget" && value) w.impostorBudget = std::max(0, atoi(argv[++i]));
+        else if (arg == "--visibility") w.visibilityRendering = true;
+        else if (arg == "--volume") w.showVolume = true;
+        else if (arg == "--volume-field" && value) w.volumeField = argv[++i];
+        else if (arg == "--tiling") w.showTiling = true;
+        else if (arg == "--tiling-length" && value) w.tilingLength = std::max(0, atoi(argv[++i]));
+        else if (arg == "--tiling-count" && value) w.tilingCount = std::max(1, atoi(argv[++i]));
+        else if (arg == "--watch") w.watchFile = true;
+        else if (arg == "--watch-delay" && value) w.watchDelay = std::max(0, atoi(argv[++i]));
+        else if (arg == "--checkpoint" && value) w.checkpointFile = argv[++i];
+        else if (arg == "--checkpoint-every" && value) w.checkpointSeconds = std::max(0, atoi(argv[++i]));
+        else if (arg == "--counters") showCounters = true;
+        else if (arg == "--counters-json" && value) countersJson = argv[++i];
+        else if (arg == "--counters-interval" && value) countersInterval = std::max(1, atoi(argv[++i]));
+        else if (arg == "--fetch") MeshLib::CMappedFile::default_mode() = MeshLib::CMappedFile::FETCH;
+        else if (arg == "--pages" && value)
+        {
+            const std::string pages = argv[++i];
+            MeshLib::CPages::policy().pages = pages == "huge" ? MeshLib::CMemoryPolicy::HUGE_PAGES
+                : pages == "transparent" ? MeshLib::CMemoryPolicy::TRANSPARENT_PAGES : MeshLib::CMemoryPolicy::SMALL_PAGES;
+#ifdef _WIN32
+            if (pages == "transparent") std::cout << "--pages transparent maps small pages, Windows has no transparent huge pages" << std::endl;
+#endif
+        }
+        else if (arg == "--first-touch") MeshLib::CPages::policy().first_touch = true;
+        else if (arg == "--interleave") MeshLib::CPages::policy().interleave = true;
+        else if (arg == "--components" && value) w.keepComponents = atoi(argv[++i]);
+        else if (arg == "--profile" && value) w.profileLog = argv[++i];
+        else if (arg == "--startup" && value) startupLog = argv[++i];
+        else if (arg == "--trace" && value) traceFile = argv[++i];
+        else if (arg == "--orbit" && value) renderer.views = BatchRenderer::orbit(atoi(argv[++i]));
+        else if (arg == "--size" && value)
+        {
+            sscanf(argv[++i], "%dx%d", &renderer.width, &renderer.height);
+            path.width = renderer.width;
+            path.height = renderer.height;
+        }
+        else if (arg == "--frames" && value) path.frames = std::max(1, atoi(argv[++i]));
+        else if (arg == "--path-log" && value) pathLog = argv[++i];
+        else if (arg == "--budget" && value) path.budget = atof(argv[++i]);
+        else if (arg == "--path" && value)
+        {
+            if (!path.read(argv[++i]))
+            {
+                std::cout << "Cannot read the camera path " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--views" && value)
+        {
+            if (!renderer.read_views(argv[++i]))
+            {
+                std::cout << "Cannot read the views " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << "Unknown option or missing value " << arg << std::endl;
+            usage();
+            return 1;
+        }
+    }
+    // the pool is sized by --threads as it starts
+    if (batchThreads > 0) MeshLib::CThreadPool::instance().set_budget(MeshLib::PRIORITY_BATCH, batchThreads);
+    if (batchMemory > 0) MeshLib::CThreadPool::instance().set_memory(MeshLib::PRIORITY_BATCH, batchMemory << 20);
+    if (servePort > 0 && inputs.empty() && batchList.empty() && sceneFile.empty()) return serveMeshes(a, w, servePort, serveDir);
+    if (!jobList.empty() && inputs.empty() && batchList.empty() && sceneFile.empty())
+    {
+        std::vector<BatchRenderer::Job> list;
+        if (!BatchRenderer::read_jobs(jobList, list))
+        {
+            std::cout << "Cannot read the mesh list " << jobList << std::endl;
+            return 1;
+        }
+        jobs.use_cache = w.useCache;
+        jobs.repair = w.repairInput;
+        jobs.weld = w.weldTolerance;
+        jobs.reorder = w.reorderInput;
+        jobs.store = w.store;
+        jobs.keep_components = (size_t)w.keepComponents;
+        jobs.decimate_ratio = w.decimateRatio;
+        jobs.bake_size = bakeSize;
+        jobs.bake_rays = bakeRays;
+        jobs.thumbnails = renderer;
+        jobs.thumbnails.output_dir = jobs.output_dir;
+        return jobs.run(w, list) ? 1 : 0;
+    }
+    if (inputs.empty() == (batchList.empty() && sceneFile.empty()) || ((!outputFile.empty() || !bakeFile.empty()) && inputs.size() != 1)
+        || (!w.meshServer.empty() && inputs.size() != 1) || servePort != 0 || !jobList.empty())
+    {
+        usage();
+        return 1;
+    }
+    if (w.sequenceFps > 0 && (inputs.size() != 1 || w.weldTolerance >= 0 || w.reorderInput || w.decimateRatio < 1
+        || w.repairInput || w.keepComponents > 0))
+    {
+        std::cout << "--sequence plays a single mesh with its points as read" << std::endl;
+        usage();
+        return 1;
+    }
+    if (!inputs.empty())
+    {
+        w.meshfile = inputs[0].mesh;
+        w.textfile = inputs[0].texture;
+    }
+
+    if (bench) return benchInputs(w, inputs, outputFile);
+    if (!outputFile.empty()) return writeInput(w, inputs[0].mesh, outputFile);
+    if (!bakeFile.empty()) return bakeInput(w, inputs[0].mesh, inputs[0].texture, bakeFile, bakeSize, bakeRays);
+
+    if (!startupLog.empty() && !StartupProfiler::instance().openLog(startupLog))
+    {
+        std::cout << "Cannot write " << startupLog << std::endl;
+        return 1;
+    }
+
+#ifdef MESHLIB_TRACE
+    MESHLIB_TRACE_THREAD("gui");
+    if (!traceFile.empty()) MeshLib::CTrace::start();
+#else
+    if (!traceFile.empty()) std::cout << "Tracing needs a build with MESHLIB_TRACE defined" << std::endl;
+#endif
+
+    if (!batchList.empty())
+    {
+        std::vector<BatchRenderer::Job> jobs;
+        if (!BatchRenderer::read_jobs(batchList, jobs))
+        {
+            std::cout << "Cannot read the mesh list " << batchList << std::endl;
+            return 1;
+        }
+        return renderer.run(w, jobs) ? 1 : 0;
+    }
+    if (headless) return renderer.run(w, inputs) ? 1 : 0;
+
+    const bool scene = !sceneFile.empty() || inputs.size() > 1;
+    if (!path.keys.empty() && !scene)
+    {
+        return path.run(w, w.meshfile, w.textfile, pathLog);
+    }
+
+    if (!sceneFile.empty() && !w.loadScene(sceneFile))
+    {
+        std::cout << "Cannot read the scene " << sceneFile << std::endl;
+        return 1;
+    }
+    if (sceneFile.empty() && scene)
+    {
+        // the meshes of the command line side by side
+        Scene s;
+        std::vector<size_t> unplaced;
+        for (const BatchRenderer::Job & input : inputs)
+        {
+            unplaced.push_back(s.instances.size());
+            s.add(input.mesh, input.texture, QVector3D());
+        }
+        s.place(unplaced);
+        w.showScene(s);
+    }
+
+    // the window takes the view only while it runs, the view is not its to delete
+    QMainWindow window;
+    if (showCounters)
+    {
+        window.setCentralWidget(&w);
+        QDockWidget * dock = new QDockWidget("Counters", &window);
+        dock->setWidget(new CountersPanel(dock));
+        window.addDockWidget(Qt::RightDockWidgetArea, dock);
+    }
+    QTimer countersTimer;
+    if (!countersJson.empty())
+    {
+        QObject::connect(&countersTimer, &QTimer::timeout, [&countersJson]()
+        {
+            if (!MeshLib::CCounters::write_json(countersJson)) std::cout << "Cannot write " << countersJson << std::endl;
+        });
+        countersTimer.start(countersInterval);
+    }
+
+    StartupProfiler::instance().record("application", 0);
+    if (showCounters) window.show();
+    else w.show();
+    // the mesh is drawn while it is parsed
+    if (!scene) w.loadMesh(w.meshfile);
+    const int ret = a.exec();
+    if (showCounters) window.takeCentralWidget();
+#ifdef MESHLIB_TRACE
+    if (!traceFile.empty() && !MeshLib::CTrace::write(traceFile)) std::cout << "Cannot write " << traceFile << std::endl;
+#endif
+    return ret;
 }
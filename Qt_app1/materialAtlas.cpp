@@ -0,0 +1,96 @@
+#include "materialAtlas.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QPainter>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "parser/objparser.h"
+
+// name relative to the folder of file, unless it is absolute
+static std::string besides(const std::string & file, const std::string & name)
+{
+    const QDir dir = QFileInfo(QString::fromStdString(file)).absoluteDir();
+    return QDir::cleanPath(dir.filePath(QString::fromStdString(name))).toStdString();
+}
+
+bool MaterialAtlas::read(const std::string & objfile)
+{
+    std::vector<std::string> mtllibs;
+    if (!MeshLib::CObjParser::scan_mtllibs(objfile, mtllibs)) return false;
+    return read(objfile, mtllibs);
+}
+
+bool MaterialAtlas::read(const std::string & objfile, const std::vector<std::string> & mtllibs)
+{
+    materials.clear();
+    for (const std::string & lib : mtllibs)
+    {
+        const std::string file = besides(objfile, lib);
+        const size_t first = materials.size();
+        // a missing library leaves its faces without a material, as other viewers do
+        if (!MeshLib::CMtlParser::parse_file(file, materials)) continue;
+        for (size_t i = first; i < materials.size(); i++)
+        {
+            std::string & map = materials[i].diffuse_map;
+            if (!map.empty()) map = besides(file, map);
+        }
+    }
+    columns = std::max(1, (int)std::ceil(std::sqrt((double)materials.size())));
+    rows = std::max(1, ((int)materials.size() + columns - 1) / columns);
+    return !materials.empty();
+}
+
+int MaterialAtlas::find(const std::string & name) const
+{
+    for (size_t i = 0; i < materials.size(); i++)
+        if (materials[i].name == name) return (int)i;
+    return -1;
+}
+
+std::string MaterialAtlas::texture() const
+{
+    return materials.size() == 1 ? materials[0].diffuse_map : std::string();
+}
+
+MeshLib::CPoint2 MaterialAtlas::place(int material, const MeshLib::CPoint2 & uv) const
+{
+    double u = uv[0], v = uv[1];
+    if (u < 0 || u > 1) u -= std::floor(u);
+    if (v < 0 || v > 1) v -= std::floor(v);
+    // cell 0 at the bottom left, v grows upwards as the texture rows do
+    return MeshLib::CPoint2((material % columns + u) / columns, (material / columns + v) / rows);
+}
+
+QImage MaterialAtlas::compose(int maxSize) const
+{
+    if (materials.empty()) return QImage();
+    std::vector<QImage> maps(materials.size());
+    int cell = 16;
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        if (materials[i].diffuse_map.empty()) continue;
+        maps[i] = QImage(QString::fromStdString(materials[i].diffuse_map));
+        if (maps[i].isNull()) std::cout << "Cannot read the texture " << materials[i].diffuse_map << std::endl;
+        else cell = std::max(cell, std::max(maps[i].width(), maps[i].height()));
+    }
+    cell = std::max(1, std::min(cell, maxSize / columns));
+
+    QImage atlas(columns * cell, rows * cell, QImage::Format_RGBA8888);
+    atlas.fill(Qt::white);
+    QPainter painter(&atlas);
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        // the rows of the image go down, the cells of place up
+        const QRect box((int)i % columns * cell, (rows - 1 - (int)i / columns) * cell, cell, cell);
+        if (!maps[i].isNull())
+        {
+            painter.drawImage(box, maps[i].scaled(cell, cell, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+            continue;
+        }
+        const MeshLib::CPoint & kd = materials[i].diffuse;
+        painter.fillRect(box, QColor::fromRgbF(std::min(1.0, std::max(0.0, kd[0])), std::min(1.0, std::max(0.0, kd[1])),
+            std::min(1.0, std::max(0.0, kd[2]))));
+    }
+    return atlas;
+}
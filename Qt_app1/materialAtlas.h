@@ -0,0 +1,45 @@
+#ifndef MATERIALATLAS_H
+#define MATERIALATLAS_H
+
+#include <QImage>
+#include <vector>
+#include <string>
+#include "Geometry/Point2.h"
+#include "parser/mtlparser.h"
+
+/*! the materials of the .mtl libraries an .obj names, their diffuse maps, or colors, laid out
+    on a grid of square cells in one texture so that a mesh of several materials is drawn with a
+    single texture and a single draw. the uvs of a face of material m are moved into cell m by
+    place, the atlas is decoded by TextureLoader::compose. a mesh of a single material keeps its
+    uvs and draws its map as the texture */
+class MaterialAtlas
+{
+public:
+    /*! the materials of the mtllib records before the first face of objfile, false if it names none */
+    bool read(const std::string & objfile);
+    /*! the materials of mtllibs, named relative to objfile, their maps relative to their library */
+    bool read(const std::string & objfile, const std::vector<std::string> & mtllibs);
+
+    size_t size() const { return materials.size(); }
+    bool empty() const { return materials.empty(); }
+    /*! whether the uvs are moved into cells, there is more than one material */
+    bool tiled() const { return materials.size() > 1; }
+    /*! the index of the material called name, -1 if there is none */
+    int find(const std::string & name) const;
+    /*! the diffuse map of a single material, empty for an atlas or a material without one */
+    std::string texture() const;
+    /*! uv, wrapped into [0, 1] if it is outside, in the cell of material */
+    MeshLib::CPoint2 place(int material, const MeshLib::CPoint2 & uv) const;
+    /*! the atlas, top row first, a cell as wide as the largest map but at most maxSize / columns
+        texels, a material without a readable map filled with its color. null without materials */
+    QImage compose(int maxSize = 8192) const;
+
+    std::vector<MeshLib::CMtlMaterial> materials;
+
+private:
+    //! cells per row, and rows, of the grid
+    int columns = 1;
+    int rows = 1;
+};
+
+#endif // MATERIALATLAS_H
@@ -0,0 +1,259 @@
+#include "meshCompute.h"
+#include <QOpenGLContext>
+#include <QFile>
+#include <algorithm>
+#include <vector>
+
+#ifndef GL_PARAMETER_BUFFER_ARB
+#define GL_PARAMETER_BUFFER_ARB 0x80EE
+#endif
+
+// a meshlet as cullMeshlets.comp reads it, std430
+struct PackedMeshlet
+{
+    GLfloat sphere[4];
+    GLfloat cone[4];
+    GLuint first;
+    GLuint count;
+    GLuint level;
+    GLuint pad;
+};
+
+static QByteArray readResource(const char * name)
+{
+    QFile file(name);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+}
+
+void MeshCompute::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    if (!gl) return;
+    const QByteArray version = "#version 450 core\n";
+    // linked from the program binary cache of Qt after the first launch
+    cullProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Compute, version + readResource(":/cullMeshlets.comp"));
+    sumProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Compute, version + "#define SUM\n" + readResource(":/vertexNormals.comp"));
+    normalizeProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Compute, version + readResource(":/vertexNormals.comp"));
+    subdivideProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Compute, version + readResource(":/subdivide.comp"));
+    if (!cullProgram.link() || !sumProgram.link() || !normalizeProgram.link() || !subdivideProgram.link())
+    {
+        releaseGL();
+        return;
+    }
+
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    gl->glCreateBuffers(1, &countBuffer);
+    gl->glNamedBufferStorage(countBuffer, 2 * sizeof(GLuint), NULL, 0);
+    gl->glCreateBuffers(1, &readbackBuffer);
+    gl->glNamedBufferStorage(readbackBuffer, 2 * sizeof(GLuint), NULL, flags);
+    readback = (const GLuint *)gl->glMapNamedBufferRange(readbackBuffer, 0, 2 * sizeof(GLuint), flags);
+
+    QOpenGLContext * context = QOpenGLContext::currentContext();
+    if (context->hasExtension("GL_ARB_indirect_parameters"))
+        multiDrawCount = (MultiDrawCount)context->getProcAddress("glMultiDrawElementsIndirectCountARB");
+}
+
+void MeshCompute::releaseGL()
+{
+    if (!gl) return;
+    setMeshlets(MeshLib::CMeshlets(), QVector<RenderMesh::LodLevel>());
+    setStencils(std::vector<uint32_t>(), std::vector<uint32_t>(), std::vector<float>());
+    if (fence) gl->glDeleteSync(fence);
+    if (readbackBuffer) gl->glUnmapNamedBuffer(readbackBuffer);
+    gl->glDeleteBuffers(1, &readbackBuffer);
+    gl->glDeleteBuffers(1, &countBuffer);
+    gl->glDeleteBuffers(1, &sumBuffer);
+    cullProgram.removeAllShaders();
+    sumProgram.removeAllShaders();
+    normalizeProgram.removeAllShaders();
+    subdivideProgram.removeAllShaders();
+    fence = 0;
+    readbackBuffer = countBuffer = sumBuffer = 0;
+    readback = NULL;
+    sumCapacity = 0;
+    multiDrawCount = NULL;
+    gl = NULL;
+}
+
+void MeshCompute::setMeshlets(const MeshLib::CMeshlets & meshlets, const QVector<RenderMesh::LodLevel> & levels)
+{
+    if (!gl) return;
+    gl->glDeleteBuffers(1, &meshletBuffer);
+    gl->glDeleteBuffers(1, &levelBuffer);
+    gl->glDeleteBuffers(1, &commandBuffer);
+    meshletBuffer = levelBuffer = commandBuffer = 0;
+    meshletCount = levelCount = 0;
+    if (levels.isEmpty() || meshlets.size() == 0) return;
+
+    std::vector<PackedMeshlet> packed;
+    std::vector<GLfloat> errors;
+    for (int l = 0; l < levels.size(); l++)
+    {
+        const RenderMesh::LodLevel & level = levels[l];
+        errors.push_back(level.error);
+        for (int i = level.firstMeshlet; i < level.firstMeshlet + level.meshletCount; i++)
+        {
+            PackedMeshlet m;
+            meshlets.bounds(i, m.sphere, m.cone);
+            m.first = meshlets.first(i);
+            m.count = meshlets.count(i);
+            m.level = (GLuint)l;
+            m.pad = 0;
+            packed.push_back(m);
+        }
+    }
+    if (packed.empty()) return;
+    meshletCount = (int)packed.size();
+    levelCount = levels.size();
+    gl->glCreateBuffers(1, &meshletBuffer);
+    gl->glNamedBufferStorage(meshletBuffer, packed.size() * sizeof(PackedMeshlet), packed.data(), 0);
+    gl->glCreateBuffers(1, &levelBuffer);
+    gl->glNamedBufferStorage(levelBuffer, errors.size() * sizeof(GLfloat), errors.data(), 0);
+    gl->glCreateBuffers(1, &commandBuffer);
+    gl->glNamedBufferStorage(commandBuffer, meshletCount * 5 * sizeof(GLuint), NULL, 0);
+}
+
+void MeshCompute::dispatch(int count)
+{
+    const int groups = (count + 63) / 64;
+    const int columns = std::min(groups, 65535);
+    gl->glDispatchCompute((GLuint)columns, (GLuint)((groups + columns - 1) / columns), 1);
+}
+
+void MeshCompute::cull(const QMatrix4x4 & mvp, const QVector3D & eye, float errorScale, float pixelError)
+{
+    if (!culling()) return;
+    // without the count parameter every command is drawn, those past the visible ones empty
+    if (!multiDrawCount) gl->glClearNamedBufferData(commandBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    gl->glClearNamedBufferData(countBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    // the frustum planes, from the rows of the matrix, with unit normals
+    QVector4D planes[6];
+    for (int i = 0; i < 3; i++)
+    {
+        for (int s = 0; s < 2; s++)
+        {
+            QVector4D p = mvp.row(3) + (s ? -1 : 1) * mvp.row(i);
+            const float l = p.toVector3D().length();
+            planes[2 * i + s] = l > 0 ? p / l : QVector4D();
+        }
+    }
+
+    cullProgram.bind();
+    cullProgram.setUniformValue("meshletCount", (GLuint)meshletCount);
+    cullProgram.setUniformValue("levelCount", (GLuint)levelCount);
+    cullProgram.setUniformValueArray("planes", planes, 6);
+    cullProgram.setUniformValue("eye", eye);
+    cullProgram.setUniformValue("errorScale", errorScale);
+    cullProgram.setUniformValue("pixelError", pixelError);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshletBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, levelBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, countBuffer);
+    dispatch(meshletCount);
+    for (GLuint b = 0; b < 4; b++) gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, 0);
+    cullProgram.release();
+    gl->glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // the counts of one cull at a time are read back, for the render counters
+    if (!fence)
+    {
+        gl->glCopyNamedBufferSubData(countBuffer, readbackBuffer, 0, 0, 2 * sizeof(GLuint));
+        fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+void MeshCompute::draw()
+{
+    if (!culling()) return;
+    gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (multiDrawCount)
+    {
+        gl->glBindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+        multiDrawCount(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, 0, meshletCount, 0);
+        gl->glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    }
+    else gl->glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, meshletCount, 0);
+    gl->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void MeshCompute::drawn(size_t & triangles, int & meshlets)
+{
+    if (fence && gl->glClientWaitSync(fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+    {
+        gl->glDeleteSync(fence);
+        fence = 0;
+        drawnMeshlets = (int)readback[0];
+        drawnTriangles = readback[1];
+    }
+    triangles = drawnTriangles;
+    meshlets = drawnMeshlets;
+}
+
+void MeshCompute::computeNormals(GLuint positions, GLuint indices, GLuint normals, int vertexCount, int triangleCount)
+{
+    if (!gl || vertexCount <= 0) return;
+    const int size = 3 * vertexCount * (int)sizeof(GLfloat);
+    if (size > sumCapacity)
+    {
+        gl->glDeleteBuffers(1, &sumBuffer);
+        gl->glCreateBuffers(1, &sumBuffer);
+        gl->glNamedBufferStorage(sumBuffer, size, NULL, 0);
+        sumCapacity = size;
+    }
+    // the bits of 0.0f are 0
+    gl->glClearNamedBufferSubData(sumBuffer, GL_R32UI, 0, size, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, indices);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sumBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, normals);
+
+    sumProgram.bind();
+    sumProgram.setUniformValue("count", (GLuint)triangleCount);
+    dispatch(triangleCount);
+    gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    normalizeProgram.bind();
+    normalizeProgram.setUniformValue("count", (GLuint)vertexCount);
+    dispatch(vertexCount);
+    normalizeProgram.release();
+
+    for (GLuint b = 0; b < 4; b++) gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, 0);
+    gl->glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void MeshCompute::setStencils(const std::vector<uint32_t> & offsets, const std::vector<uint32_t> & columns, const std::vector<float> & weights)
+{
+    if (!gl) return;
+    gl->glDeleteBuffers(1, &offsetBuffer);
+    gl->glDeleteBuffers(1, &columnBuffer);
+    gl->glDeleteBuffers(1, &weightBuffer);
+    offsetBuffer = columnBuffer = weightBuffer = 0;
+    stencilCount = 0;
+    if (offsets.size() < 2 || columns.empty() || columns.size() != weights.size()) return;
+    stencilCount = (int)offsets.size() - 1;
+    gl->glCreateBuffers(1, &offsetBuffer);
+    gl->glNamedBufferStorage(offsetBuffer, offsets.size() * sizeof(uint32_t), offsets.data(), 0);
+    gl->glCreateBuffers(1, &columnBuffer);
+    gl->glNamedBufferStorage(columnBuffer, columns.size() * sizeof(uint32_t), columns.data(), 0);
+    gl->glCreateBuffers(1, &weightBuffer);
+    gl->glNamedBufferStorage(weightBuffer, weights.size() * sizeof(float), weights.data(), 0);
+}
+
+void MeshCompute::subdivide(GLuint base, GLuint refined, int components)
+{
+    if (!gl || stencilCount <= 0) return;
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, offsetBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, columnBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, weightBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, base);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, refined);
+    subdivideProgram.bind();
+    subdivideProgram.setUniformValue("count", (GLuint)stencilCount);
+    subdivideProgram.setUniformValue("components", (GLuint)components);
+    dispatch(stencilCount);
+    subdivideProgram.release();
+    for (GLuint b = 0; b < 5; b++) gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, 0);
+    // read next as vertices, or as the positions of computeNormals
+    gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
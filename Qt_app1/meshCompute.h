@@ -0,0 +1,89 @@
+#ifndef MESHCOMPUTE_H
+#define MESHCOMPUTE_H
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+#include <vector>
+#include <cstdint>
+#include "renderMesh.h"
+
+/*! the per-frame work of the core backend in compute shaders. the meshlets of every level of
+    detail are culled and the level is picked on the GPU, writing the commands of one
+    glMultiDrawElementsIndirect, see cullMeshlets.comp, and the normals of an edited mesh are
+    summed from its triangles there instead of around every edit on the CPU, see
+    vertexNormals.comp, as are the points of its subdivided surface, see subdivide.comp. needs
+    OpenGL 4.5, the calls do nothing until initializeGL */
+class MeshCompute
+{
+public:
+    /*! build the programs with the context current, unavailable if they do not link */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    bool available() const { return gl != NULL; }
+
+    /*! the bounds of the meshlets of levels for cull, none drops them */
+    void setMeshlets(const MeshLib::CMeshlets & meshlets, const QVector<RenderMesh::LodLevel> & levels);
+    /*! whether there are meshlets to cull */
+    bool culling() const { return gl && meshletCount > 0; }
+    /*! a command for every meshlet of the coarsest level whose error times errorScale is at most
+        pixelError, in the frustum of mvp and facing eye, in the coordinates mvp takes */
+    void cull(const QMatrix4x4 & mvp, const QVector3D & eye, float errorScale, float pixelError);
+    /*! draw the commands of the last cull, the vertex array and the index buffer bound */
+    void draw();
+    /*! the triangles and meshlets of the latest cull read back, a frame or more old */
+    void drawn(size_t & triangles, int & meshlets);
+
+    /*! the unit normals of vertexCount float positions, the sums of the cross products of
+        triangleCount triangles of indices, into normals */
+    void computeNormals(GLuint positions, GLuint indices, GLuint normals, int vertexCount, int triangleCount);
+
+    /*! the stencil table of MeshLib::CSubdivision for subdivide, a row per refined vertex of the columns
+        of base vertices and their weights, as outer, inner and weights lay it out. none drops it */
+    void setStencils(const std::vector<uint32_t> & offsets, const std::vector<uint32_t> & columns, const std::vector<float> & weights);
+    /*! the rows of the stencils over components floats per vertex, 2 or 3, of base into refined */
+    void subdivide(GLuint base, GLuint refined, int components);
+    /*! the rows of the stencils, the refined vertices */
+    int stencilRows() const { return stencilCount; }
+
+private:
+    /*! run the bound program over count items, in rows of groups past the limit of one dimension */
+    void dispatch(int count);
+
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    QOpenGLShaderProgram cullProgram;
+    QOpenGLShaderProgram sumProgram;
+    QOpenGLShaderProgram normalizeProgram;
+    QOpenGLShaderProgram subdivideProgram;
+    //! the bounds of the meshlets and the level of each, and the errors of the levels
+    GLuint meshletBuffer = 0;
+    GLuint levelBuffer = 0;
+    int meshletCount = 0;
+    int levelCount = 0;
+    //! a DrawElementsIndirectCommand per meshlet, the visible ones first, zero past them
+    GLuint commandBuffer = 0;
+    //! the number of visible meshlets, the draw count, and their triangles
+    GLuint countBuffer = 0;
+    //! the counts copied for drawn, persistently mapped, read when the fence of the copy has passed
+    GLuint readbackBuffer = 0;
+    const GLuint * readback = NULL;
+    GLsync fence = 0;
+    size_t drawnTriangles = 0;
+    int drawnMeshlets = 0;
+    //! the sums of computeNormals, grown as needed
+    GLuint sumBuffer = 0;
+    int sumCapacity = 0;
+    //! the rows of the stencils, their columns and their weights, written once per connectivity
+    GLuint offsetBuffer = 0;
+    GLuint columnBuffer = 0;
+    GLuint weightBuffer = 0;
+    int stencilCount = 0;
+    //! glMultiDrawElementsIndirectCountARB, drawing only the visible commands, NULL without
+    //! GL_ARB_indirect_parameters
+    typedef void (QOPENGLF_APIENTRYP MultiDrawCount)(GLenum, GLenum, const void *, GLintptr, GLsizei, GLsizei);
+    MultiDrawCount multiDrawCount = NULL;
+};
+
+#endif // MESHCOMPUTE_H
@@ -0,0 +1,161 @@
+#include "meshLoader.h"
+#include "parser/objparser.h"
+#include "startupProfiler.h"
+#include "materialAtlas.h"
+#include <cfloat>
+
+MeshLoader::MeshLoader(ViewerMesh * mesh, std::string fname, QObject *parent)
+    : QThread(parent), vMesh(mesh), meshfile(fname)
+{
+    qRegisterMetaType<MeshBatch>("MeshBatch");
+}
+
+void MeshLoader::render(RenderQueue * q, const RenderMesh::Options & o)
+{
+    queue = q;
+    options = o;
+}
+
+void MeshLoader::cancel()
+{
+    requestInterruption();
+    job.cancel();
+}
+
+void MeshLoader::finish(int ret)
+{
+    // the GUI thread only uploads what is laid out here
+    if (ret == 0 && queue && !isInterruptionRequested())
+    {
+        StartupProfiler & startup = StartupProfiler::instance();
+        const qint64 start = startup.now();
+        RenderMesh * prepared = new RenderMesh();
+        prepared->prepare(vMesh, options);
+        startup.record("expand", start);
+        queue->push(prepared);
+    }
+    emit meshLoaded(ret);
+}
+
+void MeshLoader::run()
+{
+    MESHLIB_TRACE_THREAD("mesh loader");
+    MESHLIB_TRACE_ZONE("load mesh");
+    // the parser and the builder check the job on the way, their tasks are queued for it
+    MeshLib::CJobScope scope(&job);
+    // volume meshes have no preview, only their boundary is shown
+    if (ViewerMesh::is_tet_file(meshfile))
+    {
+        finish(vMesh->input_tet(meshfile));
+        return;
+    }
+
+    // the cache and the binary formats load faster than any preview could be shown
+    if (ViewerMesh::is_model_file(meshfile) || vMesh->has_fresh_cache(meshfile))
+    {
+        finish(vMesh->input_obj(meshfile));
+        return;
+    }
+
+    // a fetched or gzip file is parsed as its bytes arrive
+    StartupProfiler & startup = StartupProfiler::instance();
+    qint64 start = startup.now();
+    MeshLib::CMappedFile file;
+    const bool opened = file.open(meshfile, MeshLib::CMappedFile::default_mode(), false);
+    startup.record("open", start);
+    if (!opened)
+    {
+        finish(3);
+        return;
+    }
+
+    // running centroid and bounding box of the points parsed so far
+    CPoint sum(0, 0, 0);
+    CPoint lo(DBL_MAX, DBL_MAX, DBL_MAX), hi(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+    size_t counted = 0;
+
+    // the preview moves the uvs into the atlas of the materials as the mesh will, see
+    // ViewerMesh::input_obj_data, the material runs are followed from batch to batch
+    MaterialAtlas atlas;
+    if (atlas.read(meshfile) && !atlas.tiled()) atlas = MaterialAtlas();
+    std::vector<int> toAtlas;
+    size_t run = 0;
+
+    MeshLib::CObjData obj;
+    start = startup.now();
+    bool done = MeshLib::CObjParser::parse_progressive(file, obj,
+        [&](const MeshLib::CObjData & data, int first)
+    {
+        for (; counted < data.points.size(); counted++)
+        {
+            const CPoint & p = data.points[counted];
+            sum += p;
+            for (int i = 0; i < 3; i++)
+            {
+                lo[i] = std::min(lo[i], p[i]);
+                hi[i] = std::max(hi[i], p[i]);
+            }
+        }
+
+        for (size_t m = toAtlas.size(); m < data.materials.size(); m++) toAtlas.push_back(atlas.find(data.materials[m]));
+
+        MeshBatch batch;
+        std::vector<int> local;
+        for (int f = first; f < data.num_faces(); f++)
+        {
+            while (run + 1 < data.material_runs.size() && data.material_runs[run + 1].face <= f) run++;
+            const int material = run < data.material_runs.size() && data.material_runs[run].face <= f ?
+                toAtlas[data.material_runs[run].material] : -1;
+            int fb = data.face_offsets[f];
+            int n = data.face_offsets[f + 1] - fb;
+            // faces referring to points further down the file wait for the full mesh
+            bool ready = n >= 3;
+            for (int k = 0; k < n && ready; k++)
+            {
+                int v = data.corners[fb + k].v;
+                ready = v >= 0 && v < (int)data.points.size();
+            }
+            if (!ready) continue;
+
+            local.clear();
+            vMesh->triangulate(data, f, local);
+            for (int k : local)
+            {
+                const MeshLib::CObjCorner & cr = data.corners[fb + k];
+                const CPoint & p = data.points[cr.v];
+                batch.positions.push_back(QVector3D(p[0], p[1], p[2]));
+                QVector2D uv;
+                if (cr.t >= 0 && cr.t < (int)data.uvs.size())
+                {
+                    const CPoint2 t = material < 0 ? data.uvs[cr.t] : atlas.place(material, data.uvs[cr.t]);
+                    uv = QVector2D(t[0], t[1]);
+                }
+                batch.uvs.push_back(uv);
+            }
+        }
+
+        if (counted > 0)
+        {
+            CPoint c = sum / (double)counted;
+            CPoint d = hi - lo;
+            double diff = std::max(d[0], std::max(d[1], d[2]));
+            batch.center = QVector3D(c[0], c[1], c[2]);
+            batch.scale = diff > EPS ? 2 / diff : 1;
+        }
+        if (!batch.positions.isEmpty()) emit batchReady(batch);
+        return !isInterruptionRequested();
+    }, batch_size);
+    // the preview batches are made on the way
+    startup.record("parse", start);
+    const bool failed = file.failed();
+    file.close();
+
+    // concatenated gzip members cannot be sized up front to stream, they are read whole
+    if (failed)
+    {
+        finish(vMesh->input_obj(meshfile));
+        return;
+    }
+    if (!done) return;
+    finish(vMesh->input_obj_data(obj, meshfile));
+}
@@ -0,0 +1,64 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <QThread>
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <QMetaType>
+#include "viewerMesh.h"
+#include "renderMesh.h"
+#include "parser/parallel.h"
+
+/*! triangles parsed since the previous batch, in file coordinates, with the
+    normalization of everything parsed so far */
+struct MeshBatch
+{
+    QVector<QVector3D> positions;
+    QVector<QVector2D> uvs;
+    QVector3D center;
+    float scale = 1;
+};
+Q_DECLARE_METATYPE(MeshBatch)
+
+/*! reads an .obj file on a background thread. the triangles are emitted in
+    batches while the file is parsed, then the mesh is built into vMesh and, with
+    render, laid out for the buffers on the same thread. the bytes arrive and are
+    parsed a few batches ahead on a thread of their own, see
+    MeshLib::CObjParser::parse_progressive, so reading, parsing and the preview
+    overlap. the work runs as a job of the visible priority, its tasks go before those of
+    prefetches and batches on the shared pool. cancel stops the parse at the next batch, or the
+    build at its next check, the mesh is left unbuilt or part built then */
+class MeshLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    MeshLoader(ViewerMesh * mesh, std::string fname, QObject *parent = 0);
+
+    /*! bytes of the file parsed per batch */
+    size_t batch_size = 4 << 20;
+    /*! push vMesh laid out with options to queue before meshLoaded, call it before start */
+    void render(RenderQueue * queue, const RenderMesh::Options & options);
+    /*! stop the load, from any thread, wait() for it to end */
+    void cancel();
+
+signals:
+    void batchReady(const MeshBatch &batch);
+    /*! vMesh is complete, ret is the return code of ViewerMesh::input_obj */
+    void meshLoaded(int ret);
+
+protected:
+    void run();
+    /*! lay out vMesh if it was read, then emit meshLoaded */
+    void finish(int ret);
+
+private:
+    ViewerMesh * vMesh;
+    std::string meshfile;
+    RenderQueue * queue = NULL;
+    RenderMesh::Options options;
+    MeshLib::CJob job;
+};
+
+#endif // MESHLOADER_H
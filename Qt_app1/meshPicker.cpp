@@ -0,0 +1,90 @@
+#include "meshPicker.h"
+
+void MeshPicker::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    if (!gl) return;
+    gl->glCreateTextures(GL_TEXTURE_2D, 1, &idTexture);
+    gl->glTextureStorage2D(idTexture, 1, GL_R32UI, 1, 1);
+    gl->glCreateRenderbuffers(1, &depth);
+    gl->glNamedRenderbufferStorage(depth, GL_DEPTH_COMPONENT24, 1, 1);
+    gl->glCreateFramebuffers(1, &framebuffer);
+    gl->glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, idTexture, 0);
+    gl->glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    gl->glCreateBuffers(1, &readbackBuffer);
+    gl->glNamedBufferStorage(readbackBuffer, sizeof(uint32_t), NULL, flags);
+    readback = (const uint32_t *)gl->glMapNamedBufferRange(readbackBuffer, 0, sizeof(uint32_t), flags);
+}
+
+void MeshPicker::releaseGL()
+{
+    if (!gl) return;
+    if (fence) gl->glDeleteSync(fence);
+    if (readbackBuffer) gl->glUnmapNamedBuffer(readbackBuffer);
+    gl->glDeleteBuffers(1, &readbackBuffer);
+    gl->glDeleteFramebuffers(1, &framebuffer);
+    gl->glDeleteTextures(1, &idTexture);
+    gl->glDeleteRenderbuffers(1, &depth);
+    fence = 0;
+    readbackBuffer = framebuffer = idTexture = depth = 0;
+    readback = NULL;
+    pending = false;
+    gl = NULL;
+}
+
+void MeshPicker::request(int x, int y, int width, int height)
+{
+    // a newer click replaces one that has not been drawn yet
+    pixelX = x;
+    pixelY = y;
+    viewWidth = width;
+    viewHeight = height;
+    pending = true;
+}
+
+QMatrix4x4 MeshPicker::pickMatrix() const
+{
+    // the pixel, 2 / width wide in normalized device coordinates, scaled onto [-1, 1]
+    const float cx = 2 * (pixelX + 0.5f) / viewWidth - 1;
+    const float cy = 2 * (pixelY + 0.5f) / viewHeight - 1;
+    QMatrix4x4 m;
+    m.scale(viewWidth, viewHeight, 1);
+    m.translate(-cx, -cy, 0);
+    return m;
+}
+
+void MeshPicker::begin()
+{
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl->glViewport(0, 0, 1, 1);
+    const GLuint none[4] = { 0, 0, 0, 0 };
+    const GLfloat farthest = 1;
+    gl->glClearNamedFramebufferuiv(framebuffer, GL_COLOR, 0, none);
+    gl->glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &farthest);
+}
+
+void MeshPicker::end(GLuint target, int width, int height)
+{
+    // into the mapped buffer, read once the fence has passed
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+    gl->glReadPixels(0, 0, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (fence) gl->glDeleteSync(fence);
+    fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pending = false;
+
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, target);
+    gl->glViewport(0, 0, width, height);
+}
+
+bool MeshPicker::result(uint32_t & id)
+{
+    if (!fence) return false;
+    if (gl->glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+    gl->glDeleteSync(fence);
+    fence = 0;
+    id = *readback;
+    return true;
+}
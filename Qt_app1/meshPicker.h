@@ -0,0 +1,58 @@
+#ifndef MESHPICKER_H
+#define MESHPICKER_H
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QMatrix4x4>
+#include <cstdint>
+
+/*! what a pixel shows, from an ID pass drawn on demand. the pass renders
+    only the asked pixel into a 1x1 integer target, the projection zoomed
+    onto it, and reads it back through a mapped buffer a frame or more
+    later, so the cost does not grow with the viewport. needs OpenGL 4.5,
+    the calls do nothing until initializeGL. */
+class MeshPicker
+{
+public:
+    /*! create the target with the context current */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    bool available() const { return gl != NULL; }
+
+    /*! ask for pixel x, y of a width x height viewport, in device pixels from the bottom left */
+    void request(int x, int y, int width, int height);
+    void cancel() { pending = false; }
+    /*! a request waits for its pass */
+    bool wanted() const { return gl && pending; }
+    /*! a pass is drawn and not read back yet */
+    bool busy() const { return fence != 0; }
+
+    /*! the projection onto the asked pixel, to be applied after the mvp matrix */
+    QMatrix4x4 pickMatrix() const;
+    /*! bind and clear the target */
+    void begin();
+    /*! start the readback, then draw to target again with a width x height viewport */
+    void end(GLuint target, int width, int height);
+    /*! false while the readback runs, then the value written by pickShader.fsh, 0 where nothing was drawn */
+    bool result(uint32_t & id);
+
+    /*! the pixel of the last request */
+    int x() const { return pixelX; }
+    int y() const { return pixelY; }
+
+private:
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    GLuint framebuffer = 0;
+    GLuint idTexture = 0;
+    GLuint depth = 0;
+    //! persistently mapped, read when the fence of its glReadPixels has passed
+    GLuint readbackBuffer = 0;
+    const uint32_t * readback = NULL;
+    GLsync fence = 0;
+    bool pending = false;
+    int pixelX = 0;
+    int pixelY = 0;
+    int viewWidth = 1;
+    int viewHeight = 1;
+};
+
+#endif // MESHPICKER_H
@@ -0,0 +1,39 @@
+#ifndef MESHRENDERER_H
+#define MESHRENDERER_H
+
+#include <QImage>
+#include <vector>
+#include <string>
+
+/*! a backend that draws a mesh and its texture from a camera without a window, all that
+    BatchRenderer and CameraPath ask of the renderer. GlWidget is the OpenGL one. the calls come
+    from the thread that made the backend */
+class MeshRenderer
+{
+public:
+    //! a camera of the orbit, as the mouse sets it in GlWidget
+    struct Camera { double alpha; double beta; double distance; };
+    //! the times of a frame in milliseconds, the GPU one 0 where it was not measured
+    struct FrameTime { double cpu; double gpu; };
+
+    virtual ~MeshRenderer() {}
+
+    /*! draw views of width x height pixels off screen, the device is made with the first mesh */
+    virtual void startOffscreen(int width, int height) = 0;
+    /*! read the mesh on this thread and upload it in place of the last one, false if it cannot be read */
+    virtual bool uploadMesh(const std::string & fname) = 0;
+    /*! whether the device exists, once a mesh was uploaded */
+    virtual bool deviceReady() const = 0;
+    /*! decode and upload the texture on this thread, an empty name takes the maps of the materials
+        of the mesh or drops the texture, false if it cannot be read */
+    virtual bool uploadTexture(const std::string & fname) = 0;
+    /*! draw the mesh from camera into an image */
+    virtual QImage drawView(const Camera & camera) = 0;
+    /*! time the frames drawn from now on */
+    virtual void startTiming() = 0;
+    /*! the times of the frames drawn since startTiming, in their order, a frame whose times did
+        not come back has none. false if the GPU was not timed */
+    virtual bool stopTiming(std::vector<FrameTime> & frames) = 0;
+};
+
+#endif // MESHRENDERER_H
@@ -0,0 +1,235 @@
+#include "meshSequence.h"
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <sys/stat.h>
+#include "parser/objparser.h"
+#include "parser/mmap.h"
+#include "parser/parallel.h"
+#include "parser/counters.h"
+#include "parser/trace.h"
+
+//! the header of name.seq, the points of the frames follow it, frame after frame
+struct SequenceHeader
+{
+    char magic[4] = { 'M', 'S', 'E', 'Q' };
+    uint32_t version = 1;
+    uint64_t frames = 0;
+    uint64_t points = 0;
+};
+
+// the start and length of the last run of digits of the name of fname, after its directory
+static bool last_digits(const std::string & fname, size_t & start, size_t & count)
+{
+    const size_t sep = fname.find_last_of("/\\");
+    const size_t name = sep == std::string::npos ? 0 : sep + 1;
+    size_t end = fname.size();
+    while (end > name && !isdigit((unsigned char)fname[end - 1])) end--;
+    start = end;
+    while (start > name && isdigit((unsigned char)fname[start - 1])) start--;
+    count = end - start;
+    return count > 0;
+}
+
+// frame_0001.obj -> frame_.seq, the name without the number of the frame and the extension
+static std::string cache_name(const std::string & first)
+{
+    size_t start, count;
+    if (!last_digits(first, start, count)) return first + ".seq";
+    std::string name = first.substr(0, start) + first.substr(start + count);
+    const size_t dot = name.find_last_of('.'), sep = name.find_last_of("/\\");
+    if (dot != std::string::npos && (sep == std::string::npos || dot > sep)) name.resize(dot);
+    return name + ".seq";
+}
+
+std::vector<std::string> MeshSequence::frames(const std::string & fname)
+{
+    std::vector<std::string> files;
+    size_t start, count;
+    if (!last_digits(fname, start, count)) return files;
+    const std::string prefix = fname.substr(0, start), suffix = fname.substr(start + count);
+    const QFileInfo info(QString::fromStdString(fname));
+    // the names of the directory, joined to it as fname is
+    const std::string dir = fname.substr(0, fname.size() - info.fileName().toStdString().size());
+    std::vector<std::pair<long long, std::string>> numbered;
+    for (const QFileInfo & entry : info.dir().entryInfoList(QDir::Files))
+    {
+        const std::string path = dir + entry.fileName().toStdString();
+        size_t s, c;
+        if (!last_digits(path, s, c) || s != prefix.size() || s + c + suffix.size() != path.size() ||
+            path.compare(0, prefix.size(), prefix) != 0 || path.compare(s + c, suffix.size(), suffix) != 0) continue;
+        numbered.push_back(std::make_pair(atoll(path.substr(s, c).c_str()), path));
+    }
+    std::sort(numbered.begin(), numbered.end());
+    for (const std::pair<long long, std::string> & n : numbered) files.push_back(n.second);
+    return files;
+}
+
+MeshSequence::MeshSequence(const std::vector<std::string> & f, const std::vector<int> & s, size_t count,
+                           const std::vector<uint32_t> & t, bool normals, int ahead, QObject * parent)
+    : QThread(parent), files(f), slots(s), slotCount(count), triangles(t), withNormals(normals),
+      decoded((size_t)std::max(1, ahead))
+{
+    if (!files.empty()) cacheFile = cache_name(files[0]);
+}
+
+MeshSequence::~MeshSequence()
+{
+    stop();
+}
+
+void MeshSequence::stop()
+{
+    requestInterruption();
+    job.cancel();
+    decoded.cancel();
+    wait();
+}
+
+bool MeshSequence::readPoints(int f, std::vector<float> & points)
+{
+    MeshLib::CObjData obj;
+    if (!MeshLib::CObjParser::parse_file(files[f], obj) || obj.points.size() < slots.size()) return false;
+    points.resize(3 * slots.size());
+    MeshLib::parallel_for(slots.size(), 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+            for (int d = 0; d < 3; d++) points[3 * i + d] = (float)obj.points[i][d];
+    });
+    return true;
+}
+
+void MeshSequence::scatter(const std::vector<float> & points, Frame & frame) const
+{
+    frame.positions.assign(3 * slotCount, 0.0f);
+    MeshLib::parallel_for(slots.size(), 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            if (slots[i] < 0) continue;
+            for (int d = 0; d < 3; d++) frame.positions[3 * slots[i] + d] = points[3 * i + d];
+        }
+    });
+    frame.normals.clear();
+    if (!withNormals) return;
+
+    // summed over the triangles around every slot, weighted by their areas, as GlWidget::expandSlots does
+    frame.normals.assign(3 * slotCount, 0.0f);
+    const float * p = frame.positions.data();
+    float * n = frame.normals.data();
+    for (size_t t = 0; t + 2 < triangles.size(); t += 3)
+    {
+        const float * a = p + 3 * triangles[t], * b = p + 3 * triangles[t + 1], * c = p + 3 * triangles[t + 2];
+        const float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] }, v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        const float w[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+        for (int k = 0; k < 3; k++)
+            for (int d = 0; d < 3; d++) n[3 * triangles[t + k] + d] += w[d];
+    }
+    MeshLib::parallel_for(slotCount, 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            const float l = std::sqrt(n[3 * i] * n[3 * i] + n[3 * i + 1] * n[3 * i + 1] + n[3 * i + 2] * n[3 * i + 2]);
+            if (l > 0) for (int d = 0; d < 3; d++) n[3 * i + d] /= l;
+        }
+    });
+}
+
+void MeshSequence::run()
+{
+    MESHLIB_TRACE_THREAD("sequence decoder");
+    if (files.empty()) return;
+    MeshLib::CJobScope scope(&job);
+
+    // the cache is fresh if it is not older than any frame
+    struct stat cst, fst;
+    bool fresh = stat(cacheFile.c_str(), &cst) == 0;
+    for (size_t f = 0; f < files.size() && fresh; f++) fresh = stat(files[f].c_str(), &fst) == 0 && cst.st_mtime >= fst.st_mtime;
+    MeshLib::CMappedFile cache;
+    SequenceHeader header;
+    header.frames = files.size();
+    header.points = slots.size();
+    const size_t frameBytes = 3 * sizeof(float) * slots.size();
+    if (fresh && cache.open(cacheFile))
+    {
+        SequenceHeader h;
+        if (cache.size() >= sizeof(h)) memcpy(&h, cache.begin(), sizeof(h));
+        if (memcmp(h.magic, header.magic, 4) != 0 || h.version != header.version || h.frames != header.frames ||
+            h.points != header.points || cache.size() < sizeof(h) + h.frames * frameBytes) cache.close();
+    }
+
+    // the first pass writes the cache, renamed into place once every frame is in it
+    const std::string tmp = cacheFile + ".tmp";
+    FILE * writing = NULL;
+    if (!cache.is_open())
+    {
+        writing = fopen(tmp.c_str(), "wb");
+        if (writing && fwrite(&header, sizeof(header), 1, writing) != 1)
+        {
+            fclose(writing);
+            writing = NULL;
+        }
+    }
+
+    std::vector<float> points;
+    int failed = 0;
+    for (int f = 0; !isInterruptionRequested(); f = (f + 1) % frameCount())
+    {
+        MESHLIB_TRACE_ZONE("decode frame");
+        if (cache.is_open())
+        {
+            const float * p = (const float *)(cache.begin() + sizeof(SequenceHeader) + f * frameBytes);
+            points.assign(p, p + 3 * slots.size());
+        }
+        else if (!readPoints(f, points))
+        {
+            // a parse cut short by stop
+            if (isInterruptionRequested()) break;
+            // a frame that cannot be read is skipped, and the sequence is not cached
+            std::cout << "Cannot read the frame " << files[f] << ", or it has other points" << std::endl;
+            if (writing)
+            {
+                fclose(writing);
+                writing = NULL;
+                remove(tmp.c_str());
+            }
+            if (++failed == frameCount()) return;
+            continue;
+        }
+        else if (writing)
+        {
+            bool ok = fwrite(points.data(), 1, frameBytes, writing) == frameBytes;
+            if (ok && f + 1 == frameCount())
+            {
+                ok = fclose(writing) == 0;
+                writing = NULL;
+                ok = ok && (remove(cacheFile.c_str()), rename(tmp.c_str(), cacheFile.c_str()) == 0);
+                // the later passes read the cache
+                if (ok) cache.open(cacheFile);
+            }
+            if (!ok)
+            {
+                if (writing) fclose(writing);
+                writing = NULL;
+                remove(tmp.c_str());
+            }
+        }
+        failed = 0;
+
+        Frame frame;
+        frame.index = f;
+        scatter(points, frame);
+        MESHLIB_COUNTER_ADD("sequence.frames_decoded", 1);
+        if (!decoded.push(std::move(frame))) break;
+    }
+    if (writing)
+    {
+        fclose(writing);
+        remove(tmp.c_str());
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef MESHSEQUENCE_H
+#define MESHSEQUENCE_H
+
+#include <QThread>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "parser/pipeline.h"
+#include "parser/parallel.h"
+
+/*! the frames of an animated mesh, .obj files of one topology whose points move, decoded on a
+    background thread a few frames ahead of the one drawn. the connectivity is built once from the
+    first frame and only the points of the frames are read, into the vertex slots of the mesh, with
+    the normals summed over its triangles when lit. the first pass parses the files and writes their
+    points to name.seq next to the first frame, 12 bytes a point and frame, which the later passes and
+    runs map instead while it is not older than any frame. playback loops. the decoding is a
+    prefetch job, the pool runs it when nothing visible waits, and stop cancels it in the parse */
+class MeshSequence : public QThread
+{
+public:
+    /*! the points of a frame by vertex slot, normals only when lit */
+    struct Frame
+    {
+        int index = 0;
+        std::vector<float> positions;
+        std::vector<float> normals;
+    };
+
+    /*! the files of the sequence fname is one of: those of its directory whose names differ from
+        it only in the last run of digits, in the order of that number, none without digits */
+    static std::vector<std::string> frames(const std::string & fname);
+
+    /*! slots[i] is the vertex slot of point i of a frame, -1 for none, triangles the vertex slots of
+        the corners, to sum the normals, ahead the frames decoded ahead. the
+        slots are those of the first frame, ids one past the index of their point */
+    MeshSequence(const std::vector<std::string> & files, const std::vector<int> & slots, size_t slotCount,
+                 const std::vector<uint32_t> & triangles, bool normals, int ahead, QObject * parent = 0);
+    /*! stops the thread */
+    ~MeshSequence();
+
+    int frameCount() const { return (int)files.size(); }
+    /*! the next decoded frame, false if it is not there yet */
+    bool next(Frame & frame) { return decoded.try_pop(frame); }
+    /*! stop decoding and wait for the thread */
+    void stop();
+
+protected:
+    void run();
+    /*! the first slots.size() points of frame f in the order of the file, false if the file
+        cannot be read or has fewer */
+    bool readPoints(int f, std::vector<float> & points);
+    /*! points in the order of the file into frame, by slot, and its normals */
+    void scatter(const std::vector<float> & points, Frame & frame) const;
+
+private:
+    std::vector<std::string> files;
+    std::vector<int> slots;
+    size_t slotCount;
+    std::vector<uint32_t> triangles;
+    bool withNormals;
+    MeshLib::CBoundedQueue<Frame> decoded;
+    std::string cacheFile;
+    MeshLib::CJob job{ MeshLib::PRIORITY_PREFETCH };
+};
+
+#endif // MESHSEQUENCE_H
@@ -0,0 +1,112 @@
+#include "meshServer.h"
+#include "viewerMesh.h"
+#include <QFileInfo>
+#include <QDir>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+MeshServer::MeshServer(std::string dir, QObject *parent)
+    : QTcpServer(parent), root(dir)
+{
+    connect(this, &QTcpServer::newConnection, this, &MeshServer::accept);
+}
+
+void MeshServer::appendMessage(QByteArray & out, Message type, const void * data, size_t bytes)
+{
+    const uint32_t head[2] = { (uint32_t)type, (uint32_t)bytes };
+    out.append((const char *)head, sizeof(head));
+    out.append((const char *)data, (int)bytes);
+}
+
+void MeshServer::accept()
+{
+    while (QTcpSocket * socket = nextPendingConnection())
+    {
+        sessions.insert(socket, Session());
+        connect(socket, &QTcpSocket::readyRead, this, &MeshServer::readRequests);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+        {
+            sessions.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+std::shared_ptr<const MeshLib::CProgressiveMesh> MeshServer::open(const QString & name)
+{
+    auto found = meshes.find(name);
+    if (found != meshes.end()) return found.value();
+
+    // only the files under the directory, a name does not climb out of it
+    const QString path = QDir::cleanPath(QDir(QString::fromStdString(root)).absoluteFilePath(name));
+    const QString base = QDir::cleanPath(QDir(QString::fromStdString(root)).absolutePath());
+    if (QDir::isAbsolutePath(name) || !path.startsWith(base + "/") || !QFileInfo(path).isFile()) return NULL;
+
+    ViewerMesh mesh;
+    mesh.keep_positions = true;
+    mesh.keep_components = keep_components;
+    mesh.use_cache = use_cache;
+    mesh.store = store.enabled() ? &store : NULL;
+    mesh.decimate_ratio = decimate_ratio;
+    if (mesh.input_obj(path.toStdString())) return NULL;
+    std::vector<uint32_t> indices;
+    std::vector<float> vertices;
+    mesh.welded_vertices(indices, vertices);
+    std::shared_ptr<MeshLib::CProgressiveMesh> pm(new MeshLib::CProgressiveMesh);
+    pm->build(indices.data(), indices.size(), vertices.data(), vertices.size() / 8, mesh.mesh_with_uv);
+    std::cout << "Serving " << path.toStdString() << ", " << pm->header().base_triangles << " of "
+              << pm->header().triangles << " triangles in the base" << std::endl;
+    meshes.insert(name, pm);
+    return pm;
+}
+
+void MeshServer::sendError(QTcpSocket * socket, const QString & text)
+{
+    const QByteArray utf8 = text.toUtf8();
+    QByteArray message;
+    appendMessage(message, Error, utf8.constData(), utf8.size());
+    socket->write(message);
+}
+
+void MeshServer::readRequests()
+{
+    QTcpSocket * socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket || !sessions.contains(socket)) return;
+    while (socket->canReadLine())
+    {
+        const QString line = QString::fromUtf8(socket->readLine()).trimmed();
+        Session & session = sessions[socket];
+        if (line.startsWith("OPEN "))
+        {
+            const QString name = line.mid(5).trimmed();
+            session.mesh = open(name);
+            session.next = 0;
+            if (!session.mesh)
+            {
+                sendError(socket, "Cannot read " + name);
+                continue;
+            }
+            const MeshLib::CPmHeader & header = session.mesh->header();
+            std::vector<uint8_t> base;
+            session.mesh->encode_base(base);
+            QByteArray message;
+            appendMessage(message, Header, &header, sizeof(header));
+            appendMessage(message, Base, base.data(), base.size());
+            socket->write(message);
+        }
+        else if (line.startsWith("MORE ") && session.mesh)
+        {
+            // the client asks for what its view needs, the records go out in the order they apply
+            const size_t count = (size_t)std::max(0, std::min(line.mid(5).toInt(), records_per_message));
+            const size_t end = std::min(session.next + count, session.mesh->records());
+            std::vector<uint8_t> records;
+            session.mesh->encode_records(session.next, end, records);
+            session.next = end;
+            QByteArray message;
+            appendMessage(message, Records, records.data(), records.size());
+            socket->write(message);
+        }
+        else sendError(socket, "Unknown request " + line);
+    }
+}
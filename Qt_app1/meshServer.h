@@ -0,0 +1,55 @@
+#ifndef MESHSERVER_H
+#define MESHSERVER_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+#include <memory>
+#include <string>
+#include "Geometry/ProgressiveMesh.h"
+#include "parser/store.h"
+
+/*! serves the meshes under a directory as progressive meshes, see MeshLib::CProgressiveMesh, to
+    StreamedMesh. a client sends lines of text, "OPEN name" for a mesh of the directory and
+    "MORE n" for its next n records. the server answers with messages of a type, a size in bytes
+    and as many bytes: the header and the base for OPEN, records for MORE, or an error. a mesh is
+    read and simplified on the first OPEN, on the GUI thread, and kept for the next clients */
+class MeshServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    enum Message { Header = 1, Base = 2, Records = 3, Error = 4 };
+
+    MeshServer(std::string dir, QObject *parent = 0);
+
+    /*! how the meshes are read, as the view reads them */
+    bool use_cache = true;
+    MeshLib::CContentStore store;
+    size_t keep_components = 0;
+    double decimate_ratio = 1;
+    /*! records sent for one MORE at most */
+    int records_per_message = 1 << 16;
+
+    /*! append a message to out */
+    static void appendMessage(QByteArray & out, Message type, const void * data, size_t bytes);
+
+private slots:
+    void accept();
+    void readRequests();
+
+private:
+    //! the progressive mesh of every mesh opened, by its name
+    std::string root;
+    QHash<QString, std::shared_ptr<const MeshLib::CProgressiveMesh>> meshes;
+    //! per client its mesh and the next record it is sent
+    struct Session { std::shared_ptr<const MeshLib::CProgressiveMesh> mesh; size_t next; };
+    QHash<QTcpSocket *, Session> sessions;
+
+    std::shared_ptr<const MeshLib::CProgressiveMesh> open(const QString & name);
+    void sendError(QTcpSocket * socket, const QString & text);
+};
+
+#endif // MESHSERVER_H
@@ -0,0 +1,144 @@
+#include "occlusionCuller.h"
+#include <QVector4D>
+#include <algorithm>
+#include <cfloat>
+#include "parser/parallel.h"
+#include "parser/counters.h"
+#include "parser/trace.h"
+
+// the farthest of the texels 2x, 2x + 1 and rows 2y, 2y + 1 of from, those past its edge are left out
+static void reduce(const float * from, int fromWidth, int fromHeight, float * to, int width, int height)
+{
+    MeshLib::parallel_for((size_t)height, 0, [&](size_t b, size_t e)
+    {
+        for (size_t y = b; y < e; y++)
+        {
+            const int y0 = 2 * (int)y, y1 = std::min(y0 + 1, fromHeight - 1);
+            const float * r0 = from + (size_t)y0 * fromWidth;
+            const float * r1 = from + (size_t)y1 * fromWidth;
+            float * out = to + y * width;
+            for (int x = 0; x < width; x++)
+            {
+                const int x0 = 2 * x, x1 = std::min(x0 + 1, fromWidth - 1);
+                out[x] = std::max(std::max(r0[x0], r0[x1]), std::max(r1[x0], r1[x1]));
+            }
+        }
+    });
+}
+
+void OcclusionCuller::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+}
+
+void OcclusionCuller::releaseGL()
+{
+    if (!gl) return;
+    if (fence) gl->glDeleteSync(fence);
+    if (readbackBuffer) gl->glUnmapNamedBuffer(readbackBuffer);
+    gl->glDeleteBuffers(1, &readbackBuffer);
+    fence = 0;
+    readbackBuffer = 0;
+    readbackBytes = 0;
+    readback = NULL;
+    levels.clear();
+    gl = NULL;
+}
+
+void OcclusionCuller::capture(GLuint framebuffer, int width, int height, const QMatrix4x4 & mvp)
+{
+    if (!gl || fence || width < 2 || height < 2) return;
+    MESHLIB_TRACE_ZONE("OcclusionCuller::capture");
+    const int bytes = width * height * (int)sizeof(float);
+    if (bytes > readbackBytes)
+    {
+        if (readbackBuffer) gl->glUnmapNamedBuffer(readbackBuffer);
+        gl->glDeleteBuffers(1, &readbackBuffer);
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl->glCreateBuffers(1, &readbackBuffer);
+        gl->glNamedBufferStorage(readbackBuffer, bytes, NULL, flags);
+        readback = (const float *)gl->glMapNamedBufferRange(readbackBuffer, 0, bytes, flags);
+        readbackBytes = bytes;
+    }
+
+    // into the mapped buffer, reduced once the fence has passed
+    gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+    gl->glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    captureWidth = width;
+    captureHeight = height;
+    captureMvp = mvp;
+}
+
+bool OcclusionCuller::update()
+{
+    if (!fence || gl->glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) return false;
+    gl->glDeleteSync(fence);
+    fence = 0;
+
+    MESHLIB_TRACE_ZONE("OcclusionCuller::update");
+    // the rows of glReadPixels run from the bottom, as the window coordinates of occluded do
+    int width = captureWidth, height = captureHeight;
+    const float * from = readback;
+    size_t l = 0;
+    for (; width > 1 || height > 1; l++)
+    {
+        const int w = (width + 1) / 2, h = (height + 1) / 2;
+        if (levels.size() <= l) levels.push_back(Level());
+        Level & level = levels[l];
+        level.width = w;
+        level.height = h;
+        level.depth.resize((size_t)w * h);
+        reduce(from, width, height, level.depth.data(), w, h);
+        from = level.depth.data();
+        width = w;
+        height = h;
+    }
+    levels.resize(l);
+    pyramidWidth = captureWidth;
+    pyramidHeight = captureHeight;
+    pyramidMvp = captureMvp;
+    MESHLIB_COUNTER_ADD("occlusion.pyramids", 1);
+    return true;
+}
+
+bool OcclusionCuller::occluded(const QMatrix4x4 & mvp, const QVector3D & center, float radius) const
+{
+    if (levels.empty()) return false;
+    // the box of the sphere on screen and its nearest depth, from the corners of its bounding cube
+    float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX, zmin = FLT_MAX;
+    for (int c = 0; c < 8; c++)
+    {
+        const QVector3D corner = center + radius * QVector3D(c & 1 ? 1 : -1, c & 2 ? 1 : -1, c & 4 ? 1 : -1);
+        const QVector4D p = mvp * QVector4D(corner, 1);
+        if (p.w() <= 1e-6f) return false;
+        const float x = p.x() / p.w(), y = p.y() / p.w(), z = p.z() / p.w();
+        xmin = std::min(xmin, x);
+        xmax = std::max(xmax, x);
+        ymin = std::min(ymin, y);
+        ymax = std::max(ymax, y);
+        zmin = std::min(zmin, z);
+    }
+    // off screen is for the clipping to drop, in front of the near plane it is not hidden
+    if (xmax < -1 || xmin > 1 || ymax < -1 || ymin > 1 || zmin < -1) return false;
+
+    // in pixels of the captured frame, then in texels of the level where the box spans at most two
+    const float px0 = (std::max(xmin, -1.0f) * 0.5f + 0.5f) * pyramidWidth;
+    const float px1 = (std::min(xmax, 1.0f) * 0.5f + 0.5f) * pyramidWidth;
+    const float py0 = (std::max(ymin, -1.0f) * 0.5f + 0.5f) * pyramidHeight;
+    const float py1 = (std::min(ymax, 1.0f) * 0.5f + 0.5f) * pyramidHeight;
+    const float extent = std::max(px1 - px0, py1 - py0);
+    size_t l = 0;
+    while (l + 1 < levels.size() && (float)(2 << l) < extent) l++;
+    const Level & level = levels[l];
+    const float texel = (float)(2 << l);
+    const int x0 = std::max(0, (int)(px0 / texel)), x1 = std::min(level.width - 1, (int)(px1 / texel));
+    const int y0 = std::max(0, (int)(py0 / texel)), y1 = std::min(level.height - 1, (int)(py1 / texel));
+    const float nearest = zmin * 0.5f + 0.5f;
+    for (int y = y0; y <= y1; y++)
+        for (int x = x0; x <= x1; x++)
+            if (level.depth[(size_t)y * level.width + x] >= nearest) return false;
+    return true;
+}
@@ -0,0 +1,59 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <vector>
+
+/*! hierarchical Z occlusion of bounding spheres against the depth of an earlier frame. after the
+    occluders are drawn capture() reads the depth back through a mapped buffer, a frame or more
+    later update() reduces it on the CPU into a pyramid of the farthest depth of ever larger pixel
+    blocks, and a sphere whose box on screen is behind every texel of the level it spans a few
+    texels of is hidden. the depth lags the view by a frame or more, current() tells whether it
+    matches it. needs OpenGL 4.5, the calls do nothing until initializeGL. */
+class OcclusionCuller
+{
+public:
+    /*! create the readback buffer with the context current */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    bool available() const { return gl != NULL; }
+
+    /*! read the depth of the width x height framebuffer drawn with mvp back, unless a copy is on its way */
+    void capture(GLuint framebuffer, int width, int height, const QMatrix4x4 & mvp);
+    /*! reduce a finished copy into the pyramid, false while there is none */
+    bool update();
+    /*! whether there is a pyramid to test against */
+    bool ready() const { return !levels.empty(); }
+    /*! whether the pyramid is the depth of a frame drawn with mvp, the spheres are culled against an
+        older view otherwise and a frame drawn with mvp should follow */
+    bool current(const QMatrix4x4 & mvp) const { return ready() && mvp == pyramidMvp; }
+    /*! whether the sphere, in the coordinates mvp takes, is behind the pyramid wherever it is on screen,
+        false without a pyramid and for a sphere the eye plane cuts */
+    bool occluded(const QMatrix4x4 & mvp, const QVector3D & center, float radius) const;
+
+private:
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    //! persistently mapped, read when the fence of its glReadPixels has passed
+    GLuint readbackBuffer = 0;
+    int readbackBytes = 0;
+    const float * readback = NULL;
+    GLsync fence = 0;
+    int captureWidth = 0;
+    int captureHeight = 0;
+    QMatrix4x4 captureMvp;
+    //! level l covers blocks of 2^(l+1) pixels a side, the finest half the size of the framebuffer
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<float> depth;
+    };
+    std::vector<Level> levels;
+    int pyramidWidth = 0;
+    int pyramidHeight = 0;
+    QMatrix4x4 pyramidMvp;
+};
+
+#endif // OCCLUSIONCULLER_H
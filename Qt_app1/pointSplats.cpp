@@ -0,0 +1,122 @@
+#include "pointSplats.h"
+// TriangleCubeIntersect.h has its own EPS for the cube tests
+#undef EPS
+#include "Geometry/Octree.h"
+#include "Geometry/PointNormals.h"
+#include <iostream>
+
+bool PointSplats::build(CMesh * mesh, int depth, bool report)
+{
+    clear();
+    if (mesh->faces().empty()) return buildScan(mesh, depth, report);
+    MeshLib::CPointBounds box = mesh->parallel_reduce_vertices(MeshLib::CPointBounds(),
+        [](MeshLib::CPointBounds & b, CVertex * pv) { b.add(pv->point()); }, &MeshLib::CPointBounds::join);
+    if (!box.count) return false;
+
+    // the octree spans [-1, 1]^3, the bounding cube is mapped onto it
+    const CPoint center = (box.lo + box.hi) / 2.0;
+    const CPoint extent = box.hi - box.lo;
+    const double half = std::max(extent[0], std::max(extent[1], extent[2])) / 2;
+    if (half <= 0) return false;
+
+    MeshLib::COctree tree;
+    for (CFace * pf : mesh->faces())
+    {
+        MeshLib::CTriangle triangle;
+        int k = 0;
+        for (CHalfEdge * phe : pf->halfedges_range())
+        {
+            if (k == 3) break;
+            triangle.v[k] = (phe->vertex()->point() - center) / half;
+            triangle.uv[k] = phe->uv();
+            k++;
+        }
+        if (k == 3) tree._insert_triangle(triangle);
+    }
+
+    tree._construct(depth);
+    std::vector<MeshLib::CSample> samples;
+    std::vector<size_t> ends;
+    tree._sample(samples, ends);
+    if (samples.empty()) return false;
+
+    points.resize((int)samples.size());
+    Splat * out = points.data();
+    MeshLib::parallel_for(samples.size(), 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            const CPoint p = samples[i].point() * half + center;
+            const CPoint2 & uv = samples[i].uv();
+            out[i].position = QVector3D((float)p[0], (float)p[1], (float)p[2]);
+            out[i].uv = QVector2D((float)uv[0], (float)uv[1]);
+        }
+    });
+    for (size_t e : ends) levelEnds.append((int)e);
+    size = (float)(2 * half);
+    if (report) std::cout << points.size() << " splats in " << levelEnds.size() << " levels" << std::endl;
+    return true;
+}
+
+bool PointSplats::buildScan(CMesh * mesh, int depth, bool report)
+{
+    std::vector<CPoint> scan;
+    std::vector<CPoint2> uvs;
+    scan.reserve(mesh->vertices().size());
+    uvs.reserve(mesh->vertices().size());
+    for (CVertex * pv : mesh->vertices())
+    {
+        scan.push_back(pv->point());
+        uvs.push_back(pv->uv());
+    }
+    if (scan.empty()) return false;
+    std::vector<CPoint> fitted;
+    MeshLib::CPointNormals::estimate(scan.data(), scan.size(), scanNeighbors, fitted);
+
+    // the bounding cube, a little larger so that its far faces hold points too
+    const MeshLib::CPointBounds box = MeshLib::CPointBounds::of(&scan[0][0], scan.size());
+    const CPoint center = (box.lo + box.hi) / 2.0;
+    const CPoint extent = box.hi - box.lo;
+    const double half = std::max(extent[0], std::max(extent[1], extent[2])) / 2 * (1 + 1e-6);
+    if (half <= 0) return false;
+    MeshLib::CLinearOctree tree(center - CPoint(half, half, half), center + CPoint(half, half, half));
+    tree._construct(scan, depth);
+
+    // the first point of a node is its first child's too, the other children bring new ones
+    std::vector<char> fresh(tree.size(), 0);
+    fresh[0] = 1;
+    for (size_t i = 0; i < tree.size(); i++)
+    {
+        const MeshLib::CLinearOctree::CNode & node = tree.node(i);
+        if (node.leaf()) continue;
+        size_t children = 0;
+        for (int c = 0; c < 8; c++) children += (node.child_mask >> c) & 1;
+        for (size_t c = 1; c < children; c++) fresh[node.first_child + c] = 1;
+    }
+    for (size_t i = 0; i < tree.size(); i++)
+    {
+        if (!fresh[i]) continue;
+        const MeshLib::CLinearOctree::CNode & node = tree.node(i);
+        // breadth first, a level ends where the next begins
+        while (levelEnds.size() < (int)node.depth) levelEnds.append(points.size());
+        const size_t k = tree.indices()[node.begin];
+        const CPoint & p = scan[k];
+        const CPoint & n = fitted[k];
+        Splat splat;
+        splat.position = QVector3D((float)p[0], (float)p[1], (float)p[2]);
+        splat.uv = QVector2D((float)uvs[k][0], (float)uvs[k][1]);
+        splat.normal = QVector3D((float)n[0], (float)n[1], (float)n[2]);
+        points.append(splat);
+    }
+    levelEnds.append(points.size());
+    size = (float)(2 * half);
+    if (report) std::cout << points.size() << " splats of a scan in " << levelEnds.size() << " levels" << std::endl;
+    return true;
+}
+
+void PointSplats::clear()
+{
+    points.clear();
+    levelEnds.clear();
+    size = 0;
+}
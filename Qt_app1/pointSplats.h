@@ -0,0 +1,48 @@
+#ifndef POINTSPLATS_H
+#define POINTSPLATS_H
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include "viewerMesh.h"
+
+/*! a point set sampled from the triangles of a mesh by COctree, a point for every occupied
+    cell, ordered coarse to fine so that every level of the octree is a prefix of the points.
+    the points are in the coordinates of the mesh, drawn as splats about a cell wide. a mesh
+    without faces, a raw scan, is sampled from its points instead, each with the normal fitted
+    to its nearest points, see MeshLib::CPointNormals, so that it can be lit before any meshing */
+class PointSplats
+{
+public:
+    struct Splat
+    {
+        QVector3D position;
+        QVector2D uv;
+        //! zero for the samples of triangles, they are drawn unlit
+        QVector3D normal;
+    };
+
+    /*! sample mesh on an octree of depth levels below its bounding cube, false if it has no triangles
+        and no points, report prints the count of points and levels */
+    bool build(CMesh * mesh, int depth, bool report = false);
+    void clear();
+
+    /*! the points, released once they are uploaded */
+    QVector<Splat> points;
+    /*! the points of level d are the first levelEnds[d], levelEnds.last() is all of them */
+    QVector<int> levelEnds;
+    /*! the edge of a cell of level d, in the units of the mesh */
+    float cellSize(int d) const { return size / (float)(1 << d); }
+
+    //! the neighbours the normal of a point of a scan is fitted to
+    static const int scanNeighbors = 16;
+
+private:
+    /*! the points of a mesh without faces, the first one of every occupied cell of a linear octree
+        of depth levels, the cells breadth first */
+    bool buildScan(CMesh * mesh, int depth, bool report);
+
+    float size = 0;
+};
+
+#endif // POINTSPLATS_H
@@ -0,0 +1,422 @@
+#include "renderMesh.h"
+#include <iostream>
+#include <cfloat>
+#include "Geometry/VertexWelder.h"
+#include "Geometry/VertexCacheOptimizer.h"
+#include "Geometry/VertexQuantizer.h"
+#include "Geometry/MeshSimplifier.h"
+#include "Geometry/FeatureEdges.h"
+#include "Mesh/boundary.h"
+#include "Mesh/segmentation.h"
+
+void RenderMesh::expand(ViewerMesh * source, const Options & options, bool single)
+{
+    vertices.clear();
+    textureCoordinates.clear();
+    normals.clear();
+    indices.clear();
+
+    // every corner as (vertex, uv, normal), welded into render vertices below
+    size_t nv = 0;
+    std::vector<uint32_t> cornerVertex;
+    std::vector<float> cornerUv, cornerNormal;
+    std::vector<CHalfEdge*> cornerHalfedge;
+    const uint32_t * cv = NULL;
+    const float * cuv = NULL;
+    const float * cn = NULL;
+    size_t corners = 0;
+
+    const MeshLib::CSmvFile & smv = source->smv();
+    CMesh * mesh = source->m_mesh();
+    if (smv.is_open())
+    {
+        // the mapped cache already has the corners in this layout
+        nv = smv.num_vertices();
+        corners = 3 * smv.num_triangles();
+        cv = smv.indices();
+        cuv = smv.uvs();
+        cn = smv.normals();
+    }
+    else
+    {
+        // count the corners of every face, then every face fills its own slots
+        mesh->faces().compact();
+        const std::vector<CFace*> & faces = mesh->faces().data();
+        std::vector<size_t> offsets(faces.size() + 1, 0);
+        MeshLib::parallel_for(faces.size(), 0, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                CHalfEdge * phe = faces[i]->halfedge();
+                do {
+                    offsets[i + 1]++;
+                    phe = phe->next();
+                } while (phe != faces[i]->halfedge());
+            }
+        });
+        for (size_t i = 0; i < faces.size(); i++) offsets[i + 1] += offsets[i];
+        for (CVertex * pv : mesh->vertices()) nv = std::max(nv, pv->property_index() + 1);
+
+        corners = offsets.back();
+        cornerVertex.resize(corners);
+        cornerUv.resize(2 * corners);
+        cornerNormal.resize(3 * corners);
+        cornerHalfedge.resize(corners);
+        MeshLib::parallel_for(faces.size(), 0, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                size_t k = offsets[i];
+                for (CHalfEdge * phe : faces[i]->halfedges_range())
+                {
+                    cornerVertex[k] = (uint32_t)phe->vertex()->property_index();
+                    for (int d = 0; d < 2; d++) cornerUv[2 * k + d] = (float)phe->uv()[d];
+                    for (int d = 0; d < 3; d++) cornerNormal[3 * k + d] = (float)phe->normal()[d];
+                    cornerHalfedge[k] = phe;
+                    k++;
+                }
+            }
+        });
+        cv = cornerVertex.data();
+        cuv = cornerUv.data();
+        cn = cornerNormal.data();
+    }
+
+    std::vector<uint32_t> unique, welded;
+    MeshLib::CVertexWelder::weld(nv, cv, corners, cuv, cn, unique, welded);
+    if (options.report) std::cout << corners << " corners welded into " << unique.size() << " vertices" << std::endl;
+
+    vertices.resize((int)unique.size());
+    textureCoordinates.resize((int)unique.size());
+    const bool lit = options.lighting && cn;
+    if (lit) normals.resize((int)unique.size());
+
+    QVector3D * pos = vertices.data();
+    QVector2D * uv = textureCoordinates.data();
+    QVector3D * nrm = normals.data();
+    const float * positions = smv.is_open() ? smv.positions() : NULL;
+    // the mapped floats are the points as read, normalized here unless the model matrix does it
+    const CPoint c = source->keep_positions ? CPoint(0, 0, 0) : source->norm_center;
+    const float s = source->keep_positions ? 1.0f : (float)source->norm_scale;
+    MeshLib::parallel_for(unique.size(), 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            uint32_t k = unique[i];
+            if (positions)
+            {
+                const float * p = positions + 3 * cv[k];
+                pos[i] = QVector3D((p[0] - (float)c[0]) * s, (p[1] - (float)c[1]) * s, (p[2] - (float)c[2]) * s);
+            }
+            else
+            {
+                CPoint & p = cornerHalfedge[k]->vertex()->point();
+                pos[i] = QVector3D((float)p[0], (float)p[1], (float)p[2]);
+            }
+            if (cuv) uv[i] = QVector2D(cuv[2 * k], cuv[2 * k + 1]);
+            if (lit) nrm[i] = QVector3D(cn[3 * k], cn[3 * k + 1], cn[3 * k + 2]);
+        }
+    });
+
+    // levels of detail over the same vertices, each with a quarter of the triangles of the one before
+    std::vector<std::vector<uint32_t>> levels(1);
+    std::vector<float> errors(1, 0.0f);
+    levels[0].swap(welded);
+    if (options.buildLod)
+    {
+        MeshLib::CMeshSimplifier simplifier(levels[0].data(), corners, (const float*)pos, unique.size());
+        while (simplifier.size() > (size_t)options.minLodTriangles)
+        {
+            size_t before = simplifier.size();
+            if (simplifier.simplify(before / 4) > before * 9 / 10) break;
+            levels.emplace_back();
+            simplifier.triangles(levels.back());
+            errors.push_back(simplifier.error());
+        }
+        if (options.report) std::cout << levels.size() << " levels of detail down to " << levels.back().size() / 3 << " triangles" << std::endl;
+    }
+
+    // the faces of a single mesh are its triangles in order, their indices move with the triangles of the finest level
+    triangleFaces.clear();
+    if (single && mesh->faces().data().size() * 3 == corners)
+    {
+        triangleFaces.resize(corners / 3);
+        for (size_t t = 0; t < triangleFaces.size(); t++) triangleFaces[t] = (uint32_t)t;
+    }
+    std::vector<uint32_t> * tags = triangleFaces.empty() ? NULL : &triangleFaces;
+
+    boundaryPoints.clear();
+    boundaryFirst.clear();
+    boundaryCount.clear();
+    if (single) traceBoundary(mesh, options.report);
+
+    // triangles first, the fetch order below follows them
+    typedef MeshLib::CVertexCacheOptimizer COptimizer;
+    double acmr = 0;
+    size_t clusters = 0;
+    std::vector<std::vector<size_t>> starts(levels.size(), std::vector<size_t>(1, 0));
+    if (options.optimizeOrder)
+    {
+        acmr = COptimizer::acmr(levels[0].data(), corners, unique.size());
+        for (size_t l = 0; l < levels.size(); l++)
+        {
+            std::vector<uint32_t> & level = levels[l];
+            COptimizer::tipsify(level.data(), level.size(), unique.size(), COptimizer::s_cache_size, l ? NULL : tags);
+            if (l == 0 && options.patches > 0) continue;
+            clusters += COptimizer::reduce_overdraw(level.data(), level.size(), unique.size(), (const float*)pos,
+                COptimizer::s_cache_size, 1.05, &starts[l], l ? NULL : tags);
+        }
+    }
+
+    // the finest level grouped into compact patches, the triangles of one in their order above, the
+    // meshlets then follow the patches in place of the clusters
+    if (options.patches > 0)
+    {
+        std::vector<uint32_t> & level = levels[0];
+        const size_t triangles = level.size() / 3;
+        std::vector<uint32_t> original(unique.size());
+        for (size_t i = 0; i < unique.size(); i++) original[i] = cv[unique[i]];
+        MeshLib::CSegmentation segmentation;
+        segmentation.max_faces = (size_t)options.patches;
+        const size_t patches = segmentation.segment_triangles(level.data(), triangles, (const float*)pos, original.data());
+        starts[0].resize(patches);
+        for (size_t c = 0; c < patches; c++) starts[0][c] = segmentation.first(c);
+        std::vector<size_t> fill(starts[0]);
+        std::vector<uint32_t> sorted(level.size()), sortedTags(tags ? triangles : 0);
+        for (size_t t = 0; t < triangles; t++)
+        {
+            const size_t k = fill[segmentation.patch(t)]++;
+            std::copy(level.begin() + 3 * t, level.begin() + 3 * t + 3, sorted.begin() + 3 * k);
+            if (tags) sortedTags[k] = (*tags)[t];
+        }
+        level.swap(sorted);
+        if (tags) tags->swap(sortedTags);
+        if (options.report) std::cout << triangles << " triangles in " << patches << " patches" << std::endl;
+    }
+
+    lods.clear();
+    meshlets.clear();
+    indices.clear();
+    for (size_t l = 0; l < levels.size(); l++)
+    {
+        LodLevel lod;
+        lod.offset = indices.size();
+        lod.count = (int)levels[l].size();
+        lod.error = errors[l];
+        indices.resize(lod.offset + lod.count);
+        std::copy(levels[l].begin(), levels[l].end(), indices.begin() + lod.offset);
+
+        // meshlets do not straddle the clusters, which are apart in space after reduce_overdraw, or the patches
+        lod.firstMeshlet = (int)meshlets.size();
+        const size_t triangles = levels[l].size() / 3;
+        for (size_t k = 0; k < starts[l].size(); k++)
+        {
+            size_t b = starts[l][k], e = k + 1 < starts[l].size() ? starts[l][k + 1] : triangles;
+            meshlets.build(indices.constData(), lod.offset / 3 + b, e - b, (const float*)pos);
+        }
+        lod.meshletCount = (int)meshlets.size() - lod.firstMeshlet;
+        lods.append(lod);
+    }
+    if (options.report) std::cout << meshlets.size() << " meshlets" << std::endl;
+
+    // the vertex of the mesh every render vertex comes from, the creases are not the seams
+    std::vector<uint32_t> source;
+    if (options.features && single)
+    {
+        source.resize(unique.size());
+        for (size_t i = 0; i < unique.size(); i++) source[i] = cv[unique[i]];
+    }
+
+    if (options.optimizeOrder)
+    {
+        // the finest level decides the vertex order, the coarser ones fetch a subset
+        std::vector<uint32_t> order;
+        COptimizer::reorder_vertices(indices.data(), indices.size(), unique.size(), order);
+        if (!source.empty())
+        {
+            std::vector<uint32_t> moved(order.size());
+            for (size_t i = 0; i < order.size(); i++) moved[i] = source[order[i]];
+            source.swap(moved);
+        }
+        QVector<QVector3D> p(vertices.size());
+        QVector<QVector2D> t(textureCoordinates.size());
+        QVector<QVector3D> n(normals.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            p[(int)i] = pos[order[i]];
+            t[(int)i] = uv[order[i]];
+            if (lit) n[(int)i] = nrm[order[i]];
+        }
+        vertices.swap(p);
+        textureCoordinates.swap(t);
+        normals.swap(n);
+        if (options.report)
+            std::cout << "ACMR " << acmr << " -> " << COptimizer::acmr(indices.data(), corners, unique.size())
+                << " in " << clusters << " clusters" << std::endl;
+    }
+
+    featureIndices.clear();
+    adjacencyCount = 0;
+    creaseCount = 0;
+    if (!source.empty())
+    {
+        MeshLib::CFeatureEdges features;
+        features.crease_angle = options.creaseAngle;
+        features.build(indices.constData(), lods[0].count / 3, (const float*)vertices.constData(), source.data());
+        adjacencyCount = (int)features.adjacency().size();
+        creaseCount = (int)features.creases().size();
+        featureIndices.resize(adjacencyCount + creaseCount);
+        std::copy(features.adjacency().begin(), features.adjacency().end(), featureIndices.begin());
+        std::copy(features.creases().begin(), features.creases().end(), featureIndices.begin() + adjacencyCount);
+        if (options.report) std::cout << features.size() << " creases" << std::endl;
+    }
+
+    if (options.quantize) quantizeVertices();
+}
+
+void RenderMesh::traceBoundary(CMesh * mesh, bool report)
+{
+    // once per mesh, the loops stay in their buffer
+    MeshLib::CBoundary<CViewerVertex, CViewerEdge, CViewerFace, CViewerHalfEdge, MeshLib::CBlockArena, CViewerFields> boundary(mesh);
+    for (auto * loop : boundary.loops())
+    {
+        boundaryFirst.append(boundaryPoints.size());
+        for (CHalfEdge * phe : loop->halfedges())
+        {
+            const CPoint & p = phe->source()->point();
+            boundaryPoints.append(QVector3D((float)p[0], (float)p[1], (float)p[2]));
+        }
+        boundaryCount.append(boundaryPoints.size() - boundaryFirst.last());
+    }
+    if (report && !boundaryCount.isEmpty()) std::cout << boundaryCount.size() << " boundary loops" << std::endl;
+}
+
+void RenderMesh::quantizeVertices()
+{
+    if (vertices.isEmpty()) return;
+
+    // every axis of the bounding box maps onto [-1, 1]
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (const QVector3D & p : vertices)
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            lo[d] = std::min(lo[d], p[d]);
+            hi[d] = std::max(hi[d], p[d]);
+        }
+    }
+    float inv[3];
+    for (int d = 0; d < 3; d++)
+    {
+        positionScale[d] = (hi[d] - lo[d]) / 2;
+        positionOffset[d] = (hi[d] + lo[d]) / 2;
+        inv[d] = positionScale[d] > 0 ? 1 / positionScale[d] : 0;
+    }
+
+    typedef MeshLib::CVertexQuantizer CQuantizer;
+    quantizedVertices.resize(vertices.size());
+    quantizedUvs.resize(textureCoordinates.size());
+    quantizedNormals.resize(normals.size());
+    const QVector3D * pos = vertices.constData();
+    const QVector2D * uv = textureCoordinates.constData();
+    const QVector3D * nrm = normals.constData();
+    QuantizedPosition * qpos = quantizedVertices.data();
+    QuantizedUv * quv = quantizedUvs.data();
+    QuantizedNormal * qn = quantizedNormals.data();
+    const bool lit = !normals.isEmpty();
+    const QVector3D offset = positionOffset;
+    const QVector3D scale = positionScale;
+    MeshLib::parallel_for(vertices.size(), 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            qpos[i].x = CQuantizer::snorm16((pos[i].x() - offset.x()) * inv[0]);
+            qpos[i].y = CQuantizer::snorm16((pos[i].y() - offset.y()) * inv[1]);
+            qpos[i].z = CQuantizer::snorm16((pos[i].z() - offset.z()) * inv[2]);
+            qpos[i].w = 0;
+            quv[i].u = CQuantizer::half(uv[i].x());
+            quv[i].v = CQuantizer::half(uv[i].y());
+            if (!lit) continue;
+            // a normal of the decoded positions scales the other way, the shader divides it by positionScale
+            const float n[3] = { nrm[i].x() * scale.x(), nrm[i].y() * scale.y(), nrm[i].z() * scale.z() };
+            int16_t q[2];
+            CQuantizer::octahedral(n, q);
+            qn[i].x = q[0];
+            qn[i].y = q[1];
+        }
+    });
+
+    vertices = QVector<QVector3D>();
+    textureCoordinates = QVector<QVector2D>();
+    normals = QVector<QVector3D>();
+    quantized = true;
+}
+
+void RenderMesh::prepare(ViewerMesh * source, const Options & o)
+{
+    MESHLIB_TRACE_ZONE("prepareMesh");
+    options = o;
+    splats.clear();
+    if (!options.splats)
+    {
+        expand(source, options, true);
+        return;
+    }
+
+    // the triangles, the preview among them, are dropped until S switches to them
+    vertices.clear();
+    textureCoordinates.clear();
+    normals.clear();
+    quantizedVertices.clear();
+    quantizedUvs.clear();
+    quantizedNormals.clear();
+    indices.clear();
+    lods.clear();
+    meshlets.clear();
+    triangleFaces.clear();
+    boundaryPoints.clear();
+    boundaryFirst.clear();
+    boundaryCount.clear();
+    traceBoundary(source->m_mesh(), options.report);
+    splats.build(source->m_mesh(), options.splatDepth, options.report);
+}
+
+RenderQueue::~RenderQueue()
+{
+    clear();
+}
+
+void RenderQueue::push(RenderMesh * mesh, int index)
+{
+    Node * node = new Node{ mesh, index, pushed.load(std::memory_order_relaxed) };
+    while (!pushed.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+RenderMesh * RenderQueue::pop(int * index)
+{
+    if (!popped)
+    {
+        // everything pushed so far at once, reversed into the order it came in
+        Node * node = pushed.exchange(NULL, std::memory_order_acquire);
+        while (node)
+        {
+            Node * next = node->next;
+            node->next = popped;
+            popped = node;
+            node = next;
+        }
+    }
+    if (!popped) return NULL;
+    Node * node = popped;
+    popped = node->next;
+    RenderMesh * mesh = node->mesh;
+    if (index) *index = node->index;
+    delete node;
+    return mesh;
+}
+
+void RenderQueue::clear()
+{
+    while (RenderMesh * mesh = pop()) delete mesh;
+}
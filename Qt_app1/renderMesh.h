@@ -0,0 +1,119 @@
+#ifndef RENDERMESH_H
+#define RENDERMESH_H
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <QOpenGLFunctions>
+#include <atomic>
+#include <vector>
+#include "Geometry/Meshlets.h"
+#include "viewerMesh.h"
+#include "pointSplats.h"
+
+/*! the triangles of a mesh laid out for the vertex and index buffers, welded, in levels of
+    detail and meshlets, optionally quantized, or its splats in their place. it is built on
+    any thread from a ViewerMesh no other thread touches meanwhile, the loaders make it next
+    to the file they read and GlWidget only uploads it */
+class RenderMesh
+{
+public:
+    /*! how the mesh is laid out, the settings of GlWidget when the loading started */
+    struct Options
+    {
+        bool lighting = false;
+        bool buildLod = true;
+        int minLodTriangles = 1000;
+        bool optimizeOrder = true;
+        bool quantize = false;
+        bool splats = false;
+        int splatDepth = 8;
+        //! triangles of a patch of the finest level at most, see CSegmentation, 0 for none
+        int patches = 0;
+        //! lay out the creases and the adjacency of the finest level of a single mesh, see CFeatureEdges
+        bool features = false;
+        //! degrees the normals turn by across a crease
+        float creaseAngle = 40;
+        //! print what the layout came to, the welded vertices, levels, meshlets and creases, --report
+        bool report = false;
+    };
+
+    //! a level of detail, a range of the index buffer and its error in model units, and its meshlets
+    struct LodLevel { int offset; int count; float error; int firstMeshlet; int meshletCount; };
+    //! 16 bit normalized position in the bounding box, w pads it to 8 bytes
+    struct QuantizedPosition { GLshort x, y, z, w; };
+    //! half float uv
+    struct QuantizedUv { GLushort u, v; };
+    //! octahedral normal, see CVertexQuantizer, in the coordinates of the quantized positions
+    struct QuantizedNormal { GLshort x, y; };
+
+    /*! weld the corners of source into vertices, textureCoordinates, normals when lit and the
+        triangle indices. a single mesh, not one of a scene, keeps the faces of its triangles for
+        picking and its boundary loops */
+    void expand(ViewerMesh * source, const Options & options, bool single);
+    /*! expand source as a single mesh, or sample its splats in place of the triangles */
+    void prepare(ViewerMesh * source, const Options & options);
+    /*! encode vertices, textureCoordinates and normals into the quantized layout, dropping them */
+    void quantizeVertices();
+    /*! the boundary loops of mesh into boundaryPoints, a line loop each, their count printed with report */
+    void traceBoundary(CMesh * mesh, bool report);
+
+    //! what prepare was last asked for
+    Options options;
+    QVector<QVector3D> vertices;
+    QVector<QVector2D> textureCoordinates;
+    //! unit normals, empty when unlit and for the preview
+    QVector<QVector3D> normals;
+    //! three per triangle, 32 bit
+    QVector<GLuint> indices;
+    //! finest first, empty while the preview is drawn
+    QVector<LodLevel> lods;
+    //! the triangles of all levels in meshlets, culled every frame
+    MeshLib::CMeshlets meshlets;
+    //! the boundary loops of the mesh, kept until they are uploaded, and the range of every loop
+    QVector<QVector3D> boundaryPoints;
+    QVector<GLint> boundaryFirst;
+    QVector<GLsizei> boundaryCount;
+    //! the points of every level of splats, the finest last, kept once uploaded
+    PointSplats splats;
+    //! the face of the mesh every triangle of the finest level comes from, empty for the preview and scenes
+    std::vector<uint32_t> triangleFaces;
+    //! the finest level with adjacency, six indices a triangle, then two per crease, kept until they are
+    //! uploaded, and their counts, which stay. empty unless Options::features asked for them
+    QVector<GLuint> featureIndices;
+    int adjacencyCount = 0;
+    int creaseCount = 0;
+    QVector<QuantizedPosition> quantizedVertices;
+    QVector<QuantizedUv> quantizedUvs;
+    QVector<QuantizedNormal> quantizedNormals;
+    //! the layout of the vertex buffers, set by quantizeVertices
+    bool quantized = false;
+    //! decoding of the positions in the shader, vertex * positionScale + positionOffset
+    QVector3D positionScale = QVector3D(1, 1, 1);
+    QVector3D positionOffset;
+};
+
+/*! the meshes the loader threads have laid out, on their way to the GUI thread. any thread
+    pushes without a lock, the GUI thread pops them in the order they were pushed */
+class RenderQueue
+{
+public:
+    ~RenderQueue();
+
+    /*! hand over mesh, index tells the consumer which it is, the mesh of a scene say */
+    void push(RenderMesh * mesh, int index = -1);
+    /*! the oldest mesh pushed and its index, NULL if there is none, owned by the caller.
+        only one thread pops */
+    RenderMesh * pop(int * index = NULL);
+    /*! drop the meshes pushed so far */
+    void clear();
+
+private:
+    struct Node { RenderMesh * mesh; int index; Node * next; };
+    //! the meshes pushed since the last refill, newest first
+    std::atomic<Node *> pushed{ NULL };
+    //! the meshes refilled from pushed, oldest first, only the popping thread sees them
+    Node * popped = NULL;
+};
+
+#endif // RENDERMESH_H
@@ -0,0 +1,173 @@
+#include "sceneLoader.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// a normalized mesh reaches this far from its center
+static const float meshRadius = std::sqrt(3.0f);
+// grid spacing of the instances without a position
+static const float gridSpacing = 2.5f;
+
+QMatrix4x4 Scene::Instance::transform() const
+{
+    QMatrix4x4 m;
+    m.translate(position);
+    m.rotate(turn, 0, 1, 0);
+    m.scale(scale);
+    return m;
+}
+
+void Scene::add(const std::string & meshfile, const std::string & textfile, const QVector3D & position, float scale, float turn)
+{
+    int mesh = 0;
+    while (mesh < (int)meshes.size() && (meshes[mesh].meshfile != meshfile || meshes[mesh].textfile != textfile)) mesh++;
+    if (mesh == (int)meshes.size())
+    {
+        Mesh m = { meshfile, textfile };
+        meshes.push_back(m);
+    }
+    Instance instance = { mesh, position, scale, turn };
+    instances.push_back(instance);
+}
+
+// the whole token is a number
+static bool parse_number(const std::string & token, float & value)
+{
+    char * end = NULL;
+    value = (float)strtod(token.c_str(), &end);
+    return end != token.c_str() && *end == '\0';
+}
+
+bool Scene::read(const std::string & fname)
+{
+    std::ifstream in(fname);
+    if (!in) return false;
+
+    std::vector<size_t> unplaced;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string meshfile, token, textfile;
+        if (!(fields >> meshfile) || meshfile[0] == '#') continue;
+
+        // the texture is the first field that is not a number
+        std::vector<float> numbers;
+        float value;
+        while (fields >> token)
+        {
+            if (parse_number(token, value)) numbers.push_back(value);
+            else if (numbers.empty() && textfile.empty()) textfile = token;
+        }
+        if (textfile == "-") textfile.clear();
+        const float scale = numbers.size() > 3 ? numbers[3] : 1;
+        const float turn = numbers.size() > 4 ? numbers[4] : 0;
+        if (numbers.size() < 3) unplaced.push_back(instances.size());
+        add(meshfile, textfile, numbers.size() < 3 ? QVector3D() : QVector3D(numbers[0], numbers[1], numbers[2]), scale, turn);
+    }
+    place(unplaced);
+    return true;
+}
+
+void Scene::place(const std::vector<size_t> & unplaced)
+{
+    const int side = (int)std::ceil(std::sqrt((double)unplaced.size()));
+    for (size_t k = 0; k < unplaced.size(); k++)
+    {
+        const float x = ((int)k % side - (side - 1) * 0.5f) * gridSpacing;
+        const float z = ((int)k / side - (side - 1) * 0.5f) * gridSpacing;
+        instances[unplaced[k]].position = QVector3D(x, 0, z);
+    }
+}
+
+QMatrix4x4 Scene::fit() const
+{
+    QMatrix4x4 m;
+    if (instances.empty()) return m;
+    QVector3D lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (const Instance & instance : instances)
+    {
+        const float r = meshRadius * instance.scale;
+        for (int d = 0; d < 3; d++)
+        {
+            lo[d] = std::min(lo[d], instance.position[d] - r);
+            hi[d] = std::max(hi[d], instance.position[d] + r);
+        }
+    }
+    const QVector3D extent = (hi - lo) / 2;
+    const float half = std::max(extent.x(), std::max(extent.y(), extent.z()));
+    m.scale(meshRadius / std::max(half, FLT_MIN));
+    m.translate(-(lo + hi) / 2);
+    return m;
+}
+
+SceneLoader::SceneLoader(const Scene & s, bool compressed, QObject *parent)
+    : QThread(parent), scene(s), compress(compressed)
+{
+    textures.resize(scene.meshes.size());
+}
+
+SceneLoader::~SceneLoader()
+{
+    requestInterruption();
+    wait();
+}
+
+void SceneLoader::render(RenderQueue * q, const RenderMesh::Options & o)
+{
+    queue = q;
+    options = o;
+}
+
+void SceneLoader::preprocess(bool useCache, double ratio, const MeshLib::CContentStore * s)
+{
+    cache = useCache;
+    store = s;
+    decimateRatio = ratio;
+}
+
+TextureImage SceneLoader::takeTexture(int index)
+{
+    TextureImage texture = textures[index];
+    textures[index] = TextureImage();
+    return texture;
+}
+
+void SceneLoader::run()
+{
+    for (size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        if (isInterruptionRequested()) return;
+        const Scene::Mesh & m = scene.meshes[i];
+        ViewerMesh mesh;
+        mesh.use_cache = cache;
+        mesh.store = store;
+        mesh.decimate_ratio = decimateRatio;
+        const int ret = mesh.input_obj(m.meshfile);
+        // without a texture of its own a mesh is drawn with the maps of its materials
+        MaterialAtlas atlas;
+        if (!ret && m.textfile.empty()) atlas.read(m.meshfile);
+        if (!ret && (!m.textfile.empty() || !atlas.empty()))
+        {
+            TextureLoader decoder(m.textfile.empty() ? atlas.texture() : m.textfile, compress);
+            if (atlas.tiled()) decoder.compose(atlas);
+            textures[i] = decoder.decode();
+        }
+        // the texture is in its slot before the mesh can be popped
+        if (!ret && queue)
+        {
+            RenderMesh * prepared = new RenderMesh();
+            // the meshes of a scene are drawn as triangles, without picking or their boundary
+            RenderMesh::Options o = options;
+            o.splats = false;
+            prepared->options = o;
+            prepared->expand(&mesh, o, false);
+            queue->push(prepared, (int)i);
+        }
+        emit meshRead((int)i, ret);
+    }
+    emit sceneLoaded();
+}
@@ -0,0 +1,84 @@
+#ifndef SCENELOADER_H
+#define SCENELOADER_H
+
+#include <QThread>
+#include <QVector3D>
+#include <QMatrix4x4>
+#include <vector>
+#include <string>
+#include "viewerMesh.h"
+#include "renderMesh.h"
+#include "textureLoader.h"
+
+/*! meshes placed side by side. instances of the same mesh and texture share
+    one copy of it, which is drawn instanced */
+struct Scene
+{
+    struct Mesh { std::string meshfile; std::string textfile; };
+    /*! a mesh moved to position, scaled and turned about the vertical axis, in degrees */
+    struct Instance
+    {
+        int mesh;
+        QVector3D position;
+        float scale;
+        float turn;
+        QMatrix4x4 transform() const;
+    };
+    std::vector<Mesh> meshes;
+    std::vector<Instance> instances;
+
+    /*! add an instance of the mesh, loaded once for all its instances */
+    void add(const std::string & meshfile, const std::string & textfile, const QVector3D & position, float scale = 1, float turn = 0);
+    /*! read a scene file, a line per instance: mesh [texture] [x y z [scale [turn]]], - for no
+        texture. instances without a position are laid out on a grid. false if the file cannot be read */
+    bool read(const std::string & fname);
+    /*! lay the instances out on a grid of rows along x, then z, centered on the origin */
+    void place(const std::vector<size_t> & unplaced);
+    /*! the transform giving all instances together the extent of a single normalized mesh */
+    QMatrix4x4 fit() const;
+};
+
+/*! reads the meshes and textures of a scene on a background thread, one
+    after the other, and lays the meshes out for the buffers. each is pushed to
+    the queue of render, its texture kept for takeTexture, and announced by
+    meshRead */
+class SceneLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    SceneLoader(const Scene & scene, bool compressed, QObject *parent = 0);
+    ~SceneLoader();
+
+    /*! push the meshes laid out with options to queue, with their index in the scene, call it
+        before start */
+    void render(RenderQueue * queue, const RenderMesh::Options & options);
+    /*! read the meshes through their mapped caches or not, filed in store if one is given, and
+        simplify them to ratio of their triangles, see ViewerMesh::use_cache, store and
+        decimate_ratio, call it before start */
+    void preprocess(bool useCache, double ratio, const MeshLib::CContentStore * store = NULL);
+    /*! its texture, without levels if it has none or it could not be read */
+    TextureImage takeTexture(int index);
+
+signals:
+    /*! ret is the return code of ViewerMesh::input_obj */
+    void meshRead(int index, int ret);
+    /*! every mesh has been read */
+    void sceneLoaded();
+
+protected:
+    void run();
+
+private:
+    Scene scene;
+    bool compress;
+    RenderQueue * queue = NULL;
+    RenderMesh::Options options;
+    bool cache = true;
+    const MeshLib::CContentStore * store = NULL;
+    double decimateRatio = 1;
+    //! a slot is written before its meshRead and read after it
+    std::vector<TextureImage> textures;
+};
+
+#endif // SCENELOADER_H
@@ -0,0 +1,42 @@
+#include "startupProfiler.h"
+#include <QCoreApplication>
+#include <QThread>
+
+StartupProfiler & StartupProfiler::instance()
+{
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+StartupProfiler::~StartupProfiler()
+{
+    closeLog();
+}
+
+bool StartupProfiler::openLog(const std::string & fname)
+{
+    QMutexLocker lock(&mutex);
+    if (log) fclose(log);
+    log = fopen(fname.c_str(), "w");
+    if (!log) return false;
+    fprintf(log, "stage,thread,start_ms,end_ms,duration_ms\n");
+    return true;
+}
+
+void StartupProfiler::record(const char * stage, qint64 start)
+{
+    const qint64 end = now();
+    QMutexLocker lock(&mutex);
+    if (!log) return;
+    // the loaders run on threads of their own, everything touching the context on the GUI thread
+    const QCoreApplication * app = QCoreApplication::instance();
+    const bool gui = app && QThread::currentThread() == app->thread();
+    fprintf(log, "%s,%s,%.3f,%.3f,%.3f\n", stage, gui ? "gui" : "loader", start * 1e-6, end * 1e-6, (end - start) * 1e-6);
+}
+
+void StartupProfiler::closeLog()
+{
+    QMutexLocker lock(&mutex);
+    if (log) fclose(log);
+    log = NULL;
+}
@@ -0,0 +1,50 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <cstdio>
+#include <string>
+
+/*! wall clock times of the stages from launch to the first complete frame. the stages
+    run on the loader threads as well as on the GUI thread, each becomes a CSV line
+    "stage,thread,start_ms,end_ms,duration_ms" once it ends, the times counted from
+    launch. the clock starts with the first call to instance(), nothing is recorded
+    until openLog. */
+class StartupProfiler
+{
+public:
+    static StartupProfiler & instance();
+
+    /*! write the stages to a CSV file, false if it cannot be written */
+    bool openLog(const std::string & fname);
+    bool enabled() const { return log != NULL; }
+    /*! nanoseconds since launch */
+    qint64 now() const { return clock.nsecsElapsed(); }
+    /*! a stage from start, in nanoseconds since launch, to now */
+    void record(const char * stage, qint64 start);
+    /*! flush and close the log, later stages are dropped */
+    void closeLog();
+
+    /*! times a stage from its construction to the end of its scope */
+    class Stage
+    {
+    public:
+        Stage(const char * name) : name(name), start(StartupProfiler::instance().now()) {}
+        ~Stage() { StartupProfiler::instance().record(name, start); }
+
+    private:
+        const char * name;
+        qint64 start;
+    };
+
+private:
+    StartupProfiler() { clock.start(); }
+    ~StartupProfiler();
+
+    QElapsedTimer clock;
+    QMutex mutex;
+    FILE * log = NULL;
+};
+
+#endif // STARTUPPROFILER_H
@@ -0,0 +1,189 @@
+#include "streamedMesh.h"
+#include "meshServer.h"
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+StreamedMesh::StreamedMesh(QObject *parent)
+    : QObject(parent), socket(this)
+{
+    std::memset(&header, 0, sizeof(header));
+    connect(&socket, &QTcpSocket::readyRead, this, &StreamedMesh::readMessages);
+}
+
+bool StreamedMesh::parseAddress(const std::string & address, QString & host, quint16 & port)
+{
+    const size_t colon = address.find_last_of(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    bool ok = false;
+    const uint p = QString::fromStdString(address.substr(colon + 1)).toUInt(&ok);
+    if (!ok || p == 0 || p > 65535) return false;
+    host = QString::fromStdString(address.substr(0, colon));
+    port = (quint16)p;
+    return true;
+}
+
+bool StreamedMesh::open(const std::string & address, const std::string & name)
+{
+    QString host;
+    quint16 port;
+    if (!parseAddress(address, host, port)) return false;
+    socket.connectToHost(host, port);
+    if (!socket.waitForConnected(5000)) return false;
+    socket.write(("OPEN " + QString::fromStdString(name) + "\n").toUtf8());
+    return true;
+}
+
+void StreamedMesh::readMessages()
+{
+    inbox += socket.readAll();
+    bool received = false;
+    // whole messages only, a type and a size in bytes before each
+    while (inbox.size() >= 8)
+    {
+        uint32_t head[2];
+        std::memcpy(head, inbox.constData(), sizeof(head));
+        if ((size_t)inbox.size() < 8 + (size_t)head[1]) break;
+        const uint8_t * data = (const uint8_t *)inbox.constData() + 8;
+        const size_t bytes = head[1];
+        if (head[0] == MeshServer::Header && bytes == sizeof(header))
+        {
+            std::memcpy(&header, data, sizeof(header));
+            if (std::memcmp(header.magic, "PMX\x1a", 4) != 0 || header.version != MeshLib::CProgressiveMesh::s_version)
+            {
+                std::cout << "The server sends another version of the progressive mesh" << std::endl;
+                std::memset(&header, 0, sizeof(header));
+                socket.abort();
+                inbox.clear();
+                break;
+            }
+            hasHeader = true;
+            vertices.reserve(header.vertices);
+            indices.reserve(3 * (size_t)header.triangles);
+            error = header.base_error;
+            if (gl) createBuffers();
+            emit meshOpened();
+        }
+        else if (head[0] == MeshServer::Base && bytes == header.base_vertices * sizeof(MeshLib::CPmVertex) + 12 * (size_t)header.base_triangles)
+        {
+            vertices.resize(header.base_vertices);
+            indices.resize(3 * (size_t)header.base_triangles);
+            std::memcpy(vertices.data(), data, vertices.size() * sizeof(MeshLib::CPmVertex));
+            std::memcpy(indices.data(), data + vertices.size() * sizeof(MeshLib::CPmVertex), indices.size() * sizeof(uint32_t));
+            received = true;
+        }
+        else if (head[0] == MeshServer::Records)
+        {
+            // a record appends a vertex and triangles and moves corners onto the vertex
+            const long long count = MeshLib::CProgressiveMesh::decode_records(data, bytes, [&](const MeshLib::CPmRecord & r)
+            {
+                const uint32_t v = (uint32_t)vertices.size();
+                if (v >= header.vertices) return;
+                vertices.push_back(r.vertex);
+                indices.insert(indices.end(), r.indices, r.indices + 3 * (size_t)r.triangles);
+                for (uint32_t i = 0; i < r.corners; i++)
+                {
+                    if (r.positions[i] >= indices.size()) continue;
+                    indices[r.positions[i]] = v;
+                    if (r.positions[i] < uploadedIndices) changedIndex = std::min(changedIndex, (size_t)r.positions[i]);
+                }
+                error = r.error;
+            });
+            if (count < 0) std::cout << "The records of the server are cut short" << std::endl;
+            else applied += (size_t)count;
+            requested = false;
+            received = true;
+        }
+        else if (head[0] == MeshServer::Error)
+        {
+            std::cout << QString::fromUtf8((const char *)data, (int)bytes).toStdString() << std::endl;
+            requested = false;
+        }
+        inbox.remove(0, 8 + (int)bytes);
+    }
+    if (received) emit meshReceived();
+}
+
+void StreamedMesh::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    // the quantized point, uv and normal of a vertex, as the attribute locations of buildShaders
+    gl->glCreateVertexArrays(1, &vao);
+    const GLuint offsets[3] = { 0, 8, 12 };
+    const GLint sizes[3] = { 3, 2, 2 };
+    const GLenum types[3] = { GL_SHORT, GL_HALF_FLOAT, GL_SHORT };
+    for (GLuint a = 0; a < 3; a++)
+    {
+        gl->glEnableVertexArrayAttrib(vao, a);
+        gl->glVertexArrayAttribFormat(vao, a, sizes[a], types[a], GL_TRUE, offsets[a]);
+        gl->glVertexArrayAttribBinding(vao, a, 0);
+    }
+    if (opened()) createBuffers();
+}
+
+void StreamedMesh::createBuffers()
+{
+    // as large as the whole mesh, the records only fill them in
+    gl->glCreateBuffers(1, &vertexBuffer);
+    gl->glNamedBufferStorage(vertexBuffer, std::max<GLsizeiptr>(header.vertices * sizeof(MeshLib::CPmVertex), 1), NULL, GL_DYNAMIC_STORAGE_BIT);
+    gl->glCreateBuffers(1, &indexBuffer);
+    gl->glNamedBufferStorage(indexBuffer, std::max<GLsizeiptr>(12 * (GLsizeiptr)header.triangles, 1), NULL, GL_DYNAMIC_STORAGE_BIT);
+    gl->glVertexArrayVertexBuffer(vao, 0, vertexBuffer, 0, sizeof(MeshLib::CPmVertex));
+    gl->glVertexArrayElementBuffer(vao, indexBuffer);
+    uploadedVertices = 0;
+    uploadedIndices = 0;
+    changedIndex = SIZE_MAX;
+}
+
+void StreamedMesh::releaseGL()
+{
+    if (!gl) return;
+    gl->glDeleteBuffers(1, &vertexBuffer);
+    gl->glDeleteBuffers(1, &indexBuffer);
+    gl->glDeleteVertexArrays(1, &vao);
+    vertexBuffer = indexBuffer = vao = 0;
+    gl = NULL;
+}
+
+bool StreamedMesh::update()
+{
+    if (!gl || !vertexBuffer) return requested;
+    if (uploadedVertices < vertices.size())
+    {
+        gl->glNamedBufferSubData(vertexBuffer, uploadedVertices * sizeof(MeshLib::CPmVertex),
+            (vertices.size() - uploadedVertices) * sizeof(MeshLib::CPmVertex), &vertices[uploadedVertices]);
+        uploadedVertices = vertices.size();
+    }
+    // the new triangles and the corners the records moved, in one range from the first of them
+    const size_t from = std::min(changedIndex, uploadedIndices);
+    if (from < indices.size())
+    {
+        gl->glNamedBufferSubData(indexBuffer, from * sizeof(uint32_t), (indices.size() - from) * sizeof(uint32_t), &indices[from]);
+        uploadedIndices = indices.size();
+        changedIndex = SIZE_MAX;
+    }
+    return requested;
+}
+
+void StreamedMesh::draw(const QVector3D & eye, float pixels, float pixelError, size_t & triangles, int & calls)
+{
+    triangles = 0;
+    calls = 0;
+    if (!gl || !vertexBuffer) return;
+
+    // the nearest point of the bounding sphere sees the error largest
+    const QVector3D center = positionOffset();
+    const float radius = positionScale().length();
+    const float nearest = std::max(eye.distanceToPoint(center) - radius, 1e-6f * std::max(radius, 1e-30f));
+    if (!requested && applied < header.records && uploadedIndices > 0 && error * pixels > pixelError * nearest)
+    {
+        socket.write(("MORE " + QString::number(records_per_request) + "\n").toUtf8());
+        requested = true;
+    }
+
+    gl->glBindVertexArray(vao);
+    gl->glDrawElements(GL_TRIANGLES, (GLsizei)uploadedIndices, GL_UNSIGNED_INT, NULL);
+    gl->glBindVertexArray(0);
+    triangles = uploadedIndices / 3;
+    calls = 1;
+}
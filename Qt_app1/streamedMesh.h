@@ -0,0 +1,83 @@
+#ifndef STREAMEDMESH_H
+#define STREAMEDMESH_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QByteArray>
+#include <QString>
+#include <QVector3D>
+#include <QOpenGLFunctions_4_5_Core>
+#include <string>
+#include <vector>
+#include "Geometry/ProgressiveMesh.h"
+
+/*! a mesh received from a MeshServer as a progressive mesh, see MeshLib::CProgressiveMesh. the
+    base is drawn as soon as it arrives and refined by the records the view asks for: the next
+    batch is requested while the error of the mesh covers more pixels than the view allows, so a
+    distant mesh costs no more than its base. the vertices stay quantized as they arrive, decoded
+    by positionScale and positionOffset. the socket is served by the event loop of the GUI thread,
+    the GL functions run on it with the context current, on the core backend */
+class StreamedMesh : public QObject
+{
+    Q_OBJECT
+
+public:
+    StreamedMesh(QObject *parent = 0);
+
+    /*! records asked for at once */
+    int records_per_request = 4096;
+
+    /*! split "host:port", false if it is not one */
+    static bool parseAddress(const std::string & address, QString & host, quint16 & port);
+    /*! connect to the server at host:port and ask for the mesh name, a path under its directory */
+    bool open(const std::string & address, const std::string & name);
+
+    /*! whether the header arrived, the bounds and the decoding are known then */
+    bool opened() const { return hasHeader; }
+    /*! the bounds of the points */
+    QVector3D lower() const { return QVector3D(header.lo[0], header.lo[1], header.lo[2]); }
+    QVector3D upper() const { return QVector3D(header.hi[0], header.hi[1], header.hi[2]); }
+    QVector3D positionScale() const { return (upper() - lower()) / 2; }
+    QVector3D positionOffset() const { return (upper() + lower()) / 2; }
+
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    /*! upload what arrived, true while records are on their way */
+    bool update();
+    /*! draw the mesh with the bound program, eye in the coordinates of the points, and ask for
+        records while its error on screen is above pixelError. the triangles and draw calls drawn */
+    void draw(const QVector3D & eye, float pixels, float pixelError, size_t & triangles, int & calls);
+
+signals:
+    /*! the header arrived */
+    void meshOpened();
+    /*! vertices or triangles wait for their upload */
+    void meshReceived();
+
+private slots:
+    void readMessages();
+
+private:
+    QTcpSocket socket;
+    QByteArray inbox;
+    MeshLib::CPmHeader header;
+    bool hasHeader = false;
+    bool requested = false;
+    size_t applied = 0;
+    float error = 0;
+
+    //! the mesh so far, quantized, and what of it is on the GPU
+    std::vector<MeshLib::CPmVertex> vertices;
+    std::vector<uint32_t> indices;
+    size_t uploadedVertices = 0, uploadedIndices = 0;
+    //! the first index a record changed below uploadedIndices
+    size_t changedIndex = SIZE_MAX;
+
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    GLuint vao = 0;
+    GLuint vertexBuffer = 0, indexBuffer = 0;
+
+    void createBuffers();
+};
+
+#endif // STREAMEDMESH_H
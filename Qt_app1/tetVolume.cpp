@@ -0,0 +1,205 @@
+#include "tetVolume.h"
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+
+static QByteArray readResource(const char * name)
+{
+    QFile file(name);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+}
+
+void TetVolume::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    if (!gl) return;
+    const QByteArray version = "#version 450 core\n";
+    const QByteArray sort = readResource(":/sortTets.comp");
+    keyProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Compute, version + "#define KEYS\n" + sort);
+    blockProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Compute, version + "#define BLOCK\n" + sort);
+    mergeProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Compute, version + sort);
+    drawProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, version + readResource(":/volumeShader.vsh"));
+    drawProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + readResource(":/volumeShader.fsh"));
+    if (!keyProgram.link() || !blockProgram.link() || !mergeProgram.link() || !drawProgram.link())
+    {
+        releaseGL();
+        return;
+    }
+
+    gl->glCreateVertexArrays(1, &vertexArray);
+    gl->glCreateTextures(GL_TEXTURE_1D, 1, &transferTexture);
+    gl->glTextureStorage1D(transferTexture, 1, GL_RGBA32F, transferSize);
+    gl->glTextureParameteri(transferTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl->glTextureParameteri(transferTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTextureParameteri(transferTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+
+    // blue, cyan, green, yellow, red, clearer at the low end
+    std::vector<QVector4D> ramp;
+    const QVector3D stops[5] = { QVector3D(0, 0, 1), QVector3D(0, 1, 1), QVector3D(0, 1, 0), QVector3D(1, 1, 0), QVector3D(1, 0, 0) };
+    for (int i = 0; i < transferSize; i++)
+    {
+        const float u = (float)i / (transferSize - 1);
+        const float x = u * 4;
+        const int k = std::min((int)x, 3);
+        const QVector3D c = stops[k] + (stops[k + 1] - stops[k]) * (x - k);
+        ramp.push_back(QVector4D(c, u));
+    }
+    setTransfer(ramp);
+}
+
+void TetVolume::releaseGL()
+{
+    if (!gl) return;
+    clear();
+    gl->glDeleteTextures(1, &transferTexture);
+    gl->glDeleteVertexArrays(1, &vertexArray);
+    transferTexture = vertexArray = 0;
+    keyProgram.removeAllShaders();
+    blockProgram.removeAllShaders();
+    mergeProgram.removeAllShaders();
+    drawProgram.removeAllShaders();
+    gl = NULL;
+}
+
+void TetVolume::clear()
+{
+    if (!gl) return;
+    gl->glDeleteBuffers(1, &pointBuffer);
+    gl->glDeleteBuffers(1, &tetBuffer);
+    gl->glDeleteBuffers(1, &valueBuffer);
+    gl->glDeleteBuffers(1, &orderBuffer);
+    pointBuffer = tetBuffer = valueBuffer = orderBuffer = 0;
+    tetCount = sortCount = 0;
+    sorted = false;
+}
+
+void TetVolume::upload(const std::vector<QVector3D> & points, const std::vector<int32_t> & tets, const std::vector<float> & values)
+{
+    clear();
+    if (!gl || tets.size() < 4 || values.size() < tets.size() / 4) return;
+    tetCount = (int)(tets.size() / 4);
+    sortCount = sortBlock;
+    while (sortCount < tetCount) sortCount <<= 1;
+
+    // the scalars over their range, a constant field in the middle of the transfer function
+    const auto range = std::minmax_element(values.begin(), values.begin() + tetCount);
+    const float lo = *range.first, span = *range.second - *range.first;
+    std::vector<GLfloat> scalars(tetCount);
+    for (int t = 0; t < tetCount; t++) scalars[t] = span > 0 ? (values[t] - lo) / span : 0.5f;
+    std::vector<GLfloat> coordinates(3 * points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        coordinates[3 * i] = points[i].x();
+        coordinates[3 * i + 1] = points[i].y();
+        coordinates[3 * i + 2] = points[i].z();
+    }
+
+    gl->glCreateBuffers(1, &pointBuffer);
+    gl->glNamedBufferStorage(pointBuffer, coordinates.size() * sizeof(GLfloat), coordinates.data(), 0);
+    gl->glCreateBuffers(1, &tetBuffer);
+    gl->glNamedBufferStorage(tetBuffer, 4 * (size_t)tetCount * sizeof(GLuint), tets.data(), 0);
+    gl->glCreateBuffers(1, &valueBuffer);
+    gl->glNamedBufferStorage(valueBuffer, scalars.size() * sizeof(GLfloat), scalars.data(), 0);
+    gl->glCreateBuffers(1, &orderBuffer);
+    gl->glNamedBufferStorage(orderBuffer, 2 * (size_t)sortCount * sizeof(GLuint), NULL, 0);
+}
+
+void TetVolume::setTransfer(const std::vector<QVector4D> & colors)
+{
+    if (!gl || colors.empty()) return;
+    // resampled linearly onto the texels
+    std::vector<QVector4D> texels(transferSize);
+    for (int i = 0; i < transferSize; i++)
+    {
+        const float x = (float)i / (transferSize - 1) * (colors.size() - 1);
+        const int k = std::min((int)x, (int)colors.size() - 1);
+        const int next = std::min(k + 1, (int)colors.size() - 1);
+        texels[i] = colors[k] + (colors[next] - colors[k]) * (x - k);
+    }
+    gl->glTextureSubImage1D(transferTexture, 0, 0, transferSize, GL_RGBA, GL_FLOAT, texels.data());
+}
+
+void TetVolume::dispatch(int count, int size)
+{
+    const int groups = (count + size - 1) / size;
+    const int columns = std::min(groups, 65535);
+    gl->glDispatchCompute((GLuint)columns, (GLuint)((groups + columns - 1) / columns), 1);
+}
+
+void TetVolume::sort(const QVector3D & eye)
+{
+    for (GLuint b = 0; b < 3; b++) gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, b == 0 ? pointBuffer : b == 1 ? tetBuffer : orderBuffer);
+
+    keyProgram.bind();
+    keyProgram.setUniformValue("eye", eye);
+    keyProgram.setUniformValue("tetCount", (GLuint)tetCount);
+    keyProgram.setUniformValue("sortCount", (GLuint)sortCount);
+    dispatch(sortCount, 256);
+    gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // the blocks sorted in shared memory, then every merge of blocks: the strides past a block
+    // a pass each over the whole buffer, the rest again in shared memory
+    blockProgram.bind();
+    blockProgram.setUniformValue("stage", (GLuint)0);
+    dispatch(sortCount / 2, sortBlock / 2);
+    gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    for (int k = 2 * sortBlock; k <= sortCount; k <<= 1)
+    {
+        mergeProgram.bind();
+        for (int j = k / 2; j >= sortBlock; j >>= 1)
+        {
+            mergeProgram.setUniformValue("stage", (GLuint)k);
+            mergeProgram.setUniformValue("stride", (GLuint)j);
+            dispatch(sortCount / 2, 256);
+            gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        blockProgram.bind();
+        blockProgram.setUniformValue("stage", (GLuint)k);
+        dispatch(sortCount / 2, sortBlock / 2);
+        gl->glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+    blockProgram.release();
+    for (GLuint b = 0; b < 3; b++) gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, 0);
+}
+
+void TetVolume::draw(const QMatrix4x4 & mvp, const QVector3D & eye, float center, float width, float density)
+{
+    if (!gl || !tetCount) return;
+    if (!sorted || eye != sortedEye)
+    {
+        sort(eye);
+        sortedEye = eye;
+        sorted = true;
+    }
+
+    drawProgram.bind();
+    drawProgram.setUniformValue("mvpMatrix", mvp);
+    drawProgram.setUniformValue("eyePosition", eye);
+    drawProgram.setUniformValue("windowCenter", center);
+    drawProgram.setUniformValue("windowWidth", std::max(width, 1e-6f));
+    drawProgram.setUniformValue("density", density);
+    drawProgram.setUniformValue("transfer", 3);
+    gl->glBindTextureUnit(3, transferTexture);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, pointBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, tetBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, orderBuffer);
+    gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, valueBuffer);
+
+    // the faces toward the eye, one fragment per tet and pixel, back to front over premultiplied colors
+    gl->glDisable(GL_DEPTH_TEST);
+    gl->glDepthMask(GL_FALSE);
+    gl->glEnable(GL_CULL_FACE);
+    gl->glEnable(GL_BLEND);
+    gl->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    gl->glBindVertexArray(vertexArray);
+    gl->glDrawArrays(GL_TRIANGLES, 0, 12 * tetCount);
+    gl->glBindVertexArray(0);
+    gl->glDisable(GL_BLEND);
+    gl->glDepthMask(GL_TRUE);
+    gl->glEnable(GL_DEPTH_TEST);
+
+    for (GLuint b = 0; b < 4; b++) gl->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, 0);
+    gl->glBindTextureUnit(3, 0);
+    drawProgram.release();
+}
@@ -0,0 +1,76 @@
+#ifndef TETVOLUME_H
+#define TETVOLUME_H
+
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+#include <vector>
+#include <cstdint>
+
+/*! direct volume rendering of a scalar per tet by projecting the tets. the points, the tets and
+    their scalars are uploaded once. when the eye moves the tets are ordered back to front by the
+    distance of their centroids in a bitonic sort on the GPU, see sortTets.comp, and every tet is
+    drawn by its faces toward the eye in that order, each fragment the color of the transfer
+    function at the scalar of its tet and as opaque as the ray is long inside it, over what is
+    behind, see volumeShader.fsh. the transfer function is a texture and the window of scalars it
+    spans and the density are uniforms, changing them sorts and uploads nothing. needs OpenGL 4.5,
+    the calls do nothing until initializeGL */
+class TetVolume
+{
+public:
+    /*! build the programs with the context current, unavailable if they do not link */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    bool available() const { return gl != NULL; }
+
+    /*! the tets, four indices into points each, and a scalar per tet, mapped from their range onto
+        [0, 1], in place of those uploaded before */
+    void upload(const std::vector<QVector3D> & points, const std::vector<int32_t> & tets, const std::vector<float> & values);
+    /*! drop the tets */
+    void clear();
+    bool loaded() const { return tetCount > 0; }
+
+    /*! the colors of the scalars from 0 to 1 in equal steps, alpha the opacity of a unit of length,
+        from blue and clear to red and dense until set */
+    void setTransfer(const std::vector<QVector4D> & colors);
+    /*! the tets into the bound framebuffer, sorted again if eye moved, eye in the coordinates mvp
+        takes. the scalars in center -+ width / 2 span the transfer function, the others are not
+        drawn, density scales the opacity */
+    void draw(const QMatrix4x4 & mvp, const QVector3D & eye, float center, float width, float density);
+
+    //! the entries a workgroup of sortTets.comp sorts in shared memory
+    static const int sortBlock = 1024;
+    //! texels of the transfer function
+    static const int transferSize = 256;
+
+private:
+    /*! the tets from the farthest to the nearest to eye into the order buffer */
+    void sort(const QVector3D & eye);
+    /*! run the bound program over count items in groups of size, in rows of groups past the limit of one dimension */
+    void dispatch(int count, int size);
+
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    QOpenGLShaderProgram keyProgram;
+    QOpenGLShaderProgram blockProgram;
+    QOpenGLShaderProgram mergeProgram;
+    QOpenGLShaderProgram drawProgram;
+    //! three floats per point, four indices per tet and a scalar per tet
+    GLuint pointBuffer = 0;
+    GLuint tetBuffer = 0;
+    GLuint valueBuffer = 0;
+    //! the distance and the index of every tet, sortCount of them, the padding after the tets
+    GLuint orderBuffer = 0;
+    GLuint transferTexture = 0;
+    //! no attributes, the vertex shader reads the buffers by gl_VertexID
+    GLuint vertexArray = 0;
+    int tetCount = 0;
+    //! tetCount up to a power of two, at least sortBlock
+    int sortCount = 0;
+    //! the eye of the last sort, none before the first
+    QVector3D sortedEye;
+    bool sorted = false;
+};
+
+#endif // TETVOLUME_H
@@ -0,0 +1,113 @@
+#include "textureLoader.h"
+#include <QImage>
+#include <QFileInfo>
+#include <QDateTime>
+#include <iostream>
+#include "Geometry/TextureCompressor.h"
+#include "parser/stx.h"
+#include "parser/trace.h"
+#include "startupProfiler.h"
+
+// name.png -> name.stx
+static std::string cache_name(const std::string & fname)
+{
+    size_t dot = fname.find_last_of('.');
+    size_t sep = fname.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) return fname + ".stx";
+    return fname.substr(0, dot) + ".stx";
+}
+
+TextureLoader::TextureLoader(std::string fname, bool compressed, QObject *parent)
+    : QThread(parent), textfile(fname), compress(compressed)
+{
+    qRegisterMetaType<TextureImage>("TextureImage");
+}
+
+void TextureLoader::compose(const MaterialAtlas & atlas)
+{
+    materials = atlas;
+    use_cache = false;
+}
+
+void TextureLoader::run()
+{
+    MESHLIB_TRACE_THREAD("texture loader");
+    TextureImage texture = decode();
+    if (!isInterruptionRequested()) emit textureLoaded(texture);
+}
+
+TextureImage TextureLoader::decode()
+{
+    MESHLIB_TRACE_ZONE("decode texture");
+    StartupProfiler::Stage stage("texture_decode");
+    typedef MeshLib::CTextureCompressor CCompressor;
+    TextureImage texture;
+    const std::string cache = cache_name(textfile);
+
+    // the cache is fresh if it is not older than its source
+    const QFileInfo source(QString::fromStdString(textfile)), cached(QString::fromStdString(cache));
+    if (compress && use_cache && cached.exists() && cached.lastModified() >= source.lastModified())
+    {
+        MeshLib::CStxFile stx(cache);
+        if (stx.is_open() && stx.header().format == STX_BC1)
+        {
+            texture.width = (int)stx.header().width;
+            texture.height = (int)stx.header().height;
+            texture.compressed = true;
+            for (int i = 0; i < stx.levels(); i++)
+            {
+                texture.levels.append(QByteArray((const char *)stx.level(i), (int)stx.level_size(i)));
+            }
+            return texture;
+        }
+    }
+
+    // rows bottom up, as bindTexture uploaded them
+    QImage image = materials.empty() ? QImage(QString::fromStdString(textfile)) : materials.compose();
+    if (image.isNull()) return texture;
+    image = image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+
+    texture.width = image.width();
+    texture.height = image.height();
+    texture.compressed = compress;
+    const int levels = CCompressor::levels(texture.width, texture.height);
+
+    // every level from the one before, the RGBA8 level is kept until the next one is made
+    std::vector<uint8_t> level((const uint8_t *)image.constBits(), (const uint8_t *)image.constBits() + image.byteCount());
+    image = QImage();
+    std::vector<uint8_t> next;
+    int w = texture.width, h = texture.height;
+    for (int l = 0; l < levels; l++)
+    {
+        if (isInterruptionRequested()) return texture;
+        if (compress)
+        {
+            QByteArray blocks((int)CCompressor::bc1_size(w, h), Qt::Uninitialized);
+            CCompressor::encode_bc1(level.data(), w, h, (uint8_t *)blocks.data());
+            texture.levels.append(blocks);
+        }
+        else texture.levels.append(QByteArray((const char *)level.data(), (int)level.size()));
+
+        if (l + 1 == levels) break;
+        CCompressor::downsample(level.data(), w, h, next);
+        level.swap(next);
+        w = std::max(1, w / 2);
+        h = std::max(1, h / 2);
+    }
+
+    if (compress && use_cache)
+    {
+        std::vector<const uint8_t *> data;
+        std::vector<size_t> sizes;
+        for (const QByteArray & l : texture.levels)
+        {
+            data.push_back((const uint8_t *)l.constData());
+            sizes.push_back((size_t)l.size());
+        }
+        if (!MeshLib::write_stx_file(cache, STX_BC1, texture.width, texture.height, data, sizes))
+        {
+            std::cout << "Cannot write the texture cache " << cache << std::endl;
+        }
+    }
+    return texture;
+}
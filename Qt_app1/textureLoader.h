@@ -0,0 +1,52 @@
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <QThread>
+#include <QVector>
+#include <QByteArray>
+#include <QMetaType>
+#include <string>
+#include "materialAtlas.h"
+
+/*! a decoded mip chain, finest level first, rows bottom up as OpenGL expects them.
+    the levels are RGBA8 rows or, when compressed, BC1 block rows */
+struct TextureImage
+{
+    int width = 0;
+    int height = 0;
+    bool compressed = false;
+    QVector<QByteArray> levels;
+};
+Q_DECLARE_METATYPE(TextureImage)
+
+/*! decodes, mipmaps and optionally compresses a texture on a background thread.
+    compressed chains are cached next to the image, name.png -> name.stx */
+class TextureLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    TextureLoader(std::string fname, bool compressed, QObject *parent = 0);
+
+    bool use_cache = true;
+
+    /*! decode the atlas of the materials in place of the file, without a cache, see MaterialAtlas */
+    void compose(const MaterialAtlas & atlas);
+
+    /*! the work of run() on the calling thread, no levels if the image could not be read */
+    TextureImage decode();
+
+signals:
+    /*! the chain is complete, no levels if the image could not be read */
+    void textureLoaded(const TextureImage &image);
+
+protected:
+    void run();
+
+private:
+    std::string textfile;
+    bool compress;
+    MaterialAtlas materials;
+};
+
+#endif // TEXTURELOADER_H
@@ -0,0 +1,161 @@
+#include "tiledMesh.h"
+#include <QMutexLocker>
+#include <algorithm>
+
+TiledMesh::TiledMesh(std::string fname, QObject *parent)
+    : QThread(parent), meshfile(fname)
+{
+}
+
+TiledMesh::~TiledMesh()
+{
+    requestInterruption();
+    {
+        QMutexLocker lock(&mutex);
+        wake.wakeAll();
+    }
+    wait();
+}
+
+bool TiledMesh::isTileFile(const std::string & fname)
+{
+    const size_t dot = fname.find_last_of('.');
+    return dot != std::string::npos && fname.substr(dot) == ".mtx";
+}
+
+bool TiledMesh::open()
+{
+    if (!mtx.open(meshfile)) return false;
+    cache.init(mtx.nodes(), memory_budget);
+    buffers.assign(mtx.nodes().size(), 0);
+    return true;
+}
+
+QVector3D TiledMesh::lower() const
+{
+    const float * lo = mtx.header().lo;
+    return QVector3D(lo[0], lo[1], lo[2]);
+}
+
+QVector3D TiledMesh::upper() const
+{
+    const float * hi = mtx.header().hi;
+    return QVector3D(hi[0], hi[1], hi[2]);
+}
+
+void TiledMesh::run()
+{
+    while (!isInterruptionRequested())
+    {
+        QVector<uint32_t> ids;
+        {
+            QMutexLocker lock(&mutex);
+            while (requested.isEmpty() && !isInterruptionRequested()) wake.wait(&mutex);
+            ids.swap(requested);
+        }
+
+        // the copy faults the pages of the mapping in, the GUI thread never waits for the disk
+        QVector<Tile> tiles;
+        for (uint32_t id : ids)
+        {
+            Tile t = { id, QByteArray((const char *)mtx.tile(id), (int)mtx.nodes()[id].bytes()) };
+            tiles.append(t);
+        }
+        {
+            QMutexLocker lock(&mutex);
+            ready += tiles;
+        }
+        emit tilesRead();
+    }
+}
+
+void TiledMesh::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    // the point, the normal and the uv of a vertex, as the attribute locations of buildShaders
+    gl->glCreateVertexArrays(1, &vao);
+    const GLuint offsets[3] = { 0, 6 * sizeof(GLfloat), 3 * sizeof(GLfloat) };
+    const GLint sizes[3] = { 3, 2, 3 };
+    for (GLuint a = 0; a < 3; a++)
+    {
+        gl->glEnableVertexArrayAttrib(vao, a);
+        gl->glVertexArrayAttribFormat(vao, a, sizes[a], GL_FLOAT, GL_FALSE, offsets[a]);
+        gl->glVertexArrayAttribBinding(vao, a, 0);
+    }
+
+    // the root first, every view falls back to it
+    QMutexLocker lock(&mutex);
+    cache.set_pending(0, true);
+    requested.append(0);
+    inFlight++;
+    wake.wakeOne();
+}
+
+void TiledMesh::releaseGL()
+{
+    if (!gl) return;
+    for (GLuint & b : buffers) gl->glDeleteBuffers(1, &b);
+    gl->glDeleteVertexArrays(1, &vao);
+    std::fill(buffers.begin(), buffers.end(), 0);
+    vao = 0;
+    cache.init(mtx.nodes(), memory_budget);
+    gl = NULL;
+}
+
+bool TiledMesh::update()
+{
+    if (!gl) return false;
+    QVector<Tile> tiles;
+    {
+        QMutexLocker lock(&mutex);
+        const int n = std::min(uploads_per_frame, ready.size());
+        tiles = ready.mid(0, n);
+        ready.remove(0, n);
+        inFlight -= n;
+    }
+
+    for (const Tile & t : tiles)
+    {
+        // a tile that no longer fits beside those of the last frame is asked for again if still wanted
+        if (!cache.insert(t.id, evicted)) continue;
+        for (uint32_t e : evicted) gl->glDeleteBuffers(1, &buffers[e]);
+        gl->glCreateBuffers(1, &buffers[t.id]);
+        gl->glNamedBufferStorage(buffers[t.id], t.data.size(), t.data.constData(), 0);
+    }
+
+    QMutexLocker lock(&mutex);
+    return inFlight > 0;
+}
+
+void TiledMesh::draw(const QMatrix4x4 & mvp, const QVector3D & eye, float pixels, float pixelError, size_t & triangles, int & calls)
+{
+    triangles = 0;
+    calls = 0;
+    if (!gl) return;
+    const float eyes[3] = { eye.x(), eye.y(), eye.z() };
+    cache.select(mvp.constData(), eyes, pixels, pixelError, drawn, missing);
+    if (!missing.empty())
+    {
+        QMutexLocker lock(&mutex);
+        for (uint32_t id : missing)
+        {
+            cache.set_pending(id, true);
+            requested.append(id);
+            inFlight++;
+        }
+        wake.wakeOne();
+    }
+
+    const std::vector<MeshLib::CMtxNode> & nodes = mtx.nodes();
+    gl->glBindVertexArray(vao);
+    for (uint32_t id : drawn)
+    {
+        const MeshLib::CMtxNode & n = nodes[id];
+        gl->glVertexArrayVertexBuffer(vao, 0, buffers[id], 0, 8 * sizeof(GLfloat));
+        gl->glVertexArrayElementBuffer(vao, buffers[id]);
+        gl->glDrawElements(GL_TRIANGLES, 3 * n.triangles, GL_UNSIGNED_INT, (const GLvoid *)(8 * sizeof(GLfloat) * n.vertices));
+        triangles += n.triangles;
+        calls++;
+    }
+    gl->glBindVertexArray(0);
+}
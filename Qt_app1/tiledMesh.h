@@ -0,0 +1,79 @@
+#ifndef TILEDMESH_H
+#define TILEDMESH_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QVector>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QOpenGLFunctions_4_5_Core>
+#include <string>
+#include <vector>
+#include "Geometry/MeshTileCache.h"
+#include "parser/mtx.h"
+
+/*! a mesh larger than memory, drawn from the tiles of a .mtx file, see MeshLib::write_mtx_file.
+    the tiles the view needs are read on a background thread and kept on the GPU within a
+    budget, coarser ones drawn until they arrive, see MeshLib::CMeshTileCache. the GL functions
+    run on the GUI thread with the context current, on the core backend */
+class TiledMesh : public QThread
+{
+    Q_OBJECT
+
+public:
+    TiledMesh(std::string fname, QObject *parent = 0);
+    ~TiledMesh();
+
+    /*! whether fname is a tile file, by its extension */
+    static bool isTileFile(const std::string & fname);
+
+    /*! bytes of the tiles kept on the GPU, choose it before open */
+    size_t memory_budget = (size_t)512 << 20;
+    /*! tiles copied to the GPU per frame at most */
+    int uploads_per_frame = 8;
+
+    /*! map the file, false if it is not a tile file */
+    bool open();
+    /*! the bounds of the points */
+    QVector3D lower() const;
+    QVector3D upper() const;
+
+    /*! create the vertex array and ask for the root */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    /*! upload the tiles read, true while tiles are on their way */
+    bool update();
+    /*! draw the tiles of the view with the bound program, mvp and eye in the coordinates of the
+        points, ask for the finer ones it wants. the triangles and draw calls drawn */
+    void draw(const QMatrix4x4 & mvp, const QVector3D & eye, float pixels, float pixelError, size_t & triangles, int & calls);
+
+signals:
+    /*! tiles are waiting for their upload */
+    void tilesRead();
+
+protected:
+    void run();
+
+private:
+    std::string meshfile;
+    MeshLib::CMtxFile mtx;
+    MeshLib::CMeshTileCache cache;
+
+    //! tiles asked for and tiles read, shared with the thread
+    QMutex mutex;
+    QWaitCondition wake;
+    QVector<uint32_t> requested;
+    struct Tile { uint32_t id; QByteArray data; };
+    QVector<Tile> ready;
+    int inFlight = 0;
+
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    GLuint vao = 0;
+    //! the vertices and the indices of every resident tile in one buffer, 0 for the others
+    std::vector<GLuint> buffers;
+    std::vector<uint32_t> drawn, missing, evicted;
+};
+
+#endif // TILEDMESH_H
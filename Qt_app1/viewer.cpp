@@ -1,100 +1,2478 @@
 #include "viewer.h"
 #include <QMouseEvent>
+#include <QKeyEvent>
 #include <QWheelEvent>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QWindow>
+#include <QFile>
+#include <QFileInfo>
+#include <QPainter>
+#include <QFontDatabase>
+#include <QVector4D>
 #include <iostream>
-//! [0]
-#ifdef WIN32
-#include <GL/glext.h>
-PFNGLACTIVETEXTUREPROC pGlActiveTexture = NULL;
-#define glActiveTexture pGlActiveTexture
-#endif //WIN32
-//! [0]
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include "Geometry/Meshlets.h"
+#include "Mesh/distance.h"
+#include "startupProfiler.h"
+#include "parser/counters.h"
+
+// the overlay lines are pulled this far toward the eye in normalized device depth, about half a
+// percent of the mesh at the default distance, so that they pass the depth test on their edges
+static const float overlayDepthBias = 2e-6f;
+
+// model matrices of a draw of scene instances, 16 KB, the least uniform block size OpenGL guarantees
+static const int instancesPerDraw = 256;
+
+// buffer swaps wait for the vertical refresh
+static QSurfaceFormat viewerFormat(GlWidget::Backend backend)
+{
+    QSurfaceFormat format;
+    if (backend == GlWidget::CoreBackend)
+    {
+        format.setVersion(4, 5);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+    }
+    else
+    {
+        format.setVersion(3, 0);
+        format.setProfile(QSurfaceFormat::CompatibilityProfile);
+    }
+    format.setDepthBufferSize(24);
+    format.setSwapInterval(1);
+    return format;
+}
 
 GlWidget::GlWidget(QWidget *parent)
-    : QGLWidget(QGLFormat(/* Additional format options */), parent)
+    : QOpenGLWidget(parent)
+{
+    setFormat(viewerFormat(backend));
+    alpha = 0;
+    beta = 0;
+    distance = 2.5;
+    vMesh = new ViewerMesh();
+    // the overlays are toggled from the keyboard
+    setFocusPolicy(Qt::StrongFocus);
+
+    frameTimer.setSingleShot(true);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer, &QTimer::timeout, this, &GlWidget::drawFrame);
+    idleTimer.setSingleShot(true);
+    connect(&idleTimer, &QTimer::timeout, this, &GlWidget::refine);
+    connect(this, &QOpenGLWidget::frameSwapped, this, &GlWidget::startupFrame);
+    sinceFrame.start();
+    for (int i = 0; i < sequenceRing; i++)
+    {
+        sequencePositions[i] = { GL_ARRAY_BUFFER, 0, 0, NULL };
+        sequenceNormals[i] = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    }
+    sequenceTimer.setTimerType(Qt::PreciseTimer);
+    connect(&sequenceTimer, &QTimer::timeout, this, &GlWidget::advanceSequence);
+    // an export writes the file in pieces, it is read once the writes pause
+    watchTimer.setSingleShot(true);
+    connect(&watchTimer, &QTimer::timeout, this, &GlWidget::reloadMesh);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, [this]() { watchTimer.start(watchDelay); });
+    connect(&checkpointTimer, &QTimer::timeout, this, [this]() { saveCheckpoint(); });
+}
+
+GlWidget::~GlWidget()
+{
+    stopSequence();
+    if (loader)
+    {
+        loader->cancel();
+        loader->wait();
+    }
+    if (textureLoader)
+    {
+        textureLoader->requestInterruption();
+        textureLoader->wait();
+    }
+    // the upload thread shares the objects of the context, it stops before they are released
+    delete uploader;
+    uploader = NULL;
+    delete sceneLoader;
+    delete slicer;
+    delete subdivision;
+    delete vMesh;
+    if (!isValid()) return;
+    // the buffers, the texture and the vertex array object belong to this widget's context
+    makeCurrent();
+    freeBuffer(vertexBuffer);
+    freeBuffer(uvBuffer);
+    freeBuffer(normalBuffer);
+    freeBuffer(boundaryBuffer);
+    freeBuffer(splatBuffer);
+    freeBuffer(featureBuffer);
+    freeBuffer(indexBuffer);
+    freeBuffer(refinedVertexBuffer);
+    freeBuffer(refinedUvBuffer);
+    freeBuffer(refinedNormalBuffer);
+    freeBuffer(refinedIndexBuffer);
+    freeBuffer(stagingBuffer);
+    freeBuffer(instanceBuffer);
+    freeBuffer(visibleBuffer);
+    for (GLsync fence : visibleFences) if (fence) gl45->glDeleteSync(fence);
+    for (const SceneMesh & mesh : sceneMeshes) glDeleteTextures(1, &mesh.texture);
+    if (uploadFence) gl45->glDeleteSync(uploadFence);
+    if (editFence) gl45->glDeleteSync(editFence);
+    if (virtualTexture) virtualTexture->releaseGL();
+    if (tiledMesh) tiledMesh->releaseGL();
+    if (streamedMesh) streamedMesh->releaseGL();
+    profiler.releaseGL();
+    picker.releaseGL();
+    volume.releaseGL();
+    tiling.releaseGL();
+    occlusion.releaseGL();
+    impostors.releaseGL();
+    visibility.releaseGL();
+    compute.releaseGL();
+    glDeleteTextures(1, &texture);
+    glDeleteTextures(1, &normalMap);
+    countTexture(0);
+    vao.destroy();
+    boundaryVao.destroy();
+    splatVao.destroy();
+    featureVao.destroy();
+    refinedVao.destroy();
+    doneCurrent();
+}
+
+void GlWidget::setBackend(Backend b)
+{
+    backend = b;
+    setFormat(viewerFormat(b));
+}
+
+QSize GlWidget::sizeHint() const
+{
+    return QSize(640, 480);
+}
+
+//! [1]
+void GlWidget::initializeGL()
+{
+    //! [1]
+    StartupProfiler::Stage stage("initialize_gl");
+    MESHLIB_TRACE_ZONE("initializeGL");
+    initializeOpenGLFunctions();
+    gl45 = NULL;
+    if (backend == CoreBackend)
+    {
+        gl45 = context()->versionFunctions<QOpenGLFunctions_4_5_Core>();
+        if (gl45 && !gl45->initializeOpenGLFunctions()) gl45 = NULL;
+        if (!gl45)
+        {
+            std::cout << "OpenGL 4.5 core is not available, using the legacy backend" << std::endl;
+            backend = LegacyBackend;
+        }
+    }
+    if (uploadThread && gl45 && !uploader)
+    {
+        uploader = new GpuUploader(this);
+        if (uploader->initialize(context())) connect(uploader, &GpuUploader::uploaded, this, &GlWidget::resourcesUploaded);
+        else
+        {
+            std::cout << "The context cannot be shared with an upload thread, uploading on this one" << std::endl;
+            delete uploader;
+            uploader = NULL;
+        }
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    glClearColor(1, 1, 1, 1);
+
+    if (showHud || !profileLog.empty())
+    {
+        profiler.initializeGL();
+        if (!profileLog.empty() && !profiler.openLog(profileLog)) std::cout << "Cannot write " << profileLog << std::endl;
+    }
+
+    picker.initializeGL(gl45);
+    if (showVolume) volume.initializeGL(gl45);
+    if (showVolume && !gl45) std::cout << "The volume rendering needs OpenGL 4.5" << std::endl;
+    if (showTiling) tiling.initializeGL(gl45);
+    if (showTiling && !gl45) std::cout << "The hyperbolic tiling needs OpenGL 4.5" << std::endl;
+    if (occlusionCulling) occlusion.initializeGL(gl45);
+    if (occlusionCulling && !gl45) std::cout << "The occlusion culling needs OpenGL 4.5" << std::endl;
+    if (impostorPixels > 0) impostors.initializeGL(gl45);
+    if (impostorPixels > 0 && !gl45) std::cout << "The impostors need OpenGL 4.5" << std::endl;
+    if (visibilityRendering) visibility.initializeGL(gl45);
+    if (visibilityRendering && !gl45) std::cout << "The visibility buffer needs OpenGL 4.5" << std::endl;
+    if (computeCulling) compute.initializeGL(gl45);
+    if (computeCulling && gl45 && !compute.available()) std::cout << "The compute shaders did not build, culling on the CPU" << std::endl;
+
+    const bool tiled = virtualTexturing && gl45;
+    if (virtualTexturing && !gl45) std::cout << "Virtual texturing needs OpenGL 4.5, loading the texture whole" << std::endl;
+    if (showWireframe && !gl45) std::cout << "The wireframe needs OpenGL 4.5" << std::endl;
+    if (showSplats && tiled) std::cout << "The splats sample the whole texture, not the virtual one" << std::endl;
+    if (tiledMesh && gl45) tiledMesh->initializeGL(gl45);
+    if (tiledMesh && !gl45) std::cout << "The tiled mesh needs OpenGL 4.5" << std::endl;
+    if (streamedMesh && gl45) streamedMesh->initializeGL(gl45);
+    if (streamedMesh && !gl45) std::cout << "The streamed mesh needs OpenGL 4.5" << std::endl;
+    if (!normalMapFile.empty())
+    {
+        StartupProfiler::Stage stage("normal_map");
+        loadNormalMap();
+    }
+    {
+        StartupProfiler::Stage stage("build_shaders");
+        buildShaders(tiled);
+    }
+
+    // a core profile draws nothing without a vertex array object
+    vao.create();
+    boundaryVao.create();
+    splatVao.create();
+    // the feature lines bind the vertex buffer by direct state access
+    if (gl45) featureVao.create();
+    refinedVao.create();
+
+    // input vertices positions and uv coords.
+    if (!loader && scene.instances.empty() && !tiledMesh && !streamedMesh)
+    {
+        StartupProfiler::Stage stage("expand");
+        prepareMesh();
+    }
+    {
+        StartupProfiler::Stage stage("upload_buffers");
+        uploadBuffers(0, 0);
+    }
+    if (showClip && !loader && scene.instances.empty()) startClip();
+    if (showVolume && !loader && scene.instances.empty()) uploadVolume();
+    if (showTiling && !loader && scene.instances.empty()) uploadTiling();
+
+    if (!scene.instances.empty())
+    {
+        startScene();
+        return;
+    }
+    startTexture();
+}
+
+void GlWidget::startTexture()
+{
+    const std::string file = textureFile();
+    if (file.empty() && !materials.tiled()) return;
+    if (virtualTexturing && gl45 && !materials.tiled())
+    {
+        virtualTexture = new VirtualTexture(file, this);
+        connect(virtualTexture, &VirtualTexture::opened, this, &GlWidget::virtualTextureOpened);
+        connect(virtualTexture, &VirtualTexture::tilesRead, this, &GlWidget::requestFrame);
+        virtualTexture->start();
+    }
+    else loadTexture();
+}
+
+// the text of a shader resource
+static QByteArray readResource(const char * name)
+{
+    QFile file(name);
+    file.open(QIODevice::ReadOnly);
+    return file.readAll();
+}
+
+void GlWidget::buildShaders(bool tiled)
+{
+    // the shaders are written for both backends, only the version differs
+    const QByteArray version = gl45 ? "#version 450 core\n" : "#version 130\n";
+    // the instances of a scene come from a uniform block on the core backend
+    QByteArray vertexSource = version;
+    if (gl45 && !scene.instances.empty()) vertexSource += "#define SCENE_INSTANCES " + QByteArray::number(instancesPerDraw) + "\n";
+    if (lighting) vertexSource += "#define LIGHTING\n";
+    vertexSource += readResource(":/vertexShader.vsh");
+    QByteArray preamble = version;
+    if (lighting) preamble += "#define LIGHTING\n";
+    if (tiled) preamble += "#define VIRTUAL_TEXTURE\n" + readResource(":/virtualTexture.glsl");
+    if (!compareFile.empty()) preamble += "#define ERROR_MAP\n";
+    else if (lighting && normalMap) preamble += "#define NORMAL_MAP\n";
+    // the wireframe takes the distances to the edges from a geometry shader, which 3.0 lacks
+    const bool wireframe = showWireframe && gl45;
+
+    // the sources go through the program binary cache of Qt, keyed by their hash and the driver, so
+    // a later launch loads the linked programs instead of compiling them. only the surface is linked
+    // here, the variants the first frame may not need when they are first drawn, see linkProgram
+    // both programs use the vertex array object, the attributes have fixed locations
+    auto buildSurface = [&](QOpenGLShaderProgram & program, bool wire)
+    {
+        program.removeAllShaders();
+        program.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+        if (wire)
+        {
+            const QByteArray geometrySource = version + (lighting ? "#define LIGHTING\n" : "") + readResource(":/wireframe.gsh");
+            program.addCacheableShaderFromSourceCode(QOpenGLShader::Geometry, geometrySource);
+        }
+        program.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, preamble + (wire ? "#define WIREFRAME\n" : "")
+            + readResource(":/fragmentShader.fsh"));
+        program.bindAttributeLocation("vertex", 0);
+        program.bindAttributeLocation("textureCoordinate", 1);
+        program.bindAttributeLocation("normal", 2);
+    };
+    buildSurface(shaderProgram, wireframe);
+    linkProgram(shaderProgram);
+    // the moving frames skip the geometry shader
+    movingVariant = wireframe && coarseWhileMoving;
+    if (movingVariant) buildSurface(movingProgram, false);
+    else movingProgram.removeAllShaders();
+
+    lineProgram.removeAllShaders();
+    lineProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+    lineProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + readResource(":/lineShader.fsh"));
+    lineProgram.bindAttributeLocation("vertex", 0);
+
+    silhouetteProgram.removeAllShaders();
+    if (gl45)
+    {
+        silhouetteProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+        silhouetteProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Geometry, version + readResource(":/silhouette.gsh"));
+        silhouetteProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + readResource(":/lineShader.fsh"));
+        silhouetteProgram.bindAttributeLocation("vertex", 0);
+    }
+
+    splatProgram.removeAllShaders();
+    const QByteArray splatVersion = version + (lighting ? "#define LIGHTING\n" : "");
+    splatProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, splatVersion + readResource(":/splatShader.vsh"));
+    splatProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, splatVersion + readResource(":/splatShader.fsh"));
+    splatProgram.bindAttributeLocation("vertex", 0);
+    splatProgram.bindAttributeLocation("textureCoordinate", 1);
+    splatProgram.bindAttributeLocation("normal", 2);
+
+    // gl_PrimitiveID needs more than GLSL 1.30, picking is core only
+    pickProgram.removeAllShaders();
+    if (gl45)
+    {
+        pickProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+        pickProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + readResource(":/pickShader.fsh"));
+        pickProgram.bindAttributeLocation("vertex", 0);
+        pickProgram.bindAttributeLocation("textureCoordinate", 1);
+        pickProgram.bindAttributeLocation("normal", 2);
+        // reads the buffers as storage, which 3.0 lacks too
+        resolveProgram.removeAllShaders();
+        resolveProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, version + readResource(":/resolveShader.vsh"));
+        resolveProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, version + (lighting ? "#define LIGHTING\n" : "")
+            + readResource(":/resolveShader.fsh"));
+    }
+
+    feedbackProgram.removeAllShaders();
+    if (!tiled) return;
+    feedbackProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource);
+    feedbackProgram.addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, preamble + readResource(":/feedbackShader.fsh"));
+    feedbackProgram.bindAttributeLocation("vertex", 0);
+    feedbackProgram.bindAttributeLocation("textureCoordinate", 1);
+    feedbackProgram.bindAttributeLocation("normal", 2);
+}
+
+bool GlWidget::linkProgram(QOpenGLShaderProgram & program)
+{
+    if (program.isLinked()) return true;
+    MESHLIB_TRACE_ZONE("linkProgram");
+    QElapsedTimer clock;
+    clock.start();
+    const bool ok = program.link();
+    // a hit in the binary cache links in a fraction of the time of a compile
+    MESHLIB_COUNTER_ADD("gpu.program_links", 1);
+    MESHLIB_COUNTER_ADD("gpu.program_link_us", clock.nsecsElapsed() / 1000);
+    return ok;
+}
+
+void GlWidget::loadNormalMap()
+{
+    if (!lighting || !scene.instances.empty())
+    {
+        std::cout << "The normal map shades a single mesh with --lit" << std::endl;
+        return;
+    }
+    // not compressed, BC1 keeps too little of the directions
+    TextureLoader decoder(normalMapFile, false);
+    const TextureImage image = decoder.decode();
+    if (image.levels.isEmpty())
+    {
+        std::cout << "Failed to load " << normalMapFile << std::endl;
+        return;
+    }
+    normalMap = createImageTexture(image);
+}
+
+void GlWidget::loadTexture()
+{
+    // decoded and mipmapped on a background thread, then streamed in over several frames
+    const bool bc1 = compressTexture && context()->hasExtension("GL_EXT_texture_compression_s3tc");
+    textureTicket = 0;
+    textureLoader = new TextureLoader(textureFile(), bc1, this);
+    if (materials.tiled()) textureLoader->compose(materials);
+    connect(textureLoader, &TextureLoader::textureLoaded, this, &GlWidget::textureLoaded);
+    textureLoader->start();
+}
+
+void GlWidget::findMaterials(const std::string & fname)
+{
+    materials = MaterialAtlas();
+    if (!materials.read(fname) || !materials.tiled()) return;
+    // the uvs of the faces are moved into the cells of their materials as the mesh is read
+    if (!textfile.empty()) std::cout << fname << " has " << materials.size() << " materials, drawn from their maps in place of " << textfile << std::endl;
+    virtualTexturing = false;
+}
+
+std::string GlWidget::textureFile() const
+{
+    if (materials.tiled()) return "";
+    return textfile.empty() ? materials.texture() : textfile;
+}
+
+RenderMesh::Options GlWidget::renderOptions() const
+{
+    RenderMesh::Options o;
+    o.lighting = lighting;
+    o.buildLod = buildLod;
+    o.minLodTriangles = minLodTriangles;
+    o.optimizeOrder = optimizeOrder;
+    o.quantize = vertexFormat == QuantizedVertices;
+    o.splats = showSplats;
+    o.splatDepth = splatDepth;
+    o.patches = patchSize;
+    o.features = showFeatures && gl45;
+    o.creaseAngle = creaseAngle;
+    o.report = printReport;
+    return o;
+}
+
+void GlWidget::expandMesh(ViewerMesh * source)
+{
+    if (source == vMesh)
+    {
+        stopEditing();
+        dropUpload();
+    }
+    expand(source, renderOptions(), source == vMesh);
+}
+
+void GlWidget::writeBuffer(GpuBuffer & buffer, const char * data, int from, int size)
+{
+    // grow geometrically so that streaming stays linear
+    const int capacity = size > buffer.capacity ? std::max(size, 2 * buffer.capacity) : buffer.capacity;
+    if (gl45)
+    {
+        // immutable storage cannot grow, and a full rewrite must not touch what a frame in flight reads,
+        // both get a new buffer
+        if (size > 0 && (size > buffer.capacity || from == 0))
+        {
+            allocateBuffer(buffer, capacity);
+            from = 0;
+        }
+        // coherent, the copy is seen by the next draw without a flush
+        if (from < size) memcpy((char *)buffer.mapped + from, data + from, size - from);
+        return;
+    }
+
+    if (size > buffer.capacity)
+    {
+        allocateBuffer(buffer, capacity);
+        from = 0;
+    }
+    glBindBuffer(buffer.target, buffer.id);
+    if (from < size) glBufferSubData(buffer.target, from, size - from, data + from);
+    glBindBuffer(buffer.target, 0);
+}
+
+template<typename T>
+void GlWidget::streamBuffer(GpuBuffer & buffer, const QVector<T> & data, int from)
+{
+    writeBuffer(buffer, (const char *)data.constData(), from * (int)sizeof(T), data.size() * (int)sizeof(T));
+}
+
+void GlWidget::allocateBuffer(GpuBuffer & buffer, int capacity)
+{
+    if (gl45)
+    {
+        freeBuffer(buffer);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl45->glCreateBuffers(1, &buffer.id);
+        gl45->glNamedBufferStorage(buffer.id, capacity, NULL, flags);
+        buffer.mapped = gl45->glMapNamedBufferRange(buffer.id, 0, capacity, flags);
+    }
+    else
+    {
+        if (!buffer.id) glGenBuffers(1, &buffer.id);
+        glBindBuffer(buffer.target, buffer.id);
+        glBufferData(buffer.target, capacity, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(buffer.target, 0);
+    }
+    // glBufferData replaced the storage of the legacy buffer, freeBuffer dropped the core one
+    MESHLIB_GAUGE_ADD("gpu.buffer_bytes", capacity - buffer.capacity);
+    buffer.capacity = capacity;
+}
+
+void GlWidget::freeBuffer(GpuBuffer & buffer)
+{
+    if (!buffer.id) return;
+    if (buffer.mapped) gl45->glUnmapNamedBuffer(buffer.id);
+    glDeleteBuffers(1, &buffer.id);
+    MESHLIB_GAUGE_ADD("gpu.buffer_bytes", -buffer.capacity);
+    buffer.id = 0;
+    buffer.capacity = 0;
+    buffer.mapped = NULL;
+}
+
+void GlWidget::uploadBuffers(int from, int indexFrom)
+{
+    MESHLIB_TRACE_ZONE("uploadBuffers");
+    if (quantized)
+    {
+        streamBuffer(vertexBuffer, quantizedVertices, from);
+        streamBuffer(uvBuffer, quantizedUvs, from);
+        streamBuffer(normalBuffer, quantizedNormals, from);
+    }
+    else
+    {
+        streamBuffer(vertexBuffer, vertices, from);
+        streamBuffer(uvBuffer, textureCoordinates, from);
+        streamBuffer(normalBuffer, normals, from);
+    }
+    streamBuffer(indexBuffer, indices, indexFrom);
+    buffersWritten(from, indexFrom);
+}
+
+void GlWidget::buffersWritten(int from, int indexFrom)
+{
+    if (quantized) withNormals = !quantizedNormals.isEmpty() && quantizedNormals.size() == quantizedVertices.size();
+    else withNormals = !normals.isEmpty() && normals.size() == vertices.size();
+    indexCount = indices.size();
+    // the levels are complete once the buffers are written from the start, the preview has none
+    if (from == 0 && indexFrom == 0) compute.setMeshlets(meshlets, lods);
+    if (!boundaryPoints.isEmpty())
+    {
+        streamBuffer(boundaryBuffer, boundaryPoints, 0);
+        if (boundaryVao.isCreated())
+        {
+            QOpenGLVertexArrayObject::Binder binder(&boundaryVao);
+            bindBoundary();
+        }
+        boundaryPoints = QVector<QVector3D>();
+    }
+    uploadSplats();
+    if (!featureIndices.isEmpty())
+    {
+        streamBuffer(featureBuffer, featureIndices, 0);
+        featureIndices = QVector<GLuint>();
+    }
+
+    feedbackStale = true;
+
+    // the buffers or the layout may have changed under the vertex array object
+    if (vao.isCreated())
+    {
+        QOpenGLVertexArrayObject::Binder binder(&vao);
+        bindAttributes();
+    }
+    if (featureVao.isCreated() && adjacencyCount > 0) bindFeatures();
+
+    // once the mesh is complete the buffers hold the only copy
+    if (!loader)
+    {
+        vertices = QVector<QVector3D>();
+        textureCoordinates = QVector<QVector2D>();
+        normals = QVector<QVector3D>();
+        quantizedVertices = QVector<QuantizedPosition>();
+        quantizedUvs = QVector<QuantizedUv>();
+        quantizedNormals = QVector<QuantizedNormal>();
+        indices = QVector<GLuint>();
+    }
+}
+
+void GlWidget::drawVisibility(QOpenGLShaderProgram & surface, const QMatrix4x4 & mvp, const QVector3D & eye, uint32_t first, uint32_t count)
+{
+    MESHLIB_TRACE_ZONE("drawVisibility");
+    // the triangles under the pixels, through the attributes of the bound vertex array
+    pickProgram.bind();
+    pickProgram.setUniformValue("mvpMatrix", mvp);
+    pickProgram.setUniformValue("modelMatrix", QMatrix4x4());
+    pickProgram.setUniformValue("positionScale", positionScale);
+    pickProgram.setUniformValue("positionOffset", positionOffset);
+    visibility.begin(viewportWidth, viewportHeight);
+    glDrawElements(GL_TRIANGLES, (GLsizei)(3 * count), GL_UNSIGNED_INT, (const GLvoid *)(3 * sizeof(GLuint) * first));
+    visibility.end(defaultFramebufferObject());
+    pickProgram.release();
+
+    // every covered pixel from the corners of its triangle, read from the buffers bindAttributes points at
+    const bool playing = sequence && sequenceSlot >= 0;
+    const GpuBuffer & positions = playing ? sequencePositions[sequenceSlot] : vertexBuffer;
+    const GpuBuffer & normalsOf = playing && sequenceNormals[sequenceSlot].id ? sequenceNormals[sequenceSlot] : normalBuffer;
+    resolveProgram.bind();
+    resolveProgram.setUniformValue("visibility", 2);
+    resolveProgram.setUniformValue("firstTriangle", (GLuint)first);
+    resolveProgram.setUniformValue("mvpMatrix", mvp);
+    resolveProgram.setUniformValue("inverseMvp", mvp.inverted());
+    resolveProgram.setUniformValue("viewportSize", QVector2D(viewportWidth, viewportHeight));
+    resolveProgram.setUniformValue("positionScale", positionScale);
+    resolveProgram.setUniformValue("positionOffset", positionOffset);
+    resolveProgram.setUniformValue("textureMap", 0);
+    resolveProgram.setUniformValue("withNormals", withNormals);
+    resolveProgram.setUniformValue("eyePosition", eye);
+    gl45->glBindTextureUnit(2, visibility.ids());
+    gl45->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positions.id);
+    gl45->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, uvBuffer.id);
+    gl45->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, indexBuffer.id);
+    gl45->glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, withNormals ? normalsOf.id : 0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    gl45->glBindTextureUnit(2, 0);
+    resolveProgram.release();
+    surface.bind();
+}
+
+void GlWidget::bindAttributes()
+{
+    // integers are passed normalized, the shorts arrive in [-1, 1]
+    const GLuint vertex = (GLuint)shaderProgram.attributeLocation("vertex");
+    const GLuint uv = (GLuint)shaderProgram.attributeLocation("textureCoordinate");
+    const GLenum vertexType = quantized ? GL_SHORT : GL_FLOAT;
+    const GLenum uvType = quantized ? GL_HALF_FLOAT : GL_FLOAT;
+    const GLsizei vertexStride = quantized ? (GLsizei)sizeof(QuantizedPosition) : (GLsizei)sizeof(QVector3D);
+    const GLsizei uvStride = quantized ? (GLsizei)sizeof(QuantizedUv) : (GLsizei)sizeof(QVector2D);
+    // only in the lit programs, left disabled without normals so that they read as zero
+    const GLint normal = shaderProgram.attributeLocation("normal");
+    const GLint normalSize = quantized ? 2 : 3;
+    const GLenum normalType = quantized ? GL_SHORT : GL_FLOAT;
+    const GLsizei normalStride = quantized ? (GLsizei)sizeof(QuantizedNormal) : (GLsizei)sizeof(QVector3D);
+    // the frame of an animation in place of the slots, its normals too when it has them
+    const bool playing = sequence && sequenceSlot >= 0;
+    const GpuBuffer & positions = playing ? sequencePositions[sequenceSlot] : vertexBuffer;
+    const GpuBuffer & normalsOf = playing && sequenceNormals[sequenceSlot].id ? sequenceNormals[sequenceSlot] : normalBuffer;
+
+    if (gl45)
+    {
+        // direct state access, nothing is bound
+        const GLuint id = vao.objectId();
+        gl45->glVertexArrayVertexBuffer(id, 0, positions.id, 0, vertexStride);
+        gl45->glVertexArrayAttribFormat(id, vertex, 3, vertexType, GL_TRUE, 0);
+        gl45->glVertexArrayAttribBinding(id, vertex, 0);
+        gl45->glEnableVertexArrayAttrib(id, vertex);
+        gl45->glVertexArrayVertexBuffer(id, 1, uvBuffer.id, 0, uvStride);
+        gl45->glVertexArrayAttribFormat(id, uv, 2, uvType, GL_TRUE, 0);
+        gl45->glVertexArrayAttribBinding(id, uv, 1);
+        gl45->glEnableVertexArrayAttrib(id, uv);
+        if (normal >= 0 && withNormals)
+        {
+            gl45->glVertexArrayVertexBuffer(id, 2, normalsOf.id, 0, normalStride);
+            gl45->glVertexArrayAttribFormat(id, (GLuint)normal, normalSize, normalType, GL_TRUE, 0);
+            gl45->glVertexArrayAttribBinding(id, (GLuint)normal, 2);
+            gl45->glEnableVertexArrayAttrib(id, (GLuint)normal);
+        }
+        else if (normal >= 0) gl45->glDisableVertexArrayAttrib(id, (GLuint)normal);
+        gl45->glVertexArrayElementBuffer(id, indexBuffer.id);
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, positions.id);
+    glVertexAttribPointer(vertex, 3, vertexType, GL_TRUE, vertexStride, NULL);
+    glEnableVertexAttribArray(vertex);
+
+    glBindBuffer(GL_ARRAY_BUFFER, uvBuffer.id);
+    glVertexAttribPointer(uv, 2, uvType, GL_TRUE, uvStride, NULL);
+    glEnableVertexAttribArray(uv);
+
+    if (normal >= 0 && withNormals)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, normalsOf.id);
+        glVertexAttribPointer((GLuint)normal, normalSize, normalType, GL_TRUE, normalStride, NULL);
+        glEnableVertexAttribArray((GLuint)normal);
+    }
+    else if (normal >= 0) glDisableVertexAttribArray((GLuint)normal);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // stays bound, a vertex array object records it
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer.id);
+}
+
+void GlWidget::bindBoundary()
+{
+    // the attribute location is that of the linked program
+    linkProgram(lineProgram);
+    const GLuint vertex = (GLuint)lineProgram.attributeLocation("vertex");
+    if (gl45)
+    {
+        const GLuint id = boundaryVao.objectId();
+        gl45->glVertexArrayVertexBuffer(id, 0, boundaryBuffer.id, 0, (GLsizei)sizeof(QVector3D));
+        gl45->glVertexArrayAttribFormat(id, vertex, 3, GL_FLOAT, GL_FALSE, 0);
+        gl45->glVertexArrayAttribBinding(id, vertex, 0);
+        gl45->glEnableVertexArrayAttrib(id, vertex);
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, boundaryBuffer.id);
+    glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, (GLsizei)sizeof(QVector3D), NULL);
+    glEnableVertexAttribArray(vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GlWidget::bindFeatures()
+{
+    // the positions as bindAttributes points at them, the creases and the adjacency share the element buffer
+    const GLuint id = featureVao.objectId();
+    const GLuint vertex = 0;
+    gl45->glVertexArrayVertexBuffer(id, 0, vertexBuffer.id, 0, quantized ? (GLsizei)sizeof(QuantizedPosition) : (GLsizei)sizeof(QVector3D));
+    gl45->glVertexArrayAttribFormat(id, vertex, 3, quantized ? GL_SHORT : GL_FLOAT, GL_TRUE, 0);
+    gl45->glVertexArrayAttribBinding(id, vertex, 0);
+    gl45->glEnableVertexArrayAttrib(id, vertex);
+    gl45->glVertexArrayElementBuffer(id, featureBuffer.id);
+}
+
+void GlWidget::prepareMesh()
+{
+    stopEditing();
+    dropUpload();
+    prepare(vMesh, renderOptions());
+}
+
+void GlWidget::compareMesh()
+{
+    if (compareFile.empty() || vMesh->m_mesh()->faces().empty()) return;
+    ViewerMesh other;
+    other.keep_positions = true;
+    other.use_cache = useCache;
+    other.repair = repairInput;
+    other.weld = weldTolerance;
+    other.reorder = reorderInput;
+    other.store = store.enabled() ? &store : NULL;
+    if (other.input_obj(compareFile))
+    {
+        std::cout << "Failed to load " << compareFile << std::endl;
+        return;
+    }
+    QElapsedTimer clock;
+    clock.start();
+    if (!vMesh->keep_positions)
+    {
+        const CPoint c = vMesh->norm_center;
+        const double s = vMesh->norm_scale;
+        other.m_mesh()->parallel_for_vertices([&](CVertex * pv) { pv->point() = (pv->point() - c) * s; });
+        other.m_mesh()->touch_points();
+    }
+    MeshLib::CMeshDistance<CMesh> distance(*vMesh->m_mesh(), "distance");
+    distance.measure(*other.m_mesh());
+    const double largest = distance.max_vertex();
+    for (CFace * pf : vMesh->m_mesh()->faces())
+    {
+        for (CHalfEdge * phe : pf->halfedges_range())
+            phe->uv() = CPoint2(largest > 0 ? distance.distance(phe->vertex()) / largest : 0, 0.5);
+    }
+    vMesh->m_mesh()->remove_vertex_property("distance");
+    // the corners are drawn from the mesh now, the mapped cache has the uvs of the file
+    vMesh->mesh_with_uv = true;
+    vMesh->detach_smv();
+    std::cout << "Distance to " << compareFile << ": Hausdorff " << distance.hausdorff() << ", to it mean "
+              << distance.to().mean() << " rms " << distance.to().rms() << ", from it mean " << distance.from().mean()
+              << " rms " << distance.from().rms() << ", largest at a vertex " << largest << " in "
+              << clock.nsecsElapsed() * 1e-6 << " ms" << std::endl;
+}
+
+bool GlWidget::beginEditing()
+{
+    if (editing) return true;
+    if (loader || uploadingMesh || !sceneMeshes.isEmpty() || showSplats || slicer || !isValid()) return false;
+    CEditMesh * mesh = vMesh->e_mesh();
+    for (CFace * pf : mesh->faces())
+    {
+        if (pf->halfedge()->next()->next()->next() != pf->halfedge()) return false;
+    }
+
+    // the edits move the points, the mapped cache would draw them as read
+    vMesh->detach_smv();
+    mesh->trackChanges(true);
+    editing = true;
+    quantized = false;
+    positionScale = QVector3D(1, 1, 1);
+    positionOffset = QVector3D();
+    lods.clear();
+    meshlets.clear();
+    triangleFaces.clear();
+    boundaryFirst.clear();
+    boundaryCount.clear();
+    adjacencyCount = 0;
+    creaseCount = 0;
+
+    makeCurrent();
+    expandSlots(0, mesh->vertexSlots(), 0, mesh->faceSlots());
+    uploadBuffers(0, 0);
+    updateSubdivision();
+    doneCurrent();
+    requestFrame();
+    return true;
+}
+
+void GlWidget::expandSlots(size_t from, size_t to, size_t faceFrom, size_t faceTo, bool shaded)
+{
+    CEditMesh * mesh = vMesh->e_mesh();
+    const bool lit = lighting && shaded;
+    vertices.resize((int)(to - from));
+    textureCoordinates.resize((int)(to - from));
+    normals.resize(lit ? (int)(to - from) : 0);
+    QVector3D * pos = vertices.data();
+    QVector2D * uv = textureCoordinates.data();
+    QVector3D * nrm = normals.data();
+    MeshLib::parallel_for(to - from, 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            // a free slot is not indexed, it keeps whatever it is given
+            CVertex * pv = mesh->vertexAt(from + i);
+            pos[i] = QVector3D();
+            uv[i] = QVector2D();
+            if (lit) nrm[i] = QVector3D();
+            if (!pv) continue;
+            const CPoint & p = pv->point();
+            pos[i] = QVector3D((float)p[0], (float)p[1], (float)p[2]);
+            CHalfEdge * phe = pv->halfedge();
+            if (phe) uv[i] = QVector2D((float)phe->uv()[0], (float)phe->uv()[1]);
+            if (!lit || !phe) continue;
+            // the corners of one vertex share a normal in the slot layout, weighted by the areas
+            CPoint n(0, 0, 0);
+            for (CFace * pf : pv->faces_range())
+            {
+                CHalfEdge * h = pf->halfedge();
+                const CPoint & a = h->source()->point();
+                n += (h->target()->point() - a) ^ (h->next()->target()->point() - a);
+            }
+            const double l = n.norm();
+            if (l > 0) nrm[i] = QVector3D((float)(n[0] / l), (float)(n[1] / l), (float)(n[2] / l));
+        }
+    });
+
+    // a free face slot is a degenerate triangle
+    indices.resize((int)(3 * (faceTo - faceFrom)));
+    GLuint * idx = indices.data();
+    MeshLib::parallel_for(faceTo - faceFrom, 0, [&](size_t b, size_t e)
+    {
+        for (size_t i = b; i < e; i++)
+        {
+            CFace * pf = mesh->faceAt(faceFrom + i);
+            int k = 0;
+            if (pf) for (CHalfEdge * phe : pf->halfedges_range()) idx[3 * i + k++] = (GLuint)phe->vertex()->property_index();
+            for (; k < 3; k++) idx[3 * i + k] = 0;
+        }
+    });
+}
+
+void GlWidget::patchBuffer(GpuBuffer & buffer, const char * data, int offset, int size)
+{
+    if (size <= 0) return;
+    if (gl45)
+    {
+        memcpy((char *)buffer.mapped + offset, data, size);
+        return;
+    }
+    glBindBuffer(buffer.target, buffer.id);
+    glBufferSubData(buffer.target, offset, size, data);
+    glBindBuffer(buffer.target, 0);
+}
+
+void GlWidget::updateEdits()
+{
+    if (!editing) return;
+    CEditMesh * mesh = vMesh->e_mesh();
+    mesh->takeChanges(editVertices, editFaces, (size_t)editGap);
+    if (editVertices.empty() && editFaces.empty()) return;
+
+    // a moved or relinked vertex turns the normals of its neighbours, and a relinked face those of its corners.
+    // with the compute shaders all normals are summed again on the GPU instead
+    const bool gpuNormals = lighting && compute.available();
+    const bool lit = lighting && !gpuNormals;
+    if (lit)
+    {
+        editNormals.clear();
+        for (const std::pair<size_t, size_t> & r : editVertices)
+        {
+            for (size_t i = r.first; i < r.second; i++)
+            {
+                CVertex * pv = mesh->vertexAt(i);
+                if (!pv) continue;
+                editNormals.push_back(i);
+                if (pv->halfedge()) for (CVertex * pw : pv->vertices_range()) editNormals.push_back(pw->property_index());
+            }
+        }
+        for (const std::pair<size_t, size_t> & r : editFaces)
+        {
+            for (size_t i = r.first; i < r.second; i++)
+            {
+                CFace * pf = mesh->faceAt(i);
+                if (pf) for (CVertex * pv : pf->vertices_range()) editNormals.push_back(pv->property_index());
+            }
+        }
+        std::sort(editNormals.begin(), editNormals.end());
+        editVertices.clear();
+        for (size_t i : editNormals)
+        {
+            if (!editVertices.empty() && i <= editVertices.back().second + (size_t)editGap)
+                editVertices.back().second = std::max(editVertices.back().second, i + 1);
+            else editVertices.push_back(std::make_pair(i, i + 1));
+        }
+    }
+
+    makeCurrent();
+    const size_t nv = mesh->vertexSlots(), nf = mesh->faceSlots();
+    const bool fits = (int)(nv * sizeof(QVector3D)) <= vertexBuffer.capacity && (int)(nv * sizeof(QVector2D)) <= uvBuffer.capacity
+        && (!lighting || (int)(nv * sizeof(QVector3D)) <= normalBuffer.capacity) && (int)(3 * nf * sizeof(GLuint)) <= indexBuffer.capacity;
+    if (!fits)
+    {
+        // the slots outgrew the buffers, they are written again at their new size
+        expandSlots(0, nv, 0, nf);
+        uploadBuffers(0, 0);
+    }
+    else
+    {
+        // the mapped buffers are written in place, not while the last frame may still read them
+        if (gl45 && editFence)
+        {
+            gl45->glClientWaitSync(editFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            gl45->glDeleteSync(editFence);
+            editFence = 0;
+        }
+        for (const std::pair<size_t, size_t> & r : editVertices)
+        {
+            expandSlots(r.first, r.second, 0, 0, lit);
+            const int count = (int)(r.second - r.first);
+            patchBuffer(vertexBuffer, (const char *)vertices.constData(), (int)(r.first * sizeof(QVector3D)), count * (int)sizeof(QVector3D));
+            patchBuffer(uvBuffer, (const char *)textureCoordinates.constData(), (int)(r.first * sizeof(QVector2D)), count * (int)sizeof(QVector2D));
+            if (lit) patchBuffer(normalBuffer, (const char *)normals.constData(), (int)(r.first * sizeof(QVector3D)), count * (int)sizeof(QVector3D));
+        }
+        for (const std::pair<size_t, size_t> & r : editFaces)
+        {
+            expandSlots(0, 0, r.first, r.second);
+            patchBuffer(indexBuffer, (const char *)indices.constData(), (int)(3 * r.first * sizeof(GLuint)), indices.size() * (int)sizeof(GLuint));
+        }
+        indexCount = (int)(3 * nf);
+        if (gpuNormals) compute.computeNormals(vertexBuffer.id, indexBuffer.id, normalBuffer.id, (int)nv, (int)nf);
+        vertices = QVector<QVector3D>();
+        textureCoordinates = QVector<QVector2D>();
+        normals = QVector<QVector3D>();
+        indices = QVector<GLuint>();
+    }
+    updateSubdivision();
+    doneCurrent();
+    feedbackStale = true;
+    requestFrame();
+}
+
+void GlWidget::endEditing()
+{
+    if (!editing) return;
+    prepareMesh();
+    makeCurrent();
+    uploadBuffers(0, 0);
+    doneCurrent();
+    requestFrame();
+}
+
+void GlWidget::stopEditing()
+{
+    if (!editing) return;
+    // the fence of the last frame is left to the next one drawn while editing, or to the destructor
+    editing = false;
+    vMesh->e_mesh()->trackChanges(false);
+    delete subdivision;
+    subdivision = NULL;
+}
+
+void GlWidget::startSequence()
+{
+    const std::vector<std::string> files = MeshSequence::frames(meshfile);
+    if (files.size() < 2)
+    {
+        std::cout << "No other frames numbered as " << meshfile << std::endl;
+        return;
+    }
+    if (!beginEditing())
+    {
+        std::cout << "Only a complete mesh of triangles is played as a sequence" << std::endl;
+        return;
+    }
+
+    // the points of a frame are read in the order of the file, the vertex of point i has id i + 1
+    CEditMesh * mesh = vMesh->e_mesh();
+    int points = 0;
+    for (CVertex * pv : mesh->vertices()) points = std::max(points, pv->id());
+    std::vector<int> slots((size_t)points, -1);
+    for (CVertex * pv : mesh->vertices()) slots[(size_t)pv->id() - 1] = (int)pv->property_index();
+    std::vector<uint32_t> triangles;
+    triangles.reserve(3 * mesh->faces().size());
+    for (CFace * pf : mesh->faces())
+        for (CHalfEdge * phe : pf->halfedges_range()) triangles.push_back((uint32_t)phe->vertex()->property_index());
+
+    sequence = new MeshSequence(files, slots, mesh->vertexSlots(), triangles, lighting, sequenceAhead);
+    sequence->start();
+    sequenceTimer.start(std::max(1, 1000 / sequenceFps));
+    std::cout << "Playing " << files.size() << " frames at " << sequenceFps << " a second" << std::endl;
+}
+
+void GlWidget::advanceSequence()
+{
+    // the refined surface is evaluated from the slot buffers, it stays as it is meanwhile
+    if (!sequence || !editing || subdividing() || !isValid()) return;
+    MeshSequence::Frame frame;
+    if (!sequence->next(frame))
+    {
+        MESHLIB_COUNTER_ADD("sequence.frames_late", 1);
+        return;
+    }
+    MESHLIB_TRACE_ZONE("advanceSequence");
+    makeCurrent();
+    const int next = (sequenceSlot + 1) % sequenceRing;
+    // the buffer of this slot was drawn sequenceRing - 1 frames ago, the GPU is likely done with it
+    GLsync & fence = sequenceFences[next];
+    if (gl45 && fence)
+    {
+        gl45->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        gl45->glDeleteSync(fence);
+        fence = 0;
+    }
+    const int bytes = (int)(frame.positions.size() * sizeof(float));
+    if (sequencePositions[next].capacity < bytes) allocateBuffer(sequencePositions[next], bytes);
+    patchBuffer(sequencePositions[next], (const char *)frame.positions.data(), 0, bytes);
+    if (!frame.normals.empty())
+    {
+        if (sequenceNormals[next].capacity < bytes) allocateBuffer(sequenceNormals[next], bytes);
+        patchBuffer(sequenceNormals[next], (const char *)frame.normals.data(), 0, bytes);
+    }
+    sequenceSlot = next;
+    if (vao.isCreated())
+    {
+        QOpenGLVertexArrayObject::Binder binder(&vao);
+        bindAttributes();
+    }
+    doneCurrent();
+    MESHLIB_COUNTER_ADD("sequence.frames_shown", 1);
+    requestFrame();
+}
+
+void GlWidget::stopSequence()
+{
+    if (!sequence) return;
+    sequenceTimer.stop();
+    delete sequence;
+    sequence = NULL;
+    sequenceSlot = -1;
+    if (!isValid()) return;
+    makeCurrent();
+    for (int i = 0; i < sequenceRing; i++)
+    {
+        if (sequenceFences[i]) gl45->glDeleteSync(sequenceFences[i]);
+        sequenceFences[i] = 0;
+        freeBuffer(sequencePositions[i]);
+        freeBuffer(sequenceNormals[i]);
+    }
+    if (vao.isCreated())
+    {
+        QOpenGLVertexArrayObject::Binder binder(&vao);
+        bindAttributes();
+    }
+    doneCurrent();
+}
+
+void GlWidget::watchMesh()
+{
+    if (!watchFile || meshfile.empty()) return;
+    // a file replaced by a rename is no longer watched, its new one is
+    const QString path = QString::fromStdString(meshfile);
+    if (watcher.files().contains(path)) return;
+    if (!watcher.files().isEmpty()) watcher.removePaths(watcher.files());
+    if (QFileInfo::exists(path)) watcher.addPath(path);
+}
+
+void GlWidget::reloadMesh()
+{
+    // the first load, or a file being replaced, is waited for
+    if (loader || !QFileInfo::exists(QString::fromStdString(meshfile)))
+    {
+        watchTimer.start(watchDelay);
+        return;
+    }
+    watchMesh();
+    MESHLIB_TRACE_ZONE("reloadMesh");
+    QElapsedTimer clock;
+    clock.start();
+    const size_t version = vMesh->m_mesh()->geometry_version();
+    // the frames of a sequence and the distances of a comparison replace what the file has
+    const int ret = sceneMeshes.isEmpty() && !sequence && compareFile.empty() ? vMesh->update_obj(meshfile) : 1;
+    if (ret == 1)
+    {
+        if (!openMesh(meshfile)) return;
+    }
+    else if (ret)
+    {
+        std::cout << "Failed to reload " << meshfile << std::endl;
+        return;
+    }
+    else if (vMesh->m_mesh()->geometry_version() == version) return;
+    else if (beginEditing()) updateEdits();
+    else
+    {
+        // splats and polygons are laid out again, without the parse and the build
+        prepareMesh();
+        makeCurrent();
+        uploadBuffers(0, 0);
+        doneCurrent();
+    }
+    requestFrame();
+    MESHLIB_COUNTER_ADD(ret ? "reload.full" : "reload.patched", 1);
+    MESHLIB_COUNTER_ADD("reload.milliseconds", clock.elapsed());
+    std::cout << (ret ? "Read " : "Patched ") << meshfile << " again in " << clock.elapsed() << " ms" << std::endl;
+}
+
+void GlWidget::startCheckpoints()
+{
+    // the mesh as read is where the checkpoints start from
+    checkpointTopology = vMesh->m_mesh()->topology_version();
+    checkpointGeometry = vMesh->m_mesh()->geometry_version();
+    if (checkpointSeconds > 0 && !checkpointFile.empty()) checkpointTimer.start(checkpointSeconds * 1000);
+}
+
+void GlWidget::saveCheckpoint(bool force)
+{
+    if (checkpointFile.empty() || loader || !sceneMeshes.isEmpty() || vMesh->m_mesh()->vertices().empty()) return;
+    CMesh * mesh = vMesh->m_mesh();
+    if (!force && mesh->topology_version() == checkpointTopology && mesh->geometry_version() == checkpointGeometry) return;
+    if (vMesh->checkpoint_busy())
+    {
+        std::cout << "Checkpoint " << checkpointFile << " still being written, " << (int)(100 * vMesh->checkpoint_progress()) << "%" << std::endl;
+        return;
+    }
+    QElapsedTimer clock;
+    clock.start();
+    vMesh->checkpoint(checkpointFile);
+    checkpointTopology = mesh->topology_version();
+    checkpointGeometry = mesh->geometry_version();
+    MESHLIB_COUNTER_ADD("checkpoint.milliseconds", clock.elapsed());
+    std::cout << "Checkpoint of " << mesh->vertices().size() << " vertices taken in " << clock.elapsed() << " ms, writing "
+              << checkpointFile << std::endl;
+}
+
+void GlWidget::updateSubdivision()
+{
+    if (!editing || !showSubdivision || !compute.available()) return;
+    MESHLIB_TRACE_ZONE("updateSubdivision");
+    CEditMesh * mesh = vMesh->e_mesh();
+    if (!subdivision) subdivision = new MeshLib::CSubdivision<CEditMesh>(*mesh);
+    if (subdivision->stale())
+    {
+        // the editing holds triangles only, the base points are read by their slots
+        subdivision->build(subdivisionLevels, MeshLib::CSubdivision<CEditMesh>::LOOP);
+        const std::vector<uint32_t> & columns = subdivision->inner();
+        std::vector<uint32_t> slots(columns.size());
+        MeshLib::parallel_for(columns.size(), 0, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++) slots[k] = (uint32_t)subdivision->vertex(columns[k])->property_index();
+        });
+        compute.setStencils(subdivision->outer(), slots, subdivision->weights());
+
+        std::vector<uint32_t> triangles;
+        subdivision->triangles(triangles);
+        refinedIndexCount = (int)triangles.size();
+        writeBuffer(refinedIndexBuffer, (const char *)triangles.data(), 0, refinedIndexCount * (int)sizeof(GLuint));
+        const int rows = (int)subdivision->size();
+        if (rows * (int)sizeof(QVector3D) > refinedVertexBuffer.capacity) allocateBuffer(refinedVertexBuffer, rows * (int)sizeof(QVector3D));
+        if (rows * (int)sizeof(QVector2D) > refinedUvBuffer.capacity) allocateBuffer(refinedUvBuffer, rows * (int)sizeof(QVector2D));
+        if (lighting && rows * (int)sizeof(QVector3D) > refinedNormalBuffer.capacity) allocateBuffer(refinedNormalBuffer, rows * (int)sizeof(QVector3D));
+        bindRefined();
+        MESHLIB_GAUGE_SET("render.subdivision_vertices", rows);
+    }
+    compute.subdivide(vertexBuffer.id, refinedVertexBuffer.id, 3);
+    compute.subdivide(uvBuffer.id, refinedUvBuffer.id, 2);
+    if (lighting) compute.computeNormals(refinedVertexBuffer.id, refinedIndexBuffer.id, refinedNormalBuffer.id, compute.stencilRows(), refinedIndexCount / 3);
+}
+
+void GlWidget::bindRefined()
+{
+    // only with the compute shaders, so always on the core backend
+    const GLuint vertex = (GLuint)shaderProgram.attributeLocation("vertex");
+    const GLuint uv = (GLuint)shaderProgram.attributeLocation("textureCoordinate");
+    const GLint normal = shaderProgram.attributeLocation("normal");
+    const GLuint id = refinedVao.objectId();
+    gl45->glVertexArrayVertexBuffer(id, 0, refinedVertexBuffer.id, 0, (GLsizei)sizeof(QVector3D));
+    gl45->glVertexArrayAttribFormat(id, vertex, 3, GL_FLOAT, GL_FALSE, 0);
+    gl45->glVertexArrayAttribBinding(id, vertex, 0);
+    gl45->glEnableVertexArrayAttrib(id, vertex);
+    gl45->glVertexArrayVertexBuffer(id, 1, refinedUvBuffer.id, 0, (GLsizei)sizeof(QVector2D));
+    gl45->glVertexArrayAttribFormat(id, uv, 2, GL_FLOAT, GL_FALSE, 0);
+    gl45->glVertexArrayAttribBinding(id, uv, 1);
+    gl45->glEnableVertexArrayAttrib(id, uv);
+    if (normal >= 0 && lighting)
+    {
+        gl45->glVertexArrayVertexBuffer(id, 2, refinedNormalBuffer.id, 0, (GLsizei)sizeof(QVector3D));
+        gl45->glVertexArrayAttribFormat(id, (GLuint)normal, 3, GL_FLOAT, GL_FALSE, 0);
+        gl45->glVertexArrayAttribBinding(id, (GLuint)normal, 2);
+        gl45->glEnableVertexArrayAttrib(id, (GLuint)normal);
+    }
+    else if (normal >= 0) gl45->glDisableVertexArrayAttrib(id, (GLuint)normal);
+    gl45->glVertexArrayElementBuffer(id, refinedIndexBuffer.id);
+}
+
+void GlWidget::startClip()
+{
+    stopEditing();
+    delete slicer;
+    slicer = NULL;
+    const TMeshLib::CCompactTMesh & tmesh = vMesh->t_mesh();
+    if (tmesh.num_tets() == 0) return;
+
+    // the normal points to the eye, the tets nearer than the plane are clipped. the model
+    // matrix only scales and translates, the direction is the same for the points as read
+    QMatrix4x4 cameraTransformation;
+    cameraTransformation.rotate(alpha, 0, 1, 0);
+    cameraTransformation.rotate(beta, 1, 0, 0);
+    const QVector3D toEye = cameraTransformation * QVector3D(0, 0, 1);
+    slicer = new TMeshLib::CTSlicer(tmesh);
+    slicer->set_normal(CPoint(toEye.x(), toEye.y(), toEye.z()));
+    slicer->set_offset((slicer->min_offset() + slicer->max_offset()) / 2);
+
+    // every point of the tets, normalized as expandMesh does, unlit and in a single level
+    vertices.resize(tmesh.num_vertices());
+    textureCoordinates.fill(QVector2D(), tmesh.num_vertices());
+    normals.clear();
+    const CPoint c = vMesh->keep_positions ? CPoint(0, 0, 0) : vMesh->norm_center;
+    const double s = vMesh->keep_positions ? 1 : vMesh->norm_scale;
+    for (int i = 0; i < tmesh.num_vertices(); i++)
+    {
+        const CPoint p = (tmesh.point(i) - c) * s;
+        vertices[i] = QVector3D((float)p[0], (float)p[1], (float)p[2]);
+    }
+    lods.clear();
+    meshlets.clear();
+    triangleFaces.clear();
+    adjacencyCount = 0;
+    creaseCount = 0;
+    quantized = false;
+    positionScale = QVector3D(1, 1, 1);
+    positionOffset = QVector3D();
+    updateClip(true);
+}
+
+void GlWidget::uploadVolume()
+{
+    // the points as startClip moves them, the volume is drawn with the same matrices
+    const TMeshLib::CCompactTMesh & tmesh = vMesh->t_mesh();
+    std::vector<QVector3D> points(tmesh.num_vertices());
+    const CPoint c = vMesh->keep_positions ? CPoint(0, 0, 0) : vMesh->norm_center;
+    const double s = vMesh->keep_positions ? 1 : vMesh->norm_scale;
+    for (int i = 0; i < tmesh.num_vertices(); i++)
+    {
+        const CPoint p = (tmesh.point(i) - c) * s;
+        points[i] = QVector3D((float)p[0], (float)p[1], (float)p[2]);
+    }
+    volume.upload(points, tmesh.t_vert, vMesh->t_values());
+}
+
+void GlWidget::uploadTiling()
+{
+    if (!tiling.available()) return;
+    QElapsedTimer clock;
+    clock.start();
+    if (!tiling.upload(vMesh->m_mesh(), tilingLength, tilingCount))
+    {
+        std::cout << "The mesh has no uvs whose sides pair up to tile the disk with" << std::endl;
+        return;
+    }
+    std::cout << tiling.tiles() << " tiles of " << tiling.generators() << " side pairings in "
+              << clock.nsecsElapsed() * 1e-6 << " ms" << std::endl;
+}
+
+void GlWidget::updateClip(bool full)
+{
+    // the index buffer is rewritten from the first triangle that changed, the vertices stay
+    const size_t first = slicer->take_changes();
+    const std::vector<int32_t> & tris = slicer->triangles();
+    indices.resize((int)tris.size());
+    std::copy(tris.begin(), tris.end(), indices.begin());
+    uploadBuffers(full ? 0 : vertices.size(), full ? 0 : (int)first);
+}
+
+void GlWidget::uploadSplats()
+{
+    if (splats.points.isEmpty()) return;
+    streamBuffer(splatBuffer, splats.points, 0);
+    if (splatVao.isCreated())
+    {
+        QOpenGLVertexArrayObject::Binder binder(&splatVao);
+        bindSplats();
+    }
+    splats.points = QVector<PointSplats::Splat>();
+}
+
+void GlWidget::bindSplats()
+{
+    linkProgram(splatProgram);
+    const GLuint vertex = (GLuint)splatProgram.attributeLocation("vertex");
+    const GLuint uv = (GLuint)splatProgram.attributeLocation("textureCoordinate");
+    // only the lit program reads the normals
+    const int normal = splatProgram.attributeLocation("normal");
+    const GLsizei stride = (GLsizei)sizeof(PointSplats::Splat);
+    const GLuint normalOffset = (GLuint)offsetof(PointSplats::Splat, normal);
+    if (gl45)
+    {
+        const GLuint id = splatVao.objectId();
+        gl45->glVertexArrayVertexBuffer(id, 0, splatBuffer.id, 0, stride);
+        gl45->glVertexArrayAttribFormat(id, vertex, 3, GL_FLOAT, GL_FALSE, 0);
+        gl45->glVertexArrayAttribFormat(id, uv, 2, GL_FLOAT, GL_FALSE, (GLuint)sizeof(QVector3D));
+        gl45->glVertexArrayAttribBinding(id, vertex, 0);
+        gl45->glVertexArrayAttribBinding(id, uv, 0);
+        gl45->glEnableVertexArrayAttrib(id, vertex);
+        gl45->glEnableVertexArrayAttrib(id, uv);
+        if (normal >= 0)
+        {
+            gl45->glVertexArrayAttribFormat(id, (GLuint)normal, 3, GL_FLOAT, GL_FALSE, normalOffset);
+            gl45->glVertexArrayAttribBinding(id, (GLuint)normal, 0);
+            gl45->glEnableVertexArrayAttrib(id, (GLuint)normal);
+        }
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, splatBuffer.id);
+    glVertexAttribPointer(vertex, 3, GL_FLOAT, GL_FALSE, stride, NULL);
+    glVertexAttribPointer(uv, 2, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)sizeof(QVector3D));
+    glEnableVertexAttribArray(vertex);
+    glEnableVertexAttribArray(uv);
+    if (normal >= 0)
+    {
+        glVertexAttribPointer((GLuint)normal, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid *)(size_t)normalOffset);
+        glEnableVertexAttribArray((GLuint)normal);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GlWidget::loadMesh(const std::string & fname)
+{
+    if (TiledMesh::isTileFile(fname))
+    {
+        loadTiles(fname);
+        return;
+    }
+    if (!meshServer.empty())
+    {
+        connectMesh(fname);
+        return;
+    }
+    // a mesh still loading is dropped, its loader stops at the next batch, or in the build, and
+    // fills vMesh no more
+    bool dropped = false;
+    if (loader)
+    {
+        loader->cancel();
+        loader->wait();
+        delete loader;
+        loader = NULL;
+        dropped = true;
+    }
+    dropUpload();
+    // the preview of fname grows from nothing
+    vertices.clear();
+    textureCoordinates.clear();
+    normals.clear();
+    indices.clear();
+    meshfile = fname;
+    stopSequence();
+    stopEditing();
+    // the slicer points into the tets being replaced
+    delete slicer;
+    slicer = NULL;
+    // a build cut short leaves part of the mesh, the next one starts from an empty one
+    if (dropped)
+    {
+        delete vMesh;
+        vMesh = new ViewerMesh();
+    }
+    vMesh->keep_positions = keepPositions;
+    vMesh->tet_field = volumeField;
+    vMesh->keep_components = (size_t)keepComponents;
+    vMesh->use_cache = useCache;
+    vMesh->repair = repairInput;
+    vMesh->weld = weldTolerance;
+    vMesh->reorder = reorderInput;
+    vMesh->patches = (size_t)patchSize;
+    vMesh->store = store.enabled() ? &store : NULL;
+    vMesh->decimate_ratio = decimateRatio;
+    vMesh->print_report = printReport;
+    vMesh->watch = watchFile;
+    findMaterials(fname);
+    if (isValid() && (materials.tiled() || (textfile.empty() && !materials.texture().empty())))
+    {
+        // the texture on its way is not the one of this mesh
+        if (textureLoader)
+        {
+            textureLoader->requestInterruption();
+            textureLoader->wait();
+            delete textureLoader;
+            textureLoader = NULL;
+        }
+        makeCurrent();
+        if (virtualTexture)
+        {
+            virtualTexture->releaseGL();
+            delete virtualTexture;
+            virtualTexture = NULL;
+            buildShaders(false);
+        }
+        doneCurrent();
+        startTexture();
+    }
+    loadClock.start();
+    renderQueue.clear();
+    loader = new MeshLoader(vMesh, fname, this);
+    loader->render(&renderQueue, renderOptions());
+    connect(loader, &MeshLoader::batchReady, this, &GlWidget::appendBatch);
+    connect(loader, &MeshLoader::meshLoaded, this, &GlWidget::meshLoaded);
+    loader->start();
+}
+
+void GlWidget::appendBatch(const MeshBatch &batch)
+{
+    // the batches of a loader loadMesh replaced may still be queued
+    if (sender() != loader) return;
+    // the preview is not welded, every corner indexes its own vertex, and has one level
+    lods.clear();
+    triangleFaces.clear();
+    boundaryFirst.clear();
+    boundaryCount.clear();
+    adjacencyCount = 0;
+    creaseCount = 0;
+    splats.clear();
+    int from = vertices.size();
+    int indexFrom = indices.size();
+    vertices += batch.positions;
+    textureCoordinates += batch.uvs;
+    indices.resize(vertices.size());
+    for (int i = from; i < vertices.size(); i++) indices[i - from + indexFrom] = (GLuint)i;
+    modelCenter = batch.center;
+    modelScale = batch.scale;
+
+    // batches arriving before initializeGL are uploaded there
+    if (!isValid()) return;
+    makeCurrent();
+    uploadBuffers(from, indexFrom);
+    doneCurrent();
+    requestFrame();
+}
+
+void GlWidget::meshLoaded(int ret)
+{
+    if (sender() != loader) return;
+    loader->wait();
+    delete loader;
+    loader = NULL;
+    if (ret)
+    {
+        std::cout << "Failed to load " << meshfile << std::endl;
+        return;
+    }
+    // the throughput of the loader is loader.bytes over loader.milliseconds
+    MESHLIB_COUNTER_ADD("loader.meshes", 1);
+    MESHLIB_COUNTER_ADD("loader.bytes", QFileInfo(QString::fromStdString(meshfile)).size());
+    MESHLIB_COUNTER_ADD("loader.milliseconds", loadClock.elapsed());
+    countMesh();
+    compareMesh();
+    watchMesh();
+    startCheckpoints();
+
+    // replace the preview by the normalized mesh, laid out on the loader thread unless S
+    // switched between the triangles and the splats meanwhile, or the distances replaced its uvs
+    RenderMesh * prepared = renderQueue.pop();
+    if (prepared && prepared->options.splats == showSplats && compareFile.empty())
+    {
+        // the preview is drawn until the upload thread has the buffers, see resourcesUploaded
+        if (uploader && isValid())
+        {
+            startUpload(std::shared_ptr<RenderMesh>(prepared));
+            return;
+        }
+        RenderMesh::operator=(std::move(*prepared));
+    }
+    else prepareMesh();
+    delete prepared;
+    showLoadedMesh();
+}
+
+void GlWidget::showLoadedMesh()
+{
+    resetModelTransform();
+    if (!isValid()) return;
+    makeCurrent();
+    StartupProfiler & startup = StartupProfiler::instance();
+    const qint64 start = startup.now();
+    uploadBuffers(0, 0);
+    startup.record("upload_buffers", start);
+    if (showClip) startClip();
+    if (showVolume) uploadVolume();
+    if (showTiling) uploadTiling();
+    doneCurrent();
+    if (sequenceFps > 0) startSequence();
+    requestFrame();
+}
+
+// an array of a mesh as the upload thread copies it
+template<typename T>
+static GpuUploader::Span uploadSpan(const QVector<T> & data)
+{
+    return GpuUploader::Span{ data.constData(), data.size() * (int)sizeof(T) };
+}
+
+void GlWidget::startUpload(std::shared_ptr<RenderMesh> mesh)
+{
+    // in the order of the buffers resourcesUploaded swaps in, the mesh keeps the arrays alive until they are copied
+    QVector<GpuUploader::Span> spans;
+    if (mesh->quantized)
+        spans << uploadSpan(mesh->quantizedVertices) << uploadSpan(mesh->quantizedUvs) << uploadSpan(mesh->quantizedNormals);
+    else
+        spans << uploadSpan(mesh->vertices) << uploadSpan(mesh->textureCoordinates) << uploadSpan(mesh->normals);
+    spans << uploadSpan(mesh->indices);
+    uploadingMesh = mesh;
+    meshTicket = ++uploadTicket;
+    uploadStart = StartupProfiler::instance().now();
+    uploader->upload(meshTicket, spans, mesh);
+}
+
+void GlWidget::dropUpload()
+{
+    uploadingMesh.reset();
+    meshTicket = 0;
+}
+
+void GlWidget::resourcesUploaded(const UploadedResources & uploaded)
+{
+    // the context went with the widget, and the objects of its share group with it
+    if (!isValid()) return;
+    UploadedResources resources = uploaded;
+    makeCurrent();
+    // the draws from here on wait for the copies on the GPU, this thread does not
+    gl45->glWaitSync(resources.fence, 0, GL_TIMEOUT_IGNORED);
+    gl45->glDeleteSync(resources.fence);
+    resources.fence = 0;
+
+    if (resources.ticket == meshTicket && uploadingMesh)
+    {
+        RenderMesh::operator=(std::move(*uploadingMesh));
+        dropUpload();
+        GpuBuffer * targets[] = { &vertexBuffer, &uvBuffer, &normalBuffer, &indexBuffer };
+        for (int k = 0; k < 4; k++)
+        {
+            // an empty array leaves the buffer as it is, as writeBuffer does
+            if (!resources.buffers[k]) continue;
+            freeBuffer(*targets[k]);
+            targets[k]->id = resources.buffers[k];
+            targets[k]->capacity = resources.capacities[k];
+            targets[k]->mapped = resources.mapped[k];
+        }
+        resetModelTransform();
+        buffersWritten(0, 0);
+        StartupProfiler::instance().record("upload_buffers", uploadStart);
+        if (showClip) startClip();
+        if (showVolume) uploadVolume();
+        if (showTiling) uploadTiling();
+        doneCurrent();
+        if (sequenceFps > 0) startSequence();
+        requestFrame();
+        return;
+    }
+    if (resources.ticket == textureTicket && resources.texture)
+    {
+        glDeleteTextures(1, &texture);
+        texture = resources.texture;
+        textureTicket = 0;
+        pendingTexture = TextureImage();
+        pendingLevel = -1;
+        textureReady = true;
+        countTexture(resources.textureBytes);
+        StartupProfiler::instance().record("texture_upload", textureStart);
+        doneCurrent();
+        requestFrame();
+        return;
+    }
+
+    // a mesh or a texture replaced while it was copied
+    GpuUploader::release(gl45, resources);
+    doneCurrent();
+}
+
+bool GlWidget::openMesh(const std::string & fname)
+{
+    // a fresh mesh, the previous one and its mapped cache are dropped
+    meshfile = fname;
+    dropUpload();
+    stopSequence();
+    stopEditing();
+    delete slicer;
+    slicer = NULL;
+    delete vMesh;
+    vMesh = new ViewerMesh();
+    vMesh->keep_positions = keepPositions;
+    vMesh->tet_field = volumeField;
+    vMesh->keep_components = (size_t)keepComponents;
+    vMesh->use_cache = useCache;
+    vMesh->repair = repairInput;
+    vMesh->weld = weldTolerance;
+    vMesh->reorder = reorderInput;
+    vMesh->patches = (size_t)patchSize;
+    vMesh->store = store.enabled() ? &store : NULL;
+    vMesh->decimate_ratio = decimateRatio;
+    vMesh->print_report = printReport;
+    vMesh->watch = watchFile;
+    findMaterials(fname);
+    modelCenter = QVector3D();
+    modelScale = 1;
+    if (ViewerMesh::is_tet_file(fname) ? vMesh->input_tet(fname) : vMesh->input_obj(fname))
+    {
+        std::cout << "Failed to load " << fname << std::endl;
+        return false;
+    }
+    countMesh();
+    compareMesh();
+    resetModelTransform();
+    watchMesh();
+    startCheckpoints();
+
+    // expanded by initializeGL if there is no context yet
+    if (!isValid()) return true;
+    prepareMesh();
+    makeCurrent();
+    uploadBuffers(0, 0);
+    if (showClip) startClip();
+    if (showVolume) uploadVolume();
+    if (showTiling) uploadTiling();
+    doneCurrent();
+    return true;
+}
+
+bool GlWidget::openTexture(const std::string & fname)
+{
+    textfile = fname;
+    textureTicket = 0;
+    if (!isValid()) return false;
+    makeCurrent();
+    glDeleteTextures(1, &texture);
+    countTexture(0);
+    texture = 0;
+    textureReady = false;
+    const std::string file = textureFile();
+    bool ok = file.empty() && !materials.tiled();
+    if (!ok)
+    {
+        const bool bc1 = compressTexture && context()->hasExtension("GL_EXT_texture_compression_s3tc");
+        TextureLoader decoder(file, bc1);
+        if (materials.tiled()) decoder.compose(materials);
+        pendingTexture = decoder.decode();
+        ok = !pendingTexture.levels.isEmpty();
+        if (ok)
+        {
+            createTexture();
+            finishTexture();
+        }
+        else std::cout << "Failed to load " << (file.empty() ? "the materials of " + meshfile : file) << std::endl;
+    }
+    doneCurrent();
+    return ok;
+}
+
+QImage GlWidget::renderView(double a, double b, double d)
+{
+    alpha = a;
+    beta = b;
+    distance = d;
+    // QOpenGLWidget draws into its framebuffer object on an offscreen surface of its own,
+    // creating the context on the first call
+    return grabFramebuffer();
+}
+
+void GlWidget::startOffscreen(int width, int height)
+{
+    // the feedback of a virtual texture would need frames that are never drawn here
+    virtualTexturing = false;
+    resize(width, height);
+}
+
+bool GlWidget::uploadMesh(const std::string & fname)
+{
+    if (!openMesh(fname)) return false;
+    // the first grab creates the context, the programs and the buffers of the mesh
+    if (!isValid()) grabFramebuffer();
+    return true;
+}
+
+void GlWidget::startTiming()
+{
+    profiler.startRecording();
+}
+
+bool GlWidget::stopTiming(std::vector<FrameTime> & frames)
+{
+    // the queries of the frames still in flight are read with the context current
+    makeCurrent();
+    profiler.stopRecording();
+    doneCurrent();
+    frames.clear();
+    for (const FrameProfiler::Sample & s : profiler.samples()) frames.push_back(FrameTime{ s.cpu, s.gpu });
+    return profiler.gpuTimed();
+}
+
+void GlWidget::textureLoaded(const TextureImage &image)
+{
+    // a loader loadMesh replaced may have queued its texture before it stopped
+    if (sender() != textureLoader) return;
+    textureLoader->wait();
+    delete textureLoader;
+    textureLoader = NULL;
+    if (image.levels.isEmpty())
+    {
+        std::cout << "Failed to load " << (materials.tiled() ? "the materials of " + meshfile : textureFile()) << std::endl;
+        return;
+    }
+
+    // created whole on the upload thread, the frames go on with the texture they have, see resourcesUploaded
+    if (uploader)
+    {
+        textureTicket = ++uploadTicket;
+        textureStart = StartupProfiler::instance().now();
+        uploader->upload(textureTicket, image);
+        return;
+    }
+    pendingTexture = image;
+    makeCurrent();
+    {
+        StartupProfiler::Stage stage("bind_texture");
+        createTexture();
+    }
+    doneCurrent();
+    requestFrame();
+}
+
+void GlWidget::virtualTextureOpened(bool ok)
+{
+    makeCurrent();
+    if (ok)
+    {
+        virtualTexture->initializeGL(gl45);
+        feedbackStale = true;
+        doneCurrent();
+        requestFrame();
+        return;
+    }
+
+    // without its tiles the texture is loaded whole
+    std::cout << "Failed to tile " << textureFile() << std::endl;
+    delete virtualTexture;
+    virtualTexture = NULL;
+    buildShaders(false);
+    doneCurrent();
+    loadTexture();
+}
+
+void GlWidget::loadTiles(const std::string & fname)
+{
+    meshfile = fname;
+    materials = MaterialAtlas();
+    if (tiledMesh)
+    {
+        if (isValid())
+        {
+            makeCurrent();
+            tiledMesh->releaseGL();
+            doneCurrent();
+        }
+        delete tiledMesh;
+    }
+    tiledMesh = new TiledMesh(fname, this);
+    tiledMesh->memory_budget = (size_t)std::max(tileMemory, 1) << 20;
+    if (!tiledMesh->open())
+    {
+        std::cout << "Failed to load " << fname << std::endl;
+        delete tiledMesh;
+        tiledMesh = NULL;
+        return;
+    }
+    // the points are drawn as they are, normalized by the model matrix as keepPositions does
+    const QVector3D lo = tiledMesh->lower(), hi = tiledMesh->upper(), size = hi - lo;
+    modelCenter = (lo + hi) / 2;
+    modelScale = 2 / std::max(std::max(size.x(), size.y()), std::max(size.z(), 1e-30f));
+    positionScale = QVector3D(1, 1, 1);
+    positionOffset = QVector3D();
+    quantized = false;
+    // the texture is sampled whole, there is no feedback pass over the tiles
+    virtualTexturing = false;
+    connect(tiledMesh, &TiledMesh::tilesRead, this, &GlWidget::requestFrame);
+    tiledMesh->start();
+
+    // initializeGL creates the vertex array if there is no context yet
+    if (!isValid()) return;
+    if (!gl45) std::cout << "The tiled mesh needs OpenGL 4.5" << std::endl;
+    makeCurrent();
+    if (gl45) tiledMesh->initializeGL(gl45);
+    doneCurrent();
+    requestFrame();
+}
+
+void GlWidget::connectMesh(const std::string & name)
+{
+    meshfile = name;
+    materials = MaterialAtlas();
+    if (streamedMesh)
+    {
+        if (isValid())
+        {
+            makeCurrent();
+            streamedMesh->releaseGL();
+            doneCurrent();
+        }
+        delete streamedMesh;
+    }
+    streamedMesh = new StreamedMesh(this);
+    if (!streamedMesh->open(meshServer, name))
+    {
+        std::cout << "Cannot connect to " << meshServer << std::endl;
+        delete streamedMesh;
+        streamedMesh = NULL;
+        return;
+    }
+    // the positions arrive quantized in the bounds of the header, normalized by the model matrix
+    connect(streamedMesh, &StreamedMesh::meshOpened, this, [this]()
+    {
+        const QVector3D lo = streamedMesh->lower(), hi = streamedMesh->upper(), size = hi - lo;
+        modelCenter = (lo + hi) / 2;
+        modelScale = 2 / std::max(std::max(size.x(), size.y()), std::max(size.z(), 1e-30f));
+        positionScale = streamedMesh->positionScale();
+        positionOffset = streamedMesh->positionOffset();
+        quantized = true;
+        requestFrame();
+    });
+    connect(streamedMesh, &StreamedMesh::meshReceived, this, &GlWidget::requestFrame);
+    // the texture is sampled whole, there is no feedback pass over the stream
+    virtualTexturing = false;
+
+    // initializeGL creates the vertex array if there is no context yet
+    if (!isValid()) return;
+    if (!gl45) std::cout << "The streamed mesh needs OpenGL 4.5" << std::endl;
+    makeCurrent();
+    if (gl45) streamedMesh->initializeGL(gl45);
+    doneCurrent();
+    requestFrame();
+}
+
+bool GlWidget::loadScene(const std::string & fname)
+{
+    Scene s;
+    return s.read(fname) && showScene(s);
+}
+
+bool GlWidget::showScene(const Scene & s)
+{
+    if (s.instances.empty()) return false;
+    scene = s;
+    // every mesh has its own texture
+    virtualTexturing = false;
+    if (!isValid()) return true;
+
+    // the programs take the instances from the scene
+    delete sceneLoader;
+    sceneLoader = NULL;
+    renderQueue.clear();
+    dropUpload();
+    makeCurrent();
+    for (const SceneMesh & mesh : sceneMeshes) glDeleteTextures(1, &mesh.texture);
+    buildShaders(false);
+    doneCurrent();
+    startScene();
+    return true;
+}
+
+void GlWidget::startScene()
+{
+    sceneMeshes.clear();
+    sceneMeshes.resize((int)scene.meshes.size());
+    for (size_t i = 0; i < scene.instances.size(); i++) sceneMeshes[scene.instances[i].mesh].instances.append((int)i);
+    sceneLods.clear();
+    sceneGeometry = SceneGeometry();
+    // the instance matrices decode the positions of every mesh
+    positionScale = QVector3D(1, 1, 1);
+    positionOffset = QVector3D();
+
+    const bool bc1 = compressTexture && context()->hasExtension("GL_EXT_texture_compression_s3tc");
+    sceneLoader = new SceneLoader(scene, bc1, this);
+    sceneLoader->render(&renderQueue, renderOptions());
+    sceneLoader->preprocess(useCache, decimateRatio, store.enabled() ? &store : NULL);
+    connect(sceneLoader, &SceneLoader::meshRead, this, &GlWidget::sceneMeshRead);
+    connect(sceneLoader, &SceneLoader::sceneLoaded, this, &GlWidget::sceneLoaded);
+    sceneLoader->start();
+}
+
+void GlWidget::sceneMeshRead(int index, int ret)
+{
+    if (ret)
+    {
+        std::cout << "Failed to load " << scene.meshes[index].meshfile << std::endl;
+        return;
+    }
+    // laid out on the loader thread, the signals of the meshes pushed with it may still be queued
+    int read;
+    while (RenderMesh * source = renderQueue.pop(&read))
+    {
+        addSceneMesh(read, *source);
+        delete source;
+    }
+}
+
+void GlWidget::addSceneMesh(int index, const RenderMesh & source)
+{
+    // the levels and the indices follow those of the meshes before
+    SceneMesh & mesh = sceneMeshes[index];
+    SceneGeometry & g = sceneGeometry;
+    const GLuint base = (GLuint)(source.quantized ? g.quantizedVertices.size() : g.vertices.size());
+    mesh.firstLod = sceneLods.size();
+    mesh.lodCount = source.lods.size();
+    for (LodLevel lod : source.lods)
+    {
+        lod.offset += g.indices.size();
+        lod.firstMeshlet = lod.meshletCount = 0;
+        sceneLods.append(lod);
+    }
+    const int from = g.indices.size();
+    g.indices.resize(from + source.indices.size());
+    for (int i = 0; i < source.indices.size(); i++) g.indices[from + i] = source.indices[i] + base;
+    g.vertices += source.vertices;
+    g.textureCoordinates += source.textureCoordinates;
+    g.normals += source.normals;
+    g.quantizedVertices += source.quantizedVertices;
+    g.quantizedUvs += source.quantizedUvs;
+    g.quantizedNormals += source.quantizedNormals;
+    quantized = source.quantized;
+
+    // the instance matrices undo the quantization of each mesh, the shader decodes nothing
+    mesh.decode.setToIdentity();
+    mesh.decode.translate(source.positionOffset);
+    mesh.decode.scale(source.positionScale);
+
+    const TextureImage image = sceneLoader->takeTexture(index);
+    if (image.levels.isEmpty()) return;
+    makeCurrent();
+    mesh.texture = createImageTexture(image);
+    doneCurrent();
+}
+
+void GlWidget::sceneLoaded()
+{
+    sceneLoader->wait();
+    delete sceneLoader;
+    sceneLoader = NULL;
+    makeCurrent();
+
+    // the instances of a mesh in a row, from an offset a uniform block can be bound at
+    GLint alignment = (GLint)(16 * sizeof(GLfloat));
+    if (gl45) glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const int step = std::max(1, alignment / (int)(16 * sizeof(GLfloat)));
+    instanceMatrices.clear();
+    for (SceneMesh & mesh : sceneMeshes)
+    {
+        while (instanceMatrices.size() % step) instanceMatrices.append(QMatrix4x4());
+        mesh.firstInstance = instanceMatrices.size();
+        mesh.instanceCount = mesh.instances.size();
+        for (int i : mesh.instances) instanceMatrices.append(scene.instances[i].transform() * mesh.decode);
+    }
+    sceneMatrix = scene.fit();
+
+    // the scene replaces the mesh in the buffers
+    vertices.swap(sceneGeometry.vertices);
+    textureCoordinates.swap(sceneGeometry.textureCoordinates);
+    normals.swap(sceneGeometry.normals);
+    quantizedVertices.swap(sceneGeometry.quantizedVertices);
+    quantizedUvs.swap(sceneGeometry.quantizedUvs);
+    quantizedNormals.swap(sceneGeometry.quantizedNormals);
+    indices.swap(sceneGeometry.indices);
+    sceneGeometry = SceneGeometry();
+    lods.clear();
+    meshlets.clear();
+    uploadBuffers(0, 0);
+
+    if (gl45)
+    {
+        QVector<GLfloat> matrices(16 * (instanceMatrices.size() + instancesPerDraw), 0.0f);
+        for (int i = 0; i < instanceMatrices.size(); i++) memcpy(&matrices[16 * i], instanceMatrices[i].constData(), 16 * sizeof(GLfloat));
+        streamBuffer(instanceBuffer, matrices, 0);
+    }
+    if (occlusion.available() || impostors.available())
+    {
+        // a region of every frame of the ring, each as large as the instance buffer, then the
+        // matrices of its captures, a block bound from each, the last one padded as the instances
+        for (GLsync & fence : visibleFences)
+        {
+            if (fence) gl45->glDeleteSync(fence);
+            fence = 0;
+        }
+        captureStride = (int)(16 * sizeof(GLfloat)) * step;
+        captureCount = impostors.available() ? std::max(impostorBudget, 0) : 0;
+        visibleRegionBytes = (int)(16 * sizeof(GLfloat)) * (instanceMatrices.size() + instancesPerDraw + step);
+        visibleRegionBytes -= visibleRegionBytes % captureStride;
+        captureOffset = visibleRegionBytes;
+        if (captureCount) visibleRegionBytes += (captureCount + (instancesPerDraw + step - 1) / step) * captureStride;
+        allocateBuffer(visibleBuffer, visibleRing * visibleRegionBytes);
+        visibleRegion = 0;
+        impostors.reset(instanceMatrices.size());
+    }
+    doneCurrent();
+    std::cout << scene.instances.size() << " instances of " << scene.meshes.size() << " meshes" << std::endl;
+    requestFrame();
+}
+
+GLuint GlWidget::createImageTexture(const TextureImage & image)
 {
-    alpha = 0;
-    beta = 0;
-    distance = 2.5;
-    vMesh = new ViewerMesh();
+    const int levels = image.levels.size();
+    const GLenum format = image.compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+    GLuint id = 0;
+    if (gl45)
+    {
+        gl45->glCreateTextures(GL_TEXTURE_2D, 1, &id);
+        gl45->glTextureStorage2D(id, levels, format, image.width, image.height);
+        for (int l = 0; l < levels; l++)
+        {
+            const int w = std::max(1, image.width >> l), h = std::max(1, image.height >> l);
+            const QByteArray & data = image.levels[l];
+            if (image.compressed) gl45->glCompressedTextureSubImage2D(id, l, 0, 0, w, h, format, data.size(), data.constData());
+            else gl45->glTextureSubImage2D(id, l, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data.constData());
+        }
+        gl45->glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        gl45->glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return id;
+    }
+
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    for (int l = 0; l < levels; l++)
+    {
+        const int w = std::max(1, image.width >> l), h = std::max(1, image.height >> l);
+        const QByteArray & data = image.levels[l];
+        if (image.compressed) glCompressedTexImage2D(GL_TEXTURE_2D, l, format, w, h, 0, data.size(), data.constData());
+        else glTexImage2D(GL_TEXTURE_2D, l, format, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.constData());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return id;
 }
 
-GlWidget::~GlWidget()
+void GlWidget::createTexture()
 {
+    MESHLIB_TRACE_ZONE("createTexture");
+    const TextureImage & t = pendingTexture;
+    const int levels = t.levels.size();
+    const GLenum format = t.compressed ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+    glDeleteTextures(1, &texture);
+    if (gl45)
+    {
+        gl45->glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        gl45->glTextureStorage2D(texture, levels, format, t.width, t.height);
+        gl45->glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        gl45->glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        gl45->glTextureParameteri(texture, GL_TEXTURE_BASE_LEVEL, levels - 1);
+    }
+    else
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        for (int l = 0; l < levels; l++)
+        {
+            const int w = std::max(1, t.width >> l), h = std::max(1, t.height >> l);
+            if (t.compressed) glCompressedTexImage2D(GL_TEXTURE_2D, l, format, w, h, 0, t.levels[l].size(), NULL);
+            else glTexImage2D(GL_TEXTURE_2D, l, format, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    pendingLevel = levels - 1;
+    pendingRow = 0;
+    textureReady = false;
+    textureStart = StartupProfiler::instance().now();
+    qint64 bytes = 0;
+    for (const QByteArray & level : t.levels) bytes += level.size();
+    countTexture(bytes);
 }
 
-QSize GlWidget::sizeHint() const
+void GlWidget::countTexture(qint64 bytes)
 {
-    return QSize(640, 480);
+    MESHLIB_GAUGE_ADD("gpu.texture_bytes", bytes - textureBytes);
+    textureBytes = bytes;
 }
 
-//! [1]
-void GlWidget::initializeGL()
+void GlWidget::countMesh()
 {
-    //! [1]
-    //! [2]
-#ifdef WIN32
-    glActiveTexture = (PFNGLACTIVETEXTUREPROC)wglGetProcAddress((LPCSTR) "glActiveTexture");
-#endif
-    //! [2]
+    CMesh * mesh = vMesh ? vMesh->m_mesh() : NULL;
+    MESHLIB_GAUGE_SET("mesh.memory_bytes", mesh ? mesh->memory_report().total() : 0);
+}
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
+bool GlWidget::uploadTexture()
+{
+    if (pendingLevel < 0) return false;
+    MESHLIB_TRACE_ZONE("uploadTexture");
+    if (uploadFence)
+    {
+        // the staging buffer is read until the previous copy has run, try again next frame
+        if (gl45->glClientWaitSync(uploadFence, 0, 0) == GL_TIMEOUT_EXPIRED) return true;
+        gl45->glDeleteSync(uploadFence);
+        uploadFence = 0;
+    }
 
-    qglClearColor(QColor(Qt::white));
+    // whole rows, of blocks when compressed, up to the budget
+    const TextureImage & t = pendingTexture;
+    const int w = std::max(1, t.width >> pendingLevel), h = std::max(1, t.height >> pendingLevel);
+    const int unit = t.compressed ? 4 : 1;
+    const int unitBytes = t.compressed ? 8 * ((w + 3) / 4) : 4 * w;
+    const int rows = std::min(h - pendingRow, unit * std::max(1, textureUploadBudget / unitBytes));
+    const int bytes = (rows + unit - 1) / unit * unitBytes;
+    const char * src = t.levels[pendingLevel].constData() + (size_t)(pendingRow / unit) * unitBytes;
+    const GLenum format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
 
-    shaderProgram.addShaderFromSourceFile(QGLShader::Vertex, ":/vertexShader.vsh");
-    shaderProgram.addShaderFromSourceFile(QGLShader::Fragment, ":/fragmentShader.fsh");
-    shaderProgram.link();
+    if (gl45)
+    {
+        if (stagingBuffer.capacity < bytes) allocateBuffer(stagingBuffer, std::max(bytes, textureUploadBudget));
+        memcpy(stagingBuffer.mapped, src, bytes);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer.id);
+        if (t.compressed) gl45->glCompressedTextureSubImage2D(texture, pendingLevel, 0, pendingRow, w, rows, format, bytes, NULL);
+        else gl45->glTextureSubImage2D(texture, pendingLevel, 0, pendingRow, w, rows, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        uploadFence = gl45->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    else
+    {
+        // respecified every time, the driver keeps the old contents while a copy reads them
+        if (!stagingBuffer.id) glGenBuffers(1, &stagingBuffer.id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer.id);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, src, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (t.compressed) glCompressedTexSubImage2D(GL_TEXTURE_2D, pendingLevel, 0, pendingRow, w, rows, format, bytes, NULL);
+        else glTexSubImage2D(GL_TEXTURE_2D, pendingLevel, 0, pendingRow, w, rows, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
 
-    // input vertices positions and uv coords.
-    for (CFace * pf : vMesh->m_mesh()->faces())
+    // sampling starts at a level once it is complete
+    pendingRow += rows;
+    const bool complete = pendingRow == h;
+    if (complete)
+    {
+        if (gl45) gl45->glTextureParameteri(texture, GL_TEXTURE_BASE_LEVEL, pendingLevel);
+        else glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, pendingLevel);
+        textureReady = true;
+        pendingRow = 0;
+        pendingLevel--;
+    }
+    if (!gl45) glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (pendingLevel >= 0) return true;
+    pendingTexture = TextureImage();
+    // the levels are copied over several frames, up to textureUploadBudget bytes each
+    StartupProfiler::instance().record("texture_upload", textureStart);
+    return false;
+}
+
+void GlWidget::finishTexture()
+{
+    while (uploadTexture())
+    {
+        if (uploadFence) gl45->glClientWaitSync(uploadFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    }
+}
+
+void GlWidget::resizeGL(int width, int height)
+{
+    if (height == 0) {
+        height = 1;
+    }
+
+    // the views side by side, in device pixels from the bottom left as glViewport takes them, a
+    // view added since starts from the camera of the active one
+    const int count = std::max(viewportCount, 1);
+    const int w = (int)(width * devicePixelRatioF()), h = (int)(height * devicePixelRatioF());
+    if (activeView >= count) selectView(0);
+    const int before = views.size();
+    views.resize(count);
+    for (int k = 0; k < count; k++)
+    {
+        Viewport & view = views[k];
+        if (k >= before)
+        {
+            view.alpha = alpha;
+            view.beta = beta;
+            view.distance = distance;
+        }
+        view.rect = QRect(k * w / count, 0, (k + 1) * w / count - k * w / count, h);
+        view.projection.setToIdentity();
+        view.projection.perspective(60.0, (float)std::max(view.rect.width(), 1) / (float)h, 0.001, 1000);
+        view.lod = k < (int)viewportLods.size() ? viewportLods[k] : -1;
+    }
+    pMatrix = views[activeView].projection;
+    viewportWidth = views[activeView].rect.width();
+    viewportHeight = h;
+}
+
+int GlWidget::viewAt(const QPoint & position) const
+{
+    const int x = (int)(position.x() * devicePixelRatioF());
+    for (int k = 0; k < views.size(); k++)
+        if (x < views[k].rect.right() + 1) return k;
+    return std::max(views.size() - 1, 0);
+}
+
+void GlWidget::selectView(int view)
+{
+    if (view == activeView || view >= views.size()) return;
+    // the camera of the view left is kept, that of the view taken is the one moved from now on
+    Viewport & from = views[activeView];
+    from.alpha = alpha;
+    from.beta = beta;
+    from.distance = distance;
+    activeView = view;
+    const Viewport & to = views[view];
+    if (!linkCameras)
+    {
+        alpha = to.alpha;
+        beta = to.beta;
+        distance = to.distance;
+    }
+    pMatrix = to.projection;
+    viewportWidth = to.rect.width();
+    viewportHeight = to.rect.height();
+}
+
+void GlWidget::cullScene(const QMatrix4x4 & mvp, const QVector3D & eye)
+{
+    sceneCulled = false;
+    if ((!occlusion.ready() && !impostors.available()) || !visibleBuffer.mapped) return;
+    MESHLIB_TRACE_ZONE("cullScene");
+    // the region was drawn from visibleRing frames ago, the GPU is likely done with it
+    visibleRegion = (visibleRegion + 1) % visibleRing;
+    GLsync & fence = visibleFences[visibleRegion];
+    if (fence)
+    {
+        gl45->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        gl45->glDeleteSync(fence);
+        fence = 0;
+    }
+    GLfloat * region = (GLfloat *)((char *)visibleBuffer.mapped + visibleRegion * visibleRegionBytes);
+    // the scene meshes are normalized into [-1, 1]^3, as selectSceneLod takes them
+    const float radius = std::sqrt(3.0f);
+    // the pixels of a unit at distance 1, as in selectSceneLod, and the widest instance an image stands for
+    const float pixels = viewportHeight * std::sqrt(3.0f) / 2;
+    const float widest = (float)std::min(impostorPixels, ImpostorAtlas::cellSize);
+    impostors.begin(impostorAngle);
+    int occluded = 0;
+    int distant = 0;
+    for (SceneMesh & mesh : sceneMeshes)
     {
-        for (CHalfEdge * phe : pf->halfedges())
+        mesh.visibleCount = 0;
+        GLfloat * out = region + 16 * mesh.firstInstance;
+        for (int k = 0; k < mesh.instanceCount; k++)
         {
-            CVertex * pv = phe->vertex();
-            QVector3D pos;
-            QVector2D qt_uv;
-            for (int i = 0; i < 3; i++)
+            const Scene::Instance & instance = scene.instances[mesh.instances[k]];
+            const float r = radius * instance.scale;
+            if (occlusion.occluded(mvp, instance.position, r))
             {
-                pos[i] = pv->point()[i];
+                occluded++;
+                continue;
             }
-            for (int j = 0; j < 2; j++)
+            const float width = 2 * r * pixels / std::max((eye - instance.position).length(), r);
+            if (width <= widest && impostors.use(mesh.firstInstance + k, instance.position, r, eye, width))
             {
-                qt_uv[j] = phe->uv()[j];
+                distant++;
+                continue;
             }
-            vertices.push_back(pos);
-            textureCoordinates.push_back(qt_uv);
+            memcpy(out + 16 * mesh.visibleCount++, instanceMatrices[mesh.firstInstance + k].constData(), 16 * sizeof(GLfloat));
         }
     }
-    const QString txfile = QString::fromStdString(textfile);
-    
-    texture = bindTexture(QPixmap(txfile));
+    MESHLIB_COUNTER_ADD("render.instances_occluded", occluded);
+    MESHLIB_COUNTER_ADD("render.impostors", distant);
+    sceneCulled = true;
+}
 
+void GlWidget::drawScene(const QMatrix4x4 & mvp, const QVector3D & eye)
+{
+    // the visible instances from the region of this frame, all of them from the instance buffer otherwise
+    const GLuint instances = sceneCulled ? visibleBuffer.id : instanceBuffer.id;
+    const GLintptr base = sceneCulled ? (GLintptr)visibleRegion * visibleRegionBytes : 0;
+    for (int m = 0; m < sceneMeshes.size(); m++)
+    {
+        const SceneMesh & mesh = sceneMeshes[m];
+        const int count = sceneCulled ? mesh.visibleCount : mesh.instanceCount;
+        if (!mesh.lodCount || !count) continue;
+        const LodLevel & lod = sceneLods[mesh.firstLod + selectSceneLod(m, eye)];
+        const GLvoid * offset = (const GLvoid *)(sizeof(GLuint) * lod.offset);
+        glBindTexture(GL_TEXTURE_2D, mesh.texture);
+        if (gl45)
+        {
+            // a full block is bound every time, the buffer is padded for the last one
+            for (int i = 0; i < count; i += instancesPerDraw)
+            {
+                const int n = std::min(instancesPerDraw, count - i);
+                gl45->glBindBufferRange(GL_UNIFORM_BUFFER, 0, instances, base + 16 * sizeof(GLfloat) * (mesh.firstInstance + i),
+                    16 * sizeof(GLfloat) * instancesPerDraw);
+                gl45->glDrawElementsInstanced(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, offset, n);
+                drawCalls++;
+            }
+        }
+        else
+        {
+            for (int i = 0; i < mesh.instanceCount; i++)
+            {
+                shaderProgram.setUniformValue("modelMatrix", instanceMatrices[mesh.firstInstance + i]);
+                glDrawElements(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, offset);
+                drawCalls++;
+            }
+            shaderProgram.setUniformValue("modelMatrix", QMatrix4x4());
+        }
+        drawnTriangles += (size_t)count * lod.count / 3;
+    }
 }
 
+void GlWidget::drawImpostors(QOpenGLShaderProgram & surface, const QMatrix4x4 & mvp)
+{
+    MESHLIB_TRACE_ZONE("drawImpostors");
+    // every instance alone from its block after the region of the frame, at the level its cell
+    // resolves, lit from the eye as the frame is
+    const GLintptr base = (GLintptr)visibleRegion * visibleRegionBytes + captureOffset;
+    int index = 0;
+    const int captured = impostors.capture(captureCount, defaultFramebufferObject(), [&](int slot, const QMatrix4x4 & viewProjection)
+    {
+        const int m = (int)(std::upper_bound(sceneMeshes.begin(), sceneMeshes.end(), slot,
+            [](int s, const SceneMesh & mesh) { return s < mesh.firstInstance; }) - sceneMeshes.begin()) - 1;
+        const SceneMesh & mesh = sceneMeshes[m];
+        if (!mesh.lodCount) return;
+        // the cell is as wide as the bounding sphere of the normalized mesh
+        const LodLevel & lod = sceneLods[mesh.firstLod + sceneLevel(m, ImpostorAtlas::cellSize / (2 * std::sqrt(3.0)))];
+        memcpy((char *)visibleBuffer.mapped + base + index * captureStride, instanceMatrices[slot].constData(), 16 * sizeof(GLfloat));
+        gl45->glBindBufferRange(GL_UNIFORM_BUFFER, 0, visibleBuffer.id, base + index * captureStride, 16 * sizeof(GLfloat) * instancesPerDraw);
+        surface.setUniformValue("mvpMatrix", viewProjection);
+        glBindTexture(GL_TEXTURE_2D, mesh.texture);
+        gl45->glDrawElementsInstanced(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, (const GLvoid *)(sizeof(GLuint) * lod.offset), 1);
+        drawCalls++;
+        drawnTriangles += lod.count / 3;
+        index++;
+    });
+    surface.setUniformValue("mvpMatrix", mvp);
+    MESHLIB_COUNTER_ADD("render.impostors_captured", captured);
 
-void GlWidget::resizeGL(int width, int height)
+    impostors.draw(mvp);
+    if (impostors.billboards()) drawCalls++;
+    surface.bind();
+}
+
+int GlWidget::selectSceneLod(int m, const QVector3D & eye) const
 {
-    if (height == 0) {
-        height = 1;
+    // as selectLod, every instance nearer relative to its size wants a finer level
+    const SceneMesh & mesh = sceneMeshes[m];
+    const double radius = std::sqrt(3.0);
+    double density = 0;
+    for (int i : mesh.instances)
+    {
+        const Scene::Instance & instance = scene.instances[i];
+        const double nearest = std::max((double)(eye - instance.position).length() - radius * instance.scale, 0.001 * instance.scale);
+        density = std::max(density, instance.scale / nearest);
     }
+    return sceneLevel(m, viewportHeight * std::sqrt(3.0) / 2 * density);
+}
 
-    pMatrix.setToIdentity();
-    pMatrix.perspective(60.0, (float)width / (float)height, 0.001, 1000);
-
-    glViewport(0, 0, width, height);
+int GlWidget::sceneLevel(int m, double pixels) const
+{
+    const SceneMesh & mesh = sceneMeshes[m];
+    int level = 0;
+    const float error = moving ? movingPixelError : lodPixelError;
+    while (level + 1 < mesh.lodCount && sceneLods[mesh.firstLod + level + 1].error * pixels <= error) level++;
+    return level;
 }
 
 //! [5]
 void GlWidget::paintGL()
 {
     //! [5]
+    MESHLIB_TRACE_ZONE("paintGL");
+    profiler.beginFrame(FrameProfiler::Upload);
+    const bool uploading = uploadTexture();
+    const bool streaming = virtualTexture && virtualTexture->update();
+    const bool paging = tiledMesh && tiledMesh->update();
+    const bool receiving = streamedMesh && streamedMesh->update();
+    // the depth of a frame drawn earlier, for the occlusion culling of the scene
+    if (occlusion.available()) occlusion.update();
+
+    profiler.begin(FrameProfiler::Setup);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // every view from its camera and level over the same buffers, textures and programs, the
+    // camera moved is that of the active view
+    bool again = false;
+    size_t triangles = 0;
+    int calls = 0;
+    if (views.isEmpty()) again = drawViewport(true, true);
+    else
+    {
+        const double a = alpha, b = beta, d = distance;
+        const QMatrix4x4 projection = pMatrix;
+        const int width = viewportWidth, height = viewportHeight;
+        for (int k = 0; k < views.size(); k++)
+        {
+            const Viewport & view = views[k];
+            glViewport(view.rect.x(), view.rect.y(), view.rect.width(), view.rect.height());
+            if (!linkCameras && k != activeView)
+            {
+                alpha = view.alpha;
+                beta = view.beta;
+                distance = view.distance;
+            }
+            pMatrix = view.projection;
+            viewportWidth = view.rect.width();
+            viewportHeight = view.rect.height();
+            pinnedLod = view.lod;
+            again = drawViewport(k == 0, k == activeView) || again;
+            triangles += drawnTriangles;
+            calls += drawCalls;
+            alpha = a;
+            beta = b;
+            distance = d;
+        }
+        pMatrix = projection;
+        viewportWidth = width;
+        viewportHeight = height;
+        pinnedLod = -1;
+        drawnTriangles = triangles;
+        drawCalls = calls;
+    }
+    MESHLIB_COUNTER_ADD("render.frames", 1);
+    MESHLIB_GAUGE_SET("render.triangles", drawnTriangles);
+    MESHLIB_GAUGE_SET("render.draw_calls", drawCalls);
+    profiler.endFrame();
+
+    if (showHud)
+    {
+        // averaged times, updated whenever a frame is drawn
+        QPainter painter(this);
+        painter.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+        const QRect box = painter.boundingRect(QRect(8, 8, 400, 400), Qt::AlignLeft | Qt::AlignTop, profiler.summary());
+        painter.fillRect(box.adjusted(-4, -4, 4, 4), QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        painter.drawText(box, Qt::AlignLeft | Qt::AlignTop, profiler.summary());
+    }
+
+    if (uploading || streaming || paging || receiving || again) requestFrame();
+}
+
+bool GlWidget::drawViewport(bool first, bool active)
+{
+    // the overlay of the last view leaves these off
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
     QMatrix4x4 mMatrix;
     QMatrix4x4 vMatrix;
 
+    mMatrix.scale(modelScale);
+    mMatrix.translate(-modelCenter);
+    mMatrix *= sceneMatrix;
+
     QMatrix4x4 cameraTransformation;
     cameraTransformation.rotate(alpha, 0, 1, 0);
     cameraTransformation.rotate(beta, 1, 0, 0);
@@ -107,35 +2485,379 @@ void GlWidget::paintGL()
     vMatrix.lookAt(cameraPosition, QVector3D(0, 0, 0), cameraUpDirection);
 
     //! [6]
-    shaderProgram.bind();
-
-    shaderProgram.setUniformValue("mvpMatrix", pMatrix * vMatrix * mMatrix);
+    QOpenGLShaderProgram & surface = moving && movingVariant && linkProgram(movingProgram) ? movingProgram : shaderProgram;
+    surface.bind();
 
-    shaderProgram.setUniformValue("texture", 0);
+    const QMatrix4x4 mvpMatrix = pMatrix * vMatrix * mMatrix;
+    surface.setUniformValue("mvpMatrix", mvpMatrix);
+    surface.setUniformValue("modelMatrix", QMatrix4x4());
+    surface.setUniformValue("positionScale", positionScale);
+    surface.setUniformValue("positionOffset", positionOffset);
+    // the eye in the coordinates mvpMatrix takes, the light is there
+    const QVector3D eye = (vMatrix * mMatrix).inverted() * QVector3D(0, 0, 0);
+    surface.setUniformValue("eyePosition", eye);
+    surface.setUniformValue("octahedralNormals", quantized);
+    surface.setUniformValue("viewportSize", QVector2D(viewportWidth, viewportHeight));
 
+    surface.setUniformValue("textureMap", 0);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glActiveTexture(0);
+    glBindTexture(GL_TEXTURE_2D, textureReady ? texture : 0);
+    if (virtualTexture) virtualTexture->setUniforms(surface, 1);
+    if (normalMap)
+    {
+        surface.setUniformValue("normalMap", 3);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, normalMap);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // the meshlets of the level that may be visible, all of the preview, a scene draws itself,
+    // no triangles in place of splats
+    const bool splatting = showSplats && !splats.levelEnds.isEmpty() && sceneMeshes.isEmpty();
+    drawFirst.clear();
+    drawCount.clear();
+    bool indirect = false;
+    // the tets in place of the surface, drawn after it
+    const bool volumetric = showVolume && volume.loaded() && sceneMeshes.isEmpty() && !tiledMesh && !streamedMesh;
+    // the copies of the mesh in the disk in place of it, the disk in the plane of the view
+    const bool hyperbolic = showTiling && tiling.loaded() && !volumetric && sceneMeshes.isEmpty() && !tiledMesh && !streamedMesh;
+    const bool resolving = views.size() <= 1 && visibility.available() && !quantized && !splatting && !volumetric && !hyperbolic && sceneMeshes.isEmpty() && !tiledMesh && !streamedMesh
+        && !virtualTexture && !normalMap && compareFile.empty() && !showWireframe && !subdividing() && linkProgram(pickProgram) && linkProgram(resolveProgram);
+    sceneCulled = false;
+    // the occlusion reads back the depth of the first view, in the corner of the framebuffer
+    if (first && !sceneMeshes.isEmpty() && !tiledMesh && !streamedMesh) cullScene(mvpMatrix, eye);
+    if (!sceneMeshes.isEmpty() || splatting || tiledMesh || streamedMesh || volumetric || hyperbolic) {}
+    else if (resolving)
+    {
+        // one draw, so that gl_PrimitiveID counts the triangles of the level from its first
+        if (lods.isEmpty()) drawFirst.push_back(0);
+        else drawFirst.push_back(lods[selectLod()].offset / 3);
+        drawCount.push_back(lods.isEmpty() ? indexCount / 3 : lods[selectLod()].count / 3);
+    }
+    else if (!lods.isEmpty() && compute.culling() && pinnedLod < 0)
+    {
+        // the level and the meshlets are picked by cullMeshlets.comp, as selectLod and CMeshlets::cull do
+        compute.cull(mvpMatrix, eye, (float)(modelScale * pixelsPerUnit()), moving ? movingPixelError : lodPixelError);
+        indirect = true;
+    }
+    else if (!lods.isEmpty())
+    {
+        const LodLevel & lod = lods[selectLod()];
+        const float eyes[3] = { eye.x(), eye.y(), eye.z() };
+        meshlets.cull(lod.firstMeshlet, lod.firstMeshlet + lod.meshletCount, mvpMatrix.constData(), eyes, drawFirst, drawCount);
+    }
+    else
+    {
+        drawFirst.push_back(0);
+        drawCount.push_back((subdividing() ? refinedIndexCount : indexCount) / 3);
+    }
+    drawOffsets.resize((int)drawFirst.size());
+    drawCounts.resize((int)drawCount.size());
+    for (size_t i = 0; i < drawFirst.size(); i++)
+    {
+        drawOffsets[(int)i] = (const GLvoid *)(3 * sizeof(GLuint) * drawFirst[i]);
+        drawCounts[(int)i] = (GLsizei)(3 * drawCount[i]);
+    }
+
+    // the core backend draws all runs in one call, the legacy one run by run
+    drawnTriangles = 0;
+    drawCalls = 0;
+    for (uint32_t n : drawCount) drawnTriangles += n;
+    if (!drawCounts.isEmpty()) drawCalls = gl45 ? 1 : drawCounts.size();
+    if (indirect)
+    {
+        // the counts of the GPU come back a frame or more later
+        int meshletsDrawn;
+        compute.drawn(drawnTriangles, meshletsDrawn);
+        drawCalls = 1;
+    }
+    auto draw = [&]()
+    {
+        // the tiles fine enough for the view, a unit at distance 1 covers pixels as in pixelsPerUnit
+        if (tiledMesh) tiledMesh->draw(mvpMatrix, eye, (float)(viewportHeight * std::sqrt(3.0) / 2), moving ? movingPixelError : lodPixelError,
+            drawnTriangles, drawCalls);
+        else if (streamedMesh) streamedMesh->draw(eye, (float)(viewportHeight * std::sqrt(3.0) / 2), moving ? movingPixelError : lodPixelError,
+            drawnTriangles, drawCalls);
+        else if (!sceneMeshes.isEmpty()) drawScene(mvpMatrix, eye);
+        else if (indirect) compute.draw();
+        else if (resolving) drawVisibility(surface, mvpMatrix, eye, drawFirst[0], drawCount[0]);
+        else if (gl45) gl45->glMultiDrawElements(GL_TRIANGLES, drawCounts.constData(), GL_UNSIGNED_INT, drawOffsets.constData(), drawCounts.size());
+        else for (int i = 0; i < drawCounts.size(); i++) glDrawElements(GL_TRIANGLES, drawCounts[i], GL_UNSIGNED_INT, drawOffsets[i]);
+    };
+    profiler.begin(FrameProfiler::Bind);
+    // the refined surface has its own vertex array, only made on the core backend
+    QOpenGLVertexArrayObject & surfaceVao = subdividing() ? refinedVao : vao;
+    if (surfaceVao.isCreated()) surfaceVao.bind();
+    else bindAttributes();
+
+    profiler.begin(FrameProfiler::Draw);
+    draw();
+    // the distant instances cullScene left out, before the occlusion reads the depth back
+    if (sceneCulled && impostors.available()) drawImpostors(surface, mvpMatrix);
+    if (editing && gl45)
+    {
+        if (editFence) gl45->glDeleteSync(editFence);
+        editFence = gl45->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    // the occluders of the next frames are those of this one, read back before the overlays
+    const bool occluding = first && occlusion.available() && !sceneMeshes.isEmpty() && !tiledMesh && !streamedMesh;
+    if (occluding) occlusion.capture(defaultFramebufferObject(), viewportWidth, viewportHeight, mvpMatrix);
+    if (sequence && sequenceSlot >= 0 && gl45)
+    {
+        GLsync & fence = sequenceFences[sequenceSlot];
+        if (fence) gl45->glDeleteSync(fence);
+        fence = gl45->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
 
-    shaderProgram.setAttributeArray("vertex", vertices.constData());
-    shaderProgram.enableAttributeArray("vertex");
+    if (surfaceVao.isCreated()) surfaceVao.release();
+    else
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        glDisableVertexAttribArray((GLuint)surface.attributeLocation("vertex"));
+        glDisableVertexAttribArray((GLuint)surface.attributeLocation("textureCoordinate"));
+        if (surface.attributeLocation("normal") >= 0) glDisableVertexAttribArray((GLuint)surface.attributeLocation("normal"));
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    surface.release();
+    if (volumetric) volume.draw(mvpMatrix, eye, volumeCenter, volumeWidth, volumeDensity);
+    if (hyperbolic) tiling.draw(pMatrix * vMatrix, textureReady ? texture : 0, showBoundary);
+
+    // the points of a level as discs about as wide as their cells on screen, in one call
+    if (splatting && linkProgram(splatProgram))
+    {
+        const int level = selectSplatLevel();
+        splatProgram.bind();
+        splatProgram.setUniformValue("mvpMatrix", mvpMatrix);
+        splatProgram.setUniformValue("splatSize", splats.cellSize(level));
+        splatProgram.setUniformValue("splatScale", modelScale * pMatrix(1, 1) * viewportHeight / 2);
+        splatProgram.setUniformValue("textureMap", 0);
+        if (lighting) splatProgram.setUniformValue("eyePosition", eye);
+        glBindTexture(GL_TEXTURE_2D, textureReady ? texture : 0);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        if (splatVao.isCreated()) splatVao.bind();
+        else bindSplats();
+        glDrawArrays(GL_POINTS, 0, splats.levelEnds[level]);
+        if (splatVao.isCreated()) splatVao.release();
+        else
+        {
+            glDisableVertexAttribArray((GLuint)splatProgram.attributeLocation("vertex"));
+            glDisableVertexAttribArray((GLuint)splatProgram.attributeLocation("textureCoordinate"));
+            if (splatProgram.attributeLocation("normal") >= 0) glDisableVertexAttribArray((GLuint)splatProgram.attributeLocation("normal"));
+        }
+        glDisable(GL_PROGRAM_POINT_SIZE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        splatProgram.release();
+    }
 
-    shaderProgram.setAttributeArray("textureCoordinate", textureCoordinates.constData());
-    shaderProgram.enableAttributeArray("textureCoordinate");
+    // the loops from their buffer, a draw call for all of them on the core backend
+    if (showBoundary && !moving && !hyperbolic && !boundaryCount.isEmpty() && sceneMeshes.isEmpty() && linkProgram(lineProgram))
+    {
+        QMatrix4x4 bias;
+        bias.translate(0, 0, -overlayDepthBias);
+        lineProgram.bind();
+        lineProgram.setUniformValue("mvpMatrix", bias * mvpMatrix);
+        lineProgram.setUniformValue("modelMatrix", QMatrix4x4());
+        lineProgram.setUniformValue("positionScale", QVector3D(1, 1, 1));
+        lineProgram.setUniformValue("positionOffset", QVector3D());
+        lineProgram.setUniformValue("lineColor", QColor(230, 40, 20));
+        if (boundaryVao.isCreated()) boundaryVao.bind();
+        else bindBoundary();
+        if (gl45) gl45->glMultiDrawArrays(GL_LINE_LOOP, boundaryFirst.constData(), boundaryCount.constData(), boundaryCount.size());
+        else for (int i = 0; i < boundaryCount.size(); i++) glDrawArrays(GL_LINE_LOOP, boundaryFirst[i], boundaryCount[i]);
+        if (boundaryVao.isCreated()) boundaryVao.release();
+        else glDisableVertexAttribArray((GLuint)lineProgram.attributeLocation("vertex"));
+        lineProgram.release();
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+    // the creases, then the edges the geometry shader finds on the silhouette, from the buffer laid out once
+    if (showFeatures && adjacencyCount > 0 && featureVao.isCreated() && !splatting && !volumetric && !hyperbolic && sceneMeshes.isEmpty()
+        && !tiledMesh && !streamedMesh && linkProgram(lineProgram) && linkProgram(silhouetteProgram))
+    {
+        QMatrix4x4 bias;
+        bias.translate(0, 0, -overlayDepthBias);
+        featureVao.bind();
+        for (QOpenGLShaderProgram * program : { &lineProgram, &silhouetteProgram })
+        {
+            program->bind();
+            program->setUniformValue("mvpMatrix", bias * mvpMatrix);
+            program->setUniformValue("modelMatrix", QMatrix4x4());
+            program->setUniformValue("positionScale", positionScale);
+            program->setUniformValue("positionOffset", positionOffset);
+            if (program == &lineProgram)
+            {
+                program->setUniformValue("lineColor", QColor(20, 90, 220));
+                if (creaseCount > 0) glDrawElements(GL_LINES, creaseCount, GL_UNSIGNED_INT, (const GLvoid *)(sizeof(GLuint) * adjacencyCount));
+            }
+            else
+            {
+                program->setUniformValue("lineColor", QColor(10, 10, 10));
+                glDrawElements(GL_TRIANGLES_ADJACENCY, adjacencyCount, GL_UNSIGNED_INT, NULL);
+            }
+            program->release();
+        }
+        featureVao.release();
+    }
 
-    shaderProgram.disableAttributeArray("vertex");
+    // the tiles the active view samples, read back by a later frame
+    const bool viewChanged = active && virtualTexture && !moving && !splatting && virtualTexture->feedbackIdle() && (feedbackStale || mvpMatrix != feedbackMvp);
+    if (viewChanged && vao.isCreated() && linkProgram(feedbackProgram))
+    {
+        profiler.begin(FrameProfiler::Feedback);
+        feedbackProgram.bind();
+        feedbackProgram.setUniformValue("mvpMatrix", mvpMatrix);
+        feedbackProgram.setUniformValue("modelMatrix", QMatrix4x4());
+        feedbackProgram.setUniformValue("positionScale", positionScale);
+        feedbackProgram.setUniformValue("positionOffset", positionOffset);
+        feedbackProgram.setUniformValue("feedbackBias", virtualTexture->feedbackBias());
+        virtualTexture->setUniforms(feedbackProgram, 1);
+        virtualTexture->beginFeedback(viewportWidth, viewportHeight);
+        {
+            QOpenGLVertexArrayObject::Binder binder(&vao);
+            draw();
+        }
+        virtualTexture->endFeedback(defaultFramebufferObject(), viewportWidth, viewportHeight);
+        feedbackProgram.release();
+        feedbackMvp = mvpMatrix;
+        feedbackStale = false;
+    }
 
-    shaderProgram.disableAttributeArray("textureCoordinate");
+    // the ID pass of a click, the finest level in one draw so that gl_PrimitiveID counts its triangles,
+    // read back by a later frame
+    const bool picking = active && (picker.busy() || picker.wanted());
+    if (picking) profiler.begin(FrameProfiler::Pick);
+    uint32_t pickId;
+    if (active && picker.result(pickId)) reportPick(pickId);
+    // the mesh may have been replaced by a preview since the click
+    if (active && picker.wanted() && (triangleFaces.empty() || !linkProgram(pickProgram))) picker.cancel();
+    if (active && picker.wanted())
+    {
+        pickProgram.bind();
+        pickProgram.setUniformValue("mvpMatrix", picker.pickMatrix() * mvpMatrix);
+        pickProgram.setUniformValue("modelMatrix", QMatrix4x4());
+        pickProgram.setUniformValue("positionScale", positionScale);
+        pickProgram.setUniformValue("positionOffset", positionOffset);
+        picker.begin();
+        {
+            QOpenGLVertexArrayObject::Binder binder(&vao);
+            glDrawElements(GL_TRIANGLES, lods[0].count, GL_UNSIGNED_INT, (const GLvoid *)(sizeof(GLuint) * lods[0].offset));
+        }
+        picker.end(defaultFramebufferObject(), viewportWidth, viewportHeight);
+        pickProgram.release();
+        pickMvp = mvpMatrix;
+    }
+    // after the feedback pass, which draws the culled scene again
+    if (sceneCulled) visibleFences[visibleRegion] = gl45->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-    shaderProgram.release();
+    // culled against the depth of another view, the frame after the depth of this one is exact
+    const bool lagging = occluding && !occlusion.current(mvpMatrix);
+    return viewChanged || picking || lagging;
 }
 //! [6]
 
+void GlWidget::startupFrame()
+{
+    StartupProfiler & startup = StartupProfiler::instance();
+    if (!startup.enabled()) return;
+    // the first frame may show no more than the preview of a mesh being parsed
+    if (!startupFrameShown) startup.record("first_frame", 0);
+    startupFrameShown = true;
+
+    // complete once the mesh is read and the texture has all its levels, a virtual one streams on
+    const bool meshDone = !loader && !sceneLoader && !uploadingMesh;
+    const bool textureDone = (textureFile().empty() && !materials.tiled()) || virtualTexture || (!textureLoader && !textureTicket && pendingLevel < 0);
+    if (!meshDone || !textureDone) return;
+    startup.record("first_complete_frame", 0);
+    startup.closeLog();
+    QCoreApplication::quit();
+}
+
+void GlWidget::resetModelTransform()
+{
+    modelCenter = QVector3D();
+    modelScale = 1;
+    if (!vMesh->keep_positions) return;
+    const CPoint & c = vMesh->norm_center;
+    modelCenter = QVector3D((float)c[0], (float)c[1], (float)c[2]);
+    modelScale = (float)vMesh->norm_scale;
+}
+
+double GlWidget::pixelsPerUnit() const
+{
+    // the normalized model fits in [-1, 1]^3
+    const double radius = std::sqrt(3.0);
+    const double nearest = std::max(distance - radius, 0.001);
+    // the 60 degree field of view of resizeGL, tan(30) = 1 / sqrt(3)
+    return viewportHeight * std::sqrt(3.0) / (2 * nearest);
+}
+
+int GlWidget::selectLod() const
+{
+    if (pinnedLod >= 0) return std::min(pinnedLod, std::max(lods.size() - 1, 0));
+    const double pixels = pixelsPerUnit();
+    int level = 0;
+    // the errors are in the units of the vertex buffer, modelScale takes them to the normalized model
+    const float error = moving ? movingPixelError : lodPixelError;
+    while (level + 1 < lods.size() && lods[level + 1].error * modelScale * pixels <= error) level++;
+    return level;
+}
+
+int GlWidget::selectSplatLevel() const
+{
+    // finer while the cells of the next level stay wide enough, coarser ones while the camera moves
+    const double pixels = pixelsPerUnit() * modelScale;
+    const float wanted = moving ? movingPixelError : splatPixels;
+    int level = 0;
+    while (level + 1 < splats.levelEnds.size() && splats.cellSize(level + 1) * pixels >= wanted) level++;
+    return level;
+}
+
+void GlWidget::reportPick(uint32_t id)
+{
+    // the corner of the face nearest to the click on screen
+    int face = -1, vertex = -1;
+    if (id > 0 && id <= triangleFaces.size())
+    {
+        CFace * pf = vMesh->m_mesh()->faces().data()[triangleFaces[id - 1]];
+        const QVector2D click(picker.x() + 0.5f, picker.y() + 0.5f);
+        float nearest = FLT_MAX;
+        for (CHalfEdge * phe : pf->halfedges_range())
+        {
+            const CPoint & p = phe->vertex()->point();
+            const QVector4D c = pickMvp * QVector4D((float)p[0], (float)p[1], (float)p[2], 1);
+            if (c.w() <= 0) continue;
+            const QVector2D pixel((c.x() / c.w() + 1) * viewportWidth / 2, (c.y() / c.w() + 1) * viewportHeight / 2);
+            const float d = (pixel - click).lengthSquared();
+            if (d < nearest)
+            {
+                nearest = d;
+                vertex = phe->vertex()->id();
+            }
+        }
+        face = pf->id();
+        std::cout << "face " << face << " vertex " << vertex << std::endl;
+    }
+    emit picked(face, vertex);
+}
+
 void GlWidget::mousePressEvent(QMouseEvent *event)
 {
     lastMousePosition = event->pos();
+    // the view clicked takes the drags and the picks
+    selectView(viewAt(event->pos()));
+
+    if (event->button() == Qt::RightButton)
+    {
+        // in device pixels from the bottom left of the view, as the ID pass draws them
+        const qreal ratio = devicePixelRatioF();
+        const int left = views.isEmpty() ? 0 : views[activeView].rect.x();
+        if (picker.available())
+        {
+            picker.request((int)(event->x() * ratio) - left, viewportHeight - 1 - (int)(event->y() * ratio), viewportWidth, viewportHeight);
+            requestFrame();
+        }
+        else std::cout << "Picking needs OpenGL 4.5" << std::endl;
+    }
 
     event->accept();
 }
@@ -145,7 +2867,17 @@ void GlWidget::mouseMoveEvent(QMouseEvent *event)
     int deltaX = event->x() - lastMousePosition.x();
     int deltaY = event->y() - lastMousePosition.y();
 
-    if (event->buttons() & Qt::LeftButton) {
+    if ((event->buttons() & Qt::LeftButton) && (event->modifiers() & Qt::ControlModifier) && slicer)
+    {
+        // a drag over the height of the view sweeps the plane through the whole mesh
+        const double range = slicer->max_offset() - slicer->min_offset();
+        slicer->set_offset(slicer->offset() + deltaY * range / std::max(1, height()));
+        makeCurrent();
+        updateClip(false);
+        doneCurrent();
+        requestFrame();
+    }
+    else if (event->buttons() & Qt::LeftButton) {
         alpha -= deltaX;
         while (alpha < 0) {
             alpha += 360;
@@ -162,7 +2894,8 @@ void GlWidget::mouseMoveEvent(QMouseEvent *event)
         beta = 90;
         }*/
 
-        updateGL();
+        cameraMoved();
+        requestFrame();
     }
 
     lastMousePosition = event->pos();
@@ -182,8 +2915,186 @@ void GlWidget::wheelEvent(QWheelEvent *event)
             distance *= 0.9;
         }
 
-        updateGL();
+        cameraMoved();
+        requestFrame();
+    }
+
+    event->accept();
+}
+
+void GlWidget::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_W)
+    {
+        // the wireframe is a variant of the program
+        showWireframe = !showWireframe;
+        if (isValid())
+        {
+            makeCurrent();
+            buildShaders(virtualTexture != NULL);
+            doneCurrent();
+        }
+    }
+    else if (event->key() == Qt::Key_B) showBoundary = !showBoundary;
+    else if (event->key() == Qt::Key_F)
+    {
+        // laid out the first time they are shown, then they stay in their buffer
+        showFeatures = !showFeatures;
+        if (showFeatures && !gl45) std::cout << "The feature lines need OpenGL 4.5" << std::endl;
+        else if (showFeatures && adjacencyCount == 0 && !loader && sceneMeshes.isEmpty() && !editing && !slicer && isValid())
+        {
+            makeCurrent();
+            expandMesh(vMesh);
+            uploadBuffers(0, 0);
+            doneCurrent();
+        }
+    }
+    else if (event->key() == Qt::Key_L)
+    {
+        // either way the views go on from the camera of the active one
+        linkCameras = !linkCameras;
+        for (Viewport & view : views)
+        {
+            view.alpha = alpha;
+            view.beta = beta;
+            view.distance = distance;
+        }
+    }
+    else if (event->key() == Qt::Key_D)
+    {
+        // the subdivision is drawn from the slots, the editing stays on once it is off again
+        showSubdivision = !showSubdivision;
+        if (showSubdivision && !compute.available()) std::cout << "The subdivision needs the compute shaders" << std::endl;
+        else if (showSubdivision && !beginEditing()) std::cout << "Only a complete mesh of triangles is subdivided" << std::endl;
+        else if (showSubdivision && isValid())
+        {
+            makeCurrent();
+            updateSubdivision();
+            doneCurrent();
+        }
+    }
+    else if (event->key() == Qt::Key_C)
+    {
+        // the boundary is expanded again when the clipping ends
+        showClip = !showClip;
+        if (!loader && sceneMeshes.isEmpty() && isValid() && vMesh->t_mesh().num_tets() > 0)
+        {
+            makeCurrent();
+            if (showClip) startClip();
+            else
+            {
+                delete slicer;
+                slicer = NULL;
+                prepareMesh();
+                uploadBuffers(0, 0);
+            }
+            doneCurrent();
+        }
+    }
+    else if (event->key() == Qt::Key_K)
+    {
+        // a checkpoint now, whether or not the mesh changed since the last one
+        if (checkpointFile.empty()) std::cout << "No checkpoint file, see --checkpoint" << std::endl;
+        else saveCheckpoint(true);
+    }
+    else if (event->key() == Qt::Key_S)
+    {
+        // each of the two is built the first time it is shown, then both stay in their buffers
+        showSplats = !showSplats;
+        if (!loader && sceneMeshes.isEmpty() && isValid())
+        {
+            makeCurrent();
+            if (showSplats && splats.levelEnds.isEmpty())
+            {
+                splats.build(vMesh->m_mesh(), splatDepth);
+                uploadSplats();
+            }
+            if (!showSplats && lods.isEmpty())
+            {
+                expandMesh(vMesh);
+                uploadBuffers(0, 0);
+            }
+            doneCurrent();
+        }
+    }
+    else if (event->key() == Qt::Key_V)
+    {
+        // the programs are built the first time, the tets uploaded every time it is turned on
+        showVolume = !showVolume;
+        if (!loader && sceneMeshes.isEmpty() && isValid())
+        {
+            makeCurrent();
+            if (showVolume && !volume.available()) volume.initializeGL(gl45);
+            if (showVolume && !volume.available()) std::cout << "The volume rendering needs OpenGL 4.5" << std::endl;
+            if (showVolume) uploadVolume();
+            else volume.clear();
+            doneCurrent();
+        }
+    }
+    else if (event->key() == Qt::Key_T)
+    {
+        // the programs are built the first time, the tiles found and uploaded every time it is turned on
+        showTiling = !showTiling;
+        if (!loader && sceneMeshes.isEmpty() && isValid())
+        {
+            makeCurrent();
+            if (showTiling && !tiling.available()) tiling.initializeGL(gl45);
+            if (showTiling && !tiling.available()) std::cout << "The hyperbolic tiling needs OpenGL 4.5" << std::endl;
+            if (showTiling) uploadTiling();
+            else tiling.clear();
+            doneCurrent();
+        }
+    }
+    else if (showVolume && (event->key() == Qt::Key_BracketLeft || event->key() == Qt::Key_BracketRight || event->key() == Qt::Key_Comma
+        || event->key() == Qt::Key_Period || event->key() == Qt::Key_Minus || event->key() == Qt::Key_Equal))
+    {
+        // only uniforms of the next frame, nothing is sorted or uploaded again
+        if (event->key() == Qt::Key_BracketLeft) volumeCenter -= 0.05f;
+        else if (event->key() == Qt::Key_BracketRight) volumeCenter += 0.05f;
+        else if (event->key() == Qt::Key_Comma) volumeWidth /= 1.25f;
+        else if (event->key() == Qt::Key_Period) volumeWidth *= 1.25f;
+        else if (event->key() == Qt::Key_Minus) volumeDensity /= 1.5f;
+        else volumeDensity *= 1.5f;
+        std::cout << "Volume window " << volumeCenter - volumeWidth / 2 << " to " << volumeCenter + volumeWidth / 2
+                  << ", density " << volumeDensity << std::endl;
+    }
+    else
+    {
+        QOpenGLWidget::keyPressEvent(event);
+        return;
     }
 
+    requestFrame();
     event->accept();
 }
+
+void GlWidget::requestFrame()
+{
+    if (frameTimer.isActive()) return;
+
+    // one frame per refresh interval, events until then only change the view
+    QWindow * window = this->window()->windowHandle();
+    QScreen * screen = window ? window->screen() : QGuiApplication::primaryScreen();
+    const qreal rate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60;
+    const qint64 interval = (qint64)(1000 / rate);
+    frameTimer.start((int)std::max<qint64>(0, interval - sinceFrame.elapsed()));
+}
+
+void GlWidget::drawFrame()
+{
+    sinceFrame.restart();
+    update();
+}
+
+void GlWidget::cameraMoved()
+{
+    if (!coarseWhileMoving) return;
+    moving = true;
+    idleTimer.start(refineDelay);
+}
+
+void GlWidget::refine()
+{
+    moving = false;
+    requestFrame();
+}
@@ -3,12 +3,40 @@
 #define VIEWER_H
 
 
-#include <QGLWidget>
-#include <QGLShaderProgram>
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QImage>
 #include "viewerMesh.h"
+#include "renderMesh.h"
+#include "meshLoader.h"
+#include "meshSequence.h"
+#include "textureLoader.h"
+#include "virtualTexture.h"
+#include "tiledMesh.h"
+#include "streamedMesh.h"
+#include "sceneLoader.h"
+#include "frameProfiler.h"
+#include "meshRenderer.h"
+#include "meshPicker.h"
+#include "tetVolume.h"
+#include "hyperbolicTiling.h"
+#include "occlusionCuller.h"
+#include "impostorAtlas.h"
+#include "visibilityBuffer.h"
+#include "meshCompute.h"
+#include "gpuUploader.h"
+#include "pointSplats.h"
+#include "TetMesh/tslicer.h"
+#include "Mesh/subdivision.h"
 
 //! [0]
-class GlWidget : public QGLWidget
+class GlWidget : public QOpenGLWidget, public MeshRenderer, protected QOpenGLFunctions, protected RenderMesh
 {
     //! [0]
     Q_OBJECT
@@ -19,10 +47,247 @@ public:
     QSize sizeHint() const;
 
     std::string meshfile = "";
+    /*! the texture, empty to take the diffuse maps of the .mtl materials of the mesh, if any */
     std::string textfile = "";
+    /*! reorder the index buffer for the vertex caches and less overdraw when the mesh is expanded */
+    bool optimizeOrder = true;
+    /*! simplify the expanded mesh into levels of detail, drawn by their error on screen */
+    bool buildLod = true;
+    /*! no level with fewer triangles is built */
+    int minLodTriangles = 1000;
+    /*! the coarsest level whose error stays below this many pixels is drawn */
+    float lodPixelError = 1;
+    /*! while the camera moves draw a coarser level, without the wireframe, the boundary and the
+        virtual texture feedback, then refine once it has rested for refineDelay milliseconds */
+    bool coarseWhileMoving = false;
+    /*! the pixel error of the levels drawn while the camera moves */
+    float movingPixelError = 8;
+    int refineDelay = 250;
+
+    /*! layouts of the vertex buffers */
+    enum VertexFormat
+    {
+        FloatVertices,      //!< float positions and uvs, 20 bytes a vertex, 32 with normals
+        QuantizedVertices   //!< 16 bit positions in the bounding box and half float uvs, 12 bytes a vertex,
+                            //!< 16 with octahedral normals
+    };
+    /*! layout of the complete mesh, the preview while loading is always float */
+    VertexFormat vertexFormat = FloatVertices;
+
+    /*! OpenGL paths */
+    enum Backend
+    {
+        CoreBackend,    //!< 4.5 core profile, persistently mapped buffers and direct state access
+        LegacyBackend   //!< 3.0 compatibility context, buffers rewritten with glBufferSubData
+    };
+    /*! choose the context before the widget is shown, the core backend falls back to legacy without 4.5 */
+    void setBackend(Backend b);
+
+    /*! keep the points of the mesh as read and normalize it through the model matrix,
+        choose it before the mesh is loaded, see ViewerMesh::keep_positions */
+    bool keepPositions = false;
+    /*! keep the largest this many connected parts of the mesh, 0 all, choose it before the mesh
+        is loaded, see ViewerMesh::keep_components */
+    int keepComponents = 0;
+    /*! read the mapped cache of a mesh and write it, see ViewerMesh::use_cache */
+    bool useCache = true;
+    /*! repair meshes that are not manifold as they are built, see ViewerMesh::repair */
+    bool repairInput = false;
+    /*! weld the points of meshes as they are built, see ViewerMesh::weld */
+    double weldTolerance = -1;
+    /*! lay out meshes along the Morton curve as they are built, see ViewerMesh::reorder */
+    bool reorderInput = false;
+    /*! segment the mesh into compact patches of at most this many faces, listed patch by patch in
+        the cache and drawn as meshlets of the triangles of a patch, see MeshLib::CSegmentation, 0 for none */
+    int patchSize = 0;
+    /*! the store the caches are filed in by the hash of the meshes, none while it has no
+        directory, see ViewerMesh::store */
+    MeshLib::CContentStore store;
+    /*! simplify the meshes to this fraction of their triangles as they are read, 1 keeps them all,
+        see ViewerMesh::decimate_ratio */
+    double decimateRatio = 1;
+    /*! print the counts, topology and bounds of the meshes as they are read, see ViewerMesh::report */
+    bool printReport = false;
+    /*! color the mesh by the distance of its vertices to the surface of this file in place of the
+        texture, choose it before the widget is shown, see compareMesh */
+    std::string compareFile = "";
+    /*! shade with the vertex normals and a light at the eye, choose it before the widget is shown */
+    bool lighting = false;
+    /*! a tangent space normal map of the mesh, such as JobRunner bakes for a decimated one, shades
+        it with lighting in place of its vertex normals, choose it before the widget is shown */
+    std::string normalMapFile = "";
+    /*! store the texture BC1 compressed, a sixth of the memory, when the driver supports it */
+    bool compressTexture = false;
+    /*! bytes of texture copied to the GPU per frame, coarse levels first */
+    int textureUploadBudget = 8 << 20;
+    /*! create the buffers of a loaded mesh and its texture on a thread with a context sharing the
+        objects of this one, the frames go on with the preview and the texture they have until the
+        copies are fenced and swapped in, see GpuUploader, choose it before the widget is shown,
+        needs the core backend */
+    bool uploadThread = true;
+    /*! tile the texture into name.vtx and keep only the visible tiles on the GPU, for atlases
+        larger than video memory, needs the core backend */
+    bool virtualTexturing = false;
+    /*! megabytes of the tiles of a .mtx mesh kept on the GPU, see TiledMesh */
+    int tileMemory = 512;
+    /*! host:port of a MeshServer the meshes are read from, refined as the view needs, see StreamedMesh */
+    std::string meshServer = "";
+    /*! draw the edges of the triangles over the mesh, needs the core backend, W toggles it */
+    bool showWireframe = false;
+    /*! draw the boundary loops of the mesh over it, B toggles it */
+    bool showBoundary = false;
+    /*! draw the creases and the silhouette of the finest level of a single mesh over it, F toggles
+        it. the creases are found once as the mesh is expanded and the silhouette by a geometry
+        shader from the adjacency of the triangles, so the lines follow the camera without any
+        work on the CPU, see MeshLib::CFeatureEdges, needs the core backend */
+    bool showFeatures = false;
+    /*! degrees the normals turn by across a crease, choose it before the mesh is loaded */
+    float creaseAngle = 40;
+    /*! draw the mesh as splats sampled on an octree, see PointSplats, S toggles them, the
+        triangles are expanded only when they are first shown */
+    bool showSplats = false;
+    /*! levels of the octree below its root, the finest has 8^splatDepth cells */
+    int splatDepth = 8;
+    /*! the coarsest level whose cells are at least this many pixels wide at the nearest point is drawn */
+    float splatPixels = 2;
+    /*! show the tets of a volume mesh behind a plane facing the camera in place of its boundary, C toggles
+        it, a drag with Ctrl held moves the plane, see TMeshLib::CTSlicer */
+    bool showClip = false;
+    /*! draw the tets of a volume mesh as a translucent volume of their scalars in place of its
+        boundary, see TetVolume, V toggles it, [ and ] move the window of the transfer function,
+        comma and period narrow and widen it, - and = thin and thicken the volume, needs the core backend */
+    bool showVolume = false;
+    /*! the window of the scalars, mapped onto [0, 1], the transfer function spans, and the opacity of a unit of length */
+    float volumeCenter = 0.5f;
+    float volumeWidth = 1;
+    float volumeDensity = 2;
+    /*! the tet trait of the scalars, choose it before the mesh is loaded, see ViewerMesh::tet_field */
+    std::string volumeField = "value";
+    /*! draw the copies of the mesh, a fundamental domain laid out in the Poincare disk by its uvs,
+        under the group its side pairings generate, tiling the disk, in place of the mesh, T toggles
+        it. the domain is uploaded once and the copies are instances moved by their Mobius
+        transformations in the vertex shader, the sides and the axes of the pairings are drawn
+        over them with the boundary, see HyperbolicTiling, needs the core backend */
+    bool showTiling = false;
+    /*! the copies are the words of at most tilingLength side pairings, at most tilingCount of them */
+    int tilingLength = 12;
+    int tilingCount = 4096;
+    /*! cull the meshlets, pick the level of detail and sum the normals of edits in compute shaders,
+        needs the core backend, see MeshCompute */
+    bool computeCulling = true;
+    /*! skip the instances of a scene hidden behind others in the depth of an earlier frame, see
+        OcclusionCuller, choose it before the widget is shown, needs the core backend */
+    bool occlusionCulling = false;
+    /*! draw the instances of a scene covering at most impostorPixels on screen, at most
+        ImpostorAtlas::cellSize, by images of themselves captured into an atlas, good while the
+        direction to the eye turns less than impostorAngle degrees, at most impostorBudget captured
+        a frame, the others drawn as meshes until theirs is, see ImpostorAtlas. 0 draws every
+        instance as a mesh, choose it before the widget is shown, needs the core backend */
+    int impostorPixels = 0;
+    float impostorAngle = 4;
+    int impostorBudget = 8;
+    /*! write the triangle under every pixel first and shade every pixel once from it after, see
+        VisibilityBuffer, for meshes with many triangles below a pixel. a single mesh in the float layout
+        on the core backend, without the virtual texture, the wireframe, the error map or the subdivision,
+        draws so, one level in one draw without the meshlet culling, the others as usual */
+    bool visibilityRendering = false;
+    /*! read the mesh again when its file changes, watchDelay milliseconds after the last write.
+        an .obj file whose faces stay moves only the points of the blocks that changed, see
+        ViewerMesh::update_obj, patched into the buffers as edits, see beginEditing, any other
+        change is read in full, see openMesh. choose it before the mesh is loaded */
+    bool watchFile = false;
+    int watchDelay = 200;
+    /*! write a checkpoint of the mesh to checkpointFile every checkpointSeconds while it changes,
+        and on K, its slots, touched flags and properties as they are in memory, taken in a pass
+        over the arrays and written on a thread of their own, see ViewerMesh::checkpoint, so a long
+        editing session can go back to it by opening the .ckp file. 0 writes on K only */
+    std::string checkpointFile = "";
+    int checkpointSeconds = 0;
+    /*! split the window into this many views side by side, all drawn from the one set of buffers,
+        textures and programs, so that comparing levels or cameras costs no memory or loading per
+        view. the picks, the virtual texture feedback and the pixel error follow the view clicked
+        last, the occlusion culling the first, the visibility buffer needs a single view */
+    int viewportCount = 1;
+    /*! the level of detail every view draws, -1 or a missing entry picks it by its error on screen,
+        one past the coarsest draws the coarsest, choose them before the widget is shown */
+    std::vector<int> viewportLods;
+    /*! all views turn with the camera of the one dragged, or each keeps its own, L toggles it */
+    bool linkCameras = true;
+    /*! draw the CPU and GPU times of the phases of a frame over the view */
+    bool showHud = false;
+    /*! write the times of every frame to this CSV file, see FrameProfiler */
+    std::string profileLog = "";
 
     ViewerMesh * &v_mesh() { return vMesh; }
-    
+
+    /*! load the mesh on a background thread, drawing it while it is parsed, a .mtx file is drawn
+        from its tiles as they are read, see TiledMesh, and with meshServer the mesh of that name
+        as it streams in, see StreamedMesh */
+    void loadMesh(const std::string & fname);
+    /*! load the mesh on this thread in place of the current one, without a preview, false if it cannot be read */
+    bool openMesh(const std::string & fname);
+    /*! decode and upload the whole texture on this thread, an empty name takes the maps of the
+        materials of the mesh, or drops the texture without them */
+    bool openTexture(const std::string & fname);
+    /*! draw the view from alpha, beta and distance into an image, the widget need not be shown */
+    QImage renderView(double alpha, double beta, double distance);
+
+    /*! the MeshRenderer of BatchRenderer and CameraPath, on the framebuffer of the widget. the
+        context is made by the first grab once a mesh is open, the virtual texture is off */
+    void startOffscreen(int width, int height);
+    bool uploadMesh(const std::string & fname);
+    bool deviceReady() const { return isValid(); }
+    bool uploadTexture(const std::string & fname) { return openTexture(fname); }
+    QImage drawView(const Camera & camera) { return renderView(camera.alpha, camera.beta, camera.distance); }
+    /*! the frames are timed by the FrameProfiler of the widget */
+    void startTiming();
+    bool stopTiming(std::vector<FrameTime> & frames);
+
+    /*! show the scene of a scene file in place of the mesh, read once the widget has its context */
+    bool loadScene(const std::string & fname);
+    /*! show the scene in place of the mesh, false if it has no instances */
+    bool showScene(const Scene & s);
+    /*! the settings of the layout of the buffers, see RenderMesh */
+    RenderMesh::Options renderOptions() const;
+
+    /*! draw vMesh by its vertex and face slots so that its edits through v_mesh()->e_mesh() can be
+        patched into the buffers, false for a preview, a scene, splats, clipping or polygons. Until
+        endEditing the mesh has one level, in float layout, without reordering, boundary or picking */
+    bool beginEditing();
+    /*! copy the slots the edits since the last call touched into the buffers, see CDynamicMesh::takeChanges */
+    void updateEdits();
+    /*! expand the edited mesh as any other */
+    void endEditing();
+    /*! touched slots at most this far apart are copied as one range */
+    int editGap = 64;
+    /*! draw the edited mesh subdivided subdivisionLevels times by Loop's rules, D toggles it and
+        begins the editing. the stencils are built when the connectivity changes and the refined
+        points are evaluated from the slots in a compute pass after every edit, see
+        MeshLib::CSubdivision and MeshCompute::subdivide, needs the compute shaders */
+    bool showSubdivision = false;
+    int subdivisionLevels = 2;
+    /*! play the files numbered as the mesh, see MeshSequence::frames, as an animation of this many
+        frames a second once it is loaded, 0 shows the mesh alone. the mesh is edited by its slots, see
+        beginEditing, and the frames decoded on a thread are written into a ring of sequenceRing
+        position and normal buffers, the one after those the GPU may still draw, choose it before the
+        mesh is loaded with keepPositions */
+    int sequenceFps = 0;
+    /*! frames decoded ahead of the one shown */
+    int sequenceAhead = 4;
+
+signals:
+    /*! a right click picked the face and the vertex of it nearest to the click, their ids in the mesh,
+        -1 on the background */
+    void picked(int face, int vertex);
+
+public slots:
+    void appendBatch(const MeshBatch &batch);
+    void meshLoaded(int ret);
+    void textureLoaded(const TextureImage &image);
+    void virtualTextureOpened(bool ok);
+    void sceneMeshRead(int index, int ret);
+    void sceneLoaded();
+    void resourcesUploaded(const UploadedResources & resources);
 
 protected:
     void initializeGL();
@@ -31,23 +296,386 @@ protected:
     void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent *event);
+    void keyPressEvent(QKeyEvent *event);
+
+    /*! weld the corners of source into the buffers on this thread, see RenderMesh::expand */
+    void expandMesh(ViewerMesh * source);
+    /*! copy the vertices from `from` and the indices from `indexFrom` on into the buffers, growing them if needed */
+    void uploadBuffers(int from, int indexFrom);
+    /*! the vertex and index buffers hold the arrays from `from` and `indexFrom` on, write the smaller
+        buffers and point the attributes at them */
+    void buffersWritten(int from, int indexFrom);
+    /*! hand the arrays of mesh to the upload thread, it replaces the buffers once they are copied */
+    void startUpload(std::shared_ptr<RenderMesh> mesh);
+    /*! forget the mesh on the upload thread, its buffers are released as they arrive */
+    void dropUpload();
+    /*! draw the mesh the loader read, laid out in the arrays, from new buffers */
+    void showLoadedMesh();
+    //! a buffer object, persistently mapped on the core backend
+    struct GpuBuffer { GLenum target; GLuint id; int capacity; void * mapped; };
+    /*! write the bytes [from, size) of data into the buffer, reallocating it when it is too small */
+    void writeBuffer(GpuBuffer & buffer, const char * data, int from, int size);
+    template<typename T> void streamBuffer(GpuBuffer & buffer, const QVector<T> & data, int from);
+    /*! new storage of capacity bytes, persistently mapped on the core backend */
+    void allocateBuffer(GpuBuffer & buffer, int capacity);
+    /*! write size bytes of data at offset into the buffer in place, it must hold them */
+    void patchBuffer(GpuBuffer & buffer, const char * data, int offset, int size);
+    void freeBuffer(GpuBuffer & buffer);
+    /*! compile and link the programs, with virtual texture sampling if tiled, shading if lighting
+        and the wireframe if showWireframe */
+    void buildShaders(bool tiled);
+    /*! decode and upload normalMapFile on this thread, with its mipmaps */
+    void loadNormalMap();
+    /*! link program unless it is, from the binary cache when the driver and the sources match, false if it does not link */
+    bool linkProgram(QOpenGLShaderProgram & program);
+    /*! start loading the texture, decoded on a background thread */
+    void loadTexture();
+    /*! read the materials of the .mtl libraries of mesh fname, see MaterialAtlas */
+    void findMaterials(const std::string & fname);
+    /*! the file the texture is decoded from, empty for the atlas of several materials */
+    std::string textureFile() const;
+    /*! stream the texture in, tiled by the virtual texture or decoded whole by loadTexture */
+    void startTexture();
+    /*! allocate the texture of pendingTexture, its levels are uploaded by uploadTexture */
+    void createTexture();
+    /*! copy the next rows of pendingTexture to the texture, false once all levels are there */
+    bool uploadTexture();
+    /*! upload the rest of pendingTexture now, waiting for the copies */
+    void finishTexture();
+    /*! after every buffer swap, record the first frame and the first complete one with
+        --startup, closing the application then, see StartupProfiler */
+    void startupFrame();
+    /*! a texture with all levels of image, uploaded at once */
+    GLuint createImageTexture(const TextureImage & image);
+    /*! draw the tiles of a .mtx file in place of the mesh, fit into the view as a normalized mesh */
+    void loadTiles(const std::string & fname);
+    /*! draw the mesh name of meshServer in place of the mesh, fit into the view once its bounds arrive */
+    void connectMesh(const std::string & name);
+    /*! start reading the meshes of the scene */
+    void startScene();
+    /*! append scene mesh index, laid out by the loader, to the geometry of the scene */
+    void addSceneMesh(int index, const RenderMesh & source);
+    /*! write the instances of every scene mesh that the depth of the last frames does not hide and
+        the impostors do not draw, seen from eye, into the next region of the visible buffer, for drawScene */
+    void cullScene(const QMatrix4x4 & mvp, const QVector3D & eye);
+    /*! capture the instances cullScene queued into the impostor atlas with surface and draw the
+        impostors of the frame, with the vertex array of the scene bound */
+    void drawImpostors(QOpenGLShaderProgram & surface, const QMatrix4x4 & mvp);
+    /*! draw every mesh of the scene with all its instances, or the visible ones after cullScene, eye in scene coordinates */
+    void drawScene(const QMatrix4x4 & mvp, const QVector3D & eye);
+    /*! the level of detail of a scene mesh, from the instance with the most pixels per model unit */
+    int selectSceneLod(int mesh, const QVector3D & eye) const;
+    /*! the level of detail of a scene mesh at pixels per model unit */
+    int sceneLevel(int mesh, double pixels) const;
+    /*! the face and vertex of triangle id - 1 of the finest level, as read back by the picker */
+    void reportPick(uint32_t id);
+    /*! point the line program at the boundary buffer */
+    void bindBoundary();
+    /*! point the feature lines at the vertex buffer and the feature buffer */
+    void bindFeatures();
+    /*! expand vMesh into the triangle buffers, or sample its splats in their place */
+    void prepareMesh();
+    /*! measure vMesh against compareFile, moved as vMesh was normalized, and put the distance of
+        every vertex over the largest into the u of its corners, which the shaders map to colors,
+        see MeshLib::CMeshDistance */
+    void compareMesh();
+    /*! sort the tets of vMesh along the view direction and draw the surface of those behind the plane */
+    void startClip();
+    /*! copy the surface of the slicer into the index buffer, from its first change on unless full */
+    void updateClip(bool full);
+    /*! the tets of vMesh and their scalars into the volume, normalized as expandMesh does */
+    void uploadVolume();
+    /*! the faces of vMesh and their side pairings into the tiling */
+    void uploadTiling();
+    /*! the vertices of the slots [from, to) of the edited mesh into vertices, textureCoordinates and
+        normals when lit and shaded, and the triangles of its face slots [faceFrom, faceTo) into indices */
+    void expandSlots(size_t from, size_t to, size_t faceFrom, size_t faceTo, bool shaded = true);
+    /*! leave the slot layout, the mesh no longer tracks its changes */
+    void stopEditing();
+    /*! the stencils of the edited mesh if its connectivity changed, then its refined points, uvs
+        and normals from the slot buffers on the GPU */
+    void updateSubdivision();
+    /*! point the shader attributes at the refined buffers */
+    void bindRefined();
+    /*! whether the refined surface is drawn in place of the slots */
+    bool subdividing() const { return editing && showSubdivision && subdivision != NULL; }
+    /*! watch meshfile for watchFile, again after an exporter replaced it */
+    void watchMesh();
+    /*! the watched file settled, patch the mesh from it or read it in full */
+    void reloadMesh();
+    /*! count the changes of the mesh just read from here on, and take checkpoints every checkpointSeconds */
+    void startCheckpoints();
+    /*! take a checkpoint of vMesh if it changed since the last one, see checkpointFile, force takes
+        one anyway. a write still going on is left to finish, the checkpoint waits for the next turn */
+    void saveCheckpoint(bool force = false);
+    /*! play the frames of meshfile, see sequenceFps */
+    void startSequence();
+    /*! write the next decoded frame into the ring, a frame the decoder has not finished is shown later */
+    void advanceSequence();
+    /*! stop the frames, the slot buffers are drawn again */
+    void stopSequence();
+    /*! the splats into their buffer, once, their points are released */
+    void uploadSplats();
+    /*! point the splat program at the splat buffer */
+    void bindSplats();
+    /*! the level of the splats to draw, as selectLod */
+    int selectSplatLevel() const;
+    /*! pixels a unit of the normalized model covers at its nearest point */
+    double pixelsPerUnit() const;
+    /*! the triangles [first, first + count) of the index buffer into the visibility buffer, then every
+        pixel they cover shaded once, surface is bound again after */
+    void drawVisibility(QOpenGLShaderProgram & surface, const QMatrix4x4 & mvp, const QVector3D & eye, uint32_t first, uint32_t count);
+    /*! point the shader attributes at the vertex buffers */
+    void bindAttributes();
+    /*! the model transform of vMesh, its normalization if it keeps its points */
+    void resetModelTransform();
+    /*! the level of detail to draw from the camera distance and the viewport height */
+    int selectLod() const;
+    /*! the view under position, in widget coordinates */
+    int viewAt(const QPoint & position) const;
+    /*! make view the one the mouse moves, keeping the camera of the one before */
+    void selectView(int view);
+    /*! draw the frame of the current camera, projection and viewport, the first view captures the
+        occluders, the active one the feedback and the picks, true if it needs another frame */
+    bool drawViewport(bool first, bool active);
+    /*! the view changed, draw it at the next refresh, further requests until then are merged */
+    void requestFrame();
+    /*! draw the requested frame */
+    void drawFrame();
+    /*! the camera moved, draw coarse until it rests */
+    void cameraMoved();
+    /*! the camera rests, draw the full detail */
+    void refine();
 
     //! [1]
 private:
     //! [1]
     QMatrix4x4 pMatrix;
-    QGLShaderProgram shaderProgram;
-    QVector<QVector3D> vertices;
+    QOpenGLShaderProgram shaderProgram;
+    //! shaderProgram without the wireframe, drawn while the camera moves, built only when they differ
+    QOpenGLShaderProgram movingProgram;
+    //! whether movingProgram is built
+    bool movingVariant = false;
+    //! the tiles the view samples, drawn only with a virtual texture
+    QOpenGLShaderProgram feedbackProgram;
+    //! the triangle under a pixel, on the core backend
+    QOpenGLShaderProgram pickProgram;
+    //! the overlays drawn as lines
+    QOpenGLShaderProgram lineProgram;
+    //! the splats, drawn as round points
+    QOpenGLShaderProgram splatProgram;
+    //! the silhouette edges from the triangles with adjacency, on the core backend
+    QOpenGLShaderProgram silhouetteProgram;
+    //! the shading of the visibility buffer, on the core backend
+    QOpenGLShaderProgram resolveProgram;
     //! [2]
-    QVector<QVector2D> textureCoordinates;
-    GLuint texture;
+    //! the vertices, indices, levels and splats drawn are those of the RenderMesh base
+    //! runs of triangles left by the culling, and them as arguments of glMultiDrawElements
+    std::vector<uint32_t> drawFirst, drawCount;
+    QVector<const GLvoid *> drawOffsets;
+    QVector<GLsizei> drawCounts;
+    //! the triangles and draw calls of the surface in the last frame, for the render counters
+    size_t drawnTriangles = 0;
+    int drawCalls = 0;
+    GpuBuffer boundaryBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    QOpenGLVertexArrayObject boundaryVao;
+    GpuBuffer splatBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    QOpenGLVertexArrayObject splatVao;
+    //! RenderMesh::featureIndices, drawn with the positions of the vertex buffer
+    GpuBuffer featureBuffer = { GL_ELEMENT_ARRAY_BUFFER, 0, 0, NULL };
+    QOpenGLVertexArrayObject featureVao;
+    GpuBuffer vertexBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    GpuBuffer uvBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    GpuBuffer normalBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    //! whether the normal buffer holds a normal for every vertex
+    bool withNormals = false;
+    GpuBuffer indexBuffer = { GL_ELEMENT_ARRAY_BUFFER, 0, 0, NULL };
+    //! attribute bindings of the buffers, not created on legacy contexts without VAOs
+    QOpenGLVertexArrayObject vao;
+    int indexCount = 0;
+    GLuint texture = 0;
+    //! normalMapFile, whole, bound to unit 3, 0 without one
+    GLuint normalMap = 0;
+    //! the chain being uploaded, the level and the row of it that come next
+    TextureImage pendingTexture;
+    int pendingLevel = -1;
+    int pendingRow = 0;
+    //! set once the coarsest level is complete
+    bool textureReady = false;
+    //! when the texture was created, in StartupProfiler time
+    qint64 textureStart = 0;
+    //! the bytes of the texture, counted in the gpu.texture_bytes gauge
+    qint64 textureBytes = 0;
+    void countTexture(qint64 bytes);
+    //! since loadMesh, for the loader counters
+    QElapsedTimer loadClock;
+    /*! set the mesh.memory_bytes gauge to the memory of the mesh */
+    void countMesh();
+    //! whether a frame was swapped since launch, for StartupProfiler
+    bool startupFrameShown = false;
+    //! the rows on their way to the texture, and the fence of their copy on the core backend
+    GpuBuffer stagingBuffer = { GL_PIXEL_UNPACK_BUFFER, 0, 0, NULL };
+    GLsync uploadFence = 0;
+    //! the upload thread with uploadThread on the core backend, NULL otherwise
+    GpuUploader * uploader = NULL;
+    //! the mesh whose buffers are being created, the preview is drawn meanwhile
+    std::shared_ptr<RenderMesh> uploadingMesh;
+    //! the ticket of the last request, and those of the mesh and the texture awaited, 0 for none
+    int uploadTicket = 0;
+    int meshTicket = 0;
+    int textureTicket = 0;
+    //! when the buffers of uploadingMesh were asked for, in StartupProfiler time
+    qint64 uploadStart = 0;
+    VirtualTexture * virtualTexture = NULL;
+    //! the tiles of a .mtx mesh drawn in place of the buffers, NULL otherwise, needs the core backend
+    TiledMesh * tiledMesh = NULL;
+    //! the mesh of meshServer drawn in place of the buffers, NULL otherwise, needs the core backend
+    StreamedMesh * streamedMesh = NULL;
+    //! the view of the last feedback pass, a new one is drawn when it changed
+    QMatrix4x4 feedbackMvp;
+    bool feedbackStale = true;
+    Backend backend = CoreBackend;
+    //! the 4.5 entry points, NULL on the legacy backend
+    QOpenGLFunctions_4_5_Core * gl45 = NULL;
     //! [2]
     double alpha;
     double beta;
     double distance;
+    //! a pending frame, nothing is drawn while it is not running
+    QTimer frameTimer;
+    //! time since the last requested frame was drawn
+    QElapsedTimer sinceFrame;
+    //! runs from the last camera move until refineDelay later, the frames meanwhile are coarse
+    QTimer idleTimer;
+    bool moving = false;
+    int viewportWidth = 1;
+    int viewportHeight = 1;
+    //! a part of the window with its own camera, used when the cameras are not linked, and level
+    struct Viewport
+    {
+        QRect rect;
+        QMatrix4x4 projection;
+        double alpha = 0;
+        double beta = 0;
+        double distance = 2.5;
+        int lod = -1;
+    };
+    //! laid out by resizeGL, the camera fields of the active one are stale, alpha, beta and distance hold it
+    QVector<Viewport> views;
+    int activeView = 0;
+    //! the level of the view being drawn, -1 picks it by selectLod
+    int pinnedLod = -1;
     QPoint lastMousePosition;
+    //! preview normalization, then that of vMesh if it keeps its points, identity otherwise
+    QVector3D modelCenter;
+    float modelScale = 1;
+    Scene scene;
+    SceneLoader * sceneLoader = NULL;
+    //! a mesh of the scene: its levels in sceneLods, its instances in scene and in the instance
+    //! buffer from firstInstance on, counted once the scene is complete, and the decoding of its positions
+    struct SceneMesh
+    {
+        int firstLod = 0;
+        int lodCount = 0;
+        QVector<int> instances;
+        int firstInstance = 0;
+        int instanceCount = 0;
+        //! the instances cullScene left, from firstInstance on in its region
+        int visibleCount = 0;
+        GLuint texture = 0;
+        QMatrix4x4 decode;
+    };
+    //! empty without a scene
+    QVector<SceneMesh> sceneMeshes;
+    QVector<LodLevel> sceneLods;
+    //! the meshes expanded so far, moved into the buffers once the scene is complete
+    struct SceneGeometry
+    {
+        QVector<QVector3D> vertices;
+        QVector<QVector2D> textureCoordinates;
+        QVector<QVector3D> normals;
+        QVector<QuantizedPosition> quantizedVertices;
+        QVector<QuantizedUv> quantizedUvs;
+        QVector<QuantizedNormal> quantizedNormals;
+        QVector<GLuint> indices;
+    };
+    SceneGeometry sceneGeometry;
+    //! model matrix of every instance, those of a mesh in a row. the core backend reads them from
+    //! the instance buffer, a uniform block per draw, the legacy one draws instance by instance
+    QVector<QMatrix4x4> instanceMatrices;
+    GpuBuffer instanceBuffer = { GL_UNIFORM_BUFFER, 0, 0, NULL };
+    //! the instances left by the occlusion culling and the impostors, laid out as the instance buffer, in a ring of regions
+    //! the frames write in turn, each after the fence of the last frame that drew from it
+    OcclusionCuller occlusion;
+    VisibilityBuffer visibility;
+    static const int visibleRing = 3;
+    GpuBuffer visibleBuffer = { GL_UNIFORM_BUFFER, 0, 0, NULL };
+    GLsync visibleFences[visibleRing] = {};
+    int visibleRegionBytes = 0;
+    int visibleRegion = 0;
+    //! whether cullScene wrote the region of this frame
+    bool sceneCulled = false;
+    //! the distant instances while impostorPixels is set, their model matrices for the captures of
+    //! a frame at the end of its region, one uniform block apart
+    ImpostorAtlas impostors;
+    int captureOffset = 0;
+    int captureStride = 0;
+    int captureCount = 0;
+    //! the scene fit into the view, identity for a single mesh
+    QMatrix4x4 sceneMatrix;
+    //! times the phases of paintGL when the overlay or the log is on
+    FrameProfiler profiler;
+    MeshPicker picker;
+    //! the tets of vMesh drawn as a volume while showVolume is on
+    TetVolume volume;
+    //! the copies of vMesh in the disk while showTiling is on
+    HyperbolicTiling tiling;
+    //! the culling and the normals of edits on the GPU while computeCulling is on
+    MeshCompute compute;
+    //! the clipped tets while showClip is on for a volume mesh, NULL otherwise
+    TMeshLib::CTSlicer * slicer = NULL;
+    //! the view of the last ID pass, its result is measured against it
+    QMatrix4x4 pickMvp;
+    //! the buffers are indexed by the slots of vMesh, see beginEditing
+    bool editing = false;
+    //! the last frame drawn from them, the edits wait for it before writing over the mapped buffers
+    GLsync editFence = 0;
+    //! the slot ranges updateEdits copies, and the touched vertices whose normals change
+    std::vector<std::pair<size_t, size_t>> editVertices, editFaces;
+    std::vector<size_t> editNormals;
+    //! the subdivision of the edited mesh while showSubdivision is on, dropped when the editing stops
+    MeshLib::CSubdivision<CEditMesh> * subdivision = NULL;
+    //! the refined surface, written by the compute passes, and its triangles
+    GpuBuffer refinedVertexBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    GpuBuffer refinedUvBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    GpuBuffer refinedNormalBuffer = { GL_ARRAY_BUFFER, 0, 0, NULL };
+    GpuBuffer refinedIndexBuffer = { GL_ELEMENT_ARRAY_BUFFER, 0, 0, NULL };
+    QOpenGLVertexArrayObject refinedVao;
+    int refinedIndexCount = 0;
+    //! the frames of the animation, NULL without one, the buffers they are written into and the fence
+    //! of the last frame that drew each of them, sequenceSlot the one drawn next
+    MeshSequence * sequence = NULL;
+    static const int sequenceRing = 3;
+    GpuBuffer sequencePositions[sequenceRing];
+    GpuBuffer sequenceNormals[sequenceRing];
+    GLsync sequenceFences[sequenceRing] = {};
+    int sequenceSlot = -1;
+    QTimer sequenceTimer;
+    //! the file of the mesh while watchFile is on, and the wait for its writes to settle
+    QFileSystemWatcher watcher;
+    QTimer watchTimer;
+    //! the turns of the checkpoints, and the versions of the mesh the last one was taken at
+    QTimer checkpointTimer;
+    size_t checkpointTopology = 0;
+    size_t checkpointGeometry = 0;
     //! [3]
     ViewerMesh * vMesh;
+    MeshLoader * loader = NULL;
+    //! the meshes the loaders laid out, the index of a scene mesh or -1 for vMesh
+    RenderQueue renderQueue;
+    TextureLoader * textureLoader = NULL;
+    //! the materials of the mesh, drawn in place of an empty textfile
+    MaterialAtlas materials;
 };
 //! [3]
 
@@ -1,234 +1,896 @@
 #include "viewerMesh.h"
+#include "parser/objparser.h"
+#include "Geometry/PolygonTriangulation.h"
+#include "Geometry/VertexWelder.h"
+#include "Geometry/MeshSimplifier.h"
+#include "Geometry/OcclusionBaker.h"
+#include "Geometry/NormalBaker.h"
+#include "Geometry/AtlasPacker.h"
+#include "Mesh/segmentation.h"
+#include "parser/mtx.h"
+#include "parser/writer.h"
+#include "TetMesh/tmesh.h"
+#include "TetMesh/tboundary.h"
+#include "TetMesh/tquality.h"
+#include "parser/parser.h"
+#include "startupProfiler.h"
+#include "materialAtlas.h"
+#include <sys/stat.h>
 
 ViewerMesh::ViewerMesh()
 {
-    pMesh = new CMesh();
+    pMesh = new CEditMesh();
 }
 
 ViewerMesh::~ViewerMesh()
 {
+    delete e_mesh();
+}
 
+// name.obj -> name.smv, name.obj.gz -> name.smv
+static std::string cache_name(std::string fname)
+{
+    const std::string gz = ".gz";
+    if (fname.size() > gz.size() && fname.compare(fname.size() - gz.size(), gz.size(), gz) == 0) fname.resize(fname.size() - gz.size());
+    size_t dot = fname.find_last_of('.');
+    size_t sep = fname.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) return fname + ".smv";
+    return fname.substr(0, dot) + ".smv";
 }
 
-int ViewerMesh::input_obj(std::string fname)
+// the cache is fresh if it is not older than its source
+static bool cache_is_fresh(const std::string & fname, const std::string & cache)
 {
-    std::fstream f(fname, std::fstream::in);
-    if (f.fail()) return 3;
+    struct stat src, dst;
+    if (stat(fname.c_str(), &src) != 0 || stat(cache.c_str(), &dst) != 0) return false;
+    return dst.st_mtime >= src.st_mtime;
+}
 
-    std::string cmd;
-    int  vid = 1;
-    int  fid = 1;
+int ViewerMesh::input_smv(std::string fname)
+{
+    StartupProfiler::Stage stage("read_cache");
+    if (!m_smv.open(fname)) return 3;
+    // a cache written before the normals were computed is rebuilt
+    if (smooth_normals && !(m_smv.header().flags & SMV_NORMAL))
+    {
+        m_smv.close();
+        return 3;
+    }
+    if (!m_mesh()->read_smv(fname))
+    {
+        m_smv.close();
+        return 3;
+    }
 
-    bool with_uv = false;
-    bool with_normal = false;
+    mesh_with_uv = (m_smv.header().flags & SMV_UV) != 0;
+    mesh_with_normal = (m_smv.header().flags & SMV_NORMAL) != 0;
+    analyze(fname, m_smv.report());
 
-    std::vector<CPoint2> uvs;
-    std::vector<CPoint> normals;
+    // the mapped corners would draw the dropped parts
+    if (filter_components() > 0) m_smv.close();
+    if (decimate_ratio < 1) decimate(decimate_ratio);
 
-    while (std::getline(f, cmd))
+    // the mapped positions are the read points, as floats
+    const size_t n = m_smv.is_open() ? m_smv.num_vertices() : 0;
+    const bool dense = n > 0 && n == m_mesh()->vertices().size();
+    if (dense ? normalize(MeshLib::CPointBounds::of(m_smv.positions(), n)) : normalize())
     {
-        std::string line_info(cmd);
-        if (line_info.empty()) continue;
-        if (line_info[0] == '\0')
+        std::cout << "Normalizaion Issue" << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
+
+int ViewerMesh::input_obj(std::string fname, int threads)
+{
+    MESHLIB_TRACE_ZONE("input_obj");
+    m_blocks.clear();
+    if (is_model_file(fname)) return input_model(fname, threads);
+    // a cache on its own, as JobRunner leaves the meshes it processed
+    if (fname.size() > 4 && fname.compare(fname.size() - 4, 4, ".smv") == 0) return input_smv(fname);
+    if (fname.size() > 4 && fname.compare(fname.size() - 4, 4, ".ckp") == 0) return input_checkpoint(fname, threads);
+
+    MeshLib::CStoreKey key;
+    std::string stored;
+    if (use_cache && store)
+    {
+        // an unreadable cache is parsed and filed again
+        if (cache_key(fname, key) && store->find(key, ".smv", stored))
         {
-            continue;
+            int ret = input_smv(stored);
+            if (ret != 3) return ret;
         }
-        char * token;
-        token = strtok(&cmd[0], " \t\r\n");
+    }
+    else if (has_fresh_cache(fname))
+    {
+        // an unreadable cache leaves the mesh untouched, fall back to the .obj
+        int ret = input_smv(cache_name(fname));
+        if (ret != 3) return ret;
+    }
 
-        std::string check_token(token);
+    MeshLib::CObjData obj;
+    {
+        // the file is opened by the parser
+        StartupProfiler::Stage stage("parse");
+        if (!MeshLib::CObjParser::parse_file(fname, obj, threads)) return 3;
+    }
 
+    return input_obj_data(obj, fname);
+}
 
-        if (check_token == "v")
+bool ViewerMesh::is_tet_file(const std::string & fname)
+{
+    size_t dot = fname.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = fname.substr(dot);
+    return ext == ".tet" || ext == ".t" || ext == ".tmv";
+}
+
+bool ViewerMesh::is_model_file(const std::string & fname)
+{
+    size_t dot = fname.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = fname.substr(dot);
+    return ext == ".cmv" || ext == ".ply" || ext == ".glb";
+}
+
+int ViewerMesh::input_model(std::string fname, int threads)
+{
+    StartupProfiler::Stage stage("read_model");
+    const std::string ext = fname.substr(fname.find_last_of('.'));
+    bool ok;
+    m_mesh()->repair_input() = repair;
+    m_mesh()->weld_tolerance() = weld;
+    m_mesh()->reorder_input() = reorder;
+    if (ext == ".cmv") ok = m_mesh()->read_cmv(fname, threads);
+    else if (ext == ".ply") ok = m_mesh()->read_ply(fname, threads);
+    else ok = m_mesh()->read_glb(fname, threads);
+    if (!ok || m_mesh()->vertices().empty() || MeshLib::job_cancelled()) return 3;
+
+    // the formats may leave out uvs and normals, absent ones read as zero
+    mesh_with_uv = false;
+    mesh_with_normal = false;
+    for (CHalfEdge * he : m_mesh()->halfedges())
+    {
+        mesh_with_uv = mesh_with_uv || he->uv()[0] != 0 || he->uv()[1] != 0;
+        mesh_with_normal = mesh_with_normal || he->normal().norm() > 0;
+    }
+    if (!mesh_with_normal && smooth_normals)
+    {
+        m_mesh()->compute_normals();
+        mesh_with_normal = true;
+    }
+    analyze(fname, NULL, threads);
+    filter_components();
+    if (decimate_ratio < 1) decimate(decimate_ratio, threads);
+
+    if (normalize())
+    {
+        std::cout << "Normalizaion Issue" << std::endl;
+        return 2;
+    }
+    return 0;
+}
+
+int ViewerMesh::input_tet(std::string fname, int threads)
+{
+    using CTMesh = TMeshLib::CBaseTMesh<>;
+    CTMesh tmesh;
+    m_blocks.clear();
+    const std::string ext = fname.substr(fname.find_last_of('.'));
+    if (ext == ".tmv")
+    {
+        if (!tmesh._load_tmv(fname.c_str())) return 3;
+    }
+    else
+    {
+        // the loaders do not report a missing file
+        MeshLib::CMappedFile file(fname);
+        if (!file.is_open()) return 3;
+        file.close();
+        if (ext == ".t") tmesh._load_t(fname.c_str(), threads);
+        else tmesh._load(fname.c_str(), threads);
+    }
+
+    TMeshLib::CTBoundary<CTMesh>::extract(tmesh, *m_mesh(), threads);
+    if (m_mesh()->vertices().empty()) return 3;
+    analyze(fname, NULL, threads);
+    // kept for clipping, see GlWidget::showClip
+    m_tmesh.from_mesh(tmesh, threads);
+
+    // the scalars drawn by the volume rendering, in the order of the tets of m_tmesh
+    m_tvalues.clear();
+    m_tvalues.reserve(m_tmesh.num_tets());
+    bool valued = false;
+    for (auto pT : tmesh.tets())
+    {
+        float value = 0;
+        if (!tet_field.empty() && !pT->string().empty())
         {
-            token = strtok(NULL, " \t\r\n");
-            CPoint p;
-            int i = 0;
-            while (token != nullptr)
+            MeshLib::CParser parser(pT->string());
+            for (MeshLib::CToken * token : parser.tokens())
             {
-                if (i > 2)
-                {
-                    break;
-                }
-                p[i] = atof(token);
-                i++;
-                token = strtok(NULL, " \t\r\n");
+                if (token->key() != tet_field || token->value().size() < 2) continue;
+                value = strtof(token->value().c_str() + 1, NULL);
+                valued = true;
             }
-
-            CVertex * v = m_mesh()->create_vertex(vid);
-            v->point() = p;
-            vid++;
-            continue;
         }
+        m_tvalues.push_back(value);
+    }
+    if (!valued)
+    {
+        TMeshLib::CTetQuality quality;
+        TMeshLib::CTQuality::evaluate(m_tmesh, quality, threads);
+        m_tvalues.assign(quality.radius_ratio.begin(), quality.radius_ratio.end());
+    }
+    mesh_with_uv = false;
+    mesh_with_normal = false;
+    if (smooth_normals)
+    {
+        m_mesh()->compute_normals();
+        mesh_with_normal = true;
+    }
+
+    if (normalize())
+    {
+        std::cout << "Normalizaion Issue" << std::endl;
+        return 2;
+    }
+    return 0;
+}
+
+bool ViewerMesh::has_fresh_cache(std::string fname) const
+{
+    if (!use_cache) return false;
+    if (!store) return cache_is_fresh(fname, cache_name(fname));
+    MeshLib::CStoreKey key;
+    std::string stored;
+    return cache_key(fname, key) && store->find(key, ".smv", stored);
+}
 
+bool ViewerMesh::cache_key(const std::string & fname, MeshLib::CStoreKey & key) const
+{
+    // a loader asks has_fresh_cache, then reads or writes the cache, the file is hashed once
+    struct stat src;
+    if (stat(fname.c_str(), &src) != 0) return false;
+    if (fname != m_keyed || (long long)src.st_mtime != m_keyed_time || (long long)src.st_size != m_keyed_size)
+    {
+        m_keyed.clear();
+        if (!MeshLib::CContentStore::hash_file(fname, m_file_key)) return false;
+        m_keyed = fname;
+        m_keyed_time = (long long)src.st_mtime;
+        m_keyed_size = (long long)src.st_size;
+    }
+    // the options that change the cached mesh, and the version of its format
+    std::string stage = "smv " + std::to_string(SMV_VERSION);
+    if (smooth_normals) stage += " normals";
+    if (ear_clipping) stage += " ears";
+    if (repair) stage += " repair";
+    if (reorder) stage += " reorder";
+    if (patches > 0) stage += " patches " + std::to_string(patches);
+    if (weld >= 0)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), " weld %.17g", weld);
+        stage += text;
+    }
+    key = MeshLib::CContentStore::hash(stage, m_file_key);
+    return true;
+}
+
+int ViewerMesh::input_obj_data(MeshLib::CObjData & obj, std::string fname)
+{
+    MESHLIB_TRACE_ZONE("input_obj_data");
+    // the records as parsed, before the uvs move into the atlas
+    if (watch) m_blocks.build(obj);
+    else m_blocks.clear();
+    mesh_with_uv = obj.with_uv();
+    mesh_with_normal = obj.with_normal();
+
+    StartupProfiler & startup = StartupProfiler::instance();
+    qint64 start = startup.now();
 
-        if (check_token == "vt")
+    // the faces of a material follow each other, those without one first, so that every
+    // material is a contiguous range of the triangles
+    MaterialAtlas atlas;
+    atlas.read(fname, obj.mtllibs);
+    std::vector<int> faceMaterial, order(obj.num_faces()), first(atlas.size() + 2, 0);
+    obj.face_materials(faceMaterial);
+    for (int & m : faceMaterial) m = m < 0 ? -1 : atlas.find(obj.materials[m]);
+    for (int m : faceMaterial) first[m + 2]++;
+    for (size_t m = 1; m < first.size(); m++) first[m] += first[m - 1];
+    for (int f = 0; f < obj.num_faces(); f++) order[first[faceMaterial[f] + 1]++] = f;
+
+    // triangle corners, polygons are triangulated in place
+    std::vector<int> tris, tri_uvs, tri_normals, local;
+    tris.reserve(obj.corners.size());
+    // with several materials the uvs move into the cells of their atlas, a uv shared by faces
+    // of different materials is copied for every one
+    const bool tiled = atlas.tiled() && mesh_with_uv;
+    std::vector<CPoint2> atlasUvs;
+    std::vector<int> uvMaterial(tiled ? obj.uvs.size() : 0, -2), uvMoved(tiled ? obj.uvs.size() : 0);
+    for (int f : order)
+    {
+        int fb = obj.face_offsets[f];
+        int n = obj.face_offsets[f + 1] - fb;
+        if (n < 3) continue;
+
+        local.clear();
+        triangulate(obj, f, local);
+        for (int k : local)
         {
-            with_uv = true;
-            mesh_with_uv = true;
-            CPoint2 uv;
-            token = strtok(NULL, " \t\r\n");
-            int i = 0;
-            while (token != nullptr)
+            const MeshLib::CObjCorner & c = obj.corners[fb + k];
+            tris.push_back(c.v);
+            tri_normals.push_back(c.n);
+            const int m = faceMaterial[f];
+            if (!tiled || m < 0 || c.t < 0 || c.t >= (int)obj.uvs.size())
+            {
+                tri_uvs.push_back(tiled ? -1 : c.t);
+                continue;
+            }
+            // the faces of m are contiguous, a uv last moved for m is moved already
+            if (uvMaterial[c.t] != m)
             {
-                if (i > 1)
-                {
-                    break;
-                }
-                uv[i] = atof(token);
-                i++;
-                token = strtok(NULL, " \t\r\n");
+                uvMaterial[c.t] = m;
+                uvMoved[c.t] = (int)atlasUvs.size();
+                atlasUvs.push_back(atlas.place(m, obj.uvs[c.t]));
             }
-            uvs.push_back(uv);
-            continue;
+            tri_uvs.push_back(uvMoved[c.t]);
         }
+    }
+    if (tiled) obj.uvs.swap(atlasUvs);
 
-        if (check_token == "vn")
-        {
-            with_normal = true;
-            mesh_with_normal = true;
-            token = strtok(NULL, " \t\r\n");
-            CPoint n;
-            int i = 0;
-            while (token != nullptr)
-            {
+    startup.record("triangulate", start);
+    // the halfedges, then label_boundary
+    start = startup.now();
+    m_mesh()->repair_input() = repair;
+    m_mesh()->weld_tolerance() = weld;
+    m_mesh()->reorder_input() = reorder;
+    m_mesh()->build_from_arrays(obj.points, obj.uvs, obj.normals, tris, std::vector<int>(),
+        mesh_with_uv ? tri_uvs : std::vector<int>(), mesh_with_normal ? tri_normals : std::vector<int>());
+    startup.record("build", start);
+    // a load cancelled in the build is neither cached nor finished, see MeshLib::CJob
+    if (MeshLib::job_cancelled()) return 3;
+    // update_obj finds the vertex of point i by its id and the halfedges in the order of the corners, as plainly built
+    if (repair || reorder || weld >= 0 || m_mesh()->vertices().size() != obj.points.size() || m_mesh()->halfedges().size() != tris.size())
+        m_blocks.clear();
+    m_corner_normals.clear();
+    if (!m_blocks.empty() && mesh_with_normal) m_corner_normals = tri_normals;
+    // the parsed points are contiguous, their bounds are folded before they are freed
+    bool dense = !obj.points.empty() && obj.points.size() == m_mesh()->vertices().size();
+    MeshLib::CPointBounds box;
+    if (dense) box = MeshLib::CPointBounds::of(&obj.points[0][0], obj.points.size());
+    obj.clear();
+    if (!mesh_with_normal && smooth_normals)
+    {
+        StartupProfiler::Stage stage("normals");
+        m_mesh()->compute_normals();
+        mesh_with_normal = true;
+    }
+    if (patches > 0)
+    {
+        StartupProfiler::Stage stage("segment");
+        MeshLib::CAdjacency<CMesh> adjacency(*m_mesh());
+        MeshLib::CSegmentation segmentation;
+        segmentation.max_faces = patches;
+        segmentation.segment(adjacency);
+        segmentation.reorder(*m_mesh(), adjacency);
+        m_blocks.clear();
+    }
+    analyze(fname, NULL);
 
-                n[i] = atof(token);
-                i++;
-                token = strtok(NULL, " \t\r\n");
-            }
-            normals.push_back(n);
-            continue;
+    // the cache keeps the original coordinates, and all parts, and their report
+    if (use_cache)
+    {
+        StartupProfiler::Stage stage("write_cache");
+        MeshLib::CStoreKey key;
+        std::string stored;
+        if (!store) m_mesh()->write_smv(cache_name(fname), mesh_with_uv, mesh_with_normal, &m_report);
+        else if (cache_key(fname, key))
+            store->put(key, ".smv", [&](const std::string & tmp) { return m_mesh()->write_smv(tmp, mesh_with_uv, mesh_with_normal, &m_report); }, stored);
+    }
+    if (filter_components() > 0)
+    {
+        dense = false;
+        m_blocks.clear();
+    }
+    if (decimate_ratio < 1)
+    {
+        decimate(decimate_ratio);
+        dense = false;
+        m_blocks.clear();
+    }
+
+    start = startup.now();
+    const int normalized = dense ? normalize(box) : normalize();
+    startup.record("normalize", start);
+    if (normalized)
+    {
+        std::cout << "Normalizaion Issue" << std::endl;
+        return 2;
+    }
+    m_blocks_topology = m_mesh()->topology_version();
+
+    return 0;
+}
+
+int ViewerMesh::update_obj(std::string fname, int threads)
+{
+    MESHLIB_TRACE_ZONE("update_obj");
+    if (m_blocks.empty() || m_mesh()->topology_version() != m_blocks_topology) return 1;
+    MeshLib::CObjData obj;
+    if (!MeshLib::CObjParser::parse_file(fname, obj, threads)) return 3;
+    MeshLib::CObjBlocks blocks;
+    blocks.build(obj, threads);
+    MeshLib::CObjBlocks::CRanges points, normals;
+    if (!blocks.changed(m_blocks, points, normals)) return 1;
+
+    // the points of the changed blocks that moved, mapped as normalize() mapped them at the first read
+    CEditMesh * mesh = e_mesh();
+    const CPoint center = keep_positions ? CPoint(0, 0, 0) : norm_center;
+    const double scale = keep_positions ? 1 : norm_scale;
+    size_t moved = 0;
+    for (const std::pair<size_t, size_t> & r : points)
+    {
+        for (size_t i = r.first; i < r.second; i++)
+        {
+            CVertex * pv = mesh->vertex((int)i + 1);
+            if (!pv) continue;
+            const CPoint p = (obj.points[i] - center) * scale;
+            const CPoint & q = pv->point();
+            if (p[0] == q[0] && p[1] == q[1] && p[2] == q[2]) continue;
+            mesh->editVertex(pv);
+            pv->point() = p;
+            moved++;
         }
+    }
 
-        if (check_token == "f")
+    // the halfedges of the changed normals, in the order they were built
+    if (!normals.empty() && !m_corner_normals.empty())
+    {
+        std::vector<char> changed(obj.normals.size(), 0);
+        for (const std::pair<size_t, size_t> & r : normals) std::fill(changed.begin() + r.first, changed.begin() + r.second, 1);
+        mesh->halfedges().compact();
+        const std::vector<CHalfEdge*> & halfedges = mesh->halfedges().data();
+        MeshLib::parallel_for(halfedges.size(), threads, [&](size_t b, size_t e)
         {
-            std::vector<CVertex*> vs;
-            token = strtok(NULL, " /\t\r\n");
-            while (token != nullptr)
+            for (size_t k = b; k < e; k++)
             {
-                int ids[3];
-                int k = 0;
-                int loop_count = 1 + with_uv + with_normal;
-                for (int j = 0; j<loop_count; j++)
-                {
-                    ids[k] = atoi(token);
-                    k++;
-                    token = strtok(NULL, " /\t\r\n");
-                }
-
-                CVertex * vi = m_mesh()->m_map_vert[ids[0]];
-                if (with_uv)
-                    vi->uv() = uvs[ids[1] - 1];
-                if (with_normal && !with_uv)
-                {
-                    vi->normal() = normals[ids[1] - 1];
-                }
-                if (with_normal && with_uv)
-                {
-                    vi->normal() = normals[ids[2] - 1];
-                }
-                vs.push_back(vi);
+                const int n = m_corner_normals[k];
+                if (n >= 0 && n < (int)changed.size() && changed[n]) halfedges[k]->normal() = obj.normals[n];
             }
-            if (vs.size() == 3)
+        });
+    }
+
+    // the mapped cache holds the points as they were
+    if (moved > 0) m_smv.close();
+    m_blocks = std::move(blocks);
+    MESHLIB_COUNTER_ADD("reload.points_moved", moved);
+    std::cout << "Moved " << moved << " points in " << points.size() << " runs of changed blocks" << std::endl;
+    return 0;
+}
+
+size_t ViewerMesh::decimate(double ratio, int threads)
+{
+    MESHLIB_TRACE_ZONE("decimate");
+    StartupProfiler::Stage stage("decimate");
+    CMesh * mesh = m_mesh();
+    // the vertices by their property slots, the slots of removed vertices stay empty
+    size_t nv = 0;
+    for (CVertex * pv : mesh->vertices()) nv = std::max(nv, pv->property_index() + 1);
+    std::vector<CVertex*> vertices(nv, NULL);
+    for (CVertex * pv : mesh->vertices()) vertices[pv->property_index()] = pv;
+
+    // the corners as fans of triangles, welded by their uvs so that the seams are borders the
+    // simplifier keeps in place
+    std::vector<uint32_t> cornerVertex;
+    std::vector<float> cornerUv;
+    for (CFace * pf : mesh->faces())
+    {
+        CHalfEdge * first = pf->halfedge();
+        for (CHalfEdge * phe = first->next(); phe->next() != first; phe = phe->next())
+        {
+            for (CHalfEdge * c : { first, phe, phe->next() })
             {
-                CFace * c_pf = m_mesh()->create_face(vs, fid++);
+                cornerVertex.push_back((uint32_t)c->vertex()->property_index());
+                cornerUv.push_back((float)c->uv()[0]);
+                cornerUv.push_back((float)c->uv()[1]);
             }
-            else if (vs.size() == 4)
+        }
+    }
+    std::vector<uint32_t> unique, welded;
+    MeshLib::CVertexWelder::weld(vertices.size(), cornerVertex.data(), cornerVertex.size(),
+        mesh_with_uv ? cornerUv.data() : NULL, NULL, unique, welded, threads);
+    std::vector<float> positions(3 * unique.size());
+    for (size_t i = 0; i < unique.size(); i++)
+    {
+        const CPoint & p = vertices[cornerVertex[unique[i]]]->point();
+        for (int d = 0; d < 3; d++) positions[3 * i + d] = (float)p[d];
+    }
+
+    MeshLib::CMeshSimplifier simplifier(welded.data(), welded.size(), positions.data(), unique.size(), threads);
+    const size_t before = simplifier.size();
+    simplifier.simplify_ratio(ratio, threads);
+    std::vector<uint32_t> left;
+    simplifier.triangles(left);
+
+    // the vertices still used, in their order, and a uv for every welded vertex
+    std::vector<int> number(vertices.size(), -1);
+    std::vector<CPoint> points;
+    std::vector<CPoint2> uvs;
+    std::vector<int> indices(left.size()), uvIndices;
+    for (size_t k = 0; k < left.size(); k++)
+    {
+        const uint32_t v = cornerVertex[unique[left[k]]];
+        if (number[v] < 0)
+        {
+            number[v] = (int)points.size();
+            points.push_back(vertices[v]->point());
+        }
+        indices[k] = number[v];
+    }
+    if (mesh_with_uv)
+    {
+        std::vector<int> uvNumber(unique.size(), -1);
+        uvIndices.resize(left.size());
+        for (size_t k = 0; k < left.size(); k++)
+        {
+            const uint32_t w = left[k];
+            if (uvNumber[w] < 0)
             {
-                // loop the vertex vector to decompose polygon to triangles.
-                for (int i_if = 0; i_if < vs.size() - 2; i_if++)
-                {
-                    std::vector<CVertex *> vs_c;
-                    vs_c.push_back(vs[0]);
-                    vs_c.push_back(vs[i_if + 1]);
-                    vs_c.push_back(vs[i_if + 2]);
-                    CFace * c_pf = m_mesh()->create_face(vs_c, fid++);
-                }
+                uvNumber[w] = (int)uvs.size();
+                uvs.push_back(CPoint2(cornerUv[2 * unique[w]], cornerUv[2 * unique[w] + 1]));
             }
-            else
+            uvIndices[k] = uvNumber[w];
+        }
+    }
+
+    delete e_mesh();
+    pMesh = new CEditMesh();
+    m_smv.close();
+    m_mesh()->build_from_arrays(points, uvs, std::vector<CPoint>(), indices, std::vector<int>(), uvIndices, std::vector<int>());
+    mesh_with_normal = false;
+    if (smooth_normals)
+    {
+        m_mesh()->compute_normals(threads);
+        mesh_with_normal = true;
+    }
+    std::cout << "decimated " << before << " triangles to " << left.size() / 3 << std::endl;
+    return left.size() / 3;
+}
+
+int ViewerMesh::output(std::string fname, int threads)
+{
+    const size_t dot = fname.find_last_of('.');
+    const std::string ext = dot == std::string::npos ? "" : fname.substr(dot);
+    CMesh * mesh = m_mesh();
+    if (ext == ".off") mesh->write_off(fname, threads);
+    else if (ext == ".m") mesh->write_m(fname, {}, threads);
+    else if (ext == ".ply") return mesh->write_ply(fname, mesh_with_uv, mesh_with_normal) ? 0 : 3;
+    else if (ext == ".glb") return mesh->write_glb(fname, mesh_with_uv, mesh_with_normal) ? 0 : 3;
+    else if (ext == ".smv") return mesh->write_smv(fname, mesh_with_uv, mesh_with_normal) ? 0 : 3;
+    else if (ext == ".ckp")
+    {
+        if (!checkpoint(fname, threads)) return 3;
+        return m_checkpoints.wait() ? 0 : 3;
+    }
+    else if (ext == ".mtx") return output_tiles(fname, threads) ? 0 : 3;
+    else if (ext != ".obj") return 1;
+    else
+    {
+        // CBaseMesh::write_obj writes a uv per vertex, the seams need one per corner
+        MeshLib::CTextWriter out(fname);
+        if (!out.is_open()) return 3;
+        mesh->vertices().compact();
+        mesh->faces().compact();
+        const std::vector<CVertex*> & vertices = mesh->vertices().data();
+        const std::vector<CFace*> & faces = mesh->faces().data();
+        // the 1 based number of every vertex by its property slot, and the first corner of every face
+        size_t nv = 0;
+        for (CVertex * pv : vertices) nv = std::max(nv, pv->property_index() + 1);
+        std::vector<unsigned long long> number(nv, 0);
+        for (size_t i = 0; i < vertices.size(); i++) number[vertices[i]->property_index()] = i + 1;
+        std::vector<size_t> first(faces.size() + 1, 0);
+        for (size_t f = 0; f < faces.size(); f++)
+        {
+            size_t n = 0;
+            for (CHalfEdge * phe : faces[f]->halfedges_range()) n += phe->face() == faces[f];
+            first[f + 1] = first[f] + n;
+        }
+        out.records(vertices.size(), threads, [&](size_t i, MeshLib::CFormatBuffer & b)
+        {
+            b << "v " << vertices[i]->point() << '\n';
+        });
+        if (mesh_with_uv) out.records(faces.size(), threads, [&](size_t f, MeshLib::CFormatBuffer & b)
+        {
+            for (CHalfEdge * phe : faces[f]->halfedges_range()) b << "vt " << phe->uv() << '\n';
+        });
+        if (mesh_with_normal) out.records(faces.size(), threads, [&](size_t f, MeshLib::CFormatBuffer & b)
+        {
+            for (CHalfEdge * phe : faces[f]->halfedges_range()) b << "vn " << phe->normal() << '\n';
+        });
+        out.records(faces.size(), threads, [&](size_t f, MeshLib::CFormatBuffer & b)
+        {
+            size_t k = first[f] + 1;
+            b << 'f';
+            for (CHalfEdge * phe : faces[f]->halfedges_range())
             {
-                std::cout << "Polygons with more than four edges are not supported." << std::endl;
-                exit(-3);
+                b << ' ' << number[phe->vertex()->property_index()];
+                if (mesh_with_uv || mesh_with_normal) b << '/';
+                if (mesh_with_uv) b << (unsigned long long)k;
+                if (mesh_with_normal) b << '/' << (unsigned long long)k;
+                k++;
             }
-            continue;
-        }
+            b << '\n';
+        });
+        if (!out.close()) return 3;
+        return 0;
+    }
+    // the text writers report a failure on the console only
+    struct stat st;
+    return stat(fname.c_str(), &st) == 0 && st.st_size > 0 ? 0 : 3;
+}
 
-        if (check_token == "mtllib")
+bool ViewerMesh::checkpoint(std::string fname, int threads)
+{
+    MESHLIB_TRACE_ZONE("checkpoint");
+    if (m_checkpoints.busy()) return false;
+    std::shared_ptr<MeshLib::CCheckpoint> ckp = m_mesh()->checkpoint(threads);
+    // what the view needs besides the mesh, the points stay normalized
+    const double normalization[4] = { norm_center[0], norm_center[1], norm_center[2], norm_scale };
+    ckp->add("viewer.normalization", normalization, 4);
+    const uint8_t with[2] = { mesh_with_uv, mesh_with_normal };
+    ckp->add("viewer.with", with, 2);
+    m_checkpoints.write(ckp, fname);
+    return true;
+}
+
+int ViewerMesh::input_checkpoint(std::string fname, int threads)
+{
+    StartupProfiler::Stage stage("read_checkpoint");
+    MeshLib::CCheckpoint ckp;
+    if (!ckp.read(fname) || !m_mesh()->restore(ckp, threads) || m_mesh()->vertices().empty()) return 3;
+    m_smv.close();
+    const double * normalization = ckp.get<double>("viewer.normalization", 4);
+    const uint8_t * with = ckp.get<uint8_t>("viewer.with", 2);
+    if (normalization && with)
+    {
+        norm_center = CPoint(normalization[0], normalization[1], normalization[2]);
+        norm_scale = normalization[3];
+        mesh_with_uv = with[0] != 0;
+        mesh_with_normal = with[1] != 0;
+        return 0;
+    }
+    // a checkpoint of another program, its points as they were
+    mesh_with_uv = mesh_with_normal = true;
+    return normalize() ? 2 : 0;
+}
+
+bool ViewerMesh::output_tiles(const std::string & fname, int threads)
+{
+    std::vector<uint32_t> indices;
+    std::vector<float> vertices;
+    welded_vertices(indices, vertices, threads);
+    return MeshLib::write_mtx_file(fname, indices.data(), indices.size(), vertices.data(), vertices.size() / 8, mesh_with_uv,
+        1 << 15, threads);
+}
+
+void ViewerMesh::welded_vertices(std::vector<uint32_t> & indices, std::vector<float> & vertices, int threads)
+{
+    // the corners as fans of triangles, welded by their uvs and normals, the seams become borders
+    // the simplifier keeps in place
+    CMesh * mesh = m_mesh();
+    size_t nv = 0;
+    for (CVertex * pv : mesh->vertices()) nv = std::max(nv, pv->property_index() + 1);
+    std::vector<CHalfEdge *> corners;
+    std::vector<uint32_t> cornerVertex;
+    std::vector<float> cornerUv, cornerNormal;
+    for (CFace * pf : mesh->faces())
+    {
+        CHalfEdge * first = pf->halfedge();
+        for (CHalfEdge * phe = first->next(); phe->next() != first; phe = phe->next())
         {
-            std::string tx_info_i;
-            while (token != nullptr)
+            for (CHalfEdge * c : { first, phe, phe->next() })
             {
-                tx_info_i += token;
-                tx_info_i += " ";
-                token = strtok(NULL, " \n");
+                corners.push_back(c);
+                cornerVertex.push_back((uint32_t)c->vertex()->property_index());
+                for (int d = 0; d < 2; d++) cornerUv.push_back((float)c->uv()[d]);
+                for (int d = 0; d < 3; d++) cornerNormal.push_back((float)c->normal()[d]);
             }
-            tx_info_i = tx_info_i.substr(0, tx_info_i.size() - 1);
-            continue;
         }
-        if (check_token == "#")
+    }
+    std::vector<uint32_t> unique;
+    MeshLib::CVertexWelder::weld(nv, cornerVertex.data(), cornerVertex.size(), mesh_with_uv ? cornerUv.data() : NULL,
+        mesh_with_normal ? cornerNormal.data() : NULL, unique, indices, threads);
+    vertices.assign(8 * unique.size(), 0.0f);
+    for (size_t i = 0; i < unique.size(); i++)
+    {
+        CHalfEdge * c = corners[unique[i]];
+        for (int d = 0; d < 3; d++) vertices[8 * i + d] = (float)c->vertex()->point()[d];
+        if (mesh_with_normal) for (int d = 0; d < 3; d++) vertices[8 * i + 3 + d] = (float)c->normal()[d];
+        if (mesh_with_uv) for (int d = 0; d < 2; d++) vertices[8 * i + 6 + d] = (float)c->uv()[d];
+    }
+}
+
+size_t ViewerMesh::bake_occlusion(int width, int height, int rays, std::vector<float> & ao, int threads)
+{
+    ao.assign((size_t)std::max(width, 0) * std::max(height, 0), 1.0f);
+    if (!mesh_with_uv) return 0;
+    // the polygons as fans around their first corner, a corner is the halfedge ending there
+    std::vector<CHalfEdge *> corners;
+    for (CFace * pf : m_mesh()->faces())
+    {
+        CHalfEdge * first = pf->halfedge();
+        for (CHalfEdge * he = first->next(); he->next() != first; he = he->next())
         {
-            continue;
+            corners.push_back(first);
+            corners.push_back(he);
+            corners.push_back(he->next());
         }
-        else
+    }
+    MeshLib::COcclusionBaker baker;
+    baker.rays = rays;
+    return baker.bake(corners.size() / 3, [&](size_t t, int k)
+    {
+        CHalfEdge * he = corners[3 * t + k];
+        return MeshLib::CBakeCorner{ he->vertex()->point(), he->normal(), he->uv() };
+    }, width, height, ao, threads);
+}
+
+void ViewerMesh::texture_corners(std::vector<MeshLib::CRebakeCorner> & corners)
+{
+    corners.clear();
+    for (CFace * pf : m_mesh()->faces())
+    {
+        CHalfEdge * first = pf->halfedge();
+        for (CHalfEdge * he = first->next(); he->next() != first; he = he->next())
         {
-            continue;
+            for (CHalfEdge * c : { first, he, he->next() }) corners.push_back(MeshLib::CRebakeCorner{ c->vertex()->point(), c->uv() });
         }
     }
+}
 
-    if (normalize())
+void ViewerMesh::bake_corners(std::vector<MeshLib::CBakeCorner> & corners)
+{
+    corners.clear();
+    for (CFace * pf : m_mesh()->faces())
     {
-        std::cout << "Normalizaion Issue" << std::endl;
-        return 2;
+        CHalfEdge * first = pf->halfedge();
+        for (CHalfEdge * he = first->next(); he->next() != first; he = he->next())
+        {
+            for (CHalfEdge * c : { first, he, he->next() })
+                corners.push_back(MeshLib::CBakeCorner{ c->vertex()->point(), c->normal(), c->uv() });
+        }
     }
+}
 
-    f.close();
-    m_mesh()->label_boundary();
-
-    return 0;
+size_t ViewerMesh::bake_normals(const std::vector<MeshLib::CBakeCorner> & high, int width, int height, std::vector<uint32_t> & out,
+                                int threads)
+{
+    out.assign((size_t)std::max(width, 0) * std::max(height, 0), 0);
+    if (!mesh_with_uv) return 0;
+    std::vector<MeshLib::CBakeCorner> low;
+    bake_corners(low);
+    MeshLib::CNormalBaker baker;
+    return baker.bake(high.size() / 3, [&](size_t t, int k) { return high[3 * t + k]; },
+                      low.size() / 3, [&](size_t t, int k) { return low[3 * t + k]; }, width, height, out, threads);
 }
 
-int ViewerMesh::normalize()
+size_t ViewerMesh::repack_atlas(const CPoint2 & density, int padding, int & width, int & height, int threads)
 {
-    double x_min = DBL_MAX, y_min = DBL_MAX, z_min = DBL_MAX;
-    double x_max = DBL_MIN, y_max = DBL_MIN, z_max = DBL_MIN;
-    CPoint cp_min;
-    CPoint cp_a(0,0,0);
-    double x_d, y_d, z_d;
+    width = height = 0;
+    if (!mesh_with_uv) return 0;
+    // the charts are the parts of the mesh cut along its uv seams
+    MeshLib::CComponents<CMesh> charts(*m_mesh(), "chart");
+    charts.label(&MeshLib::CComponents<CMesh>::same_uv, threads);
+    std::vector<CHalfEdge *> corners;
+    std::vector<uint32_t> chart;
+    for (CFace * pf : m_mesh()->faces())
+    {
+        CHalfEdge * first = pf->halfedge();
+        for (CHalfEdge * he = first->next(); he->next() != first; he = he->next())
+        {
+            corners.push_back(first);
+            corners.push_back(he);
+            corners.push_back(he->next());
+            chart.push_back((uint32_t)charts.component(pf));
+        }
+    }
+    m_mesh()->remove_face_property("chart");
 
-    for (CVertex * pv : m_mesh()->vertices())
+    MeshLib::CAtlasPacker packer;
+    packer.padding = padding;
+    std::vector<CPoint2> uv;
+    const size_t n = packer.pack(chart.size(), [&](size_t t, int k) { return corners[3 * t + k]->uv(); }, chart.data(),
+                                 density, uv, width, height, threads);
+    // the triangles of a fan move with their chart, so their shared corners get one uv
+    for (size_t i = 0; i < corners.size(); i++)
     {
-        CPoint cp = pv->point();
-        for (int i = 0; i < 3; i++)
+        corners[i]->uv() = uv[i];
+        corners[i]->vertex()->uv() = uv[i];
+    }
+    m_smv.close();
+    return n;
+}
+
+void ViewerMesh::triangulate(const MeshLib::CObjData & obj, int f, std::vector<int> & tris) const
+{
+    int fb = obj.face_offsets[f];
+    int n = obj.face_offsets[f + 1] - fb;
+    if (!ear_clipping || n == 3)
+    {
+        MeshLib::CPolygonTriangulation::fan(n, tris);
+        return;
+    }
+    for (int k = 0; k < n; k++)
+    {
+        int v = obj.corners[fb + k].v;
+        if (v < 0 || v >= (int)obj.points.size())
         {
-            cp_a[i] += cp[i];
+            // invalid faces are rejected by the builder
+            MeshLib::CPolygonTriangulation::fan(n, tris);
+            return;
         }
-        x_min = std::min(x_min, cp[0]);
-        x_max = std::max(x_max, cp[0]);
-        y_min = std::min(y_min, cp[1]);
-        y_max = std::max(y_max, cp[1]);
-        z_min = std::min(z_min, cp[2]);
-        z_max = std::max(z_max, cp[2]);
-    }
-    cp_a /= m_mesh()->vertices().size();
-    cp_min = CPoint(x_min, y_min, z_min);
-    x_d = x_max - x_min;
-    y_d = y_max - y_min;
-    z_d = z_max - z_min;
+    }
+    MeshLib::CPolygonTriangulation::ear_clip(n, [&](int k) { return obj.points[obj.corners[fb + k].v]; }, tris);
+}
+
+size_t ViewerMesh::filter_components()
+{
+    if (keep_components == 0) return 0;
+    MeshLib::CComponents<CMesh> components(*m_mesh());
+    const size_t parts = components.label();
+    const size_t dropped = components.keep(keep_components);
+    m_mesh()->remove_face_property("component");
+    if (dropped > 0) std::cout << "kept " << keep_components << " of " << parts << " parts, " << dropped << " faces dropped" << std::endl;
+    return dropped;
+}
+
+void ViewerMesh::analyze(const std::string & fname, const MeshLib::CMeshReport * cached, int threads)
+{
+    if (cached) m_report = *cached;
+    else
+    {
+        StartupProfiler::Stage stage("analyze");
+        m_report = MeshLib::CMeshAnalysis<CMesh>(*m_mesh()).analyze(threads);
+    }
+    if (print_report) std::cout << fname << ": " << m_report.to_string() << std::endl;
+}
+
+int ViewerMesh::normalize()
+{
+    return normalize(bounds());
+}
+
+const MeshLib::CPointBounds & ViewerMesh::bounds()
+{
+    return m_bounds.get(*m_mesh(), [&](MeshLib::CPointBounds & box)
+    {
+        box = m_mesh()->parallel_reduce_vertices(MeshLib::CPointBounds(),
+            [](MeshLib::CPointBounds & b, CVertex * pv) { b.add(pv->point()); }, &MeshLib::CPointBounds::join);
+    });
+}
+
+int ViewerMesh::normalize(const MeshLib::CPointBounds & box)
+{
+    CPoint cp_a = box.center();
+    double x_d = box.hi[0] - box.lo[0];
+    double y_d = box.hi[1] - box.lo[1];
+    double z_d = box.hi[2] - box.lo[2];
     if (x_d < EPS || y_d < EPS || z_d < EPS)
     {
         std::cout << "Normalization Issue. May caused because object is too small" << std::endl;
         return 2;
     }
     double diff = std::max(x_d, std::max(y_d, z_d));
-    for (CVertex * pv : m_mesh()->vertices())
+    norm_center = cp_a;
+    norm_scale = 2 / diff;
+    if (keep_positions) return 0;
+    m_mesh()->parallel_for_vertices([&](CVertex * pv)
     {
-        CPoint cp = pv->point()-cp_a;
-        CPoint cp_new;
-        cp_new[0] = 2 * cp[0] / diff;
-        cp_new[1] = 2 * cp[1] / diff;
-        cp_new[2] = 2 * cp[2] / diff;
-        pv->point() = cp_new;
-    }
+        pv->point() = (pv->point() - cp_a) * norm_scale;
+    });
+    m_mesh()->touch_points();
     return 0;
 }
\ No newline at end of file
@@ -8,6 +8,17 @@
 #include <functional>
 #include <algorithm>
 #include "Mesh/mesh.h"
+#include "Mesh/dynamicmesh.h"
+#include "Mesh/components.h"
+#include "Mesh/analysis.h"
+#include "Mesh/derived.h"
+#include "parser/smv.h"
+#include "parser/ckp.h"
+#include "parser/store.h"
+#include "parser/objblocks.h"
+#include "Geometry/PointBounds.h"
+#include "Geometry/TextureRebaker.h"
+#include "TetMesh/compacttmesh.h"
 
 #ifndef EPS 
 #define EPS 1e-7
@@ -42,7 +53,11 @@ public:
 
 };
 
-using CMesh = MeshLib::CBaseMesh<CViewerVertex, CViewerEdge, CViewerFace, CViewerHalfEdge>;
+//! the viewer keeps no traits and no adjacency caches, see MeshLib::CMeshFields
+using CViewerFields = MeshLib::CRenderFields;
+using CMesh = MeshLib::CBaseMesh<CViewerVertex, CViewerEdge, CViewerFace, CViewerHalfEdge, MeshLib::CBlockArena, CViewerFields>;
+//! the mesh of a ViewerMesh, a CMesh that can be edited in place
+using CEditMesh = MeshLib::CDynamicMesh<CViewerVertex, CViewerEdge, CViewerFace, CViewerHalfEdge, MeshLib::CBlockArena, CViewerFields>;
 using CVertex = typename CMesh::CVertex;
 using CEdge = typename CMesh::CEdge;
 using CFace = typename CMesh::CFace;
@@ -54,16 +69,176 @@ public:
     ViewerMesh();
     ~ViewerMesh();
 
-    int input_obj(std::string fname);
+    /*! read an .obj file, parsed in parallel by `threads` workers (0: all cores).
+        a fresh .smv cache next to the file is used instead, and written otherwise, or the one
+        in the store under the hash of the file. an .smv file is read as a cache. 3 if the job of
+        the thread is cancelled meanwhile, see MeshLib::CJob, the mesh is part built then */
+    int input_obj(std::string fname, int threads = 0);
+    /*! build the mesh from the parsed records of the .obj file fname, then
+        write its cache and normalize as input_obj does */
+    int input_obj_data(MeshLib::CObjData & obj, std::string fname);
+    /*! read the .obj file fname again and move only the points and normals of the blocks that
+        changed since it was read, see MeshLib::CObjBlocks, normalized as they were then so that
+        the view stays, the mesh tracks them as edits, see CDynamicMesh::editVertex. needs watch
+        when the mesh was read, 0 if it was patched, also when nothing changed, 1 if the file
+        changed more than its points and normals, or the mesh was not built from it or changed
+        since, so that it has to be read in full into a fresh mesh, 3 if it cannot be read */
+    int update_obj(std::string fname, int threads = 0);
+    /*! whether input_obj would read fname from its .smv cache */
+    bool has_fresh_cache(std::string fname) const;
+    /*! read an .smv cache, the file stays mapped in smv() */
+    int input_smv(std::string fname);
+    /*! read the boundary surface of a .tet, .t or .tmv volume mesh, see TMeshLib::CTBoundary */
+    int input_tet(std::string fname, int threads = 0);
+    /*! whether fname is a volume mesh input_tet reads, by its extension */
+    static bool is_tet_file(const std::string & fname);
+    /*! read a .cmv, .ply or .glb file straight into the mesh, without a cache, input_obj reads them too */
+    int input_model(std::string fname, int threads = 0);
+    /*! whether fname is a mesh input_model reads, by its extension */
+    static bool is_model_file(const std::string & fname);
     int normalize();
+    /*! the bounds of the points, folded again only after the mesh changed, see MeshLib::CDerived */
+    const MeshLib::CPointBounds & bounds();
+    /*! simplify the triangles to ratio of their number, see MeshLib::CMeshSimplifier. the uv seams
+        stay in place, normals are computed again. the mapped cache is dropped, it no longer
+        matches. the number of triangles left */
+    size_t decimate(double ratio, int threads = 0);
+    /*! write the mesh to fname, the format by its extension: .obj, .off, .m, .ply, .glb, .smv or
+        .mtx, the tiles a viewer pages in, see MeshLib::write_mtx_file. the points are written as
+        they are, normalized unless keep_positions. 0 on success */
+    int output(std::string fname, int threads = 0);
+    /*! take a checkpoint of the mesh, its slots, touched flags, properties and normalization
+        included, see CBaseMesh::checkpoint, and write it to fname as .ckp on a thread of its own
+        while the mesh goes on changing. false, and nothing taken, while the last one is being
+        written */
+    bool checkpoint(std::string fname, int threads = 0);
+    /*! whether a checkpoint is being written, and the share of it done */
+    bool checkpoint_busy() const { return m_checkpoints.busy(); }
+    double checkpoint_progress() const { return m_checkpoints.progress(); }
+    /*! go back to the mesh of a .ckp checkpoint, input_obj reads them too, 3 if it cannot be read */
+    int input_checkpoint(std::string fname, int threads = 0);
+    /*! bake the ambient occlusion of the mesh, rays per texel, into width x height texels of its
+        uv atlas, row 0 at v = 0, see MeshLib::COcclusionBaker. the texels the triangles cover,
+        0 and no occlusion without uvs */
+    size_t bake_occlusion(int width, int height, int rays, std::vector<float> & ao, int threads = 0);
+    /*! the faces as fans of triangles, three corners each, with their points and uvs, the surface
+        a texture is resampled from, see MeshLib::CTextureRebaker */
+    void texture_corners(std::vector<MeshLib::CRebakeCorner> & corners);
+    /*! the faces as fans of triangles with their points, normals and uvs, the detailed surface
+        the normals are baked from, see bake_normals */
+    void bake_corners(std::vector<MeshLib::CBakeCorner> & corners);
+    /*! bake the normals of the surface of high, bake_corners of the mesh before it was decimated,
+        into width x height texels of the uv atlas of this one in its tangent frames, row 0 at v = 0,
+        see MeshLib::CNormalBaker. the texels the triangles cover, 0 and no map without uvs */
+    size_t bake_normals(const std::vector<MeshLib::CBakeCorner> & high, int width, int height, std::vector<uint32_t> & out,
+                        int threads = 0);
+    /*! pack the uv charts, the faces between seams, into a new atlas of width x height texels,
+        see MeshLib::CAtlasPacker. the charts keep density texels per unit of u and v, padding
+        texels apart. the mapped cache is dropped. the number of charts, 0 without uvs */
+    size_t repack_atlas(const CPoint2 & density, int padding, int & width, int & height, int threads = 0);
+    /*! the faces as triangles over vertices of 8 floats, point, normal and uv, the corners welded
+        by their uvs and normals, as MeshLib::write_mtx_file and MeshLib::CProgressiveMesh take them */
+    void welded_vertices(std::vector<uint32_t> & indices, std::vector<float> & vertices, int threads = 0);
+    /*! triangulate face f of obj, appending triples of its local corner indices */
+    void triangulate(const MeshLib::CObjData & obj, int f, std::vector<int> & tris) const;
 
     CMesh * &m_mesh() { return pMesh; }
+    /*! the same mesh with the editing operators of CDynamicMesh */
+    CEditMesh * e_mesh() { return static_cast<CEditMesh *>(pMesh); }
+    /*! stop drawing from the mapped cache, it no longer matches once the mesh is edited */
+    void detach_smv() { m_smv.close(); }
+    /*! the tets of a volume mesh read by input_tet, in file coordinates, empty otherwise */
+    const TMeshLib::CCompactTMesh & t_mesh() const { return m_tmesh; }
+    /*! a scalar per tet of t_mesh(), the trait tet_field of the tets as read, or their radius ratio
+        when no tet has it, see GlWidget::showVolume */
+    const std::vector<float> & t_values() const { return m_tvalues; }
+    /*! the mapped binary cache the mesh was read from, if any */
+    const MeshLib::CSmvFile & smv() const { return m_smv; }
+    /*! the counts, topology and bounds of the mesh as read, before parts were dropped or it was
+        decimated, see MeshLib::CMeshAnalysis, kept in the cache */
+    const MeshLib::CMeshReport & report() const { return m_report; }
     
     bool mesh_with_uv = false;
     bool mesh_with_normal = false;
+    bool use_cache = true;
+    /*! file the cache in this store under the hash of the bytes of the file instead of next to
+        it, so a copy or a touched file finds it and an edited one misses, none if NULL */
+    const MeshLib::CContentStore * store = NULL;
+    /*! ear clipping instead of fans for polygons, needed for concave faces */
+    bool ear_clipping = false;
+    /*! drop the faces that are not manifold, repeated or without area and split the vertices
+        where fans meet as the mesh is built, see CBaseMesh::repair_input, kept in the cache */
+    bool repair = false;
+    /*! weld the points at most this far apart, in the units of the file, before the repair, for
+        meshes exported with a vertex per face corner, see CBaseMesh::weld_tolerance, negative does
+        not weld, kept in the cache */
+    double weld = -1;
+    /*! lay out the vertices and faces along the Morton curve as the mesh is built, for files in
+        the order of a scanner, see CBaseMesh::reorder_input, kept in the cache */
+    bool reorder = false;
+    /*! list the faces patch by patch, patches of at most this many compact ones, before the cache
+        is written, see MeshLib::CSegmentation, 0 keeps the order, kept in the cache */
+    size_t patches = 0;
+    /*! give a mesh without normals smooth ones, see CBaseMesh::compute_normals, kept in the cache */
+    bool smooth_normals = true;
+
+    /*! keep only this many of the largest connected parts, see MeshLib::CComponents, 0 keeps all.
+        The cache holds every part, they are dropped after each read */
+    size_t keep_components = 0;
+
+    /*! decimate to this fraction of the triangles after reading, 1 keeps them all. The cache
+        holds the full mesh */
+    double decimate_ratio = 1;
+
+    /*! print report() as the mesh is read */
+    bool print_report = false;
+
+    /*! leave the points as read, normalize() only sets norm_center and norm_scale for the
+        model matrix to apply, so that nothing is rewritten and the points export unchanged */
+    bool keep_positions = false;
+
+    /*! keep the hashes of the blocks of the records of the .obj file the mesh is built from,
+        and the normal of every corner, for update_obj. a mesh read from its cache, repaired,
+        welded, reordered, segmented, filtered or decimated is read in full at the first change */
+    bool watch = false;
+
+    /*! the trait of the tets input_tet reads as their scalars, "value" for Tet 1 1 2 3 4 {value=(0.25)} */
+    std::string tet_field = "value";
+
+    /*! normalize() maps p to (p - norm_center) * norm_scale */
+    CPoint norm_center;
+    double norm_scale = 1;
 
 private:
+    /*! center and scale by the bounds of the mesh points */
+    int normalize(const MeshLib::CPointBounds & box);
+    /*! drop all but the keep_components largest parts, the number of faces dropped */
+    size_t filter_components();
+    /*! take the report of the cache, or sweep the mesh for it if there is none, and print it */
+    void analyze(const std::string & fname, const MeshLib::CMeshReport * cached, int threads = 0);
+    /*! cut the mesh into the tiles of a .mtx file, false if it cannot be written */
+    bool output_tiles(const std::string & fname, int threads);
+    /*! the key of the cache of fname in the store, false if fname cannot be read */
+    bool cache_key(const std::string & fname, MeshLib::CStoreKey & key) const;
+
     CMesh * pMesh;
+    MeshLib::CSmvFile m_smv;
+    MeshLib::CMeshReport m_report;
+    MeshLib::CDerived<MeshLib::CPointBounds> m_bounds;
+    //! writes the checkpoints, the destructor waits for the one in flight
+    MeshLib::CCheckpointWriter m_checkpoints;
+    //! the blocks of the .obj file the mesh was built from, empty if update_obj cannot patch it
+    MeshLib::CObjBlocks m_blocks;
+    //! the index of the normal of every halfedge in the order of the build, empty without normals
+    std::vector<int> m_corner_normals;
+    //! the connectivity the blocks were taken with, see CBaseMesh::topology_version
+    size_t m_blocks_topology = 0;
+    TMeshLib::CCompactTMesh m_tmesh;
+    std::vector<float> m_tvalues;
+    //! the hash of the bytes of the last file keyed and its time and size, it is read once per load
+    mutable std::string m_keyed;
+    mutable long long m_keyed_time = 0, m_keyed_size = -1;
+    mutable MeshLib::CStoreKey m_file_key;
 
 };
 
@@ -0,0 +1,284 @@
+#include "virtualTexture.h"
+#include <QImage>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QVector2D>
+#include <cmath>
+#include <algorithm>
+
+// name.png -> name.vtx
+static std::string cache_name(const std::string & fname)
+{
+    size_t dot = fname.find_last_of('.');
+    size_t sep = fname.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) return fname + ".vtx";
+    return fname.substr(0, dot) + ".vtx";
+}
+
+VirtualTexture::VirtualTexture(std::string fname, QObject *parent)
+    : QThread(parent), textfile(fname)
+{
+}
+
+VirtualTexture::~VirtualTexture()
+{
+    requestInterruption();
+    {
+        QMutexLocker lock(&mutex);
+        wake.wakeAll();
+    }
+    wait();
+}
+
+void VirtualTexture::run()
+{
+    // the tile file is fresh if it is not older than its source
+    const std::string tiles = cache_name(textfile);
+    const QFileInfo source(QString::fromStdString(textfile)), cached(QString::fromStdString(tiles));
+    const bool fresh = use_cache && cached.exists() && cached.lastModified() >= source.lastModified();
+    if (!fresh || !vtx.open(tiles))
+    {
+        // rows bottom up, as bindTexture uploaded them
+        QImage image(QString::fromStdString(textfile));
+        if (image.isNull())
+        {
+            emit opened(false);
+            return;
+        }
+        image = image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+        if (!MeshLib::write_vtx_file(tiles, image.constBits(), image.width(), image.height(), tile_size) || !vtx.open(tiles))
+        {
+            emit opened(false);
+            return;
+        }
+    }
+    emit opened(true);
+
+    const int bytes = (int)vtx.header().tile_bytes();
+    while (!isInterruptionRequested())
+    {
+        QVector<uint32_t> ids;
+        {
+            QMutexLocker lock(&mutex);
+            while (requested.isEmpty() && !isInterruptionRequested()) wake.wait(&mutex);
+            ids.swap(requested);
+        }
+
+        // the copy faults the pages of the mapping in, the GUI thread never waits for the disk
+        QVector<Tile> tiles;
+        for (uint32_t id : ids)
+        {
+            Tile t = { id, QByteArray((const char *)vtx.tile(id), bytes) };
+            tiles.append(t);
+        }
+        {
+            QMutexLocker lock(&mutex);
+            ready += tiles;
+        }
+        emit tilesRead();
+    }
+}
+
+void VirtualTexture::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    const MeshLib::CVtxHeader & h = vtx.header();
+    const int slot = (int)(h.tile + 2 * h.border);
+    std::vector<uint32_t> gw, gh;
+    for (int l = 0; l < (int)h.levels; l++)
+    {
+        gw.push_back(h.grid_width(l));
+        gh.push_back(h.grid_height(l));
+    }
+    cache.init(gw, gh, physical_size / slot);
+
+    gl->glCreateTextures(GL_TEXTURE_2D, 1, &physicalTexture);
+    gl->glTextureStorage2D(physicalTexture, 1, GL_RGBA8, physical_size, physical_size);
+    gl->glTextureParameteri(physicalTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl->glTextureParameteri(physicalTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl->glTextureParameteri(physicalTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    gl->glTextureParameteri(physicalTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    gl->glCreateTextures(GL_TEXTURE_2D, 1, &pageTexture);
+    gl->glTextureStorage2D(pageTexture, 1, GL_RGBA8, cache.table_width(), cache.table_height());
+    gl->glTextureParameteri(pageTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    gl->glTextureParameteri(pageTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // the coarsest level first, every lookup falls back to it
+    const int top = cache.levels() - 1;
+    QMutexLocker lock(&mutex);
+    for (uint32_t y = 0; y < gh[top]; y++)
+    {
+        for (uint32_t x = 0; x < gw[top]; x++)
+        {
+            const uint32_t id = cache.id(top, x, y);
+            cache.set_pending(id, true);
+            requested.append(id);
+            inFlight++;
+        }
+    }
+    wake.wakeOne();
+}
+
+void VirtualTexture::releaseGL()
+{
+    if (!gl) return;
+    if (feedbackFence) gl->glDeleteSync(feedbackFence);
+    if (readbackBuffer) gl->glUnmapNamedBuffer(readbackBuffer);
+    gl->glDeleteBuffers(1, &readbackBuffer);
+    gl->glDeleteFramebuffers(1, &feedbackFramebuffer);
+    gl->glDeleteTextures(1, &feedbackTexture);
+    gl->glDeleteRenderbuffers(1, &feedbackDepth);
+    gl->glDeleteTextures(1, &physicalTexture);
+    gl->glDeleteTextures(1, &pageTexture);
+    feedbackFence = 0;
+    readbackBuffer = feedbackFramebuffer = feedbackTexture = feedbackDepth = 0;
+    physicalTexture = pageTexture = 0;
+    readback = NULL;
+    feedbackWidth = feedbackHeight = 0;
+    gl = NULL;
+}
+
+bool VirtualTexture::update()
+{
+    if (!gl) return false;
+    readFeedback();
+
+    QVector<Tile> tiles;
+    {
+        QMutexLocker lock(&mutex);
+        const int n = std::min(uploads_per_frame, ready.size());
+        tiles = ready.mid(0, n);
+        ready.remove(0, n);
+        inFlight -= n;
+    }
+
+    const MeshLib::CVtxHeader & h = vtx.header();
+    const int slot = (int)(h.tile + 2 * h.border);
+    const int side = physical_size / slot;
+    const int top = cache.levels() - 1;
+    for (const Tile & t : tiles)
+    {
+        // every slot seen by the last feedback, the next one asks again
+        const uint32_t s = cache.insert(t.id, cache.level_of(t.id) == top);
+        if (s == MeshLib::CTileCache::s_none) continue;
+        gl->glTextureSubImage2D(physicalTexture, 0, (int)(s % side) * slot, (int)(s / side) * slot, slot, slot,
+            GL_RGBA, GL_UNSIGNED_BYTE, t.texels.constData());
+    }
+    if (cache.dirty())
+    {
+        cache.page_table(pageTexels);
+        gl->glTextureSubImage2D(pageTexture, 0, 0, 0, cache.table_width(), cache.table_height(),
+            GL_RGBA, GL_UNSIGNED_BYTE, pageTexels.data());
+    }
+
+    QMutexLocker lock(&mutex);
+    return inFlight > 0 || feedbackFence;
+}
+
+void VirtualTexture::readFeedback()
+{
+    if (!feedbackFence) return;
+    if (gl->glClientWaitSync(feedbackFence, 0, 0) == GL_TIMEOUT_EXPIRED) return;
+    gl->glDeleteSync(feedbackFence);
+    feedbackFence = 0;
+
+    // x and y in 12 bits each and the level + 1, see feedbackShader.fsh
+    const MeshLib::CVtxHeader & h = vtx.header();
+    visible.clear();
+    for (int i = 0; i < feedbackWidth * feedbackHeight; i++)
+    {
+        const uint8_t * p = readback + 4 * i;
+        if (!p[3]) continue;
+        const int level = std::min((int)p[3] - 1, cache.levels() - 1);
+        const uint32_t x = p[0] | (uint32_t)(p[2] & 15) << 8, y = p[1] | (uint32_t)(p[2] >> 4) << 8;
+        visible.push_back(cache.id(level, std::min(x, h.grid_width(level) - 1), std::min(y, h.grid_height(level) - 1)));
+    }
+    // neighbouring pixels mostly sample the same tile
+    std::sort(visible.begin(), visible.end());
+    visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+
+    cache.see(visible, missing);
+    if (missing.empty()) return;
+    QMutexLocker lock(&mutex);
+    for (uint32_t id : missing)
+    {
+        cache.set_pending(id, true);
+        requested.append(id);
+        inFlight++;
+    }
+    wake.wakeOne();
+}
+
+void VirtualTexture::setUniforms(QOpenGLShaderProgram & program, int unit)
+{
+    if (!gl) return;
+    gl->glBindTextureUnit(unit, pageTexture);
+    gl->glBindTextureUnit(unit + 1, physicalTexture);
+
+    const MeshLib::CVtxHeader & h = vtx.header();
+    QVector<GLint> rows;
+    for (uint32_t r : cache.rows()) rows.append((GLint)r);
+    program.setUniformValue("pageTable", unit);
+    program.setUniformValue("physicalTexture", unit + 1);
+    program.setUniformValue("virtualSize", QVector2D((float)h.width, (float)h.height));
+    program.setUniformValue("virtualLevels", (GLint)h.levels);
+    program.setUniformValueArray("pageRows", rows.constData(), rows.size());
+    program.setUniformValue("tileSize", (GLfloat)h.tile);
+    program.setUniformValue("slotSize", (GLfloat)(h.tile + 2 * h.border));
+    program.setUniformValue("physicalSize", (GLfloat)physical_size);
+}
+
+float VirtualTexture::feedbackBias() const
+{
+    return -std::log2((float)feedback_scale);
+}
+
+void VirtualTexture::beginFeedback(int width, int height)
+{
+    const int w = std::max(1, width / feedback_scale), h = std::max(1, height / feedback_scale);
+    if (w != feedbackWidth || h != feedbackHeight)
+    {
+        // the target and the readback buffer follow the viewport
+        if (readbackBuffer) gl->glUnmapNamedBuffer(readbackBuffer);
+        gl->glDeleteBuffers(1, &readbackBuffer);
+        gl->glDeleteFramebuffers(1, &feedbackFramebuffer);
+        gl->glDeleteTextures(1, &feedbackTexture);
+        gl->glDeleteRenderbuffers(1, &feedbackDepth);
+
+        gl->glCreateTextures(GL_TEXTURE_2D, 1, &feedbackTexture);
+        gl->glTextureStorage2D(feedbackTexture, 1, GL_RGBA8, w, h);
+        gl->glCreateRenderbuffers(1, &feedbackDepth);
+        gl->glNamedRenderbufferStorage(feedbackDepth, GL_DEPTH_COMPONENT24, w, h);
+        gl->glCreateFramebuffers(1, &feedbackFramebuffer);
+        gl->glNamedFramebufferTexture(feedbackFramebuffer, GL_COLOR_ATTACHMENT0, feedbackTexture, 0);
+        gl->glNamedFramebufferRenderbuffer(feedbackFramebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl->glCreateBuffers(1, &readbackBuffer);
+        gl->glNamedBufferStorage(readbackBuffer, 4 * w * h, NULL, flags);
+        readback = (const uint8_t *)gl->glMapNamedBufferRange(readbackBuffer, 0, 4 * w * h, flags);
+        feedbackWidth = w;
+        feedbackHeight = h;
+    }
+
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+    gl->glViewport(0, 0, w, h);
+    // nothing drawn reads as alpha 0
+    const GLfloat none[4] = { 0, 0, 0, 0 }, depth = 1;
+    gl->glClearNamedFramebufferfv(feedbackFramebuffer, GL_COLOR, 0, none);
+    gl->glClearNamedFramebufferfv(feedbackFramebuffer, GL_DEPTH, 0, &depth);
+}
+
+void VirtualTexture::endFeedback(GLuint framebuffer, int width, int height)
+{
+    // into the mapped buffer, read once the fence has passed
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer);
+    gl->glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    feedbackFence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    gl->glViewport(0, 0, width, height);
+}
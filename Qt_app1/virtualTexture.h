@@ -0,0 +1,96 @@
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QVector>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <string>
+#include "Geometry/TileCache.h"
+#include "parser/vtx.h"
+
+/*! a texture split into mip tiles on disk, of which only the tiles seen
+    are kept on the GPU. the tiles are cut into name.vtx on first use, then
+    read on a background thread as the feedback pass asks for them.
+    the GL functions run on the GUI thread with the context current. */
+class VirtualTexture : public QThread
+{
+    Q_OBJECT
+
+public:
+    VirtualTexture(std::string fname, QObject *parent = 0);
+    ~VirtualTexture();
+
+    /*! texels of a tile when the tile file is cut */
+    int tile_size = 128;
+    /*! texels per side of the texture holding the resident tiles */
+    int physical_size = 4096;
+    /*! tiles copied to the GPU per frame at most */
+    int uploads_per_frame = 32;
+    /*! the feedback pass is drawn this many times smaller than the viewport */
+    int feedback_scale = 8;
+    bool use_cache = true;
+
+    /*! create the textures once the tile file is open */
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    /*! read back the last feedback, upload tiles and the page table, true while tiles are on their way */
+    bool update();
+    /*! bind the page table and the physical texture to units unit and unit + 1, and set the uniforms of virtualTexture.glsl */
+    void setUniforms(QOpenGLShaderProgram & program, int unit);
+    /*! whether a feedback pass could start, once the textures exist and only one is read back at a time */
+    bool feedbackIdle() const { return gl && !feedbackFence; }
+    /*! bind and clear the feedback target for a viewport of width x height */
+    void beginFeedback(int width, int height);
+    /*! start reading the feedback back, then draw to framebuffer again with a width x height viewport */
+    void endFeedback(GLuint framebuffer, int width, int height);
+    /*! the bias of feedbackShader.fsh, the pass has fewer pixels */
+    float feedbackBias() const;
+
+signals:
+    /*! the tile file is open, or could not be made */
+    void opened(bool ok);
+    /*! tiles are waiting for their upload */
+    void tilesRead();
+
+protected:
+    void run();
+
+private:
+    void readFeedback();
+
+    std::string textfile;
+    MeshLib::CVtxFile vtx;
+    MeshLib::CTileCache cache;
+
+    //! tiles asked for and tiles read, shared with the thread
+    QMutex mutex;
+    QWaitCondition wake;
+    QVector<uint32_t> requested;
+    struct Tile { uint32_t id; QByteArray texels; };
+    QVector<Tile> ready;
+    int inFlight = 0;
+
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    GLuint physicalTexture = 0;
+    GLuint pageTexture = 0;
+    std::vector<uint32_t> pageTexels;
+    std::vector<uint32_t> visible, missing;
+    //! the tiles of the coarsest level, never evicted
+    std::vector<uint32_t> pinned;
+
+    GLuint feedbackFramebuffer = 0;
+    GLuint feedbackTexture = 0;
+    GLuint feedbackDepth = 0;
+    int feedbackWidth = 0;
+    int feedbackHeight = 0;
+    //! persistently mapped, read when the fence of its glReadPixels has passed
+    GLuint readbackBuffer = 0;
+    const uint8_t * readback = NULL;
+    GLsync feedbackFence = 0;
+};
+
+#endif // VIRTUALTEXTURE_H
@@ -0,0 +1,47 @@
+#include "visibilityBuffer.h"
+
+void VisibilityBuffer::initializeGL(QOpenGLFunctions_4_5_Core * functions)
+{
+    gl = functions;
+    if (!gl) return;
+    gl->glCreateFramebuffers(1, &framebuffer);
+}
+
+void VisibilityBuffer::releaseGL()
+{
+    if (!gl) return;
+    gl->glDeleteFramebuffers(1, &framebuffer);
+    gl->glDeleteTextures(1, &idTexture);
+    gl->glDeleteRenderbuffers(1, &depth);
+    framebuffer = idTexture = depth = 0;
+    width = height = 0;
+    gl = NULL;
+}
+
+void VisibilityBuffer::begin(int w, int h)
+{
+    if (w != width || h != height)
+    {
+        // the storage is immutable, a new size takes new targets
+        gl->glDeleteTextures(1, &idTexture);
+        gl->glDeleteRenderbuffers(1, &depth);
+        gl->glCreateTextures(GL_TEXTURE_2D, 1, &idTexture);
+        gl->glTextureStorage2D(idTexture, 1, GL_R32UI, w, h);
+        gl->glCreateRenderbuffers(1, &depth);
+        gl->glNamedRenderbufferStorage(depth, GL_DEPTH_COMPONENT24, w, h);
+        gl->glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, idTexture, 0);
+        gl->glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        width = w;
+        height = h;
+    }
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    const GLuint none[4] = { 0, 0, 0, 0 };
+    const GLfloat farthest = 1;
+    gl->glClearNamedFramebufferuiv(framebuffer, GL_COLOR, 0, none);
+    gl->glClearNamedFramebufferfv(framebuffer, GL_DEPTH, 0, &farthest);
+}
+
+void VisibilityBuffer::end(GLuint target)
+{
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
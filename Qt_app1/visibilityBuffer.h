@@ -0,0 +1,34 @@
+#ifndef VISIBILITYBUFFER_H
+#define VISIBILITYBUFFER_H
+
+#include <QOpenGLFunctions_4_5_Core>
+
+/*! the target of the first pass of visibility buffer rendering: the triangle under every pixel,
+    written by pickShader.fsh with the depth test, and nothing else. the second pass shades every
+    pixel once from its triangle, see resolveShader.fsh, so the cost of the texture fetches and the
+    lighting follows the pixels and not the triangles drawn over each other, for meshes with many
+    triangles below a pixel. needs OpenGL 4.5, the calls do nothing until initializeGL. */
+class VisibilityBuffer
+{
+public:
+    void initializeGL(QOpenGLFunctions_4_5_Core * functions);
+    void releaseGL();
+    bool available() const { return gl != NULL; }
+
+    /*! bind the target, width x height, and clear it to no triangle at the far plane */
+    void begin(int width, int height);
+    /*! draw to target again */
+    void end(GLuint target);
+    /*! the triangles + 1, an unsigned integer texture, 0 where nothing was drawn */
+    GLuint ids() const { return idTexture; }
+
+private:
+    QOpenGLFunctions_4_5_Core * gl = NULL;
+    GLuint framebuffer = 0;
+    GLuint idTexture = 0;
+    GLuint depth = 0;
+    int width = 0;
+    int height = 0;
+};
+
+#endif // VISIBILITYBUFFER_H
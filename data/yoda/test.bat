@@ -1 +1,2 @@
-Simplify3.exe "Yoda Bust.obj" "Yoda Bust.out.obj" 0.1
\ No newline at end of file
+Simplify3.exe "Yoda Bust.obj" "Yoda Bust.out.obj" 0.1
+Qt_app1.exe "Yoda Bust.obj" --decimate 0.1 --output "Yoda Bust.decimated.obj"
\ No newline at end of file
@@ -0,0 +1,349 @@
+/*!
+*      \file AtlasPacker.h
+*      \brief Packing the charts of a uv atlas into a smaller texture
+*
+*      Every chart keeps the texels per unit of its uvs, it is only moved and
+*      turned: to the direction of an edge of its convex hull where its box is
+*      the smallest, then by a quarter turn if that fits better. The boxes are
+*      placed by a skyline, the tallest first, each where its top stays the
+*      lowest. The width of the atlas is not known in advance, so packings for
+*      a range of widths run in parallel and the one of the least area wins;
+*      they do not depend on each other, so neither does the result on the
+*      number of threads.
+*/
+
+#ifndef _MESHLIB_ATLAS_PACKER_H_
+#define _MESHLIB_ATLAS_PACKER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "Point2.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CAtlasPacker class
+     */
+    class CAtlasPacker
+    {
+    public:
+        //! texels between the charts and around them, the box of a chart holds the padding after it
+        int padding = 2;
+        //! the width and the height of the atlas are multiples of align
+        int align = 4;
+        //! turn the charts to their smallest box and by quarter turns
+        bool rotate = true;
+
+        /*!
+         *  Pack charts of triangles into one atlas
+         *  \param corner  corner(t, k) is the uv of corner k of triangle t as a CPoint2
+         *  \param chart   chart[t] is the chart of triangle t, numbered from 0
+         *  \param density the texels per unit of u and of v of the texture the uvs map into
+         *  \param uv      the uv of corner k of triangle t in the atlas at 3 t + k, in [0, 1]^2
+         *  \param width, height the size of the atlas in texels
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return the number of charts
+         */
+        template<typename Corner>
+        size_t pack(size_t triangles, Corner corner, const uint32_t * chart, const CPoint2 & density,
+                    std::vector<CPoint2> & uv, int & width, int & height, int threads = 0) const;
+
+    protected:
+        //! widths of the atlas tried, from the square of the area of the charts up to twice that
+        static const int s_widths = 24;
+
+        struct CChart
+        {
+            double cos, sin;        //!< the turn to its smallest box
+            double lo[2];           //!< the box, turned
+            int    w, h;            //!< in texels, the padding included
+        };
+
+        struct CPlace
+        {
+            int  x, y;
+            bool turned;            //!< a quarter turn, w and h swapped
+        };
+
+        struct CSegment
+        {
+            int x, y, w;
+        };
+
+        /*! the convex hull of p, counterclockwise, by the monotone chain */
+        static void _hull(std::vector<CPoint2> & p);
+
+        /*! the turn of the hull h with the smallest box, its box */
+        static void _turn(const std::vector<CPoint2> & h, bool rotate, CChart & c, double & extent_u, double & extent_v);
+
+        /*!
+         *  Place the charts in order on a skyline of the given width
+         *  \return false if a chart is too wide, height is the top of the highest one
+         */
+        bool _skyline(const std::vector<CChart> & charts, const std::vector<uint32_t> & order, int width,
+                      std::vector<CPlace> & places, int & height) const;
+
+        int _align(double x) const
+        {
+            const int a = std::max(align, 1);
+            return ((int)std::ceil(x) + a - 1) / a * a;
+        }
+    };
+
+    template<typename Corner>
+    inline size_t CAtlasPacker::pack(size_t triangles, Corner corner, const uint32_t * chart, const CPoint2 & density,
+                                     std::vector<CPoint2> & uv, int & width, int & height, int threads) const
+    {
+        uv.assign(3 * triangles, CPoint2());
+        width = height = 0;
+        if (triangles == 0) return 0;
+
+        // the triangles by chart
+        size_t charts = 0;
+        for (size_t t = 0; t < triangles; t++) charts = std::max(charts, (size_t)chart[t] + 1);
+        std::vector<size_t> first(charts + 1, 0);
+        for (size_t t = 0; t < triangles; t++) first[chart[t] + 1]++;
+        for (size_t c = 0; c < charts; c++) first[c + 1] += first[c];
+        std::vector<uint32_t> members(triangles);
+        std::vector<size_t> next(first.begin(), first.end() - 1);
+        for (size_t t = 0; t < triangles; t++) members[next[chart[t]]++] = (uint32_t)t;
+
+        // every chart in texels, turned to its smallest box
+        std::vector<CChart> boxes(charts);
+        parallel_for(charts, threads, [&](size_t b, size_t e)
+        {
+            std::vector<CPoint2> p;
+            for (size_t c = b; c < e; c++)
+            {
+                p.clear();
+                for (size_t i = first[c]; i < first[c + 1]; i++)
+                    for (int k = 0; k < 3; k++)
+                    {
+                        const CPoint2 q = corner(members[i], k);
+                        p.push_back(CPoint2(q[0] * density[0], q[1] * density[1]));
+                    }
+                CChart & box = boxes[c];
+                double eu = 0, ev = 0;
+                if (p.empty())
+                {
+                    box.cos = 1;
+                    box.sin = 0;
+                    box.lo[0] = box.lo[1] = 0;
+                }
+                else
+                {
+                    _hull(p);
+                    _turn(p, rotate, box, eu, ev);
+                }
+                box.w = (int)std::ceil(eu) + padding;
+                box.h = (int)std::ceil(ev) + padding;
+            }
+        }, 16);
+
+        // the tallest first, then the widest
+        std::vector<uint32_t> order(charts);
+        double area = 0;
+        int needed = 0;
+        for (size_t c = 0; c < charts; c++)
+        {
+            order[c] = (uint32_t)c;
+            area += (double)boxes[c].w * boxes[c].h;
+            needed = std::max(needed, rotate ? std::min(boxes[c].w, boxes[c].h) : boxes[c].w);
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+        {
+            const int ma = std::max(boxes[a].w, boxes[a].h), mb = std::max(boxes[b].w, boxes[b].h);
+            if (ma != mb) return ma > mb;
+            const int na = std::min(boxes[a].w, boxes[a].h), nb = std::min(boxes[b].w, boxes[b].h);
+            return na != nb ? na > nb : a < b;
+        });
+
+        // the widths from the side of a square of the area on, the one of the least area wins
+        const int smallest = _align(std::max(std::sqrt(area), (double)needed) + padding);
+        std::vector<int> widths;
+        for (int k = 0; k < s_widths; k++)
+        {
+            const int w = _align(smallest * (1.0 + k / (double)s_widths));
+            if (widths.empty() || w != widths.back()) widths.push_back(w);
+        }
+        std::vector<std::vector<CPlace>> places(widths.size());
+        std::vector<int> heights(widths.size(), 0);
+        std::vector<char> fits(widths.size(), 0);
+        parallel_for(widths.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) fits[i] = _skyline(boxes, order, widths[i], places[i], heights[i]);
+        }, 1);
+        size_t best = widths.size();
+        for (size_t i = 0; i < widths.size(); i++)
+        {
+            if (!fits[i]) continue;
+            const double a = (double)widths[i] * _align(heights[i]);
+            if (best == widths.size() || a < (double)widths[best] * _align(heights[best])) best = i;
+        }
+        // every width is wide enough for every chart, the guard is for a skyline that still fails
+        if (best == widths.size()) return charts;
+        width = widths[best];
+        height = _align(heights[best]);
+
+        // the corners, turned, moved to their place and a quarter turned there if so placed
+        parallel_for(charts, threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++)
+            {
+                const CChart & box = boxes[c];
+                const CPlace & at = places[best][c];
+                for (size_t i = first[c]; i < first[c + 1]; i++)
+                    for (int k = 0; k < 3; k++)
+                    {
+                        const uint32_t t = members[i];
+                        const CPoint2 q = corner(t, k);
+                        const double x = q[0] * density[0], y = q[1] * density[1];
+                        double u = box.cos * x + box.sin * y - box.lo[0];
+                        double v = -box.sin * x + box.cos * y - box.lo[1];
+                        if (at.turned)
+                        {
+                            const double s = u;
+                            u = (box.h - padding) - v;
+                            v = s;
+                        }
+                        uv[3 * (size_t)t + k] = CPoint2((at.x + u) / width, (at.y + v) / height);
+                    }
+            }
+        }, 16);
+        return charts;
+    }
+
+    inline void CAtlasPacker::_hull(std::vector<CPoint2> & p)
+    {
+        std::sort(p.begin(), p.end(), [](const CPoint2 & a, const CPoint2 & b)
+        {
+            return a[0] != b[0] ? a[0] < b[0] : a[1] < b[1];
+        });
+        if (p.size() < 3) return;
+        std::vector<CPoint2> h(2 * p.size());
+        size_t k = 0;
+        auto cross = [](const CPoint2 & o, const CPoint2 & a, const CPoint2 & b)
+        {
+            return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+        };
+        for (size_t i = 0; i < p.size(); i++)
+        {
+            while (k >= 2 && cross(h[k - 2], h[k - 1], p[i]) <= 0) k--;
+            h[k++] = p[i];
+        }
+        for (size_t i = p.size() - 1, lower = k + 1; i > 0; i--)
+        {
+            while (k >= lower && cross(h[k - 2], h[k - 1], p[i - 1]) <= 0) k--;
+            h[k++] = p[i - 1];
+        }
+        h.resize(k - 1);
+        p.swap(h);
+    }
+
+    inline void CAtlasPacker::_turn(const std::vector<CPoint2> & h, bool rotate, CChart & c, double & extent_u, double & extent_v)
+    {
+        // unturned first, a turn has to make the box smaller to be taken
+        double best = DBL_MAX;
+        const size_t n = rotate ? h.size() + 1 : 1;
+        for (size_t i = 0; i < n; i++)
+        {
+            double cs = 1, sn = 0;
+            if (i > 0)
+            {
+                const CPoint2 & a = h[i - 1], & b = h[i % h.size()];
+                const double dx = b[0] - a[0], dy = b[1] - a[1], l = std::sqrt(dx * dx + dy * dy);
+                if (l == 0) continue;
+                cs = dx / l;
+                sn = dy / l;
+            }
+            double lo[2] = { DBL_MAX, DBL_MAX }, hi[2] = { -DBL_MAX, -DBL_MAX };
+            for (const CPoint2 & p : h)
+            {
+                const double u = cs * p[0] + sn * p[1], v = -sn * p[0] + cs * p[1];
+                lo[0] = std::min(lo[0], u);
+                hi[0] = std::max(hi[0], u);
+                lo[1] = std::min(lo[1], v);
+                hi[1] = std::max(hi[1], v);
+            }
+            const double a = (hi[0] - lo[0]) * (hi[1] - lo[1]);
+            if (a >= best * (1 - 1e-9)) continue;
+            best = a;
+            c.cos = cs;
+            c.sin = sn;
+            c.lo[0] = lo[0];
+            c.lo[1] = lo[1];
+            extent_u = hi[0] - lo[0];
+            extent_v = hi[1] - lo[1];
+        }
+    }
+
+    inline bool CAtlasPacker::_skyline(const std::vector<CChart> & charts, const std::vector<uint32_t> & order, int width,
+                                       std::vector<CPlace> & places, int & height) const
+    {
+        places.assign(charts.size(), CPlace{ 0, 0, false });
+        height = 0;
+        std::vector<CSegment> sky(1, CSegment{ padding, padding, width - padding });
+        for (uint32_t c : order)
+        {
+            // where the top of the chart is lowest, then leftmost, in either turn
+            int bestTop = INT32_MAX, bestX = 0, bestY = 0;
+            size_t bestFirst = 0;
+            bool bestTurned = false;
+            for (int turn = 0; turn < (rotate ? 2 : 1); turn++)
+            {
+                const int w = turn ? charts[c].h : charts[c].w, h = turn ? charts[c].w : charts[c].h;
+                if (turn && w == h) break;
+                for (size_t i = 0; i < sky.size(); i++)
+                {
+                    const int x = sky[i].x;
+                    if (x + w > width) break;
+                    int y = 0;
+                    for (size_t j = i; j < sky.size() && sky[j].x < x + w; j++) y = std::max(y, sky[j].y);
+                    if (y + h < bestTop || (y + h == bestTop && x < bestX))
+                    {
+                        bestTop = y + h;
+                        bestX = x;
+                        bestY = y;
+                        bestFirst = i;
+                        bestTurned = turn != 0;
+                    }
+                }
+            }
+            if (bestTop == INT32_MAX) return false;
+            places[c] = CPlace{ bestX, bestY, bestTurned };
+            height = std::max(height, bestTop);
+
+            // the chart covers the segments from bestFirst under its width, the last one partly
+            const int w = bestTurned ? charts[c].h : charts[c].w, right = bestX + w;
+            size_t j = bestFirst;
+            while (j < sky.size() && sky[j].x + sky[j].w <= right) j++;
+            if (j < sky.size() && sky[j].x < right)
+            {
+                sky[j].w -= right - sky[j].x;
+                sky[j].x = right;
+            }
+            sky.erase(sky.begin() + bestFirst, sky.begin() + j);
+            sky.insert(sky.begin() + bestFirst, CSegment{ bestX, bestTop, w });
+            // neighbours of one height are one segment
+            for (size_t k = 0; k + 1 < sky.size();)
+            {
+                if (sky[k].y == sky[k + 1].y)
+                {
+                    sky[k].w += sky[k + 1].w;
+                    sky.erase(sky.begin() + k + 1);
+                }
+                else k++;
+            }
+        }
+        return true;
+    }
+
+}; //namespace
+
+#endif
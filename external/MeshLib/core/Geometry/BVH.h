@@ -0,0 +1,847 @@
+/*!
+*      \file BVH.h
+*      \brief Bounding volume hierarchy over triangles, for rays and distance queries
+*
+*      The tree is built top down with the surface area heuristic, every split
+*      taken from a few bins of the triangle centers per axis, the bins of large
+*      ranges and the subtrees of large nodes filled in parallel. A node has up
+*      to four children whose boxes are stored as one float array per bound and
+*      axis, so a ray or a point is tested against all four with a few SSE
+*      instructions. The triangles are copied in the order of the leaves.
+*      Two trees descended together give the pairs of triangles, one of
+*      each, whose boxes overlap, the candidates of intersection tests.
+*/
+
+#ifndef _MESHLIB_BVH_H_
+#define _MESHLIB_BVH_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "Point.h"
+#include "../parser/parallel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLIB_BVH_SSE
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CBVH class, a four wide bounding volume hierarchy over triangles
+     */
+    class CBVH
+    {
+    public:
+        struct CNode
+        {
+            float    lo[3][4];      //!< lo[a][k] is the lower bound along axis a of child k
+            float    hi[3][4];
+            uint32_t child[4];      //!< an inner child's node, a leaf's first triangle
+            uint32_t count[4];      //!< triangles of a leaf child, 0 for an inner one
+            uint32_t slots;         //!< number of children, they come first
+        };
+
+        //! the nearest hit along a ray
+        struct CHit
+        {
+            double   t;             //!< the hit is o + t d
+            double   u, v;          //!< barycentric coordinates of corners 1 and 2
+            uint32_t triangle;
+        };
+
+        //! the nearest point on the triangles
+        struct CNearest
+        {
+            CPoint   point;
+            double   distance;
+            uint32_t triangle;
+        };
+
+        /*!
+         *  Build the tree
+         *  \param triangles number of triangles, corner(t, k) is corner k of triangle t as a CPoint
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        template<typename Corner>
+        void _construct(size_t triangles, Corner corner, int threads = 0);
+
+        /*!
+         *  Build the tree over faces, a range of face pointers such as CBaseMesh::faces(),
+         *  polygons split into fans around their first corner, face() maps triangles back
+         */
+        template<typename Faces>
+        void _construct_faces(const Faces & faces, int threads = 0);
+
+        void clear()
+        {
+            m_nodes.clear();
+            m_tris.clear();
+            m_index.clear();
+            m_face.clear();
+        }
+
+        bool empty() const { return m_nodes.empty(); }
+        size_t size() const { return m_nodes.size(); }
+        const CNode & node(size_t i) const { return m_nodes[i]; }
+        /*! number of triangles */
+        size_t triangles() const { return m_index.size(); }
+        /*! the face triangle t is part of, in the order _construct_faces met them */
+        uint32_t face(uint32_t t) const { return m_face.empty() ? t : m_face[t]; }
+
+        /*! the nearest hit of the ray o + t d with 0 < t < tmax, false if there is none */
+        bool _intersect(const CPoint & o, const CPoint & d, CHit & hit, double tmax = DBL_MAX) const
+        {
+            hit.t = tmax;
+            return _trace<false>(o, d, hit);
+        }
+
+        /*! whether the ray o + t d hits a triangle with 0 < t < tmax, stops at the first one found */
+        bool _occluded(const CPoint & o, const CPoint & d, double tmax = DBL_MAX) const
+        {
+            CHit hit;
+            hit.t = tmax;
+            return _trace<true>(o, d, hit);
+        }
+
+        /*! the nearest point to p closer than max_distance, false if there is none */
+        bool _closest(const CPoint & p, CNearest & nearest, double max_distance = DBL_MAX) const;
+
+        /*! append the triangles closer than r to c */
+        void _within(const CPoint & c, double r, std::vector<uint32_t> & triangles) const;
+
+        /*!
+         *  Append the triangles of this tree and of other whose boxes overlap, as pairs of their indices
+         *  in _construct. Both trees are descended together, the larger box first, and the pairs of
+         *  subtrees met after a few levels are shared out among the threads
+         */
+        void _overlaps(const CBVH & other, std::vector<std::pair<uint32_t, uint32_t>> & pairs, int threads = 0) const;
+
+        /*! the point of triangle a, b, c nearest to p */
+        static CPoint _closest_point(const CPoint & p, const CPoint & a, const CPoint & b, const CPoint & c);
+
+        //! leaves hold at most this many triangles
+        static const uint32_t s_leaf_size = 4;
+        //! bins per axis for the split
+        static const int s_bins = 12;
+
+    protected:
+        struct CBox
+        {
+            CPoint lo = CPoint(DBL_MAX, DBL_MAX, DBL_MAX);
+            CPoint hi = CPoint(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+
+            void add(const CPoint & p)
+            {
+                for (int a = 0; a < 3; a++)
+                {
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+            }
+            void join(const CBox & b)
+            {
+                for (int a = 0; a < 3; a++)
+                {
+                    lo[a] = std::min(lo[a], b.lo[a]);
+                    hi[a] = std::max(hi[a], b.hi[a]);
+                }
+            }
+            double area() const
+            {
+                if (lo[0] > hi[0]) return 0;
+                const CPoint e = hi - lo;
+                return 2 * (e[0] * e[1] + e[1] * e[2] + e[2] * e[0]);
+            }
+        };
+
+        //! the triangle centers and boxes of a range, binned along each axis
+        struct CBins
+        {
+            uint32_t count[3][s_bins] = {};
+            CBox     box[3][s_bins];
+
+            static CBins join(const CBins & a, const CBins & b)
+            {
+                CBins r = a;
+                for (int x = 0; x < 3; x++)
+                {
+                    for (int k = 0; k < s_bins; k++)
+                    {
+                        r.count[x][k] += b.count[x][k];
+                        r.box[x][k].join(b.box[x][k]);
+                    }
+                }
+                return r;
+            }
+        };
+
+        //! a leaf, a, b = a + e1, c = a + e2
+        struct CTriangle
+        {
+            CPoint a, e1, e2;
+        };
+
+        //! the part of the tree below a node, in its own array until it is spliced in
+        struct CPart
+        {
+            std::vector<CNode> nodes;
+        };
+
+        //! the float ray of the box tests
+        struct CRay
+        {
+            float o[3];
+            float inv[3];
+        };
+
+        //! a child of this tree and one of the other whose boxes overlap, an inner node by count 0
+        struct CPair
+        {
+            uint32_t first[2];
+            uint32_t count[2];
+            float    lo[2][3];
+            float    hi[2][3];
+        };
+
+        //! below this many triangles the bins are filled and the children built by one thread
+        static const uint32_t s_parallel_items = 1 << 12;
+        //! nodes this deep split at the median, so the traversal stack below is enough
+        static const int s_median_depth = 40;
+        static const int s_stack = 3 * (s_median_depth + 24);
+
+        //! pairs of subtrees a thread of _overlaps is given, about
+        static const size_t s_pair_tasks = 64;
+
+        template<bool any>
+        bool _trace(const CPoint & o, const CPoint & d, CHit & hit) const;
+        /*! the children of the larger side of p that overlap the other side onto next, the triangles of two leaves onto pairs */
+        void _pair(const CBVH & other, const CPair & p, std::vector<CPair> & next, std::vector<std::pair<uint32_t, uint32_t>> & pairs) const;
+
+        uint32_t _node(CPart & part, uint32_t b, uint32_t e, const CBox & box, int depth, int threads);
+        uint32_t _split(uint32_t b, uint32_t e, int depth, CBox & left, CBox & right, int threads);
+        CBox _bounds(uint32_t b, uint32_t e, bool centers, int threads) const;
+
+        /*! the children along the ray with it entering them before tmax, their entry in t */
+        static int _slabs(const CNode & n, const CRay & r, float tmax, float t[4]);
+        /*! the squared distances of p to the children */
+        static void _distances(const CNode & n, const float p[3], float d2[4]);
+
+        /*! k of the children in mask sorted by key, nearest first */
+        static int _order(int mask, const float key[4], int slot[4])
+        {
+            int k = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                if (!(mask & (1 << i))) continue;
+                int j = k++;
+                for (; j > 0 && key[slot[j - 1]] > key[i]; j--) slot[j] = slot[j - 1];
+                slot[j] = i;
+            }
+            return k;
+        }
+
+        static float _down(double x)
+        {
+            const float f = (float)x;
+            return (double)f > x ? std::nextafter(f, -FLT_MAX) : f;
+        }
+        static float _up(double x)
+        {
+            const float f = (float)x;
+            return (double)f < x ? std::nextafter(f, FLT_MAX) : f;
+        }
+
+        static bool _hit(const CTriangle & tr, const CPoint & o, const CPoint & d, CHit & hit)
+        {
+            //Moller and Trumbore
+            const CPoint p = d ^ tr.e2;
+            const double det = tr.e1 * p;
+            if (det == 0) return false;
+            const double inv = 1 / det;
+            const CPoint s = o - tr.a;
+            const double u = (s * p) * inv;
+            if (u < 0 || u > 1) return false;
+            const CPoint q = s ^ tr.e1;
+            const double v = (d * q) * inv;
+            if (v < 0 || u + v > 1) return false;
+            const double t = (tr.e2 * q) * inv;
+            if (!(t > 0 && t < hit.t)) return false;
+            hit.t = t;
+            hit.u = u;
+            hit.v = v;
+            return true;
+        }
+
+        std::vector<CNode>     m_nodes;
+        std::vector<CTriangle> m_tris;
+        //! the triangle of _construct for each of m_tris
+        std::vector<uint32_t>  m_index;
+        std::vector<uint32_t>  m_face;
+
+        //while building
+        std::vector<CBox>      m_boxes;
+        std::vector<CPoint>    m_centers;
+    };
+
+    template<typename Corner>
+    inline void CBVH::_construct(size_t triangles, Corner corner, int threads)
+    {
+        m_nodes.clear();
+        m_tris.clear();
+        m_index.resize(triangles);
+        m_boxes.resize(triangles);
+        m_centers.resize(triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                CBox box;
+                for (int k = 0; k < 3; k++) box.add(corner(t, k));
+                m_boxes[t] = box;
+                m_centers[t] = (box.lo + box.hi) / 2.0;
+                m_index[t] = (uint32_t)t;
+            }
+        });
+
+        if (triangles > 0)
+        {
+            CPart part;
+            _node(part, 0, (uint32_t)triangles, _bounds(0, (uint32_t)triangles, false, threads), 0, threads);
+            m_nodes.swap(part.nodes);
+        }
+        m_boxes = std::vector<CBox>();
+        m_centers = std::vector<CPoint>();
+
+        //the triangles of the leaves next to each other
+        m_tris.resize(triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const uint32_t t = m_index[i];
+                const CPoint a = corner(t, 0);
+                m_tris[i].a = a;
+                m_tris[i].e1 = corner(t, 1) - a;
+                m_tris[i].e2 = corner(t, 2) - a;
+            }
+        });
+    }
+
+    template<typename Faces>
+    inline void CBVH::_construct_faces(const Faces & faces, int threads)
+    {
+        std::vector<CPoint> corners;
+        std::vector<uint32_t> face;
+        uint32_t f = 0;
+        for (auto * pf : faces)
+        {
+            auto * first = pf->halfedge();
+            auto * he = first->next();
+            while (he->next() != first)
+            {
+                corners.push_back(first->vertex()->point());
+                corners.push_back(he->vertex()->point());
+                corners.push_back(he->next()->vertex()->point());
+                face.push_back(f);
+                he = he->next();
+            }
+            f++;
+        }
+        _construct(face.size(), [&corners](size_t t, int k) { return corners[3 * t + k]; }, threads);
+        m_face.swap(face);
+    }
+
+    inline CBVH::CBox CBVH::_bounds(uint32_t b, uint32_t e, bool centers, int threads) const
+    {
+        return parallel_reduce(e - b, e - b < s_parallel_items ? 1 : threads, CBox(), [&](size_t i, size_t j, CBox & acc)
+        {
+            for (size_t k = b + i; k < b + j; k++)
+            {
+                const uint32_t t = m_index[k];
+                if (centers) acc.add(m_centers[t]);
+                else acc.join(m_boxes[t]);
+            }
+        }, [](CBox a, const CBox & c) { a.join(c); return a; }, s_parallel_items);
+    }
+
+    inline uint32_t CBVH::_split(uint32_t b, uint32_t e, int depth, CBox & left, CBox & right, int threads)
+    {
+        const CBox c = _bounds(b, e, true, threads);
+        const CPoint extent = c.hi - c.lo;
+        int axis = 0;
+        for (int a = 1; a < 3; a++) if (extent[a] > extent[axis]) axis = a;
+
+        uint32_t mid = (b + e) / 2;
+        if (extent[axis] <= 0)
+        {
+            //all centers on one point, any split is as good
+        }
+        else if (depth >= s_median_depth)
+        {
+            std::nth_element(m_index.begin() + b, m_index.begin() + mid, m_index.begin() + e,
+                [&](uint32_t s, uint32_t t) { return m_centers[s][axis] < m_centers[t][axis]; });
+        }
+        else
+        {
+            double scale[3];
+            for (int a = 0; a < 3; a++) scale[a] = extent[a] > 0 ? s_bins / extent[a] : 0;
+            auto bin = [&](const CPoint & p, int a) { return std::min(s_bins - 1, (int)((p[a] - c.lo[a]) * scale[a])); };
+
+            const CBins bins = parallel_reduce(e - b, e - b < s_parallel_items ? 1 : threads, CBins(), [&](size_t i, size_t j, CBins & acc)
+            {
+                for (size_t k = b + i; k < b + j; k++)
+                {
+                    const uint32_t t = m_index[k];
+                    for (int a = 0; a < 3; a++)
+                    {
+                        const int n = bin(m_centers[t], a);
+                        acc.count[a][n]++;
+                        acc.box[a][n].join(m_boxes[t]);
+                    }
+                }
+            }, &CBins::join, s_parallel_items);
+
+            //cost of splitting after bin k, the areas of both sides times their triangles
+            double best = DBL_MAX;
+            int split = 0;
+            for (int a = 0; a < 3; a++)
+            {
+                if (extent[a] <= 0) continue;
+                double cost[s_bins];
+                CBox box;
+                uint32_t n = 0;
+                for (int k = s_bins - 1; k > 0; k--)
+                {
+                    box.join(bins.box[a][k]);
+                    n += bins.count[a][k];
+                    cost[k - 1] = n * box.area();
+                }
+                box = CBox();
+                n = 0;
+                for (int k = 0; k < s_bins - 1; k++)
+                {
+                    box.join(bins.box[a][k]);
+                    n += bins.count[a][k];
+                    cost[k] += n * box.area();
+                    if (n > 0 && n < e - b && cost[k] < best)
+                    {
+                        best = cost[k];
+                        axis = a;
+                        split = k;
+                    }
+                }
+            }
+            if (best < DBL_MAX)
+            {
+                mid = (uint32_t)(std::partition(m_index.begin() + b, m_index.begin() + e,
+                    [&](uint32_t t) { return bin(m_centers[t], axis) <= split; }) - m_index.begin());
+                left = right = CBox();
+                for (int k = 0; k < s_bins; k++) (k <= split ? left : right).join(bins.box[axis][k]);
+                return mid;
+            }
+        }
+        left = _bounds(b, mid, false, threads);
+        right = _bounds(mid, e, false, threads);
+        return mid;
+    }
+
+    inline uint32_t CBVH::_node(CPart & part, uint32_t b, uint32_t e, const CBox & box, int depth, int threads)
+    {
+        //split the largest range until there are four
+        uint32_t begin[4] = { b }, end[4] = { e };
+        CBox boxes[4];
+        boxes[0] = box;
+        int n = 1;
+        while (n < 4)
+        {
+            int largest = -1;
+            for (int k = 0; k < n; k++)
+            {
+                if (end[k] - begin[k] > s_leaf_size && (largest < 0 || end[k] - begin[k] > end[largest] - begin[largest])) largest = k;
+            }
+            if (largest < 0) break;
+            const uint32_t mid = _split(begin[largest], end[largest], depth, boxes[largest], boxes[n], threads);
+            begin[n] = mid;
+            end[n] = end[largest];
+            end[largest] = mid;
+            n++;
+        }
+
+        const uint32_t index = (uint32_t)part.nodes.size();
+        CNode node;
+        node.slots = n;
+        std::vector<int> inner;
+        for (int k = 0; k < 4; k++)
+        {
+            const bool used = k < n;
+            for (int a = 0; a < 3; a++)
+            {
+                node.lo[a][k] = used ? _down(boxes[k].lo[a]) : FLT_MAX;
+                node.hi[a][k] = used ? _up(boxes[k].hi[a]) : -FLT_MAX;
+            }
+            node.child[k] = used ? begin[k] : 0;
+            node.count[k] = used && end[k] - begin[k] <= s_leaf_size ? end[k] - begin[k] : 0;
+            if (used && !node.count[k]) inner.push_back(k);
+        }
+        part.nodes.push_back(node);
+
+        if (e - b < s_parallel_items || inner.size() < 2 || resolve_threads(threads) <= 1)
+        {
+            for (int k : inner)
+            {
+                const uint32_t child = _node(part, begin[k], end[k], boxes[k], depth + 1, threads);
+                part.nodes[index].child[k] = child;
+            }
+            return index;
+        }
+
+        //each inner child builds its subtree in a part of its own, then the parts are appended
+        std::vector<CPart> parts(inner.size());
+        parallel_run((int)inner.size(), [&](int i)
+        {
+            const int k = inner[i];
+            _node(parts[i], begin[k], end[k], boxes[k], depth + 1, threads);
+        });
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            const uint32_t base = (uint32_t)part.nodes.size();
+            for (CNode c : parts[i].nodes)
+            {
+                for (uint32_t k = 0; k < c.slots; k++) if (!c.count[k]) c.child[k] += base;
+                part.nodes.push_back(c);
+            }
+            part.nodes[index].child[inner[i]] = base;
+            parts[i] = CPart();
+        }
+        return index;
+    }
+
+    template<bool any>
+    inline bool CBVH::_trace(const CPoint & o, const CPoint & d, CHit & hit) const
+    {
+        if (m_nodes.empty()) return false;
+        CRay ray;
+        for (int a = 0; a < 3; a++)
+        {
+            ray.o[a] = (float)o[a];
+            ray.inv[a] = (float)(1 / d[a]);
+        }
+
+        bool found = false;
+        struct { uint32_t node; float t; } stack[s_stack];
+        int top = 0;
+        stack[top++] = { 0, 0 };
+        while (top > 0)
+        {
+            const auto entry = stack[--top];
+            if (entry.t > hit.t) continue;
+            const CNode & n = m_nodes[entry.node];
+            float t[4];
+            int slot[4];
+            const int k = _order(_slabs(n, ray, (float)hit.t, t), t, slot);
+
+            //the leaves now, nearest first, then the inner children, the nearest on top
+            for (int i = 0; i < k; i++)
+            {
+                const int s = slot[i];
+                if (!n.count[s] || t[s] > hit.t) continue;
+                for (uint32_t j = n.child[s]; j < n.child[s] + n.count[s]; j++)
+                {
+                    if (!_hit(m_tris[j], o, d, hit)) continue;
+                    hit.triangle = m_index[j];
+                    found = true;
+                    if (any) return true;
+                }
+            }
+            for (int i = k; i-- > 0;)
+            {
+                const int s = slot[i];
+                if (!n.count[s]) stack[top++] = { n.child[s], t[s] };
+            }
+        }
+        return found;
+    }
+
+    inline bool CBVH::_closest(const CPoint & p, CNearest & nearest, double max_distance) const
+    {
+        if (m_nodes.empty()) return false;
+        const float q[3] = { (float)p[0], (float)p[1], (float)p[2] };
+        //the float box distances a little short, so no box is dropped by rounding
+        const float slack = 1 - 1e-5f;
+        double best = max_distance < DBL_MAX ? max_distance * max_distance : DBL_MAX;
+
+        bool found = false;
+        struct { uint32_t node; float d2; } stack[s_stack];
+        int top = 0;
+        stack[top++] = { 0, 0 };
+        while (top > 0)
+        {
+            const auto entry = stack[--top];
+            if (entry.d2 * slack > best) continue;
+            const CNode & n = m_nodes[entry.node];
+            float d2[4];
+            int slot[4];
+            _distances(n, q, d2);
+            const int k = _order((1 << n.slots) - 1, d2, slot);
+
+            for (int i = 0; i < k; i++)
+            {
+                const int s = slot[i];
+                if (!n.count[s] || d2[s] * slack > best) continue;
+                for (uint32_t j = n.child[s]; j < n.child[s] + n.count[s]; j++)
+                {
+                    const CTriangle & tr = m_tris[j];
+                    const CPoint c = _closest_point(p, tr.a, tr.a + tr.e1, tr.a + tr.e2);
+                    const CPoint v = c - p;
+                    const double l = v * v;
+                    if (l >= best) continue;
+                    best = l;
+                    nearest.point = c;
+                    nearest.triangle = m_index[j];
+                    found = true;
+                }
+            }
+            for (int i = k; i-- > 0;)
+            {
+                const int s = slot[i];
+                if (!n.count[s] && d2[s] * slack <= best) stack[top++] = { n.child[s], d2[s] };
+            }
+        }
+        if (found) nearest.distance = std::sqrt(best);
+        return found;
+    }
+
+    inline void CBVH::_within(const CPoint & c, double r, std::vector<uint32_t> & triangles) const
+    {
+        if (m_nodes.empty() || r < 0) return;
+        const float q[3] = { (float)c[0], (float)c[1], (float)c[2] };
+        const double r2 = r * r;
+        const float reach = (float)r2 * (1 + 1e-5f);
+
+        uint32_t stack[s_stack];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const CNode & n = m_nodes[stack[--top]];
+            float d2[4];
+            _distances(n, q, d2);
+            for (uint32_t s = 0; s < n.slots; s++)
+            {
+                if (d2[s] > reach) continue;
+                if (!n.count[s])
+                {
+                    stack[top++] = n.child[s];
+                    continue;
+                }
+                for (uint32_t j = n.child[s]; j < n.child[s] + n.count[s]; j++)
+                {
+                    const CTriangle & tr = m_tris[j];
+                    const CPoint v = _closest_point(c, tr.a, tr.a + tr.e1, tr.a + tr.e2) - c;
+                    if (v * v <= r2) triangles.push_back(m_index[j]);
+                }
+            }
+        }
+    }
+
+    inline void CBVH::_overlaps(const CBVH & other, std::vector<std::pair<uint32_t, uint32_t>> & pairs, int threads) const
+    {
+        if (m_nodes.empty() || other.m_nodes.empty()) return;
+        CPair root;
+        for (int s = 0; s < 2; s++)
+        {
+            root.first[s] = 0;
+            root.count[s] = 0;
+            for (int a = 0; a < 3; a++)
+            {
+                root.lo[s][a] = -FLT_MAX;
+                root.hi[s][a] = FLT_MAX;
+            }
+        }
+
+        //breadth first until there is work for every thread, pairs of leaves wait for the threads
+        std::vector<CPair> level(1, root), next;
+        const size_t tasks = s_pair_tasks * resolve_threads(threads);
+        bool inner = true;
+        while (inner && !level.empty() && level.size() < tasks)
+        {
+            inner = false;
+            next.clear();
+            for (const CPair & p : level)
+            {
+                if (p.count[0] && p.count[1]) next.push_back(p);
+                else
+                {
+                    _pair(other, p, next, pairs);
+                    inner = true;
+                }
+            }
+            level.swap(next);
+        }
+
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> found(level.size());
+        parallel_for(level.size(), threads, [&](size_t b, size_t e)
+        {
+            std::vector<CPair> stack;
+            for (size_t i = b; i < e; i++)
+            {
+                stack.push_back(level[i]);
+                while (!stack.empty())
+                {
+                    const CPair p = stack.back();
+                    stack.pop_back();
+                    _pair(other, p, stack, found[i]);
+                }
+            }
+        }, 1);
+        for (const std::vector<std::pair<uint32_t, uint32_t>> & f : found) pairs.insert(pairs.end(), f.begin(), f.end());
+    }
+
+    inline void CBVH::_pair(const CBVH & other, const CPair & p, std::vector<CPair> & next, std::vector<std::pair<uint32_t, uint32_t>> & pairs) const
+    {
+        if (p.count[0] && p.count[1])
+        {
+            for (uint32_t i = p.first[0]; i < p.first[0] + p.count[0]; i++)
+            {
+                CBox a;
+                const CTriangle & s = m_tris[i];
+                a.add(s.a);
+                a.add(s.a + s.e1);
+                a.add(s.a + s.e2);
+                for (uint32_t j = p.first[1]; j < p.first[1] + p.count[1]; j++)
+                {
+                    const CTriangle & t = other.m_tris[j];
+                    const CPoint q[3] = { t.a, t.a + t.e1, t.a + t.e2 };
+                    bool overlap = true;
+                    for (int x = 0; x < 3 && overlap; x++)
+                    {
+                        overlap = std::min(std::min(q[0][x], q[1][x]), q[2][x]) <= a.hi[x] &&
+                                  std::max(std::max(q[0][x], q[1][x]), q[2][x]) >= a.lo[x];
+                    }
+                    if (overlap) pairs.push_back(std::make_pair(m_index[i], other.m_index[j]));
+                }
+            }
+            return;
+        }
+
+        //open the side that is a node, the larger one if both are
+        float extent[2];
+        for (int s = 0; s < 2; s++) extent[s] = (p.hi[s][0] - p.lo[s][0]) + (p.hi[s][1] - p.lo[s][1]) + (p.hi[s][2] - p.lo[s][2]);
+        const int side = p.count[0] || (!p.count[1] && extent[1] > extent[0]) ? 1 : 0;
+        const CNode & n = (side ? other : *this).m_nodes[p.first[side]];
+        for (uint32_t k = 0; k < n.slots; k++)
+        {
+            bool overlap = true;
+            for (int a = 0; a < 3 && overlap; a++) overlap = n.lo[a][k] <= p.hi[1 - side][a] && n.hi[a][k] >= p.lo[1 - side][a];
+            if (!overlap) continue;
+            CPair q = p;
+            q.first[side] = n.child[k];
+            q.count[side] = n.count[k];
+            for (int a = 0; a < 3; a++)
+            {
+                q.lo[side][a] = n.lo[a][k];
+                q.hi[side][a] = n.hi[a][k];
+            }
+            next.push_back(q);
+        }
+    }
+
+    inline CPoint CBVH::_closest_point(const CPoint & p, const CPoint & a, const CPoint & b, const CPoint & c)
+    {
+        //by the region of p, Ericson's Real-Time Collision Detection 5.1.5
+        const CPoint ab = b - a, ac = c - a, ap = p - a;
+        const double d1 = ab * ap, d2 = ac * ap;
+        if (d1 <= 0 && d2 <= 0) return a;
+
+        const CPoint bp = p - b;
+        const double d3 = ab * bp, d4 = ac * bp;
+        if (d3 >= 0 && d4 <= d3) return b;
+
+        const double vc = d1 * d4 - d3 * d2;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+        const CPoint cp = p - c;
+        const double d5 = ab * cp, d6 = ac * cp;
+        if (d6 >= 0 && d5 <= d6) return c;
+
+        const double vb = d5 * d2 - d1 * d6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+        const double va = d3 * d6 - d5 * d4;
+        if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        const double s = va + vb + vc;
+        if (s <= 0) return a;
+        return a + ab * (vb / s) + ac * (vc / s);
+    }
+
+    inline int CBVH::_slabs(const CNode & n, const CRay & r, float tmax, float t[4])
+    {
+        //a little slack for the float boxes and ray
+        const float slack = 1 + 1e-5f;
+#ifdef MESHLIB_BVH_SSE
+        __m128 tnear = _mm_setzero_ps(), tfar = _mm_set1_ps(tmax);
+        for (int a = 0; a < 3; a++)
+        {
+            const __m128 o = _mm_set1_ps(r.o[a]), inv = _mm_set1_ps(r.inv[a]);
+            const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.lo[a]), o), inv);
+            const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(n.hi[a]), o), inv);
+            tnear = _mm_max_ps(tnear, _mm_min_ps(t0, t1));
+            tfar = _mm_min_ps(tfar, _mm_mul_ps(_mm_max_ps(t0, t1), _mm_set1_ps(slack)));
+        }
+        _mm_storeu_ps(t, tnear);
+        return _mm_movemask_ps(_mm_cmple_ps(tnear, tfar)) & ((1 << n.slots) - 1);
+#else
+        int mask = 0;
+        for (uint32_t k = 0; k < n.slots; k++)
+        {
+            float tnear = 0, tfar = tmax;
+            for (int a = 0; a < 3; a++)
+            {
+                const float t0 = (n.lo[a][k] - r.o[a]) * r.inv[a];
+                const float t1 = (n.hi[a][k] - r.o[a]) * r.inv[a];
+                tnear = std::max(tnear, std::min(t0, t1));
+                tfar = std::min(tfar, std::max(t0, t1) * slack);
+            }
+            t[k] = tnear;
+            if (tnear <= tfar) mask |= 1 << k;
+        }
+        return mask;
+#endif
+    }
+
+    inline void CBVH::_distances(const CNode & n, const float p[3], float d2[4])
+    {
+#ifdef MESHLIB_BVH_SSE
+        __m128 sum = _mm_setzero_ps();
+        for (int a = 0; a < 3; a++)
+        {
+            const __m128 q = _mm_set1_ps(p[a]);
+            const __m128 gap = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(n.lo[a]), q), _mm_sub_ps(q, _mm_loadu_ps(n.hi[a]))), _mm_setzero_ps());
+            sum = _mm_add_ps(sum, _mm_mul_ps(gap, gap));
+        }
+        _mm_storeu_ps(d2, sum);
+#else
+        for (int k = 0; k < 4; k++)
+        {
+            float sum = 0;
+            for (int a = 0; a < 3; a++)
+            {
+                const float gap = std::max(std::max(n.lo[a][k] - p[a], p[a] - n.hi[a][k]), 0.0f);
+                sum += gap * gap;
+            }
+            d2[k] = sum;
+        }
+#endif
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,208 @@
+/*!
+*      \file Batch2D.h
+*      \brief Orientation, segment intersection and point in triangle tests over arrays
+*
+*      The tests take their points as arrays of the x and of the y coordinates,
+*      one entry per test, and run four tests per step with AVX and two with
+*      SSE2. Every orientation is evaluated in doubles together with the error
+*      bound of CPredicates::orient2d, the lanes whose sign the bound leaves
+*      uncertain are evaluated again exactly, one by one, so every result is
+*      exact whatever the input and the exact work is only paid where points
+*      are nearly on a line.
+*/
+
+#ifndef _MESHLIB_BATCH_2D_H_
+#define _MESHLIB_BATCH_2D_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include "Predicates.h"
+#include "../parser/parallel.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MESHLIB_BATCH_2D_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLIB_BATCH_2D_SSE2
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CBatch2D class, exact plane tests over arrays of points
+     */
+    class CBatch2D
+    {
+    public:
+        /*! n points, point i is (x[i], y[i]) */
+        struct CPoints
+        {
+            const double * x;
+            const double * y;
+        };
+
+        /*! how two closed segments meet */
+        enum CMeet
+        {
+            Apart = 0,  //!< no common point
+            Touch = 1,  //!< an end on the other segment, or overlapping on a line
+            Cross = 2   //!< crossing at a point inside both
+        };
+
+        /*! where a point is with respect to a triangle */
+        enum CSide
+        {
+            Outside = 0,    //!< outside, or the triangle has no area
+            Boundary = 1,   //!< on an edge or a corner
+            Inside = 2      //!< inside the edges
+        };
+
+        /*!
+         *  sign[i] = 1, -1 or 0 as a[i], b[i], c[i] turn counterclockwise, clockwise
+         *  or lie on a line, the sign of CPredicates::orient2d
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        static void orient(const CPoints & a, const CPoints & b, const CPoints & c, size_t n, int8_t * sign, int threads = 0)
+        {
+            parallel_for(n, threads, [&](size_t begin, size_t end)
+            {
+                _signs(a, b, c, begin, end - begin, sign + begin);
+            }, s_grain);
+        }
+
+        /*! out[i], a CMeet, how the segments a[i] b[i] and c[i] d[i] meet */
+        static void intersect(const CPoints & a, const CPoints & b, const CPoints & c, const CPoints & d, size_t n,
+                              uint8_t * out, int threads = 0)
+        {
+            parallel_for(n, threads, [&](size_t begin, size_t end)
+            {
+                int8_t s[4][s_block];
+                for (size_t i = begin; i < end; i += s_block)
+                {
+                    const size_t m = end - i < s_block ? end - i : s_block;
+                    _signs(a, b, c, i, m, s[0]);
+                    _signs(a, b, d, i, m, s[1]);
+                    _signs(c, d, a, i, m, s[2]);
+                    _signs(c, d, b, i, m, s[3]);
+                    for (size_t j = 0; j < m; j++)
+                    {
+                        const int s0 = s[0][j], s1 = s[1][j], s2 = s[2][j], s3 = s[3][j];
+                        if (s0 * s1 > 0 || s2 * s3 > 0) out[i + j] = Apart;
+                        else if (s0 != 0 && s1 != 0 && s2 != 0 && s3 != 0) out[i + j] = Cross;
+                        else if (s0 == 0 && s1 == 0) out[i + j] = _collinear(a, b, c, d, i + j);
+                        else out[i + j] = Touch;
+                    }
+                }
+            }, s_grain);
+        }
+
+        /*!
+         *  out[i], a CSide, where p[i] is with respect to the triangle a[i] b[i] c[i],
+         *  a triangle of either orientation
+         */
+        static void inside(const CPoints & p, const CPoints & a, const CPoints & b, const CPoints & c, size_t n,
+                           uint8_t * out, int threads = 0)
+        {
+            parallel_for(n, threads, [&](size_t begin, size_t end)
+            {
+                int8_t s[4][s_block];
+                for (size_t i = begin; i < end; i += s_block)
+                {
+                    const size_t m = end - i < s_block ? end - i : s_block;
+                    _signs(a, b, c, i, m, s[0]);
+                    _signs(a, b, p, i, m, s[1]);
+                    _signs(b, c, p, i, m, s[2]);
+                    _signs(c, a, p, i, m, s[3]);
+                    for (size_t j = 0; j < m; j++)
+                    {
+                        const int area = s[0][j];
+                        const int u = area * s[1][j], v = area * s[2][j], w = area * s[3][j];
+                        if (area == 0 || u < 0 || v < 0 || w < 0) out[i + j] = Outside;
+                        else out[i + j] = u == 0 || v == 0 || w == 0 ? Boundary : Inside;
+                    }
+                }
+            }, s_grain);
+        }
+
+    protected:
+        //! tests per thread at once
+        static const size_t s_grain = 1 << 12;
+        //! tests whose signs are kept at once
+        static const size_t s_block = 64;
+
+        static int _sign(double d) { return (d > 0) - (d < 0); }
+
+        /* the signs of the orientations i.. i + m - 1 */
+        static void _signs(const CPoints & a, const CPoints & b, const CPoints & c, size_t i, size_t m, int8_t * sign)
+        {
+            size_t j = 0;
+#if defined(MESHLIB_BATCH_2D_AVX) || defined(MESHLIB_BATCH_2D_SSE2)
+#ifdef MESHLIB_BATCH_2D_AVX
+            typedef __m256d V;
+            const int W = 4;
+#else
+            typedef __m128d V;
+            const int W = 2;
+#endif
+            const V factor = _set1(CPredicates::s_orient2d_bound);
+            for (; j + W <= m; j += W)
+            {
+                const size_t k = i + j;
+                const V ax = _load(a.x + k), ay = _load(a.y + k);
+                const V l = _mul(_sub(_load(b.x + k), ax), _sub(_load(c.y + k), ay));
+                const V r = _mul(_sub(_load(b.y + k), ay), _sub(_load(c.x + k), ax));
+                const V det = _sub(l, r);
+                const V bound = _mul(factor, _add(_abs(l), _abs(r)));
+                const int positive = _greater(det, bound), negative = _greater(_sub(_set1(0), det), bound);
+                for (int q = 0; q < W; q++)
+                {
+                    if (positive & (1 << q)) sign[j + q] = 1;
+                    else if (negative & (1 << q)) sign[j + q] = -1;
+                    else sign[j + q] = (int8_t)_sign(CPredicates::orient2d_exact(a.x[k + q], a.y[k + q], b.x[k + q], b.y[k + q], c.x[k + q], c.y[k + q]));
+                }
+            }
+#endif
+            for (; j < m; j++)
+            {
+                const size_t k = i + j;
+                sign[j] = (int8_t)_sign(CPredicates::orient2d(a.x[k], a.y[k], b.x[k], b.y[k], c.x[k], c.y[k]));
+            }
+        }
+
+        /* segments on one line meet if their extents in the lexicographic order of the points do */
+        static uint8_t _collinear(const CPoints & a, const CPoints & b, const CPoints & c, const CPoints & d, size_t k)
+        {
+            typedef std::pair<double, double> P;
+            const P pa(a.x[k], a.y[k]), pb(b.x[k], b.y[k]), pc(c.x[k], c.y[k]), pd(d.x[k], d.y[k]);
+            const P lo0 = std::min(pa, pb), hi0 = std::max(pa, pb), lo1 = std::min(pc, pd), hi1 = std::max(pc, pd);
+            return hi0 < lo1 || hi1 < lo0 ? Apart : Touch;
+        }
+
+#if defined(MESHLIB_BATCH_2D_AVX)
+        static __m256d _set1(double v) { return _mm256_set1_pd(v); }
+        static __m256d _load(const double * p) { return _mm256_loadu_pd(p); }
+        static __m256d _add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+        static __m256d _sub(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+        static __m256d _mul(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+        static __m256d _abs(__m256d a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        //! bit q set if lane q of a is above that of b
+        static int _greater(__m256d a, __m256d b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ)); }
+#elif defined(MESHLIB_BATCH_2D_SSE2)
+        static __m128d _set1(double v) { return _mm_set1_pd(v); }
+        static __m128d _load(const double * p) { return _mm_loadu_pd(p); }
+        static __m128d _add(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+        static __m128d _sub(__m128d a, __m128d b) { return _mm_sub_pd(a, b); }
+        static __m128d _mul(__m128d a, __m128d b) { return _mm_mul_pd(a, b); }
+        static __m128d _abs(__m128d a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+        //! bit q set if lane q of a is above that of b
+        static int _greater(__m128d a, __m128d b) { return _mm_movemask_pd(_mm_cmpgt_pd(a, b)); }
+#endif
+    };
+
+}; //namespace
+
+#endif
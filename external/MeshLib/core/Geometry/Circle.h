@@ -9,6 +9,8 @@
 #ifndef _MESHLIB_CIRCLE_H_
 #define _MESHLIB_CIRCLE_H_
 
+#include <math.h>
+#include "Point2.h"
 
 namespace MeshLib{
 
@@ -139,7 +141,7 @@ inline int _circle_circle_intersection(CCircle C0, CCircle C1, CPoint2 & p0, CPo
     /* no solution. circles do not intersect. */
         return 0;
     }
-    if (d < abs(r0 - r1))
+    if (d < fabs(r0 - r1))
     {
     /* no solution. one circle is contained in the other */
         return 0;
@@ -0,0 +1,732 @@
+/*!
+*      \file ConstrainedDelaunay.h
+*      \brief Constrained Delaunay triangulation of points in the plane
+*
+*      The points are inserted one at a time, Bowyer and Watson, as CTDelaunay
+*      inserts them in space: the triangles whose circumcircles hold the new
+*      point are removed and the hole is filled with triangles joining its
+*      edges to the point, the first triangle found by walking from the last
+*      one made, the points in rounds of doubling size, each along the Morton
+*      curve. Triangles live in flat arrays, the slots of removed triangles are
+*      reused by the next ones made, and the hull is closed by ghost triangles
+*      joining its edges to a vertex at infinity. The constraints, segments
+*      between two of the points, are put in afterwards: the edges a segment
+*      crosses are flipped until it is an edge, Sloan, and the edges made on
+*      the way are flipped back to Delaunay as long as they are not
+*      constraints. A segment through a point is split there, a segment that
+*      crosses a constraint put in before it is left out. Orientations and the
+*      in circle test, the orientation of the points lifted to the paraboloid,
+*      have exact signs, and points on a common circle are told apart by
+*      moving their lifts by amounts that shrink with their index.
+*/
+
+#ifndef _MESHLIB_CONSTRAINED_DELAUNAY_H_
+#define _MESHLIB_CONSTRAINED_DELAUNAY_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include "Point.h"
+#include "Point2.h"
+#include "Predicates.h"
+#include "MortonOrder.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CConstrainedDelaunay class, the constrained Delaunay triangles of points in the plane, counterclockwise
+     */
+    class CConstrainedDelaunay
+    {
+    public:
+        /*!
+         *  Triangulate the points
+         *  \param constraints two point indices a segment that is to be an edge
+         *  \param threads     number of threads for ordering the points, they are inserted by one
+         *  \return false if the points are all on a line, there are no triangles then
+         */
+        bool _triangulate(const std::vector<CPoint2> & points, const std::vector<int> & constraints, int threads = 0);
+
+        /*!
+         *  Remove the triangles outside the constraints, those reached from the hull
+         *  across an even number of them, so the constraints bound a region with
+         *  holes. Only the triangles are read after it.
+         */
+        void _trim();
+
+        /*! build mesh, any empty CBaseMesh, the points at z = 0 with their uvs, the points of no triangle left out */
+        template<typename M>
+        void _build(M & mesh) const;
+
+        void clear()
+        {
+            m_points.clear();
+            m_lift.clear();
+            m_vert.clear();
+            m_adj.clear();
+            m_fixed.clear();
+            m_mark.clear();
+            m_free.clear();
+            m_order.clear();
+            m_copy.clear();
+            m_at.clear();
+            m_duplicates = 0;
+            m_crossings = 0;
+        }
+
+        /*! three point indices per triangle */
+        std::vector<int> triangles() const;
+        /*! number of points left out as a copy of an earlier one */
+        size_t duplicates() const { return m_duplicates; }
+        /*! number of constraints left out as they cross an earlier one */
+        size_t crossings() const { return m_crossings; }
+
+        //! the rounds of the insertion order stop halving at this many points
+        static const size_t s_first_round = 64;
+
+    protected:
+        //! the vertex at infinity of the ghost triangles
+        static const int32_t s_infinite = -1;
+
+        /*! the triangle whose vertex i is replaced by p counterclockwise, p on the side of edge i that vertex i is on */
+        double _orient(int32_t t, int i, int32_t p) const
+        {
+            const int32_t * v = &m_vert[3 * (size_t)t];
+            const CPoint2 & a = m_points[i == 0 ? p : v[0]], & b = m_points[i == 1 ? p : v[1]], & c = m_points[i == 2 ? p : v[2]];
+            return CPredicates::orient2d(a, b, c);
+        }
+        /*! the orientation of points a, b, c */
+        double _turn(int32_t a, int32_t b, int32_t c) const { return CPredicates::orient2d(m_points[a], m_points[b], m_points[c]); }
+
+        /*! whether p is inside the circumcircle of the finite triangle t, never on it */
+        bool _incircle(int32_t t, int32_t p) const;
+        /*! whether triangle t is in conflict with p, removed when p is inserted */
+        bool _conflict(int32_t t, int32_t p) const;
+
+        /*! a triangle in conflict with p, walking from triangle t, -1 if p is a copy of a vertex */
+        int32_t _locate(int32_t t, int32_t p);
+        /*! insert p, false if it is a copy of a vertex */
+        bool _insert(int32_t p);
+
+        /*! make the segment from a to b an edge, false if it crosses a constraint */
+        bool _constrain(int32_t a, int32_t b);
+        /*!
+         *  Around a, the edge to b or to a point on the segment to b, that point in hit, or the
+         *  edge opposite a of the triangle the segment leaves a through, hit -1
+         */
+        int32_t _around(int32_t a, int32_t b, int32_t & hit) const;
+        /*! a halfedge of the edge from u to w, -1 if there is none */
+        int32_t _edge(int32_t u, int32_t w) const;
+        /*! flip halfedge h, the edge of its triangle and the one across, to the other diagonal of the two */
+        void _flip(int32_t h);
+
+        /*! a new triangle, in the slot of a removed one if there is one */
+        int32_t _tri()
+        {
+            if (!m_free.empty())
+            {
+                const int32_t t = m_free.back();
+                m_free.pop_back();
+                return t;
+            }
+            const int32_t t = (int32_t)m_mark.size();
+            m_vert.resize(m_vert.size() + 3);
+            m_adj.resize(m_adj.size() + 3);
+            m_fixed.resize(m_fixed.size() + 3);
+            m_mark.push_back(0);
+            return t;
+        }
+        void _link(int32_t h, int32_t g)
+        {
+            m_adj[h] = g;
+            m_adj[g] = h;
+        }
+        void _fix(int32_t h)
+        {
+            m_fixed[h] = 1;
+            m_fixed[m_adj[h]] = 1;
+        }
+        bool _ghost(int32_t t) const
+        {
+            const int32_t * v = &m_vert[3 * (size_t)t];
+            return v[0] < 0 || v[1] < 0 || v[2] < 0;
+        }
+        /*! whether the triangle is alive, removed triangles have their first vertex -2 */
+        bool _alive(int32_t t) const { return m_vert[3 * (size_t)t] != -2; }
+        /*! the slot of vertex v in triangle t */
+        int _slot(int32_t t, int32_t v) const
+        {
+            const int32_t * w = &m_vert[3 * (size_t)t];
+            return w[0] == v ? 0 : w[1] == v ? 1 : 2;
+        }
+
+        static uint64_t _mix(uint64_t x)
+        {
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        //! the points in the order of insertion
+        std::vector<CPoint2>  m_points;
+        //! x, y and the squared distance to the center of the points, the lift to the paraboloid
+        std::vector<CPoint>   m_lift;
+        //! three vertices a triangle, counterclockwise, s_infinite in the ghost triangles
+        std::vector<int32_t>  m_vert;
+        //! the halfedge 3 t' + j across edge i of triangle t, edge i opposite vertex i
+        std::vector<int32_t>  m_adj;
+        //! 1 on the halfedges of constraints
+        std::vector<uint8_t>  m_fixed;
+        //! the insertion that last visited a triangle, twice its number, one more if it was not in conflict
+        std::vector<uint32_t> m_mark;
+        std::vector<int32_t>  m_free;
+        //! the points, vertex k the k-th inserted
+        std::vector<int32_t>  m_order;
+        //! the vertex a vertex is a copy of, itself if it is in the triangulation
+        std::vector<int32_t>  m_copy;
+        //! a finite triangle of each vertex, once the points are in
+        std::vector<int32_t>  m_at;
+        uint32_t              m_stamp = 0;
+        int32_t               m_last = 0;
+        uint64_t              m_random = 0;
+        size_t                m_duplicates = 0;
+        size_t                m_crossings = 0;
+
+        //while inserting, the triangles of the hole, its outer edges, the vertices and outer neighbors of the new triangles, and for
+        //every vertex of the hole, the last one at infinity, the new edge to it that waits for the second triangle on it
+        std::vector<int32_t>  m_hole;
+        std::vector<std::pair<int32_t, int32_t>> m_edges;
+        std::vector<int32_t>  m_verts;
+        std::vector<int32_t>  m_across;
+        std::vector<int32_t>  m_waiting;
+        //while putting a constraint in, the edges it crosses and the edges flipped to
+        std::vector<std::pair<int32_t, int32_t>> m_cross;
+        std::vector<std::pair<int32_t, int32_t>> m_made;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CConstrainedDelaunay::_triangulate(const std::vector<CPoint2> & points, const std::vector<int> & constraints, int threads)
+    {
+        clear();
+        const size_t n = points.size();
+        if (n < 3) return false;
+
+        //shuffled, then rounds of half of what is left from the end, each along the Morton curve
+        std::vector<CPoint> flat(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) flat[i] = CPoint(points[i][0], points[i][1], 0);
+        });
+        std::vector<int32_t> & order = m_order;
+        order.resize(n);
+        for (size_t i = 0; i < n; i++) order[i] = (int32_t)i;
+        for (size_t i = n - 1; i > 0; i--) std::swap(order[i], order[_mix(i) % (i + 1)]);
+        std::vector<size_t> rounds(1, n);
+        while (rounds.back() > s_first_round) rounds.push_back(rounds.back() / 2);
+        rounds.push_back(0);
+        std::reverse(rounds.begin(), rounds.end());
+        std::vector<CPoint> round;
+        std::vector<int> curve;
+        for (size_t r = 0; r + 1 < rounds.size(); r++)
+        {
+            const size_t b = rounds[r], e = rounds[r + 1];
+            round.resize(e - b);
+            for (size_t i = b; i < e; i++) round[i - b] = flat[order[i]];
+            CMortonOrder::sort(round.data(), round.size(), curve, threads);
+            std::vector<int32_t> sorted(e - b);
+            for (size_t i = 0; i < sorted.size(); i++) sorted[i] = order[b + curve[i]];
+            std::copy(sorted.begin(), sorted.end(), order.begin() + b);
+        }
+        flat = std::vector<CPoint>();
+
+        //vertex k is the k-th point inserted, so the points inserted one after the other are near in memory too, and lifted about the
+        //center of the box, so the squared distances lose little
+        CPoint2 lo = points[0], hi = points[0];
+        for (const CPoint2 & p : points)
+        {
+            for (int a = 0; a < 2; a++)
+            {
+                lo[a] = std::min(lo[a], p[a]);
+                hi[a] = std::max(hi[a], p[a]);
+            }
+        }
+        const CPoint2 center = (lo + hi) / 2.0;
+        m_points.resize(n);
+        m_lift.resize(n);
+        m_copy.resize(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                const CPoint2 & p = points[order[k]];
+                const CPoint2 d = p - center;
+                m_points[k] = p;
+                m_lift[k] = CPoint(p[0], p[1], d * d);
+                m_copy[k] = (int32_t)k;
+            }
+        });
+
+        //the first triangle from the first three points that are not on a line
+        int32_t first[3] = { 0, -1, -1 };
+        for (int32_t p = 1; p < (int32_t)n && first[2] < 0; p++)
+        {
+            const CPoint2 & a = m_points[first[0]], & q = m_points[p];
+            if (first[1] < 0)
+            {
+                if (q[0] != a[0] || q[1] != a[1]) first[1] = p;
+            }
+            else if (_turn(first[0], first[1], p) != 0) first[2] = p;
+        }
+        if (first[2] < 0)
+        {
+            clear();
+            return false;
+        }
+        const int32_t found[2] = { first[1], first[2] };
+        if (_turn(first[0], first[1], first[2]) < 0) std::swap(first[1], first[2]);
+
+        m_vert.reserve(3 * 2 * n + 12);
+        m_adj.reserve(3 * 2 * n + 12);
+        m_fixed.reserve(3 * 2 * n + 12);
+        m_mark.reserve(2 * n + 4);
+        m_waiting.assign(n + 1, -1);
+        const int32_t t = _tri();
+        std::copy(first, first + 3, &m_vert[0]);
+        //ghost i is the triangle with vertex i moved to infinity beyond edge i, the other two swapped to keep it counterclockwise
+        for (int i = 0; i < 3; i++)
+        {
+            const int32_t g = _tri();
+            m_vert[3 * g + i] = s_infinite;
+            m_vert[3 * g + (i + 1) % 3] = first[(i + 2) % 3];
+            m_vert[3 * g + (i + 2) % 3] = first[(i + 1) % 3];
+            _link(3 * t + i, 3 * g + i);
+        }
+        //ghost i and ghost j share the edge from infinity to the vertex other than i and j
+        for (int i = 0; i < 3; i++)
+            for (int j = i + 1; j < 3; j++) _link(3 * (1 + i) + _slot(1 + i, first[j]), 3 * (1 + j) + _slot(1 + j, first[i]));
+        m_last = t;
+
+        for (int32_t p = 1; p < (int32_t)n; p++)
+        {
+            if (p == found[0] || p == found[1]) continue;
+            if (!_insert(p)) m_duplicates++;
+        }
+        MESHLIB_COUNTER_ADD("cdt.duplicates", m_duplicates);
+        m_hole = std::vector<int32_t>();
+        m_edges = std::vector<std::pair<int32_t, int32_t>>();
+        m_verts = std::vector<int32_t>();
+        m_across = std::vector<int32_t>();
+        m_waiting = std::vector<int32_t>();
+
+        m_at.assign(n, -1);
+        for (size_t s = 0; s < m_mark.size(); s++)
+        {
+            if (!_alive((int32_t)s) || _ghost((int32_t)s)) continue;
+            for (int k = 0; k < 3; k++) m_at[m_vert[3 * s + k]] = (int32_t)s;
+        }
+        std::vector<int32_t> vertex(n);
+        for (size_t k = 0; k < n; k++) vertex[order[k]] = (int32_t)k;
+        for (size_t c = 0; c + 1 < constraints.size(); c += 2)
+        {
+            const int a = constraints[c], b = constraints[c + 1];
+            if (a < 0 || b < 0 || (size_t)a >= n || (size_t)b >= n) continue;
+            if (!_constrain(m_copy[vertex[a]], m_copy[vertex[b]])) m_crossings++;
+        }
+        MESHLIB_COUNTER_ADD("cdt.crossings", m_crossings);
+        m_cross = std::vector<std::pair<int32_t, int32_t>>();
+        m_made = std::vector<std::pair<int32_t, int32_t>>();
+        return true;
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    The in circle test is the orientation of the four lifted points, negative for p inside with the triangle counterclockwise. When it is 0
+    the lift of every point is moved up by a tiny amount, the larger the higher its index, so the sign is that of the derivative of the
+    determinant along the lift of the highest index that is not 0. The derivative along a lift is the orientation of the other three
+    points, with a sign, and that of p is the orientation of the triangle, which is not 0, so the test never ends on the circle.
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline bool CConstrainedDelaunay::_incircle(int32_t t, int32_t p) const
+    {
+        const int32_t * v = &m_vert[3 * (size_t)t];
+        const double det = CPredicates::orient3d(m_lift[v[0]], m_lift[v[1]], m_lift[v[2]], m_lift[p]);
+        if (det != 0) return det < 0;
+
+        //the four points by falling index, the derivative along each lift is the orientation of the other three with p in its place
+        int32_t q[4] = { v[0], v[1], v[2], p };
+        int slot[4] = { 0, 1, 2, 3 };
+        std::sort(slot, slot + 4, [&](int a, int b) { return q[a] > q[b]; });
+        for (int s : slot)
+        {
+            const double d = s == 3 ? _turn(q[0], q[1], q[2])
+                : -_turn(s == 0 ? p : q[0], s == 1 ? p : q[1], s == 2 ? p : q[2]);
+            if (d != 0) return d < 0;
+        }
+        return false;
+    }
+
+    inline bool CConstrainedDelaunay::_conflict(int32_t t, int32_t p) const
+    {
+        const int32_t * v = &m_vert[3 * (size_t)t];
+        int i = 0;
+        while (i < 3 && v[i] != s_infinite) i++;
+        if (i == 3) return _incircle(t, p);
+
+        //a ghost is in conflict with the points beyond its hull edge, and on its line when the triangle behind the edge is
+        const double o = _orient(t, i, p);
+        if (o != 0) return o > 0;
+        return _incircle(m_adj[3 * (size_t)t + i] / 3, p);
+    }
+
+    inline int32_t CConstrainedDelaunay::_locate(int32_t t, int32_t p)
+    {
+        //the remembering stochastic walk, across an edge p is beyond, from a random edge on
+        if (_ghost(t)) t = m_adj[3 * (size_t)t + _slot(t, s_infinite)] / 3;
+        int32_t previous = -1;
+        while (true)
+        {
+            m_random = _mix(m_random);
+            const int start = (int)(m_random % 3);
+            int k = 0;
+            for (; k < 3; k++)
+            {
+                const int i = (start + k) % 3;
+                const int32_t next = m_adj[3 * (size_t)t + i] / 3;
+                if (next == previous || _orient(t, i, p) >= 0) continue;
+                previous = t;
+                t = next;
+                break;
+            }
+            if (k == 3) break;
+            if (_ghost(t)) return t;
+        }
+        const int32_t * v = &m_vert[3 * (size_t)t];
+        for (int k = 0; k < 3; k++)
+        {
+            const CPoint2 & a = m_points[v[k]], & q = m_points[p];
+            if (a[0] != q[0] || a[1] != q[1]) continue;
+            m_copy[p] = v[k];
+            return -1;
+        }
+        return t;
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    The triangles in conflict with p are connected, found by a search from the one the walk ended in, and their outer edges are seen from
+    p. Every outer edge, edge i of a triangle of the hole, gives the new triangle with vertex i replaced by p, so it stays counterclockwise
+    and keeps the neighbor across edge i. The other two edges of a new triangle join p to a vertex of the hole, and each vertex of the
+    hole is on two outer edges, so the first new triangle to reach a vertex waits there for the second.
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline bool CConstrainedDelaunay::_insert(int32_t p)
+    {
+        const int32_t start = _locate(m_last, p);
+        if (start < 0) return false;
+
+        m_stamp++;
+        const uint32_t in = 2 * m_stamp, out = in + 1;
+        m_hole.assign(1, start);
+        m_edges.clear();
+        m_mark[start] = in;
+        for (size_t h = 0; h < m_hole.size(); h++)
+        {
+            const int32_t t = m_hole[h];
+            for (int i = 0; i < 3; i++)
+            {
+                const int32_t n = m_adj[3 * (size_t)t + i] / 3;
+                if (m_mark[n] == in) continue;
+                if (m_mark[n] != out && _conflict(n, p))
+                {
+                    m_mark[n] = in;
+                    m_hole.push_back(n);
+                }
+                else
+                {
+                    m_mark[n] = out;
+                    m_edges.push_back(std::make_pair(t, i));
+                }
+            }
+        }
+
+        //the new triangles, first in the slots of the hole, its triangles are read before they are written
+        std::vector<int32_t> & verts = m_verts, & across = m_across;
+        verts.resize(3 * m_edges.size());
+        across.resize(m_edges.size());
+        for (size_t f = 0; f < m_edges.size(); f++)
+        {
+            const int32_t t = m_edges[f].first;
+            const int i = m_edges[f].second;
+            for (int k = 0; k < 3; k++) verts[3 * f + k] = k == i ? p : m_vert[3 * (size_t)t + k];
+            across[f] = m_adj[3 * (size_t)t + i];
+        }
+        for (int32_t t : m_hole)
+        {
+            m_free.push_back(t);
+            m_vert[3 * (size_t)t] = -2;
+        }
+        const int32_t infinity = (int32_t)m_points.size();
+        for (size_t f = 0; f < m_edges.size(); f++)
+        {
+            const int32_t t = _tri();
+            const int i = m_edges[f].second;
+            std::copy(&verts[3 * f], &verts[3 * f] + 3, &m_vert[3 * (size_t)t]);
+            m_mark[t] = 0;
+            _link(3 * t + i, across[f]);
+            for (int j = 0; j < 3; j++)
+            {
+                if (j == i) continue;
+                const int32_t u = verts[3 * f + 3 - i - j];
+                int32_t & waiting = m_waiting[u == s_infinite ? infinity : u];
+                if (waiting < 0) waiting = 3 * t + j;
+                else
+                {
+                    _link(waiting, 3 * t + j);
+                    waiting = -1;
+                }
+            }
+            if (!_ghost(t)) m_last = t;
+        }
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline int32_t CConstrainedDelaunay::_around(int32_t a, int32_t b, int32_t & hit) const
+    {
+        const CPoint2 & pa = m_points[a], & pb = m_points[b];
+        //a point on the line through a and b is on the segment when it is on the side of a that b is on, no edge holds b inside
+        auto ahead = [&](int32_t v)
+        {
+            const CPoint2 & q = m_points[v];
+            return (q[0] - pa[0]) * (pb[0] - pa[0]) + (q[1] - pa[1]) * (pb[1] - pa[1]) > 0;
+        };
+        const int32_t first = m_at[a];
+        int32_t t = first;
+        do
+        {
+            const int k = _slot(t, a);
+            const int32_t u = m_vert[3 * t + (k + 1) % 3], w = m_vert[3 * t + (k + 2) % 3];
+            if (!_ghost(t))
+            {
+                const double ou = _turn(a, b, u), ow = _turn(a, b, w);
+                if (u == b || (ou == 0 && ahead(u)))
+                {
+                    hit = u;
+                    return 3 * t + (k + 2) % 3;
+                }
+                if (w == b || (ow == 0 && ahead(w)))
+                {
+                    hit = w;
+                    return 3 * t + (k + 1) % 3;
+                }
+                if (ou < 0 && ow > 0)
+                {
+                    hit = -1;
+                    return 3 * t + k;
+                }
+            }
+            t = m_adj[3 * t + (k + 1) % 3] / 3;
+        } while (t != first);
+        hit = -1;
+        return -1;
+    }
+
+    inline int32_t CConstrainedDelaunay::_edge(int32_t u, int32_t w) const
+    {
+        const int32_t first = m_at[u];
+        int32_t t = first;
+        do
+        {
+            const int k = _slot(t, u);
+            if (m_vert[3 * t + (k + 1) % 3] == w) return 3 * t + (k + 2) % 3;
+            if (m_vert[3 * t + (k + 2) % 3] == w) return 3 * t + (k + 1) % 3;
+            t = m_adj[3 * t + (k + 1) % 3] / 3;
+        } while (t != first);
+        return -1;
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    Triangle t is a, b, c from slot i on, the one across its edge i is d, c, b from slot j on. After the flip t is a, b, d and the other
+    d, c, a, from the same slots, so each keeps the neighbor across the edge opposite its third slot and takes the one of the other across
+    the edge opposite its first slot.
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline void CConstrainedDelaunay::_flip(int32_t h)
+    {
+        const int32_t t = h / 3, n = m_adj[h] / 3;
+        const int i = h % 3, j = m_adj[h] % 3, i1 = (i + 1) % 3, i2 = (i + 2) % 3, j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+        const int32_t a = m_vert[3 * t + i], b = m_vert[3 * t + i1], c = m_vert[3 * t + i2], d = m_vert[3 * n + j];
+        const int32_t bd = m_adj[3 * n + j1], ca = m_adj[3 * t + i1];
+        const uint8_t fbd = m_fixed[3 * n + j1], fca = m_fixed[3 * t + i1];
+        m_vert[3 * t + i2] = d;
+        m_vert[3 * n + j2] = a;
+        _link(3 * t + i, bd);
+        _link(3 * n + j, ca);
+        _link(3 * t + i1, 3 * n + j1);
+        m_fixed[3 * t + i] = fbd;
+        m_fixed[3 * n + j] = fca;
+        m_fixed[3 * t + i1] = m_fixed[3 * n + j1] = 0;
+        m_at[a] = m_at[b] = m_at[d] = t;
+        m_at[c] = n;
+        MESHLIB_COUNTER_ADD("cdt.flips", 1);
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    The segment from a leaves through an edge of a triangle around a and crosses edges up to b, or up to a point on it, where it is split.
+    A crossed edge is flipped when its two triangles make a convex quad, the edge flipped to goes back in the list if it crosses the
+    segment too and otherwise is kept, else it waits at the end of the list for its neighbors to be flipped, until the segment is an edge.
+    The kept edges are then flipped while they fail the in circle test.
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline bool CConstrainedDelaunay::_constrain(int32_t a, int32_t b)
+    {
+        while (a != b)
+        {
+            int32_t hit;
+            int32_t h = _around(a, b, hit);
+            if (h < 0) return false;
+            if (hit >= 0)
+            {
+                _fix(h);
+                a = hit;
+                continue;
+            }
+
+            m_cross.clear();
+            while (true)
+            {
+                if (m_fixed[h]) return false;
+                const int32_t t = h / 3;
+                const int i = h % 3;
+                m_cross.push_back(std::make_pair(m_vert[3 * t + (i + 1) % 3], m_vert[3 * t + (i + 2) % 3]));
+                const int32_t g = m_adj[h], n = g / 3, x = m_vert[g];
+                const int j = g % 3;
+                if (x == b) { hit = b; break; }
+                const double o = _turn(a, b, x);
+                if (o == 0) { hit = x; break; }
+                h = 3 * n + (o < 0 ? (j + 2) % 3 : (j + 1) % 3);
+            }
+
+            m_made.clear();
+            for (size_t k = 0; k < m_cross.size(); k++)
+            {
+                const std::pair<int32_t, int32_t> e = m_cross[k];
+                const int32_t f = _edge(e.first, e.second);
+                const int32_t y = m_vert[f], x = m_vert[m_adj[f]];
+                const double ou = _turn(y, x, e.first), ow = _turn(y, x, e.second);
+                if (!((ou < 0 && ow > 0) || (ou > 0 && ow < 0)))
+                {
+                    m_cross.push_back(e);
+                    continue;
+                }
+                _flip(f);
+                const double oy = _turn(a, hit, y), ox = _turn(a, hit, x);
+                if ((oy < 0 && ox > 0) || (oy > 0 && ox < 0)) m_cross.push_back(std::make_pair(y, x));
+                else m_made.push_back(std::make_pair(y, x));
+            }
+            _fix(_edge(a, hit));
+
+            for (bool flipped = true; flipped;)
+            {
+                flipped = false;
+                for (std::pair<int32_t, int32_t> & e : m_made)
+                {
+                    const int32_t f = _edge(e.first, e.second);
+                    if (f < 0 || m_fixed[f] || _ghost(f / 3) || _ghost(m_adj[f] / 3) || !_incircle(f / 3, m_vert[m_adj[f]])) continue;
+                    e = std::make_pair(m_vert[f], m_vert[m_adj[f]]);
+                    _flip(f);
+                    flipped = true;
+                }
+            }
+            a = hit;
+        }
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CConstrainedDelaunay::_trim()
+    {
+        //the depth of a triangle is the fewest constraints crossed from the ghosts, by levels, each spread across free edges
+        std::vector<int32_t> depth(m_mark.size(), -1), level, next;
+        for (size_t t = 0; t < m_mark.size(); t++)
+        {
+            if (!_alive((int32_t)t) || !_ghost((int32_t)t)) continue;
+            depth[t] = 0;
+            level.push_back((int32_t)t);
+        }
+        for (int32_t d = 0; !level.empty(); d++)
+        {
+            for (size_t k = 0; k < level.size(); k++)
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    const int32_t h = 3 * level[k] + i, n = m_adj[h] / 3;
+                    if (depth[n] >= 0) continue;
+                    if (m_fixed[h]) next.push_back(n);
+                    else
+                    {
+                        depth[n] = d;
+                        level.push_back(n);
+                    }
+                }
+            }
+            level.clear();
+            for (int32_t n : next)
+            {
+                if (depth[n] >= 0) continue;
+                depth[n] = d + 1;
+                level.push_back(n);
+            }
+            next.clear();
+        }
+        for (size_t t = 0; t < m_mark.size(); t++)
+        {
+            if (!_alive((int32_t)t) || _ghost((int32_t)t) || depth[t] % 2 == 1) continue;
+            m_vert[3 * t] = -2;
+            m_free.push_back((int32_t)t);
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline std::vector<int> CConstrainedDelaunay::triangles() const
+    {
+        std::vector<int> tris;
+        for (size_t t = 0; t < m_mark.size(); t++)
+        {
+            if (!_alive((int32_t)t) || _ghost((int32_t)t)) continue;
+            for (int k = 0; k < 3; k++) tris.push_back(m_order[m_vert[3 * t + k]]);
+        }
+        return tris;
+    }
+
+    template<typename M>
+    void CConstrainedDelaunay::_build(M & mesh) const
+    {
+        std::vector<int> tris = triangles(), index(m_points.size(), -1), vertex(m_points.size());
+        for (int v : tris) index[v] = 0;
+        for (size_t k = 0; k < m_order.size(); k++) vertex[m_order[k]] = (int)k;
+        std::vector<CPoint> points;
+        std::vector<CPoint2> uvs;
+        for (size_t i = 0; i < m_points.size(); i++)
+        {
+            if (index[i] < 0) continue;
+            const CPoint2 & p = m_points[vertex[i]];
+            index[i] = (int)points.size();
+            points.push_back(CPoint(p[0], p[1], 0));
+            uvs.push_back(p);
+        }
+        for (int & v : tris) v = index[v];
+        mesh.build_from_arrays(points, uvs, std::vector<CPoint>(), tris);
+    }
+
+}; //namespace
+
+#endif
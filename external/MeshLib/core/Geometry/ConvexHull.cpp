@@ -26,7 +26,7 @@ void ConvexHull::CConvexHull::boundary( ConvexHull::CSimplex4 & Simplex, std::se
         }
 
 
-        ConvexHull::CTet * pT = m_tet_pool.allocate();
+        ConvexHull::CTet * pT = m_tet_pool.create();
 
         (*pT)[0] = vts[0];
         (*pT)[1] = vts[1];
@@ -61,7 +61,7 @@ void ConvexHull::CConvexHull::boundary( ConvexHull::CTet & Simplex, std::set<Con
             vts[1] = v;
         }
 
-        ConvexHull::CFace * pF = m_face_pool.allocate();
+        ConvexHull::CFace * pF = m_face_pool.create();
 
         (*pF)[0] = vts[0];
         (*pF)[1] = vts[1];
@@ -166,7 +166,7 @@ void ConvexHull::CConvexHull::_visibility( ConvexHull::CVertex * pV )
     for( size_t i = 0; i < visible_tets.size(); i ++ )
     {
         ConvexHull::CTet * pT = visible_tets[i];
-        m_tet_pool.delocate( pT );
+        m_tet_pool.destroy( pT );
     }
 
 };
@@ -223,7 +223,7 @@ void ConvexHull::CConvexHull::_initialize()
             {
                 //[pT, pF] = -1
                 pD->tets(1) =  pT;
-                m_face_pool.delocate( pF );
+                m_face_pool.destroy( pF );
             }
             else
             {
@@ -340,7 +340,7 @@ void ConvexHull::CConvexHull::_insert_one_vertex( CVertex * pV )
 
         if( pF->tets(0)->visible() )
         {
-            CTet * pTet = m_tet_pool.allocate();
+            CTet * pTet = m_tet_pool.create();
 
             (*pTet)[0] = pV;
             (*pTet)[1] = (*pF)[0];
@@ -353,7 +353,7 @@ void ConvexHull::CConvexHull::_insert_one_vertex( CVertex * pV )
         }
         else //pF->tets()[1]->visible()
         {
-            CTet * pTet = m_tet_pool.allocate();
+            CTet * pTet = m_tet_pool.create();
 
             (*pTet)[0] = pV;
             (*pTet)[1] = (*pF)[1];
@@ -392,7 +392,7 @@ void ConvexHull::CConvexHull::_insert_one_vertex( CVertex * pV )
                     pD->tets(1) = pT;
                     break;
                 }
-                m_face_pool.delocate( pF );
+                m_face_pool.destroy( pF );
             }
             else
             {
@@ -411,7 +411,7 @@ void ConvexHull::CConvexHull::_insert_one_vertex( CVertex * pV )
         ConvexHull::CFace   * pF = visible_faces[i];
         ConvexHull::CVertex * pV = pF->min_vert();
         pV->remove( pF );
-        m_face_pool.delocate( pF );
+        m_face_pool.destroy( pF );
     }
 
 };
@@ -419,19 +419,19 @@ void ConvexHull::CConvexHull::_insert_one_vertex( CVertex * pV )
 
 double ConvexHull::CSimplex4::volume()
 {
-    CMatrix m;
+    //the determinant of the differences to m_v[0], its sign exact
+    double p[5][4];
 
-    for( int i = 1; i < 5; i ++ )
+    for( int i = 0; i < 5; i ++ )
     {
         CVertex * pV = m_v[i];
-        CPoint4 q = pV->point() - m_v[0]->point();
         for( int j = 0; j < 4; j ++ )
         {
-            m(i-1,j) = q[j];
+            p[i][j] = pV->point()[j];
         }
     };
 
-    double vol = m.determinant();
+    double vol = CPredicates::orient4d( p[0], p[1], p[2], p[3], p[4] );
 
     //std::cout << "Volume is " << vol << std::endl;
     return vol;
@@ -507,7 +507,7 @@ void ConvexHull::CConvexHull::_remove_upper_tets()
         std::set<ConvexHull::CTet*>::iterator iter = std::find( m_tets.begin(), m_tets.end(), pT );
         assert( iter != m_tets.end() );
         m_tets.erase( iter );
-        m_tet_pool.delocate( pT );
+        m_tet_pool.destroy( pT );
     }
 
     //remove visible faces
@@ -518,7 +518,7 @@ void ConvexHull::CConvexHull::_remove_upper_tets()
         m_faces.erase( iter );
         ConvexHull::CVertex * pV = pF->min_vert();
         pV->remove( pF );
-        m_face_pool.delocate( pF );
+        m_face_pool.destroy( pF );
     }
 }
 
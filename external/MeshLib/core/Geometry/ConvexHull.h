@@ -27,6 +27,7 @@
 #include "Mesh/iterators.h"
 #include "Parser/parser.h"
 #include "TriangleCubeIntersect.h"
+#include "Predicates.h"
 #include "Geometry/MemoryPool.h"
 
 namespace MeshLib
@@ -278,8 +279,8 @@ namespace MeshLib
             std::set<CFace*>   m_faces;
             std::vector<CVertex*> m_verts;
 
-            CMPool<CFace>    m_face_pool;
-            CMPool<CTet>     m_tet_pool;
+            CObjectPool<CFace>  m_face_pool;
+            CObjectPool<CTet>   m_tet_pool;
         };
 
 
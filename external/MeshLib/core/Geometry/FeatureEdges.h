@@ -0,0 +1,161 @@
+/*!
+*      \file FeatureEdges.h
+*      \brief The creases of an index buffer and the adjacency its silhouettes are found from
+*
+*      Both are laid out once, as the mesh is expanded, so that an overlay of
+*      them costs nothing on the CPU when the camera moves. The edges of the
+*      triangles are sorted by their ends, welded across the seams of the
+*      render vertices, so that the triangles sharing one meet in the sorted
+*      array. An edge of two triangles is a crease when their normals turn by
+*      more than the crease angle, and each of the two learns the far corner
+*      of the other, which a geometry shader taking GL_TRIANGLES_ADJACENCY
+*      needs to tell whether the edge is on the silhouette from the current
+*      view.
+*/
+
+#ifndef _MESHLIB_FEATURE_EDGES_H_
+#define _MESHLIB_FEATURE_EDGES_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "Point.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CFeatureEdges class
+     */
+    class CFeatureEdges
+    {
+    public:
+        //! an edge is a crease where the normals of its triangles turn by more than this many degrees
+        double crease_angle = 40;
+
+        void clear()
+        {
+            m_creases.clear();
+            m_adjacency.clear();
+        }
+
+        /*!
+         *  Find the creases of the triangles of an index buffer and the neighbours of every triangle
+         *  \param indices   three vertex indices per triangle
+         *  \param positions 3 floats per vertex
+         *  \param welded    if not NULL, the vertex the edges of vertex v join by, a vertex split at a seam
+         *                   say, the vertices themselves otherwise
+         *  \param threads   number of threads, 0 uses all hardware threads
+         *  \return number of creases
+         */
+        size_t build(const uint32_t * indices, size_t triangles, const float * positions, const uint32_t * welded = NULL, int threads = 0);
+
+        /*! number of creases */
+        size_t size() const { return m_creases.size() / 2; }
+        /*! the two vertices of every crease and of every edge of more than two triangles, for GL_LINES */
+        const std::vector<uint32_t> & creases() const { return m_creases; }
+        /*! six vertices per triangle for GL_TRIANGLES_ADJACENCY, corner k at 2k and the far corner of the
+            triangle across the edge from corner k to the next at 2k + 1. an edge without exactly one
+            neighbour has the third corner of its own triangle there, the neighbour then faces the other
+            way and the edge reads as an outline whenever the triangle faces the eye */
+        const std::vector<uint32_t> & adjacency() const { return m_adjacency; }
+
+    protected:
+        std::vector<uint32_t> m_creases;
+        std::vector<uint32_t> m_adjacency;
+    };
+
+    inline size_t CFeatureEdges::build(const uint32_t * indices, size_t triangles, const float * positions, const uint32_t * welded, int threads)
+    {
+        clear();
+        if (triangles == 0) return 0;
+
+        // the unit normal of every triangle, zero without area
+        std::vector<CPoint> normals(triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                CPoint p[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    const float * q = positions + 3 * indices[3 * t + k];
+                    p[k] = CPoint(q[0], q[1], q[2]);
+                }
+                const CPoint n = (p[1] - p[0]) ^ (p[2] - p[0]);
+                const double l = n.norm();
+                normals[t] = l > 0 ? n / l : CPoint(0, 0, 0);
+            }
+        });
+
+        // the edges by their welded ends, the lower first, those of one edge next to each other
+        struct CEdgeKey
+        {
+            uint32_t a, b, t, k;
+            bool operator<(const CEdgeKey & o) const
+            {
+                return a != o.a ? a < o.a : b != o.b ? b < o.b : t != o.t ? t < o.t : k < o.k;
+            }
+        };
+        std::vector<CEdgeKey> edges(3 * triangles);
+        m_adjacency.resize(6 * triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t u = indices[3 * t + k], v = indices[3 * t + (k + 1) % 3];
+                    if (welded)
+                    {
+                        u = welded[u];
+                        v = welded[v];
+                    }
+                    edges[3 * t + k] = CEdgeKey{ std::min(u, v), std::max(u, v), (uint32_t)t, k };
+                    m_adjacency[6 * t + 2 * k] = indices[3 * t + k];
+                    m_adjacency[6 * t + 2 * k + 1] = indices[3 * t + (k + 2) % 3];
+                }
+        });
+        parallel_sort(edges.begin(), edges.end(), threads, [](const CEdgeKey & x, const CEdgeKey & y) { return x < y; });
+
+        // every run of equal ends is classified by its first edge, the threads take the runs that start in their range
+        const double cutoff = std::cos(crease_angle * 3.14159265358979323846 / 180.0);
+        std::vector<char> crease(edges.size(), 0);
+        parallel_for(edges.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                if (i > 0 && edges[i - 1].a == edges[i].a && edges[i - 1].b == edges[i].b) continue;
+                if (edges[i].a == edges[i].b) continue;
+                size_t j = i + 1;
+                while (j < edges.size() && edges[j].a == edges[i].a && edges[j].b == edges[i].b) j++;
+                if (j - i > 2)
+                {
+                    crease[i] = 1;
+                    continue;
+                }
+                if (j - i != 2 || edges[i].t == edges[i + 1].t) continue;
+                const CEdgeKey & x = edges[i], & y = edges[i + 1];
+                m_adjacency[6 * x.t + 2 * x.k + 1] = indices[3 * y.t + (y.k + 2) % 3];
+                m_adjacency[6 * y.t + 2 * y.k + 1] = indices[3 * x.t + (x.k + 2) % 3];
+                const CPoint & nx = normals[x.t], & ny = normals[y.t];
+                if (nx * nx > 0 && ny * ny > 0 && nx * ny < cutoff) crease[i] = 1;
+            }
+        });
+
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            if (!crease[i]) continue;
+            const CEdgeKey & x = edges[i];
+            m_creases.push_back(indices[3 * x.t + x.k]);
+            m_creases.push_back(indices[3 * x.t + (x.k + 1) % 3]);
+        }
+        return size();
+    }
+
+}; //namespace
+
+#endif
@@ -9,7 +9,7 @@
 #ifndef _MESHLIB_HYPERBOLIC_CIRCLE_H_
 #define _MESHLIB_HYPERBOLIC_CIRCLE_H_
 
-#include "circle.h"
+#include "Circle.h"
 
 namespace MeshLib{
 
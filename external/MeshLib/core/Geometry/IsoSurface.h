@@ -0,0 +1,520 @@
+/*!
+*      \file IsoSurface.h
+*      \brief Level sets of a CSignedDistanceField as triangle meshes, by marching cubes or dual contouring
+*
+*      A cell of the grid is in one brick, so the bricks holding samples are
+*      the tiles of the extraction and run in parallel. Marching cubes puts a
+*      vertex on every edge of the grid the level set crosses, dual contouring
+*      one in every cell it crosses, where the planes of the crossings of its
+*      edges meet, and a quad across every crossed edge. A vertex belongs to
+*      one brick, that of the lower end of its edge or of its cell, so bricks
+*      share the vertices along their faces instead of welding copies. Every
+*      brick first marks its crossed edges and cells in bit masks, the vertex
+*      of a mark is then the first vertex of its brick and the marks before it,
+*      so the vertices and triangles go into flat arrays at offsets known
+*      before they are written, and the mesh is built from the arrays in one
+*      go. The cases of marching cubes are traced from the crossings on the
+*      faces of a cube, a face with all four edges crossed keeps its outside
+*      corners apart, the same from both cubes sharing it, so the surface is
+*      closed. Only the bricks with samples are read, the level has to be in
+*      the band of the field.
+*/
+
+#ifndef _MESHLIB_ISO_SURFACE_H_
+#define _MESHLIB_ISO_SURFACE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include "Point.h"
+#include "Point2.h"
+#include "SignedDistanceField.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CIsoSurface class, the triangles of a level set, counterclockwise seen from above the level
+     */
+    class CIsoSurface
+    {
+    public:
+        /*! where the vertices go */
+        enum Method
+        {
+            MARCHING_CUBES,   //!< on the crossed edges, the mesh is closed
+            DUAL_CONTOURING   //!< in the crossed cells, keeps sharp edges and corners
+        };
+
+        /*!
+         *  Extract the surface where the field is level
+         *  \param level   the distance of the surface, negative to shrink, positive to grow the shape
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void _extract(const CSignedDistanceField & field, double level = 0, Method method = MARCHING_CUBES, int threads = 0);
+
+        /*! build mesh, any empty CBaseMesh, from the triangles, with the normals of the field */
+        template<typename M>
+        void _build(M & mesh) const
+        {
+            mesh.build_from_arrays(m_points, std::vector<CPoint2>(), m_normals, m_indices);
+        }
+
+        void clear()
+        {
+            m_points.clear();
+            m_normals.clear();
+            m_indices.clear();
+        }
+
+        const std::vector<CPoint> & points() const { return m_points; }
+        /*! the unit gradient of the field at every point */
+        const std::vector<CPoint> & normals() const { return m_normals; }
+        /*! three points a triangle */
+        const std::vector<int> & indices() const { return m_indices; }
+
+    protected:
+        static const int s_brick = 8;
+        static const int s_side = s_brick + 1;
+        //! how much a vertex of dual contouring is pulled to the mean of its crossings, in cells
+        static constexpr double s_bias = 0.05;
+
+        //! a brick with samples, its marks and the vertices before its words of marks
+        struct CBrick
+        {
+            int x, y, z;
+            const float * samples;
+            uint64_t marks[4][8];       //!< the crossed edges along x, y and z by their lower end, then the crossed cells, bit i + 8 j + 64 k
+            uint32_t rank[4][8];        //!< the marks of the brick before a word
+            size_t vertex, index;       //!< the first vertex and index of the brick
+        };
+
+        //! the triangles of every case of marching cubes, three edges a triangle, -1 after the last
+        struct CCases
+        {
+            int8_t edges[256][31];
+            int count[256];
+        };
+
+        /*! the two corners of edge e of a cube, corner c at x, y, z = c & 1, c >> 1 & 1, c >> 2 */
+        static void _ends(int e, int & p, int & q)
+        {
+            const int a = e / 4, u = (a + 1) % 3, v = (a + 2) % 3;
+            p = (e & 1) << u | (e >> 1 & 1) << v;
+            q = p | 1 << a;
+        }
+        static const CCases & _cases();
+
+        static int _popcount(uint64_t v)
+        {
+            v = v - ((v >> 1) & 0x5555555555555555ull);
+            v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+            v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            return (int)((v * 0x0101010101010101ull) >> 56);
+        }
+
+        /*! the brick holding local cell or sample i, j, k of brick b, each from -1 to 8, and where in it, NULL for none */
+        const CBrick * _locate(const CBrick & b, int & i, int & j, int & k) const;
+        /*! the vertex of mark kind at i, j, k of brick b, -1 if it is not marked */
+        static int _vertex(const CBrick & b, int kind, int i, int j, int k)
+        {
+            const int bit = i + 8 * j + 64 * k;
+            const uint64_t word = b.marks[kind][bit >> 6];
+            if (!(word >> (bit & 63) & 1)) return -1;
+            return (int)(b.vertex + b.rank[kind][bit >> 6] + _popcount(word & ((1ull << (bit & 63)) - 1)));
+        }
+        /*! the sample i, j, k of a brick */
+        static float _sample(const CBrick & b, int i, int j, int k) { return b.samples[(k * s_side + j) * s_side + i]; }
+
+        /*! the point of dual contouring in cell i, j, k of brick b, in cells of the grid */
+        CPoint _dual(const CBrick & b, int i, int j, int k) const;
+
+        const CSignedDistanceField * m_field = NULL;
+        double m_level = 0;
+        std::vector<CBrick>  m_bricks;
+        std::vector<CPoint>  m_points;
+        std::vector<CPoint>  m_normals;
+        std::vector<int>     m_indices;
+    };
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    The cases of marching cubes. The edges of a face are walked counterclockwise seen from outside the cube, and every crossing from an
+    inside corner to an outside one is joined to the next crossing, back inside, which cuts the outside corners between them off. The
+    cube sharing the face walks it the other way, so it joins the same crossings and the polygons of both meet along the face. Every
+    crossed edge is left on one of its faces and entered on the other, so the joins close into loops, each cut into a fan
+    wound against the order of the walk, so the triangles face out of the inside, along the gradient
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline const CIsoSurface::CCases & CIsoSurface::_cases()
+    {
+        struct CBuild : CCases
+        {
+            CBuild()
+            {
+                for (int c = 0; c < 256; c++)
+                {
+                    int next[12];
+                    std::fill(next, next + 12, -1);
+                    for (int a = 0; a < 3; a++)
+                        for (int s = 0; s < 2; s++)
+                        {
+                            const int u = (a + 1) % 3, v = (a + 2) % 3, base = s << a;
+                            int corner[4] = { base, base | 1 << u, base | 1 << u | 1 << v, base | 1 << v };
+                            if (s == 0) std::swap(corner[1], corner[3]);
+                            int edge[4];
+                            bool in[4];
+                            for (int m = 0; m < 4; m++)
+                            {
+                                const int p = corner[m], q = corner[(m + 1) % 4], d = p ^ q;
+                                const int ea = d == 1 ? 0 : d == 2 ? 1 : 2, lo = std::min(p, q);
+                                edge[m] = 4 * ea + (lo >> ((ea + 1) % 3) & 1) + 2 * (lo >> ((ea + 2) % 3) & 1);
+                                in[m] = (c >> p & 1) != 0;
+                            }
+                            for (int m = 0; m < 4; m++)
+                            {
+                                if (!in[m] || in[(m + 1) % 4]) continue;
+                                int n = (m + 1) % 4;
+                                while (!(!in[n] && in[(n + 1) % 4])) n = (n + 1) % 4;
+                                next[edge[m]] = edge[n];
+                            }
+                        }
+                    int k = 0;
+                    bool done[12] = {};
+                    for (int e = 0; e < 12; e++)
+                    {
+                        if (next[e] < 0 || done[e]) continue;
+                        std::vector<int> loop;
+                        for (int f = e; !done[f]; f = next[f])
+                        {
+                            done[f] = true;
+                            loop.push_back(f);
+                        }
+                        for (size_t t = 1; t + 1 < loop.size(); t++)
+                        {
+                            edges[c][k++] = (int8_t)loop[0];
+                            edges[c][k++] = (int8_t)loop[t + 1];
+                            edges[c][k++] = (int8_t)loop[t];
+                        }
+                    }
+                    count[c] = k / 3;
+                    std::fill(edges[c] + k, edges[c] + 31, (int8_t)-1);
+                }
+            }
+        };
+        static const CBuild cases;
+        return cases;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline const CIsoSurface::CBrick * CIsoSurface::_locate(const CBrick & b, int & i, int & j, int & k) const
+    {
+        int c[3] = { i, j, k }, g[3] = { b.x, b.y, b.z };
+        bool same = true;
+        for (int a = 0; a < 3; a++)
+        {
+            if (c[a] >= 0 && c[a] < s_brick) continue;
+            same = false;
+            g[a] += c[a] < 0 ? -1 : 1;
+            c[a] += c[a] < 0 ? s_brick : -s_brick;
+        }
+        i = c[0];
+        j = c[1];
+        k = c[2];
+        if (same) return &b;
+        const int nb = m_field->_bricks();
+        if (g[0] < 0 || g[1] < 0 || g[2] < 0 || g[0] >= nb || g[1] >= nb || g[2] >= nb) return NULL;
+        const uint32_t slot = m_field->m_slots[(size_t)g[0] + (size_t)nb * ((size_t)g[1] + (size_t)nb * g[2])];
+        return slot == CSignedDistanceField::s_none ? NULL : &m_bricks[slot];
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    The point that fits the planes of the crossings of the edges of the cell best, each through the crossing and across the gradient of
+    the trilinear field of the cell there, pulled a little to the mean of the crossings so that parallel planes still have one, and kept
+    in the cell
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline CPoint CIsoSurface::_dual(const CBrick & b, int i, int j, int k) const
+    {
+        double v[8];
+        for (int c = 0; c < 8; c++) v[c] = _sample(b, i + (c & 1), j + (c >> 1 & 1), k + (c >> 2)) - m_level;
+        double ata[3][3] = {}, atb[3] = {};
+        CPoint mean;
+        int n = 0;
+        for (int e = 0; e < 12; e++)
+        {
+            int p, q;
+            _ends(e, p, q);
+            if ((v[p] < 0) == (v[q] < 0)) continue;
+            const double t = v[p] / (v[p] - v[q]);
+            CPoint x(p & 1, p >> 1 & 1, p >> 2);
+            x[e / 4] = t;
+            const double f[3] = { x[0], x[1], x[2] };
+            const double x00 = v[0] + (v[1] - v[0]) * f[0], x10 = v[2] + (v[3] - v[2]) * f[0];
+            const double x01 = v[4] + (v[5] - v[4]) * f[0], x11 = v[6] + (v[7] - v[6]) * f[0];
+            const double dx0 = (v[1] - v[0]) + ((v[3] - v[2]) - (v[1] - v[0])) * f[1];
+            const double dx1 = (v[5] - v[4]) + ((v[7] - v[6]) - (v[5] - v[4])) * f[1];
+            CPoint g(dx0 + (dx1 - dx0) * f[2], (x10 - x00) + ((x11 - x01) - (x10 - x00)) * f[2],
+                     (x01 + (x11 - x01) * f[1]) - (x00 + (x10 - x00) * f[1]));
+            const double l = g.norm();
+            if (l > 0) g /= l;
+            const double d = g * x;
+            for (int r = 0; r < 3; r++)
+            {
+                for (int s = 0; s < 3; s++) ata[r][s] += g[r] * g[s];
+                atb[r] += g[r] * d;
+            }
+            mean += x;
+            n++;
+        }
+        if (n == 0) return CPoint(i + 0.5, j + 0.5, k + 0.5);
+        mean /= n;
+        for (int r = 0; r < 3; r++)
+        {
+            ata[r][r] += s_bias;
+            atb[r] += s_bias * mean[r];
+        }
+        // Cramer's rule on the symmetric positive definite system
+        const double det = ata[0][0] * (ata[1][1] * ata[2][2] - ata[1][2] * ata[2][1])
+                         - ata[0][1] * (ata[1][0] * ata[2][2] - ata[1][2] * ata[2][0])
+                         + ata[0][2] * (ata[1][0] * ata[2][1] - ata[1][1] * ata[2][0]);
+        CPoint x = mean;
+        if (std::fabs(det) > 1e-12)
+            for (int r = 0; r < 3; r++)
+            {
+                double m[3][3];
+                for (int s = 0; s < 3; s++)
+                    for (int t = 0; t < 3; t++) m[s][t] = t == r ? atb[s] : ata[s][t];
+                x[r] = (m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+                      - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                      + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0])) / det;
+            }
+        for (int r = 0; r < 3; r++) x[r] = std::max(0.0, std::min(1.0, x[r]));
+        return CPoint(i, j, k) + x;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CIsoSurface::_extract(const CSignedDistanceField & field, double level, Method method, int threads)
+    {
+        clear();
+        m_bricks.clear();
+        m_field = &field;
+        m_level = level;
+        const int nb = field._bricks();
+        const size_t count = field.bricks();
+        if (count == 0) return;
+        const bool dual = method == DUAL_CONTOURING;
+        const CCases & cases = _cases();
+
+        // the bricks by slot
+        m_bricks.resize(count);
+        for (size_t g = 0; g < field.m_slots.size(); g++)
+        {
+            const uint32_t slot = field.m_slots[g];
+            if (slot == CSignedDistanceField::s_none) continue;
+            CBrick & b = m_bricks[slot];
+            b.x = (int)(g % nb);
+            b.y = (int)(g / nb % nb);
+            b.z = (int)(g / nb / nb);
+            b.samples = &field.m_samples[(size_t)slot * CSignedDistanceField::s_samples];
+        }
+
+        // the crossed edges and cells of every brick, and the triangles of marching cubes
+        std::vector<size_t> triangles(count + 1, 0);
+        parallel_for(count, threads, [&](size_t bb, size_t be)
+        {
+            for (size_t s = bb; s < be; s++)
+            {
+                CBrick & b = m_bricks[s];
+                bool in[s_side * s_side * s_side];
+                for (int j = 0; j < s_side * s_side * s_side; j++) in[j] = b.samples[j] < level;
+                std::fill(&b.marks[0][0], &b.marks[0][0] + 32, 0);
+                size_t n = 0;
+                for (int k = 0; k < s_brick; k++)
+                    for (int j = 0; j < s_brick; j++)
+                        for (int i = 0; i < s_brick; i++)
+                        {
+                            const int at = (k * s_side + j) * s_side + i, bit = i + 8 * j + 64 * k;
+                            const int steps[3] = { 1, s_side, s_side * s_side };
+                            for (int a = 0; a < 3; a++)
+                                if (in[at] != in[at + steps[a]]) b.marks[a][bit >> 6] |= 1ull << (bit & 63);
+                            int c = 0;
+                            for (int m = 0; m < 8; m++) c |= in[at + (m & 1) + (m >> 1 & 1) * s_side + (m >> 2) * s_side * s_side] << m;
+                            if (c != 0 && c != 255) b.marks[3][bit >> 6] |= 1ull << (bit & 63);
+                            if (!dual) n += cases.count[c];
+                        }
+                uint32_t r = 0;
+                for (int kind = 0; kind < 4; kind++)
+                    for (int w = 0; w < 8; w++)
+                    {
+                        b.rank[kind][w] = r;
+                        if ((kind == 3) == dual) r += _popcount(b.marks[kind][w]);
+                    }
+                // the ranks of the kind the method does not use count from 0, they are never looked up
+                b.vertex = r;
+                triangles[s + 1] = n;
+            }
+        }, 16);
+
+        // a quad of dual contouring across every crossed edge whose four cells are in bricks with samples
+        if (dual)
+            parallel_for(count, threads, [&](size_t bb, size_t be)
+            {
+                for (size_t s = bb; s < be; s++)
+                {
+                    const CBrick & b = m_bricks[s];
+                    size_t n = 0;
+                    for (int a = 0; a < 3; a++)
+                        for (int w = 0; w < 8; w++)
+                            for (uint64_t word = b.marks[a][w]; word; word &= word - 1)
+                            {
+                                const int bit = 64 * w + _popcount((word & (0 - word)) - 1);
+                                const int u = (a + 1) % 3, v = (a + 2) % 3;
+                                bool all = true;
+                                for (int q = 1; q < 4 && all; q++)
+                                {
+                                    int c[3] = { bit & 7, bit >> 3 & 7, bit >> 6 };
+                                    c[u] -= q & 1;
+                                    c[v] -= q >> 1;
+                                    const CBrick * o = _locate(b, c[0], c[1], c[2]);
+                                    all = o != NULL;
+                                }
+                                if (all) n += 2;
+                            }
+                    triangles[s + 1] = n;
+                }
+            }, 16);
+
+        size_t vertices = 0;
+        for (size_t s = 0; s < count; s++)
+        {
+            const size_t n = m_bricks[s].vertex;
+            m_bricks[s].vertex = vertices;
+            vertices += n;
+            triangles[s + 1] += triangles[s];
+            m_bricks[s].index = 3 * triangles[s];
+        }
+        m_points.resize(vertices);
+        m_normals.resize(vertices);
+        m_indices.resize(3 * triangles[count]);
+
+        // the vertices, in cells of the grid first
+        const int kind = dual ? 3 : 0;
+        parallel_for(count, threads, [&](size_t bb, size_t be)
+        {
+            for (size_t s = bb; s < be; s++)
+            {
+                const CBrick & b = m_bricks[s];
+                for (int a = kind; a < (dual ? 4 : 3); a++)
+                    for (int w = 0; w < 8; w++)
+                        for (uint64_t word = b.marks[a][w]; word; word &= word - 1)
+                        {
+                            const int bit = 64 * w + _popcount((word & (0 - word)) - 1);
+                            const int i = bit & 7, j = bit >> 3 & 7, k = bit >> 6;
+                            CPoint g;
+                            if (dual) g = _dual(b, i, j, k);
+                            else
+                            {
+                                const double v0 = _sample(b, i, j, k) - level;
+                                const double v1 = _sample(b, i + (a == 0), j + (a == 1), k + (a == 2)) - level;
+                                g = CPoint(i, j, k);
+                                g[a] += v0 / (v0 - v1);
+                            }
+                            g += CPoint(b.x, b.y, b.z) * s_brick;
+                            CPoint n;
+                            field._lookup(g, &n);
+                            const double l = n.norm();
+                            const size_t at = (size_t)_vertex(b, a, i, j, k);
+                            m_points[at] = field.origin() + g * field.voxel_size();
+                            m_normals[at] = l > 0 ? n / l : n;
+                        }
+            }
+        }, 16);
+
+        // the triangles, those with a vertex another brick does not have are left out
+        std::atomic<size_t> missing(0);
+        parallel_for(count, threads, [&](size_t bb, size_t be)
+        {
+            for (size_t s = bb; s < be; s++)
+            {
+                const CBrick & b = m_bricks[s];
+                int * out = m_indices.data() + b.index;
+                auto vertex = [&](int kind, int i, int j, int k)
+                {
+                    const CBrick * o = _locate(b, i, j, k);
+                    return o ? _vertex(*o, kind, i, j, k) : -1;
+                };
+                if (dual)
+                {
+                    for (int a = 0; a < 3; a++)
+                        for (int w = 0; w < 8; w++)
+                            for (uint64_t word = b.marks[a][w]; word; word &= word - 1)
+                            {
+                                const int bit = 64 * w + _popcount((word & (0 - word)) - 1);
+                                const int i = bit & 7, j = bit >> 3 & 7, k = bit >> 6;
+                                const int u = (a + 1) % 3, v = (a + 2) % 3;
+                                // the cells around the edge counterclockwise about its axis, turned if the level rises along it
+                                int quad[4];
+                                bool all = true;
+                                for (int q = 0; q < 4; q++)
+                                {
+                                    int c[3] = { i, j, k };
+                                    c[u] -= q == 0 || q == 3;
+                                    c[v] -= q < 2;
+                                    quad[q] = vertex(3, c[0], c[1], c[2]);
+                                    all = all && _locate(b, c[0], c[1], c[2]) != NULL;
+                                }
+                                if (!all) continue;
+                                if (_sample(b, i, j, k) >= level) std::swap(quad[1], quad[3]);
+                                // split along the shorter diagonal
+                                const bool split = quad[0] >= 0 && quad[1] >= 0 && quad[2] >= 0 && quad[3] >= 0 &&
+                                    (m_points[quad[0]] - m_points[quad[2]]).norm() > (m_points[quad[1]] - m_points[quad[3]]).norm();
+                                const int t[6] = { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] };
+                                const int r[6] = { quad[1], quad[2], quad[3], quad[1], quad[3], quad[0] };
+                                for (int m = 0; m < 6; m++) *out++ = split ? r[m] : t[m];
+                            }
+                }
+                else
+                    for (int k = 0; k < s_brick; k++)
+                        for (int j = 0; j < s_brick; j++)
+                            for (int i = 0; i < s_brick; i++)
+                            {
+                                int c = 0;
+                                for (int m = 0; m < 8; m++) c |= (_sample(b, i + (m & 1), j + (m >> 1 & 1), k + (m >> 2)) < level) << m;
+                                for (const int8_t * e = cases.edges[c]; *e >= 0; e++)
+                                {
+                                    int p, q;
+                                    _ends(*e, p, q);
+                                    *out++ = vertex(*e / 4, i + (p & 1), j + (p >> 1 & 1), k + (p >> 2));
+                                }
+                            }
+                size_t lost = 0;
+                for (const int * t = m_indices.data() + b.index; t < out; t++) lost += *t < 0;
+                if (lost) missing += lost;
+            }
+        }, 16);
+
+        if (missing)
+        {
+            size_t kept = 0;
+            for (size_t t = 0; t < m_indices.size(); t += 3)
+            {
+                if (m_indices[t] < 0 || m_indices[t + 1] < 0 || m_indices[t + 2] < 0) continue;
+                for (int c = 0; c < 3; c++) m_indices[kept + c] = m_indices[t + c];
+                kept += 3;
+            }
+            m_indices.resize(kept);
+        }
+        m_bricks = std::vector<CBrick>();
+        MESHLIB_COUNTER_ADD("iso_surface.triangles", m_indices.size() / 3);
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,434 @@
+/*!
+*      \file LinearOctree.h
+*      \brief Pointerless octree over a point set
+*
+*      The points are sorted by the Morton code of their cell at the finest
+*      depth, so that every node is a range of the one sorted array. The nodes
+*      are stored breadth first, the children of a node next to each other in
+*      Morton order, and only the occupied ones.
+*
+*      The nearest neighbour and radius queries walk the nodes with a stack of
+*      their own, no recursion and no pointers, the nearer children of a node
+*      first and the cells farther than what was found already skipped. The
+*      batched ones run over the query points in parallel.
+*/
+
+#ifndef _MESHLIB_LINEAR_OCTREE_H_
+#define _MESHLIB_LINEAR_OCTREE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include "Point.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CLinearOctree class, a cube subdivided around the points in it
+     */
+    class CLinearOctree
+    {
+    public:
+        //! the deepest level a 64 bit code holds
+        static const int s_max_depth = 21;
+
+        struct CNode
+        {
+            uint64_t code;          //!< Morton code of the cell, 3 bits per level below the root
+            size_t   begin;         //!< the points of the cell, a range of points()
+            size_t   end;
+            uint32_t first_child;   //!< index of the first of the occupied children, if any
+            uint8_t  child_mask;    //!< bit 4i + 2j + k for the child at offset (i, j, k)
+            uint8_t  depth;
+
+            bool leaf() const { return child_mask == 0; }
+        };
+
+        /*! the cube from p to q, [-1, 1]^3 as COctree's by default */
+        CLinearOctree( CPoint p = CPoint( -1, -1, -1 ), CPoint q = CPoint( 1, 1, 1 ) )
+        {
+            m_corner[0] = p;
+            m_corner[1] = q;
+        };
+
+        /*!
+         *  Sort the points inside the cube and subdivide the cells holding more
+         *  than leaf_size of them, down to depth n
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \param leaf_size the points a leaf may hold above the finest depth, the queries test
+         *  a few points each in larger leaves faster than they walk the nodes down to single ones
+         */
+        void _construct( const std::vector<CPoint> & pts, int n, int threads = 0, size_t leaf_size = 1 );
+
+        size_t size() const { return m_nodes.size(); };
+        const CNode & node( size_t i ) const { return m_nodes[i]; };
+        const CNode & root() const { return m_nodes[0]; };
+        /*! the points inside the cube in Morton order */
+        const std::vector<CPoint> & points() const { return m_points; };
+        /*! for every point of points(), its index in the points given to _construct */
+        const std::vector<size_t> & indices() const { return m_indices; };
+        int depth() const { return m_depth; };
+
+        //! the index of no point, where a query found fewer than it was asked for
+        static const size_t s_none = ~(size_t)0;
+
+        /*!
+         *  The k points nearest to q as pairs of their squared distance and their index into
+         *  points(), the nearest first, fewer if the tree holds fewer. q may be outside the cube
+         */
+        void _nearest( const CPoint & q, size_t k, std::vector<std::pair<double, size_t>> & found ) const
+        {
+            std::vector<CVisit> stack;
+            _nearest( q, k, found, stack );
+        };
+
+        /*! the indices into points() of the points at most r from q, in Morton order */
+        void _within( const CPoint & q, double r, std::vector<size_t> & found ) const
+        {
+            std::vector<CVisit> stack;
+            found.clear();
+            _within( q, r, found, stack );
+        };
+
+        /*!
+         *  _nearest for every query point, in parallel over them. The neighbors of query i are
+         *  neighbors[k * i] to neighbors[k * i + k - 1], indices into points() from the nearest,
+         *  s_none past the last one found
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void _nearest( const std::vector<CPoint> & queries, size_t k, std::vector<size_t> & neighbors, int threads = 0 ) const
+        {
+            neighbors.assign( queries.size() * k, (size_t)s_none );
+            if( k == 0 ) return;
+            parallel_for( queries.size(), threads, [&]( size_t b, size_t e )
+            {
+                //the scratch of a range is reused for its queries
+                std::vector<std::pair<double, size_t>> found;
+                std::vector<CVisit> stack;
+                for( size_t i = b; i < e; i ++ )
+                {
+                    _nearest( queries[i], k, found, stack );
+                    for( size_t j = 0; j < found.size(); j ++ ) neighbors[k * i + j] = found[j].second;
+                }
+            }, 256 );
+        };
+
+        /*!
+         *  _within for every query point, in parallel over them. The neighbors of query i are
+         *  neighbors[offsets[i]] to neighbors[offsets[i + 1] - 1], indices into points()
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void _within( const std::vector<CPoint> & queries, double r, std::vector<size_t> & offsets,
+                      std::vector<size_t> & neighbors, int threads = 0 ) const
+        {
+            //the lists of every query, then their counts summed into the offsets and the lists copied
+            std::vector<std::vector<size_t>> lists( queries.size() );
+            parallel_for( queries.size(), threads, [&]( size_t b, size_t e )
+            {
+                std::vector<CVisit> stack;
+                for( size_t i = b; i < e; i ++ ) _within( queries[i], r, lists[i], stack );
+            }, 256 );
+            offsets.assign( queries.size() + 1, 0 );
+            for( size_t i = 0; i < queries.size(); i ++ ) offsets[i + 1] = offsets[i] + lists[i].size();
+            neighbors.resize( offsets.back() );
+            parallel_for( queries.size(), threads, [&]( size_t b, size_t e )
+            {
+                for( size_t i = b; i < e; i ++ ) std::copy( lists[i].begin(), lists[i].end(), neighbors.begin() + offsets[i] );
+            }, 1024 );
+        };
+
+        /*! the corners of the cell of a node */
+        void _corners( const CNode & node, CPoint & p, CPoint & q ) const
+        {
+            const double len = ( m_corner[1][0] - m_corner[0][0] ) / (double)( 1 << node.depth );
+            uint32_t c[3];
+            _compact( node.code, c );
+            p = m_corner[0] + CPoint( c[0], c[1], c[2] ) * len;
+            q = p + CPoint( len, len, len );
+        };
+
+        /*! the deepest node whose cell holds p, -1 if p is outside the cube */
+        long _find( const CPoint & p ) const
+        {
+            uint64_t code;
+            if( m_nodes.empty() || !_code( p, code ) ) return -1;
+            size_t i = 0;
+            while( !m_nodes[i].leaf() )
+            {
+                const CNode & n = m_nodes[i];
+                const int c = (int)( ( code >> ( 3 * ( m_depth - n.depth - 1 ) ) ) & 7 );
+                if( !( n.child_mask & ( 1 << c ) ) ) break;
+                //the occupied children before c come first
+                i = n.first_child + _popcount( n.child_mask & ( ( 1 << c ) - 1 ) );
+            }
+            return (long)i;
+        };
+
+        /*! interleave the bits of x, y and z, x highest */
+        static uint64_t _morton( uint32_t x, uint32_t y, uint32_t z )
+        {
+            return ( _spread( x ) << 2 ) | ( _spread( y ) << 1 ) | _spread( z );
+        };
+
+        /*! the x, y and z of a code, as _morton takes them */
+        static void _compact( uint64_t code, uint32_t c[3] )
+        {
+            c[0] = _gather( code >> 2 );
+            c[1] = _gather( code >> 1 );
+            c[2] = _gather( code );
+        };
+
+    protected:
+        static double _distance2( const CPoint & a, const CPoint & b )
+        {
+            const double x = a[0] - b[0], y = a[1] - b[1], z = a[2] - b[2];
+            return x * x + y * y + z * z;
+        };
+
+        /*! a node on the stack of a query, with the near corner of its cell and its distance from the query */
+        struct CVisit
+        {
+            double   distance;
+            uint32_t node;
+            CPoint   corner;
+        };
+
+        /*! the squared distances dmin from q to the cell from p of edge len, 0 inside, and dmax to its farthest corner */
+        static void _distances( const CPoint & p, double len, const CPoint & q, double & dmin, double & dmax )
+        {
+            dmin = dmax = 0;
+            for( int i = 0; i < 3; i ++ )
+            {
+                const double lo = q[i] - p[i], hi = p[i] + len - q[i];
+                const double t = std::max( std::max( -lo, -hi ), 0.0 );
+                const double u = std::max( lo, hi );
+                dmin += t * t;
+                dmax += u * u;
+            }
+        };
+
+        /*! the near corner of child c of a node whose cell starts at p, the children of edge len */
+        void _child( const CNode & node, int c, const CPoint & p, double len, CPoint & corner ) const
+        {
+            const int cell = (int)( m_nodes[node.first_child + c].code & 7 );
+            corner = CPoint( p[0] + ( cell >> 2 ) * len, p[1] + ( ( cell >> 1 ) & 1 ) * len, p[2] + ( cell & 1 ) * len );
+        };
+
+        /*! _nearest with the scratch of the caller, found is a max heap of the best so far on the way */
+        void _nearest( const CPoint & q, size_t k, std::vector<std::pair<double, size_t>> & found, std::vector<CVisit> & stack ) const
+        {
+            found.clear();
+            if( m_nodes.empty() || m_points.empty() || k == 0 ) return;
+            double dmin, dmax;
+            _distances( m_corner[0], m_length[0], q, dmin, dmax );
+            stack.clear();
+            stack.push_back( CVisit{ dmin, 0, m_corner[0] } );
+            while( !stack.empty() )
+            {
+                const CVisit top = stack.back();
+                stack.pop_back();
+                //the heap is full and the cell farther than its farthest
+                if( found.size() == k && top.distance >= found.front().first ) continue;
+                const CNode & node = m_nodes[top.node];
+                if( node.leaf() )
+                {
+                    for( size_t i = node.begin; i < node.end; i ++ )
+                    {
+                        const double d = _distance2( m_points[i], q );
+                        if( found.size() < k )
+                        {
+                            found.push_back( std::make_pair( d, i ) );
+                            std::push_heap( found.begin(), found.end() );
+                        }
+                        else if( d < found.front().first )
+                        {
+                            std::pop_heap( found.begin(), found.end() );
+                            found.back() = std::make_pair( d, i );
+                            std::push_heap( found.begin(), found.end() );
+                        }
+                    }
+                    continue;
+                }
+                //the children farthest first onto the stack, so that the nearest is taken next, by
+                //insertion as there are at most eight
+                const size_t first = stack.size();
+                const double len = m_length[node.depth + 1];
+                const int children = _popcount( node.child_mask );
+                for( int c = 0; c < children; c ++ )
+                {
+                    CVisit child;
+                    _child( node, c, top.corner, len, child.corner );
+                    _distances( child.corner, len, q, child.distance, dmax );
+                    if( found.size() == k && child.distance >= found.front().first ) continue;
+                    child.node = node.first_child + c;
+                    size_t at = stack.size();
+                    stack.push_back( child );
+                    for( ; at > first && stack[at - 1].distance < child.distance; at -- ) stack[at] = stack[at - 1];
+                    stack[at] = child;
+                }
+            }
+            std::sort_heap( found.begin(), found.end() );
+        };
+
+        /*! _within with the scratch of the caller, appends to found */
+        void _within( const CPoint & q, double r, std::vector<size_t> & found, std::vector<CVisit> & stack ) const
+        {
+            if( m_nodes.empty() || m_points.empty() || !( r >= 0 ) ) return;
+            const double r2 = r * r;
+            stack.clear();
+            stack.push_back( CVisit{ 0, 0, m_corner[0] } );
+            while( !stack.empty() )
+            {
+                const CVisit top = stack.back();
+                stack.pop_back();
+                const CNode & node = m_nodes[top.node];
+                double dmin, dmax;
+                _distances( top.corner, m_length[node.depth], q, dmin, dmax );
+                if( dmin > r2 ) continue;
+                //a cell inside the ball is taken whole
+                if( dmax <= r2 )
+                {
+                    for( size_t i = node.begin; i < node.end; i ++ ) found.push_back( i );
+                    continue;
+                }
+                if( node.leaf() )
+                {
+                    for( size_t i = node.begin; i < node.end; i ++ )
+                        if( _distance2( m_points[i], q ) <= r2 ) found.push_back( i );
+                    continue;
+                }
+                //the children in reverse, so that they come off in Morton order
+                const double len = m_length[node.depth + 1];
+                for( int c = _popcount( node.child_mask ) - 1; c >= 0; c -- )
+                {
+                    CVisit child;
+                    child.distance = 0;
+                    child.node = node.first_child + c;
+                    _child( node, c, top.corner, len, child.corner );
+                    stack.push_back( child );
+                }
+            }
+        };
+
+        //! the low 21 bits of v, two zero bits after each
+        static uint64_t _spread( uint32_t v )
+        {
+            uint64_t x = v & 0x1fffff;
+            x = ( x | x << 32 ) & 0x1f00000000ffffULL;
+            x = ( x | x << 16 ) & 0x1f0000ff0000ffULL;
+            x = ( x | x <<  8 ) & 0x100f00f00f00f00fULL;
+            x = ( x | x <<  4 ) & 0x10c30c30c30c30c3ULL;
+            x = ( x | x <<  2 ) & 0x1249249249249249ULL;
+            return x;
+        };
+
+        static uint32_t _gather( uint64_t x )
+        {
+            x &= 0x1249249249249249ULL;
+            x = ( x | x >>  2 ) & 0x10c30c30c30c30c3ULL;
+            x = ( x | x >>  4 ) & 0x100f00f00f00f00fULL;
+            x = ( x | x >>  8 ) & 0x1f0000ff0000ffULL;
+            x = ( x | x >> 16 ) & 0x1f00000000ffffULL;
+            x = ( x | x >> 32 ) & 0x1fffff;
+            return (uint32_t)x;
+        };
+
+        static int _popcount( unsigned v )
+        {
+            int n = 0;
+            for( ; v; v &= v - 1 ) n ++;
+            return n;
+        };
+
+        /*! the code of the finest cell holding p, false outside the cube, whose far faces are inside */
+        bool _code( const CPoint & p, uint64_t & code ) const
+        {
+            const double cells = (double)( 1 << m_depth );
+            const double scale = cells / ( m_corner[1][0] - m_corner[0][0] );
+            uint32_t c[3];
+            for( int i = 0; i < 3; i ++ )
+            {
+                if( !( p[i] >= m_corner[0][i] && p[i] <= m_corner[1][i] ) ) return false;
+                const double t = std::floor( ( p[i] - m_corner[0][i] ) * scale );
+                c[i] = (uint32_t)std::min( t, cells - 1 );
+            }
+            code = _morton( c[0], c[1], c[2] );
+            return true;
+        };
+
+        CPoint m_corner[2];
+        int m_depth = 0;
+        //! the edge of the cells of every depth
+        double m_length[s_max_depth + 2];
+        std::vector<CPoint>   m_points;
+        std::vector<size_t>   m_indices;
+        std::vector<uint64_t> m_codes;
+        std::vector<CNode>    m_nodes;
+    };
+
+    inline void CLinearOctree::_construct( const std::vector<CPoint> & pts, int n, int threads, size_t leaf_size )
+    {
+        m_depth = std::max( 0, std::min( n, (int)s_max_depth ) );
+        for( int d = 0; d <= s_max_depth + 1; d ++ ) m_length[d] = std::ldexp( m_corner[1][0] - m_corner[0][0], -d );
+
+        //codes in parallel, the points outside sort last and are dropped
+        const uint64_t outside = ~(uint64_t)0;
+        std::vector<std::pair<uint64_t, size_t>> keys( pts.size() );
+        parallel_for( pts.size(), threads, [&]( size_t b, size_t e )
+        {
+            for( size_t i = b; i < e; i ++ )
+            {
+                uint64_t code;
+                keys[i] = std::make_pair( _code( pts[i], code ) ? code : outside, i );
+            }
+        } );
+        parallel_sort( keys.begin(), keys.end(), threads, std::less<std::pair<uint64_t, size_t>>() );
+        size_t count = keys.size();
+        while( count > 0 && keys[count - 1].first == outside ) count --;
+
+        m_points.resize( count );
+        m_indices.resize( count );
+        m_codes.resize( count );
+        parallel_for( count, threads, [&]( size_t b, size_t e )
+        {
+            for( size_t i = b; i < e; i ++ )
+            {
+                m_codes[i]   = keys[i].first;
+                m_indices[i] = keys[i].second;
+                m_points[i]  = pts[keys[i].second];
+            }
+        } );
+        keys = std::vector<std::pair<uint64_t, size_t>>();
+
+        //breadth first, the node array is its own queue, each node splits its range by binary search
+        m_nodes.clear();
+        CNode root = { 0, 0, count, 0, 0, 0 };
+        m_nodes.push_back( root );
+        for( size_t i = 0; i < m_nodes.size(); i ++ )
+        {
+            const CNode node = m_nodes[i];
+            if( node.depth >= m_depth || node.end - node.begin <= std::max<size_t>( leaf_size, 1 ) ) continue;
+
+            const int shift = 3 * ( m_depth - node.depth - 1 );
+            m_nodes[i].first_child = (uint32_t)m_nodes.size();
+            size_t b = node.begin;
+            while( b < node.end )
+            {
+                const uint64_t cell = m_codes[b] >> shift;
+                const size_t e = std::upper_bound( m_codes.begin() + b, m_codes.begin() + node.end, cell,
+                    [shift]( uint64_t c, uint64_t code ) { return c < ( code >> shift ); } ) - m_codes.begin();
+                CNode child = { cell, b, e, 0, 0, (uint8_t)( node.depth + 1 ) };
+                m_nodes[i].child_mask |= (uint8_t)( 1 << ( cell & 7 ) );
+                m_nodes.push_back( child );
+                b = e;
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -1,6 +1,19 @@
 #ifndef  _MEMORY_POOL_H_
 #define  _MEMORY_POOL_H_
 
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <algorithm>
+
+#include "../parser/pages.h"
+
 namespace MeshLib
 {
 
@@ -160,6 +173,329 @@ protected:
     std::vector<T*> m_pool;
 };
 
+/*!
+ *  \brief CConcurrentPool class, fixed size slots shared by many threads
+ *
+ *  Every thread keeps its own free list, no lock is taken while it holds
+ *  slots. A thread running dry takes a batch of s_batch slots from the shared
+ *  list, or carves them from the current slab; one holding twice that many
+ *  gives a batch back. A slot freed by another thread than the one which took
+ *  it simply joins the free list of the thread freeing it.
+ *
+ *  The free slots hold the links, so the elements need no next() or prev().
+ *  Slabs are aligned to align, and are only given back when the pool goes away.
+ */
+class CConcurrentPool
+{
+public:
+    explicit CConcurrentPool( size_t size, size_t align = alignof(std::max_align_t) )
+    {
+        m_align = std::max( align, alignof(void*) );
+        m_slot  = ( std::max( size, sizeof(void*) ) + m_align - 1 ) / m_align * m_align;
+        for( size_t i = 0; i < s_max_threads; i ++ ) m_caches[i] = NULL;
+    };
+
+    ~CConcurrentPool()
+    {
+        for( size_t i = 0; i < s_max_threads; i ++ ) delete m_caches[i].load();
+        for( size_t i = 0; i < m_slabs.size(); i ++ ) CPages::release( m_slabs[i].raw, m_slabs[i].count * m_slot + m_align );
+    };
+
+    CConcurrentPool( const CConcurrentPool & ) = delete;
+    CConcurrentPool & operator=( const CConcurrentPool & ) = delete;
+
+    size_t slot() const { return m_slot; };
+
+    void * allocate()
+    {
+        CCache * c = _cache();
+        if( c == NULL )
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            CCache one;
+            _take( one, 1 );
+            return one.head;
+        }
+        if( c->head == NULL )
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            _take( *c, s_batch );
+        }
+        void * p = c->head;
+        c->head = *(void**)p;
+        c->count --;
+        return p;
+    };
+
+    void release( void * p )
+    {
+        CCache * c = _cache();
+        if( c == NULL )
+        {
+            std::lock_guard<std::mutex> lock( m_lock );
+            CBatch b = { p, 1 };
+            *(void**)p = NULL;
+            m_batches.push_back( b );
+            return;
+        }
+        *(void**)p = c->head;
+        c->head = p;
+        if( ++ c->count >= 2 * s_batch ) _spill( *c );
+    };
+
+    /*! bytes of the slabs and of the free lists of the threads */
+    size_t memory()
+    {
+        std::lock_guard<std::mutex> lock( m_lock );
+        size_t bytes = 0;
+        for( size_t i = 0; i < m_slabs.size(); i ++ ) bytes += m_slabs[i].count * m_slot + m_align;
+        for( size_t i = 0; i < s_max_threads; i ++ ) if( m_caches[i].load() != NULL ) bytes += sizeof( CCache );
+        return bytes;
+    };
+
+    /*! make room for n more slots in one slab */
+    void reserve( size_t n )
+    {
+        std::lock_guard<std::mutex> lock( m_lock );
+        if( (size_t)( m_end - m_next ) / m_slot < n ) _grow( n );
+    };
+
+    /*!
+     *  Forget every slot at once, without destructors. The slabs are kept and
+     *  handed out again. No thread may use the pool meanwhile.
+     */
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock( m_lock );
+        for( size_t i = 0; i < s_max_threads; i ++ )
+        {
+            CCache * c = m_caches[i].load();
+            if( c != NULL ) { c->head = NULL; c->count = 0; }
+        }
+        m_batches.clear();
+        m_current = 0;
+        m_next = m_end = NULL;
+        if( !m_slabs.empty() )
+        {
+            m_next = m_slabs[0].begin;
+            m_end  = m_slabs[0].begin + m_slabs[0].count * m_slot;
+        }
+    };
+
+    //! threads with a free list of their own, the others take the lock every time
+    static const size_t s_max_threads = 128;
+    //! slots moved between a thread and the shared list at once
+    static const size_t s_batch = 256;
+
+protected:
+    struct CCache
+    {
+        void * head = NULL;
+        size_t count = 0;
+        char   pad[64 - sizeof(void*) - sizeof(size_t)];
+    };
+
+    struct CBatch
+    {
+        void * head;
+        size_t count;
+    };
+
+    struct CSlab
+    {
+        void * raw;
+        char * begin;
+        size_t count;
+    };
+
+    /*!
+     *  The index of the calling thread among the live ones, -1 past s_max_threads.
+     *  An index is given back when its thread ends and taken again by the next.
+     */
+    static int _thread()
+    {
+        struct CIndex
+        {
+            int index;
+            CIndex()
+            {
+                std::lock_guard<std::mutex> lock( _indices().lock );
+                std::vector<int> & unused = _indices().unused;
+                if( !unused.empty() ) { index = unused.back(); unused.pop_back(); }
+                else index = _indices().count < (int)s_max_threads ? _indices().count ++ : -1;
+            };
+            ~CIndex()
+            {
+                if( index < 0 ) return;
+                std::lock_guard<std::mutex> lock( _indices().lock );
+                _indices().unused.push_back( index );
+            };
+        };
+        static thread_local CIndex current;
+        return current.index;
+    };
+
+    struct CIndices
+    {
+        std::mutex       lock;
+        std::vector<int> unused;
+        int              count = 0;
+    };
+    static CIndices & _indices()
+    {
+        static CIndices * indices = new CIndices();   //outlives the thread_local indices
+        return *indices;
+    };
+
+    /*! the free list of the calling thread, only ever touched by it */
+    CCache * _cache()
+    {
+        const int i = _thread();
+        if( i < 0 ) return NULL;
+        CCache * c = m_caches[i].load( std::memory_order_acquire );
+        if( c == NULL )
+        {
+            c = new CCache();
+            m_caches[i].store( c, std::memory_order_release );
+        }
+        return c;
+    };
+
+    /*! move n slots to c, a batch given back or fresh ones; the lock is held */
+    void _take( CCache & c, size_t n )
+    {
+        if( !m_batches.empty() && n > 1 )
+        {
+            c.head  = m_batches.back().head;
+            c.count = m_batches.back().count;
+            m_batches.pop_back();
+            return;
+        }
+        if( !m_batches.empty() )
+        {
+            CBatch & b = m_batches.back();
+            c.head = b.head;
+            c.count = 1;
+            b.head = *(void**)b.head;
+            if( -- b.count == 0 ) m_batches.pop_back();
+            return;
+        }
+        for( size_t k = 0; k < n; k ++ )
+        {
+            if( m_next == m_end ) _advance();
+            *(void**)m_next = c.head;
+            c.head = m_next;
+            c.count ++;
+            m_next += m_slot;
+        }
+    };
+
+    /*! give the first s_batch slots of c to the shared list */
+    void _spill( CCache & c )
+    {
+        CBatch b = { c.head, s_batch };
+        void * last = c.head;
+        for( size_t k = 1; k < s_batch; k ++ ) last = *(void**)last;
+        c.head = *(void**)last;
+        c.count -= s_batch;
+        *(void**)last = NULL;
+        std::lock_guard<std::mutex> lock( m_lock );
+        m_batches.push_back( b );
+    };
+
+    /*! carve from the next slab kept by reset(), or a new one */
+    void _advance()
+    {
+        if( m_current + 1 < m_slabs.size() )
+        {
+            m_current ++;
+            m_next = m_slabs[m_current].begin;
+            m_end  = m_next + m_slabs[m_current].count * m_slot;
+            return;
+        }
+        _grow( 0 );
+    };
+
+    /*! a new slab, doubling up to s_max_slab bytes, or of n slots when reserved */
+    void _grow( size_t n )
+    {
+        //the rest of the current slab goes to the shared list as one batch
+        if( m_next != m_end )
+        {
+            CBatch b = { NULL, 0 };
+            for( ; m_next != m_end; m_next += m_slot, b.count ++ )
+            {
+                *(void**)m_next = b.head;
+                b.head = m_next;
+            }
+            m_batches.push_back( b );
+        }
+
+        //copies, std::min and std::max take their arguments by reference
+        const size_t least = s_min_count;
+        const size_t most = s_max_slab / m_slot;
+        size_t count = least << std::min<size_t>( m_slabs.size(), 10 );
+        count = std::max( least, std::min( count, most ) );
+        count = std::max( count, n );
+
+        CSlab slab;
+        //the threads taking the slots fault their pages in, no touch under the lock
+        slab.raw   = CPages::allocate( count * m_slot + m_align, m_slot, false );
+        slab.begin = (char*)( ( (uintptr_t)slab.raw + m_align - 1 ) / m_align * m_align );
+        slab.count = count;
+        m_slabs.push_back( slab );
+        m_current = m_slabs.size() - 1;
+        m_next = slab.begin;
+        m_end  = slab.begin + count * m_slot;
+    };
+
+    static constexpr size_t s_min_count = 1024;
+    static constexpr size_t s_max_slab = 16 << 20;
+
+    size_t                m_slot;
+    size_t                m_align;
+    std::atomic<CCache*>  m_caches[s_max_threads];
+
+    std::mutex            m_lock;          //!< guards the members below
+    std::vector<CBatch>   m_batches;
+    std::vector<CSlab>    m_slabs;
+    size_t                m_current = 0;
+    char *                m_next = NULL;
+    char *                m_end = NULL;
+};
+
+/*!
+ *  \brief CObjectPool class, constructs elements of type T in a CConcurrentPool
+ *
+ *  Unlike CMPool, T needs no links of its own, and create() and destroy() may
+ *  be called from any thread.
+ *  \tparam Align alignment of the elements, raise it for SIMD members
+ */
+template<typename T, size_t Align = alignof(T)>
+class CObjectPool
+{
+public:
+    CObjectPool() : m_pool( sizeof(T), Align ) {};
+
+    template<typename... Args>
+    T * create( Args &&... args ) { return new ( m_pool.allocate() ) T( std::forward<Args>( args )... ); };
+
+    void destroy( T * t )
+    {
+        if( t == NULL ) return;
+        t->~T();
+        m_pool.release( t );
+    };
+
+    void reserve( size_t n ) { m_pool.reserve( n ); };
+
+    /*! drop every element at once, their destructors are not run */
+    void reset() { m_pool.reset(); };
+
+protected:
+    CConcurrentPool m_pool;
+};
+
 }
 
 #endif
@@ -0,0 +1,841 @@
+/*!
+*      \file MeshBoolean.h
+*      \brief Union, intersection and difference of two closed triangle meshes
+*
+*      The pairs of triangles that may meet come from descending the bounding
+*      volume hierarchies of both meshes together, and every pair is tested in
+*      parallel with the exact orientation signs of CPredicates. Two triangles
+*      in general position meet in a segment between two crossings, each an
+*      edge of one mesh through a face of the other, so a crossing is known by
+*      its edge and face and is made once, whichever triangle found it. The
+*      triangles that are cut are split along their segments: the chains of
+*      segments from edge to edge cut the polygon of the triangle in two, from
+*      the order of the crossings along its edges only, the closed loops
+*      inside it are joined to the polygon around them by a bridge, and the
+*      polygons are clipped into ears. Neighbours split their common edge at
+*      the same crossings, so the pieces close up whatever the rounding. The
+*      pieces a mesh falls into between the curves of intersection are kept
+*      or dropped by the winding number of the other mesh at one of their
+*      triangles. A pair whose signs are 0, a vertex on a face or two edges
+*      through each other or coplanar triangles, or a triangle whose crossings
+*      are out of order, is not resolved: the second mesh is moved by a tiny
+*      amount, more every retry, and everything is done again.
+*/
+
+#ifndef _MESHLIB_MESH_BOOLEAN_H_
+#define _MESHLIB_MESH_BOOLEAN_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include "Point.h"
+#include "Point2.h"
+#include "BVH.h"
+#include "Predicates.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshBoolean class, a boolean operation on two closed, oriented triangle meshes
+     *
+     *  The meshes are each expected to be closed and free of self intersections, the faces
+     *  counterclockwise seen from outside. The triangles of the result keep their orientation,
+     *  those of the second mesh inside the first are turned over for the difference.
+     */
+    class CMeshBoolean
+    {
+    public:
+        enum Operation
+        {
+            OP_UNION,          //!< the space inside either mesh
+            OP_INTERSECTION,   //!< the space inside both meshes
+            OP_DIFFERENCE      //!< the space inside the first mesh and outside the second
+        };
+
+        /*!
+         *  Combine two meshes given as flat arrays
+         *  \param a_indices three 0-based points of a_points a triangle, the same for b
+         *  \param threads   number of threads, 0 uses all hardware threads
+         *  \return false if the meshes could not be brought into general position, the result is empty then
+         */
+        bool _compute(const std::vector<CPoint> & a_points, const std::vector<int> & a_indices,
+                      const std::vector<CPoint> & b_points, const std::vector<int> & b_indices, Operation operation, int threads = 0);
+
+        /*! combine two meshes, any CBaseMesh, polygons split into fans around their first corner */
+        template<typename MA, typename MB>
+        bool _combine(MA & a, MB & b, Operation operation, int threads = 0)
+        {
+            std::vector<CPoint> a_points, b_points;
+            std::vector<int> a_indices, b_indices;
+            _arrays(a, a_points, a_indices);
+            _arrays(b, b_points, b_indices);
+            return _compute(a_points, a_indices, b_points, b_indices, operation, threads);
+        }
+
+        /*! build mesh, any empty CBaseMesh, from the triangles of the result */
+        template<typename M>
+        void _build(M & mesh) const
+        {
+            mesh.build_from_arrays(m_result, std::vector<CPoint2>(), std::vector<CPoint>(), m_indices);
+        }
+
+        void clear()
+        {
+            m_points.clear();
+            m_tris.clear();
+            m_keys.clear();
+            m_cuts.clear();
+            m_result.clear();
+            m_indices.clear();
+        }
+
+        const std::vector<CPoint> & points() const { return m_result; }
+        /*! three points a triangle */
+        const std::vector<int> & indices() const { return m_indices; }
+
+        //! how often the second mesh is moved after the first attempt met a degenerate pair
+        static const int s_retries = 6;
+        //! the first move relative to the size of the meshes, ten times more every retry
+        static constexpr double s_perturbation = 1e-12;
+
+    protected:
+        //! a crossing, edge u < v of one mesh through face f of the other
+        struct CKey
+        {
+            uint32_t u, v, f;
+
+            bool operator<(const CKey & k) const
+            {
+                return u != k.u ? u < k.u : v != k.v ? v < k.v : f < k.f;
+            }
+            bool operator==(const CKey & k) const { return u == k.u && v == k.v && f == k.f; }
+        };
+
+        //! a face of either mesh against one of the other, they meet in the segment between two crossings
+        struct CCut
+        {
+            uint32_t face[2];
+            CKey     key[2];
+            uint32_t point[2];      //!< the crossings as points, after the vertices
+        };
+
+        //! the projection of a cut triangle to the plane of two axes, counterclockwise
+        struct CPlane
+        {
+            int    u, v;
+            double sign;
+        };
+
+        template<typename M>
+        static void _arrays(M & mesh, std::vector<CPoint> & points, std::vector<int> & indices)
+        {
+            std::unordered_map<const void *, int> vindex;
+            vindex.reserve(mesh.num_vertices());
+            for (auto * v : mesh.vertices())
+            {
+                vindex[v] = (int)points.size();
+                points.push_back(v->point());
+            }
+            for (auto * pf : mesh.faces())
+            {
+                auto * first = pf->halfedge();
+                auto * he = first->next();
+                while (he->next() != first)
+                {
+                    indices.push_back(vindex[first->vertex()]);
+                    indices.push_back(vindex[he->vertex()]);
+                    indices.push_back(vindex[he->next()->vertex()]);
+                    he = he->next();
+                }
+            }
+        }
+
+        /*! one attempt on the points as they are, false if it met a degeneracy */
+        bool _attempt(Operation operation, int threads);
+
+        /*! whether faces a and b cross, 1 with the crossings in cut, 0 if they do not, -1 for a degenerate pair */
+        int _cut(uint32_t a, uint32_t b, CCut & cut) const;
+        /*! whether the segment p, q, whose ends are on either side of the plane of x, y, z, goes through the triangle, -1 through its boundary */
+        static int _through(const CPoint & p, const CPoint & q, const CPoint & x, const CPoint & y, const CPoint & z);
+
+        /*! the pieces of face t along the segments of the cuts c[0..n), onto tris, false if they are not consistent */
+        bool _split(uint32_t t, const uint32_t * c, size_t n, std::vector<uint32_t> & tris) const;
+        /*! join the hole, clockwise, to the polygon around it, false if no vertex of the polygon sees one of the hole */
+        bool _bridge(std::vector<uint32_t> & polygon, const std::vector<uint32_t> & hole, const CPlane & plane) const;
+        /*! the ears of a polygon, counterclockwise in plane, onto tris */
+        void _ears(const std::vector<uint32_t> & polygon, const CPlane & plane, std::vector<uint32_t> & tris) const;
+
+        /*! whether the polygon holds point p, by the crossings of a ray */
+        bool _inside(const std::vector<uint32_t> & polygon, const CPlane & plane, double x, double y) const;
+
+        double _x(uint32_t i, const CPlane & p) const { return m_points[i][p.u]; }
+        double _y(uint32_t i, const CPlane & p) const { return m_points[i][p.v] * p.sign; }
+        double _orient(uint32_t a, uint32_t b, uint32_t c, const CPlane & p) const
+        {
+            return CPredicates::orient2d(_x(a, p), _y(a, p), _x(b, p), _y(b, p), _x(c, p), _y(c, p));
+        }
+
+        static uint64_t _edge(uint32_t a, uint32_t b)
+        {
+            return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+        }
+        static uint64_t _mix(uint64_t x)
+        {
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        //! the vertices of both meshes, a then b, and then the crossings
+        std::vector<CPoint>   m_points;
+        //! three vertices a face, those of a then those of b
+        std::vector<uint32_t> m_tris;
+        size_t                m_vertices[2];
+        size_t                m_faces[2];
+        std::vector<CKey>     m_keys;
+        std::vector<CCut>     m_cuts;
+
+        std::vector<CPoint>   m_result;
+        std::vector<int>      m_indices;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CMeshBoolean::_compute(const std::vector<CPoint> & a_points, const std::vector<int> & a_indices,
+                                       const std::vector<CPoint> & b_points, const std::vector<int> & b_indices, Operation operation, int threads)
+    {
+        clear();
+        m_vertices[0] = a_points.size();
+        m_vertices[1] = b_points.size();
+        m_faces[0] = a_indices.size() / 3;
+        m_faces[1] = b_indices.size() / 3;
+        const size_t vertices = m_vertices[0] + m_vertices[1];
+        m_tris.resize(3 * (m_faces[0] + m_faces[1]));
+        for (size_t i = 0; i < 3 * m_faces[0]; i++) m_tris[i] = (uint32_t)a_indices[i];
+        for (size_t i = 0; i < 3 * m_faces[1]; i++) m_tris[3 * m_faces[0] + i] = (uint32_t)(m_vertices[0] + b_indices[i]);
+
+        double size = 0;
+        CPoint lo(DBL_MAX, DBL_MAX, DBL_MAX), hi(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+        for (const std::vector<CPoint> * points : { &a_points, &b_points })
+        {
+            for (const CPoint & p : *points)
+            {
+                for (int a = 0; a < 3; a++)
+                {
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+            }
+        }
+        for (int a = 0; a < 3 && vertices > 0; a++) size = std::max(size, hi[a] - lo[a]);
+
+        double move = s_perturbation * size;
+        for (int attempt = 0; attempt <= s_retries; attempt++)
+        {
+            m_points.assign(a_points.begin(), a_points.end());
+            m_points.insert(m_points.end(), b_points.begin(), b_points.end());
+            if (attempt > 0)
+            {
+                //the same moves every run, a vertex at a time
+                for (size_t i = 0; i < m_vertices[1]; i++)
+                {
+                    for (int a = 0; a < 3; a++)
+                    {
+                        const double r = (_mix(((uint64_t)attempt << 40) + 3 * i + a) >> 11) * (1.0 / 9007199254740992.0);
+                        m_points[m_vertices[0] + i][a] += (2 * r - 1) * move;
+                    }
+                }
+                move *= 10;
+                MESHLIB_COUNTER_ADD("mesh_boolean.retries", 1);
+            }
+            if (_attempt(operation, threads))
+            {
+                m_points = std::vector<CPoint>();
+                m_tris = std::vector<uint32_t>();
+                m_keys = std::vector<CKey>();
+                m_cuts = std::vector<CCut>();
+                return true;
+            }
+        }
+        clear();
+        return false;
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    One attempt. The candidate pairs are tested, the crossings sorted by their keys and made points, and the faces with cuts split, each
+    on its own. The faces of the result, those not cut and the pieces of those cut, are joined across their edges into the parts of the
+    meshes between the curves of intersection, never across a segment. Every part is kept or dropped by the winding number of the other
+    mesh at the center of its largest triangle, above one half is inside
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline bool CMeshBoolean::_attempt(Operation operation, int threads)
+    {
+        const size_t vertices = m_vertices[0] + m_vertices[1];
+        const size_t faces = m_faces[0] + m_faces[1];
+        m_points.resize(vertices);
+        m_keys.clear();
+        m_cuts.clear();
+
+        CBVH trees[2];
+        for (int s = 0; s < 2; s++)
+        {
+            const uint32_t * tris = m_tris.data() + 3 * (s ? m_faces[0] : 0);
+            trees[s]._construct(m_faces[s], [&](size_t t, int k) { return m_points[tris[3 * t + k]]; }, threads);
+        }
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        trees[0]._overlaps(trees[1], pairs, threads);
+        MESHLIB_COUNTER_ADD("mesh_boolean.candidates", pairs.size());
+
+        //the pairs that cross
+        std::atomic<bool> degenerate(false);
+        std::vector<CCut> cuts(pairs.size());
+        std::vector<char> crossing(pairs.size(), 0);
+        parallel_for(pairs.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e && !degenerate; i++)
+            {
+                const int r = _cut(pairs[i].first, (uint32_t)(m_faces[0] + pairs[i].second), cuts[i]);
+                if (r < 0) degenerate = true;
+                crossing[i] = r > 0;
+            }
+        }, 1 << 10);
+        if (degenerate) return false;
+        for (size_t i = 0; i < pairs.size(); i++) if (crossing[i]) m_cuts.push_back(cuts[i]);
+        cuts = std::vector<CCut>();
+        pairs = std::vector<std::pair<uint32_t, uint32_t>>();
+        MESHLIB_COUNTER_ADD("mesh_boolean.cuts", m_cuts.size());
+
+        //a point for every crossing, made from its edge and face, whichever pair found it
+        m_keys.resize(2 * m_cuts.size());
+        for (size_t i = 0; i < m_cuts.size(); i++)
+        {
+            m_keys[2 * i] = m_cuts[i].key[0];
+            m_keys[2 * i + 1] = m_cuts[i].key[1];
+        }
+        parallel_sort(m_keys.begin(), m_keys.end(), threads, [](const CKey & a, const CKey & b) { return a < b; });
+        m_keys.erase(std::unique(m_keys.begin(), m_keys.end()), m_keys.end());
+        m_points.resize(vertices + m_keys.size());
+        parallel_for(m_keys.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const CKey & k = m_keys[i];
+                const uint32_t * f = &m_tris[3 * k.f];
+                const CPoint & p = m_points[k.u], & q = m_points[k.v];
+                const double dp = CPredicates::orient3d(m_points[f[0]], m_points[f[1]], m_points[f[2]], p);
+                const double dq = CPredicates::orient3d(m_points[f[0]], m_points[f[1]], m_points[f[2]], q);
+                const double t = std::min(std::max(dp / (dp - dq), 0.0), 1.0);
+                m_points[vertices + i] = p + (q - p) * t;
+            }
+        });
+        parallel_for(m_cuts.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                for (int k = 0; k < 2; k++)
+                {
+                    m_cuts[i].point[k] = (uint32_t)(vertices + (std::lower_bound(m_keys.begin(), m_keys.end(), m_cuts[i].key[k]) - m_keys.begin()));
+                }
+            }
+        });
+
+        //the cuts of every face, the faces split in parallel
+        std::vector<std::pair<uint32_t, uint32_t>> by_face(2 * m_cuts.size());
+        for (size_t i = 0; i < m_cuts.size(); i++)
+        {
+            by_face[2 * i] = std::make_pair(m_cuts[i].face[0], (uint32_t)i);
+            by_face[2 * i + 1] = std::make_pair(m_cuts[i].face[1], (uint32_t)i);
+        }
+        parallel_sort(by_face.begin(), by_face.end(), threads, [](const std::pair<uint32_t, uint32_t> & a, const std::pair<uint32_t, uint32_t> & b) { return a < b; });
+        std::vector<size_t> runs;
+        std::vector<uint32_t> cut_of(by_face.size());
+        for (size_t i = 0; i < by_face.size(); i++)
+        {
+            if (i == 0 || by_face[i].first != by_face[i - 1].first) runs.push_back(i);
+            cut_of[i] = by_face[i].second;
+        }
+        runs.push_back(by_face.size());
+        std::vector<std::vector<uint32_t>> pieces(runs.size() - 1);
+        std::atomic<bool> failed(false);
+        parallel_for(pieces.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t r = b; r < e && !failed; r++)
+            {
+                if (!_split(by_face[runs[r]].first, &cut_of[runs[r]], runs[r + 1] - runs[r], pieces[r])) failed = true;
+            }
+        }, 16);
+        if (failed) return false;
+
+        //the faces of the result, in the order of the faces they come from
+        std::vector<uint32_t> tris;
+        size_t side[2] = { 0, 0 };
+        for (size_t f = 0, r = 0; f < faces; f++)
+        {
+            if (f == m_faces[0]) side[0] = tris.size() / 3;
+            if (r < pieces.size() && by_face[runs[r]].first == f)
+            {
+                tris.insert(tris.end(), pieces[r].begin(), pieces[r].end());
+                pieces[r] = std::vector<uint32_t>();
+                r++;
+            }
+            else tris.insert(tris.end(), &m_tris[3 * f], &m_tris[3 * f] + 3);
+        }
+        const size_t count = tris.size() / 3;
+        side[1] = count;
+        if (m_faces[0] == faces) side[0] = count;
+
+        //the parts, faces joined across edges that are not segments
+        std::vector<uint64_t> segments(m_cuts.size());
+        for (size_t i = 0; i < m_cuts.size(); i++) segments[i] = _edge(m_cuts[i].point[0], m_cuts[i].point[1]);
+        std::sort(segments.begin(), segments.end());
+        std::vector<std::pair<uint64_t, uint32_t>> edges(3 * count);
+        parallel_for(count, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                for (int k = 0; k < 3; k++) edges[3 * t + k] = std::make_pair(_edge(tris[3 * t + k], tris[3 * t + (k + 1) % 3]), (uint32_t)t);
+            }
+        });
+        parallel_sort(edges.begin(), edges.end(), threads, [](const std::pair<uint64_t, uint32_t> & a, const std::pair<uint64_t, uint32_t> & b) { return a < b; });
+        std::vector<uint32_t> parent(count);
+        for (size_t t = 0; t < count; t++) parent[t] = (uint32_t)t;
+        auto root = [&](uint32_t t)
+        {
+            while (parent[t] != t) t = parent[t] = parent[parent[t]];
+            return t;
+        };
+        for (size_t i = 0, j; i < edges.size(); i = j)
+        {
+            for (j = i + 1; j < edges.size() && edges[j].first == edges[i].first; j++) {}
+            if (std::binary_search(segments.begin(), segments.end(), edges[i].first)) continue;
+            for (size_t k = i + 1; k < j; k++)
+            {
+                //faces of a and b share no edge but a segment, the ids of the faces of a come first
+                if ((edges[k - 1].second < side[0]) != (edges[k].second < side[0])) continue;
+                const uint32_t x = root(edges[k - 1].second), y = root(edges[k].second);
+                if (x != y) parent[std::max(x, y)] = std::min(x, y);
+            }
+        }
+        edges = std::vector<std::pair<uint64_t, uint32_t>>();
+
+        std::vector<uint32_t> part(count);
+        std::vector<uint32_t> largest;
+        std::vector<double> area;
+        for (size_t t = 0; t < count; t++)
+        {
+            const uint32_t r = root((uint32_t)t);
+            const uint32_t * v = &tris[3 * t];
+            const double a = ((m_points[v[1]] - m_points[v[0]]) ^ (m_points[v[2]] - m_points[v[0]])).norm();
+            if (r == t)
+            {
+                part[t] = (uint32_t)largest.size();
+                largest.push_back((uint32_t)t);
+                area.push_back(a);
+            }
+            else
+            {
+                part[t] = part[r];
+                if (a > area[part[t]])
+                {
+                    area[part[t]] = a;
+                    largest[part[t]] = (uint32_t)t;
+                }
+            }
+        }
+        MESHLIB_COUNTER_ADD("mesh_boolean.parts", largest.size());
+
+        //the winding numbers of the other mesh, summed over its faces in parallel
+        const size_t parts = largest.size();
+        std::vector<CPoint> centers(parts);
+        std::vector<int> part_side(parts);
+        for (size_t p = 0; p < parts; p++)
+        {
+            const uint32_t * v = &tris[3 * largest[p]];
+            centers[p] = (m_points[v[0]] + m_points[v[1]] + m_points[v[2]]) / 3.0;
+            part_side[p] = largest[p] < side[0] ? 0 : 1;
+        }
+        const std::vector<double> winding = parallel_reduce(faces, threads, std::vector<double>(parts, 0.0),
+            [&](size_t b, size_t e, std::vector<double> & acc)
+        {
+            for (size_t f = b; f < e; f++)
+            {
+                const int s = f < m_faces[0] ? 0 : 1;
+                const uint32_t * v = &m_tris[3 * f];
+                for (size_t p = 0; p < parts; p++)
+                {
+                    if (part_side[p] == s) continue;
+                    const CPoint x = m_points[v[0]] - centers[p], y = m_points[v[1]] - centers[p], z = m_points[v[2]] - centers[p];
+                    const double lx = x.norm(), ly = y.norm(), lz = z.norm();
+                    const double det = x * (y ^ z);
+                    const double dot = lx * ly * lz + (x * y) * lz + (y * z) * lx + (z * x) * ly;
+                    acc[p] += 2 * std::atan2(det, dot);
+                }
+            }
+        },
+            [](const std::vector<double> & a, const std::vector<double> & b)
+        {
+            std::vector<double> r = a;
+            for (size_t p = 0; p < r.size(); p++) r[p] += b[p];
+            return r;
+        }, 1 << 12);
+
+        //a part of a is kept outside b for the union and the difference, inside for the intersection, a part of b
+        //outside a for the union only, and turned over for the difference
+        std::vector<char> keep(parts);
+        for (size_t p = 0; p < parts; p++)
+        {
+            const bool inside = winding[p] / (4 * M_PI) > 0.5;
+            keep[p] = part_side[p] == 0 ? inside == (operation == OP_INTERSECTION) : inside == (operation != OP_UNION);
+        }
+        std::vector<int> index(m_points.size(), -1);
+        for (size_t t = 0; t < count; t++)
+        {
+            if (!keep[part[t]]) continue;
+            const bool turn = operation == OP_DIFFERENCE && t >= side[0];
+            for (int k = 0; k < 3; k++)
+            {
+                const uint32_t v = tris[3 * t + (turn ? 2 - k : k)];
+                if (index[v] < 0)
+                {
+                    index[v] = (int)m_result.size();
+                    m_result.push_back(m_points[v]);
+                }
+                m_indices.push_back(index[v]);
+            }
+        }
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline int CMeshBoolean::_cut(uint32_t a, uint32_t b, CCut & cut) const
+    {
+        const uint32_t face[2] = { a, b };
+        const uint32_t * v[2] = { &m_tris[3 * a], &m_tris[3 * b] };
+
+        //the vertices of each face against the plane of the other
+        double side[2][3];
+        for (int s = 0; s < 2; s++)
+        {
+            const uint32_t * p = v[s], * q = v[1 - s];
+            int positive = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                side[1 - s][k] = CPredicates::orient3d(m_points[p[0]], m_points[p[1]], m_points[p[2]], m_points[q[k]]);
+                if (side[1 - s][k] == 0) return -1;
+                positive += side[1 - s][k] > 0;
+            }
+            if (positive == 0 || positive == 3) return 0;
+        }
+
+        //the edges of each face through the other
+        int found = 0;
+        for (int s = 0; s < 2; s++)
+        {
+            const uint32_t * p = v[s], * q = v[1 - s];
+            for (int k = 0; k < 3; k++)
+            {
+                if ((side[s][k] > 0) == (side[s][(k + 1) % 3] > 0)) continue;
+                const uint32_t x = std::min(p[k], p[(k + 1) % 3]), y = std::max(p[k], p[(k + 1) % 3]);
+                const int r = _through(m_points[x], m_points[y], m_points[q[0]], m_points[q[1]], m_points[q[2]]);
+                if (r < 0 || (r > 0 && found == 2)) return -1;
+                if (r == 0) continue;
+                cut.key[found].u = x;
+                cut.key[found].v = y;
+                cut.key[found].f = face[1 - s];
+                found++;
+            }
+        }
+        if (found == 1) return -1;
+        cut.face[0] = a;
+        cut.face[1] = b;
+        return found == 2 ? 1 : 0;
+    }
+
+    inline int CMeshBoolean::_through(const CPoint & p, const CPoint & q, const CPoint & x, const CPoint & y, const CPoint & z)
+    {
+        const double s[3] = { CPredicates::orient3d(p, q, x, y), CPredicates::orient3d(p, q, y, z), CPredicates::orient3d(p, q, z, x) };
+        const bool positive = s[0] > 0 || s[1] > 0 || s[2] > 0, negative = s[0] < 0 || s[1] < 0 || s[2] < 0;
+        if (positive && negative) return 0;
+        return s[0] != 0 && s[1] != 0 && s[2] != 0 ? 1 : -1;
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    A cut face is split without asking where its crossings are. The polygon starts as the face with the crossings of its edges in the
+    order along them, the same order the neighbour across the edge uses. A crossing on an edge ends one segment, a crossing inside two,
+    so the segments make chains from edge to edge and closed loops. A chain cuts the polygon holding both of its ends in two, and only
+    the order of the ends in it says which side the other chains are on. A chain whose ends are not in one polygon crosses another one,
+    which the rounding of nearby crossings can do, and the attempt is given up. The loops are placed by a point in polygon test, the
+    largest first so a loop inside another one is placed into the polygon of the other, and each becomes a polygon and a hole
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline bool CMeshBoolean::_split(uint32_t t, const uint32_t * c, size_t n, std::vector<uint32_t> & tris) const
+    {
+        const uint32_t * corner = &m_tris[3 * t];
+        const size_t vertices = m_vertices[0] + m_vertices[1];
+        CPlane plane;
+        const CPoint normal = (m_points[corner[1]] - m_points[corner[0]]) ^ (m_points[corner[2]] - m_points[corner[0]]);
+        int axis = 0;
+        for (int a = 1; a < 3; a++) if (std::fabs(normal[a]) > std::fabs(normal[axis])) axis = a;
+        plane.u = (axis + 1) % 3;
+        plane.v = (axis + 2) % 3;
+        plane.sign = normal[axis] < 0 ? -1 : 1;
+
+        //the crossings and the up to two crossings joined to each
+        std::vector<uint32_t> nodes;
+        nodes.reserve(2 * n);
+        for (size_t i = 0; i < n; i++)
+        {
+            nodes.push_back(m_cuts[c[i]].point[0]);
+            nodes.push_back(m_cuts[c[i]].point[1]);
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        const size_t m = nodes.size();
+        auto local = [&](uint32_t id) { return (int)(std::lower_bound(nodes.begin(), nodes.end(), id) - nodes.begin()); };
+        std::vector<int> degree(m, 0), link(2 * m, -1);
+        for (size_t i = 0; i < n; i++)
+        {
+            const int p = local(m_cuts[c[i]].point[0]), q = local(m_cuts[c[i]].point[1]);
+            if (degree[p] == 2 || degree[q] == 2) return false;
+            link[2 * p + degree[p]++] = q;
+            link[2 * q + degree[q]++] = p;
+        }
+
+        //the face with the crossings of its edges
+        std::vector<uint32_t> ring;
+        std::vector<char> edge(m, 0);
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t a = corner[k], b = corner[(k + 1) % 3];
+            const uint32_t lo = std::min(a, b), hi = std::max(a, b);
+            const CPoint d = m_points[hi] - m_points[lo];
+            std::vector<std::pair<double, uint32_t>> on;
+            for (size_t i = 0; i < m; i++)
+            {
+                const CKey & key = m_keys[nodes[i] - vertices];
+                if (key.u != lo || key.v != hi) continue;
+                if (degree[i] != 1) return false;
+                edge[i] = 1;
+                on.push_back(std::make_pair((m_points[nodes[i]] - m_points[lo]) * d, nodes[i]));
+            }
+            std::sort(on.begin(), on.end());
+            if (a != lo) std::reverse(on.begin(), on.end());
+            ring.push_back(a);
+            for (const std::pair<double, uint32_t> & o : on) ring.push_back(o.second);
+        }
+
+        //a chain from the crossing i to the next one on an edge or back to i, false if it ends inside
+        std::vector<char> seen(m, 0);
+        auto walk = [&](int i, std::vector<uint32_t> & chain)
+        {
+            chain.assign(1, nodes[i]);
+            seen[i] = 1;
+            int previous = -1, at = i;
+            while (true)
+            {
+                int next = -1;
+                for (int s = 0; s < degree[at] && next < 0; s++) if (link[2 * at + s] != previous) next = link[2 * at + s];
+                if (next < 0) return false;
+                if (next == i) return true;
+                previous = at;
+                at = next;
+                seen[at] = 1;
+                chain.push_back(nodes[at]);
+                if (edge[at]) return true;
+            }
+        };
+
+        std::vector<std::vector<uint32_t>> polygons(1, ring);
+        std::vector<uint32_t> chain;
+        for (size_t i = 0; i < m; i++)
+        {
+            //a chain that ends inside comes from an open mesh and is left out
+            if (!edge[i] || seen[i] || !walk((int)i, chain)) continue;
+            size_t p = 0, a = 0, b = 0;
+            for (; p < polygons.size(); p++)
+            {
+                const std::vector<uint32_t> & polygon = polygons[p];
+                a = std::find(polygon.begin(), polygon.end(), chain.front()) - polygon.begin();
+                if (a < polygon.size()) break;
+            }
+            if (p == polygons.size()) return false;
+            std::vector<uint32_t> & polygon = polygons[p];
+            b = std::find(polygon.begin(), polygon.end(), chain.back()) - polygon.begin();
+            if (b == polygon.size()) return false;
+            std::vector<uint32_t> first, second;
+            for (size_t k = a; ; k = (k + 1) % polygon.size())
+            {
+                first.push_back(polygon[k]);
+                if (k == b) break;
+            }
+            first.insert(first.end(), chain.rbegin() + 1, chain.rend() - 1);
+            for (size_t k = b; ; k = (k + 1) % polygon.size())
+            {
+                second.push_back(polygon[k]);
+                if (k == a) break;
+            }
+            second.insert(second.end(), chain.begin() + 1, chain.end() - 1);
+            polygon.swap(first);
+            polygons.push_back(second);
+        }
+
+        std::vector<std::pair<double, std::vector<uint32_t>>> loops;
+        for (size_t i = 0; i < m; i++)
+        {
+            if (seen[i]) continue;
+            if (degree[i] == 2 && walk((int)i, chain) && !edge[local(chain.back())])
+            {
+                double area = 0;
+                for (size_t k = 0; k < chain.size(); k++)
+                {
+                    const uint32_t p = chain[k], q = chain[(k + 1) % chain.size()];
+                    area += _x(p, plane) * _y(q, plane) - _x(q, plane) * _y(p, plane);
+                }
+                if (area < 0) std::reverse(chain.begin(), chain.end());
+                loops.push_back(std::make_pair(std::fabs(area), chain));
+            }
+        }
+        std::sort(loops.begin(), loops.end(), [](const std::pair<double, std::vector<uint32_t>> & a, const std::pair<double, std::vector<uint32_t>> & b)
+        {
+            return a.first > b.first;
+        });
+        for (const std::pair<double, std::vector<uint32_t>> & loop : loops)
+        {
+            const double x = _x(loop.second[0], plane), y = _y(loop.second[0], plane);
+            size_t p = 0;
+            while (p < polygons.size() && !_inside(polygons[p], plane, x, y)) p++;
+            if (p == polygons.size()) return false;
+            const std::vector<uint32_t> hole(loop.second.rbegin(), loop.second.rend());
+            if (!_bridge(polygons[p], hole, plane)) return false;
+            polygons.push_back(loop.second);
+        }
+
+        for (const std::vector<uint32_t> & polygon : polygons) _ears(polygon, plane, tris);
+        return true;
+    }
+
+    inline bool CMeshBoolean::_inside(const std::vector<uint32_t> & polygon, const CPlane & plane, double x, double y) const
+    {
+        bool inside = false;
+        for (size_t k = 0, j = polygon.size() - 1; k < polygon.size(); j = k++)
+        {
+            const double xk = _x(polygon[k], plane), yk = _y(polygon[k], plane);
+            const double xj = _x(polygon[j], plane), yj = _y(polygon[j], plane);
+            if ((yk > y) != (yj > y) && x < xj + (y - yj) * (xk - xj) / (yk - yj)) inside = !inside;
+        }
+        return inside;
+    }
+
+    inline bool CMeshBoolean::_bridge(std::vector<uint32_t> & polygon, const std::vector<uint32_t> & hole, const CPlane & plane) const
+    {
+        //whether a, b and c, d cross other than at a common end
+        auto cross = [&](uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+        {
+            if (a == c || a == d || b == c || b == d) return false;
+            const double s = _orient(a, b, c, plane), t = _orient(a, b, d, plane);
+            if ((s > 0 && t > 0) || (s < 0 && t < 0)) return false;
+            const double u = _orient(c, d, a, plane), v = _orient(c, d, b, plane);
+            return !((u > 0 && v > 0) || (u < 0 && v < 0));
+        };
+
+        //from the vertices of the hole right to left, to the nearest vertex of the polygon it sees
+        std::vector<size_t> from(hole.size()), to(polygon.size());
+        for (size_t k = 0; k < hole.size(); k++) from[k] = k;
+        for (size_t k = 0; k < polygon.size(); k++) to[k] = k;
+        std::sort(from.begin(), from.end(), [&](size_t a, size_t b) { return _x(hole[a], plane) > _x(hole[b], plane); });
+        for (size_t h : from)
+        {
+            const CPoint & p = m_points[hole[h]];
+            auto distance = [&](size_t k)
+            {
+                const CPoint d = m_points[polygon[k]] - p;
+                return d * d;
+            };
+            std::sort(to.begin(), to.end(), [&](size_t a, size_t b) { return distance(a) < distance(b); });
+            for (size_t j : to)
+            {
+                bool sees = true;
+                for (size_t k = 0; k < polygon.size() && sees; k++) sees = !cross(hole[h], polygon[j], polygon[k], polygon[(k + 1) % polygon.size()]);
+                for (size_t k = 0; k < hole.size() && sees; k++) sees = !cross(hole[h], polygon[j], hole[k], hole[(k + 1) % hole.size()]);
+                if (!sees) continue;
+                std::vector<uint32_t> joined(polygon.begin(), polygon.begin() + j + 1);
+                for (size_t k = 0; k <= hole.size(); k++) joined.push_back(hole[(h + k) % hole.size()]);
+                joined.insert(joined.end(), polygon.begin() + j, polygon.end());
+                polygon.swap(joined);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CMeshBoolean::_ears(const std::vector<uint32_t> & polygon, const CPlane & plane, std::vector<uint32_t> & tris) const
+    {
+        const int n = (int)polygon.size();
+        if (n < 3) return;
+        std::vector<int> previous(n), next(n);
+        std::vector<char> reflex(n, 0);
+        std::vector<int> reflexes;
+        for (int k = 0; k < n; k++)
+        {
+            previous[k] = (k + n - 1) % n;
+            next[k] = (k + 1) % n;
+        }
+        auto orient = [&](int a, int b, int c) { return _orient(polygon[a], polygon[b], polygon[c], plane); };
+        for (int k = 0; k < n; k++)
+        {
+            reflex[k] = orient(previous[k], k, next[k]) <= 0;
+            if (reflex[k]) reflexes.push_back(k);
+        }
+
+        //only a reflex vertex can be in an ear, and a vertex turns convex but never back
+        int left = n, i = 0, tried = 0;
+        while (left > 3)
+        {
+            const int a = previous[i], c = next[i];
+            bool ear = !reflex[i];
+            for (size_t r = 0; r < reflexes.size() && ear; r++)
+            {
+                const int q = reflexes[r];
+                if (!reflex[q] || q == a || q == i || q == c) continue;
+                if (polygon[q] == polygon[a] || polygon[q] == polygon[i] || polygon[q] == polygon[c]) continue;
+                ear = !(orient(a, i, q) >= 0 && orient(i, c, q) >= 0 && orient(c, a, q) >= 0);
+            }
+            if (!ear && tried < left)
+            {
+                tried++;
+                i = c;
+                continue;
+            }
+            //with no ear left the rest is degenerate, and is clipped all the same
+            if (!ear) MESHLIB_COUNTER_ADD("mesh_boolean.forced_ears", 1);
+            tris.push_back(polygon[a]);
+            tris.push_back(polygon[i]);
+            tris.push_back(polygon[c]);
+            next[a] = c;
+            previous[c] = a;
+            reflex[i] = 0;
+            left--;
+            tried = 0;
+            if (reflex[a]) reflex[a] = orient(previous[a], a, c) <= 0;
+            if (reflex[c]) reflex[c] = orient(a, c, next[c]) <= 0;
+            i = a;
+        }
+        tris.push_back(polygon[previous[i]]);
+        tris.push_back(polygon[i]);
+        tris.push_back(polygon[next[i]]);
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,541 @@
+/*!
+*      \file MeshSimplifier.h
+*      \brief Edge collapse simplification of an indexed triangle list
+*
+*      Half edge collapses ordered by quadric error (Garland and Heckbert,
+*      Surface Simplification Using Quadric Error Metrics, 1997). A collapse
+*      moves a vertex onto a neighbor, so every level of detail is a triangle
+*      list over a subset of the input vertices and all levels can share one
+*      vertex buffer.
+*
+*      Every vertex that may move holds its cheapest collapse in a mutable
+*      binary heap, updated in place when a neighbor changes. Whether the
+*      collapse keeps the mesh valid is only checked once it comes to the
+*      top; if not, the vertex is evaluated again with the check.
+*/
+
+#ifndef _MESHLIB_MESH_SIMPLIFIER_H_
+#define _MESHLIB_MESH_SIMPLIFIER_H_
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshSimplifier class
+     *
+     *  simplify() may be called with decreasing targets, each call goes on from
+     *  the previous result, which is how a chain of levels is built. Vertices on
+     *  a border, the uv seams of a welded mesh included, and on non manifold
+     *  edges stay in place, so the levels keep their outline and do not crack
+     *  along the seams.
+     */
+    class CMeshSimplifier
+    {
+    public:
+        /*!
+         *  \param indices   three vertex indices per triangle
+         *  \param n         number of indices
+         *  \param positions 3 floats per vertex
+         *  \param nv        number of vertices
+         *  \param threads   number of threads for the setup, 0 uses all hardware threads
+         */
+        CMeshSimplifier(const uint32_t * indices, size_t n, const float * positions, size_t nv, int threads = 0)
+            : m_indices(indices, indices + n / 3 * 3), m_positions(positions)
+        {
+            const size_t nt = n / 3;
+            m_dead.assign(nt, 0);
+            for (size_t t = 0; t < nt; t++)
+            {
+                const uint32_t * c = &m_indices[3 * t];
+                if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0]) m_dead[t] = 1;
+                else m_alive++;
+            }
+
+            // triangles of every vertex
+            m_begin.assign(nv + 1, 0);
+            m_size.assign(nv, 0);
+            for (size_t t = 0; t < nt; t++)
+            {
+                if (m_dead[t]) continue;
+                for (int c = 0; c < 3; c++) m_begin[m_indices[3 * t + c] + 1]++;
+            }
+            for (size_t v = 0; v < nv; v++) m_begin[v + 1] += m_begin[v];
+            m_capacity.resize(nv);
+            for (size_t v = 0; v < nv; v++) m_capacity[v] = m_begin[v + 1] - m_begin[v];
+            m_adjacency.resize(m_begin[nv]);
+            m_begin.pop_back();
+            for (size_t t = 0; t < nt; t++)
+            {
+                if (m_dead[t]) continue;
+                for (int c = 0; c < 3; c++)
+                {
+                    uint32_t v = m_indices[3 * t + c];
+                    m_adjacency[m_begin[v] + m_size[v]++] = (uint32_t)t;
+                }
+            }
+
+            // quadric of every vertex from the planes of its triangles, and the vertices that stay
+            m_quadrics.resize(nv);
+            m_locked.assign(nv, 0);
+            m_initial = m_alive;
+            parallel_for(nv, threads, [&](size_t b, size_t e)
+            {
+                std::vector<uint32_t> ring;
+                for (size_t v = b; v < e; v++)
+                {
+                    const uint32_t * a = &m_adjacency[m_begin[v]];
+                    for (uint32_t k = 0; k < m_size[v]; k++) m_quadrics[v].add_plane(_corners(a[k]), m_positions);
+
+                    // every edge of an interior manifold vertex is in exactly two of its triangles
+                    ring.clear();
+                    for (uint32_t k = 0; k < m_size[v]; k++)
+                    {
+                        const uint32_t * c = _corners(a[k]);
+                        for (int i = 0; i < 3; i++)
+                        {
+                            if (c[i] != v) ring.push_back(c[i]);
+                        }
+                    }
+                    std::sort(ring.begin(), ring.end());
+                    for (size_t i = 0; i < ring.size();)
+                    {
+                        size_t j = i;
+                        while (j < ring.size() && ring[j] == ring[i]) j++;
+                        if (j - i != 2) m_locked[v] = 1;
+                        i = j;
+                    }
+                }
+            }, 1 << 12);
+        }
+
+        /*! triangles left */
+        size_t size() const { return m_alive; }
+
+        /*! root mean square distance to the original planes of the worst collapse so far */
+        float error() const { return (float)std::sqrt(m_error); }
+
+        /*! the collapses so far in order, each moving the first vertex onto the second */
+        const std::vector<std::pair<uint32_t, uint32_t>> & collapses() const { return m_collapses; }
+
+        /*!
+         *  Collapse edges until at most `target` triangles are left or no edge
+         *  can go without flipping a triangle or changing the topology
+         *  \return triangles left
+         */
+        size_t simplify(size_t target, int threads = 0)
+        {
+            if (!m_started)
+            {
+                m_started = true;
+                _start(threads);
+            }
+
+            while (m_alive > target && !m_heap.empty())
+            {
+                const uint32_t from = m_heap[0], to = m_target[from];
+                // not allowed, or no longer, look for the best one that is
+                if (!_collapsible(from, to, m_ring, m_ring2))
+                {
+                    _update(from, true);
+                    continue;
+                }
+                m_error = std::max(m_error, (double)m_cost[from]);
+                _collapse(from, to);
+            }
+            return m_alive;
+        }
+
+        /*!
+         *  Simplify to a fraction of the triangles the simplifier started with,
+         *  0.1 keeps a tenth of them
+         *  \return triangles left
+         */
+        size_t simplify_ratio(double ratio, int threads = 0)
+        {
+            ratio = std::max(0.0, std::min(1.0, ratio));
+            return simplify((size_t)(ratio * m_initial), threads);
+        }
+
+        /*! the triangles left, three indices of the input vertices each */
+        void triangles(std::vector<uint32_t> & out) const
+        {
+            out.clear();
+            out.reserve(3 * m_alive);
+            for (size_t t = 0; t < m_dead.size(); t++)
+            {
+                if (!m_dead[t]) out.insert(out.end(), m_indices.begin() + 3 * t, m_indices.begin() + 3 * t + 3);
+            }
+        }
+
+    protected:
+        /*! symmetric 4x4 quadric weighted by area, and the total area */
+        struct CQuadric
+        {
+            float a[10] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+            float w = 0;
+
+            void add_plane(const uint32_t * c, const float * p)
+            {
+                const float * p0 = p + 3 * c[0];
+                const float * p1 = p + 3 * c[1];
+                const float * p2 = p + 3 * c[2];
+                double u[3], v[3], n[3];
+                for (int d = 0; d < 3; d++) { u[d] = p1[d] - p0[d]; v[d] = p2[d] - p0[d]; }
+                n[0] = u[1] * v[2] - u[2] * v[1];
+                n[1] = u[2] * v[0] - u[0] * v[2];
+                n[2] = u[0] * v[1] - u[1] * v[0];
+                const double l = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (l == 0) return;
+                for (int d = 0; d < 3; d++) n[d] /= l;
+                const double dist = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+                const double area = l / 2;
+                const double q[10] = { n[0] * n[0], n[0] * n[1], n[0] * n[2], n[0] * dist,
+                    n[1] * n[1], n[1] * n[2], n[1] * dist, n[2] * n[2], n[2] * dist, dist * dist };
+                for (int i = 0; i < 10; i++) a[i] += (float)(area * q[i]);
+                w += (float)area;
+            }
+
+            void add(const CQuadric & q)
+            {
+                for (int i = 0; i < 10; i++) a[i] += q.a[i];
+                w += q.w;
+            }
+
+            /*! weighted sum of squared distances of p to the planes */
+            double eval(const float * p) const
+            {
+                const double x = p[0], y = p[1], z = p[2];
+                const double r = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                    + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                    + a[7] * z * z + 2 * a[8] * z + a[9];
+                return std::max(0.0, r);
+            }
+        };
+
+        const uint32_t * _corners(uint32_t t) const { return &m_indices[3 * t]; }
+
+        /*! mean squared distance over the combined area of moving a onto b */
+        double _cost(uint32_t a, uint32_t b) const
+        {
+            CQuadric q = m_quadrics[a];
+            q.add(m_quadrics[b]);
+            return q.eval(m_positions + 3 * b) / (q.w > 0 ? q.w : 1);
+        }
+
+        /*!
+         *  The cheapest collapse of v, with `check` the cheapest that is allowed now
+         *  \return false if v may not move or none of its edges can go
+         */
+        bool _best(uint32_t v, bool check, float & cost, uint32_t & target, std::vector<uint32_t> & ring, std::vector<uint32_t> & ring2,
+            std::vector<std::pair<double, uint32_t>> & candidates) const
+        {
+            if (m_locked[v] || m_size[v] == 0) return false;
+            _ring(v, ring);
+            candidates.clear();
+            for (uint32_t w : ring) candidates.push_back(std::make_pair(_cost(v, w), w));
+            std::sort(candidates.begin(), candidates.end());
+            for (const auto & c : candidates)
+            {
+                if (check && !_collapsible(v, c.second, ring, ring2)) continue;
+                cost = (float)c.first;
+                target = c.second;
+                return true;
+            }
+            return false;
+        }
+
+        /*! the best collapses of all vertices, in parallel, then the heap over them */
+        void _start(int threads)
+        {
+            const size_t nv = m_locked.size();
+            m_cost.assign(nv, 0);
+            m_target.assign(nv, 0);
+            m_slot.assign(nv, (uint32_t)s_none);
+            std::vector<char> movable(nv, 0);
+            parallel_for(nv, threads, [&](size_t b, size_t e)
+            {
+                std::vector<uint32_t> ring, ring2;
+                std::vector<std::pair<double, uint32_t>> candidates;
+                for (size_t v = b; v < e; v++) movable[v] = _best((uint32_t)v, false, m_cost[v], m_target[v], ring, ring2, candidates);
+            }, 1 << 12);
+
+            m_heap.clear();
+            for (size_t v = 0; v < nv; v++)
+            {
+                if (!movable[v]) continue;
+                m_slot[v] = (uint32_t)m_heap.size();
+                m_heap.push_back((uint32_t)v);
+            }
+            for (size_t i = m_heap.size() / 2; i-- > 0;) _down(i);
+        }
+
+        /*! evaluate v again, moving it in the heap or out of it */
+        void _update(uint32_t v, bool check)
+        {
+            float cost;
+            uint32_t target;
+            if (!_best(v, check, cost, target, m_ring, m_ring2, m_candidates))
+            {
+                _remove(v);
+                return;
+            }
+            m_target[v] = target;
+            if (m_slot[v] == s_none)
+            {
+                m_cost[v] = cost;
+                m_slot[v] = (uint32_t)m_heap.size();
+                m_heap.push_back(v);
+                _up(m_slot[v]);
+            }
+            else
+            {
+                const bool lower = cost < m_cost[v];
+                m_cost[v] = cost;
+                if (lower) _up(m_slot[v]);
+                else _down(m_slot[v]);
+            }
+        }
+
+        void _remove(uint32_t v)
+        {
+            const uint32_t i = m_slot[v];
+            if (i == s_none) return;
+            m_slot[v] = s_none;
+            const uint32_t last = m_heap.back();
+            m_heap.pop_back();
+            if (i == m_heap.size()) return;
+            m_heap[i] = last;
+            m_slot[last] = i;
+            _up(i);
+            _down(m_slot[last]);
+        }
+
+        void _up(size_t i)
+        {
+            const uint32_t v = m_heap[i];
+            while (i > 0)
+            {
+                const size_t p = (i - 1) / 2;
+                if (!(m_cost[v] < m_cost[m_heap[p]])) break;
+                m_heap[i] = m_heap[p];
+                m_slot[m_heap[i]] = (uint32_t)i;
+                i = p;
+            }
+            m_heap[i] = v;
+            m_slot[v] = (uint32_t)i;
+        }
+
+        void _down(size_t i)
+        {
+            const uint32_t v = m_heap[i];
+            const size_t n = m_heap.size();
+            for (size_t c = 2 * i + 1; c < n; c = 2 * i + 1)
+            {
+                if (c + 1 < n && m_cost[m_heap[c + 1]] < m_cost[m_heap[c]]) c++;
+                if (!(m_cost[m_heap[c]] < m_cost[v])) break;
+                m_heap[i] = m_heap[c];
+                m_slot[m_heap[i]] = (uint32_t)i;
+                i = c;
+            }
+            m_heap[i] = v;
+            m_slot[v] = (uint32_t)i;
+        }
+
+        /*! distinct vertices of the live triangles around v, v excluded */
+        void _ring(uint32_t v, std::vector<uint32_t> & ring) const
+        {
+            ring.clear();
+            const uint32_t * a = &m_adjacency[m_begin[v]];
+            for (uint32_t k = 0; k < m_size[v]; k++)
+            {
+                if (m_dead[a[k]]) continue;
+                const uint32_t * c = _corners(a[k]);
+                for (int i = 0; i < 3; i++)
+                {
+                    if (c[i] != v) ring.push_back(c[i]);
+                }
+            }
+            std::sort(ring.begin(), ring.end());
+            ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+        }
+
+        /*! the edge is in two triangles, the rings of its ends meet only there, and no triangle flips */
+        bool _collapsible(uint32_t from, uint32_t to, std::vector<uint32_t> & ring, std::vector<uint32_t> & ring2) const
+        {
+            _ring(from, ring);
+            _ring(to, ring2);
+            size_t common = 0;
+            for (size_t i = 0, j = 0; i < ring.size() && j < ring2.size();)
+            {
+                if (ring[i] < ring2[j]) i++;
+                else if (ring2[j] < ring[i]) j++;
+                else { common++; i++; j++; }
+            }
+            if (common != 2) return false;
+
+            const float * target = m_positions + 3 * to;
+            const uint32_t * a = &m_adjacency[m_begin[from]];
+            size_t shared = 0;
+            for (uint32_t k = 0; k < m_size[from]; k++)
+            {
+                if (m_dead[a[k]]) continue;
+                const uint32_t * c = _corners(a[k]);
+                if (c[0] == to || c[1] == to || c[2] == to)
+                {
+                    shared++;
+                    continue;
+                }
+                // normal before and after, a flip or a sliver of more than 75 degrees turn is rejected
+                const float * p[3];
+                const float * q[3];
+                for (int i = 0; i < 3; i++)
+                {
+                    p[i] = m_positions + 3 * c[i];
+                    q[i] = c[i] == from ? target : p[i];
+                }
+                double n0[3], n1[3];
+                _normal(p, n0);
+                _normal(q, n1);
+                const double d = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+                const double l0 = n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2];
+                const double l1 = n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2];
+                if (d <= 0 || d * d < 0.0625 * l0 * l1) return false;
+            }
+            return shared == 2;
+        }
+
+        static void _normal(const float * const * p, double * n)
+        {
+            double u[3], v[3];
+            for (int d = 0; d < 3; d++) { u[d] = p[1][d] - p[0][d]; v[d] = p[2][d] - p[0][d]; }
+            n[0] = u[1] * v[2] - u[2] * v[1];
+            n[1] = u[2] * v[0] - u[0] * v[2];
+            n[2] = u[0] * v[1] - u[1] * v[0];
+        }
+
+        void _collapse(uint32_t from, uint32_t to)
+        {
+            // the triangles of `to` afterwards, the two on the edge are gone
+            m_list.clear();
+            const uint32_t * a = &m_adjacency[m_begin[to]];
+            for (uint32_t k = 0; k < m_size[to]; k++)
+            {
+                if (!m_dead[a[k]]) m_list.push_back(a[k]);
+            }
+            a = &m_adjacency[m_begin[from]];
+            for (uint32_t k = 0; k < m_size[from]; k++)
+            {
+                const uint32_t t = a[k];
+                if (m_dead[t]) continue;
+                uint32_t * c = &m_indices[3 * t];
+                if (c[0] == to || c[1] == to || c[2] == to)
+                {
+                    m_dead[t] = 1;
+                    m_alive--;
+                    continue;
+                }
+                for (int i = 0; i < 3; i++)
+                {
+                    if (c[i] == from) c[i] = to;
+                }
+                m_list.push_back(t);
+            }
+            m_list.erase(std::remove_if(m_list.begin(), m_list.end(), [&](uint32_t t) { return m_dead[t] != 0; }), m_list.end());
+
+            // in place if it fits, else at the end of the array
+            if (m_list.size() > m_capacity[to])
+            {
+                if (m_adjacency.size() > 4 * (3 * m_alive + s_min_compact)) _compact();
+                m_begin[to] = (uint32_t)m_adjacency.size();
+                m_capacity[to] = (uint32_t)(2 * m_list.size());
+                m_adjacency.resize(m_adjacency.size() + m_capacity[to]);
+            }
+            std::copy(m_list.begin(), m_list.end(), m_adjacency.begin() + m_begin[to]);
+            m_size[to] = (uint32_t)m_list.size();
+            m_size[from] = 0;
+
+            m_quadrics[to].add(m_quadrics[from]);
+            m_collapses.push_back(std::make_pair(from, to));
+            _remove(from);
+
+            // the quadric of `to` grew, the neighbors of `from` are now those of `to`
+            _update(to, false);
+            _ring(to, m_around);
+            for (uint32_t w : m_around)
+            {
+                if (m_slot[w] == s_none || m_target[w] == from || m_target[w] == to)
+                {
+                    _update(w, false);
+                    continue;
+                }
+                const float cost = (float)_cost(w, to);
+                if (cost < m_cost[w])
+                {
+                    m_cost[w] = cost;
+                    m_target[w] = to;
+                    _up(m_slot[w]);
+                }
+            }
+        }
+
+        /*! drop the dead triangles and the abandoned lists from the adjacency */
+        void _compact()
+        {
+            std::vector<uint32_t> adjacency;
+            adjacency.reserve(3 * m_alive + s_min_compact);
+            for (size_t v = 0; v < m_begin.size(); v++)
+            {
+                const uint32_t b = (uint32_t)adjacency.size();
+                for (uint32_t k = 0; k < m_size[v]; k++)
+                {
+                    uint32_t t = m_adjacency[m_begin[v] + k];
+                    if (!m_dead[t]) adjacency.push_back(t);
+                }
+                m_begin[v] = b;
+                m_size[v] = m_capacity[v] = (uint32_t)adjacency.size() - b;
+            }
+            m_adjacency.swap(adjacency);
+        }
+
+        //! adjacency entries not worth compacting the array for
+        static const size_t s_min_compact = 1 << 16;
+
+        std::vector<uint32_t> m_indices;
+        std::vector<char>     m_dead;
+        const float *         m_positions;
+        size_t                m_alive = 0;
+
+        //! the triangles of vertex v are m_adjacency[m_begin[v], m_begin[v] + m_size[v]), dead ones included
+        std::vector<uint32_t> m_adjacency;
+        std::vector<uint32_t> m_begin, m_size, m_capacity;
+
+        std::vector<CQuadric> m_quadrics;
+        std::vector<char>     m_locked;
+        size_t                m_initial = 0;
+        bool                  m_started = false;
+        double                m_error = 0;
+
+        //! the vertices that may move by the cost of their cheapest collapse, and their place in the heap
+        std::vector<uint32_t> m_heap;
+        std::vector<uint32_t> m_slot;
+        std::vector<float>    m_cost;
+        std::vector<uint32_t> m_target;
+        static const uint32_t s_none = 0xffffffffu;
+        std::vector<std::pair<uint32_t, uint32_t>> m_collapses;
+
+        std::vector<uint32_t> m_ring, m_ring2, m_list, m_around;
+        std::vector<std::pair<double, uint32_t>> m_candidates;
+    };
+
+}; //namespace
+
+#endif
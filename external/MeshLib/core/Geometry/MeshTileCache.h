@@ -0,0 +1,210 @@
+/*!
+*      \file MeshTileCache.h
+*      \brief Residency of the tiles of a .mtx hierarchy within a memory budget
+*
+*      Every frame the tree is walked from its root, a tile whose error on
+*      screen is small enough is drawn, otherwise its children are drawn in
+*      its place once all those in view are resident, and asked for until
+*      then. Only resident tiles are ever drawn, the root is always one, so
+*      the memory and the triangles of a frame stay within the budget however
+*      large the mesh is. The least recently seen tiles make room for new ones,
+*      and no more tiles are asked for than fit beside those the frame keeps.
+*/
+
+#ifndef _MESHLIB_MESH_TILE_CACHE_H_
+#define _MESHLIB_MESH_TILE_CACHE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "../parser/mtx.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshTileCache class
+     */
+    class CMeshTileCache
+    {
+    public:
+        /*!
+         *  \param nodes  the nodes of the .mtx file
+         *  \param budget bytes of the resident tiles, the root always fits
+         */
+        void init(const std::vector<CMtxNode> & nodes, size_t budget)
+        {
+            m_nodes = nodes;
+            m_budget = budget;
+            m_used = 0;
+            m_resident.assign(nodes.size(), 0);
+            m_pending.assign(nodes.size(), 0);
+            m_seen.assign(nodes.size(), 0);
+            m_frame = 1;
+        }
+
+        size_t tiles() const { return m_nodes.size(); }
+        size_t used() const { return m_used; }
+        size_t resident_count() const { return (size_t)std::count(m_resident.begin(), m_resident.end(), 1); }
+        bool resident(uint32_t id) const { return m_resident[id] != 0; }
+
+        /*!
+         *  Start a frame, the tiles to draw and the tiles to read
+         *  \param mvp     column major model view projection matrix, in the coordinates of the points
+         *  \param eye     the eye in those coordinates
+         *  \param pixels  pixels a unit covers at a distance of one unit, half the viewport height over
+         *                 the tangent of half the field of view
+         *  \param error   the largest error on screen in pixels
+         *  \param draw    resident tiles covering what is in view
+         *  \param missing the tiles wanted, neither resident nor pending, coarsest first
+         */
+        void select(const float mvp[16], const float eye[3], float pixels, float error,
+            std::vector<uint32_t> & draw, std::vector<uint32_t> & missing)
+        {
+            m_frame++;
+            draw.clear();
+            missing.clear();
+            if (m_nodes.empty() || !m_resident[0]) return;
+
+            // the frustum planes, from the rows of the matrix, with unit normals
+            float planes[6][4];
+            for (int i = 0; i < 3; i++)
+            {
+                for (int s = 0; s < 2; s++)
+                {
+                    float * p = planes[2 * i + s];
+                    for (int c = 0; c < 4; c++) p[c] = mvp[4 * c + 3] + (s ? -1 : 1) * mvp[4 * c + i];
+                    const float l = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                    for (int c = 0; c < 4; c++) p[c] = l > 0 ? p[c] / l : 0;
+                }
+            }
+            auto visible = [&](const CMtxNode & n)
+            {
+                for (int p = 0; p < 6; p++)
+                {
+                    if (planes[p][0] * n.center[0] + planes[p][1] * n.center[1] + planes[p][2] * n.center[2] + planes[p][3] < -n.radius) return false;
+                }
+                return true;
+            };
+
+            // the bytes of the tiles this frame keeps
+            size_t kept = 0;
+            m_stack.clear();
+            m_refine.clear();
+            if (visible(m_nodes[0])) m_stack.push_back(0);
+            while (!m_stack.empty())
+            {
+                const uint32_t id = m_stack.back();
+                m_stack.pop_back();
+                const CMtxNode & n = m_nodes[id];
+                kept += n.bytes();
+                m_seen[id] = m_frame;
+                const float dx = n.center[0] - eye[0], dy = n.center[1] - eye[1], dz = n.center[2] - eye[2];
+                const float nearest = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - n.radius, 1e-6f * n.radius);
+                if (n.children == 0 || n.error * pixels <= error * nearest)
+                {
+                    draw.push_back(id);
+                    continue;
+                }
+                // the children in view replace the tile once they are all here
+                bool ready = true;
+                for (uint32_t c = n.first_child; c < n.first_child + n.children; c++)
+                    ready &= !visible(m_nodes[c]) || m_resident[c];
+                if (!ready)
+                {
+                    draw.push_back(id);
+                    m_refine.push_back(id);
+                    continue;
+                }
+                for (uint32_t c = n.first_child; c < n.first_child + n.children; c++)
+                    if (visible(m_nodes[c])) m_stack.push_back(c);
+            }
+
+            // the tiles drawn in place of their children ask for them, coarsest first, while they
+            // fit beside what the frame keeps. the resident children stay, they are needed as soon
+            // as the rest arrives
+            std::sort(m_refine.begin(), m_refine.end());
+            for (uint32_t id : m_refine)
+            {
+                const CMtxNode & n = m_nodes[id];
+                size_t bytes = 0;
+                for (uint32_t c = n.first_child; c < n.first_child + n.children; c++)
+                    if (visible(m_nodes[c])) bytes += m_nodes[c].bytes();
+                if (kept + bytes > m_budget) continue;
+                kept += bytes;
+                for (uint32_t c = n.first_child; c < n.first_child + n.children; c++)
+                {
+                    if (!visible(m_nodes[c])) continue;
+                    if (m_resident[c]) m_seen[c] = m_frame;
+                    else if (!m_pending[c]) missing.push_back(c);
+                }
+            }
+            // the hit rate is 1 - missed / drawn
+            MESHLIB_COUNTER_ADD("mesh.tiles_drawn", draw.size());
+            MESHLIB_COUNTER_ADD("mesh.tiles_missed", missing.size());
+            std::sort(missing.begin(), missing.end());
+        }
+
+        /*! a tile is being read, it is not reported missing again */
+        void set_pending(uint32_t id, bool pending) { m_pending[id] = pending ? 1 : 0; }
+
+        /*!
+         *  Make a read tile resident, evicting the least recently seen ones not
+         *  seen this frame until it fits
+         *  \param evicted the tiles dropped for it
+         *  \return false if it does not fit, it is dropped then
+         */
+        bool insert(uint32_t id, std::vector<uint32_t> & evicted)
+        {
+            evicted.clear();
+            m_pending[id] = 0;
+            if (m_resident[id]) return true;
+            const size_t bytes = m_nodes[id].bytes();
+            // the root is the fallback of every view, it goes in whatever the budget
+            if (id != 0)
+            {
+                if (m_used + bytes > m_budget)
+                {
+                    m_candidates.clear();
+                    for (uint32_t t = 1; t < m_nodes.size(); t++)
+                        if (m_resident[t] && m_seen[t] < m_frame) m_candidates.push_back(t);
+                    std::sort(m_candidates.begin(), m_candidates.end(), [&](uint32_t a, uint32_t b)
+                    {
+                        // the finer of two as old, their parents may still need them less
+                        return m_seen[a] != m_seen[b] ? m_seen[a] < m_seen[b] : a > b;
+                    });
+                    size_t freed = 0;
+                    size_t k = 0;
+                    while (k < m_candidates.size() && m_used - freed + bytes > m_budget) freed += m_nodes[m_candidates[k++]].bytes();
+                    if (m_used - freed + bytes > m_budget) return false;
+                    for (size_t i = 0; i < k; i++)
+                    {
+                        m_resident[m_candidates[i]] = 0;
+                        evicted.push_back(m_candidates[i]);
+                    }
+                    m_used -= freed;
+                }
+            }
+            m_resident[id] = 1;
+            m_used += bytes;
+            MESHLIB_GAUGE_SET("mesh.tile_bytes", m_used);
+            return true;
+        }
+
+    protected:
+        std::vector<CMtxNode> m_nodes;
+        std::vector<char>     m_resident, m_pending;
+        std::vector<uint32_t> m_seen;
+        std::vector<uint32_t> m_stack, m_refine, m_candidates;
+        size_t   m_budget = 0;
+        size_t   m_used = 0;
+        uint32_t m_frame = 1;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,221 @@
+/*!
+*      \file Meshlets.h
+*      \brief Small runs of triangles with bounds for culling them as a whole
+*
+*      A meshlet is a range of consecutive triangles of an index buffer with a
+*      bounding sphere and a cone around its normals. Every frame the meshlets
+*      outside of the view frustum or facing away from the eye are dropped and
+*      the rest is drawn as few runs of triangles as possible.
+*/
+
+#ifndef _MESHLIB_MESHLETS_H_
+#define _MESHLIB_MESHLETS_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshlets class
+     *
+     *  The bounds are stored as one array per coordinate, so the culling loop
+     *  runs over contiguous floats without branches and the compiler can
+     *  vectorize it.
+     */
+    class CMeshlets
+    {
+    public:
+        void clear()
+        {
+            m_first.clear(); m_count.clear();
+            m_x.clear(); m_y.clear(); m_z.clear(); m_radius.clear();
+            m_ax.clear(); m_ay.clear(); m_az.clear(); m_cutoff.clear();
+        }
+
+        /*! number of meshlets */
+        size_t size() const { return m_first.size(); }
+
+        /*! first triangle and number of triangles of meshlet i */
+        uint32_t first(size_t i) const { return m_first[i]; }
+        uint32_t count(size_t i) const { return m_count[i]; }
+
+        /*!
+         *  The bounds of meshlet i as cull tests them, for culling elsewhere
+         *  \param sphere center and radius
+         *  \param cone   unit axis and the sine of its widest angle
+         */
+        void bounds(size_t i, float sphere[4], float cone[4]) const
+        {
+            sphere[0] = m_x[i]; sphere[1] = m_y[i]; sphere[2] = m_z[i]; sphere[3] = m_radius[i];
+            cone[0] = m_ax[i]; cone[1] = m_ay[i]; cone[2] = m_az[i]; cone[3] = m_cutoff[i];
+        }
+
+        /*!
+         *  Split the triangles [first, first + count) into meshlets of at most
+         *  max_triangles, of about equal size, appended to the others
+         *  \param indices   three vertex indices per triangle
+         *  \param positions 3 floats per vertex
+         */
+        void build(const uint32_t * indices, size_t first, size_t count, const float * positions, size_t max_triangles = s_max_triangles)
+        {
+            if (count == 0) return;
+            const size_t parts = (count + max_triangles - 1) / max_triangles;
+            for (size_t k = 0; k < parts; k++)
+            {
+                size_t b = first + count * k / parts, e = first + count * (k + 1) / parts;
+                _add(indices, b, e, positions);
+            }
+        }
+
+        /*!
+         *  The triangles of meshlets [begin, end) that may be visible, consecutive
+         *  meshlets joined into one run
+         *  \param mvp    column major model view projection matrix
+         *  \param eye    the eye in model coordinates
+         *  \param first  first triangle of every run
+         *  \param count  triangles of every run
+         */
+        void cull(size_t begin, size_t end, const float mvp[16], const float eye[3],
+            std::vector<uint32_t> & first, std::vector<uint32_t> & count, int threads = 0) const
+        {
+            first.clear();
+            count.clear();
+            if (begin >= end) return;
+
+            // the frustum planes, from the rows of the matrix, with unit normals
+            float planes[6][4];
+            for (int i = 0; i < 3; i++)
+            {
+                for (int s = 0; s < 2; s++)
+                {
+                    float * p = planes[2 * i + s];
+                    for (int c = 0; c < 4; c++) p[c] = mvp[4 * c + 3] + (s ? -1 : 1) * mvp[4 * c + i];
+                    const float l = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                    for (int c = 0; c < 4; c++) p[c] = l > 0 ? p[c] / l : 0;
+                }
+            }
+
+            std::vector<char> visible(end - begin);
+            parallel_for(end - begin, threads, [&](size_t b, size_t e)
+            {
+                for (size_t k = b; k < e; k++)
+                {
+                    const size_t i = begin + k;
+                    const float x = m_x[i], y = m_y[i], z = m_z[i], r = m_radius[i];
+                    bool in = true;
+                    for (int p = 0; p < 6; p++)
+                    {
+                        in &= planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] >= -r;
+                    }
+                    // every triangle faces away if the view direction stays within the cone's complement
+                    const float dx = x - eye[0], dy = y - eye[1], dz = z - eye[2];
+                    const float l = std::sqrt(dx * dx + dy * dy + dz * dz);
+                    const bool back = dx * m_ax[i] + dy * m_ay[i] + dz * m_az[i] >= m_cutoff[i] * l + r;
+                    visible[k] = in && !back;
+                }
+            }, 1 << 12);
+
+            for (size_t k = 0; k < visible.size(); k++)
+            {
+                if (!visible[k]) continue;
+                const size_t i = begin + k;
+                if (!first.empty() && first.back() + count.back() == m_first[i]) count.back() += m_count[i];
+                else
+                {
+                    first.push_back(m_first[i]);
+                    count.push_back(m_count[i]);
+                }
+            }
+        }
+
+        //! triangles per meshlet, small enough for tight cones
+        static const size_t s_max_triangles = 128;
+
+    protected:
+        void _add(const uint32_t * indices, size_t b, size_t e, const float * positions)
+        {
+            // the sphere around the bounding box
+            float lo[3] = { HUGE_VALF, HUGE_VALF, HUGE_VALF };
+            float hi[3] = { -HUGE_VALF, -HUGE_VALF, -HUGE_VALF };
+            for (size_t i = 3 * b; i < 3 * e; i++)
+            {
+                const float * p = positions + 3 * indices[i];
+                for (int d = 0; d < 3; d++)
+                {
+                    lo[d] = std::min(lo[d], p[d]);
+                    hi[d] = std::max(hi[d], p[d]);
+                }
+            }
+            float c[3], r2 = 0;
+            for (int d = 0; d < 3; d++) c[d] = (lo[d] + hi[d]) / 2;
+            for (size_t i = 3 * b; i < 3 * e; i++)
+            {
+                const float * p = positions + 3 * indices[i];
+                const float dx = p[0] - c[0], dy = p[1] - c[1], dz = p[2] - c[2];
+                r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+            }
+
+            // the cone, the mean of the unit normals and the widest angle to it
+            std::vector<float> & normals = m_normals;
+            normals.assign(3 * (e - b), 0.0f);
+            double axis[3] = { 0, 0, 0 };
+            for (size_t t = b; t < e; t++)
+            {
+                const float * p0 = positions + 3 * indices[3 * t];
+                const float * p1 = positions + 3 * indices[3 * t + 1];
+                const float * p2 = positions + 3 * indices[3 * t + 2];
+                double u[3], v[3], n[3];
+                for (int d = 0; d < 3; d++) { u[d] = p1[d] - p0[d]; v[d] = p2[d] - p0[d]; }
+                n[0] = u[1] * v[2] - u[2] * v[1];
+                n[1] = u[2] * v[0] - u[0] * v[2];
+                n[2] = u[0] * v[1] - u[1] * v[0];
+                const double l = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (l == 0) continue;
+                for (int d = 0; d < 3; d++)
+                {
+                    normals[3 * (t - b) + d] = (float)(n[d] / l);
+                    axis[d] += n[d] / l;
+                }
+            }
+            const double al = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            double spread = 1;
+            if (al > 0)
+            {
+                for (int d = 0; d < 3; d++) axis[d] /= al;
+                for (size_t t = 0; t < e - b; t++)
+                {
+                    const float * n = &normals[3 * t];
+                    if (n[0] == 0 && n[1] == 0 && n[2] == 0) continue;
+                    spread = std::min(spread, axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2]);
+                }
+            }
+
+            m_first.push_back((uint32_t)b);
+            m_count.push_back((uint32_t)(e - b));
+            m_x.push_back(c[0]);
+            m_y.push_back(c[1]);
+            m_z.push_back(c[2]);
+            m_radius.push_back(std::sqrt(r2));
+            m_ax.push_back((float)axis[0]);
+            m_ay.push_back((float)axis[1]);
+            m_az.push_back((float)axis[2]);
+            // sine of the widest angle, a cone of 90 degrees or more never culls
+            m_cutoff.push_back(al > 0 && spread > 0 ? (float)std::sqrt(1 - spread * spread) : 1.0f);
+        }
+
+        std::vector<uint32_t> m_first, m_count;
+        std::vector<float>    m_x, m_y, m_z, m_radius;
+        std::vector<float>    m_ax, m_ay, m_az, m_cutoff;
+        std::vector<float>    m_normals;
+    };
+
+}; //namespace
+
+#endif
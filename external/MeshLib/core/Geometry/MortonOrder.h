@@ -0,0 +1,77 @@
+/*!
+*      \file MortonOrder.h
+*      \brief Ordering points along the Morton curve of their bounding box
+*
+*      Points close in space are mostly close on the curve, so elements laid
+*      out in its order are close in memory to their neighbors, which mesh
+*      files of scanners and sculpting tools seldom are. The bounding box is
+*      cut into 2^21 cells on its longest axis and the codes of the cells are
+*      sorted, ties in the order of the points, so the order does not depend
+*      on the number of threads.
+*/
+
+#ifndef _MESHLIB_MORTON_ORDER_H_
+#define _MESHLIB_MORTON_ORDER_H_
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include "Point.h"
+#include "PointBounds.h"
+#include "LinearOctree.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMortonOrder class
+     */
+    class CMortonOrder
+    {
+    public:
+        /*!
+         *  The order of n points along the curve, points that are not finite last
+         *  \param order   order[k] is the k-th point on the curve
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        static void sort(const CPoint * points, size_t n, std::vector<int> & order, int threads = 0);
+
+    protected:
+        //! cells of the finest depth of a 64 bit Morton code on an axis
+        static const uint32_t s_cells = (1u << CLinearOctree::s_max_depth) - 1;
+    };
+
+    inline void CMortonOrder::sort(const CPoint * points, size_t n, std::vector<int> & order, int threads)
+    {
+        order.resize(n);
+        if (n == 0) return;
+        const CPointBounds box = CPointBounds::of(reinterpret_cast<const double *>(points), n, threads);
+        double extent = 0;
+        for (int d = 0; d < 3; d++) extent = std::max(extent, box.hi[d] - box.lo[d]);
+        const double scale = extent > 0 ? s_cells / extent : 0;
+
+        std::vector<std::pair<uint64_t, int>> keys(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                uint32_t c[3];
+                bool finite = true;
+                for (int d = 0; d < 3; d++)
+                {
+                    const double x = (points[i][d] - box.lo[d]) * scale;
+                    finite = finite && x >= 0 && x <= s_cells;
+                    c[d] = finite ? (uint32_t)x : 0;
+                }
+                keys[i] = std::make_pair(finite ? CLinearOctree::_morton(c[0], c[1], c[2]) : UINT64_MAX, (int)i);
+            }
+        });
+        parallel_sort(keys.begin(), keys.end(), threads, std::less<std::pair<uint64_t, int>>());
+        for (size_t k = 0; k < n; k++) order[k] = keys[k].second;
+    }
+
+}; //namespace
+
+#endif
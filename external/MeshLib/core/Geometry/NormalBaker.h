@@ -0,0 +1,203 @@
+/*!
+*      \file NormalBaker.h
+*      \brief The normals of a detailed surface baked into the uv atlas of a simplified one
+*
+*      The triangles of the low surface, a decimated one, are rasterized in
+*      the texture plane as COcclusionBaker does. From every texel center
+*      inside a triangle a ray goes along the interpolated normal of the low
+*      surface, to both sides, into a CBVH of the high triangles, the nearer
+*      hit wins, the closest point within the same reach without one. The
+*      normal of the high surface there is written in the tangent frame of
+*      the low triangle, its tangent the direction of growing u, turned
+*      perpendicular to the low normal, as a shader rebuilds it from the
+*      derivatives of the position and the uv. The texture is cut into tiles
+*      the threads take, the rays of a tile are near each other and walk the
+*      same nodes. Texels outside the charts are then filled from their
+*      neighbours as CTextureRebaker fills them.
+*/
+
+#ifndef _MESHLIB_NORMAL_BAKER_H_
+#define _MESHLIB_NORMAL_BAKER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include "Point.h"
+#include "Point2.h"
+#include "BVH.h"
+#include "OcclusionBaker.h"
+#include "TextureRebaker.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CNormalBaker class
+     */
+    class CNormalBaker : protected CTextureRebaker
+    {
+    public:
+        //! rays reach this far to either side of the low surface, times the diagonal of its bounds
+        double reach = 0.02;
+        //! texels along the side of a tile a thread takes at once
+        int    tile = 32;
+        using CTextureRebaker::dilate;
+
+        /*!
+         *  Bake the normals of the high triangles into width x height texels of the atlas of the low
+         *  ones, row 0 at v = 0. A texel is 0xAARRGGBB, as QImage keeps them, its red, green and blue
+         *  the tangent, bitangent and normal components of the unit normal mapped from [-1, 1] to
+         *  [0, 255], opaque. A texel no low triangle covers and no dilation reaches is 0, one whose
+         *  ray finds nothing keeps the low normal, 0xFF8080FF
+         *  \param high    high(t, k) is corner k of detailed triangle t as a CBakeCorner, its uv unused
+         *  \param low     low(t, k) is corner k of triangle t of the atlas as a CBakeCorner
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return the number of texels covered by low triangles
+         */
+        template<typename High, typename Low>
+        size_t bake(size_t highs, High high, size_t lows, Low low, int width, int height, std::vector<uint32_t> & out,
+                    int threads = 0) const;
+
+        /*! the texel of the unit vector n in the frame tangent, bitangent, normal */
+        static uint32_t _encode(const CPoint & n, const CPoint & tangent, const CPoint & bitangent, const CPoint & normal)
+        {
+            uint32_t r = 0xFF000000U;
+            const double c[3] = { n * tangent, n * bitangent, n * normal };
+            for (int k = 0; k < 3; k++)
+                r |= (uint32_t)std::max(0.0, std::min(255.0, (c[k] * 0.5 + 0.5) * 255 + 0.5)) << (16 - 8 * k);
+            return r;
+        }
+
+    protected:
+        /*! the normal of corners c0, c1, c2 at weights b1, b2 of corners 1 and 2, of unit length, face where they have none */
+        template<typename Corner>
+        static CPoint _normal(const Corner & c0, const Corner & c1, const Corner & c2, double b1, double b2, const CPoint & face)
+        {
+            CPoint n = c0.normal * (1.0 - b1 - b2) + c1.normal * b1 + c2.normal * b2;
+            if (n.norm() == 0) return face;
+            return n / n.norm();
+        }
+
+        /*! the unit face normal of a, b, c, 0 if it has no area */
+        static CPoint _face(const CPoint & a, const CPoint & b, const CPoint & c)
+        {
+            const CPoint n = (b - a) ^ (c - a);
+            const double l = n.norm();
+            return l > 0 ? n / l : CPoint(0, 0, 0);
+        }
+    };
+
+    template<typename High, typename Low>
+    inline size_t CNormalBaker::bake(size_t highs, High high, size_t lows, Low low, int width, int height, std::vector<uint32_t> & out,
+                                     int threads) const
+    {
+        out.assign((size_t)std::max(width, 0) * std::max(height, 0), 0);
+        if (out.empty() || highs == 0 || lows == 0) return 0;
+
+        std::vector<COcclusionBaker::CTexel> texels(out.size(), COcclusionBaker::CTexel{ -1, 0, 0 });
+        CPoint lo = low(0, 0).point, hi = lo;
+        for (size_t t = 0; t < lows; t++)
+        {
+            const CPoint2 uv[3] = { low(t, 0).uv, low(t, 1).uv, low(t, 2).uv };
+            COcclusionBaker::_rasterize(uv, (int32_t)t, width, height, texels);
+            for (int k = 0; k < 3; k++)
+            {
+                const CPoint p = low(t, k).point;
+                for (int a = 0; a < 3; a++)
+                {
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+            }
+        }
+        const double tmax = reach * (hi - lo).norm();
+
+        CBVH bvh;
+        bvh._construct(highs, [&](size_t t, int k) { return high(t, k).point; }, threads);
+
+        std::vector<char> covered(out.size(), 0);
+        const int side = std::max(tile, 1);
+        const int columns = (width + side - 1) / side, rows = (height + side - 1) / side;
+        parallel_for((size_t)columns * rows, threads, [&](size_t b, size_t e)
+        {
+            for (size_t j = b; j < e; j++)
+            {
+                const int x0 = (int)(j % columns) * side, y0 = (int)(j / columns) * side;
+                for (int y = y0; y < std::min(y0 + side, height); y++)
+                    for (int x = x0; x < std::min(x0 + side, width); x++)
+                    {
+                        const size_t i = (size_t)y * width + x;
+                        const COcclusionBaker::CTexel & texel = texels[i];
+                        if (texel.triangle < 0) continue;
+                        covered[i] = 1;
+                        const CBakeCorner c0 = low(texel.triangle, 0), c1 = low(texel.triangle, 1), c2 = low(texel.triangle, 2);
+                        const CPoint face = _face(c0.point, c1.point, c2.point);
+                        if (face.norm() == 0)
+                        {
+                            out[i] = 0xFF8080FFU;
+                            continue;
+                        }
+                        const CPoint normal = _normal(c0, c1, c2, texel.b1, texel.b2, face);
+                        const CPoint p = c0.point * (1.0 - texel.b1 - texel.b2) + c1.point * texel.b1 + c2.point * texel.b2;
+
+                        // the tangent along u, the bitangent only gives the handedness of the chart
+                        const CPoint e1 = c1.point - c0.point, e2 = c2.point - c0.point;
+                        const double du1 = c1.uv[0] - c0.uv[0], dv1 = c1.uv[1] - c0.uv[1];
+                        const double du2 = c2.uv[0] - c0.uv[0], dv2 = c2.uv[1] - c0.uv[1];
+                        const double det = du1 * dv2 - du2 * dv1;
+                        CPoint tangent = (e1 * dv2 - e2 * dv1) * (det < 0 ? -1.0 : 1.0);
+                        const CPoint along = (e2 * du1 - e1 * du2) * (det < 0 ? -1.0 : 1.0);
+                        tangent = tangent - normal * (normal * tangent);
+                        if (tangent.norm() == 0)
+                        {
+                            out[i] = 0xFF8080FFU;
+                            continue;
+                        }
+                        tangent /= tangent.norm();
+                        CPoint bitangent = normal ^ tangent;
+                        if (bitangent * along < 0) bitangent = -bitangent;
+
+                        // the nearer hit to either side, the closest point without one
+                        CBVH::CHit front, back;
+                        const bool ahead = bvh._intersect(p, normal, front, tmax);
+                        const bool behind = bvh._intersect(p, -normal, back, ahead ? front.t : tmax);
+                        uint32_t triangle;
+                        double b1, b2;
+                        if (behind || ahead)
+                        {
+                            const CBVH::CHit & hit = behind ? back : front;
+                            triangle = hit.triangle;
+                            b1 = hit.u;
+                            b2 = hit.v;
+                        }
+                        else
+                        {
+                            CBVH::CNearest nearest;
+                            if (!bvh._closest(p, nearest, tmax))
+                            {
+                                out[i] = 0xFF8080FFU;
+                                continue;
+                            }
+                            triangle = nearest.triangle;
+                            _weights(high(triangle, 0).point, high(triangle, 1).point, high(triangle, 2).point, nearest.point, b1, b2);
+                        }
+                        const CBakeCorner s0 = high(triangle, 0), s1 = high(triangle, 1), s2 = high(triangle, 2);
+                        const CPoint sface = _face(s0.point, s1.point, s2.point);
+                        const CPoint n = _normal(s0, s1, s2, b1, b2, sface.norm() > 0 ? sface : normal);
+                        out[i] = _encode(n, tangent, bitangent, normal);
+                    }
+            }
+        }, 1);
+
+        _dilate(width, height, out, covered);
+        size_t count = 0;
+        for (char c : covered) count += c != 0;
+        return count;
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,253 @@
+/*!
+*      \file OcclusionBaker.h
+*      \brief Ambient occlusion of a surface baked into the texels of its uv atlas
+*
+*      The triangles are rasterized in the texture plane, every texel center
+*      inside a triangle takes the point and the normal of the surface there.
+*      From that point cosine weighted rays over the hemisphere of the normal
+*      are tested for occluders on a CBVH of the same triangles, the texel
+*      keeps the fraction that escapes. The rays of a texel follow a fixed
+*      sequence rotated by a hash of the texel, so the result does not depend
+*      on the number of threads. Texels outside the charts are then filled
+*      from their neighbours, a few rings deep, so that filtering and mipmaps
+*      do not bleed the background into the seams.
+*/
+
+#ifndef _MESHLIB_OCCLUSION_BAKER_H_
+#define _MESHLIB_OCCLUSION_BAKER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "Point.h"
+#include "Point2.h"
+#include "BVH.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief a corner of a triangle to bake, its point, normal and uv
+     */
+    struct CBakeCorner
+    {
+        CPoint  point;
+        CPoint  normal;     //!< the shading normal, the face normal is taken where it is 0
+        CPoint2 uv;
+    };
+
+    /*!
+     *  \brief COcclusionBaker class
+     */
+    class COcclusionBaker
+    {
+    public:
+        //! rays per texel
+        int    rays = 64;
+        //! occluders farther than reach times the diagonal of the bounds are ignored
+        double reach = 0.25;
+        //! rays start this far above the surface, times the diagonal of the bounds
+        double bias = 1e-4;
+        //! rings of texels around the charts filled from their neighbours
+        int    dilate = 4;
+
+        /*!
+         *  Bake width x height texels, row 0 at v = 0, the uvs in [0, 1]^2,
+         *  parts of triangles outside are clipped. A texel no triangle covers
+         *  and no dilation reaches is 1, unoccluded
+         *  \param corner  corner(t, k) is corner k of triangle t as a CBakeCorner
+         *  \param ao      the fraction of the hemisphere open at every texel
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return the number of texels covered by triangles
+         */
+        template<typename Corner>
+        size_t bake(size_t triangles, Corner corner, int width, int height, std::vector<float> & ao, int threads = 0) const;
+
+        //! the triangle of a covered texel, -1 for none, and the weights of its corners 1 and 2
+        struct CTexel
+        {
+            int32_t triangle;
+            float   b1, b2;
+        };
+
+        /*! the texels whose centers are inside triangle t, a later triangle wins an overlap, see CTextureRebaker too */
+        static void _rasterize(const CPoint2 uv[3], int32_t t, int width, int height, std::vector<CTexel> & texels);
+
+    protected:
+        /*! fill the empty texels next to covered ones with the mean of them, rings times */
+        void _dilate(int width, int height, std::vector<float> & ao, const std::vector<char> & covered) const;
+
+        /*! a hash of x in [0, 1) */
+        static double _hash(uint32_t x)
+        {
+            x ^= x >> 16; x *= 0x7feb352dU;
+            x ^= x >> 15; x *= 0x846ca68bU;
+            x ^= x >> 16;
+            return x / 4294967296.0;
+        }
+
+        /*! the radical inverse of i in base 2 */
+        static double _van_der_corput(uint32_t i)
+        {
+            i = (i << 16) | (i >> 16);
+            i = ((i & 0x55555555U) << 1) | ((i & 0xAAAAAAAAU) >> 1);
+            i = ((i & 0x33333333U) << 2) | ((i & 0xCCCCCCCCU) >> 2);
+            i = ((i & 0x0F0F0F0FU) << 4) | ((i & 0xF0F0F0F0U) >> 4);
+            i = ((i & 0x00FF00FFU) << 8) | ((i & 0xFF00FF00U) >> 8);
+            return i / 4294967296.0;
+        }
+    };
+
+    template<typename Corner>
+    inline size_t COcclusionBaker::bake(size_t triangles, Corner corner, int width, int height, std::vector<float> & ao, int threads) const
+    {
+        ao.assign((size_t)std::max(width, 0) * std::max(height, 0), 1.0f);
+        if (ao.empty() || triangles == 0) return 0;
+
+        std::vector<CTexel> texels(ao.size(), CTexel{ -1, 0, 0 });
+        for (size_t t = 0; t < triangles; t++)
+        {
+            const CPoint2 uv[3] = { corner(t, 0).uv, corner(t, 1).uv, corner(t, 2).uv };
+            _rasterize(uv, (int32_t)t, width, height, texels);
+        }
+
+        CBVH bvh;
+        bvh._construct(triangles, [&](size_t t, int k) { return corner(t, k).point; }, threads);
+        CPoint lo = corner(0, 0).point, hi = lo;
+        for (size_t t = 0; t < triangles; t++)
+            for (int k = 0; k < 3; k++)
+            {
+                const CPoint p = corner(t, k).point;
+                for (int a = 0; a < 3; a++)
+                {
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+            }
+        const double diagonal = (hi - lo).norm();
+        const double tmax = reach * diagonal, offset = bias * diagonal;
+        const int n = std::max(rays, 1);
+
+        std::vector<char> covered(ao.size(), 0);
+        parallel_for(ao.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const CTexel & x = texels[i];
+                if (x.triangle < 0) continue;
+                covered[i] = 1;
+                const CBakeCorner c0 = corner(x.triangle, 0), c1 = corner(x.triangle, 1), c2 = corner(x.triangle, 2);
+                const double b0 = 1.0 - x.b1 - x.b2;
+                const CPoint p = c0.point * b0 + c1.point * x.b1 + c2.point * x.b2;
+                CPoint face = (c1.point - c0.point) ^ (c2.point - c0.point);
+                if (face.norm() == 0)
+                {
+                    ao[i] = 1;
+                    continue;
+                }
+                face /= face.norm();
+                CPoint normal = c0.normal * b0 + c1.normal * x.b1 + c2.normal * x.b2;
+                if (normal.norm() == 0) normal = face;
+                normal /= normal.norm();
+                // the ray starts on the side of the surface the normal looks at
+                const CPoint o = p + face * (face * normal < 0 ? -offset : offset);
+
+                // a frame around the normal
+                const CPoint axis = std::fabs(normal[0]) < 0.9 ? CPoint(1, 0, 0) : CPoint(0, 1, 0);
+                CPoint tangent = axis ^ normal;
+                tangent /= tangent.norm();
+                const CPoint bitangent = normal ^ tangent;
+
+                const double shift1 = _hash((uint32_t)i * 2 + 1), shift2 = _hash((uint32_t)i * 2 + 2);
+                int open = 0;
+                for (int k = 0; k < n; k++)
+                {
+                    double u1 = (k + 0.5) / n + shift1, u2 = _van_der_corput((uint32_t)k) + shift2;
+                    u1 -= std::floor(u1);
+                    u2 -= std::floor(u2);
+                    const double r = std::sqrt(u1), phi = 2 * M_PI * u2;
+                    const CPoint d = tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(std::max(0.0, 1 - u1));
+                    if (!bvh._occluded(o, d, tmax)) open++;
+                }
+                ao[i] = (float)open / n;
+            }
+        }, 64);
+
+        _dilate(width, height, ao, covered);
+        size_t count = 0;
+        for (char c : covered) count += c != 0;
+        return count;
+    }
+
+    inline void COcclusionBaker::_rasterize(const CPoint2 uv[3], int32_t t, int width, int height, std::vector<CTexel> & texels)
+    {
+        // texel space, the center of texel x, y is at x + 0.5, y + 0.5
+        double px[3], py[3];
+        for (int k = 0; k < 3; k++)
+        {
+            px[k] = uv[k][0] * width;
+            py[k] = uv[k][1] * height;
+        }
+        const double area = (px[1] - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (py[1] - py[0]);
+        if (area == 0) return;
+        const int x0 = std::max(0, (int)std::floor(std::min(px[0], std::min(px[1], px[2])) - 0.5));
+        const int x1 = std::min(width - 1, (int)std::ceil(std::max(px[0], std::max(px[1], px[2])) - 0.5));
+        const int y0 = std::max(0, (int)std::floor(std::min(py[0], std::min(py[1], py[2])) - 0.5));
+        const int y1 = std::min(height - 1, (int)std::ceil(std::max(py[0], std::max(py[1], py[2])) - 0.5));
+        // the centers on an edge belong to both triangles, tolerate rounding
+        const double eps = -1e-9;
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+            {
+                const double cx = x + 0.5, cy = y + 0.5;
+                const double b1 = ((cx - px[0]) * (py[2] - py[0]) - (px[2] - px[0]) * (cy - py[0])) / area;
+                const double b2 = ((px[1] - px[0]) * (cy - py[0]) - (cx - px[0]) * (py[1] - py[0])) / area;
+                if (b1 < eps || b2 < eps || 1 - b1 - b2 < eps) continue;
+                CTexel & texel = texels[(size_t)y * width + x];
+                texel.triangle = t;
+                texel.b1 = (float)b1;
+                texel.b2 = (float)b2;
+            }
+    }
+
+    inline void COcclusionBaker::_dilate(int width, int height, std::vector<float> & ao, const std::vector<char> & covered) const
+    {
+        std::vector<char> filled = covered;
+        std::vector<std::pair<size_t, float>> ring;
+        for (int r = 0; r < dilate; r++)
+        {
+            // the empty texels next to filled ones take the mean of those, all at once
+            ring.clear();
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    const size_t i = (size_t)y * width + x;
+                    if (filled[i]) continue;
+                    double sum = 0;
+                    int count = 0;
+                    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ny++)
+                        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); nx++)
+                        {
+                            const size_t j = (size_t)ny * width + nx;
+                            if (!filled[j]) continue;
+                            sum += ao[j];
+                            count++;
+                        }
+                    if (count) ring.push_back(std::make_pair(i, (float)(sum / count)));
+                }
+            if (ring.empty()) break;
+            for (const std::pair<size_t, float> & t : ring)
+            {
+                ao[t.first] = t.second;
+                filled[t.first] = 1;
+            }
+        }
+    }
+
+}; //namespace
+
+#endif
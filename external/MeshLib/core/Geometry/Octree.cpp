@@ -17,14 +17,21 @@ COctree::~COctree()
     }
 }
 
+//the linear octree holds the points once, the nodes of COctreeNode::subdivide copy them on every level
 void COctree::_construct( std::vector<CPoint> & pts, int n )
 {
-    m_root->subdivide( pts, n );
+    m_point_tree._construct( pts, n );
 }
 
 void COctree::_construct( int n )
 {
-    m_root->subdivide( m_trs, n );
+    _construct( n, 0 );
+}
+
+//the leaves keep indices into m_trs, the inner nodes nothing
+void COctree::_construct( int n, size_t leaf_size )
+{
+    m_triangle_tree._construct( m_trs.size(), [this]( size_t t, int k ) -> const CPoint & { return m_trs[t]->v[k]; }, n, leaf_size );
 }
 
 void COctree::_insert_triangle( CPoint a, CPoint b, CPoint c )
@@ -54,7 +61,7 @@ void COctreeNode::_sample( std::vector<CPoint> & samples )
         CPoint rd;
         for (int i =0; i<3;++i)
         {
-            rd[i] =((double) rand() / (RAND_MAX+1)) * 2 - 1.0;
+            rd[i] =((double) rand() / (RAND_MAX+1.0)) * 2 - 1.0;
         }
 
         double len = m_corner[1][0] - m_corner[0][0];
@@ -94,7 +101,7 @@ void COctreeNode::_sample( std::vector<CSample> & samples )
         CPoint rd;
         for (int i =0; i<3;++i)
         {
-            rd[i] =((double) rand() / (RAND_MAX+1)) * 2 - 1.0;
+            rd[i] =((double) rand() / (RAND_MAX+1.0)) * 2 - 1.0;
         }
 
         double len = m_corner[1][0] - m_corner[0][0];
@@ -124,18 +131,108 @@ void COctreeNode::_sample( std::vector<CSample> & samples )
     }
 }
 
+void COctreeNode::_sample( std::vector<CSample> & samples, std::vector<int> & levels, int depth )
+{
+    if( m_triangles.empty() ) return;
+
+    size_t first = samples.size();
+    if( m_child[0][0][0] == NULL )
+    {
+        _sample( samples );
+        if( samples.size() > first ) levels.push_back( depth );
+    }
+    else
+    {
+        for( int i = 0; i < 2; i ++ )
+        for( int j = 0; j < 2; j ++ )
+        for( int k = 0; k < 2; k ++ )
+        {
+            m_child[i][j][k]->_sample( samples, levels, depth + 1 );
+        }
+    }
+
+    //the first sample below stands for this node
+    if( samples.size() > first ) levels[first] = depth;
+}
+
+template<typename S>
+void COctree::_sample_tree( size_t i, std::vector<S> & samples, std::vector<int> * levels )
+{
+    const CTriangleOctree::CNode & node = m_triangle_tree.node( i );
+    size_t first = samples.size();
+
+    if( node.leaf() )
+    {
+        CPoint rd;
+        for (int d =0; d<3;++d)
+        {
+            rd[d] =((double) rand() / (RAND_MAX+1.0)) * 2 - 1.0;
+        }
+
+        CPoint lo, hi;
+        m_triangle_tree._corners( node, lo, hi );
+        double len = hi[0] - lo[0];
+        //ditter
+        CPoint p = (lo + hi)/2.0 + rd * len/4.0;
+
+        const std::vector<uint32_t> & items = m_triangle_tree.items();
+        for( uint32_t k = node.begin; k < node.end; k ++ )
+        {
+            S q;
+            if( m_trs[items[k]]->_project( p, q ) )
+            {
+                samples.push_back( q );
+                if( levels ) levels->push_back( node.depth );
+                break;
+            }
+        }
+    }
+    else
+    {
+        int c = 0;
+        for( int m = 0; m < 8; m ++ )
+        {
+            if( node.child_mask & ( 1 << m ) ) _sample_tree( node.first_child + c ++, samples, levels );
+        }
+    }
+
+    //the first sample below stands for this node
+    if( levels && samples.size() > first ) (*levels)[first] = node.depth;
+}
+
 void COctree::_sample( std::vector<CPoint> & samples )
 {
     srand((unsigned)time(NULL));
-    if( m_root != NULL )
-        m_root->_sample( samples );
+    if( m_triangle_tree.size() > 0 )
+        _sample_tree( 0, samples, (std::vector<int> *)NULL );
 };
 
 void COctree::_sample( std::vector<CSample> & samples )
 {
     srand((unsigned)time(NULL));
-    if( m_root != NULL )
-        m_root->_sample( samples );
+    if( m_triangle_tree.size() > 0 )
+        _sample_tree( 0, samples, (std::vector<int> *)NULL );
+};
+
+void COctree::_sample( std::vector<CSample> & samples, std::vector<size_t> & level_ends )
+{
+    std::vector<CSample> found;
+    std::vector<int> levels;
+    srand((unsigned)time(NULL));
+    if( m_triangle_tree.size() > 0 )
+        _sample_tree( 0, found, &levels );
+
+    //counting sort by level, stable so that each level keeps the order of the tree
+    int depth = 0;
+    for( size_t i = 0; i < levels.size(); i ++ ) depth = std::max( depth, levels[i] + 1 );
+    level_ends.assign( depth, 0 );
+    for( size_t i = 0; i < levels.size(); i ++ ) level_ends[levels[i]] ++;
+    for( int d = 1; d < depth; d ++ ) level_ends[d] += level_ends[d-1];
+
+    std::vector<size_t> next( depth, 0 );
+    for( int d = 1; d < depth; d ++ ) next[d] = level_ends[d-1];
+    samples.resize( found.size() );
+    for( size_t i = 0; i < found.size(); i ++ ) samples[next[levels[i]] ++] = found[i];
 };
 
 
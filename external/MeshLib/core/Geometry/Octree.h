@@ -15,16 +15,13 @@
 #include <limits>
 #include <cstdlib>
 #include <ctime>
+#include <algorithm>
 
-#include "Mesh/Vertex.h"
-#include "Mesh/Edge.h"
-#include "Mesh/Face.h"
-#include "Mesh/HalfEdge.h"
-
-#include "Mesh/BaseMesh.h"
-#include "Mesh/boundary.h"
-#include "Mesh/iterators.h"
-#include "Parser/parser.h"
+#include "Point.h"
+#include "Point2.h"
+#include "../parser/parallel.h"
+#include "LinearOctree.h"
+#include "TriangleOctree.h"
 #include "TriangleCubeIntersect.h"
 
 namespace MeshLib
@@ -113,16 +110,14 @@ namespace MeshLib
             }
 
 
-            for( int i = 0; i < 2; i ++ )
-            for( int j = 0; j < 2; j ++ )
-            for( int k = 0; k < 2; k ++ )
+            _for_children( m_pts.size(), [&]( int i, int j, int k )
             {
                 CPoint p = m_corner[0] + CPoint( i, j, k ) * len;
                 CPoint q = p + CPoint(len, len, len );
                 m_child[i][j][k] = new COctreeNode(p,q);
 
                 m_child[i][j][k]->subdivide( m_pts, n-1 );
-            }
+            } );
 
         }
 
@@ -136,37 +131,62 @@ namespace MeshLib
 
             CPoint center = (m_corner[0] + m_corner[1] )/2.0;
 
-            for( size_t id = 0; id < trs.size(); id ++ )
+            //four triangles at a time, the last batch padded
+            for( size_t id = 0; id < trs.size(); id += 4 )
             {
-                CTriangle * pT = trs[id];
-
-                CPoint a = ( pT->v[0] - center )/(len*2);
-                CPoint b = ( pT->v[1] - center )/(len*2);
-                CPoint c = ( pT->v[2] - center )/(len*2);
+                double batch[3][3][4];
+                for( int k = 0; k < 4; k ++ )
+                {
+                    if( id + k >= trs.size() )
+                    {
+                        TC.pad( batch, k );
+                        continue;
+                    }
+                    CTriangle * pT = trs[id + k];
+                    TC.pack( batch, k, ( pT->v[0] - center )/(len*2), ( pT->v[1] - center )/(len*2), ( pT->v[2] - center )/(len*2) );
+                }
 
-                long inside = TC.test( a, b, c );
-                if( !inside )
-                    m_triangles.push_back( pT );
+                int inside = TC.batch( batch );
+                for( int k = 0; inside; k ++, inside >>= 1 )
+                    if( inside & 1 )
+                        m_triangles.push_back( trs[id + k] );
             }
 
             //current node is a leaf
             if( n == 0 ) return;
 
-            for( int i = 0; i < 2; i ++ )
-            for( int j = 0; j < 2; j ++ )
-            for( int k = 0; k < 2; k ++ )
+            _for_children( m_triangles.size(), [&]( int i, int j, int k )
             {
                 CPoint p = m_corner[0] + CPoint( i, j, k ) * len;
                 CPoint q = p + CPoint(len, len, len );
                 m_child[i][j][k] = new COctreeNode(p,q);
 
                 m_child[i][j][k]->subdivide( m_triangles, n-1 );
-            }
+            } );
 
         }
 
         void _sample( std::vector<CPoint>  & samples );
         void _sample( std::vector<CSample> & samples );
+        /*! as _sample, levels gets for every sample the depth of the coarsest node whose
+            first sample it is, this node being at depth */
+        void _sample( std::vector<CSample> & samples, std::vector<int> & levels, int depth );
+
+    protected:
+        //! items below which the children of a node are built by the calling thread
+        static const size_t s_parallel_items = 1 << 12;
+
+        /*! fn(i, j, k) for the eight children, on the shared pool when the node holds enough items */
+        template<typename Fn>
+        static void _for_children( size_t items, Fn fn )
+        {
+            auto child = [&]( int c ) { fn( c >> 2, ( c >> 1 ) & 1, c & 1 ); };
+            if( items < s_parallel_items )
+            {
+                for( int c = 0; c < 8; c ++ ) child( c );
+            }
+            else parallel_run( 8, child );
+        }
 
     public:
 
@@ -185,16 +205,33 @@ namespace MeshLib
         COctree();
         ~COctree();
         COctreeNode * root() { return m_root; };
+        /*! the points of _construct( pts, n ), sorted into a linear octree over the same cube, for
+            the nearest neighbour and radius queries, see CLinearOctree::_nearest and _within */
+        CLinearOctree & point_tree() { return m_point_tree; };
+        /*! the inserted triangles by index in an octree over the same cube, which _sample samples */
+        CTriangleOctree & triangle_tree() { return m_triangle_tree; };
         void _construct( std::vector<CPoint> & pts, int n );
+        /*! the triangle tree down to depth n */
         void _construct( int n );
+        /*! the triangle tree down to depth n, nodes meeting at most leaf_size triangles are not split */
+        void _construct( int n, size_t leaf_size );
         void _insert_triangle( CPoint a, CPoint b, CPoint c );
         void _insert_triangle( const CTriangle & tri );
         void _sample( std::vector<CPoint> & samples );
         void _sample( std::vector<CSample> & samples );
+        /*! the samples ordered coarse to fine, the first level_ends[d] of them hold one sample
+            for every node of depth d that got one, level_ends.back() is all of them */
+        void _sample( std::vector<CSample> & samples, std::vector<size_t> & level_ends );
 
     protected:
         COctreeNode * m_root;
         std::vector<CTriangle*> m_trs;
+        CLinearOctree m_point_tree;
+        CTriangleOctree m_triangle_tree;
+
+        /*! samples of the leaves below node i of the triangle tree, with their levels as COctreeNode's */
+        template<typename S>
+        void _sample_tree( size_t i, std::vector<S> & samples, std::vector<int> * levels );
     };
 };
 
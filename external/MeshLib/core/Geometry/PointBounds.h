@@ -0,0 +1,163 @@
+/*!
+*      \file PointBounds.h
+*      \brief Bounding box and coordinate sum of a point set
+*
+*      Folds contiguous xyz arrays of floats or doubles in parallel, four
+*      points per step with AVX and two with SSE2. The registers hold the
+*      interleaved coordinates as they are in memory, so no shuffles run in
+*      the loop, the lanes are sorted out once at the end.
+*/
+
+#ifndef _MESHLIB_POINT_BOUNDS_H_
+#define _MESHLIB_POINT_BOUNDS_H_
+
+#include <cstddef>
+#include <cfloat>
+#include <algorithm>
+#include "Point.h"
+#include "../parser/parallel.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MESHLIB_POINT_BOUNDS_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLIB_POINT_BOUNDS_SSE2
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPointBounds class, the box and the sum of the points folded in
+     */
+    class CPointBounds
+    {
+    public:
+        //! empty, lo above hi
+        CPoint lo = CPoint(DBL_MAX, DBL_MAX, DBL_MAX);
+        CPoint hi = CPoint(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+        CPoint sum = CPoint(0, 0, 0);
+        size_t count = 0;
+
+        void add(const CPoint & p)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                lo[d] = std::min(lo[d], p[d]);
+                hi[d] = std::max(hi[d], p[d]);
+            }
+            sum += p;
+            count++;
+        }
+
+        static CPointBounds join(const CPointBounds & a, const CPointBounds & b)
+        {
+            CPointBounds r = a;
+            for (int d = 0; d < 3; d++)
+            {
+                r.lo[d] = std::min(a.lo[d], b.lo[d]);
+                r.hi[d] = std::max(a.hi[d], b.hi[d]);
+            }
+            r.sum += b.sum;
+            r.count += b.count;
+            return r;
+        }
+
+        CPoint center() const { return count ? sum / (double)count : sum; }
+
+        /*!
+         *  The bounds of n points, x y z after each other
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        template<typename T>
+        static CPointBounds of(const T * xyz, size_t n, int threads = 0)
+        {
+            return parallel_reduce(n, threads, CPointBounds(), [xyz](size_t b, size_t e, CPointBounds & acc)
+            {
+                acc = join(acc, _fold(xyz + 3 * b, e - b));
+            }, &CPointBounds::join, 1 << 16);
+        }
+
+    protected:
+        template<typename T>
+        static CPointBounds _fold(const T * p, size_t n)
+        {
+            CPointBounds r;
+            size_t i = 0;
+#if defined(MESHLIB_POINT_BOUNDS_AVX) || defined(MESHLIB_POINT_BOUNDS_SSE2)
+#ifdef MESHLIB_POINT_BOUNDS_AVX
+            typedef __m256d V;
+            const int W = 4;
+#else
+            typedef __m128d V;
+            const int W = 2;
+#endif
+            // W points are 3 registers, lane j of register k holds coordinate (W * k + j) % 3
+            V lo[3], hi[3], sum[3];
+            for (int k = 0; k < 3; k++)
+            {
+                lo[k] = _set1(DBL_MAX);
+                hi[k] = _set1(-DBL_MAX);
+                sum[k] = _set1(0);
+            }
+            for (; i + W <= n; i += W)
+            {
+                const T * q = p + 3 * i;
+                for (int k = 0; k < 3; k++)
+                {
+                    const V v = _load(q + W * k);
+                    lo[k] = _min(lo[k], v);
+                    hi[k] = _max(hi[k], v);
+                    sum[k] = _add(sum[k], v);
+                }
+            }
+            if (i > 0)
+            {
+                double l[3][W], h[3][W], s[3][W];
+                for (int k = 0; k < 3; k++)
+                {
+                    _store(l[k], lo[k]);
+                    _store(h[k], hi[k]);
+                    _store(s[k], sum[k]);
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    for (int j = 0; j < W; j++)
+                    {
+                        const int d = (W * k + j) % 3;
+                        r.lo[d] = std::min(r.lo[d], l[k][j]);
+                        r.hi[d] = std::max(r.hi[d], h[k][j]);
+                        r.sum[d] += s[k][j];
+                    }
+                }
+                r.count = i;
+            }
+#endif
+            for (; i < n; i++) r.add(CPoint(p[3 * i], p[3 * i + 1], p[3 * i + 2]));
+            return r;
+        }
+
+#if defined(MESHLIB_POINT_BOUNDS_AVX)
+        static __m256d _set1(double v) { return _mm256_set1_pd(v); }
+        static __m256d _load(const double * p) { return _mm256_loadu_pd(p); }
+        static __m256d _load(const float * p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+        static __m256d _min(__m256d a, __m256d b) { return _mm256_min_pd(a, b); }
+        static __m256d _max(__m256d a, __m256d b) { return _mm256_max_pd(a, b); }
+        static __m256d _add(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+        static void _store(double * p, __m256d v) { _mm256_storeu_pd(p, v); }
+#elif defined(MESHLIB_POINT_BOUNDS_SSE2)
+        static __m128d _set1(double v) { return _mm_set1_pd(v); }
+        static __m128d _load(const double * p) { return _mm_loadu_pd(p); }
+        //! two floats, without reading past them
+        static __m128d _load(const float * p) { return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)p))); }
+        static __m128d _min(__m128d a, __m128d b) { return _mm_min_pd(a, b); }
+        static __m128d _max(__m128d a, __m128d b) { return _mm_max_pd(a, b); }
+        static __m128d _add(__m128d a, __m128d b) { return _mm_add_pd(a, b); }
+        static void _store(double * p, __m128d v) { _mm_storeu_pd(p, v); }
+#endif
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,155 @@
+/*!
+*      \file PointNormals.h
+*      \brief Normals of a point cloud from its nearest neighbours
+*
+*      A raw scan has points and no faces, so its normals are not summed over
+*      faces but fitted: the normal of a point is the direction its k nearest
+*      neighbours, found in a CLinearOctree, spread the least in, the
+*      eigenvector of the smallest eigenvalue of their 3x3 covariance, solved
+*      in closed form by Eigen. The fit leaves the sign open, the normals are
+*      turned toward a viewpoint, the scanner, or away from the centroid of
+*      the cloud. The points are fitted in parallel and the result does not
+*      depend on the number of threads.
+*/
+
+#ifndef _MESHLIB_POINT_NORMALS_H_
+#define _MESHLIB_POINT_NORMALS_H_
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+#include "Point.h"
+#include "PointBounds.h"
+#include "LinearOctree.h"
+#include "../parser/parallel.h"
+#include "../parser/trace.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPointNormals class
+     */
+    class CPointNormals
+    {
+    public:
+        //! the depth of the tree estimate builds, finer than any scan needs to tell its points apart
+        static const int s_depth = 16;
+        //! the points of a leaf of that tree, a query tests them faster than it walks smaller cells
+        static const size_t s_leaf_size = 16;
+
+        /*!
+         *  The normals of the points of tree, by the same index as tree.points(), of unit length,
+         *  zero where fewer than three neighbours span no plane
+         *  \param k         the neighbours a normal is fitted to, the point itself among them
+         *  \param viewpoint the normals turn toward it, away from the centroid of the points without one
+         *  \param threads   number of threads, 0 uses all hardware threads
+         */
+        static void estimate(const CLinearOctree & tree, size_t k, std::vector<CPoint> & normals,
+                             const CPoint * viewpoint = NULL, int threads = 0);
+
+        /*!
+         *  The normals of n points, by the index of the points, in a tree over their bounding cube
+         *  \see estimate(const CLinearOctree &, size_t, std::vector<CPoint> &, const CPoint *, int)
+         */
+        static void estimate(const CPoint * points, size_t n, size_t k, std::vector<CPoint> & normals,
+                             const CPoint * viewpoint = NULL, int threads = 0);
+
+    protected:
+        /*! the unit normal of the plane of the points, zero if they span none */
+        static CPoint _fit(const std::vector<CPoint> & points, const std::vector<std::pair<double, size_t>> & found);
+    };
+
+    inline CPoint CPointNormals::_fit(const std::vector<CPoint> & points, const std::vector<std::pair<double, size_t>> & found)
+    {
+        if (found.size() < 3) return CPoint(0, 0, 0);
+        // about the centroid, the sums of far away points lose the digits of the spread
+        Eigen::Vector3d c = Eigen::Vector3d::Zero();
+        for (const auto & f : found)
+        {
+            const CPoint & p = points[f.second];
+            c += Eigen::Vector3d(p[0], p[1], p[2]);
+        }
+        c /= (double)found.size();
+        Eigen::Matrix3d cov = Eigen::Matrix3d::Zero();
+        for (const auto & f : found)
+        {
+            const CPoint & p = points[f.second];
+            const Eigen::Vector3d d = Eigen::Vector3d(p[0], p[1], p[2]) - c;
+            cov.noalias() += d * d.transpose();
+        }
+
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+        solver.computeDirect(cov);
+        // the eigenvalues ascending, a line or a single point has two of them at zero
+        const Eigen::Vector3d & values = solver.eigenvalues();
+        if (!(values[1] > 0)) return CPoint(0, 0, 0);
+        const Eigen::Vector3d n = solver.eigenvectors().col(0).normalized();
+        return CPoint(n[0], n[1], n[2]);
+    }
+
+    inline void CPointNormals::estimate(const CLinearOctree & tree, size_t k, std::vector<CPoint> & normals,
+                                        const CPoint * viewpoint, int threads)
+    {
+        MESHLIB_TRACE_ZONE("estimate point normals");
+        const std::vector<CPoint> & points = tree.points();
+        normals.assign(points.size(), CPoint(0, 0, 0));
+        if (points.empty()) return;
+
+        CPoint toward;
+        if (viewpoint) toward = *viewpoint;
+        else
+        {
+            toward = parallel_reduce(points.size(), threads, CPoint(0, 0, 0),
+                [&](size_t b, size_t e, CPoint & sum) { for (size_t i = b; i < e; i++) sum += points[i]; },
+                [](const CPoint & a, const CPoint & b) { return a + b; });
+            toward /= (double)points.size();
+        }
+
+        // the points of a range are neighbours in Morton order, their queries walk the same nodes
+        parallel_for(points.size(), threads, [&](size_t b, size_t e)
+        {
+            std::vector<std::pair<double, size_t>> found;
+            for (size_t i = b; i < e; i++)
+            {
+                tree._nearest(points[i], k, found);
+                CPoint n = _fit(points, found);
+                // toward the viewpoint, or away from the centroid
+                const double side = n * (toward - points[i]);
+                if (viewpoint ? side < 0 : side > 0) n = -n;
+                normals[i] = n;
+            }
+        }, 256);
+    }
+
+    inline void CPointNormals::estimate(const CPoint * points, size_t n, size_t k, std::vector<CPoint> & normals,
+                                        const CPoint * viewpoint, int threads)
+    {
+        normals.assign(n, CPoint(0, 0, 0));
+        if (n == 0) return;
+        std::vector<CPoint> copy(points, points + n);
+        const CPointBounds box = CPointBounds::of(&copy[0][0], n, threads);
+        const CPoint extent = box.hi - box.lo;
+        // a little larger than the box, its far faces hold points too
+        const double half = std::max(std::max(extent[0], extent[1]), std::max(extent[2], 1e-12)) * 0.5 * (1 + 1e-6);
+        const CPoint center = (box.lo + box.hi) / 2.0;
+        CLinearOctree tree(center - CPoint(half, half, half), center + CPoint(half, half, half));
+        tree._construct(copy, s_depth, threads, s_leaf_size);
+        copy = std::vector<CPoint>();
+
+        std::vector<CPoint> sorted;
+        estimate(tree, k, sorted, viewpoint, threads);
+        const std::vector<size_t> & index = tree.indices();
+        parallel_for(sorted.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) normals[index[i]] = sorted[i];
+        });
+    }
+
+}; //namespace
+
+#endif
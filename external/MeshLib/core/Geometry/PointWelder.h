@@ -0,0 +1,147 @@
+/*!
+*      \file PointWelder.h
+*      \brief Merging the points of a mesh that lie within a tolerance of each other
+*
+*      Meshes exported per face, STL and many OBJ files, repeat every vertex
+*      for every face around it, so the faces share no vertex. The points go
+*      into cells of a little more than twice the tolerance, numbered in Morton order
+*      and sorted by it, so every cell is a range of one sorted array. A
+*      point within the tolerance of another is in its cell or in one next
+*      to it on the side of the nearer face of its cell, eight cells in all,
+*      each found by a binary search. Every point takes the first point
+*      within the tolerance of it, in the order of the input, and every
+*      point then the one its one took, so points chained by the tolerance
+*      merge into the first of them. The points are looked up in parallel
+*      and the result does not depend on the number of threads.
+*/
+
+#ifndef _MESHLIB_POINT_WELDER_H_
+#define _MESHLIB_POINT_WELDER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include "Point.h"
+#include "PointBounds.h"
+#include "LinearOctree.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPointWelder class
+     */
+    class CPointWelder
+    {
+    public:
+        /*!
+         *  Weld n points
+         *  \param tolerance points at most this far apart merge, 0 merges equal ones only
+         *  \param remap     the welded vertex of every point, numbered by their first point
+         *  \param unique    the first point of every welded vertex, in order
+         *  \param threads   number of threads, 0 uses all hardware threads
+         *  \return the number of welded vertices
+         */
+        static size_t weld(const CPoint * points, size_t n, double tolerance, std::vector<int> & remap, std::vector<int> & unique,
+                           int threads = 0);
+
+    protected:
+        //! cells of the finest depth of a 64 bit Morton code on an axis
+        static const uint32_t s_cells = (1u << CLinearOctree::s_max_depth) - 1;
+    };
+
+    inline size_t CPointWelder::weld(const CPoint * points, size_t n, double tolerance, std::vector<int> & remap, std::vector<int> & unique,
+                                     int threads)
+    {
+        remap.resize(n);
+        unique.clear();
+        if (n == 0) return 0;
+
+        // the cells are a little more than twice the tolerance, wider if the box has more than fit in a code
+        const CPointBounds box = CPointBounds::of(reinterpret_cast<const double *>(points), n, threads);
+        double extent = 0;
+        for (int d = 0; d < 3; d++) extent = std::max(extent, box.hi[d] - box.lo[d]);
+        const double size = std::max(2.001 * std::max(tolerance, 0.0), extent / s_cells);
+        const double scale = size > 0 ? 1 / size : 0;
+        const double t2 = std::max(tolerance, 0.0) * std::max(tolerance, 0.0);
+
+        // the cell of a point and where in it, points that are not finite get a cell of their own
+        auto cell = [&](const CPoint & p, uint32_t c[3], double f[3])
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                const double x = (p[d] - box.lo[d]) * scale;
+                if (!(x >= 0 && x <= s_cells)) return false;
+                c[d] = std::min((uint32_t)x, s_cells - 1);
+                f[d] = x - c[d];
+            }
+            return true;
+        };
+
+        std::vector<std::pair<uint64_t, int>> keys(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            uint32_t c[3];
+            double f[3];
+            for (size_t i = b; i < e; i++)
+                keys[i] = std::make_pair(cell(points[i], c, f) ? CLinearOctree::_morton(c[0], c[1], c[2]) : ~(uint64_t)0, (int)i);
+        });
+        parallel_sort(keys.begin(), keys.end(), threads, std::less<std::pair<uint64_t, int>>());
+
+        // the first point within the tolerance, the point itself if there is none before it
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            uint32_t c[3];
+            double f[3];
+            for (size_t i = b; i < e; i++)
+            {
+                int first = (int)i;
+                if (cell(points[i], c, f))
+                {
+                    const int side[3] = { f[0] < 0.5 ? -1 : 1, f[1] < 0.5 ? -1 : 1, f[2] < 0.5 ? -1 : 1 };
+                    for (int k = 0; k < 8; k++)
+                    {
+                        int64_t q[3];
+                        bool inside = true;
+                        for (int d = 0; d < 3; d++)
+                        {
+                            q[d] = (int64_t)c[d] + ((k >> d) & 1) * side[d];
+                            inside = inside && q[d] >= 0 && q[d] < (int64_t)s_cells;
+                        }
+                        if (!inside) continue;
+                        const uint64_t code = CLinearOctree::_morton((uint32_t)q[0], (uint32_t)q[1], (uint32_t)q[2]);
+                        // the points of the cell sorted by index, only those before the best so far matter
+                        auto it = std::lower_bound(keys.begin(), keys.end(), std::make_pair(code, 0));
+                        for (; it != keys.end() && it->first == code && it->second < first; ++it)
+                        {
+                            const CPoint d = points[it->second] - points[i];
+                            if (d * d <= t2) first = it->second;
+                        }
+                    }
+                }
+                remap[i] = first;
+            }
+        }, 1 << 12);
+
+        // the first point of a chain is before every point of it, so one pass in order follows the chains
+        for (size_t i = 0; i < n; i++)
+        {
+            if (remap[i] == (int)i)
+            {
+                remap[i] = (int)unique.size();
+                unique.push_back((int)i);
+            }
+            else remap[i] = remap[remap[i]];
+        }
+        MESHLIB_COUNTER_ADD("point_welder.merged", n - unique.size());
+        return unique.size();
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,351 @@
+/*!
+*      \file PoissonSampler.h
+*      \brief Poisson disk samples of a triangle surface, no two closer than a radius
+*
+*      Candidates are thrown on the triangles by area, as CSurfaceDistance
+*      does, candidate k at the area (k + x) A / n of the running sum of the
+*      areas for a random x, and across its triangle at a random step. They go
+*      into cells as wide as the radius, numbered in Morton order, so a sample
+*      only conflicts with those of its cell and of the 26 around it, which are
+*      listed once for every cell. Cells two apart on an axis share none of
+*      these, so the cells fall into 8 phases by the parity of their
+*      coordinates and the cells of one phase take a candidate each in
+*      parallel, against samples none of which changes during the phase. A
+*      round runs the phases in a random order and every cell tries its
+*      candidates in a random order, one per round, so that no phase fills its
+*      cells first, until none is left. Randomness comes from hashing the seed
+*      with the number of the candidate, so the samples do not depend on the
+*      number of threads.
+*/
+
+#ifndef _MESHLIB_POISSON_SAMPLER_H_
+#define _MESHLIB_POISSON_SAMPLER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <utility>
+#include <algorithm>
+#include "Point.h"
+#include "Point2.h"
+#include "Octree.h"
+#include "PointBounds.h"
+#include "LinearOctree.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPoissonSampler class
+     */
+    class CPoissonSampler
+    {
+    public:
+        /*!
+         *  Sample triangles
+         *  \param radius     no two samples are closer, raised to fit the box in 2^21 cells on an axis
+         *  \param samples    the samples, the point, uv and rgb interpolated over their triangle, in Morton order
+         *  \param candidates candidates thrown, 0 for s_density per radius squared of area
+         *  \param seed       different seeds give different samples
+         *  \param threads    number of threads, 0 uses all hardware threads
+         *  \return the number of samples
+         */
+        static size_t sample(const std::vector<CTriangle> & triangles, double radius, std::vector<CSample> & samples,
+                             size_t candidates = 0, uint64_t seed = 0, int threads = 0);
+
+        /*!
+         *  Sample the faces of a mesh, any CBaseMesh, polygons split into fans, the uv that of the halfedges,
+         *  the mesh has no colors and rgb is 0
+         */
+        template<typename M>
+        static size_t sample_faces(M & mesh, double radius, std::vector<CSample> & samples,
+                                   size_t candidates = 0, uint64_t seed = 0, int threads = 0);
+
+        //! candidates per radius squared of area, a maximal set has about 0.7 samples there and this gives 0.6
+        static const int s_density = 6;
+
+    protected:
+        //! cells of the finest depth of a 64 bit Morton code on an axis
+        static const uint32_t s_cells = (1u << CLinearOctree::s_max_depth) - 1;
+
+        //! samples of a cell as wide as the radius, at most one at every corner
+        static const int s_per_cell = 8;
+
+        /*! a well mixed 64 bit hash of x */
+        static uint64_t _mix(uint64_t x)
+        {
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+        /*! the bits set in v */
+        static int _popcount(uint64_t v)
+        {
+            v = v - ((v >> 1) & 0x5555555555555555ull);
+            v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+            v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            return (int)((v * 0x0101010101010101ull) >> 56);
+        }
+        /*! a number in [0, 1) from the hash of x */
+        static double _unit(uint64_t x) { return (_mix(x) >> 11) * (1.0 / 9007199254740992.0); }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline size_t CPoissonSampler::sample(const std::vector<CTriangle> & triangles, double radius, std::vector<CSample> & samples,
+                                          size_t candidates, uint64_t seed, int threads)
+    {
+        samples.clear();
+        const size_t m = triangles.size();
+        if (m == 0 || !(radius > 0)) return 0;
+
+        // the running sum of the areas, triangles that are not finite have none
+        std::vector<double> prefix(m + 1, 0);
+        parallel_for(m, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const CPoint * v = triangles[t].v;
+                const double area = ((v[1] - v[0]) ^ (v[2] - v[0])).norm() / 2;
+                prefix[t + 1] = std::isfinite(area) ? area : 0;
+            }
+        });
+        for (size_t t = 0; t < m; t++) prefix[t + 1] += prefix[t];
+        const double total = prefix[m];
+        if (total <= 0) return 0;
+        const size_t n = std::min<size_t>(candidates ? candidates : (size_t)std::ceil(s_density * total / (radius * radius)), 0xffffffffu);
+
+        // the candidates, where in their triangle, their point and the box of the points
+        std::vector<uint32_t> tri(n);
+        std::vector<CPoint2> weight(n);
+        std::vector<CPoint> points(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            size_t t = (size_t)(std::upper_bound(prefix.begin(), prefix.end(), b * total / n) - prefix.begin()) - 1;
+            for (size_t k = b; k < e; k++)
+            {
+                const double at = (k + _unit(seed ^ (2 * k))) * total / n;
+                while (t + 1 < m && prefix[t + 1] <= at) t++;
+                const double length = prefix[t + 1] - prefix[t];
+                const double u = length > 0 ? std::sqrt(std::min(1.0, std::max(0.0, (at - prefix[t]) / length))) : 0;
+                const double v = _unit(seed ^ (2 * k + 1));
+                const CPoint * c = triangles[t].v;
+                tri[k] = (uint32_t)t;
+                weight[k] = CPoint2(u * (1 - v), u * v);
+                points[k] = c[0] * (1 - u) + c[1] * (u * (1 - v)) + c[2] * (u * v);
+            }
+        });
+        const CPointBounds box = CPointBounds::of(reinterpret_cast<const double *>(points.data()), n, threads);
+        double extent = 0;
+        for (int d = 0; d < 3; d++) extent = std::max(extent, box.hi[d] - box.lo[d]);
+        const double size = std::max(radius, extent / s_cells);
+        const double scale = 1 / size;
+        const double r2 = size * size;
+
+        auto cell = [&](const CPoint & p, uint32_t c[3])
+        {
+            for (int d = 0; d < 3; d++) c[d] = std::min((uint32_t)std::max(0.0, (p[d] - box.lo[d]) * scale), s_cells - 1);
+        };
+
+        // the candidates sorted by cell and by a random priority in the cell
+        std::vector<std::pair<uint64_t, uint64_t>> keys(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            uint32_t c[3];
+            for (size_t k = b; k < e; k++)
+            {
+                cell(points[k], c);
+                keys[k] = std::make_pair(CLinearOctree::_morton(c[0], c[1], c[2]), (_mix(~seed ^ k) & 0xffffffff00000000ULL) | k);
+            }
+        });
+        parallel_sort(keys.begin(), keys.end(), threads, std::less<std::pair<uint64_t, uint64_t>>());
+
+        // the cells and their first candidate
+        std::vector<uint64_t> codes;
+        std::vector<size_t> begin;
+        for (size_t k = 0; k < n; k++)
+        {
+            if (k > 0 && keys[k].first == keys[k - 1].first) continue;
+            codes.push_back(keys[k].first);
+            begin.push_back(k);
+        }
+        const size_t cells = codes.size();
+        begin.push_back(n);
+
+        // the cells that share a face, an edge and a corner with every cell, by how near a sample in them can be.
+        // The codes of a block of 4 cells on an axis are a range of those of the cells, 6 bits below the code of
+        // the block, so a cell of a block is a bit of a mask, and its index the number of bits of the mask below it
+        // after the first of the block. The blocks around a block are found once for all of its cells
+        static const int offsets[26][3] = {
+            { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 },
+            { -1, -1, 0 }, { 1, -1, 0 }, { -1, 1, 0 }, { 1, 1, 0 }, { -1, 0, -1 }, { 1, 0, -1 },
+            { -1, 0, 1 }, { 1, 0, 1 }, { 0, -1, -1 }, { 0, 1, -1 }, { 0, -1, 1 }, { 0, 1, 1 },
+            { -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 }, { -1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 } };
+        std::vector<uint64_t> blocks, masks;
+        std::vector<size_t> first;
+        for (size_t i = 0; i < cells; i++)
+        {
+            if (i == 0 || codes[i] >> 6 != codes[i - 1] >> 6)
+            {
+                blocks.push_back(codes[i] >> 6);
+                masks.push_back(0);
+                first.push_back(i);
+            }
+            masks.back() |= 1ull << (codes[i] & 63);
+        }
+        first.push_back(cells);
+        std::vector<size_t> ring(cells + 1, 0);
+        std::vector<int> around;
+        auto neighbors = [&](size_t b, size_t e, bool write)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                uint32_t bc[3];
+                CLinearOctree::_compact(blocks[k], bc);
+                uint64_t mask[27];
+                size_t start[27];
+                for (int q = 0; q < 27; q++)
+                {
+                    const int64_t x = (int64_t)bc[0] + q % 3 - 1, y = (int64_t)bc[1] + q / 3 % 3 - 1, z = (int64_t)bc[2] + q / 9 - 1;
+                    mask[q] = 0;
+                    start[q] = 0;
+                    if (x < 0 || y < 0 || z < 0) continue;
+                    const uint64_t code = CLinearOctree::_morton((uint32_t)x, (uint32_t)y, (uint32_t)z);
+                    const size_t at = (size_t)(std::lower_bound(blocks.begin(), blocks.end(), code) - blocks.begin());
+                    if (at == blocks.size() || blocks[at] != code) continue;
+                    mask[q] = masks[at];
+                    start[q] = first[at];
+                }
+                for (size_t i = first[k]; i < first[k + 1]; i++)
+                {
+                    uint32_t c[3];
+                    CLinearOctree::_compact(codes[i] & 63, c);
+                    size_t found = write ? ring[i] : 0;
+                    for (int o = 0; o < 26; o++)
+                    {
+                        // the cell in the block q, 0 to 26 around the block, and its bit there
+                        const int x = (int)c[0] + offsets[o][0] + 4, y = (int)c[1] + offsets[o][1] + 4, z = (int)c[2] + offsets[o][2] + 4;
+                        const int q = (x >> 2) + 3 * (y >> 2) + 9 * (z >> 2);
+                        const int bit = (int)CLinearOctree::_morton(x & 3, y & 3, z & 3);
+                        if (!(mask[q] >> bit & 1)) continue;
+                        if (write) around[found] = (int)(start[q] + _popcount(mask[q] & ((1ull << bit) - 1)));
+                        found++;
+                    }
+                    if (!write) ring[i + 1] = found;
+                }
+            }
+        };
+        parallel_for(blocks.size(), threads, [&](size_t b, size_t e) { neighbors(b, e, false); }, 1 << 8);
+        for (size_t i = 0; i < cells; i++) ring[i + 1] += ring[i];
+        around.resize(ring[cells]);
+        parallel_for(blocks.size(), threads, [&](size_t b, size_t e) { neighbors(b, e, true); }, 1 << 8);
+
+        // the cells of every phase, by the parity of their coordinates
+        std::vector<std::vector<int>> phases(8);
+        for (size_t i = 0; i < cells; i++)
+        {
+            uint32_t c[3];
+            CLinearOctree::_compact(codes[i], c);
+            phases[(c[0] & 1) | (c[1] & 1) << 1 | (c[2] & 1) << 2].push_back((int)i);
+        }
+
+        // the samples of every cell, at most s_per_cell
+        std::vector<int> taken(s_per_cell * cells, -1);
+        std::vector<uint8_t> count(cells, 0);
+        std::vector<size_t> next(begin.begin(), begin.end() - 1);
+        size_t tried = 0;
+        for (uint64_t round = 0; ; round++)
+        {
+            int order[8];
+            for (int p = 0; p < 8; p++) order[p] = p;
+            for (int p = 7; p > 0; p--) std::swap(order[p], order[_mix(seed ^ (round << 8) ^ p) % (p + 1)]);
+
+            bool left = false;
+            for (int p : order)
+            {
+                std::vector<int> & phase = phases[p];
+                parallel_for(phase.size(), threads, [&](size_t b, size_t e)
+                {
+                    for (size_t i = b; i < e; i++)
+                    {
+                        const int x = phase[i];
+                        const int k = (int)(keys[next[x]++].second & 0xffffffffu);
+                        const CPoint & q = points[k];
+                        // the cell itself first, where a sample is nearest
+                        bool clear = true;
+                        for (size_t r = ring[x]; r <= ring[x + 1] && clear; r++)
+                        {
+                            const int w = r == ring[x] ? x : around[r - 1];
+                            for (int j = 0; j < count[w] && clear; j++)
+                            {
+                                const CPoint d = points[taken[s_per_cell * w + j]] - q;
+                                clear = d * d >= r2;
+                            }
+                        }
+                        if (clear) taken[s_per_cell * x + count[x]++] = k;
+                    }
+                }, 1 << 10);
+                tried += phase.size();
+
+                // the cells full or with no candidate left are done
+                phase.erase(std::remove_if(phase.begin(), phase.end(), [&](int x) { return count[x] == s_per_cell || next[x] == begin[x + 1]; }), phase.end());
+                left = left || !phase.empty();
+            }
+            if (!left) break;
+        }
+
+        // the samples in the order of their cells
+        std::vector<size_t> at(cells + 1, 0);
+        for (size_t i = 0; i < cells; i++) at[i + 1] = at[i] + count[i];
+        samples.resize(at[cells]);
+        parallel_for(cells, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+                for (int j = 0; j < count[i]; j++)
+                {
+                    const int k = taken[s_per_cell * i + j];
+                    const CTriangle & t = triangles[tri[k]];
+                    const double w1 = weight[k][0], w2 = weight[k][1], w0 = 1 - w1 - w2;
+                    CSample & s = samples[at[i] + j];
+                    s.point() = points[k];
+                    s.uv() = t.uv[0] * w0 + t.uv[1] * w1 + t.uv[2] * w2;
+                    s.rgb() = t.rgb[0] * w0 + t.rgb[1] * w1 + t.rgb[2] * w2;
+                }
+        });
+        MESHLIB_COUNTER_ADD("poisson_sampler.candidates_tried", tried);
+        MESHLIB_COUNTER_ADD("poisson_sampler.samples", samples.size());
+        return samples.size();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    inline size_t CPoissonSampler::sample_faces(M & mesh, double radius, std::vector<CSample> & samples,
+                                                size_t candidates, uint64_t seed, int threads)
+    {
+        std::vector<CTriangle> triangles;
+        for (auto * pf : mesh.faces())
+        {
+            auto * first = pf->halfedge();
+            auto * he = first->next();
+            while (he->next() != first)
+            {
+                CTriangle t;
+                t.v[0] = first->vertex()->point();
+                t.v[1] = he->vertex()->point();
+                t.v[2] = he->next()->vertex()->point();
+                t.uv[0] = first->uv();
+                t.uv[1] = he->uv();
+                t.uv[2] = he->next()->uv();
+                triangles.push_back(t);
+                he = he->next();
+            }
+        }
+        return sample(triangles, radius, samples, candidates, seed, threads);
+    }
+
+}; //namespace
+
+#endif
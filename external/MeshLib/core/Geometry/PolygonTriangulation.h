@@ -0,0 +1,129 @@
+/*!
+*      \file PolygonTriangulation.h
+*      \brief Triangulation of simple polygons, fan and ear clipping
+*
+*      Both methods emit triples of local corner indices 0..n-1 that keep
+*      the orientation of the polygon.
+*/
+
+#ifndef _MESHLIB_POLYGON_TRIANGULATION_H_
+#define _MESHLIB_POLYGON_TRIANGULATION_H_
+
+#include <vector>
+#include <cmath>
+
+#include "Point.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPolygonTriangulation class
+     */
+    class CPolygonTriangulation
+    {
+    public:
+        /*!
+         *  Fan triangulation around corner 0, exact for convex polygons
+         *  \param n     number of corners
+         *  \param tris  the n-2 triangles are appended here
+         */
+        static void fan(int n, std::vector<int> & tris)
+        {
+            for (int k = 1; k < n - 1; k++)
+            {
+                tris.push_back(0);
+                tris.push_back(k);
+                tris.push_back(k + 1);
+            }
+        }
+
+        /*!
+         *  Ear clipping triangulation, handles concave (non self-intersecting) polygons.
+         *  The polygon is projected onto the plane of its Newell normal. Degenerate
+         *  polygons, where no ear can be found, are finished with a fan.
+         *  \param n      number of corners
+         *  \param point  point(k) returns the position of corner k
+         *  \param tris   the n-2 triangles are appended here
+         */
+        template<typename Fn>
+        static void ear_clip(int n, Fn point, std::vector<int> & tris)
+        {
+            if (n <= 3) { fan(n, tris); return; }
+
+            std::vector<CPoint> p(n);
+            CPoint normal(0, 0, 0);
+            for (int k = 0; k < n; k++) p[k] = point(k);
+            for (int k = 0; k < n; k++)
+            {
+                const CPoint & a = p[k];
+                const CPoint & b = p[(k + 1) % n];
+                normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+                normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+                normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+            }
+
+            // drop the dominant axis, the projection keeps the orientation positive
+            int ax = 0;
+            for (int i = 1; i < 3; i++) if (fabs(normal[i]) > fabs(normal[ax])) ax = i;
+            int u = (ax + 1) % 3, v = (ax + 2) % 3;
+            double sign = normal[ax] < 0 ? -1 : 1;
+            std::vector<double> xs(n), ys(n);
+            for (int k = 0; k < n; k++)
+            {
+                xs[k] = p[k][u];
+                ys[k] = p[k][v] * sign;
+            }
+
+            auto cross = [&](int a, int b, int c)
+            {
+                return (xs[b] - xs[a]) * (ys[c] - ys[a]) - (ys[b] - ys[a]) * (xs[c] - xs[a]);
+            };
+
+            std::vector<int> ring(n);
+            for (int k = 0; k < n; k++) ring[k] = k;
+
+            int guard = 0;
+            int i = 0;
+            while (ring.size() > 3 && guard < (int)ring.size())
+            {
+                int m = (int)ring.size();
+                int a = ring[(i + m - 1) % m], b = ring[i % m], c = ring[(i + 1) % m];
+
+                bool ear = cross(a, b, c) > 0;
+                for (int k = 0; k < m && ear; k++)
+                {
+                    int q = ring[k];
+                    if (q == a || q == b || q == c) continue;
+                    ear = !(cross(a, b, q) >= 0 && cross(b, c, q) >= 0 && cross(c, a, q) >= 0);
+                }
+
+                if (ear)
+                {
+                    tris.push_back(a);
+                    tris.push_back(b);
+                    tris.push_back(c);
+                    ring.erase(ring.begin() + i % m);
+                    guard = 0;
+                    i = i % (m - 1);
+                }
+                else
+                {
+                    guard++;
+                    i = (i + 1) % m;
+                }
+            }
+
+            // the rest of the ring is degenerate or already a triangle
+            for (size_t k = 1; k + 1 < ring.size(); k++)
+            {
+                tris.push_back(ring[0]);
+                tris.push_back(ring[k]);
+                tris.push_back(ring[k + 1]);
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
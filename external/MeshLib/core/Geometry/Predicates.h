@@ -0,0 +1,329 @@
+/*!
+*      \file Predicates.h
+*      \brief Orientation and in-sphere tests with exact signs
+*
+*      The determinant is first evaluated in doubles together with a bound on its
+*      rounding error, computed from the same products taken in absolute value.
+*      Only when the result lies within the bound is it evaluated again exactly,
+*      on expansions: sums of doubles that do not overlap, after Shewchuk.
+*/
+
+#ifndef _MESHLIB_PREDICATES_H_
+#define _MESHLIB_PREDICATES_H_
+
+#include <vector>
+#include <cfloat>
+#include <cmath>
+#include "Point.h"
+#include "Point2.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPredicates class, orientation of points in two, three and four dimensions, and the in-sphere test
+     *
+     *  The sign of every result is exact for any double input, its magnitude
+     *  is only approximate.
+     */
+    class CPredicates
+    {
+    public:
+        /*!
+         *  Positive when a, b, c turn counterclockwise, negative when they turn
+         *  clockwise, 0 when they are on a line. The value is (b - a) ^ (c - a),
+         *  twice the signed area.
+         */
+        static double orient2d(const CPoint2 & a, const CPoint2 & b, const CPoint2 & c)
+        {
+            return orient2d(a[0], a[1], b[0], b[1], c[0], c[1]);
+        }
+
+        /*! orient2d of the points given by their coordinates */
+        static double orient2d(double ax, double ay, double bx, double by, double cx, double cy)
+        {
+            const double l = (bx - ax) * (cy - ay), r = (by - ay) * (cx - ax);
+            const double det = l - r;
+            const double bound = s_orient2d_bound * (std::fabs(l) + std::fabs(r));
+            if (det > bound || -det > bound) return det;
+            return orient2d_exact(ax, ay, bx, by, cx, cy);
+        }
+
+        /*! orient2d evaluated exactly, for the results a filter of its own left uncertain */
+        static double orient2d_exact(double ax, double ay, double bx, double by, double cx, double cy)
+        {
+            const double q[3][2] = { { ax, ay }, { bx, by }, { cx, cy } };
+            const double * p[3] = { q[0], q[1], q[2] };
+            return _exact(p, 2);
+        }
+
+        //! the relative error bound of orient2d, |det| above it times |l| + |r| has the exact sign
+        static constexpr double s_orient2d_bound = (3 + 16 * (DBL_EPSILON / 2)) * (DBL_EPSILON / 2);
+
+        /*!
+         *  Positive when d lies on the side of the plane through a, b, c that
+         *  (b - a) ^ (c - a) points to, negative on the other side, 0 on the plane.
+         *  The value is det[b - a; c - a; d - a], six times the signed volume.
+         */
+        static double orient3d(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d)
+        {
+            double m[3][3];
+            for (int j = 0; j < 3; j++)
+            {
+                m[0][j] = b[j] - a[j];
+                m[1][j] = c[j] - a[j];
+                m[2][j] = d[j] - a[j];
+            }
+            const double m12 = m[1][1] * m[2][2], m21 = m[1][2] * m[2][1];
+            const double m02 = m[1][0] * m[2][2], m20 = m[1][2] * m[2][0];
+            const double m01 = m[1][0] * m[2][1], m10 = m[1][1] * m[2][0];
+            const double det = m[0][0] * (m12 - m21) - m[0][1] * (m02 - m20) + m[0][2] * (m01 - m10);
+            const double permanent = std::fabs(m[0][0]) * (std::fabs(m12) + std::fabs(m21))
+                                   + std::fabs(m[0][1]) * (std::fabs(m02) + std::fabs(m20))
+                                   + std::fabs(m[0][2]) * (std::fabs(m01) + std::fabs(m10));
+            const double bound = (7 + 56 * s_epsilon) * s_epsilon * permanent;
+            if (det > bound || -det > bound) return det;
+
+            const double q[4][3] = { { a[0], a[1], a[2] }, { b[0], b[1], b[2] }, { c[0], c[1], c[2] }, { d[0], d[1], d[2] } };
+            const double * p[4] = { q[0], q[1], q[2], q[3] };
+            return _exact(p, 3);
+        }
+
+        /*!
+         *  The four dimensional orientation, det[b - a; c - a; d - a; e - a], of
+         *  points given by their four coordinates. With the fourth coordinate the
+         *  squared norm of the first three it is the in-sphere test.
+         */
+        static double orient4d(const double a[4], const double b[4], const double c[4], const double d[4], const double e[4])
+        {
+            double m[4][4];
+            for (int j = 0; j < 4; j++)
+            {
+                m[0][j] = b[j] - a[j];
+                m[1][j] = c[j] - a[j];
+                m[2][j] = d[j] - a[j];
+                m[3][j] = e[j] - a[j];
+            }
+            //2 x 2 minors of the last two rows, then 3 x 3 of the last three
+            double m2[4][4], p2[4][4];
+            for (int i = 0; i < 4; i++)
+                for (int j = i + 1; j < 4; j++)
+                {
+                    const double x = m[2][i] * m[3][j], y = m[2][j] * m[3][i];
+                    m2[i][j] = x - y;
+                    p2[i][j] = std::fabs(x) + std::fabs(y);
+                }
+            double m3[4], p3[4];
+            for (int k = 0; k < 4; k++)
+            {
+                int c[3], n = 0;
+                for (int j = 0; j < 4; j++) if (j != k) c[n++] = j;
+                m3[k] = m[1][c[0]] * m2[c[1]][c[2]] - m[1][c[1]] * m2[c[0]][c[2]] + m[1][c[2]] * m2[c[0]][c[1]];
+                p3[k] = std::fabs(m[1][c[0]]) * p2[c[1]][c[2]] + std::fabs(m[1][c[1]]) * p2[c[0]][c[2]] + std::fabs(m[1][c[2]]) * p2[c[0]][c[1]];
+            }
+            const double det = m[0][0] * m3[0] - m[0][1] * m3[1] + m[0][2] * m3[2] - m[0][3] * m3[3];
+            const double permanent = std::fabs(m[0][0]) * p3[0] + std::fabs(m[0][1]) * p3[1] + std::fabs(m[0][2]) * p3[2] + std::fabs(m[0][3]) * p3[3];
+            const double bound = (16 + 224 * s_epsilon) * s_epsilon * permanent;
+            if (det > bound || -det > bound) return det;
+
+            const double * p[5] = { a, b, c, d, e };
+            return _exact(p, 4);
+        }
+
+        /*!
+         *  Negative when e lies inside the sphere through a, b, c, d with orient3d(a, b, c, d)
+         *  positive, positive outside, 0 on the sphere. The value is orient4d of the points
+         *  lifted to the paraboloid, taken about a so that its sign stays exact: the lifts are
+         *  squared from the differences to a, in the filter and again exactly.
+         */
+        static double insphere(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d, const CPoint & e)
+        {
+            double m[4][4];
+            const CPoint * q[4] = { &b, &c, &d, &e };
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 3; j++) m[i][j] = (*q[i])[j] - a[j];
+                m[i][3] = m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2];
+            }
+            double m2[4][4], p2[4][4];
+            for (int i = 0; i < 4; i++)
+                for (int j = i + 1; j < 4; j++)
+                {
+                    const double x = m[2][i] * m[3][j], y = m[2][j] * m[3][i];
+                    m2[i][j] = x - y;
+                    p2[i][j] = std::fabs(x) + std::fabs(y);
+                }
+            double m3[4], p3[4];
+            for (int k = 0; k < 4; k++)
+            {
+                int c[3], n = 0;
+                for (int j = 0; j < 4; j++) if (j != k) c[n++] = j;
+                m3[k] = m[1][c[0]] * m2[c[1]][c[2]] - m[1][c[1]] * m2[c[0]][c[2]] + m[1][c[2]] * m2[c[0]][c[1]];
+                p3[k] = std::fabs(m[1][c[0]]) * p2[c[1]][c[2]] + std::fabs(m[1][c[1]]) * p2[c[0]][c[2]] + std::fabs(m[1][c[2]]) * p2[c[0]][c[1]];
+            }
+            const double det = m[0][0] * m3[0] - m[0][1] * m3[1] + m[0][2] * m3[2] - m[0][3] * m3[3];
+            const double permanent = std::fabs(m[0][0]) * p3[0] + std::fabs(m[0][1]) * p3[1] + std::fabs(m[0][2]) * p3[2] + std::fabs(m[0][3]) * p3[3];
+            //that of orient4d and the rounding of the lifts, a few more units each
+            const double bound = (32 + 512 * s_epsilon) * s_epsilon * permanent;
+            if (det > bound || -det > bound) return det;
+
+            CExpansion x[4][4];
+            for (int i = 0; i < 4; i++)
+            {
+                for (int j = 0; j < 3; j++)
+                {
+                    x[i][j] = _difference((*q[i])[j], a[j]);
+                    x[i][3] = _sum(x[i][3], _product(x[i][j], x[i][j]));
+                }
+            }
+            const CExpansion exact = _minor(x, 4, 0, 15);
+            return exact.empty() ? 0 : exact.back();
+        }
+
+    protected:
+        //! half a unit in the last place of 1, the relative rounding error
+        static constexpr double s_epsilon = DBL_EPSILON / 2;
+
+        typedef std::vector<double> CExpansion;
+
+        /* x + y = a + b exactly, x the rounded sum */
+        static void _two_sum(double a, double b, double & x, double & y)
+        {
+            x = a + b;
+            const double bv = x - a, av = x - bv;
+            y = (a - av) + (b - bv);
+        }
+
+        /* x + y = a * b exactly; fma keeps the error exact whether or not products are contracted */
+        static void _two_product(double a, double b, double & x, double & y)
+        {
+            x = a * b;
+            y = std::fma(a, b, -x);
+        }
+
+        /* h = e + f, the fast expansion sum of Shewchuk with zeros dropped */
+        static CExpansion _sum(const CExpansion & e, const CExpansion & f)
+        {
+            CExpansion h;
+            if (e.empty()) return f;
+            if (f.empty()) return e;
+            h.reserve(e.size() + f.size());
+            size_t i = 0, j = 0;
+            double q, x, y;
+            double enow = e[0], fnow = f[0];
+            if ((fnow > enow) == (fnow > -enow)) { q = enow; i++; }
+            else { q = fnow; j++; }
+            if (i < e.size() && j < f.size())
+            {
+                enow = e[i]; fnow = f[j];
+                if ((fnow > enow) == (fnow > -enow))
+                {
+                    x = enow + q; y = q - (x - enow); i++;
+                }
+                else
+                {
+                    x = fnow + q; y = q - (x - fnow); j++;
+                }
+                q = x;
+                if (y != 0) h.push_back(y);
+                while (i < e.size() && j < f.size())
+                {
+                    enow = e[i]; fnow = f[j];
+                    if ((fnow > enow) == (fnow > -enow)) { _two_sum(q, enow, x, y); i++; }
+                    else { _two_sum(q, fnow, x, y); j++; }
+                    q = x;
+                    if (y != 0) h.push_back(y);
+                }
+            }
+            for (; i < e.size(); i++)
+            {
+                _two_sum(q, e[i], x, y);
+                q = x;
+                if (y != 0) h.push_back(y);
+            }
+            for (; j < f.size(); j++)
+            {
+                _two_sum(q, f[j], x, y);
+                q = x;
+                if (y != 0) h.push_back(y);
+            }
+            if (q != 0 || h.empty()) h.push_back(q);
+            return h;
+        }
+
+        /* h = e * b, zeros dropped */
+        static CExpansion _scale(const CExpansion & e, double b)
+        {
+            CExpansion h;
+            if (e.empty()) return h;
+            h.reserve(2 * e.size());
+            double q, x, y, p, s;
+            _two_product(e[0], b, q, y);
+            if (y != 0) h.push_back(y);
+            for (size_t i = 1; i < e.size(); i++)
+            {
+                _two_product(e[i], b, p, s);
+                _two_sum(q, s, x, y);
+                if (y != 0) h.push_back(y);
+                _two_sum(p, x, q, y);
+                if (y != 0) h.push_back(y);
+            }
+            if (q != 0 || h.empty()) h.push_back(q);
+            return h;
+        }
+
+        static CExpansion _product(const CExpansion & e, const CExpansion & f)
+        {
+            CExpansion h;
+            for (double x : f) h = _sum(h, _scale(e, x));
+            return h;
+        }
+
+        static CExpansion _negate(CExpansion e)
+        {
+            for (double & x : e) x = -x;
+            return e;
+        }
+
+        /* the minor of rows row.. n - 1 and the columns left in mask, by cofactors along row */
+        static CExpansion _minor(const CExpansion m[4][4], int n, int row, int mask)
+        {
+            CExpansion det;
+            int sign = 1;
+            for (int j = 0; j < n; j++)
+            {
+                if (!(mask & (1 << j))) continue;
+                CExpansion term = row == n - 1 ? m[row][j] : _product(m[row][j], _minor(m, n, row + 1, mask & ~(1 << j)));
+                det = _sum(det, sign > 0 ? term : _negate(term));
+                sign = -sign;
+            }
+            return det;
+        }
+
+        /* a - b exactly, the rounded difference and its error */
+        static CExpansion _difference(double a, double b)
+        {
+            CExpansion h;
+            const double x = a - b;
+            const double bv = a - x, av = x + bv;
+            const double y = (a - av) + (bv - b);
+            if (y != 0) h.push_back(y);
+            h.push_back(x);
+            return h;
+        }
+
+        /* the n x n determinant of the differences p[i + 1] - p[0], exactly, rounded in the end */
+        static double _exact(const double * const * p, int n)
+        {
+            CExpansion m[4][4];
+            for (int i = 0; i < n; i++)
+                for (int j = 0; j < n; j++) m[i][j] = _difference(p[i + 1][j], p[0][j]);
+            const CExpansion det = _minor(m, n, 0, (1 << n) - 1);
+            //the largest component comes last and carries the sign
+            return det.empty() ? 0 : det.back();
+        }
+    };
+
+}; //namespace
+
+#endif
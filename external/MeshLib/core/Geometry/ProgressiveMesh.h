@@ -0,0 +1,358 @@
+/*!
+*      \file ProgressiveMesh.h
+*      \brief A coarse mesh and the vertex splits that refine it, for streaming
+*
+*      Hoppe, Progressive Meshes, 1996, over the half edge collapses of
+*      CMeshSimplifier. The mesh is simplified as far as it goes and the
+*      collapses are replayed to record what each of them did; undone in
+*      reverse order they are the records. A record brings back the vertex a
+*      collapse moved, the triangles it removed and the corners it moved, so a
+*      client applying the records in order holds exactly the mesh the
+*      simplifier had at that point and may stop anywhere.
+*
+*      Vertices and triangles are numbered in the order they arrive, those of
+*      the base first, so a record only appends to the vertex and index
+*      buffers and overwrites some indices. The vertices are quantized as the
+*      viewer lays them out: 16 bit positions in the bounds, half float uvs
+*      and octahedral normals in the coordinates of the quantized positions,
+*      16 bytes each, see CVertexQuantizer.
+*
+*      The encodings are little endian. The base is the vertices followed by
+*      three indices per triangle; a record is its vertex, the error of the
+*      mesh once it is applied, the number of triangles and of moved corners,
+*      three indices per triangle and the positions in the index buffer of
+*      the corners, which become the new vertex.
+*/
+
+#ifndef _MESHLIB_PROGRESSIVE_MESH_H_
+#define _MESHLIB_PROGRESSIVE_MESH_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include "MeshSimplifier.h"
+#include "VertexQuantizer.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief a quantized vertex, 16 bytes
+     */
+    struct CPmVertex
+    {
+        int16_t  position[4];   //!< snorm16 in the bounds, the fourth is 0
+        uint16_t uv[2];         //!< half floats
+        int16_t  normal[2];     //!< octahedral
+    };
+
+    /*!
+     *  \brief what a client needs before the base
+     */
+    struct CPmHeader
+    {
+        char     magic[4];          //!< "PMX\x1a"
+        uint32_t version;
+        uint32_t vertices;          //!< all of them, the base ones included
+        uint32_t triangles;
+        uint32_t base_vertices;
+        uint32_t base_triangles;
+        uint32_t records;
+        uint32_t with_uv;
+        float    lo[3], hi[3];      //!< the bounds the positions are quantized in
+        float    base_error;        //!< the error of the base
+    };
+
+    /*!
+     *  \brief a decoded record, its arrays point into the encoding
+     */
+    struct CPmRecord
+    {
+        CPmVertex        vertex;
+        float            error;
+        uint32_t         triangles;
+        const uint32_t * indices;   //!< three per triangle
+        uint32_t         corners;
+        const uint32_t * positions; //!< in the index buffer, set to the new vertex
+    };
+
+    /*!
+     *  \brief CProgressiveMesh class
+     */
+    class CProgressiveMesh
+    {
+    public:
+        static const uint32_t s_version = 1;
+
+        /*!
+         *  Simplify the mesh to its base and record the splits back
+         *  \param indices  three vertex indices per triangle
+         *  \param n        number of indices
+         *  \param vertices 8 floats per vertex, point, normal and uv, as write_mtx_file
+         *  \param nv       number of vertices
+         *  \param with_uv  whether the uvs are meaningful
+         *  \param threads  number of threads, 0 uses all hardware threads
+         */
+        void build(const uint32_t * indices, size_t n, const float * vertices, size_t nv, bool with_uv, int threads = 0);
+
+        const CPmHeader & header() const { return m_header; }
+        size_t records() const { return m_header.records; }
+        /*! the error of the mesh once records 0 to r are applied, the largest move of a collapse left */
+        float error(size_t r) const { return m_error[r]; }
+
+        /*! append the vertices and the triangles of the base to out */
+        void encode_base(std::vector<uint8_t> & out) const;
+        /*! append records begin to end to out */
+        void encode_records(size_t begin, size_t end, std::vector<uint8_t> & out) const;
+
+        /*!
+         *  Decode the records of encode_records
+         *  \param data   the encoding, 4 byte aligned
+         *  \param record record(const CPmRecord &) for each in order
+         *  \return the number of records, or -1 if the encoding is cut or malformed
+         */
+        template<typename Record>
+        static long long decode_records(const uint8_t * data, size_t bytes, Record record);
+
+    protected:
+        CPmHeader              m_header;
+        //! the quantized vertices, by the order they arrive
+        std::vector<CPmVertex> m_vertices;
+        std::vector<uint32_t>  m_base;
+        //! per record its triangles and its corners, from the begin entries to the next ones
+        std::vector<uint32_t>  m_triangle_begin, m_triangles;
+        std::vector<uint32_t>  m_corner_begin, m_corners;
+        std::vector<float>     m_error;
+
+        static void _append(std::vector<uint8_t> & out, const void * p, size_t bytes)
+        {
+            const uint8_t * b = (const uint8_t *)p;
+            out.insert(out.end(), b, b + bytes);
+        }
+    };
+
+    inline void CProgressiveMesh::build(const uint32_t * indices, size_t n, const float * vertices, size_t nv, bool with_uv, int threads)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+        std::memcpy(m_header.magic, "PMX\x1a", 4);
+        m_header.version = s_version;
+        m_header.with_uv = with_uv ? 1 : 0;
+        m_vertices.clear();
+        m_base.clear();
+        m_triangle_begin.assign(1, 0);
+        m_triangles.clear();
+        m_corner_begin.assign(1, 0);
+        m_corners.clear();
+        m_error.clear();
+
+        std::vector<float> points(3 * nv);
+        for (size_t v = 0; v < nv; v++)
+            for (int d = 0; d < 3; d++) points[3 * v + d] = vertices[8 * v + d];
+
+        CMeshSimplifier simplifier(indices, n, points.data(), nv, threads);
+        simplifier.simplify(0, threads);
+        const std::vector<std::pair<uint32_t, uint32_t>> & collapses = simplifier.collapses();
+        const size_t m = collapses.size();
+
+        // replay the collapses, the triangles each kills, their corners then, and the corners it moves
+        const size_t nt = n / 3;
+        std::vector<uint32_t> current(indices, indices + 3 * nt);
+        std::vector<char> dead(nt, 0);
+        std::vector<std::vector<uint32_t>> around(nv);
+        for (size_t t = 0; t < nt; t++)
+        {
+            const uint32_t * c = &current[3 * t];
+            if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0]) dead[t] = 1;
+            else for (int k = 0; k < 3; k++) around[c[k]].push_back((uint32_t)t);
+        }
+        std::vector<uint32_t> killed_begin(1, 0), killed, killed_corners;
+        std::vector<uint32_t> moved_begin(1, 0), moved;
+        std::vector<float> move(m);
+        for (size_t j = 0; j < m; j++)
+        {
+            const uint32_t from = collapses[j].first, to = collapses[j].second;
+            float d2 = 0;
+            for (int d = 0; d < 3; d++) d2 += (points[3 * from + d] - points[3 * to + d]) * (points[3 * from + d] - points[3 * to + d]);
+            move[j] = std::sqrt(d2);
+            for (uint32_t t : around[from])
+            {
+                if (dead[t]) continue;
+                uint32_t * c = &current[3 * t];
+                if (c[0] == to || c[1] == to || c[2] == to)
+                {
+                    dead[t] = 1;
+                    killed.push_back(t);
+                    killed_corners.insert(killed_corners.end(), c, c + 3);
+                    continue;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    if (c[k] != from) continue;
+                    c[k] = to;
+                    moved.push_back((uint32_t)(3 * t + k));
+                }
+                around[to].push_back(t);
+            }
+            std::vector<uint32_t>().swap(around[from]);
+            killed_begin.push_back((uint32_t)killed.size());
+            moved_begin.push_back((uint32_t)moved.size());
+        }
+        std::vector<std::vector<uint32_t>>().swap(around);
+
+        // the vertices of the base first, then those the collapses moved, the last collapse first
+        const uint32_t none = UINT32_MAX;
+        std::vector<uint32_t> rank(nv, none), order;
+        // a vertex the collapses left without triangles is still one of the base, the records name it
+        std::vector<char> referenced(nv, 0), collapsed(nv, 0);
+        for (size_t t = 0; t < nt; t++)
+        {
+            const uint32_t * c = &indices[3 * t];
+            if (c[0] != c[1] && c[1] != c[2] && c[2] != c[0]) for (int k = 0; k < 3; k++) referenced[c[k]] = 1;
+        }
+        for (size_t j = 0; j < m; j++) collapsed[collapses[j].first] = 1;
+        for (size_t v = 0; v < nv; v++)
+        {
+            if (!referenced[v] || collapsed[v]) continue;
+            rank[v] = (uint32_t)order.size();
+            order.push_back((uint32_t)v);
+        }
+        const size_t base_vertices = order.size();
+        for (size_t j = m; j-- > 0;)
+        {
+            rank[collapses[j].first] = (uint32_t)order.size();
+            order.push_back(collapses[j].first);
+        }
+
+        std::vector<uint32_t> number(nt, none);
+        uint32_t triangles = 0;
+        for (size_t t = 0; t < nt; t++)
+        {
+            if (dead[t]) continue;
+            number[t] = triangles++;
+            for (int k = 0; k < 3; k++) m_base.push_back(rank[current[3 * t + k]]);
+        }
+        const size_t base_triangles = triangles;
+
+        // undo the collapses, the triangles a record brings back get the next numbers
+        m_error.resize(m);
+        float worst = 0;
+        for (size_t j = 0; j < m; j++)
+        {
+            m_error[m - 1 - j] = worst;
+            worst = std::max(worst, move[j]);
+        }
+        for (size_t j = m; j-- > 0;)
+        {
+            for (uint32_t i = killed_begin[j]; i < killed_begin[j + 1]; i++)
+            {
+                number[killed[i]] = triangles++;
+                for (int k = 0; k < 3; k++) m_triangles.push_back(rank[killed_corners[3 * i + k]]);
+            }
+            for (uint32_t i = moved_begin[j]; i < moved_begin[j + 1]; i++)
+                m_corners.push_back(3 * number[moved[i] / 3] + moved[i] % 3);
+            m_triangle_begin.push_back((uint32_t)(m_triangles.size() / 3));
+            m_corner_begin.push_back((uint32_t)m_corners.size());
+        }
+
+        // the bounds, then the vertices quantized in them
+        float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (uint32_t v : order)
+            for (int d = 0; d < 3; d++)
+            {
+                lo[d] = std::min(lo[d], points[3 * v + d]);
+                hi[d] = std::max(hi[d], points[3 * v + d]);
+            }
+        if (order.empty()) for (int d = 0; d < 3; d++) lo[d] = hi[d] = 0;
+        float scale[3], offset[3], inv[3];
+        for (int d = 0; d < 3; d++)
+        {
+            scale[d] = (hi[d] - lo[d]) / 2;
+            offset[d] = (hi[d] + lo[d]) / 2;
+            inv[d] = scale[d] > 0 ? 1 / scale[d] : 0;
+        }
+        m_vertices.resize(order.size());
+        parallel_for(order.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const float * p = &vertices[8 * order[i]];
+                CPmVertex & q = m_vertices[i];
+                for (int d = 0; d < 3; d++) q.position[d] = CVertexQuantizer::snorm16((p[d] - offset[d]) * inv[d]);
+                q.position[3] = 0;
+                for (int d = 0; d < 2; d++) q.uv[d] = CVertexQuantizer::half(with_uv ? p[6 + d] : 0.0f);
+                // a normal of the quantized positions scales the other way
+                float normal[3] = { p[3] * scale[0], p[4] * scale[1], p[5] * scale[2] };
+                if (normal[0] == 0 && normal[1] == 0 && normal[2] == 0) normal[2] = 1;
+                CVertexQuantizer::octahedral(normal, q.normal);
+            }
+        }, 1 << 12);
+
+        m_header.vertices = (uint32_t)order.size();
+        m_header.triangles = triangles;
+        m_header.base_vertices = (uint32_t)base_vertices;
+        m_header.base_triangles = (uint32_t)base_triangles;
+        m_header.records = (uint32_t)m;
+        for (int d = 0; d < 3; d++)
+        {
+            m_header.lo[d] = lo[d];
+            m_header.hi[d] = hi[d];
+        }
+        m_header.base_error = worst;
+    }
+
+    inline void CProgressiveMesh::encode_base(std::vector<uint8_t> & out) const
+    {
+        _append(out, m_vertices.data(), m_header.base_vertices * sizeof(CPmVertex));
+        _append(out, m_base.data(), m_base.size() * sizeof(uint32_t));
+    }
+
+    inline void CProgressiveMesh::encode_records(size_t begin, size_t end, std::vector<uint8_t> & out) const
+    {
+        end = std::min(end, records());
+        for (size_t r = begin; r < end; r++)
+        {
+            const uint32_t triangles = m_triangle_begin[r + 1] - m_triangle_begin[r];
+            const uint32_t corners = m_corner_begin[r + 1] - m_corner_begin[r];
+            _append(out, &m_vertices[m_header.base_vertices + r], sizeof(CPmVertex));
+            _append(out, &m_error[r], sizeof(float));
+            _append(out, &triangles, sizeof(uint32_t));
+            _append(out, &corners, sizeof(uint32_t));
+            _append(out, &m_triangles[3 * m_triangle_begin[r]], 3 * triangles * sizeof(uint32_t));
+            _append(out, &m_corners[m_corner_begin[r]], corners * sizeof(uint32_t));
+        }
+    }
+
+    template<typename Record>
+    inline long long CProgressiveMesh::decode_records(const uint8_t * data, size_t bytes, Record record)
+    {
+        const size_t fixed = sizeof(CPmVertex) + sizeof(float) + 2 * sizeof(uint32_t);
+        long long count = 0;
+        size_t at = 0;
+        while (at < bytes)
+        {
+            if (bytes - at < fixed) return -1;
+            CPmRecord r;
+            std::memcpy(&r.vertex, data + at, sizeof(CPmVertex));
+            std::memcpy(&r.error, data + at + sizeof(CPmVertex), sizeof(float));
+            std::memcpy(&r.triangles, data + at + sizeof(CPmVertex) + 4, sizeof(uint32_t));
+            std::memcpy(&r.corners, data + at + sizeof(CPmVertex) + 8, sizeof(uint32_t));
+            at += fixed;
+            const size_t rest = (3 * (size_t)r.triangles + r.corners) * sizeof(uint32_t);
+            if (bytes - at < rest) return -1;
+            r.indices = (const uint32_t *)(data + at);
+            r.positions = r.indices + 3 * (size_t)r.triangles;
+            at += rest;
+            record(r);
+            count++;
+        }
+        return count;
+    }
+
+}; //namespace
+
+#endif
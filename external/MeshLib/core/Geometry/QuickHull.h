@@ -0,0 +1,470 @@
+/*!
+*      \file QuickHull.h
+*      \brief Convex hulls of large three dimensional point sets
+*
+*      The points inside the hull of a few extreme points are dropped first, the
+*      Akl-Toussaint heuristic. The rest is cut into chunks whose hulls are built
+*      in parallel, and the hull of all their vertices is the result. Every hull
+*      is a quickhull: each face keeps the points above it, its conflict list,
+*      and the farthest of them is added next.
+*/
+
+#ifndef _MESHLIB_QUICK_HULL_H_
+#define _MESHLIB_QUICK_HULL_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include "Point.h"
+#include "Predicates.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CQuickHull class, the convex hull of points as triangles
+     *
+     *  Points closer than a rounding tolerance to a face count as on it, so
+     *  coplanar points do not add vertices, and flat or collinear input gives an
+     *  empty hull. Which faces a new vertex sees is decided by exact orientation
+     *  tests, so the faces around it always close up.
+     */
+    class CQuickHull
+    {
+    public:
+        /*!
+         *  Build the hull
+         *  \param points  number of points, point(i) is point i as a CPoint
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        template<typename Point>
+        void _construct(size_t points, Point point, int threads = 0);
+
+        void _construct(const std::vector<CPoint> & points, int threads = 0)
+        {
+            _construct(points.size(), [&points](size_t i) { return points[i]; }, threads);
+        }
+
+        void clear()
+        {
+            m_triangles.clear();
+            m_vertices.clear();
+        }
+
+        bool empty() const { return m_triangles.empty(); }
+        /*! three point indices per face, counterclockwise seen from outside */
+        const std::vector<uint32_t> & triangles() const { return m_triangles; }
+        /*! the points on the hull, in increasing order */
+        const std::vector<uint32_t> & vertices() const { return m_vertices; }
+
+        //! chunks hold at least this many points
+        static const size_t s_parallel_points = 1 << 16;
+
+    protected:
+        struct CFace
+        {
+            uint32_t v[3];
+            uint32_t adj[3];                 //!< the face across edge v[i], v[i + 1]
+            CPoint   normal;
+            double   offset;
+            std::vector<uint32_t> outside;   //!< the conflict list, the farthest point first
+            double   farthest = 0;           //!< the height of outside.front() above the face
+            uint32_t visit = 0;
+            bool     visible = false;
+            bool     alive = true;
+
+            double distance(const CPoint & p) const { return normal * p - offset; }
+        };
+
+        /*! one quickhull over some of the points */
+        struct CBuilder
+        {
+            const CPoint *     pts;
+            double             eps;
+            int                threads;
+            std::vector<CFace> faces;
+            uint32_t           stamp = 0;
+            //scratch space of _add and _assign, kept between the steps
+            std::vector<uint32_t> visible, stack, orphans, target, cone;
+            std::vector<uint32_t> unused;    //!< faces removed, to be taken again
+            std::vector<std::pair<uint32_t, int>> horizon;
+            std::vector<std::pair<uint32_t, uint32_t>> starts;
+
+            CBuilder(const CPoint * points, double tolerance, int n) : pts(points), eps(tolerance), threads(n) {}
+
+            /*! the hull of points, false if they are flat */
+            bool run(std::vector<uint32_t> & points);
+            /*! the faces of the hull, three point indices each */
+            void triangles(std::vector<uint32_t> & tris) const;
+
+            uint32_t _face(uint32_t a, uint32_t b, uint32_t c);
+            /*! move points to the conflict lists of faces cone */
+            void _assign(const std::vector<uint32_t> & points);
+            void _add(uint32_t f);
+        };
+
+        /*! the extremes along the axes and four diagonals, their ranks and the bounds of |x|, |y|, |z| */
+        struct CExtremes
+        {
+            double   lo[7], hi[7];
+            uint32_t ilo[7], ihi[7];
+            double   reach[3];
+        };
+
+        static void _directions(const CPoint & p, double s[7])
+        {
+            s[0] = p[0]; s[1] = p[1]; s[2] = p[2];
+            s[3] = p[0] + p[1] + p[2];
+            s[4] = p[0] + p[1] - p[2];
+            s[5] = p[0] - p[1] + p[2];
+            s[6] = -p[0] + p[1] + p[2];
+        }
+
+        std::vector<uint32_t> m_triangles;
+        std::vector<uint32_t> m_vertices;
+    };
+
+    template<typename Point>
+    inline void CQuickHull::_construct(size_t points, Point point, int threads)
+    {
+        clear();
+        if (points < 4) return;
+
+        CExtremes none;
+        for (int k = 0; k < 7; k++)
+        {
+            none.lo[k] = DBL_MAX; none.hi[k] = -DBL_MAX;
+            none.ilo[k] = none.ihi[k] = 0;
+        }
+        none.reach[0] = none.reach[1] = none.reach[2] = 0;
+        const CExtremes ext = parallel_reduce(points, threads, none, [&](size_t b, size_t e, CExtremes & acc)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const CPoint p = point(i);
+                double s[7];
+                _directions(p, s);
+                for (int k = 0; k < 7; k++)
+                {
+                    if (s[k] < acc.lo[k]) { acc.lo[k] = s[k]; acc.ilo[k] = (uint32_t)i; }
+                    if (s[k] > acc.hi[k]) { acc.hi[k] = s[k]; acc.ihi[k] = (uint32_t)i; }
+                }
+                for (int a = 0; a < 3; a++) acc.reach[a] = std::max(acc.reach[a], std::fabs(p[a]));
+            }
+        }, [](CExtremes a, const CExtremes & c)
+        {
+            for (int k = 0; k < 7; k++)
+            {
+                if (c.lo[k] < a.lo[k]) { a.lo[k] = c.lo[k]; a.ilo[k] = c.ilo[k]; }
+                if (c.hi[k] > a.hi[k]) { a.hi[k] = c.hi[k]; a.ihi[k] = c.ihi[k]; }
+            }
+            for (int i = 0; i < 3; i++) a.reach[i] = std::max(a.reach[i], c.reach[i]);
+            return a;
+        });
+        //the rounding error of a distance to a plane
+        const double eps = 3 * DBL_EPSILON * (ext.reach[0] + ext.reach[1] + ext.reach[2]);
+
+        //the hull of the extremes, the points well inside it are dropped
+        std::vector<uint32_t> extremes;
+        for (int k = 0; k < 7; k++)
+        {
+            extremes.push_back(ext.ilo[k]);
+            extremes.push_back(ext.ihi[k]);
+        }
+        std::sort(extremes.begin(), extremes.end());
+        extremes.erase(std::unique(extremes.begin(), extremes.end()), extremes.end());
+        std::vector<CPoint> corners;
+        for (uint32_t i : extremes) corners.push_back(point(i));
+        CBuilder filter(corners.data(), eps, 1);
+        std::vector<uint32_t> all(corners.size());
+        for (uint32_t i = 0; i < all.size(); i++) all[i] = i;
+        std::vector<uint32_t> ptris;
+        if (filter.run(all)) filter.triangles(ptris);
+        std::vector<CPoint> normals;
+        std::vector<double> offsets;
+        for (size_t f = 0; f < ptris.size(); f += 3)
+        {
+            const CPoint a = corners[ptris[f]], b = corners[ptris[f + 1]], c = corners[ptris[f + 2]];
+            CPoint n = (b - a) ^ (c - a);
+            const double len = n.norm();
+            if (len == 0) continue;
+            n /= len;
+            normals.push_back(n);
+            offsets.push_back(n * a - eps);
+        }
+
+        const size_t chunks = std::max<size_t>(1, std::min<size_t>(points / s_parallel_points, (size_t)resolve_threads(threads) * 4));
+        std::vector<std::vector<uint32_t>> kept(chunks);
+        std::vector<std::vector<CPoint>> kept_points(chunks);
+        parallel_for(chunks, threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++)
+                for (size_t i = points * c / chunks; i < points * (c + 1) / chunks; i++)
+                {
+                    const CPoint p = point(i);
+                    bool inside = !normals.empty();
+                    for (size_t f = 0; f < normals.size() && inside; f++) inside = normals[f] * p < offsets[f];
+                    if (inside) continue;
+                    kept[c].push_back((uint32_t)i);
+                    kept_points[c].push_back(p);
+                }
+        }, 1);
+
+        //the hulls of the chunks, their vertices gathered
+        std::vector<uint32_t> ids;
+        std::vector<CPoint> pts;
+        std::vector<std::vector<uint32_t>> hulls(chunks);
+        parallel_for(chunks, threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++)
+            {
+                std::vector<uint32_t> local(kept[c].size());
+                for (uint32_t i = 0; i < local.size(); i++) local[i] = i;
+                CBuilder builder(kept_points[c].data(), eps, 1);
+                if (chunks == 1 || !builder.run(local))
+                {
+                    hulls[c].swap(local);
+                    continue;
+                }
+                std::vector<uint32_t> tris;
+                builder.triangles(tris);
+                std::sort(tris.begin(), tris.end());
+                tris.erase(std::unique(tris.begin(), tris.end()), tris.end());
+                hulls[c].swap(tris);
+            }
+        }, 1);
+        for (size_t c = 0; c < chunks; c++)
+        {
+            for (uint32_t i : hulls[c])
+            {
+                ids.push_back(kept[c][i]);
+                pts.push_back(kept_points[c][i]);
+            }
+            kept[c] = std::vector<uint32_t>();
+            kept_points[c] = std::vector<CPoint>();
+        }
+
+        std::vector<uint32_t> local(pts.size());
+        for (uint32_t i = 0; i < local.size(); i++) local[i] = i;
+        CBuilder builder(pts.data(), eps, threads);
+        if (!builder.run(local)) return;
+        builder.triangles(m_triangles);
+        for (uint32_t & v : m_triangles) v = ids[v];
+        m_vertices = m_triangles;
+        std::sort(m_vertices.begin(), m_vertices.end());
+        m_vertices.erase(std::unique(m_vertices.begin(), m_vertices.end()), m_vertices.end());
+    }
+
+    inline uint32_t CQuickHull::CBuilder::_face(uint32_t a, uint32_t b, uint32_t c)
+    {
+        CFace f;
+        f.v[0] = a; f.v[1] = b; f.v[2] = c;
+        f.adj[0] = f.adj[1] = f.adj[2] = 0;
+        f.normal = (pts[b] - pts[a]) ^ (pts[c] - pts[a]);
+        const double len = f.normal.norm();
+        if (len > 0) f.normal /= len;
+        f.offset = f.normal * pts[a];
+        //the faces removed by earlier steps are taken first
+        if (unused.empty())
+        {
+            faces.push_back(std::move(f));
+            return (uint32_t)faces.size() - 1;
+        }
+        const uint32_t i = unused.back();
+        unused.pop_back();
+        faces[i] = std::move(f);
+        return i;
+    }
+
+    inline bool CQuickHull::CBuilder::run(std::vector<uint32_t> & points)
+    {
+        faces.clear();
+        unused.clear();
+        if (points.size() < 4) return false;
+
+        //the initial tetrahedron: the farthest of the axis extremes, the farthest
+        //point from their line, then the farthest from the plane of the three
+        uint32_t ext[6];
+        for (int a = 0; a < 3; a++)
+        {
+            ext[2 * a] = ext[2 * a + 1] = points[0];
+            for (uint32_t i : points)
+            {
+                if (pts[i][a] < pts[ext[2 * a]][a]) ext[2 * a] = i;
+                if (pts[i][a] > pts[ext[2 * a + 1]][a]) ext[2 * a + 1] = i;
+            }
+        }
+        uint32_t v[4] = { ext[0], ext[1], 0, 0 };
+        for (int a = 1; a < 3; a++)
+            if ((pts[ext[2 * a + 1]] - pts[ext[2 * a]]).norm() > (pts[v[1]] - pts[v[0]]).norm())
+            {
+                v[0] = ext[2 * a];
+                v[1] = ext[2 * a + 1];
+            }
+        const CPoint d = pts[v[1]] - pts[v[0]];
+        if (d.norm() <= eps) return false;
+        double best = 0;
+        for (uint32_t i : points)
+        {
+            const double s = (d ^ (pts[i] - pts[v[0]])).norm();
+            if (s > best) { best = s; v[2] = i; }
+        }
+        if (best <= eps * d.norm()) return false;
+        CPoint n = d ^ (pts[v[2]] - pts[v[0]]);
+        n /= n.norm();
+        best = 0;
+        for (uint32_t i : points)
+        {
+            const double s = std::fabs(n * (pts[i] - pts[v[0]]));
+            if (s > best) { best = s; v[3] = i; }
+        }
+        if (best <= eps) return false;
+        //face 0, 1, 2 facing away from point 3
+        if (n * (pts[v[3]] - pts[v[0]]) > 0) std::swap(v[1], v[2]);
+
+        _face(v[0], v[1], v[2]);
+        _face(v[0], v[3], v[1]);
+        _face(v[1], v[3], v[2]);
+        _face(v[2], v[3], v[0]);
+        //faces across the edges, edge i going from v[i] to v[i + 1]
+        const uint32_t adj[4][3] = { { 1, 2, 3 }, { 3, 2, 0 }, { 1, 3, 0 }, { 2, 1, 0 } };
+        for (int f = 0; f < 4; f++)
+            for (int i = 0; i < 3; i++) faces[f].adj[i] = adj[f][i];
+
+        std::vector<uint32_t> rest;
+        rest.reserve(points.size());
+        for (uint32_t i : points)
+            if (i != v[0] && i != v[1] && i != v[2] && i != v[3]) rest.push_back(i);
+        points = std::vector<uint32_t>();
+        cone = { 0, 1, 2, 3 };
+        _assign(rest);
+
+        std::vector<uint32_t> work;
+        for (uint32_t f = 0; f < 4; f++)
+            if (!faces[f].outside.empty()) work.push_back(f);
+        while (!work.empty())
+        {
+            const uint32_t f = work.back();
+            work.pop_back();
+            if (!faces[f].alive || faces[f].outside.empty()) continue;
+            _add(f);
+            for (uint32_t g : cone)
+                if (!faces[g].outside.empty()) work.push_back(g);
+        }
+        return true;
+    }
+
+    inline void CQuickHull::CBuilder::_assign(const std::vector<uint32_t> & points)
+    {
+        //the face each point is farthest above, or none
+        target.resize(points.size());
+        const size_t count = cone.size();
+        parallel_for(points.size(), points.size() < s_parallel_points ? 1 : threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                const CPoint & p = pts[points[k]];
+                double best = eps;
+                target[k] = (uint32_t)count;
+                for (size_t g = 0; g < count; g++)
+                {
+                    const double s = faces[cone[g]].distance(p);
+                    if (s > best) { best = s; target[k] = (uint32_t)g; }
+                }
+            }
+        }, s_parallel_points / 4);
+
+        for (size_t k = 0; k < points.size(); k++)
+        {
+            if (target[k] == count) continue;
+            CFace & f = faces[cone[target[k]]];
+            const double s = f.distance(pts[points[k]]);
+            f.outside.push_back(points[k]);
+            if (s > f.farthest)
+            {
+                f.farthest = s;
+                std::swap(f.outside.front(), f.outside.back());
+            }
+        }
+    }
+
+    inline void CQuickHull::CBuilder::_add(uint32_t seed)
+    {
+        const uint32_t eye = faces[seed].outside.front();
+        const CPoint & p = pts[eye];
+
+        //the faces seen from the eye, and the edges around them as face, edge
+        stamp++;
+        visible.clear();
+        horizon.clear();
+        stack.assign(1, seed);
+        faces[seed].visit = stamp;
+        faces[seed].visible = true;
+        while (!stack.empty())
+        {
+            const uint32_t f = stack.back();
+            stack.pop_back();
+            visible.push_back(f);
+            for (int i = 0; i < 3; i++)
+            {
+                CFace & g = faces[faces[f].adj[i]];
+                if (g.visit != stamp)
+                {
+                    g.visit = stamp;
+                    g.visible = CPredicates::orient3d(pts[g.v[0]], pts[g.v[1]], pts[g.v[2]], p) > 0;
+                    if (g.visible) stack.push_back(faces[f].adj[i]);
+                }
+                if (!g.visible) horizon.push_back(std::make_pair(f, i));
+            }
+        }
+
+        //a cone of faces from the horizon to the eye, edge 0 on the horizon
+        cone.clear();
+        starts.clear();
+        for (const auto & h : horizon)
+        {
+            const uint32_t a = faces[h.first].v[h.second], b = faces[h.first].v[(h.second + 1) % 3];
+            const uint32_t outer = faces[h.first].adj[h.second];
+            const uint32_t f = _face(a, b, eye);
+            faces[f].adj[0] = outer;
+            for (int i = 0; i < 3; i++)
+                if (faces[outer].adj[i] == h.first) faces[outer].adj[i] = f;
+            starts.push_back(std::make_pair(a, f));
+            cone.push_back(f);
+        }
+        std::sort(starts.begin(), starts.end());
+        for (uint32_t f : cone)
+        {
+            const uint32_t b = faces[f].v[1];
+            const auto it = std::lower_bound(starts.begin(), starts.end(), std::make_pair(b, (uint32_t)0));
+            faces[f].adj[1] = it->second;
+            faces[it->second].adj[2] = (uint32_t)f;
+        }
+
+        //the conflict points of the faces removed go to the new faces
+        orphans.clear();
+        for (uint32_t f : visible)
+        {
+            for (uint32_t i : faces[f].outside)
+                if (i != eye) orphans.push_back(i);
+            faces[f].outside = std::vector<uint32_t>();
+            faces[f].alive = false;
+            unused.push_back(f);
+        }
+        _assign(orphans);
+    }
+
+    inline void CQuickHull::CBuilder::triangles(std::vector<uint32_t> & tris) const
+    {
+        tris.clear();
+        for (const CFace & f : faces)
+            if (f.alive) tris.insert(tris.end(), f.v, f.v + 3);
+    }
+
+}; //namespace
+
+#endif
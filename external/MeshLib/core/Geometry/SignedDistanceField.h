@@ -0,0 +1,680 @@
+/*!
+*      \file SignedDistanceField.h
+*      \brief Signed distance fields of triangle meshes on a sparse grid of bricks
+*
+*      The grid is cut into bricks of 8^3 cells. The distances at the corners
+*      of all bricks form a coarse grid: those near the surface by nearest
+*      point queries on a CBVH, the far ones by a chamfer transform, with the
+*      sign of the region the surface closes them in. A brick that may hold a
+*      sample in the band also gets its 9^3 samples. The triangles are binned
+*      into those bricks and every brick, in parallel, takes the nearest of
+*      its triangles at the samples in their band, so only the bricks along
+*      the surface hold samples and a 1024^3 grid takes memory by its surface.
+*      The sign is that of the angle weighted pseudo normal of the nearest
+*      feature, face, edge or vertex, of Baerentzen and Aanaes, right for
+*      closed, consistently oriented meshes. A sample beyond the band keeps
+*      the sign of a coarse corner whose empty ball holds it. Queries are
+*      trilinear in a brick, or in the coarse grid away from the surface.
+*/
+
+#ifndef _MESHLIB_SIGNED_DISTANCE_FIELD_H_
+#define _MESHLIB_SIGNED_DISTANCE_FIELD_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include "Point.h"
+#include "BVH.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    class CIsoSurface;
+
+    /*!
+     *  \brief CSignedDistanceField class, distances to a closed mesh, negative inside
+     *
+     *  Sample (i, j, k) is at origin() + (i, j, k) voxel_size(), for i, j, k in
+     *  [0, resolution()]. The grid is a cube centered on the bounding box of
+     *  the triangles with a margin of the band and a cell on every side.
+     */
+    class CSignedDistanceField
+    {
+    public:
+        /*!
+         *  Bake the field of a triangle mesh
+         *  \param points     the vertices
+         *  \param indices    three vertices a triangle, counterclockwise seen from outside
+         *  \param resolution cells along each axis, rounded up to a multiple of 8, at most s_max_resolution
+         *  \param band       in cells, the samples nearer than this are exact
+         *  \param threads    number of threads, 0 uses all hardware threads
+         */
+        void _bake(const std::vector<CPoint> & points, const std::vector<uint32_t> & indices, int resolution, double band = 3, int threads = 0);
+
+        /*!
+         *  Bake the field of faces, a range of face pointers such as CBaseMesh::faces(),
+         *  polygons split into fans around their first corner
+         */
+        template<typename Faces>
+        void _bake_faces(const Faces & faces, int resolution, double band = 3, int threads = 0);
+
+        void clear()
+        {
+            m_coarse.clear();
+            m_slots.clear();
+            m_samples.clear();
+            m_resolution = 0;
+        }
+
+        int resolution() const { return m_resolution; }
+        const CPoint & origin() const { return m_origin; }
+        double voxel_size() const { return m_size; }
+        /*! the band of exact samples, in units of length */
+        double band() const { return m_band * m_size; }
+        /*! number of bricks holding samples */
+        size_t bricks() const { return m_samples.size() / s_samples; }
+        /*! bytes held by the grids */
+        size_t memory() const { return (m_coarse.size() + m_samples.size()) * sizeof(float) + m_slots.size() * sizeof(uint32_t); }
+
+        /*! the distance at p, beyond the grid that at the nearest point of the grid plus the way there */
+        double distance(const CPoint & p) const;
+        /*! the gradient of the field at p, of length about 1 near the surface */
+        CPoint gradient(const CPoint & p) const;
+        /*! the distance at p and its gradient */
+        double distance(const CPoint & p, CPoint & gradient) const;
+
+        //! upper bound of resolution()
+        static const int s_max_resolution = 1 << 13;
+
+        /*!
+         *  The point of triangle a, b, c nearest to p, feature is 0 for the face,
+         *  1 + k for corner k, 4 + k for the edge from corner k to the next one
+         */
+        static CPoint _closest_feature(const CPoint & p, const CPoint & a, const CPoint & b, const CPoint & c, int & feature);
+
+    protected:
+        //! reads the samples of the bricks
+        friend class CIsoSurface;
+
+        //! cells of a brick along each axis, and its samples
+        static const int s_brick = 8;
+        static const int s_side = s_brick + 1;
+        static const int s_samples = s_side * s_side * s_side;
+        static const uint32_t s_none = 0xffffffffu;
+
+        //! what the sign needs of the triangles, dropped after baking
+        struct CSurface
+        {
+            std::vector<CPoint>   points;
+            std::vector<uint32_t> indices;
+            std::vector<CPoint>   face;      //!< unit normal of every triangle
+            std::vector<CPoint>   vertex;    //!< angle weighted normal of every point
+            std::vector<CPoint>   edge;      //!< sum of the normals of the faces of every edge
+            std::vector<uint32_t> edges;     //!< the edge from corner k of triangle t is edges[3 t + k]
+            CBVH                  bvh;
+        };
+
+        int _bricks() const { return m_resolution / s_brick; }
+        size_t _coarse_index(int x, int y, int z) const
+        {
+            const size_t n = (size_t)_bricks() + 1;
+            return (size_t)x + n * ((size_t)y + n * (size_t)z);
+        }
+
+        /*! the normals and the tree of the triangles */
+        static void _surface(CSurface & s, int threads);
+        /*! the signed distance of p by the nearest point of the surface, false if none is nearer than reach */
+        static bool _signed(const CSurface & s, const CPoint & p, double reach, double & d);
+        /*! the sign of p by the pseudo normal of the feature of triangle t nearest to it */
+        static double _sign(const CSurface & s, const CPoint & p, uint32_t t);
+        /*! the corners of the bricks, exact to m_exact, beyond by a chamfer distance and the sign of their side */
+        void _corners(const CSurface & s, int threads);
+        /*! the samples of brick bx, by, bz into samples, from the count triangles near it */
+        void _brick(const CSurface & s, int bx, int by, int bz, const uint32_t * triangles, size_t count, float * samples) const;
+        /*! the coarse value at a point in cells, trilinear */
+        double _coarse(const CPoint & g) const;
+        /*! the value at a point in cells of the grid and its gradient in cells */
+        double _lookup(const CPoint & g, CPoint * gradient) const;
+
+        int m_resolution = 0;
+        CPoint m_origin;
+        double m_size = 1;
+        double m_band = 3;
+        double m_exact = 0;              //!< the corners nearer than this are exact, the others at least this far
+        std::vector<float>    m_coarse;    //!< the corners of the bricks, x fastest
+        std::vector<uint32_t> m_slots;     //!< the samples of every brick start at s_samples m_slots[b], s_none if it has none
+        std::vector<float>    m_samples;   //!< 9^3 a brick, x fastest
+    };
+
+    template<typename Faces>
+    inline void CSignedDistanceField::_bake_faces(const Faces & faces, int resolution, double band, int threads)
+    {
+        //the vertices by address
+        std::vector<const void *> vertices;
+        for (auto * pf : faces)
+        {
+            auto * first = pf->halfedge();
+            auto * he = first;
+            do
+            {
+                vertices.push_back(he->vertex());
+                he = he->next();
+            } while (he != first);
+        }
+        std::sort(vertices.begin(), vertices.end());
+        vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+        auto index = [&vertices](const void * v) { return (uint32_t)(std::lower_bound(vertices.begin(), vertices.end(), v) - vertices.begin()); };
+
+        std::vector<CPoint> points(vertices.size());
+        std::vector<uint32_t> indices;
+        for (auto * pf : faces)
+        {
+            auto * first = pf->halfedge();
+            auto * he = first->next();
+            points[index(first->vertex())] = first->vertex()->point();
+            points[index(he->vertex())] = he->vertex()->point();
+            while (he->next() != first)
+            {
+                indices.push_back(index(first->vertex()));
+                indices.push_back(index(he->vertex()));
+                indices.push_back(index(he->next()->vertex()));
+                points[index(he->next()->vertex())] = he->next()->vertex()->point();
+                he = he->next();
+            }
+        }
+        _bake(points, indices, resolution, band, threads);
+    }
+
+    inline void CSignedDistanceField::_surface(CSurface & s, int threads)
+    {
+        const size_t triangles = s.indices.size() / 3;
+        s.face.resize(triangles);
+        std::vector<CPoint> weighted(3 * triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const CPoint p[3] = { s.points[s.indices[3 * t]], s.points[s.indices[3 * t + 1]], s.points[s.indices[3 * t + 2]] };
+                const CPoint n = (p[1] - p[0]) ^ (p[2] - p[0]);
+                const double l = n.norm();
+                s.face[t] = l > 0 ? n / l : CPoint(0, 0, 0);
+                for (int k = 0; k < 3; k++)
+                {
+                    CPoint u = p[(k + 1) % 3] - p[k], v = p[(k + 2) % 3] - p[k];
+                    const double lu = u.norm(), lv = v.norm();
+                    const double angle = lu > 0 && lv > 0 ? std::acos(std::max(-1.0, std::min(1.0, (u * v) / (lu * lv)))) : 0;
+                    weighted[3 * t + k] = s.face[t] * angle;
+                }
+            }
+        });
+        s.vertex.assign(s.points.size(), CPoint(0, 0, 0));
+        for (size_t c = 0; c < weighted.size(); c++) s.vertex[s.indices[c]] += weighted[c];
+
+        //the edges by their ends, a pair of triangles each unless the mesh is not closed
+        std::vector<uint64_t> keys(3 * triangles);
+        for (size_t c = 0; c < keys.size(); c++)
+        {
+            const uint64_t a = s.indices[c], b = s.indices[c - c % 3 + (c + 1) % 3];
+            keys[c] = std::min(a, b) << 32 | std::max(a, b);
+        }
+        std::vector<uint32_t> order(keys.size());
+        for (size_t c = 0; c < order.size(); c++) order[c] = (uint32_t)c;
+        parallel_sort(order.begin(), order.end(), threads, [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        s.edges.resize(keys.size());
+        s.edge.clear();
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            if (i == 0 || keys[order[i]] != keys[order[i - 1]]) s.edge.push_back(CPoint(0, 0, 0));
+            s.edges[order[i]] = (uint32_t)(s.edge.size() - 1);
+            s.edge.back() += s.face[order[i] / 3];
+        }
+
+        s.bvh._construct(triangles, [&s](size_t t, int k) { return s.points[s.indices[3 * t + k]]; }, threads);
+    }
+
+    inline double CSignedDistanceField::_sign(const CSurface & s, const CPoint & p, uint32_t t)
+    {
+        const CPoint a = s.points[s.indices[3 * t]], b = s.points[s.indices[3 * t + 1]], c = s.points[s.indices[3 * t + 2]];
+        int feature;
+        const CPoint q = _closest_feature(p, a, b, c, feature);
+        const CPoint & n = feature == 0 ? s.face[t] : feature < 4 ? s.vertex[s.indices[3 * t + feature - 1]] : s.edge[s.edges[3 * t + feature - 4]];
+        return (p - q) * n < 0 ? -1 : 1;
+    }
+
+    inline bool CSignedDistanceField::_signed(const CSurface & s, const CPoint & p, double reach, double & d)
+    {
+        CBVH::CNearest nearest;
+        if (!s.bvh._closest(p, nearest, reach)) return false;
+        d = _sign(s, p, nearest.triangle) * nearest.distance;
+        return true;
+    }
+
+    inline void CSignedDistanceField::_bake(const std::vector<CPoint> & points, const std::vector<uint32_t> & indices, int resolution, double band, int threads)
+    {
+        clear();
+        m_band = std::max(band, 0.0);
+        m_resolution = std::max((int)s_brick, std::min((int)s_max_resolution, (resolution + s_brick - 1) / s_brick * s_brick));
+        const size_t triangles = indices.size() / 3;
+        if (triangles == 0) return;
+
+        CPoint lo(DBL_MAX, DBL_MAX, DBL_MAX), hi(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+        for (size_t c = 0; c < 3 * triangles; c++)
+        {
+            const CPoint & p = points[indices[c]];
+            for (int a = 0; a < 3; a++)
+            {
+                lo[a] = std::min(lo[a], p[a]);
+                hi[a] = std::max(hi[a], p[a]);
+            }
+        }
+        //the band and a cell around the bounding box, the rest of the cells over it
+        const double extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+        const double margin = std::min(std::ceil(m_band) + 1, m_resolution / 4.0);
+        m_size = extent > 0 ? extent / (m_resolution - 2 * margin) : 1;
+        m_origin = (lo + hi) / 2.0 - CPoint(1, 1, 1) * (m_size * m_resolution / 2);
+
+        CSurface s;
+        s.points = points;
+        s.indices.assign(indices.begin(), indices.begin() + 3 * triangles);
+        _surface(s, threads);
+
+        //a brick gets samples if one may be in the band, all are within half its diagonal of its center,
+        //and of a corner, so the corners rule most bricks out before the center is looked up
+        const int nb = _bricks();
+        const double reach = (m_band + s_brick * std::sqrt(3.0) / 2) * m_size;
+        m_exact = reach + s_brick * m_size;
+        _corners(s, threads);
+        std::vector<uint32_t> candidates;
+        for (int z = 0; z < nb; z++)
+            for (int y = 0; y < nb; y++)
+                for (int x = 0; x < nb; x++)
+                {
+                    double nearest = DBL_MAX;
+                    for (int k = 0; k < 8; k++)
+                        nearest = std::min(nearest, (double)std::fabs(m_coarse[_coarse_index(x + (k & 1), y + (k >> 1 & 1), z + (k >> 2))]));
+                    if (nearest <= reach) candidates.push_back((uint32_t)(x + nb * (y + nb * z)));
+                }
+        std::vector<char> near(candidates.size());
+        parallel_for(candidates.size(), threads, [&](size_t b, size_t e)
+        {
+            CBVH::CNearest nearest;
+            for (size_t i = b; i < e; i++)
+            {
+                const uint32_t brick = candidates[i];
+                const CPoint center = m_origin + (CPoint(brick % nb, brick / nb % nb, brick / nb / nb) + CPoint(0.5, 0.5, 0.5)) * (s_brick * m_size);
+                near[i] = s.bvh._closest(center, nearest, reach) ? 1 : 0;
+            }
+        }, 256);
+        std::vector<uint32_t> chosen;
+        m_slots.assign((size_t)nb * nb * nb, (uint32_t)s_none);
+        for (size_t i = 0; i < candidates.size(); i++)
+        {
+            if (!near[i]) continue;
+            m_slots[candidates[i]] = (uint32_t)chosen.size();
+            chosen.push_back(candidates[i]);
+        }
+
+        //the triangles whose band meets every chosen brick, as its slot << 32 | triangle, a little
+        //wider so a sample on the face of two bricks gets the same triangles in both
+        const double pad = m_band + 1e-6;
+        const int chunks = resolve_threads(threads) * 4;
+        std::vector<std::vector<uint64_t>> bins(chunks);
+        parallel_for(chunks, threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++)
+                for (size_t t = triangles * c / chunks; t < triangles * (c + 1) / chunks; t++)
+                {
+                    int lo[3], hi[3];
+                    for (int a = 0; a < 3; a++)
+                    {
+                        double l = DBL_MAX, h = -DBL_MAX;
+                        for (int k = 0; k < 3; k++)
+                        {
+                            const double g = (s.points[s.indices[3 * t + k]][a] - m_origin[a]) / m_size;
+                            l = std::min(l, g);
+                            h = std::max(h, g);
+                        }
+                        lo[a] = std::max(0, (int)std::floor((l - pad) / s_brick));
+                        hi[a] = std::min(nb - 1, (int)std::floor((h + pad) / s_brick));
+                    }
+                    for (int z = lo[2]; z <= hi[2]; z++)
+                        for (int y = lo[1]; y <= hi[1]; y++)
+                            for (int x = lo[0]; x <= hi[0]; x++)
+                            {
+                                const uint32_t slot = m_slots[(size_t)x + (size_t)nb * ((size_t)y + (size_t)nb * z)];
+                                if (slot != s_none) bins[c].push_back((uint64_t)slot << 32 | (uint64_t)t);
+                            }
+                }
+        }, 1);
+        std::vector<uint64_t> pairs;
+        for (auto & bin : bins)
+        {
+            pairs.insert(pairs.end(), bin.begin(), bin.end());
+            bin = std::vector<uint64_t>();
+        }
+        parallel_sort(pairs.begin(), pairs.end(), threads, std::less<uint64_t>());
+        std::vector<size_t> starts(chosen.size() + 1, 0);
+        for (uint64_t pair : pairs) starts[(pair >> 32) + 1]++;
+        for (size_t i = 0; i < chosen.size(); i++) starts[i + 1] += starts[i];
+        std::vector<uint32_t> near_triangles(pairs.size());
+        for (size_t i = 0; i < pairs.size(); i++) near_triangles[i] = (uint32_t)(pairs[i] & 0xffffffffu);
+        pairs = std::vector<uint64_t>();
+
+        m_samples.resize(chosen.size() * s_samples);
+        parallel_for(chosen.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const uint32_t brick = chosen[i];
+                _brick(s, (int)(brick % nb), (int)(brick / nb % nb), (int)(brick / nb / nb),
+                    near_triangles.data() + starts[i], starts[i + 1] - starts[i], &m_samples[i * s_samples]);
+            }
+        }, 1);
+    }
+
+    inline void CSignedDistanceField::_corners(const CSurface & s, int threads)
+    {
+        //only the corners near the surface are looked up, a far query may visit most of the tree
+        const int n = _bricks() + 1;
+        const double spacing = s_brick * m_size;
+        m_coarse.resize((size_t)n * n * n);
+        parallel_for((size_t)n * n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t yz = b; yz < e; yz++)
+                for (int x = 0; x < n; x++)
+                {
+                    const CPoint p = m_origin + CPoint(x, (double)(yz % n), (double)(yz / n)) * spacing;
+                    double d;
+                    m_coarse[(size_t)x + n * yz] = _signed(s, p, m_exact, d) ? (float)d : FLT_MAX;
+                }
+        }, 1);
+
+        //the far corners take the sign of the near ones next to their component, which the surface bounds
+        std::vector<float> sign(m_coarse.size(), 0);
+        std::vector<size_t> stack;
+        for (size_t c = 0; c < m_coarse.size(); c++)
+        {
+            if (m_coarse[c] != FLT_MAX || sign[c] != 0) continue;
+            std::vector<size_t> component(1, c);
+            float side = 0;
+            sign[c] = 1;
+            stack.assign(1, c);
+            while (!stack.empty())
+            {
+                const size_t i = stack.back();
+                stack.pop_back();
+                const int x = (int)(i % n), y = (int)(i / n % n), z = (int)(i / n / n);
+                const int next[6][3] = { { x - 1, y, z }, { x + 1, y, z }, { x, y - 1, z }, { x, y + 1, z }, { x, y, z - 1 }, { x, y, z + 1 } };
+                for (int k = 0; k < 6; k++)
+                {
+                    if (next[k][0] < 0 || next[k][1] < 0 || next[k][2] < 0 || next[k][0] >= n || next[k][1] >= n || next[k][2] >= n) continue;
+                    const size_t j = _coarse_index(next[k][0], next[k][1], next[k][2]);
+                    if (m_coarse[j] != FLT_MAX)
+                    {
+                        if (side == 0) side = m_coarse[j] < 0 ? -1.0f : 1.0f;
+                        continue;
+                    }
+                    if (sign[j] != 0) continue;
+                    sign[j] = 1;
+                    component.push_back(j);
+                    stack.push_back(j);
+                }
+            }
+            if (side < 0)
+                for (size_t j : component) sign[j] = -1;
+        }
+
+        //the distances of the far corners by a chamfer transform from the near ones, forward and back
+        std::vector<float> d(m_coarse.size());
+        for (size_t c = 0; c < d.size(); c++) d[c] = m_coarse[c] == FLT_MAX ? FLT_MAX : std::fabs(m_coarse[c]);
+        int offsets[13][3];
+        float lengths[13];
+        int count = 0;
+        for (int dz = -1; dz <= 0; dz++)
+            for (int dy = -1; dy <= 1; dy++)
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if (dz == 0 && (dy > 0 || (dy == 0 && dx >= 0))) continue;
+                    offsets[count][0] = dx;
+                    offsets[count][1] = dy;
+                    offsets[count][2] = dz;
+                    lengths[count++] = (float)(spacing * std::sqrt((double)(dx * dx + dy * dy + dz * dz)));
+                }
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const int step = pass == 0 ? 1 : -1;
+            for (int z = pass == 0 ? 0 : n - 1; z >= 0 && z < n; z += step)
+                for (int y = pass == 0 ? 0 : n - 1; y >= 0 && y < n; y += step)
+                    for (int x = pass == 0 ? 0 : n - 1; x >= 0 && x < n; x += step)
+                    {
+                        const size_t c = _coarse_index(x, y, z);
+                        if (m_coarse[c] != FLT_MAX) continue;
+                        for (int k = 0; k < 13; k++)
+                        {
+                            const int u = x + step * offsets[k][0], v = y + step * offsets[k][1], w = z + step * offsets[k][2];
+                            if (u < 0 || v < 0 || w < 0 || u >= n || v >= n || w >= n) continue;
+                            d[c] = std::min(d[c], d[_coarse_index(u, v, w)] + lengths[k]);
+                        }
+                    }
+        }
+        for (size_t c = 0; c < d.size(); c++)
+            if (m_coarse[c] == FLT_MAX) m_coarse[c] = sign[c] * std::max(d[c], (float)m_exact);
+    }
+
+    inline void CSignedDistanceField::_brick(const CSurface & s, int bx, int by, int bz, const uint32_t * triangles, size_t count, float * samples) const
+    {
+        const double band = m_band * m_size;
+        const CPoint corner = m_origin + CPoint(bx, by, bz) * (s_brick * m_size);
+
+        //every triangle to the samples in its band, the nearest one kept
+        double best[s_samples];
+        uint32_t nearest[s_samples];
+        std::fill(best, best + s_samples, band * band);
+        std::fill(nearest, nearest + s_samples, (uint32_t)s_none);
+        for (size_t i = 0; i < count; i++)
+        {
+            const uint32_t t = triangles[i];
+            const CPoint a = s.points[s.indices[3 * t]], b = s.points[s.indices[3 * t + 1]], c = s.points[s.indices[3 * t + 2]];
+            const CPoint & n = s.face[t];
+            int lo[3], hi[3];
+            for (int k = 0; k < 3; k++)
+            {
+                const double l = (std::min(a[k], std::min(b[k], c[k])) - band - corner[k]) / m_size;
+                const double h = (std::max(a[k], std::max(b[k], c[k])) + band - corner[k]) / m_size;
+                lo[k] = std::max(0, (int)std::ceil(l));
+                hi[k] = std::min(s_brick, (int)std::floor(h));
+            }
+            for (int z = lo[2]; z <= hi[2]; z++)
+                for (int y = lo[1]; y <= hi[1]; y++)
+                    for (int x = lo[0]; x <= hi[0]; x++)
+                    {
+                        const int j = (z * s_side + y) * s_side + x;
+                        const CPoint p = corner + CPoint(x, y, z) * m_size;
+                        //no nearer than the plane
+                        const double plane = (p - a) * n;
+                        if (plane * plane >= best[j]) continue;
+                        const CPoint v = CBVH::_closest_point(p, a, b, c) - p;
+                        const double d2 = v * v;
+                        if (d2 >= best[j]) continue;
+                        best[j] = d2;
+                        nearest[j] = t;
+                    }
+        }
+
+        float coarse[8];
+        CPoint corners[8];
+        for (int k = 0; k < 8; k++)
+        {
+            coarse[k] = m_coarse[_coarse_index(bx + (k & 1), by + (k >> 1 & 1), bz + (k >> 2))];
+            corners[k] = corner + CPoint(k & 1, k >> 1 & 1, k >> 2) * (s_brick * m_size);
+        }
+        for (int z = 0; z < s_side; z++)
+            for (int y = 0; y < s_side; y++)
+                for (int x = 0; x < s_side; x++)
+                {
+                    const int j = (z * s_side + y) * s_side + x;
+                    const CPoint p = corner + CPoint(x, y, z) * m_size;
+                    if (nearest[j] != s_none)
+                    {
+                        samples[j] = (float)(_sign(s, p, nearest[j]) * std::sqrt(best[j]));
+                        continue;
+                    }
+                    //beyond the band, |d(p)| >= |d(c)| - |p - c| for every corner c, and p has the sign of a corner whose empty ball holds it
+                    double bound = 0, sign = 0;
+                    for (int k = 0; k < 8; k++)
+                    {
+                        const double gap = std::min((double)std::fabs(coarse[k]), m_exact) - (p - corners[k]).norm();
+                        if (gap <= bound) continue;
+                        bound = gap;
+                        sign = coarse[k] < 0 ? -1 : 1;
+                    }
+                    double d = 0;
+                    if (sign != 0)
+                    {
+                        const CPoint g = CPoint(bx * s_brick + x, by * s_brick + y, bz * s_brick + z);
+                        d = sign * std::max(std::max(band, bound), std::fabs(_coarse(g)));
+                    }
+                    else _signed(s, p, DBL_MAX, d);
+                    samples[j] = (float)d;
+                }
+    }
+
+    inline double CSignedDistanceField::_coarse(const CPoint & g) const
+    {
+        const int nb = _bricks();
+        int c[3];
+        double f[3];
+        for (int a = 0; a < 3; a++)
+        {
+            const double v = g[a] / s_brick;
+            c[a] = std::max(0, std::min(nb - 1, (int)std::floor(v)));
+            f[a] = v - c[a];
+        }
+        double d = 0;
+        for (int k = 0; k < 8; k++)
+        {
+            const double w = (k & 1 ? f[0] : 1 - f[0]) * (k & 2 ? f[1] : 1 - f[1]) * (k & 4 ? f[2] : 1 - f[2]);
+            d += w * m_coarse[_coarse_index(c[0] + (k & 1), c[1] + (k >> 1 & 1), c[2] + (k >> 2))];
+        }
+        return d;
+    }
+
+    inline double CSignedDistanceField::_lookup(const CPoint & g, CPoint * gradient) const
+    {
+        const int nb = _bricks();
+        int b[3];
+        for (int a = 0; a < 3; a++) b[a] = std::max(0, std::min(nb - 1, (int)std::floor(g[a] / s_brick)));
+        const uint32_t slot = m_slots[(size_t)b[0] + (size_t)nb * ((size_t)b[1] + (size_t)nb * b[2])];
+
+        //the eight values around g and where g is between them
+        double v[8], f[3];
+        if (slot != s_none)
+        {
+            const float * samples = &m_samples[(size_t)slot * s_samples];
+            int c[3];
+            for (int a = 0; a < 3; a++)
+            {
+                const double l = g[a] - b[a] * s_brick;
+                c[a] = std::max(0, std::min(s_brick - 1, (int)std::floor(l)));
+                f[a] = l - c[a];
+            }
+            for (int k = 0; k < 8; k++)
+                v[k] = samples[((c[2] + (k >> 2)) * s_side + c[1] + (k >> 1 & 1)) * s_side + c[0] + (k & 1)];
+        }
+        else
+        {
+            for (int a = 0; a < 3; a++) f[a] = g[a] / s_brick - b[a];
+            for (int k = 0; k < 8; k++) v[k] = m_coarse[_coarse_index(b[0] + (k & 1), b[1] + (k >> 1 & 1), b[2] + (k >> 2))];
+        }
+
+        const double x00 = v[0] + (v[1] - v[0]) * f[0], x10 = v[2] + (v[3] - v[2]) * f[0];
+        const double x01 = v[4] + (v[5] - v[4]) * f[0], x11 = v[6] + (v[7] - v[6]) * f[0];
+        const double y0 = x00 + (x10 - x00) * f[1], y1 = x01 + (x11 - x01) * f[1];
+        if (gradient)
+        {
+            const double scale = slot != s_none ? 1.0 : 1.0 / s_brick;
+            const double dx0 = (v[1] - v[0]) + ((v[3] - v[2]) - (v[1] - v[0])) * f[1];
+            const double dx1 = (v[5] - v[4]) + ((v[7] - v[6]) - (v[5] - v[4])) * f[1];
+            (*gradient)[0] = (dx0 + (dx1 - dx0) * f[2]) * scale;
+            (*gradient)[1] = ((x10 - x00) + ((x11 - x01) - (x10 - x00)) * f[2]) * scale;
+            (*gradient)[2] = (y1 - y0) * scale;
+        }
+        return y0 + (y1 - y0) * f[2];
+    }
+
+    inline double CSignedDistanceField::distance(const CPoint & p, CPoint & gradient) const
+    {
+        gradient = CPoint(0, 0, 0);
+        if (m_resolution == 0 || m_coarse.empty()) return DBL_MAX;
+        const CPoint g = (p - m_origin) / m_size;
+        CPoint clamped;
+        for (int a = 0; a < 3; a++) clamped[a] = std::max(0.0, std::min((double)m_resolution, g[a]));
+        CPoint grad;
+        const double d = _lookup(clamped, &grad);
+        const CPoint out = (g - clamped) * m_size;
+        const double away = out.norm();
+        //beyond the grid the field grows along the way out
+        gradient = away > 0 ? out / away : grad / m_size;
+        return d + away;
+    }
+
+    inline double CSignedDistanceField::distance(const CPoint & p) const
+    {
+        if (m_resolution == 0 || m_coarse.empty()) return DBL_MAX;
+        const CPoint g = (p - m_origin) / m_size;
+        CPoint clamped;
+        for (int a = 0; a < 3; a++) clamped[a] = std::max(0.0, std::min((double)m_resolution, g[a]));
+        return _lookup(clamped, NULL) + ((g - clamped) * m_size).norm();
+    }
+
+    inline CPoint CSignedDistanceField::gradient(const CPoint & p) const
+    {
+        CPoint g;
+        distance(p, g);
+        return g;
+    }
+
+    inline CPoint CSignedDistanceField::_closest_feature(const CPoint & p, const CPoint & a, const CPoint & b, const CPoint & c, int & feature)
+    {
+        //the regions of CBVH::_closest_point, with the feature they belong to
+        const CPoint ab = b - a, ac = c - a, ap = p - a;
+        const double d1 = ab * ap, d2 = ac * ap;
+        feature = 1;
+        if (d1 <= 0 && d2 <= 0) return a;
+
+        const CPoint bp = p - b;
+        const double d3 = ab * bp, d4 = ac * bp;
+        feature = 2;
+        if (d3 >= 0 && d4 <= d3) return b;
+
+        const double vc = d1 * d4 - d3 * d2;
+        feature = 4;
+        if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+        const CPoint cp = p - c;
+        const double d5 = ab * cp, d6 = ac * cp;
+        feature = 3;
+        if (d6 >= 0 && d5 <= d6) return c;
+
+        const double vb = d5 * d2 - d1 * d6;
+        feature = 6;
+        if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+        const double va = d3 * d6 - d5 * d4;
+        feature = 5;
+        if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        const double s = va + vb + vc;
+        feature = 1;
+        if (s <= 0) return a;
+        feature = 0;
+        return a + ab * (vb / s) + ac * (vc / s);
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,195 @@
+/*!
+*      \file SurfaceDistance.h
+*      \brief Hausdorff, mean and RMS distance from one triangle surface to another
+*
+*      The target triangles go into a CBVH. The source triangles are sampled
+*      uniformly by area: sample k sits at the area (k + 1/2) A / n of the
+*      running sum of the triangle areas, which stratifies the samples over
+*      the triangles, and across its triangle at a square root and a golden
+*      ratio step, so the samples and the result do not depend on the number
+*      of threads. Every sample takes its closest point on the target, those
+*      of a thread in order, each query bounded by the distance to the
+*      closest point of the sample before it, which is on the target and near
+*      by, so most of the tree is never visited. The distance is one sided,
+*      the Hausdorff distance of two surfaces is the larger of both ways.
+*/
+
+#ifndef _MESHLIB_SURFACE_DISTANCE_H_
+#define _MESHLIB_SURFACE_DISTANCE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include "Point.h"
+#include "BVH.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CSurfaceDistance class, the distances of points and surfaces to target triangles
+     */
+    class CSurfaceDistance
+    {
+    public:
+        /*!
+         *  The target
+         *  \param triangles number of triangles, corner(t, k) is corner k of triangle t as a CPoint
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        template<typename Corner>
+        void _construct(size_t triangles, Corner corner, int threads = 0) { m_bvh._construct(triangles, corner, threads); }
+        /*! the target, a range of face pointers such as CBaseMesh::faces() */
+        template<typename Faces>
+        void _construct_faces(const Faces & faces, int threads = 0) { m_bvh._construct_faces(faces, threads); }
+        const CBVH & bvh() const { return m_bvh; }
+
+        /*!
+         *  Sample the source triangles and measure the distances of the samples to the target
+         *  \param triangles number of source triangles, corner(t, k) as for _construct
+         *  \param samples   number of samples, 0 for one per source triangle and at least s_samples
+         */
+        template<typename Corner>
+        void _measure(size_t triangles, Corner corner, size_t samples = 0, int threads = 0);
+
+        /*! out[i] the distance of point(i), a CPoint, to the target, DBL_MAX without a target */
+        template<typename Point>
+        void _distances(size_t n, Point point, double * out, int threads = 0) const;
+
+        /*! the largest distance of a sample, the one sided Hausdorff distance */
+        double hausdorff() const { return m_max; }
+        /*! the mean and the root mean square of the distances, over the area of the source */
+        double mean() const { return m_count ? m_sum / m_count : 0; }
+        double rms() const { return m_count ? std::sqrt(m_sum2 / m_count) : 0; }
+        size_t samples() const { return m_count; }
+        /*! the area of the source triangles */
+        double area() const { return m_area; }
+        /*! the sample farthest from the target */
+        const CPoint & farthest() const { return m_farthest; }
+
+        //! samples of _measure at least, unless asked for
+        static const size_t s_samples = 1 << 16;
+
+    protected:
+        //! samples per thread at once, consecutive ones share their bound
+        static const size_t s_grain = 1 << 12;
+
+        /* the statistics of a range of samples */
+        struct CStats
+        {
+            double max = 0;
+            double sum = 0;
+            double sum2 = 0;
+            CPoint farthest;
+
+            static CStats join(const CStats & a, const CStats & b)
+            {
+                CStats r = a.max >= b.max ? a : b;
+                r.sum = a.sum + b.sum;
+                r.sum2 = a.sum2 + b.sum2;
+                return r;
+            }
+        };
+
+        /* the closest point to p, bounded by the distance to the point near that came before */
+        bool _nearest(const CPoint & p, const CPoint * near, CBVH::CNearest & nearest) const
+        {
+            if (near)
+            {
+                // a hair over, the near point itself must pass the strict test of the tree
+                const double bound = (p - *near).norm();
+                if (m_bvh._closest(p, nearest, bound * (1 + 1e-9) + 1e-300)) return true;
+            }
+            return m_bvh._closest(p, nearest);
+        }
+
+        CBVH   m_bvh;
+        double m_max = 0;
+        double m_sum = 0;
+        double m_sum2 = 0;
+        size_t m_count = 0;
+        double m_area = 0;
+        CPoint m_farthest;
+    };
+
+    template<typename Corner>
+    inline void CSurfaceDistance::_measure(size_t triangles, Corner corner, size_t samples, int threads)
+    {
+        m_max = m_sum = m_sum2 = m_area = 0;
+        m_count = 0;
+        m_farthest = CPoint();
+        if (triangles == 0 || m_bvh.empty()) return;
+
+        // the running sum of the areas, sample k falls in the triangle whose range holds its area
+        std::vector<double> prefix(triangles + 1, 0);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const CPoint a = corner(t, 0);
+                prefix[t + 1] = ((corner(t, 1) - a) ^ (corner(t, 2) - a)).norm() / 2;
+            }
+        });
+        for (size_t t = 0; t < triangles; t++) prefix[t + 1] += prefix[t];
+        m_area = prefix[triangles];
+        if (m_area <= 0) return;
+        const size_t n = samples ? samples : std::max(triangles, s_samples);
+
+        const CStats stats = parallel_reduce(n, threads, CStats(), [&](size_t b, size_t e, CStats & s)
+        {
+            size_t t = (size_t)(std::upper_bound(prefix.begin(), prefix.end(), (b + 0.5) * m_area / n) - prefix.begin()) - 1;
+            CBVH::CNearest nearest;
+            bool near = false;
+            for (size_t k = b; k < e; k++)
+            {
+                const double at = (k + 0.5) * m_area / n;
+                while (t + 1 < triangles && prefix[t + 1] <= at) t++;
+                const double length = prefix[t + 1] - prefix[t];
+                const double u = length > 0 ? std::sqrt(std::min(1.0, std::max(0.0, (at - prefix[t]) / length))) : 0;
+                const double v = k * 0.6180339887498949 - std::floor(k * 0.6180339887498949);
+                const CPoint a = corner(t, 0), c1 = corner(t, 1), c2 = corner(t, 2);
+                const CPoint p = a * (1 - u) + c1 * (u * (1 - v)) + c2 * (u * v);
+                const CPoint last = nearest.point;
+                if (!_nearest(p, near ? &last : NULL, nearest)) continue;
+                near = true;
+                const double d = nearest.distance;
+                s.sum += d;
+                s.sum2 += d * d;
+                if (d < s.max) continue;
+                s.max = d;
+                s.farthest = p;
+            }
+        }, CStats::join, s_grain);
+
+        m_max = stats.max;
+        m_sum = stats.sum;
+        m_sum2 = stats.sum2;
+        m_count = n;
+        m_farthest = stats.farthest;
+        MESHLIB_COUNTER_ADD("surface_distance.samples", n);
+    }
+
+    template<typename Point>
+    inline void CSurfaceDistance::_distances(size_t n, Point point, double * out, int threads) const
+    {
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            CBVH::CNearest nearest;
+            bool near = false;
+            for (size_t i = b; i < e; i++)
+            {
+                const CPoint p = point(i);
+                const CPoint last = nearest.point;
+                near = _nearest(p, near ? &last : NULL, nearest);
+                out[i] = near ? nearest.distance : DBL_MAX;
+            }
+        }, s_grain);
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,319 @@
+/*!
+*      \file TPoint.h
+*      \brief Points with float or double coordinates, for bulk work on positions
+*
+*      TPoint<T, N> holds N coordinates of type T. TPoint<T, 3, 4> pads a
+*      point to four coordinates and aligns it to 16 bytes, so that a float
+*      point fills one SSE register. TPointSoA views separate x, y, z arrays
+*      of many points. CPointKernels runs dot, cross, norm, normalize and
+*      affine transforms over arrays of either layout.
+*/
+
+#ifndef _MESHLIB_TPOINT_H_
+#define _MESHLIB_TPOINT_H_
+
+#include <assert.h>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include "Point.h"
+#include "Point2.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHLIB_TPOINT_SSE
+#include <emmintrin.h>
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief TPoint class, N coordinates of type T stored in S slots
+     *
+     *  The slots past N are padding, kept 0. Padded points are aligned to 16 bytes.
+     *  Three and two dimensional points convert to and from CPoint and CPoint2.
+     */
+    template<typename T, int N, int S = N>
+    class alignas(S == N ? alignof(T) : 16) TPoint
+    {
+        static_assert(N > 0 && S >= N, "TPoint needs at least N slots");
+    public:
+        typedef T value_type;
+        static const int dimension = N;
+
+        TPoint() { for (int i = 0; i < S; i++) v[i] = 0; };
+
+        TPoint(T x, T y) { static_assert(N == 2, "two coordinates for a 2D point"); v[0] = x; v[1] = y; _pad(); };
+        TPoint(T x, T y, T z) { static_assert(N == 3, "three coordinates for a 3D point"); v[0] = x; v[1] = y; v[2] = z; _pad(); };
+        TPoint(T x, T y, T z, T w) { static_assert(N == 4, "four coordinates for a 4D point"); v[0] = x; v[1] = y; v[2] = z; v[3] = w; _pad(); };
+
+        /*! from another precision or padding */
+        template<typename U, int R>
+        explicit TPoint(const TPoint<U, N, R> & p) { for (int i = 0; i < N; i++) v[i] = (T)p[i]; _pad(); };
+
+        template<int M = N, typename std::enable_if<M == 3, int>::type = 0>
+        explicit TPoint(const CPoint & p) { v[0] = (T)p[0]; v[1] = (T)p[1]; v[2] = (T)p[2]; _pad(); };
+
+        template<int M = N, typename std::enable_if<M == 2, int>::type = 0>
+        explicit TPoint(const CPoint2 & p) { v[0] = (T)p[0]; v[1] = (T)p[1]; _pad(); };
+
+        template<int M = N, typename std::enable_if<M == 3, int>::type = 0>
+        operator CPoint() const { return CPoint(v[0], v[1], v[2]); };
+
+        template<int M = N, typename std::enable_if<M == 2, int>::type = 0>
+        operator CPoint2() const { return CPoint2(v[0], v[1]); };
+
+        T & operator[](int i) { assert(0 <= i && i < N); return v[i]; };
+        T   operator[](int i) const { assert(0 <= i && i < N); return v[i]; };
+
+        T       * data()       { return v; };
+        const T * data() const { return v; };
+
+        TPoint & operator+=(const TPoint & p) { for (int i = 0; i < N; i++) v[i] += p.v[i]; return *this; };
+        TPoint & operator-=(const TPoint & p) { for (int i = 0; i < N; i++) v[i] -= p.v[i]; return *this; };
+        TPoint & operator*=(T s) { for (int i = 0; i < N; i++) v[i] *= s; return *this; };
+        TPoint & operator/=(T s) { for (int i = 0; i < N; i++) v[i] /= s; return *this; };
+
+        TPoint operator+(const TPoint & p) const { TPoint r(*this); return r += p; };
+        TPoint operator-(const TPoint & p) const { TPoint r(*this); return r -= p; };
+        TPoint operator*(T s) const { TPoint r(*this); return r *= s; };
+        TPoint operator/(T s) const { TPoint r(*this); return r /= s; };
+        TPoint operator-() const { TPoint r; for (int i = 0; i < N; i++) r.v[i] = -v[i]; return r; };
+
+        /*! dot product */
+        T operator*(const TPoint & p) const
+        {
+            T s = 0;
+            for (int i = 0; i < N; i++) s += v[i] * p.v[i];
+            return s;
+        };
+
+        /*! cross product, three dimensional points only */
+        TPoint operator^(const TPoint & p) const
+        {
+            static_assert(N == 3, "the cross product needs 3D points");
+            return TPoint(v[1] * p.v[2] - v[2] * p.v[1], v[2] * p.v[0] - v[0] * p.v[2], v[0] * p.v[1] - v[1] * p.v[0]);
+        };
+
+        T norm() const { return std::sqrt((*this) * (*this)); };
+
+    protected:
+        void _pad() { for (int i = N; i < S; i++) v[i] = 0; };
+
+        T v[S];
+    };
+
+    typedef TPoint<float, 2>     CPoint2f;
+    typedef TPoint<double, 2>    CPoint2d;
+    typedef TPoint<float, 3>     CPoint3f;
+    typedef TPoint<double, 3>    CPoint3d;
+    //! three coordinates padded to four, 16 bytes aligned
+    typedef TPoint<float, 3, 4>  CPoint3fA;
+    typedef TPoint<double, 3, 4> CPoint3dA;
+    typedef TPoint<float, 4>     CPoint4f;
+    typedef TPoint<double, 4>    CPoint4d;
+
+    /*!
+     *  \brief TPointSoA class, a view of n three dimensional points stored as separate x, y and z arrays
+     *
+     *  The view does not own the arrays.
+     */
+    template<typename T>
+    class TPointSoA
+    {
+    public:
+        TPointSoA() : m_n(0) { m_c[0] = m_c[1] = m_c[2] = NULL; };
+        TPointSoA(T * x, T * y, T * z, size_t n) : m_n(n) { m_c[0] = x; m_c[1] = y; m_c[2] = z; };
+
+        size_t size() const { return m_n; };
+
+        /*! the array of coordinate k */
+        T * operator()(int k) const { assert(0 <= k && k < 3); return m_c[k]; };
+        T * x() const { return m_c[0]; };
+        T * y() const { return m_c[1]; };
+        T * z() const { return m_c[2]; };
+
+        TPoint<T, 3> operator[](size_t i) const { assert(i < m_n); return TPoint<T, 3>(m_c[0][i], m_c[1][i], m_c[2][i]); };
+
+        template<typename U, int S>
+        void set(size_t i, const TPoint<U, 3, S> & p) { assert(i < m_n); m_c[0][i] = (T)p[0]; m_c[1][i] = (T)p[1]; m_c[2][i] = (T)p[2]; };
+
+        /*! the points first.. first + n - 1 */
+        TPointSoA sub(size_t first, size_t n) const
+        {
+            assert(first + n <= m_n);
+            return TPointSoA(m_c[0] + first, m_c[1] + first, m_c[2] + first, n);
+        };
+
+    protected:
+        T *    m_c[3];
+        size_t m_n;
+    };
+
+    /*!
+     *  \brief CPointKernels class, operations on arrays of points
+     *
+     *  Arrays of points are given by a pointer and a count, or as a TPointSoA
+     *  view. Outputs may alias the inputs of the same index.
+     */
+    class CPointKernels
+    {
+    public:
+        /*! out[i] = a[i] * b[i] */
+        template<typename T, int S>
+        static void dot(const TPoint<T, 3, S> * a, const TPoint<T, 3, S> * b, T * out, size_t n)
+        {
+            for (size_t i = 0; i < n; i++) out[i] = a[i] * b[i];
+        }
+
+        template<typename T>
+        static void dot(const TPointSoA<T> & a, const TPointSoA<T> & b, T * out)
+        {
+            const T * ax = a.x(), * ay = a.y(), * az = a.z();
+            const T * bx = b.x(), * by = b.y(), * bz = b.z();
+            for (size_t i = 0; i < a.size(); i++) out[i] = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i];
+        }
+
+        /*! out[i] = a[i] ^ b[i] */
+        template<typename T, int S>
+        static void cross(const TPoint<T, 3, S> * a, const TPoint<T, 3, S> * b, TPoint<T, 3, S> * out, size_t n)
+        {
+            for (size_t i = 0; i < n; i++) out[i] = a[i] ^ b[i];
+        }
+
+        template<typename T>
+        static void cross(const TPointSoA<T> & a, const TPointSoA<T> & b, const TPointSoA<T> & out)
+        {
+            const T * ax = a.x(), * ay = a.y(), * az = a.z();
+            const T * bx = b.x(), * by = b.y(), * bz = b.z();
+            T * ox = out.x(), * oy = out.y(), * oz = out.z();
+            for (size_t i = 0; i < a.size(); i++)
+            {
+                const T x = ay[i] * bz[i] - az[i] * by[i];
+                const T y = az[i] * bx[i] - ax[i] * bz[i];
+                const T z = ax[i] * by[i] - ay[i] * bx[i];
+                ox[i] = x; oy[i] = y; oz[i] = z;
+            }
+        }
+
+        /*! out[i] = |p[i]| */
+        template<typename T, int S>
+        static void norm(const TPoint<T, 3, S> * p, T * out, size_t n)
+        {
+            for (size_t i = 0; i < n; i++) out[i] = p[i].norm();
+        }
+
+        template<typename T>
+        static void norm(const TPointSoA<T> & p, T * out)
+        {
+            const T * x = p.x(), * y = p.y(), * z = p.z();
+            for (size_t i = 0; i < p.size(); i++) out[i] = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        }
+
+        /*! scale every p[i] to unit length, zero vectors stay zero */
+        template<typename T, int S>
+        static void normalize(TPoint<T, 3, S> * p, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                const T l = p[i].norm();
+                p[i] *= l > 0 ? 1 / l : 0;
+            }
+        }
+
+        template<typename T>
+        static void normalize(const TPointSoA<T> & p)
+        {
+            T * x = p.x(), * y = p.y(), * z = p.z();
+            for (size_t i = 0; i < p.size(); i++)
+            {
+                const T l = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+                const T s = l > 0 ? 1 / l : 0;
+                x[i] *= s; y[i] *= s; z[i] *= s;
+            }
+        }
+
+        /*!
+         *  out[i] = M p[i] + t, m the 3 x 4 matrix [M | t] in row major order.
+         *  Directions, as normals under an orthogonal M, take t = 0.
+         */
+        template<typename T, int S>
+        static void transform(const T m[12], const TPoint<T, 3, S> * p, TPoint<T, 3, S> * out, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                const T x = p[i][0], y = p[i][1], z = p[i][2];
+                out[i] = TPoint<T, 3, S>(m[0] * x + m[1] * y + m[2]  * z + m[3],
+                                         m[4] * x + m[5] * y + m[6]  * z + m[7],
+                                         m[8] * x + m[9] * y + m[10] * z + m[11]);
+            }
+        }
+
+#ifdef MESHLIB_TPOINT_SSE
+        /*! the padded float points go through SSE, one point per register */
+        static void transform(const float m[12], const CPoint3fA * p, CPoint3fA * out, size_t n)
+        {
+            // columns of [M | t] with a zero fourth row, so that the padding stays 0
+            const __m128 c0 = _mm_setr_ps(m[0], m[4], m[8], 0);
+            const __m128 c1 = _mm_setr_ps(m[1], m[5], m[9], 0);
+            const __m128 c2 = _mm_setr_ps(m[2], m[6], m[10], 0);
+            const __m128 c3 = _mm_setr_ps(m[3], m[7], m[11], 0);
+            for (size_t i = 0; i < n; i++)
+            {
+                const __m128 q = _mm_load_ps(p[i].data());
+                __m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 0, 0, 0))), c3);
+                r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(q, q, _MM_SHUFFLE(1, 1, 1, 1))));
+                r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 2, 2, 2))));
+                _mm_store_ps(out[i].data(), r);
+            }
+        }
+#endif
+
+        template<typename T>
+        static void transform(const T m[12], const TPointSoA<T> & p, const TPointSoA<T> & out)
+        {
+            const T * x = p.x(), * y = p.y(), * z = p.z();
+            T * ox = out.x(), * oy = out.y(), * oz = out.z();
+            for (size_t i = 0; i < p.size(); i++)
+            {
+                const T a = x[i], b = y[i], c = z[i];
+                ox[i] = m[0] * a + m[1] * b + m[2]  * c + m[3];
+                oy[i] = m[4] * a + m[5] * b + m[6]  * c + m[7];
+                oz[i] = m[8] * a + m[9] * b + m[10] * c + m[11];
+            }
+        }
+
+        /*! from interleaved points to the view, converting the precision */
+        template<typename U, int S, typename T>
+        static void scatter(const TPoint<U, 3, S> * p, size_t n, const TPointSoA<T> & out)
+        {
+            assert(n <= out.size());
+            T * x = out.x(), * y = out.y(), * z = out.z();
+            for (size_t i = 0; i < n; i++) { x[i] = (T)p[i][0]; y[i] = (T)p[i][1]; z[i] = (T)p[i][2]; }
+        }
+
+        /*! from the view back to interleaved points */
+        template<typename T, typename U, int S>
+        static void gather(const TPointSoA<T> & p, TPoint<U, 3, S> * out)
+        {
+            const T * x = p.x(), * y = p.y(), * z = p.z();
+            for (size_t i = 0; i < p.size(); i++) out[i] = TPoint<U, 3, S>((U)x[i], (U)y[i], (U)z[i]);
+        }
+
+        /*! from CPoints, as a mesh stores them, to float points and back */
+        template<typename T, int S>
+        static void convert(const CPoint * p, size_t n, TPoint<T, 3, S> * out)
+        {
+            for (size_t i = 0; i < n; i++) out[i] = TPoint<T, 3, S>(p[i]);
+        }
+
+        template<typename T, int S>
+        static void convert(const TPoint<T, 3, S> * p, size_t n, CPoint * out)
+        {
+            for (size_t i = 0; i < n; i++) out[i] = CPoint(p[i][0], p[i][1], p[i][2]);
+        }
+    };
+
+}; //namespace
+
+#endif
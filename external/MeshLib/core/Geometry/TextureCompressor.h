@@ -0,0 +1,232 @@
+/*!
+*      \file TextureCompressor.h
+*      \brief Mipmaps and BC1 block compression of RGBA8 images
+*
+*      downsample() builds the next level of a mip chain with a box filter,
+*      encode_bc1() compresses a level into 4x4 blocks of 8 bytes, two 565
+*      endpoints and a 2 bit palette index per pixel (Waveren, Real-Time DXT
+*      Compression, 2006), a sixth of the video memory of uncompressed RGB.
+*/
+
+#ifndef _MESHLIB_TEXTURE_COMPRESSOR_H_
+#define _MESHLIB_TEXTURE_COMPRESSOR_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CTextureCompressor class
+     *
+     *  Images are rows of RGBA8 pixels without padding, top row first.
+     */
+    class CTextureCompressor
+    {
+    public:
+        /*! number of levels of a full mip chain down to 1x1 */
+        static int levels(int width, int height)
+        {
+            int n = 1;
+            while (width > 1 || height > 1)
+            {
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+                n++;
+            }
+            return n;
+        }
+
+        /*!
+         *  The next level, half the size rounded down, each pixel the mean of
+         *  the 2x2 pixels above it; the last row or column of an odd size is
+         *  averaged with itself
+         */
+        static void downsample(const uint8_t * src, int width, int height, std::vector<uint8_t> & dst, int threads = 0)
+        {
+            const int w = std::max(1, width / 2), h = std::max(1, height / 2);
+            dst.resize((size_t)4 * w * h);
+            uint8_t * out = dst.data();
+            parallel_for((size_t)h, threads, [&](size_t b, size_t e)
+            {
+                for (size_t y = b; y < e; y++)
+                {
+                    const uint8_t * r0 = src + (size_t)4 * width * std::min(2 * (int)y, height - 1);
+                    const uint8_t * r1 = src + (size_t)4 * width * std::min(2 * (int)y + 1, height - 1);
+                    for (int x = 0; x < w; x++)
+                    {
+                        const int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                        for (int c = 0; c < 4; c++)
+                        {
+                            const int sum = r0[4 * x0 + c] + r0[4 * x1 + c] + r1[4 * x0 + c] + r1[4 * x1 + c];
+                            out[4 * ((size_t)w * y + x) + c] = (uint8_t)((sum + 2) / 4);
+                        }
+                    }
+                }
+            }, 16);
+        }
+
+        /*! bytes of a BC1 level, partial blocks at the edges count as whole */
+        static size_t bc1_size(int width, int height)
+        {
+            return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * 8;
+        }
+
+        /*!
+         *  Compress a level into BC1 blocks, row by row of blocks, alpha is dropped
+         *  \param out bc1_size(width, height) bytes
+         */
+        static void encode_bc1(const uint8_t * src, int width, int height, uint8_t * out, int threads = 0)
+        {
+            const int bw = (width + 3) / 4, bh = (height + 3) / 4;
+            parallel_for((size_t)bh, threads, [&](size_t b, size_t e)
+            {
+                uint8_t block[64];
+                for (size_t by = b; by < e; by++)
+                {
+                    for (int bx = 0; bx < bw; bx++)
+                    {
+                        // pixels past the edge repeat the last ones
+                        for (int y = 0; y < 4; y++)
+                        {
+                            const int sy = std::min(4 * (int)by + y, height - 1);
+                            for (int x = 0; x < 4; x++)
+                            {
+                                const int sx = std::min(4 * bx + x, width - 1);
+                                memcpy(block + 4 * (4 * y + x), src + 4 * ((size_t)width * sy + sx), 4);
+                            }
+                        }
+                        _encode_block(block, out + 8 * ((size_t)bw * by + bx));
+                    }
+                }
+            }, 4);
+        }
+
+        /*! the 16 RGBA8 pixels of a BC1 block as the GPU decodes them, rows first */
+        static void decode_bc1_block(const uint8_t * in, uint8_t pixels[64])
+        {
+            uint8_t palette[4][4];
+            const uint16_t c0 = (uint16_t)(in[0] | in[1] << 8), c1 = (uint16_t)(in[2] | in[3] << 8);
+            _palette(c0, c1, palette);
+            for (int i = 0; i < 16; i++)
+            {
+                const int k = (in[4 + i / 4] >> (2 * (i % 4))) & 3;
+                memcpy(pixels + 4 * i, palette[k], 4);
+            }
+        }
+
+    protected:
+        static uint16_t _pack565(const int c[3])
+        {
+            return (uint16_t)(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+        }
+
+        static void _unpack565(uint16_t v, int c[3])
+        {
+            const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+            c[0] = (r << 3) | (r >> 2);
+            c[1] = (g << 2) | (g >> 4);
+            c[2] = (b << 3) | (b >> 2);
+        }
+
+        //! the four colors of a block, the third and fourth between the endpoints, or black in 3 color mode
+        static void _palette(uint16_t c0, uint16_t c1, uint8_t palette[4][4])
+        {
+            int a[3], b[3];
+            _unpack565(c0, a);
+            _unpack565(c1, b);
+            for (int d = 0; d < 3; d++)
+            {
+                palette[0][d] = (uint8_t)a[d];
+                palette[1][d] = (uint8_t)b[d];
+                if (c0 > c1)
+                {
+                    palette[2][d] = (uint8_t)((2 * a[d] + b[d]) / 3);
+                    palette[3][d] = (uint8_t)((a[d] + 2 * b[d]) / 3);
+                }
+                else
+                {
+                    palette[2][d] = (uint8_t)((a[d] + b[d]) / 2);
+                    palette[3][d] = 0;
+                }
+            }
+            for (int k = 0; k < 4; k++) palette[k][3] = 255;
+            if (c0 <= c1) palette[3][3] = 0;
+        }
+
+        static void _encode_block(const uint8_t block[64], uint8_t * out)
+        {
+            // the bounding box of the colors, its diagonal along their spread, inset by a sixteenth
+            int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 }, mean[3] = { 0, 0, 0 };
+            for (int i = 0; i < 16; i++)
+            {
+                for (int d = 0; d < 3; d++)
+                {
+                    lo[d] = std::min(lo[d], (int)block[4 * i + d]);
+                    hi[d] = std::max(hi[d], (int)block[4 * i + d]);
+                    mean[d] += block[4 * i + d];
+                }
+            }
+            // red and blue against green decide which diagonal of the box
+            int covr = 0, covb = 0;
+            for (int i = 0; i < 16; i++)
+            {
+                const int g = 16 * block[4 * i + 1] - mean[1];
+                covr += (16 * block[4 * i] - mean[0]) * g;
+                covb += (16 * block[4 * i + 2] - mean[2]) * g;
+            }
+            if (covr < 0) std::swap(lo[0], hi[0]);
+            if (covb < 0) std::swap(lo[2], hi[2]);
+            int e0[3], e1[3];
+            for (int d = 0; d < 3; d++)
+            {
+                const int inset = (hi[d] - lo[d]) / 16;
+                e0[d] = hi[d] - inset;
+                e1[d] = lo[d] + inset;
+            }
+
+            uint16_t c0 = _pack565(e0), c1 = _pack565(e1);
+            uint32_t bits = 0;
+            if (c0 != c1)
+            {
+                // 4 color mode needs the larger endpoint first
+                if (c0 < c1) std::swap(c0, c1);
+                uint8_t palette[4][4];
+                _palette(c0, c1, palette);
+                for (int i = 0; i < 16; i++)
+                {
+                    int best = 0, dist = 1 << 30;
+                    for (int k = 0; k < 4; k++)
+                    {
+                        int s = 0;
+                        for (int d = 0; d < 3; d++)
+                        {
+                            const int v = (int)block[4 * i + d] - palette[k][d];
+                            s += v * v;
+                        }
+                        if (s < dist)
+                        {
+                            dist = s;
+                            best = k;
+                        }
+                    }
+                    bits |= (uint32_t)best << (2 * i);
+                }
+            }
+            out[0] = (uint8_t)c0;
+            out[1] = (uint8_t)(c0 >> 8);
+            out[2] = (uint8_t)c1;
+            out[3] = (uint8_t)(c1 >> 8);
+            for (int k = 0; k < 4; k++) out[4 + k] = (uint8_t)(bits >> (8 * k));
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,193 @@
+/*!
+*      \file TextureRebaker.h
+*      \brief A texture resampled from one uv atlas of a surface into another
+*
+*      The triangles of the new atlas, those of a decimated or repacked
+*      surface, are rasterized in the texture plane as COcclusionBaker does.
+*      Every texel center inside a triangle takes the point of the surface
+*      there, finds the closest point on the original triangles through a
+*      CBVH and takes the color of the original texture at the uv of that
+*      point, filtered bilinearly. Texels outside the charts are then filled
+*      from their neighbours, a few rings deep, so that filtering and mipmaps
+*      do not bleed the background into the seams.
+*/
+
+#ifndef _MESHLIB_TEXTURE_REBAKER_H_
+#define _MESHLIB_TEXTURE_REBAKER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "Point.h"
+#include "Point2.h"
+#include "BVH.h"
+#include "OcclusionBaker.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief a corner of a triangle to resample, its point and uv
+     */
+    struct CRebakeCorner
+    {
+        CPoint  point;
+        CPoint2 uv;
+    };
+
+    /*!
+     *  \brief CTextureRebaker class
+     */
+    class CTextureRebaker
+    {
+    public:
+        //! rings of texels around the charts filled from their neighbours
+        int dilate = 4;
+
+        /*!
+         *  Resample texture into width x height texels of the atlas of the target triangles.
+         *  The texels are 32 bits of four 8 bit channels in any order, row 0 at v = 0, the
+         *  texture repeats outside [0, 1]^2. A texel no triangle covers and no dilation
+         *  reaches is 0
+         *  \param source  source(t, k) is corner k of original triangle t as a CRebakeCorner
+         *  \param target  target(t, k) is corner k of triangle t of the new atlas
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return the number of texels covered by triangles
+         */
+        template<typename Source, typename Target>
+        size_t bake(size_t sources, Source source, const uint32_t * texture, int texture_width, int texture_height,
+                    size_t targets, Target target, int width, int height, std::vector<uint32_t> & out, int threads = 0) const;
+
+    protected:
+        /*! the texture at uv, bilinear, repeated */
+        static uint32_t _sample(const uint32_t * texture, int w, int h, const CPoint2 & uv);
+
+        /*! the weights of corners 1 and 2 of the triangle a, b, c at its point p */
+        static void _weights(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & p, double & b1, double & b2)
+        {
+            const CPoint e1 = b - a, e2 = c - a, d = p - a;
+            const double d11 = e1 * e1, d12 = e1 * e2, d22 = e2 * e2, d1 = d * e1, d2 = d * e2;
+            const double det = d11 * d22 - d12 * d12;
+            if (det <= 0)
+            {
+                b1 = b2 = 0;
+                return;
+            }
+            b1 = (d22 * d1 - d12 * d2) / det;
+            b2 = (d11 * d2 - d12 * d1) / det;
+        }
+
+        /*! fill the empty texels next to covered ones with the mean of them, channel by channel, rings times */
+        void _dilate(int width, int height, std::vector<uint32_t> & out, const std::vector<char> & covered) const;
+    };
+
+    template<typename Source, typename Target>
+    inline size_t CTextureRebaker::bake(size_t sources, Source source, const uint32_t * texture, int texture_width, int texture_height,
+                                        size_t targets, Target target, int width, int height, std::vector<uint32_t> & out, int threads) const
+    {
+        out.assign((size_t)std::max(width, 0) * std::max(height, 0), 0);
+        if (out.empty() || sources == 0 || targets == 0 || texture_width <= 0 || texture_height <= 0) return 0;
+
+        std::vector<COcclusionBaker::CTexel> texels(out.size(), COcclusionBaker::CTexel{ -1, 0, 0 });
+        for (size_t t = 0; t < targets; t++)
+        {
+            const CPoint2 uv[3] = { target(t, 0).uv, target(t, 1).uv, target(t, 2).uv };
+            COcclusionBaker::_rasterize(uv, (int32_t)t, width, height, texels);
+        }
+
+        CBVH bvh;
+        bvh._construct(sources, [&](size_t t, int k) { return source(t, k).point; }, threads);
+
+        std::vector<char> covered(out.size(), 0);
+        parallel_for(out.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const COcclusionBaker::CTexel & x = texels[i];
+                if (x.triangle < 0) continue;
+                covered[i] = 1;
+                const CRebakeCorner c0 = target(x.triangle, 0), c1 = target(x.triangle, 1), c2 = target(x.triangle, 2);
+                const CPoint p = c0.point * (1.0 - x.b1 - x.b2) + c1.point * x.b1 + c2.point * x.b2;
+                CBVH::CNearest nearest;
+                if (!bvh._closest(p, nearest)) continue;
+                const CRebakeCorner s0 = source(nearest.triangle, 0), s1 = source(nearest.triangle, 1), s2 = source(nearest.triangle, 2);
+                double b1, b2;
+                _weights(s0.point, s1.point, s2.point, nearest.point, b1, b2);
+                const double b0 = 1.0 - b1 - b2;
+                const CPoint2 uv(s0.uv[0] * b0 + s1.uv[0] * b1 + s2.uv[0] * b2, s0.uv[1] * b0 + s1.uv[1] * b1 + s2.uv[1] * b2);
+                out[i] = _sample(texture, texture_width, texture_height, uv);
+            }
+        }, 256);
+
+        _dilate(width, height, out, covered);
+        size_t count = 0;
+        for (char c : covered) count += c != 0;
+        return count;
+    }
+
+    inline uint32_t CTextureRebaker::_sample(const uint32_t * texture, int w, int h, const CPoint2 & uv)
+    {
+        const double x = uv[0] * w - 0.5, y = uv[1] * h - 0.5;
+        const double fx = std::floor(x), fy = std::floor(y);
+        const double ax = x - fx, ay = y - fy;
+        // the texels around, repeated
+        int x0 = (int)std::fmod(fx, (double)w), y0 = (int)std::fmod(fy, (double)h);
+        if (x0 < 0) x0 += w;
+        if (y0 < 0) y0 += h;
+        const int x1 = x0 + 1 == w ? 0 : x0 + 1, y1 = y0 + 1 == h ? 0 : y0 + 1;
+        const uint32_t t00 = texture[(size_t)y0 * w + x0], t10 = texture[(size_t)y0 * w + x1];
+        const uint32_t t01 = texture[(size_t)y1 * w + x0], t11 = texture[(size_t)y1 * w + x1];
+        uint32_t r = 0;
+        for (int s = 0; s < 32; s += 8)
+        {
+            const double c = (1 - ay) * ((1 - ax) * ((t00 >> s) & 255) + ax * ((t10 >> s) & 255))
+                           + ay * ((1 - ax) * ((t01 >> s) & 255) + ax * ((t11 >> s) & 255));
+            r |= (uint32_t)std::min(255.0, c + 0.5) << s;
+        }
+        return r;
+    }
+
+    inline void CTextureRebaker::_dilate(int width, int height, std::vector<uint32_t> & out, const std::vector<char> & covered) const
+    {
+        std::vector<char> filled = covered;
+        std::vector<std::pair<size_t, uint32_t>> ring;
+        for (int r = 0; r < dilate; r++)
+        {
+            // the empty texels next to filled ones take the mean of those, all at once
+            ring.clear();
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                {
+                    const size_t i = (size_t)y * width + x;
+                    if (filled[i]) continue;
+                    uint32_t sum[4] = { 0, 0, 0, 0 };
+                    uint32_t count = 0;
+                    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ny++)
+                        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); nx++)
+                        {
+                            const size_t j = (size_t)ny * width + nx;
+                            if (!filled[j]) continue;
+                            for (int s = 0; s < 4; s++) sum[s] += (out[j] >> (8 * s)) & 255;
+                            count++;
+                        }
+                    if (!count) continue;
+                    uint32_t mean = 0;
+                    for (int s = 0; s < 4; s++) mean |= ((sum[s] + count / 2) / count) << (8 * s);
+                    ring.push_back(std::make_pair(i, mean));
+                }
+            if (ring.empty()) break;
+            for (const std::pair<size_t, uint32_t> & t : ring)
+            {
+                out[t.first] = t.second;
+                filled[t.first] = 1;
+            }
+        }
+    }
+
+}; //namespace
+
+#endif
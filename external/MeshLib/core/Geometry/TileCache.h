@@ -0,0 +1,192 @@
+/*!
+*      \file TileCache.h
+*      \brief Residency of the tiles of a virtual texture in a fixed set of slots
+*
+*      The tiles seen in a frame, and all coarser tiles covering them, are
+*      kept in the slots of a physical texture, the least recently seen ones
+*      make room for new ones. The page table maps every tile of every level
+*      to the slot of the finest resident tile that covers it, so a missing
+*      tile is drawn from a coarser one until it arrives.
+*/
+
+#ifndef _MESHLIB_TILE_CACHE_H_
+#define _MESHLIB_TILE_CACHE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CTileCache class
+     *
+     *  Tiles are numbered level by level, finest first, row by row, the
+     *  numbering of the .vtx files.
+     */
+    class CTileCache
+    {
+    public:
+        /*!
+         *  \param grid_width, grid_height  tiles of every level
+         *  \param side                     slots per side of the physical texture
+         */
+        void init(const std::vector<uint32_t> & grid_width, const std::vector<uint32_t> & grid_height, int side)
+        {
+            m_gw = grid_width;
+            m_gh = grid_height;
+            m_first.assign(m_gw.size() + 1, 0);
+            m_rows.assign(m_gw.size(), 0);
+            for (size_t l = 0; l < m_gw.size(); l++)
+            {
+                m_first[l + 1] = m_first[l] + m_gw[l] * m_gh[l];
+                if (l + 1 < m_gw.size()) m_rows[l + 1] = m_rows[l] + m_gh[l];
+            }
+            m_side = side;
+            const uint32_t tiles = m_first.back();
+            m_slot.assign(tiles, uint32_t(s_none));
+            m_pending.assign(tiles, 0);
+            m_seen.assign(tiles, 0);
+            m_owner.assign((size_t)side * side, uint32_t(s_none));
+            m_pinned.assign((size_t)side * side, 0);
+            m_frame = 1;
+            m_dirty = true;
+        }
+
+        int levels() const { return (int)m_gw.size(); }
+        uint32_t tiles() const { return m_first.empty() ? 0 : m_first.back(); }
+        uint32_t id(int level, uint32_t x, uint32_t y) const { return m_first[level] + y * m_gw[level] + x; }
+        int level_of(uint32_t id) const { return (int)(std::upper_bound(m_first.begin(), m_first.end(), id) - m_first.begin()) - 1; }
+        /*! first page table row of every level */
+        const std::vector<uint32_t> & rows() const { return m_rows; }
+        /*! page table size, the tiles of level 0 wide, the levels stacked */
+        uint32_t table_width() const { return m_gw.empty() ? 0 : m_gw[0]; }
+        uint32_t table_height() const { return m_gw.empty() ? 0 : m_rows.back() + m_gh.back(); }
+
+        /*! slot of a tile, s_none if it is not resident */
+        uint32_t slot(uint32_t id) const { return m_slot[id]; }
+
+        /*!
+         *  Start a frame with the tiles it sampled from, the coarser tiles
+         *  covering them are seen too
+         *  \param visible tile numbers, in any order, repeats allowed
+         *  \param missing the seen tiles neither resident nor pending, coarsest first
+         */
+        void see(const std::vector<uint32_t> & visible, std::vector<uint32_t> & missing)
+        {
+            m_frame++;
+            missing.clear();
+            size_t seen = 0;
+            for (uint32_t t : visible)
+            {
+                if (t >= tiles()) continue;
+                int l = level_of(t);
+                uint32_t x = (t - m_first[l]) % m_gw[l], y = (t - m_first[l]) / m_gw[l];
+                // stop at the first ancestor already seen this frame, the rest of the path is too
+                for (; l < levels(); l++, x /= 2, y /= 2)
+                {
+                    const uint32_t a = id(l, std::min(x, m_gw[l] - 1), std::min(y, m_gh[l] - 1));
+                    if (m_seen[a] == m_frame) break;
+                    m_seen[a] = m_frame;
+                    seen++;
+                    if (m_slot[a] == s_none && !m_pending[a]) missing.push_back(a);
+                }
+            }
+            // the hit rate is 1 - missed / seen
+            MESHLIB_COUNTER_ADD("texture.tiles_seen", seen);
+            MESHLIB_COUNTER_ADD("texture.tiles_missed", missing.size());
+            std::sort(missing.begin(), missing.end(), [](uint32_t a, uint32_t b) { return a > b; });
+        }
+
+        /*! a tile is being read, it is not reported missing again */
+        void set_pending(uint32_t id, bool pending) { m_pending[id] = pending ? 1 : 0; }
+
+        /*!
+         *  Give a tile a slot, a free one or the least recently seen one not
+         *  seen this frame
+         *  \return the slot, s_none if every slot is in use this frame
+         */
+        uint32_t insert(uint32_t id, bool pin = false)
+        {
+            m_pending[id] = 0;
+            if (m_slot[id] != s_none) return m_slot[id];
+            uint32_t best = s_none;
+            uint32_t oldest = m_frame;
+            for (uint32_t s = 0; s < m_owner.size(); s++)
+            {
+                if (m_owner[s] == s_none)
+                {
+                    best = s;
+                    break;
+                }
+                if (m_pinned[s]) continue;
+                const uint32_t seen = m_seen[m_owner[s]];
+                if (seen < oldest)
+                {
+                    oldest = seen;
+                    best = s;
+                }
+            }
+            if (best == s_none) return s_none;
+            if (m_owner[best] != s_none) m_slot[m_owner[best]] = s_none;
+            m_owner[best] = id;
+            m_slot[id] = best;
+            m_pinned[best] = pin ? 1 : 0;
+            m_dirty = true;
+            return best;
+        }
+
+        /*! whether slots changed since the page table was last built */
+        bool dirty() const { return m_dirty; }
+
+        /*!
+         *  The page table, one RGBA8 texel per tile: slot x, slot y, level of
+         *  the resident tile, and 255, or 0 where no covering tile is resident
+         */
+        void page_table(std::vector<uint32_t> & texels)
+        {
+            const uint32_t w = table_width();
+            texels.assign((size_t)w * table_height(), 0);
+            for (int l = levels() - 1; l >= 0; l--)
+            {
+                for (uint32_t y = 0; y < m_gh[l]; y++)
+                {
+                    for (uint32_t x = 0; x < m_gw[l]; x++)
+                    {
+                        uint32_t & out = texels[(size_t)w * (m_rows[l] + y) + x];
+                        const uint32_t s = m_slot[id(l, x, y)];
+                        if (s != s_none)
+                        {
+                            out = (s % m_side) | (s / m_side) << 8 | (uint32_t)l << 16 | 0xffu << 24;
+                        }
+                        else if (l + 1 < levels())
+                        {
+                            const uint32_t px = std::min(x / 2, m_gw[l + 1] - 1), py = std::min(y / 2, m_gh[l + 1] - 1);
+                            out = texels[(size_t)w * (m_rows[l + 1] + py) + px];
+                        }
+                    }
+                }
+            }
+            m_dirty = false;
+        }
+
+        static const uint32_t s_none = 0xffffffffu;
+
+    protected:
+        std::vector<uint32_t> m_gw, m_gh, m_first, m_rows;
+        //! slot of every tile and tile of every slot
+        std::vector<uint32_t> m_slot, m_owner;
+        std::vector<uint32_t> m_seen;
+        std::vector<char>     m_pending, m_pinned;
+        uint32_t m_frame = 1;
+        int      m_side = 0;
+        bool     m_dirty = true;
+    };
+
+}; //namespace
+
+#endif
@@ -11,6 +11,15 @@
 
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLIB_TCI_SSE
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MESHLIB_TCI_AVX
+#endif
+
 #define EPS 10e-5
 #define SIGN3( A ) \
   (((A).x < EPS) ? 4 : 0 | ((A).x > -EPS) ? 32 : 0 | \
@@ -74,7 +83,244 @@ namespace MeshLib
 
             return t_c_intersection(t);
         };
+
+        /*!
+         *  Tests 4 or 8 triangles at once against the unit cube centered on the origin.
+         *  v[i][d][k] is coordinate d of corner i of triangle k. Bit k of the result is
+         *  set when triangle k meets the cube, the opposite of test(), which returns
+         *  INSIDE (0) then.
+         *
+         *  The test is the separating axis test: the cube axes, the nine cross
+         *  products of the cube axes with the triangle edges, and the normal. It is
+         *  exact where test() is off by EPS, so the two may disagree on triangles
+         *  grazing the cube. Float uses SSE, and AVX for 8 triangles; double uses
+         *  SSE2 pairs, and AVX for 4 triangles at a time.
+         */
+        static int batch(const float(&v)[3][3][4]) { return _batch<CF4>(v); };
+        static int batch(const float(&v)[3][3][8]) { return _batch<CF8>(v); };
+        static int batch(const double(&v)[3][3][4]) { return _batch<CD4>(v); };
+        static int batch(const double(&v)[3][3][8]) { return _batch<CPair<CD4> >(v); };
+
+        /*! Fill lane k of a batch with triangle a, b, c */
+        template<typename T, int W>
+        static void pack(T(&v)[3][3][W], int k, const CPoint & a, const CPoint & b, const CPoint & c)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                v[0][d][k] = (T)a[d];
+                v[1][d][k] = (T)b[d];
+                v[2][d][k] = (T)c[d];
+            }
+        };
+
+        /*! Fill lane k of a batch with a triangle far off the cube, for short batches */
+        template<typename T, int W>
+        static void pad(T(&v)[3][3][W], int k)
+        {
+            for (int i = 0; i < 3; i++)
+                for (int d = 0; d < 3; d++)
+                    v[i][d][k] = (T)2;
+        };
     protected:
+        /*
+         *  The lane types of batch(). Each has a vector V of width lanes, a mask M of
+         *  the same lanes, and bits(M) giving one bit per lane. CLanes is the plain
+         *  loop used without SSE, CPair puts two halves side by side.
+         */
+
+        template<typename T, int W>
+        struct CLanes
+        {
+            typedef T Scalar;
+            static const int width = W;
+            struct V { T x[W]; };
+            typedef int M;
+
+            static V load(const T * p) { V r; for (int k = 0; k < W; k++) r.x[k] = p[k]; return r; };
+            static V set1(T a) { V r; for (int k = 0; k < W; k++) r.x[k] = a; return r; };
+            static V add(V a, V b) { for (int k = 0; k < W; k++) a.x[k] += b.x[k]; return a; };
+            static V sub(V a, V b) { for (int k = 0; k < W; k++) a.x[k] -= b.x[k]; return a; };
+            static V mul(V a, V b) { for (int k = 0; k < W; k++) a.x[k] *= b.x[k]; return a; };
+            static V min(V a, V b) { for (int k = 0; k < W; k++) a.x[k] = b.x[k] < a.x[k] ? b.x[k] : a.x[k]; return a; };
+            static V max(V a, V b) { for (int k = 0; k < W; k++) a.x[k] = b.x[k] > a.x[k] ? b.x[k] : a.x[k]; return a; };
+            static V abs(V a) { for (int k = 0; k < W; k++) a.x[k] = a.x[k] < 0 ? -a.x[k] : a.x[k]; return a; };
+            static M gt(V a, V b) { M m = 0; for (int k = 0; k < W; k++) if (a.x[k] > b.x[k]) m |= 1 << k; return m; };
+            static M or_(M a, M b) { return a | b; };
+            static int bits(M m) { return m; };
+        };
+
+        template<typename H>
+        struct CPair
+        {
+            typedef typename H::Scalar Scalar;
+            static const int width = 2 * H::width;
+            struct V { typename H::V lo, hi; };
+            struct M { typename H::M lo, hi; };
+
+            static V load(const Scalar * p) { V r = { H::load(p), H::load(p + H::width) }; return r; };
+            static V set1(Scalar a) { V r = { H::set1(a), H::set1(a) }; return r; };
+            static V add(V a, V b) { V r = { H::add(a.lo, b.lo), H::add(a.hi, b.hi) }; return r; };
+            static V sub(V a, V b) { V r = { H::sub(a.lo, b.lo), H::sub(a.hi, b.hi) }; return r; };
+            static V mul(V a, V b) { V r = { H::mul(a.lo, b.lo), H::mul(a.hi, b.hi) }; return r; };
+            static V min(V a, V b) { V r = { H::min(a.lo, b.lo), H::min(a.hi, b.hi) }; return r; };
+            static V max(V a, V b) { V r = { H::max(a.lo, b.lo), H::max(a.hi, b.hi) }; return r; };
+            static V abs(V a) { V r = { H::abs(a.lo), H::abs(a.hi) }; return r; };
+            static M gt(V a, V b) { M r = { H::gt(a.lo, b.lo), H::gt(a.hi, b.hi) }; return r; };
+            static M or_(M a, M b) { M r = { H::or_(a.lo, b.lo), H::or_(a.hi, b.hi) }; return r; };
+            static int bits(M m) { return H::bits(m.lo) | H::bits(m.hi) << H::width; };
+        };
+
+#ifdef MESHLIB_TCI_SSE
+        struct CF4
+        {
+            typedef float Scalar;
+            static const int width = 4;
+            typedef __m128 V;
+            typedef __m128 M;
+
+            static V load(const float * p) { return _mm_loadu_ps(p); };
+            static V set1(float a) { return _mm_set1_ps(a); };
+            static V add(V a, V b) { return _mm_add_ps(a, b); };
+            static V sub(V a, V b) { return _mm_sub_ps(a, b); };
+            static V mul(V a, V b) { return _mm_mul_ps(a, b); };
+            static V min(V a, V b) { return _mm_min_ps(a, b); };
+            static V max(V a, V b) { return _mm_max_ps(a, b); };
+            static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); };
+            static M gt(V a, V b) { return _mm_cmpgt_ps(a, b); };
+            static M or_(M a, M b) { return _mm_or_ps(a, b); };
+            static int bits(M m) { return _mm_movemask_ps(m); };
+        };
+
+        struct CD2
+        {
+            typedef double Scalar;
+            static const int width = 2;
+            typedef __m128d V;
+            typedef __m128d M;
+
+            static V load(const double * p) { return _mm_loadu_pd(p); };
+            static V set1(double a) { return _mm_set1_pd(a); };
+            static V add(V a, V b) { return _mm_add_pd(a, b); };
+            static V sub(V a, V b) { return _mm_sub_pd(a, b); };
+            static V mul(V a, V b) { return _mm_mul_pd(a, b); };
+            static V min(V a, V b) { return _mm_min_pd(a, b); };
+            static V max(V a, V b) { return _mm_max_pd(a, b); };
+            static V abs(V a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); };
+            static M gt(V a, V b) { return _mm_cmpgt_pd(a, b); };
+            static M or_(M a, M b) { return _mm_or_pd(a, b); };
+            static int bits(M m) { return _mm_movemask_pd(m); };
+        };
+#else
+        typedef CLanes<float, 4>  CF4;
+        typedef CLanes<double, 2> CD2;
+#endif
+
+#ifdef MESHLIB_TCI_AVX
+        struct CF8
+        {
+            typedef float Scalar;
+            static const int width = 8;
+            typedef __m256 V;
+            typedef __m256 M;
+
+            static V load(const float * p) { return _mm256_loadu_ps(p); };
+            static V set1(float a) { return _mm256_set1_ps(a); };
+            static V add(V a, V b) { return _mm256_add_ps(a, b); };
+            static V sub(V a, V b) { return _mm256_sub_ps(a, b); };
+            static V mul(V a, V b) { return _mm256_mul_ps(a, b); };
+            static V min(V a, V b) { return _mm256_min_ps(a, b); };
+            static V max(V a, V b) { return _mm256_max_ps(a, b); };
+            static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); };
+            static M gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); };
+            static M or_(M a, M b) { return _mm256_or_ps(a, b); };
+            static int bits(M m) { return _mm256_movemask_ps(m); };
+        };
+
+        struct CD4
+        {
+            typedef double Scalar;
+            static const int width = 4;
+            typedef __m256d V;
+            typedef __m256d M;
+
+            static V load(const double * p) { return _mm256_loadu_pd(p); };
+            static V set1(double a) { return _mm256_set1_pd(a); };
+            static V add(V a, V b) { return _mm256_add_pd(a, b); };
+            static V sub(V a, V b) { return _mm256_sub_pd(a, b); };
+            static V mul(V a, V b) { return _mm256_mul_pd(a, b); };
+            static V min(V a, V b) { return _mm256_min_pd(a, b); };
+            static V max(V a, V b) { return _mm256_max_pd(a, b); };
+            static V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); };
+            static M gt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); };
+            static M or_(M a, M b) { return _mm256_or_pd(a, b); };
+            static int bits(M m) { return _mm256_movemask_pd(m); };
+        };
+#else
+        typedef CPair<CF4> CF8;
+        typedef CPair<CD2> CD4;
+#endif
+
+        /* or into sep the lanes where the projections p, q lie off [-r, r] */
+        template<typename P>
+        static void _separate(typename P::M & sep, typename P::V p, typename P::V q, typename P::V r, typename P::V nr)
+        {
+            sep = P::or_(sep, P::or_(P::gt(P::min(p, q), r), P::gt(nr, P::max(p, q))));
+        };
+
+        /* The separating axis test of batch(), lane k being triangle k */
+        template<typename P>
+        static int _batch(const typename P::Scalar(&v)[3][3][P::width])
+        {
+            typedef typename P::V V;
+            typedef typename P::M M;
+            const V h = P::set1((typename P::Scalar)0.5);
+            const V nh = P::set1((typename P::Scalar)-0.5);
+
+            V x[3][3];
+            for (int i = 0; i < 3; i++)
+                for (int d = 0; d < 3; d++)
+                    x[i][d] = P::load(v[i][d]);
+
+            /* The cube axes are the bounding box test */
+            M sep = P::gt(nh, P::max(x[0][0], P::max(x[1][0], x[2][0])));
+            for (int d = 0; d < 3; d++)
+            {
+                sep = P::or_(sep, P::gt(P::min(x[0][d], P::min(x[1][d], x[2][d])), h));
+                if (d > 0) sep = P::or_(sep, P::gt(nh, P::max(x[0][d], P::max(x[1][d], x[2][d]))));
+            }
+
+            /* Cube axis cross edge j: the edge ends project alike, so only */
+            /* corner j and the corner off the edge are projected.          */
+            V e[3][3];
+            for (int j = 0; j < 3; j++)
+            {
+                const V * a = x[j];
+                const V * b = x[(j + 2) % 3];
+                for (int d = 0; d < 3; d++) e[j][d] = P::sub(x[(j + 1) % 3][d], a[d]);
+                const V ax = P::abs(e[j][0]), ay = P::abs(e[j][1]), az = P::abs(e[j][2]);
+
+                V r = P::mul(h, P::add(ay, az));
+                _separate<P>(sep, P::sub(P::mul(e[j][1], a[2]), P::mul(e[j][2], a[1])),
+                                  P::sub(P::mul(e[j][1], b[2]), P::mul(e[j][2], b[1])), r, P::sub(P::set1(0), r));
+                r = P::mul(h, P::add(az, ax));
+                _separate<P>(sep, P::sub(P::mul(e[j][2], a[0]), P::mul(e[j][0], a[2])),
+                                  P::sub(P::mul(e[j][2], b[0]), P::mul(e[j][0], b[2])), r, P::sub(P::set1(0), r));
+                r = P::mul(h, P::add(ax, ay));
+                _separate<P>(sep, P::sub(P::mul(e[j][0], a[1]), P::mul(e[j][1], a[0])),
+                                  P::sub(P::mul(e[j][0], b[1]), P::mul(e[j][1], b[0])), r, P::sub(P::set1(0), r));
+            }
+
+            /* The normal, all corners project alike */
+            const V n0 = P::sub(P::mul(e[0][1], e[1][2]), P::mul(e[0][2], e[1][1]));
+            const V n1 = P::sub(P::mul(e[0][2], e[1][0]), P::mul(e[0][0], e[1][2]));
+            const V n2 = P::sub(P::mul(e[0][0], e[1][1]), P::mul(e[0][1], e[1][0]));
+            const V p = P::add(P::mul(n0, x[0][0]), P::add(P::mul(n1, x[0][1]), P::mul(n2, x[0][2])));
+            const V r = P::mul(h, P::add(P::abs(n0), P::add(P::abs(n1), P::abs(n2))));
+            sep = P::or_(sep, P::gt(P::abs(p), r));
+
+            return ~P::bits(sep) & ((1 << P::width) - 1);
+        };
+
         /*___________________________________________________________________________*/
 
         /* Which of the six face-plane(s) is point P outside of? */
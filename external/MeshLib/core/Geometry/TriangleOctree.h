@@ -0,0 +1,246 @@
+/*!
+*      \file TriangleOctree.h
+*      \brief Octree over triangles, the triangles of its leaves as indices in one pool
+*
+*      Only the occupied children of a node are built, a node stops being split
+*      at the depth limit or when it overlaps few enough triangles, and only the
+*      leaves keep their lists. A triangle meets a cell by the separating axis
+*      test, after its bounding box has ruled out most cells.
+*/
+
+#ifndef _MESHLIB_TRIANGLE_OCTREE_H_
+#define _MESHLIB_TRIANGLE_OCTREE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "Point.h"
+#include "LinearOctree.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CTriangleOctree class, a cube subdivided around the triangles it meets
+     */
+    class CTriangleOctree
+    {
+    public:
+        struct CNode
+        {
+            uint64_t code;          //!< Morton code of the cell, 3 bits per level below the root
+            uint32_t begin;         //!< the triangles of a leaf, a range of items()
+            uint32_t end;
+            uint32_t first_child;   //!< index of the first of the occupied children, if any
+            uint8_t  child_mask;    //!< bit 4i + 2j + k for the child at offset (i, j, k)
+            uint8_t  depth;
+
+            bool leaf() const { return child_mask == 0; }
+        };
+
+        /*! the cube from p to q, [-1, 1]^3 as COctree's by default */
+        CTriangleOctree( CPoint p = CPoint( -1, -1, -1 ), CPoint q = CPoint( 1, 1, 1 ) )
+        {
+            m_corner[0] = p;
+            m_corner[1] = q;
+        };
+
+        /*!
+         *  Build the tree over the triangles meeting the cube
+         *  \param triangles number of triangles, corner(t, k) is corner k of triangle t as a CPoint
+         *  \param n the depth limit
+         *  \param leaf_size a node meeting at most this many triangles is a leaf, 0 splits down to depth n
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        template<typename Corner>
+        void _construct( size_t triangles, Corner corner, int n, size_t leaf_size = 0, int threads = 0 );
+
+        size_t size() const { return m_nodes.size(); };
+        const CNode & node( size_t i ) const { return m_nodes[i]; };
+        const CNode & root() const { return m_nodes[0]; };
+        /*! the triangle indices of the leaves */
+        const std::vector<uint32_t> & items() const { return m_items; };
+        int depth() const { return m_depth; };
+
+        /*! the corners of the cell of a node */
+        void _corners( const CNode & node, CPoint & p, CPoint & q ) const
+        {
+            const double len = ( m_corner[1][0] - m_corner[0][0] ) / (double)( 1 << node.depth );
+            uint32_t c[3];
+            CLinearOctree::_compact( node.code, c );
+            p = m_corner[0] + CPoint( c[0], c[1], c[2] ) * len;
+            q = p + CPoint( len, len, len );
+        };
+
+        /*!
+         *  Whether triangle a, b, c meets the box of center o and half width h, by
+         *  the separating axis theorem: the box axes, the triangle normal and the
+         *  nine cross products of the box axes with the triangle edges
+         */
+        static bool _overlap( const CPoint & o, double h, const CPoint & a, const CPoint & b, const CPoint & c )
+        {
+            const CPoint v[3] = { a - o, b - o, c - o };
+            //the box axes are the bounding box test
+            for( int i = 0; i < 3; i ++ )
+            {
+                if( std::min( v[0][i], std::min( v[1][i], v[2][i] ) ) > h ) return false;
+                if( std::max( v[0][i], std::max( v[1][i], v[2][i] ) ) < -h ) return false;
+            }
+
+            const CPoint e[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+            for( int j = 0; j < 3; j ++ )
+            for( int i = 0; i < 3; i ++ )
+            {
+                //axis i cross edge j
+                CPoint axis;
+                axis[( i + 1 ) % 3] = -e[j][( i + 2 ) % 3];
+                axis[( i + 2 ) % 3] =  e[j][( i + 1 ) % 3];
+                if( _separates( axis, v, h ) ) return false;
+            }
+
+            return !_separates( e[0] ^ e[1], v, h );
+        };
+
+    protected:
+        //! nodes with at least this many triangles build their children in parallel
+        static const size_t s_parallel_items = 1 << 12;
+
+        /*! the part of the tree below a node, in its own arrays until it is spliced in */
+        struct CPart
+        {
+            std::vector<CNode>    nodes;
+            std::vector<uint32_t> items;
+        };
+
+        static bool _separates( const CPoint & axis, const CPoint v[3], double h )
+        {
+            const double p0 = axis * v[0], p1 = axis * v[1], p2 = axis * v[2];
+            const double r = h * ( std::fabs( axis[0] ) + std::fabs( axis[1] ) + std::fabs( axis[2] ) );
+            return std::min( p0, std::min( p1, p2 ) ) > r || std::max( p0, std::max( p1, p2 ) ) < -r;
+        };
+
+        /*! split node i of part, which meets the triangles of list */
+        template<typename Corner>
+        void _split( CPart & part, size_t i, std::vector<uint32_t> & list, Corner & corner, size_t leaf_size, int threads ) const;
+
+        CPoint m_corner[2];
+        int m_depth = 0;
+        std::vector<CNode>    m_nodes;
+        std::vector<uint32_t> m_items;
+    };
+
+    template<typename Corner>
+    inline void CTriangleOctree::_construct( size_t triangles, Corner corner, int n, size_t leaf_size, int threads )
+    {
+        m_depth = std::max( 0, std::min( n, (int)CLinearOctree::s_max_depth ) );
+
+        const double h = ( m_corner[1][0] - m_corner[0][0] ) / 2;
+        const CPoint o = ( m_corner[0] + m_corner[1] ) / 2.0;
+        std::vector<uint32_t> list;
+        list.reserve( triangles );
+        for( size_t t = 0; t < triangles; t ++ )
+        {
+            if( _overlap( o, h, corner( t, 0 ), corner( t, 1 ), corner( t, 2 ) ) ) list.push_back( (uint32_t)t );
+        }
+
+        CPart part;
+        CNode root = { 0, 0, 0, 0, 0, 0 };
+        part.nodes.push_back( root );
+        _split( part, 0, list, corner, leaf_size, threads );
+        m_nodes.swap( part.nodes );
+        m_items.swap( part.items );
+    };
+
+    template<typename Corner>
+    inline void CTriangleOctree::_split( CPart & part, size_t i, std::vector<uint32_t> & list, Corner & corner, size_t leaf_size, int threads ) const
+    {
+        const CNode node = part.nodes[i];
+        if( node.depth >= m_depth || list.size() <= leaf_size )
+        {
+            part.nodes[i].begin = (uint32_t)part.items.size();
+            part.items.insert( part.items.end(), list.begin(), list.end() );
+            part.nodes[i].end = (uint32_t)part.items.size();
+            return;
+        }
+
+        CPoint p, q;
+        _corners( node, p, q );
+        const double h = ( q[0] - p[0] ) / 4;
+        const CPoint mid = ( p + q ) / 2.0;
+
+        //the children a triangle may meet are those its bounding box reaches
+        std::vector<uint32_t> lists[8];
+        for( size_t k = 0; k < list.size(); k ++ )
+        {
+            const uint32_t t = list[k];
+            const CPoint a = corner( t, 0 ), b = corner( t, 1 ), c = corner( t, 2 );
+            int lo[3], hi[3];
+            for( int d = 0; d < 3; d ++ )
+            {
+                lo[d] = std::min( a[d], std::min( b[d], c[d] ) ) > mid[d] ? 1 : 0;
+                hi[d] = std::max( a[d], std::max( b[d], c[d] ) ) < mid[d] ? 0 : 1;
+            }
+            for( int x = lo[0]; x <= hi[0]; x ++ )
+            for( int y = lo[1]; y <= hi[1]; y ++ )
+            for( int z = lo[2]; z <= hi[2]; z ++ )
+            {
+                const CPoint o = mid + CPoint( 2 * x - 1, 2 * y - 1, 2 * z - 1 ) * h;
+                if( _overlap( o, h, a, b, c ) ) lists[4 * x + 2 * y + z].push_back( t );
+            }
+        }
+        const size_t items = list.size();
+        list = std::vector<uint32_t>();
+
+        //the occupied children next to each other
+        const size_t first = part.nodes.size();
+        std::vector<int> occupied;
+        for( int c = 0; c < 8; c ++ )
+        {
+            if( lists[c].empty() ) continue;
+            CNode child = { ( node.code << 3 ) | (uint64_t)c, 0, 0, 0, 0, (uint8_t)( node.depth + 1 ) };
+            part.nodes.push_back( child );
+            occupied.push_back( c );
+        }
+        part.nodes[i].first_child = (uint32_t)first;
+        for( int c : occupied ) part.nodes[i].child_mask |= (uint8_t)( 1 << c );
+
+        if( items < s_parallel_items || resolve_threads( threads ) <= 1 )
+        {
+            for( size_t k = 0; k < occupied.size(); k ++ ) _split( part, first + k, lists[occupied[k]], corner, leaf_size, threads );
+            return;
+        }
+
+        //each child builds its subtree in a part of its own, then the parts are appended
+        std::vector<CPart> parts( occupied.size() );
+        parallel_run( (int)occupied.size(), [&]( int k )
+        {
+            parts[k].nodes.push_back( part.nodes[first + k] );
+            _split( parts[k], 0, lists[occupied[k]], corner, leaf_size, threads );
+        } );
+        for( size_t k = 0; k < parts.size(); k ++ )
+        {
+            //node j > 0 of the part moves to base + j - 1, its root to the reserved slot
+            const uint32_t base = (uint32_t)part.nodes.size() - 1;
+            const uint32_t item_base = (uint32_t)part.items.size();
+            for( size_t j = 0; j < parts[k].nodes.size(); j ++ )
+            {
+                CNode n = parts[k].nodes[j];
+                if( n.leaf() )
+                {
+                    n.begin += item_base;
+                    n.end += item_base;
+                }
+                else n.first_child += base;
+                if( j == 0 ) part.nodes[first + k] = n;
+                else part.nodes.push_back( n );
+            }
+            part.items.insert( part.items.end(), parts[k].items.begin(), parts[k].items.end() );
+            parts[k] = CPart();
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,285 @@
+/*!
+*      \file UVOverlap.h
+*      \brief Overlapping triangles in the texture plane
+*
+*      A sweep along u: the triangles are sorted by the low end of their boxes
+*      and every triangle is compared with those after it that start before it
+*      ends and whose boxes overlap its own in v. The pairs the sweep finds are
+*      tested in batches on the exact orientations of CBatch2D, by separating
+*      edges: the insides of two triangles are apart exactly when the line of
+*      an edge of one has the other on its outer side, the line included. So
+*      triangles sharing an edge or a corner, or touching, do not overlap, a
+*      fold over a shared edge does. The sorted triangles are split into
+*      ranges swept on many threads, the result does not depend on how many.
+*/
+
+#ifndef _MESHLIB_UV_OVERLAP_H_
+#define _MESHLIB_UV_OVERLAP_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <utility>
+#include <algorithm>
+#include "Point2.h"
+#include "Batch2D.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CUVOverlap class, the pairs of UV triangles whose insides overlap
+     */
+    class CUVOverlap
+    {
+    public:
+        typedef std::pair<uint32_t, uint32_t> CPair;
+
+        /*!
+         *  Find the overlapping triangles
+         *  \param triangles number of triangles, corner(t, k) is corner k of triangle t as a CPoint2
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        template<typename Corner>
+        void _detect(size_t triangles, Corner corner, int threads = 0);
+
+        /*!
+         *  Find the overlapping triangles of the uv() of the halfedges of faces,
+         *  split into fans as by CUVTree::_construct_faces, face() maps them back
+         */
+        template<typename Faces>
+        void _detect_faces(const Faces & faces, int threads = 0);
+
+        void clear()
+        {
+            m_x.clear();
+            m_y.clear();
+            m_side.clear();
+            m_pairs.clear();
+            m_face.clear();
+            m_candidates = 0;
+        }
+
+        /*! the overlapping triangles t < u, sorted */
+        const std::vector<CPair> & pairs() const { return m_pairs; }
+        /*! the face triangle t is part of, in the order _detect_faces met them */
+        uint32_t face(uint32_t t) const { return m_face.empty() ? t : m_face[t]; }
+        /*! the pairs of overlapping boxes the sweep found and tested exactly */
+        size_t candidates() const { return m_candidates; }
+
+    protected:
+        //! sorted triangles a thread sweeps from at once
+        static const size_t s_sweep = 1 << 10;
+        //! pairs tested at once, 18 orientations each
+        static const size_t s_batch = 64;
+        static const size_t s_rows = 18;
+
+        struct CBox
+        {
+            double lo[2];
+            double hi[2];
+        };
+
+        /* the arrays of one batch, reused from batch to batch */
+        struct CScratch
+        {
+            std::vector<double> p[6];
+            std::vector<int8_t> sign;
+        };
+
+        /* corner k of triangle t */
+        double _x(uint32_t t, int k) const { return m_x[k * m_triangles + t]; }
+        double _y(uint32_t t, int k) const { return m_y[k * m_triangles + t]; }
+
+        void _sweep(const std::vector<CBox> & boxes, int threads);
+        void _test(const std::vector<CPair> & candidates, CScratch & scratch, std::vector<CPair> & overlaps) const;
+
+        size_t                m_triangles = 0;
+        std::vector<double>   m_x;          //!< corner k of triangle t at k * m_triangles + t
+        std::vector<double>   m_y;
+        std::vector<int8_t>   m_side;       //!< the orientation of every triangle, 0 if it has no area
+        std::vector<CPair>    m_pairs;
+        std::vector<uint32_t> m_face;
+        size_t                m_candidates = 0;
+    };
+
+    template<typename Corner>
+    inline void CUVOverlap::_detect(size_t triangles, Corner corner, int threads)
+    {
+        clear();
+        m_triangles = triangles;
+        if (triangles == 0) return;
+
+        m_x.resize(3 * triangles);
+        m_y.resize(3 * triangles);
+        std::vector<CBox> boxes(triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                CBox & box = boxes[t];
+                for (int a = 0; a < 2; a++)
+                {
+                    box.lo[a] = DBL_MAX;
+                    box.hi[a] = -DBL_MAX;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    const CPoint2 p = corner(t, k);
+                    m_x[k * triangles + t] = p[0];
+                    m_y[k * triangles + t] = p[1];
+                    for (int a = 0; a < 2; a++)
+                    {
+                        box.lo[a] = std::min(box.lo[a], p[a]);
+                        box.hi[a] = std::max(box.hi[a], p[a]);
+                    }
+                }
+            }
+        });
+
+        // triangles without area have no inside, the sweep passes them over
+        m_side.resize(triangles);
+        const CBatch2D::CPoints c0 = { &m_x[0], &m_y[0] };
+        const CBatch2D::CPoints c1 = { &m_x[triangles], &m_y[triangles] };
+        const CBatch2D::CPoints c2 = { &m_x[2 * triangles], &m_y[2 * triangles] };
+        CBatch2D::orient(c0, c1, c2, triangles, m_side.data(), threads);
+
+        _sweep(boxes, threads);
+    }
+
+    template<typename Faces>
+    inline void CUVOverlap::_detect_faces(const Faces & faces, int threads)
+    {
+        std::vector<CPoint2> corners;
+        std::vector<uint32_t> face;
+        uint32_t f = 0;
+        for (auto * pf : faces)
+        {
+            auto * first = pf->halfedge();
+            auto * he = first->next();
+            while (he->next() != first)
+            {
+                corners.push_back(first->uv());
+                corners.push_back(he->uv());
+                corners.push_back(he->next()->uv());
+                face.push_back(f);
+                he = he->next();
+            }
+            f++;
+        }
+        _detect(face.size(), [&corners](size_t t, int k) { return corners[3 * t + k]; }, threads);
+        m_face.swap(face);
+    }
+
+    inline void CUVOverlap::_sweep(const std::vector<CBox> & boxes, int threads)
+    {
+        const size_t n = boxes.size();
+        std::vector<std::pair<double, uint32_t>> order(n);
+        for (size_t t = 0; t < n; t++) order[t] = std::make_pair(boxes[t].lo[0], (uint32_t)t);
+        parallel_sort(order.begin(), order.end(), threads, std::less<std::pair<double, uint32_t>>());
+        // the boxes in the order of the sweep, which reads them one after the other
+        std::vector<CBox> sorted(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) sorted[i] = boxes[order[i].second];
+        });
+
+        // the ranges only depend on n, their pairs are joined in order
+        const size_t chunks = std::max<size_t>(1, n / s_sweep);
+        std::vector<std::vector<CPair>> found(chunks);
+        std::vector<size_t> tested(chunks, 0);
+        parallel_for(chunks, threads, [&](size_t b, size_t e)
+        {
+            CScratch scratch;
+            std::vector<CPair> candidates;
+            candidates.reserve(s_batch);
+            for (size_t c = b; c < e; c++)
+            {
+                for (size_t i = n * c / chunks; i < n * (c + 1) / chunks; i++)
+                {
+                    const uint32_t t = order[i].second;
+                    if (m_side[t] == 0) continue;
+                    const CBox & box = sorted[i];
+                    // boxes meeting only on a line hold no overlap of insides
+                    for (size_t j = i + 1; j < n && sorted[j].lo[0] < box.hi[0]; j++)
+                    {
+                        if (sorted[j].lo[1] >= box.hi[1] || sorted[j].hi[1] <= box.lo[1]) continue;
+                        const uint32_t u = order[j].second;
+                        if (m_side[u] == 0) continue;
+                        candidates.push_back(std::make_pair(std::min(t, u), std::max(t, u)));
+                        if (candidates.size() < s_batch) continue;
+                        _test(candidates, scratch, found[c]);
+                        tested[c] += candidates.size();
+                        candidates.clear();
+                    }
+                }
+                if (candidates.empty()) continue;
+                _test(candidates, scratch, found[c]);
+                tested[c] += candidates.size();
+                candidates.clear();
+            }
+        }, 1);
+
+        for (size_t c = 0; c < chunks; c++)
+        {
+            m_pairs.insert(m_pairs.end(), found[c].begin(), found[c].end());
+            m_candidates += tested[c];
+        }
+        std::sort(m_pairs.begin(), m_pairs.end());
+        MESHLIB_COUNTER_ADD("uv_overlap.candidates", m_candidates);
+        MESHLIB_COUNTER_ADD("uv_overlap.pairs", m_pairs.size());
+    }
+
+    inline void CUVOverlap::_test(const std::vector<CPair> & candidates, CScratch & scratch, std::vector<CPair> & overlaps) const
+    {
+        // row 18 q + 9 s + 3 k + v: the edge k, k + 1 of one triangle of pair q, the other one
+        // for s = 1, against the corner v of the other
+        const size_t rows = s_rows * candidates.size();
+        for (auto & p : scratch.p) p.resize(rows);
+        scratch.sign.resize(rows);
+        for (size_t q = 0; q < candidates.size(); q++)
+        {
+            for (int s = 0; s < 2; s++)
+            {
+                const uint32_t t = s ? candidates[q].second : candidates[q].first;
+                const uint32_t u = s ? candidates[q].first : candidates[q].second;
+                for (int k = 0; k < 3; k++)
+                    for (int v = 0; v < 3; v++)
+                    {
+                        const size_t r = s_rows * q + 9 * s + 3 * k + v;
+                        scratch.p[0][r] = _x(t, k);
+                        scratch.p[1][r] = _y(t, k);
+                        scratch.p[2][r] = _x(t, (k + 1) % 3);
+                        scratch.p[3][r] = _y(t, (k + 1) % 3);
+                        scratch.p[4][r] = _x(u, v);
+                        scratch.p[5][r] = _y(u, v);
+                    }
+            }
+        }
+        const CBatch2D::CPoints a = { scratch.p[0].data(), scratch.p[1].data() };
+        const CBatch2D::CPoints b = { scratch.p[2].data(), scratch.p[3].data() };
+        const CBatch2D::CPoints c = { scratch.p[4].data(), scratch.p[5].data() };
+        CBatch2D::orient(a, b, c, rows, scratch.sign.data(), 1);
+
+        for (size_t q = 0; q < candidates.size(); q++)
+        {
+            bool apart = false;
+            for (int s = 0; s < 2 && !apart; s++)
+            {
+                const int inner = m_side[s ? candidates[q].second : candidates[q].first];
+                for (int k = 0; k < 3 && !apart; k++)
+                {
+                    const int8_t * sign = &scratch.sign[s_rows * q + 9 * s + 3 * k];
+                    apart = inner * sign[0] <= 0 && inner * sign[1] <= 0 && inner * sign[2] <= 0;
+                }
+            }
+            if (!apart) overlaps.push_back(candidates[q]);
+        }
+    }
+
+}; //namespace
+
+#endif
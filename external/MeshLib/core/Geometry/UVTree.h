@@ -0,0 +1,332 @@
+/*!
+*      \file UVTree.h
+*      \brief Packed R-tree over triangles in the texture plane
+*
+*      The triangles are sorted by the Morton code of the centers of their
+*      boxes and packed, s_fanout at a time, into leaves; the leaves are
+*      packed the same way into the level above, up to a single root. Every
+*      level is a range of one node array and the children of node i are the
+*      nodes, or the triangles, s_fanout i.. s_fanout i + s_fanout - 1 of the
+*      level below, so the tree holds no pointers. Queries only read the tree
+*      and may run on many threads at once.
+*/
+
+#ifndef _MESHLIB_UV_TREE_H_
+#define _MESHLIB_UV_TREE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <utility>
+#include <algorithm>
+#include "Point2.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CUVTree class, point location and rectangle queries over UV triangles
+     */
+    class CUVTree
+    {
+    public:
+        struct CNode
+        {
+            double lo[2];
+            double hi[2];
+        };
+
+        /*!
+         *  Build the tree
+         *  \param triangles number of triangles, corner(t, k) is corner k of triangle t as a CPoint2
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        template<typename Corner>
+        void _construct(size_t triangles, Corner corner, int threads = 0);
+
+        /*!
+         *  Build the tree over the uv() of the halfedges of faces, a range of face
+         *  pointers such as CBaseMesh::faces(). Polygons are split into fans around
+         *  their first corner, face() maps triangles back.
+         */
+        template<typename Faces>
+        void _construct_faces(const Faces & faces, int threads = 0);
+
+        void clear()
+        {
+            m_nodes.clear();
+            m_levels.clear();
+            m_corners.clear();
+            m_index.clear();
+            m_face.clear();
+        }
+
+        bool empty() const { return m_index.empty(); }
+        /*! number of triangles */
+        size_t triangles() const { return m_index.size(); }
+        /*! corner k of triangle t, in the numbering given to _construct */
+        const CPoint2 & corner(uint32_t t, int k) const { return m_corners[3 * (size_t)t + k]; }
+        /*! the face triangle t is part of, in the order _construct_faces met them */
+        uint32_t face(uint32_t t) const { return m_face.empty() ? t : m_face[t]; }
+
+        /*!
+         *  A triangle holding p, edges included, -1 if there is none. Triangles
+         *  of either orientation are found, those of zero area never.
+         */
+        long _locate(const CPoint2 & p) const;
+
+        /*! out[i] = _locate(p[i]) for n points, on threads threads */
+        void _locate(const CPoint2 * p, size_t n, long * out, int threads = 0) const
+        {
+            parallel_for(n, threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) out[i] = _locate(p[i]);
+            }, s_parallel_queries);
+        }
+
+        /*! append the triangles meeting the rectangle lo, hi, boundaries included */
+        void _query(const CPoint2 & lo, const CPoint2 & hi, std::vector<uint32_t> & triangles) const;
+
+        //! children of a node, triangles of a leaf
+        static const size_t s_fanout = 8;
+
+    protected:
+        //! queries handed to a thread at once
+        static const size_t s_parallel_queries = 1 << 10;
+
+        /* the box of triangle t */
+        CNode _box(uint32_t t) const
+        {
+            CNode b;
+            for (int a = 0; a < 2; a++)
+            {
+                const double x = m_corners[3 * (size_t)t][a], y = m_corners[3 * (size_t)t + 1][a], z = m_corners[3 * (size_t)t + 2][a];
+                b.lo[a] = std::min(x, std::min(y, z));
+                b.hi[a] = std::max(x, std::max(y, z));
+            }
+            return b;
+        }
+
+        static CNode _join(CNode a, const CNode & b)
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                a.lo[k] = std::min(a.lo[k], b.lo[k]);
+                a.hi[k] = std::max(a.hi[k], b.hi[k]);
+            }
+            return a;
+        }
+
+        /* (b - a) ^ (c - a) */
+        static double _orient(const CPoint2 & a, const CPoint2 & b, const CPoint2 & c)
+        {
+            return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+        }
+
+        bool _inside(uint32_t t, const CPoint2 & p) const;
+        bool _meets(uint32_t t, const CPoint2 & lo, const CPoint2 & hi) const;
+
+        /* spread the low 16 bits of x to the even bits */
+        static uint32_t _spread(uint32_t x)
+        {
+            x &= 0xffff;
+            x = (x | (x << 8)) & 0x00ff00ff;
+            x = (x | (x << 4)) & 0x0f0f0f0f;
+            x = (x | (x << 2)) & 0x33333333;
+            x = (x | (x << 1)) & 0x55555555;
+            return x;
+        }
+
+        std::vector<CNode>    m_nodes;      //!< the leaves first, the root last
+        std::vector<size_t>   m_levels;     //!< level l is m_nodes[m_levels[l], m_levels[l + 1])
+        std::vector<CPoint2>  m_corners;    //!< three per triangle, in the order of the leaves
+        std::vector<uint32_t> m_index;      //!< the triangle numbers given to _construct, in the order of the leaves
+        std::vector<uint32_t> m_face;
+    };
+
+    template<typename Corner>
+    inline void CUVTree::_construct(size_t triangles, Corner corner, int threads)
+    {
+        clear();
+        if (triangles == 0) return;
+
+        // the Morton codes of the box centers on a 2^16 grid over all of them
+        std::vector<CPoint2> center(triangles);
+        CNode all = { { DBL_MAX, DBL_MAX }, { -DBL_MAX, -DBL_MAX } };
+        all = parallel_reduce(triangles, threads, all, [&](size_t b, size_t e, CNode & acc)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const CPoint2 p = corner(t, 0), q = corner(t, 1), r = corner(t, 2);
+                CPoint2 & c = center[t];
+                for (int a = 0; a < 2; a++)
+                {
+                    const double lo = std::min(p[a], std::min(q[a], r[a])), hi = std::max(p[a], std::max(q[a], r[a]));
+                    c[a] = (lo + hi) / 2;
+                    acc.lo[a] = std::min(acc.lo[a], c[a]);
+                    acc.hi[a] = std::max(acc.hi[a], c[a]);
+                }
+            }
+        }, [](CNode a, const CNode & b) { return _join(a, b); });
+
+        std::vector<std::pair<uint32_t, uint32_t>> keys(triangles);
+        double scale[2];
+        for (int a = 0; a < 2; a++) scale[a] = all.hi[a] > all.lo[a] ? 65535.0 / (all.hi[a] - all.lo[a]) : 0;
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const uint32_t x = (uint32_t)((center[t][0] - all.lo[0]) * scale[0]);
+                const uint32_t y = (uint32_t)((center[t][1] - all.lo[1]) * scale[1]);
+                keys[t] = std::make_pair(_spread(x) | (_spread(y) << 1), (uint32_t)t);
+            }
+        });
+        parallel_sort(keys.begin(), keys.end(), threads, std::less<std::pair<uint32_t, uint32_t>>());
+
+        m_index.resize(triangles);
+        m_corners.resize(3 * triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                m_index[i] = keys[i].second;
+                for (int k = 0; k < 3; k++) m_corners[3 * i + k] = corner(m_index[i], k);
+            }
+        });
+
+        // the leaves, then every level from the one below
+        size_t below = triangles;
+        m_levels.push_back(0);
+        do
+        {
+            const size_t first = m_nodes.size(), count = (below + s_fanout - 1) / s_fanout;
+            const size_t child = m_levels.size() == 1 ? 0 : m_levels[m_levels.size() - 2];
+            const bool leaves = m_levels.size() == 1;
+            m_nodes.resize(first + count);
+            parallel_for(count, threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++)
+                {
+                    const size_t c0 = i * s_fanout, c1 = std::min(below, c0 + s_fanout);
+                    CNode box = leaves ? _box((uint32_t)c0) : m_nodes[child + c0];
+                    for (size_t c = c0 + 1; c < c1; c++) box = _join(box, leaves ? _box((uint32_t)c) : m_nodes[child + c]);
+                    m_nodes[first + i] = box;
+                }
+            }, 1 << 12);
+            m_levels.push_back(m_nodes.size());
+            below = count;
+        } while (below > 1);
+    }
+
+    template<typename Faces>
+    inline void CUVTree::_construct_faces(const Faces & faces, int threads)
+    {
+        std::vector<CPoint2> corners;
+        std::vector<uint32_t> face;
+        uint32_t f = 0;
+        for (auto * pf : faces)
+        {
+            auto * first = pf->halfedge();
+            auto * he = first->next();
+            while (he->next() != first)
+            {
+                corners.push_back(first->uv());
+                corners.push_back(he->uv());
+                corners.push_back(he->next()->uv());
+                face.push_back(f);
+                he = he->next();
+            }
+            f++;
+        }
+        _construct(face.size(), [&corners](size_t t, int k) { return corners[3 * t + k]; }, threads);
+        // face() is looked up by the triangle numbers given to _construct
+        m_face.swap(face);
+    }
+
+    inline bool CUVTree::_inside(uint32_t t, const CPoint2 & p) const
+    {
+        const CPoint2 & a = m_corners[3 * (size_t)t], & b = m_corners[3 * (size_t)t + 1], & c = m_corners[3 * (size_t)t + 2];
+        const double area = _orient(a, b, c);
+        if (area == 0) return false;
+        const double u = _orient(a, b, p), v = _orient(b, c, p), w = _orient(c, a, p);
+        return area > 0 ? (u >= 0 && v >= 0 && w >= 0) : (u <= 0 && v <= 0 && w <= 0);
+    }
+
+    inline bool CUVTree::_meets(uint32_t t, const CPoint2 & lo, const CPoint2 & hi) const
+    {
+        // the boxes overlap, so only the normals of the edges can separate
+        const CPoint2 * v = &m_corners[3 * (size_t)t];
+        for (int k = 0; k < 3; k++)
+        {
+            const CPoint2 & a = v[k], & b = v[(k + 1) % 3], & c = v[(k + 2) % 3];
+            const double nx = a[1] - b[1], ny = b[0] - a[0];
+            if (nx == 0 && ny == 0) continue;
+            const double d = nx * a[0] + ny * a[1];
+            const double s = nx * c[0] + ny * c[1] - d;
+            // the corner of the rectangle farthest to the side of the triangle
+            const double x = (nx > 0) == (s > 0) ? hi[0] : lo[0];
+            const double y = (ny > 0) == (s > 0) ? hi[1] : lo[1];
+            const double r = nx * x + ny * y - d;
+            if (s > 0 ? r < 0 : (s < 0 ? r > 0 : false)) return false;
+        }
+        return true;
+    }
+
+    inline long CUVTree::_locate(const CPoint2 & p) const
+    {
+        if (m_nodes.empty()) return -1;
+        const int top = (int)m_levels.size() - 2;
+        std::pair<int, size_t> stack[64 * s_fanout];
+        int n = 0;
+        stack[n++] = std::make_pair(top, (size_t)0);
+        while (n > 0)
+        {
+            const int level = stack[n - 1].first;
+            const size_t i = stack[--n].second;
+            const CNode & box = m_nodes[m_levels[level] + i];
+            if (p[0] < box.lo[0] || p[0] > box.hi[0] || p[1] < box.lo[1] || p[1] > box.hi[1]) continue;
+            const size_t c0 = i * s_fanout;
+            const size_t c1 = std::min(c0 + s_fanout, level == 0 ? m_index.size() : m_levels[level] - m_levels[level - 1]);
+            for (size_t c = c0; c < c1; c++)
+            {
+                if (level > 0) stack[n++] = std::make_pair(level - 1, c);
+                else if (_inside((uint32_t)c, p)) return m_index[c];
+            }
+        }
+        return -1;
+    }
+
+    inline void CUVTree::_query(const CPoint2 & lo, const CPoint2 & hi, std::vector<uint32_t> & triangles) const
+    {
+        if (m_nodes.empty()) return;
+        const int top = (int)m_levels.size() - 2;
+        std::pair<int, size_t> stack[64 * s_fanout];
+        int n = 0;
+        stack[n++] = std::make_pair(top, (size_t)0);
+        while (n > 0)
+        {
+            const int level = stack[n - 1].first;
+            const size_t i = stack[--n].second;
+            const CNode & box = m_nodes[m_levels[level] + i];
+            if (hi[0] < box.lo[0] || lo[0] > box.hi[0] || hi[1] < box.lo[1] || lo[1] > box.hi[1]) continue;
+            const size_t c0 = i * s_fanout;
+            const size_t c1 = std::min(c0 + s_fanout, level == 0 ? m_index.size() : m_levels[level] - m_levels[level - 1]);
+            for (size_t c = c0; c < c1; c++)
+            {
+                if (level > 0)
+                {
+                    stack[n++] = std::make_pair(level - 1, c);
+                    continue;
+                }
+                const CNode t = _box((uint32_t)c);
+                if (hi[0] < t.lo[0] || lo[0] > t.hi[0] || hi[1] < t.lo[1] || lo[1] > t.hi[1]) continue;
+                if (_meets((uint32_t)c, lo, hi)) triangles.push_back(m_index[c]);
+            }
+        }
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,311 @@
+/*!
+*      \file VertexCacheOptimizer.h
+*      \brief Triangle and vertex order of an index buffer for the GPU vertex caches
+*
+*      tipsify() orders the triangles for a post-transform cache of a given size
+*      (Sander, Nehab and Barczak, Fast Triangle Reordering for Vertex Locality
+*      and Reduced Overdraw, 2007), reduce_overdraw() then cuts that order into
+*      clusters and sorts them front to back as seen from outside, and
+*      reorder_vertices() numbers the vertices in the order they are first fetched.
+*/
+
+#ifndef _MESHLIB_VERTEX_CACHE_OPTIMIZER_H_
+#define _MESHLIB_VERTEX_CACHE_OPTIMIZER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CVertexCacheOptimizer class
+     */
+    class CVertexCacheOptimizer
+    {
+    public:
+        /*!
+         *  Average cache miss ratio, transformed vertices per triangle, of a FIFO cache
+         *  \param indices three vertex indices per triangle
+         *  \param n       number of indices
+         *  \param nv      number of vertices
+         *  \param cache   cache size
+         */
+        static double acmr(const uint32_t * indices, size_t n, size_t nv, int cache = s_cache_size)
+        {
+            if (n < 3) return 0;
+            // a vertex is cached if it entered the FIFO less than `cache` misses ago
+            std::vector<size_t> entered(nv, 0);
+            size_t misses = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                size_t & e = entered[indices[i]];
+                if (e == 0 || misses + 1 - e >= (size_t)cache)
+                {
+                    misses++;
+                    e = misses;
+                }
+            }
+            return (double)misses / (double)(n / 3);
+        }
+
+        /*!
+         *  Reorder the triangles of the index buffer in place
+         *  \param tags if not NULL, a value per triangle, as the face it came from, moved along with it
+         */
+        static void tipsify(uint32_t * indices, size_t n, size_t nv, int cache = s_cache_size, std::vector<uint32_t> * tags = NULL)
+        {
+            const size_t nt = n / 3;
+            // triangles of every vertex
+            std::vector<uint32_t> start(nv + 1, 0), tris(3 * nt);
+            for (size_t i = 0; i < 3 * nt; i++) start[indices[i] + 1]++;
+            for (size_t v = 0; v < nv; v++) start[v + 1] += start[v];
+            std::vector<int> live(nv);
+            for (size_t v = 0; v < nv; v++) live[v] = (int)(start[v + 1] - start[v]);
+            {
+                std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+                for (size_t i = 0; i < 3 * nt; i++) tris[fill[indices[i]]++] = (uint32_t)(i / 3);
+            }
+
+            std::vector<size_t>   stamp(nv, 0);
+            std::vector<char>     emitted(nt, 0);
+            std::vector<uint32_t> dead_end, candidates, out, moved;
+            out.reserve(3 * nt);
+            if (tags) moved.reserve(nt);
+
+            size_t time = (size_t)cache + 1;
+            size_t cursor = 0;
+            int fan = nv ? 0 : -1;
+            while (fan >= 0)
+            {
+                // emit every triangle around the fanning vertex
+                candidates.clear();
+                for (uint32_t k = start[fan]; k < start[fan + 1]; k++)
+                {
+                    uint32_t t = tris[k];
+                    if (emitted[t]) continue;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        uint32_t v = indices[3 * t + c];
+                        out.push_back(v);
+                        dead_end.push_back(v);
+                        candidates.push_back(v);
+                        live[v]--;
+                        if (time - stamp[v] > (size_t)cache)
+                        {
+                            stamp[v] = time;
+                            time++;
+                        }
+                    }
+                    emitted[t] = 1;
+                    if (tags) moved.push_back((*tags)[t]);
+                }
+
+                // the candidate that is still cached after its remaining fan
+                fan = -1;
+                int best = -1;
+                for (uint32_t v : candidates)
+                {
+                    if (live[v] <= 0) continue;
+                    int priority = 0;
+                    if (time - stamp[v] + 2 * (size_t)live[v] <= (size_t)cache) priority = (int)(time - stamp[v]);
+                    if (priority > best)
+                    {
+                        best = priority;
+                        fan = (int)v;
+                    }
+                }
+                if (fan >= 0) continue;
+
+                // dead end, go back to a recent vertex or on to the next unfinished one
+                while (!dead_end.empty() && fan < 0)
+                {
+                    uint32_t v = dead_end.back();
+                    dead_end.pop_back();
+                    if (live[v] > 0) fan = (int)v;
+                }
+                if (fan >= 0) continue;
+                while (cursor < nv && live[cursor] <= 0) cursor++;
+                if (cursor < nv) fan = (int)cursor;
+            }
+            std::copy(out.begin(), out.end(), indices);
+            if (tags) tags->swap(moved);
+        }
+
+        /*!
+         *  Reorder the clusters of a cache optimized order so that the ones facing
+         *  away from the center come first, they tend to occlude the others.
+         *  A cluster ends where the order starts over with an empty cache, or
+         *  as soon as its cache miss ratio is within `threshold` times that of
+         *  the whole stretch, so splitting costs little vertex locality.
+         *  \param positions 3 floats per vertex
+         *  \param starts    if not NULL, the first triangle of every cluster in the new order
+         *  \param tags      if not NULL, a value per triangle moved along with it, as for tipsify
+         *  \return          number of clusters
+         */
+        static size_t reduce_overdraw(uint32_t * indices, size_t n, size_t nv, const float * positions,
+            int cache = s_cache_size, double threshold = 1.05, std::vector<size_t> * starts = NULL,
+            std::vector<uint32_t> * tags = NULL)
+        {
+            std::vector<size_t> clusters;
+            _clusters(indices, n, nv, cache, threshold, clusters);
+            const size_t nt = n / 3;
+            if (clusters.size() < 2)
+            {
+                if (starts) *starts = clusters;
+                return clusters.size();
+            }
+
+            double center[3] = { 0, 0, 0 };
+            for (size_t i = 0; i < 3 * nt; i++)
+            {
+                for (int d = 0; d < 3; d++) center[d] += positions[3 * indices[i] + d];
+            }
+            for (int d = 0; d < 3; d++) center[d] /= (double)(3 * nt);
+
+            struct CCluster { size_t begin, end; double key; };
+            std::vector<CCluster> cs(clusters.size());
+            for (size_t c = 0; c < clusters.size(); c++)
+            {
+                CCluster & cl = cs[c];
+                cl.begin = clusters[c];
+                cl.end = c + 1 < clusters.size() ? clusters[c + 1] : nt;
+
+                // area weighted normal and centroid of the cluster
+                double normal[3] = { 0, 0, 0 }, centroid[3] = { 0, 0, 0 }, area = 0;
+                for (size_t t = cl.begin; t < cl.end; t++)
+                {
+                    const float * a = positions + 3 * indices[3 * t];
+                    const float * b = positions + 3 * indices[3 * t + 1];
+                    const float * p = positions + 3 * indices[3 * t + 2];
+                    double u[3], v[3], w[3];
+                    for (int d = 0; d < 3; d++) { u[d] = b[d] - a[d]; v[d] = p[d] - a[d]; }
+                    w[0] = u[1] * v[2] - u[2] * v[1];
+                    w[1] = u[2] * v[0] - u[0] * v[2];
+                    w[2] = u[0] * v[1] - u[1] * v[0];
+                    double s = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+                    for (int d = 0; d < 3; d++)
+                    {
+                        normal[d] += w[d];
+                        centroid[d] += s * (a[d] + b[d] + p[d]) / 3;
+                    }
+                    area += s;
+                }
+                cl.key = 0;
+                if (area > 0)
+                {
+                    for (int d = 0; d < 3; d++) cl.key += (centroid[d] / area - center[d]) * normal[d];
+                    cl.key /= area;
+                }
+            }
+            std::stable_sort(cs.begin(), cs.end(), [](const CCluster & a, const CCluster & b) { return a.key > b.key; });
+
+            std::vector<uint32_t> out, moved;
+            out.reserve(3 * nt);
+            if (tags) moved.reserve(nt);
+            if (starts) starts->clear();
+            for (const CCluster & cl : cs)
+            {
+                if (starts) starts->push_back(out.size() / 3);
+                out.insert(out.end(), indices + 3 * cl.begin, indices + 3 * cl.end);
+                if (tags) moved.insert(moved.end(), tags->begin() + cl.begin, tags->begin() + cl.end);
+            }
+            std::copy(out.begin(), out.end(), indices);
+            if (tags) tags->swap(moved);
+            return clusters.size();
+        }
+
+        /*!
+         *  Renumber the vertices in the order the triangles first use them
+         *  \param order old index of every new vertex, unused vertices come last
+         */
+        static void reorder_vertices(uint32_t * indices, size_t n, size_t nv, std::vector<uint32_t> & order)
+        {
+            const uint32_t none = (uint32_t)-1;
+            std::vector<uint32_t> renumber(nv, none);
+            order.clear();
+            order.reserve(nv);
+            for (size_t i = 0; i < n; i++)
+            {
+                uint32_t & r = renumber[indices[i]];
+                if (r == none)
+                {
+                    r = (uint32_t)order.size();
+                    order.push_back(indices[i]);
+                }
+                indices[i] = r;
+            }
+            for (size_t v = 0; v < nv; v++)
+            {
+                if (renumber[v] == none) order.push_back((uint32_t)v);
+            }
+        }
+
+        //! FIFO size the defaults assume, small enough to help on every GPU
+        static const int s_cache_size = 16;
+
+    protected:
+        /*! first triangle of every cluster */
+        static void _clusters(const uint32_t * indices, size_t n, size_t nv, int cache, double threshold, std::vector<size_t> & clusters)
+        {
+            const size_t nt = n / 3;
+            // FIFO simulation as in acmr(), restarted at every cluster
+            std::vector<size_t> entered(nv, 0);
+            size_t misses = 0, base = 0;
+            auto miss = [&](size_t t)
+            {
+                int m = 0;
+                for (int c = 0; c < 3; c++)
+                {
+                    size_t & e = entered[indices[3 * t + c]];
+                    if (e <= base || misses + 1 - e >= (size_t)cache)
+                    {
+                        misses++;
+                        e = misses;
+                        m++;
+                    }
+                }
+                return m;
+            };
+
+            // hard boundaries, triangles that miss all their vertices
+            std::vector<size_t> hard;
+            for (size_t t = 0; t < nt; t++)
+            {
+                if (miss(t) == 3) hard.push_back(t);
+            }
+            hard.push_back(nt);
+
+            clusters.clear();
+            for (size_t h = 0; h + 1 < hard.size(); h++)
+            {
+                // the miss ratio of the whole hard cluster, then cut where a prefix does as well
+                const size_t b = hard[h], e = hard[h + 1];
+                base = misses;
+                size_t start = misses;
+                for (size_t t = b; t < e; t++) miss(t);
+                const double target = threshold * (double)(misses - start) / (double)(e - b);
+
+                clusters.push_back(b);
+                base = misses;
+                start = misses;
+                for (size_t t = b; t < e; t++)
+                {
+                    miss(t);
+                    if (t + 1 < e && (double)(misses - start) <= target * (double)(t + 1 - clusters.back()))
+                    {
+                        clusters.push_back(t + 1);
+                        base = misses;
+                        start = misses;
+                    }
+                }
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,131 @@
+/*!
+*      \file VertexQuantizer.h
+*      \brief Compact encodings of vertex attributes for the GPU
+*
+*      16 bit normalized integers for coordinates in [-1, 1], half floats,
+*      and octahedral unit vectors, a normal in two 16 bit integers. Each
+*      encoding comes with its decoding, which the shaders mirror.
+*/
+
+#ifndef _MESHLIB_VERTEX_QUANTIZER_H_
+#define _MESHLIB_VERTEX_QUANTIZER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CVertexQuantizer class
+     */
+    class CVertexQuantizer
+    {
+    public:
+        /*! v in [-1, 1] to a signed normalized 16 bit integer, clamped */
+        static int16_t snorm16(float v)
+        {
+            v = std::max(-1.0f, std::min(1.0f, v));
+            return (int16_t)std::lround(v * 32767.0f);
+        }
+
+        /*! the decoding of OpenGL, -32768 maps to -1 like -32767 */
+        static float from_snorm16(int16_t q)
+        {
+            return std::max(-1.0f, (float)q / 32767.0f);
+        }
+
+        /*! IEEE half float, rounded to nearest even, too large values become infinite */
+        static uint16_t half(float f)
+        {
+            uint32_t x;
+            memcpy(&x, &f, sizeof(x));
+            const uint32_t sign = (x >> 16) & 0x8000;
+            const uint32_t a = x & 0x7fffffff;
+
+            // infinity and NaN, NaN stays quiet
+            if (a >= 0x7f800000) return (uint16_t)(sign | (a > 0x7f800000 ? 0x7e00 : 0x7c00));
+            // 65520 and up round to infinity
+            if (a >= 0x477ff000) return (uint16_t)(sign | 0x7c00);
+            if (a < 0x38800000)
+            {
+                // subnormal, the scaling by 2^24 is exact and nearbyint rounds to even
+                float af;
+                memcpy(&af, &a, sizeof(af));
+                return (uint16_t)(sign | (uint32_t)std::nearbyint(af * 16777216.0f));
+            }
+            // rebias the exponent from 127 to 15 and round the 13 dropped bits
+            uint32_t h = (a - 0x38000000) >> 13;
+            const uint32_t rest = a & 0x1fff;
+            if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) h++;
+            return (uint16_t)(sign | h);
+        }
+
+        static float from_half(uint16_t h)
+        {
+            const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+            const uint32_t e = (h >> 10) & 0x1f;
+            const uint32_t m = h & 0x3ff;
+            uint32_t x;
+            if (e == 0)
+            {
+                float f = (float)m / 16777216.0f;
+                memcpy(&x, &f, sizeof(x));
+                x |= sign;
+            }
+            else if (e == 31) x = sign | 0x7f800000 | (m << 13);
+            else x = sign | ((e + 112) << 23) | (m << 13);
+            float f;
+            memcpy(&f, &x, sizeof(f));
+            return f;
+        }
+
+        /*!
+         *  Unit vector to octahedral coordinates, the vector projected onto the
+         *  octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper
+         *  \param n   the vector, need not be normalized, not zero
+         *  \param out two signed normalized 16 bit integers
+         */
+        static void octahedral(const float n[3], int16_t out[2])
+        {
+            const float l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+            float x = n[0] / l1, y = n[1] / l1;
+            if (n[2] < 0)
+            {
+                const float fx = (1 - std::fabs(y)) * _sign(x);
+                const float fy = (1 - std::fabs(x)) * _sign(y);
+                x = fx;
+                y = fy;
+            }
+            out[0] = snorm16(x);
+            out[1] = snorm16(y);
+        }
+
+        /*! the unit vector of octahedral coordinates */
+        static void from_octahedral(const int16_t q[2], float n[3])
+        {
+            float x = from_snorm16(q[0]), y = from_snorm16(q[1]);
+            float z = 1 - std::fabs(x) - std::fabs(y);
+            if (z < 0)
+            {
+                const float fx = (1 - std::fabs(y)) * _sign(x);
+                const float fy = (1 - std::fabs(x)) * _sign(y);
+                x = fx;
+                y = fy;
+            }
+            const float l = std::sqrt(x * x + y * y + z * z);
+            n[0] = x / l;
+            n[1] = y / l;
+            n[2] = z / l;
+        }
+
+    protected:
+        //! sign with +1 for zero, so the fold is continuous on the axes
+        static float _sign(float v) { return v < 0 ? -1.0f : 1.0f; }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,126 @@
+/*!
+*      \file VertexWelder.h
+*      \brief Merging the corners of a triangle list into unique render vertices
+*
+*      A render vertex is a mesh vertex with one uv and one normal. Corners
+*      of the same vertex whose uv and normal are bitwise equal become one
+*      render vertex, so a triangle list indexes them instead of repeating
+*      every attribute once per corner.
+*/
+
+#ifndef _MESHLIB_VERTEX_WELDER_H_
+#define _MESHLIB_VERTEX_WELDER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CVertexWelder class
+     */
+    class CVertexWelder
+    {
+    public:
+        /*!
+         *  Weld n corners
+         *  \param nv       number of mesh vertices, every corner_vertex is below it
+         *  \param corner_vertex mesh vertex of every corner
+         *  \param n        number of corners
+         *  \param uv       2 floats per corner, or NULL
+         *  \param normal   3 floats per corner, or NULL
+         *  \param unique   the first corner of every render vertex, render vertices
+         *                  are numbered by mesh vertex, then by first corner
+         *  \param indices  render vertex of every corner
+         *  \param threads  number of threads, 0 uses all hardware threads
+         */
+        static void weld(size_t nv, const uint32_t * corner_vertex, size_t n, const float * uv, const float * normal,
+            std::vector<uint32_t> & unique, std::vector<uint32_t> & indices, int threads = 0)
+        {
+            // the corners of every vertex, in corner order
+            std::vector<uint32_t> start(nv + 1, 0), order(n);
+            for (size_t c = 0; c < n; c++) start[corner_vertex[c] + 1]++;
+            for (size_t v = 0; v < nv; v++) start[v + 1] += start[v];
+            {
+                std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+                for (size_t c = 0; c < n; c++) order[fill[corner_vertex[c]]++] = (uint32_t)c;
+            }
+
+            // number the distinct attributes of every vertex, indices holds the local number first
+            auto equal = [&](uint32_t a, uint32_t b)
+            {
+                return (!uv || memcmp(uv + 2 * a, uv + 2 * b, 2 * sizeof(float)) == 0) &&
+                    (!normal || memcmp(normal + 3 * a, normal + 3 * b, 3 * sizeof(float)) == 0);
+            };
+            auto less = [&](uint32_t a, uint32_t b)
+            {
+                int r = uv ? memcmp(uv + 2 * a, uv + 2 * b, 2 * sizeof(float)) : 0;
+                if (r == 0 && normal) r = memcmp(normal + 3 * a, normal + 3 * b, 3 * sizeof(float));
+                return r != 0 ? r < 0 : a < b;
+            };
+            indices.resize(n);
+            std::vector<char>     first(n, 0);
+            std::vector<uint32_t> count(nv + 1, 0);
+            parallel_for(nv, threads, [&](size_t b, size_t e)
+            {
+                for (size_t v = b; v < e; v++)
+                {
+                    uint32_t * cb = order.data() + start[v];
+                    uint32_t * ce = order.data() + start[v + 1];
+                    uint32_t k = 0;
+                    if (ce - cb > s_linear_group)
+                    {
+                        // high valence, sort to find the equal ones
+                        std::sort(cb, ce, less);
+                        for (uint32_t * c = cb; c < ce; c++)
+                        {
+                            if (c == cb || !equal(c[-1], *c)) { first[*c] = 1; k++; }
+                            indices[*c] = k - 1;
+                        }
+                    }
+                    else for (uint32_t * c = cb; c < ce; c++)
+                    {
+                        uint32_t j = 0;
+                        for (uint32_t * p = cb; p < c; p++)
+                        {
+                            if (!first[*p]) continue;
+                            if (equal(*p, *c)) break;
+                            j++;
+                        }
+                        if (j == k) { first[*c] = 1; k++; }
+                        indices[*c] = j;
+                    }
+                    count[v + 1] = k;
+                }
+            }, 1 << 12);
+            for (size_t v = 0; v < nv; v++) count[v + 1] += count[v];
+
+            unique.resize(count[nv]);
+            parallel_for(nv, threads, [&](size_t b, size_t e)
+            {
+                for (size_t v = b; v < e; v++)
+                {
+                    for (uint32_t i = start[v]; i < start[v + 1]; i++)
+                    {
+                        uint32_t c = order[i];
+                        indices[c] += count[v];
+                        if (first[c]) unique[indices[c]] = c;
+                    }
+                }
+            }, 1 << 12);
+        }
+
+    protected:
+        //! corners of a vertex compared pairwise, larger groups are sorted
+        static const ptrdiff_t s_linear_group = 16;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,471 @@
+/*!
+*      \file Voxelizer.h
+*      \brief Sparse occupancy grids of triangle meshes
+*
+*      The grid is cut into tiles of 64^3 voxels. The triangles are binned into
+*      the tiles they meet, then each row of tiles along x is voxelized by one
+*      task into its own bits: the bricks of 8^3 voxels a triangle meets are
+*      found first, then the voxels inside them, all with the batched cube test
+*      of CTriangleCubeIntersect. A solid grid also fills the voxels whose
+*      centers are inside the mesh, by the parity of the crossings of scanlines
+*      along x. Only the bricks holding a voxel are kept, and all full bricks
+*      share one block of bits.
+*/
+
+#ifndef _MESHLIB_VOXELIZER_H_
+#define _MESHLIB_VOXELIZER_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include "Point.h"
+#include "TriangleCubeIntersect.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CVoxelizer class, a sparse bit grid of the voxels a mesh occupies
+     *
+     *  Voxel (i, j, k) is the box origin() + [i, i + 1] x [j, j + 1] x [k, k + 1]
+     *  times voxel_size(). The grid is a cube of resolution() voxels per axis
+     *  centered on the bounding box of the triangles.
+     */
+    class CVoxelizer
+    {
+    public:
+        /*!
+         *  Voxelize triangles
+         *  \param triangles  number of triangles, corner(t, k) is corner k of triangle t as a CPoint
+         *  \param resolution voxels along each axis, at most s_max_resolution
+         *  \param solid      also fill the inside, the triangles must form closed surfaces
+         *  \param threads    number of threads, 0 uses all hardware threads
+         */
+        template<typename Corner>
+        void _voxelize(size_t triangles, Corner corner, int resolution, bool solid = false, int threads = 0);
+
+        /*!
+         *  Voxelize faces, a range of face pointers such as CBaseMesh::faces(),
+         *  polygons split into fans around their first corner
+         */
+        template<typename Faces>
+        void _voxelize_faces(const Faces & faces, int resolution, bool solid = false, int threads = 0);
+
+        void clear()
+        {
+            m_keys.clear();
+            m_slots.clear();
+            m_words.clear();
+            m_resolution = 0;
+        }
+
+        int resolution() const { return m_resolution; }
+        const CPoint & origin() const { return m_origin; }
+        double voxel_size() const { return m_size; }
+        /*! number of bricks holding a voxel */
+        size_t bricks() const { return m_keys.size(); }
+
+        /*! whether voxel i, j, k is occupied */
+        bool occupied(int i, int j, int k) const
+        {
+            if (i < 0 || j < 0 || k < 0 || i >= m_resolution || j >= m_resolution || k >= m_resolution) return false;
+            const uint64_t key = _key(i >> 3, j >> 3, k >> 3);
+            const auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+            if (it == m_keys.end() || *it != key) return false;
+            const uint64_t * w = &m_words[(size_t)m_slots[it - m_keys.begin()] * 8];
+            return (w[k & 7] >> ((j & 7) * 8 + (i & 7)) & 1) != 0;
+        }
+
+        /*! the voxel holding p, which may lie off the grid */
+        void voxel(const CPoint & p, int & i, int & j, int & k) const
+        {
+            const CPoint g = (p - m_origin) / m_size;
+            i = (int)std::floor(g[0]);
+            j = (int)std::floor(g[1]);
+            k = (int)std::floor(g[2]);
+        }
+
+        /*! number of occupied voxels */
+        size_t count() const
+        {
+            size_t n = 0;
+            for (uint32_t s : m_slots)
+                for (int z = 0; z < 8; z++) n += _popcount(m_words[(size_t)s * 8 + z]);
+            return n;
+        }
+
+        /*! fn(i, j, k) for every occupied voxel, brick by brick */
+        template<typename Fn>
+        void for_each(Fn fn) const
+        {
+            const int tiles = _tiles();
+            for (size_t b = 0; b < m_keys.size(); b++)
+            {
+                const uint64_t tile = m_keys[b] >> 9;
+                const int in = (int)(m_keys[b] & 511);
+                const int x = (int)(tile % tiles) * 64 + (in & 7) * 8;
+                const int y = (int)(tile / tiles % tiles) * 64 + (in >> 3 & 7) * 8;
+                const int z = (int)(tile / tiles / tiles) * 64 + (in >> 6) * 8;
+                const uint64_t * w = &m_words[(size_t)m_slots[b] * 8];
+                for (int dz = 0; dz < 8; dz++)
+                    for (uint64_t bits = w[dz]; bits; bits &= bits - 1)
+                    {
+                        const int c = _lowest(bits);
+                        fn(x + (c & 7), y + (c >> 3), z + dz);
+                    }
+            }
+        }
+
+        //! upper bound of resolution()
+        static const int s_max_resolution = 1 << 14;
+
+    protected:
+        //! a tile is 64 voxels, 8 bricks, along each axis
+        static const int s_tile = 64;
+
+        int _tiles() const { return (m_resolution + s_tile - 1) / s_tile; }
+
+        /*!
+         *  Bricks are keyed by their tile, x fastest, then by their place in the
+         *  tile, so the bricks of a row of tiles along x are next to each other
+         */
+        uint64_t _key(int bx, int by, int bz) const
+        {
+            const uint64_t tiles = (uint64_t)_tiles();
+            const uint64_t tile = (uint64_t)(bx >> 3) + tiles * ((uint64_t)(by >> 3) + tiles * (uint64_t)(bz >> 3));
+            return tile << 9 | (uint64_t)((bx & 7) | (by & 7) << 3 | (bz & 7) << 6);
+        }
+
+        static int _popcount(uint64_t v)
+        {
+            v = v - ((v >> 1) & 0x5555555555555555ull);
+            v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+            v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            return (int)((v * 0x0101010101010101ull) >> 56);
+        }
+
+        static int _lowest(uint64_t v)
+        {
+            return _popcount((v & (0 - v)) - 1);
+        }
+
+        /*!
+         *  fn(x, y, z) for the cells of width s inside [lo, hi] that triangle t meets,
+         *  t in voxel units. The cells are tested four at a time.
+         */
+        template<typename Fn>
+        static void _cells(const CPoint t[3], const int lo[3], const int hi[3], double s, Fn fn);
+
+        /*!
+         *  Where the scanline through y, z along x crosses triangle t, false if it
+         *  misses. A line through an edge or corner shared by two triangles facing
+         *  apart crosses only one of them.
+         */
+        static bool _crossing(const CPoint t[3], double y, double z, double & x);
+
+        /*! twice the signed area of a, b, p in the yz plane, exactly the negative of that of b, a, p */
+        static double _edge(const CPoint & a, const CPoint & b, double y, double z)
+        {
+            if (b[1] < a[1] || (b[1] == a[1] && b[2] < a[2])) return -_edge(b, a, y, z);
+            return (b[1] - a[1]) * (z - a[2]) - (b[2] - a[2]) * (y - a[1]);
+        }
+
+        /*! the bricks of one row of tiles along x */
+        struct CRow
+        {
+            std::vector<uint64_t> keys;
+            std::vector<uint32_t> slots;     //!< 0 for a full brick, else 1 + its place in words
+            std::vector<uint64_t> words;
+        };
+
+        /*! voxelize the row of tiles ty, tz, pairs holding its triangles tile by tile */
+        void _row(int ty, int tz, const std::vector<CPoint> & corners, const uint64_t * pairs, size_t count, bool solid, CRow & row) const;
+
+        int m_resolution = 0;
+        CPoint m_origin;
+        double m_size = 1;
+        std::vector<uint64_t> m_keys;    //!< sorted
+        std::vector<uint32_t> m_slots;   //!< the bits of brick b are m_words[8 m_slots[b], + 8)
+        std::vector<uint64_t> m_words;   //!< 8 words a brick, word z bit 8 y + x, slot 0 is full
+    };
+
+    template<typename Faces>
+    inline void CVoxelizer::_voxelize_faces(const Faces & faces, int resolution, bool solid, int threads)
+    {
+        std::vector<CPoint> corners;
+        for (auto * pf : faces)
+        {
+            auto * first = pf->halfedge();
+            auto * he = first->next();
+            while (he->next() != first)
+            {
+                corners.push_back(first->vertex()->point());
+                corners.push_back(he->vertex()->point());
+                corners.push_back(he->next()->vertex()->point());
+                he = he->next();
+            }
+        }
+        _voxelize(corners.size() / 3, [&corners](size_t t, int k) { return corners[3 * t + k]; }, resolution, solid, threads);
+    }
+
+    template<typename Corner>
+    inline void CVoxelizer::_voxelize(size_t triangles, Corner corner, int resolution, bool solid, int threads)
+    {
+        clear();
+        m_resolution = std::max(1, std::min(resolution, s_max_resolution));
+        m_words.assign(8, ~(uint64_t)0);
+        if (triangles == 0) return;
+
+        CPoint lo(DBL_MAX, DBL_MAX, DBL_MAX), hi(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+        for (size_t t = 0; t < triangles; t++)
+            for (int k = 0; k < 3; k++)
+            {
+                const CPoint p = corner(t, k);
+                for (int a = 0; a < 3; a++)
+                {
+                    lo[a] = std::min(lo[a], p[a]);
+                    hi[a] = std::max(hi[a], p[a]);
+                }
+            }
+        //a little margin, so no triangle lies on the border of the grid
+        const double extent = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+        m_size = extent > 0 ? extent * (1 + 1e-6) / m_resolution : 1;
+        m_origin = (lo + hi) / 2.0 - CPoint(1, 1, 1) * (m_size * m_resolution / 2);
+
+        //the corners in voxel units
+        std::vector<CPoint> corners(3 * triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+                for (int k = 0; k < 3; k++) corners[3 * t + k] = (corner(t, k) - m_origin) / m_size;
+        });
+
+        //bin the triangles into the tiles they meet, as tile << 32 | triangle
+        const int tiles = _tiles();
+        const int chunks = resolve_threads(threads) * 4;
+        std::vector<std::vector<uint64_t>> bins(chunks);
+        parallel_for(chunks, threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++)
+            {
+                const int last[3] = { tiles - 1, tiles - 1, tiles - 1 };
+                const int first[3] = { 0, 0, 0 };
+                for (size_t t = triangles * c / chunks; t < triangles * (c + 1) / chunks; t++)
+                {
+                    _cells(&corners[3 * t], first, last, s_tile, [&](int x, int y, int z)
+                    {
+                        const uint64_t tile = (uint64_t)x + (uint64_t)tiles * ((uint64_t)y + (uint64_t)tiles * (uint64_t)z);
+                        bins[c].push_back(tile << 32 | (uint64_t)t);
+                    });
+                }
+            }
+        }, 1);
+        std::vector<uint64_t> pairs;
+        for (auto & bin : bins)
+        {
+            pairs.insert(pairs.end(), bin.begin(), bin.end());
+            bin = std::vector<uint64_t>();
+        }
+        parallel_sort(pairs.begin(), pairs.end(), threads, std::less<uint64_t>());
+
+        //the rows of tiles along x holding triangles
+        std::vector<size_t> starts;
+        for (size_t p = 0; p < pairs.size(); p++)
+            if (p == 0 || (pairs[p] >> 32) / tiles != (pairs[p - 1] >> 32) / tiles) starts.push_back(p);
+        starts.push_back(pairs.size());
+
+        std::vector<CRow> rows(starts.size() - 1);
+        parallel_for(rows.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t r = b; r < e; r++)
+            {
+                const uint64_t yz = (pairs[starts[r]] >> 32) / tiles;
+                _row((int)(yz % tiles), (int)(yz / tiles), corners, &pairs[starts[r]], starts[r + 1] - starts[r], solid, rows[r]);
+            }
+        }, 1);
+
+        //the rows are in key order
+        for (CRow & row : rows)
+        {
+            const uint32_t base = (uint32_t)(m_words.size() / 8) - 1;
+            m_keys.insert(m_keys.end(), row.keys.begin(), row.keys.end());
+            for (uint32_t s : row.slots) m_slots.push_back(s ? s + base : 0);
+            m_words.insert(m_words.end(), row.words.begin(), row.words.end());
+            row = CRow();
+        }
+    }
+
+    template<typename Fn>
+    inline void CVoxelizer::_cells(const CPoint t[3], const int lo[3], const int hi[3], double s, Fn fn)
+    {
+        //every cell the bounding box touches, the cube test counts touching as meeting
+        int b[3], e[3];
+        for (int a = 0; a < 3; a++)
+        {
+            const double l = std::min(t[0][a], std::min(t[1][a], t[2][a])) / s;
+            const double h = std::max(t[0][a], std::max(t[1][a], t[2][a])) / s;
+            b[a] = std::max(lo[a], (int)std::ceil(l) - 1);
+            e[a] = std::min(hi[a], (int)std::floor(h));
+        }
+
+        double v[3][3][4];
+        int cell[4][3];
+        int k = 0;
+        auto flush = [&]()
+        {
+            for (int l = k; l < 4; l++) CTriangleCubeIntersect::pad(v, l);
+            for (int mask = CTriangleCubeIntersect::batch(v), l = 0; mask; mask >>= 1, l++)
+                if (mask & 1) fn(cell[l][0], cell[l][1], cell[l][2]);
+            k = 0;
+        };
+        for (int z = b[2]; z <= e[2]; z++)
+            for (int y = b[1]; y <= e[1]; y++)
+                for (int x = b[0]; x <= e[0]; x++)
+                {
+                    const CPoint c = CPoint(x + 0.5, y + 0.5, z + 0.5) * s;
+                    CTriangleCubeIntersect::pack(v, k, (t[0] - c) / s, (t[1] - c) / s, (t[2] - c) / s);
+                    cell[k][0] = x;
+                    cell[k][1] = y;
+                    cell[k][2] = z;
+                    if (++k == 4) flush();
+                }
+        if (k) flush();
+    }
+
+    inline bool CVoxelizer::_crossing(const CPoint t[3], double y, double z, double & x)
+    {
+        const double area = (t[1][1] - t[0][1]) * (t[2][2] - t[0][2]) - (t[1][2] - t[0][2]) * (t[2][1] - t[0][1]);
+        if (area == 0) return false;
+        const double sign = area > 0 ? 1 : -1;
+
+        double w[3];
+        for (int i = 0; i < 3; i++)
+        {
+            const CPoint & a = t[(i + 1) % 3];
+            const CPoint & b = t[(i + 2) % 3];
+            w[i] = sign * _edge(a, b, y, z);
+            if (w[i] < 0) return false;
+            if (w[i] == 0)
+            {
+                //on the edge, which belongs to the triangle on its left or below it
+                const double dy = sign * (b[1] - a[1]), dz = sign * (b[2] - a[2]);
+                if (!(dz > 0 || (dz == 0 && dy < 0))) return false;
+            }
+        }
+        const double sum = w[0] + w[1] + w[2];
+        if (sum <= 0) return false;
+        x = (w[0] * t[0][0] + w[1] * t[1][0] + w[2] * t[2][0]) / sum;
+        return true;
+    }
+
+    inline void CVoxelizer::_row(int ty, int tz, const std::vector<CPoint> & corners, const uint64_t * pairs, size_t count, bool solid, CRow & row) const
+    {
+        const int tiles = _tiles();
+        const int n = m_resolution;
+        //bit x of line 64 z + y, z and y in the row, is voxel x
+        std::vector<uint64_t> bits((size_t)s_tile * s_tile * tiles, 0);
+        const int y0 = ty * s_tile, z0 = tz * s_tile;
+        auto set = [&](int x, int y, int z)
+        {
+            bits[((size_t)(z - z0) * s_tile + (y - y0)) * tiles + (x >> 6)] |= (uint64_t)1 << (x & 63);
+        };
+
+        //the surface, brick by brick
+        for (size_t p = 0; p < count; p++)
+        {
+            const int tx = (int)((pairs[p] >> 32) % tiles);
+            const CPoint * t = &corners[3 * (pairs[p] & 0xffffffffu)];
+            const int lo[3] = { tx * 8, ty * 8, tz * 8 };
+            const int hi[3] = { std::min(lo[0] + 7, (n - 1) >> 3), std::min(lo[1] + 7, (n - 1) >> 3), std::min(lo[2] + 7, (n - 1) >> 3) };
+            _cells(t, lo, hi, 8, [&](int bx, int by, int bz)
+            {
+                const int vlo[3] = { bx * 8, by * 8, bz * 8 };
+                const int vhi[3] = { std::min(vlo[0] + 7, n - 1), std::min(vlo[1] + 7, n - 1), std::min(vlo[2] + 7, n - 1) };
+                _cells(t, vlo, vhi, 1, set);
+            });
+        }
+
+        //the inside, between pairs of crossings of the scanlines through the voxel centers
+        if (solid)
+        {
+            std::vector<uint32_t> list(count);
+            for (size_t p = 0; p < count; p++) list[p] = (uint32_t)(pairs[p] & 0xffffffffu);
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+
+            const int ymax = std::min(y0 + s_tile, n) - 1, zmax = std::min(z0 + s_tile, n) - 1;
+            std::vector<std::vector<double>> crossings((size_t)s_tile * s_tile);
+            for (uint32_t i : list)
+            {
+                const CPoint * t = &corners[3 * (size_t)i];
+                const double ylo = std::min(t[0][1], std::min(t[1][1], t[2][1])), yhi = std::max(t[0][1], std::max(t[1][1], t[2][1]));
+                const double zlo = std::min(t[0][2], std::min(t[1][2], t[2][2])), zhi = std::max(t[0][2], std::max(t[1][2], t[2][2]));
+                const int jb = std::max(y0, (int)std::ceil(ylo - 0.5)), je = std::min(ymax, (int)std::floor(yhi - 0.5));
+                const int kb = std::max(z0, (int)std::ceil(zlo - 0.5)), ke = std::min(zmax, (int)std::floor(zhi - 0.5));
+                for (int k = kb; k <= ke; k++)
+                    for (int j = jb; j <= je; j++)
+                    {
+                        double x;
+                        if (_crossing(t, j + 0.5, k + 0.5, x)) crossings[(size_t)(k - z0) * s_tile + (j - y0)].push_back(x);
+                    }
+            }
+
+            for (size_t line = 0; line < crossings.size(); line++)
+            {
+                std::vector<double> & xs = crossings[line];
+                std::sort(xs.begin(), xs.end());
+                uint64_t * words = &bits[line * tiles];
+                for (size_t c = 0; c + 1 < xs.size(); c += 2)
+                {
+                    //the voxels whose centers lie between the two crossings
+                    const int b = std::max(0, (int)std::floor(xs[c] - 0.5) + 1);
+                    const int e = std::min(n - 1, (int)std::ceil(xs[c + 1] - 0.5) - 1);
+                    for (int x = b; x <= e;)
+                    {
+                        const int last = std::min(e, (x | 63));
+                        const int len = last - x + 1;
+                        words[x >> 6] |= (len == 64 ? ~(uint64_t)0 : (((uint64_t)1 << len) - 1)) << (x & 63);
+                        x = last + 1;
+                    }
+                }
+            }
+        }
+
+        //the bricks, in key order
+        for (int tx = 0; tx < tiles; tx++)
+            for (int bz = 0; bz < 8; bz++)
+                for (int by = 0; by < 8; by++)
+                    for (int bx = 0; bx < 8; bx++)
+                    {
+                        uint64_t w[8];
+                        uint64_t any = 0, all = ~(uint64_t)0;
+                        for (int dz = 0; dz < 8; dz++)
+                        {
+                            w[dz] = 0;
+                            for (int dy = 0; dy < 8; dy++)
+                            {
+                                const uint64_t line = bits[((size_t)(bz * 8 + dz) * s_tile + by * 8 + dy) * tiles + tx];
+                                w[dz] |= (line >> (bx * 8) & 0xff) << (dy * 8);
+                            }
+                            any |= w[dz];
+                            all &= w[dz];
+                        }
+                        if (!any) continue;
+                        row.keys.push_back(_key(tx * 8 + bx, ty * 8 + by, tz * 8 + bz));
+                        if (all == ~(uint64_t)0)
+                        {
+                            row.slots.push_back(0);
+                            continue;
+                        }
+                        row.slots.push_back((uint32_t)(row.words.size() / 8) + 1);
+                        row.words.insert(row.words.end(), w, w + 8);
+                    }
+    }
+
+}; //namespace
+
+#endif
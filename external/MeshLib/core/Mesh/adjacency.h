@@ -0,0 +1,190 @@
+/*!
+*      \file adjacency.h
+*      \brief The one rings of a mesh as compressed rows of indices
+*
+*      Algorithms on the graph of a mesh, smoothing, geodesics or segmentation,
+*      need the neighbors of every vertex or face again and again, and the
+*      halfedges lead to them through pointers scattered over the memory. The
+*      tables here hold them as rows of indices in one array, the neighbors of
+*      row i at [outer[i], outer[i + 1]). The vertices and faces are rows in
+*      the order of the mesh lists. Every row is counted and then filled in
+*      parallel from the halfedges, and the tables are laid out again only
+*      when CBaseMesh::topology_version() tells the connectivity changed.
+*/
+
+#ifndef _MESHLIB_ADJACENCY_H_
+#define _MESHLIB_ADJACENCY_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "mesh.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CAdjacencyRows class, rows of indices in one array
+     */
+    struct CAdjacencyRows
+    {
+        //! row i is [outer[i], outer[i + 1]) of inner
+        std::vector<int> outer;
+        std::vector<int> inner;
+
+        /*! number of rows */
+        size_t size() const { return outer.empty() ? 0 : outer.size() - 1; }
+        /*! the entries of row i */
+        const int * begin(size_t i) const { return inner.data() + outer[i]; }
+        const int * end(size_t i) const { return inner.data() + outer[i + 1]; }
+        int degree(size_t i) const { return outer[i + 1] - outer[i]; }
+    };
+
+    /*!
+     *  \brief CAdjacency class, the vertex to vertex, vertex to face and face to face tables of a mesh
+     *
+     *  The neighbors of a vertex are in the order of its circulators, vertices_range()
+     *  and faces_range(), the neighbors of a face in the order of its halfedges, without
+     *  those across the boundary.
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CAdjacency
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        CAdjacency(M & mesh) : m_mesh(mesh) {}
+
+        /*!
+         *  Lay out the tables if the connectivity changed since the last time, a call per use is cheap
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void update(int threads = 0)
+        {
+            if (!m_built || m_version != m_mesh.topology_version()) build(threads);
+        }
+        /*! lay out the tables */
+        void build(int threads = 0);
+
+        /*! number of vertex rows, and of face rows */
+        size_t num_vertices() const { return m_vertices.size(); }
+        size_t num_faces() const { return m_faces.size(); }
+        /*! the vertex of row i, and the row of a vertex */
+        CVertex * vertex(size_t i) const { return m_vertices[i]; }
+        int row(CVertex * v) const { return m_vertex_row[v->property_index()]; }
+        /*! the face of row j, and the row of a face */
+        CFace * face(size_t j) const { return m_faces[j]; }
+        int row(CFace * f) const { return m_face_row[f->property_index()]; }
+
+        /*! the vertex rows around every vertex row */
+        const CAdjacencyRows & vertex_vertices() const { return m_vv; }
+        /*! the face rows around every vertex row */
+        const CAdjacencyRows & vertex_faces() const { return m_vf; }
+        /*! the face rows across the edges of every face row */
+        const CAdjacencyRows & face_faces() const { return m_ff; }
+
+    protected:
+        M & m_mesh;
+        bool m_built = false;
+        size_t m_version = 0;
+
+        std::vector<CVertex*> m_vertices;
+        std::vector<CFace*> m_faces;
+        std::vector<int> m_vertex_row, m_face_row;
+        CAdjacencyRows m_vv, m_vf, m_ff;
+
+        /*! count the entries of every row with count(i), add them up, then fill(i, row) */
+        template<typename Count, typename Fill>
+        static void _rows(CAdjacencyRows & rows, size_t n, int threads, Count count, Fill fill);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    template<typename Count, typename Fill>
+    void CAdjacency<M>::_rows(CAdjacencyRows & rows, size_t n, int threads, Count count, Fill fill)
+    {
+        rows.outer.assign(n + 1, 0);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) rows.outer[i + 1] = count(i);
+        });
+        for (size_t i = 0; i < n; i++) rows.outer[i + 1] += rows.outer[i];
+        rows.inner.resize(rows.outer[n]);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) fill(i, rows.inner.data() + rows.outer[i]);
+        });
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CAdjacency<M>::build(int threads)
+    {
+        MESHLIB_TRACE_ZONE("adjacency.build");
+        m_vertices.clear();
+        m_faces.clear();
+        size_t vslots = 0, fslots = 0;
+        for (CVertex * v : m_mesh.vertices())
+        {
+            m_vertices.push_back(v);
+            vslots = std::max(vslots, v->property_index() + 1);
+        }
+        for (CFace * f : m_mesh.faces())
+        {
+            m_faces.push_back(f);
+            fslots = std::max(fslots, f->property_index() + 1);
+        }
+        const size_t nv = m_vertices.size(), nf = m_faces.size();
+        m_vertex_row.assign(vslots, -1);
+        m_face_row.assign(fslots, -1);
+        parallel_for(nv, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) m_vertex_row[m_vertices[i]->property_index()] = (int)i;
+        });
+        parallel_for(nf, threads, [&](size_t b, size_t e)
+        {
+            for (size_t j = b; j < e; j++) m_face_row[m_faces[j]->property_index()] = (int)j;
+        });
+
+        _rows(m_vv, nv, threads, [&](size_t i)
+        {
+            int n = 0;
+            for (CVertex * w : m_vertices[i]->vertices_range()) { (void)w; n++; }
+            return n;
+        }, [&](size_t i, int * out)
+        {
+            for (CVertex * w : m_vertices[i]->vertices_range()) *out++ = row(w);
+        });
+        _rows(m_vf, nv, threads, [&](size_t i)
+        {
+            int n = 0;
+            for (CFace * f : m_vertices[i]->faces_range()) { (void)f; n++; }
+            return n;
+        }, [&](size_t i, int * out)
+        {
+            for (CFace * f : m_vertices[i]->faces_range()) *out++ = row(f);
+        });
+        _rows(m_ff, nf, threads, [&](size_t j)
+        {
+            int n = 0;
+            for (CHalfEdge * he : m_faces[j]->halfedges_range()) n += he->dual() != NULL;
+            return n;
+        }, [&](size_t j, int * out)
+        {
+            for (CHalfEdge * he : m_faces[j]->halfedges_range())
+                if (he->dual()) *out++ = row(he->dual()->face());
+        });
+
+        MESHLIB_COUNTER_ADD("adjacency.entries", m_vv.inner.size() + m_vf.inner.size() + m_ff.inner.size());
+        m_version = m_mesh.topology_version();
+        m_built = true;
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,261 @@
+/*!
+*      \file allocator.h
+*      \brief Allocation policies for the vertices, edges, faces and halfedges of a mesh
+*
+*      A policy offers create<T>() and destroy<T>(t) for single elements and
+*      reserve<T>(n) as a hint before bulk construction. Elements never move,
+*      the mesh links them with raw pointers. memory<T>(live) tells the bytes
+*      held for the elements of type T, live of them in use. The slabs of the
+*      arenas are placed by CPages::policy(), see pages.h.
+*/
+
+#ifndef _MESHLIB_ALLOCATOR_H_
+#define _MESHLIB_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+#include "../Geometry/MemoryPool.h"
+#include "../parser/pages.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CHeapAllocator class, one new/delete per element
+     */
+    class CHeapAllocator
+    {
+    public:
+        template<typename T> T * create() { return new T(); }
+        template<typename T> void destroy(T * t) { delete t; }
+        template<typename T> void reserve(size_t) {}
+        /*! the elements alone, the overhead of the heap is not known */
+        template<typename T> size_t memory(size_t live) { return live * sizeof(T); }
+    };
+
+    /*!
+     *  \brief CBlockArena class, elements are placed in slabs, one free list per element type
+     *
+     *  destroy() runs the destructor and keeps the slot for the next create()
+     *  of the same type, the slabs are released together when the arena goes
+     *  away. Copies share the slabs, as the default copy of a mesh shares its
+     *  elements.
+     */
+    class CBlockArena
+    {
+    public:
+        CBlockArena() : m_pools(std::make_shared<std::vector<CPool>>()) {}
+
+        template<typename T>
+        T * create()
+        {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned mesh elements are not supported");
+            return new (_pool<T>().allocate()) T();
+        }
+
+        template<typename T>
+        void destroy(T * t)
+        {
+            if (t == NULL) return;
+            t->~T();
+            _pool<T>().release(t);
+        }
+
+        /*! make room for n more elements of type T in one slab */
+        template<typename T>
+        void reserve(size_t n) { _pool<T>().reserve(n); }
+
+        /*! bytes of the slabs of type T, shared with the copies of the arena, free slots included */
+        template<typename T>
+        size_t memory(size_t) { return _pool<T>().memory(); }
+
+    protected:
+        /*! slabs and free slots of one element type */
+        class CPool
+        {
+        public:
+            explicit CPool(size_t slot = 0) : m_slot(slot) {}
+            CPool(CPool && other) { *this = std::move(other); }
+            CPool & operator=(CPool && other)
+            {
+                std::swap(m_slot, other.m_slot);
+                std::swap(m_next, other.m_next);
+                std::swap(m_end, other.m_end);
+                std::swap(m_free, other.m_free);
+                std::swap(m_bytes, other.m_bytes);
+                m_slabs.swap(other.m_slabs);
+                m_sizes.swap(other.m_sizes);
+                return *this;
+            }
+            ~CPool() { for (size_t i = 0; i < m_slabs.size(); i++) CPages::release(m_slabs[i], m_sizes[i]); }
+
+            size_t slot() const { return m_slot; }
+            size_t memory() const { return m_bytes; }
+
+            void * allocate()
+            {
+                if (m_free)
+                {
+                    void * p = m_free;
+                    m_free = *(void **)m_free;
+                    return p;
+                }
+                if (m_next == m_end) _grow(0);
+                void * p = m_next;
+                m_next += m_slot;
+                return p;
+            }
+
+            void release(void * p)
+            {
+                *(void **)p = m_free;
+                m_free = p;
+            }
+
+            void reserve(size_t n)
+            {
+                if ((size_t)(m_end - m_next) / m_slot < n) _grow(n);
+            }
+
+        protected:
+            void _grow(size_t n)
+            {
+                // slabs double up to s_max_slab bytes, a reserve gets a slab of its own size
+                // copies, std::min and std::max take their arguments by reference
+                const size_t least = s_min_count;
+                const size_t most = s_max_slab / m_slot;
+                size_t count = least << std::min<size_t>(m_slabs.size(), 10);
+                count = std::max(least, std::min(count, most));
+                count = std::max(count, n);
+
+                // the rest of the current slab goes to the free list
+                while (m_next != m_end)
+                {
+                    release(m_next);
+                    m_next += m_slot;
+                }
+
+                char * s = (char *)CPages::allocate(count * m_slot, m_slot);
+                m_slabs.push_back(s);
+                m_sizes.push_back(count * m_slot);
+                m_bytes += count * m_slot;
+                m_next = s;
+                m_end = s + count * m_slot;
+            }
+
+            static constexpr size_t s_min_count = 1024;
+            static constexpr size_t s_max_slab = 16 << 20;
+
+            size_t              m_slot = 0;
+            char *              m_next = NULL;
+            char *              m_end = NULL;
+            void *              m_free = NULL;
+            size_t              m_bytes = 0;
+            std::vector<char *> m_slabs;
+            std::vector<size_t> m_sizes;
+        };
+
+        template<typename T>
+        CPool & _pool()
+        {
+            static const size_t index = _next_index();
+            std::vector<CPool> & pools = *m_pools;
+            if (index >= pools.size()) pools.resize(index + 1);
+            if (pools[index].slot() == 0)
+            {
+                const size_t a = std::max(alignof(T), alignof(void *));
+                const size_t slot = std::max(sizeof(T), sizeof(void *));
+                pools[index] = CPool((slot + a - 1) / a * a);
+            }
+            return pools[index];
+        }
+
+        /*! every element type gets its own pool index, shared by all arenas */
+        static size_t _next_index()
+        {
+            static std::atomic<size_t> count(0);
+            return count++;
+        }
+
+        std::shared_ptr<std::vector<CPool>> m_pools;
+    };
+
+    /*!
+     *  \brief CConcurrentArena class, as CBlockArena but create() and destroy() may run on many threads
+     *
+     *  Every element type gets a CConcurrentPool, made on first use. Only the
+     *  allocation is safe this way, the lists and properties of the mesh still
+     *  need a single writer.
+     */
+    class CConcurrentArena
+    {
+    public:
+        CConcurrentArena() : m_pools(std::make_shared<CPools>()) {}
+
+        template<typename T>
+        T * create()
+        {
+            return new (_pool<T>().allocate()) T();
+        }
+
+        template<typename T>
+        void destroy(T * t)
+        {
+            if (t == NULL) return;
+            t->~T();
+            _pool<T>().release(t);
+        }
+
+        /*! make room for n more elements of type T in one slab */
+        template<typename T>
+        void reserve(size_t n) { _pool<T>().reserve(n); }
+
+        /*! bytes of the slabs of type T, as CBlockArena::memory */
+        template<typename T>
+        size_t memory(size_t) { return _pool<T>().memory(); }
+
+        //! element types an arena can hold
+        static const size_t s_max_types = 64;
+
+    protected:
+        struct CPools
+        {
+            CPools() { for (size_t i = 0; i < s_max_types; i++) pools[i] = NULL; }
+            ~CPools() { for (size_t i = 0; i < s_max_types; i++) delete pools[i].load(); }
+            std::atomic<CConcurrentPool *> pools[s_max_types];
+        };
+
+        template<typename T>
+        CConcurrentPool & _pool()
+        {
+            static const size_t index = _next_index();
+            std::atomic<CConcurrentPool *> & slot = m_pools->pools[index];
+            CConcurrentPool * pool = slot.load(std::memory_order_acquire);
+            if (pool != NULL) return *pool;
+
+            // the first thread to get here installs the pool, the others drop theirs
+            CConcurrentPool * made = new CConcurrentPool(sizeof(T), alignof(T));
+            if (slot.compare_exchange_strong(pool, made, std::memory_order_acq_rel)) return *made;
+            delete made;
+            return *pool;
+        }
+
+        static size_t _next_index()
+        {
+            static std::atomic<size_t> count(0);
+            const size_t index = count++;
+            if (index >= s_max_types) throw std::length_error("CConcurrentArena: too many element types");
+            return index;
+        }
+
+        std::shared_ptr<CPools> m_pools;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,245 @@
+/*!
+*      \file analysis.h
+*      \brief The counts, topology and bounds of a mesh in one sweep per element type
+*
+*      An intake check used to walk the lists once for every number it
+*      printed: the counts, the boundary loops of CBoundary, the components of
+*      CComponents and the bounds. The analysis folds all of them in three
+*      parallel reductions, over the edges, the vertices and the faces, with
+*      nothing traced or sorted. The components and the boundary loops are
+*      counted by two union finds whose links are set by compare and swap as
+*      the edges are swept: a set is one less for every link that joins two,
+*      so that no pass over the roots is needed. The vertices are joined by
+*      their edges, and every boundary edge to the next one along its loop,
+*      found by turning about its target as CLoop does.
+*/
+
+#ifndef _MESHLIB_ANALYSIS_H_
+#define _MESHLIB_ANALYSIS_H_
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+
+#include "mesh.h"
+#include "../Geometry/PointBounds.h"
+#include "../parser/smv.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshAnalysis class, the CMeshReport of a mesh
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CMeshAnalysis
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        CMeshAnalysis(M & mesh) : m_mesh(mesh) {}
+
+        /*!
+         *  Sweep the edges, the vertices and the faces once each
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return the report, it does not depend on the number of threads
+         */
+        const CMeshReport & analyze(int threads = 0);
+
+        /*! the report of the last analyze() */
+        const CMeshReport & report() const { return m_report; }
+
+    protected:
+        M & m_mesh;
+        CMeshReport m_report;
+
+        /*! the root of a set, halving the path on the way */
+        static uint32_t _find(std::vector<std::atomic<uint32_t>> & parent, uint32_t x)
+        {
+            uint32_t p = parent[x].load(std::memory_order_relaxed);
+            while (p != x)
+            {
+                uint32_t gp = parent[p].load(std::memory_order_relaxed);
+                parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+                x = gp;
+                p = parent[x].load(std::memory_order_relaxed);
+            }
+            return x;
+        }
+        /*! join the sets of a and b, the larger root goes under the smaller one, false if they were one */
+        static bool _unite(std::vector<std::atomic<uint32_t>> & parent, uint32_t a, uint32_t b)
+        {
+            while (true)
+            {
+                a = _find(parent, a);
+                b = _find(parent, b);
+                if (a == b) return false;
+                if (a < b) std::swap(a, b);
+                uint32_t expected = a;
+                if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return true;
+            }
+        }
+        /*! every slot a set of its own */
+        static void _reset(std::vector<std::atomic<uint32_t>> & parent, size_t slots, int threads)
+        {
+            std::vector<std::atomic<uint32_t>>(slots).swap(parent);
+            parallel_for(slots, threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) parent[i].store((uint32_t)i, std::memory_order_relaxed);
+            });
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    const CMeshReport & CMeshAnalysis<M>::analyze(int threads)
+    {
+        MESHLIB_TRACE_ZONE("analyze");
+        m_report = CMeshReport();
+        CMeshReport & r = m_report;
+
+        // the edges, the links that join two sets of vertices or of boundary edges
+        struct CEdgeFold
+        {
+            uint64_t edges = 0, boundary = 0, joined = 0, linked = 0;
+        };
+        std::vector<std::atomic<uint32_t>> vertex_sets, loop_sets;
+        _reset(vertex_sets, m_mesh.vertex_slots(), threads);
+        _reset(loop_sets, m_mesh.edge_slots(), threads);
+        const CEdgeFold edges = m_mesh.parallel_reduce_edges(CEdgeFold(), [&](CEdgeFold & acc, CEdge * e)
+        {
+            acc.edges++;
+            CHalfEdge * h = e->halfedge(0) ? e->halfedge(0) : e->halfedge(1);
+            if (h == NULL) return;
+            if (_unite(vertex_sets, (uint32_t)h->source()->property_index(), (uint32_t)h->target()->property_index())) acc.joined++;
+            if (!e->boundary()) return;
+            acc.boundary++;
+            // the next boundary halfedge is the most clw out halfedge of the target in the fan of h
+            CHalfEdge * g = h->next();
+            while (g->dual()) g = g->dual()->next();
+            if (_unite(loop_sets, (uint32_t)e->property_index(), (uint32_t)g->edge()->property_index())) acc.linked++;
+        }, [](const CEdgeFold & a, const CEdgeFold & b)
+        {
+            CEdgeFold c;
+            c.edges = a.edges + b.edges;
+            c.boundary = a.boundary + b.boundary;
+            c.joined = a.joined + b.joined;
+            c.linked = a.linked + b.linked;
+            return c;
+        }, threads);
+
+        // the vertices, their valences and bounds
+        struct CVertexFold
+        {
+            uint64_t vertices = 0, isolated = 0, boundary = 0, valence_sum = 0;
+            uint32_t valence_min = UINT32_MAX, valence_max = 0;
+            uint64_t valence[CMeshReport::s_valences] = {};
+            CPointBounds box;
+        };
+        const CVertexFold verts = m_mesh.parallel_reduce_vertices(CVertexFold(), [&](CVertexFold & acc, CVertex * v)
+        {
+            acc.vertices++;
+            uint32_t valence = 0;
+            bool boundary = false;
+            if (v->halfedge())
+            {
+                for (CEdge * e : v->edges_range())
+                {
+                    valence++;
+                    boundary = boundary || e->boundary();
+                }
+            }
+            acc.box.add(v->point());
+            acc.valence[std::min<uint32_t>(valence, CMeshReport::s_valences - 1)]++;
+            if (valence == 0)
+            {
+                acc.isolated++;
+                return;
+            }
+            if (boundary) acc.boundary++;
+            acc.valence_sum += valence;
+            acc.valence_min = std::min(acc.valence_min, valence);
+            acc.valence_max = std::max(acc.valence_max, valence);
+        }, [](const CVertexFold & a, const CVertexFold & b)
+        {
+            CVertexFold c;
+            c.vertices = a.vertices + b.vertices;
+            c.isolated = a.isolated + b.isolated;
+            c.boundary = a.boundary + b.boundary;
+            c.valence_sum = a.valence_sum + b.valence_sum;
+            c.valence_min = std::min(a.valence_min, b.valence_min);
+            c.valence_max = std::max(a.valence_max, b.valence_max);
+            for (int k = 0; k < CMeshReport::s_valences; k++) c.valence[k] = a.valence[k] + b.valence[k];
+            c.box = CPointBounds::join(a.box, b.box);
+            return c;
+        }, threads);
+
+        // the faces, their corners and areas
+        struct CFaceFold
+        {
+            uint64_t faces = 0, triangles = 0, corners = 0;
+            double area = 0;
+        };
+        const CFaceFold faces = m_mesh.parallel_reduce_faces(CFaceFold(), [&](CFaceFold & acc, CFace * f)
+        {
+            acc.faces++;
+            uint64_t corners = 0;
+            CPoint twice(0, 0, 0);
+            for (CHalfEdge * he : f->halfedges_range())
+            {
+                corners++;
+                twice += he->source()->point() ^ he->target()->point();
+            }
+            acc.corners += corners;
+            if (corners == 3) acc.triangles++;
+            acc.area += 0.5 * twice.norm();
+        }, [](const CFaceFold & a, const CFaceFold & b)
+        {
+            CFaceFold c;
+            c.faces = a.faces + b.faces;
+            c.triangles = a.triangles + b.triangles;
+            c.corners = a.corners + b.corners;
+            c.area = a.area + b.area;
+            return c;
+        }, threads);
+
+        r.vertices = verts.vertices;
+        r.edges = edges.edges;
+        r.faces = faces.faces;
+        r.halfedges = faces.corners;
+        r.triangles = faces.triangles;
+        r.isolated_vertices = verts.isolated;
+        r.boundary_vertices = verts.boundary;
+        r.boundary_edges = edges.boundary;
+        r.boundary_loops = edges.boundary - edges.linked;
+        // every vertex with an edge starts as a component of its own
+        r.components = verts.vertices - verts.isolated - edges.joined;
+        r.euler = (int64_t)(verts.vertices - verts.isolated) - (int64_t)edges.edges + (int64_t)faces.faces;
+        r.genus = (2 * (int64_t)r.components - (int64_t)r.boundary_loops - r.euler) / 2;
+        const uint64_t connected = verts.vertices - verts.isolated;
+        r.valence_min = connected ? verts.valence_min : 0;
+        r.valence_max = verts.valence_max;
+        r.valence_mean = connected ? (double)verts.valence_sum / (double)connected : 0;
+        for (int k = 0; k < CMeshReport::s_valences; k++) r.valence[k] = verts.valence[k];
+        r.area = faces.area;
+        if (verts.vertices)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                r.lo[d] = (float)verts.box.lo[d];
+                r.hi[d] = (float)verts.box.hi[d];
+            }
+        }
+        return m_report;
+    };
+
+}; //namespace
+
+#endif
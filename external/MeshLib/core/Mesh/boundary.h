@@ -15,7 +15,7 @@
 #include <algorithm>
 #include <vector>
 #include <list>
-#include <set>
+#include <unordered_map>
 #include "mesh.h"
 
 namespace MeshLib
@@ -27,11 +27,11 @@ namespace MeshLib
         \tparam CFace   Face   type
         \tparam CHalfEdge HalfEdge type
     */
-    template<typename V, typename E, typename F, typename H>
+    template<typename V, typename E, typename F, typename H, typename A = CBlockArena, typename P = CAllFields>
     class CLoopSegment
     {
     public:
-        using CMesh = CBaseMesh<V, E, F, H>;
+        using CMesh = CBaseMesh<V, E, F, H, A, P>;
         using CVertex = typename CMesh::CVertex;
         using CEdge = typename CMesh::CEdge;
         using CFace = typename CMesh::CFace;
@@ -44,12 +44,28 @@ namespace MeshLib
         CLoopSegment(CMesh * pMesh, std::vector<CHalfEdge*> & pHs)
         {
             m_pMesh = pMesh;
+            m_sequence = NULL;
+            m_first = 0;
+            m_count = 0;
 
             for (size_t i = 0; i < pHs.size(); i++)
             {
                 m_halfedges.push_back(pHs[i]);
             }
         }
+        /*!
+            Constructor of the CLoopSegment over count halfedges of a loop from first on, wrapping
+            around, its halfedges are copied only once they are asked for
+            \param pMesh  pointer to the current mesh
+            \param sequence the halfedges of the loop, it has to outlive the segment
+        */
+        CLoopSegment(CMesh * pMesh, const std::vector<CHalfEdge*> * sequence, size_t first, size_t count)
+        {
+            m_pMesh = pMesh;
+            m_sequence = sequence;
+            m_first = first;
+            m_count = count;
+        }
         /*!
            Destructor of CLoop.
         */
@@ -63,26 +79,35 @@ namespace MeshLib
         */
         std::vector<CHalfEdge*>  & halfedges()
         {
+            if (m_halfedges.empty() && m_count > 0)
+            {
+                m_halfedges.reserve(m_count);
+                for (size_t i = 0; i < m_count; i++) m_halfedges.push_back(_at(i));
+            }
             return m_halfedges;
         }
+        /*!
+            number of halfedges, without copying them
+        */
+        size_t size() const
+        {
+            return m_sequence ? m_count : m_halfedges.size();
+        }
         /*!
             Starting vertex
         */
         CVertex * start()
         {
-            if (m_halfedges.size() == 0) return NULL;
-            CHalfEdge * he = m_halfedges[0];
-            return m_pMesh->halfedgeSource(he);
+            if (size() == 0) return NULL;
+            return _at(0)->source();
         }
         /*!
             ending vertex
         */
         CVertex * end()
         {
-            if (m_halfedges.size() == 0) return NULL;
-            size_t n = m_halfedges.size();
-            CHalfEdge * he = m_halfedges[n - 1];
-            return m_pMesh->halfedgeTarget(he);
+            if (size() == 0) return NULL;
+            return _at(size() - 1)->target();
         }
 
     protected:
@@ -95,7 +120,20 @@ namespace MeshLib
             The vector of consecutive halfedges along the boundary loop.
         */
         std::vector<CHalfEdge*>							  m_halfedges;
+        /*!
+            The halfedges of the loop and the range of them, NULL if the segment holds its own
+        */
+        const std::vector<CHalfEdge*> * m_sequence;
+        size_t                          m_first;
+        size_t                          m_count;
 
+        CHalfEdge * _at(size_t i)
+        {
+            if (!m_sequence) return m_halfedges[i];
+            size_t k = m_first + i;
+            if (k >= m_sequence->size()) k -= m_sequence->size();
+            return (*m_sequence)[k];
+        }
     };
 
     /*!
@@ -105,15 +143,15 @@ namespace MeshLib
         \tparam CFace   Face   type
         \tparam CHalfEdge HalfEdge type
     */    
-    template<typename V, typename E, typename F, typename H>
+    template<typename V, typename E, typename F, typename H, typename A = CBlockArena, typename P = CAllFields>
     class CLoop
     {
-        using CMesh = CBaseMesh<V, E, F, H>;
+        using CMesh = CBaseMesh<V, E, F, H, A, P>;
         using CVertex = typename CMesh::CVertex;
         using CEdge = typename CMesh::CEdge;
         using CFace = typename CMesh::CFace;
         using CHalfEdge = typename CMesh::CHalfEdge;
-        using TSegment = CLoopSegment<V, E, F, H>;
+        using TSegment = CLoopSegment<V, E, F, H, A, P>;
 
     public:
         /*!
@@ -163,10 +201,16 @@ namespace MeshLib
             return m_segments;
         }
         /*!
-            divide the loop to segments
+            divide the loop to segments, replacing those of an earlier call. Each marker is
+            found by its position in the loop, the segments copy their halfedges only when
+            asked for them, see CLoopSegment::halfedges
             \param markers, the array of markers, the first marker is the starting one
         */
         void divide(std::vector<CVertex*> & markers);
+        /*!
+            position of the halfedge leaving v in the loop, -1 if v is not on it
+        */
+        int position(CVertex * v);
 
     protected:
         /*!
@@ -188,6 +232,13 @@ namespace MeshLib
             Vector of segments
         */
         std::vector<TSegment*> m_segments;
+        /*!
+            The halfedges in a vector, and the position of the halfedge leaving each vertex,
+            built from m_halfedges when it is first needed and again once it has changed
+        */
+        std::vector<CHalfEdge*> m_sequence;
+        std::unordered_map<CVertex*, size_t> m_position;
+        void _index();
     };
 
     /*!
@@ -197,15 +248,15 @@ namespace MeshLib
         \tparam CFace   Face   type
         \tparam CHalfEdge HalfEdge type
     */
-    template<typename V, typename E, typename F, typename H>
+    template<typename V, typename E, typename F, typename H, typename A = CBlockArena, typename P = CAllFields>
     class CBoundary
     {
-        using CMesh = CBaseMesh<V, E, F, H>;
+        using CMesh = CBaseMesh<V, E, F, H, A, P>;
         using CVertex = typename CMesh::CVertex;
         using CEdge = typename CMesh::CEdge;
         using CFace = typename CMesh::CFace;
         using CHalfEdge = typename CMesh::CHalfEdge;
-        using TLoop = CLoop<V, E, F, H>;
+        using TLoop = CLoop<V, E, F, H, A, P>;
 
     public:
         /*!
@@ -235,10 +286,10 @@ namespace MeshLib
         */
         typename std::vector<TLoop*> m_loops;
         /*!
-            Bubble sort the loops
+            Sort the loops, the longest first, loops of equal length keep their order
             \param loops the vector of loops
         */
-        void _bubble_sort(std::vector<TLoop*> & loops);
+        void _sort(std::vector<TLoop*> & loops);
     };
 
     /*!
@@ -246,8 +297,8 @@ namespace MeshLib
         \param pMesh pointer to the current mesh
         \param pH  halfedge on the current boundary loop
     */
-    template<typename V, typename E, typename F, typename H>
-    CLoop<V, E, F, H>::CLoop(CMesh * pMesh, CHalfEdge * pH)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    CLoop<V, E, F, H, A, P>::CLoop(CMesh * pMesh, CHalfEdge * pH)
     {
         m_pMesh = pMesh;
         m_pHalfedge = pH;
@@ -266,8 +317,27 @@ namespace MeshLib
     /*!
     CLoop destructor, clean up the list of halfedges in the loop
     */
-    template<typename V, typename E, typename F, typename H>
-    CLoop<V, E, F, H>::~CLoop()
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CLoop<V, E, F, H, A, P>::_index()
+    {
+        if (m_sequence.size() == m_halfedges.size()) return;
+        m_sequence.assign(m_halfedges.begin(), m_halfedges.end());
+        m_position.clear();
+        m_position.reserve(m_sequence.size());
+        //a pinched vertex is found at its first halfedge
+        for (size_t i = 0; i < m_sequence.size(); i++) m_position.emplace(m_sequence[i]->source(), i);
+    }
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    int CLoop<V, E, F, H, A, P>::position(CVertex * v)
+    {
+        _index();
+        auto it = m_position.find(v);
+        return it == m_position.end() ? -1 : (int)it->second;
+    }
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    CLoop<V, E, F, H, A, P>::~CLoop()
     {
         m_halfedges.clear();
 
@@ -280,74 +350,55 @@ namespace MeshLib
 
 
     /*!
-        _bubble_sort
-        bubble sort  a vector of boundary loop objects, according to their lengths
+        _sort
+        sort a vector of boundary loop objects by their lengths, descending
         \param loops vector of loops
     */
-    template<typename V, typename E, typename F, typename H>
-    void CBoundary<V, E, F, H>::_bubble_sort(std::vector<TLoop*> & loops)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CBoundary<V, E, F, H, A, P>::_sort(std::vector<TLoop*> & loops)
     {
-        int i, j, flag = 1;    // set flag to 1 to start first pass
-        CLoop<V, E, F, H> * temp;             // holding variable
-        int numLength = (int)loops.size();
-        for (i = 1; (i <= numLength) && flag; i++)
-        {
-            flag = 0;
-            for (j = 0; j < (numLength - 1); j++)
-            {
-                if (loops[j + 1]->length() > loops[j]->length())      // ascending order simply changes to <
-                {
-                    temp = loops[j];								// swap elements
-                    loops[j] = loops[j + 1];
-                    loops[j + 1] = temp;
-                    flag = 1;										// indicates that a swap occurred.
-                }
-            }
-        }
+        std::stable_sort(loops.begin(), loops.end(), [](TLoop * a, TLoop * b) { return a->length() > b->length(); });
     }
 
     /*!
         CBoundary constructor
         \param pMesh the current mesh
     */
-    template<typename V, typename E, typename F, typename H>
-    CBoundary<V, E, F, H>::CBoundary(CMesh * pMesh)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    CBoundary<V, E, F, H, A, P>::CBoundary(CMesh * pMesh)
     {
         m_pMesh = pMesh;
-        //collect all boundary halfedges
-        std::set<CHalfEdge*> boundary_hes;
-        for (CEdge * e : m_pMesh->edges())        
+        //collect all boundary halfedges, and the slots they take
+        std::vector<CHalfEdge*> boundary_hes;
+        size_t slots = 0;
+        for (CEdge * e : m_pMesh->edges())
         {
             if (!e->boundary()) continue;
             CHalfEdge * he = e->halfedge(0);
-            boundary_hes.insert(he);
+            boundary_hes.push_back(he);
+            slots = std::max(slots, he->property_index() + 1);
         }
-        //trace all the boundary loops
-        while (!boundary_hes.empty())
+        //trace a loop from every halfedge no loop has passed yet, each halfedge is visited once
+        std::vector<char> visited(slots, 0);
+        for (CHalfEdge * he : boundary_hes)
         {
-            //get the first boundary halfedge
-            CHalfEdge * he = *boundary_hes.begin();
-            //trace along this boundary halfedge
+            if (visited[he->property_index()]) continue;
             TLoop * pL = new TLoop(m_pMesh, he);
             assert(pL);
             m_loops.push_back(pL);
-            //remove all the boundary halfedges, which are in the same boundary loop as the head, from the halfedge list
-            for (CHalfEdge * he : pL->halfedges())
+            for (CHalfEdge * ph : pL->halfedges())
             {
-                typename std::set<CHalfEdge*>::iterator siter = boundary_hes.find(he);
-                if (siter == boundary_hes.end()) continue;
-                boundary_hes.erase(siter);
+                if (ph->property_index() < slots) visited[ph->property_index()] = 1;
             }
         }
 
-        //std::sort( vlps.begin(), vlps.end(), loop_compare<CVertex,CFace,CEdge,CHalfEdge> );
-        _bubble_sort(m_loops);
+        _sort(m_loops);
     }
 
     /*!	CBoundary destructor, delete all boundary loop objects.
     */
-    template<typename V, typename E, typename F, typename H>
-    CBoundary<V, E, F, H>::~CBoundary()
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    CBoundary<V, E, F, H, A, P>::~CBoundary()
     {
         for (TLoop * pL : m_loops) delete pL;
         m_loops.clear();
@@ -357,8 +408,8 @@ namespace MeshLib
         Output the loop to a file
         \param file_name the name of the file
     */
-    template<typename V, typename E, typename F, typename H>
-    void CLoop<V, E, F, H>::write(const char * file_name)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CLoop<V, E, F, H, A, P>::write(const char * file_name)
     {
         std::ofstream ofs;
         ofs.open(file_name);
@@ -375,27 +426,31 @@ namespace MeshLib
         Output the loop to a file
         \param file_name the name of the file
     */
-    template<typename V, typename E, typename F, typename H>
-    void CLoop<V, E, F, H>::read(const char * file_name)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CLoop<V, E, F, H, A, P>::read(const char * file_name)
     {
-        std::ifstream ifs;
-        ifs.open(file_name);
+        CMappedFile file(file_name);
+        if (!file.is_open()) return;
 
-        if (ifs.is_open())
+        // one "source target" pair per line
+        const char * p = file.begin();
+        const char * end = file.end();
+        while (p < end)
         {
-            while (ifs.good())
-            {
-                int source, target;
-                ifs >> source >> target;
-                CVertex * pS = m_pMesh->vertex(source);
-                CVertex * pT = m_pMesh->vertex(target);
-                CEdge   * pE = m_pMesh->edge(pS, pT);
-                CHalfEdge * pH = pE->halfedge(0);
-                m_halfedges.push_back(pH);
-            }
-            ifs.close();
+            int source, target;
+            CNumParser::skip_blank(p, end);
+            bool ok = CNumParser::scan_int(p, end, source);
+            CNumParser::skip_blank(p, end);
+            ok = ok && CNumParser::scan_int(p, end, target);
+            CNumParser::skip_line(p, end);
+            if (!ok) continue;
+
+            CVertex * pS = m_pMesh->vertex(source);
+            CVertex * pT = m_pMesh->vertex(target);
+            CEdge   * pE = (pS && pT) ? m_pMesh->edge(pS, pT) : NULL;
+            if (pE == NULL) continue;
+            m_halfedges.push_back(pE->halfedge(0));
         }
-
     };
 
 
@@ -403,50 +458,45 @@ namespace MeshLib
         Divide the loop to segments
         \param markers
     */
-    template<typename V, typename E, typename F, typename H>
-    void CLoop<V, E, F, H>::divide(std::vector<CVertex*> & markers)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CLoop<V, E, F, H, A, P>::divide(std::vector<CVertex*> & markers)
     {
-        std::deque<CHalfEdge*> queue;
-        for (CHalfEdge * pH : m_halfedges)  queue.push_back(pH);
-        
-        size_t n = 0;
-        while (true)
+        for (TSegment * pS : m_segments) delete pS;
+        m_segments.clear();
+        if (markers.empty()) return;
+
+        const size_t n = m_halfedges.size();
+        std::vector<size_t> starts(markers.size());
+        for (size_t i = 0; i < markers.size(); i++)
         {
-            CHalfEdge * pH = queue.front();
-            if (pH->source() == markers[0]) break;
-            queue.pop_front();
-            queue.push_back(pH);
-            n++;
-            if (n > queue.size()) break;
+            const int p = position(markers[i]);
+            if (p < 0)
+            {
+                if (i == 0) std::cerr << "CLoop::divide: can not find the starting vertex " << std::endl;
+                else std::cerr << "CLoop::divide error" << std::endl;
+                return;
+            }
+            starts[i] = (size_t)p;
         }
 
-        if (n > queue.size())
+        //each segment runs to the next marker, the last one back to the first, once around in all
+        size_t total = 0;
+        std::vector<size_t> counts(markers.size());
+        for (size_t i = 0; i < markers.size(); i++)
         {
-            std::cerr << "CLoop::divide: can not find the starting vertex " << std::endl;
+            const size_t next = starts[(i + 1) % markers.size()];
+            counts[i] = (next + n - starts[i] - 1) % n + 1;
+            total += counts[i];
+        }
+        if (total != n)
+        {
+            std::cerr << "CLoop::divide error" << std::endl;
             return;
         }
 
         for (size_t i = 0; i < markers.size(); i++)
         {
-            std::vector<CHalfEdge*> hes;
-            CHalfEdge * ph = queue.front();
-            queue.pop_front();
-            assert(ph->source() == markers[i]);
-            hes.push_back(ph);
-
-            while (ph->target() != markers[(i + 1) % markers.size()])
-            {
-                if (queue.empty())
-                {
-                    std::cerr << "CLoop::divide error" << std::endl;
-                    return;
-                }
-                ph = queue.front();
-                queue.pop_front();
-                hes.push_back(ph);
-            }
-
-            TSegment * pS = new TSegment(m_pMesh, hes);
+            TSegment * pS = new TSegment(m_pMesh, &m_sequence, starts[i], counts[i]);
             assert(pS != NULL);
             m_segments.push_back(pS);
         }
@@ -0,0 +1,73 @@
+/*!
+*      \file circulator.h
+*      \brief Allocation free ranges around the vertices and faces of a halfedge mesh
+*/
+
+#ifndef _MESHLIB_CIRCULATOR_H_
+#define _MESHLIB_CIRCULATOR_H_
+
+#include <cstddef>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CCirculator class, steps through halfedges until the first one comes back or the step gives NULL
+     *
+     *  P supplies the static step(he), value(he) and tail(he) functions. With
+     *  P::s_tail set, one more value, tail() of the last halfedge, is produced
+     *  after an open fan ends, e.g. the last neighbor of a boundary vertex.
+     */
+    template<typename HE, typename P>
+    class CCirculator
+    {
+    public:
+        typedef decltype(P::value((HE *)NULL)) value_type;
+
+        CCirculator(HE * first = NULL) : m_first(first), m_he(first) {}
+
+        value_type operator*() const { return m_tail ? P::tail(m_he) : P::value(m_he); }
+
+        CCirculator & operator++()
+        {
+            if (m_tail)
+            {
+                m_tail = false;
+                m_he = NULL;
+                return *this;
+            }
+            HE * next = P::step(m_he);
+            if (next == NULL && P::s_tail)
+            {
+                m_tail = true;
+                return *this;
+            }
+            m_he = (next == m_first) ? NULL : next;
+            return *this;
+        }
+
+        bool operator==(const CCirculator & other) const { return m_he == other.m_he && m_tail == other.m_tail; }
+        bool operator!=(const CCirculator & other) const { return !(*this == other); }
+
+    protected:
+        HE * m_first;
+        HE * m_he;
+        bool m_tail = false;
+    };
+
+    /*! begin/end pair of a circulation, for range-for */
+    template<typename HE, typename P>
+    class CCirculatorRange
+    {
+    public:
+        CCirculatorRange(HE * first) : m_first(first) {}
+        CCirculator<HE, P> begin() const { return CCirculator<HE, P>(m_first); }
+        CCirculator<HE, P> end() const { return CCirculator<HE, P>(); }
+
+    protected:
+        HE * m_first;
+    };
+
+}; //namespace
+
+#endif
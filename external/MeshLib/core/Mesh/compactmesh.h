@@ -0,0 +1,511 @@
+/*!
+*      \file compactmesh.h
+*      \brief Index based halfedge mesh with struct-of-arrays storage
+*
+*      CCompactMesh holds the connectivity of a polygon mesh in int32 arrays
+*      and the positions as floats, about 60 bytes per triangle. It is meant
+*      for read-mostly work, such as rendering, sampling and curvature, on
+*      meshes too large for CBaseMesh, and converts to and from CBaseMesh.
+*
+*      CMappedCompactMesh is the same mesh read-only over a mapped .smv cache,
+*      its arrays point into the mapping, so processes opening the same cache
+*      share one copy of it in the page cache and opening costs the mapping.
+*/
+
+#ifndef _MESHLIB_COMPACT_MESH_H_
+#define _MESHLIB_COMPACT_MESH_H_
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+#include "../Geometry/Point.h"
+#include "../Geometry/Point2.h"
+#include "../parser/smv.h"
+
+namespace MeshLib
+{
+
+    /*! single precision position or normal */
+    struct CFloat3 { float x, y, z; };
+    /*! single precision texture coordinates */
+    struct CFloat2 { float u, v; };
+
+    /*!
+     *  \brief CCompactArrayView class, a read-only array in memory owned elsewhere, a mapped file say
+     */
+    template<typename T>
+    class CCompactArrayView
+    {
+    public:
+        CCompactArrayView() {}
+        CCompactArrayView(const T * data, size_t size) : m_data(data), m_size(size) {}
+
+        const T & operator[](size_t i) const { return m_data[i]; }
+        const T * data() const { return m_data; }
+        const T * begin() const { return m_data; }
+        const T * end() const { return m_data + m_size; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        /*! no memory of its own */
+        size_t capacity() const { return 0; }
+        void clear() { m_data = NULL; m_size = 0; }
+
+    protected:
+        const T * m_data = NULL;
+        size_t    m_size = 0;
+    };
+
+    /*!
+     *  \brief CTriangleArray class, an array of a triangle mesh that follows from the index,
+     *  the halfedges of triangle j being 3j, 3j+1 and 3j+2
+     */
+    template<typename Fn>
+    class CTriangleArray
+    {
+    public:
+        CTriangleArray(size_t size = 0) : m_size(size) {}
+
+        int32_t operator[](int32_t i) const { return Fn()(i); }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        size_t capacity() const { return 0; }
+        void clear() { m_size = 0; }
+
+    protected:
+        size_t m_size;
+    };
+
+    struct CTriangleNext { int32_t operator()(int32_t he) const { return he % 3 == 2 ? he - 2 : he + 1; } };
+    struct CTriangleFace { int32_t operator()(int32_t he) const { return he / 3; } };
+    struct CTriangleFirst { int32_t operator()(int32_t f) const { return 3 * f; } };
+
+    /*! the arrays of CCompactMesh, owned and growable */
+    struct CCompactVectors
+    {
+        template<typename T> using array = std::vector<T>;
+        using next_array = std::vector<int32_t>;
+        using face_array = std::vector<int32_t>;
+        using first_array = std::vector<int32_t>;
+    };
+
+    /*! the arrays of CMappedCompactMesh, views of a mapped triangle mesh */
+    struct CCompactViews
+    {
+        template<typename T> using array = CCompactArrayView<T>;
+        using next_array = CTriangleArray<CTriangleNext>;
+        using face_array = CTriangleArray<CTriangleFace>;
+        using first_array = CTriangleArray<CTriangleFirst>;
+    };
+
+    /*!
+     *  \brief CBasicCompactMesh class, halfedge connectivity as index arrays
+     *
+     *  The halfedges of a face are stored next to each other, in corner order,
+     *  like the corners of the input arrays. As in CBaseMesh, he_vert is the
+     *  target vertex of a halfedge, and boundary halfedges have no twin (-1).
+     *  Only consistently oriented manifold edges get twins, so that the
+     *  circulators always terminate. The outgoing halfedge of a boundary
+     *  vertex is its boundary halfedge, the most clockwise one, so that a
+     *  counter clockwise sweep meets every neighbor.
+     *
+     *  Storage gives the array types, see CCompactVectors and CCompactViews.
+     *  build and from_mesh need growable arrays.
+     */
+    template<typename Storage>
+    class CBasicCompactMesh
+    {
+    public:
+        /*!
+         *  \brief CFaceCirculator class, halfedges or vertices of a face, in order
+         */
+        template<bool Vertices>
+        class CFaceCirculator
+        {
+        public:
+            CFaceCirculator(const CBasicCompactMesh * mesh, int32_t he) : m_mesh(mesh), m_first(he), m_he(he) {}
+
+            int32_t operator*() const { return Vertices ? m_mesh->he_vert[m_he] : m_he; }
+            CFaceCirculator & operator++()
+            {
+                m_he = m_mesh->he_next[m_he];
+                if (m_he == m_first) m_he = -1;
+                return *this;
+            }
+            bool operator==(const CFaceCirculator & other) const { return m_he == other.m_he; }
+            bool operator!=(const CFaceCirculator & other) const { return m_he != other.m_he; }
+
+        protected:
+            const CBasicCompactMesh * m_mesh;
+            int32_t              m_first;
+            int32_t              m_he;
+        };
+
+        /*!
+         *  \brief CVertexCirculator class, outgoing halfedges or neighbors of a vertex, counter clockwise
+         *
+         *  The ccw_rotate_about_source() sweep of CBaseMesh, from the most clockwise
+         *  outgoing halfedge of a boundary vertex, from any one of an interior
+         *  vertex. A boundary vertex has one more neighbor than outgoing halfedges.
+         */
+        template<bool Vertices>
+        class CVertexCirculator
+        {
+        public:
+            CVertexCirculator(const CBasicCompactMesh * mesh, int32_t he) : m_mesh(mesh), m_first(he), m_he(he) {}
+
+            int32_t operator*() const
+            {
+                if (m_tail >= 0) return m_tail;
+                return Vertices ? m_mesh->he_vert[m_he] : m_he;
+            }
+            CVertexCirculator & operator++()
+            {
+                if (m_tail >= 0) { m_tail = -1; m_he = -1; return *this; }
+                int32_t in = m_mesh->prev(m_he);
+                int32_t next = m_mesh->he_twin[in];
+                if (next < 0 && Vertices)
+                {
+                    // the source of the boundary halfedge coming in
+                    m_tail = m_mesh->source(in);
+                    return *this;
+                }
+                m_he = (next == m_first) ? -1 : next;
+                return *this;
+            }
+            bool operator==(const CVertexCirculator & other) const { return m_he == other.m_he && m_tail == other.m_tail; }
+            bool operator!=(const CVertexCirculator & other) const { return !(*this == other); }
+
+        protected:
+            const CBasicCompactMesh * m_mesh;
+            int32_t              m_first;
+            int32_t              m_he;
+            int32_t              m_tail = -1;
+        };
+
+        /*! begin/end pair for range-for */
+        template<typename It>
+        class CRange
+        {
+        public:
+            CRange(It b, It e) : m_begin(b), m_end(e) {}
+            It begin() const { return m_begin; }
+            It end() const { return m_end; }
+        protected:
+            It m_begin, m_end;
+        };
+
+        int num_vertices() const { return (int)v_pos.size(); }
+        int num_faces() const { return (int)f_he.size(); }
+        int num_halfedges() const { return (int)he_next.size(); }
+
+        CPoint point(int32_t v) const { return CPoint(v_pos[v].x, v_pos[v].y, v_pos[v].z); }
+
+        /*! previous halfedge in the face, walks the face */
+        int32_t prev(int32_t he) const
+        {
+            int32_t p = he;
+            while (he_next[p] != he) p = he_next[p];
+            return p;
+        }
+        int32_t source(int32_t he) const { return he_vert[prev(he)]; }
+        int32_t target(int32_t he) const { return he_vert[he]; }
+        bool    boundary(int32_t he) const { return he_twin[he] < 0; }
+        /*! whether v is on the boundary, isolated vertices count as not */
+        bool    vertex_boundary(int32_t v) const { return v_he[v] >= 0 && he_twin[v_he[v]] < 0; }
+
+        /*! halfedges of face f, like CBaseMesh::CFace::halfedges() */
+        CRange<CFaceCirculator<false>> face_halfedges(int32_t f) const { return _face_range<false>(f); }
+        /*! vertices of face f, like CBaseMesh::CFace::vertices() */
+        CRange<CFaceCirculator<true>> face_vertices(int32_t f) const { return _face_range<true>(f); }
+        /*! outgoing halfedges of v, counter clockwise */
+        CRange<CVertexCirculator<false>> vertex_out_halfedges(int32_t v) const { return _vertex_range<false>(v); }
+        /*! neighbors of v, counter clockwise, like CBaseMesh::CVertex::vertices() */
+        CRange<CVertexCirculator<true>> vertex_vertices(int32_t v) const { return _vertex_range<true>(v); }
+
+        void clear()
+        {
+            v_pos.clear(); v_normal.clear(); v_uv.clear(); v_he.clear();
+            he_next.clear(); he_twin.clear(); he_vert.clear(); he_face.clear();
+            f_he.clear();
+        }
+
+        /*! bytes held by the arrays */
+        size_t memory() const
+        {
+            return (v_pos.capacity() + v_normal.capacity()) * sizeof(CFloat3) + v_uv.capacity() * sizeof(CFloat2) +
+                (v_he.capacity() + he_next.capacity() + he_twin.capacity() + he_vert.capacity() +
+                    he_face.capacity() + f_he.capacity()) * sizeof(int32_t);
+        }
+
+        /*!
+         *  Build from flat arrays, as CBaseMesh::build_from_arrays takes them
+         *  \param indices       0-based vertex indices of the corners
+         *  \param face_offsets  first corner of every face and the end, empty for triangles
+         */
+        void build(const std::vector<CPoint> & points, const std::vector<int> & indices, const std::vector<int> & face_offsets = std::vector<int>())
+        {
+            clear();
+            const int32_t nv = (int32_t)points.size();
+            const int32_t nf = face_offsets.empty() ? (int32_t)(indices.size() / 3) : (int32_t)face_offsets.size() - 1;
+
+            v_pos.resize(nv);
+            for (int32_t i = 0; i < nv; i++) v_pos[i] = CFloat3{ (float)points[i][0], (float)points[i][1], (float)points[i][2] };
+
+            he_next.reserve(indices.size());
+            he_vert.reserve(indices.size());
+            he_face.reserve(indices.size());
+            f_he.reserve(nf);
+            for (int32_t f = 0; f < nf; f++)
+            {
+                int fb = face_offsets.empty() ? 3 * f : face_offsets[f];
+                int fe = face_offsets.empty() ? 3 * f + 3 : face_offsets[f + 1];
+                int32_t first = (int32_t)he_next.size();
+                f_he.push_back(first);
+                for (int c = fb; c < fe; c++)
+                {
+                    he_vert.push_back(indices[c]);
+                    he_face.push_back(f);
+                    he_next.push_back(c + 1 < fe ? (int32_t)he_next.size() + 1 : first);
+                }
+            }
+            _link();
+        }
+
+        /*!
+         *  Copy a CBaseMesh, vertices and faces are numbered in the order of
+         *  vertices() and faces(), positions are rounded to float.
+         */
+        template<typename M>
+        void from_mesh(M & mesh)
+        {
+            clear();
+            std::unordered_map<const void *, int32_t> vindex;
+            vindex.reserve(mesh.num_vertices());
+            for (auto v : mesh.vertices())
+            {
+                vindex[v] = (int32_t)v_pos.size();
+                CPoint & p = v->point();
+                CPoint & n = v->normal();
+                CPoint2 & t = v->uv();
+                v_pos.push_back(CFloat3{ (float)p[0], (float)p[1], (float)p[2] });
+                v_normal.push_back(CFloat3{ (float)n[0], (float)n[1], (float)n[2] });
+                v_uv.push_back(CFloat2{ (float)t[0], (float)t[1] });
+            }
+
+            std::unordered_map<const void *, int32_t> hindex;
+            hindex.reserve(3 * mesh.num_faces());
+            std::vector<const void *> duals;
+            for (auto f : mesh.faces())
+            {
+                int32_t first = (int32_t)he_next.size();
+                f_he.push_back(first);
+                auto he = f->halfedge();
+                do {
+                    hindex[he] = (int32_t)he_next.size();
+                    // a dual in the same direction, a flipped face, cannot be circulated
+                    auto d = he->dual();
+                    duals.push_back((d && d->vertex() != he->vertex()) ? d : NULL);
+                    he_vert.push_back(vindex[he->vertex()]);
+                    he_face.push_back((int32_t)f_he.size() - 1);
+                    he_next.push_back((int32_t)he_next.size() + 1);
+                    he = he->next();
+                } while (he != f->halfedge());
+                he_next.back() = first;
+            }
+
+            he_twin.resize(he_next.size());
+            for (size_t i = 0; i < duals.size(); i++)
+            {
+                const void * d = duals[i];
+                he_twin[i] = d ? hindex[d] : -1;
+            }
+            _link_vertices();
+        }
+
+        /*!
+         *  Build a CBaseMesh, vertex and face ids are the indices plus one.
+         *  Duals are found again from the corner order.
+         */
+        template<typename M>
+        void to_mesh(M & mesh) const
+        {
+            std::vector<CPoint> points(v_pos.size());
+            for (size_t i = 0; i < v_pos.size(); i++) points[i] = point((int32_t)i);
+
+            std::vector<CPoint2> uvs;
+            if (v_uv.size() == v_pos.size())
+            {
+                uvs.resize(v_uv.size());
+                for (size_t i = 0; i < v_uv.size(); i++) uvs[i] = CPoint2(v_uv[i].u, v_uv[i].v);
+            }
+            std::vector<CPoint> normals;
+            if (v_normal.size() == v_pos.size())
+            {
+                normals.resize(v_normal.size());
+                for (size_t i = 0; i < v_normal.size(); i++) normals[i] = CPoint(v_normal[i].x, v_normal[i].y, v_normal[i].z);
+            }
+
+            std::vector<int> indices;
+            std::vector<int> offsets;
+            indices.reserve(he_vert.size());
+            offsets.reserve(f_he.size() + 1);
+            for (int32_t f = 0; f < num_faces(); f++)
+            {
+                offsets.push_back((int)indices.size());
+                for (int32_t v : face_vertices(f)) indices.push_back(v);
+            }
+            offsets.push_back((int)indices.size());
+
+            mesh.build_from_arrays(points, uvs, normals, indices, offsets, std::vector<int>(), std::vector<int>());
+        }
+
+    public:
+        /*! vertex positions */
+        typename Storage::template array<CFloat3> v_pos;
+        /*! vertex normals, empty if there are none */
+        typename Storage::template array<CFloat3> v_normal;
+        /*! vertex texture coordinates, empty if there are none */
+        typename Storage::template array<CFloat2> v_uv;
+        /*! one outgoing halfedge per vertex, -1 for isolated vertices */
+        typename Storage::template array<int32_t> v_he;
+
+        /*! next halfedge in the face */
+        typename Storage::next_array he_next;
+        /*! opposite halfedge, -1 on the boundary */
+        typename Storage::template array<int32_t> he_twin;
+        /*! target vertex */
+        typename Storage::template array<int32_t> he_vert;
+        /*! face of the halfedge */
+        typename Storage::face_array he_face;
+
+        /*! first halfedge of every face */
+        typename Storage::first_array f_he;
+
+    protected:
+        template<bool Vertices>
+        CRange<CFaceCirculator<Vertices>> _face_range(int32_t f) const
+        {
+            return CRange<CFaceCirculator<Vertices>>(CFaceCirculator<Vertices>(this, f_he[f]), CFaceCirculator<Vertices>(this, -1));
+        }
+
+        template<bool Vertices>
+        CRange<CVertexCirculator<Vertices>> _vertex_range(int32_t v) const
+        {
+            return CRange<CVertexCirculator<Vertices>>(CVertexCirculator<Vertices>(this, v_he[v]), CVertexCirculator<Vertices>(this, -1));
+        }
+
+        /*! pair the halfedges by their (min, max) vertex key, and set the vertex halfedges */
+        void _link()
+        {
+            const size_t nh = he_next.size();
+            std::vector<int32_t> src(nh);
+            for (int32_t f = 0; f < num_faces(); f++)
+            {
+                int32_t he = f_he[f];
+                do {
+                    src[he_next[he]] = he_vert[he];
+                    he = he_next[he];
+                } while (he != f_he[f]);
+            }
+
+            std::vector<std::pair<uint64_t, int32_t>> keys(nh);
+            for (size_t i = 0; i < nh; i++)
+            {
+                uint64_t s = (uint32_t)src[i], t = (uint32_t)he_vert[i];
+                keys[i].first = s < t ? (s << 32 | t) : (t << 32 | s);
+                keys[i].second = (int32_t)i;
+            }
+            std::sort(keys.begin(), keys.end());
+
+            // an edge with exactly two opposite halfedges links them, other edges stay boundary
+            he_twin.assign(nh, -1);
+            for (size_t i = 0; i < nh;)
+            {
+                size_t j = i + 1;
+                while (j < nh && keys[j].first == keys[i].first) j++;
+                int32_t a = keys[i].second, b = keys[i + 1 < nh ? i + 1 : i].second;
+                if (j - i == 2 && src[a] == he_vert[b])
+                {
+                    he_twin[a] = b;
+                    he_twin[b] = a;
+                }
+                i = j;
+            }
+            _link_vertices();
+        }
+
+        void _link_vertices()
+        {
+            v_he.assign(v_pos.size(), -1);
+            for (int32_t f = 0; f < num_faces(); f++)
+            {
+                int32_t he = f_he[f];
+                do {
+                    // halfedge next(he) leaves the target of he
+                    int32_t out = he_next[he];
+                    int32_t & vh = v_he[he_vert[he]];
+                    if (vh < 0 || he_twin[out] < 0) vh = out;
+                    he = out;
+                } while (he != f_he[f]);
+            }
+        }
+    };
+
+    /*! the compact mesh with arrays of its own */
+    typedef CBasicCompactMesh<CCompactVectors> CCompactMesh;
+
+    /*!
+     *  \brief CMappedCompactMesh class, a read-only compact mesh over a mapped .smv cache
+     *
+     *  The cache needs its twins and outgoing halfedges, which CBaseMesh::write_smv
+     *  writes for triangle meshes. The arrays are not checked, the cache is trusted
+     *  as CSmvFile trusts it. Normals and uvs are per corner in the cache, they are
+     *  read from smv() rather than v_normal and v_uv.
+     */
+    class CMappedCompactMesh : public CBasicCompactMesh<CCompactViews>
+    {
+    public:
+        CMappedCompactMesh() {}
+        CMappedCompactMesh(const std::string & filename) { open(filename); }
+
+        /*!
+         *  Map the cache
+         *  \return false if it is missing, damaged or lacks the twins or outgoing halfedges
+         */
+        bool open(const std::string & filename)
+        {
+            close();
+            if (!m_smv.open(filename)) return false;
+            if (!m_smv.twins() || !m_smv.outgoing()) { close(); return false; }
+
+            const size_t nv = m_smv.num_vertices();
+            const size_t nh = 3 * m_smv.num_triangles();
+            v_pos = CCompactArrayView<CFloat3>((const CFloat3 *)m_smv.positions(), nv);
+            v_he = CCompactArrayView<int32_t>(m_smv.outgoing(), nv);
+            he_next = CTriangleArray<CTriangleNext>(nh);
+            he_twin = CCompactArrayView<int32_t>(m_smv.twins(), nh);
+            he_vert = CCompactArrayView<int32_t>((const int32_t *)m_smv.indices(), nh);
+            he_face = CTriangleArray<CTriangleFace>(nh);
+            f_he = CTriangleArray<CTriangleFirst>(m_smv.num_triangles());
+            return true;
+        }
+
+        void close()
+        {
+            clear();
+            m_smv.close();
+        }
+        bool is_open() const { return m_smv.is_open(); }
+
+        /*! the mapped cache, for its corner normals and uvs */
+        const CSmvFile & smv() const { return m_smv; }
+
+    protected:
+        CSmvFile m_smv;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,209 @@
+/*!
+*      \file components.h
+*      \brief Connected components of the faces of a mesh
+*
+*      The faces are joined across their edges by a union find whose links
+*      are set by compare and swap, the edges are scanned in parallel. The
+*      components are numbered from the largest down, the faces sorted by
+*      them and the bounds of each folded, so that a part can be culled,
+*      drawn or dropped as a whole. Edges can be cut, the uv seams say, so
+*      that the components are the charts of a texture atlas.
+*/
+
+#ifndef _MESHLIB_COMPONENTS_H_
+#define _MESHLIB_COMPONENTS_H_
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "mesh.h"
+#include "../Geometry/PointBounds.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CComponents class, the connected components of the faces of a mesh
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CComponents
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        /*! the component of every face is the face property name, -1 until labeled */
+        CComponents(M & mesh, const std::string & name = "component")
+            : m_mesh(mesh), m_label(mesh.template add_face_property<int>(name, -1)) {}
+
+        /*!
+         *  Label the faces, faces sharing an edge are in the same component
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return number of components
+         */
+        size_t label(int threads = 0) { return label([](CEdge *) { return true; }, threads); }
+
+        /*!
+         *  Label the faces, faces sharing an edge are in the same component if joined(edge)
+         *  \return number of components
+         */
+        template<typename Joined>
+        size_t label(Joined joined, int threads = 0);
+
+        /*! whether the faces of an edge agree on the uvs of both of its ends, it is no seam */
+        static bool same_uv(CEdge * e)
+        {
+            CHalfEdge * h0 = e->halfedge(0);
+            CHalfEdge * h1 = e->halfedge(1);
+            if (h0 == NULL || h1 == NULL) return false;
+            // a halfedge carries the uv of its face at its target
+            return h0->uv() == h1->prev()->uv() && h0->prev()->uv() == h1->uv();
+        }
+
+        /*! number of components */
+        size_t size() const { return m_bounds.size(); }
+        /*! component of a face, 0 is the one with the most faces */
+        int component(CFace * f) const { return m_label[f]; }
+        /*! the faces, those of component c at [first(c), first(c) + count(c)) */
+        const std::vector<CFace*> & faces() const { return m_faces; }
+        size_t first(size_t c) const { return m_first[c]; }
+        size_t count(size_t c) const { return m_first[c + 1] - m_first[c]; }
+        /*! the box of the vertices of component c, its sum counts a vertex once per face */
+        const CPointBounds & bounds(size_t c) const { return m_bounds[c]; }
+
+        /*!
+         *  Delete all but the n largest components, see CBaseMesh::delete_faces
+         *  \return number of faces deleted
+         */
+        size_t keep(size_t n);
+
+    protected:
+        M & m_mesh;
+        CProperty<int> & m_label;
+        std::vector<CFace*> m_faces;
+        std::vector<size_t> m_first;
+        std::vector<CPointBounds> m_bounds;
+
+        /*! the root of a set, halving the path on the way */
+        static uint32_t _find(std::vector<std::atomic<uint32_t>> & parent, uint32_t x)
+        {
+            uint32_t p = parent[x].load(std::memory_order_relaxed);
+            while (p != x)
+            {
+                uint32_t gp = parent[p].load(std::memory_order_relaxed);
+                parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+                x = gp;
+                p = parent[x].load(std::memory_order_relaxed);
+            }
+            return x;
+        }
+        /*! join the sets of a and b, the larger root goes under the smaller one */
+        static void _unite(std::vector<std::atomic<uint32_t>> & parent, uint32_t a, uint32_t b)
+        {
+            while (true)
+            {
+                a = _find(parent, a);
+                b = _find(parent, b);
+                if (a == b) return;
+                if (a < b) std::swap(a, b);
+                uint32_t expected = a;
+                if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+            }
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    template<typename Joined>
+    size_t CComponents<M>::label(Joined joined, int threads)
+    {
+        // the sets are over the face slots, a slot of no face stays alone
+        const size_t slots = m_label.size();
+        std::vector<std::atomic<uint32_t>> parent(slots);
+        parallel_for(slots, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) parent[i].store((uint32_t)i, std::memory_order_relaxed);
+        });
+        m_mesh.parallel_for_edges([&](CEdge * e)
+        {
+            CHalfEdge * h0 = e->halfedge(0);
+            CHalfEdge * h1 = e->halfedge(1);
+            if (h0 == NULL || h1 == NULL || !joined(e)) return;
+            _unite(parent, (uint32_t)h0->face()->property_index(), (uint32_t)h1->face()->property_index());
+        }, threads);
+
+        // the roots, then the components by their size, the largest first
+        const std::vector<CFace*> & faces = m_mesh.faces().data();
+        std::vector<uint32_t> root(faces.size());
+        parallel_for(faces.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) root[i] = faces[i] ? _find(parent, (uint32_t)faces[i]->property_index()) : UINT32_MAX;
+        });
+        std::vector<uint32_t> id(slots, UINT32_MAX);
+        std::vector<size_t> sizes;
+        for (uint32_t r : root)
+        {
+            if (r == UINT32_MAX) continue;
+            if (id[r] == UINT32_MAX)
+            {
+                id[r] = (uint32_t)sizes.size();
+                sizes.push_back(0);
+            }
+            sizes[id[r]]++;
+        }
+        std::vector<uint32_t> order(sizes.size());
+        for (size_t c = 0; c < order.size(); c++) order[c] = (uint32_t)c;
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+        std::vector<uint32_t> rank(sizes.size());
+        for (size_t c = 0; c < order.size(); c++) rank[order[c]] = (uint32_t)c;
+
+        // faces sorted by component, in list order within one
+        m_first.assign(sizes.size() + 1, 0);
+        for (size_t c = 0; c < order.size(); c++) m_first[c + 1] = m_first[c] + sizes[order[c]];
+        m_faces.resize(m_first.back());
+        std::vector<size_t> next(m_first.begin(), m_first.end() - 1);
+        for (size_t i = 0; i < faces.size(); i++)
+        {
+            if (root[i] == UINT32_MAX) continue;
+            const uint32_t c = rank[id[root[i]]];
+            m_label[faces[i]] = (int)c;
+            m_faces[next[c]++] = faces[i];
+        }
+
+        // every component is folded by one worker
+        m_bounds.assign(sizes.size(), CPointBounds());
+        parallel_for(m_bounds.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++)
+            {
+                for (size_t i = m_first[c]; i < m_first[c + 1]; i++)
+                {
+                    for (CHalfEdge * he : m_faces[i]->halfedges_range()) m_bounds[c].add(he->vertex()->point());
+                }
+            }
+        }, 64);
+        return m_bounds.size();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    size_t CComponents<M>::keep(size_t n)
+    {
+        if (n >= size()) return 0;
+        const size_t deleted = m_mesh.delete_faces([&](CFace * f) { return m_label[f] < 0 || m_label[f] >= (int)n; });
+        m_faces.resize(m_first[n]);
+        m_first.resize(n + 1);
+        m_bounds.resize(n);
+        return deleted;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,327 @@
+/*!
+*      \file curvature.h
+*      \brief Discrete curvatures of the vertices of a mesh
+*
+*      Gaussian curvature is the angle defect, mean curvature the length of
+*      the cotangent Laplacian of the points, both over the mixed Voronoi area
+*      of Meyer et al. The principal curvatures follow from the two, their
+*      directions are those of the quadratic form fitted to the normal
+*      curvatures along the edges by least squares. Every triangle computes
+*      the terms of its corners in parallel, then every vertex sums those of
+*      its corners, so no two threads write the same value. The results are
+*      arrays by vertex row, laid out once per connectivity.
+*/
+
+#ifndef _MESHLIB_CURVATURE_H_
+#define _MESHLIB_CURVATURE_H_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "mesh.h"
+#include "derived.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CCurvature class, curvatures by vertex in arrays
+     *
+     *  Polygons are fanned into triangles. The normal points to the side the
+     *  faces are oriented towards, mean curvature is positive where the
+     *  surface bends away from it, on a sphere with outward faces say. A
+     *  boundary vertex has the defect to pi, its mean and principal
+     *  curvatures and directions are 0.
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CCurvature
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        CCurvature(M & mesh) : m_mesh(mesh) {}
+
+        /*!
+         *  Compute the curvatures of the current points, the layout is redone if the connectivity changed,
+         *  nothing is if the points did not move since the last call, see CBaseMesh::geometry_version
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void compute(int threads = 0);
+
+        /*! number of vertices, the length of every array */
+        size_t size() const { return m_vertices.size(); }
+        /*! the vertex of row i, and the row of a vertex */
+        CVertex * vertex(size_t i) const { return m_vertices[i]; }
+        int row(CVertex * v) const { return m_row[v->property_index()]; }
+
+        /*! the angle defect, its integral over the area */
+        const std::vector<double> & angle_defect() const { return m_defect; }
+        /*! the mixed Voronoi area */
+        const std::vector<double> & area() const { return m_area; }
+        const std::vector<double> & gaussian() const { return m_gaussian; }
+        const std::vector<double> & mean() const { return m_mean; }
+        /*! the principal curvatures, k1 >= k2 */
+        const std::vector<double> & k1() const { return m_k1; }
+        const std::vector<double> & k2() const { return m_k2; }
+        /*! unit directions of k1 and k2, and the area weighted normal */
+        const std::vector<CPoint> & direction1() const { return m_direction1; }
+        const std::vector<CPoint> & direction2() const { return m_direction2; }
+        const std::vector<CPoint> & normal() const { return m_normal; }
+
+    protected:
+        M & m_mesh;
+        size_t m_version = 0;
+        bool m_built = false;
+        //! the mesh as the curvatures were last computed
+        CVersionStamp m_computed;
+
+        std::vector<CVertex*> m_vertices;
+        std::vector<int> m_row;
+        std::vector<char> m_boundary;
+        //! rows of the corners of the triangles, and the corners of row i at [m_corner_outer[i], m_corner_outer[i + 1])
+        std::vector<int> m_tris;
+        std::vector<int> m_corner_outer;
+        std::vector<int> m_corners;
+
+        std::vector<CPoint> m_points;
+        //! by corner, its angle, area, part of the Laplacian, and by triangle twice its area along its normal
+        std::vector<double> m_corner_angle;
+        std::vector<double> m_corner_area;
+        std::vector<CPoint> m_corner_laplacian;
+        std::vector<CPoint> m_tri_normal;
+
+        std::vector<double> m_defect, m_area, m_gaussian, m_mean, m_k1, m_k2;
+        std::vector<CPoint> m_direction1, m_direction2, m_normal;
+
+        void _build();
+        /*! angles, cotangents and areas of the corners of triangle t */
+        void _triangle(size_t t);
+        /*! sum the corners of row i */
+        void _vertex(size_t i);
+        /*! fit the quadratic form of the normal curvature at row i, its eigenvectors are the principal directions */
+        void _directions(size_t i);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CCurvature<M>::_build()
+    {
+        m_vertices.clear();
+        size_t slots = 0;
+        for (CVertex * v : m_mesh.vertices())
+        {
+            m_vertices.push_back(v);
+            slots = std::max(slots, v->property_index() + 1);
+        }
+        const size_t n = m_vertices.size();
+        m_row.assign(slots, -1);
+        m_boundary.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            m_row[m_vertices[i]->property_index()] = (int)i;
+            m_boundary[i] = m_vertices[i]->boundary() ? 1 : 0;
+        }
+
+        m_tris.clear();
+        for (CFace * f : m_mesh.faces())
+        {
+            CHalfEdge * first = f->halfedge();
+            const int a = row(first->source());
+            for (CHalfEdge * he = first->next(); he->next() != first; he = he->next())
+            {
+                m_tris.push_back(a);
+                m_tris.push_back(row(he->source()));
+                m_tris.push_back(row(he->target()));
+            }
+        }
+
+        m_corner_outer.assign(n + 1, 0);
+        for (int r : m_tris) m_corner_outer[r + 1]++;
+        for (size_t i = 0; i < n; i++) m_corner_outer[i + 1] += m_corner_outer[i];
+        std::vector<int> fill(m_corner_outer.begin(), m_corner_outer.end() - 1);
+        m_corners.resize(m_tris.size());
+        for (size_t c = 0; c < m_tris.size(); c++) m_corners[fill[m_tris[c]]++] = (int)c;
+
+        const size_t nc = m_tris.size();
+        m_corner_angle.resize(nc);
+        m_corner_area.resize(nc);
+        m_corner_laplacian.resize(nc);
+        m_tri_normal.resize(nc / 3);
+        for (std::vector<double> * a : { &m_defect, &m_area, &m_gaussian, &m_mean, &m_k1, &m_k2 }) a->assign(n, 0.0);
+        for (std::vector<CPoint> * a : { &m_direction1, &m_direction2, &m_normal }) a->assign(n, CPoint(0, 0, 0));
+
+        m_version = m_mesh.topology_version();
+        m_built = true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CCurvature<M>::compute(int threads)
+    {
+        if (!m_built || m_version != m_mesh.topology_version()) _build();
+        if (!m_computed.stale(m_mesh)) return;
+        const size_t n = size();
+
+        m_points.resize(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) m_points[i] = m_vertices[i]->point();
+        });
+        parallel_for(m_tri_normal.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++) _triangle(t);
+        });
+        // the normals are needed around a vertex for its directions
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) _vertex(i);
+        });
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) _directions(i);
+        });
+        m_computed.take(m_mesh);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CCurvature<M>::_triangle(size_t t)
+    {
+        const int * r = &m_tris[3 * t];
+        const CPoint p[3] = { m_points[r[0]], m_points[r[1]], m_points[r[2]] };
+        const CPoint normal = (p[1] - p[0]) ^ (p[2] - p[0]);
+        const double area = normal.norm() / 2;
+        m_tri_normal[t] = normal;
+
+        double angle[3], cot[3];
+        for (int c = 0; c < 3; c++)
+        {
+            const CPoint u = p[(c + 1) % 3] - p[c], v = p[(c + 2) % 3] - p[c];
+            const double s = (u ^ v).norm(), d = u * v;
+            angle[c] = atan2(s, d);
+            // a degenerate triangle adds no cotangents rather than infinite ones
+            cot[c] = s > 0 ? d / s : 0;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            const int j = (c + 1) % 3, k = (c + 2) % 3;
+            const CPoint ej = p[c] - p[j], ek = p[c] - p[k];
+            m_corner_angle[3 * t + c] = angle[c];
+            m_corner_laplacian[3 * t + c] = ej * cot[k] + ek * cot[j];
+
+            // the Voronoi part of the corner, or a share of an obtuse triangle
+            double a;
+            if (angle[c] > M_PI / 2) a = area / 2;
+            else if (angle[j] > M_PI / 2 || angle[k] > M_PI / 2) a = area / 4;
+            else a = ((ek * ek) * cot[j] + (ej * ej) * cot[k]) / 8;
+            m_corner_area[3 * t + c] = a;
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CCurvature<M>::_vertex(size_t i)
+    {
+        double angle = 0, area = 0;
+        CPoint laplacian(0, 0, 0), normal(0, 0, 0);
+        for (int k = m_corner_outer[i]; k < m_corner_outer[i + 1]; k++)
+        {
+            const int c = m_corners[k];
+            angle += m_corner_angle[c];
+            area += m_corner_area[c];
+            laplacian += m_corner_laplacian[c];
+            normal += m_tri_normal[c / 3];
+        }
+        const double len = normal.norm();
+        m_normal[i] = len > 0 ? normal / len : CPoint(0, 0, 0);
+        m_area[i] = area;
+        m_defect[i] = (m_boundary[i] ? M_PI : 2 * M_PI) - angle;
+        m_gaussian[i] = area > 0 ? m_defect[i] / area : 0;
+
+        if (m_boundary[i] || area <= 0)
+        {
+            m_mean[i] = m_k1[i] = m_k2[i] = 0;
+            return;
+        }
+        // the Laplacian is 4 H A along the normal
+        const double h = laplacian.norm() / (4 * area);
+        m_mean[i] = laplacian * m_normal[i] < 0 ? -h : h;
+        const double d = sqrt(std::max(0.0, m_mean[i] * m_mean[i] - m_gaussian[i]));
+        m_k1[i] = m_mean[i] + d;
+        m_k2[i] = m_mean[i] - d;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CCurvature<M>::_directions(size_t i)
+    {
+        m_direction1[i] = m_direction2[i] = CPoint(0, 0, 0);
+        const CPoint & n = m_normal[i];
+        if (m_boundary[i] || n.norm() == 0) return;
+
+        // a frame of the tangent plane
+        const CPoint axis = fabs(n[0]) < 0.9 ? CPoint(1, 0, 0) : CPoint(0, 1, 0);
+        CPoint t1 = axis - n * (axis * n);
+        t1 /= t1.norm();
+        const CPoint t2 = n ^ t1;
+
+        // k(x, y) = a x^2 + 2 b xy + c y^2 fitted to the normal curvature along every edge, in its
+        // direction in the tangent plane and weighted by the area of its triangle, as Euler's formula
+        double lhs[3][3] = { { 0 } }, rhs[3] = { 0 };
+        const CPoint & p = m_points[i];
+        for (int k = m_corner_outer[i]; k < m_corner_outer[i + 1]; k++)
+        {
+            const int corner = m_corners[k];
+            const int * r = &m_tris[3 * (corner / 3)];
+            const double w = m_tri_normal[corner / 3].norm();
+            for (int s = 1; s < 3; s++)
+            {
+                const CPoint e = m_points[r[(corner % 3 + s) % 3]] - p;
+                const double ee = e * e;
+                const CPoint d = e - n * (e * n);
+                const double dd = d.norm();
+                if (ee <= 0 || dd <= 0) continue;
+                const double kappa = -2 * (n * e) / ee;
+                const double x = (d * t1) / dd, y = (d * t2) / dd;
+                const double phi[3] = { x * x, 2 * x * y, y * y };
+                for (int u = 0; u < 3; u++)
+                {
+                    for (int v = 0; v < 3; v++) lhs[u][v] += w * phi[u] * phi[v];
+                    rhs[u] += w * kappa * phi[u];
+                }
+            }
+        }
+
+        // Cramer's rule, the edges of a vertex with fewer than three directions leave it singular
+        auto det = [](const double m[3][3])
+        {
+            return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                 + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        };
+        const double d = det(lhs);
+        const double trace = lhs[0][0] + lhs[1][1] + lhs[2][2];
+        if (!(fabs(d) > 1e-12 * trace * trace * trace)) return;
+        double form[3];
+        for (int u = 0; u < 3; u++)
+        {
+            double m[3][3];
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++) m[r][c] = c == u ? rhs[r] : lhs[r][c];
+            form[u] = det(m) / d;
+        }
+
+        // the eigenvector of the larger eigenvalue of the form
+        const double phi = atan2(2 * form[1], form[0] - form[2]) / 2;
+        m_direction1[i] = t1 * cos(phi) + t2 * sin(phi);
+        m_direction2[i] = n ^ m_direction1[i];
+    }
+
+}; //namespace
+
+#endif
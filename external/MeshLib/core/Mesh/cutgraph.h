@@ -0,0 +1,409 @@
+/*!
+*      \file cutgraph.h
+*      \brief Cut a mesh open into a topological disk along a cut graph
+*
+*      The harmonic and conformal maps need a disk. A spanning tree of the
+*      dual graph, grown breadth first over the face rows of CAdjacency, glues
+*      the faces into a disk, every edge it does not cross is cut. Pruning the
+*      dangling cut edges, those with an end no other cut or boundary edge
+*      meets, leaves the cut graph: 2g loops on a closed surface of genus g,
+*      with the paths that join the boundary loops of a surface with boundary.
+*      A closed sphere keeps the longest path of its tree, a slit to open.
+*
+*      The mesh is split along the cuts in bulk. The corners around a vertex
+*      are joined across the uncut edges by a union find, each of the sets is
+*      a vertex of the cut mesh, which is built from arrays at once instead of
+*      splitting edge by edge. Its boundary is then traced as a CBoundary.
+*/
+
+#ifndef _MESHLIB_CUTGRAPH_H_
+#define _MESHLIB_CUTGRAPH_H_
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+#include "mesh.h"
+#include "adjacency.h"
+#include "boundary.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CCutGraph class, cuts a mesh into a disk per connected component
+     *  \tparam V Vertex type
+     *  \tparam E Edge   type
+     *  \tparam F Face   type
+     *  \tparam H HalfEdge type
+     */
+    template<typename V, typename E, typename F, typename H, typename A = CBlockArena, typename P = CAllFields>
+    class CCutGraph
+    {
+    public:
+        using CMesh = CBaseMesh<V, E, F, H, A, P>;
+        using CVertex = typename CMesh::CVertex;
+        using CEdge = typename CMesh::CEdge;
+        using CFace = typename CMesh::CFace;
+        using CHalfEdge = typename CMesh::CHalfEdge;
+        using TBoundary = CBoundary<V, E, F, H, A, P>;
+
+        CCutGraph(CMesh * pMesh) : m_pMesh(pMesh), m_adjacency(*pMesh) {}
+
+        /*!
+         *  Find the cut graph and split the mesh along it, the mesh itself is not changed
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return false if the mesh has no faces
+         */
+        bool cut(int threads = 0);
+
+        /*! the cut edges, in the order of the edge list */
+        const std::vector<CEdge*> & edges() const { return m_edges; }
+        /*! whether e is cut */
+        bool is_cut(CEdge * e) const { return e->property_index() < m_cut.size() && m_cut[e->property_index()]; }
+
+        /*! the mesh cut open, face j is face j of the face list, vertex i + 1 a copy of origin of it */
+        CMesh * disk() { return m_disk.get(); }
+        /*! the vertex of the mesh a vertex of disk() is a copy of */
+        CVertex * origin(CVertex * v) const { return m_adjacency.vertex(m_origin[v->id() - 1]); }
+        /*! the boundary loops of disk(), the cuts on both sides and the boundary of the mesh */
+        TBoundary & boundary() { return *m_boundary; }
+
+    protected:
+        CMesh * m_pMesh;
+        CAdjacency<CMesh> m_adjacency;
+        //! 1 for the cut edges, by edge slot
+        std::vector<char> m_cut;
+        std::vector<CEdge*> m_edges;
+        //! the vertex row every vertex of the disk is a copy of
+        std::vector<int> m_origin;
+        std::unique_ptr<CMesh> m_disk;
+        std::unique_ptr<TBoundary> m_boundary;
+
+        /*! cut every edge the dual tree does not cross, the component of every face row into component */
+        void _tree(std::vector<int> & component, int threads);
+        /*! drop the dangling cut edges, but keep the longest path of a closed component without loops */
+        void _prune(const std::vector<int> & component, int threads);
+        /*! the vertex row farthest from v over the cut edges, incident by vertex row and ends by edge,
+            the rows before it on the way into from, the rows reached into queue */
+        static int _farthest(int v, const CAdjacencyRows & incident, const std::vector<int> & ends,
+            std::vector<int> & from, std::vector<int> & queue);
+        /*! the corners joined across the uncut edges into the vertices of the disk, built from arrays */
+        void _split(int threads);
+
+        /*! the root of a set, halving the path on the way */
+        static uint32_t _find(std::vector<std::atomic<uint32_t>> & parent, uint32_t x)
+        {
+            uint32_t p = parent[x].load(std::memory_order_relaxed);
+            while (p != x)
+            {
+                uint32_t gp = parent[p].load(std::memory_order_relaxed);
+                parent[x].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+                x = gp;
+                p = parent[x].load(std::memory_order_relaxed);
+            }
+            return x;
+        }
+        /*! join the sets of a and b, the larger root goes under the smaller one */
+        static void _unite(std::vector<std::atomic<uint32_t>> & parent, uint32_t a, uint32_t b)
+        {
+            while (true)
+            {
+                a = _find(parent, a);
+                b = _find(parent, b);
+                if (a == b) return;
+                if (a < b) std::swap(a, b);
+                uint32_t expected = a;
+                if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+            }
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CCutGraph<V, E, F, H, A, P>::cut(int threads)
+    {
+        MESHLIB_TRACE_ZONE("cutgraph.cut");
+        m_boundary.reset();
+        m_disk.reset();
+        m_adjacency.update(threads);
+        if (m_adjacency.num_faces() == 0) return false;
+
+        std::vector<int> component;
+        _tree(component, threads);
+        _prune(component, threads);
+        m_edges.clear();
+        for (CEdge * e : m_pMesh->edges())
+            if (m_cut[e->property_index()]) m_edges.push_back(e);
+
+        _split(threads);
+        m_boundary.reset(new TBoundary(m_disk.get()));
+        MESHLIB_COUNTER_ADD("cutgraph.edges", m_edges.size());
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CCutGraph<V, E, F, H, A, P>::_tree(std::vector<int> & component, int threads)
+    {
+        // breadth first over the face rows, from the first face of every component
+        const CAdjacencyRows & ff = m_adjacency.face_faces();
+        const int nf = (int)m_adjacency.num_faces();
+        std::vector<int> parent(nf, -1), queue;
+        component.assign(nf, -1);
+        queue.reserve(nf);
+        int components = 0;
+        for (int root = 0; root < nf; root++)
+        {
+            if (component[root] >= 0) continue;
+            component[root] = components;
+            size_t head = queue.size();
+            queue.push_back(root);
+            while (head < queue.size())
+            {
+                const int f = queue[head++];
+                for (const int * g = ff.begin(f); g != ff.end(f); g++)
+                {
+                    if (component[*g] >= 0) continue;
+                    component[*g] = components;
+                    parent[*g] = f;
+                    queue.push_back(*g);
+                }
+            }
+            components++;
+        }
+
+        // every interior edge is cut but the one each face was reached across
+        size_t slots = 0;
+        for (CEdge * e : m_pMesh->edges()) slots = std::max(slots, e->property_index() + 1);
+        m_cut.assign(slots, 0);
+        for (CEdge * e : m_pMesh->edges()) m_cut[e->property_index()] = !e->boundary();
+        parallel_for((size_t)nf, threads, [&](size_t b, size_t e)
+        {
+            for (size_t g = b; g < e; g++)
+            {
+                if (parent[g] < 0) continue;
+                for (CHalfEdge * he : m_adjacency.face(g)->halfedges_range())
+                {
+                    CHalfEdge * d = he->dual();
+                    if (d == NULL || m_adjacency.row(d->face()) != parent[g]) continue;
+                    m_cut[he->edge()->property_index()] = 0;
+                    break;
+                }
+            }
+        });
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    int CCutGraph<V, E, F, H, A, P>::_farthest(int v, const CAdjacencyRows & incident, const std::vector<int> & ends,
+        std::vector<int> & from, std::vector<int> & queue)
+    {
+        queue.assign(1, v);
+        from[v] = v;
+        for (size_t head = 0; head < queue.size(); head++)
+        {
+            const int u = queue[head];
+            for (const int * k = incident.begin(u); k != incident.end(u); k++)
+            {
+                const int w = ends[2 * *k] ^ ends[2 * *k + 1] ^ u;
+                if (from[w] >= 0) continue;
+                from[w] = u;
+                queue.push_back(w);
+            }
+        }
+        return queue.back();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CCutGraph<V, E, F, H, A, P>::_prune(const std::vector<int> & component, int threads)
+    {
+        // the vertex rows at the ends of every edge, and the Euler characteristic of every component
+        const int nv = (int)m_adjacency.num_vertices();
+        const int components = *std::max_element(component.begin(), component.end()) + 1;
+        std::vector<CEdge*> edges;
+        edges.reserve(m_cut.size());
+        for (CEdge * e : m_pMesh->edges()) edges.push_back(e);
+        const size_t ne = edges.size();
+        std::vector<int> ends(2 * ne), edge_component(ne), vertex_component(nv, -1);
+        std::vector<char> boundary(ne);
+        parallel_for(ne, threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                CHalfEdge * he = edges[k]->halfedge(0);
+                ends[2 * k] = m_adjacency.row(he->source());
+                ends[2 * k + 1] = m_adjacency.row(he->target());
+                edge_component[k] = component[m_adjacency.row(he->face())];
+                boundary[k] = edges[k]->boundary();
+            }
+        });
+        const CAdjacencyRows & vf = m_adjacency.vertex_faces();
+        parallel_for((size_t)nv, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) if (vf.degree(i) > 0) vertex_component[i] = component[*vf.begin(i)];
+        });
+        std::vector<long long> euler(components, 0);
+        std::vector<char> open(components, 0);
+        for (int c : component) euler[c]++;
+        for (int c : vertex_component) if (c >= 0) euler[c]++;
+        for (size_t k = 0; k < ne; k++)
+        {
+            euler[edge_component[k]]--;
+            if (boundary[k]) open[edge_component[k]] = 1;
+        }
+
+        // the cut and boundary edges at every vertex, and the cut edges in rows by vertex
+        std::vector<int> degree(nv, 0);
+        CAdjacencyRows incident;
+        incident.outer.assign(nv + 1, 0);
+        for (size_t k = 0; k < ne; k++)
+        {
+            if (!boundary[k] && !m_cut[edges[k]->property_index()]) continue;
+            degree[ends[2 * k]]++;
+            degree[ends[2 * k + 1]]++;
+            if (boundary[k]) continue;
+            incident.outer[ends[2 * k] + 1]++;
+            incident.outer[ends[2 * k + 1] + 1]++;
+        }
+        for (int i = 0; i < nv; i++) incident.outer[i + 1] += incident.outer[i];
+        incident.inner.resize(incident.outer[nv]);
+        std::vector<int> fill(incident.outer.begin(), incident.outer.end() - 1);
+        for (size_t k = 0; k < ne; k++)
+        {
+            if (boundary[k] || !m_cut[edges[k]->property_index()]) continue;
+            incident.inner[fill[ends[2 * k]]++] = (int)k;
+            incident.inner[fill[ends[2 * k + 1]]++] = (int)k;
+        }
+
+        // a closed sphere has a tree of cuts and nothing would be left, the ends of its longest path stay
+        std::vector<char> kept(nv, 0), seen(components, 0);
+        std::vector<int> from(nv, -1), queue;
+        for (int i = 0; i < nv; i++)
+        {
+            const int c = vertex_component[i];
+            if (c < 0 || seen[c] || open[c] || euler[c] != 2) continue;
+            seen[c] = 1;
+            const int a = _farthest(i, incident, ends, from, queue);
+            for (int w : queue) from[w] = -1;
+            kept[a] = 1;
+            kept[_farthest(a, incident, ends, from, queue)] = 1;
+        }
+
+        queue.clear();
+        for (int i = 0; i < nv; i++) if (degree[i] == 1 && !kept[i]) queue.push_back(i);
+        while (!queue.empty())
+        {
+            const int v = queue.back();
+            queue.pop_back();
+            if (degree[v] != 1 || kept[v]) continue;
+            for (const int * k = incident.begin(v); k != incident.end(v); k++)
+            {
+                char & cut = m_cut[edges[*k]->property_index()];
+                if (!cut) continue;
+                cut = 0;
+                const int w = ends[2 * *k] ^ ends[2 * *k + 1] ^ v;
+                degree[v]--;
+                if (--degree[w] == 1 && !kept[w]) queue.push_back(w);
+                break;
+            }
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CCutGraph<V, E, F, H, A, P>::_split(int threads)
+    {
+        // the corners of the faces in the order of their halfedges, a halfedge names the corner at its target
+        const size_t nf = m_adjacency.num_faces();
+        std::vector<int> offsets(nf + 1, 0), corner_of;
+        size_t hslots = 0;
+        bool triangles = true;
+        for (size_t j = 0; j < nf; j++)
+        {
+            int n = 0;
+            for (CHalfEdge * he : m_adjacency.face(j)->halfedges_range())
+            {
+                hslots = std::max(hslots, he->property_index() + 1);
+                n++;
+            }
+            offsets[j + 1] = offsets[j] + n;
+            triangles = triangles && n == 3;
+        }
+        const size_t corners = offsets[nf];
+        std::vector<int> vertex(corners);
+        corner_of.assign(hslots, -1);
+        parallel_for(nf, threads, [&](size_t b, size_t e)
+        {
+            for (size_t j = b; j < e; j++)
+            {
+                int k = offsets[j];
+                for (CHalfEdge * he : m_adjacency.face(j)->halfedges_range())
+                {
+                    corner_of[he->property_index()] = k;
+                    vertex[k++] = m_adjacency.row(he->target());
+                }
+            }
+        });
+
+        // the two corners at each end of an uncut interior edge are one vertex of the disk
+        std::vector<CEdge*> edges;
+        edges.reserve(m_cut.size());
+        for (CEdge * e : m_pMesh->edges())
+            if (!e->boundary() && !m_cut[e->property_index()]) edges.push_back(e);
+        std::vector<std::atomic<uint32_t>> parent(corners);
+        parallel_for(corners, threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++) parent[c].store((uint32_t)c, std::memory_order_relaxed);
+        });
+        parallel_for(edges.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                CHalfEdge * h0 = edges[i]->halfedge(0);
+                CHalfEdge * h1 = edges[i]->halfedge(1);
+                _unite(parent, corner_of[h0->property_index()], corner_of[h1->prev()->property_index()]);
+                _unite(parent, corner_of[h0->prev()->property_index()], corner_of[h1->property_index()]);
+            }
+        });
+
+        // the first set of a vertex keeps its row, the others are numbered after all rows
+        const int nv = (int)m_adjacency.num_vertices();
+        std::vector<int> wedge(corners, -1), indices(corners);
+        std::vector<char> used(nv, 0);
+        m_origin.resize(nv);
+        for (int i = 0; i < nv; i++) m_origin[i] = i;
+        for (size_t c = 0; c < corners; c++)
+        {
+            const uint32_t r = _find(parent, (uint32_t)c);
+            if (wedge[r] < 0)
+            {
+                const int v = vertex[c];
+                if (!used[v]) wedge[r] = v;
+                else
+                {
+                    wedge[r] = (int)m_origin.size();
+                    m_origin.push_back(v);
+                }
+                used[v] = 1;
+            }
+            indices[c] = wedge[r];
+        }
+
+        std::vector<CPoint> points(m_origin.size());
+        parallel_for(points.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) points[i] = m_adjacency.vertex(m_origin[i])->point();
+        });
+        if (triangles) offsets.clear();
+        m_disk.reset(new CMesh());
+        m_disk->build_from_arrays(points, std::vector<CPoint2>(), std::vector<CPoint>(), indices, offsets, std::vector<int>(), std::vector<int>());
+    }
+
+}; //namespace
+
+#endif
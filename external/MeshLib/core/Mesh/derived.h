@@ -0,0 +1,99 @@
+/*!
+*      \file derived.h
+*      \brief Values computed from a mesh, computed again only after it changed
+*
+*      A mesh counts the changes of its connectivity, topology_version(), and
+*      of its points, geometry_version(). A value built on them, normals,
+*      bounds, a tree or a matrix, keeps the counts it was computed at and is
+*      computed again when it is asked for after they moved on, not every
+*      time and not never. A change of the connectivity makes every value
+*      stale, a move of the points only those that depend on them.
+*/
+
+#ifndef _MESHLIB_DERIVED_H_
+#define _MESHLIB_DERIVED_H_
+
+#include <cstddef>
+#include <utility>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CVersionStamp class, the versions of a mesh something was computed at
+     */
+    class CVersionStamp
+    {
+    public:
+        /*! what a value depends on */
+        enum Depends
+        {
+            TOPOLOGY = 1,  //!< the connectivity only
+            GEOMETRY = 3   //!< the connectivity and the points
+        };
+
+        /*! whether the mesh changed in what depends is on since take(), true before the first and for another mesh */
+        template<typename M>
+        bool stale(const M & mesh, Depends depends = GEOMETRY) const
+        {
+            return m_mesh != (const void *)&mesh || m_topology != mesh.topology_version() ||
+                (depends == GEOMETRY && m_geometry != mesh.geometry_version());
+        }
+        /*! the versions of the mesh now */
+        template<typename M>
+        void take(const M & mesh)
+        {
+            m_mesh = &mesh;
+            m_topology = mesh.topology_version();
+            m_geometry = mesh.geometry_version();
+        }
+        /*! stale from now on, whatever the mesh */
+        void clear() { m_mesh = NULL; }
+
+    protected:
+        const void * m_mesh = NULL;
+        size_t m_topology = 0;
+        size_t m_geometry = 0;
+    };
+
+    /*!
+     *  \brief CDerived class, a value computed from a mesh, kept while the mesh does not change
+     *  \tparam T the value
+     */
+    template<typename T>
+    class CDerived
+    {
+    public:
+        CDerived(CVersionStamp::Depends depends = CVersionStamp::GEOMETRY, T value = T()) : m_depends(depends), m_value(std::move(value)) {}
+
+        /*!
+         *  The value, compute(value) fills it in first if the mesh changed since the last time
+         *  \param mesh a CBaseMesh, the same one at every call
+         */
+        template<typename M, typename Compute>
+        T & get(const M & mesh, Compute compute)
+        {
+            if (m_stamp.stale(mesh, m_depends))
+            {
+                compute(m_value);
+                m_stamp.take(mesh);
+            }
+            return m_value;
+        }
+        /*! whether get() would compute the value */
+        template<typename M>
+        bool stale(const M & mesh) const { return m_stamp.stale(mesh, m_depends); }
+        /*! compute the value at the next get() */
+        void invalidate() { m_stamp.clear(); }
+        /*! the value as last computed */
+        T & value() { return m_value; }
+
+    protected:
+        CVersionStamp::Depends m_depends;
+        CVersionStamp m_stamp;
+        T m_value;
+    };
+
+}; //namespace
+
+#endif
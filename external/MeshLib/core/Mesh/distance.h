@@ -0,0 +1,147 @@
+/*!
+*      \file distance.h
+*      \brief The distance between two meshes, Hausdorff, mean and RMS, and per vertex
+*
+*      Both surfaces go into a CSurfaceDistance, polygons split into fans,
+*      and each is sampled by area against the tree of the other. The one
+*      sided results are kept apart, a simplified mesh is usually close to
+*      the original everywhere while the original has spots it misses, the
+*      Hausdorff distance is the larger of them. The vertices of the mesh
+*      also take their own distance to the other one, in a vertex property
+*      a viewer can map to colors.
+*/
+
+#ifndef _MESHLIB_MESH_DISTANCE_H_
+#define _MESHLIB_MESH_DISTANCE_H_
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "mesh.h"
+#include "derived.h"
+#include "../Geometry/SurfaceDistance.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshDistance class, how far a mesh is from another surface
+     *
+     *  The distance of every vertex to the other surface is in the vertex
+     *  property named at construction, "distance" by default.
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CMeshDistance
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        CMeshDistance(M & mesh, const std::string & name = "distance", int threads = 0)
+            : m_mesh(mesh), m_threads(threads), m_property(mesh.template add_vertex_property<double>(name, 0.0)) {}
+
+        /*!
+         *  Measure against another mesh, any CBaseMesh
+         *  \param samples samples on each surface, 0 for one per triangle and at least CSurfaceDistance::s_samples
+         */
+        template<typename R>
+        void measure(R & other, size_t samples = 0)
+        {
+            m_to._construct_faces(other.faces(), m_threads);
+            std::vector<const CPoint*> corners;
+            _fans(other, corners);
+            _measure(corners.size() / 3, [&corners](size_t t, int k) { return *corners[3 * t + k]; }, samples);
+        }
+
+        /*!
+         *  Measure against triangles
+         *  \param triangles number of triangles, corner(t, k) is corner k of triangle t as a CPoint
+         */
+        template<typename Corner>
+        void measure_triangles(size_t triangles, Corner corner, size_t samples = 0)
+        {
+            m_to._construct(triangles, corner, m_threads);
+            _measure(triangles, corner, samples);
+        }
+
+        /*! from this mesh to the other surface, its samples and its vertices, with the tree of the other surface */
+        const CSurfaceDistance & to() const { return m_to; }
+        /*! from the other surface to this mesh, with the tree of the mesh */
+        const CSurfaceDistance & from() const { return m_from; }
+        /*! the Hausdorff distance, the larger one sided one */
+        double hausdorff() const { return std::max(m_to.hausdorff(), m_from.hausdorff()); }
+
+        /*! the distance of a vertex to the other surface after measure() */
+        double distance(CVertex * v) const { return m_property[v]; }
+        /*! the largest distance of a vertex */
+        double max_vertex() const { return m_max_vertex; }
+
+    protected:
+        /* the corners of the fans of the faces, three per triangle */
+        template<typename R>
+        static void _fans(R & mesh, std::vector<const CPoint*> & corners)
+        {
+            for (auto * pf : mesh.faces())
+            {
+                auto * first = pf->halfedge();
+                auto * he = first->next();
+                while (he->next() != first)
+                {
+                    corners.push_back(&first->target()->point());
+                    corners.push_back(&he->target()->point());
+                    corners.push_back(&he->next()->target()->point());
+                    he = he->next();
+                }
+            }
+        }
+
+        template<typename Corner>
+        void _measure(size_t triangles, Corner corner, size_t samples);
+
+        M & m_mesh;
+        int m_threads;
+        CProperty<double> & m_property;
+        CSurfaceDistance m_to;
+        CSurfaceDistance m_from;
+        CVersionStamp m_from_stamp;
+        double m_max_vertex = 0;
+    };
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    Both ways, the mesh and its vertices against the tree of the other surface in m_to, the other surface against the tree of the mesh
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    template<typename M>
+    template<typename Corner>
+    inline void CMeshDistance<M>::_measure(size_t triangles, Corner corner, size_t samples)
+    {
+        std::vector<const CPoint*> corners;
+        _fans(m_mesh, corners);
+        m_to._measure(corners.size() / 3, [&corners](size_t t, int k) { return *corners[3 * t + k]; }, samples, m_threads);
+
+        std::vector<CVertex*> vertices(m_mesh.vertices().begin(), m_mesh.vertices().end());
+        std::vector<double> distance(vertices.size());
+        m_to._distances(vertices.size(), [&vertices](size_t i) { return vertices[i]->point(); }, distance.data(), m_threads);
+        m_max_vertex = 0;
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            m_property[vertices[i]] = distance[i];
+            m_max_vertex = std::max(m_max_vertex, distance[i]);
+        }
+
+        // the tree of the mesh stands while the mesh does not change, against one other surface after another
+        if (m_from_stamp.stale(m_mesh))
+        {
+            m_from._construct_faces(m_mesh.faces(), m_threads);
+            m_from_stamp.take(m_mesh);
+        }
+        m_from._measure(triangles, corner, samples, m_threads);
+    }
+
+}; //namespace
+
+#endif
@@ -1,8 +1,14 @@
 /*!
 *      \file DynamicMesh.h
-*      \brief Dynamic Mesh Class for edge swap, face split, edge split
+*      \brief Dynamic Mesh Class for edge swap, face split, edge split, edge collapse
 *
-*      Dynamic Mesh Class for edge swap, face split, edge split
+*      Dynamic Mesh Class for edge swap, face split, edge split, edge collapse
+*      Define MESHLIB_CHECK_TOPOLOGY to validate the faces around every edit,
+*      the first broken link is reported and aborts.
+*      Edits between beginEdit() and endEdit() form a step that undo() and
+*      redo() revert and apply again by relinking only what the step touched.
+*      trackChanges() collects the slots of the vertices and faces the edits
+*      touch, for copies laid out by slot such as GPU buffers.
 *      \author David Gu
 *      \date 10/07/2010
 *
@@ -13,10 +19,15 @@
 
 #include <map>
 #include <vector>
+#include <deque>
 #include <queue>
+#include <algorithm>
+#include <cstdlib>
 
 #include "mesh.h"
 #include "boundary.h"
+#include "editlog.h"
+#include "../Geometry/MeshSimplifier.h"
 
 
 namespace MeshLib
@@ -29,13 +40,14 @@ namespace MeshLib
     --------------------------------------------------------------------------------------------------------------------------------------*/
     /*! \brief CDynamicMesh class : Dynamic mesh
     *
-    *  Mesh supports FaceSlit, EdgeSlit, EdgeSwap operations
+    *  Mesh supports FaceSlit, EdgeSlit, EdgeSwap, EdgeCollapse operations
     */
-    template<typename V = CVertex, typename E = CEdge, typename F = CFace, typename H = CHalfEdge>
-    class CDynamicMesh : public CBaseMesh<V, E, F, H>
+    template<typename V = CVertex, typename E = CEdge, typename F = CFace, typename H = CHalfEdge, typename A = CBlockArena, typename P = CAllFields>
+    class CDynamicMesh : public CBaseMesh<V, E, F, H, A, P>
     {
+        static_assert(P::s_degree == 0 || P::s_degree == 3, "the operators make triangles, a mesh of other faces needs any degree");
     public:
-        using CMesh = CDynamicMesh<V, E, F, H>;
+        using CMesh = CDynamicMesh<V, E, F, H, A, P>;
         using CVertex = typename CDynamicMesh::CVertex;
         using CEdge = typename CDynamicMesh::CEdge;
         using CFace = typename CDynamicMesh::CFace;
@@ -43,11 +55,15 @@ namespace MeshLib
 
     public:
         /*! CDynamicMesh constructor */
-        CDynamicMesh() { m_vertex_id = 0; m_face_id = 0; };
-        CDynamicMesh(CBaseMesh<V,E,F,H> * mesh) : CBaseMesh<V,E,F,H>(*mesh)
+        CDynamicMesh() { m_vertex_id = 0; m_face_id = 0; m_ids = false; };
+        /*! a copy of mesh, every element in its slot through a checkpoint, see CBaseMesh::restore,
+            the members of V, E, F and H only if they are trivially copyable */
+        CDynamicMesh(CBaseMesh<V,E,F,H,A,P> * mesh)
         {
+            this->restore(*mesh->checkpoint());
             m_vertex_id = 0;
             m_face_id = 0;
+            m_ids = true;
 
             for (CVertex * v : mesh->vertices())
             {
@@ -80,7 +96,193 @@ namespace MeshLib
         */
         bool swapable(CEdge * edge);
 
+        /*! Add the triangle v0 v1 v2, ccw, over boundary edges running the other way or
+        * new edges, to close holes. It should share an edge with the mesh, the vertices
+        * of a triangle hanging by a vertex only are not told apart from pinched ones.
+        * The edges are indexed first if they are not
+        * \return the new face, NULL if an edge already has two faces or the same direction
+        */
+        CFace *    addTriangle(CVertex * v0, CVertex * v1, CVertex * v2);
+
+        /*! Flip edges until pred holds for none, the neighbors of a flipped edge are
+        * checked again. Blocks of vertices are flipped in parallel, each by one worker,
+        * the edge index is rebuilt at the end
+        * \param pred bool(CEdge*), whether to flip an interior edge, it has to settle as
+        * the Delaunay criterion does and may only read around the four vertices of the
+        * two faces of the edge
+        * \param threads number of threads, 0 uses all hardware threads
+        * \param block vertices per block
+        * \return number of flips
+        */
+        template<typename Pred>
+        size_t flipEdges(Pred pred, int threads = 0, size_t block = 1 << 14);
+
+        /*! Flip to a Delaunay triangulation, an edge flips when the two angles opposite
+        * to it sum to more than pi, see flipEdges
+        * \param eps tolerance on the sum of the cotangents of the two angles
+        * \return number of flips
+        */
+        size_t delaunayFlip(int threads = 0, double eps = 1e-12);
+
+        /*! Collapse an edge, its source vertex moves onto its target and is removed
+        * with the two faces of the edge
+        * \param pH halfedge of the edge, from the vertex that goes to the one that stays
+        * \return the vertex that stays, NULL if the edge is not collapsable
+        */
+        CVertex *  collapseEdge(CHalfEdge * pH);
+
+        /*! Test if an edge can be collapsed along a halfedge: the edge is interior
+        * between two triangles, its source is not on the boundary and the one ring
+        * neighbors shared by its ends are the tips of the two triangles only
+        * \param pH halfedge of the edge, from the vertex that would go
+        */
+        bool collapsable(CHalfEdge * pH);
+
+        /*! collapseEdge for batches of collapses: the removed elements stay allocated until
+        * sweep(), which takes them out of the lists in one pass. Meanwhile the removed
+        * vertex and edges have no halfedge, to tell them from the live ones. Within a
+        * step it is collapseEdge, the step keeps the removed elements
+        * \return the vertex that stays, NULL if the edge is not collapsable
+        */
+        CVertex *  collapseEdgeDeferred(CHalfEdge * pH);
+        /*! free the elements removed by collapseEdgeDeferred and index the edges again */
+        void sweep()
+        {
+            if (m_removed.vertices.empty()) return;
+            _sweep(m_removed);
+            this->_index_edges();
+        }
+
+        /*! Simplify a triangle mesh by quadric error edge collapses, see CMeshSimplifier
+        * \param ratio fraction of the faces to keep, 0.1 keeps a tenth
+        * \param threads number of threads for the setup, 0 uses all hardware threads
+        * \return number of faces left, unchanged if the mesh has other faces than triangles
+        */
+        int decimate(double ratio, int threads = 0);
+
+        //undoable steps
+        /*! Start a step, the edits until endEdit() are undone and redone as one. The
+        * steps that were undone can no longer be redone, an edit outside a step drops the
+        * history since it could not be undone over. Nested calls join the open step.
+        * Within a step flipEdges runs on one thread
+        */
+        void beginEdit();
+        /*! Close the step, undo() then reverts it. A step that changed nothing is dropped */
+        void endEdit();
+        /*! Revert the open step and drop it */
+        void cancelEdit();
+        /*! Call before moving v by hand: the open step keeps its point, the changes get it */
+        void editVertex(CVertex * v)
+        {
+            _check_history();
+            if (m_editing) _record_element(v);
+            _touch(v);
+            this->m_geometry_version++;
+        }
+        /*! Revert the last step
+        * 
+eturn false if there is none or a step is open
+        */
+        bool undo();
+        /*! Apply the last undone step again
+        * 
+eturn false if there is none or a step is open
+        */
+        bool redo();
+        bool canUndo() const { return !m_editing && m_done > 0; }
+        bool canRedo() const { return !m_editing && m_done < m_steps.size(); }
+        /*! keep at most this many steps to undo, 0 keeps all */
+        void setUndoLimit(size_t steps) { m_undo_limit = steps; _trim(); }
+        /*! drop the closed steps and free the elements they held */
+        void clearHistory();
+
+        /*! what the last endEdit(), cancelEdit(), undo() or redo() changed, to update
+        * copies of the mesh such as GPU buffers instead of rebuilding them */
+        struct CChange
+        {
+            /*! elements in the mesh that were relinked or moved */
+            std::vector<CVertex*> vertices;
+            std::vector<CFace*>   faces;
+            /*! elements put into the mesh */
+            std::vector<CVertex*> added_vertices;
+            std::vector<CFace*>   added_faces;
+            /*! elements taken out, they stay allocated as long as their step is kept */
+            std::vector<CVertex*> removed_vertices;
+            std::vector<CFace*>   removed_faces;
+        };
+        const CChange & lastChange() const { return m_change; }
+
+        //changes by slot, for copies of the mesh laid out by property_index() such as GPU buffers
+        /*! Collect the slots of the vertices and faces that the operators, undo and redo
+        * touch, create or remove, until takeChanges(). Turning it on maps the slots to the
+        * elements, see vertexAt()
+        */
+        void trackChanges(bool on);
+        /*! The slots touched since the last call, as sorted half open ranges
+        * \param gap ranges less than gap slots apart are merged, fewer and longer copies
+        */
+        void takeChanges(std::vector<std::pair<size_t, size_t>> & vertices, std::vector<std::pair<size_t, size_t>> & faces, size_t gap = 0);
+        /*! the vertex in a slot while changes are tracked, NULL if the slot is free */
+        CVertex * vertexAt(size_t slot) const { return slot < m_vertex_at.size() ? m_vertex_at[slot] : NULL; }
+        CFace *   faceAt(size_t slot) const { return slot < m_face_at.size() ? m_face_at[slot] : NULL; }
+        /*! one past the highest slot used so far, the length of a copy laid out by slot */
+        size_t vertexSlots() const { return m_vertex_at.size(); }
+        size_t faceSlots() const { return m_face_at.size(); }
+
     protected:
+        /*! the elements removed by collapses whose removal from the lists is deferred */
+        struct CRemoved
+        {
+            std::vector<CVertex*>   vertices;
+            std::vector<CEdge*>     edges;
+            std::vector<CFace*>     faces;
+            std::vector<CHalfEdge*> halfedges;
+        };
+        /*! collapseEdge, with `removed` the elements are only collected for _sweep */
+        CVertex *  _collapse(CHalfEdge * pH, CRemoved * removed);
+        /*! the elements of collapseEdgeDeferred */
+        CRemoved   m_removed;
+        /*! take the removed elements out of the lists in one pass each and free them */
+        void _sweep(CRemoved & removed);
+        template<typename T>
+        void _sweep(CElementList<T> & list, std::vector<T*> & gone)
+        {
+            if (gone.empty()) return;
+            std::sort(gone.begin(), gone.end());
+            list.remove_if([&](T * t)
+            {
+                if (!std::binary_search(gone.begin(), gone.end(), t)) return false;
+                this->_destroy(t);
+                return true;
+            });
+            gone.clear();
+        }
+        /*! the vertices of the two faces of an interior edge: its ends pv[0], pv[2]
+        * and the tips pv[1], pv[3], that become the ends once it is swapped */
+        void _quad(CEdge * edge, CVertex * pv[4]);
+        /*! whether v and w are joined by an edge, without allocating */
+        bool _adjacent(CVertex * v, CVertex * w);
+        /*! swapEdge without the edge index, it only writes the quad of the edge */
+        void _swap(CEdge * edge);
+        /*! whether the edge index is up to date, the split and swap operators then keep it so */
+        bool _indexed() { return this->m_edge_hash.size() == this->m_edges.size(); }
+        /*! add e to the edge index, under the ids of its current ends */
+        void _index(CEdge * e);
+        /*! take e out of the edge index, before its ends change */
+        void _unindex(CEdge * e);
+        /*! abort if the halfedges of the faces are not linked both ways, for MESHLIB_CHECK_TOPOLOGY
+        * \param op the operator, for the report
+        */
+        void _verify(const char * op, CFace * const * faces, int n);
+        /*! sorted one ring neighbors of v */
+        void _ring(CVertex * v, std::vector<CVertex*> & ring);
+        /*! the boundary flag of v from its faces, and its halfedge the most ccw in halfedge of the fan
+        * around the halfedge it has, which has to enter v */
+        void _relabel(CVertex * v);
+
+        std::vector<CVertex*>   m_ring[2];
+        std::vector<CHalfEdge*> m_incoming;
+
         /*! attach halfeges to an edge
         * \param he0, he1 the halfedges
         * \param e edge
@@ -90,27 +292,176 @@ namespace MeshLib
         int  m_vertex_id;
         /*! next face id */
         int  m_face_id;
+        /*! whether the two above are past the ids in use */
+        bool m_ids;
+        /*! set m_vertex_id and m_face_id from the elements, once, the mesh may have been read after construction */
+        void _scan_ids()
+        {
+            if (m_ids) return;
+            for (CVertex * v : this->vertices()) m_vertex_id = std::max(m_vertex_id, v->id());
+            for (CFace * f : this->faces()) m_face_id = std::max(m_face_id, f->id());
+            m_ids = true;
+        }
+
+        using CStep = CEditStep<CVertex, CEdge, CFace, CHalfEdge>;
+        /*! the first m_done steps are applied, the others were undone, an open step is the last */
+        std::deque<CStep> m_steps;
+        size_t m_done = 0;
+        /*! depth of the beginEdit calls not closed yet */
+        int    m_editing = 0;
+        size_t m_undo_limit = 0;
+        /*! the open step stamps the elements it recorded with 2 m_serial, those it created with 2 m_serial + 1 */
+        unsigned m_serial = 0;
+        CProperty<unsigned> * m_vertex_stamp = NULL;
+        CProperty<unsigned> * m_edge_stamp = NULL;
+        CProperty<unsigned> * m_face_stamp = NULL;
+        CProperty<unsigned> * m_halfedge_stamp = NULL;
+        unsigned & _stamp(CVertex * v) { return (*m_vertex_stamp)[v]; }
+        unsigned & _stamp(CEdge * e) { return (*m_edge_stamp)[e]; }
+        unsigned & _stamp(CFace * f) { return (*m_face_stamp)[f]; }
+        unsigned & _stamp(CHalfEdge * h) { return (*m_halfedge_stamp)[h]; }
+        /*! elements created and removed again in the open step, freed when it closes */
+        CRemoved m_gone;
+        CChange  m_change;
+
+        /*! an operator is about to edit, outside a step the history no longer fits the mesh */
+        void _check_history() { if (!m_editing && !m_steps.empty()) clearHistory(); }
+        /*! keep the links of an element in the open step, the first time it is met */
+        template<typename T>
+        void _record_element(T * t)
+        {
+            unsigned & stamp = _stamp(t);
+            if (stamp >= 2 * m_serial) return;
+            stamp = 2 * m_serial;
+            m_steps.back().record(t);
+        }
+        /*! in a step, record a face with its halfedges and their duals, edges and vertices, before an operator relinks them */
+        void _record(CFace * f)
+        {
+            if (!m_editing) return;
+            _record_element(f);
+            for (CHalfEdge * he : f->halfedges_range())
+            {
+                _record_element(he);
+                if (he->dual() != NULL) _record_element(he->dual());
+                _record_element(he->edge());
+                _record_element(he->vertex());
+            }
+        }
+        /*! in a step, an element an operator created */
+        template<typename T>
+        void _created(T * t)
+        {
+            if (!m_editing) return;
+            _stamp(t) = 2 * m_serial + 1;
+            m_steps.back().create(t);
+        }
+        /*! take an element out of its list for the open step, it stays allocated */
+        template<typename T>
+        void _retire(CElementList<T> & list, T * t, std::vector<T*> & gone)
+        {
+            list.remove(t);
+            if (_stamp(t) == 2 * m_serial + 1) gone.push_back(t);
+            else m_steps.back().remove(t);
+        }
+        /*! close the open step, free what it created and removed again */
+        void _seal();
+        /*! redo a closed step if forward, else undo it */
+        void _apply(CStep & step, bool forward);
+        /*! m_change from a step applied forward or backward */
+        void _describe(CStep & step, bool forward);
+        /*! free what a dropped step holds, the removed elements if it is applied, else the created ones */
+        void _drop(CStep & step, bool applied);
+        /*! drop the oldest steps beyond the limit */
+        void _trim();
+        template<typename T>
+        void _free(std::vector<T*> & ts)
+        {
+            for (T * t : ts) this->_destroy(t);
+            ts.clear();
+        }
+        bool m_tracking = false;
+        /*! the elements by slot, and the slots touched since takeChanges */
+        std::vector<CVertex*> m_vertex_at;
+        std::vector<CFace*>   m_face_at;
+        std::vector<size_t>   m_touched_vertices;
+        std::vector<size_t>   m_touched_faces;
+        /*! while tracking, an element the operators changed or created, or removed from its slot */
+        void _touch(CVertex * v, bool removed = false) { if (m_tracking) _touch(m_vertex_at, m_touched_vertices, v, removed); }
+        void _touch(CFace * f, bool removed = false) { if (m_tracking) _touch(m_face_at, m_touched_faces, f, removed); }
+        template<typename T>
+        static void _touch(std::vector<T*> & at, std::vector<size_t> & touched, T * t, bool removed)
+        {
+            const size_t slot = t->property_index();
+            if (slot >= at.size()) at.resize(slot + 1, NULL);
+            at[slot] = removed ? NULL : t;
+            touched.push_back(slot);
+        }
+        /*! while tracking, the two faces of an edge and their vertices */
+        void _touch(CEdge * e)
+        {
+            if (!m_tracking) return;
+            for (int k = 0; k < 2; k++)
+            {
+                CHalfEdge * he = e->halfedge(k);
+                if (he == NULL) continue;
+                _touch(he->face());
+                for (CHalfEdge * fh : he->face()->halfedges_range()) _touch(fh->vertex());
+            }
+        }
+        /*! sorted slots into ranges, closer than gap merged */
+        static void _ranges(std::vector<size_t> & slots, std::vector<std::pair<size_t, size_t>> & ranges, size_t gap);
+
+        /*! take the elements out of the list and put the others in */
+        template<typename T>
+        static void _relist(CElementList<T> & list, const std::vector<T*> & out, const std::vector<T*> & in)
+        {
+            if (out.size() < 16)
+            {
+                for (T * t : out) list.remove(t);
+            }
+            else
+            {
+                std::vector<T*> sorted(out);
+                std::sort(sorted.begin(), sorted.end());
+                list.remove_if([&](T * t) { return std::binary_search(sorted.begin(), sorted.end(), t); });
+            }
+            for (T * t : in) list.push_back(t);
+        }
     };
 
     /*---------------------------------------------------------------------------*/
-    template<typename V, typename E, typename F, typename H>
-    CDynamicMesh<V, E, F, H>::~CDynamicMesh()
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    CDynamicMesh<V, E, F, H, A, P>::~CDynamicMesh()
     {
+        // the elements out of the lists are only held by the steps
+        if (m_editing)
+        {
+            m_editing = 0;
+            _seal();
+            m_done++;
+        }
+        clearHistory();
     }
 
 
     /*---------------------------------------------------------------------------*/
 
     //insert a vertex in the center of a face, split the face to 3 faces
-    template<typename V, typename E, typename F, typename H>
-    typename CDynamicMesh<V, E, F, H>::CVertex * CDynamicMesh<V,E,F,H>::splitFace(typename CDynamicMesh<V, E, F, H>::CFace * pFace)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    typename CDynamicMesh<V, E, F, H, A, P>::CVertex * CDynamicMesh<V,E,F,H,A,P>::splitFace(typename CDynamicMesh<V, E, F, H, A, P>::CFace * pFace)
     {
 
+        const bool indexed = _indexed();
+        _check_history();
+        _record(pFace);
+        _scan_ids();
         CVertex * pV = this->create_vertex(++m_vertex_id);
 
         CVertex   *  v[3];
         CHalfEdge *  h[3];
         CHalfEdge *  hs[3];
+        CFace     *  fs[3] = { pFace, NULL, NULL };
 
         CEdge     *  eg[3];
 
@@ -126,16 +477,17 @@ namespace MeshLib
         }
 
 
-        CFace * f = new CFace();
+        CFace * f = this->template _create<CFace>();
         assert(f != NULL);
         f->id() = ++m_face_id;
         this->m_faces.push_back(f);
+        fs[1] = f;
 
         //create halfedges
         CHalfEdge * hes[3];
         for (int i = 0; i < 3; i++)
         {
-            hes[i] = new CHalfEdge();
+            hes[i] = this->template _create<CHalfEdge>();
             assert(hes[i]);
         }
 
@@ -154,17 +506,18 @@ namespace MeshLib
         }
 
 
-        f = new CFace();
+        f = this->template _create<CFace>();
         assert(f != NULL);
         f->id() = ++m_face_id;
         this->m_faces.push_back(f);
+        fs[2] = f;
 
         //create halfedges
         CHalfEdge * hes2[3];
 
         for (int i = 0; i < 3; i++)
         {
-            hes2[i] = new CHalfEdge;
+            hes2[i] = this->template _create<CHalfEdge>();
             assert(hes2[i]);
         }
 
@@ -185,7 +538,7 @@ namespace MeshLib
         CEdge * e[3];
         for (int i = 0; i < 3; i++)
         {
-            e[i] = new CEdge();
+            e[i] = this->template _create<CEdge>();
             assert(e[i]);
             this->m_edges.push_back(e[i]);
         }
@@ -213,31 +566,121 @@ namespace MeshLib
         hes2[1]->vertex() = v[1];
         hes2[2]->vertex() = v[2];
 
+        v[0]->halfedge() = h[0];
+        v[1]->halfedge() = hes[1];
+        v[2]->halfedge() = hes2[2];
+        for (int i = 0; i < 3; i++) v[i]->clear_adjacency();
+        pFace->clear_adjacency();
+
+        _touch(pV);
         for (int i = 0; i < 3; i++)
         {
-            v[i]->halfedge() = hs[i]->dual();
+            _touch(v[i]);
+            _touch(fs[i]);
         }
+        if (m_editing)
+        {
+            _created(pV);
+            for (int i = 1; i < 3; i++) _created(fs[i]);
+            for (int i = 0; i < 3; i++)
+            {
+                _created(hes[i]);
+                _created(hes2[i]);
+                _created(e[i]);
+            }
+        }
+
+        // the old edges keep their ends
+        if (indexed)
+        {
+            for (int i = 0; i < 3; i++) _index(e[i]);
+        }
+#ifdef MESHLIB_CHECK_TOPOLOGY
+        _verify("SplitFace", fs, 3);
+#endif
         return pV;
 
     };
 
-    template<typename V, typename E, typename F, typename H>
-    void CDynamicMesh<V, E, F, H>::swapEdge(CEdge * edge)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::swapEdge(CEdge * edge)
     {
+        if (edge->halfedge(1) == NULL)  return;
+
+#ifdef MESHLIB_CHECK_TOPOLOGY
+        CVertex * pv[4];
+        _quad(edge, pv);
+        if (_adjacent(pv[1], pv[3]))
+        {
+            std::cout << "DynamicMesh::SwapEdge::Warning Two edges share same both end vertices" << std::endl;
+        }
+#endif
+
+        // the edge gets new end vertices
+        _check_history();
+        const bool indexed = _indexed();
+        if (indexed) _unindex(edge);
+        _swap(edge);
+        this->m_topology_version++;
+        if (indexed) _index(edge);
+        _touch(edge);
+#ifdef MESHLIB_CHECK_TOPOLOGY
+        CFace * faces[2] = { edge->halfedge(0)->face(), edge->halfedge(1)->face() };
+        _verify("SwapEdge", faces, 2);
+#endif
+    };
 
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDynamicMesh<V,E,F,H,A,P>::swapable(typename CDynamicMesh<V, E, F, H, A, P>::CEdge * edge)
+    {
+        if (edge->halfedge(1) == NULL)  return false;
+
+        // the other diagonal of the quad must not be an edge already
+        CVertex * pv[4];
+        _quad(edge, pv);
+        return pv[1] != pv[3] && !_adjacent(pv[1], pv[3]);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_quad(typename CDynamicMesh<V, E, F, H, A, P>::CEdge * edge, CVertex * pv[4])
+    {
         CHalfEdge * he_left = edge->halfedge(0);
         CHalfEdge * he_right = edge->halfedge(1);
 
-        if (he_right == NULL)  return;
+        pv[0] = he_left->target();
+        pv[1] = he_left->next()->target();
+        pv[2] = he_left->next()->next()->target();
+        pv[3] = he_right->next()->target();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDynamicMesh<V, E, F, H, A, P>::_adjacent(typename CDynamicMesh<V, E, F, H, A, P>::CVertex * v, typename CDynamicMesh<V, E, F, H, A, P>::CVertex * w)
+    {
+        for (CVertex * u : v->vertices_range())
+        {
+            if (u == w) return true;
+        }
+        return false;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    //relink the two faces of an interior edge to its other diagonal, touches nothing outside the quad
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_swap(typename CDynamicMesh<V, E, F, H, A, P>::CEdge * edge)
+    {
+        _record(edge->halfedge(0)->face());
+        _record(edge->halfedge(1)->face());
 
         CHalfEdge * ph[6];
 
-        ph[0] = he_left;
+        ph[0] = edge->halfedge(0);
         ph[1] = ph[0]->next();
         ph[2] = ph[1]->next();
 
-
-        ph[3] = he_right;
+        ph[3] = edge->halfedge(1);
         ph[4] = ph[3]->next();
         ph[5] = ph[4]->next();
 
@@ -268,31 +711,6 @@ namespace MeshLib
             }
         }
 
-
-        //remove edge from edge list of the original vertex
-        CVertex * vb = (pv[0]->id() < pv[2]->id()) ? pv[0] : pv[2];
-        std::list<CEdge*> & ledges = (std::list<CEdge*> &) vb->edges();
-
-        //add edge to the edge list of the new vertex
-        CVertex * wb = (pv[1]->id() < pv[3]->id()) ? pv[1] : pv[3];
-        std::list<CEdge*> & wedges = (std::list<CEdge*> &) wb->edges();
-
-        for (typename std::list<CEdge*>::iterator eiter = wedges.begin(); eiter != wedges.end(); eiter++)
-        {
-            CEdge * pE = *eiter;
-
-            CVertex * v1 = pE->vertex1();
-            CVertex * v2 = pE->vertex2();
-
-            if ((v1 == pv[0] && v2 == pv[2]) || (v1 == pv[2]) && (v2 == pv[0]))
-            {
-                std::cout << "DynamicMesh::SwapEdge::Warning Two edges share same both end vertices" << std::endl;
-                //return;
-            }
-        }
-
-
-
         //relink the vertices
 
         ph[0]->target() = pv[1];
@@ -309,7 +727,6 @@ namespace MeshLib
             v->halfedge() = h;
         }
 
-
         //relink the edge-halfedge pointers
 
         ph[1]->edge() = pe[2];
@@ -324,170 +741,145 @@ namespace MeshLib
         ph[5]->edge() = pe[1];
         pe[1]->halfedge(pi[1]) = ph[5];
 
-
-
-        //remove edge from edge list of the original vertex
-        typename std::list<CEdge*>::iterator pos = ledges.end();
-        for (typename std::list<CEdge*>::iterator eiter = ledges.begin(); eiter != ledges.end(); eiter++)
-        {
-            CEdge * pE = *eiter;
-            if (pE == edge)
-            {
-                pos = eiter;
-                break;
-            }
-        }
-
-        if (pos == ledges.end())
-        {
-            std::cout << "Error" << std::endl;
-        }
-
-        if (pos != ledges.end())
-            ledges.erase(pos);
-
-        //add edge to the edge list of the new vertex
-        wedges.push_back(edge);
-
-        for (int i = 0; i < 6; i++)
-        {
-            CHalfEdge * he = ph[i];
-            CHalfEdge * sh = he->dual();
-            assert(he->target() == sh->prev()->target());
-            assert(he->prev()->target() == sh->target());
-        }
-
-        /*
-          for(int i = 0; i < 6; i ++ )
-          {
-              CHalfEdge * he = ph[i];
-              CEdge     * pe = halfedgeEdge( he );
-              CVertex   * v1 = edgeVertex1( pe );
-              CVertex   * v2 = edgeVertex2( pe );
-              CEdge     * we = vertexEdge( v1, v2 );
-              if( pe != we )
-              {
-                  std::cout << "Error" << std::endl;
-
-                  for( int j = 0; j < 4; j ++ )
-                  {
-                      std::cout << pv[j]->id() << " ";
-                  }
-                  std::cout << std::endl;
-
-                  for( std::list<CEdge*>::iterator eiter = ledges.begin(); eiter != ledges.end(); eiter ++ )
-                  {
-                      CEdge * e = *eiter;
-                      CVertex * v1 = edgeVertex1( e );
-                      CVertex * v2 = edgeVertex2( e );
-                      std::cout << "(" << v1->id() << "," << v2->id() <<")" << std::endl;
-                  }
-
-                  std::cout << " Edge list " << std::endl;
-
-                  for( std::list<CEdge*>::iterator eiter = wedges.begin(); eiter != wedges.end(); eiter ++ )
-                  {
-                      CEdge * e = *eiter;
-                      CVertex * v1 = edgeVertex1( e );
-                      CVertex * v2 = edgeVertex2( e );
-                      std::cout << "(" << v1->id() << "," << v2->id() <<")" << std::endl;
-                  }
-
-                  write_m("test.m");
-              }
-              assert( pe == we );
-          }
-
-          static int id = 0;
-          char name[1024];
-          sprintf(name,"temp_%d.m", id++);
-
-          write_m( name );
-
-          */
-
+        for (int i = 0; i < 4; i++) pv[i]->clear_adjacency();
+        ph[0]->face()->clear_adjacency();
+        ph[3]->face()->clear_adjacency();
     };
 
     /*---------------------------------------------------------------------------*/
-    template<typename V, typename E, typename F, typename H>
-    bool CDynamicMesh<V,E,F,H>::swapable(typename CDynamicMesh<V, E, F, H>::CEdge * edge)
+    //the vertex slots are cut into blocks, mesh order keeps a block mostly in one piece of the
+    //surface. A worker flips, Lawson style, the edges whose quads lie in its block: it alone
+    //writes the faces around the vertices of the block, so the workers need no locks. Edges
+    //across blocks wait for the next round, whose blocks are shifted by half a block.
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    template<typename Pred>
+    size_t CDynamicMesh<V, E, F, H, A, P>::flipEdges(Pred pred, int threads, size_t block)
     {
+        // a step records the flips one after the other
+        _check_history();
+        if (m_editing) threads = 1;
 
-        CHalfEdge * he_left = edge->halfedge(0);
-        CHalfEdge * he_right = edge->halfedge(1);
-
-        if (he_right == NULL)  return false;
+        size_t slots = 0;
+        for (CVertex * v : this->vertices()) slots = std::max(slots, v->property_index() + 1);
+        block = std::max<size_t>(block, 1);
 
-        CHalfEdge * ph[6];
+        std::vector<CEdge*> todo;
+        for (CEdge * e : this->edges()) todo.push_back(e);
 
-        ph[0] = he_left;
-        ph[1] = ph[0]->next();
-        ph[2] = ph[1]->next();
+        this->drop_edge_index();
 
-
-        ph[3] = he_right;
-        ph[4] = ph[3]->next();
-        ph[5] = ph[4]->next();
-
-        CVertex * pv[4];
-
-        pv[0] = ph[0]->target();
-        pv[1] = ph[1]->target();
-        pv[2] = ph[2]->target();
-        pv[3] = ph[4]->target();
-
-        int     pi[6];
-        CEdge * pe[6];
-
-        for (int i = 0; i < 6; i++)
+        // swapped only while changes are tracked, they are touched after the workers
+        std::vector<std::vector<CEdge*>> stacks, deferred, swapped;
+        std::vector<size_t> flips;
+        size_t total = 0, last = 0;
+        for (int round = 0; !todo.empty(); round++)
         {
-            CHalfEdge *   he = ph[i];
-            CEdge     *   e = he->edge();
-            pe[i] = e;
-
-            if (pe[i]->halfedge(0) == he)
+            // at last one block, it defers nothing: when few edges are left or the blocks stopped helping
+            const bool single = slots <= block || round >= 4 || (round > 0 && (todo.size() < block || last < todo.size()));
+            const size_t size = single ? slots : block;
+            const size_t offset = single ? 0 : (round % 2) * (block / 2);
+            const size_t count = (slots + offset + size - 1) / size;
+            auto owner = [&](CVertex * v) { return (v->property_index() + offset) / size; };
+
+            // an edge goes to the block of its ends, then only edges with both ends in one block are on a stack
+            stacks.assign(count, std::vector<CEdge*>());
+            deferred.assign(count, std::vector<CEdge*>());
+            swapped.assign(count, std::vector<CEdge*>());
+            flips.assign(count, 0);
+            std::vector<CEdge*> across;
+            for (CEdge * e : todo)
             {
-                pi[i] = 0;
+                const size_t b = owner(e->halfedge(0)->target());
+                if (owner(e->halfedge(0)->source()) == b) stacks[b].push_back(e);
+                else across.push_back(e);
             }
-            else
+
+            parallel_for(count, threads, [&](size_t b, size_t e)
             {
-                assert(pe[i]->halfedge(1) == he);
-                pi[i] = 1;
+                CVertex * pv[4];
+                for (size_t c = b; c < e; c++)
+                {
+                    std::vector<CEdge*> & stack = stacks[c];
+                    while (!stack.empty())
+                    {
+                        CEdge * edge = stack.back();
+                        stack.pop_back();
+                        if (edge->halfedge(1) == NULL) continue;
+                        // the ends are in the block, the tips may not be
+                        _quad(edge, pv);
+                        if (owner(pv[1]) != c || owner(pv[3]) != c)
+                        {
+                            deferred[c].push_back(edge);
+                            continue;
+                        }
+                        if (!pred(edge) || !swapable(edge)) continue;
+                        _swap(edge);
+                        flips[c]++;
+                        if (m_tracking) swapped[c].push_back(edge);
+                        for (int k = 0; k < 2; k++)
+                        {
+                            CHalfEdge * he = edge->halfedge(k);
+                            stack.push_back(he->next()->edge());
+                            stack.push_back(he->prev()->edge());
+                        }
+                    }
+                }
+            }, 1);
+
+            todo.swap(across);
+            size_t round_flips = 0;
+            for (size_t c = 0; c < count; c++)
+            {
+                round_flips += flips[c];
+                todo.insert(todo.end(), deferred[c].begin(), deferred[c].end());
+                for (CEdge * edge : swapped[c]) _touch(edge);
             }
+            total += round_flips;
+            last = round_flips;
+            if (single) break;
         }
 
+        if (total > 0) this->m_topology_version++;
+        this->_index_edges();
+#ifdef MESHLIB_CHECK_TOPOLOGY
+        for (CFace * f : this->faces()) _verify("FlipEdges", &f, 1);
+#endif
+        return total;
+    };
 
-        //remove edge from edge list of the original vertex
-        CVertex * vb = (pv[0]->id() < pv[2]->id()) ? pv[0] : pv[2];
-        std::list<CEdge*> & ledges = (std::list<CEdge*> &) vb->edges();
-
-        //add edge to the edge list of the new vertex
-        CVertex * wb = (pv[1]->id() < pv[3]->id()) ? pv[1] : pv[3];
-        std::list<CEdge*> & wedges = (std::list<CEdge*> &) wb->edges();
-
-        for (typename std::list<CEdge*>::iterator eiter = wedges.begin(); eiter != wedges.end(); eiter++)
+    /*---------------------------------------------------------------------------*/
+    //the angles opposite an edge sum to more than pi iff their cotangents sum below zero
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    size_t CDynamicMesh<V, E, F, H, A, P>::delaunayFlip(int threads, double eps)
+    {
+        auto cotangent = [](const CPoint & a, const CPoint & b, const CPoint & c)
         {
-            CEdge * pE = *eiter;
-
-            CVertex * v1 = pE->vertex1();
-            CVertex * v2 = pE->vertex2();
-
-            if ((v1 == pv[0] && v2 == pv[2]) || (v1 == pv[2]) && (v2 == pv[0]))
-            {
-                std::cout << "DynamicMesh::SwapEdge::Warning Two edges share same both end vertices" << std::endl;
-                return false;
-            }
-        }
-
-        return true;
+            const CPoint u = b - a, v = c - a;
+            const double s = (u ^ v).norm();
+            return s > 0 ? (u * v) / s : 0.0;
+        };
+        return flipEdges([&](CEdge * e)
+        {
+            CVertex * pv[4];
+            _quad(e, pv);
+            return cotangent(pv[1]->point(), pv[2]->point(), pv[0]->point())
+                 + cotangent(pv[3]->point(), pv[0]->point(), pv[2]->point()) < -eps;
+        }, threads);
     };
 
     /*---------------------------------------------------------------------------*/
     //insert a vertex in the center of an edge, split each neighboring face into 2 faces
-    template<typename V, typename E, typename F, typename H>
-    typename CDynamicMesh<V, E, F, H>::CVertex * CDynamicMesh<V,E,F,H>::splitEdge(typename CDynamicMesh<V, E, F, H>::CEdge * pEdge)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    typename CDynamicMesh<V, E, F, H, A, P>::CVertex * CDynamicMesh<V,E,F,H,A,P>::splitEdge(typename CDynamicMesh<V, E, F, H, A, P>::CEdge * pEdge)
     {
-
+        // pEdge keeps only one of its end vertices
+        const bool indexed = _indexed();
+        if (indexed) _unindex(pEdge);
+        _check_history();
+        _record(pEdge->halfedge(0)->face());
+        _record(pEdge->halfedge(1)->face());
+
+        _scan_ids();
         CVertex * pV = this->create_vertex(++m_vertex_id);
 
 
@@ -516,7 +908,7 @@ namespace MeshLib
             s[i] = h[i]->dual();
         }
 
-        f[2] = new CFace();
+        f[2] = this->template _create<CFace>();
         assert(f[2] != NULL);
         f[2]->id() = ++m_face_id;
         this->m_faces.push_back(f[2]);
@@ -524,7 +916,7 @@ namespace MeshLib
         //create halfedges
         for (int i = 6; i < 9; i++)
         {
-            h[i] = new CHalfEdge;
+            h[i] = this->template _create<CHalfEdge>();
             assert(h[i]);
         }
 
@@ -543,7 +935,7 @@ namespace MeshLib
         }
 
 
-        f[3] = new CFace();
+        f[3] = this->template _create<CFace>();
         assert(f[3] != NULL);
         f[3]->id() = ++m_face_id;
         this->m_faces.push_back(f[3]);
@@ -551,7 +943,7 @@ namespace MeshLib
         //create halfedges
         for (int i = 9; i < 12; i++)
         {
-            h[i] = new CHalfEdge();
+            h[i] = this->template _create<CHalfEdge>();
             assert(h[i]);
         }
 
@@ -573,7 +965,7 @@ namespace MeshLib
 
         for (int i = 0; i < 3; i++)
         {
-            e[i] = new CEdge();
+            e[i] = this->template _create<CEdge>();
             this->m_edges.push_back(e[i]);
             assert(e[i]);
         }
@@ -611,28 +1003,653 @@ namespace MeshLib
         v[4]->halfedge() = h[4];
         pV->halfedge() = h[3];
 
-        for (int k = 0; k < 4; k++)
+        for (int i : { 0, 1, 2, 4 }) v[i]->clear_adjacency();
+        f[0]->clear_adjacency();
+        f[1]->clear_adjacency();
+
+        _touch(pV);
+        for (int i : { 0, 1, 2, 4 }) _touch(v[i]);
+        for (int i = 0; i < 4; i++) _touch(f[i]);
+        if (m_editing)
+        {
+            _created(pV);
+            _created(f[2]);
+            _created(f[3]);
+            for (int i = 6; i < 12; i++) _created(h[i]);
+            for (int i = 0; i < 3; i++) _created(e[i]);
+        }
+
+        if (indexed)
+        {
+            _index(pEdge);
+            for (int i = 0; i < 3; i++) _index(e[i]);
+        }
+#ifdef MESHLIB_CHECK_TOPOLOGY
+        _verify("SplitEdge", f, 4);
+#endif
+        return pV;
+
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_ring(typename CDynamicMesh<V, E, F, H, A, P>::CVertex * v, std::vector<CVertex*> & ring)
+    {
+        ring.clear();
+        for (CVertex * w : v->vertices_range()) ring.push_back(w);
+        std::sort(ring.begin(), ring.end());
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_relabel(typename CDynamicMesh<V, E, F, H, A, P>::CVertex * v)
+    {
+        CHalfEdge * start = v->halfedge();
+        CHalfEdge * he = start;
+        do
+        {
+            CHalfEdge * ne = he->ccw_rotate_about_target();
+            if (ne == NULL)
+            {
+                v->boundary() = true;
+                v->halfedge() = he;
+                return;
+            }
+            he = ne;
+        } while (he != start);
+        v->boundary() = false;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    typename CDynamicMesh<V, E, F, H, A, P>::CFace * CDynamicMesh<V, E, F, H, A, P>::addTriangle(typename CDynamicMesh<V, E, F, H, A, P>::CVertex * v0,
+        typename CDynamicMesh<V, E, F, H, A, P>::CVertex * v1, typename CDynamicMesh<V, E, F, H, A, P>::CVertex * v2)
+    {
+        if (v0 == v1 || v1 == v2 || v2 == v0) return NULL;
+        // the lookups below walk one fan of a vertex without the index, pinched vertices have several
+        if (!_indexed()) this->_index_edges();
+
+        //halfedge i runs from v[i] to v[i + 1], over the halfedge of an edge there the other way
+        CVertex * v[3] = { v0, v1, v2 };
+        CEdge * e[3];
+        for (int i = 0; i < 3; i++)
+        {
+            e[i] = this->edge(v[i], v[(i + 1) % 3]);
+            if (e[i] == NULL) continue;
+            if (e[i]->halfedge(1) != NULL || e[i]->halfedge(0)->source() != v[(i + 1) % 3]) return NULL;
+        }
+
+        _check_history();
+        _scan_ids();
+        if (m_editing)
         {
-            CHalfEdge * pH = f[k]->halfedge();
             for (int i = 0; i < 3; i++)
             {
-                assert(pH->vertex() == pH->dual()->prev()->vertex());
-                pH = pH->next();
+                _record_element(v[i]);
+                if (e[i] != NULL) _record_element(e[i]);
             }
         }
-        return pV;
 
+        CFace * f = this->template _create<CFace>();
+        assert(f != NULL);
+        f->id() = ++m_face_id;
+        this->m_faces.push_back(f);
+
+        CHalfEdge * hes[3];
+        for (int i = 0; i < 3; i++)
+        {
+            hes[i] = this->template _create<CHalfEdge>();
+            assert(hes[i]);
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            hes[i]->next() = hes[(i + 1) % 3];
+            hes[i]->prev() = hes[(i + 2) % 3];
+            hes[i]->face() = f;
+            hes[i]->vertex() = v[(i + 1) % 3];
+        }
+        f->halfedge() = hes[0];
+
+        bool created[3] = { false, false, false };
+        for (int i = 0; i < 3; i++)
+        {
+            if (e[i] != NULL)
+            {
+                __attach_halfedge_to_edge(e[i]->halfedge(0), hes[i], e[i]);
+                continue;
+            }
+            e[i] = this->template _create<CEdge>();
+            assert(e[i]);
+            this->m_edges.push_back(e[i]);
+            __attach_halfedge_to_edge(hes[i], NULL, e[i]);
+            _index(e[i]);
+            created[i] = true;
+        }
+
+        // each vertex is entered by the new halfedge before it
+        for (int i = 0; i < 3; i++)
+        {
+            v[(i + 1) % 3]->halfedge() = hes[i];
+            _relabel(v[(i + 1) % 3]);
+            v[i]->clear_adjacency();
+        }
+
+        for (int i = 0; i < 3; i++) _touch(v[i]);
+        _touch(f);
+        if (m_editing)
+        {
+            _created(f);
+            for (int i = 0; i < 3; i++)
+            {
+                _created(hes[i]);
+                if (created[i]) _created(e[i]);
+            }
+        }
+#ifdef MESHLIB_CHECK_TOPOLOGY
+        _verify("AddTriangle", &f, 1);
+#endif
+        return f;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDynamicMesh<V, E, F, H, A, P>::collapsable(typename CDynamicMesh<V, E, F, H, A, P>::CHalfEdge * pH)
+    {
+        CHalfEdge * pD = pH->dual();
+        if (pD == NULL) return false;
+        if (pH->next()->next()->next() != pH || pD->next()->next()->next() != pD) return false;
+
+        CVertex * from = pH->source();
+        CVertex * to = pH->target();
+        CVertex * a = pH->next()->target();
+        CVertex * b = pD->next()->target();
+        if (from->boundary() || a == b) return false;
+        // a triangle whose other two edges are both on the boundary would leave its tip dangling
+        if (pH->next()->dual() == NULL && pH->prev()->dual() == NULL) return false;
+        if (pD->next()->dual() == NULL && pD->prev()->dual() == NULL) return false;
+
+        _ring(from, m_ring[0]);
+        _ring(to, m_ring[1]);
+        size_t common = 0, all = 0;
+        for (size_t i = 0, j = 0; i < m_ring[0].size() || j < m_ring[1].size(); all++)
+        {
+            if (j == m_ring[1].size() || (i < m_ring[0].size() && m_ring[0][i] < m_ring[1][j])) i++;
+            else if (i == m_ring[0].size() || m_ring[1][j] < m_ring[0][i]) j++;
+            else { common++; i++; j++; }
+        }
+        // the rings meet at a and b only, and are more than a and b, else the faces would fold onto each other
+        return common == 2 && all - 2 > 2;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    typename CDynamicMesh<V, E, F, H, A, P>::CVertex * CDynamicMesh<V, E, F, H, A, P>::collapseEdge(typename CDynamicMesh<V, E, F, H, A, P>::CHalfEdge * pH)
+    {
+        if (!collapsable(pH)) return NULL;
+        return _collapse(pH, NULL);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    typename CDynamicMesh<V, E, F, H, A, P>::CVertex * CDynamicMesh<V, E, F, H, A, P>::collapseEdgeDeferred(typename CDynamicMesh<V, E, F, H, A, P>::CHalfEdge * pH)
+    {
+        if (!collapsable(pH)) return NULL;
+        return _collapse(pH, &m_removed);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    //the faces f0 = (from, to, a) and f1 = (to, from, b) go, the edge (a, from) merges into (to, a)
+    //and (from, b) into (b, to), and the halfedges entering from enter to instead
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    typename CDynamicMesh<V, E, F, H, A, P>::CVertex * CDynamicMesh<V, E, F, H, A, P>::_collapse(typename CDynamicMesh<V, E, F, H, A, P>::CHalfEdge * pH, CRemoved * removed)
+    {
+        // edges get new end vertices
+        this->drop_edge_index();
+
+        CHalfEdge * h[6];
+        h[0] = pH;
+        h[1] = h[0]->next();
+        h[2] = h[1]->next();
+        h[3] = pH->dual();
+        h[4] = h[3]->next();
+        h[5] = h[4]->next();
+
+        CVertex * from = h[0]->source();
+        CVertex * to = h[0]->target();
+        CVertex * a = h[1]->target();
+        CVertex * b = h[4]->target();
+
+        // the faces around from hold every link that changes
+        _check_history();
+        if (m_editing)
+        {
+            for (CFace * f : from->faces_range()) _record(f);
+        }
+        if (m_tracking)
+        {
+            for (CFace * f : from->faces_range()) _touch(f);
+            for (CVertex * v : { to, a, b }) _touch(v);
+            _touch(from, true);
+            for (int i = 0; i < 2; i++) _touch(h[3 * i]->face(), true);
+        }
+
+        // the outer halfedges of the two faces, any may be NULL on the boundary
+        CHalfEdge * o1 = h[1]->dual();   // a -> to
+        CHalfEdge * o2 = h[2]->dual();   // from -> a
+        CHalfEdge * q1 = h[4]->dual();   // b -> from
+        CHalfEdge * q2 = h[5]->dual();   // to -> b
+
+        CEdge * ea = h[1]->edge();
+        CEdge * eb = h[5]->edge();
+        CEdge * dead[3] = { h[0]->edge(), h[2]->edge(), h[4]->edge() };
+        CFace * faces[2] = { h[0]->face(), h[3]->face() };
+
+        m_incoming.clear();
+        for (CHalfEdge * he : from->in_halfedges_range()) m_incoming.push_back(he);
+        for (CHalfEdge * he : m_incoming) he->vertex() = to;
+
+        ea->halfedge(0) = o1 ? o1 : o2;
+        ea->halfedge(1) = o1 ? o2 : NULL;
+        if (o2) o2->edge() = ea;
+        eb->halfedge(0) = q2 ? q2 : q1;
+        eb->halfedge(1) = q2 ? q1 : NULL;
+        if (q1) q1->edge() = eb;
+
+        to->halfedge() = o1 ? o1 : q1;
+        if (a->halfedge() == h[1]) a->halfedge() = o2 ? o2 : o1->prev();
+        if (b->halfedge() == h[4]) b->halfedge() = q2 ? q2 : q1->prev();
+
+        // cached neighborhoods around to are out of date
+        to->clear_adjacency();
+        for (CVertex * w : to->vertices_range()) w->clear_adjacency();
+        for (CFace * f : to->faces_range()) f->clear_adjacency();
+
+        if (this->m_map_vert.find(from->id()) == from) this->m_map_vert.erase(from->id());
+        for (int i = 0; i < 2; i++)
+        {
+            if (this->m_map_face.find(faces[i]->id()) == faces[i]) this->m_map_face.erase(faces[i]->id());
+        }
+
+        if (m_editing)
+        {
+            _retire(this->m_verts, from, m_gone.vertices);
+            for (int i = 0; i < 3; i++) _retire(this->m_edges, dead[i], m_gone.edges);
+            for (int i = 0; i < 2; i++) _retire(this->m_faces, faces[i], m_gone.faces);
+            for (int i = 0; i < 6; i++) _retire(this->m_halfedges, h[i], m_gone.halfedges);
+            return to;
+        }
+
+        if (removed)
+        {
+            from->halfedge() = NULL;
+            for (int i = 0; i < 3; i++) dead[i]->halfedge(0) = dead[i]->halfedge(1) = NULL;
+            removed->vertices.push_back(from);
+            removed->edges.insert(removed->edges.end(), dead, dead + 3);
+            removed->faces.insert(removed->faces.end(), faces, faces + 2);
+            removed->halfedges.insert(removed->halfedges.end(), h, h + 6);
+            return to;
+        }
+
+        this->m_verts.remove(from);
+        this->_destroy(from);
+        for (int i = 0; i < 3; i++)
+        {
+            this->m_edges.remove(dead[i]);
+            this->_destroy(dead[i]);
+        }
+        for (int i = 0; i < 2; i++)
+        {
+            this->m_faces.remove(faces[i]);
+            this->_destroy(faces[i]);
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            this->m_halfedges.remove(h[i]);
+            this->_destroy(h[i]);
+        }
+        return to;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_sweep(CRemoved & removed)
+    {
+        _sweep(this->m_verts, removed.vertices);
+        _sweep(this->m_edges, removed.edges);
+        _sweep(this->m_faces, removed.faces);
+        _sweep(this->m_halfedges, removed.halfedges);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    //the collapses are chosen on flat arrays by CMeshSimplifier, then replayed on the mesh
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    int CDynamicMesh<V, E, F, H, A, P>::decimate(double ratio, int threads)
+    {
+        std::vector<CVertex*> verts;
+        std::vector<float> positions;
+        std::vector<uint32_t> index, indices;
+        for (CVertex * v : this->vertices())
+        {
+            if (v->property_index() >= index.size()) index.resize(v->property_index() + 1);
+            index[v->property_index()] = (uint32_t)verts.size();
+            verts.push_back(v);
+            for (int k = 0; k < 3; k++) positions.push_back((float)v->point()[k]);
+        }
+        indices.reserve(3 * this->faces().size());
+        for (CFace * f : this->faces())
+        {
+            CHalfEdge * he = f->halfedge();
+            if (he->next()->next()->next() != he) return this->num_faces();
+            for (int k = 0; k < 3; k++, he = he->next()) indices.push_back(index[he->vertex()->property_index()]);
+        }
+
+        CMeshSimplifier simplifier(indices.data(), indices.size(), positions.data(), verts.size(), threads);
+        simplifier.simplify_ratio(ratio, threads);
+
+        CRemoved removed;
+        for (const auto & c : simplifier.collapses())
+        {
+            CVertex * from = verts[c.first];
+            CVertex * to = verts[c.second];
+            for (CHalfEdge * he : from->out_halfedges_range())
+            {
+                if (he->target() != to) continue;
+                if (collapsable(he)) _collapse(he, &removed);
+                break;
+            }
+        }
+        _sweep(removed);
+        this->_index_edges();
+        return this->num_faces();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_index(typename CDynamicMesh<V, E, F, H, A, P>::CEdge * e)
+    {
+        CHalfEdge * he = e->halfedge(0);
+        this->m_edge_hash.insert(CEdgeHash<CEdge>::key(he->source()->id(), he->target()->id()), e);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_unindex(typename CDynamicMesh<V, E, F, H, A, P>::CEdge * e)
+    {
+        CHalfEdge * he = e->halfedge(0);
+        this->m_edge_hash.erase(CEdgeHash<CEdge>::key(he->source()->id(), he->target()->id()), e);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_verify(const char * op, CFace * const * faces, int n)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            CHalfEdge * he = faces[k]->halfedge();
+            do
+            {
+                CHalfEdge * sh = he->dual();
+                const bool linked = he->face() == faces[k] && he->next()->prev() == he
+                    && (he->edge()->halfedge(0) == he || he->edge()->halfedge(1) == he)
+                    && he->target()->halfedge() != NULL && he->target()->halfedge()->target() == he->target()
+                    && (sh == NULL || (sh->dual() == he && sh->target() == he->source() && he->target() == sh->source()));
+                if (!linked)
+                {
+                    std::cerr << "DynamicMesh::" << op << "::Error broken halfedge in face " << faces[k]->id() << std::endl;
+                    std::abort();
+                }
+                he = he->next();
+            } while (he != faces[k]->halfedge());
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::beginEdit()
+    {
+        if (m_editing++) return;
+        sweep();
+
+        // the undone steps can no longer be redone
+        while (m_steps.size() > m_done)
+        {
+            _drop(m_steps.back(), false);
+            m_steps.pop_back();
+        }
+        if (m_vertex_stamp == NULL)
+        {
+            m_vertex_stamp = &this->template add_vertex_property<unsigned>("edit_stamp", 0);
+            m_edge_stamp = &this->template add_edge_property<unsigned>("edit_stamp", 0);
+            m_face_stamp = &this->template add_face_property<unsigned>("edit_stamp", 0);
+            m_halfedge_stamp = &this->template add_halfedge_property<unsigned>("edit_stamp", 0);
+        }
+        m_serial++;
+        m_steps.emplace_back();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::endEdit()
+    {
+        if (m_editing == 0 || --m_editing > 0) return;
+        _seal();
+        if (m_steps.back().empty())
+        {
+            m_steps.pop_back();
+            m_change = CChange();
+            return;
+        }
+        m_done++;
+        _describe(m_steps.back(), true);
+        _trim();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::cancelEdit()
+    {
+        if (m_editing == 0) return;
+        m_editing = 0;
+        _seal();
+        _apply(m_steps.back(), false);
+        _drop(m_steps.back(), false);
+        m_steps.pop_back();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDynamicMesh<V, E, F, H, A, P>::undo()
+    {
+        if (!canUndo()) return false;
+        _apply(m_steps[--m_done], false);
+        this->m_topology_version++;
+        this->m_geometry_version++;
+        return true;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDynamicMesh<V, E, F, H, A, P>::redo()
+    {
+        if (!canRedo()) return false;
+        _apply(m_steps[m_done++], true);
+        this->m_topology_version++;
+        this->m_geometry_version++;
+        return true;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::clearHistory()
+    {
+        // an open step stays, it is the last one
+        const size_t closed = m_steps.size() - (m_editing ? 1 : 0);
+        for (size_t i = 0; i < closed; i++) _drop(m_steps[i], i < m_done);
+        m_steps.erase(m_steps.begin(), m_steps.begin() + closed);
+        m_done = 0;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_trim()
+    {
+        while (m_undo_limit > 0 && m_done > m_undo_limit)
+        {
+            _drop(m_steps.front(), true);
+            m_steps.pop_front();
+            m_done--;
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_seal()
+    {
+        m_steps.back().seal(m_gone.vertices, m_gone.edges, m_gone.faces, m_gone.halfedges);
+        _free(m_gone.vertices);
+        _free(m_gone.edges);
+        _free(m_gone.faces);
+        _free(m_gone.halfedges);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_drop(CStep & step, bool applied)
+    {
+        if (applied)
+        {
+            _free(step.vertices.removed);
+            _free(step.edges.removed);
+            _free(step.faces.removed);
+            _free(step.halfedges.removed);
+        }
+        else
+        {
+            _free(step.vertices.created);
+            _free(step.edges.created);
+            _free(step.faces.created);
+            _free(step.halfedges.created);
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    //the records hold every edge whose ends change, they leave the edge index before
+    //the links are written and come back after, so an index that was up to date stays so
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_apply(CStep & step, bool forward)
+    {
+        const bool indexed = _indexed();
+        if (indexed)
+        {
+            for (const auto & r : step.edges.records) if (forward || !r.removed) _unindex(r.element);
+            if (!forward) for (CEdge * e : step.edges.created) _unindex(e);
+        }
+
+        // what goes in and out of the lists
+        auto & vertices = step.vertices;
+        auto & edges = step.edges;
+        auto & faces = step.faces;
+        auto & halfedges = step.halfedges;
+        const std::vector<CVertex*> & vin = forward ? vertices.created : vertices.removed;
+        const std::vector<CVertex*> & vout = forward ? vertices.removed : vertices.created;
+        const std::vector<CFace*> & fin = forward ? faces.created : faces.removed;
+        const std::vector<CFace*> & fout = forward ? faces.removed : faces.created;
+
+        for (CVertex * v : vout) if (this->m_map_vert.find(v->id()) == v) this->m_map_vert.erase(v->id());
+        for (CFace * f : fout) if (this->m_map_face.find(f->id()) == f) this->m_map_face.erase(f->id());
+        _relist(this->m_verts, vout, vin);
+        _relist(this->m_edges, forward ? edges.removed : edges.created, forward ? edges.created : edges.removed);
+        _relist(this->m_faces, fout, fin);
+        _relist(this->m_halfedges, forward ? halfedges.removed : halfedges.created, forward ? halfedges.created : halfedges.removed);
+        for (CVertex * v : vin) this->m_map_vert.insert(v->id(), v);
+        for (CFace * f : fin) this->m_map_face.insert(f->id(), f);
+
+        step.restore(forward);
+
+        for (const auto & r : vertices.records) r.element->clear_adjacency();
+        for (const auto & r : faces.records) r.element->clear_adjacency();
+        for (CVertex * v : vin) v->clear_adjacency();
+        for (CFace * f : fin) f->clear_adjacency();
+        if (m_tracking)
+        {
+            for (const auto & r : vertices.records) if (!r.removed) _touch(r.element);
+            for (const auto & r : faces.records) if (!r.removed) _touch(r.element);
+            for (CVertex * v : vin) _touch(v);
+            for (CFace * f : fin) _touch(f);
+            for (CVertex * v : vout) _touch(v, true);
+            for (CFace * f : fout) _touch(f, true);
+        }
+
+        if (indexed)
+        {
+            for (const auto & r : edges.records) if (!forward || !r.removed) _index(r.element);
+            if (forward) for (CEdge * e : edges.created) _index(e);
+        }
+        _describe(step, forward);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_describe(CStep & step, bool forward)
+    {
+        m_change.vertices.clear();
+        m_change.faces.clear();
+        for (const auto & r : step.vertices.records) if (!r.removed) m_change.vertices.push_back(r.element);
+        for (const auto & r : step.faces.records) if (!r.removed) m_change.faces.push_back(r.element);
+        m_change.added_vertices = forward ? step.vertices.created : step.vertices.removed;
+        m_change.added_faces = forward ? step.faces.created : step.faces.removed;
+        m_change.removed_vertices = forward ? step.vertices.removed : step.vertices.created;
+        m_change.removed_faces = forward ? step.faces.removed : step.faces.created;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::trackChanges(bool on)
+    {
+        m_tracking = on;
+        m_touched_vertices.clear();
+        m_touched_faces.clear();
+        m_vertex_at.clear();
+        m_face_at.clear();
+        if (!on) return;
+
+        m_vertex_at.resize(this->m_properties->vertices.size(), NULL);
+        m_face_at.resize(this->m_properties->faces.size(), NULL);
+        for (CVertex * v : this->vertices()) m_vertex_at[v->property_index()] = v;
+        for (CFace * f : this->faces()) m_face_at[f->property_index()] = f;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::takeChanges(std::vector<std::pair<size_t, size_t>> & vertices, std::vector<std::pair<size_t, size_t>> & faces, size_t gap)
+    {
+        _ranges(m_touched_vertices, vertices, gap);
+        _ranges(m_touched_faces, faces, gap);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::_ranges(std::vector<size_t> & slots, std::vector<std::pair<size_t, size_t>> & ranges, size_t gap)
+    {
+        ranges.clear();
+        std::sort(slots.begin(), slots.end());
+        for (size_t s : slots)
+        {
+            if (!ranges.empty() && s <= ranges.back().second + gap) ranges.back().second = std::max(ranges.back().second, s + 1);
+            else ranges.push_back(std::make_pair(s, s + 1));
+        }
+        slots.clear();
     };
 
     /*---------------------------------------------------------------------------*/
-    template<typename V, typename E, typename F, typename H>
-    void CDynamicMesh<V, E, F, H>::__attach_halfedge_to_edge(typename CDynamicMesh<V, E, F, H>::CHalfEdge * he0, typename CDynamicMesh<V, E, F, H>::CHalfEdge * he1, typename CDynamicMesh<V, E, F, H>::CEdge * e)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDynamicMesh<V, E, F, H, A, P>::__attach_halfedge_to_edge(typename CDynamicMesh<V, E, F, H, A, P>::CHalfEdge * he0, typename CDynamicMesh<V, E, F, H, A, P>::CHalfEdge * he1, typename CDynamicMesh<V, E, F, H, A, P>::CEdge * e)
     {
         e->halfedge(0) = he0;
         e->halfedge(1) = he1;
 
         he0->edge() = e;
-        he1->edge() = e;
+        if (he1 != NULL) he1->edge() = e;
 
     };
 
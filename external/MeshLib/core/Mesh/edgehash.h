@@ -0,0 +1,129 @@
+/*!
+*      \file edgehash.h
+*      \brief Open addressing table from vertex id pairs to edges
+*/
+
+#ifndef _MESHLIB_EDGEHASH_H_
+#define _MESHLIB_EDGEHASH_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CEdgeHash class, edges keyed by (min id, max id) of their end vertices
+     *
+     *  Linear probing with backward shift deletion, the table stays at most
+     *  half full. Vertex ids need not be unique: find() takes a predicate that
+     *  confirms an entry, so equal keys of different edges can live side by side.
+     */
+    template<typename T>
+    class CEdgeHash
+    {
+    public:
+        static uint64_t key(int a, int b)
+        {
+            uint32_t lo = (uint32_t)(a < b ? a : b), hi = (uint32_t)(a < b ? b : a);
+            return (uint64_t)hi << 32 | lo;
+        }
+
+        /*! the first entry with this key that `match` accepts, NULL if there is none */
+        template<typename Match>
+        T * find(uint64_t k, Match match) const
+        {
+            if (m_slots.empty()) return NULL;
+            for (size_t i = _home(k); m_slots[i].value != NULL; i = (i + 1) & m_mask)
+            {
+                if (m_slots[i].key == k && match(m_slots[i].value)) return m_slots[i].value;
+            }
+            return NULL;
+        }
+
+        void insert(uint64_t k, T * t)
+        {
+            if (2 * (m_size + 1) > m_slots.size()) _rehash(m_slots.empty() ? s_min_slots : 2 * m_slots.size());
+            size_t i = _home(k);
+            while (m_slots[i].value != NULL) i = (i + 1) & m_mask;
+            m_slots[i].key = k;
+            m_slots[i].value = t;
+            m_size++;
+        }
+
+        /*! remove the entry of t */
+        bool erase(uint64_t k, T * t)
+        {
+            if (m_slots.empty()) return false;
+            size_t i = _home(k);
+            while (m_slots[i].value != NULL && !(m_slots[i].key == k && m_slots[i].value == t)) i = (i + 1) & m_mask;
+            if (m_slots[i].value == NULL) return false;
+
+            // move later entries of the probe run back into the hole
+            for (size_t j = (i + 1) & m_mask; m_slots[j].value != NULL; j = (j + 1) & m_mask)
+            {
+                size_t h = _home(m_slots[j].key);
+                bool between = (i <= j) ? (i < h && h <= j) : (i < h || h <= j);
+                if (between) continue;
+                m_slots[i] = m_slots[j];
+                i = j;
+            }
+            m_slots[i].value = NULL;
+            m_size--;
+            return true;
+        }
+
+        /*! make room for n entries without rehashing */
+        void reserve(size_t n)
+        {
+            size_t count = s_min_slots;
+            while (count < 2 * n) count *= 2;
+            if (count > m_slots.size()) _rehash(count);
+        }
+
+        /*! remove all entries and release the table */
+        void clear()
+        {
+            std::vector<CSlot>().swap(m_slots);
+            m_size = 0;
+            m_mask = 0;
+        }
+
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        /*! bytes of the table */
+        size_t memory() const { return m_slots.capacity() * sizeof(CSlot); }
+
+    protected:
+        struct CSlot
+        {
+            uint64_t key = 0;
+            T *      value = NULL;
+        };
+
+        size_t _home(uint64_t k) const { return (size_t)((k * 0x9E3779B97F4A7C15ull) >> 32) & m_mask; }
+
+        void _rehash(size_t count)
+        {
+            std::vector<CSlot> old;
+            old.swap(m_slots);
+            m_slots.resize(count);
+            m_mask = count - 1;
+            m_size = 0;
+            for (const CSlot & s : old)
+            {
+                if (s.value) insert(s.key, s.value);
+            }
+        }
+
+        static const size_t s_min_slots = 16;
+
+        std::vector<CSlot> m_slots;
+        size_t             m_size = 0;
+        size_t             m_mask = 0;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,176 @@
+/*!
+*      \file editlog.h
+*      \brief Undoable steps of mesh edits, kept as the links the edits changed
+*/
+
+#ifndef _MESHLIB_EDITLOG_H_
+#define _MESHLIB_EDITLOG_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "../Geometry/Point.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CEditStep class, one undoable step of edits on the elements of a mesh
+     *
+     *  A step holds the elements it created and removed, and for every element
+     *  that was there before it and got relinked, its links before and after.
+     *  Undo writes the links before back, redo the ones after, neither walks
+     *  more than the step. The removed elements stay allocated while the step
+     *  can be redone, the created ones while it can be undone; the mesh that
+     *  owns them frees them when the step is dropped.
+     *  \tparam V, E, F, H vertex, edge, face and halfedge classes of the mesh
+     */
+    template<typename V, typename E, typename F, typename H>
+    class CEditStep
+    {
+    public:
+        /*! links of a vertex, with its point for vertices moved by hand */
+        struct CVertexLinks
+        {
+            H *    halfedge;
+            CPoint point;
+            bool   boundary;
+            void read(V * v) { halfedge = v->halfedge(); point = v->point(); boundary = v->boundary(); }
+            void write(V * v) const { v->halfedge() = halfedge; v->point() = point; v->boundary() = boundary; }
+        };
+        struct CEdgeLinks
+        {
+            H * halfedge[2];
+            void read(E * e) { halfedge[0] = e->halfedge(0); halfedge[1] = e->halfedge(1); }
+            void write(E * e) const { e->halfedge(0) = halfedge[0]; e->halfedge(1) = halfedge[1]; }
+        };
+        struct CFaceLinks
+        {
+            H * halfedge;
+            void read(F * f) { halfedge = f->halfedge(); }
+            void write(F * f) const { f->halfedge() = halfedge; }
+        };
+        struct CHalfEdgeLinks
+        {
+            V * vertex;
+            E * edge;
+            F * face;
+            H * next;
+            H * prev;
+            void read(H * h) { vertex = h->vertex(); edge = h->edge(); face = h->face(); next = h->next(); prev = h->prev(); }
+            void write(H * h) const { h->vertex() = vertex; h->edge() = edge; h->face() = face; h->next() = next; h->prev() = prev; }
+        };
+
+        /*! an element that was there before the step, its links before and after, whether the step removed it */
+        template<typename T, typename L>
+        struct CRecord
+        {
+            T *  element;
+            L    before;
+            L    after;
+            bool removed;
+        };
+
+        /*! the elements of one kind the step touched */
+        template<typename T, typename L>
+        struct CElements
+        {
+            std::vector<CRecord<T, L>> records;
+            std::vector<T*>            created;
+            std::vector<T*>            removed;
+        };
+
+        CElements<V, CVertexLinks>   vertices;
+        CElements<E, CEdgeLinks>     edges;
+        CElements<F, CFaceLinks>     faces;
+        CElements<H, CHalfEdgeLinks> halfedges;
+
+        /*! keep the links of an element before they change, the mesh records each once per step */
+        void record(V * v) { _record(vertices, v); }
+        void record(E * e) { _record(edges, e); }
+        void record(F * f) { _record(faces, f); }
+        void record(H * h) { _record(halfedges, h); }
+        /*! an element the step created */
+        void create(V * v) { vertices.created.push_back(v); }
+        void create(E * e) { edges.created.push_back(e); }
+        void create(F * f) { faces.created.push_back(f); }
+        void create(H * h) { halfedges.created.push_back(h); }
+        /*! an element the step took out of the mesh */
+        void remove(V * v) { vertices.removed.push_back(v); }
+        void remove(E * e) { edges.removed.push_back(e); }
+        void remove(F * f) { faces.removed.push_back(f); }
+        void remove(H * h) { halfedges.removed.push_back(h); }
+
+        /*! whether the step changed nothing */
+        bool empty() const
+        {
+            return vertices.records.empty() && vertices.created.empty() && edges.records.empty() && edges.created.empty()
+                && faces.records.empty() && faces.created.empty() && halfedges.records.empty() && halfedges.created.empty();
+        }
+
+        /*!
+         *  Close the step: take the links after, and mark the records of removed elements
+         *  \param gone elements created and removed again within the step, they are
+         *  struck from the created ones, the caller frees them
+         */
+        void seal(std::vector<V*> & gone_vertices, std::vector<E*> & gone_edges, std::vector<F*> & gone_faces, std::vector<H*> & gone_halfedges)
+        {
+            _seal(vertices, gone_vertices);
+            _seal(edges, gone_edges);
+            _seal(faces, gone_faces);
+            _seal(halfedges, gone_halfedges);
+        }
+
+        /*!
+         *  Write the links back
+         *  \param after the links after the step, else before it; the removed elements keep theirs
+         */
+        void restore(bool after)
+        {
+            _restore(vertices, after);
+            _restore(edges, after);
+            _restore(faces, after);
+            _restore(halfedges, after);
+        }
+
+    protected:
+        template<typename T, typename L>
+        static void _record(CElements<T, L> & elements, T * t)
+        {
+            CRecord<T, L> r;
+            r.element = t;
+            r.before.read(t);
+            r.removed = false;
+            elements.records.push_back(r);
+        }
+
+        template<typename T, typename L>
+        static void _seal(CElements<T, L> & elements, std::vector<T*> & gone)
+        {
+            std::sort(gone.begin(), gone.end());
+            auto is_gone = [&](T * t) { return std::binary_search(gone.begin(), gone.end(), t); };
+            elements.created.erase(std::remove_if(elements.created.begin(), elements.created.end(), is_gone), elements.created.end());
+
+            std::vector<T*> removed(elements.removed);
+            std::sort(removed.begin(), removed.end());
+            for (CRecord<T, L> & r : elements.records)
+            {
+                r.removed = std::binary_search(removed.begin(), removed.end(), r.element);
+                if (!r.removed) r.after.read(r.element);
+            }
+        }
+
+        template<typename T, typename L>
+        static void _restore(CElements<T, L> & elements, bool after)
+        {
+            for (const CRecord<T, L> & r : elements.records)
+            {
+                if (!after) r.before.write(r.element);
+                else if (!r.removed) r.after.write(r.element);
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,132 @@
+/*!
+*      \file elemlist.h
+*      \brief Contiguous list of element pointers with tombstones for removed elements
+*/
+
+#ifndef _MESHLIB_ELEMLIST_H_
+#define _MESHLIB_ELEMLIST_H_
+
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <cstddef>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CElementList class, the element lists of CBaseMesh
+     *
+     *  Offers the parts of the std::list interface the meshes use. The pointers
+     *  are kept in one array in creation order, a removed element leaves a NULL
+     *  tombstone that iteration skips, the array is compacted once half of it
+     *  is tombstones. Unlike std::list, push_back and remove may invalidate
+     *  iterators.
+     */
+    template<typename T>
+    class CElementList
+    {
+    public:
+        /*! forward iterator over the live elements */
+        class iterator
+        {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef T *                       value_type;
+            typedef std::ptrdiff_t            difference_type;
+            typedef T * const *               pointer;
+            typedef T * const &               reference;
+
+            iterator() {}
+            iterator(T * const * p, T * const * end) : m_p(p), m_end(end) { _skip(); }
+
+            reference operator*() const { return *m_p; }
+            pointer operator->() const { return m_p; }
+            iterator & operator++() { ++m_p; _skip(); return *this; }
+            iterator operator++(int) { iterator it = *this; ++*this; return it; }
+            bool operator==(const iterator & other) const { return m_p == other.m_p; }
+            bool operator!=(const iterator & other) const { return m_p != other.m_p; }
+
+        protected:
+            void _skip() { while (m_p != m_end && *m_p == NULL) ++m_p; }
+
+            T * const * m_p = NULL;
+            T * const * m_end = NULL;
+        };
+        typedef iterator const_iterator;
+        typedef T *      value_type;
+
+        iterator begin() const { return iterator(m_data.data(), m_data.data() + m_data.size()); }
+        iterator end() const { return iterator(m_data.data() + m_data.size(), m_data.data() + m_data.size()); }
+
+        /*! number of live elements */
+        size_t size() const { return m_data.size() - m_dead; }
+        bool empty() const { return size() == 0; }
+        T * front() const { return *begin(); }
+
+        void push_back(T * t) { m_data.push_back(t); }
+        void reserve(size_t n) { m_data.reserve(n); }
+        /*! bytes of the array, tombstones included */
+        size_t memory() const { return m_data.capacity() * sizeof(T*); }
+        void clear() { m_data.clear(); m_dead = 0; }
+
+        /*! remove t, an element is in the list at most once */
+        void remove(T * t)
+        {
+            // recently created elements are the usual ones to go
+            for (size_t i = m_data.size(); i-- > 0;)
+            {
+                if (m_data[i] != t) continue;
+                m_data[i] = NULL;
+                m_dead++;
+                break;
+            }
+            while (!m_data.empty() && m_data.back() == NULL)
+            {
+                m_data.pop_back();
+                m_dead--;
+            }
+            if (m_dead > s_min_dead && 2 * m_dead > m_data.size()) compact();
+        }
+
+        /*! remove every element pred accepts in one pass, pred may dispose of it */
+        template<typename Pred>
+        size_t remove_if(Pred pred)
+        {
+            compact();
+            size_t n = m_data.size();
+            m_data.erase(std::remove_if(m_data.begin(), m_data.end(), pred), m_data.end());
+            return n - m_data.size();
+        }
+
+        /*! drop the tombstones, the live elements keep their order */
+        void compact()
+        {
+            m_data.erase(std::remove(m_data.begin(), m_data.end(), (T *)NULL), m_data.end());
+            m_dead = 0;
+        }
+
+        /*! the live elements in a new order, order lists each of them once */
+        void assign(const std::vector<T *> & order)
+        {
+            m_data = order;
+            m_dead = 0;
+        }
+
+        /*!
+         *  The underlying array, tombstones included, call compact() first for
+         *  an array of live elements only.
+         */
+        const std::vector<T *> & data() const { return m_data; }
+
+    protected:
+        //! tombstones tolerated before half the array has to be dead
+        static const size_t s_min_dead = 64;
+
+        std::vector<T *> m_data;
+        size_t           m_dead = 0;
+    };
+
+}; //namespace
+
+#endif
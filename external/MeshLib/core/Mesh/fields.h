@@ -0,0 +1,170 @@
+/*!
+*      \file fields.h
+*      \brief The optional per element fields of CBaseMesh, chosen at compile time
+*
+*      CMeshFields picks which of the uvs and normals of the vertices and
+*      halfedges, the trait strings of all elements and the cached adjacency
+*      vectors of the vertices and faces a mesh has. The fields are bases
+*      chained onto the element classes, one after the other, a field left out
+*      is an empty link of the chain and costs no byte on any compiler.
+*
+*      The accessors stay, so that the readers, writers and algorithms compile
+*      for every choice: a uv or a normal left out reads as zero and drops what
+*      is written to it, a string left out reads empty and keeps no traits.
+*      The cached adjacency vectors of a mesh without them do not compile, the
+*      allocation free *_range() circulations serve instead.
+*
+*      A fixed degree makes a mesh of triangles or quads only, see CTriMesh and
+*      CQuadMesh: the corner loops of a face are bounded by the constant and
+*      unrolled, and the halfedges, vertices and edges of a face are arrays
+*      built on the fly instead of vectors cached per face.
+*/
+
+#ifndef _MESHLIB_FIELDS_H_
+#define _MESHLIB_FIELDS_H_
+
+#include <string>
+#include <memory>
+
+#include "../Geometry/Point.h"
+#include "../Geometry/Point2.h"
+#include "../parser/traitstr.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshFields, the optional fields of the elements of a CBaseMesh
+     *
+     *  \tparam UV       a uv per vertex and per halfedge
+     *  \tparam Normal   a normal per vertex and per halfedge
+     *  \tparam String   a trait string per element, what .m traits are kept in
+     *  \tparam AdjCache the cached adjacency vectors of the vertices and faces
+     *  \tparam Degree   the corners of every face, 3 or 4, 0 for any polygons
+     */
+    template<bool UV = true, bool Normal = true, bool String = true, bool AdjCache = true, int Degree = 0>
+    struct CMeshFields
+    {
+        static const bool s_uv = UV;
+        static const bool s_normal = Normal;
+        static const bool s_string = String;
+        static const bool s_adjacency = AdjCache;
+        static const int  s_degree = Degree;
+        static_assert(Degree == 0 || Degree >= 3, "a face has 3 corners at least");
+    };
+
+    //! every field, the default of CBaseMesh
+    typedef CMeshFields<> CAllFields;
+    //! points, uvs and normals, all a mesh that is only drawn needs
+    typedef CMeshFields<true, true, false, false> CRenderFields;
+    //! the connectivity and the points only
+    typedef CMeshFields<false, false, false, false> CLeanFields;
+
+    /*! a fresh value of a field left out, per thread, what is written to it is lost on the next call */
+    template<typename T>
+    T & _no_field()
+    {
+        static thread_local T t;
+        t = T();
+        return t;
+    }
+
+    /*!
+     *  \brief the uv of an element, B the chain before it
+     */
+    template<typename B, bool On>
+    class CUVField : public B
+    {
+    public:
+        /*! the texture coordinates */
+        CPoint2 & uv() { return m_uv; }
+    protected:
+        CPoint2 m_uv;
+    };
+    template<typename B>
+    class CUVField<B, false> : public B
+    {
+    public:
+        CPoint2 & uv() { return _no_field<CPoint2>(); }
+    };
+
+    /*!
+     *  \brief the normal of an element
+     */
+    template<typename B, bool On>
+    class CNormalField : public B
+    {
+    public:
+        /*! the normal */
+        CPoint & normal() { return m_normal; }
+    protected:
+        CPoint m_normal;
+    };
+    template<typename B>
+    class CNormalField<B, false> : public B
+    {
+    public:
+        CPoint & normal() { return _no_field<CPoint>(); }
+    };
+
+    /*!
+     *  \brief the trait string of an element
+     */
+    template<typename B, bool On>
+    class CStringField : public B
+    {
+    public:
+        /*! the string of the element, which stores the traits */
+        std::string & string() { return m_string.str(); }
+        /*! the trait string, possibly still a view into the input file */
+        CTraitString & trait_string() { return m_string; }
+    protected:
+        CTraitString m_string;
+    };
+    template<typename B>
+    class CStringField<B, false> : public B
+    {
+    public:
+        std::string & string() { return _no_field<std::string>(); }
+        CTraitString & trait_string() { return _no_field<CTraitString>(); }
+    };
+
+    /*!
+     *  \brief the cached adjacency vectors of an element, Adj holds them
+     */
+    template<typename B, typename Adj, bool On>
+    class CAdjacencyField : public B
+    {
+    public:
+        /*! drop the cached adjacency vectors, e.g. after the neighborhood changed */
+        void clear_adjacency() { m_adjacency.reset(); }
+    protected:
+        /*! adjacency vectors, only allocated by the cached accessors */
+        Adj & _adjacency()
+        {
+            if (!m_adjacency) m_adjacency.reset(new Adj());
+            return *m_adjacency;
+        }
+        /*! bytes of the cached adjacency */
+        size_t _adjacency_memory() const { return m_adjacency ? sizeof(Adj) + m_adjacency->memory() : 0; }
+
+        /*! Cached adjacency, empty until a cached accessor is used */
+        std::unique_ptr<Adj> m_adjacency;
+    };
+    template<typename B, typename Adj>
+    class CAdjacencyField<B, Adj, false> : public B
+    {
+    public:
+        void clear_adjacency() {}
+    protected:
+        Adj & _adjacency()
+        {
+            static_assert(sizeof(Adj) == 0, "the mesh has no adjacency cache, see CMeshFields, use the *_range() circulations");
+            return *(Adj *)NULL;
+        }
+        size_t _adjacency_memory() const { return 0; }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,282 @@
+/*!
+*      \file geodesic.h
+*      \brief Geodesic distances by the heat method
+*
+*      The heat method of Crane et al. diffuses heat from the sources for a
+*      short time t, normalizes the negated gradient of it in every triangle
+*      and finds the distance as the function whose gradient fits that field
+*      best, by a Poisson equation. Both systems are CPoissonSolver ones,
+*      (M / t - L) u = delta and -L d = div X with a vertex fixed per
+*      connected component, factored once per connectivity and points, so a
+*      query of any number of sources costs two back-substitutions and two
+*      passes over the triangles.
+*/
+
+#ifndef _MESHLIB_GEODESIC_H_
+#define _MESHLIB_GEODESIC_H_
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "poisson.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CHeatGeodesic class, distances to a set of source vertices
+     *
+     *  The distances are in the vertex property "geodesic", and in an array
+     *  by the rows of laplacian(). A component of the mesh without a source
+     *  is at infinity. Polygons other than triangles are left out, as in
+     *  CLaplacian.
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CHeatGeodesic
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        CHeatGeodesic(M & mesh, int threads = 0)
+            : m_mesh(mesh), m_threads(threads),
+              m_heat(mesh, CLaplacian<M>::COTANGENT, threads), m_poisson(mesh, CLaplacian<M>::COTANGENT, threads),
+              m_property(mesh.template add_vertex_property<double>("geodesic", 0.0)) {}
+
+        /*! the time of the heat flow is factor h^2, h the mean edge length, 1 by default, at least (D / 300)^2 with D the size of the mesh */
+        void set_time_factor(double factor)
+        {
+            m_factor = factor;
+            m_assembled = false;
+        }
+        /*! the points moved, refactor at the next query */
+        void update() { m_assembled = false; }
+
+        /*!
+         *  Distances to the nearest of the sources
+         *  \return false if a system cannot be solved
+         */
+        bool compute(const std::vector<CVertex*> & sources);
+        bool compute(CVertex * source) { return compute(std::vector<CVertex*>(1, source)); }
+
+        /*! the distance of a vertex after compute() */
+        double distance(CVertex * v) const { return m_distance[laplacian().row(v)]; }
+        /*! the distances by the rows of laplacian() */
+        const std::vector<double> & distances() const { return m_distance; }
+        const CLaplacian<M> & laplacian() const { return m_heat.laplacian(); }
+
+    protected:
+        M & m_mesh;
+        int m_threads;
+        CPoissonSolver<M> m_heat;
+        CPoissonSolver<M> m_poisson;
+        CProperty<double> & m_property;
+        double m_factor = 1;
+
+        size_t m_version = 0;
+        bool m_built = false;
+        bool m_assembled = false;
+
+        //! rows of the corners of every triangle, and the corners of row i at [m_corner_outer[i], m_corner_outer[i + 1])
+        std::vector<int> m_tris;
+        std::vector<int> m_corner_outer;
+        std::vector<int> m_corners;
+        //! the component of every row
+        std::vector<int> m_component;
+        size_t m_components = 0;
+
+        //! the gradients of the hat functions of the corners of every triangle, and its area
+        std::vector<CPoint> m_gradients;
+        std::vector<double> m_areas;
+
+        //! the rows fixed to 0 in the Poisson equation, the first of every component
+        std::vector<int> m_fixed;
+        //! the flux of the unit field through every corner of every triangle
+        std::vector<double> m_flux;
+        std::vector<double> m_distance;
+
+        /*! lay out the triangles and the components, fix a vertex of every component */
+        void _build();
+        /*! the gradients and areas of the current points, the time of the flow */
+        void _assemble();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CHeatGeodesic<M>::_build()
+    {
+        const CLaplacian<M> & laplacian = m_heat.laplacian();
+        const size_t n = laplacian.size();
+
+        m_tris.clear();
+        for (CFace * f : m_mesh.faces())
+        {
+            CHalfEdge * he = f->halfedge();
+            if (he->next()->next()->next() != he) continue;
+            m_tris.push_back(laplacian.row(he->source()));
+            m_tris.push_back(laplacian.row(he->target()));
+            m_tris.push_back(laplacian.row(he->next()->target()));
+        }
+        m_corner_outer.assign(n + 1, 0);
+        for (int r : m_tris) m_corner_outer[r + 1]++;
+        for (size_t i = 0; i < n; i++) m_corner_outer[i + 1] += m_corner_outer[i];
+        m_corners.resize(m_tris.size());
+        std::vector<int> fill(m_corner_outer.begin(), m_corner_outer.end() - 1);
+        for (size_t c = 0; c < m_tris.size(); c++) m_corners[fill[m_tris[c]]++] = (int)c;
+
+        // the components by the pattern of L, the first row of each is fixed to 0
+        const std::vector<int> & outer = laplacian.outer();
+        const std::vector<int> & inner = laplacian.inner();
+        m_component.assign(n, -1);
+        m_components = 0;
+        std::vector<CVertex*> fixed;
+        std::vector<int> stack;
+        m_fixed.clear();
+        for (size_t s = 0; s < n; s++)
+        {
+            if (m_component[s] >= 0) continue;
+            const int c = (int)m_components++;
+            fixed.push_back(laplacian.vertex(s));
+            m_fixed.push_back((int)s);
+            m_component[s] = c;
+            stack.assign(1, (int)s);
+            while (!stack.empty())
+            {
+                const int i = stack.back();
+                stack.pop_back();
+                for (int k = outer[i]; k < outer[i + 1]; k++)
+                {
+                    if (m_component[inner[k]] >= 0) continue;
+                    m_component[inner[k]] = c;
+                    stack.push_back(inner[k]);
+                }
+            }
+        }
+        m_poisson.set_fixed(fixed);
+
+        m_gradients.resize(m_tris.size());
+        m_areas.resize(m_tris.size() / 3);
+        m_flux.resize(m_tris.size());
+        m_version = m_mesh.topology_version();
+        m_built = true;
+        m_assembled = false;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CHeatGeodesic<M>::_assemble()
+    {
+        const CLaplacian<M> & laplacian = m_heat.laplacian();
+        const size_t nt = m_areas.size();
+
+        // the gradient of the hat function of corner i is N x e_i / 2A, e_i the opposite edge
+        std::vector<double> lengths(nt);
+        parallel_for(nt, m_threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const int * r = &m_tris[3 * t];
+                const CPoint p[3] = { laplacian.vertex(r[0])->point(), laplacian.vertex(r[1])->point(), laplacian.vertex(r[2])->point() };
+                const CPoint n = (p[1] - p[0]) ^ (p[2] - p[0]);
+                const double twice = n.norm();
+                m_areas[t] = twice / 2;
+                lengths[t] = (p[1] - p[0]).norm() + (p[2] - p[1]).norm() + (p[0] - p[2]).norm();
+                for (int k = 0; k < 3; k++)
+                {
+                    // a degenerate triangle has no gradient
+                    m_gradients[3 * t + k] = twice > 0 ? (n ^ (p[(k + 2) % 3] - p[(k + 1) % 3])) / (twice * twice) : CPoint(0, 0, 0);
+                }
+            }
+        });
+        double h = 0;
+        for (double l : lengths) h += l;
+        h = nt ? h / (3 * nt) : 1;
+
+        // the heat falls off about as exp(-d / sqrt(t)), so on a fine mesh it underflows
+        // far from the sources, t is kept above (D / 300)^2, D the diagonal of the box
+        CPoint lo = laplacian.size() ? laplacian.vertex(0)->point() : CPoint(0, 0, 0), hi = lo;
+        for (size_t i = 0; i < laplacian.size(); i++)
+        {
+            const CPoint & p = laplacian.vertex(i)->point();
+            for (int k = 0; k < 3; k++)
+            {
+                lo[k] = std::min(lo[k], p[k]);
+                hi[k] = std::max(hi[k], p[k]);
+            }
+        }
+        const double reach = (hi - lo).norm() / 300;
+        m_heat.set_shift(1 / std::max(m_factor * h * h, reach * reach));
+        m_heat.update();
+        m_poisson.update();
+        m_assembled = true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    bool CHeatGeodesic<M>::compute(const std::vector<CVertex*> & sources)
+    {
+        m_heat.prepare();
+        if (!m_built || m_version != m_mesh.topology_version()) _build();
+        if (!m_assembled) _assemble();
+
+        const CLaplacian<M> & laplacian = m_heat.laplacian();
+        const size_t n = laplacian.size();
+
+        Eigen::MatrixXd b = Eigen::MatrixXd::Zero((Eigen::Index)n, 1), u;
+        for (CVertex * v : sources) b(laplacian.row(v), 0) = 1;
+        if (!m_heat.solve(b, u)) return false;
+
+        // the unit field against the gradient of the heat in every triangle, its flux through the corners
+        parallel_for(m_areas.size(), m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t t = s; t < e; t++)
+            {
+                const int * r = &m_tris[3 * t];
+                const CPoint * g = &m_gradients[3 * t];
+                const CPoint grad = g[0] * u(r[0], 0) + g[1] * u(r[1], 0) + g[2] * u(r[2], 0);
+                const double norm = grad.norm();
+                const CPoint x = norm > 0 ? grad / -norm : CPoint(0, 0, 0);
+                for (int k = 0; k < 3; k++) m_flux[3 * t + k] = m_areas[t] * (g[k] * x);
+            }
+        });
+        // -L d = div X, with d = 0 at the fixed vertices
+        parallel_for(n, m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t i = s; i < e; i++)
+            {
+                double sum = 0;
+                for (int k = m_corner_outer[i]; k < m_corner_outer[i + 1]; k++) sum += m_flux[m_corners[k]];
+                b(i, 0) = sum;
+            }
+        });
+        for (size_t c = 0; c < m_fixed.size(); c++) b(m_fixed[c], 0) = 0;
+        Eigen::MatrixXd d;
+        if (!m_poisson.solve(b, d)) return false;
+
+        // the distance is 0 at the nearest source of every component
+        std::vector<double> lowest(m_components, std::numeric_limits<double>::infinity());
+        for (CVertex * v : sources)
+        {
+            const int i = laplacian.row(v);
+            lowest[m_component[i]] = std::min(lowest[m_component[i]], d(i, 0));
+        }
+        m_distance.resize(n);
+        parallel_for(n, m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t i = s; i < e; i++)
+            {
+                const double low = lowest[m_component[i]];
+                m_distance[i] = low < std::numeric_limits<double>::infinity() ? d(i, 0) - low : low;
+                m_property[laplacian.vertex(i)] = m_distance[i];
+            }
+        });
+        return true;
+    }
+
+}; //namespace
+
+#endif
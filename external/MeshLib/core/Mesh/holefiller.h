@@ -0,0 +1,308 @@
+/*!
+*      \file holefiller.h
+*      \brief Close the holes of a triangle mesh with new triangles
+*
+*      The holes are the loops of CBoundary. Each is triangulated on its own,
+*      in parallel, over the points of its vertices only: up to a number of
+*      edges by the dynamic program of Liepa, that minimizes the largest
+*      dihedral angle and then the area, or the area alone, in O(n^3) time
+*      and O(n^2) memory; larger ones by clipping the ear with the smallest
+*      angle first. The triangles are then added to the CDynamicMesh one by
+*      one, each over an edge of the mesh, so a step of edits takes them all.
+*      No vertices are added, the fill is as coarse as its loop.
+*/
+
+#ifndef _MESHLIB_HOLEFILLER_H_
+#define _MESHLIB_HOLEFILLER_H_
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <queue>
+
+#include "dynamicmesh.h"
+#include "boundary.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CHoleFiller class, closes the holes of a CDynamicMesh in place
+     *  \tparam V, E, F, H vertex, edge, face and halfedge classes of the mesh
+     *  \tparam A, P its arena and fields, see CBaseMesh
+     */
+    template<typename V, typename E, typename F, typename H, typename A = CBlockArena, typename P = CAllFields>
+    class CHoleFiller
+    {
+    public:
+        using M = CDynamicMesh<V, E, F, H, A, P>;
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        /*! what the dynamic program minimizes */
+        enum Weight
+        {
+            MinDihedral,    //!< the largest dihedral angle between the triangles, then the area
+            MinArea         //!< the area
+        };
+
+        CHoleFiller(M & mesh) : m_mesh(mesh) {}
+
+        /*! loops with more edges are left open, 0 fills all, scans usually want their outer border kept */
+        size_t max_edges = 0;
+        /*! loops with up to this many edges are filled by the dynamic program, the others by ear clipping */
+        size_t dp_edges = 200;
+        Weight weight = MinDihedral;
+
+        /*!
+         *  Fill the holes
+         *  \param threads number of threads for the triangulations, 0 uses all hardware threads
+         *  \return number of holes closed. A loop through a vertex that is on the boundary
+         *  more than once, or that cannot be triangulated without an edge the mesh already has,
+         *  is left open
+         */
+        size_t fill(int threads = 0);
+
+    protected:
+        M & m_mesh;
+
+        /*! a hole, its vertices in the order of the new faces and the tips of the faces over its edges */
+        struct CHole
+        {
+            std::vector<CVertex*> vertices;
+            std::vector<CVertex*> tips;
+            /*! the triangles as vertex indices, parents before children, empty if it failed */
+            std::vector<int> triangles;
+        };
+
+        /*! the loops as holes, those that can be filled */
+        void _collect(std::vector<CHole> & holes);
+        /*! the triangulation of Liepa, false if every one needs an edge the mesh has */
+        bool _dp(CHole & hole);
+        /*! ears clipped from the smallest angle on, false if the clipping gets stuck */
+        bool _ears(CHole & hole);
+
+        /*! normal of the triangle a b c, its length twice the area */
+        static CPoint _normal(const CPoint & a, const CPoint & b, const CPoint & c) { return (b - a) ^ (c - a); }
+        /*! angle between two normals, pi if one is degenerate */
+        static double _dihedral(const CPoint & n0, const CPoint & n1)
+        {
+            const double l = n0.norm() * n1.norm();
+            if (l <= 0) return M_PI;
+            return std::acos(std::max(-1.0, std::min(1.0, (n0 * n1) / l)));
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    size_t CHoleFiller<V, E, F, H, A, P>::fill(int threads)
+    {
+        std::vector<CHole> holes;
+        _collect(holes);
+
+        // the triangulations only read the mesh
+        parallel_for(holes.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                CHole & hole = holes[i];
+                const bool ok = hole.vertices.size() <= dp_edges ? _dp(hole) : _ears(hole);
+                if (!ok) hole.triangles.clear();
+            }
+        }, 1);
+
+        size_t filled = 0;
+        for (CHole & hole : holes)
+        {
+            if (hole.triangles.empty()) continue;
+            const std::vector<CVertex*> & v = hole.vertices;
+            bool closed = true;
+            for (size_t t = 0; t < hole.triangles.size(); t += 3)
+            {
+                const int * k = hole.triangles.data() + t;
+                if (m_mesh.addTriangle(v[k[0]], v[k[1]], v[k[2]]) == NULL)
+                {
+                    closed = false;
+                    break;
+                }
+            }
+            if (closed) filled++;
+        }
+        return filled;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CHoleFiller<V, E, F, H, A, P>::_collect(std::vector<CHole> & holes)
+    {
+        CBoundary<V, E, F, H, A, P> boundary(&m_mesh);
+
+        // a vertex on two loops, or twice on one, is pinched, the loops through it are left open
+        std::vector<int> count;
+        for (auto * loop : boundary.loops())
+        {
+            for (CHalfEdge * he : loop->halfedges())
+            {
+                const size_t slot = he->source()->property_index();
+                if (slot >= count.size()) count.resize(slot + 1, 0);
+                count[slot]++;
+            }
+        }
+
+        for (auto * loop : boundary.loops())
+        {
+            const size_t n = loop->halfedges().size();
+            if (n < 3 || (max_edges > 0 && n > max_edges)) continue;
+            bool pinched = false;
+            for (CHalfEdge * he : loop->halfedges()) pinched = pinched || count[he->source()->property_index()] > 1;
+            if (pinched) continue;
+
+            // the loop runs along the faces, the hole the other way round
+            CHole hole;
+            hole.vertices.reserve(n);
+            hole.tips.reserve(n);
+            for (CHalfEdge * he : loop->halfedges())
+            {
+                hole.vertices.push_back(he->source());
+                hole.tips.push_back(he->next()->target());
+            }
+            std::reverse(hole.vertices.begin(), hole.vertices.end());
+            // the edge from vertex i to i + 1 of the hole is the halfedge n - 2 - i of the loop
+            std::reverse(hole.tips.begin(), hole.tips.end());
+            std::rotate(hole.tips.begin(), hole.tips.begin() + 1, hole.tips.end());
+            holes.push_back(hole);
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    //W(i, k), the weight of the polygon i..k closed by the edge (i, k), is the least over m of
+    //W(i, m) + W(m, k) + the triangle (i, m, k), where + takes the larger angle and adds the areas
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CHoleFiller<V, E, F, H, A, P>::_dp(CHole & hole)
+    {
+        const std::vector<CVertex*> & v = hole.vertices;
+        const int n = (int)v.size();
+        const bool dihedral = weight == MinDihedral;
+        std::vector<double> angle(n * n, 0.0), area(n * n, 0.0);
+        std::vector<int> apex(n * n, -1);
+        auto at = [n](int i, int k) { return i * n + k; };
+        auto point = [&](int i) -> const CPoint & { return v[i]->point(); };
+        // the normal of the triangle over the edge i -> k, from the mesh on the boundary, else the sub polygon
+        auto outer = [&](int i, int k) -> CPoint
+        {
+            if (k == i + 1) return _normal(point(k), point(i), hole.tips[i]->point());
+            if (i == 0 && k == n - 1) return _normal(point(i), point(k), hole.tips[n - 1]->point());
+            return _normal(point(i), point(apex[at(i, k)]), point(k));
+        };
+
+        for (int len = 2; len < n; len++)
+        {
+            for (int i = 0; i + len < n; i++)
+            {
+                const int k = i + len;
+                // a diagonal the mesh has elsewhere would be its third face
+                if (!(i == 0 && k == n - 1) && m_mesh.edge(v[i], v[k]) != NULL) continue;
+                double best_angle = DBL_MAX, best_area = DBL_MAX;
+                for (int m = i + 1; m < k; m++)
+                {
+                    if ((m > i + 1 && apex[at(i, m)] < 0) || (k > m + 1 && apex[at(m, k)] < 0)) continue;
+                    const CPoint normal = _normal(point(i), point(m), point(k));
+                    double a = std::max(angle[at(i, m)], angle[at(m, k)]);
+                    if (dihedral)
+                    {
+                        a = std::max(a, _dihedral(normal, outer(i, m)));
+                        a = std::max(a, _dihedral(normal, outer(m, k)));
+                        if (len == n - 1) a = std::max(a, _dihedral(normal, outer(i, k)));
+                    }
+                    const double s = area[at(i, m)] + area[at(m, k)] + normal.norm() / 2;
+                    if (a < best_angle || (a == best_angle && s < best_area))
+                    {
+                        best_angle = a;
+                        best_area = s;
+                        apex[at(i, k)] = m;
+                    }
+                }
+                angle[at(i, k)] = best_angle;
+                area[at(i, k)] = best_area;
+            }
+        }
+        if (apex[at(0, n - 1)] < 0) return false;
+
+        // parents first, each triangle is added over an edge that is there by then
+        std::vector<std::pair<int, int>> stack(1, std::make_pair(0, n - 1));
+        while (!stack.empty())
+        {
+            const int i = stack.back().first, k = stack.back().second;
+            stack.pop_back();
+            if (k - i < 2) continue;
+            const int m = apex[at(i, k)];
+            hole.triangles.insert(hole.triangles.end(), { i, m, k });
+            stack.push_back(std::make_pair(m, k));
+            stack.push_back(std::make_pair(i, m));
+        }
+        return true;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CHoleFiller<V, E, F, H, A, P>::_ears(CHole & hole)
+    {
+        const std::vector<CVertex*> & v = hole.vertices;
+        const int n = (int)v.size();
+        std::vector<int> prev(n), next(n), version(n, 0);
+        for (int i = 0; i < n; i++)
+        {
+            prev[i] = (i + n - 1) % n;
+            next[i] = (i + 1) % n;
+        }
+
+        // the angles are measured about the normal of the hole, Newell's
+        CPoint up(0, 0, 0);
+        for (int i = 0; i < n; i++) up += v[i]->point() ^ v[next[i]]->point();
+
+        // the inner angle at i, past 2 pi if the diagonal is an edge of the mesh already
+        auto ear = [&](int i) -> double
+        {
+            const CPoint d0 = v[i]->point() - v[prev[i]]->point();
+            const CPoint d1 = v[next[i]]->point() - v[i]->point();
+            const CPoint c = d0 ^ d1;
+            const double turn = std::atan2(c * up >= 0 ? c.norm() : -c.norm(), d0 * d1);
+            const double inner = M_PI - turn;
+            return m_mesh.edge(v[prev[i]], v[next[i]]) != NULL ? inner + 4 * M_PI : inner;
+        };
+        typedef std::pair<double, std::pair<int, int>> CEar;
+        std::priority_queue<CEar, std::vector<CEar>, std::greater<CEar>> ears;
+        for (int i = 0; i < n; i++) ears.push(CEar(ear(i), std::make_pair(i, 0)));
+
+        for (int left = n; left > 3; )
+        {
+            if (ears.empty()) return false;
+            const CEar top = ears.top();
+            ears.pop();
+            const int i = top.second.first;
+            if (top.second.second != version[i]) continue;
+            if (top.first >= 4 * M_PI) return false;
+
+            const int a = prev[i], b = next[i];
+            hole.triangles.insert(hole.triangles.end(), { a, i, b });
+            next[a] = b;
+            prev[b] = a;
+            version[i] = -1;
+            left--;
+            for (int j : { a, b }) ears.push(CEar(ear(j), std::make_pair(j, ++version[j])));
+        }
+
+        // the last three
+        int i = 0;
+        while (version[i] < 0) i++;
+        hole.triangles.insert(hole.triangles.end(), { prev[i], i, next[i] });
+        return true;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,130 @@
+/*!
+*      \file idmap.h
+*      \brief Id to element lookup, flat for dense ids, hashed for sparse ones
+*/
+
+#ifndef _MESHLIB_IDMAP_H_
+#define _MESHLIB_IDMAP_H_
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CIdMap class, maps element ids to element pointers
+     *
+     *  Ids read from .obj, .off and .tet files run from 0 or 1 up to the number
+     *  of elements, they index a flat vector. As soon as an id lands far beyond
+     *  the number of elements, as in edited .m files, the map moves to a hash
+     *  table.
+     */
+    template<typename T>
+    class CIdMap
+    {
+    public:
+        /*! the element with this id, NULL if there is none */
+        T * find(int id) const
+        {
+            if (!m_sparse) return (id >= 0 && id < (int)m_dense.size()) ? m_dense[id] : NULL;
+            typename std::unordered_map<int, T*>::const_iterator it = m_hash.find(id);
+            return it == m_hash.end() ? NULL : it->second;
+        }
+        T * operator[](int id) const { return find(id); }
+
+        /*!
+         *  Add an element
+         *  \return false if the id is taken, the old element is kept like std::map::insert does
+         */
+        bool insert(int id, T * t)
+        {
+            if (!m_sparse && (id < 0 || (size_t)id >= _dense_limit())) _to_sparse();
+
+            if (m_sparse)
+            {
+                if (!m_hash.insert(std::make_pair(id, t)).second) return false;
+                m_size++;
+                return true;
+            }
+
+            if ((size_t)id >= m_dense.size()) m_dense.resize(std::max<size_t>(id + 1, 2 * m_dense.size()), NULL);
+            if (m_dense[id] != NULL) return false;
+            m_dense[id] = t;
+            m_size++;
+            return true;
+        }
+
+        /*! remove the element with this id */
+        bool erase(int id)
+        {
+            if (m_sparse)
+            {
+                if (!m_hash.erase(id)) return false;
+            }
+            else
+            {
+                if (id < 0 || id >= (int)m_dense.size() || m_dense[id] == NULL) return false;
+                m_dense[id] = NULL;
+            }
+            m_size--;
+            return true;
+        }
+
+        /*! make room for ids up to n */
+        void reserve(size_t n)
+        {
+            if (m_sparse) m_hash.reserve(n);
+            else if (n + 1 > m_dense.size()) m_dense.resize(n + 1, NULL);
+        }
+
+        void clear()
+        {
+            m_dense.clear();
+            m_hash.clear();
+            m_size = 0;
+            m_sparse = false;
+        }
+
+        size_t size() const { return m_size; }
+        /*! whether the ids are looked up in the hash table */
+        bool sparse() const { return m_sparse; }
+        /*! bytes of the vector, or of the buckets and, estimated, the nodes of the hash table */
+        size_t memory() const
+        {
+            return m_dense.capacity() * sizeof(T*) + m_hash.bucket_count() * sizeof(void*) +
+                m_hash.size() * (sizeof(typename std::unordered_map<int, T*>::value_type) + sizeof(void*));
+        }
+
+    protected:
+        /*! ids below this stay in the flat vector */
+        size_t _dense_limit() const
+        {
+            // a copy, std::max takes its arguments by reference
+            const size_t least = s_min_dense;
+            return std::max<size_t>(least, 2 * (m_size + 1));
+        }
+
+        void _to_sparse()
+        {
+            m_hash.reserve(m_size + 1);
+            for (size_t i = 0; i < m_dense.size(); i++)
+            {
+                if (m_dense[i]) m_hash.insert(std::make_pair((int)i, m_dense[i]));
+            }
+            std::vector<T*>().swap(m_dense);
+            m_sparse = true;
+        }
+
+        static constexpr size_t s_min_dense = 4096;
+
+        std::vector<T*>             m_dense;
+        std::unordered_map<int, T*> m_hash;
+        size_t                      m_size = 0;
+        bool                        m_sparse = false;
+    };
+
+}; //namespace
+
+#endif
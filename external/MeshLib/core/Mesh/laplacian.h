@@ -0,0 +1,318 @@
+/*!
+*      \file laplacian.h
+*      \brief Laplacian and lumped mass matrix of a mesh in compressed rows
+*
+*      The pattern, a row per vertex with its neighbors and itself, is laid
+*      out once from the connectivity, with the vertices of every edge and
+*      of the corners opposite to it, and the triangles around every vertex.
+*      Assembling reads the points into an array and fills the values from
+*      it in parallel, so iterative methods that move the points repeat only
+*      that part. The rows are those of Eigen::SparseMatrix<double, RowMajor,
+*      int>, which views them in place when MESHLIB_EIGEN is defined.
+*/
+
+#ifndef _MESHLIB_LAPLACIAN_H_
+#define _MESHLIB_LAPLACIAN_H_
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "mesh.h"
+#include "../parser/parallel.h"
+
+#ifdef MESHLIB_EIGEN
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CLaplacian class, the Laplacian L and lumped mass M of a mesh
+     *
+     *  L(i, j) is the weight of the edge ij and L(i, i) minus the sum of the
+     *  weights in row i, so L is symmetric negative semi-definite. The mass
+     *  of a vertex is a third of the area of its triangles.
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CLaplacian
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        /*! edge weights */
+        enum Weights
+        {
+            UNIFORM,   //!< 1 per edge
+            COTANGENT  //!< half the sum of the cotangents of the angles opposite the edge in its triangles
+        };
+
+        CLaplacian(M & mesh) : m_mesh(mesh) {}
+
+        /*!
+         *  Lay out the pattern, again after the connectivity changed
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void build(int threads = 0);
+        /*!
+         *  Fill the values from the points, the pattern is built on the first call
+         *  \param weights how the edges are weighted, polygons other than triangles add no cotangents
+         */
+        void assemble(Weights weights = COTANGENT, int threads = 0);
+
+        /*! number of rows and columns, the number of vertices when built */
+        size_t size() const { return m_vertices.size(); }
+        /*! the vertex of row i, and the row of a vertex */
+        CVertex * vertex(size_t i) const { return m_vertices[i]; }
+        int row(CVertex * v) const { return m_row[v->property_index()]; }
+
+        /*! the entries of row i are at [outer()[i], outer()[i + 1]), columns ascending */
+        const std::vector<int> & outer() const { return m_outer; }
+        const std::vector<int> & inner() const { return m_inner; }
+        const std::vector<double> & values() const { return m_values; }
+        /*! the diagonal of the lumped mass matrix */
+        const std::vector<double> & mass() const { return m_mass; }
+        /*!
+         *  Replace the values by those of another symmetric matrix of the pattern, Hessians of
+         *  energies of the edges say, until the next assemble
+         */
+        void set_values(const std::vector<double> & values)
+        {
+            if (values.size() == m_values.size()) m_values = values;
+        }
+
+#ifdef MESHLIB_EIGEN
+        typedef Eigen::SparseMatrix<double, Eigen::RowMajor, int> CSparse;
+
+        /*! L in place, valid until the next build */
+        Eigen::Map<const CSparse> eigen_matrix() const
+        {
+            return Eigen::Map<const CSparse>((int)size(), (int)size(), (int)m_values.size(),
+                m_outer.data(), m_inner.data(), m_values.data());
+        }
+        /*! the diagonal of M in place, M itself is eigen_mass().asDiagonal() */
+        Eigen::Map<const Eigen::VectorXd> eigen_mass() const
+        {
+            return Eigen::Map<const Eigen::VectorXd>(m_mass.data(), (Eigen::Index)m_mass.size());
+        }
+#endif
+
+    protected:
+        M & m_mesh;
+        bool m_built = false;
+
+        std::vector<CVertex*> m_vertices;
+        //! row of each vertex slot, -1 for a slot of no vertex
+        std::vector<int> m_row;
+
+        std::vector<int> m_outer;
+        std::vector<int> m_inner;
+        std::vector<double> m_values;
+        //! edge of each entry, -1 on the diagonal
+        std::vector<int> m_entry_edge;
+
+        //! rows of the ends of every edge and of the corners opposite to it, -1 on a side with no triangle
+        std::vector<int> m_edge_rows;
+        std::vector<double> m_weights;
+
+        //! rows of the corners of every triangle, and the triangles of row i at [m_tri_outer[i], m_tri_outer[i + 1])
+        std::vector<int> m_tris;
+        std::vector<int> m_tri_outer;
+        std::vector<int> m_vertex_tris;
+        std::vector<double> m_areas;
+        std::vector<double> m_mass;
+
+        std::vector<CPoint> m_points;
+
+        /*! the corner opposite to he in its face, -1 if it has none or is no triangle */
+        int _opposite(CHalfEdge * he) const
+        {
+            if (he == NULL || he->face() == NULL || he->next()->next()->next() != he) return -1;
+            return row(he->next()->target());
+        }
+        /*! cotangent of the angle at o between a and b */
+        static double _cotangent(const CPoint & a, const CPoint & b, const CPoint & o)
+        {
+            const CPoint u = a - o, v = b - o;
+            const double s = (u ^ v).norm();
+            // a degenerate triangle adds nothing rather than infinity
+            return s > 0 ? (u * v) / s : 0;
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CLaplacian<M>::build(int threads)
+    {
+        m_vertices.clear();
+        size_t slots = 0;
+        for (CVertex * v : m_mesh.vertices())
+        {
+            m_vertices.push_back(v);
+            slots = std::max(slots, v->property_index() + 1);
+        }
+        const size_t n = m_vertices.size();
+        m_row.assign(slots, -1);
+        for (size_t i = 0; i < n; i++) m_row[m_vertices[i]->property_index()] = (int)i;
+
+        // edges with the corners across them, each counted in the rows of both ends
+        std::vector<CEdge*> edges;
+        for (CEdge * e : m_mesh.edges()) edges.push_back(e);
+        m_edge_rows.resize(4 * edges.size());
+        parallel_for(edges.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                CHalfEdge * h0 = edges[k]->halfedge(0);
+                CHalfEdge * h1 = edges[k]->halfedge(1);
+                int * r = &m_edge_rows[4 * k];
+                r[0] = row(h0->source());
+                r[1] = row(h0->target());
+                r[2] = _opposite(h0);
+                r[3] = _opposite(h1);
+            }
+        });
+        m_weights.resize(edges.size());
+
+        m_outer.assign(n + 1, 0);
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            m_outer[m_edge_rows[4 * k] + 1]++;
+            m_outer[m_edge_rows[4 * k + 1] + 1]++;
+        }
+        // one more for the diagonal
+        for (size_t i = 0; i < n; i++) m_outer[i + 1] += m_outer[i] + 1;
+
+        const size_t nnz = (size_t)m_outer[n];
+        m_inner.resize(nnz);
+        m_entry_edge.resize(nnz);
+        std::vector<int> fill(m_outer.begin(), m_outer.end() - 1);
+        for (size_t i = 0; i < n; i++)
+        {
+            m_inner[fill[i]] = (int)i;
+            m_entry_edge[fill[i]++] = -1;
+        }
+        for (size_t k = 0; k < edges.size(); k++)
+        {
+            const int i = m_edge_rows[4 * k], j = m_edge_rows[4 * k + 1];
+            m_inner[fill[i]] = j;
+            m_entry_edge[fill[i]++] = (int)k;
+            m_inner[fill[j]] = i;
+            m_entry_edge[fill[j]++] = (int)k;
+        }
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            std::vector<std::pair<int, int>> entries;
+            for (size_t i = b; i < e; i++)
+            {
+                entries.clear();
+                for (int k = m_outer[i]; k < m_outer[i + 1]; k++) entries.push_back(std::make_pair(m_inner[k], m_entry_edge[k]));
+                std::sort(entries.begin(), entries.end());
+                for (int k = m_outer[i]; k < m_outer[i + 1]; k++)
+                {
+                    m_inner[k] = entries[k - m_outer[i]].first;
+                    m_entry_edge[k] = entries[k - m_outer[i]].second;
+                }
+            }
+        }, 1 << 12);
+        m_values.assign(nnz, 0.0);
+
+        // the triangles, and those around every vertex
+        m_tris.clear();
+        for (CFace * f : m_mesh.faces())
+        {
+            CHalfEdge * he = f->halfedge();
+            if (he->next()->next()->next() != he) continue;
+            m_tris.push_back(row(he->source()));
+            m_tris.push_back(row(he->target()));
+            m_tris.push_back(row(he->next()->target()));
+        }
+        const size_t nt = m_tris.size() / 3;
+        m_tri_outer.assign(n + 1, 0);
+        for (int r : m_tris) m_tri_outer[r + 1]++;
+        for (size_t i = 0; i < n; i++) m_tri_outer[i + 1] += m_tri_outer[i];
+        m_vertex_tris.resize(m_tris.size());
+        fill.assign(m_tri_outer.begin(), m_tri_outer.end() - 1);
+        for (size_t t = 0; t < m_tris.size(); t++) m_vertex_tris[fill[m_tris[t]]++] = (int)(t / 3);
+        m_areas.resize(nt);
+        m_mass.assign(n, 0.0);
+
+        m_built = true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CLaplacian<M>::assemble(Weights weights, int threads)
+    {
+        if (!m_built) build(threads);
+        const size_t n = size();
+
+        m_points.resize(n);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) m_points[i] = m_vertices[i]->point();
+        });
+
+        parallel_for(m_weights.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                if (weights == UNIFORM)
+                {
+                    m_weights[k] = 1;
+                    continue;
+                }
+                const int * r = &m_edge_rows[4 * k];
+                double w = 0;
+                for (int s = 2; s < 4; s++)
+                {
+                    if (r[s] >= 0) w += _cotangent(m_points[r[0]], m_points[r[1]], m_points[r[s]]);
+                }
+                m_weights[k] = w / 2;
+            }
+        });
+
+        parallel_for(m_areas.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const CPoint & a = m_points[m_tris[3 * t]];
+                m_areas[t] = ((m_points[m_tris[3 * t + 1]] - a) ^ (m_points[m_tris[3 * t + 2]] - a)).norm() / 2;
+            }
+        });
+
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                double sum = 0;
+                int diagonal = -1;
+                for (int k = m_outer[i]; k < m_outer[i + 1]; k++)
+                {
+                    const int edge = m_entry_edge[k];
+                    if (edge < 0)
+                    {
+                        diagonal = k;
+                        continue;
+                    }
+                    m_values[k] = m_weights[edge];
+                    sum += m_weights[edge];
+                }
+                m_values[diagonal] = -sum;
+
+                double area = 0;
+                for (int k = m_tri_outer[i]; k < m_tri_outer[i + 1]; k++) area += m_areas[m_vertex_tris[k]];
+                m_mass[i] = area / 3;
+            }
+        });
+    }
+
+}; //namespace
+
+#endif
@@ -21,10 +21,41 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <array>
+#include <atomic>
 
 #include "../Geometry/Point.h"
 #include "../Geometry/Point2.h"
 #include "../parser/strutil.h"
+#include "../parser/objparser.h"
+#include "../parser/smv.h"
+#include "../parser/ckp.h"
+#include "../parser/writer.h"
+#include "../parser/parallel.h"
+#include "../parser/traitstr.h"
+#include "../parser/traits_io.h"
+#include "../parser/mb.h"
+#include "../parser/cmv.h"
+#include "../parser/ply.h"
+#include "../parser/gltf.h"
+#include "idmap.h"
+#include "allocator.h"
+#include "elemlist.h"
+#include "circulator.h"
+#include "edgehash.h"
+#include "repair.h"
+#include "../Geometry/PointWelder.h"
+#include "../Geometry/MortonOrder.h"
+
+#ifdef MESHLIB_EIGEN
+#include <Eigen/Core>
+#endif
+#include "property.h"
+#include "fields.h"
 
 namespace MeshLib {
 
@@ -33,6 +64,42 @@ namespace MeshLib {
     class CFace {};
     class CHalfEdge {};
 
+    /*!
+    * \brief CMemoryReport, bytes a mesh holds by what they are for, see CBaseMesh::memory_report
+    */
+    struct CMemoryReport
+    {
+        //! the elements, slabs of the allocator with their free slots
+        size_t vertices = 0;
+        size_t edges = 0;
+        size_t faces = 0;
+        size_t halfedges = 0;
+        //! the element lists
+        size_t lists = 0;
+        //! the id maps and the edge table
+        size_t maps = 0;
+        //! the cached adjacency vectors of the vertices and faces
+        size_t adjacency = 0;
+        //! the trait strings built from the text
+        size_t strings = 0;
+        //! the property arrays
+        size_t properties = 0;
+        //! the mapped .m files the trait strings refer to, pages of the file rather than heap
+        size_t mapped = 0;
+
+        /*! bytes on the heap, without the mapped files */
+        size_t total() const { return vertices + edges + faces + halfedges + lists + maps + adjacency + strings + properties; }
+
+        /*! a line per part, in MB */
+        void print(std::ostream & os) const
+        {
+            const char * names[] = { "vertices", "edges", "faces", "halfedges", "lists", "maps", "adjacency", "strings", "properties", "mapped" };
+            const size_t bytes[] = { vertices, edges, faces, halfedges, lists, maps, adjacency, strings, properties, mapped };
+            for (int i = 0; i < 10; i++) os << names[i] << " " << bytes[i] / 1048576.0 << " MB" << std::endl;
+            os << "total " << total() / 1048576.0 << " MB" << std::endl;
+        }
+    };
+
     /*!
     * \brief CBaseMesh, base class for all types of mesh classes
     *
@@ -46,8 +113,21 @@ namespace MeshLib {
     * \tparam E     edge class, derived from MeshLib::CEdge     class
     * \tparam F     face class, derived from MeshLib::CFace     class
     * \tparam H halfedge class, derived from MeshLib::CHalfEdge class
+    * \tparam A allocation policy of the elements, see allocator.h
+    * \tparam P the optional fields of the elements, see CMeshFields, a mesh
+    *           that is only drawn leaves out the trait strings and caches
+    *
+    *  Concurrent reads: the halfedge navigation, the most_c*w_*_halfedge
+    *  accessors, the *_range() circulations, point(), id(), boundary(), the
+    *  element lists and the lookups vertex(id), face(id), edge(v0, v1) and
+    *  halfedge(v0, v1) never write, any number of threads may use them at once.
+    *  string() and the cached adjacency vectors are filled on first use, call
+    *  freeze() before sharing the mesh to use them from several threads too.
+    *  Any edit, create_*, delete_face, read_* or the dynamic mesh operators,
+    *  needs the mesh to itself and ends the frozen state, clear_adjacency() of
+    *  the touched elements and freeze() again before the next parallel pass.
     */
-    template<typename V = CVertex, typename E = CEdge, typename F = CFace, typename H = CHalfEdge>
+    template<typename V = CVertex, typename E = CEdge, typename F = CFace, typename H = CHalfEdge, typename A = CBlockArena, typename P = CAllFields>
     class CBaseMesh
     {
     public:
@@ -56,16 +136,95 @@ namespace MeshLib {
         class CFace;
         class CHalfEdge;
 
+        /*!
+        Circulation policies of the allocation free ranges, see circulator.h
+        */
+        struct COutSweep
+        {
+            static const bool s_tail = false;
+            static CHalfEdge * step(CHalfEdge * he) { return he->ccw_rotate_about_source(); }
+            static CHalfEdge * value(CHalfEdge * he) { return he; }
+            static CHalfEdge * tail(CHalfEdge * he) { return he; }
+        };
+        struct CInSweep : COutSweep
+        {
+            static CHalfEdge * step(CHalfEdge * he) { return he->clw_rotate_about_target(); }
+        };
+        //the fan of a boundary vertex ends before its last neighbor and edge
+        struct CVertexVertices : COutSweep
+        {
+            static const bool s_tail = true;
+            static CVertex * value(CHalfEdge * he) { return he->target(); }
+            static CVertex * tail(CHalfEdge * he) { return he->prev()->source(); }
+        };
+        struct CVertexEdges : COutSweep
+        {
+            static const bool s_tail = true;
+            static CEdge * value(CHalfEdge * he) { return he->edge(); }
+            static CEdge * tail(CHalfEdge * he) { return he->prev()->edge(); }
+        };
+        struct CVertexFaces : COutSweep
+        {
+            static CFace * value(CHalfEdge * he) { return he->face(); }
+            static CFace * tail(CHalfEdge * he) { return he->face(); }
+        };
+        struct CFaceHalfedges : COutSweep
+        {
+            static CHalfEdge * step(CHalfEdge * he) { return he->next(); }
+        };
+        struct CFaceVertices : CFaceHalfedges
+        {
+            static CVertex * value(CHalfEdge * he) { return he->vertex(); }
+            static CVertex * tail(CHalfEdge * he) { return he->vertex(); }
+        };
+        struct CFaceEdges : CFaceHalfedges
+        {
+            static CEdge * value(CHalfEdge * he) { return he->edge(); }
+            static CEdge * tail(CHalfEdge * he) { return he->edge(); }
+        };
+
+        /*! adjacency vectors of a vertex, only allocated by the cached accessors */
+        struct CVertexAdjacency
+        {
+            std::vector<CEdge*>     edges;
+            std::vector<CVertex*>   vertices;
+            std::vector<CFace*>     faces;
+            std::vector<CHalfEdge*> halfedges;
+            std::vector<CHalfEdge*> in_halfedges;
+            std::vector<CHalfEdge*> out_halfedges;
+
+            size_t memory() const
+            {
+                return (edges.capacity() + vertices.capacity() + faces.capacity() + halfedges.capacity() +
+                    in_halfedges.capacity() + out_halfedges.capacity()) * sizeof(void*);
+            }
+        };
+        /*! adjacency vectors of a face */
+        struct CFaceAdjacency
+        {
+            std::vector<CEdge*>     edges;
+            std::vector<CHalfEdge*> halfedges;
+            std::vector<CVertex*>   vertices;
+
+            size_t memory() const { return (edges.capacity() + halfedges.capacity() + vertices.capacity()) * sizeof(void*); }
+        };
+
+        //the classes given with the fields of P chained onto them, see fields.h
+        typedef CAdjacencyField<CStringField<CNormalField<CUVField<V, P::s_uv>, P::s_normal>, P::s_string>, CVertexAdjacency, P::s_adjacency> _CVertexBase;
+        typedef CStringField<E, P::s_string> _CEdgeBase;
+        typedef CAdjacencyField<CStringField<F, P::s_string>, CFaceAdjacency, P::s_adjacency && P::s_degree == 0> _CFaceBase;
+        typedef CStringField<CNormalField<CUVField<H, P::s_uv>, P::s_normal>, P::s_string> _CHalfEdgeBase;
+
         /*!
         \brief CVertex class, which is the base class of all kinds of vertex classes
         */
-        class CVertex : public V
+        class CVertex : public _CVertexBase
         {
         public:
             /*!
             CVertex constructor
             */
-            CVertex() { m_halfedge = NULL; m_boundary = false; }
+            CVertex() { m_halfedge = NULL; m_boundary = false; m_touched = false; m_dangling = false; }
             /*!
             CVertex destructor
             */
@@ -74,12 +233,6 @@ namespace MeshLib {
             /*! The point of the vertex
             */
             CPoint & point() { return m_point; }
-            /*! The normal of the vertex
-            */
-            CPoint & normal() { return m_normal; }
-            /*! The texutre coordinates of the vertex
-            */
-            CPoint2 & uv() { return m_uv; }
 
             /*! The most counter clockwise outgoing halfedge of the vertex .
             */
@@ -92,16 +245,9 @@ namespace MeshLib {
                 }
 
                 //for boundary vertex
-                CHalfEdge * he = m_halfedge->next();
-                //get the out halfedge which is the next halfedge of the most ccw in halfedge
-                CHalfEdge * ne = he->ccw_rotate_about_source();
+                //get the out halfedge which is the next halfedge of the most ccw in halfedge,
                 //rotate ccwly around the source vertex
-                while (ne != NULL)
-                {
-                    he = ne;
-                    ne = he->ccw_rotate_about_source();
-                }
-                return he;
+                return _rotate(m_halfedge->next(), [](CHalfEdge * he) { return he->ccw_rotate_about_source(); });
             }
             /*! The most clockwise outgoing halfedge of the vertex .
             */
@@ -112,18 +258,8 @@ namespace MeshLib {
                 {
                     return most_ccw_out_halfedge()->ccw_rotate_about_source();  //most ccw out halfedge rotate ccwly once about the source
                 }
-                //get one out halfedge
-                CHalfEdge * he = m_halfedge->next();
-                //rotate the out halfedge clwly about the source
-                CHalfEdge * ne = he->clw_rotate_about_source();
-
-                while (ne != NULL)
-                {
-                    he = ne;
-                    ne = he->clw_rotate_about_source();
-                }
-
-                return he;
+                //get one out halfedge, rotate it clwly about the source
+                return _rotate(m_halfedge->next(), [](CHalfEdge * he) { return he->clw_rotate_about_source(); });
             }
             /*! The most counter clockwise incoming halfedge of the vertex.
             */
@@ -135,16 +271,9 @@ namespace MeshLib {
                     return m_halfedge; //current half edge is the most ccw in halfedge
                 }
 
-                //for boundary vertex
-                CHalfEdge * he = m_halfedge->ccw_rotate_about_target();
-                //rotate to the most ccw in halfedge
-                while (he != NULL)
-                {
-                    m_halfedge = he;
-                    he = m_halfedge->ccw_rotate_about_target();
-                }
-                // the halfedge of the vertex becomes the most ccw in halfedge
-                return m_halfedge;
+                //for boundary vertex, rotate to the most ccw in halfedge, label_boundary
+                //already put m_halfedge there, so this is usually no step at all
+                return _rotate(m_halfedge, [](CHalfEdge * he) { return he->ccw_rotate_about_target(); });
             }
             /*! The most clockwise incoming halfedge of the vertex.
             */
@@ -155,24 +284,13 @@ namespace MeshLib {
                 {
                     return most_ccw_in_halfedge()->ccw_rotate_about_target(); //the most ccw in halfedge rotate ccwly once to get the most clw in halfedge
                 }
-                //for boundary vertex
-                CHalfEdge * he = m_halfedge->clw_rotate_about_target();
-                //rotate to the most clw in halfedge
-                while (he != NULL)
-                {
-                    m_halfedge = he;
-                    he = m_halfedge->clw_rotate_about_target();
-                }
-
-                return m_halfedge;
+                //for boundary vertex, rotate to the most clw in halfedge
+                return _rotate(m_halfedge, [](CHalfEdge * he) { return he->clw_rotate_about_target(); });
             }
 
             /*! One incoming halfedge of the vertex .
             */
             CHalfEdge * & halfedge() { return m_halfedge; }
-            /*! the string of the vertex.
-            */
-            std::string & string() { return m_string; }
 
             bool & touched() { return m_touched; }
             bool & dangled() { return m_dangling; }
@@ -191,104 +309,93 @@ namespace MeshLib {
             */
             void _from_string() {}
 
-            /*! Adjacent edges
+            /*! Adjacent edges, ccw, cached until clear_adjacency()
             */
             std::vector<CEdge*>   & edges()
             {
-                if (m_edges.empty())
-                {
-                    m_halfedges = this->halfedges();
-                    for (CHalfEdge * he : m_halfedges) m_edges.push_back(he->edge());
-                    if (this->boundary())
-                    {
-                        CHalfEdge * he = this->most_ccw_in_halfedge();
-                        m_edges.push_back(he->edge());
-                    }
-                }
-                return m_edges;
+                CVertexAdjacency & a = this->_adjacency();
+                if (a.edges.empty()) for (CEdge * e : edges_range()) a.edges.push_back(e);
+                return a.edges;
             }
-            /*! Adjacent vertices
+            /*! Adjacent vertices, ccw, cached until clear_adjacency()
             */
             std::vector<CVertex*> & vertices()
             {
-                if (m_vertices.empty())
-                {
-                    m_halfedges = this->halfedges();
-                    for (CHalfEdge * he : m_halfedges) m_vertices.push_back(he->target());
-                    if (this->boundary())
-                    {
-                        CHalfEdge * he = this->most_ccw_in_halfedge();
-                        m_vertices.push_back(he->source());
-                    }
-                }
-                return m_vertices;
+                CVertexAdjacency & a = this->_adjacency();
+                if (a.vertices.empty()) for (CVertex * v : vertices_range()) a.vertices.push_back(v);
+                return a.vertices;
             }
-            /* Adjacent faces
+            /* Adjacent faces, ccw, cached until clear_adjacency()
             */
             std::vector<CFace*>   & faces()
             {
-                if (m_faces.empty())
-                {
-                    m_halfedges = this->halfedges();
-                    for (CHalfEdge * he : m_halfedges) m_faces.push_back(he->face());
-                }
-                return m_faces;
+                CVertexAdjacency & a = this->_adjacency();
+                if (a.faces.empty()) for (CFace * f : faces_range()) a.faces.push_back(f);
+                return a.faces;
             }
 
             /*! Adjacent halfedges, direction == 1 means out, direction == -1 means in
             */
             std::vector<CHalfEdge*> & halfedges(int direction = 1)
             {
-                if (!m_halfedges.empty() && halfedge_direction == direction) return m_halfedges;
-                m_halfedges.clear();
-                if (direction == -1) // in halfedges
-                {
-                    CHalfEdge * he0 = this->most_ccw_in_halfedge();
-                    CHalfEdge * he = he0;
-                    m_halfedges.push_back(he);
-                    while (he)
-                    {
-                        he = he->clw_rotate_about_target();
-                        if (!he || he == he0) break;
-                        m_halfedges.push_back(he);
-                    }
-                }
-                else // out halfedge
+                CVertexAdjacency & a = this->_adjacency();
+                if (direction == -1)
                 {
-                    CHalfEdge * he0 = this->most_clw_out_halfedge();
-                    CHalfEdge * he = he0;
-                    m_halfedges.push_back(he);
-                    while (he)
-                    {
-                        he = he->ccw_rotate_about_source();
-                        if (!he || he == he0) break;
-                        m_halfedges.push_back(he);
-                    }
+                    if (a.in_halfedges.empty()) for (CHalfEdge * he : in_halfedges_range()) a.in_halfedges.push_back(he);
+                    return a.in_halfedges;
                 }
-                return m_halfedges;
+                if (a.halfedges.empty()) for (CHalfEdge * he : out_halfedges_range()) a.halfedges.push_back(he);
+                return a.halfedges;
             }
 
+            /*! the halfedges following the incoming ones */
             std::vector<CHalfEdge * > & out_halfedges()
             {
-                if (!m_out_halfedges.empty()) return m_out_halfedges;
-                m_out_halfedges.clear();
+                CVertexAdjacency & a = this->_adjacency();
+                if (a.out_halfedges.empty()) for (CHalfEdge * he : in_halfedges_range()) a.out_halfedges.push_back(he->next());
+                return a.out_halfedges;
+            }
 
-                for (CHalfEdge * phe : m_halfedges)
-                {
-                    m_out_halfedges.push_back(phe->next());
-                }
+            std::vector<CHalfEdge *> & in_halfedges() { return halfedges(-1); }
 
-                return m_out_halfedges;
-            }
+            //allocation free ranges, they only read the mesh
+            /*! outgoing halfedges, ccw, from the most clw one */
+            CCirculatorRange<CHalfEdge, COutSweep> out_halfedges_range() { return m_halfedge ? most_clw_out_halfedge() : NULL; }
+            /*! incoming halfedges, clw, from the most ccw one */
+            CCirculatorRange<CHalfEdge, CInSweep> in_halfedges_range() { return m_halfedge ? most_ccw_in_halfedge() : NULL; }
+            /*! adjacent vertices, ccw, a boundary vertex has one more than out halfedges */
+            CCirculatorRange<CHalfEdge, CVertexVertices> vertices_range() { return m_halfedge ? most_clw_out_halfedge() : NULL; }
+            /*! adjacent edges, ccw */
+            CCirculatorRange<CHalfEdge, CVertexEdges> edges_range() { return m_halfedge ? most_clw_out_halfedge() : NULL; }
+            /*! adjacent faces, ccw */
+            CCirculatorRange<CHalfEdge, CVertexFaces> faces_range() { return m_halfedge ? most_clw_out_halfedge() : NULL; }
 
-            std::vector<CHalfEdge *> & in_halfedges()
+            /*! slot of the element in the property arrays of the mesh */
+            size_t property_index() const { return m_property_index; }
+
+        protected:
+            friend class CBaseMesh;
+            /*!
+             *  Rotate he by rotate until the next one is NULL. The fan of a non-manifold vertex may
+             *  close or run into a loop without reaching NULL, a second halfedge rotated at half the
+             *  pace meets the first then, and the rotation stops there
+             */
+            template<typename R>
+            static CHalfEdge * _rotate(CHalfEdge * he, R rotate)
             {
-                return m_halfedges;
+                CHalfEdge * slow = he;
+                bool pace = false;
+                for (CHalfEdge * ne = rotate(he); ne != NULL && ne != slow; ne = rotate(he))
+                {
+                    he = ne;
+                    if (pace) slow = rotate(slow);
+                    pace = !pace;
+                }
+                return he;
             }
 
-            std::list<CEdge*> & ledges() { return m_ledges; }
-
-        protected:
+            /*! slot in the property arrays, given by the mesh */
+            unsigned int m_property_index = 0;
 
             /*! Vertex ID.
             */
@@ -296,40 +403,13 @@ namespace MeshLib {
             /*! Vertex position point.
             */
             CPoint m_point;
-            /*! Normal at the vertex.
-            */
-            CPoint m_normal;
-            /*! Texture coordinates of the vertex.
-            */
-            CPoint2 m_uv;
             /*! The most CCW incoming halfedge of the vertex.
             */
             CHalfEdge *       m_halfedge;
             /*! Indicating if the vertex is on the boundary.
             */
             bool              m_boundary;
-            /*! The string of the vertex, which stores the traits information.
-            */
-            std::string       m_string;
-
-            /*! List of adjacent edges, such that current vertex is the end vertex of the edge with smaller id
-            */
-            std::vector<CEdge*>   m_edges;
-            /*! Adjacent vertices, ccw order
-            */
-            std::vector<CVertex*> m_vertices;
-            /*! Adjacent faces, ccw order
-            */
-            std::vector<CFace*>   m_faces;
-            /*!
-            */
-            std::vector<CHalfEdge*> m_halfedges;
-            std::vector<CHalfEdge*> m_out_halfedges;
-            int halfedge_direction = 1;
 
-            /*! temp edge list when loading mesh
-            */
-            std::list<CEdge*> m_ledges;
 
             bool              m_touched;
             bool              m_dangling;
@@ -339,13 +419,13 @@ namespace MeshLib {
         /*!
         \brief CEdge class, which is the base class of all kinds of edge classes
         */
-        class CEdge : public E
+        class CEdge : public _CEdgeBase
         {
         public:
             /*!
             CEdge constructor, set both halfedge pointers to be NULL.
             */
-            CEdge() { m_halfedge[0] = NULL; m_halfedge[1] = NULL; };
+            CEdge() { m_halfedge[0] = NULL; m_halfedge[1] = NULL; m_touched = false; };
             /*!
             CEdge destructor.
             */
@@ -425,10 +505,6 @@ namespace MeshLib {
             \return the other halfedge attached to the current edge
             */
             CHalfEdge * & other(CHalfEdge * he) { return (he != m_halfedge[0]) ? m_halfedge[0] : m_halfedge[1]; }
-            /*!
-            The string of the current edge.
-            */
-            std::string & string() { return m_string; }
 
             bool   & touched() { return m_touched; }
             double & length() { return m_length; }
@@ -442,15 +518,18 @@ namespace MeshLib {
             */
             void _to_string() {}
 
+            /*! slot of the element in the property arrays of the mesh */
+            size_t property_index() const { return m_property_index; }
+
         protected:
+            friend class CBaseMesh;
+            /*! slot in the property arrays, given by the mesh */
+            unsigned int m_property_index = 0;
+
             /*!
             Pointers to the two halfedges attached to the current edge.
             */
             CHalfEdge      * m_halfedge[2];
-            /*!
-            The string associated to the current edge.
-            */
-            std::string      m_string;
             bool             m_touched;
             double           m_length;
         };
@@ -458,13 +537,13 @@ namespace MeshLib {
         /*!
         \brief CFace base class of all kinds of face classes
         */
-        class CFace : public F
+        class CFace : public _CFaceBase
         {
         public:
             /*!
             CFace constructor
             */
-            CFace() { m_halfedge = NULL; }
+            CFace() { m_halfedge = NULL; m_touched = false; }
             /*!
             CFace destructor
             */
@@ -481,10 +560,6 @@ namespace MeshLib {
             The value of the current face id.
             */
             const int id() const { return m_id; }
-            /*!
-            The string of the current face.
-            */
-            std::string & string() { return m_string; }
             bool & touched() { return m_touched; }
 
             /*!
@@ -496,49 +571,62 @@ namespace MeshLib {
             */
             void _from_string() {}
 
-            std::vector<CHalfEdge*> & halfedges()
+            //the cached vectors of a polygon, the arrays of the corners of a face of fixed degree
+            typedef std::integral_constant<bool, P::s_degree == 0> CPolygon;
+            template<typename T>
+            using CCorners = typename std::conditional<P::s_degree == 0, std::vector<T*> &, std::array<T*, P::s_degree>>::type;
+
+            /*! halfedges of the face, from halfedge() on, cached until clear_adjacency() */
+            CCorners<CHalfEdge> halfedges() { return _halfedges(CPolygon()); }
+            /*! vertices of the face, cached until clear_adjacency() */
+            CCorners<CVertex>   vertices() { return _vertices(CPolygon()); }
+            /*! edges of the face, cached until clear_adjacency() */
+            CCorners<CEdge>     edges() { return _edges(CPolygon()); }
+
+            //allocation free ranges, from halfedge() on
+            CCirculatorRange<CHalfEdge, CFaceHalfedges> halfedges_range() { return m_halfedge; }
+            CCirculatorRange<CHalfEdge, CFaceVertices>  vertices_range() { return m_halfedge; }
+            CCirculatorRange<CHalfEdge, CFaceEdges>     edges_range() { return m_halfedge; }
+
+            /*! slot of the element in the property arrays of the mesh */
+            size_t property_index() const { return m_property_index; }
+
+        protected:
+            friend class CBaseMesh;
+            /*! slot in the property arrays, given by the mesh */
+            unsigned int m_property_index = 0;
+
+            std::vector<CHalfEdge*> & _halfedges(std::true_type)
             {
-                if (m_halfedges.empty())
-                {
-                    m_halfedge = this->halfedge();
-                    m_halfedges.push_back(m_halfedge);
-                    CHalfEdge * he = m_halfedge->next();
-                    while (he != m_halfedge)
-                    {
-                        m_halfedges.push_back(he);
-                        he = he->next();
-                    }
-                }
-                return m_halfedges;
+                CFaceAdjacency & a = this->_adjacency();
+                if (a.halfedges.empty()) for (CHalfEdge * he : halfedges_range()) a.halfedges.push_back(he);
+                return a.halfedges;
             }
-
-            std::vector<CVertex*>   & vertices()
+            std::vector<CVertex*> & _vertices(std::true_type)
             {
-                if (m_vertices.empty())
-                {
-                    m_halfedges = halfedges();
-                    for (CHalfEdge* he : m_halfedges)
-                    {
-                        m_vertices.push_back(he->vertex());
-                    }
-                }
-                return m_vertices;
+                CFaceAdjacency & a = this->_adjacency();
+                if (a.vertices.empty()) for (CVertex * v : vertices_range()) a.vertices.push_back(v);
+                return a.vertices;
             }
-
-            std::vector<CEdge*>     & edges()
+            std::vector<CEdge*> & _edges(std::true_type)
             {
-                if (m_edges.empty())
-                {
-                    std::vector<CHalfEdge*> & m_halfedges = halfedges();
-                    for (CHalfEdge* he : m_halfedges)
-                    {
-                        m_edges.push_back(he->edge());
-                    }
-                }
-                return m_edges;
+                CFaceAdjacency & a = this->_adjacency();
+                if (a.edges.empty()) for (CEdge * e : edges_range()) a.edges.push_back(e);
+                return a.edges;
+            }
+            std::array<CHalfEdge*, P::s_degree> _halfedges(std::false_type) { return _corners<CHalfEdge>([](CHalfEdge * he) { return he; }); }
+            std::array<CVertex*, P::s_degree> _vertices(std::false_type) { return _corners<CVertex>([](CHalfEdge * he) { return he->vertex(); }); }
+            std::array<CEdge*, P::s_degree> _edges(std::false_type) { return _corners<CEdge>([](CHalfEdge * he) { return he->edge(); }); }
+            /*! fn of the halfedges from halfedge() on, the constant bound unrolls the loop */
+            template<typename T, typename Fn>
+            std::array<T*, P::s_degree> _corners(Fn fn)
+            {
+                std::array<T*, P::s_degree> a;
+                CHalfEdge * he = m_halfedge;
+                for (int i = 0; i < P::s_degree; i++, he = he->next()) a[i] = fn(he);
+                return a;
             }
 
-        protected:
             /*!
             id of the current face
             */
@@ -547,27 +635,19 @@ namespace MeshLib {
             One halfedge  attaching to the current face.
             */
             CHalfEdge * m_halfedge;
-            /*!
-            String of the current face.
-            */
-            std::string m_string;
             bool        m_touched;
-
-            std::vector<CEdge*> m_edges;
-            std::vector<CHalfEdge*> m_halfedges;
-            std::vector<CVertex*>   m_vertices;
         };
 
         /*!
         \brief CHalfEdge Base class of all kinds of halfedges.
         */
-        class CHalfEdge : public H
+        class CHalfEdge : public _CHalfEdgeBase
         {
         public:
 
             /*! Constructor, initialize all pointers to be NULL.
             */
-            CHalfEdge() { m_edge = NULL; m_vertex = NULL; m_prev = NULL; m_next = NULL; m_face = NULL; };
+            CHalfEdge() { m_edge = NULL; m_vertex = NULL; m_prev = NULL; m_next = NULL; m_face = NULL; m_touched = false; };
             /*! Destructure.
             */
             ~CHalfEdge() {};
@@ -627,9 +707,6 @@ namespace MeshLib {
             */
             CHalfEdge * next_clw_in_halfedge() { return clw_rotate_about_target(); }
 
-            /*! String of the current halfedge. */
-            std::string & string() { return m_string; }
-
             bool   & touched() { return m_touched; }
             double & length() { return m_length; }
 
@@ -640,11 +717,14 @@ namespace MeshLib {
             */
             void _from_string() {};
 
-            CPoint2 & uv() { return m_uv; }
-
-            CPoint & normal() { return m_normal; }
+            /*! slot of the element in the property arrays of the mesh */
+            size_t property_index() const { return m_property_index; }
 
         protected:
+            friend class CBaseMesh;
+            /*! slot in the property arrays, given by the mesh */
+            unsigned int m_property_index = 0;
+
             /*! Edge, current halfedge attached to. */
             CEdge       *     m_edge;
             /*! Face, current halfedge attached to. */
@@ -655,14 +735,8 @@ namespace MeshLib {
             CHalfEdge   *     m_prev;
             /*! Next halfedge of the current halfedge, in the same face. */
             CHalfEdge   *     m_next;
-            /*! The string of the current halfedge. */
-            std::string       m_string;
             bool              m_touched;
             double            m_length;
-            /*! Texture coordinate on target. */
-            CPoint2           m_uv;
-            /*! normal */
-            CPoint            m_normal;
         };
 
         //constructor and destructor
@@ -674,10 +748,14 @@ namespace MeshLib {
         CBaseMesh destructor
         */
         ~CBaseMesh();
+        /*! a mesh owns its elements, a copy of the lists would free them twice, see checkpoint() and
+            restore() for a copy of the elements */
+        CBaseMesh(const CBaseMesh &) = delete;
+        CBaseMesh & operator=(const CBaseMesh &) = delete;
 
         //file io
         /*!
-        Read an .obj file.
+        Read an .obj file, the file is parsed in parallel chunks.
         \param filename the input .obj file name
         */
         void read_obj(const char * filename);
@@ -685,21 +763,27 @@ namespace MeshLib {
         /*!
         Write an .obj file.
         \param filename the output .obj file name
+        \param threads number of formatting threads, 0 uses all hardware threads
         */
-        void write_obj(const char * filename);
-        void write_obj(std::string filename) { write_obj(filename.c_str()); }
+        void write_obj(const char * filename, int threads = 0);
+        void write_obj(std::string filename, int threads = 0) { write_obj(filename.c_str(), threads); }
         /*!
         Read an .m file.
         \param filename the input obj file name
+        \param traits   if not empty only these traits are kept in the element strings,
+                        otherwise the strings stay in the mapped file until first accessed
+        \param threads  number of threads labeling the boundary and reading the traits, 0 uses all
+                        hardware threads, _from_string() of the elements has to be thread safe
         */
-        void read_m(const std::string & filename, const std::set<std::string> & traits = {});
-        void read_m(const char * filename, const std::set<std::string> & traits = {}) { read_m(std::string(filename), traits); }
+        void read_m(const std::string & filename, const std::set<std::string> & traits = {}, int threads = 0);
+        void read_m(const char * filename, const std::set<std::string> & traits = {}, int threads = 0) { read_m(std::string(filename), traits, threads); }
         /*!
         Write an .m file.
         \param filename the output .m file name
+        \param threads number of formatting threads, 0 uses all hardware threads
         */
-        void write_m(const std::string & filename, const std::set<std::string> & traits = {});
-        void write_m(const char * filename, const std::set<std::string> & traits = {}) { write_m(std::string(filename), traits); }
+        void write_m(const std::string & filename, const std::set<std::string> & traits = {}, int threads = 0);
+        void write_m(const char * filename, const std::set<std::string> & traits = {}, int threads = 0) { write_m(std::string(filename), traits, threads); }
         /*!
         Read an .off file
         \param filename the input .off filename
@@ -709,14 +793,235 @@ namespace MeshLib {
         /*!
         Write an .off file.
         \param filename the output .off file name
+        \param threads number of formatting threads, 0 uses all hardware threads
+        */
+        void write_off(const char * filename, int threads = 0);
+        void write_off(std::string filename, int threads = 0) { write_off(filename.c_str(), threads); }
+        /*!
+        Read a .ply file, text or binary of either byte order. The vertex element gives the points,
+        with nx ny nz the normals and with s t, u v or texture_u texture_v the uvs, the face element
+        its vertex_indices
+        \param filename the input .ply file name
+        \param threads  number of threads converting the columns, 0 uses all hardware threads
+        \return false if the file is missing or damaged
+        */
+        bool read_ply(const std::string & filename, int threads = 0);
+        /*!
+        Write a binary little endian .ply file, the faces as they are
+        \param filename the output .ply file name
+        \param with_uv  store the vertex uv coordinates
+        \param with_normal store the vertex normals
+        */
+        bool write_ply(const std::string & filename, bool with_uv = true, bool with_normal = true);
+        /*!
+        Read the triangle primitives of all meshes of a .glb file, see parser/gltf.h. Their
+        vertices are welded by position, their normals and uvs stay on the halfedges, the node
+        transforms are not applied
+        \param filename the input .glb file name
+        \param threads  number of threads converting the accessors, 0 uses all hardware threads
+        \return false if the file is missing or has no triangle primitive
+        */
+        bool read_glb(const std::string & filename, int threads = 0);
+        /*!
+        Write a .glb file, polygons are fan triangulated and vertices split where their halfedges
+        differ in uv or normal
+        \param filename the output .glb file name
+        \param with_uv  store the halfedge uv coordinates
+        \param with_normal store the halfedge normals
+        */
+        bool write_glb(const std::string & filename, bool with_uv = true, bool with_normal = true);
+        /*!
+        Read an .smv binary cache, see parser/smv.h
+        \param filename the input .smv file name
+        \return false if the file is missing or not a valid cache
+        */
+        bool read_smv(const std::string & filename);
+        /*!
+        Write an .smv binary cache, polygons are fan triangulated.
+        \param filename the output .smv file name
+        \param with_uv  store the halfedge uv coordinates
+        \param with_normal store the halfedge normals
+        \param report   stored with the mesh if not NULL, see CMeshAnalysis
+        */
+        bool write_smv(const std::string & filename, bool with_uv = true, bool with_normal = true, const CMeshReport * report = NULL);
+        /*!
+        The state of the mesh as flat arrays by element slot, see parser/ckp.h: the points, the
+        links between the elements as slots, ids, touched and boundary flags, uvs, normals, trait
+        strings, the members of V, E, F and H if they are trivially copyable, and the property
+        arrays of trivially copyable values. The copy is taken in parallel and nothing refers
+        back to the mesh, so it is written by a CCheckpointWriter while the mesh goes on changing
+        \param threads number of threads, 0 uses all hardware threads
+        */
+        std::shared_ptr<CCheckpoint> checkpoint(int threads = 0);
+        /*!
+        Go back to a checkpoint of a mesh of this type, every element in its slot and the lists
+        in their order, so the property arrays and the iteration are as they were. Properties the
+        mesh has not added again are held as bytes until it does, see CPropertySet::add
+        \return false, and the mesh left as it is, if the checkpoint lacks the arrays of this mesh
+        */
+        bool restore(const CCheckpoint & checkpoint, int threads = 0);
+        /*!
+        Write a .ckp checkpoint, see checkpoint(), on this thread
+        \param filename the output .ckp file name
+        */
+        bool write_checkpoint(const std::string & filename, int threads = 0) { return checkpoint(threads)->write(filename); }
+        /*!
+        Read a .ckp checkpoint back, see restore()
+        \param filename the input .ckp file name
+        */
+        bool read_checkpoint(const std::string & filename, int threads = 0)
+        {
+            CCheckpoint c;
+            return c.read(filename) && restore(c, threads);
+        }
+        /*!
+        Read an .mb file, the binary .m, see parser/mb.h
+        \param filename the input .mb file name
+        \param traits   if not empty only the columns of these traits are put into the element strings
+        \param threads  number of threads building the strings and reading the traits, 0 uses all hardware threads
+        \return false if the file is missing or not a valid .mb file
+        */
+        bool read_mb(const std::string & filename, const std::set<std::string> & traits = {}, int threads = 0);
+        /*!
+        Write an .mb file, the trait strings become columns. read_mb gives the strings back, the
+        tokens in the order their columns were first seen, the doubles in the shortest text that
+        reads back the same, so .m to .mb and back loses nothing
+        \param filename the output .mb file name
+        \param traits   if not empty only these traits are written
         */
-        void write_off(const char * filename);
-        void write_off(std::string filename) { write_off(filename.c_str()); }
+        bool write_mb(const std::string & filename, const std::set<std::string> & traits = {}, int threads = 0);
+        /*!
+        Read a .cmv compressed mesh, see parser/cmv.h, the blocks are decoded in parallel
+        \param filename the input .cmv file name
+        \param threads  number of decoding threads, 0 uses all hardware threads
+        \return false if the file is missing or damaged
+        */
+        bool read_cmv(const std::string & filename, int threads = 0);
+        /*!
+        Write a .cmv compressed mesh, polygons are fan triangulated. Points are rounded to a grid of
+        2^position_bits steps over the bounding box, uvs and normals to 16 and 12 bits
+        \param filename the output .cmv file name
+        \param with_uv  store the halfedge uv coordinates
+        \param with_normal store the halfedge normals
+        */
+        bool write_cmv(const std::string & filename, bool with_uv = true, bool with_normal = true, int position_bits = 16, int threads = 0);
 
         /*!
-        Construct mesh from point and face vectors*/
+        Construct mesh from point and face vectors, face vertex ids are 1-based*/
         void set_from_vector(std::vector<CPoint>, std::vector<std::vector<int>>);
 
+        /*!
+        Construct a triangle mesh from flat arrays in one pass.
+        \param points      vertex positions, vertex i gets id i+1
+        \param uvs         per vertex texture coordinates, may be empty
+        \param normals     per vertex normals, may be empty
+        \param tri_indices 0-based vertex indices, three per face, face j gets id j+1
+        */
+        void build_from_arrays(const std::vector<CPoint> & points, const std::vector<CPoint2> & uvs,
+            const std::vector<CPoint> & normals, const std::vector<int> & tri_indices);
+        /*!
+        Construct a polygonal mesh from flat arrays in one pass.
+        \param indices        0-based vertex indices of all face corners
+        \param face_offsets   face j owns corners [face_offsets[j], face_offsets[j+1]), empty means triangles
+        \param uv_indices     per corner index into uvs, empty means uvs are per vertex
+        \param normal_indices per corner index into normals, empty means normals are per vertex
+        A cancelled job of the calling thread, see CJob, stops the build after the faces so far
+        */
+        void build_from_arrays(const std::vector<CPoint> & points, const std::vector<CPoint2> & uvs,
+            const std::vector<CPoint> & normals, const std::vector<int> & indices, const std::vector<int> & face_offsets,
+            const std::vector<int> & uv_indices, const std::vector<int> & normal_indices)
+        {
+            _build_from_arrays(points, uvs, normals, indices, face_offsets, uv_indices, normal_indices, NULL);
+        }
+
+        /*!
+        Repair the faces of every following bulk build, by build_from_arrays and the readers built on
+        it, see CMeshRepair: faces that cannot be linked into halfedges are dropped and vertices
+        where several fans meet are split, instead of a build that stops or links them wrongly. The
+        face ids stay those of the input, the split vertices take the ids after the points
+        */
+        bool & repair_input() { return m_repair; }
+        /*! what the last build repaired, see repair_input */
+        const CRepairReport & repair_report() const { return m_repair_report; }
+        /*!
+        Weld the points of every following bulk build that are at most this far apart, before the
+        repair, see CPointWelder: a mesh exported with a vertex per face corner gets its vertices
+        shared and its edges paired. The uvs and normals per vertex go to the halfedges, so their
+        seams stay. 0 welds equal points only, negative, the default, does not weld. The welded
+        vertices take the ids of their first point in order
+        */
+        double & weld_tolerance() { return m_weld; }
+        /*! points the last build welded into others, see weld_tolerance */
+        size_t welded_points() const { return m_welded; }
+        /*!
+        Lay out the vertices and faces of every following bulk build along the Morton curve of the
+        points and of the centers of the faces, after the weld and the repair, see CMortonOrder, so
+        that neighbors are close in memory whatever the order of the file. The vertices and faces
+        take the ids of their new order
+        */
+        bool & reorder_input() { return m_reorder; }
+
+#ifdef MESHLIB_EIGEN
+        /*! rows of C doubles a vertex apart in memory, see positions_matrix */
+        template<int C>
+        using CVertexMatrix = Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, C, Eigen::RowMajor>, 0, Eigen::OuterStride<>>;
+
+        /*!
+        The points of the vertices in place, row i that of the i-th vertex of vertices(), so that
+        transforms and other batched Eigen expressions run over all of them without a copy in or
+        out. Only when the vertices lie a slot apart in the order of the list, as the bulk build
+        leaves them in a CBlockArena, see vertices_in_place, the map has no rows otherwise. Valid
+        until a vertex is created or deleted
+        */
+        CVertexMatrix<3> positions_matrix() { return _vertex_matrix<3>(true, [](CVertex * v) { return &v->point()[0]; }); }
+        /*! the normals of the vertices in place, see positions_matrix, no rows without the field */
+        CVertexMatrix<3> normals_matrix() { return _vertex_matrix<3>(P::s_normal, [](CVertex * v) { return &v->normal()[0]; }); }
+        /*! the uvs of the vertices in place, see positions_matrix, no rows without the field */
+        CVertexMatrix<2> uvs_matrix() { return _vertex_matrix<2>(P::s_uv, [](CVertex * v) { return &v->uv()[0]; }); }
+        /*! whether the vertices lie a slot apart in the order of the list, see positions_matrix */
+        bool vertices_in_place() { return _vertex_stride() != 0; }
+#endif
+
+    protected:
+#ifdef MESHLIB_EIGEN
+        /*! the doubles from one vertex to the next if they lie evenly apart, 0 if not */
+        ptrdiff_t _vertex_stride()
+        {
+            if (m_stride_version == m_topology_version) return m_stride;
+            m_verts.compact();
+            const std::vector<CVertex*> & d = m_verts.data();
+            m_stride_version = m_topology_version;
+            m_stride = d.empty() ? 0 : (ptrdiff_t)(sizeof(CVertex) / sizeof(double));
+            if (d.size() < 2 || sizeof(CVertex) % sizeof(double)) return m_stride;
+            const ptrdiff_t bytes = (const char *)d[1] - (const char *)d[0];
+            m_stride = bytes > 0 && bytes % sizeof(double) == 0 ? bytes / (ptrdiff_t)sizeof(double) : 0;
+            for (size_t i = 2; i < d.size() && m_stride; i++)
+                if ((const char *)d[i] - (const char *)d[0] != (ptrdiff_t)i * bytes) m_stride = 0;
+            return m_stride;
+        }
+        /*! the map of the field at first(v) of every vertex, no rows if there is none or they are not in place */
+        template<int C, typename First>
+        CVertexMatrix<C> _vertex_matrix(bool field, First first)
+        {
+            const ptrdiff_t stride = field ? _vertex_stride() : 0;
+            if (stride == 0) return CVertexMatrix<C>(NULL, 0, C, Eigen::OuterStride<>(C));
+            return CVertexMatrix<C>(first(m_verts.front()), (Eigen::Index)m_verts.size(), C, Eigen::OuterStride<>(stride));
+        }
+#endif
+        /*!
+        Bulk construction, `twins` optionally gives the dual corner of every corner (-1 on the boundary),
+        which replaces sorting the edge keys.
+        */
+        void _build_from_arrays(const std::vector<CPoint> & points, const std::vector<CPoint2> & uvs,
+            const std::vector<CPoint> & normals, const std::vector<int> & indices, const std::vector<int> & face_offsets,
+            const std::vector<int> & uv_indices, const std::vector<int> & normal_indices, const int * twins);
+        /*!
+        The fan triangulated faces as wedges, a wedge per vertex and distinct halfedge uv and normal,
+        see write_cmv and write_glb
+        */
+        void _triangle_wedges(CCmvMesh & out, bool with_uv, bool with_normal);
+    public:
+
         //number of vertices, faces, edges
         /*! number of vertices */
         int  num_vertices() { return m_verts.size(); }
@@ -724,6 +1029,22 @@ namespace MeshLib {
         int  num_edges() { return m_edges.size(); }
         /*! number of faces */
         int  num_faces() { return m_faces.size(); }
+        /*! changes whenever elements are created, deleted or linked anew, a key for what is built on the connectivity */
+        size_t topology_version() const { return m_topology_version; }
+        /*!
+        Changes whenever the algorithms of the library move points, and on touch_points(), with
+        topology_version a key for what is built on the points, see CDerived
+        */
+        size_t geometry_version() const { return m_geometry_version; }
+        /*! tell the mesh that points were moved by hand, see geometry_version */
+        void touch_points() { m_geometry_version++; }
+        /*!
+        Bytes the mesh holds, by part. The elements are counted by the allocator, slabs
+        with their free slots, which copies of the mesh share, see CBlockArena. What
+        the classes V, E, F and H hold on the heap themselves is not seen
+        \param threads number of threads, 0 uses all hardware threads
+        */
+        CMemoryReport memory_report(int threads = 0);
 
 
         //acess vertex - id
@@ -732,7 +1053,7 @@ namespace MeshLib {
         \param id the vertex id
         \return the vertex, whose ID equals to id. NULL, if there is no such a vertex.
         */
-        CVertex * vertex(int id) { return m_map_vert[id]; }
+        CVertex * vertex(int id) { return m_map_vert.find(id); }
 
         //access face - id
         /*!
@@ -740,7 +1061,7 @@ namespace MeshLib {
         \param id the face id
         \return the face, whose ID equals to id. NULL, if there is no such a face.
         */
-        CFace *  face(int id) { return m_map_face[id]; }
+        CFace *  face(int id) { return m_map_face.find(id); }
 
         //access edge - edge key, vertex
         /*!
@@ -751,16 +1072,75 @@ namespace MeshLib {
         */
         CEdge * edge(CVertex * v0, CVertex * v1)
         {
-            CVertex * pV = (v0->id() < v1->id()) ? v0 : v1;
-            for (CEdge * pE : pV->ledges())
+            if (m_edge_hash.size() == m_edges.size())
+            {
+                return m_edge_hash.find(CEdgeHash<CEdge>::key(v0->id(), v1->id()), [&](CEdge * e) { return _joins(e, v0, v1); });
+            }
+            // the table was dropped or is out of date, walk around v0
+            for (CEdge * pE : v0->edges_range())
             {
-                CHalfEdge * pH = pE->halfedge(0);
-                if (pH->source() == v0 && pH->target() == v1) return pE;
-                if (pH->source() == v1 && pH->target() == v0) return pE;
+                if (_joins(pE, v0, v1)) return pE;
             }
             return NULL;
         }
 
+        /*!
+        Release the edge table, edge() then walks around the vertex. The table
+        has to be dropped when edges are relinked to other vertices, the next
+        create_edge rebuilds it.
+        */
+        void drop_edge_index() { m_edge_hash.clear(); }
+
+        //parallel loops over the elements, fn has to follow the concurrency rules of the class comment
+        /*! elements handed to a worker at a time */
+        static const size_t s_grain = 1 << 14;
+        /*!
+        Run fn(v) for every vertex on the shared thread pool
+        \param threads number of threads, 0 uses all hardware threads
+        \param grain   vertices handed to a worker at a time, lower it for expensive fn
+        */
+        template<typename Fn>
+        void parallel_for_vertices(Fn fn, int threads = 0, size_t grain = s_grain) { _for_each(m_verts, threads, fn, grain); }
+        template<typename Fn>
+        void parallel_for_faces(Fn fn, int threads = 0, size_t grain = s_grain) { _for_each(m_faces, threads, fn, grain); }
+        template<typename Fn>
+        void parallel_for_edges(Fn fn, int threads = 0, size_t grain = s_grain) { _for_each(m_edges, threads, fn, grain); }
+        template<typename Fn>
+        void parallel_for_halfedges(Fn fn, int threads = 0, size_t grain = s_grain) { _for_each(m_halfedges, threads, fn, grain); }
+        /*!
+        Fold all vertices, fn(acc, v) adds v to acc, which starts as identity,
+        combine(a, b) joins partial results. The result does not depend on the
+        number of threads.
+        */
+        template<typename R, typename Fn, typename Combine>
+        R parallel_reduce_vertices(const R & identity, Fn fn, Combine combine, int threads = 0, size_t grain = s_grain)
+        {
+            return _reduce(m_verts, identity, fn, combine, threads, grain);
+        }
+        template<typename R, typename Fn, typename Combine>
+        R parallel_reduce_faces(const R & identity, Fn fn, Combine combine, int threads = 0, size_t grain = s_grain)
+        {
+            return _reduce(m_faces, identity, fn, combine, threads, grain);
+        }
+        template<typename R, typename Fn, typename Combine>
+        R parallel_reduce_edges(const R & identity, Fn fn, Combine combine, int threads = 0, size_t grain = s_grain)
+        {
+            return _reduce(m_edges, identity, fn, combine, threads, grain);
+        }
+
+        /*!
+        Build everything the accessors would build lazily: the trait strings and
+        the cached adjacency vectors of all elements, those the fields of P hold.
+        Afterwards the mesh can be read from several threads, including string()
+        and the cached vectors, until it is edited again, see the class comment.
+        \param threads number of threads, 0 uses all hardware threads
+        */
+        void freeze(int threads = 0)
+        {
+            _freeze_strings(threads, std::integral_constant<bool, P::s_string>());
+            _freeze_adjacency(threads, std::integral_constant<bool, P::s_adjacency>());
+        }
+
         //access halfedge - halfedge key, vertex
         /*!
         Access a halfedge by its two end vertices
@@ -798,96 +1178,386 @@ namespace MeshLib {
         /*!
         List of the edges of the mesh.
         */
-        std::list<CEdge*>     & edges() { return m_edges; }
+        CElementList<CEdge>     & edges() { return m_edges; }
         /*!
         List of the halfedges of the mesh.
         */
-        std::list<CHalfEdge*> & halfedges() { return m_halfedges; }
+        CElementList<CHalfEdge> & halfedges() { return m_halfedges; }
         /*!
         List of the faces of the mesh.
         */
-        std::list<CFace*>     & faces() { return m_faces; }
+        CElementList<CFace>     & faces() { return m_faces; }
         /*!
         List of the vertices of the mesh.
         */
-        std::list<CVertex*>   & vertices() { return m_verts; }
+        CElementList<CVertex>   & vertices() { return m_verts; }
+
+        //property arrays, one value per element, prop[v] or prop.data()[v->property_index()]
+        /*!
+        Add a vertex property, or get the one of this name and type that is already there
+        \param name name of the property
+        \param init value of the vertices that exist now and are created later
+        */
+        template<typename T>
+        CProperty<T> & add_vertex_property(const std::string & name, const T & init = T()) { return m_properties->vertices.template add<T>(name, init); }
+        template<typename T>
+        CProperty<T> & add_edge_property(const std::string & name, const T & init = T()) { return m_properties->edges.template add<T>(name, init); }
+        template<typename T>
+        CProperty<T> & add_face_property(const std::string & name, const T & init = T()) { return m_properties->faces.template add<T>(name, init); }
+        template<typename T>
+        CProperty<T> & add_halfedge_property(const std::string & name, const T & init = T()) { return m_properties->halfedges.template add<T>(name, init); }
+        /*! the vertex property of this name and type, NULL if there is none */
+        template<typename T>
+        CProperty<T> * vertex_property(const std::string & name) { return m_properties->vertices.template find<T>(name); }
+        template<typename T>
+        CProperty<T> * edge_property(const std::string & name) { return m_properties->edges.template find<T>(name); }
+        template<typename T>
+        CProperty<T> * face_property(const std::string & name) { return m_properties->faces.template find<T>(name); }
+        template<typename T>
+        CProperty<T> * halfedge_property(const std::string & name) { return m_properties->halfedges.template find<T>(name); }
+        /*! release the array of a property */
+        bool remove_vertex_property(const std::string & name) { return m_properties->vertices.remove(name); }
+        bool remove_edge_property(const std::string & name) { return m_properties->edges.remove(name); }
+        bool remove_face_property(const std::string & name) { return m_properties->faces.remove(name); }
+        bool remove_halfedge_property(const std::string & name) { return m_properties->halfedges.remove(name); }
+        /*! the length of the property arrays, every property_index of a vertex is below it */
+        size_t vertex_slots() const { return m_properties->vertices.size(); }
+        size_t edge_slots() const { return m_properties->edges.size(); }
+        size_t face_slots() const { return m_properties->faces.size(); }
+        size_t halfedge_slots() const { return m_properties->halfedges.size(); }
 
     protected:
         /*! list of edges */
-        std::list<CEdge*>       m_edges;
+        CElementList<CEdge>     m_edges;
         /*! list of edges */
-        std::list<CHalfEdge*>   m_halfedges;
+        CElementList<CHalfEdge> m_halfedges;
         /*! list of vertices */
-        std::list<CVertex*>     m_verts;
+        CElementList<CVertex>   m_verts;
         /*! list of faces */
-        std::list<CFace*>       m_faces;
-    public:
-        //maps
-        /*! map between vetex and its id*/
-        std::map<int, CVertex*> m_map_vert;
-        /*! map between face and its id*/
-        std::map<int, CFace*>   m_map_face;
-
-    public:
-        /*! Create a vertex
-        \param id Vertex id
-        \return pointer to the new vertex
-        */
-        CVertex * create_vertex(int id = 0);
-        /*! Create an edge
-        \param v1 end vertex of the edge
-        \param v2 end vertex of the edge
-        \return pointer to the new edge
-        */
-        CEdge *   create_edge(CVertex * v1, CVertex * v2);
-        /*! Create a face
-        \param v an array of vertices
-        \param id face id
-        \return pointer to the new face
-        */
-        CFace *   create_face(std::vector<CVertex*> & v, int id); //create a triangle
-
-        /*! delete one face
-        \param pFace the face to be deleted
-        */
-        void      delete_face(CFace * pFace);
+        CElementList<CFace>     m_faces;
+        /*! storage of the elements */
+        A                       m_allocator;
+        /*! edges by their end vertex ids, for create_edge and edge() */
+        CEdgeHash<CEdge>        m_edge_hash;
+        /*! property arrays and element indices, shared by copies like the elements */
+        struct CProperties
+        {
+            CPropertySet vertices, edges, faces, halfedges;
+        };
+        std::shared_ptr<CProperties> m_properties = std::make_shared<CProperties>();
+        /*! see topology_version(), a new mesh does not start at the versions of one that was where it is */
+        size_t                  m_topology_version = _first_version();
+        /*! see geometry_version() */
+        size_t                  m_geometry_version = m_topology_version;
+        /*! see repair_input() */
+        bool                    m_repair = false;
+        CRepairReport           m_repair_report;
+        /*! see weld_tolerance() */
+        double                  m_weld = -1;
+        size_t                  m_welded = 0;
+        /*! see reorder_input() */
+        bool                    m_reorder = false;
+#ifdef MESHLIB_EIGEN
+        /*! see _vertex_stride(), as of m_stride_version of the topology */
+        ptrdiff_t               m_stride = 0;
+        size_t                  m_stride_version = (size_t)-1;
+#endif
+
+        CPropertySet & _properties(CVertex *)   { return m_properties->vertices; }
+        CPropertySet & _properties(CEdge *)     { return m_properties->edges; }
+        CPropertySet & _properties(CFace *)     { return m_properties->faces; }
+        CPropertySet & _properties(CHalfEdge *) { return m_properties->halfedges; }
+
+        /*! where the versions of a new mesh start, apart from those of every other mesh */
+        static size_t _first_version()
+        {
+            static std::atomic<size_t> s_meshes(0);
+            return (size_t)++s_meshes << (sizeof(size_t) > 4 ? 32 : 16);
+        }
 
-        /*! label boundary vertices, edges, faces */
-        void      label_boundary();
+        /*! a new element with its property slot, it is not linked or listed yet */
+        template<typename T>
+        T * _create()
+        {
+            T * t = m_allocator.template create<T>();
+            t->m_property_index = (unsigned int)_properties(t).acquire();
+            m_topology_version++;
+            return t;
+        }
+        /*! give the property slot back and free the element */
+        template<typename T>
+        void _destroy(T * t)
+        {
+            _properties(t).release(t->m_property_index);
+            m_allocator.destroy(t);
+            m_topology_version++;
+        }
+
+        /*! whether the edge joins a and b */
+        static bool _joins(CEdge * e, CVertex * a, CVertex * b)
+        {
+            CHalfEdge * pH = e->halfedge(0);
+            if (pH == NULL) return false;
+            return (pH->source() == a && pH->target() == b) || (pH->source() == b && pH->target() == a);
+        }
+        void _index_edges();
+        /*! the flagged traits and the hooks of the element classes, after a mesh is read */
+        void _read_traits(int threads);
+        /*! the hooks of the element classes and the flagged traits, before a mesh is written */
+        void _write_traits(int threads);
+        /*! the trait strings of the elements from the columns of the element kind, see read_mb */
+        template<typename T>
+        static void _mb_strings(const CMbFile & mb, int element, const std::set<std::string> & traits, std::vector<T*> & elements, int threads);
+        /*! the columns of the trait strings of the elements, see write_mb */
+        template<typename T>
+        static void _mb_columns(CMbTraitTable & table, const std::vector<T*> & elements);
+
+        //freeze() of the fields P holds, a field left out has nothing to build
+        void _freeze_strings(int threads, std::true_type)
+        {
+            _for_each(m_verts, threads, [](CVertex * v) { v->string(); });
+            _for_each(m_faces, threads, [](CFace * f) { f->string(); });
+            _for_each(m_edges, threads, [](CEdge * e) { e->string(); });
+            _for_each(m_halfedges, threads, [](CHalfEdge * he) { he->string(); });
+        }
+        void _freeze_strings(int, std::false_type) {}
+        void _freeze_adjacency(int threads, std::true_type)
+        {
+            _for_each(m_verts, threads, [](CVertex * v)
+            {
+                v->edges();
+                v->vertices();
+                v->faces();
+                v->halfedges(1);
+                v->halfedges(-1);
+                v->out_halfedges();
+            });
+            _for_each(m_faces, threads, [](CFace * f)
+            {
+                f->halfedges();
+                f->vertices();
+                f->edges();
+            });
+        }
+        void _freeze_adjacency(int, std::false_type) {}
+
+        /*! fn(t) for every element of the list, in parallel */
+        template<typename T, typename Fn>
+        static void _for_each(CElementList<T> & list, int threads, Fn fn, size_t grain = s_grain)
+        {
+            const std::vector<T*> & data = list.data();
+            parallel_for(data.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) if (data[i]) fn(data[i]);
+            }, grain);
+        }
+        /*! fold the elements of the list in parallel, see parallel_reduce */
+        template<typename T, typename R, typename Fn, typename Combine>
+        static R _reduce(CElementList<T> & list, const R & identity, Fn fn, Combine combine, int threads, size_t grain)
+        {
+            const std::vector<T*> & data = list.data();
+            return parallel_reduce(data.size(), threads, identity, [&](size_t b, size_t e, R & acc)
+            {
+                for (size_t i = b; i < e; i++) if (data[i]) fn(acc, data[i]);
+            }, combine, grain);
+        }
+        //the parts of checkpoint() and restore()
+        template<typename T>
+        static uint32_t _slot(T * t) { return t ? (uint32_t)t->m_property_index : UINT32_MAX; }
+        template<typename T>
+        static T * _at(const std::vector<T*> & slots, uint32_t i) { return i < slots.size() ? slots[i] : NULL; }
+        /*! a block of n values per slot, fn(t, values) fills those of t, the free slots are zero */
+        template<typename R, typename T, typename Fn>
+        static void _column(CCheckpoint & c, const std::string & name, size_t n, CElementList<T> & list, const CPropertySet & set, int threads, Fn fn)
+        {
+            R * out = c.add<R>(name, n * set.size());
+            for (size_t i : set.free_indices()) std::fill(out + n * i, out + n * (i + 1), R());
+            _for_each(list, threads, [&](T * t) { fn(t, out + n * t->m_property_index); });
+        }
+        /*! fn(t, values) for the n values per slot of every element of the block */
+        template<typename R, typename T, typename Fn>
+        static bool _uncolumn(const CCheckpoint & c, const std::string & name, size_t n, const std::vector<T*> & slots, int threads, Fn fn)
+        {
+            const R * in = c.get<R>(name, n * slots.size());
+            if (in == NULL) return false;
+            parallel_for(slots.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) if (slots[i]) fn(slots[i], in + n * i);
+            }, s_grain);
+            return true;
+        }
+        static void _copy_bytes(char * to, const char * from, size_t bytes, int threads)
+        {
+            const size_t slice = (size_t)1 << 20;
+            parallel_for((bytes + slice - 1) / slice, threads, [&](size_t b, size_t e)
+            {
+                memcpy(to + b * slice, from + b * slice, std::min(e * slice, bytes) - b * slice);
+            }, 1);
+        }
+        /*! the slots, the order of the list, the trait strings, the members of B and the properties of one kind */
+        template<typename T, typename B>
+        void _checkpoint_kind(CCheckpoint & c, const std::string & kind, CElementList<T> & list, CPropertySet & set, int threads);
+        /*! the elements of one kind in their slots and list order, unlinked, NULL in the free slots */
+        template<typename T>
+        void _restore_elements(const CCheckpoint & c, const std::string & kind, CElementList<T> & list, CPropertySet & set, std::vector<T*> & slots);
+        /*! whether the trait strings of a kind, if there are any, lie in their block */
+        static bool _valid_strings(const CCheckpoint & c, const std::string & kind, size_t size);
+        /*! whether the links of the columns of a checkpoint join live slots of the right kinds, and agree */
+        static bool _valid_links(const CCheckpoint & c, const size_t sizes[4], const std::vector<uint8_t> live[4]);
+        /*! what _checkpoint_kind stored besides the slots, into the elements restored */
+        template<typename T, typename B>
+        void _restore_kind(const CCheckpoint & c, const std::string & kind, CPropertySet & set, const std::vector<T*> & slots, int threads);
+        /*! the members of B, the class the user gave, as bytes if they can be */
+        template<typename T, typename B>
+        static void _checkpoint_members(CCheckpoint & c, const std::string & kind, CElementList<T> & list, const CPropertySet & set, int threads, std::true_type)
+        {
+            char * out = c.add(kind + ".members", set.size(), sizeof(B));
+            c.add(kind + ".members.type", std::string(typeid(B).name()));
+            _for_each(list, threads, [&](T * t)
+            {
+                const B b = *t;
+                memcpy(out + sizeof(B) * t->m_property_index, &b, sizeof(B));
+            });
+        }
+        template<typename T, typename B>
+        static void _checkpoint_members(CCheckpoint &, const std::string &, CElementList<T> &, const CPropertySet &, int, std::false_type) {}
+        template<typename T, typename B>
+        static void _restore_members(const CCheckpoint & c, const std::string & kind, const std::vector<T*> & slots, int threads, std::true_type)
+        {
+            if (c.text(kind + ".members.type") != typeid(B).name()) return;
+            const CCheckpoint::CBlock * block = c.find(kind + ".members");
+            if (block == NULL || block->count != slots.size() || block->size != sizeof(B) * slots.size()) return;
+            parallel_for(slots.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++)
+                {
+                    if (slots[i] == NULL) continue;
+                    // through a whole B, the derived class may live in the tail padding of its base
+                    B m;
+                    memcpy(&m, block->data + sizeof(B) * i, sizeof(B));
+                    static_cast<B&>(*slots[i]) = m;
+                }
+            }, s_grain);
+        }
+        template<typename T, typename B>
+        static void _restore_members(const CCheckpoint &, const std::string &, const std::vector<T*> &, int, std::false_type) {}
+        template<typename B>
+        using _raw_members = std::integral_constant<bool, std::is_trivially_copyable<B>::value && !std::is_empty<B>::value>;
+
+    public:
+        //maps
+        /*! map between vetex and its id*/
+        CIdMap<CVertex>         m_map_vert;
+        /*! map between face and its id*/
+        CIdMap<CFace>           m_map_face;
+        /*! mapped .m files the trait strings of the elements still refer to */
+        std::vector<std::shared_ptr<CMappedFile>> m_trait_files;
+
+    public:
+        /*! Create a vertex
+        \param id Vertex id
+        \return pointer to the new vertex
+        */
+        CVertex * create_vertex(int id = 0);
+        /*! Create an edge
+        \param v1 end vertex of the edge
+        \param v2 end vertex of the edge
+        \return pointer to the new edge
+        */
+        CEdge *   create_edge(CVertex * v1, CVertex * v2);
+        /*! Create a face
+        \param v an array of vertices
+        \param id face id
+        \return pointer to the new face
+        */
+        CFace *   create_face(const std::vector<CVertex*> & v, int id) { return create_face(v.data(), v.size(), id); }
+        /*! Create a face from n vertices at vs, without temporary allocations
+        \param vs the vertices, ccw
+        \param n number of vertices
+        \param id face id
+        \return pointer to the new face
+        */
+        CFace *   create_face(CVertex * const * vs, size_t n, int id);
+        /*! Create the triangle v0 v1 v2 */
+        CFace *   create_triangle(CVertex * v0, CVertex * v1, CVertex * v2, int id)
+        {
+            CVertex * vs[3] = { v0, v1, v2 };
+            return create_face(vs, 3, id);
+        }
+
+        /*! delete one face
+        \param pFace the face to be deleted
+        */
+        void      delete_face(CFace * pFace);
+        /*! delete the faces pred(f) picks, with their halfedges and the edges and vertices left
+        without faces, in one pass over each list. The faces kept next to them get boundary
+        edges and vertices
+        \return number of faces deleted
+        */
+        template<typename Pred>
+        size_t    delete_faces(Pred pred);
+
+        /*!
+        Orient the edges from the lower to the higher vertex id, label boundary
+        vertices and remove dangling ones
+        \param threads number of threads, 0 uses all hardware threads
+        */
+        void      label_boundary(int threads = 0);
+
+        /*!
+        Smooth normals, the normal of every vertex is the sum of the normals of
+        its faces weighted by their area and their angle at the vertex, and each
+        halfedge gets the normal of its target vertex
+        \param threads number of threads, 0 uses all hardware threads
+        */
+        void      compute_normals(int threads = 0);
 
     public:
         /*!
-         *   the input traits of the mesh, there are 64 bits in total
+         *   the input traits of the mesh, there are 64 bits in total. read_m parses the
+         *   flagged ones, VERTEX_UV | EDGE_SHARP say, into the elements, see CTraitIO
          */
         static unsigned long long m_input_traits;
         /*!
-         *   the output triats of the mesh, there are 64 bits in total
+         *   the output triats of the mesh, there are 64 bits in total, write_m puts the
+         *   flagged ones into the trait strings
          */
         static unsigned long long m_output_traits;
 
     };
 
+    /*! a mesh of triangles only, the corners of a face are fixed arrays, see CMeshFields */
+    template<typename V = CVertex, typename E = CEdge, typename F = CFace, typename H = CHalfEdge, typename A = CBlockArena>
+    using CTriMesh = CBaseMesh<V, E, F, H, A, CMeshFields<true, true, true, true, 3>>;
+    /*! a mesh of quads only, see quadrilateralboundary.h */
+    template<typename V = CVertex, typename E = CEdge, typename F = CFace, typename H = CHalfEdge, typename A = CBlockArena>
+    using CQuadMesh = CBaseMesh<V, E, F, H, A, CMeshFields<true, true, true, true, 4>>;
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    unsigned long long CBaseMesh<V, E, F, H, A, P>::m_input_traits = 0;
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    unsigned long long CBaseMesh<V, E, F, H, A, P>::m_output_traits = 0;
 
     /*!
      CBaseMesh destructor
      */
-    template<typename V, typename E, typename F, typename H>
-    inline CBaseMesh<V, E, F, H>::~CBaseMesh()
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline CBaseMesh<V, E, F, H, A, P>::~CBaseMesh()
     {
         // remove vertices
-        for (CVertex * v : m_verts) delete v;
+        for (CVertex * v : m_verts) m_allocator.destroy(v);
         m_verts.clear();
 
         // remove faces
-        for (CFace * f : m_faces) delete f;
+        for (CFace * f : m_faces) m_allocator.destroy(f);
         m_faces.clear();
 
         // remove edges
-        for (CEdge * e : m_edges) delete e;
+        for (CEdge * e : m_edges) m_allocator.destroy(e);
         m_edges.clear();
 
         // remove halfedges
-        for (CHalfEdge * he : m_halfedges) delete he;
+        for (CHalfEdge * he : m_halfedges) m_allocator.destroy(he);
         m_halfedges.clear();
 
         // clear all the maps
@@ -901,14 +1571,14 @@ namespace MeshLib {
     \param id Vertex id
     \return pointer to the new vertex
     */
-    template<typename V, typename E, typename F, typename H>
-    inline typename CBaseMesh<V, E, F, H>::CVertex * CBaseMesh<V, E, F, H>::create_vertex(int id)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline typename CBaseMesh<V, E, F, H, A, P>::CVertex * CBaseMesh<V, E, F, H, A, P>::create_vertex(int id)
     {
-        CVertex * v = new CVertex();
+        CVertex * v = _create<CVertex>();
         assert(v != NULL);
         v->id() = id;
         m_verts.push_back(v);
-        m_map_vert.insert(std::pair<int, CVertex*>(id, v));
+        m_map_vert.insert(id, v);
         return v;
     };
 
@@ -917,51 +1587,52 @@ namespace MeshLib {
     \param id face id
     \return pointer to the new face
     */
-    template<typename V, typename E, typename F, typename H>
-    inline typename CBaseMesh<V, E, F, H>::CFace * CBaseMesh<V, E, F, H>::create_face(std::vector<CVertex*> & vs, int id)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline typename CBaseMesh<V, E, F, H, A, P>::CFace * CBaseMesh<V, E, F, H, A, P>::create_face(CVertex * const * vs, size_t n, int id)
     {
-        CFace * f = new CFace();
+        CFace * f = _create<CFace>();
         assert(f != NULL);
         f->id() = id;
         m_faces.push_back(f);
-        m_map_face.insert(std::pair<int, CFace*>(id, f));
-
-        //create halfedges
-        std::vector<CHalfEdge*> hes;
-        for (CVertex * v : vs)
+        m_map_face.insert(id, f);
+
+        //create halfedges, linking each to the previous one, a fixed degree bounds the loops
+        assert(P::s_degree == 0 || n == (size_t)P::s_degree);
+        if (P::s_degree) n = P::s_degree;
+        CHalfEdge * first = NULL;
+        CHalfEdge * last = NULL;
+        for (size_t i = 0; i < n; i++)
         {
-            CHalfEdge * he = new CHalfEdge();
+            CVertex * v = vs[i];
+            CHalfEdge * he = _create<CHalfEdge>();
             assert(he);
             he->vertex() = v;
             he->uv() = v->uv();
             he->normal() = v->normal();
+            he->face() = f;
             v->halfedge() = he;
-            v->in_halfedges().push_back(he);
-            hes.push_back(he);
             m_halfedges.push_back(he);
-        }
 
-        //linking to each other
-        for (size_t i = 0; i < hes.size(); i++)
-        {
-            hes[i]->next() = hes[(i + 1) % hes.size()];
-            hes[i]->prev() = hes[(i + hes.size() - 1) % hes.size()];
+            if (last) last->next() = he;
+            else first = he;
+            he->prev() = last;
+            last = he;
         }
+        if (first == NULL) return f;
 
-        //linking to face
-        for (size_t i = 0; i < hes.size(); i++)
-        {
-            hes[i]->face() = f;
-            f->halfedge() = hes[i];
-        }
+        //close the loop, the face keeps the last halfedge
+        last->next() = first;
+        first->prev() = last;
+        f->halfedge() = last;
 
         //connecting with edge
-        for (size_t i = 0; i < hes.size(); i++)
+        CHalfEdge * he = first;
+        for (size_t i = 0; i < n; i++, he = he->next())
         {
-            CEdge * e = create_edge(vs[i], vs[(i + hes.size() - 1) % hes.size()]);
+            CEdge * e = create_edge(vs[i], vs[(i + n - 1) % n]);
             if (e->halfedge(0) == NULL)
             {
-                e->halfedge(0) = hes[i];
+                e->halfedge(0) = he;
             }
             else
             {
@@ -970,9 +1641,9 @@ namespace MeshLib {
                 {
                     std::cout << "Illegal Face Construction " << id << std::endl;
                 }
-                e->halfedge(1) = hes[i];
+                e->halfedge(1) = he;
             }
-            hes[i]->edge() = e;
+            he->edge() = e;
         }
 
         return f;
@@ -983,413 +1654,304 @@ namespace MeshLib {
     \param v2 end vertex of the edge
     \return pointer to the new edge
     */
-    template<typename V, typename E, typename F, typename H>
-    inline typename CBaseMesh<V, E, F, H>::CEdge * CBaseMesh<V, E, F, H>::create_edge(CVertex * v1, CVertex * v2)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline typename CBaseMesh<V, E, F, H, A, P>::CEdge * CBaseMesh<V, E, F, H, A, P>::create_edge(CVertex * v1, CVertex * v2)
     {
-        CVertex * pV = (v1->id() < v2->id()) ? v1 : v2;
-        std::list<CEdge*> & ledges = pV->ledges();
+        // edges made behind the table's back, e.g. by CDynamicMesh, are picked up again
+        if (m_edge_hash.size() != m_edges.size()) _index_edges();
 
-        for (CEdge * pE : ledges)
-        {
-            CHalfEdge * pH = pE->halfedge(0);
-            if (pH->source() == v1 && pH->target() == v2)
-            {
-                return pE;
-            }
-            if (pH->source() == v2 && pH->target() == v1)
-            {
-                return pE;
-            }
-        }
+        const uint64_t key = CEdgeHash<CEdge>::key(v1->id(), v2->id());
+        CEdge * pE = m_edge_hash.find(key, [&](CEdge * e) { return _joins(e, v1, v2); });
+        if (pE != NULL) return pE;
 
         //new edge
-        CEdge * e = new CEdge();
+        CEdge * e = _create<CEdge>();
         assert(e != NULL);
         m_edges.push_back(e);
-        ledges.push_back(e);
+        m_edge_hash.insert(key, e);
 
         return e;
     };
 
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline CMemoryReport CBaseMesh<V, E, F, H, A, P>::memory_report(int threads)
+    {
+        CMemoryReport r;
+        r.vertices = m_allocator.template memory<CVertex>(m_verts.size());
+        r.edges = m_allocator.template memory<CEdge>(m_edges.size());
+        r.faces = m_allocator.template memory<CFace>(m_faces.size());
+        r.halfedges = m_allocator.template memory<CHalfEdge>(m_halfedges.size());
+        r.lists = m_verts.memory() + m_edges.memory() + m_faces.memory() + m_halfedges.memory();
+        r.maps = m_map_vert.memory() + m_map_face.memory() + m_edge_hash.memory();
+        r.properties = m_properties->vertices.memory() + m_properties->edges.memory() +
+            m_properties->faces.memory() + m_properties->halfedges.memory();
+        for (auto & file : m_trait_files) r.mapped += file->size();
+
+        auto plus = [](size_t a, size_t b) { return a + b; };
+        r.adjacency = _reduce(m_verts, (size_t)0, [](size_t & a, CVertex * v) { a += v->_adjacency_memory(); }, plus, threads, s_grain) +
+            _reduce(m_faces, (size_t)0, [](size_t & a, CFace * f) { a += f->_adjacency_memory(); }, plus, threads, s_grain);
+        r.strings = _reduce(m_verts, (size_t)0, [](size_t & a, CVertex * v) { a += v->trait_string().memory(); }, plus, threads, s_grain) +
+            _reduce(m_edges, (size_t)0, [](size_t & a, CEdge * e) { a += e->trait_string().memory(); }, plus, threads, s_grain) +
+            _reduce(m_faces, (size_t)0, [](size_t & a, CFace * f) { a += f->trait_string().memory(); }, plus, threads, s_grain) +
+            _reduce(m_halfedges, (size_t)0, [](size_t & a, CHalfEdge * h) { a += h->trait_string().memory(); }, plus, threads, s_grain);
+        return r;
+    }
+
+    /*! rebuild the edge table from the edge list */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::_index_edges()
+    {
+        m_edge_hash.clear();
+        m_edge_hash.reserve(m_edges.size());
+        for (CEdge * e : m_edges)
+        {
+            CHalfEdge * he = e->halfedge(0) ? e->halfedge(0) : e->halfedge(1);
+            if (he == NULL) continue;
+            m_edge_hash.insert(CEdgeHash<CEdge>::key(he->source()->id(), he->target()->id()), e);
+        }
+    }
+
     /*!
     Read an .obj file.
     \param filename the filename .obj file name
     */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::read_obj(const char * filename)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::read_obj(const char * filename)
     {
-
-        std::fstream f(filename, std::fstream::in);
-        if (f.fail()) return;
-
-        char cmd[1024];
-
-        int  vid = 1;
-        int  fid = 1;
-
-        bool with_uv = false;
-        bool with_normal = false;
-
-        std::vector<CPoint2> uvs;
-        std::vector<CPoint> normals;
-
-
-        while (f.getline(cmd, 1024))
+        MESHLIB_TRACE_ZONE("read_obj");
+        CObjData obj;
+        if (!CObjParser::parse_file(filename, obj)) return;
+
+        std::vector<int> indices(obj.corners.size());
+        std::vector<int> uv_indices(obj.with_uv() ? obj.corners.size() : 0);
+        std::vector<int> normal_indices(obj.with_normal() ? obj.corners.size() : 0);
+        for (size_t c = 0; c < obj.corners.size(); c++)
         {
-            std::string line(cmd);
-            line = strutil::trim(line);
-
-            strutil::Tokenizer stokenizer(line, " \t\r\n");
-
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-
-            if (token == "v")
-            {
-                CPoint p;
-                for (int i = 0; i < 3; i++)
-                {
-                    stokenizer.nextToken();
-                    token = stokenizer.getToken();
-                    p[i] = strutil::parseString<float>(token);
-                }
-
-                CVertex * v = create_vertex(vid);
-                v->point() = p;
-                vid++;
-                continue;
-            }
-
-
-            if (token == "vt")
-            {
-                with_uv = true;
-                CPoint2 uv;
-                for (int i = 0; i < 2; i++)
-                {
-                    stokenizer.nextToken();
-                    token = stokenizer.getToken();
-                    uv[i] = strutil::parseString<float>(token);
-                }
-                uvs.push_back(uv);
-                continue;
-            }
-
-            if (token == "vn")
-            {
-                with_normal = true;
-
-                CPoint n;
-                for (int i = 0; i < 3; i++)
-                {
-                    stokenizer.nextToken();
-                    token = stokenizer.getToken();
-                    n[i] = strutil::parseString<float>(token);
-                }
-                normals.push_back(n);
-                continue;
-            }
-
-            if (token == "f")
-            {
-                std::vector<CVertex*> vs;
-                for (int i = 0; i < 3; i++)
-                {
-                    stokenizer.nextToken();
-                    token = stokenizer.getToken();
-                    strutil::Tokenizer tokenizer(token, " /\t\r\n");
-
-                    int ids[3];
-                    int k = 0;
-                    while (tokenizer.nextToken())
-                    {
-                        std::string token = tokenizer.getToken();
-                        ids[k] = strutil::parseString<int>(token);
-                        k++;
-                    }
-
-                    CVertex * vi = m_map_vert[ids[0]];
-                    if (with_uv)
-                        vi->uv() = uvs[ids[1] - 1];
-                    if (with_normal)
-                        vi->normal() = normals[ids[2] - 1];
-                    vs.push_back(vi);
-                }
-                create_face(vs, fid++);
-            }
+            indices[c] = obj.corners[c].v;
+            if (obj.with_uv()) uv_indices[c] = obj.corners[c].t;
+            if (obj.with_normal()) normal_indices[c] = obj.corners[c].n;
         }
 
-        f.close();
-
-        label_boundary();
+        build_from_arrays(obj.points, obj.uvs, obj.normals, indices, obj.face_offsets, uv_indices, normal_indices);
     }
 
     /*!
         Read an .m file.
         \param input the input obj file name
     */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::read_m(const std::string & input, const std::set<std::string> & traits)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::read_m(const std::string & input, const std::set<std::string> & traits, int threads)
     {
-        std::fstream is(input, std::fstream::in);
+        MESHLIB_TRACE_ZONE("read_m");
+        std::shared_ptr<CMappedFile> file(new CMappedFile(input));
 
-        if (is.fail())
+        if (!file->is_open())
         {
             std::cerr << "error in opening file " << input << std::endl;
             return;
         }
+        // trait strings are views into the file until they are accessed
+        m_trait_files.push_back(file);
 
-        char buffer[MAX_LINE];
         int id;
 
-        while (is.getline(buffer, MAX_LINE))
+        // the word at p, advancing past it if it equals `word`
+        auto keyword = [](const char * &p, const char * end, const char * word)
         {
+            size_t n = strlen(word);
+            if ((size_t)(end - p) < n || strncmp(p, word, n) != 0) return false;
+            if (p + n < end && !CNumParser::is_blank(p[n])) return false;
+            p += n;
+            return true;
+        };
+        // the text between the first '{' and the following '}' from p on, only
+        // the selected traits if any are given
+        auto trait_string = [&traits](const char * p, const char * end, CTraitString & str)
+        {
+            const char * sp = (const char *)memchr(p, '{', (size_t)(end - p));
+            if (sp == NULL) return;
+            const char * ep = (const char *)memchr(sp, '}', (size_t)(end - sp));
+            if (ep == NULL) return;
+            if (traits.empty()) str.view(sp + 1, (size_t)(ep - sp - 1));
+            else str.str() = CTraitString::select(sp + 1, ep, traits);
+        };
+        auto next_int = [](const char * &p, const char * end, int & value)
+        {
+            CNumParser::skip_blank(p, end);
+            return CNumParser::scan_int(p, end, value);
+        };
 
-            std::string line(buffer);
-            line = strutil::trim(line);
-
-            strutil::Tokenizer stokenizer(line, " \r\n");
-
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
+        // the corners of the current face, reused from face to face
+        std::vector<CVertex*> vs;
+        const char * line = file->begin();
+        const char * file_end = file->end();
+        while (line < file_end)
+        {
+            const char * p = line;
+            const char * end = (const char *)memchr(line, '\n', (size_t)(file_end - line));
+            if (end == NULL) end = file_end;
+            line = end < file_end ? end + 1 : file_end;
+            CNumParser::skip_blank(p, end);
 
-            if (token == "Vertex")
+            if (keyword(p, end, "Vertex"))
             {
-                stokenizer.nextToken();
-                token = stokenizer.getToken();
-                id = strutil::parseString<int>(token);
+                id = 0;
+                next_int(p, end, id);
 
-                CPoint p;
+                CPoint pt;
                 for (int i = 0; i < 3; i++)
                 {
-                    stokenizer.nextToken();
-                    token = stokenizer.getToken();
-                    p[i] = strutil::parseString<float>(token);
+                    CNumParser::skip_blank(p, end);
+                    CNumParser::scan_double(p, end, pt[i]);
                 }
 
                 CVertex * v = create_vertex(id);
-                v->point() = p;
-
-                if (!stokenizer.nextToken("\t\r\n")) continue;
-                token = stokenizer.getToken();
-
-                int sp = (int)token.find("{");
-                int ep = (int)token.find("}");
+                v->point() = pt;
 
-                if (sp >= 0 && ep >= 0)
-                {
-                    v->string() = token.substr(sp + 1, ep - sp - 1);
-                }
+                trait_string(p, end, v->trait_string());
                 continue;
             }
 
 
-            if (token == "Face")
+            if (keyword(p, end, "Face"))
             {
+                id = 0;
+                next_int(p, end, id);
 
-                stokenizer.nextToken();
-                token = stokenizer.getToken();
-                id = strutil::parseString<int>(token);
-
-                std::vector<CVertex*> vs;
-                while (stokenizer.nextToken())
+                vs.clear();
+                bool known = true;
+                int vid;
+                while (next_int(p, end, vid))
                 {
-                    token = stokenizer.getToken();
-                    if (strutil::startsWith(token, "{")) break;
-                    int vid = strutil::parseString<int>(token);
                     vs.push_back(this->vertex(vid));
+                    known = known && vs.back() != NULL;
                 }
+                // a face on a vertex the file does not define is dropped
+                if (!known || vs.size() < 3) continue;
+                if (P::s_degree && vs.size() != (size_t)P::s_degree) continue;
 
                 CFace * f = create_face(vs, id);
 
-                if (strutil::startsWith(token, "{"))
-                {
-                    f->string() = strutil::trim(token, "{}");
-                }
+                trait_string(p, end, f->trait_string());
                 continue;
             }
 
             //read in edge attributes
-            if (token == "Edge")
+            if (keyword(p, end, "Edge"))
             {
-                stokenizer.nextToken();
-                token = stokenizer.getToken();
-                int id0 = strutil::parseString<int>(token);
-
-                stokenizer.nextToken();
-                token = stokenizer.getToken();
-                int id1 = strutil::parseString<int>(token);
+                int id0 = 0, id1 = 0;
+                next_int(p, end, id0);
+                next_int(p, end, id1);
 
                 CVertex * v0 = this->vertex(id0);
                 CVertex * v1 = this->vertex(id1);
 
-                CEdge * edge = this->edge(v0, v1);
-
-                if (!stokenizer.nextToken("\t\r\n")) continue;
-                token = stokenizer.getToken();
-
-                int sp = (int)token.find("{");
-                int ep = (int)token.find("}");
+                CEdge * edge = v0 && v1 ? this->edge(v0, v1) : NULL;
+                if (edge == NULL) continue;
 
-                if (sp >= 0 && ep >= 0)
-                {
-                    edge->string() = token.substr(sp + 1, ep - sp - 1);
-                }
+                trait_string(p, end, edge->trait_string());
                 continue;
             }
 
             //read in edge attributes
-            if (token == "Corner")
+            if (keyword(p, end, "Corner"))
             {
-                stokenizer.nextToken();
-                token = stokenizer.getToken();
-                int vid = strutil::parseString<int>(token);
-
-                stokenizer.nextToken();
-                token = stokenizer.getToken();
-                int fid = strutil::parseString<int>(token);
-
+                int vid = 0, fid = 0;
+                next_int(p, end, vid);
+                next_int(p, end, fid);
 
                 CVertex * v = this->vertex(vid);
                 CFace   * f = this->face(fid);
-                CHalfEdge * he = this->corner(v, f);
+                CHalfEdge * he = v && f ? this->corner(v, f) : NULL;
+                if (he == NULL) continue;
 
-
-                if (!stokenizer.nextToken("\t\r\n")) continue;
-                token = stokenizer.getToken();
-
-                int sp = (int)token.find("{");
-                int ep = (int)token.find("}");
-
-                if (sp >= 0 && ep >= 0)
-                {
-                    he->string() = token.substr(sp + 1, ep - sp - 1);
-                }
+                trait_string(p, end, he->trait_string());
                 continue;
             }
         }
 
-        //labelBoundary();
-
-        //Label boundary edges
-        for (CEdge * edge : m_edges)
-        {
-            CHalfEdge * he[2];
-            he[0] = edge->halfedge(0);
-            he[1] = edge->halfedge(1);
-            assert(he[0] != NULL);
-
-            if (he[1] != NULL)
-            {
-                assert(he[0]->target() == he[1]->source() && he[0]->source() == he[1]->target());
-
-                if (he[0]->target()->id() < he[0]->source()->id())
-                {
-                    edge->halfedge(0) = he[1];
-                    edge->halfedge(1) = he[0];
-                }
-
-                assert(edge->vertex1()->id() < edge->vertex2()->id());
-            }
-            else
-            {
-                he[0]->vertex()->boundary() = true;
-                he[0]->prev()->vertex()->boundary() = true;
-            }
-
-        }
-
-        std::list<CVertex*> dangling_verts;
-        //Label boundary edges
-        for (CVertex * v : m_verts)
-        {
-            if (v->halfedge() != NULL) continue;
-            dangling_verts.push_back(v);
-        }
-
-        for (CVertex * v : dangling_verts)
-        {
-            m_verts.remove(v);
-            delete v;
-            v = NULL;
-        }
-
-        //Arrange the boundary half_edge of boundary vertices, to make its halfedge
-        //to be the most ccw in half_edge
-        for (CVertex * v : m_verts)
-        {
-            if (!v->boundary()) continue;
-
-            CHalfEdge * he = v->most_ccw_in_halfedge();
-            while (he->dual() != NULL)
-            {
-                he = he->next_ccw_in_halfedge();
-            }
-            v->halfedge() = he;
-        }
-
-        //read in the traits
-        for (CVertex * v : m_verts) v->_from_string();
-        for (CEdge * e : m_edges) e->_from_string();
-        for (CFace * f : m_faces) f->_from_string();
-        for (CHalfEdge * he : m_halfedges) he->_from_string();
+        label_boundary(threads);
+        _read_traits(threads);
+    };
 
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::_read_traits(int threads)
+    {
+        //read in the traits, the flagged ones first, then those of the element classes
+        if (m_input_traits) CTraitIO<CBaseMesh>::read(*this, m_input_traits, threads);
+        _for_each(m_verts, threads, [](CVertex * v) { v->_from_string(); });
+        _for_each(m_edges, threads, [](CEdge * e) { e->_from_string(); });
+        _for_each(m_faces, threads, [](CFace * f) { f->_from_string(); });
+        _for_each(m_halfedges, threads, [](CHalfEdge * he) { he->_from_string(); });
     };
 
-    /*!
-        Write an .m file.
-        \param output the output .m file name
-    */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::write_m(const std::string & output, const std::set<std::string> & traits)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::_write_traits(int threads)
     {
         // write traits to string
         for (CVertex * v : m_verts) v->_to_string();
         for (CEdge * e : m_edges) e->_to_string();
         for (CFace * f : m_faces) f->_to_string();
         for (CHalfEdge * he : m_halfedges) he->_to_string();
+        if (m_output_traits) CTraitIO<CBaseMesh>::write(*this, m_output_traits, threads);
+    };
+
+    /*!
+        Write an .m file.
+        \param output the output .m file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::write_m(const std::string & output, const std::set<std::string> & traits, int threads)
+    {
+        _write_traits(threads);
 
-        std::fstream _os(output, std::fstream::out);
-        if (_os.fail())
+        CTextWriter _os(output);
+        if (!_os.is_open())
         {
             std::cerr << "error in opening file " << output << std::endl;
             return;
         }
 
         // write vertices
-        for (CVertex * v : m_verts)
+        std::vector<CVertex*> verts(m_verts.begin(), m_verts.end());
+        _os.records(verts.size(), threads, [&](size_t i, CFormatBuffer & b)
         {
-            _os << "Vertex " << v->id();
-            _os << " " << v->point();
+            CVertex * v = verts[i];
+            b << "Vertex " << v->id();
+            b << " " << v->point();
 
             if (v->string().size() > 0)
             {
-                _os << " " << "{" << v->string() << "}";
+                b << " " << "{" << v->string() << "}";
             }
-            _os << std::endl;
-        }
+            b << '\n';
+        });
 
-        for (CFace * f : m_faces)
+        std::vector<CFace*> faces(m_faces.begin(), m_faces.end());
+        _os.records(faces.size(), threads, [&](size_t i, CFormatBuffer & b)
         {
-            _os << "Face " << f->id();
-            for (CVertex * v : f->vertices())
-            {
-                _os << " " << v->id();
-            }
+            CFace * f = faces[i];
+            b << "Face " << f->id();
+            CHalfEdge * he = f->halfedge();
+            do {
+                b << " " << he->target()->id();
+                he = he->next();
+            } while (he != f->halfedge());
 
             if (f->string().size() > 0)
             {
-                _os << " " << "{" << f->string() << "}";
+                b << " " << "{" << f->string() << "}";
             }
-            _os << std::endl;
-        }
+            b << '\n';
+        });
 
+        CFormatBuffer b;
         for (CEdge * e : m_edges)
         {
             if (e->string().size() > 0)
             {
-                _os << "Edge " << e->vertex(0)->id() << " " << e->vertex(1)->id() << " ";
-                _os << "{" << e->string() << "}" << std::endl;
+                b << "Edge " << e->vertex(0)->id() << " " << e->vertex(1)->id() << " ";
+                b << "{" << e->string() << "}" << '\n';
             }
         }
 
@@ -1397,12 +1959,13 @@ namespace MeshLib {
         {
             if (he->string().size() > 0)
             {
-                _os << "Corner " << he->vertex()->id() << " " << he->face()->id() << " ";
-                _os << "{" << he->string() << "}" << std::endl;
+                b << "Corner " << he->vertex()->id() << " " << he->face()->id() << " ";
+                b << "{" << he->string() << "}" << '\n';
             }
         }
+        _os.write(b);
 
-        _os.close();
+        if (!_os.close()) std::cerr << "error in writing file " << output << std::endl;
     };
 
     //assume the mesh is with uv coordinates and normal vector for each vertex
@@ -1410,11 +1973,11 @@ namespace MeshLib {
         Write an .obj file.
         \param output the output .obj file name
     */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::write_obj(const char * output)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::write_obj(const char * output, int threads)
     {
-        std::fstream _os(output, std::fstream::out);
-        if (_os.fail())
+        CTextWriter _os(output);
+        if (!_os.is_open())
         {
             std::cerr << "error in opening file " << output << std::endl;
             return;
@@ -1422,103 +1985,1155 @@ namespace MeshLib {
 
         int vid = 0;
         for (CVertex * v : m_verts) v->id() = ++vid;
-        for (CVertex * v : m_verts)
+        std::vector<CVertex*> verts(m_verts.begin(), m_verts.end());
+        _os.records(verts.size(), threads, [&](size_t i, CFormatBuffer & b)
         {
-            _os << "v " << v->point() << std::endl;
-        }
-        for (CVertex * v : m_verts)
+            b << "v " << verts[i]->point() << '\n';
+        });
+        _os.records(verts.size(), threads, [&](size_t i, CFormatBuffer & b)
         {
-            _os << "vt " << v->uv() << std::endl;
-        }
-        for (CVertex * v : m_verts)
+            b << "vt " << verts[i]->uv() << '\n';
+        });
+        _os.records(verts.size(), threads, [&](size_t i, CFormatBuffer & b)
         {
-            _os << "vn " << v->normal() << std::endl;
-        }
+            b << "vn " << verts[i]->normal() << '\n';
+        });
 
-        for (CFace * f : m_faces)
+        std::vector<CFace*> faces(m_faces.begin(), m_faces.end());
+        _os.records(faces.size(), threads, [&](size_t i, CFormatBuffer & b)
         {
-            _os << "f";
+            CFace * f = faces[i];
+            b << "f";
             CHalfEdge *he = f->halfedge();
 
             do {
                 int vid = he->target()->id();
-                _os << " " << vid << "/" << vid << "/" << vid;
+                b << " " << vid << "/" << vid << "/" << vid;
                 he = he->next();
             } while (he != f->halfedge());
-            _os << std::endl;
-        }
+            b << '\n';
+        });
 
-        _os.close();
+        if (!_os.close()) std::cerr << "error in writing file " << output << std::endl;
     };
 
     /*!
         Write an .off file.
         \param output the output .off file name
     */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::write_off(const char * output)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::write_off(const char * output, int threads)
     {
-        std::fstream _os(output, std::fstream::out);
-        if (_os.fail())
+        CTextWriter _os(output);
+        if (!_os.is_open())
         {
             std::cerr << "error in opening file " << output << std::endl;
             return;
         }
 
-        _os << "OFF" << std::endl;
-        _os << m_verts.size() << " " << m_faces.size() << " " << m_edges.size() << std::endl;
+        CFormatBuffer header;
+        header << "OFF" << '\n';
+        header << m_verts.size() << " " << m_faces.size() << " " << m_edges.size() << '\n';
+        _os.write(header);
 
         int vid = 0;
         for (CVertex * v : m_verts) v->id() = vid++;
-        for (CVertex * v : m_verts) _os << v->point() << std::endl;
+        std::vector<CVertex*> verts(m_verts.begin(), m_verts.end());
+        _os.records(verts.size(), threads, [&](size_t i, CFormatBuffer & b)
+        {
+            b << verts[i]->point() << '\n';
+        });
 
-        for (CFace * f : m_faces)
+        std::vector<CFace*> faces(m_faces.begin(), m_faces.end());
+        _os.records(faces.size(), threads, [&](size_t i, CFormatBuffer & b)
         {
-            _os << "3";
+            CFace * f = faces[i];
+            b << "3";
             CHalfEdge * he = f->halfedge();
             do {
                 int vid = he->target()->id();
-                _os << " " << vid;
+                b << " " << vid;
                 he = he->next();
             } while (he != f->halfedge());
-            _os << std::endl;
-        }
+            b << '\n';
+        });
 
-        _os.close();
+        if (!_os.close()) std::cerr << "error in writing file " << output << std::endl;
     };
 
-    //template pointer converting to base class pointer is OK (BasePointer) = (TemplatePointer)
-    //(TemplatePointer)=(BasePointer) is incorrect
-    /*! delete one face
-    \param pFace the face to be deleted
+    /*!
+        Write an .smv binary cache.
+        \param output the output .smv file name
     */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::delete_face(CFace * pFace)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::write_smv(const std::string & output, bool with_uv, bool with_normal, const CMeshReport * report)
     {
-        typename std::map<int, CFace*>::iterator fiter = m_map_face.find(pFace->id());
-        if (fiter != m_map_face.end())
+        std::unordered_map<CVertex*, uint32_t> vindex;
+        vindex.reserve(m_verts.size());
+        std::vector<float> positions;
+        positions.reserve(3 * m_verts.size());
+        for (CVertex * v : m_verts)
         {
-            m_map_face.erase(fiter);
+            vindex[v] = (uint32_t)vindex.size();
+            for (int k = 0; k < 3; k++) positions.push_back((float)v->point()[k]);
         }
-        m_faces.remove(pFace);
 
-        //create halfedges
-        CHalfEdge * hes[3];
-
-        hes[0] = pFace->halfedge();
-        hes[1] = hes[0]->next();
-        hes[2] = hes[1]->next();
-
-        for (int i = 0; i < 3; i++)
+        std::vector<uint32_t> indices;
+        std::vector<float> uvs, normals;
+        std::vector<CHalfEdge*> corners;
+        bool triangles = true;
+        for (CFace * f : m_faces)
         {
-            //connection with edge
-            CHalfEdge * pH = hes[i];
-
-            //connection to target
-            CVertex * pV = pH->target();
-            if (pV->halfedge() == pH)
+            CHalfEdge * h0 = f->halfedge();
+            CHalfEdge * h1 = h0->next();
+            triangles = triangles && h1->next()->next() == h0;
+            // fan around the target of h0, triangles keep halfedge() as their last corner
+            for (CHalfEdge * he = h1; he->next() != h0; he = he->next())
             {
-                if (pH->next()->dual() != NULL)
+                CHalfEdge * tri[3] = { he, he->next(), h0 };
+                for (CHalfEdge * c : tri)
+                {
+                    corners.push_back(c);
+                    indices.push_back(vindex[c->vertex()]);
+                    if (with_uv) { uvs.push_back((float)c->uv()[0]); uvs.push_back((float)c->uv()[1]); }
+                    if (with_normal) for (int k = 0; k < 3; k++) normals.push_back((float)c->normal()[k]);
+                }
+            }
+        }
+
+        // twin corners are only meaningful when the corners are the halfedges
+        std::vector<int32_t> twins, outgoing;
+        if (triangles)
+        {
+            std::unordered_map<CHalfEdge*, int32_t> cindex;
+            cindex.reserve(corners.size());
+            for (size_t c = 0; c < corners.size(); c++) cindex[corners[c]] = (int32_t)c;
+            twins.resize(corners.size());
+            for (size_t c = 0; c < corners.size(); c++)
+            {
+                CHalfEdge * d = corners[c]->dual();
+                twins[c] = d ? cindex[d] : -1;
+            }
+            // the outgoing corner of every vertex as CCompactMesh picks it, the boundary one if any
+            outgoing.assign(m_verts.size(), -1);
+            for (size_t c = 0; c < corners.size(); c++)
+            {
+                const int32_t out = (int32_t)(c % 3 == 2 ? c - 2 : c + 1);
+                int32_t & vh = outgoing[indices[c]];
+                if (vh < 0 || twins[out] < 0) vh = out;
+            }
+        }
+
+        bool ok = write_smv_file(output, m_verts.size(), indices.size() / 3, positions.data(),
+            with_uv ? uvs.data() : NULL, with_normal ? normals.data() : NULL, indices.data(),
+            triangles ? twins.data() : NULL, triangles ? outgoing.data() : NULL, report);
+        if (!ok) std::cerr << "error in writing file " << output << std::endl;
+        return ok;
+    };
+
+    /*!
+        Read an .smv binary cache.
+        \param input the input .smv file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::read_smv(const std::string & input)
+    {
+        CSmvFile smv(input);
+        if (!smv.is_open()) return false;
+
+        const size_t nv = smv.num_vertices();
+        const size_t nc = 3 * smv.num_triangles();
+
+        // a damaged cache is left for the source mesh, not built into one label_boundary stops on:
+        // the corners name vertices, and a twin corner is the halfedge back along the same edge
+        const uint32_t * idx = smv.indices();
+        const int32_t * twins = smv.twins();
+        for (size_t c = 0; c < nc; c++)
+        {
+            if (idx[c] >= nv) return false;
+        }
+        for (size_t c = 0; twins && c < nc; c++)
+        {
+            const int32_t t = twins[c];
+            if (t == -1) continue;
+            if (t < 0 || (size_t)t >= nc || (size_t)t == c || twins[t] != (int32_t)c) return false;
+            const size_t pc = c % 3 == 0 ? c + 2 : c - 1, pt = t % 3 == 0 ? t + 2 : t - 1;
+            if (idx[t] != idx[pc] || idx[pt] != idx[c]) return false;
+        }
+
+        std::vector<CPoint> points(nv);
+        const float * p = smv.positions();
+        for (size_t i = 0; i < nv; i++) points[i] = CPoint(p[3 * i], p[3 * i + 1], p[3 * i + 2]);
+
+        std::vector<int> indices(idx, idx + nc);
+        std::vector<int> corner_ids;
+        if (smv.uvs() || smv.normals())
+        {
+            corner_ids.resize(nc);
+            for (size_t c = 0; c < nc; c++) corner_ids[c] = (int)c;
+        }
+
+        std::vector<CPoint2> uvs;
+        if (const float * t = smv.uvs())
+        {
+            uvs.resize(nc);
+            for (size_t c = 0; c < nc; c++) uvs[c] = CPoint2(t[2 * c], t[2 * c + 1]);
+        }
+        std::vector<CPoint> normals;
+        if (const float * n = smv.normals())
+        {
+            normals.resize(nc);
+            for (size_t c = 0; c < nc; c++) normals[c] = CPoint(n[3 * c], n[3 * c + 1], n[3 * c + 2]);
+        }
+
+        _build_from_arrays(points, uvs, normals, indices, std::vector<int>(),
+            uvs.empty() ? std::vector<int>() : corner_ids, normals.empty() ? std::vector<int>() : corner_ids,
+            (const int *)twins);
+        return true;
+    };
+
+    /*!
+        The state of the mesh as flat arrays by slot, see parser/ckp.h.
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline std::shared_ptr<CCheckpoint> CBaseMesh<V, E, F, H, A, P>::checkpoint(int threads)
+    {
+        MESHLIB_TRACE_ZONE("checkpoint");
+        std::shared_ptr<CCheckpoint> c = std::make_shared<CCheckpoint>();
+        _checkpoint_kind<CVertex, V>(*c, "vertices", m_verts, m_properties->vertices, threads);
+        _checkpoint_kind<CEdge, E>(*c, "edges", m_edges, m_properties->edges, threads);
+        _checkpoint_kind<CFace, F>(*c, "faces", m_faces, m_properties->faces, threads);
+        _checkpoint_kind<CHalfEdge, H>(*c, "halfedges", m_halfedges, m_properties->halfedges, threads);
+        const CPropertySet & vs = m_properties->vertices, & es = m_properties->edges;
+        const CPropertySet & fs = m_properties->faces, & hs = m_properties->halfedges;
+
+        _column<double>(*c, "vertices.point", 3, m_verts, vs, threads, [](CVertex * v, double * out)
+        {
+            for (int k = 0; k < 3; k++) out[k] = v->m_point[k];
+        });
+        _column<uint32_t>(*c, "vertices.halfedge", 1, m_verts, vs, threads, [](CVertex * v, uint32_t * out) { *out = _slot(v->m_halfedge); });
+        _column<int32_t>(*c, "vertices.id", 1, m_verts, vs, threads, [](CVertex * v, int32_t * out) { *out = v->m_id; });
+        _column<uint8_t>(*c, "vertices.flags", 1, m_verts, vs, threads, [](CVertex * v, uint8_t * out)
+        {
+            *out = (uint8_t)((v->m_boundary ? 1 : 0) | (v->m_touched ? 2 : 0) | (v->m_dangling ? 4 : 0));
+        });
+
+        _column<uint32_t>(*c, "edges.halfedge", 2, m_edges, es, threads, [](CEdge * e, uint32_t * out)
+        {
+            out[0] = _slot(e->m_halfedge[0]);
+            out[1] = _slot(e->m_halfedge[1]);
+        });
+        _column<uint8_t>(*c, "edges.flags", 1, m_edges, es, threads, [](CEdge * e, uint8_t * out) { *out = e->m_touched ? 2 : 0; });
+        _column<double>(*c, "edges.length", 1, m_edges, es, threads, [](CEdge * e, double * out) { *out = e->m_length; });
+
+        _column<uint32_t>(*c, "faces.halfedge", 1, m_faces, fs, threads, [](CFace * f, uint32_t * out) { *out = _slot(f->m_halfedge); });
+        _column<int32_t>(*c, "faces.id", 1, m_faces, fs, threads, [](CFace * f, int32_t * out) { *out = f->m_id; });
+        _column<uint8_t>(*c, "faces.flags", 1, m_faces, fs, threads, [](CFace * f, uint8_t * out) { *out = f->m_touched ? 2 : 0; });
+
+        // edge, face, vertex, prev and next of every halfedge
+        _column<uint32_t>(*c, "halfedges.links", 5, m_halfedges, hs, threads, [](CHalfEdge * he, uint32_t * out)
+        {
+            out[0] = _slot(he->m_edge);
+            out[1] = _slot(he->m_face);
+            out[2] = _slot(he->m_vertex);
+            out[3] = _slot(he->m_prev);
+            out[4] = _slot(he->m_next);
+        });
+        _column<uint8_t>(*c, "halfedges.flags", 1, m_halfedges, hs, threads, [](CHalfEdge * he, uint8_t * out) { *out = he->m_touched ? 2 : 0; });
+        _column<double>(*c, "halfedges.length", 1, m_halfedges, hs, threads, [](CHalfEdge * he, double * out) { *out = he->m_length; });
+
+        if (P::s_uv)
+        {
+            _column<double>(*c, "vertices.uv", 2, m_verts, vs, threads, [](CVertex * v, double * out) { out[0] = v->uv()[0]; out[1] = v->uv()[1]; });
+            _column<double>(*c, "halfedges.uv", 2, m_halfedges, hs, threads, [](CHalfEdge * he, double * out) { out[0] = he->uv()[0]; out[1] = he->uv()[1]; });
+        }
+        if (P::s_normal)
+        {
+            _column<double>(*c, "vertices.normal", 3, m_verts, vs, threads, [](CVertex * v, double * out) { for (int k = 0; k < 3; k++) out[k] = v->normal()[k]; });
+            _column<double>(*c, "halfedges.normal", 3, m_halfedges, hs, threads, [](CHalfEdge * he, double * out) { for (int k = 0; k < 3; k++) out[k] = he->normal()[k]; });
+        }
+        return c;
+    };
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    template<typename T, typename B>
+    inline void CBaseMesh<V, E, F, H, A, P>::_checkpoint_kind(CCheckpoint & c, const std::string & kind, CElementList<T> & list, CPropertySet & set, int threads)
+    {
+        const uint64_t size = set.size();
+        c.add(kind + ".size", &size, 1);
+        std::vector<uint32_t> free(set.free_indices().begin(), set.free_indices().end());
+        c.add(kind + ".free", free.data(), free.size());
+        uint32_t * order = c.add<uint32_t>(kind + ".order", list.size());
+        size_t n = 0;
+        for (T * t : list) order[n++] = (uint32_t)t->m_property_index;
+
+        if (P::s_string)
+        {
+            // the lengths by slot, then the characters after one another
+            uint64_t * offsets = c.add<uint64_t>(kind + ".strings.offsets", size + 1);
+            std::fill(offsets, offsets + size + 1, 0);
+            _for_each(list, threads, [&](T * t) { offsets[t->m_property_index + 1] = t->trait_string().size(); });
+            for (size_t i = 0; i < size; i++) offsets[i + 1] += offsets[i];
+            char * text = c.add<char>(kind + ".strings", (size_t)offsets[size]);
+            _for_each(list, threads, [&](T * t)
+            {
+                const size_t i = t->m_property_index;
+                if (offsets[i + 1] > offsets[i]) memcpy(text + offsets[i], t->trait_string().data(), (size_t)(offsets[i + 1] - offsets[i]));
+            });
+        }
+        _checkpoint_members<T, B>(c, kind, list, set, threads, _raw_members<B>());
+
+        // the arrays as they are, those of other types are left out
+        for (const std::unique_ptr<CBaseProperty> & p : set.properties())
+        {
+            if (p->bytes() == NULL) continue;
+            const size_t bytes = p->value_size() * (size_t)size;
+            _copy_bytes(c.add(kind + ".property." + p->name(), (size_t)size, p->value_size()), p->bytes(), bytes, threads);
+            c.add(kind + ".type." + p->name(), std::string(p->type_name()));
+            c.add(kind + ".init." + p->name(), p->initial_bytes(), p->value_size());
+        }
+    };
+
+    /*!
+        Go back to a checkpoint.
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::restore(const CCheckpoint & c, int threads)
+    {
+        MESHLIB_TRACE_ZONE("restore");
+        // the arrays every mesh has, in the lengths of the slots, before anything is dropped
+        const char * kinds[4] = { "vertices", "edges", "faces", "halfedges" };
+        size_t sizes[4];
+        // 1 for the slots of the elements, 2 for the free ones
+        std::vector<uint8_t> live[4];
+        for (int k = 0; k < 4; k++)
+        {
+            const std::string kind = kinds[k];
+            const uint64_t * size = c.get<uint64_t>(kind + ".size", 1);
+            const CCheckpoint::CBlock * order = c.find(kind + ".order");
+            const CCheckpoint::CBlock * free = c.find(kind + ".free");
+            if (size == NULL || order == NULL || free == NULL || order->size != 4 * order->count || free->size != 4 * free->count) return false;
+            // every slot has values in the columns, a damaged size is larger than the checkpoint
+            if (*size > c.memory()) return false;
+            sizes[k] = (size_t)*size;
+            live[k].assign(sizes[k], 0);
+            const uint32_t * o = (const uint32_t *)order->data;
+            for (uint64_t i = 0; i < order->count; i++)
+            {
+                if (o[i] >= sizes[k]) return false;
+                live[k][o[i]] = 1;
+            }
+            // a free slot once, and not one of an element
+            const uint32_t * f = (const uint32_t *)free->data;
+            for (uint64_t i = 0; i < free->count; i++)
+            {
+                if (f[i] >= sizes[k] || live[k][f[i]] != 0) return false;
+                live[k][f[i]] = 2;
+            }
+            if (P::s_string && !_valid_strings(c, kind, sizes[k])) return false;
+        }
+        const size_t nv = sizes[0], ne = sizes[1], nf = sizes[2], nh = sizes[3];
+        if (!c.get<double>("vertices.point", 3 * nv) || !c.get<uint32_t>("vertices.halfedge", nv) || !c.get<int32_t>("vertices.id", nv) ||
+            !c.get<uint32_t>("edges.halfedge", 2 * ne) || !c.get<uint32_t>("faces.halfedge", nf) || !c.get<int32_t>("faces.id", nf) ||
+            !c.get<uint32_t>("halfedges.links", 5 * nh)) return false;
+        if (!_valid_links(c, sizes, live)) return false;
+
+        // the mesh as it is goes
+        for (CVertex * v : m_verts) m_allocator.destroy(v);
+        for (CFace * f : m_faces) m_allocator.destroy(f);
+        for (CEdge * e : m_edges) m_allocator.destroy(e);
+        for (CHalfEdge * he : m_halfedges) m_allocator.destroy(he);
+        m_verts.clear();
+        m_faces.clear();
+        m_edges.clear();
+        m_halfedges.clear();
+        m_map_vert.clear();
+        m_map_face.clear();
+        m_edge_hash.clear();
+        m_trait_files.clear();
+
+        std::vector<CVertex*> vslots;
+        std::vector<CEdge*> eslots;
+        std::vector<CFace*> fslots;
+        std::vector<CHalfEdge*> hslots;
+        _restore_elements(c, "vertices", m_verts, m_properties->vertices, vslots);
+        _restore_elements(c, "edges", m_edges, m_properties->edges, eslots);
+        _restore_elements(c, "faces", m_faces, m_properties->faces, fslots);
+        _restore_elements(c, "halfedges", m_halfedges, m_properties->halfedges, hslots);
+        _restore_kind<CVertex, V>(c, "vertices", m_properties->vertices, vslots, threads);
+        _restore_kind<CEdge, E>(c, "edges", m_properties->edges, eslots, threads);
+        _restore_kind<CFace, F>(c, "faces", m_properties->faces, fslots, threads);
+        _restore_kind<CHalfEdge, H>(c, "halfedges", m_properties->halfedges, hslots, threads);
+
+        _uncolumn<double>(c, "vertices.point", 3, vslots, threads, [](CVertex * v, const double * in) { v->m_point = CPoint(in[0], in[1], in[2]); });
+        _uncolumn<uint32_t>(c, "vertices.halfedge", 1, vslots, threads, [&](CVertex * v, const uint32_t * in) { v->m_halfedge = _at(hslots, *in); });
+        _uncolumn<int32_t>(c, "vertices.id", 1, vslots, threads, [](CVertex * v, const int32_t * in) { v->m_id = *in; });
+        _uncolumn<uint8_t>(c, "vertices.flags", 1, vslots, threads, [](CVertex * v, const uint8_t * in)
+        {
+            v->m_boundary = (*in & 1) != 0;
+            v->m_touched = (*in & 2) != 0;
+            v->m_dangling = (*in & 4) != 0;
+        });
+
+        _uncolumn<uint32_t>(c, "edges.halfedge", 2, eslots, threads, [&](CEdge * e, const uint32_t * in)
+        {
+            e->m_halfedge[0] = _at(hslots, in[0]);
+            e->m_halfedge[1] = _at(hslots, in[1]);
+        });
+        _uncolumn<uint8_t>(c, "edges.flags", 1, eslots, threads, [](CEdge * e, const uint8_t * in) { e->m_touched = (*in & 2) != 0; });
+        _uncolumn<double>(c, "edges.length", 1, eslots, threads, [](CEdge * e, const double * in) { e->m_length = *in; });
+
+        _uncolumn<uint32_t>(c, "faces.halfedge", 1, fslots, threads, [&](CFace * f, const uint32_t * in) { f->m_halfedge = _at(hslots, *in); });
+        _uncolumn<int32_t>(c, "faces.id", 1, fslots, threads, [](CFace * f, const int32_t * in) { f->m_id = *in; });
+        _uncolumn<uint8_t>(c, "faces.flags", 1, fslots, threads, [](CFace * f, const uint8_t * in) { f->m_touched = (*in & 2) != 0; });
+
+        _uncolumn<uint32_t>(c, "halfedges.links", 5, hslots, threads, [&](CHalfEdge * he, const uint32_t * in)
+        {
+            he->m_edge = _at(eslots, in[0]);
+            he->m_face = _at(fslots, in[1]);
+            he->m_vertex = _at(vslots, in[2]);
+            he->m_prev = _at(hslots, in[3]);
+            he->m_next = _at(hslots, in[4]);
+        });
+        _uncolumn<uint8_t>(c, "halfedges.flags", 1, hslots, threads, [](CHalfEdge * he, const uint8_t * in) { he->m_touched = (*in & 2) != 0; });
+        _uncolumn<double>(c, "halfedges.length", 1, hslots, threads, [](CHalfEdge * he, const double * in) { he->m_length = *in; });
+
+        if (P::s_uv)
+        {
+            _uncolumn<double>(c, "vertices.uv", 2, vslots, threads, [](CVertex * v, const double * in) { v->uv() = CPoint2(in[0], in[1]); });
+            _uncolumn<double>(c, "halfedges.uv", 2, hslots, threads, [](CHalfEdge * he, const double * in) { he->uv() = CPoint2(in[0], in[1]); });
+        }
+        if (P::s_normal)
+        {
+            _uncolumn<double>(c, "vertices.normal", 3, vslots, threads, [](CVertex * v, const double * in) { v->normal() = CPoint(in[0], in[1], in[2]); });
+            _uncolumn<double>(c, "halfedges.normal", 3, hslots, threads, [](CHalfEdge * he, const double * in) { he->normal() = CPoint(in[0], in[1], in[2]); });
+        }
+
+        m_map_vert.reserve(m_verts.size());
+        m_map_face.reserve(m_faces.size());
+        for (CVertex * v : m_verts) m_map_vert.insert(v->m_id, v);
+        for (CFace * f : m_faces) m_map_face.insert(f->m_id, f);
+        _index_edges();
+        m_topology_version++;
+        m_geometry_version++;
+        return true;
+    };
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::_valid_strings(const CCheckpoint & c, const std::string & kind, size_t size)
+    {
+        // the strings are left out without their blocks, their offsets run up to the characters
+        const uint64_t * offsets = c.get<uint64_t>(kind + ".strings.offsets", size + 1);
+        const CCheckpoint::CBlock * text = c.find(kind + ".strings");
+        if (offsets == NULL || text == NULL) return true;
+        for (size_t i = 0; i < size; i++) if (offsets[i + 1] < offsets[i]) return false;
+        return offsets[size] == text->size;
+    };
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::_valid_links(const CCheckpoint & c, const size_t sizes[4], const std::vector<uint8_t> live[4])
+    {
+        const uint32_t none = UINT32_MAX;
+        auto is = [&](int k, uint32_t i) { return i < sizes[k] && live[k][i] == 1; };
+        const uint32_t * vh = c.get<uint32_t>("vertices.halfedge", sizes[0]);
+        const uint32_t * eh = c.get<uint32_t>("edges.halfedge", 2 * sizes[1]);
+        const uint32_t * fh = c.get<uint32_t>("faces.halfedge", sizes[2]);
+        const uint32_t * hl = c.get<uint32_t>("halfedges.links", 5 * sizes[3]);
+
+        // every link to an element of its kind, NULL only where a mesh leaves it so, and the links
+        // both ways agree, so the traversals of the mesh restored come round
+        for (size_t h = 0; h < sizes[3]; h++)
+        {
+            if (live[3][h] != 1) continue;
+            // edge, face, vertex, prev and next
+            const uint32_t * l = hl + 5 * h;
+            if (!is(1, l[0]) || (l[1] != none && !is(2, l[1])) || !is(0, l[2]) || !is(3, l[3]) || !is(3, l[4])) return false;
+            if (hl[5 * l[4] + 3] != h || hl[5 * l[4] + 1] != l[1]) return false;
+            if (eh[2 * l[0]] != h && eh[2 * l[0] + 1] != h) return false;
+        }
+        for (size_t e = 0; e < sizes[1]; e++)
+        {
+            if (live[1][e] != 1) continue;
+            if (!is(3, eh[2 * e]) || hl[5 * eh[2 * e]] != e) return false;
+            if (eh[2 * e + 1] != none && (!is(3, eh[2 * e + 1]) || hl[5 * eh[2 * e + 1]] != e)) return false;
+        }
+        for (size_t f = 0; f < sizes[2]; f++)
+        {
+            if (live[2][f] == 1 && (!is(3, fh[f]) || hl[5 * fh[f] + 1] != f)) return false;
+        }
+        for (size_t v = 0; v < sizes[0]; v++)
+        {
+            if (live[0][v] == 1 && vh[v] != none && (!is(3, vh[v]) || hl[5 * vh[v] + 2] != v)) return false;
+        }
+        return true;
+    };
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    template<typename T>
+    inline void CBaseMesh<V, E, F, H, A, P>::_restore_elements(const CCheckpoint & c, const std::string & kind, CElementList<T> & list, CPropertySet & set, std::vector<T*> & slots)
+    {
+        const CCheckpoint::CBlock * order = c.find(kind + ".order");
+        const CCheckpoint::CBlock * free = c.find(kind + ".free");
+        const uint32_t * f = (const uint32_t *)free->data;
+        set.restore((size_t)*c.get<uint64_t>(kind + ".size", 1), std::vector<size_t>(f, f + free->count));
+
+        slots.assign(set.size(), NULL);
+        const uint32_t * o = (const uint32_t *)order->data;
+        std::vector<T*> elements((size_t)order->count);
+        m_allocator.template reserve<T>(elements.size());
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            // a slot listed twice keeps its first element
+            if (slots[o[i]]) continue;
+            T * t = m_allocator.template create<T>();
+            t->m_property_index = o[i];
+            slots[o[i]] = elements[i] = t;
+        }
+        elements.erase(std::remove(elements.begin(), elements.end(), (T *)NULL), elements.end());
+        list.assign(elements);
+    };
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    template<typename T, typename B>
+    inline void CBaseMesh<V, E, F, H, A, P>::_restore_kind(const CCheckpoint & c, const std::string & kind, CPropertySet & set, const std::vector<T*> & slots, int threads)
+    {
+        const size_t size = slots.size();
+        if (P::s_string)
+        {
+            const uint64_t * offsets = c.get<uint64_t>(kind + ".strings.offsets", size + 1);
+            const CCheckpoint::CBlock * text = c.find(kind + ".strings");
+            // checked by _valid_strings
+            if (offsets && text)
+            {
+                parallel_for(size, threads, [&](size_t b, size_t e)
+                {
+                    for (size_t i = b; i < e; i++)
+                    {
+                        if (slots[i] == NULL || offsets[i + 1] <= offsets[i]) continue;
+                        slots[i]->string().assign(text->data + offsets[i], (size_t)(offsets[i + 1] - offsets[i]));
+                    }
+                }, s_grain);
+            }
+        }
+        _restore_members<T, B>(c, kind, slots, threads, _raw_members<B>());
+
+        const std::string prefix = kind + ".property.";
+        for (const CCheckpoint::CBlock & b : c.blocks())
+        {
+            if (b.name.compare(0, prefix.size(), prefix) != 0) continue;
+            const std::string name = b.name.substr(prefix.size());
+            const CCheckpoint::CBlock * init = c.find(kind + ".init." + name);
+            // the values of every slot, without the product overflowing for a damaged init
+            if (init == NULL || init->size == 0 || b.count != size || (size ? b.size % size != 0 || b.size / size != init->size : b.size != 0)) continue;
+            char * to = set.restore(name, c.text(kind + ".type." + name), (size_t)init->size, init->data);
+            if (to) _copy_bytes(to, b.data, (size_t)b.size, threads);
+        }
+    };
+
+    /*!
+        The fan triangulated faces as wedges.
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::_triangle_wedges(CCmvMesh & out, bool with_uv, bool with_normal)
+    {
+        std::unordered_map<CVertex*, uint32_t> vindex;
+        vindex.reserve(m_verts.size());
+        out.positions.reserve(3 * m_verts.size());
+        for (CVertex * v : m_verts)
+        {
+            vindex[v] = (uint32_t)vindex.size();
+            for (int k = 0; k < 3; k++) out.positions.push_back(v->point()[k]);
+        }
+
+        // a wedge per vertex and distinct uv and normal, the wedges of a vertex in a list
+        std::vector<uint32_t> first(vindex.size(), UINT32_MAX), next;
+        for (CFace * f : m_faces)
+        {
+            CHalfEdge * h0 = f->halfedge();
+            for (CHalfEdge * he = h0->next(); he->next() != h0; he = he->next())
+            {
+                CHalfEdge * tri[3] = { he, he->next(), h0 };
+                for (CHalfEdge * c : tri)
+                {
+                    const uint32_t v = vindex[c->vertex()];
+                    float t[2] = { 0, 0 }, n[3] = { 0, 0, 0 };
+                    if (with_uv) for (int k = 0; k < 2; k++) t[k] = (float)c->uv()[k];
+                    if (with_normal) for (int k = 0; k < 3; k++) n[k] = (float)c->normal()[k];
+                    uint32_t w = first[v];
+                    while (w != UINT32_MAX && ((with_uv && memcmp(&out.uvs[2 * w], t, sizeof(t)) != 0) ||
+                        (with_normal && memcmp(&out.normals[3 * w], n, sizeof(n)) != 0))) w = next[w];
+                    if (w == UINT32_MAX)
+                    {
+                        w = (uint32_t)out.wedge_vertex.size();
+                        out.wedge_vertex.push_back(v);
+                        next.push_back(first[v]);
+                        first[v] = w;
+                        if (with_uv) out.uvs.insert(out.uvs.end(), t, t + 2);
+                        if (with_normal) out.normals.insert(out.normals.end(), n, n + 3);
+                    }
+                    out.wedges.push_back(w);
+                }
+            }
+        }
+    };
+
+    /*!
+        Write a .cmv compressed mesh.
+        \param output the output .cmv file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::write_cmv(const std::string & output, bool with_uv, bool with_normal, int position_bits, int threads)
+    {
+        CCmvMesh cmv;
+        _triangle_wedges(cmv, with_uv, with_normal);
+
+        CCmvCodec codec;
+        codec.position_bits = position_bits;
+        bool ok = codec.write(output, cmv, threads);
+        if (!ok) std::cerr << "error in writing file " << output << std::endl;
+        return ok;
+    };
+
+    /*!
+        Read a .cmv compressed mesh.
+        \param input the input .cmv file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::read_cmv(const std::string & input, int threads)
+    {
+        CCmvMesh cmv;
+        if (!CCmvCodec::read(input, cmv, threads)) return false;
+
+        const size_t nv = cmv.num_vertices();
+        const size_t nw = cmv.num_wedges();
+        std::vector<CPoint> points(nv);
+        for (size_t i = 0; i < nv; i++) points[i] = CPoint(cmv.positions[3 * i], cmv.positions[3 * i + 1], cmv.positions[3 * i + 2]);
+
+        std::vector<int> indices(cmv.wedges.size());
+        for (size_t c = 0; c < indices.size(); c++) indices[c] = (int)cmv.wedge_vertex[cmv.wedges[c]];
+        std::vector<int> wedges;
+        if (!cmv.uvs.empty() || !cmv.normals.empty()) wedges.assign(cmv.wedges.begin(), cmv.wedges.end());
+
+        std::vector<CPoint2> uvs;
+        if (!cmv.uvs.empty())
+        {
+            uvs.resize(nw);
+            for (size_t w = 0; w < nw; w++) uvs[w] = CPoint2(cmv.uvs[2 * w], cmv.uvs[2 * w + 1]);
+        }
+        std::vector<CPoint> normals;
+        if (!cmv.normals.empty())
+        {
+            normals.resize(nw);
+            for (size_t w = 0; w < nw; w++) normals[w] = CPoint(cmv.normals[3 * w], cmv.normals[3 * w + 1], cmv.normals[3 * w + 2]);
+        }
+
+        _build_from_arrays(points, uvs, normals, indices, std::vector<int>(),
+            uvs.empty() ? std::vector<int>() : wedges, normals.empty() ? std::vector<int>() : wedges, NULL);
+        return true;
+    };
+
+    /*!
+        Read a .ply file.
+        \param input the input .ply file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::read_ply(const std::string & input, int threads)
+    {
+        CPlyFile ply(input);
+        if (!ply.is_open()) return false;
+        const CPlyElement * ve = ply.element("vertex");
+        const CPlyElement * fe = ply.element("face");
+        if (ve == NULL) return false;
+
+        // the first of the names a column goes by
+        auto columns = [ve](std::initializer_list<const char *> names, int n, int * props)
+        {
+            const char * const * name = names.begin();
+            for (size_t i = 0; i < names.size(); i += n, name += n)
+            {
+                bool all = true;
+                for (int k = 0; k < n; k++) all = all && (props[k] = ve->find(name[k])) >= 0;
+                if (all) return true;
+            }
+            return false;
+        };
+        int xyz[3], nxyz[3], st[2];
+        if (!columns({ "x", "y", "z" }, 3, xyz)) return false;
+        const bool with_normal = columns({ "nx", "ny", "nz" }, 3, nxyz);
+        const bool with_uv = columns({ "s", "t", "u", "v", "texture_u", "texture_v" }, 2, st);
+
+        const size_t nv = ve->count;
+        std::vector<double> values(3 * nv);
+        if (!ply.read(*ve, xyz, 3, values.data(), threads)) return false;
+        std::vector<CPoint> points(nv);
+        for (size_t i = 0; i < nv; i++) points[i] = CPoint(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+        std::vector<CPoint> normals;
+        if (with_normal)
+        {
+            if (!ply.read(*ve, nxyz, 3, values.data(), threads)) return false;
+            normals.resize(nv);
+            for (size_t i = 0; i < nv; i++) normals[i] = CPoint(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+        }
+        std::vector<CPoint2> uvs;
+        if (with_uv)
+        {
+            if (!ply.read(*ve, st, 2, values.data(), threads)) return false;
+            uvs.resize(nv);
+            for (size_t i = 0; i < nv; i++) uvs[i] = CPoint2(values[2 * i], values[2 * i + 1]);
+        }
+
+        std::vector<int> indices, offsets;
+        if (fe)
+        {
+            int list = fe->find("vertex_indices");
+            if (list < 0) list = fe->find("vertex_index");
+            if (!ply.read_lists(*fe, list, indices, offsets, threads)) return false;
+            for (int c : indices) if (c < 0 || (size_t)c >= nv) return false;
+        }
+        if (offsets.empty()) offsets.push_back(0);
+
+        build_from_arrays(points, uvs, normals, indices, offsets, std::vector<int>(), std::vector<int>());
+        return true;
+    };
+
+    /*!
+        Write a .ply file.
+        \param output the output .ply file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::write_ply(const std::string & output, bool with_uv, bool with_normal)
+    {
+        std::unordered_map<CVertex*, uint32_t> vindex;
+        vindex.reserve(m_verts.size());
+        std::vector<double> positions, normals, uvs;
+        positions.reserve(3 * m_verts.size());
+        for (CVertex * v : m_verts)
+        {
+            vindex[v] = (uint32_t)vindex.size();
+            for (int k = 0; k < 3; k++) positions.push_back(v->point()[k]);
+            if (with_normal) for (int k = 0; k < 3; k++) normals.push_back(v->normal()[k]);
+            if (with_uv) for (int k = 0; k < 2; k++) uvs.push_back(v->uv()[k]);
+        }
+
+        std::vector<uint32_t> indices, offsets(1, 0);
+        for (CFace * f : m_faces)
+        {
+            CHalfEdge * he = f->halfedge();
+            do {
+                indices.push_back(vindex[he->target()]);
+                he = he->next();
+            } while (he != f->halfedge());
+            offsets.push_back((uint32_t)indices.size());
+        }
+
+        bool ok = write_ply_file(output, vindex.size(), positions.data(), with_normal ? normals.data() : NULL,
+            with_uv ? uvs.data() : NULL, offsets.size() - 1, indices.data(), offsets.data());
+        if (!ok) std::cerr << "error in writing file " << output << std::endl;
+        return ok;
+    };
+
+    /*!
+        Read a .glb file.
+        \param input the input .glb file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::read_glb(const std::string & input, int threads)
+    {
+        CGlbFile glb(input);
+        if (!glb.is_open()) return false;
+
+        // the glTF vertices of all primitives, the corners index them
+        std::vector<float> positions, normals, uvs;
+        std::vector<int> corners;
+        bool with_uv = false, with_normal = false;
+        const CJsonValue & meshes = glb.json()["meshes"];
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            const CJsonValue & primitives = meshes[m]["primitives"];
+            for (size_t i = 0; i < primitives.size(); i++)
+            {
+                const CJsonValue & prim = primitives[i];
+                CGlbAccessor pos, nor, tex, idx;
+                if (prim["mode"].as_int(GLTF_TRIANGLES) != GLTF_TRIANGLES) continue;
+                if (!glb.accessor(prim["attributes"]["POSITION"].as_int(), pos) || pos.components != 3) continue;
+                const bool has_normal = glb.accessor(prim["attributes"]["NORMAL"].as_int(), nor) && nor.components == 3 && nor.count == pos.count;
+                const bool has_uv = glb.accessor(prim["attributes"]["TEXCOORD_0"].as_int(), tex) && tex.components == 2 && tex.count == pos.count;
+                const bool indexed = !prim["indices"].is_null();
+                if (indexed && (!glb.accessor(prim["indices"].as_int(), idx) || idx.components != 1)) continue;
+
+                // data() and an offset, not &v[i], which is past the end of a vector an empty accessor leaves empty
+                const size_t base = positions.size() / 3;
+                positions.resize(3 * (base + pos.count));
+                CGlbFile::read(pos, positions.data() + 3 * base, threads);
+                normals.resize(3 * (base + pos.count), 0.0f);
+                if (has_normal) CGlbFile::read(nor, normals.data() + 3 * base, threads);
+                uvs.resize(2 * (base + pos.count), 0.0f);
+                if (has_uv) CGlbFile::read(tex, uvs.data() + 2 * base, threads);
+                with_normal = with_normal || has_normal;
+                with_uv = with_uv || has_uv;
+
+                const size_t first = corners.size();
+                const size_t count = (indexed ? idx.count : pos.count) / 3 * 3;
+                // all the indices read, the ones past the last whole triangle dropped
+                corners.resize(first + (indexed ? idx.count : count));
+                if (indexed) CGlbFile::read(idx, corners.data() + first, threads);
+                corners.resize(first + count);
+                if (!indexed) for (size_t c = 0; c < count; c++) corners[first + c] = (int)c;
+                for (size_t c = first; c < first + count; c++)
+                {
+                    if (corners[c] < 0 || (size_t)corners[c] >= pos.count) return false;
+                    corners[c] += (int)base;
+                }
+            }
+        }
+        if (corners.empty()) return false;
+
+        // glTF vertices at the same position are one vertex of the mesh
+        struct Key
+        {
+            float p[3];
+            bool operator==(const Key & k) const { return memcmp(p, k.p, sizeof(p)) == 0; }
+        };
+        struct KeyHash
+        {
+            size_t operator()(const Key & k) const
+            {
+                uint32_t b[3];
+                memcpy(b, k.p, sizeof(b));
+                return (size_t)(b[0] * 73856093u ^ b[1] * 19349663u ^ b[2] * 83492791u);
+            }
+        };
+        const size_t nw = positions.size() / 3;
+        std::unordered_map<Key, int, KeyHash> weld;
+        weld.reserve(nw);
+        std::vector<int> vertex(nw);
+        std::vector<CPoint> points;
+        for (size_t w = 0; w < nw; w++)
+        {
+            Key k;
+            memcpy(k.p, &positions[3 * w], sizeof(k.p));
+            auto it = weld.emplace(k, (int)points.size());
+            if (it.second) points.push_back(CPoint(k.p[0], k.p[1], k.p[2]));
+            vertex[w] = it.first->second;
+        }
+
+        std::vector<int> indices(corners.size());
+        for (size_t c = 0; c < corners.size(); c++) indices[c] = vertex[corners[c]];
+        std::vector<CPoint2> tuvs;
+        if (with_uv)
+        {
+            // glTF puts the uv origin at the top left
+            tuvs.resize(nw);
+            for (size_t w = 0; w < nw; w++) tuvs[w] = CPoint2(uvs[2 * w], 1.0 - uvs[2 * w + 1]);
+        }
+        std::vector<CPoint> tnormals;
+        if (with_normal)
+        {
+            tnormals.resize(nw);
+            for (size_t w = 0; w < nw; w++) tnormals[w] = CPoint(normals[3 * w], normals[3 * w + 1], normals[3 * w + 2]);
+        }
+
+        _build_from_arrays(points, tuvs, tnormals, indices, std::vector<int>(),
+            with_uv ? corners : std::vector<int>(), with_normal ? corners : std::vector<int>(), NULL);
+        return true;
+    };
+
+    /*!
+        Write a .glb file.
+        \param output the output .glb file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::write_glb(const std::string & output, bool with_uv, bool with_normal)
+    {
+        CCmvMesh mesh;
+        _triangle_wedges(mesh, with_uv, with_normal);
+
+        const size_t nw = mesh.num_wedges();
+        std::vector<float> positions(3 * nw);
+        for (size_t w = 0; w < nw; w++)
+        {
+            for (int k = 0; k < 3; k++) positions[3 * w + k] = (float)mesh.positions[3 * mesh.wedge_vertex[w] + k];
+        }
+        for (size_t w = 0; with_uv && w < nw; w++) mesh.uvs[2 * w + 1] = 1.0f - mesh.uvs[2 * w + 1];
+
+        bool ok = write_glb_file(output, nw, positions.data(), with_normal ? mesh.normals.data() : NULL,
+            with_uv ? mesh.uvs.data() : NULL, mesh.num_triangles(), mesh.wedges.data());
+        if (!ok) std::cerr << "error in writing file " << output << std::endl;
+        return ok;
+    };
+
+    /*!
+        Read an .mb file.
+        \param input the input .mb file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::read_mb(const std::string & input, const std::set<std::string> & traits, int threads)
+    {
+        CMbFile mb(input);
+        if (!mb.is_open())
+        {
+            std::cerr << "error in opening file " << input << std::endl;
+            return false;
+        }
+
+        // the indices are checked before anything is built
+        const size_t nv = mb.num_vertices();
+        const size_t nf = mb.num_faces();
+        const uint64_t * offsets = mb.face_offsets();
+        const uint32_t * indices = mb.face_indices();
+        bool valid = true;
+        for (size_t f = 0; f < nf && valid; f++) valid = offsets[f] < offsets[f + 1];
+        for (size_t k = 0; k < mb.header().num_face_indices && valid; k++) valid = indices[k] < nv;
+        for (size_t k = 0; k < 2 * mb.num_edges() && valid; k++) valid = mb.edges()[k] < nv;
+        for (size_t k = 0; k < mb.num_corners() && valid; k++) valid = mb.corners()[2 * k] < nv && mb.corners()[2 * k + 1] < nf;
+        for (size_t f = 0; f < nf && valid && P::s_degree; f++) valid = offsets[f + 1] - offsets[f] == (uint64_t)P::s_degree;
+        if (!valid)
+        {
+            std::cerr << "invalid indices in file " << input << std::endl;
+            return false;
+        }
+
+        std::vector<CVertex*> verts(nv);
+        const double * p = mb.points();
+        for (size_t i = 0; i < nv; i++)
+        {
+            verts[i] = create_vertex(mb.vertex_ids()[i]);
+            verts[i]->point() = CPoint(p[3 * i], p[3 * i + 1], p[3 * i + 2]);
+        }
+
+        std::vector<CFace*> faces(nf);
+        std::vector<CVertex*> vs;
+        for (size_t f = 0; f < nf; f++)
+        {
+            vs.clear();
+            for (uint64_t k = offsets[f]; k < offsets[f + 1]; k++) vs.push_back(verts[indices[k]]);
+            faces[f] = create_face(vs, mb.face_ids()[f]);
+        }
+
+        std::vector<CEdge*> edges(mb.num_edges());
+        for (size_t i = 0; i < edges.size(); i++) edges[i] = this->edge(verts[mb.edges()[2 * i]], verts[mb.edges()[2 * i + 1]]);
+        std::vector<CHalfEdge*> corners(mb.num_corners());
+        for (size_t i = 0; i < corners.size(); i++) corners[i] = this->corner(verts[mb.corners()[2 * i]], faces[mb.corners()[2 * i + 1]]);
+
+        _mb_strings(mb, MB_VERTEX, traits, verts, threads);
+        _mb_strings(mb, MB_EDGE, traits, edges, threads);
+        _mb_strings(mb, MB_FACE, traits, faces, threads);
+        _mb_strings(mb, MB_CORNER, traits, corners, threads);
+
+        label_boundary(threads);
+        _read_traits(threads);
+        return true;
+    };
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    template<typename T>
+    inline void CBaseMesh<V, E, F, H, A, P>::_mb_strings(const CMbFile & mb, int element, const std::set<std::string> & traits, std::vector<T*> & elements, int threads)
+    {
+        // only the pages of these columns are touched
+        std::vector<CMbColumn> columns;
+        for (size_t i = 0; i < mb.num_columns(); i++)
+        {
+            CMbColumn c = mb.column(i);
+            if (c.element() == element && (traits.empty() || traits.count(c.name()))) columns.push_back(c);
+        }
+        if (columns.empty()) return;
+
+        parallel_for(elements.size(), threads, [&](size_t b, size_t e)
+        {
+            CFormatBuffer buffer;
+            for (size_t i = b; i < e; i++)
+            {
+                if (elements[i] == NULL) continue;
+                buffer.clear();
+                for (const CMbColumn & c : columns)
+                {
+                    if (!c.present(i)) continue;
+                    if (buffer.size() > 0) buffer << ' ';
+                    c.format(i, buffer);
+                }
+                elements[i]->trait_string().str().assign(buffer.data(), buffer.size());
+            }
+        }, 1 << 12);
+    };
+
+    /*!
+        Write an .mb file.
+        \param output the output .mb file name
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline bool CBaseMesh<V, E, F, H, A, P>::write_mb(const std::string & output, const std::set<std::string> & traits, int threads)
+    {
+        _write_traits(threads);
+
+        // the tables, vertices and faces are referred to by their index, found by their slot
+        std::vector<CVertex*> verts(m_verts.begin(), m_verts.end());
+        size_t slots = 0;
+        for (CVertex * v : verts) slots = std::max(slots, v->property_index() + 1);
+        std::vector<uint32_t> vindex(slots);
+        std::vector<int32_t> vids(verts.size());
+        std::vector<double> points(3 * verts.size());
+        for (size_t i = 0; i < verts.size(); i++)
+        {
+            vindex[verts[i]->property_index()] = (uint32_t)i;
+            vids[i] = verts[i]->id();
+            for (int k = 0; k < 3; k++) points[3 * i + k] = verts[i]->point()[k];
+        }
+
+        std::vector<CFace*> faces(m_faces.begin(), m_faces.end());
+        slots = 0;
+        for (CFace * f : faces) slots = std::max(slots, f->property_index() + 1);
+        std::vector<uint32_t> findex(slots);
+        std::vector<int32_t> fids(faces.size());
+        std::vector<uint64_t> offsets(1, 0);
+        std::vector<uint32_t> indices;
+        for (size_t i = 0; i < faces.size(); i++)
+        {
+            CFace * f = faces[i];
+            findex[f->property_index()] = (uint32_t)i;
+            fids[i] = f->id();
+            // the order of write_m
+            CHalfEdge * he = f->halfedge();
+            do {
+                indices.push_back(vindex[he->target()->property_index()]);
+                he = he->next();
+            } while (he != f->halfedge());
+            offsets.push_back(indices.size());
+        }
+
+        std::vector<CEdge*> edges;
+        std::vector<uint32_t> edge_records;
+        for (CEdge * e : m_edges)
+        {
+            if (e->trait_string().size() == 0) continue;
+            edges.push_back(e);
+            edge_records.push_back(vindex[e->vertex(0)->property_index()]);
+            edge_records.push_back(vindex[e->vertex(1)->property_index()]);
+        }
+        std::vector<CHalfEdge*> corners;
+        std::vector<uint32_t> corner_records;
+        for (CHalfEdge * he : m_halfedges)
+        {
+            if (he->trait_string().size() == 0) continue;
+            corners.push_back(he);
+            corner_records.push_back(vindex[he->vertex()->property_index()]);
+            corner_records.push_back(findex[he->face()->property_index()]);
+        }
+
+        CMbTraitTable vertex_table(MB_VERTEX, verts.size(), traits), edge_table(MB_EDGE, edges.size(), traits);
+        CMbTraitTable face_table(MB_FACE, faces.size(), traits), corner_table(MB_CORNER, corners.size(), traits);
+        _mb_columns(vertex_table, verts);
+        _mb_columns(edge_table, edges);
+        _mb_columns(face_table, faces);
+        _mb_columns(corner_table, corners);
+        CMbTraitTable * tables[4] = { &vertex_table, &edge_table, &face_table, &corner_table };
+        const size_t rows[4] = { verts.size(), edges.size(), faces.size(), corners.size() };
+
+        CMbHeader header;
+        header.num_vertices = verts.size();
+        header.num_faces = faces.size();
+        header.num_face_indices = indices.size();
+        header.num_edges = edges.size();
+        header.num_corners = corners.size();
+
+        CMbWriter writer;
+        header.offset[0] = writer.add(vids.data(), 4 * vids.size());
+        header.offset[1] = writer.add(points.data(), 8 * points.size());
+        header.offset[2] = writer.add(fids.data(), 4 * fids.size());
+        header.offset[3] = writer.add(offsets.data(), 8 * offsets.size());
+        header.offset[4] = writer.add(indices.data(), 4 * indices.size());
+        header.offset[5] = writer.add(edge_records.data(), 4 * edge_records.size());
+        header.offset[6] = writer.add(corner_records.data(), 4 * corner_records.size());
+
+        // the directory and the names, then the sections of the columns
+        std::string names;
+        for (CMbTraitTable * t : tables)
+        {
+            for (size_t i : t->order()) names += t->columns()[i].name;
+        }
+        std::vector<CMbColumnHeader> directory;
+        for (int k = 0; k < 4; k++) header.num_columns += (uint32_t)tables[k]->columns().size();
+        directory.resize(header.num_columns);
+        header.offset[7] = writer.add(directory.data(), sizeof(CMbColumnHeader) * directory.size());
+        header.offset[8] = writer.add(names.data(), names.size());
+
+        size_t d = 0, name = 0;
+        for (int k = 0; k < 4; k++)
+        {
+            for (size_t i : tables[k]->order())
+            {
+                CMbTraitTable::CColumn & c = tables[k]->columns()[i];
+                CMbColumnHeader & h = directory[d++];
+                memset(&h, 0, sizeof(CMbColumnHeader));
+                h.element = (uint32_t)tables[k]->element();
+                h.type = c.type;
+                h.arity = c.arity;
+                h.name = name;
+                h.name_size = (uint32_t)c.name.size();
+                name += c.name.size();
+                h.rows = rows[k];
+                h.present = writer.add(c.present.data(), c.present.size());
+                if (c.type == MB_INT) h.data = writer.add(c.ints.data(), 4 * c.ints.size());
+                if (c.type == MB_REAL) h.data = writer.add(c.reals.data(), 8 * c.reals.size());
+                if (c.type == MB_TEXT)
+                {
+                    h.data = writer.add(c.offsets.data(), 8 * c.offsets.size());
+                    h.text = writer.add(c.text.data(), c.text.size());
+                    h.text_size = c.text.size();
+                }
+            }
+        }
+
+        bool ok = writer.write(output, header);
+        if (!ok) std::cerr << "error in writing file " << output << std::endl;
+        return ok;
+    };
+
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    template<typename T>
+    inline void CBaseMesh<V, E, F, H, A, P>::_mb_columns(CMbTraitTable & table, const std::vector<T*> & elements)
+    {
+        for (T * t : elements)
+        {
+            const CTraitString & s = t->trait_string();
+            table.scan(s.data(), s.data() + s.size());
+        }
+        table.allocate();
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            const CTraitString & s = elements[i]->trait_string();
+            table.fill(i, s.data(), s.data() + s.size());
+        }
+        table.finish();
+    };
+
+    //template pointer converting to base class pointer is OK (BasePointer) = (TemplatePointer)
+    //(TemplatePointer)=(BasePointer) is incorrect
+    /*! delete one face
+    \param pFace the face to be deleted
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::delete_face(CFace * pFace)
+    {
+        if (m_map_face.find(pFace->id()) == pFace) m_map_face.erase(pFace->id());
+        m_faces.remove(pFace);
+
+        //create halfedges
+        CHalfEdge * hes[3];
+
+        hes[0] = pFace->halfedge();
+        hes[1] = hes[0]->next();
+        hes[2] = hes[1]->next();
+
+        for (int i = 0; i < 3; i++)
+        {
+            //connection with edge
+            CHalfEdge * pH = hes[i];
+
+            //connection to target
+            CVertex * pV = pH->target();
+            if (pV->halfedge() == pH)
+            {
+                if (pH->next()->dual() != NULL)
                     pV->halfedge() = pH->next()->dual();
                 else
                 {
@@ -1543,202 +3158,625 @@ namespace MeshLib {
                 m_edges.remove(pE);
                 CVertex * v0 = pH->source();
                 CVertex * v1 = pH->target();
-                delete pE;
+                m_edge_hash.erase(CEdgeHash<CEdge>::key(v0->id(), v1->id()), pE);
+                _destroy(pE);
             }
         }
 
         //remove half edges
         for (int i = 0; i < 3; i++)
         {
-            delete hes[i];
+            hes[i]->target()->clear_adjacency();
+            m_halfedges.remove(hes[i]);
+            _destroy(hes[i]);
         }
 
-        delete pFace;
+        _destroy(pFace);
+    };
+
+    /*! delete the faces pred picks
+    \param pred bool(CFace*), called once per face
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    template<typename Pred>
+    inline size_t CBaseMesh<V, E, F, H, A, P>::delete_faces(Pred pred)
+    {
+        std::vector<char> gone(m_properties->faces.size(), 0);
+        size_t n = 0;
+        for (CFace * f : m_faces)
+        {
+            if (!pred(f)) continue;
+            gone[f->property_index()] = 1;
+            n++;
+        }
+        if (n == 0) return 0;
+        auto dead = [&](CHalfEdge * he) { return he != NULL && gone[he->face()->property_index()]; };
+
+        //an edge keeps its live halfedge first, the ends of a new boundary edge enter along it
+        std::vector<CVertex*> opened;
+        m_edges.remove_if([&](CEdge * e)
+        {
+            CHalfEdge * h0 = e->halfedge(0);
+            CHalfEdge * h1 = e->halfedge(1);
+            const bool d0 = dead(h0), d1 = dead(h1);
+            if (!d0 && !d1) return false;
+            CHalfEdge * live = d0 ? (d1 ? NULL : h1) : h0;
+            if (live == NULL)
+            {
+                _destroy(e);
+                return true;
+            }
+            e->halfedge(0) = live;
+            e->halfedge(1) = NULL;
+            live->target()->halfedge() = live;
+            live->prev()->target()->halfedge() = live->prev();
+            opened.push_back(live->target());
+            opened.push_back(live->prev()->target());
+            return false;
+        });
+
+        //the halfedge of a boundary vertex is its most ccw in halfedge, see label_boundary
+        for (CVertex * v : opened)
+        {
+            v->boundary() = true;
+            CHalfEdge * he = v->halfedge();
+            for (CHalfEdge * ne = he->ccw_rotate_about_target(); ne != NULL; ne = he->ccw_rotate_about_target()) he = ne;
+            v->halfedge() = he;
+            v->clear_adjacency();
+        }
+
+        m_verts.remove_if([&](CVertex * v)
+        {
+            if (!dead(v->halfedge())) return false;
+            if (m_map_vert.find(v->id()) == v) m_map_vert.erase(v->id());
+            _destroy(v);
+            return true;
+        });
+        m_halfedges.remove_if([&](CHalfEdge * he)
+        {
+            if (!dead(he)) return false;
+            _destroy(he);
+            return true;
+        });
+        m_faces.remove_if([&](CFace * f)
+        {
+            if (!gone[f->property_index()]) return false;
+            if (m_map_face.find(f->id()) == f) m_map_face.erase(f->id());
+            _destroy(f);
+            return true;
+        });
+
+        _index_edges();
+        return n;
     };
 
     /*!
         Read an .off file
         \param input the input .off filename
     */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::read_off(const char * input)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::read_off(const char * input)
     {
-        std::fstream is(input, std::fstream::in);
-
-        if (is.fail())
+        CMappedFile file(input);
+        if (!file.is_open())
         {
             std::cerr << "error in opening file " << input << std::endl;
             return;
         }
+        const char * p = file.begin();
+        const char * end = file.end();
 
-        char buffer[MAX_LINE];
-
-        //read in the first line "OFF"
-
-        while (is.getline(buffer, MAX_LINE))
+        // the data lines, blank lines and comments are skipped
+        auto next_line = [end](const char * &p)
         {
-            std::string line(buffer);
-
-            strutil::Tokenizer stokenizer(line, " \r\n");
+            for (;;)
+            {
+                CNumParser::skip_blank(p, end);
+                if (p >= end) return false;
+                if (*p != '\n' && *p != '#') return true;
+                CNumParser::skip_line(p, end);
+            }
+        };
 
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-            if (token == "OFF" || token == "COFF" || token == "NOFF") break;
+        //the keyword, OFF, COFF or NOFF, may be followed by the counts on its line
+        if (!next_line(p)) return;
+        bool with_normal = false;
+        if (!CNumParser::is_digit(*p))
+        {
+            with_normal = *p == 'N';
+            while (p < end && !CNumParser::is_blank(*p) && *p != '\n') p++;
+            CNumParser::skip_blank(p, end);
+            if (p < end && *p == '\n' && !next_line(p)) return;
         }
 
-        int nVertices, nFaces, nEdges;
-
         //read in Vertex Number, Face Number, Edge Number
+        int nVertices = 0, nFaces = 0, nEdges = 0;
+        CNumParser::scan_int(p, end, nVertices);
+        CNumParser::skip_blank(p, end);
+        CNumParser::scan_int(p, end, nFaces);
+        CNumParser::skip_blank(p, end);
+        CNumParser::scan_int(p, end, nEdges);
+        CNumParser::skip_line(p, end);
+        if (nVertices < 0 || nFaces < 0) return;
+
+        // the counts give the lines of both blocks, found by one scan
+        std::vector<const char *> lines((size_t)nVertices + nFaces);
+        for (size_t l = 0; l < lines.size(); l++)
+        {
+            if (!next_line(p))
+            {
+                std::cerr << "error in reading file " << input << std::endl;
+                return;
+            }
+            lines[l] = p;
+            CNumParser::skip_line(p, end);
+        }
 
-        is.getline(buffer, MAX_LINE);
-        std::string line(buffer);
-
-        strutil::Tokenizer stokenizer(line, " \r\n");
-
-        stokenizer.nextToken();
-        std::string token = stokenizer.getToken();
-        nVertices = strutil::parseString<int>(token);
+        std::vector<CPoint> points(nVertices);
+        std::vector<CPoint> normals(with_normal ? nVertices : 0);
+        parallel_for((size_t)nVertices, 0, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const char * pc = lines[i];
+                for (int j = 0; j < 3; j++)
+                {
+                    CNumParser::skip_blank(pc, end);
+                    CNumParser::scan_double(pc, end, points[i][j]);
+                }
+                for (int j = 0; with_normal && j < 3; j++)
+                {
+                    CNumParser::skip_blank(pc, end);
+                    CNumParser::scan_double(pc, end, normals[i][j]);
+                }
+            }
+        });
 
-        stokenizer.nextToken();
-        token = stokenizer.getToken();
-        nFaces = strutil::parseString<int>(token);
+        // the corner counts, then the corners where their prefix sums put them
+        std::vector<int> offsets(nFaces + 1, 0);
+        parallel_for((size_t)nFaces, 0, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const char * pc = lines[nVertices + i];
+                CNumParser::skip_blank(pc, end);
+                CNumParser::scan_int(pc, end, offsets[i + 1]);
+            }
+        });
+        for (int f = 0; f < nFaces; f++)
+        {
+            if (offsets[f + 1] < 3)
+            {
+                std::cerr << "error in reading file " << input << std::endl;
+                return;
+            }
+            offsets[f + 1] += offsets[f];
+        }
+        std::vector<int> indices(offsets[nFaces]);
+        std::atomic<bool> failed(false);
+        parallel_for((size_t)nFaces, 0, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const char * pc = lines[nVertices + i];
+                int n;
+                CNumParser::skip_blank(pc, end);
+                CNumParser::scan_int(pc, end, n);
+                for (int c = offsets[i]; c < offsets[i + 1]; c++)
+                {
+                    CNumParser::skip_blank(pc, end);
+                    if (!CNumParser::scan_int(pc, end, indices[c]) || indices[c] < 0 || indices[c] >= nVertices) failed = true;
+                }
+            }
+        });
+        if (failed)
+        {
+            std::cerr << "error in reading file " << input << std::endl;
+            return;
+        }
 
-        stokenizer.nextToken();
-        token = stokenizer.getToken();
-        nEdges = strutil::parseString<int>(token);
+        build_from_arrays(points, std::vector<CPoint2>(), normals, indices, offsets, std::vector<int>(), std::vector<int>());
+    };
 
-        for (int id = 0; id < nVertices; id++)
+    /*!
+        Label boundary edges, vertices
+    */
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::label_boundary(int threads)
+    {
+        MESHLIB_TRACE_ZONE("label_boundary");
+        //Orient the edges, every edge only touches itself, boundary vertices are collected per thread
+        const std::vector<CEdge*> & edges = m_edges.data();
+        const size_t n = edges.size();
+        threads = resolve_threads(threads, n, 1 << 14);
+        std::vector<std::vector<CVertex*>> boundary(threads);
+        parallel_run(threads, [&](int t)
         {
-            is.getline(buffer, MAX_LINE);
-            std::string line(buffer);
-
-            strutil::Tokenizer stokenizer(line, " \r\n");
-            CPoint p;
-            for (int j = 0; j < 3; j++)
+            std::vector<CVertex*> & bv = boundary[t];
+            for (size_t i = n * t / threads; i < n * (t + 1) / threads; i++)
             {
-                stokenizer.nextToken();
-                std::string token = stokenizer.getToken();
-                p[j] = strutil::parseString<float>(token);
-            }
+                CEdge * edge = edges[i];
+                if (edge == NULL) continue;
+
+                CHalfEdge * he[2];
+                he[0] = edge->halfedge(0);
+                he[1] = edge->halfedge(1);
+                assert(he[0] != NULL);
 
-            CVertex * v = create_vertex(id + 1);
-            v->point() = p;
+                if (he[1] != NULL)
+                {
+                    assert(he[0]->target() == he[1]->source() && he[0]->source() == he[1]->target());
+                    if (he[0]->target()->id() < he[0]->source()->id())
+                    {
+                        edge->halfedge(0) = he[1];
+                        edge->halfedge(1) = he[0];
+                    }
+                    assert(edge->vertex1()->id() < edge->vertex2()->id());
+                }
+                else
+                {
+                    bv.push_back(he[0]->vertex());
+                    bv.push_back(he[0]->prev()->vertex());
+                }
+            }
+        });
+        for (std::vector<CVertex*> & bv : boundary)
+        {
+            for (CVertex * v : bv) v->boundary() = true;
         }
 
-        for (int id = 0; id < nFaces; id++)
+        //Remove dangling vertices in one pass
+        m_verts.remove_if([&](CVertex * v)
         {
-            is.getline(buffer, MAX_LINE);
-            std::string line(buffer);
+            if (v->halfedge() != NULL) return false;
+            if (m_map_vert.find(v->id()) == v) m_map_vert.erase(v->id());
+            _destroy(v);
+            return true;
+        });
+
+        //Arrange the halfedge of boundary vertices to be the most ccw in halfedge,
+        //every vertex only touches itself
+        _for_each(m_verts, threads, [](CVertex * v)
+        {
+            if (v->boundary()) v->halfedge() = v->most_ccw_in_halfedge();
+        });
+    };
 
-            strutil::Tokenizer stokenizer(line, " \r\n");
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::compute_normals(int threads)
+    {
+        //The weighted normal of every corner, in the halfedge ending there,
+        //every face only writes its own halfedges
+        _for_each(m_faces, threads, [](CFace * f)
+        {
+            for (CHalfEdge * he : f->halfedges_range())
+            {
+                const CPoint & p = he->vertex()->point();
+                const CPoint a = he->source()->point() - p;
+                const CPoint b = he->next()->vertex()->point() - p;
+                //twice the area of the triangle of the corner, times its angle
+                const CPoint n = b ^ a;
+                he->normal() = n * atan2(n.norm(), a * b);
+            }
+        });
 
-            int n = strutil::parseString<int>(token);
-            assert(n == 3);
+        //Sum them around every vertex, then hand the result back to the halfedges
+        _for_each(m_verts, threads, [](CVertex * v)
+        {
+            CPoint n(0, 0, 0);
+            for (CHalfEdge * he : v->in_halfedges_range()) n += he->normal();
+            const double l = n.norm();
+            v->normal() = l > 0 ? n / l : n;
+        });
+        _for_each(m_halfedges, threads, [](CHalfEdge * he) { he->normal() = he->vertex()->normal(); });
+    };
 
-            std::vector<CVertex*> vs;
-            for (int j = 0; j < 3; j++)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CBaseMesh<V, E, F, H, A, P>::set_from_vector(std::vector<CPoint> ps, std::vector<std::vector<int>> fs)
+    {
+        std::vector<int> indices;
+        std::vector<int> offsets;
+        for (size_t i = 0; i < fs.size(); ++i)
+        {
+            offsets.push_back((int)indices.size());
+            for (size_t j = 0; j < fs[i].size(); ++j)
             {
-                stokenizer.nextToken();
-                std::string token = stokenizer.getToken();
-                int vid = strutil::parseString<int>(token);
-                vs.push_back(this->vertex(vid + 1));
+                indices.push_back(fs[i][j] - 1);
             }
-            create_face(vs, id + 1);
         }
+        offsets.push_back((int)indices.size());
 
-        is.close();
-
-        label_boundary();
+        build_from_arrays(ps, std::vector<CPoint2>(), std::vector<CPoint>(), indices, offsets, std::vector<int>(), std::vector<int>());
+    }
 
-    };
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::build_from_arrays(const std::vector<CPoint> & points, const std::vector<CPoint2> & uvs,
+        const std::vector<CPoint> & normals, const std::vector<int> & tri_indices)
+    {
+        build_from_arrays(points, uvs, normals, tri_indices, std::vector<int>(), std::vector<int>(), std::vector<int>());
+    }
 
     /*!
-        Label boundary edges, vertices
+        Construct a mesh from flat arrays. Vertices, faces and halfedges are created
+        in input order, then all halfedges are sorted by their (min, max) vertex key
+        so that the edges and duals are linked in one pass, without a lookup per
+        halfedge in create_edge. The result is the same as calling create_face
+        for every face followed by label_boundary.
     */
-    template<typename V, typename E, typename F, typename H>
-    inline void CBaseMesh<V, E, F, H>::label_boundary(void)
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    inline void CBaseMesh<V, E, F, H, A, P>::_build_from_arrays(const std::vector<CPoint> & points, const std::vector<CPoint2> & uvs,
+        const std::vector<CPoint> & normals, const std::vector<int> & indices, const std::vector<int> & face_offsets,
+        const std::vector<int> & uv_indices, const std::vector<int> & normal_indices, const int * twins)
     {
-        //Label boundary edges
-        for (CEdge * e : m_edges)
+        MESHLIB_TRACE_ZONE("build_from_arrays");
+        assert(m_verts.empty() && m_faces.empty());
+        if (m_weld >= 0)
         {
-            CHalfEdge * he[2];
-            he[0] = e->halfedge(0);
-            he[1] = e->halfedge(1);
-            assert(he[0] != NULL);
-
-            if (he[1] != NULL)
+            // the corners keep their point as the index of their uv and normal per vertex
+            std::vector<int> remap, unique;
+            CPointWelder::weld(points.data(), points.size(), m_weld, remap, unique);
+            std::vector<CPoint> p(unique.size());
+            for (size_t k = 0; k < unique.size(); k++) p[k] = points[unique[k]];
+            std::vector<int> welded(indices.size());
+            for (size_t c = 0; c < indices.size(); c++)
+                welded[c] = indices[c] >= 0 && indices[c] < (int)points.size() ? remap[indices[c]] : -1;
+            const bool vertex_uv = uv_indices.empty() && uvs.size() == points.size();
+            const bool vertex_normal = normal_indices.empty() && normals.size() == points.size();
+            const double tolerance = m_weld;
+            m_weld = -1;
+            _build_from_arrays(p, uvs, normals, welded, face_offsets,
+                vertex_uv ? indices : uv_indices, vertex_normal ? indices : normal_indices, NULL);
+            m_weld = tolerance;
+            m_welded = points.size() - unique.size();
+            if (m_welded) std::cout << "Welded " << points.size() << " points into " << unique.size() << " vertices" << std::endl;
+            return;
+        }
+        m_welded = 0;
+        if (m_repair)
+        {
+            // the twins of the input may pair corners the repair parts, the edges are sorted anew
+            std::vector<int> repaired(indices);
+            const int faces = face_offsets.empty() ? (int)indices.size() / 3 : (int)face_offsets.size() - 1;
+            for (int j = 0; P::s_degree && j < faces; j++)
             {
-                assert(he[0]->target() == he[1]->source() && he[0]->source() == he[1]->target());
-                if (he[0]->target()->id() < he[0]->source()->id())
+                const int fb = face_offsets.empty() ? 3 * j : face_offsets[j];
+                const int fe = face_offsets.empty() ? 3 * j + 3 : face_offsets[j + 1];
+                if (fe - fb != P::s_degree) std::fill(repaired.begin() + fb, repaired.begin() + fe, -1);
+            }
+            std::vector<int> split;
+            m_repair_report = CMeshRepair().repair(points.size(), [&points](size_t i) { return points[i]; }, repaired, face_offsets, split);
+            m_repair = false;
+            if (split.empty())
+                _build_from_arrays(points, uvs, normals, repaired, face_offsets, uv_indices, normal_indices, NULL);
+            else
+            {
+                // a split vertex is a copy of its vertex, its point and the attributes per vertex too
+                std::vector<CPoint> p(points), n;
+                std::vector<CPoint2> u;
+                for (int v : split) p.push_back(points[v]);
+                if (uv_indices.empty() && uvs.size() == points.size())
                 {
-                    e->halfedge(0) = he[1];
-                    e->halfedge(1) = he[0];
+                    u = uvs;
+                    for (int v : split) u.push_back(uvs[v]);
                 }
-                assert(e->vertex1()->id() < e->vertex2()->id());
+                if (normal_indices.empty() && normals.size() == points.size())
+                {
+                    n = normals;
+                    for (int v : split) n.push_back(normals[v]);
+                }
+                _build_from_arrays(p, u.empty() ? uvs : u, n.empty() ? normals : n, repaired, face_offsets, uv_indices, normal_indices, NULL);
             }
-            else
+            m_repair = true;
+            if (!m_repair_report.clean())
             {
-                he[0]->vertex()->boundary() = true;
-                he[0]->prev()->vertex()->boundary() = true;
+                std::cout << "Repaired the input, " << m_faces.size() << " faces kept" << std::endl;
+                m_repair_report.print(std::cout);
             }
+            return;
         }
-
-        std::list<CVertex*> dangling_verts;
-        //Label boundary edges
-        for (CVertex * v : m_verts)
+        if (m_reorder)
         {
-            if (v->halfedge() != NULL) continue;
-            dangling_verts.push_back(v);
+            // faces with an invalid corner have no center and go last, the build skips them
+            const int np = (int)points.size();
+            const int faces = face_offsets.empty() ? (int)indices.size() / 3 : (int)face_offsets.size() - 1;
+            std::vector<int> vorder, forder, rank(np);
+            CMortonOrder::sort(points.data(), points.size(), vorder);
+            for (int k = 0; k < np; k++) rank[vorder[k]] = k;
+            std::vector<CPoint> centers(faces);
+            parallel_for(faces, 0, [&](size_t b, size_t e)
+            {
+                for (size_t j = b; j < e; j++)
+                {
+                    const int fb = face_offsets.empty() ? 3 * (int)j : face_offsets[j];
+                    const int fe = face_offsets.empty() ? 3 * (int)j + 3 : face_offsets[j + 1];
+                    CPoint c(0, 0, 0);
+                    for (int k = fb; k < fe; k++)
+                    {
+                        if (indices[k] < 0 || indices[k] >= np) c[0] = NAN;
+                        else c += points[indices[k]];
+                    }
+                    centers[j] = fe > fb ? c / (double)(fe - fb) : CPoint(NAN, 0, 0);
+                }
+            });
+            CMortonOrder::sort(centers.data(), centers.size(), forder);
+
+            // the arrays in the new order, a corner keeps its uv, normal and twin
+            const bool vertex_uv = uv_indices.empty() && uvs.size() == points.size();
+            const bool vertex_normal = normal_indices.empty() && normals.size() == points.size();
+            std::vector<CPoint> p(np), n(vertex_normal ? np : 0);
+            std::vector<CPoint2> u(vertex_uv ? np : 0);
+            for (int k = 0; k < np; k++)
+            {
+                p[k] = points[vorder[k]];
+                if (vertex_uv) u[k] = uvs[vorder[k]];
+                if (vertex_normal) n[k] = normals[vorder[k]];
+            }
+            std::vector<int> idx, offsets, ui, ni, corner(twins ? indices.size() : 0), tw;
+            idx.reserve(indices.size());
+            if (!face_offsets.empty()) offsets.push_back(0);
+            for (int j : forder)
+            {
+                const int fb = face_offsets.empty() ? 3 * j : face_offsets[j];
+                const int fe = face_offsets.empty() ? 3 * j + 3 : face_offsets[j + 1];
+                for (int k = fb; k < fe; k++)
+                {
+                    if (twins) corner[k] = (int)idx.size();
+                    idx.push_back(indices[k] >= 0 && indices[k] < np ? rank[indices[k]] : -1);
+                    if (!uv_indices.empty()) ui.push_back(uv_indices[k]);
+                    if (!normal_indices.empty()) ni.push_back(normal_indices[k]);
+                }
+                if (!face_offsets.empty()) offsets.push_back((int)idx.size());
+            }
+            if (twins)
+            {
+                tw.resize(indices.size());
+                for (size_t k = 0; k < indices.size(); k++) tw[corner[k]] = twins[k] >= 0 ? corner[twins[k]] : -1;
+            }
+            m_reorder = false;
+            _build_from_arrays(p, vertex_uv ? u : uvs, vertex_normal ? n : normals, idx, offsets, ui, ni, twins ? tw.data() : NULL);
+            m_reorder = true;
+            return;
         }
 
-        for (CVertex * v : dangling_verts)
+        const int nv = (int)points.size();
+        const int nf = face_offsets.empty() ? (int)indices.size() / 3 : (int)face_offsets.size() - 1;
+        const bool vertex_uv = uv_indices.empty() && uvs.size() == points.size();
+        const bool vertex_normal = normal_indices.empty() && normals.size() == points.size();
+        MESHLIB_COUNTER_ADD("meshlib.faces_built", nf);
+
+        m_map_vert.reserve(nv);
+        m_map_face.reserve(nf);
+        m_allocator.template reserve<CVertex>(nv);
+        m_allocator.template reserve<CFace>(nf);
+        m_allocator.template reserve<CHalfEdge>(indices.size());
+        m_allocator.template reserve<CEdge>(indices.size() / 2 + 1);
+        m_properties->vertices.reserve(nv);
+        m_properties->faces.reserve(nf);
+        m_properties->halfedges.reserve(indices.size());
+        m_properties->edges.reserve(indices.size() / 2 + 1);
+        m_verts.reserve(nv);
+        m_faces.reserve(nf);
+        m_halfedges.reserve(indices.size());
+        m_edges.reserve(indices.size() / 2 + 1);
+        m_edge_hash.reserve(indices.size() / 2 + 1);
+        std::vector<CVertex*> verts(nv);
+        for (int i = 0; i < nv; i++)
         {
-            m_verts.remove(v);
-            v->dangled() = true;
-            delete v;
-            v = NULL;
+            CVertex * v = create_vertex(i + 1);
+            v->point() = points[i];
+            if (vertex_uv) v->uv() = uvs[i];
+            if (vertex_normal) v->normal() = normals[i];
+            verts[i] = v;
         }
 
-        //Arrange the boundary half_edge of boundary vertices, to make its halfedge
-        //to be the most ccw in half_edge
-        //for (CVertex * v : m_verts)
-        //{
-        //    if (!v->boundary()) continue;
+        // faces and halfedges, corners of faces with invalid indices are skipped
+        std::vector<CHalfEdge*> hes;
+        std::vector<int>        he_source;
+        hes.reserve(indices.size());
+        he_source.reserve(indices.size());
 
-        //    CHalfEdge * he = v->halfedge();
-        //    while (he->dual() != NULL)
-        //    {
-        //        he = he->ccw_rotate_about_target();
-        //    }
-        //    v->halfedge() = he;
-        //}
+        for (int j = 0; j < nf; j++)
+        {
+            // a cancelled job keeps the faces so far, the caller drops the mesh
+            if ((j & 65535) == 0 && job_cancelled()) break;
+            int fb = face_offsets.empty() ? 3 * j : face_offsets[j];
+            int fe = face_offsets.empty() ? 3 * j + 3 : face_offsets[j + 1];
+            if (fe - fb < 3) continue;
+            // a mesh of fixed degree drops the faces of another one
+            if (P::s_degree && fe - fb != P::s_degree) continue;
+
+            bool valid = true;
+            for (int c = fb; c < fe && valid; c++) valid = indices[c] >= 0 && indices[c] < nv;
+            if (!valid) continue;
+
+            CFace * f = _create<CFace>();
+            assert(f != NULL);
+            f->id() = j + 1;
+            m_faces.push_back(f);
+            m_map_face.insert(j + 1, f);
+
+            size_t first = hes.size();
+            for (int c = fb; c < fe; c++)
+            {
+                CVertex * v = verts[indices[c]];
+                if (!uv_indices.empty() && uv_indices[c] >= 0 && uv_indices[c] < (int)uvs.size())
+                    v->uv() = uvs[uv_indices[c]];
+                if (!normal_indices.empty() && normal_indices[c] >= 0 && normal_indices[c] < (int)normals.size())
+                    v->normal() = normals[normal_indices[c]];
+
+                CHalfEdge * he = _create<CHalfEdge>();
+                assert(he);
+                he->vertex() = v;
+                he->uv() = v->uv();
+                he->normal() = v->normal();
+                he->face() = f;
+                v->halfedge() = he;
+                    m_halfedges.push_back(he);
+                hes.push_back(he);
+                he_source.push_back(indices[c == fb ? fe - 1 : c - 1]);
+            }
 
-    };
+            const size_t n = P::s_degree ? (size_t)P::s_degree : hes.size() - first;
+            for (size_t i = 0; i < n; i++)
+            {
+                hes[first + i]->next() = hes[first + (i + 1) % n];
+                hes[first + i]->prev() = hes[first + (i + n - 1) % n];
+            }
+            f->halfedge() = hes.back();
+        }
 
-    template<typename V, typename E, typename F, typename H>
-    void CBaseMesh<V, E, F, H>::set_from_vector(std::vector<CPoint> ps, std::vector<std::vector<int>> fs)
-    {
-        int id = 1;
-        for (size_t i = 0; i < ps.size(); ++i)
+        const size_t nh = hes.size();
+        std::vector<int> leader(nh);
+        if (twins && nh == indices.size())
         {
-            CPoint p = ps[i];
-            CVertex* v = create_vertex(id);
-            ++id;
-            v->point() = p;
+            // the lower corner of every twin pair owns the edge
+            for (size_t i = 0; i < nh; i++)
+            {
+                leader[i] = (twins[i] >= 0 && twins[i] < (int)i) ? twins[i] : (int)i;
+            }
         }
+        else
+        {
+            // sort halfedges by edge key, ties keep creation order
+            std::vector<std::pair<unsigned long long, int>> keys(nh);
+            for (size_t i = 0; i < nh; i++)
+            {
+                unsigned long long s = (unsigned long long)he_source[i];
+                unsigned long long t = (unsigned long long)(hes[i]->vertex()->id() - 1);
+                keys[i].first = s < t ? (s << 32 | t) : (t << 32 | s);
+                keys[i].second = (int)i;
+            }
+            std::sort(keys.begin(), keys.end());
 
-        int id = 1;
-        for (size_t i = 0; i < fs.size(); ++i)
+            // the first halfedge of every key owns the edge
+            for (size_t i = 0; i < nh; i++)
+            {
+                leader[keys[i].second] = (i > 0 && keys[i].first == keys[i - 1].first) ? leader[keys[i - 1].second] : keys[i].second;
+            }
+        }
+
+        // create edges in the order they are first met, like create_edge does
+        for (size_t i = 0; i < nh; i++)
         {
-            std::vector<CVertex*> vs;
-            for (int j = 0; j < fs[i].size(); ++j)
+            CHalfEdge * he = hes[i];
+            if (leader[i] == (int)i)
+            {
+                CEdge * e = _create<CEdge>();
+                assert(e != NULL);
+                m_edges.push_back(e);
+                m_edge_hash.insert(CEdgeHash<CEdge>::key(he->vertex()->id(), verts[he_source[i]]->id()), e);
+                e->halfedge(0) = he;
+                he->edge() = e;
+                continue;
+            }
+
+            CEdge * e = hes[leader[i]]->edge();
+            if (e->halfedge(1) != NULL)
             {
-                vs.push_back(this->vertex(vs[i][j]));
+                std::cout << "Illegal Face Construction " << he->face()->id() << std::endl;
             }
-            CFace* f = this->create_face(vs, id);
-            ++id;
+            e->halfedge(1) = he;
+            he->edge() = e;
         }
 
         label_boundary();
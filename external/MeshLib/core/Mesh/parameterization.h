@@ -0,0 +1,321 @@
+/*!
+*      \file parameterization.h
+*      \brief Harmonic and least squares conformal maps of a mesh with boundary
+*
+*      The harmonic map pins the longest boundary loop to the unit circle by
+*      arc length and solves the cotangent Laplace equation inside, with the
+*      factored system of CPoissonSolver, so maps of the same patch after its
+*      points moved reuse the analysis. A Mobius transformation of the disk,
+*      see CMobius, then moves the center of the area to the origin. The least
+*      squares conformal map (LSCM) leaves the boundary free, it minimizes the
+*      Dirichlet energy less the area of the image with two boundary vertices
+*      pinned. Either map is written to the uvs of the vertices and halfedges.
+*/
+
+#ifndef _MESHLIB_PARAMETERIZATION_H_
+#define _MESHLIB_PARAMETERIZATION_H_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+#include <Eigen/SparseCholesky>
+
+#include "boundary.h"
+#include "poisson.h"
+#include "../Mobius/Mobius.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CDiskParameterization class, maps a mesh with boundary to the plane
+     *  \tparam V Vertex type
+     *  \tparam E Edge   type
+     *  \tparam F Face   type
+     *  \tparam H HalfEdge type
+     *  \tparam A, P the arena and fields of the mesh, see CBaseMesh
+     */
+    template<typename V, typename E, typename F, typename H, typename A = CBlockArena, typename P = CAllFields>
+    class CDiskParameterization
+    {
+    public:
+        using CMesh = CBaseMesh<V, E, F, H, A, P>;
+        using CVertex = typename CMesh::CVertex;
+        using CHalfEdge = typename CMesh::CHalfEdge;
+        using TBoundary = CBoundary<V, E, F, H, A, P>;
+        using TLoop = CLoop<V, E, F, H, A, P>;
+
+        /*! maps */
+        enum Method
+        {
+            HARMONIC,  //!< onto the unit disk, the uvs in [0, 1]^2
+            LSCM       //!< free boundary, scaled into [0, 1]^2
+        };
+
+        CDiskParameterization(CMesh * pMesh, int threads = 0)
+            : m_pMesh(pMesh), m_threads(threads), m_solver(*pMesh, CLaplacian<CMesh>::COTANGENT, threads),
+              m_laplacian(*pMesh) {}
+
+        /*!
+         *  Map the mesh and write the uvs
+         *  \param normalize center the harmonic map on the disk by a Mobius transformation
+         *  \return false if the mesh has no boundary or the system cannot be solved
+         */
+        bool map(Method method = HARMONIC, bool normalize = true);
+
+        /*! the image of every vertex, by the rows of CLaplacian */
+        const std::vector<Complex> & image() const { return m_image; }
+        /*! the transformation normalize applied to the harmonic map */
+        const CMobius & mobius() const { return m_mobius; }
+
+    protected:
+        CMesh * m_pMesh;
+        int m_threads;
+        CPoissonSolver<CMesh> m_solver;
+        CLaplacian<CMesh> m_laplacian;
+        size_t m_version = 0;
+        std::vector<CVertex*> m_fixed;
+        std::vector<Complex> m_image;
+        CMobius m_mobius;
+
+        /*! the halfedges of the loop with the longest edges, empty without boundary */
+        std::vector<CHalfEdge*> _longest_loop();
+        bool _harmonic(bool normalize);
+        bool _lscm();
+        /*! move the center of the area to the origin, one Mobius step after another */
+        void _center(const std::vector<double> & mass);
+        /*! write m_image, an affine image of it into [0, 1]^2, to the uvs */
+        void _write(const CLaplacian<CMesh> & laplacian, Complex origin, double scale);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    std::vector<typename CDiskParameterization<V, E, F, H, A, P>::CHalfEdge*> CDiskParameterization<V, E, F, H, A, P>::_longest_loop()
+    {
+        // the loops are sorted by the edge length trait, which the points need not match
+        TBoundary boundary(m_pMesh);
+        TLoop * longest = NULL;
+        double best = -1;
+        for (TLoop * loop : boundary.loops())
+        {
+            double length = 0;
+            for (CHalfEdge * he : loop->halfedges()) length += (he->target()->point() - he->source()->point()).norm();
+            if (length > best)
+            {
+                best = length;
+                longest = loop;
+            }
+        }
+        if (longest == NULL) return std::vector<CHalfEdge*>();
+        return std::vector<CHalfEdge*>(longest->halfedges().begin(), longest->halfedges().end());
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDiskParameterization<V, E, F, H, A, P>::map(Method method, bool normalize)
+    {
+        const bool ok = method == HARMONIC ? _harmonic(normalize) : _lscm();
+        if (!ok) return false;
+        if (method == HARMONIC)
+        {
+            _write(m_solver.laplacian(), Complex(-1, -1), 0.5);
+            return true;
+        }
+
+        // the box of the free image, scaled evenly into the unit square
+        double lo[2] = { 1e300, 1e300 }, hi[2] = { -1e300, -1e300 };
+        for (const Complex & z : m_image)
+        {
+            lo[0] = std::min(lo[0], z.real());
+            lo[1] = std::min(lo[1], z.imag());
+            hi[0] = std::max(hi[0], z.real());
+            hi[1] = std::max(hi[1], z.imag());
+        }
+        const double extent = std::max(hi[0] - lo[0], hi[1] - lo[1]);
+        _write(m_laplacian, Complex(lo[0], lo[1]), extent > 0 ? 1 / extent : 1);
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDiskParameterization<V, E, F, H, A, P>::_harmonic(bool normalize)
+    {
+        const std::vector<CHalfEdge*> loop = _longest_loop();
+        if (loop.empty()) return false;
+
+        std::vector<CVertex*> fixed;
+        std::vector<double> arc(1, 0.0);
+        for (CHalfEdge * he : loop)
+        {
+            fixed.push_back(he->source());
+            arc.push_back(arc.back() + (he->target()->point() - he->source()->point()).norm());
+        }
+        // the same boundary keeps its analysis, the points may have moved since
+        if (fixed != m_fixed)
+        {
+            m_solver.set_fixed(fixed);
+            m_fixed = fixed;
+        }
+        m_solver.update();
+        m_solver.prepare();
+
+        const CLaplacian<CMesh> & laplacian = m_solver.laplacian();
+        Eigen::MatrixXd b = Eigen::MatrixXd::Zero((Eigen::Index)laplacian.size(), 2), x;
+        for (size_t k = 0; k < fixed.size(); k++)
+        {
+            const double angle = 2 * M_PI * arc[k] / arc.back();
+            b(laplacian.row(fixed[k]), 0) = cos(angle);
+            b(laplacian.row(fixed[k]), 1) = sin(angle);
+        }
+        if (!m_solver.solve(b, x)) return false;
+
+        m_image.resize(laplacian.size());
+        for (size_t i = 0; i < m_image.size(); i++) m_image[i] = Complex(x(i, 0), x(i, 1));
+        m_mobius = CMobius();
+        if (normalize) _center(laplacian.mass());
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDiskParameterization<V, E, F, H, A, P>::_center(const std::vector<double> & mass)
+    {
+        double total = 0;
+        for (double m : mass) total += m;
+        if (total <= 0) return;
+        for (int step = 0; step < 32; step++)
+        {
+            Complex center(0, 0);
+            for (size_t i = 0; i < m_image.size(); i++) center += mass[i] * m_image[i];
+            center /= total;
+            if (std::abs(center) < 1e-9 || std::abs(center) >= 1) return;
+
+            const CMobius move(center, 0);
+            move.transform(m_image.data(), m_image.size(), m_threads);
+            m_mobius = move * m_mobius;
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    bool CDiskParameterization<V, E, F, H, A, P>::_lscm()
+    {
+        const std::vector<CHalfEdge*> loop = _longest_loop();
+        if (loop.empty()) return false;
+        if (m_laplacian.size() == 0 || m_version != m_pMesh->topology_version())
+        {
+            m_laplacian.build(m_threads);
+            m_version = m_pMesh->topology_version();
+        }
+        m_laplacian.assemble(CLaplacian<CMesh>::COTANGENT, m_threads);
+        const size_t n = m_laplacian.size();
+
+        // pin the first vertex of the loop and the one of it farthest from it
+        CVertex * pin[2] = { loop[0]->source(), loop[0]->source() };
+        double span = 0;
+        for (CHalfEdge * he : loop)
+        {
+            const double d = (he->source()->point() - pin[0]->point()).norm();
+            if (d > span)
+            {
+                span = d;
+                pin[1] = he->source();
+            }
+        }
+        if (span <= 0) return false;
+        const int pinned[2] = { m_laplacian.row(pin[0]), m_laplacian.row(pin[1]) };
+        const double pinned_value[4] = { 0, 0, span, 0 };
+
+        // u and v of row i are unknowns 2i and 2i + 1, the pinned ones drop out
+        std::vector<int> column(2 * n);
+        int free = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const bool fixed = (int)i == pinned[0] || (int)i == pinned[1];
+            column[2 * i] = fixed ? -1 : free++;
+            column[2 * i + 1] = fixed ? -1 : free++;
+        }
+        auto pinned_at = [&](int unknown)
+        {
+            const int r = unknown / 2;
+            return pinned_value[2 * (r == pinned[0] ? 0 : 1) + unknown % 2];
+        };
+
+        // half the Hessian of the Dirichlet energy less the area of the image, -L / 2 on u and
+        // on v, and -1/4 at (u_s, v_t) and 1/4 at (u_t, v_s) for every boundary halfedge s -> t
+        typedef Eigen::Triplet<double> T;
+        std::vector<T> triplets;
+        Eigen::VectorXd rhs = Eigen::VectorXd::Zero(free);
+        auto add = [&](int a, int b, double value)
+        {
+            if (column[a] < 0) return;
+            if (column[b] >= 0) triplets.push_back(T(column[a], column[b], value));
+            else rhs[column[a]] -= value * pinned_at(b);
+        };
+        const std::vector<int> & outer = m_laplacian.outer();
+        const std::vector<int> & inner = m_laplacian.inner();
+        const std::vector<double> & values = m_laplacian.values();
+        triplets.reserve(2 * values.size() + 8 * loop.size());
+        for (size_t i = 0; i < n; i++)
+        {
+            for (int k = outer[i]; k < outer[i + 1]; k++)
+            {
+                add(2 * (int)i, 2 * inner[k], -values[k] / 2);
+                add(2 * (int)i + 1, 2 * inner[k] + 1, -values[k] / 2);
+            }
+        }
+        for (CVertex * v : m_pMesh->vertices())
+        {
+            if (!v->boundary()) continue;
+            for (CHalfEdge * he : v->out_halfedges())
+            {
+                // a boundary halfedge is the one of its edge with a face
+                if (!he->edge()->boundary()) continue;
+                const int s = m_laplacian.row(he->source()), t = m_laplacian.row(he->target());
+                add(2 * s, 2 * t + 1, -0.25);
+                add(2 * t + 1, 2 * s, -0.25);
+                add(2 * t, 2 * s + 1, 0.25);
+                add(2 * s + 1, 2 * t, 0.25);
+            }
+        }
+
+        Eigen::SparseMatrix<double> system(free, free);
+        system.setFromTriplets(triplets.begin(), triplets.end());
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver(system);
+        if (solver.info() != Eigen::Success) return false;
+        const Eigen::VectorXd x = solver.solve(rhs);
+        if (solver.info() != Eigen::Success) return false;
+
+        m_image.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            const int u = column[2 * i], v = column[2 * i + 1];
+            m_image[i] = u < 0 ? Complex(pinned_at(2 * (int)i), pinned_at(2 * (int)i + 1)) : Complex(x[u], x[v]);
+        }
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename V, typename E, typename F, typename H, typename A, typename P>
+    void CDiskParameterization<V, E, F, H, A, P>::_write(const CLaplacian<CMesh> & laplacian, Complex origin, double scale)
+    {
+        std::vector<CVertex*> verts(laplacian.size());
+        for (size_t i = 0; i < verts.size(); i++) verts[i] = laplacian.vertex(i);
+        parallel_for(verts.size(), m_threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const Complex z = (m_image[i] - origin) * scale;
+                verts[i]->uv() = CPoint2(z.real(), z.imag());
+            }
+        });
+        m_pMesh->parallel_for_halfedges([](CHalfEdge * he) { he->uv() = he->target()->uv(); }, m_threads);
+    }
+
+}; //namespace
+
+#endif
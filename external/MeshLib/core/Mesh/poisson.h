@@ -0,0 +1,255 @@
+/*!
+*      \file poisson.h
+*      \brief Factored Laplace and Poisson systems of a mesh for repeated solves
+*
+*      Harmonic maps, smoothing and diffusion solve the same system with many
+*      right-hand sides. The system of the free vertices is laid out and
+*      analyzed once per connectivity, keyed by CBaseMesh::topology_version(),
+*      factored once per boundary condition and shift, and refactored with
+*      the analysis kept when the points move. The factorization is any
+*      Eigen sparse solver with analyzePattern() and factorize(),
+*      SimplicialLDLT by default, SparseLU, or CholmodSupernodalLLT and
+*      PardisoLDLT where those libraries are linked.
+*/
+
+#ifndef _MESHLIB_POISSON_H_
+#define _MESHLIB_POISSON_H_
+
+#include <vector>
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+#include <Eigen/SparseCholesky>
+
+#include "laplacian.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPoissonSolver class, solves (s M - L) x = b at the free vertices
+     *
+     *  L and M are those of CLaplacian, the values of the fixed vertices are
+     *  given. With no fixed vertex s has to be positive.
+     *  \tparam M      a CBaseMesh
+     *  \tparam Solver an Eigen sparse solver of Eigen::SparseMatrix<double>
+     */
+    template<typename M, typename Solver = Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>>>
+    class CPoissonSolver
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        typedef typename CLaplacian<M>::Weights Weights;
+
+        CPoissonSolver(M & mesh, Weights weights = CLaplacian<M>::COTANGENT, int threads = 0)
+            : m_mesh(mesh), m_laplacian(mesh), m_weights(weights), m_threads(threads) {}
+
+        /*! the vertices whose values are given, a new set is factored at the next solve */
+        void set_fixed(const std::vector<CVertex*> & fixed)
+        {
+            m_fixed = fixed;
+            m_analyzed = false;
+        }
+        /*! the shift s of the mass, 0 for the Laplace and Poisson equations, 1/t for a diffusion for time t */
+        void set_shift(double s)
+        {
+            m_shift = s;
+            m_factored = false;
+        }
+        /*! the points moved, assemble and factor at the next solve, the analysis is kept */
+        void update() { m_factored = false; m_assembled = false; }
+        /*! lay out and assemble L and M for the current mesh, solve() does it first, call it to fill b */
+        void prepare();
+        /*!
+         *  Solve with another matrix of the pattern of L in place of L, see CLaplacian::set_values,
+         *  it is refactored with the analysis kept, update() assembles L from the points again
+         */
+        void set_values(const std::vector<double> & values)
+        {
+            prepare();
+            m_laplacian.set_values(values);
+            m_factored = false;
+        }
+
+        /*!
+         *  Solve for every column of b
+         *  \param b a row per vertex in the order of laplacian(), the value of a fixed
+         *           vertex or the right-hand side at a free one
+         *  \param x the solution, the fixed rows as given in b
+         *  \return false if the system is singular or b has the wrong size
+         */
+        bool solve(const Eigen::MatrixXd & b, Eigen::MatrixXd & x);
+
+        /*! the Laplacian, its rows are those of b and x */
+        const CLaplacian<M> & laplacian() const { return m_laplacian; }
+        /*! the factorization, after the first solve */
+        const Solver & solver() const { return m_solver; }
+
+    protected:
+        M & m_mesh;
+        CLaplacian<M> m_laplacian;
+        Weights m_weights;
+        int m_threads;
+        std::vector<CVertex*> m_fixed;
+        double m_shift = 0;
+
+        size_t m_version = 0;
+        bool m_assembled = false;
+        bool m_analyzed = false;
+        bool m_factored = false;
+
+        Solver m_solver;
+        //! the system of the free vertices, column major and symmetric
+        Eigen::SparseMatrix<double> m_system;
+        //! the entry of L of every entry of m_system, and its entries on the diagonal by column
+        std::vector<int> m_entry;
+        std::vector<int> m_diagonal;
+        //! the column of the system of every row, -1 for a fixed one
+        std::vector<int> m_column;
+        //! the free rows, and the entries of L in their rows at fixed columns
+        std::vector<int> m_free;
+        std::vector<int> m_coupling_outer;
+        std::vector<int> m_coupling;
+
+        /*! lay out the system of the free vertices */
+        void _layout();
+        /*! fill its values from L and M */
+        void _fill();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CPoissonSolver<M, Solver>::_layout()
+    {
+        const size_t n = m_laplacian.size();
+        const std::vector<int> & outer = m_laplacian.outer();
+        const std::vector<int> & inner = m_laplacian.inner();
+
+        m_column.assign(n, 0);
+        for (CVertex * v : m_fixed) m_column[m_laplacian.row(v)] = -1;
+        m_free.clear();
+        for (size_t i = 0; i < n; i++)
+        {
+            if (m_column[i] < 0) continue;
+            m_column[i] = (int)m_free.size();
+            m_free.push_back((int)i);
+        }
+
+        // L is symmetric, its free rows restricted to the free columns are the columns of the system
+        const int nf = (int)m_free.size();
+        std::vector<int> outer_index(nf + 1, 0);
+        m_entry.clear();
+        m_diagonal.clear();
+        m_coupling_outer.assign(1, 0);
+        m_coupling.clear();
+        std::vector<int> inner_index;
+        for (int c = 0; c < nf; c++)
+        {
+            const int i = m_free[c];
+            for (int k = outer[i]; k < outer[i + 1]; k++)
+            {
+                const int j = m_column[inner[k]];
+                if (j < 0)
+                {
+                    m_coupling.push_back(k);
+                    continue;
+                }
+                if (inner[k] == i) m_diagonal.push_back((int)m_entry.size());
+                inner_index.push_back(j);
+                m_entry.push_back(k);
+            }
+            outer_index[c + 1] = (int)m_entry.size();
+            m_coupling_outer.push_back((int)m_coupling.size());
+        }
+
+        m_system.resize(nf, nf);
+        m_system.resizeNonZeros((Eigen::Index)m_entry.size());
+        std::copy(outer_index.begin(), outer_index.end(), m_system.outerIndexPtr());
+        std::copy(inner_index.begin(), inner_index.end(), m_system.innerIndexPtr());
+        std::fill(m_system.valuePtr(), m_system.valuePtr() + m_entry.size(), 0.0);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CPoissonSolver<M, Solver>::_fill()
+    {
+        const std::vector<double> & values = m_laplacian.values();
+        const std::vector<double> & mass = m_laplacian.mass();
+        double * a = m_system.valuePtr();
+        parallel_for(m_entry.size(), m_threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++) a[k] = -values[m_entry[k]];
+        });
+        if (m_shift == 0) return;
+        for (size_t c = 0; c < m_diagonal.size(); c++) a[m_diagonal[c]] += m_shift * mass[m_free[c]];
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CPoissonSolver<M, Solver>::prepare()
+    {
+        if (m_laplacian.size() == 0 || m_version != m_mesh.topology_version())
+        {
+            // the connectivity changed, lay out everything again
+            m_laplacian.build(m_threads);
+            m_version = m_mesh.topology_version();
+            m_assembled = false;
+            m_analyzed = false;
+        }
+        if (!m_assembled)
+        {
+            m_laplacian.assemble(m_weights, m_threads);
+            m_assembled = true;
+            m_factored = false;
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    bool CPoissonSolver<M, Solver>::solve(const Eigen::MatrixXd & b, Eigen::MatrixXd & x)
+    {
+        prepare();
+        if (!m_analyzed)
+        {
+            _layout();
+            m_solver.analyzePattern(m_system);
+            m_analyzed = true;
+            m_factored = false;
+        }
+        if (!m_factored)
+        {
+            _fill();
+            m_solver.factorize(m_system);
+            if (m_solver.info() != Eigen::Success) return false;
+            m_factored = true;
+        }
+
+        const size_t n = m_laplacian.size();
+        if ((size_t)b.rows() != n) return false;
+        const std::vector<double> & values = m_laplacian.values();
+        const std::vector<int> & inner = m_laplacian.inner();
+
+        // the fixed values move to the right-hand side, (s M - L) couples them by -L
+        const int nf = (int)m_free.size();
+        Eigen::MatrixXd rhs(nf, b.cols());
+        parallel_for((size_t)nf, m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t c = s; c < e; c++)
+            {
+                rhs.row(c) = b.row(m_free[c]);
+                for (int k = m_coupling_outer[c]; k < m_coupling_outer[c + 1]; k++)
+                    rhs.row(c) += values[m_coupling[k]] * b.row(inner[m_coupling[k]]);
+            }
+        });
+        const Eigen::MatrixXd y = m_solver.solve(rhs);
+        if (m_solver.info() != Eigen::Success) return false;
+
+        x = b;
+        for (int c = 0; c < nf; c++) x.row(m_free[c]) = y.row(c);
+        return true;
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,283 @@
+/*!
+*      \file property.h
+*      \brief Typed attribute arrays of mesh elements, addressed by a dense element index
+*
+*      The large arrays are placed by CPages::policy(), on huge pages or on the
+*      nodes of the threads that work on them, see pages.h.
+*
+*      The arrays of trivially copyable values are offered as raw bytes, so a
+*      checkpoint stores them as they are, see CBaseMesh::checkpoint(). One read
+*      back before the program added its property again is held as bytes, by
+*      the name of its type, until add() of that type takes the values over.
+*/
+
+#ifndef _MESHLIB_PROPERTY_H_
+#define _MESHLIB_PROPERTY_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <typeinfo>
+
+#include "../parser/pages.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CBaseProperty class, the type independent part of a property array
+     */
+    class CBaseProperty
+    {
+    public:
+        explicit CBaseProperty(const std::string & name) : m_name(name) {}
+        virtual ~CBaseProperty() {}
+
+        const std::string & name() const { return m_name; }
+
+        /*! grow or shrink to n elements, new ones get the initial value */
+        virtual void resize(size_t n) = 0;
+        virtual void reserve(size_t n) = 0;
+        /*! give element i the initial value again, e.g. when its index is recycled */
+        virtual void reset(size_t i) = 0;
+        /*! bytes of the array, not counting what the values hold elsewhere */
+        virtual size_t memory() const = 0;
+
+        /*! the values as raw bytes, value_size() each, NULL unless their type is trivially copyable */
+        virtual char * bytes() = 0;
+        /*! the initial value as raw bytes, NULL as bytes() */
+        virtual const char * initial_bytes() const = 0;
+        virtual size_t value_size() const = 0;
+        /*! the name of the type of the values, a checkpointed array goes back to a property of the same */
+        virtual const char * type_name() const = 0;
+
+    protected:
+        std::string m_name;
+    };
+
+    /*!
+     *  \brief CProperty class, one value of type T per element, stored contiguously
+     *
+     *  Indexed by the element pointer, prop[v], or by its property_index().
+     *  Slots of deleted elements stay in place until their index is recycled.
+     */
+    template<typename T>
+    class CProperty : public CBaseProperty
+    {
+        static_assert(!std::is_same<T, bool>::value, "std::vector<bool> is not contiguous, use char for flags");
+
+    public:
+        CProperty(const std::string & name, const T & init) : CBaseProperty(name), m_init(init) {}
+
+        template<typename Element>
+        T & operator[](Element * e) { return m_data[e->property_index()]; }
+        template<typename Element>
+        const T & operator[](Element * e) const { return m_data[e->property_index()]; }
+
+        T & operator[](size_t i) { return m_data[i]; }
+        const T & operator[](size_t i) const { return m_data[i]; }
+
+        /*! the values, size() of them, e.g. to upload one attribute in one copy */
+        T * data() { return m_data.data(); }
+        const T * data() const { return m_data.data(); }
+        size_t size() const { return m_data.size(); }
+
+        /*! set every slot to v */
+        void fill(const T & v) { std::fill(m_data.begin(), m_data.end(), v); }
+
+        void resize(size_t n) { m_data.resize(n, m_init); }
+        void reserve(size_t n) { m_data.reserve(n); }
+        void reset(size_t i) { m_data[i] = m_init; }
+        size_t memory() const { return m_data.capacity() * sizeof(T); }
+
+        char * bytes() { return std::is_trivially_copyable<T>::value ? (char *)m_data.data() : NULL; }
+        const char * initial_bytes() const { return std::is_trivially_copyable<T>::value ? (const char *)&m_init : NULL; }
+        size_t value_size() const { return sizeof(T); }
+        const char * type_name() const { return typeid(T).name(); }
+
+    protected:
+        T                                 m_init;
+        std::vector<T, CPageAllocator<T>> m_data;
+    };
+
+    /*!
+     *  \brief CRawProperty class, the values of a property of a type not known here, as bytes
+     *
+     *  Read back from a checkpoint before the program added the property, it
+     *  keeps its slots as the elements come and go, and hands its values to
+     *  the first CPropertySet::add() of its name and type.
+     */
+    class CRawProperty : public CBaseProperty
+    {
+    public:
+        CRawProperty(const std::string & name, const std::string & type, size_t value_size, const char * init)
+            : CBaseProperty(name), m_type(type), m_value_size(value_size), m_init(init, init + value_size) {}
+
+        void resize(size_t n)
+        {
+            const size_t old = size();
+            m_data.resize(n * m_value_size);
+            for (size_t i = old; i < n; i++) reset(i);
+        }
+        void reserve(size_t n) { m_data.reserve(n * m_value_size); }
+        void reset(size_t i) { if (m_value_size) memcpy(&m_data[i * m_value_size], m_init.data(), m_value_size); }
+        size_t memory() const { return m_data.capacity(); }
+
+        char * bytes() { return m_data.data(); }
+        const char * initial_bytes() const { return m_init.data(); }
+        size_t value_size() const { return m_value_size; }
+        const char * type_name() const { return m_type.c_str(); }
+        size_t size() const { return m_value_size ? m_data.size() / m_value_size : 0; }
+
+    protected:
+        std::string                             m_type;
+        size_t                                  m_value_size;
+        std::vector<char>                       m_init;
+        std::vector<char, CPageAllocator<char>> m_data;
+    };
+
+    /*!
+     *  \brief CPropertySet class, the properties of one kind of element and the indices of the elements
+     *
+     *  Every element takes an index when created and returns it when deleted,
+     *  returned indices are handed out again first, so the arrays stay as long
+     *  as the most elements alive at once.
+     */
+    class CPropertySet
+    {
+    public:
+        /*! an index for a new element, every property gets a slot for it */
+        size_t acquire()
+        {
+            if (!m_free.empty())
+            {
+                size_t i = m_free.back();
+                m_free.pop_back();
+                for (auto & p : m_properties) p->reset(i);
+                return i;
+            }
+            for (auto & p : m_properties) p->resize(m_size + 1);
+            return m_size++;
+        }
+
+        /*! the element with index i is gone */
+        void release(size_t i) { m_free.push_back(i); }
+
+        /*! room for n more elements without reallocating the arrays */
+        void reserve(size_t n)
+        {
+            for (auto & p : m_properties) p->reserve(m_size + n);
+        }
+
+        /*! indices handed out so far, the length of every array */
+        size_t size() const { return m_size; }
+
+        /*!
+         *  add a property, one of the same name and type is returned as it is, one of another type
+         *  is replaced. The values of one of the same name and type read back from a checkpoint,
+         *  held as bytes so far, are taken over
+         */
+        template<typename T>
+        CProperty<T> & add(const std::string & name, const T & init = T())
+        {
+            if (CProperty<T> * p = find<T>(name)) return *p;
+            CProperty<T> * p = new CProperty<T>(name, init);
+            p->resize(m_size);
+            for (auto & q : m_properties)
+            {
+                if (q->name() != name) continue;
+                if (dynamic_cast<CRawProperty*>(q.get()) && _same_type(*q, *p) && m_size)
+                    memcpy(p->bytes(), q->bytes(), m_size * sizeof(T));
+                break;
+            }
+            remove(name);
+            m_properties.emplace_back(p);
+            return *p;
+        }
+
+        /*! the arrays, e.g. to checkpoint them */
+        const std::vector<std::unique_ptr<CBaseProperty>> & properties() const { return m_properties; }
+        /*! the indices returned and not handed out again, the last one goes first */
+        const std::vector<size_t> & free_indices() const { return m_free; }
+
+        /*!
+         *  Start over with size indices, those in free returned, every array with the initial
+         *  value in all of them, as a checkpoint is restored
+         */
+        void restore(size_t size, const std::vector<size_t> & free)
+        {
+            m_size = size;
+            m_free = free;
+            for (auto & p : m_properties)
+            {
+                p->resize(0);
+                p->resize(size);
+            }
+        }
+
+        /*!
+         *  The array for the values of a property read back from a checkpoint, size() of them: the
+         *  one of the name if its type matches, otherwise a CRawProperty in place of any of the name
+         *  \return where value_size bytes per index go, NULL if the property has no raw bytes
+         */
+        char * restore(const std::string & name, const std::string & type, size_t value_size, const char * init)
+        {
+            for (auto & p : m_properties)
+            {
+                if (p->name() == name && p->type_name() == type && p->value_size() == value_size) return p->bytes();
+            }
+            remove(name);
+            CRawProperty * p = new CRawProperty(name, type, value_size, init);
+            p->resize(m_size);
+            m_properties.emplace_back(p);
+            return p->bytes();
+        }
+
+        /*! bytes of the arrays and of the returned indices */
+        size_t memory() const
+        {
+            size_t bytes = m_free.capacity() * sizeof(size_t);
+            for (auto & p : m_properties) bytes += p->memory();
+            return bytes;
+        }
+
+        /*! the property of this name and type, NULL if there is none */
+        template<typename T>
+        CProperty<T> * find(const std::string & name)
+        {
+            for (auto & p : m_properties)
+            {
+                if (p->name() == name) return dynamic_cast<CProperty<T>*>(p.get());
+            }
+            return NULL;
+        }
+
+        bool remove(const std::string & name)
+        {
+            for (size_t i = 0; i < m_properties.size(); i++)
+            {
+                if (m_properties[i]->name() != name) continue;
+                m_properties.erase(m_properties.begin() + i);
+                return true;
+            }
+            return false;
+        }
+
+    protected:
+        static bool _same_type(CBaseProperty & a, CBaseProperty & b)
+        {
+            return a.value_size() == b.value_size() && std::string(a.type_name()) == b.type_name();
+        }
+
+        std::vector<std::unique_ptr<CBaseProperty>> m_properties;
+        std::vector<size_t>                         m_free;
+        size_t                                      m_size = 0;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,412 @@
+/*!
+*      \file remesher.h
+*      \brief Isotropic remeshing of triangle meshes towards a target edge length
+*
+*      Each iteration splits the edges longer than 4/3 of their target, collapses
+*      those shorter than 4/5, flips towards valence 6, 4 on the boundary, and
+*      moves the vertices tangentially to the centroids of their neighbors, back
+*      onto the input surface. Split and collapse start from the edges found by
+*      a parallel scan and go on with the edges their edits create, the flips
+*      run on CDynamicMesh::flipEdges and the smoothing in parallel. The target
+*      length is a vertex property, uniform, given or from the curvature.
+*      Boundary vertices and edges stay as they are.
+*/
+
+#ifndef _MESHLIB_REMESHER_H_
+#define _MESHLIB_REMESHER_H_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+
+#include "dynamicmesh.h"
+#include "../Geometry/BVH.h"
+#include "../parser/parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CRemesher class, remeshes a CDynamicMesh in place
+     *  \tparam M a CDynamicMesh of triangles
+     */
+    template<typename M>
+    class CRemesher
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        /*! the target lengths are the vertex property "remesh_length", 1 until set */
+        CRemesher(M & mesh) : m_mesh(mesh), m_length(mesh.template add_vertex_property<double>("remesh_length", 1.0)) {}
+
+        /*! the same target edge length everywhere */
+        void set_length(double length)
+        {
+            for (CVertex * v : m_mesh.vertices()) m_length[v] = length;
+        }
+
+        /*!
+         *  A target edge length per vertex, a sizing field
+         *  \param sizing double(CVertex*), called from several threads
+         */
+        template<typename Sizing>
+        void set_sizing(Sizing sizing, int threads = 0)
+        {
+            m_mesh.parallel_for_vertices([&](CVertex * v) { m_length[v] = sizing(v); }, threads);
+        }
+
+        /*!
+         *  Target lengths from the curvature: a chord of length l on a circle of radius r is
+         *  off by about l^2 / (8 r), the length keeps that below the tolerance
+         *  \param tolerance distance allowed between the mesh and the input surface
+         *  \param lmin, lmax bounds of the lengths, lmax where the surface is flat
+         */
+        void set_curvature_sizing(double tolerance, double lmin, double lmax, int threads = 0);
+
+        /*!
+         *  Remesh
+         *  \param iterations rounds of split, collapse, flip and smooth
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \param project move the smoothed vertices back onto the input surface
+         *  \return false if the mesh has other faces than triangles, it is left as it is
+         */
+        bool remesh(int iterations = 5, int threads = 0, bool project = true);
+
+    protected:
+        /*! target length of an edge, the mean of its ends' */
+        double _target(CVertex * a, CVertex * b) { return 0.5 * (m_length[a] + m_length[b]); }
+        /*! length squared of an edge and its target, false for a removed edge */
+        bool _measure(CEdge * e, double & length2, double & target);
+
+        void _split(int threads);
+        void _collapse(int threads);
+        /*! whether moving the ends of pH onto p folds a face around them or makes an edge too long */
+        bool _collapse_ok(CHalfEdge * pH, const CPoint & p, double max_length2);
+        void _flip(int threads);
+        void _smooth(int threads, bool project);
+
+        /*! the edges whose length and target satisfy pred, scanned in parallel */
+        template<typename Pred>
+        void _scan(std::vector<CEdge*> & edges, Pred pred, int threads);
+
+        static int _valence(CVertex * v)
+        {
+            int n = 0;
+            for (CVertex * w : v->vertices_range()) { (void)w; n++; }
+            return n;
+        }
+        static CPoint _normal(const CPoint & a, const CPoint & b, const CPoint & c) { return (b - a) ^ (c - a); }
+
+        M &                 m_mesh;
+        CProperty<double> & m_length;
+        CBVH                m_input;
+        std::vector<CEdge*> m_queue;
+        std::vector<CVertex*> m_verts;
+        std::vector<CPoint> m_points;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    //|k| at a vertex is taken as the largest 2 |n . (p_j - p_i)| / |p_j - p_i|^2 over its
+    //neighbors, the normal curvature along each edge; then l^2 / (8 r) <= tolerance solved
+    //with the exact sagitta gives l = sqrt(8 r t - 4 t^2)
+    template<typename M>
+    void CRemesher<M>::set_curvature_sizing(double tolerance, double lmin, double lmax, int threads)
+    {
+        m_mesh.parallel_for_vertices([&](CVertex * v)
+        {
+            CPoint n(0, 0, 0);
+            for (CFace * f : v->faces_range())
+            {
+                CHalfEdge * he = f->halfedge();
+                n += _normal(he->source()->point(), he->target()->point(), he->next()->target()->point());
+            }
+            double k = 0;
+            const double len = n.norm();
+            if (len > 0)
+            {
+                n /= len;
+                for (CVertex * w : v->vertices_range())
+                {
+                    const CPoint d = w->point() - v->point();
+                    const double d2 = d * d;
+                    if (d2 > 0) k = std::max(k, 2 * std::fabs(n * d) / d2);
+                }
+            }
+            double l = lmax;
+            if (k > 0)
+            {
+                const double r = 1 / k;
+                l = 8 * r * tolerance > 4 * tolerance * tolerance ? std::sqrt(8 * r * tolerance - 4 * tolerance * tolerance) : lmin;
+            }
+            m_length[v] = std::min(lmax, std::max(lmin, l));
+        }, threads);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    bool CRemesher<M>::remesh(int iterations, int threads, bool project)
+    {
+        for (CFace * f : m_mesh.faces())
+        {
+            CHalfEdge * he = f->halfedge();
+            if (he->next()->next()->next() != he) return false;
+        }
+        if (project) m_input._construct_faces(m_mesh.faces(), threads);
+
+        for (int i = 0; i < iterations; i++)
+        {
+            _split(threads);
+            _collapse(threads);
+            _flip(threads);
+            _smooth(threads, project);
+        }
+        m_input.clear();
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    bool CRemesher<M>::_measure(CEdge * e, double & length2, double & target)
+    {
+        CHalfEdge * he = e->halfedge(0);
+        if (he == NULL) return false;
+        CVertex * a = he->source();
+        CVertex * b = he->target();
+        const CPoint d = b->point() - a->point();
+        length2 = d * d;
+        target = _target(a, b);
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    template<typename Pred>
+    void CRemesher<M>::_scan(std::vector<CEdge*> & edges, Pred pred, int threads)
+    {
+        const std::vector<CEdge*> & data = m_mesh.edges().data();
+        std::vector<unsigned char> flag(data.size(), 0);
+        parallel_for(data.size(), threads, [&](size_t b, size_t e)
+        {
+            double length2, target;
+            for (size_t i = b; i < e; i++)
+            {
+                flag[i] = data[i] != NULL && _measure(data[i], length2, target) && pred(data[i], length2, target);
+            }
+        }, 1 << 12);
+        edges.clear();
+        for (size_t i = 0; i < data.size(); i++) if (flag[i]) edges.push_back(data[i]);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    //interior edges longer than 4/3 of their target are split at their middle, the
+    //new edges around the middle are split in turn while they are too long. Boundary
+    //edges are kept as they are. The longest edge relative to its target goes first,
+    //else the spokes of the new vertices keep fanning out around one end
+    template<typename M>
+    void CRemesher<M>::_split(int threads)
+    {
+        auto too_long = [](CEdge * e, double length2, double target)
+        {
+            return e->halfedge(1) != NULL && length2 > 16.0 / 9.0 * target * target;
+        };
+        _scan(m_queue, too_long, threads);
+
+        double length2, target;
+        std::priority_queue<std::pair<double, CEdge*>> queue;
+        for (CEdge * e : m_queue)
+        {
+            _measure(e, length2, target);
+            queue.push(std::make_pair(length2 / (target * target), e));
+        }
+
+        while (!queue.empty())
+        {
+            CEdge * e = queue.top().second;
+            queue.pop();
+            if (!_measure(e, length2, target) || !too_long(e, length2, target)) continue;
+
+            CVertex * a = e->halfedge(0)->source();
+            CVertex * b = e->halfedge(0)->target();
+            const CPoint middle = (a->point() + b->point()) / 2.0;
+            const double length = _target(a, b);
+
+            //the spokes to the opposite corners must come out shorter than e, else a
+            //triangle on a long, fixed boundary edge keeps spawning spokes as long as it
+            const CPoint c0 = e->halfedge(0)->next()->target()->point() - middle;
+            const CPoint c1 = e->halfedge(1)->next()->target()->point() - middle;
+            if (c0 * c0 >= length2 || c1 * c1 >= length2) continue;
+
+            CVertex * v = m_mesh.splitEdge(e);
+            v->point() = middle;
+            m_length[v] = length;
+            for (CEdge * f : v->edges_range())
+            {
+                if (_measure(f, length2, target) && too_long(f, length2, target)) queue.push(std::make_pair(length2 / (target * target), f));
+            }
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    bool CRemesher<M>::_collapse_ok(CHalfEdge * pH, const CPoint & p, double max_length2)
+    {
+        CVertex * ends[2] = { pH->source(), pH->target() };
+        CFace * gone[2] = { pH->face(), pH->dual()->face() };
+        for (CVertex * v : ends)
+        {
+            for (CVertex * w : v->vertices_range())
+            {
+                if (w == ends[0] || w == ends[1]) continue;
+                const CPoint d = w->point() - p;
+                if (d * d > max_length2) return false;
+            }
+            for (CFace * f : v->faces_range())
+            {
+                if (f == gone[0] || f == gone[1]) continue;
+                CPoint before[3], after[3];
+                CHalfEdge * he = f->halfedge();
+                for (int k = 0; k < 3; k++, he = he->next())
+                {
+                    before[k] = he->target()->point();
+                    after[k] = (he->target() == ends[0] || he->target() == ends[1]) ? p : before[k];
+                }
+                if (_normal(before[0], before[1], before[2]) * _normal(after[0], after[1], after[2]) <= 0) return false;
+            }
+        }
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    //edges shorter than 4/5 of their target collapse into their middle, or onto the end
+    //on the boundary, unless that makes an edge longer than 4/3 or folds a face
+    template<typename M>
+    void CRemesher<M>::_collapse(int threads)
+    {
+        auto too_short = [](CEdge * e, double length2, double target)
+        {
+            (void)e;
+            return length2 < 16.0 / 25.0 * target * target;
+        };
+        _scan(m_queue, too_short, threads);
+        // shortest last, they are taken first
+        {
+            std::vector<std::pair<double, CEdge*>> order(m_queue.size());
+            double length2, target;
+            for (size_t i = 0; i < m_queue.size(); i++)
+            {
+                _measure(m_queue[i], length2, target);
+                order[i] = std::make_pair(-length2, m_queue[i]);
+            }
+            std::sort(order.begin(), order.end());
+            for (size_t i = 0; i < order.size(); i++) m_queue[i] = order[i].second;
+        }
+
+        double length2, target;
+        while (!m_queue.empty())
+        {
+            CEdge * e = m_queue.back();
+            m_queue.pop_back();
+            if (!_measure(e, length2, target) || !too_short(e, length2, target)) continue;
+
+            CHalfEdge * pH = e->halfedge(0);
+            if (pH->dual() == NULL) continue;
+            // the vertex that goes must be interior
+            if (pH->source()->boundary()) pH = pH->dual();
+            if (pH->source()->boundary()) continue;
+
+            CVertex * to = pH->target();
+            const CPoint p = to->boundary() ? to->point() : (pH->source()->point() + to->point()) / 2.0;
+            if (!_collapse_ok(pH, p, 16.0 / 9.0 * target * target) || !m_mesh.collapsable(pH)) continue;
+
+            m_mesh.collapseEdgeDeferred(pH);
+            to->point() = p;
+            for (CEdge * f : to->edges_range())
+            {
+                if (_measure(f, length2, target) && too_short(f, length2, target)) m_queue.push_back(f);
+            }
+        }
+        m_mesh.sweep();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    //a flip has to bring the four valences closer to 6, 4 on the boundary, and keep the
+    //two new faces facing the way of the old ones
+    template<typename M>
+    void CRemesher<M>::_flip(int threads)
+    {
+        m_mesh.flipEdges([&](CEdge * e)
+        {
+            CHalfEdge * h0 = e->halfedge(0);
+            CHalfEdge * h1 = e->halfedge(1);
+            CVertex * pv[4] = { h0->target(), h0->next()->target(), h0->source(), h1->next()->target() };
+            int before = 0, after = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                const int valence = _valence(pv[k]);
+                const int deviation = valence - (pv[k]->boundary() ? 4 : 6);
+                // the ends lose the edge, the tips gain it
+                const int changed = deviation + ((k % 2) ? 1 : -1);
+                before += deviation * deviation;
+                after += changed * changed;
+            }
+            if (after >= before) return false;
+
+            const CPoint & a = pv[0]->point(), & b = pv[1]->point(), & c = pv[2]->point(), & d = pv[3]->point();
+            const CPoint n = _normal(a, b, c) + _normal(c, d, a);
+            return _normal(b, c, d) * n > 0 && _normal(d, a, b) * n > 0;
+        }, threads);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    //uniform Laplacian, only its part in the tangent plane, then back onto the input
+    template<typename M>
+    void CRemesher<M>::_smooth(int threads, bool project)
+    {
+        m_verts.assign(m_mesh.vertices().begin(), m_mesh.vertices().end());
+        m_points.resize(m_verts.size());
+        parallel_for(m_verts.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                CVertex * v = m_verts[i];
+                m_points[i] = v->point();
+                if (v->boundary() || v->halfedge() == NULL) continue;
+
+                CPoint centroid(0, 0, 0), n(0, 0, 0);
+                int count = 0;
+                for (CVertex * w : v->vertices_range())
+                {
+                    centroid += w->point();
+                    count++;
+                }
+                for (CFace * f : v->faces_range())
+                {
+                    CHalfEdge * he = f->halfedge();
+                    n += _normal(he->source()->point(), he->target()->point(), he->next()->target()->point());
+                }
+                const double len = n.norm();
+                if (count == 0 || len == 0) continue;
+                n /= len;
+
+                CPoint d = centroid / (double)count - v->point();
+                d -= n * (n * d);
+                CPoint p = v->point() + d;
+                CBVH::CNearest nearest;
+                if (project && m_input._closest(p, nearest)) p = nearest.point;
+                m_points[i] = p;
+            }
+        }, 1 << 10);
+        parallel_for(m_verts.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++) m_verts[i]->point() = m_points[i];
+        }, 1 << 14);
+        m_mesh.touch_points();
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,332 @@
+/*!
+*      \file repair.h
+*      \brief Faces of flat arrays made fit for the halfedge structure
+*
+*      Scanned and exported meshes are often not manifold: an edge of three
+*      faces, two faces walking an edge the same way, a bowtie of two fans
+*      meeting at one vertex, faces listed twice, faces with a repeated
+*      corner or without area. The bulk build would link such input wrongly
+*      or stop on it. The repair runs over the index arrays before the build,
+*      in the order of the faces, so that the first faces of the file are the
+*      ones kept: the faces that cannot be linked are dropped, their indices
+*      set to -1, which the build skips, and every vertex whose faces form
+*      more than one fan is split into a vertex per fan, appended after the
+*      points. The edges are found through a CEdgeHash of their end vertices.
+*/
+
+#ifndef _MESHLIB_REPAIR_H_
+#define _MESHLIB_REPAIR_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include "../Geometry/Point.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+#include "../parser/trace.h"
+#include "edgehash.h"
+
+namespace MeshLib
+{
+
+    /*!
+    * \brief CRepairReport, what CMeshRepair changed in the faces and vertices it was given
+    */
+    struct CRepairReport
+    {
+        //! faces of less than three corners or with a corner outside the points
+        size_t invalid_faces = 0;
+        //! faces with a repeated corner or without area
+        size_t degenerate_faces = 0;
+        //! faces over the same corners as an earlier one, in either orientation
+        size_t duplicate_faces = 0;
+        //! faces on an edge an earlier face walks the same way, a third face or one turned against its neighbours
+        size_t nonmanifold_faces = 0;
+        //! vertices added for the fans of the vertices that had more than one
+        size_t split_vertices = 0;
+
+        size_t dropped_faces() const { return invalid_faces + degenerate_faces + duplicate_faces + nonmanifold_faces; }
+        bool clean() const { return dropped_faces() == 0 && split_vertices == 0; }
+
+        /*! a line per kind of repair */
+        void print(std::ostream & os) const
+        {
+            os << "invalid faces " << invalid_faces << std::endl;
+            os << "degenerate faces " << degenerate_faces << std::endl;
+            os << "duplicate faces " << duplicate_faces << std::endl;
+            os << "non-manifold faces " << nonmanifold_faces << std::endl;
+            os << "split vertices " << split_vertices << std::endl;
+        }
+    };
+
+    /*!
+     *  \brief CMeshRepair class
+     */
+    class CMeshRepair
+    {
+    public:
+        //! a face is without area when twice its area is at most this times its longest edge squared
+        double area_tolerance = 1e-12;
+
+        /*!
+         *  Repair the faces in place
+         *  \param nv           number of points
+         *  \param point        point(i) is point i as a CPoint
+         *  \param indices      0-based vertex of every corner, -1 for the corners of the faces dropped,
+         *                      the split vertices nv and up
+         *  \param face_offsets face j owns corners [face_offsets[j], face_offsets[j+1]), empty means triangles
+         *  \param split        the vertex every split vertex nv + k is a copy of
+         *  \param threads      number of threads, 0 uses all hardware threads
+         */
+        template<typename Point>
+        CRepairReport repair(size_t nv, Point point, std::vector<int> & indices, const std::vector<int> & face_offsets,
+                             std::vector<int> & split, int threads = 0) const;
+
+    protected:
+        enum { KEPT, INVALID, DEGENERATE, DUPLICATE, NONMANIFOLD };
+
+        /* the faces walking an edge, by the corner their halfedge starts at, one each way */
+        struct CEdgeUse
+        {
+            int lo, hi;
+            int forward = -1;       //!< from lo to hi
+            int backward = -1;      //!< from hi to lo
+        };
+
+        /* the first corner of face f and the one past its last */
+        static int _begin(const std::vector<int> & offsets, size_t f) { return offsets.empty() ? 3 * (int)f : offsets[f]; }
+        static int _end(const std::vector<int> & offsets, size_t f) { return offsets.empty() ? 3 * (int)f + 3 : offsets[f + 1]; }
+
+        /* faces over the same corners as an earlier kept face */
+        static void _duplicates(const std::vector<int> & indices, const std::vector<int> & offsets, std::vector<char> & state, int threads);
+        /* faces on an edge taken the same way already, in face order, and the corners of every edge */
+        static void _edges(const std::vector<int> & indices, const std::vector<int> & offsets, std::vector<char> & state,
+                           std::vector<CEdgeUse> & uses);
+        /* split the vertices whose corners fall into several fans */
+        static void _fans(size_t nv, std::vector<int> & indices, const std::vector<int> & offsets, const std::vector<char> & state,
+                          const std::vector<CEdgeUse> & uses, std::vector<int> & split);
+
+        /* the root of corner c, halving the path */
+        static int _root(std::vector<int> & parent, int c)
+        {
+            while (parent[c] != c)
+            {
+                parent[c] = parent[parent[c]];
+                c = parent[c];
+            }
+            return c;
+        }
+    };
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    Every face alone first, in parallel, then the duplicates, the edges in face order and the fans
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    template<typename Point>
+    inline CRepairReport CMeshRepair::repair(size_t nv, Point point, std::vector<int> & indices, const std::vector<int> & face_offsets,
+                                             std::vector<int> & split, int threads) const
+    {
+        MESHLIB_TRACE_ZONE("repair");
+        split.clear();
+        const size_t nf = face_offsets.empty() ? indices.size() / 3 : face_offsets.size() - 1;
+        std::vector<char> state(nf, KEPT);
+        parallel_for(nf, threads, [&](size_t b, size_t e)
+        {
+            for (size_t f = b; f < e; f++)
+            {
+                const int fb = _begin(face_offsets, f), fe = _end(face_offsets, f);
+                bool valid = fe - fb >= 3;
+                for (int c = fb; c < fe && valid; c++) valid = indices[c] >= 0 && indices[c] < (int)nv;
+                if (!valid)
+                {
+                    state[f] = INVALID;
+                    continue;
+                }
+                bool repeated = false;
+                for (int c = fb; c < fe && !repeated; c++)
+                    for (int d = c + 1; d < fe && !repeated; d++) repeated = indices[c] == indices[d];
+                // the area by Newell's rule, which holds for polygons that are not flat too, about
+                // the first corner so that points far from the origin keep their digits
+                const CPoint o = point(indices[fb]);
+                CPoint normal;
+                double longest = 0;
+                for (int c = fb; c < fe && !repeated; c++)
+                {
+                    const CPoint p = point(indices[c]) - o, q = point(indices[c + 1 == fe ? fb : c + 1]) - o;
+                    normal += p ^ q;
+                    longest = std::max(longest, (q - p) * (q - p));
+                }
+                if (repeated || normal.norm() <= area_tolerance * longest) state[f] = DEGENERATE;
+            }
+        });
+
+        _duplicates(indices, face_offsets, state, threads);
+        std::vector<CEdgeUse> uses;
+        _edges(indices, face_offsets, state, uses);
+
+        CRepairReport report;
+        for (size_t f = 0; f < nf; f++)
+        {
+            switch (state[f])
+            {
+            case KEPT: continue;
+            case INVALID: report.invalid_faces++; break;
+            case DEGENERATE: report.degenerate_faces++; break;
+            case DUPLICATE: report.duplicate_faces++; break;
+            default: report.nonmanifold_faces++; break;
+            }
+            for (int c = _begin(face_offsets, f); c < _end(face_offsets, f); c++) indices[c] = -1;
+        }
+
+        _fans(nv, indices, face_offsets, state, uses, split);
+        report.split_vertices = split.size();
+        MESHLIB_COUNTER_ADD("repair.dropped_faces", report.dropped_faces());
+        MESHLIB_COUNTER_ADD("repair.split_vertices", report.split_vertices);
+        return report;
+    }
+
+    inline void CMeshRepair::_duplicates(const std::vector<int> & indices, const std::vector<int> & offsets, std::vector<char> & state, int threads)
+    {
+        // the faces by a hash of their sorted corners, equal hashes compared corner by corner
+        const size_t nf = state.size();
+        std::vector<std::pair<uint64_t, uint32_t>> keys(nf);
+        parallel_for(nf, threads, [&](size_t b, size_t e)
+        {
+            std::vector<int> sorted;
+            for (size_t f = b; f < e; f++)
+            {
+                sorted.assign(indices.begin() + _begin(offsets, f), indices.begin() + _end(offsets, f));
+                std::sort(sorted.begin(), sorted.end());
+                uint64_t h = 14695981039346656037ull;
+                for (int v : sorted) h = (h ^ (uint32_t)v) * 1099511628211ull;
+                keys[f] = std::make_pair(state[f] == KEPT ? h : 0, (uint32_t)f);
+            }
+        });
+        parallel_sort(keys.begin(), keys.end(), threads, std::less<std::pair<uint64_t, uint32_t>>());
+
+        std::vector<int> a, b;
+        for (size_t i = 0; i < nf;)
+        {
+            size_t j = i + 1;
+            while (j < nf && keys[j].first == keys[i].first) j++;
+            // the faces of a run are in face order, each against the kept ones before it
+            for (size_t k = i + 1; k < j; k++)
+            {
+                const uint32_t f = keys[k].second;
+                if (state[f] != KEPT) continue;
+                b.assign(indices.begin() + _begin(offsets, f), indices.begin() + _end(offsets, f));
+                std::sort(b.begin(), b.end());
+                for (size_t l = i; l < k && state[f] == KEPT; l++)
+                {
+                    const uint32_t g = keys[l].second;
+                    if (state[g] != KEPT) continue;
+                    a.assign(indices.begin() + _begin(offsets, g), indices.begin() + _end(offsets, g));
+                    std::sort(a.begin(), a.end());
+                    if (a == b) state[f] = DUPLICATE;
+                }
+            }
+            i = j;
+        }
+    }
+
+    inline void CMeshRepair::_edges(const std::vector<int> & indices, const std::vector<int> & offsets, std::vector<char> & state,
+                                    std::vector<CEdgeUse> & uses)
+    {
+        // the table points into uses, which never grows past the corners
+        uses.clear();
+        uses.reserve(indices.size());
+        CEdgeHash<CEdgeUse> table;
+        table.reserve(indices.size() / 2 + 1);
+        auto find = [&](int a, int b)
+        {
+            const int lo = std::min(a, b), hi = std::max(a, b);
+            return table.find(CEdgeHash<CEdgeUse>::key(lo, hi), [&](CEdgeUse * u) { return u->lo == lo && u->hi == hi; });
+        };
+
+        for (size_t f = 0; f < state.size(); f++)
+        {
+            if (state[f] != KEPT) continue;
+            const int fb = _begin(offsets, f), fe = _end(offsets, f);
+            // the face is kept only if every edge of it is free its way
+            bool free = true;
+            for (int c = fb; c < fe && free; c++)
+            {
+                const int a = indices[c], b = indices[c + 1 == fe ? fb : c + 1];
+                const CEdgeUse * u = find(a, b);
+                free = !u || (a < b ? u->forward : u->backward) < 0;
+            }
+            if (!free)
+            {
+                state[f] = NONMANIFOLD;
+                continue;
+            }
+            for (int c = fb; c < fe; c++)
+            {
+                const int a = indices[c], b = indices[c + 1 == fe ? fb : c + 1];
+                CEdgeUse * u = find(a, b);
+                if (!u)
+                {
+                    uses.push_back(CEdgeUse());
+                    u = &uses.back();
+                    u->lo = std::min(a, b);
+                    u->hi = std::max(a, b);
+                    table.insert(CEdgeHash<CEdgeUse>::key(u->lo, u->hi), u);
+                }
+                (a < b ? u->forward : u->backward) = c;
+            }
+        }
+    }
+
+    inline void CMeshRepair::_fans(size_t nv, std::vector<int> & indices, const std::vector<int> & offsets, const std::vector<char> & state,
+                                   const std::vector<CEdgeUse> & uses, std::vector<int> & split)
+    {
+        // the corner after every corner in its face
+        std::vector<int> next(indices.size());
+        for (size_t f = 0; f < state.size(); f++)
+        {
+            const int fb = _begin(offsets, f), fe = _end(offsets, f);
+            for (int c = fb; c < fe; c++) next[c] = c + 1 == fe ? fb : c + 1;
+        }
+
+        // the two faces of an edge join their corners at both ends into one fan
+        std::vector<int> parent(indices.size());
+        for (size_t c = 0; c < parent.size(); c++) parent[c] = (int)c;
+        auto join = [&](int a, int b)
+        {
+            a = _root(parent, a);
+            b = _root(parent, b);
+            if (a != b) parent[std::max(a, b)] = std::min(a, b);
+        };
+        for (const CEdgeUse & u : uses)
+        {
+            if (u.forward < 0 || u.backward < 0) continue;
+            join(u.forward, next[u.backward]);
+            join(next[u.forward], u.backward);
+        }
+
+        // the fan of the first corner of a vertex keeps it, every other fan takes a copy
+        std::vector<int> fan(nv, -1), copy(indices.size(), -1);
+        for (size_t c = 0; c < indices.size(); c++)
+        {
+            const int v = indices[c];
+            if (v < 0) continue;
+            const int r = _root(parent, (int)c);
+            if (fan[v] < 0) fan[v] = r;
+            if (fan[v] == r) continue;
+            if (copy[r] < 0)
+            {
+                copy[r] = (int)(nv + split.size());
+                split.push_back(v);
+            }
+            indices[c] = copy[r];
+        }
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,575 @@
+/*!
+*      \file ricciflow.h
+*      \brief Discrete Ricci flow of inversive distance circle packings, Euclidean and hyperbolic
+*
+*      Every vertex carries a circle, every edge the inversive distance of
+*      the circles of its ends, taken from the points at the start, so the
+*      radii alone give the lengths of the edges. The flow changes the radii
+*      until the curvatures, the angle deficits, are the target ones. It is
+*      Newton's method on a convex energy whose Hessian has the pattern of
+*      the Laplacian: the angle terms of every triangle are evaluated in
+*      parallel, every row sums those of its corners, and the system is
+*      solved by CPoissonSolver, its analysis kept over the iterations. The
+*      metric is then laid out face by face, in the plane or in the Poincare
+*      disk, to the uvs.
+*/
+
+#ifndef _MESHLIB_RICCI_FLOW_H_
+#define _MESHLIB_RICCI_FLOW_H_
+
+#include <vector>
+#include <deque>
+#include <cmath>
+#include <complex>
+#include <algorithm>
+
+#include "poisson.h"
+#include "../Geometry/HyperbolicCircle.h"
+#include "../Mobius/Mobius.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CRicciFlow class, a metric of prescribed curvatures by circle packing
+     *
+     *  The curvature of an interior vertex is 2 pi less the angles around it,
+     *  that of a boundary vertex pi less them. By default the targets are 0
+     *  inside; in the Euclidean plane the boundary has 2 pi chi by arc length,
+     *  which maps a disk to a convex domain, and in the hyperbolic one it is
+     *  0 too, a geodesic boundary. A closed mesh needs chi = 0 to be flat and
+     *  chi < 0 to be hyperbolic. Polygons other than triangles are left out.
+     *  \tparam M      a CBaseMesh
+     *  \tparam Solver an Eigen sparse solver, see CPoissonSolver
+     */
+    template<typename M, typename Solver = Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>>>
+    class CRicciFlow
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        /*! background geometries */
+        enum Geometry
+        {
+            EUCLIDEAN,
+            HYPERBOLIC
+        };
+
+        CRicciFlow(M & mesh, Geometry geometry = EUCLIDEAN, int threads = 0)
+            : m_mesh(mesh), m_geometry(geometry), m_threads(threads), m_solver(mesh, CLaplacian<M>::COTANGENT, threads) {}
+
+        /*! the target curvatures by the rows of laplacian(), the defaults if empty */
+        void set_target(const std::vector<double> & target) { m_target = target; }
+        /*! vertices whose radii stay, in the Euclidean plane the first vertex if none */
+        void set_fixed(const std::vector<CVertex*> & fixed) { m_fixed = fixed; }
+
+        /*!
+         *  Run the flow from the circles of the points
+         *  \param tolerance of the largest difference of curvature to the target
+         *  \param iterations most Newton steps
+         *  \return false if it did not converge
+         */
+        bool solve(double tolerance = 1e-10, int iterations = 100);
+        /*!
+         *  Lay the triangles out by the metric, into the uvs of the halfedges, and of the
+         *  vertices where each is first placed; Euclidean uvs are scaled into [0, 1]^2, the
+         *  Poincare disk is mapped onto the disk inscribed in it
+         */
+        void layout();
+
+        /*! the largest difference of curvature to the target after solve() */
+        double error() const { return m_error; }
+        /*! by the rows of laplacian(), the curvatures, targets and radii */
+        const std::vector<double> & curvature() const { return m_curvature; }
+        const std::vector<double> & target() const { return m_target; }
+        std::vector<double> radii() const;
+        /*! the circles of the vertices where layout() first placed them, before the uvs are scaled */
+        CCircle circle(CVertex * v) const;
+        CHyperbolicCircle hyperbolic_circle(CVertex * v) const;
+        const CLaplacian<M> & laplacian() const { return m_solver.laplacian(); }
+
+    protected:
+        M & m_mesh;
+        Geometry m_geometry;
+        int m_threads;
+        CPoissonSolver<M, Solver> m_solver;
+        std::vector<double> m_target;
+        std::vector<CVertex*> m_fixed;
+        double m_error = 0;
+
+        //! the triangles, their faces, and the corners of row i at [m_corner_outer[i], m_corner_outer[i + 1])
+        std::vector<int> m_tris;
+        std::vector<CFace*> m_faces;
+        std::vector<int> m_corner_outer;
+        std::vector<int> m_corners;
+        //! for every corner the entries of L of its row at the columns of the three corners
+        std::vector<int> m_entries;
+        std::vector<char> m_boundary;
+
+        //! u, log r or log tanh(r / 2), by row, and the inversive distance of every side of a triangle
+        std::vector<double> m_u;
+        std::vector<double> m_inversive;
+        //! by corner, the angle, the length of the opposite side, and the derivatives of the angle by u
+        std::vector<double> m_angle;
+        std::vector<double> m_length;
+        std::vector<double> m_jacobian;
+        std::vector<double> m_values;
+        std::vector<double> m_curvature;
+        //! where layout() placed the vertices, by row
+        std::vector<Complex> m_center;
+
+        /*! lay out the triangles and the entries of their corners */
+        void _build();
+        /*! the circles and inversive distances of the points, the default targets */
+        void _initialize();
+        double _radius(double u) const { return m_geometry == EUCLIDEAN ? std::exp(u) : 2 * std::atanh(std::exp(u)); }
+        /*! cosh a cosh b - 1 without cancellation */
+        static double _cosh_product(double a, double b) { return std::pow(std::sinh((a + b) / 2), 2) + std::pow(std::sinh((a - b) / 2), 2); }
+        /*! lengths, angles and their derivatives of triangle t for u, false if it is degenerate */
+        bool _triangle(size_t t, const std::vector<double> & u);
+        /*! the triangles and the rows for u, the Hessian into m_values, false if a triangle is degenerate */
+        bool _evaluate(const std::vector<double> & u);
+        /*! the norm of the differences of curvature to the target at the rows that are not fixed */
+        double _residual(const std::vector<char> & fixed, double & largest) const;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CRicciFlow<M, Solver>::_build()
+    {
+        const CLaplacian<M> & laplacian = m_solver.laplacian();
+        const size_t n = laplacian.size();
+        m_tris.clear();
+        m_faces.clear();
+        for (CFace * f : m_mesh.faces())
+        {
+            CHalfEdge * he = f->halfedge();
+            if (he->next()->next()->next() != he) continue;
+            m_tris.push_back(laplacian.row(he->source()));
+            m_tris.push_back(laplacian.row(he->target()));
+            m_tris.push_back(laplacian.row(he->next()->target()));
+            m_faces.push_back(f);
+        }
+        m_corner_outer.assign(n + 1, 0);
+        for (int r : m_tris) m_corner_outer[r + 1]++;
+        for (size_t i = 0; i < n; i++) m_corner_outer[i + 1] += m_corner_outer[i];
+        m_corners.resize(m_tris.size());
+        std::vector<int> fill(m_corner_outer.begin(), m_corner_outer.end() - 1);
+        for (size_t c = 0; c < m_tris.size(); c++) m_corners[fill[m_tris[c]]++] = (int)c;
+
+        const std::vector<int> & outer = laplacian.outer();
+        const std::vector<int> & inner = laplacian.inner();
+        m_entries.resize(3 * m_tris.size());
+        parallel_for(m_tris.size(), m_threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++)
+            {
+                const int i = m_tris[c];
+                const int * t = &m_tris[3 * (c / 3)];
+                for (int k = 0; k < 3; k++)
+                    m_entries[3 * c + k] = (int)(std::lower_bound(inner.begin() + outer[i], inner.begin() + outer[i + 1], t[k]) - inner.begin());
+            }
+        });
+        m_boundary.resize(n);
+        for (size_t i = 0; i < n; i++) m_boundary[i] = laplacian.vertex(i)->boundary() ? 1 : 0;
+
+        m_inversive.resize(m_tris.size());
+        m_angle.resize(m_tris.size());
+        m_length.resize(m_tris.size());
+        m_jacobian.resize(3 * m_tris.size());
+        m_curvature.resize(n);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CRicciFlow<M, Solver>::_initialize()
+    {
+        const CLaplacian<M> & laplacian = m_solver.laplacian();
+        const size_t n = laplacian.size();
+        const size_t nt = m_tris.size() / 3;
+
+        // the lengths of the sides, scaled for the hyperbolic plane to the area of its metric, 2 pi for chi >= 0
+        std::vector<double> length(m_tris.size());
+        double area = 0;
+        for (size_t t = 0; t < nt; t++)
+        {
+            const CPoint p[3] = { laplacian.vertex(m_tris[3 * t])->point(), laplacian.vertex(m_tris[3 * t + 1])->point(),
+                laplacian.vertex(m_tris[3 * t + 2])->point() };
+            for (int c = 0; c < 3; c++) length[3 * t + c] = (p[(c + 2) % 3] - p[(c + 1) % 3]).norm();
+            area += ((p[1] - p[0]) ^ (p[2] - p[0])).norm() / 2;
+        }
+        const int chi = (int)m_mesh.vertices().size() - (int)m_mesh.edges().size() + (int)m_mesh.faces().size();
+        double scale = 1;
+        if (m_geometry == HYPERBOLIC && area > 0) scale = std::sqrt(2 * M_PI * std::max(-chi, 1) / area);
+        for (double & l : length) l *= scale;
+
+        // a third of the shortest side at the vertex, the circles are disjoint
+        std::vector<double> radius(n, 1e300);
+        for (size_t c = 0; c < m_tris.size(); c++)
+        {
+            const int t = (int)(c / 3), k = (int)(c % 3);
+            const double l = length[c];
+            for (int s = 1; s < 3; s++)
+            {
+                const int r = m_tris[3 * t + (k + s) % 3];
+                radius[r] = std::min(radius[r], l / 3);
+            }
+        }
+        m_u.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (radius[i] >= 1e300) radius[i] = 1;
+            m_u[i] = m_geometry == EUCLIDEAN ? std::log(radius[i]) : std::log(std::tanh(radius[i] / 2));
+        }
+        for (size_t c = 0; c < m_tris.size(); c++)
+        {
+            const int t = (int)(c / 3), k = (int)(c % 3);
+            const double ri = radius[m_tris[3 * t + (k + 1) % 3]], rj = radius[m_tris[3 * t + (k + 2) % 3]], l = length[c];
+            m_inversive[c] = m_geometry == EUCLIDEAN ? (l * l - ri * ri - rj * rj) / (2 * ri * rj)
+                : (std::cosh(l) - std::cosh(ri) * std::cosh(rj)) / (std::sinh(ri) * std::sinh(rj));
+        }
+
+        if (m_target.size() == n) return;
+        m_target.assign(n, 0.0);
+        if (m_geometry == HYPERBOLIC) return;
+        // 2 pi chi over the boundary by the length around every vertex
+        std::vector<double> share(n, 0.0);
+        double total = 0;
+        for (CEdge * e : m_mesh.edges())
+        {
+            if (e->halfedge(1) != NULL) continue;
+            CHalfEdge * he = e->halfedge(0);
+            const double l = (he->target()->point() - he->source()->point()).norm();
+            share[laplacian.row(he->source())] += l / 2;
+            share[laplacian.row(he->target())] += l / 2;
+            total += l;
+        }
+        if (total <= 0) return;
+        for (size_t i = 0; i < n; i++) m_target[i] = 2 * M_PI * chi * share[i] / total;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    bool CRicciFlow<M, Solver>::_triangle(size_t t, const std::vector<double> & u)
+    {
+        const bool euclidean = m_geometry == EUCLIDEAN;
+        const int * v = &m_tris[3 * t];
+        double r[3], dr[3];
+        for (int k = 0; k < 3; k++)
+        {
+            r[k] = _radius(u[v[k]]);
+            // the derivative of r by u over r in the plane, for log r, and sinh r over sinh r in the disk
+            dr[k] = euclidean ? r[k] : std::sinh(r[k]);
+        }
+
+        // the side c is opposite to corner c, between the corners p and q after it
+        double l[3], f[3], dl[3][3] = { { 0 } };
+        for (int c = 0; c < 3; c++)
+        {
+            const int p = (c + 1) % 3, q = (c + 2) % 3;
+            const double I = m_inversive[3 * t + c];
+            if (euclidean)
+            {
+                const double l2 = r[p] * r[p] + r[q] * r[q] + 2 * r[p] * r[q] * I;
+                if (!(l2 > 0)) return false;
+                l[c] = f[c] = std::sqrt(l2);
+                dl[c][p] = r[p] * (r[p] + r[q] * I) / l[c];
+                dl[c][q] = r[q] * (r[q] + r[p] * I) / l[c];
+            }
+            else
+            {
+                // cosh l - 1, acosh loses half the digits of short sides
+                const double x = _cosh_product(r[p], r[q]) + std::sinh(r[p]) * std::sinh(r[q]) * I;
+                if (!(x > 0)) return false;
+                l[c] = 2 * std::asinh(std::sqrt(x / 2));
+                f[c] = std::sinh(l[c]);
+                dl[c][p] = dr[p] * (std::sinh(r[p]) * std::cosh(r[q]) + std::cosh(r[p]) * std::sinh(r[q]) * I) / f[c];
+                dl[c][q] = dr[q] * (std::sinh(r[q]) * std::cosh(r[p]) + std::cosh(r[q]) * std::sinh(r[p]) * I) / f[c];
+            }
+        }
+        for (int c = 0; c < 3; c++)
+            if (!(l[c] < l[(c + 1) % 3] + l[(c + 2) % 3])) return false;
+
+        double angle[3], cosine[3], sine[3];
+        for (int c = 0; c < 3; c++)
+        {
+            const int p = (c + 1) % 3, q = (c + 2) % 3;
+            const double x = euclidean ? (l[p] * l[p] + l[q] * l[q] - l[c] * l[c]) / (2 * l[p] * l[q])
+                : (_cosh_product(l[p], l[q]) - 2 * std::pow(std::sinh(l[c] / 2), 2)) / (f[p] * f[q]);
+            cosine[c] = std::max(-1.0, std::min(1.0, x));
+            angle[c] = std::acos(cosine[c]);
+            sine[c] = std::sin(angle[c]);
+            if (!(sine[c] > 0)) return false;
+        }
+        // d angle_c / d l_c = f(l_c) / (f(l_p) f(l_q) sin angle_c), d angle_c / d l_p = -that cos angle_q
+        for (int c = 0; c < 3; c++)
+        {
+            const int p = (c + 1) % 3, q = (c + 2) % 3;
+            const double d = f[c] / (f[p] * f[q] * sine[c]);
+            double dangle[3];
+            dangle[c] = d;
+            dangle[p] = -d * cosine[q];
+            dangle[q] = -d * cosine[p];
+            m_angle[3 * t + c] = angle[c];
+            m_length[3 * t + c] = l[c];
+            for (int b = 0; b < 3; b++)
+            {
+                double s = 0;
+                for (int side = 0; side < 3; side++) s += dangle[side] * dl[side][b];
+                m_jacobian[9 * t + 3 * c + b] = s;
+            }
+        }
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    bool CRicciFlow<M, Solver>::_evaluate(const std::vector<double> & u)
+    {
+        const size_t nt = m_tris.size() / 3;
+        const size_t n = m_curvature.size();
+        const int valid = parallel_reduce(nt, m_threads, 1, [&](size_t b, size_t e, int & ok)
+        {
+            for (size_t t = b; t < e && ok; t++) ok = _triangle(t, u);
+        }, [](int a, int b) { return a && b; }, 1 << 10);
+        if (!valid) return false;
+
+        // every row sums its corners, the Hessian symmetrized, it is so up to rounding
+        m_values.assign(laplacian().values().size(), 0.0);
+        parallel_for(n, m_threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                double sum = 0;
+                for (int k = m_corner_outer[i]; k < m_corner_outer[i + 1]; k++)
+                {
+                    const int c = m_corners[k], t = c / 3, a = c % 3;
+                    sum += m_angle[c];
+                    for (int j = 0; j < 3; j++)
+                        m_values[m_entries[3 * c + j]] += (m_jacobian[9 * t + 3 * a + j] + m_jacobian[9 * t + 3 * j + a]) / 2;
+                }
+                m_curvature[i] = (m_boundary[i] ? M_PI : 2 * M_PI) - sum;
+            }
+        });
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    double CRicciFlow<M, Solver>::_residual(const std::vector<char> & fixed, double & largest) const
+    {
+        double sum = 0;
+        largest = 0;
+        for (size_t i = 0; i < m_curvature.size(); i++)
+        {
+            if (fixed[i]) continue;
+            const double d = m_target[i] - m_curvature[i];
+            sum += d * d;
+            largest = std::max(largest, std::abs(d));
+        }
+        return std::sqrt(sum);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    bool CRicciFlow<M, Solver>::solve(double tolerance, int iterations)
+    {
+        m_solver.prepare();
+        _build();
+        _initialize();
+        const CLaplacian<M> & laplacian = m_solver.laplacian();
+        const size_t n = laplacian.size();
+        if (n == 0) return true;
+
+        std::vector<CVertex*> fixed = m_fixed;
+        if (fixed.empty() && m_geometry == EUCLIDEAN) fixed.push_back(laplacian.vertex(0));
+        std::vector<char> is_fixed(n, 0);
+        for (CVertex * v : fixed) is_fixed[laplacian.row(v)] = 1;
+        m_solver.set_fixed(fixed);
+
+        if (!_evaluate(m_u)) return false;
+        double residual = _residual(is_fixed, m_error);
+        std::vector<double> u(n);
+        Eigen::MatrixXd b((Eigen::Index)n, 1), du;
+        for (int it = 0; it < iterations && m_error > tolerance; it++)
+        {
+            // -L du = target - curvature, L the sum of the derivatives of the angles
+            for (size_t i = 0; i < n; i++) b(i, 0) = is_fixed[i] ? 0 : m_target[i] - m_curvature[i];
+            m_solver.set_values(m_values);
+            if (!m_solver.solve(b, du)) return false;
+
+            // halve the step until the triangles are valid and the residual decreases
+            bool moved = false;
+            for (double step = 1; step > 1e-8 && !moved; step /= 2)
+            {
+                for (size_t i = 0; i < n; i++) u[i] = m_u[i] + step * du(i, 0);
+                if (m_geometry == HYPERBOLIC)
+                {
+                    bool inside = true;
+                    for (size_t i = 0; i < n && inside; i++) inside = u[i] < 0;
+                    if (!inside) continue;
+                }
+                if (!_evaluate(u)) continue;
+                double largest;
+                const double next = _residual(is_fixed, largest);
+                if (next >= residual) continue;
+                m_u.swap(u);
+                residual = next;
+                m_error = largest;
+                moved = true;
+            }
+            if (!moved)
+            {
+                _evaluate(m_u);
+                return m_error <= tolerance;
+            }
+        }
+        return m_error <= tolerance;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    std::vector<double> CRicciFlow<M, Solver>::radii() const
+    {
+        std::vector<double> r(m_u.size());
+        for (size_t i = 0; i < r.size(); i++) r[i] = _radius(m_u[i]);
+        return r;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CRicciFlow<M, Solver>::layout()
+    {
+        const CLaplacian<M> & laplacian = m_solver.laplacian();
+        const size_t nt = m_faces.size();
+        const bool euclidean = m_geometry == EUCLIDEAN;
+        size_t slots = 0;
+        for (CFace * f : m_faces) slots = std::max(slots, f->property_index() + 1);
+        std::vector<int> tri(slots, -1);
+        for (size_t t = 0; t < nt; t++) tri[m_faces[t]->property_index()] = (int)t;
+
+        // o from a and b, the side ao and the angle at a, counterclockwise
+        auto place = [&](Complex a, Complex b, double length, double angle)
+        {
+            if (euclidean) return a + std::polar(length, std::arg(b - a) + angle);
+            CMobius to(a, 0);
+            const Complex d = to * b;
+            return inverse(to) * std::polar(std::tanh(length / 2), std::arg(d) + angle);
+        };
+        auto corner = [&](size_t t, CVertex * v)
+        {
+            const int r = laplacian.row(v);
+            return m_tris[3 * t] == r ? 0 : (m_tris[3 * t + 1] == r ? 1 : 2);
+        };
+
+        std::vector<Complex> position(m_tris.size());
+        std::vector<char> placed(nt, 0);
+        m_center.assign(laplacian.size(), Complex(0, 0));
+        std::vector<char> seen(laplacian.size(), 0);
+        std::deque<int> queue;
+        for (size_t seed = 0; seed < nt; seed++)
+        {
+            if (placed[seed]) continue;
+            // the first triangle of a component, corner 0 at the origin and corner 1 along the axis
+            const double l2 = m_length[3 * seed + 2];
+            position[3 * seed] = Complex(0, 0);
+            position[3 * seed + 1] = euclidean ? Complex(l2, 0) : Complex(std::tanh(l2 / 2), 0);
+            position[3 * seed + 2] = place(position[3 * seed], position[3 * seed + 1], m_length[3 * seed + 1], m_angle[3 * seed]);
+            placed[seed] = 1;
+            queue.push_back((int)seed);
+            while (!queue.empty())
+            {
+                const int t = queue.front();
+                queue.pop_front();
+                CHalfEdge * first = m_faces[t]->halfedge();
+                CHalfEdge * he = first;
+                do
+                {
+                    CHalfEdge * twin = he->dual();
+                    const int g = twin && twin->face() ? tri[twin->face()->property_index()] : -1;
+                    if (g >= 0 && !placed[g])
+                    {
+                        // the twin runs from a to b, the third corner o is to its left
+                        const int ca = corner(g, twin->source()), cb = corner(g, twin->target()), co = 3 - ca - cb;
+                        const Complex a = position[3 * t + corner(t, twin->source())];
+                        const Complex b = position[3 * t + corner(t, twin->target())];
+                        position[3 * g + ca] = a;
+                        position[3 * g + cb] = b;
+                        position[3 * g + co] = place(a, b, m_length[3 * g + cb], m_angle[3 * g + ca]);
+                        placed[g] = 1;
+                        queue.push_back(g);
+                    }
+                    he = he->next();
+                } while (he != first);
+            }
+        }
+
+        for (size_t c = 0; c < m_tris.size(); c++)
+        {
+            if (seen[m_tris[c]]) continue;
+            seen[m_tris[c]] = 1;
+            m_center[m_tris[c]] = position[c];
+        }
+
+        // into the unit square, the disk onto the disk inscribed in it
+        Complex origin(0, 0);
+        double scale = 1;
+        if (euclidean)
+        {
+            double lo[2] = { 1e300, 1e300 }, hi[2] = { -1e300, -1e300 };
+            for (const Complex & z : position)
+            {
+                lo[0] = std::min(lo[0], z.real());
+                lo[1] = std::min(lo[1], z.imag());
+                hi[0] = std::max(hi[0], z.real());
+                hi[1] = std::max(hi[1], z.imag());
+            }
+            const double extent = std::max(hi[0] - lo[0], hi[1] - lo[1]);
+            origin = Complex(lo[0], lo[1]);
+            scale = extent > 0 ? 1 / extent : 1;
+        }
+        else
+        {
+            origin = Complex(-1, -1);
+            scale = 0.5;
+        }
+        auto uv = [&](const Complex & z)
+        {
+            const Complex w = (z - origin) * scale;
+            return CPoint2(w.real(), w.imag());
+        };
+        for (size_t t = 0; t < nt; t++)
+        {
+            CHalfEdge * first = m_faces[t]->halfedge();
+            CHalfEdge * he = first;
+            do
+            {
+                he->uv() = uv(position[3 * t + corner(t, he->target())]);
+                he = he->next();
+            } while (he != first);
+        }
+        for (size_t i = 0; i < laplacian.size(); i++) laplacian.vertex(i)->uv() = uv(m_center[i]);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    CCircle CRicciFlow<M, Solver>::circle(CVertex * v) const
+    {
+        const int i = laplacian().row(v);
+        return CCircle(CPoint2(m_center[i].real(), m_center[i].imag()), _radius(m_u[i]));
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    CHyperbolicCircle CRicciFlow<M, Solver>::hyperbolic_circle(CVertex * v) const
+    {
+        const int i = laplacian().row(v);
+        return CHyperbolicCircle(CPoint2(m_center[i].real(), m_center[i].imag()), _radius(m_u[i]));
+    }
+
+}; //namespace
+
+#endif
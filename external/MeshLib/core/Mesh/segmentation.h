@@ -0,0 +1,589 @@
+/*!
+*      \file segmentation.h
+*      \brief Faces grouped into spatially compact patches
+*
+*      Meshlets, tiles and the parts a viewer streams all want faces grouped
+*      into small patches that are compact in space and turn little, so that
+*      a sphere and a cone bound each of them tightly. The faces are sorted
+*      along the Morton curve of their centers and cut into blocks of many
+*      patches, the blocks are grown on the threads at once. In a block a
+*      patch starts at the first free face on the curve and grows over the
+*      face rows of CAdjacency, or of any compressed rows, the face nearest
+*      to its centroid and closest to its axis first, while the normals stay
+*      within a cone around that of the seed, the centers within a radius of
+*      it and the patch below its size. Patches left much smaller than the
+*      others are then merged into a neighbour with room, and a few rounds of
+*      k-means may move the faces on the borders to the patch whose centroid
+*      and axis suit them better, a patch they cut apart split into pieces
+*      merged the same way. The result depends on the block size only,
+*      not on the number of threads. The patches are numbered along the curve
+*      and the faces listed patch by patch, in ranges a renderer draws or a
+*      cache writes as they are.
+*/
+
+#ifndef _MESHLIB_SEGMENTATION_H_
+#define _MESHLIB_SEGMENTATION_H_
+
+#include <vector>
+#include <queue>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "mesh.h"
+#include "adjacency.h"
+#include "../Geometry/MortonOrder.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CSegmentation class, faces grouped into compact patches of bounded size and spread
+     */
+    class CSegmentation
+    {
+    public:
+        //! faces of a patch at most
+        size_t max_faces = 128;
+        //! the least cosine between the normal of a face and that of the seed of its patch
+        double cone = 0.5;
+        //! the centers of the faces of a patch are at most this far from that of its seed, 0 for no limit
+        double max_radius = 0;
+        //! a patch with fewer faces than this fraction of max_faces is merged into a neighbour with room,
+        //! the patches grow to max_faces less as many, so that such a neighbour is near
+        double min_fill = 0.25;
+        //! rounds of k-means over the faces on the borders of the patches, none by default
+        int refine = 0;
+        //! patches grown per block, the blocks are what the threads share
+        static const size_t s_block_patches = 64;
+
+        /*!
+         *  Group the faces of compressed rows into patches
+         *  \param neighbors the rows of the faces across the edges of every face, see CAdjacency::face_faces
+         *  \param centers   the center of every face
+         *  \param normals   the unit normal of every face, zero for a face without one
+         *  \param areas     the area of every face, NULL weighs them all the same
+         *  \param radii     the distance from the center of a face to its farthest corner, NULL for none
+         *  \param threads   number of threads, 0 uses all hardware threads
+         *  \return number of patches
+         */
+        size_t segment(const CAdjacencyRows & neighbors, const CPoint * centers, const CPoint * normals,
+                       const double * areas = NULL, const double * radii = NULL, int threads = 0);
+
+        /*!
+         *  Group the face rows of adjacency into patches, laid out first if the mesh changed
+         *  \return number of patches
+         */
+        template<typename M>
+        size_t segment(CAdjacency<M> & adjacency, int threads = 0);
+
+        /*!
+         *  Group the triangles of an index buffer into patches, joined across the edges two of
+         *  them share, see triangle_neighbors
+         *  \param positions 3 floats per vertex
+         *  \param welded    if not NULL, the vertex the edges of vertex v join by, a vertex split at a seam
+         *                   say, the vertices themselves otherwise
+         *  \return number of patches
+         */
+        size_t segment_triangles(const uint32_t * indices, size_t triangles, const float * positions,
+                                 const uint32_t * welded = NULL, int threads = 0);
+
+        /*! the rows of the triangles across the edges of every triangle, edges of more than two left out */
+        static void triangle_neighbors(const uint32_t * indices, size_t triangles, CAdjacencyRows & rows,
+                                       const uint32_t * welded = NULL, int threads = 0);
+
+        /*! the patch of every face of the mesh is the face property name, -1 for a face added since */
+        template<typename M>
+        void label(M & mesh, const CAdjacency<M> & adjacency, const std::string & name = "patch") const;
+        /*! list the faces of the mesh patch by patch, so that CBaseMesh::write_smv writes them in ranges */
+        template<typename M>
+        void reorder(M & mesh, const CAdjacency<M> & adjacency) const;
+
+        /*! number of patches */
+        size_t size() const { return m_first.empty() ? 0 : m_first.size() - 1; }
+        /*! the patch of face j, numbered along the Morton curve */
+        int patch(size_t j) const { return m_label[j]; }
+        const std::vector<int> & labels() const { return m_label; }
+        /*! the faces patch by patch, along the curve in a patch, those of patch c at [first(c), first(c) + count(c)) */
+        const std::vector<int> & faces() const { return m_faces; }
+        size_t first(size_t c) const { return m_first[c]; }
+        size_t count(size_t c) const { return m_first[c + 1] - m_first[c]; }
+        /*! the sphere around patch c */
+        const CPoint & center(size_t c) const { return m_center[c]; }
+        double radius(size_t c) const { return m_radius[c]; }
+        /*! the unit axis of the cone of the normals of patch c, and the least cosine of a normal to it */
+        const CPoint & axis(size_t c) const { return m_axis[c]; }
+        double spread(size_t c) const { return m_spread[c]; }
+
+    protected:
+        std::vector<int> m_label;
+        std::vector<int> m_faces;
+        std::vector<size_t> m_first;
+        std::vector<CPoint> m_center;
+        std::vector<double> m_radius;
+        std::vector<CPoint> m_axis;
+        std::vector<double> m_spread;
+
+        /*! whether the unit normals a and b are within the cone, a zero one goes with anything */
+        bool _within(const CPoint & a, const CPoint & b) const
+        {
+            return a * a == 0 || b * b == 0 || a * b >= cone;
+        }
+        /*! grow the patches of the faces order[b, e), numbered from 0, the number of them */
+        int _grow(const CAdjacencyRows & neighbors, const CPoint * centers, const CPoint * normals, const double * areas,
+                  const std::vector<int> & order, const std::vector<int> & rank, size_t b, size_t e);
+        /*! the least faces of a patch left as it is */
+        size_t _small() const { return std::min((size_t)(std::max(min_fill, 0.0) * max_faces), max_faces / 2); }
+        /*! number the connected pieces of every patch apart, the number of them */
+        int _split(const CAdjacencyRows & neighbors);
+        /*! merge the patches below min_fill into neighbours with room, the number left */
+        int _merge(const CAdjacencyRows & neighbors, const CPoint * normals, const double * areas, int patches);
+        /*! a round of k-means over the faces on the borders, the number of faces moved */
+        size_t _refine(const CAdjacencyRows & neighbors, const CPoint * centers, const CPoint * normals, const double * areas,
+                       int patches, int threads);
+        /*! the area weighted centroids and unit axes of the patches of m_label */
+        void _centroids(const CPoint * centers, const CPoint * normals, const double * areas, int patches,
+                        std::vector<CPoint> & centroid, std::vector<CPoint> & axis) const;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline int CSegmentation::_grow(const CAdjacencyRows & neighbors, const CPoint * centers, const CPoint * normals, const double * areas,
+                                    const std::vector<int> & order, const std::vector<int> & rank, size_t b, size_t e)
+    {
+        typedef std::pair<double, int> CCandidate;
+        std::priority_queue<CCandidate, std::vector<CCandidate>, std::greater<CCandidate>> front;
+        // only the faces of the block are read or written, the other blocks grow meanwhile
+        std::vector<int> & label = m_label;
+        const size_t limit = std::max<size_t>(max_faces - _small(), 1);
+        int patches = 0;
+        for (size_t k = b; k < e; k++)
+        {
+            const int seed = order[k];
+            if (label[seed] >= 0) continue;
+            const int id = patches++;
+            CPoint reference = normals[seed], sum(0, 0, 0), turn(0, 0, 0);
+            double weight = 0;
+            size_t count = 0;
+            front = decltype(front)();
+            front.push(CCandidate(0.0, seed));
+            while (!front.empty() && count < limit)
+            {
+                const int f = front.top().second;
+                front.pop();
+                if (label[f] >= 0) continue;
+                if (f != seed && (!_within(normals[f], reference)
+                    || (max_radius > 0 && (centers[f] - centers[seed]).norm() > max_radius))) continue;
+                label[f] = id;
+                count++;
+                const double w = areas ? areas[f] : 1.0;
+                sum += centers[f] * w;
+                turn += normals[f] * w;
+                weight += w;
+                if (reference * reference == 0) reference = normals[f];
+
+                // the free faces of the block around, the nearer to the centroid and the axis the sooner
+                const CPoint centroid = weight > 0 ? sum / weight : centers[f];
+                const double l = turn.norm();
+                const CPoint axis = l > 0 ? turn / l : CPoint(0, 0, 0);
+                for (const int * g = neighbors.begin(f); g != neighbors.end(f); g++)
+                {
+                    if ((size_t)rank[*g] < b || (size_t)rank[*g] >= e || label[*g] >= 0) continue;
+                    front.push(CCandidate((centers[*g] - centroid).norm() * (2.0 - normals[*g] * axis), *g));
+                }
+            }
+        }
+        return patches;
+    }
+
+    inline void CSegmentation::_centroids(const CPoint * centers, const CPoint * normals, const double * areas, int patches,
+                                          std::vector<CPoint> & centroid, std::vector<CPoint> & axis) const
+    {
+        centroid.assign(patches, CPoint(0, 0, 0));
+        axis.assign(patches, CPoint(0, 0, 0));
+        std::vector<double> weight(patches, 0.0);
+        for (size_t f = 0; f < m_label.size(); f++)
+        {
+            const int p = m_label[f];
+            const double w = areas ? areas[f] : 1.0;
+            centroid[p] += centers[f] * w;
+            axis[p] += normals[f] * w;
+            weight[p] += w;
+        }
+        for (int p = 0; p < patches; p++)
+        {
+            if (weight[p] > 0) centroid[p] /= weight[p];
+            const double l = axis[p].norm();
+            if (l > 0) axis[p] /= l;
+        }
+    }
+
+    inline int CSegmentation::_split(const CAdjacencyRows & neighbors)
+    {
+        std::vector<int> piece(m_label.size(), -1), stack;
+        int pieces = 0;
+        for (size_t s = 0; s < m_label.size(); s++)
+        {
+            if (piece[s] >= 0) continue;
+            piece[s] = pieces;
+            stack.assign(1, (int)s);
+            while (!stack.empty())
+            {
+                const int f = stack.back();
+                stack.pop_back();
+                for (const int * g = neighbors.begin(f); g != neighbors.end(f); g++)
+                {
+                    if (piece[*g] >= 0 || m_label[*g] != m_label[f]) continue;
+                    piece[*g] = pieces;
+                    stack.push_back(*g);
+                }
+            }
+            pieces++;
+        }
+        m_label.swap(piece);
+        return pieces;
+    }
+
+    inline int CSegmentation::_merge(const CAdjacencyRows & neighbors, const CPoint * normals, const double * areas, int patches)
+    {
+        const size_t small = _small();
+        std::vector<size_t> size(patches, 0);
+        std::vector<CPoint> turn(patches, CPoint(0, 0, 0));
+        for (size_t f = 0; f < m_label.size(); f++)
+        {
+            size[m_label[f]]++;
+            turn[m_label[f]] += normals[f] * (areas ? areas[f] : 1.0);
+        }
+        // the faces of every patch, to find its neighbours
+        std::vector<size_t> first(patches + 1, 0);
+        for (int p : m_label) first[p + 1]++;
+        for (int p = 0; p < patches; p++) first[p + 1] += first[p];
+        std::vector<int> faces(m_label.size());
+        {
+            std::vector<size_t> fill(first.begin(), first.end() - 1);
+            for (size_t f = 0; f < m_label.size(); f++) faces[fill[m_label[f]]++] = (int)f;
+        }
+        std::vector<int> into(patches);
+        for (int p = 0; p < patches; p++) into[p] = p;
+        auto find = [&](int p)
+        {
+            while (into[p] != p) p = into[p] = into[into[p]];
+            return p;
+        };
+
+        int left = patches;
+        for (int p = 0; p < patches; p++)
+        {
+            if (size[p] == 0 || size[p] >= small) continue;
+            // the smallest neighbour with room whose axis is within the cone
+            const double lp = turn[p].norm();
+            const CPoint ap = lp > 0 ? turn[p] / lp : CPoint(0, 0, 0);
+            int best = -1;
+            for (size_t k = first[p]; k < first[p + 1]; k++)
+                for (const int * g = neighbors.begin(faces[k]); g != neighbors.end(faces[k]); g++)
+                {
+                    const int q = find(m_label[*g]);
+                    if (q == p || size[q] + size[p] > max_faces) continue;
+                    const double lq = turn[q].norm();
+                    if (!_within(ap, lq > 0 ? turn[q] / lq : CPoint(0, 0, 0))) continue;
+                    if (best < 0 || size[q] < size[best] || (size[q] == size[best] && q < best)) best = q;
+                }
+            if (best < 0) continue;
+            into[p] = best;
+            size[best] += size[p];
+            turn[best] += turn[p];
+            size[p] = 0;
+            left--;
+        }
+        for (int & l : m_label) l = find(l);
+        return left;
+    }
+
+    inline size_t CSegmentation::_refine(const CAdjacencyRows & neighbors, const CPoint * centers, const CPoint * normals, const double * areas,
+                                         int patches, int threads)
+    {
+        std::vector<CPoint> centroid, axis;
+        _centroids(centers, normals, areas, patches, centroid, axis);
+        std::vector<size_t> size(patches, 0);
+        for (int p : m_label) size[p]++;
+
+        // every face at once against the centroids of the last round, its own patch wins a tie
+        const size_t n = m_label.size();
+        std::vector<int> moved(m_label);
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t f = b; f < e; f++)
+            {
+                const int own = m_label[f];
+                auto cost = [&](int p)
+                {
+                    const CPoint d = centers[f] - centroid[p];
+                    return (d * d) * (2.0 - normals[f] * axis[p]);
+                };
+                double best = cost(own);
+                for (const int * g = neighbors.begin(f); g != neighbors.end(f); g++)
+                {
+                    const int p = m_label[*g];
+                    if (p == own || !_within(normals[f], axis[p])) continue;
+                    if (max_radius > 0 && (centers[f] - centroid[p]).norm() > max_radius) continue;
+                    const double c = cost(p);
+                    if (c < best)
+                    {
+                        best = c;
+                        moved[f] = p;
+                    }
+                }
+            }
+        }, 1024);
+
+        // the moves into a patch they would overfill are undone, and those out of a patch they would empty
+        std::vector<size_t> in(patches, 0), out(patches, 0);
+        for (size_t f = 0; f < n; f++)
+        {
+            if (moved[f] == m_label[f]) continue;
+            in[moved[f]]++;
+            out[m_label[f]]++;
+        }
+        size_t count = 0;
+        for (size_t f = 0; f < n; f++)
+        {
+            const int p = m_label[f], q = moved[f];
+            if (q == p || size[q] + in[q] > max_faces || out[p] >= size[p]) continue;
+            m_label[f] = q;
+            count++;
+        }
+        return count;
+    }
+
+    inline size_t CSegmentation::segment(const CAdjacencyRows & neighbors, const CPoint * centers, const CPoint * normals,
+                                         const double * areas, const double * radii, int threads)
+    {
+        MESHLIB_TRACE_ZONE("segmentation.segment");
+        const size_t n = neighbors.size();
+        m_label.assign(n, -1);
+        m_faces.clear();
+        m_first.assign(1, 0);
+        m_center.clear();
+        m_radius.clear();
+        m_axis.clear();
+        m_spread.clear();
+        if (n == 0) return 0;
+
+        // the faces along the curve, cut into blocks grown apart
+        std::vector<int> order, rank(n);
+        CMortonOrder::sort(centers, n, order, threads);
+        for (size_t k = 0; k < n; k++) rank[order[k]] = (int)k;
+        const size_t block = std::max<size_t>(max_faces, 1) * s_block_patches;
+        const size_t blocks = (n + block - 1) / block;
+        std::vector<int> grown(blocks + 1, 0);
+        parallel_for(blocks, threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++) grown[k + 1] = _grow(neighbors, centers, normals, areas, order, rank, k * block, std::min(n, (k + 1) * block));
+        }, 1);
+        for (size_t k = 0; k < blocks; k++) grown[k + 1] += grown[k];
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t f = b; f < e; f++) m_label[f] += grown[rank[f] / block];
+        });
+        int patches = grown[blocks];
+
+        // numbered again along the curve after every pass that drops patches
+        auto renumber = [&]()
+        {
+            std::vector<int> number(patches, -1);
+            int next = 0;
+            for (int f : order)
+                if (number[m_label[f]] < 0) number[m_label[f]] = next++;
+            for (int & l : m_label) l = number[l];
+            patches = next;
+        };
+        if (min_fill > 0)
+        {
+            _merge(neighbors, normals, areas, patches);
+            renumber();
+        }
+        for (int r = 0; r < refine; r++)
+        {
+            if (_refine(neighbors, centers, normals, areas, patches, threads) == 0) break;
+            renumber();
+        }
+        // the moves may have cut a patch in two, its pieces are patches of their own and merged again
+        if (refine > 0)
+        {
+            patches = _split(neighbors);
+            if (min_fill > 0) _merge(neighbors, normals, areas, patches);
+            renumber();
+        }
+
+        // the faces patch by patch, along the curve in each
+        m_first.assign(patches + 1, 0);
+        for (int l : m_label) m_first[l + 1]++;
+        for (int p = 0; p < patches; p++) m_first[p + 1] += m_first[p];
+        m_faces.resize(n);
+        {
+            std::vector<size_t> fill(m_first.begin(), m_first.end() - 1);
+            for (int f : order) m_faces[fill[m_label[f]]++] = f;
+        }
+
+        // the bounds
+        std::vector<CPoint> centroid;
+        _centroids(centers, normals, areas, patches, centroid, m_axis);
+        m_center.swap(centroid);
+        m_radius.assign(patches, 0.0);
+        m_spread.assign(patches, 1.0);
+        parallel_for((size_t)patches, threads, [&](size_t b, size_t e)
+        {
+            for (size_t p = b; p < e; p++)
+                for (size_t k = m_first[p]; k < m_first[p + 1]; k++)
+                {
+                    const int f = m_faces[k];
+                    m_radius[p] = std::max(m_radius[p], (centers[f] - m_center[p]).norm() + (radii ? radii[f] : 0.0));
+                    if (normals[f] * normals[f] > 0 && m_axis[p] * m_axis[p] > 0) m_spread[p] = std::min(m_spread[p], normals[f] * m_axis[p]);
+                }
+        }, 64);
+        MESHLIB_COUNTER_ADD("segmentation.patches", patches);
+        return (size_t)patches;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CSegmentation::triangle_neighbors(const uint32_t * indices, size_t triangles, CAdjacencyRows & rows,
+                                                  const uint32_t * welded, int threads)
+    {
+        // the edges by their ends, the lower first, the triangles sharing one next to each other
+        struct CEdgeKey
+        {
+            uint32_t a, b, t;
+            bool operator<(const CEdgeKey & o) const { return a != o.a ? a < o.a : b != o.b ? b < o.b : t < o.t; }
+        };
+        std::vector<CEdgeKey> edges(3 * triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t u = indices[3 * t + k], v = indices[3 * t + (k + 1) % 3];
+                    if (welded)
+                    {
+                        u = welded[u];
+                        v = welded[v];
+                    }
+                    edges[3 * t + k] = CEdgeKey{ std::min(u, v), std::max(u, v), (uint32_t)t };
+                }
+        });
+        std::sort(edges.begin(), edges.end());
+
+        rows.outer.assign(triangles + 1, 0);
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j].a == edges[i].a && edges[j].b == edges[i].b) j++;
+            if (j == i + 2 && edges[i].a != edges[i].b && edges[i].t != edges[i + 1].t)
+            {
+                pairs.push_back(std::make_pair(edges[i].t, edges[i + 1].t));
+                rows.outer[edges[i].t + 1]++;
+                rows.outer[edges[i + 1].t + 1]++;
+            }
+            i = j;
+        }
+        for (size_t t = 0; t < triangles; t++) rows.outer[t + 1] += rows.outer[t];
+        rows.inner.resize(rows.outer[triangles]);
+        std::vector<int> fill(rows.outer.begin(), rows.outer.end() - 1);
+        for (const std::pair<uint32_t, uint32_t> & p : pairs)
+        {
+            rows.inner[fill[p.first]++] = (int)p.second;
+            rows.inner[fill[p.second]++] = (int)p.first;
+        }
+    }
+
+    inline size_t CSegmentation::segment_triangles(const uint32_t * indices, size_t triangles, const float * positions,
+                                                   const uint32_t * welded, int threads)
+    {
+        CAdjacencyRows rows;
+        triangle_neighbors(indices, triangles, rows, welded, threads);
+        std::vector<CPoint> centers(triangles), normals(triangles);
+        std::vector<double> areas(triangles), radii(triangles);
+        parallel_for(triangles, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                CPoint p[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    const float * q = positions + 3 * indices[3 * t + k];
+                    p[k] = CPoint(q[0], q[1], q[2]);
+                }
+                centers[t] = (p[0] + p[1] + p[2]) / 3.0;
+                const CPoint n = (p[1] - p[0]) ^ (p[2] - p[0]);
+                const double l = n.norm();
+                normals[t] = l > 0 ? n / l : CPoint(0, 0, 0);
+                areas[t] = l / 2;
+                radii[t] = std::max((p[0] - centers[t]).norm(), std::max((p[1] - centers[t]).norm(), (p[2] - centers[t]).norm()));
+            }
+        });
+        return segment(rows, centers.data(), normals.data(), areas.data(), radii.data(), threads);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    size_t CSegmentation::segment(CAdjacency<M> & adjacency, int threads)
+    {
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+        adjacency.update(threads);
+        const size_t nf = adjacency.num_faces();
+        std::vector<CPoint> centers(nf), normals(nf);
+        std::vector<double> areas(nf), radii(nf);
+        parallel_for(nf, threads, [&](size_t b, size_t e)
+        {
+            for (size_t j = b; j < e; j++)
+            {
+                CFace * f = adjacency.face(j);
+                CPoint c(0, 0, 0), n(0, 0, 0);
+                int k = 0;
+                for (CHalfEdge * he : f->halfedges_range())
+                {
+                    c += he->vertex()->point();
+                    k++;
+                }
+                c /= (double)std::max(k, 1);
+                // the sum of the fans around the center, the area vector of a polygon that need not be flat
+                double r = 0;
+                for (CHalfEdge * he : f->halfedges_range())
+                {
+                    n += (he->source()->point() - c) ^ (he->vertex()->point() - c);
+                    r = std::max(r, (he->vertex()->point() - c).norm());
+                }
+                const double l = n.norm();
+                centers[j] = c;
+                normals[j] = l > 0 ? n / l : CPoint(0, 0, 0);
+                areas[j] = l / 2;
+                radii[j] = r;
+            }
+        });
+        return segment(adjacency.face_faces(), centers.data(), normals.data(), areas.data(), radii.data(), threads);
+    }
+
+    template<typename M>
+    void CSegmentation::label(M & mesh, const CAdjacency<M> & adjacency, const std::string & name) const
+    {
+        CProperty<int> & patch = mesh.template add_face_property<int>(name, -1);
+        for (size_t j = 0; j < m_label.size(); j++) patch[adjacency.face(j)] = m_label[j];
+    }
+
+    template<typename M>
+    void CSegmentation::reorder(M & mesh, const CAdjacency<M> & adjacency) const
+    {
+        using CFace = typename M::CFace;
+        std::vector<CFace*> faces(m_faces.size());
+        for (size_t k = 0; k < m_faces.size(); k++) faces[k] = adjacency.face(m_faces[k]);
+        mesh.faces().assign(faces);
+    }
+
+}; //namespace
+
+#endif
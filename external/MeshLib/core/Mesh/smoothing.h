@@ -0,0 +1,333 @@
+/*!
+*      \file smoothing.h
+*      \brief Laplacian, Taubin and implicit smoothing of the points of a mesh
+*
+*      The explicit steps move every point towards the weighted mean of its
+*      neighbors, reading the points of the last step from one buffer and
+*      writing the next to another, so the rows are independent and run in
+*      parallel, and the result does not depend on the order of the
+*      vertices. The buffers hold x, y and z in separate arrays and the
+*      weights are normalized by row once, so a step is a multiply-add per
+*      neighbor and coordinate. The implicit step solves (M - s L) p' = M p
+*      by CPoissonSolver, factored once for all its steps.
+*/
+
+#ifndef _MESHLIB_SMOOTHING_H_
+#define _MESHLIB_SMOOTHING_H_
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "laplacian.h"
+
+#ifdef MESHLIB_EIGEN
+#include "poisson.h"
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CSmoother class, smooths the points of a mesh in place
+     *
+     *  Boundary vertices stay by default. With a feature angle, an edge whose
+     *  faces meet at a larger angle is a feature edge, a vertex on two of them
+     *  moves along them only, and a vertex on one or more than two stays.
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CSmoother
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+        typedef typename CLaplacian<M>::Weights Weights;
+
+        CSmoother(M & mesh, int threads = 0) : m_mesh(mesh), m_threads(threads), m_laplacian(mesh) {}
+
+        /*! the weights of the neighbors, UNIFORM by default */
+        void set_weights(Weights weights) { m_weights = weights; }
+        /*! whether boundary vertices stay, true by default */
+        void set_fixed_boundary(bool fixed) { m_fixed_boundary = fixed; }
+        /*! the dihedral angle of the feature edges in radians, 0 turns features off, the default */
+        void set_feature_angle(double angle) { m_feature_angle = angle; }
+
+        /*!
+         *  Move every point lambda of the way to the mean of its neighbors, iterations times
+         *  \param lambda in (0, 1]
+         */
+        void laplacian(int iterations, double lambda = 0.5);
+        /*!
+         *  Taubin's smoothing, a step by lambda and a step back by mu per iteration, which keeps the volume
+         *  \param mu negative, of a larger magnitude than lambda
+         */
+        void taubin(int iterations, double lambda = 0.5, double mu = -0.53);
+
+#ifdef MESHLIB_EIGEN
+        /*!
+         *  Implicit fairing, iterations backward Euler steps of the heat flow of the points, the
+         *  operator is that of the points at the first step, feature vertices stay. It is the
+         *  cotangent Laplacian whatever the weights, uniform ones do not scale with the mass
+         *  \param step time of a step, in units of the squared mean edge length
+         *  \return false if the system cannot be solved
+         */
+        bool implicit(int iterations, double step = 1);
+#endif
+
+    protected:
+        M & m_mesh;
+        int m_threads;
+        CLaplacian<M> m_laplacian;
+        Weights m_weights = CLaplacian<M>::UNIFORM;
+        bool m_fixed_boundary = true;
+        double m_feature_angle = 0;
+        size_t m_version = 0;
+
+        //! the weight of every entry of L over the sum of its row, 0 on the diagonal and in rows that stay
+        std::vector<double> m_normalized;
+        //! whether every row moves freely, 0 if it stays or moves along features only
+        std::vector<char> m_free;
+        //! the points, x, y and z apart, of the last step and of the next
+        std::vector<double> m_buffer[2][3];
+
+        /*! lay out L for the connectivity, read the points and the weights of the rows */
+        void _prepare();
+        /*! the rows of the ends of the feature edges, and the count of them at every row */
+        void _features(std::vector<std::pair<int, int>> & edges, std::vector<int> & count) const;
+        /*! one explicit step by factor, from buffer 0 to buffer 1, then swap them */
+        void _step(double factor);
+        /*! write buffer 0 to the points */
+        void _store();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSmoother<M>::_features(std::vector<std::pair<int, int>> & edges, std::vector<int> & count) const
+    {
+        edges.clear();
+        count.assign(m_laplacian.size(), 0);
+        if (m_feature_angle <= 0) return;
+        auto normal = [](CFace * f)
+        {
+            CHalfEdge * he = f->halfedge();
+            const CPoint & a = he->source()->point();
+            return (he->target()->point() - a) ^ (he->next()->target()->point() - a);
+        };
+        const double threshold = cos(m_feature_angle);
+        for (CEdge * e : m_mesh.edges())
+        {
+            CHalfEdge * h0 = e->halfedge(0);
+            CHalfEdge * h1 = e->halfedge(1);
+            if (h1 == NULL) continue;
+            const CPoint n0 = normal(h0->face()), n1 = normal(h1->face());
+            const double l = n0.norm() * n1.norm();
+            if (l <= 0 || (n0 * n1) / l >= threshold) continue;
+            const int i = m_laplacian.row(h0->source()), j = m_laplacian.row(h0->target());
+            edges.push_back(std::make_pair(i, j));
+            count[i]++;
+            count[j]++;
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSmoother<M>::_prepare()
+    {
+        if (m_laplacian.size() == 0 || m_version != m_mesh.topology_version())
+        {
+            m_laplacian.build(m_threads);
+            m_version = m_mesh.topology_version();
+        }
+        m_laplacian.assemble(m_weights, m_threads);
+        const size_t n = m_laplacian.size();
+        const std::vector<int> & outer = m_laplacian.outer();
+        const std::vector<int> & inner = m_laplacian.inner();
+        const std::vector<double> & values = m_laplacian.values();
+
+        for (int b = 0; b < 2; b++)
+            for (int k = 0; k < 3; k++) m_buffer[b][k].resize(n);
+        m_free.assign(n, 1);
+        parallel_for(n, m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t i = s; i < e; i++)
+            {
+                CVertex * v = m_laplacian.vertex(i);
+                for (int k = 0; k < 3; k++) m_buffer[0][k][i] = v->point()[k];
+                if (m_fixed_boundary && v->boundary()) m_free[i] = 0;
+            }
+        });
+
+        // a vertex on two feature edges keeps the weights of those, any other on features stays
+        std::vector<std::pair<int, int>> features;
+        std::vector<int> count;
+        _features(features, count);
+        std::vector<char> along(n, 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            if (count[i] == 0) continue;
+            if (count[i] == 2 && m_free[i]) along[i] = 1;
+            m_free[i] = 0;
+        }
+        auto entry = [&](int i, int j)
+        {
+            return (int)(std::lower_bound(inner.begin() + outer[i], inner.begin() + outer[i + 1], j) - inner.begin());
+        };
+
+        m_normalized.assign(values.size(), 0.0);
+        for (const std::pair<int, int> & f : features)
+        {
+            if (along[f.first]) m_normalized[entry(f.first, f.second)] = 1;
+            if (along[f.second]) m_normalized[entry(f.second, f.first)] = 1;
+        }
+        parallel_for(n, m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t i = s; i < e; i++)
+            {
+                double sum = 0;
+                if (m_free[i])
+                {
+                    for (int k = outer[i]; k < outer[i + 1]; k++)
+                        if (inner[k] != (int)i) sum += m_normalized[k] = values[k];
+                    // negative cotangents may cancel, the row falls back to uniform weights
+                    if (sum <= 0)
+                    {
+                        sum = 0;
+                        for (int k = outer[i]; k < outer[i + 1]; k++)
+                            if (inner[k] != (int)i) sum += m_normalized[k] = 1;
+                    }
+                }
+                else
+                {
+                    for (int k = outer[i]; k < outer[i + 1]; k++) sum += m_normalized[k];
+                }
+                if (sum <= 0) continue;
+                for (int k = outer[i]; k < outer[i + 1]; k++) m_normalized[k] /= sum;
+            }
+        });
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSmoother<M>::_step(double factor)
+    {
+        const std::vector<int> & outer = m_laplacian.outer();
+        const std::vector<int> & inner = m_laplacian.inner();
+        const double * w = m_normalized.data();
+        const int * col = inner.data();
+        const double * x = m_buffer[0][0].data(), * y = m_buffer[0][1].data(), * z = m_buffer[0][2].data();
+        double * nx = m_buffer[1][0].data(), * ny = m_buffer[1][1].data(), * nz = m_buffer[1][2].data();
+        parallel_for(m_laplacian.size(), m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t i = s; i < e; i++)
+            {
+                // the diagonal weighs 0, rows that stay have no weight at all
+                double mx = 0, my = 0, mz = 0, sum = 0;
+                for (int k = outer[i]; k < outer[i + 1]; k++)
+                {
+                    const int j = col[k];
+                    mx += w[k] * x[j];
+                    my += w[k] * y[j];
+                    mz += w[k] * z[j];
+                    sum += w[k];
+                }
+                const double f = sum > 0 ? factor : 0;
+                nx[i] = x[i] + f * (mx - x[i]);
+                ny[i] = y[i] + f * (my - y[i]);
+                nz[i] = z[i] + f * (mz - z[i]);
+            }
+        });
+        for (int k = 0; k < 3; k++) m_buffer[0][k].swap(m_buffer[1][k]);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSmoother<M>::_store()
+    {
+        parallel_for(m_laplacian.size(), m_threads, [&](size_t s, size_t e)
+        {
+            for (size_t i = s; i < e; i++)
+                m_laplacian.vertex(i)->point() = CPoint(m_buffer[0][0][i], m_buffer[0][1][i], m_buffer[0][2][i]);
+        });
+        m_mesh.touch_points();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSmoother<M>::laplacian(int iterations, double lambda)
+    {
+        _prepare();
+        for (int it = 0; it < iterations; it++) _step(lambda);
+        _store();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSmoother<M>::taubin(int iterations, double lambda, double mu)
+    {
+        _prepare();
+        for (int it = 0; it < iterations; it++)
+        {
+            _step(lambda);
+            _step(mu);
+        }
+        _store();
+    }
+
+#ifdef MESHLIB_EIGEN
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    bool CSmoother<M>::implicit(int iterations, double step)
+    {
+        _prepare();
+        const size_t n = m_laplacian.size();
+
+        // the rows that do not move freely are fixed
+        std::vector<CVertex*> fixed;
+        for (size_t i = 0; i < n; i++)
+            if (!m_free[i]) fixed.push_back(m_laplacian.vertex(i));
+        double h = 0;
+        size_t edges = 0;
+        const std::vector<int> & outer = m_laplacian.outer();
+        const std::vector<int> & inner = m_laplacian.inner();
+        for (size_t i = 0; i < n; i++)
+        {
+            for (int k = outer[i]; k < outer[i + 1]; k++)
+            {
+                const int j = inner[k];
+                if (j <= (int)i) continue;
+                h += std::sqrt(std::pow(m_buffer[0][0][j] - m_buffer[0][0][i], 2) + std::pow(m_buffer[0][1][j] - m_buffer[0][1][i], 2) +
+                    std::pow(m_buffer[0][2][j] - m_buffer[0][2][i], 2));
+                edges++;
+            }
+        }
+        if (edges == 0) return true;
+        h /= edges;
+
+        // (M / s - L) p' = M p / s, the rows of the solver are those of m_laplacian, laid out alike
+        CPoissonSolver<M> solver(m_mesh, CLaplacian<M>::COTANGENT, m_threads);
+        const double shift = 1 / (step * h * h);
+        solver.set_fixed(fixed);
+        solver.set_shift(shift);
+        const std::vector<double> & mass = m_laplacian.mass();
+        Eigen::MatrixXd b((Eigen::Index)n, 3), x((Eigen::Index)n, 3);
+        for (size_t i = 0; i < n; i++)
+            for (int k = 0; k < 3; k++) x(i, k) = m_buffer[0][k][i];
+        for (int it = 0; it < iterations; it++)
+        {
+            for (size_t i = 0; i < n; i++)
+                for (int k = 0; k < 3; k++) b(i, k) = m_free[i] ? shift * mass[i] * x(i, k) : x(i, k);
+            if (!solver.solve(b, x)) return false;
+        }
+        for (size_t i = 0; i < n; i++)
+            for (int k = 0; k < 3; k++) m_buffer[0][k][i] = x(i, k);
+        _store();
+        return true;
+    }
+#endif
+
+}; //namespace
+
+#endif
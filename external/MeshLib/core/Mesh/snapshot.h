@@ -0,0 +1,225 @@
+/*!
+*      \file snapshot.h
+*      \brief Copy on write snapshots of a CDynamicMesh for threads reading it during edits
+*
+*      A renderer or an analysis that reads a mesh while another thread edits
+*      it, a decimation say, needs a state of the mesh that does not change
+*      under it. Copying the whole mesh for every such state costs as much as
+*      the mesh. Here the points and the triangles are laid out by slot,
+*      property_index(), in chunks of s_chunk slots, and a snapshot is a list
+*      of shared chunks that never change once published. The editing thread
+*      copies only the chunks its edits touched, see CDynamicMesh::trackChanges,
+*      and publishes a new list with them, so a snapshot costs one pointer per
+*      chunk and its copied chunks. A reader takes the latest snapshot at any
+*      time without waiting for the editor, and keeps it, and the chunks it
+*      shares with later ones, for as long as it holds it.
+*/
+
+#ifndef _MESHLIB_SNAPSHOT_H_
+#define _MESHLIB_SNAPSHOT_H_
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+#include "../Geometry/Point.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshSnapshot class, the points and triangles of a mesh at one time, by slot
+     */
+    class CMeshSnapshot
+    {
+    public:
+        //! slots per chunk
+        static const size_t s_chunk = 1 << 12;
+
+        /*! one past the highest vertex and face slot */
+        size_t vertex_slots() const { return m_vertex_slots; }
+        size_t face_slots() const { return m_face_slots; }
+        /*! number of vertices and faces */
+        size_t num_vertices() const { return m_num_vertices; }
+        size_t num_faces() const { return m_num_faces; }
+
+        /*! whether a vertex is in the slot */
+        bool has_vertex(size_t slot) const { return _vertices(slot).used[slot % s_chunk] != 0; }
+        /*! the point of the vertex in the slot */
+        const CPoint & point(size_t slot) const { return _vertices(slot).points[slot % s_chunk]; }
+        /*! whether a face is in the slot */
+        bool has_face(size_t slot) const { return face(slot)[0] >= 0; }
+        /*! the vertex slots of the corners of the face in the slot, -1 for a free slot */
+        const int * face(size_t slot) const { return &_faces(slot).corners[3 * (slot % s_chunk)]; }
+
+        /*! CBaseMesh::topology_version() and geometry_version() of the mesh at publish */
+        size_t topology_version() const { return m_topology_version; }
+        size_t geometry_version() const { return m_geometry_version; }
+
+    protected:
+        template<typename M> friend class CMeshSnapshots;
+
+        struct CVertexChunk
+        {
+            std::vector<CPoint> points;
+            std::vector<char>   used;
+        };
+        struct CFaceChunk
+        {
+            std::vector<int> corners;
+        };
+
+        const CVertexChunk & _vertices(size_t slot) const { return *m_vertex_chunks[slot / s_chunk]; }
+        const CFaceChunk & _faces(size_t slot) const { return *m_face_chunks[slot / s_chunk]; }
+
+        std::vector<std::shared_ptr<const CVertexChunk>> m_vertex_chunks;
+        std::vector<std::shared_ptr<const CFaceChunk>>   m_face_chunks;
+        size_t m_vertex_slots = 0, m_face_slots = 0;
+        size_t m_num_vertices = 0, m_num_faces = 0;
+        size_t m_topology_version = 0, m_geometry_version = 0;
+    };
+
+    /*!
+     *  \brief CMeshSnapshots class, publishes snapshots of a CDynamicMesh as it is edited
+     *
+     *  Only the editing thread calls the constructor and publish(), any thread snapshot().
+     *  \tparam M a CDynamicMesh of triangles
+     */
+    template<typename M>
+    class CMeshSnapshots
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+        using CRanges = std::vector<std::pair<size_t, size_t>>;
+
+        /*!
+         *  Lay out every slot of mesh and publish it, the slots are tracked from now on, see
+         *  CDynamicMesh::trackChanges
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        CMeshSnapshots(M & mesh, int threads = 0);
+
+        /*!
+         *  Copy the chunks of the slots the edits touched since the last publish and publish them
+         *  \param vertices, faces the slots of CDynamicMesh::takeChanges, for a caller that also uses them
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void publish(const CRanges & vertices, const CRanges & faces, int threads = 0);
+        /*! publish the changes, for a mesh whose changes no one else takes */
+        void publish(int threads = 0)
+        {
+            m_mesh.takeChanges(m_vertex_ranges, m_face_ranges);
+            publish(m_vertex_ranges, m_face_ranges, threads);
+        }
+
+        /*! the last snapshot published, it stays as it is */
+        std::shared_ptr<const CMeshSnapshot> snapshot() const { return std::atomic_load(&m_published); }
+
+    protected:
+        M & m_mesh;
+        std::shared_ptr<const CMeshSnapshot> m_published;
+        CRanges m_vertex_ranges, m_face_ranges;
+
+        /*! the chunks of the ranges, in order */
+        static void _chunks(const CRanges & ranges, size_t slots, std::vector<size_t> & chunks);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    CMeshSnapshots<M>::CMeshSnapshots(M & mesh, int threads) : m_mesh(mesh)
+    {
+        m_mesh.trackChanges(true);
+        m_published = std::make_shared<CMeshSnapshot>();
+        const CRanges vertices(1, std::make_pair((size_t)0, m_mesh.vertexSlots()));
+        const CRanges faces(1, std::make_pair((size_t)0, m_mesh.faceSlots()));
+        publish(vertices, faces, threads);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CMeshSnapshots<M>::_chunks(const CRanges & ranges, size_t slots, std::vector<size_t> & chunks)
+    {
+        chunks.clear();
+        for (const std::pair<size_t, size_t> & r : ranges)
+        {
+            const size_t last = std::min(r.second, slots);
+            for (size_t c = r.first / CMeshSnapshot::s_chunk; c * CMeshSnapshot::s_chunk < last; c++)
+                if (chunks.empty() || chunks.back() < c) chunks.push_back(c);
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CMeshSnapshots<M>::publish(const CRanges & vertices, const CRanges & faces, int threads)
+    {
+        using CVertexChunk = CMeshSnapshot::CVertexChunk;
+        using CFaceChunk = CMeshSnapshot::CFaceChunk;
+        const size_t S = CMeshSnapshot::s_chunk;
+
+        // the chunks the later snapshot does not share, the new ones past the old slots among them
+        std::shared_ptr<CMeshSnapshot> next = std::make_shared<CMeshSnapshot>(*m_published);
+        next->m_vertex_slots = m_mesh.vertexSlots();
+        next->m_face_slots = m_mesh.faceSlots();
+        next->m_vertex_chunks.resize((next->m_vertex_slots + S - 1) / S);
+        next->m_face_chunks.resize((next->m_face_slots + S - 1) / S);
+        std::vector<size_t> vchunks, fchunks;
+        _chunks(vertices, next->m_vertex_slots, vchunks);
+        _chunks(faces, next->m_face_slots, fchunks);
+        for (size_t c = m_published->m_vertex_chunks.size(); c < next->m_vertex_chunks.size(); c++)
+            if (!std::binary_search(vchunks.begin(), vchunks.end(), c)) vchunks.insert(std::upper_bound(vchunks.begin(), vchunks.end(), c), c);
+        for (size_t c = m_published->m_face_chunks.size(); c < next->m_face_chunks.size(); c++)
+            if (!std::binary_search(fchunks.begin(), fchunks.end(), c)) fchunks.insert(std::upper_bound(fchunks.begin(), fchunks.end(), c), c);
+
+        // a chunk is laid out again from the mesh as a whole, its untouched slots are equal anyway
+        parallel_for(vchunks.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                std::shared_ptr<CVertexChunk> chunk = std::make_shared<CVertexChunk>();
+                chunk->points.assign(S, CPoint(0, 0, 0));
+                chunk->used.assign(S, 0);
+                for (size_t i = 0; i < S; i++)
+                {
+                    CVertex * v = m_mesh.vertexAt(vchunks[k] * S + i);
+                    if (!v) continue;
+                    chunk->points[i] = v->point();
+                    chunk->used[i] = 1;
+                }
+                next->m_vertex_chunks[vchunks[k]] = chunk;
+            }
+        }, 1);
+        parallel_for(fchunks.size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t k = b; k < e; k++)
+            {
+                std::shared_ptr<CFaceChunk> chunk = std::make_shared<CFaceChunk>();
+                chunk->corners.assign(3 * S, -1);
+                for (size_t i = 0; i < S; i++)
+                {
+                    CFace * f = m_mesh.faceAt(fchunks[k] * S + i);
+                    if (!f) continue;
+                    int j = 0;
+                    for (CHalfEdge * he : f->halfedges_range())
+                        if (j < 3) chunk->corners[3 * i + j++] = (int)he->vertex()->property_index();
+                }
+                next->m_face_chunks[fchunks[k]] = chunk;
+            }
+        }, 1);
+        MESHLIB_COUNTER_ADD("snapshot.chunks_copied", vchunks.size() + fchunks.size());
+
+        next->m_num_vertices = m_mesh.vertices().size();
+        next->m_num_faces = m_mesh.faces().size();
+        next->m_topology_version = m_mesh.topology_version();
+        next->m_geometry_version = m_mesh.geometry_version();
+        std::atomic_store(&m_published, std::shared_ptr<const CMeshSnapshot>(std::move(next)));
+    }
+
+}; //namespace
+
+#endif
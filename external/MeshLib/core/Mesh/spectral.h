@@ -0,0 +1,241 @@
+/*!
+*      \file spectral.h
+*      \brief Manifold harmonics, the lowest eigenpairs of the Laplacian of a mesh
+*
+*      The eigenpairs of -L phi = lambda M phi with the smallest lambda are
+*      found by the Lanczos method on the shifted inverse (s M - L)^-1 M,
+*      whose largest eigenvalues 1 / (lambda + s) are those, in the inner
+*      product of M in which it is symmetric. The system is factored once by
+*      CPoissonSolver, so the factorization stays for more eigenpairs or
+*      another basis of the same mesh. The Lanczos basis is reorthogonalized
+*      in full and restarted thickly, keeping the best Ritz vectors, so its
+*      size stays a fixed multiple of the number of eigenpairs. Its products
+*      run in parallel over blocks of rows.
+*/
+
+#ifndef _MESHLIB_SPECTRAL_H_
+#define _MESHLIB_SPECTRAL_H_
+
+#include <vector>
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include "poisson.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CManifoldHarmonics class, the lowest eigenpairs of the cotangent Laplacian
+     *
+     *  The basis is M-orthonormal, a column per eigenpair and a row per row
+     *  of laplacian(), so projecting a signal by vertex and reconstructing
+     *  it are dense products with it.
+     *  \tparam M      a CBaseMesh
+     *  \tparam Solver an Eigen sparse solver, see CPoissonSolver
+     */
+    template<typename M, typename Solver = Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>>>
+    class CManifoldHarmonics
+    {
+    public:
+        CManifoldHarmonics(M & mesh, int threads = 0) : m_solver(mesh, CLaplacian<M>::COTANGENT, threads), m_threads(threads) {}
+
+        /*! the shift s, positive, small against the eigenvalues, by default 1e-6 of trace(-L) / trace(M) */
+        void set_shift(double s)
+        {
+            m_shift = s;
+            m_solver.set_shift(s);
+        }
+        /*! the points moved, refactor at the next compute */
+        void update() { m_solver.update(); }
+
+        /*!
+         *  Compute the eigenpairs
+         *  \param k number of eigenpairs
+         *  \param tolerance of the residuals relative to the eigenvalues of the shifted inverse
+         *  \param restarts most restarts of the Lanczos basis
+         *  \return false if the system cannot be solved or the eigenpairs did not converge
+         */
+        bool compute(int k, double tolerance = 1e-8, int restarts = 200);
+
+        /*! the eigenvalues, ascending */
+        const Eigen::VectorXd & eigenvalues() const { return m_values; }
+        /*! the eigenvectors, column major by eigenvalue */
+        const Eigen::MatrixXd & basis() const { return m_basis; }
+        /*! the coefficients of signals, a column per signal and a row per row of laplacian() */
+        Eigen::MatrixXd project(const Eigen::MatrixXd & f) const;
+        /*! the signals of coefficients */
+        Eigen::MatrixXd reconstruct(const Eigen::MatrixXd & c) const { return m_basis * c; }
+        const CLaplacian<M> & laplacian() const { return m_solver.laplacian(); }
+
+    protected:
+        CPoissonSolver<M, Solver> m_solver;
+        int m_threads;
+        double m_shift = 0;
+
+        Eigen::VectorXd m_mass;
+        Eigen::VectorXd m_values;
+        Eigen::MatrixXd m_basis;
+
+        /*! w = (s M - L)^-1 M v */
+        bool _apply(const Eigen::VectorXd & v, Eigen::VectorXd & w);
+        /*! take w M-orthogonal to the first j columns of V, h receives the coefficients removed */
+        void _orthogonalize(const Eigen::MatrixXd & V, int j, Eigen::VectorXd & w, Eigen::VectorXd & h) const;
+        /*! the columns of V times Y, in place over the first Y.cols() columns */
+        void _rotate(Eigen::MatrixXd & V, const Eigen::MatrixXd & Y) const;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    bool CManifoldHarmonics<M, Solver>::_apply(const Eigen::VectorXd & v, Eigen::VectorXd & w)
+    {
+        Eigen::MatrixXd b = m_mass.cwiseProduct(v), x;
+        if (!m_solver.solve(b, x)) return false;
+        w = x.col(0);
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CManifoldHarmonics<M, Solver>::_orthogonalize(const Eigen::MatrixXd & V, int j, Eigen::VectorXd & w, Eigen::VectorXd & h) const
+    {
+        const size_t n = (size_t)V.rows();
+        h.setZero(j);
+        double norm = std::sqrt(w.dot(m_mass.cwiseProduct(w)));
+        // a second pass only if the first cancelled most of w, and rounding may have left some of V in it
+        for (int pass = 0; pass < 2; pass++)
+        {
+            const Eigen::VectorXd mw = m_mass.cwiseProduct(w);
+            Eigen::VectorXd c(j);
+            parallel_for((size_t)j, m_threads, [&](size_t b, size_t e)
+            {
+                c.segment(b, e - b).noalias() = V.middleCols(b, e - b).transpose() * mw;
+            }, 16);
+            parallel_for(n, m_threads, [&](size_t b, size_t e)
+            {
+                w.segment(b, e - b).noalias() -= V.block(b, 0, e - b, j) * c;
+            }, 1 << 12);
+            h += c;
+            const double left = std::sqrt(w.dot(m_mass.cwiseProduct(w)));
+            if (left > 0.7071 * norm) break;
+            norm = left;
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    void CManifoldHarmonics<M, Solver>::_rotate(Eigen::MatrixXd & V, const Eigen::MatrixXd & Y) const
+    {
+        const Eigen::Index m = Y.rows(), l = Y.cols();
+        parallel_for((size_t)V.rows(), m_threads, [&](size_t b, size_t e)
+        {
+            const Eigen::MatrixXd block = V.block(b, 0, e - b, m) * Y;
+            V.block(b, 0, e - b, l) = block;
+        }, 1 << 10);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    bool CManifoldHarmonics<M, Solver>::compute(int k, double tolerance, int restarts)
+    {
+        m_solver.prepare();
+        const CLaplacian<M> & laplacian = m_solver.laplacian();
+        const size_t n = laplacian.size();
+        if (k <= 0 || (size_t)k > n) return false;
+        m_mass = Eigen::Map<const Eigen::VectorXd>(laplacian.mass().data(), (Eigen::Index)n);
+        if (m_shift <= 0)
+        {
+            double trace = 0, mass = m_mass.sum();
+            const std::vector<int> & outer = laplacian.outer();
+            const std::vector<int> & inner = laplacian.inner();
+            for (size_t i = 0; i < n; i++)
+                for (int e = outer[i]; e < outer[i + 1]; e++)
+                    if (inner[e] == (int)i) trace -= laplacian.values()[e];
+            m_shift = mass > 0 && trace > 0 ? 1e-6 * trace / mass : 1e-6;
+            m_solver.set_shift(m_shift);
+        }
+
+        // the Lanczos basis, the k wanted and half as many again to converge faster, at most n
+        const int m = (int)std::min<size_t>(n, (size_t)std::max(k + k / 2, k + 20));
+        Eigen::MatrixXd V((Eigen::Index)n, m + 1);
+        Eigen::MatrixXd H = Eigen::MatrixXd::Zero(m, m);
+        std::mt19937 random(1);
+        std::uniform_real_distribution<double> uniform(-1, 1);
+        Eigen::VectorXd w((Eigen::Index)n), h;
+        for (size_t i = 0; i < n; i++) w[i] = uniform(random);
+        V.col(0) = w / std::sqrt(w.dot(m_mass.cwiseProduct(w)));
+
+        int kept = 0;
+        Eigen::VectorXd theta;
+        Eigen::MatrixXd Y;
+        for (int restart = 0; restart <= restarts; restart++)
+        {
+            double beta = 0;
+            for (int j = kept; j < m; j++)
+            {
+                if (!_apply(V.col(j), w)) return false;
+                _orthogonalize(V, j + 1, w, h);
+                H.block(0, j, j + 1, 1) = h;
+                H.block(j, 0, 1, j + 1) = h.transpose();
+                beta = std::sqrt(std::max(0.0, w.dot(m_mass.cwiseProduct(w))));
+                if (j + 1 == m) break;
+                if (beta <= 1e-14 * std::abs(h[j]))
+                {
+                    // an invariant subspace, go on from a new random direction
+                    for (size_t i = 0; i < n; i++) w[i] = uniform(random);
+                    _orthogonalize(V, j + 1, w, h);
+                    V.col(j + 1) = w / std::sqrt(w.dot(m_mass.cwiseProduct(w)));
+                    beta = 0;
+                }
+                else V.col(j + 1) = w / beta;
+                H(j + 1, j) = H(j, j + 1) = beta;
+            }
+
+            // the Ritz pairs, largest first
+            Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> ritz(H);
+            theta = ritz.eigenvalues().reverse();
+            Y = ritz.eigenvectors().rowwise().reverse();
+            int converged = 0;
+            while (converged < k && std::abs(beta * Y(m - 1, converged)) <= tolerance * std::abs(theta[converged])) converged++;
+            if (converged >= k || m == (int)n) break;
+            if (restart == restarts) return false;
+
+            // keep the best Ritz vectors, the residual goes on from there
+            kept = std::min(m - 1, k + (m - k) / 2);
+            const Eigen::VectorXd residual = w / (beta > 0 ? beta : 1);
+            _rotate(V, Y.leftCols(kept));
+            V.col(kept) = residual;
+            H.setZero();
+            for (int i = 0; i < kept; i++)
+            {
+                H(i, i) = theta[i];
+                H(i, kept) = H(kept, i) = beta * Y(m - 1, i);
+            }
+            if (beta > 0) continue;
+            // the residual vanished, a random direction takes its place
+            for (size_t i = 0; i < n; i++) w[i] = uniform(random);
+            _orthogonalize(V, kept, w, h);
+            V.col(kept) = w / std::sqrt(w.dot(m_mass.cwiseProduct(w)));
+        }
+
+        m_values.resize(k);
+        for (int i = 0; i < k; i++) m_values[i] = 1 / theta[i] - m_shift;
+        _rotate(V, Y.leftCols(k));
+        m_basis = V.leftCols(k);
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M, typename Solver>
+    Eigen::MatrixXd CManifoldHarmonics<M, Solver>::project(const Eigen::MatrixXd & f) const
+    {
+        return m_basis.transpose() * (m_mass.asDiagonal() * f);
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,654 @@
+/*!
+*      \file subdivision.h
+*      \brief Loop and Catmull-Clark subdivision by precomputed stencils
+*
+*      The refinement is laid out once per topology: every level is split on
+*      flat arrays of faces and edges, not by the local operations of
+*      CDynamicMesh, and the rules of the level give every new vertex as a
+*      weighted sum of the vertices of the level before. The sums of the
+*      levels are composed into one table, a compressed row per refined
+*      vertex with the base vertices it depends on and their weights. Moving
+*      the points, an edit or an animation, leaves the table as it is, the
+*      refined points are the product of it and the base points, rows in
+*      parallel, and the same rows run on the GPU as they are. Boundary and
+*      non-manifold edges are creases, subdivided as curves; a vertex on more
+*      or fewer than two of them is a corner and stays.
+*/
+
+#ifndef _MESHLIB_SUBDIVISION_H_
+#define _MESHLIB_SUBDIVISION_H_
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+#include "mesh.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MESHLIB_SUBDIVISION_SSE
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CSubdivision class, the stencils of levels of subdivision of a mesh
+     *
+     *  Loop subdivision splits every triangle into four, Catmull-Clark every
+     *  polygon of k corners into k quads. The refined vertices are the base
+     *  vertices first, the points of the edges next and, for Catmull-Clark,
+     *  those of the faces last, level after level.
+     *  \tparam M a CBaseMesh
+     */
+    template<typename M>
+    class CSubdivision
+    {
+    public:
+        using CVertex = typename M::CVertex;
+        using CFace = typename M::CFace;
+        using CHalfEdge = typename M::CHalfEdge;
+
+        /*! subdivision schemes */
+        enum Scheme
+        {
+            LOOP,           //!< triangles only
+            CATMULL_CLARK,  //!< any polygons, quads after one level
+            AUTO            //!< LOOP if all faces are triangles, CATMULL_CLARK otherwise
+        };
+
+        CSubdivision(M & mesh) : m_mesh(mesh) {}
+
+        /*!
+         *  Lay out the stencils of levels of subdivision, again after the connectivity changed
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return false if LOOP is asked of faces other than triangles
+         */
+        bool build(int levels, Scheme scheme = AUTO, int threads = 0);
+        /*! whether the stencils are not built for the current connectivity */
+        bool stale() const { return !m_built || m_version != m_mesh.topology_version(); }
+
+        /*! the scheme built, never AUTO */
+        Scheme scheme() const { return m_scheme; }
+        int levels() const { return m_levels; }
+        /*! number of refined vertices, the rows */
+        size_t size() const { return m_outer.empty() ? 0 : m_outer.size() - 1; }
+        /*! number of base vertices, the columns */
+        size_t sources() const { return m_vertices.size(); }
+        /*! the base vertex of column i, and the column of a vertex */
+        CVertex * vertex(size_t i) const { return m_vertices[i]; }
+        int column(CVertex * v) const { return m_column[v->property_index()]; }
+
+        /*! the entries of row i are at [outer()[i], outer()[i + 1]), columns ascending */
+        const std::vector<uint32_t> & outer() const { return m_outer; }
+        const std::vector<uint32_t> & inner() const { return m_inner; }
+        const std::vector<float> & weights() const { return m_weights; }
+
+        /*! the refined faces, face j has the rows at [face_outer()[j], face_outer()[j + 1]) of corners() */
+        const std::vector<int> & face_outer() const { return m_face_outer; }
+        const std::vector<int> & corners() const { return m_corners; }
+        /*! the corners of every face, 3 or 4, 0 if they differ, only without levels */
+        int degree() const { return m_degree; }
+        /*! the refined faces split into fans, three rows per triangle */
+        void triangles(std::vector<uint32_t> & out) const;
+
+        /*!
+         *  The refined values of N components per vertex, out[N * i + c] the sum over row i of the
+         *  weights times in[N * j + c], with j the column. in holds sources() vertices, out size()
+         */
+        template<int N, typename T>
+        void evaluate(const T * in, T * out, int threads = 0) const;
+        /*! the refined points of the current points of the mesh */
+        void points(std::vector<CPoint> & out, int threads = 0) const;
+        /*! build refined as the refined faces and points of the mesh */
+        template<typename R>
+        void refine(R & refined, int threads = 0) const;
+
+    protected:
+        //! rows of a table composed at once by a thread
+        static const size_t s_chunk = 1 << 10;
+        //! rows evaluated at once by a thread
+        static const size_t s_grain = 1 << 12;
+
+        /* the faces of a level and their edges */
+        struct CLevel
+        {
+            size_t           vertices = 0;
+            std::vector<int> face_outer;
+            std::vector<int> corners;
+            //! the edge of every corner, the one from it to the next corner of its face
+            std::vector<int> corner_edge;
+            //! the ends of every edge and the number of corners on it, 2 for an inner one
+            std::vector<int> ends;
+            std::vector<int> count;
+            //! a corner on every edge, and another one if it has two
+            std::vector<int> side;
+        };
+
+        /* rows of weights of the vertices of one level, columns may repeat */
+        struct CRows
+        {
+            std::vector<uint32_t> outer;
+            std::vector<uint32_t> inner;
+            std::vector<double>   weights;
+
+            void add(int j, double w)
+            {
+                inner.push_back((uint32_t)j);
+                weights.push_back(w);
+            }
+            void next() { outer.push_back((uint32_t)inner.size()); }
+        };
+
+        /* the edges of the faces of a level */
+        static void _edges(CLevel & level, int threads);
+        /* the face of a corner */
+        static int _face(const CLevel & level, int corner)
+        {
+            return (int)(std::upper_bound(level.face_outer.begin(), level.face_outer.end(), corner) - level.face_outer.begin()) - 1;
+        }
+        /* the rows of the vertices of the next level and its faces, by the rules of the scheme */
+        void _loop(const CLevel & level, CRows & rows, CLevel & next) const;
+        void _catmull_clark(const CLevel & level, CRows & rows, CLevel & next) const;
+        /* the number of crease edges of vertex v, and the other ends of the first two */
+        static void _creases(const CLevel & level, const std::vector<int> & incident_outer,
+                             const std::vector<int> & incident, size_t v, int & creases, int crease[2]);
+        /* the rows of composed times the rows of a level, merged and sorted by column */
+        void _compose(const CRows & rows, bool first, int threads);
+
+        M & m_mesh;
+        bool m_built = false;
+        size_t m_version = 0;
+        Scheme m_scheme = LOOP;
+        int m_levels = 0;
+        int m_degree = 0;
+
+        std::vector<CVertex*> m_vertices;
+        //! column of each vertex slot, -1 for a slot of no vertex
+        std::vector<int> m_column;
+
+        std::vector<uint32_t> m_outer;
+        std::vector<uint32_t> m_inner;
+        std::vector<float>    m_weights;
+        //! the weights while the levels are composed
+        std::vector<double>   m_exact;
+
+        std::vector<int> m_face_outer;
+        std::vector<int> m_corners;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    bool CSubdivision<M>::build(int levels, Scheme scheme, int threads)
+    {
+        m_built = false;
+        m_vertices.clear();
+        size_t slots = 0;
+        for (CVertex * v : m_mesh.vertices())
+        {
+            m_vertices.push_back(v);
+            slots = std::max(slots, v->property_index() + 1);
+        }
+        const size_t n = m_vertices.size();
+        m_column.assign(slots, -1);
+        for (size_t i = 0; i < n; i++) m_column[m_vertices[i]->property_index()] = (int)i;
+
+        CLevel level;
+        level.vertices = n;
+        level.face_outer.push_back(0);
+        bool triangles = true;
+        for (CFace * f : m_mesh.faces())
+        {
+            int k = 0;
+            for (CHalfEdge * he : f->halfedges_range())
+            {
+                level.corners.push_back(column(he->source()));
+                k++;
+            }
+            level.face_outer.push_back((int)level.corners.size());
+            triangles = triangles && k == 3;
+        }
+        if (scheme == AUTO) scheme = triangles ? LOOP : CATMULL_CLARK;
+        if (scheme == LOOP && !triangles) return false;
+        m_scheme = scheme;
+        m_levels = std::max(levels, 0);
+
+        // the identity, the rows of the base vertices before any level
+        m_outer.resize(n + 1);
+        m_inner.resize(n);
+        m_exact.assign(n, 1.0);
+        for (size_t i = 0; i <= n; i++) m_outer[i] = (uint32_t)i;
+        for (size_t i = 0; i < n; i++) m_inner[i] = (uint32_t)i;
+
+        for (int l = 0; l < m_levels; l++)
+        {
+            _edges(level, threads);
+            CRows rows;
+            CLevel next;
+            if (m_scheme == LOOP) _loop(level, rows, next);
+            else _catmull_clark(level, rows, next);
+            _compose(rows, l == 0, threads);
+            level.face_outer.swap(next.face_outer);
+            level.corners.swap(next.corners);
+            level.vertices = next.vertices;
+        }
+
+        m_weights.assign(m_exact.begin(), m_exact.end());
+        m_exact = std::vector<double>();
+        m_face_outer.swap(level.face_outer);
+        m_corners.swap(level.corners);
+        if (m_levels > 0) m_degree = m_scheme == LOOP ? 3 : 4;
+        else
+        {
+            m_degree = 0;
+            for (size_t j = 0; j + 1 < m_face_outer.size(); j++)
+            {
+                const int k = m_face_outer[j + 1] - m_face_outer[j];
+                if (j == 0) m_degree = k;
+                else if (k != m_degree) m_degree = 0;
+            }
+        }
+        m_version = m_mesh.topology_version();
+        m_built = true;
+        MESHLIB_COUNTER_ADD("subdivision.stencil_entries", m_inner.size());
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSubdivision<M>::_edges(CLevel & level, int threads)
+    {
+        // the corners by the ends of their edges, the lower end first
+        const size_t corners = level.corners.size();
+        std::vector<std::pair<uint64_t, uint32_t>> keys(corners);
+        const size_t faces = level.face_outer.size() - 1;
+        parallel_for(faces, threads, [&](size_t b, size_t e)
+        {
+            for (size_t f = b; f < e; f++)
+            {
+                const int first = level.face_outer[f], last = level.face_outer[f + 1];
+                for (int c = first; c < last; c++)
+                {
+                    const uint64_t u = (uint32_t)level.corners[c];
+                    const uint64_t v = (uint32_t)level.corners[c + 1 == last ? first : c + 1];
+                    keys[c] = std::make_pair(u < v ? (u << 32 | v) : (v << 32 | u), (uint32_t)c);
+                }
+            }
+        });
+        parallel_sort(keys.begin(), keys.end(), threads, std::less<std::pair<uint64_t, uint32_t>>());
+
+        level.corner_edge.resize(corners);
+        level.ends.clear();
+        level.count.clear();
+        level.side.clear();
+        for (size_t i = 0; i < corners; i++)
+        {
+            const uint32_t c = keys[i].second;
+            if (i > 0 && keys[i].first == keys[i - 1].first)
+            {
+                const int e = (int)level.count.size() - 1;
+                if (level.count[e]++ == 1) level.side[2 * e + 1] = (int)c;
+                level.corner_edge[c] = e;
+                continue;
+            }
+            level.corner_edge[c] = (int)level.count.size();
+            level.ends.push_back((int)(keys[i].first >> 32));
+            level.ends.push_back((int)(keys[i].first & 0xffffffff));
+            level.count.push_back(1);
+            level.side.push_back((int)c);
+            level.side.push_back(-1);
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSubdivision<M>::_creases(const CLevel & level, const std::vector<int> & incident_outer,
+                                   const std::vector<int> & incident, size_t v, int & creases, int crease[2])
+    {
+        creases = 0;
+        for (int k = incident_outer[v]; k < incident_outer[v + 1]; k++)
+        {
+            const int e = incident[k];
+            if (level.count[e] == 2) continue;
+            if (creases < 2) crease[creases] = level.ends[2 * e] == (int)v ? level.ends[2 * e + 1] : level.ends[2 * e];
+            creases++;
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSubdivision<M>::_loop(const CLevel & level, CRows & rows, CLevel & next) const
+    {
+        const size_t n = level.vertices, edges = level.count.size();
+        // the edges of every vertex
+        std::vector<int> outer(n + 1, 0), incident(2 * edges);
+        for (size_t e = 0; e < edges; e++)
+        {
+            outer[level.ends[2 * e] + 1]++;
+            outer[level.ends[2 * e + 1] + 1]++;
+        }
+        for (size_t v = 0; v < n; v++) outer[v + 1] += outer[v];
+        std::vector<int> fill(outer.begin(), outer.end() - 1);
+        for (size_t e = 0; e < edges; e++)
+        {
+            incident[fill[level.ends[2 * e]]++] = (int)e;
+            incident[fill[level.ends[2 * e + 1]]++] = (int)e;
+        }
+
+        rows.outer.push_back(0);
+        for (size_t v = 0; v < n; v++)
+        {
+            int creases, crease[2];
+            _creases(level, outer, incident, v, creases, crease);
+            const int valence = outer[v + 1] - outer[v];
+            if (creases == 2)
+            {
+                rows.add((int)v, 0.75);
+                rows.add(crease[0], 0.125);
+                rows.add(crease[1], 0.125);
+            }
+            else if (creases == 0 && valence >= 3)
+            {
+                const double beta = valence == 3 ? 3.0 / 16 : 3.0 / (8.0 * valence);
+                rows.add((int)v, 1 - valence * beta);
+                for (int k = outer[v]; k < outer[v + 1]; k++)
+                {
+                    const int e = incident[k];
+                    rows.add(level.ends[2 * e] == (int)v ? level.ends[2 * e + 1] : level.ends[2 * e], beta);
+                }
+            }
+            else rows.add((int)v, 1);
+            rows.next();
+        }
+        for (size_t e = 0; e < edges; e++)
+        {
+            const int a = level.ends[2 * e], b = level.ends[2 * e + 1];
+            if (level.count[e] == 2)
+            {
+                // the corners across the edge, the third of each of its triangles
+                rows.add(a, 0.375);
+                rows.add(b, 0.375);
+                for (int s = 0; s < 2; s++)
+                {
+                    const int c = level.side[2 * e + s];
+                    const int f = _face(level, c);
+                    const int first = level.face_outer[f];
+                    rows.add(level.corners[first + (c - first + 2) % 3], 0.125);
+                }
+            }
+            else
+            {
+                rows.add(a, 0.5);
+                rows.add(b, 0.5);
+            }
+            rows.next();
+        }
+
+        // a triangle a b c into a, ab, ca and ab, b, bc and ca, bc, c and ab, bc, ca
+        const size_t faces = level.face_outer.size() - 1;
+        next.vertices = n + edges;
+        next.face_outer.resize(4 * faces + 1);
+        next.corners.resize(12 * faces);
+        for (size_t f = 0; f <= 4 * faces; f++) next.face_outer[f] = 3 * (int)f;
+        for (size_t f = 0; f < faces; f++)
+        {
+            const int * c = &level.corners[3 * f];
+            const int * e = &level.corner_edge[3 * f];
+            const int ab = (int)n + e[0], bc = (int)n + e[1], ca = (int)n + e[2];
+            const int t[12] = { c[0], ab, ca, ab, c[1], bc, ca, bc, c[2], ab, bc, ca };
+            std::copy(t, t + 12, &next.corners[12 * f]);
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSubdivision<M>::_catmull_clark(const CLevel & level, CRows & rows, CLevel & next) const
+    {
+        const size_t n = level.vertices, edges = level.count.size(), faces = level.face_outer.size() - 1;
+        std::vector<int> outer(n + 1, 0), incident(2 * edges);
+        for (size_t e = 0; e < edges; e++)
+        {
+            outer[level.ends[2 * e] + 1]++;
+            outer[level.ends[2 * e + 1] + 1]++;
+        }
+        for (size_t v = 0; v < n; v++) outer[v + 1] += outer[v];
+        std::vector<int> fill(outer.begin(), outer.end() - 1);
+        for (size_t e = 0; e < edges; e++)
+        {
+            incident[fill[level.ends[2 * e]]++] = (int)e;
+            incident[fill[level.ends[2 * e + 1]]++] = (int)e;
+        }
+        // the faces of every vertex
+        std::vector<int> face_outer(n + 1, 0), face_of(level.corners.size());
+        for (int v : level.corners) face_outer[v + 1]++;
+        for (size_t v = 0; v < n; v++) face_outer[v + 1] += face_outer[v];
+        fill.assign(face_outer.begin(), face_outer.end() - 1);
+        for (size_t f = 0; f < faces; f++)
+            for (int c = level.face_outer[f]; c < level.face_outer[f + 1]; c++) face_of[fill[level.corners[c]]++] = (int)f;
+
+        // the point of a face, the mean of its corners, times w
+        auto face_point = [&](int f, double w)
+        {
+            const int first = level.face_outer[f], last = level.face_outer[f + 1];
+            for (int c = first; c < last; c++) rows.add(level.corners[c], w / (last - first));
+        };
+
+        rows.outer.push_back(0);
+        for (size_t v = 0; v < n; v++)
+        {
+            int creases, crease[2];
+            _creases(level, outer, incident, v, creases, crease);
+            const int valence = outer[v + 1] - outer[v], around = face_outer[v + 1] - face_outer[v];
+            if (creases == 2)
+            {
+                rows.add((int)v, 0.75);
+                rows.add(crease[0], 0.125);
+                rows.add(crease[1], 0.125);
+            }
+            else if (creases == 0 && valence >= 3 && around > 0)
+            {
+                // (F + 2 R + (n - 3) v) / n, F the mean of the face points and R that of the edge midpoints
+                const double k = valence;
+                rows.add((int)v, (k - 2) / k);
+                for (int i = outer[v]; i < outer[v + 1]; i++)
+                {
+                    const int e = incident[i];
+                    rows.add(level.ends[2 * e] == (int)v ? level.ends[2 * e + 1] : level.ends[2 * e], 1 / (k * k));
+                }
+                for (int i = face_outer[v]; i < face_outer[v + 1]; i++) face_point(face_of[i], 1 / (k * around));
+            }
+            else rows.add((int)v, 1);
+            rows.next();
+        }
+        for (size_t e = 0; e < edges; e++)
+        {
+            const int a = level.ends[2 * e], b = level.ends[2 * e + 1];
+            if (level.count[e] == 2)
+            {
+                rows.add(a, 0.25);
+                rows.add(b, 0.25);
+                face_point(_face(level, level.side[2 * e]), 0.25);
+                face_point(_face(level, level.side[2 * e + 1]), 0.25);
+            }
+            else
+            {
+                rows.add(a, 0.5);
+                rows.add(b, 0.5);
+            }
+            rows.next();
+        }
+        for (size_t f = 0; f < faces; f++)
+        {
+            face_point((int)f, 1);
+            rows.next();
+        }
+
+        // corner i of a face into the quad of it, the point of its edge, that of the face and that of the edge before
+        next.vertices = n + edges + faces;
+        next.face_outer.resize(level.corners.size() + 1);
+        next.corners.resize(4 * level.corners.size());
+        for (size_t q = 0; q < next.face_outer.size(); q++) next.face_outer[q] = 4 * (int)q;
+        for (size_t f = 0; f < faces; f++)
+        {
+            const int first = level.face_outer[f], last = level.face_outer[f + 1];
+            for (int c = first; c < last; c++)
+            {
+                const int before = c == first ? last - 1 : c - 1;
+                int * q = &next.corners[4 * c];
+                q[0] = level.corners[c];
+                q[1] = (int)n + level.corner_edge[c];
+                q[2] = (int)(n + edges + f);
+                q[3] = (int)n + level.corner_edge[before];
+            }
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSubdivision<M>::_compose(const CRows & rows, bool first, int threads)
+    {
+        // the rows are independent, each thread merges chunks of them into arrays joined in order
+        const size_t count = rows.outer.size() - 1;
+        const size_t chunks = std::max<size_t>(1, count / s_chunk);
+        std::vector<std::vector<uint32_t>> inner(chunks), length(chunks);
+        std::vector<std::vector<double>> weights(chunks);
+        parallel_for(chunks, threads, [&](size_t b, size_t e)
+        {
+            std::vector<std::pair<uint32_t, double>> terms;
+            for (size_t c = b; c < e; c++)
+            {
+                for (size_t i = count * c / chunks; i < count * (c + 1) / chunks; i++)
+                {
+                    terms.clear();
+                    for (uint32_t k = rows.outer[i]; k < rows.outer[i + 1]; k++)
+                    {
+                        const uint32_t j = rows.inner[k];
+                        const double w = rows.weights[k];
+                        if (first)
+                        {
+                            terms.push_back(std::make_pair(j, w));
+                            continue;
+                        }
+                        for (uint32_t t = m_outer[j]; t < m_outer[j + 1]; t++) terms.push_back(std::make_pair(m_inner[t], w * m_exact[t]));
+                    }
+                    std::sort(terms.begin(), terms.end(),
+                        [](const std::pair<uint32_t, double> & x, const std::pair<uint32_t, double> & y) { return x.first < y.first; });
+                    uint32_t n = 0;
+                    for (size_t t = 0; t < terms.size(); t++)
+                    {
+                        if (t > 0 && terms[t].first == terms[t - 1].first)
+                        {
+                            weights[c].back() += terms[t].second;
+                            continue;
+                        }
+                        inner[c].push_back(terms[t].first);
+                        weights[c].push_back(terms[t].second);
+                        n++;
+                    }
+                    length[c].push_back(n);
+                }
+            }
+        }, 1);
+
+        m_outer.resize(count + 1);
+        m_inner.clear();
+        m_exact.clear();
+        size_t i = 0;
+        m_outer[0] = 0;
+        for (size_t c = 0; c < chunks; c++)
+        {
+            m_inner.insert(m_inner.end(), inner[c].begin(), inner[c].end());
+            m_exact.insert(m_exact.end(), weights[c].begin(), weights[c].end());
+            for (uint32_t n : length[c])
+            {
+                m_outer[i + 1] = m_outer[i] + n;
+                i++;
+            }
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSubdivision<M>::triangles(std::vector<uint32_t> & out) const
+    {
+        out.clear();
+        for (size_t f = 0; f + 1 < m_face_outer.size(); f++)
+        {
+            const int first = m_face_outer[f], last = m_face_outer[f + 1];
+            for (int c = first + 1; c + 1 < last; c++)
+            {
+                out.push_back((uint32_t)m_corners[first]);
+                out.push_back((uint32_t)m_corners[c]);
+                out.push_back((uint32_t)m_corners[c + 1]);
+            }
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    template<int N, typename T>
+    void CSubdivision<M>::evaluate(const T * in, T * out, int threads) const
+    {
+        const size_t columns = sources();
+        parallel_for(size(), threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+            {
+                const uint32_t first = m_outer[i], last = m_outer[i + 1];
+                uint32_t k = first;
+                T sum[N] = {};
+#ifdef MESHLIB_SUBDIVISION_SSE
+                // four lanes of floats hold a point of 3 or 4, the lane past a point of 3 reads the next one,
+                // so the last column is left to the loop below
+                if (std::is_same<T, float>::value && (N == 3 || N == 4))
+                {
+                    __m128 s = _mm_setzero_ps();
+                    for (; k < last && (N == 4 || m_inner[k] + 1 < columns); k++)
+                        s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(m_weights[k]), _mm_loadu_ps((const float *)in + N * (size_t)m_inner[k])));
+                    float lanes[4];
+                    _mm_storeu_ps(lanes, s);
+                    for (int c = 0; c < N; c++) sum[c] = (T)lanes[c];
+                }
+#endif
+                for (; k < last; k++)
+                {
+                    const T w = (T)m_weights[k];
+                    const T * p = in + N * (size_t)m_inner[k];
+                    for (int c = 0; c < N; c++) sum[c] += w * p[c];
+                }
+                for (int c = 0; c < N; c++) out[N * i + c] = sum[c];
+            }
+        }, s_grain);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    void CSubdivision<M>::points(std::vector<CPoint> & out, int threads) const
+    {
+        std::vector<double> in(3 * sources()), refined(3 * size());
+        for (size_t i = 0; i < sources(); i++)
+            for (int c = 0; c < 3; c++) in[3 * i + c] = m_vertices[i]->point()[c];
+        evaluate<3>(in.data(), refined.data(), threads);
+        out.resize(size());
+        for (size_t i = 0; i < size(); i++) out[i] = CPoint(refined[3 * i], refined[3 * i + 1], refined[3 * i + 2]);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    template<typename R>
+    void CSubdivision<M>::refine(R & refined, int threads) const
+    {
+        std::vector<CPoint> refined_points;
+        points(refined_points, threads);
+        refined.build_from_arrays(refined_points, std::vector<CPoint2>(), std::vector<CPoint>(), m_corners, m_face_outer,
+            std::vector<int>(), std::vector<int>());
+    }
+
+}; //namespace
+
+#endif
@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <math.h>
 #include <complex>
+#include <vector>
 
 namespace MeshLib {
 
@@ -62,8 +63,6 @@ namespace MeshLib {
             m_c = mid + d * t.real();
 
             m_r = std::abs( m_p[0] - m_c );
-
-            printf("%f %f\n", m_r - std::abs( m_p[1] - m_c ), std::norm( m_c ) - 1 - m_r * m_r);
         }
         /*!
          *  CHyperbolicLine destructor
@@ -86,6 +85,29 @@ namespace MeshLib {
         {
             return m_p[k];
         }
+        /*!
+         *  whether the line is an arc of a circle or a diameter
+         */
+        HyperbolicLineType type() const { return m_type; };
+        /*!
+         *  n + 1 points from m_p[0] to m_p[1] along the line, equally spaced in angle on the
+         *  circle, or in length on a diameter, appended to points. the ends may lie on the unit
+         *  circle, the line is the geodesic between them then
+         */
+        void sample( int n, std::vector<std::complex<double>> & points ) const
+        {
+            if ( m_type == LINE )
+            {
+                for ( int i = 0; i <= n; i++ ) points.push_back( m_p[0] + ( m_p[1] - m_p[0] ) * ( (double) i / n ) );
+                return;
+            }
+            // the arc inside the disk is the one of less than pi between the ends
+            const double a0 = std::arg( m_p[0] - m_c );
+            double turn = std::arg( m_p[1] - m_c ) - a0;
+            if ( turn > M_PI ) turn -= 2 * M_PI;
+            if ( turn < -M_PI ) turn += 2 * M_PI;
+            for ( int i = 0; i <= n; i++ ) points.push_back( m_c + std::polar( m_r, a0 + turn * i / n ) );
+        };
     protected:
         /*!
          *  Two points on the hyperbolic line
@@ -4,6 +4,11 @@
 *      \author David Gu
 *      \date 10/07/2010
 *
+*      Arrays of points are transformed in parallel, by real arithmetic in
+*      place of the complex division, four points per step with AVX and two
+*      with SSE2 when the real and imaginary parts are in separate arrays.
+*      Composed transformations are again of this form, so a chain of them
+*      is applied in one pass.
 */
 
 #ifndef _MESHLIB_MOBIUS_H_
@@ -12,6 +17,16 @@
 #include <assert.h>
 #include <math.h>
 #include <complex>
+#include <cstddef>
+#include "../parser/parallel.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MESHLIB_MOBIUS_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLIB_MOBIUS_SSE2
+#endif
 
 namespace MeshLib {
 
@@ -48,7 +63,7 @@ namespace MeshLib {
          *  Transform a complex number by the current Mobius transformation
          *  \param z the input complex number
          */
-        Complex operator*(Complex z) { return m_theta * (z - m_z0) / (Complex(1.0, 0.0) - std::conj(m_z0) * z); };
+        Complex operator*(Complex z) const { return m_theta * (z - m_z0) / (Complex(1.0, 0.0) - std::conj(m_z0) * z); };
         /*!
          *  The z0 of the Mobius transformation
          */
@@ -57,6 +72,27 @@ namespace MeshLib {
          *  The rotation part
          */
         Complex & theta() { return m_theta; };
+        /*!
+         *  The matrix m, (m[0][0] z + m[0][1]) / (m[1][0] z + m[1][1]), m[1][1] = 1
+         */
+        void matrix(Complex m[2][2]) const
+        {
+            m[0][0] = m_theta;
+            m[0][1] = -m_z0 * m_theta;
+            m[1][0] = -std::conj(m_z0);
+            m[1][1] = 1.0;
+        };
+
+        /*!
+         *  Transform points in place, the real parts in re and the imaginary parts in im
+         *  \param n number of points
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        void transform(double * re, double * im, size_t n, int threads = 0) const;
+        /*!
+         *  Transform an array of complex numbers in place
+         */
+        void transform(Complex * z, size_t n, int threads = 0) const;
 
     protected:
         /*!
@@ -68,15 +104,100 @@ namespace MeshLib {
          */
         Complex  m_z0;
 
-        friend CMobius inverse(CMobius & mob);
-        friend CMobius operator*(CMobius & mob1, CMobius & mob2);
-
+        friend CMobius inverse(const CMobius & mob);
+        friend CMobius operator*(const CMobius & mob1, const CMobius & mob2);
+
+        /*! the points [b, e) of the arrays */
+        void _transform(double * re, double * im, size_t b, size_t e) const;
+
+#if defined(MESHLIB_MOBIUS_AVX)
+        typedef __m256d V;
+        static const int W = 4;
+        static V _set1(double v) { return _mm256_set1_pd(v); }
+        static V _load(const double * p) { return _mm256_loadu_pd(p); }
+        static void _store(double * p, V v) { _mm256_storeu_pd(p, v); }
+        static V _add(V a, V b) { return _mm256_add_pd(a, b); }
+        static V _sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        static V _mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        static V _div(V a, V b) { return _mm256_div_pd(a, b); }
+#elif defined(MESHLIB_MOBIUS_SSE2)
+        typedef __m128d V;
+        static const int W = 2;
+        static V _set1(double v) { return _mm_set1_pd(v); }
+        static V _load(const double * p) { return _mm_loadu_pd(p); }
+        static void _store(double * p, V v) { _mm_storeu_pd(p, v); }
+        static V _add(V a, V b) { return _mm_add_pd(a, b); }
+        static V _sub(V a, V b) { return _mm_sub_pd(a, b); }
+        static V _mul(V a, V b) { return _mm_mul_pd(a, b); }
+        static V _div(V a, V b) { return _mm_div_pd(a, b); }
+#endif
     };
 
+    /*
+     *  With z0 = p + iq, the image of z = x + iy is theta (z - z0) conj(d) / |d|^2,
+     *  where d = 1 - conj(z0) z = (1 - px - qy) + i(qx - py)
+     */
+    inline void CMobius::_transform(double * re, double * im, size_t b, size_t e) const
+    {
+        const double p = m_z0.real(), q = m_z0.imag(), cr = m_theta.real(), ci = m_theta.imag();
+        size_t i = b;
+#if defined(MESHLIB_MOBIUS_AVX) || defined(MESHLIB_MOBIUS_SSE2)
+        const V vp = _set1(p), vq = _set1(q), vcr = _set1(cr), vci = _set1(ci), one = _set1(1.0);
+        for (; i + W <= e; i += W)
+        {
+            const V x = _load(re + i), y = _load(im + i);
+            const V ar = _sub(x, vp), ai = _sub(y, vq);
+            const V dr = _sub(_sub(one, _mul(vp, x)), _mul(vq, y));
+            const V di = _sub(_mul(vq, x), _mul(vp, y));
+            const V tr = _add(_mul(ar, dr), _mul(ai, di));
+            const V ti = _sub(_mul(ai, dr), _mul(ar, di));
+            const V norm = _add(_mul(dr, dr), _mul(di, di));
+            _store(re + i, _div(_sub(_mul(vcr, tr), _mul(vci, ti)), norm));
+            _store(im + i, _div(_add(_mul(vcr, ti), _mul(vci, tr)), norm));
+        }
+#endif
+        for (; i < e; i++)
+        {
+            const double x = re[i], y = im[i];
+            const double ar = x - p, ai = y - q;
+            const double dr = 1 - p * x - q * y, di = q * x - p * y;
+            const double tr = ar * dr + ai * di, ti = ai * dr - ar * di;
+            const double norm = dr * dr + di * di;
+            re[i] = (cr * tr - ci * ti) / norm;
+            im[i] = (cr * ti + ci * tr) / norm;
+        }
+    }
+
+    inline void CMobius::transform(double * re, double * im, size_t n, int threads) const
+    {
+        parallel_for(n, threads, [&](size_t b, size_t e) { _transform(re, im, b, e); });
+    }
+
+    inline void CMobius::transform(Complex * z, size_t n, int threads) const
+    {
+        // split blocks into parts and back, so the parts go through the vector loop
+        parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            const size_t block = 256;
+            double re[block], im[block];
+            for (size_t s = b; s < e; s += block)
+            {
+                const size_t m = std::min(block, e - s);
+                for (size_t i = 0; i < m; i++)
+                {
+                    re[i] = z[s + i].real();
+                    im[i] = z[s + i].imag();
+                }
+                _transform(re, im, 0, m);
+                for (size_t i = 0; i < m; i++) z[s + i] = Complex(re[i], im[i]);
+            }
+        });
+    }
+
     /*!
      *  Compute the inverse mobius transformation
      */
-    CMobius inverse(CMobius & mob)
+    inline CMobius inverse(const CMobius & mob)
     {
         CMobius imb;
         imb.m_theta = std::conj(mob.m_theta);
@@ -87,20 +208,13 @@ namespace MeshLib {
     /*!
      *  Compose Mobius transformation
      */
-    CMobius operator*(CMobius & mob1, CMobius & mob2)
+    inline CMobius operator*(const CMobius & mob1, const CMobius & mob2)
     {
         Complex m1[2][2];
         Complex m2[2][2];
 
-        m1[0][0] = mob1.m_theta;
-        m1[0][1] = -mob1.m_z0 * mob1.m_theta;
-        m1[1][0] = -std::conj(mob1.m_z0);
-        m1[1][1] = 1.0;
-
-        m2[0][0] = mob2.m_theta;
-        m2[0][1] = -mob2.m_z0 * mob2.m_theta;
-        m2[1][0] = -std::conj(mob2.m_z0);
-        m2[1][1] = 1.0;
+        mob1.matrix(m1);
+        mob2.matrix(m2);
 
         Complex m[2][2];
         for (int i = 0; i < 2; i++)
@@ -0,0 +1,267 @@
+/*!
+*      \file MobiusGroup.h
+*      \brief The copies of a fundamental domain of the Poincare disk under a group of Mobius transformations
+*
+*      A surface uniformized onto the hyperbolic plane is cut open into a
+*      fundamental domain whose sides are paired by Mobius transformations of
+*      the disk, the side pairings, see CRicciFlow::layout. The group they
+*      generate tiles the disk with copies of the domain. The copies are found
+*      by a breadth first search over the words in the generators and their
+*      inverses, shortest first, so that the tiles nearest the domain come
+*      first and the search stops at a length or a count. Words that differ by
+*      a relation of the group give the same copy, they are told apart by the
+*      image of a point inside the domain, which no other element fixes for the
+*      group of a surface, looked up in a grid of the disk. A copy whose point
+*      lies past a radius is kept but not extended, the tiles beyond are
+*      smaller than a pixel of any view of the whole disk.
+*/
+
+#ifndef _MESHLIB_MOBIUS_GROUP_H_
+#define _MESHLIB_MOBIUS_GROUP_H_
+
+#include <vector>
+#include <unordered_map>
+#include <complex>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include "Mobius.h"
+#include "HyperbolicLine.h"
+#include "../Geometry/Point2.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  The Mobius transformation of the disk that takes a to a1 and b to b1, a and b as far apart
+     *  in the hyperbolic metric as a1 and b1, the direction from a1 to b1 is matched otherwise
+     */
+    inline CMobius side_pairing(Complex a, Complex b, Complex a1, Complex b1)
+    {
+        const CMobius from(a, 0), to(a1, 0);
+        const double turn = std::arg(to * b1) - std::arg(from * b);
+        return inverse(to) * CMobius(Complex(0, 0), turn) * from;
+    }
+
+    /*!
+     *  \brief CMobiusGroup class, a group of Mobius transformations of the disk given by generators,
+     *  and its elements as words of bounded length
+     */
+    class CMobiusGroup
+    {
+    public:
+        /*!
+         *  Add g and its inverse as generators, unless they are already
+         *  \param tolerance distance within which two transformations are the same, see distance
+         *  \return the index of g among the generators
+         */
+        size_t add_generator(const CMobius & g, double tolerance = 1e-6);
+
+        /*!
+         *  Add the side pairings of the uv layout of a mesh: every edge whose two halfedges have
+         *  different uvs at its ends is a side of the fundamental domain twice, and the
+         *  transformation that takes one side onto the other is a generator. the uvs are the
+         *  disk scaled into [0, 1]^2, as CRicciFlow::layout writes a hyperbolic layout
+         *  \tparam M a CBaseMesh whose halfedges have uv(), the corner of their target
+         *  \return the number of generators, with their inverses
+         */
+        template<typename M>
+        size_t add_side_pairings(M & mesh, double tolerance = 1e-6);
+
+        /*! the generators, every one followed by its inverse, the inverse of an involution is itself */
+        const std::vector<CMobius> & generators() const { return m_generators; }
+
+        /*!
+         *  The elements of the group as words of at most max_length generators, at most max_count
+         *  of them, shortest first, the identity first
+         *  \param base a point inside the fundamental domain, its images tell the copies apart
+         *  \param max_radius the words whose image of base lies farther from the center are not extended
+         *  \param tolerance hyperbolic distance within which two images of base are one copy
+         *  \return the number of elements
+         */
+        size_t enumerate(Complex base, size_t max_length, size_t max_count, double max_radius = 0.998, double tolerance = 1e-4);
+
+        /*! the elements of the last enumerate() */
+        const std::vector<CMobius> & elements() const { return m_elements; }
+        /*! the length of the word of every element */
+        const std::vector<uint32_t> & lengths() const { return m_lengths; }
+
+        /*!
+         *  The axis of generator k, the geodesic between its two fixed points on the unit circle,
+         *  which it moves along. false for an elliptic or parabolic transformation, without one
+         */
+        bool axis(size_t k, Complex & from, Complex & to) const;
+
+        /*! the axes of the generators as polylines of n + 1 points, see CHyperbolicLine::sample, a
+            generator and its inverse share one. moved by the elements they are the orbits of the
+            closed geodesics of the surface */
+        void axes(int n, std::vector<std::vector<Complex>> & lines) const;
+
+        /*! the difference of two transformations, of their rotations and their centers */
+        static double distance(const CMobius & a, const CMobius & b)
+        {
+            Complex ma[2][2], mb[2][2];
+            a.matrix(ma);
+            b.matrix(mb);
+            return std::abs(ma[0][0] - mb[0][0]) + std::abs(ma[1][0] - mb[1][0]);
+        }
+
+        /*! the distance of z and w in the Poincare metric */
+        static double hyperbolic_distance(Complex z, Complex w)
+        {
+            const double s = std::abs(z - w) / std::abs(Complex(1, 0) - std::conj(w) * z);
+            return 2 * std::atanh(std::min(s, 1 - 1e-16));
+        }
+
+    protected:
+        std::vector<CMobius> m_generators;
+        //! the index of the inverse of every generator
+        std::vector<size_t> m_inverse;
+        std::vector<CMobius> m_elements;
+        std::vector<uint32_t> m_lengths;
+
+        /*! the index of a generator within tolerance of g, or -1 */
+        long _find(const CMobius & g, double tolerance) const
+        {
+            for (size_t k = 0; k < m_generators.size(); k++)
+                if (distance(m_generators[k], g) < tolerance) return (long)k;
+            return -1;
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline size_t CMobiusGroup::add_generator(const CMobius & g, double tolerance)
+    {
+        const long found = _find(g, tolerance);
+        if (found >= 0) return (size_t)found;
+        const size_t k = m_generators.size();
+        const CMobius h = inverse(g);
+        m_generators.push_back(g);
+        m_inverse.push_back(k);
+        if (distance(g, h) >= tolerance)
+        {
+            m_generators.push_back(h);
+            m_inverse.push_back(k);
+            m_inverse[k] = k + 1;
+        }
+        return k;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    template<typename M>
+    size_t CMobiusGroup::add_side_pairings(M & mesh, double tolerance)
+    {
+        auto disk = [](const CPoint2 & uv) { return Complex(2 * uv[0] - 1, 2 * uv[1] - 1); };
+        for (auto * e : mesh.edges())
+        {
+            auto * h0 = e->halfedge(0);
+            auto * h1 = e->halfedge(1);
+            if (h0 == NULL || h1 == NULL) continue;
+            // h0 runs from a to b, h1 back, each halfedge holds the uv of its target
+            const Complex a0 = disk(h0->prev()->uv()), b0 = disk(h0->uv());
+            const Complex a1 = disk(h1->uv()), b1 = disk(h1->prev()->uv());
+            if (std::abs(a0 - a1) + std::abs(b0 - b1) < tolerance) continue;
+            add_generator(side_pairing(a1, b1, a0, b0), tolerance);
+        }
+        return m_generators.size();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline size_t CMobiusGroup::enumerate(Complex base, size_t max_length, size_t max_count, double max_radius, double tolerance)
+    {
+        m_elements.clear();
+        m_lengths.clear();
+        if (max_count == 0) return 0;
+
+        // two images of base within tolerance are at most this far apart inside max_radius, the
+        // cells are that wide so that a match is in the cell of the image or one beside it
+        const double cell = std::max(tolerance * (1 - max_radius * max_radius) / 2, 1e-12);
+        auto key = [](int64_t x, int64_t y) { return (uint64_t)(x * 73856093) ^ (uint64_t)(y * 19349663); };
+        std::unordered_multimap<uint64_t, size_t> seen;
+        std::vector<Complex> images;
+        auto known = [&](Complex z)
+        {
+            const int64_t x = (int64_t)std::floor(z.real() / cell), y = (int64_t)std::floor(z.imag() / cell);
+            for (int64_t dx = -1; dx <= 1; dx++)
+                for (int64_t dy = -1; dy <= 1; dy++)
+                {
+                    auto range = seen.equal_range(key(x + dx, y + dy));
+                    for (auto it = range.first; it != range.second; ++it)
+                        if (hyperbolic_distance(images[it->second], z) < tolerance) return true;
+                }
+            return false;
+        };
+        auto insert = [&](Complex z)
+        {
+            seen.insert(std::make_pair(key((int64_t)std::floor(z.real() / cell), (int64_t)std::floor(z.imag() / cell)), images.size()));
+            images.push_back(z);
+        };
+
+        // the last letter of every word, the next ones do not undo it
+        std::vector<long> last;
+        m_elements.push_back(CMobius());
+        m_lengths.push_back(0);
+        insert(base);
+        last.push_back(-1);
+        size_t begin = 0;
+        for (size_t length = 1; length <= max_length && m_elements.size() < max_count; length++)
+        {
+            const size_t end = m_elements.size();
+            for (size_t i = begin; i < end && m_elements.size() < max_count; i++)
+            {
+                if (std::abs(images[i]) > max_radius) continue;
+                for (size_t k = 0; k < m_generators.size() && m_elements.size() < max_count; k++)
+                {
+                    if (last[i] >= 0 && m_inverse[(size_t)last[i]] == k) continue;
+                    // the copy across side k of copy i
+                    const CMobius g = m_elements[i] * m_generators[k];
+                    const Complex z = g * base;
+                    if (known(z)) continue;
+                    insert(z);
+                    m_elements.push_back(g);
+                    m_lengths.push_back((uint32_t)length);
+                    last.push_back((long)k);
+                }
+            }
+            begin = end;
+        }
+        return m_elements.size();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CMobiusGroup::axis(size_t k, Complex & from, Complex & to) const
+    {
+        // the fixed points solve c z^2 + (d - a) z - b = 0
+        Complex m[2][2];
+        m_generators[k].matrix(m);
+        const Complex a = m[0][0], b = m[0][1], c = m[1][0], d = m[1][1];
+        if (std::abs(c) < 1e-12) return false;
+        const Complex root = std::sqrt((d - a) * (d - a) + 4.0 * b * c);
+        const Complex z0 = (a - d + root) / (2.0 * c), z1 = (a - d - root) / (2.0 * c);
+        // a hyperbolic transformation has both on the circle and apart
+        if (std::abs(std::abs(z0) - 1) > 1e-6 || std::abs(std::abs(z1) - 1) > 1e-6 || std::abs(z0 - z1) < 1e-9) return false;
+        // the repelling point first, where the derivative a d - b c / (c z + d)^2 is larger
+        const Complex det = a * d - b * c;
+        const bool repelling = std::abs(det / ((c * z0 + d) * (c * z0 + d))) > 1;
+        from = repelling ? z0 : z1;
+        to = repelling ? z1 : z0;
+        return true;
+    }
+
+    inline void CMobiusGroup::axes(int n, std::vector<std::vector<Complex>> & lines) const
+    {
+        lines.clear();
+        for (size_t k = 0; k < m_generators.size(); k++)
+        {
+            Complex from, to;
+            if (m_inverse[k] < k || !axis(k, from, to)) continue;
+            lines.push_back(std::vector<Complex>());
+            CHyperbolicLine(from, to).sample(n, lines.back());
+        }
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,259 @@
+/*!
+*      \file compacttmesh.h
+*      \brief Index based tetrahedral mesh with struct-of-arrays storage
+*
+*      CCompactTMesh holds a tet mesh in int32 arrays, about 40 bytes per tet
+*      and 28 per vertex, where CBaseTMesh takes over a kilobyte per tet. It
+*      is meant for simulation sized volumes, and converts to and from
+*      CBaseTMesh.
+*/
+
+#ifndef _TMESHLIB_COMPACT_TMESH_H_
+#define _TMESHLIB_COMPACT_TMESH_H_
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+#include "../Geometry/Point.h"
+#include "../parser/tetparser.h"
+#include "../parser/parallel.h"
+
+namespace TMeshLib
+{
+    using CPoint = MeshLib::CPoint;
+
+    /*!
+     *  \brief CCompactTMesh class, tets and their neighbors as index arrays
+     *
+     *  Halfface 4t + i of tet t is the face opposite its vertex i, its
+     *  vertices are those of CBaseTMesh's halfface i, in the same order, so
+     *  that its normal points out of the tet. t_adj pairs the halffaces of
+     *  neighboring tets. Edges are numbered on first use.
+     */
+    class CCompactTMesh
+    {
+    public:
+        int num_vertices() const { return (int)v_pos.size(); }
+        int num_tets() const { return (int)t_id.size(); }
+        int num_halffaces() const { return (int)t_adj.size(); }
+
+        const CPoint & point(int32_t v) const { return v_pos[v]; }
+        int32_t tet_vertex(int32_t t, int i) const { return t_vert[4 * (size_t)t + i]; }
+        /*! the tet across the face opposite vertex i of t, -1 on the boundary */
+        int32_t neighbor(int32_t t, int i) const { const int32_t h = t_adj[4 * (size_t)t + i]; return h < 0 ? -1 : h >> 2; }
+
+        /*! vertex k of halfface h, k = 0, 1, 2 */
+        int32_t halfface_vertex(int32_t h, int k) const { return t_vert[4 * (size_t)(h >> 2) + s_face[h & 3][k]]; }
+        /*! the opposite halfface, -1 on the boundary */
+        int32_t dual(int32_t h) const { return t_adj[h]; }
+        bool    boundary(int32_t h) const { return t_adj[h] < 0; }
+
+        /*! number of edges, numbering them first if needed */
+        int num_edges() { build_edges(); return (int)(e_vert.size() / 2); }
+        /*! edge k of tet t, k over the pairs (0,1), (0,2), (0,3), (1,2), (1,3), (2,3) */
+        int32_t tet_edge(int32_t t, int k) { build_edges(); return t_edge[6 * (size_t)t + k]; }
+        /*! vertex k of edge e, the smaller index first */
+        int32_t edge_vertex(int32_t e, int k) { build_edges(); return e_vert[2 * (size_t)e + k]; }
+
+        void clear()
+        {
+            v_pos.clear(); v_id.clear();
+            t_vert.clear(); t_adj.clear(); t_id.clear();
+            e_vert.clear(); t_edge.clear();
+        }
+
+        /*! bytes held by the arrays */
+        size_t memory() const
+        {
+            return v_pos.capacity() * sizeof(CPoint) +
+                (v_id.capacity() + t_vert.capacity() + t_adj.capacity() + t_id.capacity() +
+                    e_vert.capacity() + t_edge.capacity()) * sizeof(int32_t);
+        }
+
+        /*!
+         *  Build from flat arrays
+         *  \param tets 0-based vertex indices, four per tet
+         *  \param threads number of threads for the face matching, 0 uses all hardware threads
+         */
+        void build(const std::vector<CPoint> & points, const std::vector<int32_t> & tets, int threads = 0)
+        {
+            clear();
+            v_pos = points;
+            v_id.resize(points.size());
+            for (size_t i = 0; i < points.size(); i++) v_id[i] = (int32_t)i;
+            t_vert = tets;
+            t_id.resize(tets.size() / 4);
+            for (size_t i = 0; i < t_id.size(); i++) t_id[i] = (int32_t)i;
+            _link(threads);
+        }
+
+        /*! build from parsed records, see MeshLib::CTetParser; ids are kept, tets referring to unknown ids are dropped */
+        void build(const MeshLib::CTetData & data, int threads = 0)
+        {
+            clear();
+            v_pos = data.points;
+            v_id.assign(data.vertex_ids.begin(), data.vertex_ids.end());
+            std::unordered_map<int32_t, int32_t> index;
+            index.reserve(v_id.size());
+            for (size_t i = 0; i < v_id.size(); i++) index[v_id[i]] = (int32_t)i;
+
+            t_vert.reserve(data.tets.size());
+            t_id.reserve(data.num_tets());
+            for (size_t t = 0; t < data.num_tets(); t++)
+            {
+                int32_t v[4];
+                int k = 0;
+                for (; k < 4; k++)
+                {
+                    auto it = index.find(data.tets[4 * t + k]);
+                    if (it == index.end()) break;
+                    v[k] = it->second;
+                }
+                if (k < 4) continue;
+                t_vert.insert(t_vert.end(), v, v + 4);
+                t_id.push_back(data.tet_ids[t]);
+            }
+            _link(threads);
+        }
+
+        /*!
+         *  Copy a CBaseTMesh, vertices and tets are numbered in the order of
+         *  vertices() and tets(), their ids are kept.
+         */
+        template<typename M>
+        void from_mesh(M & mesh, int threads = 0)
+        {
+            clear();
+            std::unordered_map<const void *, int32_t> vindex;
+            vindex.reserve(mesh.vertices().size());
+            for (auto v : mesh.vertices())
+            {
+                vindex[v] = (int32_t)v_pos.size();
+                v_pos.push_back(v->point());
+                v_id.push_back(v->id());
+            }
+            for (auto t : mesh.tets())
+            {
+                for (int k = 0; k < 4; k++) t_vert.push_back(vindex[t->vertex(k)]);
+                t_id.push_back(t->id());
+            }
+            _link(threads);
+        }
+
+        /*! Build a CBaseTMesh with the ids of this mesh */
+        template<typename M>
+        void to_mesh(M & mesh) const
+        {
+            MeshLib::CTetData data;
+            data.points = v_pos;
+            data.vertex_ids.assign(v_id.begin(), v_id.end());
+            data.tets.resize(t_vert.size());
+            for (size_t i = 0; i < t_vert.size(); i++) data.tets[i] = v_id[t_vert[i]];
+            data.tet_ids.assign(t_id.begin(), t_id.end());
+            mesh._load_data(data);
+        }
+
+        /*! number the edges, and fill e_vert and t_edge, unless done already */
+        void build_edges(int threads = 0)
+        {
+            if (!t_edge.empty() || t_vert.empty()) return;
+            const size_t nt = t_id.size();
+            std::vector<std::pair<uint64_t, uint32_t>> keys(6 * nt);
+            MeshLib::parallel_for(nt, threads, [&](size_t b, size_t e)
+            {
+                for (size_t t = b; t < e; t++)
+                    for (int k = 0; k < 6; k++)
+                    {
+                        const uint64_t x = (uint32_t)t_vert[4 * t + s_edge[k][0]], y = (uint32_t)t_vert[4 * t + s_edge[k][1]];
+                        keys[6 * t + k] = std::make_pair(x < y ? (x << 32 | y) : (y << 32 | x), (uint32_t)(6 * t + k));
+                    }
+            });
+            MeshLib::parallel_sort(keys.begin(), keys.end(), threads, std::less<std::pair<uint64_t, uint32_t>>());
+
+            t_edge.resize(6 * nt);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (i == 0 || keys[i].first != keys[i - 1].first)
+                {
+                    e_vert.push_back((int32_t)(keys[i].first >> 32));
+                    e_vert.push_back((int32_t)(keys[i].first & 0xffffffff));
+                }
+                t_edge[keys[i].second] = (int32_t)(e_vert.size() / 2 - 1);
+            }
+        }
+
+    public:
+        /*! vertex positions */
+        std::vector<CPoint>  v_pos;
+        /*! vertex ids, as in CBaseTMesh */
+        std::vector<int32_t> v_id;
+
+        /*! four vertex indices per tet */
+        std::vector<int32_t> t_vert;
+        /*! the dual of every halfface, -1 on the boundary */
+        std::vector<int32_t> t_adj;
+        /*! tet ids */
+        std::vector<int32_t> t_id;
+
+        /*! two vertex indices per edge, empty until the edges are numbered */
+        std::vector<int32_t> e_vert;
+        /*! six edge indices per tet, empty until the edges are numbered */
+        std::vector<int32_t> t_edge;
+
+        //! vertices of the halfface opposite vertex i, as CBaseTMesh orders them
+        static constexpr int s_face[4][3] = { { 1, 2, 3 }, { 2, 0, 3 }, { 0, 1, 3 }, { 1, 0, 2 } };
+        //! vertices of the six edges of a tet
+        static constexpr int s_edge[6][2] = { { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+
+    protected:
+        /*! pair the halffaces by their sorted vertex triples; faces of more than two tets stay boundary */
+        void _link(int threads)
+        {
+            struct CKey
+            {
+                int32_t v[3];
+                int32_t h;
+                bool operator<(const CKey & k) const
+                {
+                    if (v[0] != k.v[0]) return v[0] < k.v[0];
+                    if (v[1] != k.v[1]) return v[1] < k.v[1];
+                    if (v[2] != k.v[2]) return v[2] < k.v[2];
+                    return h < k.h;
+                }
+            };
+
+            const size_t nh = t_vert.size();
+            std::vector<CKey> keys(nh);
+            MeshLib::parallel_for(nh, threads, [&](size_t b, size_t e)
+            {
+                for (size_t h = b; h < e; h++)
+                {
+                    CKey & k = keys[h];
+                    for (int j = 0; j < 3; j++) k.v[j] = halfface_vertex((int32_t)h, j);
+                    std::sort(k.v, k.v + 3);
+                    k.h = (int32_t)h;
+                }
+            });
+            MeshLib::parallel_sort(keys.begin(), keys.end(), threads, std::less<CKey>());
+
+            t_adj.assign(nh, -1);
+            for (size_t i = 0; i < nh; )
+            {
+                size_t j = i + 1;
+                while (j < nh && std::equal(keys[j].v, keys[j].v + 3, keys[i].v)) j++;
+                if (j - i == 2)
+                {
+                    t_adj[keys[i].h] = keys[i + 1].h;
+                    t_adj[keys[i + 1].h] = keys[i].h;
+                }
+                i = j;
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,597 @@
+/*!
+*      \file dynamictmesh.h
+*      \brief Tet mesh improvement in place by flips and vertex smoothing
+*
+*      CDynamicTMesh adds the local operators of tet meshes to CCompactTMesh:
+*      the 2-3 flip, which swaps a face shared by two tets for the edge
+*      joining their far vertices, the 3-2 flip, which removes an edge of
+*      three tets, and the 4-4 flip, which moves an edge of four tets to the
+*      other diagonal of its ring. flip() and smooth() apply them, and move
+*      vertices to where the tets around them are better, at the tets whose
+*      quality is below a threshold, in rounds. Every round finds the best
+*      move at each such tet or vertex in parallel, and applies at once the
+*      moves that touch no vertex of a more urgent one, worst tets first, so
+*      the moves made together change disjoint tets. The signs of the new
+*      tets are exact, a move that would turn a tet flat or inverted is not
+*      made.
+*/
+
+#ifndef _TMESHLIB_DYNAMIC_TMESH_H_
+#define _TMESHLIB_DYNAMIC_TMESH_H_
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+
+#include "compacttmesh.h"
+#include "../Geometry/Predicates.h"
+#include "../parser/parallel.h"
+
+namespace TMeshLib
+{
+
+    /*!
+     *  \brief CDynamicTMesh class, CCompactTMesh with flips and smoothing
+     *
+     *  The mesh is assumed embedded, its tets positively oriented. A 3-2 flip
+     *  leaves the slot of the tet it removes dead, vertex -1, until sweep()
+     *  drops it; flip() and smooth() sweep before they return. New tets take
+     *  the ids of the tets they replace, the tet a 2-3 flip adds has id -1
+     *  until sweep() numbers it after the largest.
+     */
+    class CDynamicTMesh : public CCompactTMesh
+    {
+    public:
+        bool alive(int32_t t) const { return t_vert[4 * (size_t)t] >= 0; }
+
+        /*! 2-3 flip of the face of halfface h, false if it is on the boundary or a new tet would not be positive */
+        bool flip23(int32_t h)
+        {
+            COp op;
+            if (!_face_op(h, op)) return false;
+            _commit(op);
+            return true;
+        }
+        /*! 3-2 flip of edge k of tet t, false unless it is inside and of three tets, and the two new ones positive */
+        bool flip32(int32_t t, int k)
+        {
+            COp op;
+            if (!_edge_op(t, k, 3, 0, op)) return false;
+            _commit(op);
+            return true;
+        }
+        /*! 4-4 flip of edge k of tet t to the diagonal of its ring from its vertex diagonal = 0 or 1 */
+        bool flip44(int32_t t, int k, int diagonal)
+        {
+            COp op;
+            if (!_edge_op(t, k, 4, diagonal, op)) return false;
+            _commit(op);
+            return true;
+        }
+
+        /*!
+         *  Flip at the tets of quality below threshold, in rounds, a flip only
+         *  if it raises the worst quality of the tets it replaces
+         *  \param rounds  the most rounds, fewer if a round flips nothing
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return the number of flips
+         */
+        size_t flip(double threshold = 0.3, int rounds = 16, int threads = 0);
+
+        /*!
+         *  Move the inner vertices of the tets of quality below threshold
+         *  towards the mean of their neighbors, as far as that raises the
+         *  worst quality of their tets, in rounds
+         *  \return the number of moves
+         */
+        size_t smooth(double threshold = 0.3, int rounds = 8, int threads = 0);
+
+        /*! flip() and smooth() in turn until neither changes anything or passes are done, the number of changes */
+        size_t improve(double threshold = 0.3, int passes = 4, int threads = 0)
+        {
+            size_t all = 0;
+            for (int pass = 0; pass < passes; pass++)
+            {
+                const size_t n = flip(threshold, 16, threads) + smooth(threshold, 8, threads);
+                all += n;
+                if (n == 0) break;
+            }
+            return all;
+        }
+
+        /*! drop the dead tets and number the new ones, the number dropped */
+        size_t sweep();
+
+        /*!
+         *  The mean ratio 12 (3 V)^(2/3) over the sum of the squared edge
+         *  lengths, 1 for the regular tet, 0 for a flat one and negative for
+         *  an inverted one
+         */
+        static double quality(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d)
+        {
+            const CPoint u = b - a, v = c - a, w = d - a, x = c - b, y = d - b, z = d - c;
+            const double l = u * u + v * v + w * w + x * x + y * y + z * z;
+            if (l <= 0) return 0;
+            const double V = u * (v ^ w) / 6;
+            return 12 * std::copysign(std::cbrt(9 * V * V), V) / l;
+        }
+
+    protected:
+        /*! a flip, the tets it replaces and those it makes, and their worst qualities */
+        struct COp
+        {
+            int32_t old[4];
+            int32_t tets[16];
+            int32_t verts[6];
+            int n_old = 0, n_new = 0, n_verts = 0;
+            double before = 0, after = -DBL_MAX;
+        };
+
+        double _quality(const int32_t * v) const { return quality(v_pos[v[0]], v_pos[v[1]], v_pos[v[2]], v_pos[v[3]]); }
+        bool _positive(const int32_t * v) const { return MeshLib::CPredicates::orient3d(v_pos[v[0]], v_pos[v[1]], v_pos[v[2]], v_pos[v[3]]) > 0; }
+
+        int _local(int32_t t, int32_t v) const
+        {
+            const int32_t * p = &t_vert[4 * (size_t)t];
+            return p[0] == v ? 0 : p[1] == v ? 1 : p[2] == v ? 2 : 3;
+        }
+
+        /*!
+         *  The tets around edge k of t, tet i being (a, b, c[i], c[i + 1]), t first
+         *  \return their number, 0 if the edge is on the boundary or has more than four
+         */
+        int _ring(int32_t t, int k, int32_t & a, int32_t & b, int32_t c[5], int32_t tets[4]) const;
+
+        /*! the worst qualities before and after, false if a new tet is not positive */
+        bool _score(COp & op) const;
+        /*! plan the 2-3 flip of halfface h */
+        bool _face_op(int32_t h, COp & op) const;
+        /*! plan the flip of edge k of t if it has m tets around it */
+        bool _edge_op(int32_t t, int k, int m, int diagonal, COp & op) const;
+        /*! the best flip at tet t, n_new = 0 if none raises the worst quality */
+        void _best(int32_t t, COp & op) const;
+
+        /*! put the new tets of op in slots, n_new of them, and link them to the tets around, the cavity is op's alone */
+        void _apply(const COp & op, const int32_t * slots);
+        /*! apply op alone, a new tet at the end */
+        void _commit(const COp & op);
+
+        /*! move v towards the mean of its neighbors, star the tets around it, if that raises their worst quality above worst */
+        bool _relocate(int32_t v, const int32_t * star, const int32_t * star_end, double worst);
+
+        static void _claim(std::atomic<uint32_t> & c, uint32_t rank)
+        {
+            uint32_t x = c.load(std::memory_order_relaxed);
+            while (rank < x && !c.compare_exchange_weak(x, rank, std::memory_order_relaxed));
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline int CDynamicTMesh::_ring(int32_t t, int k, int32_t & a, int32_t & b, int32_t c[5], int32_t tets[4]) const
+    {
+        // for edge k, the other two corners in the order that keeps the tet positive with the edge first
+        static const int opposite[6][2] = { { 2, 3 }, { 3, 1 }, { 1, 2 }, { 0, 3 }, { 2, 0 }, { 0, 1 } };
+        static const int edge[6][2] = { { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+        const int32_t * v = &t_vert[4 * (size_t)t];
+        a = v[edge[k][0]];
+        b = v[edge[k][1]];
+        c[0] = v[opposite[k][0]];
+        c[1] = v[opposite[k][1]];
+        tets[0] = t;
+        // the next tet is across the face opposite c[i], its corner off that face is c[i + 2]
+        for (int i = 0; ; i++)
+        {
+            const int32_t h = t_adj[4 * (size_t)tets[i] + _local(tets[i], c[i])];
+            if (h < 0) return 0;
+            if ((h >> 2) == t) return i + 1;
+            if (i == 3) return 0;
+            tets[i + 1] = h >> 2;
+            c[i + 2] = t_vert[h];
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CDynamicTMesh::_score(COp & op) const
+    {
+        op.before = DBL_MAX;
+        for (int i = 0; i < op.n_old; i++) op.before = std::min(op.before, _quality(&t_vert[4 * (size_t)op.old[i]]));
+        op.after = DBL_MAX;
+        for (int i = 0; i < op.n_new; i++)
+        {
+            if (!_positive(op.tets + 4 * i)) return false;
+            op.after = std::min(op.after, _quality(op.tets + 4 * i));
+        }
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CDynamicTMesh::_face_op(int32_t h, COp & op) const
+    {
+        const int32_t d = t_adj[h];
+        if (d < 0) return false;
+        const int32_t a = t_vert[h], b = t_vert[d];
+        const int32_t p = halfface_vertex(h, 0), q = halfface_vertex(h, 1), r = halfface_vertex(h, 2);
+        if (a == b) return false;
+
+        // (p, q, r, b) is positive, each of p, q, r in turn gives way to a
+        const int32_t tets[12] = { a, q, r, b, p, a, r, b, p, q, a, b };
+        std::copy(tets, tets + 12, op.tets);
+        op.old[0] = h >> 2;
+        op.old[1] = d >> 2;
+        const int32_t verts[5] = { a, b, p, q, r };
+        std::copy(verts, verts + 5, op.verts);
+        op.n_old = 2;
+        op.n_new = 3;
+        op.n_verts = 5;
+        return _score(op);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CDynamicTMesh::_edge_op(int32_t t, int k, int m, int diagonal, COp & op) const
+    {
+        int32_t a, b, c[5];
+        if (_ring(t, k, a, b, c, op.old) != m) return false;
+
+        // the triangles of the ring, each (x, y, z) makes (x, y, z, b) and (y, x, z, a)
+        static const int triangles[3][2][3] = { { { 0, 1, 2 } }, { { 0, 1, 2 }, { 0, 2, 3 } }, { { 1, 2, 3 }, { 1, 3, 0 } } };
+        const int (*tri)[3] = triangles[m == 3 ? 0 : 1 + diagonal];
+        op.n_new = 0;
+        for (int i = 0; i < m - 2; i++)
+        {
+            const int32_t x = c[tri[i][0]], y = c[tri[i][1]], z = c[tri[i][2]];
+            const int32_t tets[8] = { x, y, z, b, y, x, z, a };
+            std::copy(tets, tets + 8, op.tets + 4 * op.n_new);
+            op.n_new += 2;
+        }
+        op.verts[0] = a;
+        op.verts[1] = b;
+        std::copy(c, c + m, op.verts + 2);
+        op.n_old = m;
+        op.n_verts = m + 2;
+        return _score(op);
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CDynamicTMesh::_best(int32_t t, COp & best) const
+    {
+        best.n_new = 0;
+        COp op;
+        auto consider = [&](bool valid)
+        {
+            if (valid && op.after > op.before && (best.n_new == 0 || op.after > best.after)) best = op;
+        };
+        for (int i = 0; i < 4; i++) consider(_face_op(4 * t + i, op));
+        for (int k = 0; k < 6; k++)
+        {
+            int32_t a, b, c[5], tets[4];
+            const int m = _ring(t, k, a, b, c, tets);
+            if (m == 3) consider(_edge_op(t, k, 3, 0, op));
+            if (m == 4)
+            {
+                consider(_edge_op(t, k, 4, 0, op));
+                consider(_edge_op(t, k, 4, 1, op));
+            }
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CDynamicTMesh::_apply(const COp & op, const int32_t * slots)
+    {
+        // the faces of the cavity and what lies across them, read before the slots are written
+        struct CFace { int32_t v[3]; int32_t h; };
+        CFace outside[8];
+        int n_outside = 0;
+        for (int i = 0; i < op.n_old; i++)
+            for (int f = 0; f < 4; f++)
+            {
+                const int32_t h = 4 * op.old[i] + f, d = t_adj[h];
+                if (d >= 0 && std::find(op.old, op.old + op.n_old, d >> 2) != op.old + op.n_old) continue;
+                CFace & face = outside[n_outside++];
+                for (int j = 0; j < 3; j++) face.v[j] = halfface_vertex(h, j);
+                std::sort(face.v, face.v + 3);
+                face.h = d;
+            }
+
+        for (int i = 0; i < op.n_new; i++)
+        {
+            std::copy(op.tets + 4 * i, op.tets + 4 * i + 4, &t_vert[4 * (size_t)slots[i]]);
+            t_id[slots[i]] = i < op.n_old ? t_id[op.old[i]] : -1;
+        }
+        for (int i = op.n_new; i < op.n_old; i++)
+        {
+            std::fill(&t_vert[4 * (size_t)op.old[i]], &t_vert[4 * (size_t)op.old[i]] + 4, -1);
+            std::fill(&t_adj[4 * (size_t)op.old[i]], &t_adj[4 * (size_t)op.old[i]] + 4, -1);
+            t_id[op.old[i]] = -1;
+        }
+
+        // every face of a new tet is a face of the cavity or of another new tet
+        auto key = [&](int32_t h, int32_t v[3])
+        {
+            for (int j = 0; j < 3; j++) v[j] = halfface_vertex(h, j);
+            std::sort(v, v + 3);
+        };
+        for (int i = 0; i < op.n_new; i++)
+            for (int f = 0; f < 4; f++)
+            {
+                const int32_t h = 4 * slots[i] + f;
+                int32_t v[3];
+                key(h, v);
+                bool linked = false;
+                for (int j = 0; j < n_outside && !linked; j++)
+                    if (std::equal(v, v + 3, outside[j].v))
+                    {
+                        t_adj[h] = outside[j].h;
+                        if (outside[j].h >= 0) t_adj[outside[j].h] = h;
+                        linked = true;
+                    }
+                for (int j = 0; j < op.n_new && !linked; j++)
+                    for (int g = 0; g < 4 && j != i && !linked; g++)
+                    {
+                        int32_t w[3];
+                        key(4 * slots[j] + g, w);
+                        if (std::equal(v, v + 3, w))
+                        {
+                            t_adj[h] = 4 * slots[j] + g;
+                            linked = true;
+                        }
+                    }
+            }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CDynamicTMesh::_commit(const COp & op)
+    {
+        int32_t slots[4];
+        std::copy(op.old, op.old + std::min(op.n_old, op.n_new), slots);
+        for (int i = op.n_old; i < op.n_new; i++)
+        {
+            slots[i] = (int32_t)t_id.size();
+            t_id.push_back(-1);
+            t_vert.resize(t_vert.size() + 4);
+            t_adj.resize(t_adj.size() + 4);
+        }
+        _apply(op, slots);
+        e_vert.clear();
+        t_edge.clear();
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline size_t CDynamicTMesh::flip(double threshold, int rounds, int threads)
+    {
+        const uint32_t none = UINT32_MAX;
+        std::vector<std::atomic<uint32_t>> claim(v_pos.size());
+        for (auto & c : claim) c.store(none, std::memory_order_relaxed);
+        std::vector<int32_t> bad, order, winners, slots, free;
+        std::vector<COp> ops;
+        std::vector<uint8_t> low;
+        size_t done = 0;
+
+        for (int round = 0; round < rounds; round++)
+        {
+            low.resize(t_id.size());
+            MeshLib::parallel_for(t_id.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t t = b; t < e; t++) low[t] = alive((int32_t)t) && _quality(&t_vert[4 * t]) < threshold;
+            }, 1 << 12);
+            bad.clear();
+            for (size_t t = 0; t < t_id.size(); t++)
+                if (low[t]) bad.push_back((int32_t)t);
+            ops.assign(bad.size(), COp());
+            MeshLib::parallel_for(bad.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) _best(bad[i], ops[i]);
+            }, 1 << 8);
+
+            // worst first, each flip claims its vertices for the most urgent flip that wants them
+            order.clear();
+            for (size_t i = 0; i < ops.size(); i++)
+                if (ops[i].n_new) order.push_back((int32_t)i);
+            if (order.empty()) break;
+            std::sort(order.begin(), order.end(), [&](int32_t x, int32_t y)
+            {
+                return ops[x].before != ops[y].before ? ops[x].before < ops[y].before : x < y;
+            });
+            MeshLib::parallel_for(order.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t r = b; r < e; r++)
+                {
+                    const COp & op = ops[order[r]];
+                    for (int j = 0; j < op.n_verts; j++) _claim(claim[op.verts[j]], (uint32_t)r);
+                }
+            }, 1 << 10);
+
+            // the flips holding all their vertices, slots for the tets they add
+            winners.clear();
+            slots.clear();
+            for (size_t r = 0; r < order.size(); r++)
+            {
+                const COp & op = ops[order[r]];
+                bool won = true;
+                for (int j = 0; j < op.n_verts && won; j++) won = claim[op.verts[j]].load(std::memory_order_relaxed) == r;
+                if (!won) continue;
+                winners.push_back(order[r]);
+                for (int i = 0; i < 4; i++)
+                {
+                    int32_t s = -1;
+                    if (i < std::min(op.n_old, op.n_new)) s = op.old[i];
+                    else if (i < op.n_new)
+                    {
+                        if (!free.empty()) { s = free.back(); free.pop_back(); }
+                        else
+                        {
+                            s = (int32_t)t_id.size();
+                            t_id.push_back(-1);
+                        }
+                    }
+                    slots.push_back(s);
+                }
+            }
+            t_vert.resize(4 * t_id.size());
+            t_adj.resize(4 * t_id.size());
+
+            MeshLib::parallel_for(winners.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) _apply(ops[winners[i]], &slots[4 * i]);
+            }, 1 << 8);
+
+            for (int32_t w : winners)
+                for (int i = ops[w].n_new; i < ops[w].n_old; i++) free.push_back(ops[w].old[i]);
+            MeshLib::parallel_for(order.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t r = b; r < e; r++)
+                {
+                    const COp & op = ops[order[r]];
+                    for (int j = 0; j < op.n_verts; j++) claim[op.verts[j]].store(none, std::memory_order_relaxed);
+                }
+            }, 1 << 10);
+            done += winners.size();
+        }
+
+        e_vert.clear();
+        t_edge.clear();
+        sweep();
+        return done;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CDynamicTMesh::_relocate(int32_t v, const int32_t * star, const int32_t * star_end, double worst)
+    {
+        CPoint target(0, 0, 0);
+        for (const int32_t * t = star; t != star_end; t++)
+            for (int k = 0; k < 4; k++) target += v_pos[t_vert[4 * (size_t)*t + k]];
+        const CPoint p = v_pos[v];
+        const double others = 3.0 * (star_end - star);
+        target = (target - p * (double)(star_end - star)) / others;
+
+        // the step halves until the worst tet around v is better than it was
+        for (double step = 1; step > 1.0 / 16; step /= 2)
+        {
+            v_pos[v] = p + (target - p) * step;
+            double q = DBL_MAX;
+            for (const int32_t * t = star; t != star_end && q > worst; t++)
+            {
+                const int32_t * c = &t_vert[4 * (size_t)*t];
+                q = _positive(c) ? std::min(q, _quality(c)) : -DBL_MAX;
+            }
+            if (q > worst) return true;
+        }
+        v_pos[v] = p;
+        return false;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline size_t CDynamicTMesh::smooth(double threshold, int rounds, int threads)
+    {
+        const size_t nv = v_pos.size(), nt = t_id.size();
+
+        // the tets around every vertex, and the vertices of the boundary, which stay
+        std::vector<int32_t> outer(nv + 1, 0), star;
+        std::vector<uint8_t> fixed(nv, 0);
+        for (size_t t = 0; t < nt; t++)
+            if (alive((int32_t)t))
+                for (int k = 0; k < 4; k++)
+                {
+                    outer[t_vert[4 * t + k] + 1]++;
+                    if (t_adj[4 * t + k] < 0)
+                        for (int j = 0; j < 3; j++) fixed[halfface_vertex((int32_t)(4 * t + k), j)] = 1;
+                }
+        for (size_t v = 0; v < nv; v++) outer[v + 1] += outer[v];
+        star.resize(outer[nv]);
+        std::vector<int32_t> fill(outer.begin(), outer.end() - 1);
+        for (size_t t = 0; t < nt; t++)
+            if (alive((int32_t)t))
+                for (int k = 0; k < 4; k++) star[fill[t_vert[4 * t + k]]++] = (int32_t)t;
+
+        std::vector<double> worst(nv);
+        std::vector<uint32_t> rank(nv);
+        std::vector<int32_t> order;
+        std::vector<uint8_t> moved(nv);
+        size_t done = 0;
+        for (int round = 0; round < rounds; round++)
+        {
+            MeshLib::parallel_for(nv, threads, [&](size_t b, size_t e)
+            {
+                for (size_t v = b; v < e; v++)
+                {
+                    worst[v] = DBL_MAX;
+                    if (fixed[v]) continue;
+                    for (int32_t i = outer[v]; i < outer[v + 1]; i++) worst[v] = std::min(worst[v], _quality(&t_vert[4 * (size_t)star[i]]));
+                }
+            }, 1 << 10);
+
+            // worst first, a vertex moves if no neighbor before it wants to
+            order.clear();
+            for (size_t v = 0; v < nv; v++)
+                if (worst[v] < threshold) order.push_back((int32_t)v);
+            if (order.empty()) break;
+            std::sort(order.begin(), order.end(), [&](int32_t x, int32_t y)
+            {
+                return worst[x] != worst[y] ? worst[x] < worst[y] : x < y;
+            });
+            std::fill(rank.begin(), rank.end(), UINT32_MAX);
+            for (size_t r = 0; r < order.size(); r++) rank[order[r]] = (uint32_t)r;
+
+            MeshLib::parallel_for(order.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t r = b; r < e; r++)
+                {
+                    const int32_t v = order[r];
+                    bool first = true;
+                    for (int32_t i = outer[v]; i < outer[v + 1] && first; i++)
+                        for (int k = 0; k < 4; k++) first = first && rank[t_vert[4 * (size_t)star[i] + k]] >= r;
+                    moved[v] = first && _relocate(v, &star[outer[v]], &star[0] + outer[v + 1], worst[v]);
+                }
+            }, 1 << 8);
+
+            size_t n = 0;
+            for (int32_t v : order) n += moved[v];
+            done += n;
+            if (n == 0) break;
+        }
+        sweep();
+        return done;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline size_t CDynamicTMesh::sweep()
+    {
+        const size_t n = t_id.size();
+        std::vector<int32_t> index(n, -1);
+        int32_t kept = 0, id = -1;
+        for (size_t t = 0; t < n; t++)
+        {
+            if (alive((int32_t)t)) index[t] = kept++;
+            id = std::max(id, t_id[t]);
+        }
+        id++;
+
+        // in place, a tet moves to a slot no later than its own
+        for (size_t t = 0; t < n; t++)
+        {
+            const int32_t s = index[t];
+            if (s < 0) continue;
+            for (int k = 0; k < 4; k++)
+            {
+                const int32_t h = t_adj[4 * t + k];
+                t_vert[4 * (size_t)s + k] = t_vert[4 * t + k];
+                t_adj[4 * (size_t)s + k] = h < 0 ? -1 : 4 * index[h >> 2] + (h & 3);
+            }
+            t_id[s] = t_id[t] >= 0 ? t_id[t] : id++;
+        }
+        t_vert.resize(4 * (size_t)kept);
+        t_adj.resize(4 * (size_t)kept);
+        t_id.resize(kept);
+        if ((size_t)kept != n)
+        {
+            e_vert.clear();
+            t_edge.clear();
+        }
+        return n - kept;
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,407 @@
+/*!
+*      \file tassembly.h
+*      \brief Stiffness and mass matrices of linear elements on tetrahedral meshes
+*
+*      The pattern, a row per vertex and component with the vertices of its
+*      tets, is laid out once from the connectivity, with the place of every
+*      entry of every tet in it, and the tets are colored so that no two of a
+*      color share a vertex. Assembling computes the element matrices of a
+*      color in batches of four tets, a lane per tet, so that the kernel
+*      vectorizes, and adds them into the rows in parallel: the tets of a
+*      color write rows no other tet of the color writes, so no entry is
+*      written by two threads and there are no atomics. The rows are those of
+*      Eigen::SparseMatrix<double, RowMajor, int>, which views them in place
+*      when MESHLIB_EIGEN is defined, ready for its sparse solvers.
+*/
+
+#ifndef _TMESHLIB_TASSEMBLY_H_
+#define _TMESHLIB_TASSEMBLY_H_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+#include "../Geometry/Point.h"
+#include "../parser/parallel.h"
+#include "compacttmesh.h"
+
+#ifdef MESHLIB_EIGEN
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace TMeshLib
+{
+
+    /*!
+     *  \brief CTAssembly class, the stiffness K and consistent mass M of linear tets
+     *
+     *  For LAPLACE, K(i, j) is the integral of grad phi_i . grad phi_j, so K is
+     *  symmetric positive semi-definite, and M(i, j) that of phi_i phi_j. For
+     *  ELASTICITY the unknowns are the three displacements of every vertex, row
+     *  3 i + c for component c of vertex i, K is that of isotropic linear
+     *  elasticity with the Lame parameters of the material, and M has the mass
+     *  of LAPLACE on the diagonal of every 3 x 3 block.
+     */
+    class CTAssembly
+    {
+    public:
+        /*! the operator assembled */
+        enum Operator
+        {
+            LAPLACE,    //!< one unknown per vertex
+            ELASTICITY  //!< three displacements per vertex
+        };
+
+        /*!
+         *  Lay out the pattern and color the tets, again after the connectivity changed
+         *  \param tets     four vertex indices per tet
+         *  \param vertices number of vertices, every index is below it
+         *  \param threads  number of threads, 0 uses all hardware threads
+         */
+        void build(const int32_t * tets, size_t n, size_t vertices, Operator op = LAPLACE, int threads = 0);
+        /*! build over the tets of a CCompactTMesh, vertex i its point i */
+        void build(const CCompactTMesh & mesh, Operator op = LAPLACE, int threads = 0)
+        {
+            build(mesh.t_vert.data(), (size_t)mesh.num_tets(), mesh.v_pos.size(), op, threads);
+        }
+        /*! build over the tets of a CBaseTMesh, vertex i the i-th of vertices() */
+        template<typename M>
+        void build(M & mesh, Operator op = LAPLACE, int threads = 0);
+
+        /*!
+         *  Fill the values from the points, the pattern stays
+         *  \param points a point per vertex
+         */
+        void assemble(const CPoint * points, int threads = 0);
+        void assemble(const CCompactTMesh & mesh, int threads = 0) { assemble(mesh.v_pos.data(), threads); }
+        template<typename M>
+        void assemble(M & mesh, int threads = 0);
+
+        /*! the Lame parameters of ELASTICITY from Young's modulus and Poisson's ratio, 1 and 0 unless set */
+        void set_material(double young, double poisson)
+        {
+            m_lambda = young * poisson / ((1 + poisson) * (1 - 2 * poisson));
+            m_mu = young / (2 * (1 + poisson));
+        }
+
+        /*! number of rows and columns, the number of vertices times that of components */
+        size_t size() const { return m_outer.empty() ? 0 : m_outer.size() - 1; }
+        /*! unknowns per vertex */
+        int components() const { return m_op == ELASTICITY ? 3 : 1; }
+        /*! number of colors of the tets */
+        size_t colors() const { return m_color_outer.empty() ? 0 : m_color_outer.size() - 1; }
+
+        /*! the entries of row i are at [outer()[i], outer()[i + 1]), columns ascending, the same for K and M */
+        const std::vector<int> & outer() const { return m_outer; }
+        const std::vector<int> & inner() const { return m_inner; }
+        const std::vector<double> & stiffness() const { return m_stiffness; }
+        const std::vector<double> & mass() const { return m_mass; }
+
+#ifdef MESHLIB_EIGEN
+        typedef Eigen::SparseMatrix<double, Eigen::RowMajor, int> CSparse;
+
+        /*! K in place, valid until the next build */
+        Eigen::Map<const CSparse> eigen_stiffness() const
+        {
+            return Eigen::Map<const CSparse>((int)size(), (int)size(), (int)m_stiffness.size(),
+                m_outer.data(), m_inner.data(), m_stiffness.data());
+        }
+        /*! M in place, valid until the next build */
+        Eigen::Map<const CSparse> eigen_mass() const
+        {
+            return Eigen::Map<const CSparse>((int)size(), (int)size(), (int)m_mass.size(),
+                m_outer.data(), m_inner.data(), m_mass.data());
+        }
+#endif
+
+        //! tets whose element matrices are computed together, a lane each
+        static const int s_lanes = 4;
+
+    protected:
+        Operator m_op = LAPLACE;
+        double m_lambda = 0;
+        double m_mu = 0.5;
+
+        //! the neighbors of every vertex, itself among them, ascending
+        std::vector<int> m_vertex_outer;
+        std::vector<int> m_vertex_inner;
+
+        std::vector<int> m_outer;
+        std::vector<int> m_inner;
+        std::vector<double> m_stiffness;
+        std::vector<double> m_mass;
+
+        //! the tets by color, those of color c at [m_color_outer[c], m_color_outer[c + 1])
+        std::vector<int32_t> m_tets;
+        std::vector<size_t> m_color_outer;
+        //! for entry 4 a + b of every tet, in the order of m_tets, the neighbor entry of its vertex b in the row of its vertex a
+        std::vector<int> m_slots;
+
+        std::vector<CPoint> m_points;
+
+        static int _lowest(uint64_t x)
+        {
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanForward64(&i, x);
+            return (int)i;
+#else
+            return __builtin_ctzll(x);
+#endif
+        }
+
+        /*! color the tets, greedily, 64 colors at a time over the tets the colors before left */
+        void _color(const int32_t * tets, size_t n, size_t vertices, std::vector<int32_t> & color) const;
+        /*! the element matrices of count tets from first on in m_tets, added into the rows */
+        void _batch(const CPoint * points, size_t first, int count);
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline void CTAssembly::_color(const int32_t * tets, size_t n, size_t vertices, std::vector<int32_t> & color) const
+    {
+        color.assign(n, -1);
+        std::vector<int32_t> left(n), rest;
+        for (size_t t = 0; t < n; t++) left[t] = (int32_t)t;
+        std::vector<uint64_t> used(vertices);
+        for (int32_t base = 0; !left.empty(); base += 64)
+        {
+            std::fill(used.begin(), used.end(), 0);
+            rest.clear();
+            for (int32_t t : left)
+            {
+                const int32_t * v = tets + 4 * (size_t)t;
+                const uint64_t taken = used[v[0]] | used[v[1]] | used[v[2]] | used[v[3]];
+                if (taken == ~uint64_t(0))
+                {
+                    rest.push_back(t);
+                    continue;
+                }
+                const int c = _lowest(~taken);
+                color[t] = base + c;
+                for (int k = 0; k < 4; k++) used[v[k]] |= uint64_t(1) << c;
+            }
+            left.swap(rest);
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CTAssembly::build(const int32_t * tets, size_t n, size_t vertices, Operator op, int threads)
+    {
+        m_op = op;
+        const int c = components();
+
+        // the tets around every vertex
+        std::vector<int> tet_outer(vertices + 1, 0), vertex_tets(4 * n);
+        for (size_t k = 0; k < 4 * n; k++) tet_outer[tets[k] + 1]++;
+        for (size_t i = 0; i < vertices; i++) tet_outer[i + 1] += tet_outer[i];
+        std::vector<int> fill(tet_outer.begin(), tet_outer.end() - 1);
+        for (size_t k = 0; k < 4 * n; k++) vertex_tets[fill[tets[k]]++] = (int)(k / 4);
+
+        // the neighbors of every vertex, counted first and then written where the counts put them
+        m_vertex_outer.assign(vertices + 1, 0);
+        auto neighbors = [&](size_t i, std::vector<int> & list)
+        {
+            list.assign(1, (int)i);
+            for (int k = tet_outer[i]; k < tet_outer[i + 1]; k++) list.insert(list.end(), tets + 4 * (size_t)vertex_tets[k], tets + 4 * (size_t)vertex_tets[k] + 4);
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+        };
+        MeshLib::parallel_for(vertices, threads, [&](size_t b, size_t e)
+        {
+            std::vector<int> list;
+            for (size_t i = b; i < e; i++)
+            {
+                neighbors(i, list);
+                m_vertex_outer[i + 1] = (int)list.size();
+            }
+        }, 1 << 10);
+        for (size_t i = 0; i < vertices; i++) m_vertex_outer[i + 1] += m_vertex_outer[i];
+        m_vertex_inner.resize(m_vertex_outer[vertices]);
+        MeshLib::parallel_for(vertices, threads, [&](size_t b, size_t e)
+        {
+            std::vector<int> list;
+            for (size_t i = b; i < e; i++)
+            {
+                neighbors(i, list);
+                std::copy(list.begin(), list.end(), m_vertex_inner.begin() + m_vertex_outer[i]);
+            }
+        }, 1 << 10);
+
+        // row c i + s has the components of the neighbors of i, c entries a neighbor
+        m_outer.assign(c * vertices + 1, 0);
+        for (size_t i = 0; i < vertices; i++)
+        {
+            const int degree = m_vertex_outer[i + 1] - m_vertex_outer[i];
+            for (int s = 0; s < c; s++) m_outer[c * i + s + 1] = m_outer[c * i + s] + c * degree;
+        }
+        m_inner.resize(m_outer.back());
+        MeshLib::parallel_for(vertices, threads, [&](size_t b, size_t e)
+        {
+            for (size_t i = b; i < e; i++)
+                for (int s = 0; s < c; s++)
+                {
+                    int * row = &m_inner[m_outer[c * i + s]];
+                    for (int k = m_vertex_outer[i]; k < m_vertex_outer[i + 1]; k++)
+                        for (int r = 0; r < c; r++) *row++ = c * m_vertex_inner[k] + r;
+                }
+        }, 1 << 10);
+        m_stiffness.assign(m_inner.size(), 0.0);
+        m_mass.assign(m_inner.size(), 0.0);
+
+        // the tets by color, and the place of their entries among the neighbors
+        std::vector<int32_t> color;
+        _color(tets, n, vertices, color);
+        const int32_t colors = n ? *std::max_element(color.begin(), color.end()) + 1 : 0;
+        m_color_outer.assign(colors + 1, 0);
+        for (int32_t k : color) m_color_outer[k + 1]++;
+        for (int32_t k = 0; k < colors; k++) m_color_outer[k + 1] += m_color_outer[k];
+        std::vector<size_t> at(m_color_outer.begin(), m_color_outer.end() - 1);
+        m_tets.resize(4 * n);
+        for (size_t t = 0; t < n; t++) std::copy(tets + 4 * t, tets + 4 * t + 4, &m_tets[4 * at[color[t]]++]);
+        m_slots.resize(16 * n);
+        MeshLib::parallel_for(n, threads, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                const int32_t * v = &m_tets[4 * t];
+                for (int a = 0; a < 4; a++)
+                {
+                    const int * first = &m_vertex_inner[m_vertex_outer[v[a]]], * last = &m_vertex_inner[m_vertex_outer[v[a] + 1]];
+                    for (int b2 = 0; b2 < 4; b2++) m_slots[16 * t + 4 * a + b2] = (int)(std::lower_bound(first, last, v[b2]) - &m_vertex_inner[0]);
+                }
+            }
+        }, 1 << 12);
+    }
+
+    template<typename M>
+    void CTAssembly::build(M & mesh, Operator op, int threads)
+    {
+        // flat arrays first, as CTQuality reads them
+        std::vector<int32_t> tets;
+        std::unordered_map<const void *, int32_t> index;
+        index.reserve(mesh.vertices().size());
+        for (auto pV : mesh.vertices())
+        {
+            const int32_t i = (int32_t)index.size();
+            index[pV] = i;
+        }
+        tets.reserve(4 * mesh.tets().size());
+        for (auto pT : mesh.tets())
+            for (int k = 0; k < 4; k++) tets.push_back(index[pT->vertex(k)]);
+        build(tets.data(), tets.size() / 4, index.size(), op, threads);
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    With the edges e_k = p_k - p_0 and d = e_1 . (e_2 x e_3), six times the signed volume, the gradients of the barycentric coordinates are
+    g_1 = (e_2 x e_3) / d, g_2 = (e_3 x e_1) / d, g_3 = (e_1 x e_2) / d and g_0 = -(g_1 + g_2 + g_3), and the volume V = |d| / 6. Then
+    K(a, b) = V g_a . g_b and M(a, b) = V (1 + [a = b]) / 20, and for elasticity, components i, j,
+    K(3 a + i, 3 b + j) = V (lambda g_a[i] g_b[j] + mu g_a[j] g_b[i] + mu [i = j] g_a . g_b). A flat tet adds nothing.
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline void CTAssembly::_batch(const CPoint * points, size_t first, int count)
+    {
+        const int L = s_lanes;
+        double e[3][3][s_lanes], g[4][3][s_lanes], volume[s_lanes];
+        for (int l = 0; l < L; l++)
+        {
+            // the lanes past count repeat the last tet, their results are not written
+            const int32_t * v = &m_tets[4 * (first + std::min(l, count - 1))];
+            const CPoint & o = points[v[0]];
+            for (int k = 0; k < 3; k++)
+                for (int x = 0; x < 3; x++) e[k][x][l] = points[v[k + 1]][x] - o[x];
+        }
+        for (int l = 0; l < L; l++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                const int p = (k + 1) % 3, q = (k + 2) % 3;
+                for (int x = 0; x < 3; x++)
+                {
+                    const int y = (x + 1) % 3, z = (x + 2) % 3;
+                    g[k + 1][x][l] = e[p][y][l] * e[q][z][l] - e[p][z][l] * e[q][y][l];
+                }
+            }
+            const double d = e[0][0][l] * g[1][0][l] + e[0][1][l] * g[1][1][l] + e[0][2][l] * g[1][2][l];
+            const double inverse = d != 0 ? 1 / d : 0;
+            volume[l] = std::fabs(d) / 6;
+            for (int k = 1; k < 4; k++)
+                for (int x = 0; x < 3; x++) g[k][x][l] *= inverse;
+            for (int x = 0; x < 3; x++) g[0][x][l] = -(g[1][x][l] + g[2][x][l] + g[3][x][l]);
+        }
+
+        const int c = components();
+        for (int l = 0; l < count; l++)
+        {
+            const size_t t = first + l;
+            const int32_t * v = &m_tets[4 * t];
+            const int * slot = &m_slots[16 * t];
+            const double V = volume[l];
+            for (int a = 0; a < 4; a++)
+            {
+                const int row = m_vertex_outer[v[a]], degree = m_vertex_outer[v[a] + 1] - row;
+                for (int b = 0; b < 4; b++)
+                {
+                    const double dot = g[a][0][l] * g[b][0][l] + g[a][1][l] * g[b][1][l] + g[a][2][l] * g[b][2][l];
+                    const double mass = V * (a == b ? 2 : 1) / 20;
+                    const int k = slot[4 * a + b];
+                    if (c == 1)
+                    {
+                        m_stiffness[k] += V * dot;
+                        m_mass[k] += mass;
+                        continue;
+                    }
+                    // entry j of block k in row 3 i + s is at 9 row + 3 s degree + 3 (k - row) + j
+                    for (int i = 0; i < 3; i++)
+                    {
+                        const size_t entry = 9 * (size_t)row + 3 * (size_t)i * degree + 3 * (size_t)(k - row);
+                        for (int j = 0; j < 3; j++)
+                            m_stiffness[entry + j] += V * (m_lambda * g[a][i][l] * g[b][j][l] + m_mu * g[a][j][l] * g[b][i][l] + (i == j ? m_mu * dot : 0));
+                        m_mass[entry + i] += mass;
+                    }
+                }
+            }
+        }
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline void CTAssembly::assemble(const CPoint * points, int threads)
+    {
+        MeshLib::parallel_for(m_stiffness.size(), threads, [&](size_t b, size_t e)
+        {
+            std::fill(m_stiffness.begin() + b, m_stiffness.begin() + e, 0.0);
+            std::fill(m_mass.begin() + b, m_mass.begin() + e, 0.0);
+        }, 1 << 16);
+
+        // a color at a time, its tets touch rows apart, in batches of lanes
+        for (size_t color = 0; color < colors(); color++)
+        {
+            const size_t first = m_color_outer[color], count = m_color_outer[color + 1] - first;
+            const size_t batches = (count + s_lanes - 1) / s_lanes;
+            MeshLib::parallel_for(batches, threads, [&](size_t b, size_t e)
+            {
+                for (size_t k = b; k < e; k++)
+                    _batch(points, first + s_lanes * k, (int)std::min<size_t>(s_lanes, count - s_lanes * k));
+            }, 1 << 8);
+        }
+    }
+
+    template<typename M>
+    void CTAssembly::assemble(M & mesh, int threads)
+    {
+        m_points.clear();
+        m_points.reserve(mesh.vertices().size());
+        for (auto pV : mesh.vertices()) m_points.push_back(pV->point());
+        assemble(m_points.data(), threads);
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,130 @@
+/*!
+*      \file tboundary.h
+*      \brief Boundary surface of a tetrahedral mesh as indexed triangles
+*
+*      The faces with a single tet are collected in parallel and oriented so
+*      that their normals point out of the volume, whatever the orientation
+*      of the tets in the file. The result feeds CBaseMesh::build_from_arrays
+*      or a vertex / index buffer pair directly.
+*/
+
+#ifndef _TMESHLIB_TBOUNDARY_H_
+#define _TMESHLIB_TBOUNDARY_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "../Geometry/Point.h"
+#include "../Geometry/Point2.h"
+#include "../parser/parallel.h"
+
+namespace TMeshLib
+{
+    using CPoint = MeshLib::CPoint;
+
+    /*!
+     *  \brief CTBoundary class, the boundary surface of a CBaseTMesh
+     *
+     *  Only the vertices on the boundary are kept, numbered in the order of
+     *  their ids.
+     *
+     *  \tparam M a CBaseTMesh
+     */
+    template<typename M>
+    class CTBoundary
+    {
+        using CTet = typename M::CTet;
+        using CVertex = typename M::CVertex;
+
+    public:
+        /*!
+         *  Extract the boundary
+         *  \param points boundary vertex positions
+         *  \param tris three indices into points per boundary face, counterclockwise seen from outside
+         *  \param vertex_ids if not NULL, the tet mesh id of every point
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        static void extract(M & tmesh, std::vector<CPoint> & points, std::vector<int> & tris,
+            std::vector<int> * vertex_ids = NULL, int threads = 0)
+        {
+            points.clear();
+            tris.clear();
+            if (vertex_ids) vertex_ids->clear();
+
+            std::vector<CTet*> tets(tmesh.tets().begin(), tmesh.tets().end());
+            const size_t nt = tets.size();
+
+            // boundary faces per tet, then their offsets
+            std::vector<size_t> first(nt + 1, 0);
+            MeshLib::parallel_for(nt, threads, [&](size_t b, size_t e)
+            {
+                for (size_t t = b; t < e; t++)
+                    for (int i = 0; i < 4; i++)
+                        if (tets[t]->halfface(i)->dual() == NULL) first[t + 1]++;
+            });
+            for (size_t t = 0; t < nt; t++) first[t + 1] += first[t];
+
+            // vertex ids of the oriented triangles
+            tris.resize(3 * first[nt]);
+            MeshLib::parallel_for(nt, threads, [&](size_t b, size_t e)
+            {
+                for (size_t t = b; t < e; t++)
+                {
+                    CTet * pT = tets[t];
+                    int * tri = tris.data() + 3 * first[t];
+                    for (int i = 0; i < 4; i++)
+                    {
+                        if (pT->halfface(i)->dual() != NULL) continue;
+                        CVertex * v[3];
+                        for (int k = 0; k < 3; k++) v[k] = pT->vertex(s_face[i][k]);
+                        const CPoint & p = v[0]->point();
+                        const CPoint n = (v[1]->point() - p) ^ (v[2]->point() - p);
+                        // an inverted tet has its faces pointing inwards
+                        if (n * (pT->vertex(i)->point() - p) > 0) std::swap(v[1], v[2]);
+                        for (int k = 0; k < 3; k++) *tri++ = v[k]->id();
+                    }
+                }
+            });
+
+            // number the boundary vertices by id
+            int max_id = -1;
+            for (int id : tris) max_id = std::max(max_id, id);
+            std::vector<int> index(max_id + 1, -1);
+            for (int id : tris) index[id] = 0;
+            int n = 0;
+            for (int & i : index)
+                if (i == 0) i = n++;
+
+            points.resize(n);
+            if (vertex_ids) vertex_ids->resize(n);
+            for (int id = 0; id <= max_id; id++)
+            {
+                if (index[id] < 0) continue;
+                points[index[id]] = tmesh.vertex(id)->point();
+                if (vertex_ids) (*vertex_ids)[index[id]] = id;
+            }
+
+            MeshLib::parallel_for(tris.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) tris[i] = index[tris[i]];
+            });
+        }
+
+        /*! build the boundary surface into a CBaseMesh */
+        template<typename SM>
+        static void extract(M & tmesh, SM & mesh, int threads = 0)
+        {
+            std::vector<CPoint> points;
+            std::vector<int> tris;
+            extract(tmesh, points, tris, NULL, threads);
+            mesh.build_from_arrays(points, std::vector<MeshLib::CPoint2>(), std::vector<CPoint>(), tris);
+        }
+
+    protected:
+        //! vertices of the halfface opposite vertex i, as CBaseTMesh::_construct_tet orders them
+        static constexpr int s_face[4][3] = { { 1, 2, 3 }, { 2, 0, 3 }, { 0, 1, 3 }, { 1, 0, 2 } };
+    };
+
+}; //namespace
+
+#endif
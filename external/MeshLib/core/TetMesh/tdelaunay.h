@@ -0,0 +1,480 @@
+/*!
+*      \file tdelaunay.h
+*      \brief Delaunay tetrahedralization of a point set
+*
+*      The points are inserted one at a time, Bowyer and Watson: the tets
+*      whose circumspheres hold the new point are removed and the hole is
+*      filled with tets joining its faces to the point. The tet to start from
+*      is found by walking from the last tet made towards the point, so the
+*      points are inserted in a biased randomized order, rounds of doubling
+*      size, each round along the Morton curve: a point is near the one
+*      before it, and the random rounds keep the tets of the early points from
+*      being long and thin. Tets live in flat arrays, the slots of removed
+*      tets are reused by the next ones made. The hull is closed by ghost tets
+*      joining its faces to a vertex at infinity, so every face has two tets
+*      and a point outside the hull is inserted like any other. The signs of
+*      the orientation and of the in sphere test, the orientation of the
+*      points lifted to the paraboloid, are exact, and points on a common
+*      sphere are told apart by moving their lifts by amounts that shrink
+*      with their index, so the tets are those of one Delaunay
+*      tetrahedralization of the points whatever their degeneracies. Points
+*      equal to an earlier one are left out.
+*/
+
+#ifndef _TMESHLIB_TDELAUNAY_H_
+#define _TMESHLIB_TDELAUNAY_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+#include "compacttmesh.h"
+#include "../Geometry/Predicates.h"
+#include "../Geometry/MortonOrder.h"
+#include "../parser/parallel.h"
+#include "../parser/counters.h"
+
+namespace TMeshLib
+{
+
+    /*!
+     *  \brief CTDelaunay class, the Delaunay tets of a point set, positively oriented
+     */
+    class CTDelaunay
+    {
+    public:
+        /*!
+         *  Tetrahedralize the points
+         *  \param threads number of threads for ordering the points, they are inserted by one
+         *  \return false if the points are all on a plane, there are no tets then
+         */
+        bool _tetrahedralize(const std::vector<CPoint> & points, int threads = 0);
+
+        /*! the mesh of the tets, vertex i the point i, the neighbors from the triangulation */
+        void _build(CCompactTMesh & mesh) const;
+
+        /*! build mesh, any empty CBaseTMesh, vertex and tet ids 0-based as CCompactTMesh::build numbers them */
+        template<typename M>
+        void _to_mesh(M & mesh) const
+        {
+            CCompactTMesh compact;
+            _build(compact);
+            compact.to_mesh(mesh);
+        }
+
+        void clear()
+        {
+            m_points.clear();
+            m_vert.clear();
+            m_adj.clear();
+            m_mark.clear();
+            m_free.clear();
+            m_duplicates = 0;
+        }
+
+        /*! four point indices per tet */
+        std::vector<int32_t> tets() const;
+        /*! number of points left out as a copy of an earlier one */
+        size_t duplicates() const { return m_duplicates; }
+
+        //! the rounds of the insertion order stop halving at this many points
+        static const size_t s_first_round = 64;
+
+    protected:
+        //! the vertex at infinity of the ghost tets
+        static const int32_t s_infinite = -1;
+        //! a slot of the edge table whose two faces are joined, no edge has two equal ends
+        static const uint64_t s_taken = ~uint64_t(0);
+
+        /*! the tet whose vertex i is replaced by p positive, p on the side of face i that vertex i is on */
+        double _orient(int32_t t, int i, int32_t p) const
+        {
+            const int32_t * v = &m_vert[4 * (size_t)t];
+            const CPoint * q[4];
+            for (int k = 0; k < 4; k++) q[k] = &m_points[k == i ? p : v[k]];
+            return MeshLib::CPredicates::orient3d(*q[0], *q[1], *q[2], *q[3]);
+        }
+
+        /*! whether p is inside the circumsphere of the finite tet t, never on it */
+        bool _insphere(int32_t t, int32_t p) const;
+        /*! whether tet t is in conflict with p, removed when p is inserted */
+        bool _conflict(int32_t t, int32_t p) const;
+
+        /*! a tet in conflict with p, walking from tet t, -1 if p is a copy of a vertex */
+        int32_t _locate(int32_t t, int32_t p);
+        /*! insert p, false if it is a copy of a vertex */
+        bool _insert(int32_t p);
+
+        /*! a new tet, in the slot of a removed one if there is one */
+        int32_t _tet()
+        {
+            if (!m_free.empty())
+            {
+                const int32_t t = m_free.back();
+                m_free.pop_back();
+                return t;
+            }
+            const int32_t t = (int32_t)m_mark.size();
+            m_vert.resize(m_vert.size() + 4);
+            m_adj.resize(m_adj.size() + 4);
+            m_mark.push_back(0);
+            return t;
+        }
+        void _link(int32_t h, int32_t g)
+        {
+            m_adj[h] = g;
+            m_adj[g] = h;
+        }
+        bool _ghost(int32_t t) const
+        {
+            const int32_t * v = &m_vert[4 * (size_t)t];
+            return v[0] < 0 || v[1] < 0 || v[2] < 0 || v[3] < 0;
+        }
+        /*! whether the tet is alive, removed tets have their first vertex -2 */
+        bool _alive(int32_t t) const { return m_vert[4 * (size_t)t] != -2; }
+
+        static bool _same(const CPoint & a, const CPoint & b) { return a[0] == b[0] && a[1] == b[1] && a[2] == b[2]; }
+
+        static uint64_t _mix(uint64_t x)
+        {
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        std::vector<CPoint>   m_points;
+        //! four vertices a tet, s_infinite in the ghost tets
+        std::vector<int32_t>  m_vert;
+        //! the halfface 4 t' + j across face i of tet t, face i opposite vertex i
+        std::vector<int32_t>  m_adj;
+        //! the insertion that last visited a tet, twice its number, one more if it was not in conflict
+        std::vector<uint32_t> m_mark;
+        std::vector<int32_t>  m_free;
+        uint32_t              m_stamp = 0;
+        int32_t               m_last = 0;
+        uint64_t              m_random = 0;
+        size_t                m_duplicates = 0;
+
+        //while inserting, the tets of the hole, its outer faces, the vertices and outer neighbors of the new tets, and a table of the
+        //new faces on the edges of the hole, keyed by the edge
+        std::vector<int32_t>  m_hole;
+        std::vector<std::pair<int32_t, int32_t>> m_faces;
+        std::vector<int32_t>  m_verts;
+        std::vector<int32_t>  m_across;
+        std::vector<std::pair<uint64_t, int32_t>> m_edges;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CTDelaunay::_tetrahedralize(const std::vector<CPoint> & points, int threads)
+    {
+        clear();
+        m_points = points;
+        const size_t n = points.size();
+        if (n < 4) return false;
+
+        //shuffled, then rounds of half of what is left from the end, each along the Morton curve
+        std::vector<int32_t> order(n);
+        for (size_t i = 0; i < n; i++) order[i] = (int32_t)i;
+        for (size_t i = n - 1; i > 0; i--) std::swap(order[i], order[_mix(i) % (i + 1)]);
+        std::vector<size_t> rounds(1, n);
+        while (rounds.back() > s_first_round) rounds.push_back(rounds.back() / 2);
+        rounds.push_back(0);
+        std::reverse(rounds.begin(), rounds.end());
+        std::vector<CPoint> round;
+        std::vector<int> curve;
+        for (size_t r = 0; r + 1 < rounds.size(); r++)
+        {
+            const size_t b = rounds[r], e = rounds[r + 1];
+            round.resize(e - b);
+            for (size_t i = b; i < e; i++) round[i - b] = points[order[i]];
+            MeshLib::CMortonOrder::sort(round.data(), round.size(), curve, threads);
+            std::vector<int32_t> sorted(e - b);
+            for (size_t i = 0; i < sorted.size(); i++) sorted[i] = order[b + curve[i]];
+            std::copy(sorted.begin(), sorted.end(), order.begin() + b);
+        }
+
+        //the first tet from the first four points in the order that are not on a plane
+        int32_t first[4] = { order[0], -1, -1, -1 };
+        size_t found[4] = { 0, 0, 0, 0 };
+        for (size_t i = 1; i < n && first[3] < 0; i++)
+        {
+            const int32_t p = order[i];
+            const CPoint & a = points[first[0]], & q = points[p];
+            if (first[1] < 0)
+            {
+                if (!_same(q, a)) { first[1] = p; found[1] = i; }
+            }
+            else if (first[2] < 0)
+            {
+                const CPoint & b = points[first[1]];
+                using MeshLib::CPredicates;
+                if (CPredicates::orient2d(a[0], a[1], b[0], b[1], q[0], q[1]) != 0 || CPredicates::orient2d(a[1], a[2], b[1], b[2], q[1], q[2]) != 0 ||
+                    CPredicates::orient2d(a[2], a[0], b[2], b[0], q[2], q[0]) != 0) { first[2] = p; found[2] = i; }
+            }
+            else if (MeshLib::CPredicates::orient3d(a, points[first[1]], points[first[2]], q) != 0)
+            {
+                first[3] = p;
+                found[3] = i;
+            }
+        }
+        if (first[3] < 0)
+        {
+            clear();
+            return false;
+        }
+        if (MeshLib::CPredicates::orient3d(points[first[0]], points[first[1]], points[first[2]], points[first[3]]) < 0) std::swap(first[1], first[2]);
+
+        m_vert.reserve(4 * 7 * n);
+        m_adj.reserve(4 * 7 * n);
+        m_mark.reserve(7 * n);
+        const int32_t t = _tet();
+        std::copy(first, first + 4, &m_vert[0]);
+        //ghost i is the tet with vertex i moved to infinity beyond face i, two of its other vertices swapped to keep it positive
+        for (int i = 0; i < 4; i++)
+        {
+            const int32_t g = _tet();
+            for (int k = 0; k < 4; k++) m_vert[4 * g + k] = k == i ? s_infinite : first[k];
+            std::swap(m_vert[4 * g + (i + 1) % 4], m_vert[4 * g + (i + 2) % 4]);
+            _link(4 * t + i, 4 * g + i);
+        }
+        //ghost i and ghost j share the face of infinity and the two vertices other than i and j
+        auto slot = [&](int32_t g, int32_t v) { int k = 0; while (m_vert[4 * g + k] != v) k++; return 4 * g + k; };
+        for (int i = 0; i < 4; i++)
+            for (int j = i + 1; j < 4; j++) _link(slot(1 + i, first[j]), slot(1 + j, first[i]));
+        m_last = t;
+
+        for (size_t i = 1; i < n; i++)
+        {
+            if (i == found[1] || i == found[2] || i == found[3]) continue;
+            if (!_insert(order[i])) m_duplicates++;
+        }
+        MESHLIB_COUNTER_ADD("delaunay.duplicates", m_duplicates);
+        m_hole = std::vector<int32_t>();
+        m_faces = std::vector<std::pair<int32_t, int32_t>>();
+        m_verts = std::vector<int32_t>();
+        m_across = std::vector<int32_t>();
+        m_edges = std::vector<std::pair<uint64_t, int32_t>>();
+        return true;
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    The in sphere test is the orientation of the five lifted points, see CPredicates::insphere, lifted from the coordinates themselves, so
+    its sign is that of the exact determinant, negative for p inside with the tet positive. When it is 0 the lift of
+    every point is moved up by a tiny amount, the larger the higher its index, so the sign is that of the derivative of the determinant
+    along the lift of the highest index that is not 0. The derivative along a lift is the orientation of the other four points, with a
+    sign, and that of p is the orientation of the tet, which is not 0, so the test never ends on the sphere.
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline bool CTDelaunay::_insphere(int32_t t, int32_t p) const
+    {
+        const int32_t * v = &m_vert[4 * (size_t)t];
+        const double det = MeshLib::CPredicates::insphere(m_points[v[0]], m_points[v[1]], m_points[v[2]], m_points[v[3]], m_points[p]);
+        if (det != 0) return det < 0;
+
+        //the five points by falling index, the derivative along each lift is the orientation of the other four with p in its place
+        int32_t q[5] = { v[0], v[1], v[2], v[3], p };
+        int slot[5] = { 0, 1, 2, 3, 4 };
+        std::sort(slot, slot + 5, [&](int a, int b) { return q[a] > q[b]; });
+        for (int s : slot)
+        {
+            double d;
+            if (s == 4) d = MeshLib::CPredicates::orient3d(m_points[q[0]], m_points[q[1]], m_points[q[2]], m_points[q[3]]);
+            else
+            {
+                const CPoint * r[4];
+                for (int k = 0; k < 4; k++) r[k] = &m_points[k == s ? p : q[k]];
+                d = -MeshLib::CPredicates::orient3d(*r[0], *r[1], *r[2], *r[3]);
+            }
+            if (d != 0) return d < 0;
+        }
+        return false;
+    }
+
+    inline bool CTDelaunay::_conflict(int32_t t, int32_t p) const
+    {
+        const int32_t * v = &m_vert[4 * (size_t)t];
+        int i = 0;
+        while (i < 4 && v[i] != s_infinite) i++;
+        if (i == 4) return _insphere(t, p);
+
+        //a ghost is in conflict with the points beyond its hull face, and on its plane when the tet behind the face is
+        const double o = _orient(t, i, p);
+        if (o != 0) return o > 0;
+        return _insphere(m_adj[4 * (size_t)t + i] >> 2, p);
+    }
+
+    inline int32_t CTDelaunay::_locate(int32_t t, int32_t p)
+    {
+        //the remembering stochastic walk, across a face p is beyond, from a random face on
+        if (_ghost(t))
+        {
+            const int32_t * v = &m_vert[4 * (size_t)t];
+            int i = 0;
+            while (v[i] != s_infinite) i++;
+            t = m_adj[4 * (size_t)t + i] >> 2;
+        }
+        int32_t previous = -1;
+        while (true)
+        {
+            m_random = _mix(m_random);
+            const int start = (int)(m_random & 3);
+            int k = 0;
+            for (; k < 4; k++)
+            {
+                const int i = (start + k) & 3;
+                const int32_t next = m_adj[4 * (size_t)t + i] >> 2;
+                if (next == previous || _orient(t, i, p) >= 0) continue;
+                previous = t;
+                t = next;
+                break;
+            }
+            if (k == 4) break;
+            if (_ghost(t)) return t;
+        }
+        const int32_t * v = &m_vert[4 * (size_t)t];
+        for (int k = 0; k < 4; k++) if (_same(m_points[v[k]], m_points[p])) return -1;
+        return t;
+    }
+
+    /*-------------------------------------------------------------------------------------------------------------------------------------
+
+    The tets in conflict with p are connected, found by a search from the one the walk ended in, and their outer faces are seen from p.
+    Every outer face, face i of a tet of the hole, gives the new tet with vertex i replaced by p, so its orientation stays positive and it
+    keeps the neighbor across face i. The other three faces of a new tet hold p and an edge of the outer face, two new tets share each
+    such edge and are joined across it
+
+    --------------------------------------------------------------------------------------------------------------------------------------*/
+    inline bool CTDelaunay::_insert(int32_t p)
+    {
+        const int32_t start = _locate(m_last, p);
+        if (start < 0) return false;
+
+        m_stamp++;
+        const uint32_t in = 2 * m_stamp, out = in + 1;
+        m_hole.assign(1, start);
+        m_faces.clear();
+        m_mark[start] = in;
+        for (size_t h = 0; h < m_hole.size(); h++)
+        {
+            const int32_t t = m_hole[h];
+            for (int i = 0; i < 4; i++)
+            {
+                const int32_t n = m_adj[4 * (size_t)t + i] >> 2;
+                if (m_mark[n] == in) continue;
+                if (m_mark[n] != out && _conflict(n, p))
+                {
+                    m_mark[n] = in;
+                    m_hole.push_back(n);
+                }
+                else
+                {
+                    m_mark[n] = out;
+                    m_faces.push_back(std::make_pair(t, i));
+                }
+            }
+        }
+        MESHLIB_COUNTER_ADD("delaunay.removed_tets", m_hole.size());
+
+        //the new tets, first in the slots of the hole, its tets are read before they are written
+        std::vector<int32_t> & made = m_hole;
+        const size_t removed = m_hole.size();
+        std::vector<int32_t> & verts = m_verts, & across = m_across;
+        verts.resize(4 * m_faces.size());
+        across.resize(m_faces.size());
+        for (size_t f = 0; f < m_faces.size(); f++)
+        {
+            const int32_t t = m_faces[f].first;
+            const int i = m_faces[f].second;
+            for (int k = 0; k < 4; k++) verts[4 * f + k] = k == i ? p : m_vert[4 * (size_t)t + k];
+            across[f] = m_adj[4 * (size_t)t + i];
+        }
+        for (size_t h = 0; h < removed; h++)
+        {
+            m_free.push_back(made[h]);
+            m_vert[4 * (size_t)made[h]] = -2;
+        }
+        made.clear();
+        size_t size = 64;
+        while (size < 4 * m_faces.size()) size *= 2;
+        if (m_edges.size() < size) m_edges.assign(size, std::make_pair(uint64_t(0), int32_t(0)));
+        const size_t mask = size - 1;
+        for (size_t f = 0; f < m_faces.size(); f++)
+        {
+            const int32_t t = _tet();
+            const int i = m_faces[f].second;
+            std::copy(&verts[4 * f], &verts[4 * f] + 4, &m_vert[4 * (size_t)t]);
+            m_mark[t] = 0;
+            _link(4 * t + i, across[f]);
+            for (int j = 0; j < 4; j++)
+            {
+                if (j == i) continue;
+                uint32_t e[2], k = 0;
+                for (int c = 0; c < 4; c++) if (c != i && c != j) e[k++] = (uint32_t)verts[4 * f + c];
+                if (e[0] > e[1]) std::swap(e[0], e[1]);
+                //the first of the two faces on the edge waits in the table for the second, which takes it out
+                const uint64_t key = (uint64_t)e[0] << 32 | e[1];
+                size_t h = (size_t)(_mix(key) & mask);
+                while (m_edges[h].first != 0 && m_edges[h].first != key) h = (h + 1) & mask;
+                if (m_edges[h].first == key)
+                {
+                    _link(m_edges[h].second, 4 * t + j);
+                    m_edges[h].first = s_taken;
+                }
+                else m_edges[h] = std::make_pair(key, 4 * t + j);
+            }
+            if (!_ghost(t)) m_last = t;
+        }
+        for (size_t h = 0; h < size; h++) m_edges[h].first = 0;
+        return true;
+    }
+
+    /*---------------------------------------------------------------------------*/
+    inline std::vector<int32_t> CTDelaunay::tets() const
+    {
+        std::vector<int32_t> tets;
+        for (size_t t = 0; t < m_mark.size(); t++)
+        {
+            if (!_alive((int32_t)t) || _ghost((int32_t)t)) continue;
+            tets.insert(tets.end(), &m_vert[4 * t], &m_vert[4 * t] + 4);
+        }
+        return tets;
+    }
+
+    inline void CTDelaunay::_build(CCompactTMesh & mesh) const
+    {
+        mesh.clear();
+        mesh.v_pos = m_points;
+        mesh.v_id.resize(m_points.size());
+        for (size_t i = 0; i < m_points.size(); i++) mesh.v_id[i] = (int32_t)i;
+
+        //the tets numbered in the order of their slots, the ghosts left out and their faces boundary
+        std::vector<int32_t> index(m_mark.size(), -1);
+        int32_t count = 0;
+        for (size_t t = 0; t < m_mark.size(); t++) if (_alive((int32_t)t) && !_ghost((int32_t)t)) index[t] = count++;
+        mesh.t_vert.resize(4 * (size_t)count);
+        mesh.t_adj.resize(4 * (size_t)count);
+        mesh.t_id.resize(count);
+        MeshLib::parallel_for(m_mark.size(), 0, [&](size_t b, size_t e)
+        {
+            for (size_t t = b; t < e; t++)
+            {
+                if (index[t] < 0) continue;
+                const size_t s = 4 * (size_t)index[t];
+                for (int k = 0; k < 4; k++)
+                {
+                    mesh.t_vert[s + k] = m_vert[4 * t + k];
+                    const int32_t h = m_adj[4 * t + k], n = index[h >> 2];
+                    mesh.t_adj[s + k] = n < 0 ? -1 : 4 * n + (h & 3);
+                }
+                mesh.t_id[index[t]] = index[t];
+            }
+        });
+    }
+
+}; //namespace
+
+#endif
@@ -1,722 +1,475 @@
 /*!
 *      \file titerators.h
-*      \brief iterators for Tetrahedron Mesh Classes
+*      \brief Allocation free iterators and ranges for CBaseTMesh
 *
-*	   \author David Gu
-*      \date 10/02/2011
+*      Every traversal is a small state over the pointers of the mesh, used
+*      either through the classic iterator classes,
 *
+*          for (TVertexVertexIterator<CTMesh> it(pMesh, pV); !it.end(); ++it) ...
+*
+*      or through the ranges of the elements,
+*
+*          for (auto pW : pV->vertices_range()) ...
+*
+*      Neither allocates. Where the old iterators collected the neighbors into
+*      a std::set, repeated neighbors are skipped by looking back over the
+*      ones already produced, which is a handful of pointer compares at the
+*      valences of a tet mesh; the order is that of the adjacency lists
+*      instead of pointer order.
 */
 
 #ifndef _TMESHLIB_TITERATORS_H_
 #define _TMESHLIB_TITERATORS_H_
 
 #include <list>
-#include <set>
-#include "vertex.h"
-#include "tvertex.h"
-#include "edge.h"
-#include "tedge.h"
-#include "halfedge.h"
-#include "face.h"
-#include "halfface.h"
-#include "tet.h"
-#include "tmesh.h"
-
+#include <cstddef>
+#include <utility>
 
 namespace TMeshLib
 {
-	/*!
-	\brief TMeshVertex Iterator
-	
-	go through all the vertices in the TetMesh
-	*/
-	class TMeshVertexIterator
-	{
-	public:
-		TMeshVertexIterator(CTMesh *  pMesh)
-		{
-			m_pMesh = pMesh;
-			//m_id = 0;
-			m_iter = pMesh->vertices().begin();
-		};
-
-		~TMeshVertexIterator(){};
-
-		CVertex * value() { return *m_iter; };
-
-		/*! iterate ++ */
-		void operator++()
-		{
-			m_iter++;
-		};
-		/*! ++iterator */
-		void operator++(int) { m_iter++; };
-		/*! whether the iterator reaches the end */
-		bool end(){ return m_iter == m_pMesh->vertices().end(); };
-		/*! get the current vertex */
-		CVertex * operator*() { return value(); };
-
-	protected:
-		/*! TetMesh pointer */
-		CTMesh *        m_pMesh;
-		/*! Current vertex list iterator */
-		//int             m_id;
-		typename std::list<CVertex*>::iterator m_iter;
-	};
-
-	/*!
-	\brief VertexVertex Iterator
-
-	go through all the adjacent vertices in of a vertex
-	*/
-	class TVertexVertexIterator
-	{
-	public:
-		/*! Constructor */
-		TVertexVertexIterator(CTMesh *  pMesh, CVertex *  pV)
-		{
-			m_pMesh = pMesh;
-			m_vertex = pV;
-			std::list<CEdge*> * pEdges = pMesh->VertexEdgeList(pV);
-			std::set<CVertex*> vertices;
-
-			for (std::list<CEdge*>::iterator eiter = (*pEdges).begin(); eiter != (*pEdges).end(); eiter++)
-			{
-				CEdge * e = *eiter;
-				CVertex * v1 = pMesh->EdgeVertex1(e);
-				CVertex * v2 = pMesh->EdgeVertex2(e);
-				if (v1 != pV)
-					m_pVertices.insert(v1);
-				else
-					m_pVertices.insert(v2);
-			}
-			m_iter = m_pVertices.begin();
-		};
-		/*! Destructor */
-		~TVertexVertexIterator(){};
-		/*! Iterator ++ */
-		void operator++()
-		{
-			m_iter++;
-		};
-		/*! ++ Iterator */
-		void operator++(int) { m_iter++; };
-		/*! Verify if the iterator reaches the end */
-		bool end(){ return m_iter == m_pVertices.end(); };
-		/*! dereferencing */
-		CVertex * operator*() { return *m_iter; };
-
-	protected:
-		/*! Pointer to the tmesh */
-		CTMesh *  m_pMesh;
-		/*! center vertex */
-		CVertex *			m_vertex;
-		/*! surrounding vertices */
-		std::set<CVertex*>	m_pVertices;
-		/*! set iterator */
-		typename std::set<CVertex*>::iterator m_iter;
-	};
-
-	/*!
-	\brief MeshTet Iterator
-		
-	go through all the Tets in a mesh
-	*/
-	class TMeshTetIterator
-	{
-	public:
-		/*! Consructor */
-		TMeshTetIterator(CTMesh *  pMesh)
-		{
-			m_pMesh = pMesh;
-			//m_id = 0;
-			m_iter = pMesh->tets().begin();
-		};
-		/*! Destructor */
-		~TMeshTetIterator(){};
-		/*! ++iterate */
-		void operator++()
-		{
-			m_iter++;
-		};
-		/*! iterator ++ */
-		void operator++(int) { m_iter++; };
-		/*! verify if reaches the end */
-		bool end(){ return m_iter == m_pMesh->tets().end(); };
-		/*! dereferencing */
-		CTet * operator*() { return *m_iter; };
-
-	private:
-		/*! pointer to a TetMesh */
-		CTMesh *        m_pMesh;
-		/*! tet iterator */
-		typename std::list<CTet*>::iterator m_iter;
-	};
-
-	/*!
-	\brief TetHalfFace Iterator
-
-	go through all the halfaces of a Tet in a mesh
-	*/
-	class TetHalfFaceIterator
-	{
-	public:
-		/*! Constructor */
-		TetHalfFaceIterator(CTMesh * pMesh, CTet * pT)
-		{
-			m_pMesh = pMesh;
-			m_pTet = pT;
-			m_id = 0;
-		};
-		/*! Destructor */
-		~TetHalfFaceIterator(){};
-		/*! iterator ++ */
-		void operator++()
-		{
-			m_id++;
-		};
-		/*! ++iterator */
-		void operator++(int) { m_id++; };
-		/*! verify if the end has been reached */
-		bool end(){ return m_id == 4; };
-		/*! dereferencing */
-		CHalfFace * operator*() { return m_pMesh->TetHalfFace(m_pTet, m_id); };
-
-	private:
-		/*! pointer to a TetMesh */
-		CTMesh *  m_pMesh;
-		/*! current tet */
-		CTet *             m_pTet;
-		/*! current half_face */
-		int                m_id;
-	};
-
-	/*!
-	\brief Mesh Edge Iterator
-
-	go through all the edges of a Tet in a mesh
-	*/
-	class TMeshEdgeIterator
-	{
-	public:
-		/*! Constructor */
-		TMeshEdgeIterator(CTMesh * pMesh)
-		{
-			m_pMesh = pMesh;
-			m_iter = m_pMesh->edges().begin();
-		};
-		/*! Destructor */
-		~TMeshEdgeIterator(){};
-		/*! ++ iterator */
-		void operator++()
-		{
-			m_iter++;
-		};
-		/*! iterator++ */
-		void operator++(int) { m_iter++; };
-		/*! verify if the end has been reached */
-		bool end() { return m_iter == m_pMesh->edges().end(); };
-		/*! dereferencing */
-		CEdge * operator*() { return *m_iter; };
-	private:
-		/*! pointer to the mesh */
-		CTMesh * m_pMesh;
-		/*! edge list iterator */
-		typename std::list<CEdge*>::iterator m_iter;
-	};
-
-	/*!
-	\brief Edge->TEdge Iterator
-
-	go through all the tedges of an edge
-	*/
-	class EdgeTEdgeIterator
-	{
-	public:
-		/*! constrructor */
-		EdgeTEdgeIterator(CTMesh * pMesh, CEdge * pE)
-		{
-			m_pMesh = pMesh;
-			m_pEdge = pE;
-			m_iter = m_pMesh->EdgeTEdgeList(pE)->begin();
-		};
-		/*! Destructor */
-		~EdgeTEdgeIterator(){};
-		/*! ++iterator */
-		void operator++(){ m_iter++; };
-		/*! iterator++ */
-		void operator++(int unused) { m_iter++; };
-		/*! verify if the end has been reached */
-		bool end(){ return m_iter == m_pMesh->EdgeTEdgeList(m_pEdge)->end(); };
-		/*! dereferencing */
-		CTEdge * operator*() { return *m_iter; };
-	private:
-		/*! pointer to mesh */
-		CTMesh * m_pMesh;
-		/*! pointer to the edge */
-		CEdge  * m_pEdge;
-		/*! TEdge list iterator */
-		typename std::list<CTEdge*>::iterator m_iter;
-	};
-
-	/*!
-	\brief Vertex->Edge Iterator
-
-	go through all the edges of a vertex
-	*/
-	class TVertexEdgeIterator
-	{
-	public:
-		/*! constructor */
-		TVertexEdgeIterator(CTMesh * pMesh, CVertex * pV)
-		{
-			m_pMesh = pMesh; m_pV = pV; m_iter = m_pMesh->VertexEdgeList(pV)->begin();
-		};
-		/*! destructor */
-		~TVertexEdgeIterator() {};
-		/*! ++ iterator */
-		void operator++(){ m_iter++; };
-		/*! iterator ++ */
-		void operator++(int unused) { m_iter++; };
-		/*! verify if the end has been reached */
-		bool end() { return m_iter == m_pMesh->VertexEdgeList(m_pV)->end(); };
-		/*! dereferencing */
-		CEdge * operator*() { return *m_iter; };
-
-	private:
-		/*! pointer to mesh */
-		CTMesh * m_pMesh;
-		/*! pointer to the vertex */
-		CVertex * m_pV;
-		/*! Edge list iterator */
-		typename std::list<CEdge*>::iterator m_iter;
-	};
-
-	/*!
-	\brief Tet->Edge Iterator
-
-	go through all the edges of a Tet
-	*/
-	class TetEdgeIterator
-	{
-	public:
-		/*! constructor */
-		TetEdgeIterator(CTMesh * pMesh, CTet * pT)
-		{
-			m_pMesh = pMesh;
-			m_pT = pT;
-			for (int i = 0; i < 4; i++)
-			{
-				CHalfFace * pF = m_pMesh->TetHalfFace(pT, i);
-				CHalfEdge * pH = m_pMesh->HalfFaceHalfEdge(pF);
-				for (int j = 0; j < 3; j++)
-				{
-					CTEdge * pTE = m_pMesh->HalfEdgeTEdge(pH);
-					CEdge  * pE = m_pMesh->TEdgeEdge(pTE);
-					m_edges.insert(pE);
-					pH = m_pMesh->HalfEdgeNext(pH);
-				}
-			}
-			m_iter = m_edges.begin();
-		};
-		/*! destructor */
-		~TetEdgeIterator() {};
-		/*! iterator ++ */
-		void operator++(){ m_iter++; };
-		/*! ++ iterator */
-		void operator++(int unused) { m_iter++; };
-		/*! verify if the end of the list has been reached */
-		bool end() { return m_iter == m_edges.end(); };
-		/*! dereferencing */
-		CEdge * operator*() { return *m_iter; };
-
-	private:
-		/*! Pointer to the mesh */
-		CTMesh * m_pMesh;
-		/*! Pointer to the tet */
-		CTet * m_pT;
-		/*! set of edges adjacent to the central vertex */
-		std::set<CEdge*> m_edges;
-		/*! edge set iterator */
-		typename std::set<CEdge*>::iterator m_iter;
-	};
-
-	/*!
-	\brief Mesh->Face Iterator
-
-	go through all the faces of a Mesh
-	*/
-	class TMeshFaceIterator
-	{
-	public:
-		/*! Constructor */
-		TMeshFaceIterator(CTMesh *  pMesh)
-		{
-			m_pMesh = pMesh;
-			m_iter = pMesh->faces().begin();
-		};
-		/*! Destructor */
-		~TMeshFaceIterator(){};
-		/*! ++ iterator */
-		void operator++(){ m_iter++; };
-		/*! iterator ++ */
-		void operator++(int) { m_iter++; };
-		/*! reach the end of face list */
-		bool end(){ return m_iter == m_pMesh->faces().end(); };
-		/*! dereferencing */
-		CFace * operator*() { return *m_iter; };
-
-	private:
-		/*! pointer to the mesh */
-		CTMesh *    m_pMesh;
-		/*! list of face iterator */
-		typename std::list<CFace*>::iterator m_iter;
-	};
-
-	/*!
-	\brief Edge->Face Iterator
-
-	go through all the faces adjacent to an edge
-	*/
-	class TEdgeFaceIterator
-	{
-	public:
-		/*! constructor */
-		TEdgeFaceIterator(CTMesh * pMesh, CEdge * pE)
-		{
-			m_pMesh = pMesh;
-			std::list<CTEdge*> * TEdges = m_pMesh->EdgeTEdgeList(pE);
-			for (std::list<CTEdge*>::iterator tit = TEdges->begin(); tit != TEdges->end(); tit++)
-			{
-				CTEdge * pT = *tit;
-
-				CHalfEdge * pL = m_pMesh->TEdgeLeftHalfEdge(pT);
-				CHalfEdge * pR = m_pMesh->TEdgeRightHalfEdge(pT);
-
-				CHalfFace * pHF = m_pMesh->HalfEdgeHalfFace(pL);
-				CFace *      pF = m_pMesh->HalfFaceFace(pHF);
-				m_faces.insert(pF);
-
-				pHF = m_pMesh->HalfEdgeHalfFace(pR);
-				pF = m_pMesh->HalfFaceFace(pHF);
-				m_faces.insert(pF);
-			}
-
-			m_iter = m_faces.begin();
-		};
-
-		/*! destructor */
-		~TEdgeFaceIterator(){};
-		/*! ++ iterator */
-		void operator++() { m_iter++; };
-		/*! iterator ++ */
-		void operator++(int unused) { m_iter++; };
-		/*! reach the end */
-		bool end(){ return m_iter == m_faces.end(); };
-		/*! dereferencing */
-		CFace * operator*() { return *m_iter; };
-
-	private:
-		/*! pointer to the mesh */
-		CTMesh *    m_pMesh;
-		/*! face set */
-		std::set<CFace*> m_faces;
-		/*! face set iterator */
-		typename std::set<CFace*>::iterator m_iter;
-	};
-
-
-	/*!
-	\brief HalfFace->vertex Iterator
-
-	go through all the vertices of a HalfFace
-	*/
-	class HalfFaceVertexIterator
-	{
-	public:
-		/*! constructor */
-		HalfFaceVertexIterator(CTMesh * pMesh, CHalfFace * pF)
-		{
-			m_pMesh = pMesh;
-			m_pF = pF;
-			m_pH = pMesh->HalfFaceHalfEdge(pF);
-		};
-		/*! destructor */
-		~HalfFaceVertexIterator() {};
-		/*! iterator ++ */
-		void operator++()
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! ++ iterator */
-		void operator++(int)
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! verify if the end of the list has been reached */
-		bool end() { return m_pH == NULL; };
-		/*! dereferencing */
-		CVertex * operator*() { return m_pMesh->HalfEdgeTarget(m_pH); };
-
-	private:
-		/*! Pointer to the mesh */
-		CTMesh * m_pMesh;
-		/*! Pointer to the halfface */
-		CHalfFace * m_pF;
-		/*! Pointer to the halfedge */
-		CHalfEdge * m_pH;
-	};
-
-	/*!
-	\brief HalfFace->HalfEdge Iterator
-
-	go through all the halfedges of a HalfFace
-	*/
-	class HalfFaceHalfEdgeIterator
-	{
-	public:
-		/*! constructor */
-		HalfFaceHalfEdgeIterator(CTMesh * pMesh, CHalfFace * pF)
-		{
-			m_pMesh = pMesh;
-			m_pF = pF;
-			m_pH = pMesh->HalfFaceHalfEdge(pF);
-		};
-		/*! destructor */
-		~HalfFaceHalfEdgeIterator() {};
-		/*! iterator ++ */
-		void operator++()
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! ++ iterator */
-		void operator++(int unused)
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! verify if the end of the list has been reached */
-		bool end() { return m_pH == NULL; };
-		/*! dereferencing */
-		CHalfEdge * operator*() { return m_pH; };
-
-	protected:
-		/*! Pointer to the mesh */
-		CTMesh * m_pMesh;
-		/*! Pointer to the halfface */
-		CHalfFace * m_pF;
-		/*! Pointer to the halfedge */
-		CHalfEdge * m_pH;
-	};
-
-
-	/*!
-	\brief Face->vertex Iterator
-
-	go through all the vertices of a Face
-	*/
-	class FaceVertexIterator
-	{
-	public:
-		/*! constructor */
-		FaceVertexIterator(CTMesh * pMesh, CFace * pF)
-		{
-			m_pMesh = pMesh;
-			m_pF = pF;
-			m_pHF = m_pMesh->FaceLeftHalfFace(m_pF);
-			m_pH = pMesh->HalfFaceHalfEdge(m_pHF);
-		};
-		/*! destructor */
-		~FaceVertexIterator() {};
-		/*! iterator ++ */
-		void operator++()
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pHF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! ++ iterator */
-		void operator++(int)
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pHF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! verify if the end of the list has been reached */
-		bool end() { return m_pH == NULL; };
-		/*! dereferencing */
-		CVertex * operator*() { return m_pMesh->HalfEdgeTarget(m_pH); };
-
-	private:
-		/*! Pointer to the mesh */
-		CTMesh * m_pMesh;
-		/*! Pointer to the face */
-		CFace * m_pF;
-		/*! Pointer to the halfface */
-		CHalfFace * m_pHF;
-		/*! Pointer to the halfedge */
-		CHalfEdge * m_pH;
-	};
-
-
-	/*!
-	\brief TVertex->InHalfEdge Iterator
-
-	go through all the InHalfEdge of a TVertex
-	*/
-	class TVertexInHalfEdgeIterator
-	{
-	public:
-		/*! constructor */
-		TVertexInHalfEdgeIterator(CTMesh * pMesh, CTVertex * pTV)
-		{
-			m_pMesh = pMesh;
-			m_pTV = pTV;
-			m_pH = pMesh->TVertexHalfEdge(pTV);
-			m_pHF = m_pMesh->HalfEdgeHalfFace(m_pH);
-		};
-		/*! destructor */
-		~TVertexInHalfEdgeIterator() {};
-		/*! iterator ++ */
-		void operator++()
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pHF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! ++ iterator */
-		void operator++(int unused)
-		{
-			CHalfEdge * pN = m_pMesh->HalfEdgeNext(m_pH);
-			m_pH = m_pMesh->HalfEdgeDual(pN);
-			if (m_pH == m_pMesh->TVertexHalfEdge(m_pTV))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! verify if the end of the list has been reached */
-		bool end() { return m_pH == NULL; };
-		/*! dereferencing */
-		CHalfEdge * operator*() { return m_pH; };
-
-	private:
-		/*! Pointer to the mesh */
-		CTMesh * m_pMesh;
-		/*! Pointer to the TVertex */
-		CTVertex * m_pTV;
-		/*! Pointer to the halfedge */
-		CHalfEdge * m_pH;
-		/*! Pointer to the halfface */
- 		CHalfFace * m_pHF;
-	};
-
-	/*!
-	\brief TVertex->TEdge Iterator
-
-	go through all the TEdge of a TVertex
-	*/
-	class TVertexTEdgeIterator
-	{
-	public:
-		/*! constructor */
-		TVertexTEdgeIterator(CTMesh * pMesh, CTVertex * pTV)
-		{
-			m_pMesh = pMesh;
-			m_pTV = pTV;
-			m_pH = pMesh->TVertexHalfEdge(pTV);
-			m_pHF = m_pMesh->HalfEdgeHalfFace(m_pH);
-		};
-		/*! destructor */
-		~TVertexTEdgeIterator() {};
-		/*! iterator ++ */
-		void operator++()
-		{
-			m_pH = m_pMesh->HalfEdgeNext(m_pH);
-			if (m_pH == m_pMesh->HalfFaceHalfEdge(m_pHF))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! ++ iterator */
-		void operator++(int unused)
-		{
-			CHalfEdge * pN = m_pMesh->HalfEdgeNext(m_pH);
-			m_pH = m_pMesh->HalfEdgeDual(pN);
-			if (m_pH == m_pMesh->TVertexHalfEdge(m_pTV))
-			{
-				m_pH = NULL;
-			}
-		};
-		/*! verify if the end of the list has been reached */
-		bool end() { return m_pH == NULL; };
-		/*! dereferencing */
-		CTEdge * operator*() { return m_pMesh->HalfEdgeTEdge(m_pH); };
-
-	private:
-		/*! Pointer to the mesh */
-		CTMesh * m_pMesh;
-		/*! Pointer to the TVertex */
-		CTVertex * m_pTV;
-		/*! Pointer to the halfedge */
-		CHalfEdge * m_pH;
-		/*! Pointer to the halfface */
- 		CHalfFace * m_pHF;
-	};
-
-	/*!
-	\brief Vertex->TVertex Iterator
-	
-	go through all the tvertices of a vertex
-	*/
-	class VertexTVertexIterator
-	{
-	public:
-		/*! constrructor */
-		VertexTVertexIterator(CTMesh * pMesh, CVertex * pV)
-		{
-			m_pMesh = pMesh;
-			m_pVert = pV;
-			m_iter = m_pMesh->VertexTVertexList(pV)->begin();
-		};
-		/*! Destructor */
-		~VertexTVertexIterator(){};
-		/*! ++iterator */
-		void operator++(){ m_iter++; };
-		/*! iterator++ */
-		void operator++(int unused) { m_iter++; };
-		/*! verify if the end has been reached */
-		bool end(){ return m_iter == m_pMesh->VertexTVertexList(m_pVert)->end(); };
-		/*! dereferencing */
-		CTVertex * operator*() { return *m_iter; };
-	private:
-		/*! pointer to mesh */
-		CTMesh * m_pMesh;
-		/*! pointer to the vertex */
-		CVertex  * m_pVert;
-		/*! TVertex list iterator */
-		typename std::list<CTVertex*>::iterator m_iter;
-	};
-
-};
-#endif
\ No newline at end of file
+
+    /*!
+     *  \brief CTRange class, begin/end pair over a traversal state S, for range-for
+     *
+     *  S supplies value(), next() and done().
+     */
+    template<typename S>
+    class CTRange
+    {
+    public:
+        class iterator
+        {
+        public:
+            typedef decltype(std::declval<const S &>().value()) value_type;
+
+            iterator() : m_end(true) {}
+            iterator(const S & s) : m_state(s), m_end(false) {}
+
+            value_type operator*() const { return m_state.value(); }
+            iterator & operator++() { m_state.next(); return *this; }
+            //! only the end is compared against
+            bool operator!=(const iterator & other) const { return (m_end || m_state.done()) != (other.m_end || other.m_state.done()); }
+            bool operator==(const iterator & other) const { return !(*this != other); }
+
+        protected:
+            S    m_state;
+            bool m_end;
+        };
+
+        CTRange(const S & s) : m_state(s) {}
+        iterator begin() const { return iterator(m_state); }
+        iterator end() const { return iterator(); }
+
+    protected:
+        S m_state;
+    };
+
+    /*! \brief CTListState, the elements of an adjacency or mesh list */
+    template<typename E>
+    class CTListState
+    {
+    public:
+        CTListState() {}
+        CTListState(std::list<E*> & l) : m_iter(l.begin()), m_end(l.end()) {}
+        E *  value() const { return *m_iter; }
+        void next() { ++m_iter; }
+        bool done() const { return m_iter == m_end; }
+
+    protected:
+        typename std::list<E*>::iterator m_iter, m_end;
+    };
+
+    /*! \brief CTVertexVerticesState, the other ends of the edges of a vertex, each once */
+    template<typename M>
+    class CTVertexVerticesState
+    {
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using iter = typename std::list<CEdge*>::iterator;
+
+    public:
+        CTVertexVerticesState() {}
+        CTVertexVerticesState(CVertex * pV) : m_vertex(pV), m_first(pV->edges().begin()), m_iter(m_first), m_end(pV->edges().end()) {}
+
+        CVertex * value() const { return _other(*m_iter); }
+        void next()
+        {
+            for (++m_iter; m_iter != m_end; ++m_iter)
+            {
+                CVertex * w = _other(*m_iter);
+                iter i = m_first;
+                while (i != m_iter && _other(*i) != w) ++i;
+                if (i == m_iter) return;
+            }
+        }
+        bool done() const { return m_iter == m_end; }
+
+    protected:
+        CVertex * _other(CEdge * e) const { return e->vertex1() != m_vertex ? e->vertex1() : e->vertex2(); }
+
+        CVertex * m_vertex = NULL;
+        iter m_first, m_iter, m_end;
+    };
+
+    /*! \brief CTVertexTetsState, the tets around a vertex, one per tvertex */
+    template<typename M>
+    class CTVertexTetsState : public CTListState<typename M::CTVertex>
+    {
+    public:
+        CTVertexTetsState() {}
+        CTVertexTetsState(typename M::CVertex * pV) : CTListState<typename M::CTVertex>(pV->tvertices()) {}
+        typename M::CTet * value() const { return (*this->m_iter)->tet(); }
+    };
+
+    /*! \brief CTTetHalfFacesState, the four halffaces of a tet */
+    template<typename M>
+    class CTTetHalfFacesState
+    {
+    public:
+        CTTetHalfFacesState() {}
+        CTTetHalfFacesState(typename M::CTet * pT) : m_tet(pT) {}
+        typename M::CHalfFace * value() const { return m_tet->halfface(m_k); }
+        void next() { m_k++; }
+        bool done() const { return m_k == 4; }
+
+    protected:
+        typename M::CTet * m_tet = NULL;
+        int m_k = 0;
+    };
+
+    /*! \brief CTTetVerticesState, the four vertices of a tet */
+    template<typename M>
+    class CTTetVerticesState : public CTTetHalfFacesState<M>
+    {
+    public:
+        CTTetVerticesState() {}
+        CTTetVerticesState(typename M::CTet * pT) : CTTetHalfFacesState<M>(pT) {}
+        typename M::CVertex * value() const { return this->m_tet->vertex(this->m_k); }
+    };
+
+    /*! \brief CTTetTetsState, the tets sharing a face with a tet */
+    template<typename M>
+    class CTTetTetsState : public CTTetHalfFacesState<M>
+    {
+    public:
+        CTTetTetsState() {}
+        CTTetTetsState(typename M::CTet * pT) : CTTetHalfFacesState<M>(pT) { _skip(); }
+        typename M::CTet * value() const { return this->m_tet->halfface(this->m_k)->dual()->tet(); }
+        void next() { this->m_k++; _skip(); }
+
+    protected:
+        void _skip() { while (this->m_k < 4 && this->m_tet->halfface(this->m_k)->dual() == NULL) this->m_k++; }
+    };
+
+    /*! \brief CTTetEdgesState, the edges of a tet, each once, from the halfedges of its halffaces */
+    template<typename M>
+    class CTTetEdgesState
+    {
+        using CEdge = typename M::CEdge;
+
+    public:
+        CTTetEdgesState() {}
+        CTTetEdgesState(typename M::CTet * pT) : m_tet(pT) {}
+
+        CEdge * value() const { return _edge(m_k); }
+        void next()
+        {
+            for (m_k++; m_k < 12; m_k++)
+            {
+                int i = 0;
+                while (i < m_k && _edge(i) != _edge(m_k)) i++;
+                if (i == m_k) return;
+            }
+        }
+        bool done() const { return m_k == 12; }
+
+    protected:
+        //! halfedge k % 3 of halfface k / 3
+        CEdge * _edge(int k) const
+        {
+            typename M::CHalfEdge * pH = m_tet->halfface(k / 3)->halfedge();
+            for (int j = k % 3; j > 0; j--) pH = pH->next();
+            return pH->tedge()->edge();
+        }
+
+        typename M::CTet * m_tet = NULL;
+        int m_k = 0;
+    };
+
+    /*! \brief CTHalfFaceHalfEdgesState, the three halfedges of a halfface */
+    template<typename M>
+    class CTHalfFaceHalfEdgesState
+    {
+        using CHalfEdge = typename M::CHalfEdge;
+
+    public:
+        CTHalfFaceHalfEdgesState() {}
+        CTHalfFaceHalfEdgesState(typename M::CHalfFace * pF) : m_first(pF->halfedge()), m_he(m_first) {}
+        CHalfEdge * value() const { return m_he; }
+        void next() { m_he = m_he->next(); if (m_he == m_first) m_he = NULL; }
+        bool done() const { return m_he == NULL; }
+
+    protected:
+        CHalfEdge * m_first = NULL;
+        CHalfEdge * m_he = NULL;
+    };
+
+    /*! \brief CTHalfFaceVerticesState, the targets of the halfedges of a halfface */
+    template<typename M>
+    class CTHalfFaceVerticesState : public CTHalfFaceHalfEdgesState<M>
+    {
+    public:
+        CTHalfFaceVerticesState() {}
+        CTHalfFaceVerticesState(typename M::CHalfFace * pF) : CTHalfFaceHalfEdgesState<M>(pF) {}
+        typename M::CVertex * value() const { return this->m_he->target(); }
+    };
+
+    /*! \brief CTVertexOutHalfEdgesState, the three halfedges leaving a tvertex in its tet */
+    template<typename M>
+    class CTVertexOutHalfEdgesState
+    {
+        using CHalfEdge = typename M::CHalfEdge;
+
+    public:
+        CTVertexOutHalfEdgesState() {}
+        CTVertexOutHalfEdgesState(typename M::CTVertex * pTV) : m_first(pTV->halfedge()), m_he(m_first) {}
+        CHalfEdge * value() const { return m_he; }
+        //! the halfedge into the source in the same halfface, then its dual in the next halfface
+        void next() { m_he = m_he->prev()->dual(); if (m_he == m_first) m_he = NULL; }
+        bool done() const { return m_he == NULL; }
+
+    protected:
+        CHalfEdge * m_first = NULL;
+        CHalfEdge * m_he = NULL;
+    };
+
+    /*! \brief CTVertexInHalfEdgesState, the three halfedges entering a tvertex in its tet */
+    template<typename M>
+    class CTVertexInHalfEdgesState : public CTVertexOutHalfEdgesState<M>
+    {
+    public:
+        CTVertexInHalfEdgesState() {}
+        CTVertexInHalfEdgesState(typename M::CTVertex * pTV) : CTVertexOutHalfEdgesState<M>(pTV) {}
+        typename M::CHalfEdge * value() const { return this->m_he->prev(); }
+    };
+
+    /*! \brief CTVertexTEdgesState, the three tedges at a tvertex */
+    template<typename M>
+    class CTVertexTEdgesState : public CTVertexOutHalfEdgesState<M>
+    {
+    public:
+        CTVertexTEdgesState() {}
+        CTVertexTEdgesState(typename M::CTVertex * pTV) : CTVertexOutHalfEdgesState<M>(pTV) {}
+        typename M::CTEdge * value() const { return this->m_he->tedge(); }
+    };
+
+    /*! \brief CTEdgeTetsState, the tets around an edge, one per tedge */
+    template<typename M>
+    class CTEdgeTetsState : public CTListState<typename M::CTEdge>
+    {
+    public:
+        CTEdgeTetsState() {}
+        CTEdgeTetsState(typename M::CEdge * pE) : CTListState<typename M::CTEdge>(pE->tedges()) {}
+        typename M::CTet * value() const { return (*this->m_iter)->tet(); }
+    };
+
+    /*! \brief CTEdgeFacesState, the faces around an edge, each once */
+    template<typename M>
+    class CTEdgeFacesState
+    {
+        using CFace = typename M::CFace;
+        using iter = typename std::list<typename M::CTEdge*>::iterator;
+
+    public:
+        CTEdgeFacesState() {}
+        CTEdgeFacesState(typename M::CEdge * pE) : m_first(pE->tedges().begin()), m_iter(m_first), m_end(pE->tedges().end()) {}
+
+        CFace * value() const { return _face(m_iter, m_side); }
+        void next()
+        {
+            while (_step())
+            {
+                CFace * f = _face(m_iter, m_side);
+                iter i = m_first;
+                int side = 0;
+                while ((i != m_iter || side != m_side) && _face(i, side) != f)
+                {
+                    if (++side == 2) { side = 0; ++i; }
+                }
+                if (i == m_iter && side == m_side) return;
+            }
+        }
+        bool done() const { return m_iter == m_end; }
+
+    protected:
+        bool _step()
+        {
+            if (++m_side == 2) { m_side = 0; ++m_iter; }
+            return m_iter != m_end;
+        }
+        //! the face of the left or right halfedge of a tedge
+        static CFace * _face(iter i, int side)
+        {
+            return (side ? (*i)->right() : (*i)->left())->halfface()->face();
+        }
+
+        iter m_first, m_iter, m_end;
+        int  m_side = 0;
+    };
+
+    /*!
+     *  \brief CTIterator class, a traversal state with the classic interface
+     *
+     *  value() or *it gives the current element, ++it steps, end() tells
+     *  whether the traversal is over.
+     */
+    template<typename S>
+    class CTIterator : public S
+    {
+    public:
+        using S::S;
+        decltype(std::declval<const S &>().value()) operator*() const { return this->value(); }
+        void operator++() { this->next(); }
+        void operator++(int) { this->next(); }
+        bool end() const { return this->done(); }
+    };
+
+    /*! \brief TMeshVertexIterator, all the vertices of the mesh */
+    template<typename M>
+    class TMeshVertexIterator : public CTIterator<CTListState<typename M::CVertex>>
+    {
+    public:
+        TMeshVertexIterator(M * pMesh) : CTIterator<CTListState<typename M::CVertex>>(pMesh->vertices()) {}
+    };
+
+    /*! \brief TMeshTetIterator, all the tets of the mesh */
+    template<typename M>
+    class TMeshTetIterator : public CTIterator<CTListState<typename M::CTet>>
+    {
+    public:
+        TMeshTetIterator(M * pMesh) : CTIterator<CTListState<typename M::CTet>>(pMesh->tets()) {}
+    };
+
+    /*! \brief TMeshEdgeIterator, all the edges of the mesh */
+    template<typename M>
+    class TMeshEdgeIterator : public CTIterator<CTListState<typename M::CEdge>>
+    {
+    public:
+        TMeshEdgeIterator(M * pMesh) : CTIterator<CTListState<typename M::CEdge>>(pMesh->edges()) {}
+    };
+
+    /*! \brief TMeshFaceIterator, all the faces of the mesh */
+    template<typename M>
+    class TMeshFaceIterator : public CTIterator<CTListState<typename M::CFace>>
+    {
+    public:
+        TMeshFaceIterator(M * pMesh) : CTIterator<CTListState<typename M::CFace>>(pMesh->faces()) {}
+    };
+
+    /*! \brief TVertexVertexIterator, the vertices sharing an edge with a vertex */
+    template<typename M>
+    class TVertexVertexIterator : public CTIterator<CTVertexVerticesState<M>>
+    {
+    public:
+        TVertexVertexIterator(M *, typename M::CVertex * pV) : CTIterator<CTVertexVerticesState<M>>(pV) {}
+    };
+
+    /*! \brief TVertexEdgeIterator, the edges of a vertex */
+    template<typename M>
+    class TVertexEdgeIterator : public CTIterator<CTListState<typename M::CEdge>>
+    {
+    public:
+        TVertexEdgeIterator(M *, typename M::CVertex * pV) : CTIterator<CTListState<typename M::CEdge>>(pV->edges()) {}
+    };
+
+    /*! \brief VertexTVertexIterator, the tvertices of a vertex */
+    template<typename M>
+    class VertexTVertexIterator : public CTIterator<CTListState<typename M::CTVertex>>
+    {
+    public:
+        VertexTVertexIterator(M *, typename M::CVertex * pV) : CTIterator<CTListState<typename M::CTVertex>>(pV->tvertices()) {}
+    };
+
+    /*! \brief TVertexTetIterator, the tets around a vertex */
+    template<typename M>
+    class TVertexTetIterator : public CTIterator<CTVertexTetsState<M>>
+    {
+    public:
+        TVertexTetIterator(M *, typename M::CVertex * pV) : CTIterator<CTVertexTetsState<M>>(pV) {}
+    };
+
+    /*! \brief TetHalfFaceIterator, the halffaces of a tet */
+    template<typename M>
+    class TetHalfFaceIterator : public CTIterator<CTTetHalfFacesState<M>>
+    {
+    public:
+        TetHalfFaceIterator(M *, typename M::CTet * pT) : CTIterator<CTTetHalfFacesState<M>>(pT) {}
+    };
+
+    /*! \brief TetEdgeIterator, the edges of a tet */
+    template<typename M>
+    class TetEdgeIterator : public CTIterator<CTTetEdgesState<M>>
+    {
+    public:
+        TetEdgeIterator(M *, typename M::CTet * pT) : CTIterator<CTTetEdgesState<M>>(pT) {}
+    };
+
+    /*! \brief EdgeTEdgeIterator, the tedges of an edge */
+    template<typename M>
+    class EdgeTEdgeIterator : public CTIterator<CTListState<typename M::CTEdge>>
+    {
+    public:
+        EdgeTEdgeIterator(M *, typename M::CEdge * pE) : CTIterator<CTListState<typename M::CTEdge>>(pE->tedges()) {}
+    };
+
+    /*! \brief TEdgeFaceIterator, the faces around an edge */
+    template<typename M>
+    class TEdgeFaceIterator : public CTIterator<CTEdgeFacesState<M>>
+    {
+    public:
+        TEdgeFaceIterator(M *, typename M::CEdge * pE) : CTIterator<CTEdgeFacesState<M>>(pE) {}
+    };
+
+    /*! \brief HalfFaceVertexIterator, the vertices of a halfface */
+    template<typename M>
+    class HalfFaceVertexIterator : public CTIterator<CTHalfFaceVerticesState<M>>
+    {
+    public:
+        HalfFaceVertexIterator(M *, typename M::CHalfFace * pF) : CTIterator<CTHalfFaceVerticesState<M>>(pF) {}
+    };
+
+    /*! \brief HalfFaceHalfEdgeIterator, the halfedges of a halfface */
+    template<typename M>
+    class HalfFaceHalfEdgeIterator : public CTIterator<CTHalfFaceHalfEdgesState<M>>
+    {
+    public:
+        HalfFaceHalfEdgeIterator(M *, typename M::CHalfFace * pF) : CTIterator<CTHalfFaceHalfEdgesState<M>>(pF) {}
+    };
+
+    /*! \brief FaceVertexIterator, the vertices of a face, those of its left halfface */
+    template<typename M>
+    class FaceVertexIterator : public CTIterator<CTHalfFaceVerticesState<M>>
+    {
+    public:
+        FaceVertexIterator(M *, typename M::CFace * pF) : CTIterator<CTHalfFaceVerticesState<M>>(pF->left()) {}
+    };
+
+    /*! \brief TVertexInHalfEdgeIterator, the halfedges into a tvertex in its tet */
+    template<typename M>
+    class TVertexInHalfEdgeIterator : public CTIterator<CTVertexInHalfEdgesState<M>>
+    {
+    public:
+        TVertexInHalfEdgeIterator(M *, typename M::CTVertex * pTV) : CTIterator<CTVertexInHalfEdgesState<M>>(pTV) {}
+    };
+
+    /*! \brief TVertexTEdgeIterator, the tedges at a tvertex */
+    template<typename M>
+    class TVertexTEdgeIterator : public CTIterator<CTVertexTEdgesState<M>>
+    {
+    public:
+        TVertexTEdgeIterator(M *, typename M::CTVertex * pTV) : CTIterator<CTVertexTEdgesState<M>>(pTV) {}
+    };
+
+}; //namespace
+
+#endif
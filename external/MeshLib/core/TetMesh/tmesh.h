@@ -20,9 +20,18 @@
 #include <list>
 #include <vector>
 #include <map>
+#include <utility>
+#include <functional>
+#include <algorithm>
 
 #include "../Geometry/Point.h"
 #include "../parser/strutil.h"
+#include "../Mesh/idmap.h"
+#include "../Mesh/edgehash.h"
+#include "../parser/parallel.h"
+#include "../parser/tetparser.h"
+#include "../parser/tmv.h"
+#include "titerators.h"
 
 #ifndef MAX_LINE 
 #define MAX_LINE 2048
@@ -41,6 +50,33 @@ namespace TMeshLib
     class CFace {};
     class CTet {};
 
+    /*!
+     *  \brief CTraitHook, the trait string hooks of an element base class
+     *
+     *  A base class given to CBaseTMesh reads and writes the traits of its
+     *  elements by declaring
+     *
+     *      template<typename Elem> void _from_string(Elem & e);
+     *      template<typename Elem> void _to_string(Elem & e);
+     *
+     *  which are called with the complete element, string() included. The
+     *  hooks are bound at compile time, the elements carry no vtable, and
+     *  base classes without them do nothing.
+     */
+    template<typename B>
+    struct CTraitHook
+    {
+        template<typename Elem>
+        static auto from_string(Elem & e, int) -> decltype(e.B::_from_string(e), void()) { e.B::_from_string(e); }
+        template<typename Elem>
+        static void from_string(Elem &, long) {}
+
+        template<typename Elem>
+        static auto to_string(Elem & e, int) -> decltype(e.B::_to_string(e), void()) { e.B::_to_string(e); }
+        template<typename Elem>
+        static void to_string(Elem &, long) {}
+    };
+
     /*!
     * \brief CBaseTMesh, base class for all types of tet-mesh classes
     *
@@ -86,8 +122,16 @@ namespace TMeshLib
             CTet      * & tet() { return m_pTet; };
             CHalfEdge * & halfedge() { return m_pHalfedge; };
 
-            virtual void _from_string() { };
-            virtual void _to_string() { };
+            //allocation free ranges, see titerators.h
+            /*! the three halfedges leaving the tvertex in its tet */
+            CTRange<CTVertexOutHalfEdgesState<CBaseTMesh>> out_halfedges_range() { return CTVertexOutHalfEdgesState<CBaseTMesh>(this); }
+            /*! the three halfedges entering the tvertex in its tet */
+            CTRange<CTVertexInHalfEdgesState<CBaseTMesh>> in_halfedges_range() { return CTVertexInHalfEdgesState<CBaseTMesh>(this); }
+            /*! the three tedges at the tvertex */
+            CTRange<CTVertexTEdgesState<CBaseTMesh>> tedges_range() { return CTVertexTEdgesState<CBaseTMesh>(this); }
+
+            void _from_string() { CTraitHook<TV>::from_string(*this, 0); };
+            void _to_string() { CTraitHook<TV>::to_string(*this, 0); };
 
         protected:
             int          m_id;			// vertex ID
@@ -115,10 +159,16 @@ namespace TMeshLib
             std::list<CHalfFace*> & halffaces() { return m_pHFaces; };
             std::list<CTVertex*>  & tvertices() { return m_pTVertices; };
 
+            //allocation free ranges, see titerators.h
+            /*! the vertices sharing an edge with this one, each once */
+            CTRange<CTVertexVerticesState<CBaseTMesh>> vertices_range() { return CTVertexVerticesState<CBaseTMesh>(this); }
+            /*! the tets around the vertex */
+            CTRange<CTVertexTetsState<CBaseTMesh>> tets_range() { return CTVertexTetsState<CBaseTMesh>(this); }
+
             std::string & string() { return m_string; };
 
-            virtual void _from_string() { };
-            virtual void _to_string() { };
+            void _from_string() { CTraitHook<V>::from_string(*this, 0); };
+            void _to_string() { CTraitHook<V>::to_string(*this, 0); };
 
         protected:
 
@@ -166,8 +216,8 @@ namespace TMeshLib
             CTEdge    * & tedge() { return m_pTEdge; };
             CHalfFace * & halfface() { return m_pHalfFace; };
 
-            virtual void _from_string() { };
-            virtual void _to_string() { };
+            void _from_string() { CTraitHook<HE>::from_string(*this, 0); };
+            void _to_string() { CTraitHook<HE>::to_string(*this, 0); };
 
         protected:
             CTVertex   * m_pSource;
@@ -206,8 +256,8 @@ namespace TMeshLib
 
             int & key(int k) { return m_key[k]; };
 
-            virtual void _from_string() { };
-            virtual void _to_string() { };
+            void _from_string() { CTraitHook<TE>::from_string(*this, 0); };
+            void _to_string() { CTraitHook<TE>::to_string(*this, 0); };
 
         protected:
 
@@ -236,8 +286,14 @@ namespace TMeshLib
 
             std::list<CTEdge*> & tedges() { return m_lTEdges; };
 
-            virtual void _from_string() { };
-            virtual void _to_string() { };
+            //allocation free ranges, see titerators.h
+            /*! the tets around the edge */
+            CTRange<CTEdgeTetsState<CBaseTMesh>> tets_range() { return CTEdgeTetsState<CBaseTMesh>(this); }
+            /*! the faces around the edge, each once */
+            CTRange<CTEdgeFacesState<CBaseTMesh>> faces_range() { return CTEdgeFacesState<CBaseTMesh>(this); }
+
+            void _from_string() { CTraitHook<E>::from_string(*this, 0); };
+            void _to_string() { CTraitHook<E>::to_string(*this, 0); };
 
             std::string & string() { return m_string; };
 
@@ -272,6 +328,11 @@ namespace TMeshLib
             bool        & boundary() { return m_boundary; };
             int         & key(int k) { return m_key[k]; };
 
+            //allocation free ranges, see titerators.h
+            CTRange<CTHalfFaceHalfEdgesState<CBaseTMesh>> halfedges_range() { return CTHalfFaceHalfEdgesState<CBaseTMesh>(this); }
+            /*! the targets of the halfedges */
+            CTRange<CTHalfFaceVerticesState<CBaseTMesh>> vertices_range() { return CTHalfFaceVerticesState<CBaseTMesh>(this); }
+
             bool operator==(const CHalfFace & f)
             {
                 for (int i = 0; i < 3; i++)
@@ -308,8 +369,8 @@ namespace TMeshLib
             bool & boundary() { return m_boundary; };
             std::string & string() { return m_string; };
 
-            virtual void _from_string() { };
-            virtual void _to_string() { };
+            void _from_string() { CTraitHook<F>::from_string(*this, 0); };
+            void _to_string() { CTraitHook<F>::to_string(*this, 0); };
 
         protected:
 
@@ -335,11 +396,19 @@ namespace TMeshLib
 
             int  & id() { return m_id; };
 
-            virtual void _from_string() { };
-            virtual void _to_string() { };
+            void _from_string() { CTraitHook<T>::from_string(*this, 0); };
+            void _to_string() { CTraitHook<T>::to_string(*this, 0); };
 
             std::string & string() { return m_string; };
 
+            //allocation free ranges, see titerators.h
+            CTRange<CTTetHalfFacesState<CBaseTMesh>> halffaces_range() { return CTTetHalfFacesState<CBaseTMesh>(this); }
+            CTRange<CTTetVerticesState<CBaseTMesh>> vertices_range() { return CTTetVerticesState<CBaseTMesh>(this); }
+            /*! the six edges, each once */
+            CTRange<CTTetEdgesState<CBaseTMesh>> edges_range() { return CTTetEdgesState<CBaseTMesh>(this); }
+            /*! the tets sharing a face with this one */
+            CTRange<CTTetTetsState<CBaseTMesh>> tets_range() { return CTTetTetsState<CBaseTMesh>(this); }
+
         protected:
 
             CHalfFace  * m_pHalfFace[4];
@@ -360,13 +429,27 @@ namespace TMeshLib
         */
         ~CBaseTMesh() { _clear(); };
         /*!
-            Load tet mesh from a ".tet" file
+            Load tet mesh from a ".tet" file, the file is mapped and parsed on threads threads,
+            0 uses all hardware threads
         */
-        void _load(const char *);
+        void _load(const char *, int threads = 0);
         /*!
             Load tet mesh from a ".t" file
         */
-        void _load_t(const char *);
+        void _load_t(const char *, int threads = 0);
+        /*!
+            Load tet mesh from a ".tmv" binary cache, see parser/tmv.h
+            \return false if the file is missing or not a valid cache
+        */
+        bool _load_tmv(const char *);
+        /*!
+            Write tet mesh to a ".tmv" binary cache, trait strings are not kept
+        */
+        bool _write_tmv(const char *);
+        /*!
+            Build tet mesh from parsed records, see parser/tetparser.h and compacttmesh.h
+        */
+        void _load_data(const MeshLib::CTetData & data) { _build(data); }
         /*!
             Write tet mesh to a file
         */
@@ -412,20 +495,64 @@ namespace TMeshLib
         /*! access the tet with ID */
         CTet    * tet(int id) { return m_map_Tets[id]; };
 
-        /*! Vertex->Edge */
+        /*! Vertex->Edge, the first edge of v1 joining v2 */
         CEdge   * edge(CVertex * v1, CVertex * v2)
         {
+            if (m_indexed)
+                return m_edge_index.find(MeshLib::CEdgeHash<CEdge>::key(v1->id(), v2->id()), [&](CEdge * e) { return _joins(e, v1, v2); });
+
             std::list<CEdge*> & edges = v1->edges();
             for(auto pE : edges)
             {
-                CVertex * w1 = pE->vertex1();
-                CVertex * w2 = pE->vertex2();
-                if (w1 == v1 && w2 == v2) return pE;
-                if (w1 == v2 && w2 == v1) return pE;
+                if (_joins(pE, v1, v2)) return pE;
             }
             return NULL;
         }
 
+        /*! Vertex->HalfFace, the halfface whose halfedges run v1->v2->v3, NULL if there is none */
+        CHalfFace * halfface(CVertex * v1, CVertex * v2, CVertex * v3)
+        {
+            if (m_indexed)
+                return m_face_index.find(_face_key(v1->id(), v2->id(), v3->id()), [&](CHalfFace * f) { return _runs(f, v1, v2, v3); });
+
+            for (auto pTV : v1->tvertices())
+            {
+                CTet * pT = pTV->tet();
+                for (int i = 0; i < 4; i++)
+                {
+                    if (_runs(pT->halfface(i), v1, v2, v3)) return pT->halfface(i);
+                }
+            }
+            return NULL;
+        }
+
+        /*! Vertex->Face, the face of the three vertices in any order */
+        CFace   * face(CVertex * v1, CVertex * v2, CVertex * v3)
+        {
+            CHalfFace * pF = halfface(v1, v2, v3);
+            if (pF == NULL) pF = halfface(v1, v3, v2);
+            return pF ? pF->face() : NULL;
+        }
+
+        /*!
+            Index the edges and halffaces by their vertex ids, so that edge(), halfface()
+            and face() are hash lookups instead of walks around v1. Off by default; once
+            on, meshes loaded later are indexed as they are built. The mesh must not be
+            edited while the index is on.
+        */
+        void index(bool on)
+        {
+            m_indexed = on;
+            if (on) _build_index();
+            else
+            {
+                m_edge_index.clear();
+                m_face_index.clear();
+            }
+        }
+        /*! whether edge(), halfface() and face() use the index */
+        bool indexed() const { return m_indexed; }
+
 
     protected:
 
@@ -436,6 +563,8 @@ namespace TMeshLib
         */
 
         void  _construct_tet(CTet* pT, int id, int * v);
+        /*! create the vertices and tets of the parsed records and connect them */
+        void  _build(const MeshLib::CTetData & data);
         /*! construct faces */
         void  _construct_faces();
         /*! construct edges */
@@ -448,6 +577,32 @@ namespace TMeshLib
         /*! release all the memory allocations */
         void _clear();
 
+        /*! fill the edge and halfface indices from the lists */
+        void _build_index();
+
+        static bool _joins(CEdge * e, CVertex * v1, CVertex * v2)
+        {
+            return (e->vertex1() == v1 && e->vertex2() == v2) || (e->vertex1() == v2 && e->vertex2() == v1);
+        }
+        /*! whether the halfedges of f run v1->v2->v3, starting anywhere */
+        static bool _runs(CHalfFace * f, CVertex * v1, CVertex * v2, CVertex * v3)
+        {
+            CHalfEdge * pH = f->halfedge();
+            for (int k = 0; k < 3; k++, pH = pH->next())
+            {
+                if (pH->source() == v1) return pH->target() == v2 && pH->next()->target() == v3;
+            }
+            return false;
+        }
+        /*! hash key of the face of three vertex ids, in any order */
+        static uint64_t _face_key(int a, int b, int c)
+        {
+            if (a > b) std::swap(a, b);
+            if (b > c) std::swap(b, c);
+            if (a > b) std::swap(a, b);
+            return (uint64_t)(uint32_t)a * 0x9E3779B97F4A7C15ull ^ MeshLib::CEdgeHash<CHalfFace>::key(b, c);
+        }
+
     protected:
         /*!
         list of faces
@@ -479,7 +634,7 @@ namespace TMeshLib
         /*!
         map of CVertex id and pointer
         */
-        std::map<int, CVertex *> m_map_Vertices;
+        MeshLib::CIdMap<CVertex> m_map_Vertices;
 
         /*!
         array of tets
@@ -487,7 +642,7 @@ namespace TMeshLib
         std::list<CTet*>		 m_pTets;
         //CTet*                    m_pTets;
 
-        std::map<int, CTet*>     m_map_Tets;
+        MeshLib::CIdMap<CTet>    m_map_Tets;
 
         /*! number of vertices */
         int m_nVertices;
@@ -501,100 +656,151 @@ namespace TMeshLib
         /*! max vertex id */
         int m_maxVertexId;
 
+        /*! edges and halffaces by vertex ids, see index() */
+        bool                         m_indexed = false;
+        MeshLib::CEdgeHash<CEdge>     m_edge_index;
+        MeshLib::CEdgeHash<CHalfFace> m_face_index;
+
     };
 
     //construct faces
+    //
+    //the halffaces in the list of a vertex, the one of least id in each, are
+    //sorted by key; twins end up next to each other, in the order of the list.
+    //This pairs them, and orders the faces, as a scan of the list would.
     template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
     void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_construct_faces()
     {
-        CVertex * pV = NULL;
+        MESHLIB_TRACE_ZONE("_construct_faces");
+        struct CKey
+        {
+            int         key[2];
+            int         order;
+            CHalfFace * pF;
+
+            bool operator<(const CKey & k) const
+            {
+                if (key[0] != k.key[0]) return key[0] < k.key[0];
+                if (key[1] != k.key[1]) return key[1] < k.key[1];
+                return order < k.order;
+            }
+        };
+
+        //buffers reused from vertex to vertex
+        std::vector<CKey> keys;
+        std::vector<CHalfFace*> hfs;
+        std::vector<int> twin;
 
         for (typename std::list<CVertex*>::iterator vIter = m_pVertices.begin(); vIter != m_pVertices.end(); vIter++)
         {
-            pV = *vIter;
+            std::list<CHalfFace*> & halffaces = (*vIter)->halffaces();
+            keys.clear();
+            hfs.clear();
+            for (auto pF : halffaces)
+            {
+                CKey k = { { pF->key(1), pF->key(2) }, (int)hfs.size(), pF };
+                keys.push_back(k);
+                hfs.push_back(pF);
+            }
+            halffaces.clear();
+            std::sort(keys.begin(), keys.end());
 
-            std::list<CHalfFace*> & halffaces = pV->halffaces();
+            twin.assign(hfs.size(), -1);
+            for (size_t i = 0; i + 1 < keys.size(); )
+            {
+                if (keys[i + 1].key[0] == keys[i].key[0] && keys[i + 1].key[1] == keys[i].key[1])
+                {
+                    twin[keys[i].order] = keys[i + 1].order;
+                    twin[keys[i + 1].order] = keys[i].order;
+                    i += 2;
+                }
+                else i++;
+            }
 
-            while (!halffaces.empty())
+            for (int i = 0; i < (int)hfs.size(); i++)
             {
-                CHalfFace * pF = halffaces.front();
-                halffaces.remove(pF);
+                if (twin[i] >= 0 && twin[i] < i) continue;
+                CHalfFace * pF = hfs[i];
                 CFace * f = new CFace();
                 assert(f != NULL);
                 m_pFaces.push_back(f);
                 f->left() = pF;
                 pF->face() = f;
 
-                for(auto pH: halffaces)
+                if (twin[i] >= 0)
                 {
-                    if (*pH == *pF)
-                    {
-                        pH->dual() = pF;
-                        pF->dual() = pH;
-                        f->right() = pH;
-                        pH->face() = f;
-                        break;
-                    }
-                }
-
-                if (pF->dual() != NULL)
-                {
-                    halffaces.remove(pF->dual());
+                    CHalfFace * pH = hfs[twin[i]];
+                    pH->dual() = pF;
+                    pF->dual() = pH;
+                    f->right() = pH;
+                    pH->face() = f;
                 }
             }
         }
     };
 
     //construct edges
+    //
+    //as the faces, the tedges of a vertex with the same key are a run once sorted
     template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
     void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_construct_edges()
     {
-        for (typename std::list<CVertex*>::iterator vIter = m_pVertices.begin(); vIter != m_pVertices.end(); vIter++)
+        MESHLIB_TRACE_ZONE("_construct_edges");
+        struct CKey
         {
-            CVertex * pV = *vIter;
-            std::list<CTEdge*> & pL = pV->tedges();
+            int      key;
+            int      order;
+            CTEdge * pTE;
 
-            while (!pL.empty())
+            bool operator<(const CKey & k) const
             {
-                CTEdge * pTE = pL.front();
-                pL.remove(pTE);
-                CEdge * e = new CEdge;
-                assert(e != NULL);
+                if (key != k.key) return key < k.key;
+                return order < k.order;
+            }
+        };
 
-                int id1 = pTE->key(0);
-                CVertex * v1 = m_map_Vertices[id1];
-                e->vertex1() = v1;
+        std::vector<CKey> keys;
+        std::vector<int> first;     //the place in keys of the run a tedge leads, -1 for the others
 
-                int id2 = pTE->key(1);
-                CVertex * v2 = m_map_Vertices[id2];
-                e->vertex2() = v2;
+        for (typename std::list<CVertex*>::iterator vIter = m_pVertices.begin(); vIter != m_pVertices.end(); vIter++)
+        {
+            std::list<CTEdge*> & pL = (*vIter)->tedges();
+            keys.clear();
+            for (auto pTE : pL)
+            {
+                CKey k = { pTE->key(1), (int)keys.size(), pTE };
+                keys.push_back(k);
+            }
+            pL.clear();
+            std::sort(keys.begin(), keys.end());
 
-                m_pEdges.push_back(e);
+            first.assign(keys.size(), -1);
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (i == 0 || keys[i].key != keys[i - 1].key) first[keys[i].order] = (int)i;
+            }
 
-                e->tedges().push_back(pTE);
-                pTE->edge() = e;
+            //the edges in the order of the tedges leading their runs
+            for (size_t o = 0; o < keys.size(); o++)
+            {
+                if (first[o] < 0) continue;
+                const size_t i = (size_t)first[o];
+                CTEdge * pTE = keys[i].pTE;
+                CEdge * e = new CEdge;
+                assert(e != NULL);
 
-                std::list<CTEdge*> tmp_edges;
-                for(auto pH: pL)
-                {
-                    if (*pH == *pTE)
-                    {
-                        pH->edge() = e;
-                        tmp_edges.push_back(pH);
-                    }
-                }
+                e->vertex1() = m_map_Vertices[pTE->key(0)];
+                e->vertex2() = m_map_Vertices[pTE->key(1)];
+                m_pEdges.push_back(e);
 
-                for(auto pH: tmp_edges)
+                for (size_t j = i; j < keys.size() && keys[j].key == keys[i].key; j++)
                 {
-                    pL.remove(pH);
-                    e->tedges().push_back(pH);
+                    keys[j].pTE->edge() = e;
+                    e->tedges().push_back(keys[j].pTE);
                 }
-
             }
-
         }
 
-
         for (typename std::list<CEdge*>::iterator it = m_pEdges.begin(); it != m_pEdges.end(); it++)
         {
             CEdge * pE = *it;
@@ -727,32 +933,32 @@ namespace TMeshLib
     template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
     void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_clear()
     {
-        for (std::list<CEdge*>::iterator eit = m_pEdges.begin(); eit != m_pEdges.end(); eit++)
+        for (typename std::list<CEdge*>::iterator eit = m_pEdges.begin(); eit != m_pEdges.end(); eit++)
         {
             CEdge * pE = *eit;
             delete pE;
         }
 
-        for (std::list<CTEdge*>::iterator eit = m_pTEdges.begin(); eit != m_pTEdges.end(); eit++)
+        for (typename std::list<CTEdge*>::iterator eit = m_pTEdges.begin(); eit != m_pTEdges.end(); eit++)
         {
             CTEdge * pE = *eit;
             delete pE;
         }
 
-        for (std::list<CHalfEdge*>::iterator hit = m_pHalfEdges.begin(); hit != m_pHalfEdges.end(); hit++)
+        for (typename std::list<CHalfEdge*>::iterator hit = m_pHalfEdges.begin(); hit != m_pHalfEdges.end(); hit++)
         {
             CHalfEdge * pH = *hit;
             delete pH;
         }
 
 
-        for (std::list<CFace*>::iterator fit = m_pFaces.begin(); fit != m_pFaces.end(); fit++)
+        for (typename std::list<CFace*>::iterator fit = m_pFaces.begin(); fit != m_pFaces.end(); fit++)
         {
             CFace * pF = *fit;
             delete pF;
         }
 
-        for (std::list<CHalfFace*>::iterator fit = m_pHalfFaces.begin(); fit != m_pHalfFaces.end(); fit++)
+        for (typename std::list<CHalfFace*>::iterator fit = m_pHalfFaces.begin(); fit != m_pHalfFaces.end(); fit++)
         {
             CHalfFace * pF = *fit;
             delete pF;
@@ -760,360 +966,155 @@ namespace TMeshLib
 
         m_pVertices.clear();
         m_pTets.clear();
+        m_edge_index.clear();
+        m_face_index.clear();
         //delete[] m_pTVertices;
     };
 
+    //in list order, so that of edges with equal ends the index finds the one a walk around v1 would
     template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
-    void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_load(const char * input)
+    void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_build_index()
     {
-        m_maxVertexId = 0;
-
-        std::ifstream is(input);
+        m_edge_index.clear();
+        m_edge_index.reserve(m_pEdges.size());
+        for (auto pE : m_pEdges)
+            m_edge_index.insert(MeshLib::CEdgeHash<CEdge>::key(pE->vertex1()->id(), pE->vertex2()->id()), pE);
+
+        m_face_index.clear();
+        m_face_index.reserve(m_pHalfFaces.size());
+        for (auto pF : m_pHalfFaces)
+            m_face_index.insert(_face_key(pF->key(0), pF->key(1), pF->key(2)), pF);
+    };
 
-        if (is.fail())
+    template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
+    void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_load(const char * input, int threads)
+    {
+        MeshLib::CTetData data;
+        if (!MeshLib::CTetParser::parse_tet_file(input, data, threads))
         {
             fprintf(stderr, "Error in opening file %s\n", input);
             return;
         }
+        _build(data);
+    };
 
-        char buffer[MAX_LINE];
-        {
-            //read in the first line
-            is.getline(buffer, MAX_LINE);
-            //read in the number of vertices: "number vertices"
-            std::string line(buffer);
-            line = strutil::trim(line);
-            strutil::Tokenizer stokenizer(line, " \r\n");
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-            m_nVertices = strutil::parseString<int>(token);
-            stokenizer.nextToken();
-            token = stokenizer.getToken();
-            std::cout << token << std::endl;
-            if (token != "vertices")
-            {
-                fprintf(stderr, "Error in vertex format %s\n", input);
-                return;
-            }
-        }
-
-        //read in the second line
-        is.getline(buffer, MAX_LINE);
-        //read in the number of vertices: "number tets"
-        std::string line(buffer);
-        line = strutil::trim(line);
-        strutil::Tokenizer stokenizer(line, " \r\n");
-        stokenizer.nextToken();
-        std::string token = stokenizer.getToken();
-        m_nTets = strutil::parseString<int>(token);
-        stokenizer.nextToken();
-        token = stokenizer.getToken();
-        if (token != "tets")
+    template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
+    void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_load_t(const char * input, int threads)
+    {
+        MeshLib::CTetData data;
+        if (!MeshLib::CTetParser::parse_t_file(input, data, threads))
         {
-            fprintf(stderr, "Error in tet format %s\n", input);
+            fprintf(stderr, "Error in opening file %s\n", input);
             return;
         }
+        _build(data);
 
-        //read in the vertices
-        for (int i = 0; i < m_nVertices && is.getline(buffer, MAX_LINE); i++)
+        // read in traits
+        for (typename std::list<CVertex*>::iterator vIter = m_pVertices.begin(); vIter != m_pVertices.end(); vIter++)
         {
-            std::string line(buffer);
-            line = strutil::trim(line);
-            strutil::Tokenizer stokenizer(line, " \r\n");
-
-            CPoint p;
-            for (int k = 0; k < 3; k++)
-            {
-                stokenizer.nextToken();
-                std::string token = stokenizer.getToken();
-                p[k] = strutil::parseString<float>(token);
-            }
-
-            CVertex * v = new CVertex();
-            //CVertex & v = m_pVertices[i];
-            v->id() = i;
-            v->point() = p;
-
-            m_pVertices.push_back(v);
-            m_map_Vertices.insert(std::pair<int, CVertex*>(i, v));
-
-            if (!stokenizer.nextToken("\t\r\n")) continue;
-            std::string token = stokenizer.getToken();
-
-            int sp = (int)token.find("{");
-            int ep = (int)token.find("}");
-
-            if (sp >= 0 && ep >= 0)
-            {
-                v->string() = token.substr(sp + 1, ep - sp - 1);
-            }
+            CVertex * pV = *vIter;
+            pV->_from_string();
         }
 
-
-        //read in tets 
-        for (int id = 0; id < m_nTets && is.getline(buffer, MAX_LINE); id++)
+        for (typename std::list<CTet *>::iterator tIter = m_pTets.begin(); tIter != m_pTets.end(); tIter++)
         {
-            int vId[4];
-
-            std::string line(buffer);
-            line = strutil::trim(line);
-            strutil::Tokenizer stokenizer(line, " \r\n");
-
-            //skip the first "4" in the line
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-
-            for (int k = 0; k < 4; k++)
-            {
-                stokenizer.nextToken();
-                std::string token = stokenizer.getToken();
-                vId[k] = strutil::parseString<int>(token);
-            }
-
-            CTet * pT = new CTet();
-            m_pTets.push_back(pT);
-            m_map_Tets.insert(std::pair<int, CTet *>(id, pT));
-
-            _construct_tet(pT, id, vId);
+            CTet * pT = *tIter;
+            pT->_from_string();
         }
 
-        _construct_faces();
-        _construct_edges();
-
-        is.close();
-
-        for (typename std::list<CVertex*>::iterator vIter = m_pVertices.begin(); vIter != m_pVertices.end(); vIter++)
+        for (typename std::list<CEdge*>::iterator eIter = m_pEdges.begin(); eIter != m_pEdges.end(); eIter++)
         {
-            CVertex * pV = *vIter;
-            if (pV->id() > m_maxVertexId)
-            {
-                m_maxVertexId = pV->id();
-            }
+            CEdge * pE = *eIter;
+            pE->_from_string();
         }
-
     };
 
     template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
-    void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_load_t(const char * input)
+    bool CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_load_tmv(const char * input)
     {
-        m_maxVertexId = 0;
-
-        std::fstream is(input, std::fstream::in);
+        MeshLib::CTmvFile tmv(input);
+        if (!tmv.is_open()) return false;
+
+        MeshLib::CTetData data;
+        const size_t nv = tmv.num_vertices(), nt = tmv.num_tets();
+        const double * p = tmv.positions();
+        data.points.resize(nv);
+        for (size_t i = 0; i < nv; i++) data.points[i] = CPoint(p[3 * i], p[3 * i + 1], p[3 * i + 2]);
+        data.vertex_ids.assign(tmv.vertex_ids(), tmv.vertex_ids() + nv);
+        data.tets.assign(tmv.tets(), tmv.tets() + 4 * nt);
+        data.tet_ids.assign(tmv.tet_ids(), tmv.tet_ids() + nt);
+        _build(data);
+        return true;
+    };
 
-        if (is.fail())
+    template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
+    bool CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_write_tmv(const char * output)
+    {
+        std::vector<double>  positions;
+        std::vector<int32_t> vertex_ids, tets, tet_ids;
+        positions.reserve(3 * m_pVertices.size());
+        for (auto pV : m_pVertices)
         {
-            fprintf(stderr, "Error in opening file %s\n", input);
-            return;
+            for (int k = 0; k < 3; k++) positions.push_back(pV->point()[k]);
+            vertex_ids.push_back(pV->id());
         }
-
-        char buffer[MAX_LINE];
-
-        m_nVertices = 0;
-        m_nTets = 0;
-        m_nEdges = 0;
-
-        while (!is.eof())
+        for (auto pT : m_pTets)
         {
-            is.getline(buffer, MAX_LINE);
-            std::string line(buffer);
-            line = strutil::trim(line);
-            strutil::Tokenizer stokenizer(line, " \r\n");
-
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-
-            if (token == "Vertex") m_nVertices++;
-            if (token == "Tet") m_nTets++;
-            if (token == "Edge") m_nEdges++;
+            for (int k = 0; k < 4; k++) tets.push_back(pT->vertex(k)->id());
+            tet_ids.push_back(pT->id());
         }
+        return MeshLib::write_tmv_file(output, vertex_ids.size(), tet_ids.size(),
+            positions.data(), vertex_ids.data(), tets.data(), tet_ids.data());
+    };
 
-        is.clear();              // forget we hit the end of file
-        is.seekg(0, std::ios::beg);   // move to the start of the file
+    //build the mesh from the parsed records, then the faces and edges shared by the tets
+    template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
+    void CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_build(const MeshLib::CTetData & data)
+    {
+        MESHLIB_TRACE_ZONE("build tets");
+        m_maxVertexId = 0;
+        m_nVertices = (int)data.num_vertices();
+        m_nTets = (int)data.num_tets();
 
-        //read in the vertices
-        for (int i = 0; i < m_nVertices && is.getline(buffer, MAX_LINE); i++)
+        std::vector<CVertex*> verts(data.num_vertices());
+        for (size_t i = 0; i < data.num_vertices(); i++)
         {
-            std::string line(buffer);
-            line = strutil::trim(line);
-            strutil::Tokenizer stokenizer(line, " \r\n");
-
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-
-            if (token != "Vertex")
-            {
-                fprintf(stderr, "Error in vertex format\n");
-                return;
-            }
-
-
-            stokenizer.nextToken();
-            token = stokenizer.getToken();
-            int vid = strutil::parseString<int>(token);
-
-            CPoint p;
-            for (int k = 0; k < 3; k++)
-            {
-                stokenizer.nextToken();
-                std::string token = stokenizer.getToken();
-                p[k] = strutil::parseString<float>(token);
-            }
-
             CVertex * v = new CVertex();
-            //CVertex & v = m_pVertices[i];
-            v->id() = vid;
-            v->point() = p;
-
+            v->id() = data.vertex_ids[i];
+            v->point() = data.points[i];
             m_pVertices.push_back(v);
-
-            m_map_Vertices.insert(std::pair<int, CVertex *>(vid, v));
-
-            if (!stokenizer.nextToken("\t\r\n")) continue;
-            token = stokenizer.getToken();
-
-            int sp = (int)token.find("{");
-            int ep = (int)token.find("}");
-
-            if (sp >= 0 && ep >= 0)
-            {
-                v->string() = token.substr(sp + 1, ep - sp - 1);
-            }
+            m_map_Vertices.insert(v->id(), v);
+            verts[i] = v;
+            m_maxVertexId = std::max(m_maxVertexId, v->id());
         }
+        for (const auto & t : data.vertex_traits) verts[t.first]->string() = t.second;
 
-
-        //read in tets 
-        for (int id = 0; id < m_nTets && is.getline(buffer, MAX_LINE); id++)
+        std::vector<CTet*> tets(data.num_tets());
+        for (size_t i = 0; i < data.num_tets(); i++)
         {
-            int vId[4];
-
-            std::string line(buffer);
-            line = strutil::trim(line);
-            strutil::Tokenizer stokenizer(line, " \r\n");
-
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-
-            if (token != "Tet")
-            {
-                fprintf(stderr, "Error in tet format\n");
-                return;
-            }
-
-            //skip the first "4" in the line
-            stokenizer.nextToken();
-            token = stokenizer.getToken();
-            int tid = strutil::parseString<int>(token);
-
-
-            for (int k = 0; k < 4; k++)
-            {
-                stokenizer.nextToken();
-                std::string token = stokenizer.getToken();
-                vId[k] = strutil::parseString<int>(token);
-            }
-
-
-
+            int vId[4] = { data.tets[4 * i], data.tets[4 * i + 1], data.tets[4 * i + 2], data.tets[4 * i + 3] };
             CTet * pT = new CTet();
             m_pTets.push_back(pT);
-            m_map_Tets.insert(std::pair<int, CTet *>(tid, pT));
-
-            _construct_tet(pT, tid, vId);
-
-            // read in string
-            if (!stokenizer.nextToken("\t\r\n")) continue;
-            token = stokenizer.getToken();
-
-            int sp = (int)token.find("{");
-            int ep = (int)token.find("}");
-
-            if (sp >= 0 && ep >= 0)
-            {
-                pT->string() = token.substr(sp + 1, ep - sp - 1);
-            }
+            m_map_Tets.insert(data.tet_ids[i], pT);
+            _construct_tet(pT, data.tet_ids[i], vId);
+            tets[i] = pT;
         }
+        for (const auto & t : data.tet_traits) tets[t.first]->string() = t.second;
 
         _construct_faces();
         _construct_edges();
+        if (m_indexed) _build_index();
 
-        for (int id = 0; id < m_nEdges && is.getline(buffer, MAX_LINE); id++)
+        for (const auto & t : data.edge_traits)
         {
-            std::string line(buffer);
-            line = strutil::trim(line);
-            strutil::Tokenizer stokenizer(line, " \r\n");
-
-            stokenizer.nextToken();
-            std::string token = stokenizer.getToken();
-
-            if (token != "Edge")
-            {
-                fprintf(stderr, "Error in edge format\n");
-                return;
-            }
-
-            stokenizer.nextToken();
-            token = stokenizer.getToken();
-            int id1 = strutil::parseString<int>(token);
-
-            stokenizer.nextToken();
-            token = stokenizer.getToken();
-            int id2 = strutil::parseString<int>(token);
-
-            CVertex * pV1 = this->vertex(id1);
-            CVertex * pV2 = this->vertex(id2);
-
-            CEdge * pE = this->edge(pV1, pV2);
-
-            if (!stokenizer.nextToken("\t\r\n"))
-            {
-                continue;
-            }
-
-            token = stokenizer.getToken();
-
-            int sp = (int)token.find("{");
-            int ep = (int)token.find("}");
-
-            if (sp >= 0 && ep >= 0)
-            {
-                pE->string() = token.substr(sp + 1, ep - sp - 1);
-            }
+            CVertex * v1 = vertex(data.edges[2 * t.first]);
+            CVertex * v2 = vertex(data.edges[2 * t.first + 1]);
+            CEdge * pE = (v1 && v2) ? edge(v1, v2) : NULL;
+            if (pE != NULL) pE->string() = t.second;
         }
 
         m_nEdges = (int)m_pEdges.size();
-
-        is.close();
-
-        for (typename std::list<CVertex*>::iterator vIter = m_pVertices.begin(); vIter != m_pVertices.end(); vIter++)
-        {
-            CVertex * pV = *vIter;
-            if (pV->id() > m_maxVertexId)
-            {
-                m_maxVertexId = pV->id();
-            }
-        }
-
-        // read in traits
-        for (typename std::list<CVertex*>::iterator vIter = m_pVertices.begin(); vIter != m_pVertices.end(); vIter++)
-        {
-            CVertex * pV = *vIter;
-            pV->_from_string();
-        }
-
-        for (typename std::list<CTet *>::iterator tIter = m_pTets.begin(); tIter != m_pTets.end(); tIter++)
-        {
-            CTet * pT = *tIter;
-            pT->_from_string();
-        }
-
-        for (typename std::list<CEdge*>::iterator eIter = m_pEdges.begin(); eIter != m_pEdges.end(); eIter++)
-        {
-            CEdge * pE = *eIter;
-            pE->_from_string();
-        }
-
     };
-
     template <typename TV, typename V, typename HE, typename TE, typename E, typename HF, typename F, typename T>
     typename CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::CHalfFace* CBaseTMesh<TV, V, HE, TE, E, HF, F, T>::_construct_half_face(CTVertex ** pTV)
     {
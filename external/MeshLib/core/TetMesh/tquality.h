@@ -0,0 +1,231 @@
+/*!
+*      \file tquality.h
+*      \brief Element quality of tetrahedral meshes, for screening slivers
+*
+*      Per tet: signed volume, smallest and largest dihedral angle, radius
+*      ratio and edge length ratio, evaluated in parallel into one array per
+*      measure. The kernel reads the four corners into locals and is branch
+*      free but for degenerate tets, so that it vectorizes where the compiler
+*      can gather. Histograms summarize each array.
+*/
+
+#ifndef _TMESHLIB_TQUALITY_H_
+#define _TMESHLIB_TQUALITY_H_
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <unordered_map>
+
+#include "../Geometry/Point.h"
+#include "../parser/parallel.h"
+#include "compacttmesh.h"
+
+namespace TMeshLib
+{
+
+    /*!
+     *  \brief CTetQuality, the measures of every tet, one array per measure
+     *
+     *  Angles are in degrees. radius_ratio is 3 r / R of the inscribed and
+     *  circumscribed spheres and edge_ratio the shortest over the longest
+     *  edge, both 1 for the regular tet and 0 for a flat one.
+     */
+    struct CTetQuality
+    {
+        std::vector<double> volume;
+        std::vector<double> min_dihedral;
+        std::vector<double> max_dihedral;
+        std::vector<double> radius_ratio;
+        std::vector<double> edge_ratio;
+
+        size_t size() const { return volume.size(); }
+
+        void resize(size_t n)
+        {
+            volume.resize(n);
+            min_dihedral.resize(n);
+            max_dihedral.resize(n);
+            radius_ratio.resize(n);
+            edge_ratio.resize(n);
+        }
+    };
+
+    /*!
+     *  \brief CQualityHistogram, equal width bins over [lo, hi] of a measure
+     *
+     *  Values outside the range are counted in the first or last bin.
+     */
+    struct CQualityHistogram
+    {
+        double lo = 0, hi = 1;
+        double min = DBL_MAX, max = -DBL_MAX, mean = 0;
+        std::vector<size_t> bins;
+
+        size_t count() const
+        {
+            size_t n = 0;
+            for (size_t b : bins) n += b;
+            return n;
+        }
+        /*! number of values below the upper end of the bin holding t */
+        size_t count_below(double t) const
+        {
+            size_t n = 0;
+            for (size_t b = 0; b < bins.size() && lo + (hi - lo) * b / bins.size() < t; b++) n += bins[b];
+            return n;
+        }
+    };
+
+    /*!
+     *  \brief CTQuality class, evaluates CTetQuality over a mesh
+     */
+    class CTQuality
+    {
+    public:
+        /*!
+         *  The measures of n tets
+         *  \param tets four indices into points per tet
+         *  \param threads number of threads, 0 uses all hardware threads
+         */
+        static void evaluate(const CPoint * points, const int32_t * tets, size_t n, CTetQuality & q, int threads = 0)
+        {
+            q.resize(n);
+            MeshLib::parallel_for(n, threads, [&](size_t b, size_t e)
+            {
+                for (size_t t = b; t < e; t++)
+                {
+                    const int32_t * v = tets + 4 * t;
+                    _tet(points[v[0]], points[v[1]], points[v[2]], points[v[3]],
+                        q.volume[t], q.min_dihedral[t], q.max_dihedral[t], q.radius_ratio[t], q.edge_ratio[t]);
+                }
+            }, 1 << 12);
+        }
+
+        /*! the measures of the tets of a CCompactTMesh, in its order */
+        static void evaluate(const CCompactTMesh & mesh, CTetQuality & q, int threads = 0)
+        {
+            evaluate(mesh.v_pos.data(), mesh.t_vert.data(), mesh.num_tets(), q, threads);
+        }
+
+        /*! the measures of the tets of a CBaseTMesh, in the order of tets() */
+        template<typename M>
+        static void evaluate(M & mesh, CTetQuality & q, int threads = 0)
+        {
+            // flat arrays first, the kernel then does not chase pointers
+            std::vector<CPoint> points;
+            std::vector<int32_t> tets;
+            std::unordered_map<const void *, int32_t> index;
+            points.reserve(mesh.vertices().size());
+            index.reserve(mesh.vertices().size());
+            for (auto pV : mesh.vertices())
+            {
+                index[pV] = (int32_t)points.size();
+                points.push_back(pV->point());
+            }
+            tets.reserve(4 * mesh.tets().size());
+            for (auto pT : mesh.tets())
+                for (int k = 0; k < 4; k++) tets.push_back(index[pT->vertex(k)]);
+            evaluate(points.data(), tets.data(), tets.size() / 4, q, threads);
+        }
+
+        /*!
+         *  Summarize a measure
+         *  \param bins number of bins over [lo, hi]
+         */
+        static CQualityHistogram histogram(const std::vector<double> & values, int bins, double lo, double hi, int threads = 0)
+        {
+            CQualityHistogram h;
+            h.lo = lo;
+            h.hi = hi;
+            h.bins.assign(std::max(1, bins), 0);
+            const double scale = h.bins.size() / (hi > lo ? hi - lo : 1);
+            const int last = (int)h.bins.size() - 1;
+
+            struct CPartial { std::vector<size_t> bins; double min, max, sum; };
+            CPartial identity = { std::vector<size_t>(h.bins.size(), 0), DBL_MAX, -DBL_MAX, 0 };
+            CPartial all = MeshLib::parallel_reduce(values.size(), threads, identity,
+                [&](size_t b, size_t e, CPartial & p)
+            {
+                for (size_t i = b; i < e; i++)
+                {
+                    const double x = values[i];
+                    p.bins[std::min(last, std::max(0, (int)std::floor((x - lo) * scale)))]++;
+                    p.min = std::min(p.min, x);
+                    p.max = std::max(p.max, x);
+                    p.sum += x;
+                }
+            },
+                [](const CPartial & a, const CPartial & b)
+            {
+                CPartial c = a;
+                for (size_t k = 0; k < c.bins.size(); k++) c.bins[k] += b.bins[k];
+                c.min = std::min(a.min, b.min);
+                c.max = std::max(a.max, b.max);
+                c.sum = a.sum + b.sum;
+                return c;
+            }, 1 << 16);
+
+            h.bins = all.bins;
+            h.min = all.min;
+            h.max = all.max;
+            h.mean = values.empty() ? 0 : all.sum / values.size();
+            return h;
+        }
+
+    protected:
+        static void _tet(const CPoint & a, const CPoint & b, const CPoint & c, const CPoint & d,
+            double & volume, double & min_dihedral, double & max_dihedral, double & radius_ratio, double & edge_ratio)
+        {
+            const CPoint u = b - a, v = c - a, w = d - a;
+            const double det = u * (v ^ w);
+            volume = det / 6;
+
+            // edges (0,1), (0,2), (0,3), (1,2), (1,3), (2,3)
+            const CPoint e[6] = { u, v, w, c - b, d - b, d - c };
+            double lmin = DBL_MAX, lmax = 0;
+            for (int k = 0; k < 6; k++)
+            {
+                const double l = e[k] * e[k];
+                lmin = std::min(lmin, l);
+                lmax = std::max(lmax, l);
+            }
+            edge_ratio = lmax > 0 ? std::sqrt(lmin / lmax) : 0;
+
+            // area vectors of the faces opposite each corner, all into the tet if det > 0, all out otherwise
+            const CPoint n[4] = { (d - b) ^ (c - b), v ^ w, w ^ u, u ^ v };
+            double area[4], area_sum = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                area[k] = n[k].norm();
+                area_sum += area[k];
+            }
+
+            // the dihedral angle at the edge of faces i and j is pi less the angle of their normals
+            static const int pairs[6][2] = { { 2, 3 }, { 1, 3 }, { 1, 2 }, { 0, 3 }, { 0, 2 }, { 0, 1 } };
+            double cmin = 1, cmax = -1;
+            for (int k = 0; k < 6; k++)
+            {
+                const int i = pairs[k][0], j = pairs[k][1];
+                const double len = area[i] * area[j];
+                const double cosine = len > 0 ? -(n[i] * n[j]) / len : 1;
+                cmin = std::min(cmin, cosine);
+                cmax = std::max(cmax, cosine);
+            }
+            const double to_degrees = 180.0 / 3.14159265358979323846;
+            min_dihedral = std::acos(std::max(-1.0, std::min(1.0, cmax))) * to_degrees;
+            max_dihedral = std::acos(std::max(-1.0, std::min(1.0, cmin))) * to_degrees;
+
+            // r = 3 |V| / A, R = |o - a| for the circumcenter o
+            const CPoint o = (v ^ w) * (u * u) + (w ^ u) * (v * v) + (u ^ v) * (w * w);
+            const double r = area_sum > 0 ? std::fabs(det) / area_sum : 0;
+            const double R = det != 0 ? o.norm() / (2 * std::fabs(det)) : 0;
+            radius_ratio = R > 0 ? 3 * r / R : 0;
+        }
+    };
+
+}; //namespace
+
+#endif
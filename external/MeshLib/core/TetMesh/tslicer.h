@@ -0,0 +1,192 @@
+/*!
+*      \file tslicer.h
+*      \brief Clipping a tetrahedral mesh by a moving plane
+*
+*      The tets are sorted once by their highest point along the plane normal,
+*      the tets kept below the plane are then always a prefix of that order.
+*      Moving the plane only visits the tets between its old and new offset,
+*      and updates the surface of the kept tets face by face, so dragging the
+*      plane costs what the cut sweeps over instead of a pass over all tets.
+*/
+
+#ifndef _TMESHLIB_TSLICER_H_
+#define _TMESHLIB_TSLICER_H_
+
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+
+#include "compacttmesh.h"
+
+namespace TMeshLib
+{
+
+    /*!
+     *  \brief CTSlicer class, the surface of the tets on the lower side of a plane
+     *
+     *  A tet is kept if all its vertices p have normal * p <= offset; whole
+     *  tets are shown, not cut. The surface is their halffaces on the mesh
+     *  boundary or facing a clipped tet, three vertex indices of the mesh
+     *  per triangle, oriented out of the kept tets.
+     */
+    class CTSlicer
+    {
+    public:
+        /*! the mesh must outlive the slicer and stay unchanged */
+        CTSlicer(const CCompactTMesh & mesh) : m_mesh(mesh) {}
+
+        /*!
+         *  Set the plane normal, sorting the tets along it; the plane starts
+         *  below the mesh, all tets clipped.
+         *  \param threads number of threads for the sort, 0 uses all hardware threads
+         */
+        void set_normal(const CPoint & normal, int threads = 0)
+        {
+            const int32_t nt = m_mesh.num_tets();
+            m_normal = normal;
+            m_keys.resize(nt);
+            m_order.resize(nt);
+            MeshLib::parallel_for(nt, threads, [&](size_t b, size_t e)
+            {
+                for (size_t t = b; t < e; t++)
+                {
+                    double d = -DBL_MAX;
+                    for (int k = 0; k < 4; k++) d = std::max(d, m_mesh.point(m_mesh.tet_vertex((int32_t)t, k)) * normal);
+                    m_keys[t] = d;
+                    m_order[t] = (int32_t)t;
+                }
+            });
+            MeshLib::parallel_sort(m_order.begin(), m_order.end(), threads,
+                [&](int32_t a, int32_t b) { return m_keys[a] < m_keys[b] || (m_keys[a] == m_keys[b] && a < b); });
+            m_rank.resize(nt);
+            MeshLib::parallel_for(nt, threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) m_rank[m_order[i]] = (int32_t)i;
+            });
+
+            m_count = 0;
+            m_offset = -DBL_MAX;
+            m_faces.clear();
+            m_triangles.clear();
+            m_slot.assign(m_mesh.num_halffaces(), -1);
+            m_first_changed = 0;
+        }
+
+        /*! move the plane to normal * p = offset, visiting only the tets it passes */
+        void set_offset(double offset)
+        {
+            m_offset = offset;
+            const int32_t nt = (int32_t)m_order.size();
+            while (m_count < nt && m_keys[m_order[m_count]] <= offset) _keep(m_order[m_count]);
+            while (m_count > 0 && m_keys[m_order[m_count - 1]] > offset) _clip(m_order[m_count - 1]);
+        }
+
+        /*! the range of offsets over which the cut changes */
+        double min_offset() const { return m_order.empty() ? 0 : m_keys[m_order.front()]; }
+        double max_offset() const { return m_order.empty() ? 0 : m_keys[m_order.back()]; }
+
+        const CPoint & normal() const { return m_normal; }
+        double offset() const { return m_offset; }
+        /*! number of tets below the plane */
+        int32_t num_kept() const { return m_count; }
+        bool kept(int32_t t) const { return m_rank[t] < m_count; }
+
+        /*! three vertex indices per surface triangle */
+        const std::vector<int32_t> & triangles() const { return m_triangles; }
+        /*! the halfface of every triangle */
+        const std::vector<int32_t> & halffaces() const { return m_faces; }
+
+        /*!
+         *  The first entry of triangles() changed since the last call, its
+         *  size if none did; entries from there to the end are to be copied
+         *  again, for instance into an index buffer.
+         */
+        size_t take_changes()
+        {
+            const size_t first = std::min(m_first_changed, m_triangles.size());
+            m_first_changed = m_triangles.size();
+            return first;
+        }
+
+    protected:
+        void _keep(int32_t t)
+        {
+            m_count++;
+            for (int i = 0; i < 4; i++)
+            {
+                const int32_t h = 4 * t + i, d = m_mesh.dual(h);
+                if (d >= 0 && kept(d >> 2)) _remove(d);
+                else _add(h);
+            }
+        }
+
+        void _clip(int32_t t)
+        {
+            m_count--;
+            for (int i = 0; i < 4; i++)
+            {
+                const int32_t h = 4 * t + i, d = m_mesh.dual(h);
+                _remove(h);
+                if (d >= 0 && kept(d >> 2)) _add(d);
+            }
+        }
+
+        void _add(int32_t h)
+        {
+            if (m_slot[h] >= 0) return;
+            m_slot[h] = (int32_t)m_faces.size();
+            m_faces.push_back(h);
+            m_triangles.resize(m_triangles.size() + 3);
+            _write(m_slot[h]);
+        }
+
+        /*! the last triangle takes the place of the removed one */
+        void _remove(int32_t h)
+        {
+            const int32_t s = m_slot[h];
+            if (s < 0) return;
+            const int32_t last = m_faces.back();
+            m_faces[s] = last;
+            m_slot[last] = s;
+            m_slot[h] = -1;
+            m_faces.pop_back();
+            m_triangles.resize(m_triangles.size() - 3);
+            if ((size_t)s < m_faces.size()) _write(s);
+        }
+
+        /*! the triangle of slot s, oriented out of its tet whatever the orientation of the tet */
+        void _write(int32_t s)
+        {
+            const int32_t h = m_faces[s];
+            int32_t v[3];
+            for (int k = 0; k < 3; k++) v[k] = m_mesh.halfface_vertex(h, k);
+            const CPoint & p = m_mesh.point(v[0]);
+            const CPoint n = (m_mesh.point(v[1]) - p) ^ (m_mesh.point(v[2]) - p);
+            if (n * (m_mesh.point(m_mesh.tet_vertex(h >> 2, h & 3)) - p) > 0) std::swap(v[1], v[2]);
+            std::copy(v, v + 3, m_triangles.begin() + 3 * (size_t)s);
+            m_first_changed = std::min(m_first_changed, 3 * (size_t)s);
+        }
+
+        const CCompactTMesh & m_mesh;
+        CPoint               m_normal;
+        double               m_offset = -DBL_MAX;
+
+        /*! highest point of every tet along the normal */
+        std::vector<double>  m_keys;
+        /*! tets by key, and the position of every tet in that order */
+        std::vector<int32_t> m_order;
+        std::vector<int32_t> m_rank;
+        /*! the first m_count tets of m_order are kept */
+        int32_t              m_count = 0;
+
+        /*! the surface halffaces, their slot in m_faces or -1, and their triangles */
+        std::vector<int32_t> m_faces;
+        std::vector<int32_t> m_slot;
+        std::vector<int32_t> m_triangles;
+        size_t               m_first_changed = 0;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,537 @@
+/*!
+*      \file tstream.h
+*      \brief Out of core processing of tet meshes too large to load
+*
+*      CTStream walks a mapped .tmv file chunk by chunk, each chunk a run of
+*      consecutive tets with a halo of the tets around the run in the file,
+*      connected as a CCompactTMesh. Only the chunk is in memory, the file
+*      is paged in and out by the system. sort() first rewrites a .tmv with
+*      its tets in Morton order of their centers and its vertices in order
+*      of first use, so that the tets of a run are close in space and their
+*      neighbors mostly in the run or its halo. Boundary extraction and
+*      statistics are built on top, and need memory for their results only.
+*/
+
+#ifndef _TMESHLIB_TSTREAM_H_
+#define _TMESHLIB_TSTREAM_H_
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cfloat>
+#include <cstdint>
+
+#include "../Geometry/Point.h"
+#include "../Geometry/LinearOctree.h"
+#include "../parser/parallel.h"
+#include "../parser/tmv.h"
+#include "compacttmesh.h"
+#include "tquality.h"
+
+namespace TMeshLib
+{
+
+    /*!
+     *  \brief CTChunk, a run of tets of a streamed mesh and its halo
+     *
+     *  The first `owned` tets of mesh are the run, the others the halo; a
+     *  halfface of an owned tet is boundary in mesh if its neighbor is in
+     *  neither. Vertex and tet ids are those of the file.
+     */
+    struct CTChunk
+    {
+        CCompactTMesh        mesh;
+        int32_t              owned = 0;
+        /*! position in the file of the first owned tet */
+        size_t               first = 0;
+        /*! position in the file of every vertex of mesh */
+        std::vector<int32_t> v_index;
+    };
+
+    /*!
+     *  \brief CTStreamStats, totals and quality histograms of a streamed mesh
+     */
+    struct CTStreamStats
+    {
+        size_t            tets = 0;
+        /*! tets of zero or negative volume */
+        size_t            inverted = 0;
+        double            volume = 0;
+        CQualityHistogram min_dihedral;
+        CQualityHistogram max_dihedral;
+        CQualityHistogram radius_ratio;
+        CQualityHistogram edge_ratio;
+    };
+
+    /*!
+     *  \brief CTStream class, reads a .tmv file in chunks
+     *
+     *  Besides the chunk, memory goes to a table from vertex id to position
+     *  in the file, four bytes per id between the least and largest one.
+     *  Tets referring to unknown vertex ids are skipped.
+     */
+    class CTStream
+    {
+    public:
+        CTStream() {}
+        CTStream(const std::string & filename) { open(filename); }
+
+        /*! map the file, false if it is missing or not a valid .tmv */
+        bool open(const std::string & filename)
+        {
+            close();
+            if (!m_file.open(filename)) return false;
+
+            const int32_t * ids = m_file.vertex_ids();
+            const size_t nv = m_file.num_vertices();
+            m_min_id = 0;
+            int32_t max_id = -1;
+            if (nv > 0)
+            {
+                m_min_id = *std::min_element(ids, ids + nv);
+                max_id = *std::max_element(ids, ids + nv);
+            }
+            m_index.assign((size_t)((int64_t)max_id - m_min_id + 1), -1);
+            for (size_t i = 0; i < nv; i++) m_index[ids[i] - m_min_id] = (int32_t)i;
+            rewind();
+            return true;
+        }
+
+        void close()
+        {
+            m_file.close();
+            std::vector<int32_t>().swap(m_index);
+            m_next = 0;
+        }
+
+        bool is_open() const { return m_file.is_open(); }
+        size_t num_vertices() const { return m_file.num_vertices(); }
+        size_t num_tets() const { return m_file.num_tets(); }
+        const MeshLib::CTmvFile & file() const { return m_file; }
+
+        /*! position in the file of the vertex with this id, -1 if there is none */
+        int32_t vertex_index(int32_t id) const
+        {
+            const int64_t i = (int64_t)id - m_min_id;
+            return (i < 0 || i >= (int64_t)m_index.size()) ? -1 : m_index[(size_t)i];
+        }
+        CPoint point(size_t v) const
+        {
+            const double * p = m_file.positions() + 3 * v;
+            return CPoint(p[0], p[1], p[2]);
+        }
+
+        /*!
+         *  Set the chunk size
+         *  \param tets number of tets of each run
+         *  \param halo number of tets before and after the run read along with it
+         */
+        void set_chunk(size_t tets, size_t halo = 0)
+        {
+            m_chunk = std::max<size_t>(1, tets);
+            m_halo = halo;
+        }
+
+        /*! start over from the first tet */
+        void rewind() { m_next = 0; }
+
+        /*!
+         *  Read the next chunk
+         *  \param threads number of threads for the face matching, 0 uses all hardware threads
+         *  \return false once all tets have been read
+         */
+        bool next(CTChunk & chunk, int threads = 0)
+        {
+            const size_t nt = num_tets();
+            if (m_next >= nt) return false;
+
+            const size_t first = m_next, last = std::min(nt, first + m_chunk);
+            const size_t lo = first - std::min(first, m_halo), hi = std::min(nt, last + m_halo);
+            m_next = last;
+
+            // the run first, then the halo on either side
+            std::vector<int32_t> tets, tet_ids;
+            tets.reserve(4 * (hi - lo));
+            tet_ids.reserve(hi - lo);
+            chunk.owned = 0;
+            auto take = [&](size_t b, size_t e)
+            {
+                for (size_t t = b; t < e; t++)
+                {
+                    const int32_t * v = m_file.tets() + 4 * t;
+                    int32_t w[4];
+                    int k = 0;
+                    for (; k < 4 && (w[k] = vertex_index(v[k])) >= 0; k++);
+                    if (k < 4) continue;
+                    tets.insert(tets.end(), w, w + 4);
+                    tet_ids.push_back(m_file.tet_ids()[t]);
+                }
+            };
+            take(first, last);
+            chunk.owned = (int32_t)tet_ids.size();
+            take(lo, first);
+            take(last, hi);
+            chunk.first = first;
+
+            // local vertices in file order
+            std::vector<int32_t> & verts = chunk.v_index;
+            verts.assign(tets.begin(), tets.end());
+            MeshLib::parallel_sort(verts.begin(), verts.end(), threads, std::less<int32_t>());
+            verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+            MeshLib::parallel_for(tets.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++) tets[i] = (int32_t)(std::lower_bound(verts.begin(), verts.end(), tets[i]) - verts.begin());
+            });
+
+            std::vector<CPoint> points(verts.size());
+            for (size_t i = 0; i < verts.size(); i++) points[i] = point(verts[i]);
+            chunk.mesh.build(points, tets, threads);
+            for (size_t i = 0; i < verts.size(); i++) chunk.mesh.v_id[i] = m_file.vertex_ids()[verts[i]];
+            chunk.mesh.t_id.swap(tet_ids);
+            return true;
+        }
+
+        /*! call fn(const CTChunk &) on every chunk, from the first */
+        template<typename Fn>
+        void for_each_chunk(Fn fn, int threads = 0)
+        {
+            CTChunk chunk;
+            rewind();
+            while (next(chunk, threads)) fn((const CTChunk &)chunk);
+        }
+
+        /*!
+         *  The boundary surface, as CTBoundary::extract gives it for a loaded mesh
+         *
+         *  Each chunk reports the halffaces of its run that have no neighbor in
+         *  the run; a face between two runs is then reported twice and dropped,
+         *  a boundary face once. Memory goes to the faces between runs, which
+         *  the Morton order of sort() keeps few. Faces of more than two tets
+         *  are left out.
+         *  \param vertex_ids if not NULL, the vertex id of every point
+         */
+        void boundary(std::vector<CPoint> & points, std::vector<int> & tris, std::vector<int> * vertex_ids = NULL, int threads = 0)
+        {
+            struct CFaceRecord
+            {
+                int32_t key[3];     //!< file positions of the vertices, sorted
+                int32_t v[3];       //!< the same, oriented out of the tet
+                bool operator<(const CFaceRecord & f) const
+                {
+                    if (key[0] != f.key[0]) return key[0] < f.key[0];
+                    if (key[1] != f.key[1]) return key[1] < f.key[1];
+                    return key[2] < f.key[2];
+                }
+                bool same(const CFaceRecord & f) const { return key[0] == f.key[0] && key[1] == f.key[1] && key[2] == f.key[2]; }
+            };
+
+            std::vector<CFaceRecord> faces;
+            for_each_chunk([&](const CTChunk & chunk)
+            {
+                const CCompactTMesh & m = chunk.mesh;
+                for (int32_t h = 0; h < 4 * chunk.owned; h++)
+                {
+                    if (m.dual(h) >= 0 && (m.dual(h) >> 2) < chunk.owned) continue;
+                    int32_t v[3];
+                    for (int k = 0; k < 3; k++) v[k] = m.halfface_vertex(h, k);
+                    const CPoint & p = m.point(v[0]);
+                    const CPoint n = (m.point(v[1]) - p) ^ (m.point(v[2]) - p);
+                    if (n * (m.point(m.tet_vertex(h >> 2, h & 3)) - p) > 0) std::swap(v[1], v[2]);
+
+                    CFaceRecord f;
+                    for (int k = 0; k < 3; k++) f.v[k] = f.key[k] = chunk.v_index[v[k]];
+                    std::sort(f.key, f.key + 3);
+                    faces.push_back(f);
+                }
+            }, threads);
+            MeshLib::parallel_sort(faces.begin(), faces.end(), threads, std::less<CFaceRecord>());
+
+            // the faces reported once, and their vertices renumbered in file order
+            size_t count = 0;
+            for (size_t i = 0; i < faces.size(); )
+            {
+                size_t j = i + 1;
+                while (j < faces.size() && faces[j].same(faces[i])) j++;
+                if (j == i + 1) faces[count++] = faces[i];
+                i = j;
+            }
+            faces.resize(count);
+
+            std::vector<int32_t> verts;
+            verts.reserve(3 * count);
+            for (const CFaceRecord & f : faces) verts.insert(verts.end(), f.v, f.v + 3);
+            MeshLib::parallel_sort(verts.begin(), verts.end(), threads, std::less<int32_t>());
+            verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+
+            points.resize(verts.size());
+            for (size_t i = 0; i < verts.size(); i++) points[i] = point(verts[i]);
+            if (vertex_ids)
+            {
+                vertex_ids->resize(verts.size());
+                for (size_t i = 0; i < verts.size(); i++) (*vertex_ids)[i] = m_file.vertex_ids()[verts[i]];
+            }
+            tris.resize(3 * count);
+            MeshLib::parallel_for(count, threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++)
+                    for (int k = 0; k < 3; k++)
+                        tris[3 * i + k] = (int)(std::lower_bound(verts.begin(), verts.end(), faces[i].v[k]) - verts.begin());
+            });
+        }
+
+        /*!
+         *  Totals and quality histograms over all tets, see CTQuality
+         *  \param bins number of bins of each histogram
+         */
+        CTStreamStats statistics(int bins = 20, int threads = 0)
+        {
+            CTStreamStats s;
+            CTetQuality q;
+            for_each_chunk([&](const CTChunk & chunk)
+            {
+                CTQuality::evaluate(chunk.mesh.v_pos.data(), chunk.mesh.t_vert.data(), chunk.owned, q, threads);
+                for (double v : q.volume)
+                {
+                    s.volume += v;
+                    if (v <= 0) s.inverted++;
+                }
+                s.tets += q.size();
+                _add(s.min_dihedral, CTQuality::histogram(q.min_dihedral, bins, 0, 180, threads));
+                _add(s.max_dihedral, CTQuality::histogram(q.max_dihedral, bins, 0, 180, threads));
+                _add(s.radius_ratio, CTQuality::histogram(q.radius_ratio, bins, 0, 1, threads));
+                _add(s.edge_ratio, CTQuality::histogram(q.edge_ratio, bins, 0, 1, threads));
+            }, threads);
+            return s;
+        }
+
+        /*!
+         *  Rewrite a .tmv with its tets in Morton order of their centers and its
+         *  vertices in order of first use, ids unchanged
+         *
+         *  The tets are sorted in runs that fit in memory, spilled to
+         *  output + ".runs" and merged. Besides the runs, memory goes to two
+         *  int32 per vertex and the id table of open().
+         *  \param memory bytes for the sort keys
+         *  \param threads number of threads, 0 uses all hardware threads
+         *  \return false if the input cannot be read or the output written
+         */
+        static bool sort(const std::string & input, const std::string & output, size_t memory = (size_t)1 << 30, int threads = 0)
+        {
+            CTStream in;
+            if (!in.open(input)) return false;
+            const size_t nv = in.num_vertices(), nt = in.num_tets();
+            const MeshLib::CTmvFile & file = in.file();
+
+            // the box of the vertices, cut in 2^21 cells per axis
+            struct CBox { CPoint lo, hi; };
+            CBox box = { CPoint(DBL_MAX, DBL_MAX, DBL_MAX), CPoint(-DBL_MAX, -DBL_MAX, -DBL_MAX) };
+            box = MeshLib::parallel_reduce(nv, threads, box, [&](size_t b, size_t e, CBox & r)
+            {
+                for (size_t v = b; v < e; v++)
+                {
+                    const CPoint p = in.point(v);
+                    for (int k = 0; k < 3; k++)
+                    {
+                        r.lo[k] = std::min(r.lo[k], p[k]);
+                        r.hi[k] = std::max(r.hi[k], p[k]);
+                    }
+                }
+            },
+                [](const CBox & a, const CBox & b)
+            {
+                CBox c = a;
+                for (int k = 0; k < 3; k++)
+                {
+                    c.lo[k] = std::min(a.lo[k], b.lo[k]);
+                    c.hi[k] = std::max(a.hi[k], b.hi[k]);
+                }
+                return c;
+            });
+            double scale[3];
+            for (int k = 0; k < 3; k++) scale[k] = box.hi[k] > box.lo[k] ? ((1 << 21) - 1) / (box.hi[k] - box.lo[k]) : 0;
+
+            auto code = [&](size_t t) -> uint64_t
+            {
+                const int32_t * v = file.tets() + 4 * t;
+                CPoint c(0, 0, 0);
+                for (int k = 0; k < 4; k++)
+                {
+                    const int32_t i = in.vertex_index(v[k]);
+                    if (i < 0) return UINT64_MAX;
+                    c += in.point(i);
+                }
+                c /= 4;
+                uint32_t x[3];
+                for (int k = 0; k < 3; k++) x[k] = (uint32_t)((c[k] - box.lo[k]) * scale[k]);
+                return MeshLib::CLinearOctree::_morton(x[0], x[1], x[2]);
+            };
+
+            struct CRecord
+            {
+                uint64_t code;
+                uint64_t tet;
+                bool operator<(const CRecord & r) const { return code < r.code || (code == r.code && tet < r.tet); }
+            };
+            const size_t run = std::max<size_t>(1, memory / sizeof(CRecord));
+            const size_t runs = (nt + run - 1) / run;
+
+            // sorted runs, spilled when there is more than one
+            std::vector<CRecord> records;
+            const std::string spill = output + ".runs";
+            FILE * fp = NULL;
+            if (runs > 1 && (fp = fopen(spill.c_str(), "w+b")) == NULL) return false;
+            bool ok = true;
+            for (size_t r = 0; r < runs && ok; r++)
+            {
+                const size_t b = r * run, n = std::min(nt, b + run) - b;
+                records.resize(n);
+                MeshLib::parallel_for(n, threads, [&](size_t i0, size_t i1)
+                {
+                    for (size_t i = i0; i < i1; i++) records[i] = { code(b + i), b + i };
+                }, 1 << 12);
+                MeshLib::parallel_sort(records.begin(), records.end(), threads, std::less<CRecord>());
+                if (fp) ok = fwrite(records.data(), sizeof(CRecord), n, fp) == n;
+            }
+
+            MeshLib::CTmvWriter writer;
+            ok = ok && writer.open(output, nv, nt);
+
+            // vertices are numbered on first use as the sorted tets go out
+            std::vector<int32_t> order, position(nv, -1);
+            order.reserve(nv);
+            std::vector<int32_t> tets, tet_ids;
+            size_t written = 0;
+            auto emit = [&](const CRecord * r, size_t n)
+            {
+                tets.resize(4 * n);
+                tet_ids.resize(n);
+                for (size_t i = 0; i < n; i++)
+                {
+                    const int32_t * v = file.tets() + 4 * r[i].tet;
+                    for (int k = 0; k < 4; k++)
+                    {
+                        tets[4 * i + k] = v[k];
+                        const int32_t j = in.vertex_index(v[k]);
+                        if (j >= 0 && position[j] < 0)
+                        {
+                            position[j] = (int32_t)order.size();
+                            order.push_back(j);
+                        }
+                    }
+                    tet_ids[i] = file.tet_ids()[r[i].tet];
+                }
+                ok = ok && writer.write(2, 16 * (uint64_t)written, tets.data(), 16 * n);
+                ok = ok && writer.write(3, 4 * (uint64_t)written, tet_ids.data(), 4 * n);
+                written += n;
+            };
+
+            if (!fp) emit(records.data(), records.size());
+            else
+            {
+                // k-way merge, each run read through its own buffer
+                std::vector<CRecord>().swap(records);
+                const size_t buffer = std::max<size_t>(1, run / (runs + 1));
+                struct CRun { uint64_t next, end; std::vector<CRecord> buf; size_t pos; };
+                std::vector<CRun> rs(runs);
+                auto refill = [&](CRun & r)
+                {
+                    const size_t n = (size_t)std::min<uint64_t>(buffer, r.end - r.next);
+                    r.buf.resize(n);
+                    r.pos = 0;
+                    if (n == 0) return;
+#ifdef _WIN32
+                    ok = ok && _fseeki64(fp, (__int64)(r.next * sizeof(CRecord)), SEEK_SET) == 0;
+#else
+                    ok = ok && fseeko(fp, (off_t)(r.next * sizeof(CRecord)), SEEK_SET) == 0;
+#endif
+                    ok = ok && fread(r.buf.data(), sizeof(CRecord), n, fp) == n;
+                    r.next += n;
+                };
+                typedef std::pair<CRecord, size_t> CHead;
+                auto later = [](const CHead & a, const CHead & b) { return b.first < a.first; };
+                std::vector<CHead> heap;
+                for (size_t r = 0; r < runs; r++)
+                {
+                    rs[r].next = r * run;
+                    rs[r].end = std::min(nt, (r + 1) * run);
+                    refill(rs[r]);
+                    heap.push_back(CHead(rs[r].buf[0], r));
+                }
+                std::make_heap(heap.begin(), heap.end(), later);
+
+                std::vector<CRecord> out;
+                out.reserve(buffer);
+                while (!heap.empty() && ok)
+                {
+                    std::pop_heap(heap.begin(), heap.end(), later);
+                    const CHead h = heap.back();
+                    heap.pop_back();
+                    out.push_back(h.first);
+                    if (out.size() == buffer)
+                    {
+                        emit(out.data(), out.size());
+                        out.clear();
+                    }
+
+                    CRun & r = rs[h.second];
+                    if (++r.pos == r.buf.size()) refill(r);
+                    if (r.pos < r.buf.size())
+                    {
+                        heap.push_back(CHead(r.buf[r.pos], h.second));
+                        std::push_heap(heap.begin(), heap.end(), later);
+                    }
+                }
+                emit(out.data(), out.size());
+                fclose(fp);
+                remove(spill.c_str());
+            }
+
+            // the vertices no tet uses go last
+            for (size_t v = 0; v < nv; v++)
+                if (position[v] < 0) order.push_back((int32_t)v);
+
+            const size_t block = 1 << 16;
+            std::vector<double> positions;
+            std::vector<int32_t> ids;
+            for (size_t b = 0; b < nv && ok; b += block)
+            {
+                const size_t n = std::min(nv, b + block) - b;
+                positions.resize(3 * n);
+                ids.resize(n);
+                for (size_t i = 0; i < n; i++)
+                {
+                    std::copy(file.positions() + 3 * (size_t)order[b + i], file.positions() + 3 * (size_t)order[b + i] + 3, &positions[3 * i]);
+                    ids[i] = file.vertex_ids()[order[b + i]];
+                }
+                ok = writer.write(0, 24 * (uint64_t)b, positions.data(), 24 * n) && writer.write(1, 4 * (uint64_t)b, ids.data(), 4 * n);
+            }
+            return writer.close() && ok;
+        }
+
+    protected:
+        /*! fold the histogram of a chunk into the running one, bins alike */
+        static void _add(CQualityHistogram & h, const CQualityHistogram & c)
+        {
+            const size_t n = h.count(), m = c.count();
+            if (h.bins.empty()) { h = c; return; }
+            for (size_t k = 0; k < h.bins.size(); k++) h.bins[k] += c.bins[k];
+            h.min = std::min(h.min, c.min);
+            h.max = std::max(h.max, c.max);
+            if (n + m > 0) h.mean = (h.mean * n + c.mean * m) / (n + m);
+        }
+
+        MeshLib::CTmvFile    m_file;
+        /*! file position of every vertex id from m_min_id on, -1 for unused ids */
+        std::vector<int32_t> m_index;
+        int32_t              m_min_id = 0;
+
+        size_t               m_chunk = (size_t)1 << 20;
+        size_t               m_halo = 0;
+        /*! the first tet of the next run */
+        size_t               m_next = 0;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,320 @@
+/*!
+*      \file ckp.h
+*      \brief Binary checkpoint of the in-memory state of a mesh (.ckp)
+*
+*      A checkpoint is a list of named blocks of raw values, the arrays of a
+*      mesh by element slot as CBaseMesh::checkpoint() lays them out, with the
+*      links between the elements as slot indices. The blocks are written as
+*      they are in memory and read back by mapping the file, nothing is parsed:
+*
+*          CCkpHeader
+*          blocks      every one on a 16 byte boundary
+*          index       CCkpEntry per block, then their names
+*
+*      The values are in the byte order and the layout of the machine that
+*      wrote them, a checkpoint is meant to be read back by the program that
+*      took it, not to be exchanged. A checkpoint is immutable once taken, so
+*      it is written on a thread of its own while the mesh goes on changing,
+*      see CCheckpointWriter, through a temporary file renamed into place, so
+*      a crash while writing leaves the checkpoint before it.
+*/
+
+#ifndef _MESHLIB_CKP_H_
+#define _MESHLIB_CKP_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "mmap.h"
+
+#define CKP_VERSION 1
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CCkpHeader, the first bytes of a .ckp file
+     */
+    struct CCkpHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t blocks;
+        uint32_t reserved;
+        /*! byte offset of the index */
+        uint64_t index;
+
+        CCkpHeader()
+        {
+            memcpy(magic, "CKP\x1a", 4);
+            version = CKP_VERSION;
+            blocks = 0;
+            reserved = 0;
+            index = 0;
+        }
+
+        bool valid() const { return memcmp(magic, "CKP\x1a", 4) == 0 && version == CKP_VERSION; }
+    };
+
+    /*!
+     *  \brief CCkpEntry, where a block is in a .ckp file
+     */
+    struct CCkpEntry
+    {
+        uint64_t offset;
+        uint64_t size;
+        //! number of values, size / count bytes each
+        uint64_t count;
+        //! the name, at name_offset from the end of the entries
+        uint32_t name_offset;
+        uint32_t name_length;
+    };
+
+    /*!
+     *  \brief CCheckpoint class, named blocks of raw values, in memory or mapped from a .ckp file
+     */
+    class CCheckpoint
+    {
+    public:
+        /*! a named array of count values, size bytes in all */
+        struct CBlock
+        {
+            std::string  name;
+            uint64_t     count = 0;
+            uint64_t     size = 0;
+            const char * data = NULL;
+        };
+
+        /*!
+         *  A new block of n values of type T, not initialized, the caller fills them. A block of
+         *  the same name is replaced
+         */
+        template<typename T>
+        T * add(const std::string & name, size_t n) { return (T *)add(name, n, sizeof(T)); }
+        /*! a new block of n values of value_size bytes each, not initialized */
+        char * add(const std::string & name, size_t n, size_t value_size)
+        {
+            m_owned.emplace_back(new char[n * value_size > 0 ? n * value_size : 1]);
+            CBlock b;
+            b.name = name;
+            b.count = n;
+            b.size = n * value_size;
+            b.data = m_owned.back().get();
+            remove(name);
+            m_blocks.push_back(b);
+            return m_owned.back().get();
+        }
+        /*! a new block with a copy of the n values at data */
+        template<typename T>
+        void add(const std::string & name, const T * data, size_t n)
+        {
+            if (n) memcpy(add<T>(name, n), data, n * sizeof(T));
+            else add<T>(name, 0);
+        }
+        /*! a block of the characters of s */
+        void add(const std::string & name, const std::string & s) { add(name, s.data(), s.size()); }
+
+        /*! the block of this name, NULL if there is none */
+        const CBlock * find(const std::string & name) const
+        {
+            for (const CBlock & b : m_blocks) if (b.name == name) return &b;
+            return NULL;
+        }
+        /*! the values of the block of this name if it holds n of type T, NULL otherwise */
+        template<typename T>
+        const T * get(const std::string & name, size_t n) const
+        {
+            const CBlock * b = find(name);
+            return b && b->count == n && b->size == n * sizeof(T) ? (const T *)b->data : NULL;
+        }
+        /*! the block as a string, empty if there is none */
+        std::string text(const std::string & name) const
+        {
+            const CBlock * b = find(name);
+            return b ? std::string(b->data, (size_t)b->size) : std::string();
+        }
+
+        void remove(const std::string & name)
+        {
+            for (size_t i = 0; i < m_blocks.size(); i++)
+            {
+                if (m_blocks[i].name != name) continue;
+                m_blocks.erase(m_blocks.begin() + i);
+                return;
+            }
+        }
+
+        const std::vector<CBlock> & blocks() const { return m_blocks; }
+        /*! bytes of the blocks */
+        size_t memory() const
+        {
+            size_t bytes = 0;
+            for (const CBlock & b : m_blocks) bytes += (size_t)b.size;
+            return bytes;
+        }
+
+        /*!
+         *  Map a .ckp file, the blocks point into the mapping until the checkpoint is read again
+         *  \return false if the file is missing or damaged
+         */
+        bool read(const std::string & filename)
+        {
+            m_blocks.clear();
+            m_owned.clear();
+            m_file = std::make_shared<CMappedFile>();
+            if (!m_file->open(filename, CMappedFile::MAP) || m_file->size() < sizeof(CCkpHeader)) return _fail();
+            const char * base = m_file->begin();
+            const uint64_t size = m_file->size();
+            CCkpHeader header;
+            memcpy(&header, base, sizeof(CCkpHeader));
+            if (!header.valid() || header.index > size || (size - header.index) / sizeof(CCkpEntry) < header.blocks) return _fail();
+
+            const uint64_t names = header.index + (uint64_t)header.blocks * sizeof(CCkpEntry);
+            for (uint32_t i = 0; i < header.blocks; i++)
+            {
+                CCkpEntry e;
+                memcpy(&e, base + header.index + i * sizeof(CCkpEntry), sizeof(CCkpEntry));
+                if (e.offset > size || e.size > size - e.offset || names + e.name_offset + e.name_length > size) return _fail();
+                CBlock b;
+                b.name.assign(base + names + e.name_offset, e.name_length);
+                b.count = e.count;
+                b.size = e.size;
+                b.data = base + e.offset;
+                m_blocks.push_back(b);
+            }
+            return true;
+        }
+
+        /*!
+         *  Write a .ckp file, through a temporary file renamed into place
+         *  \param written if not NULL, the bytes written so far as the write goes on
+         *  \return false if the file cannot be written
+         */
+        bool write(const std::string & filename, std::atomic<uint64_t> * written = NULL) const
+        {
+            const std::string tmp = filename + ".tmp";
+            FILE * fp = fopen(tmp.c_str(), "wb");
+            if (fp == NULL) return false;
+
+            CCkpHeader header;
+            header.blocks = (uint32_t)m_blocks.size();
+            std::vector<CCkpEntry> entries(m_blocks.size());
+            std::string names;
+            uint64_t pos = (sizeof(CCkpHeader) + 15) & ~(uint64_t)15;
+            for (size_t i = 0; i < m_blocks.size(); i++)
+            {
+                entries[i].offset = pos;
+                entries[i].size = m_blocks[i].size;
+                entries[i].count = m_blocks[i].count;
+                entries[i].name_offset = (uint32_t)names.size();
+                entries[i].name_length = (uint32_t)m_blocks[i].name.size();
+                names += m_blocks[i].name;
+                pos = (pos + m_blocks[i].size + 15) & ~(uint64_t)15;
+            }
+            header.index = pos;
+
+            bool ok = fwrite(&header, sizeof(CCkpHeader), 1, fp) == 1;
+            uint64_t at = sizeof(CCkpHeader);
+            static const char zeros[16] = { 0 };
+            for (size_t i = 0; i < m_blocks.size() && ok; i++)
+            {
+                ok = fwrite(zeros, 1, (size_t)(entries[i].offset - at), fp) == entries[i].offset - at;
+                // in slices, so that the progress moves on a large block
+                const size_t slice = (size_t)1 << 26;
+                for (uint64_t b = 0; b < m_blocks[i].size && ok; b += slice)
+                {
+                    const size_t n = (size_t)std::min<uint64_t>(slice, m_blocks[i].size - b);
+                    ok = fwrite(m_blocks[i].data + b, 1, n, fp) == n;
+                    if (written) *written += n;
+                }
+                at = entries[i].offset + m_blocks[i].size;
+            }
+            ok = ok && fwrite(zeros, 1, (size_t)(header.index - at), fp) == header.index - at;
+            ok = ok && (entries.empty() || fwrite(entries.data(), sizeof(CCkpEntry), entries.size(), fp) == entries.size());
+            ok = ok && fwrite(names.data(), 1, names.size(), fp) == names.size();
+
+            ok = (fclose(fp) == 0) && ok;
+#ifdef _WIN32
+            // rename does not replace a file there, MoveFileEx does in one step
+            ok = ok && win32::replace_file(tmp.c_str(), filename.c_str());
+#else
+            ok = ok && std::rename(tmp.c_str(), filename.c_str()) == 0;
+#endif
+            if (!ok) std::remove(tmp.c_str());
+            return ok;
+        }
+
+    protected:
+        bool _fail()
+        {
+            m_blocks.clear();
+            m_file.reset();
+            return false;
+        }
+
+        std::vector<CBlock>                  m_blocks;
+        std::vector<std::unique_ptr<char[]>> m_owned;
+        std::shared_ptr<CMappedFile>         m_file;
+    };
+
+    /*!
+     *  \brief CCheckpointWriter class, writes checkpoints on a thread of its own, one at a time
+     *
+     *  The checkpoint is shared with the caller, who may drop it right away. The
+     *  destructor waits for the write in flight.
+     */
+    class CCheckpointWriter
+    {
+    public:
+        ~CCheckpointWriter() { wait(); }
+
+        /*!
+         *  Start writing checkpoint to filename, after the write before it is done
+         *  \return false, and nothing started, if a write is still in flight and wait is false
+         */
+        bool write(std::shared_ptr<const CCheckpoint> checkpoint, const std::string & filename, bool wait = true)
+        {
+            if (busy() && !wait) return false;
+            this->wait();
+            m_total = checkpoint->memory();
+            m_written = 0;
+            m_busy = true;
+            m_thread = std::thread([this, checkpoint, filename]()
+            {
+                m_ok = checkpoint->write(filename, &m_written);
+                m_busy = false;
+            });
+            return true;
+        }
+
+        /*! whether a write is in flight */
+        bool busy() const { return m_busy; }
+        /*! the share of the write in flight done, 1 when there is none */
+        double progress() const { return m_busy && m_total ? (double)m_written / (double)m_total : 1.0; }
+
+        /*! wait for the write in flight \return false if the last write failed */
+        bool wait()
+        {
+            if (m_thread.joinable()) m_thread.join();
+            return m_ok;
+        }
+
+    protected:
+        std::thread           m_thread;
+        std::atomic<bool>     m_busy{ false };
+        std::atomic<uint64_t> m_written{ 0 };
+        uint64_t              m_total = 0;
+        bool                  m_ok = true;
+    };
+
+}; //namespace
+
+#endif
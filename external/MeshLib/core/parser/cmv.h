@@ -0,0 +1,521 @@
+/*!
+*      \file cmv.h
+*      \brief Compressed triangle mesh format (.cmv)
+*
+*      A version of .smv for archives and transfers:
+*
+*          CCmvHeader
+*          wedge blocks    CCmvBlock per block of wedges
+*          triangle blocks CCmvBlock per block of triangles
+*          the coded bytes of the blocks
+*
+*      A wedge is a vertex with one uv and normal, the wedges of a vertex
+*      differ across seams. Vertices and wedges are numbered in the order the
+*      triangles first use them: wedge i < num_vertices is the first wedge of
+*      vertex i, later ones follow as extra wedges with their vertex coded.
+*      Points are quantized to a grid over the bounding box, uvs over theirs,
+*      normals in the octahedral map, every value as the zigzag varint of its
+*      difference to the one of the wedge before. A corner of a triangle is
+*      0 for the next new vertex, 1 for the next new extra wedge, or twice the
+*      distance back to an earlier wedge, plus one for extra wedges. Blocks
+*      restart the differences and carry the counters of new wedges, so they
+*      are decoded in parallel.
+*/
+
+#ifndef _MESHLIB_CMV_H_
+#define _MESHLIB_CMV_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "mmap.h"
+#include "parallel.h"
+
+#define CMV_VERSION 1
+
+#define CMV_UV      (0x01<<0)
+#define CMV_NORMAL  (0x01<<1)
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CCmvHeader, the first bytes of a .cmv file
+     */
+    struct CCmvHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint8_t  position_bits;
+        uint8_t  uv_bits;
+        uint8_t  normal_bits;
+        uint8_t  reserved;
+        uint64_t num_vertices;
+        uint64_t num_wedges;
+        uint64_t num_triangles;
+        /*! a point is lo + q * step */
+        double   lo[3];
+        double   step;
+        /*! a uv is uv_lo + q * uv_step */
+        double   uv_lo[2];
+        double   uv_step;
+        uint32_t num_wedge_blocks;
+        uint32_t num_triangle_blocks;
+        /*! byte offsets of the wedge blocks, the triangle blocks and the coded bytes */
+        uint64_t offset[3];
+
+        CCmvHeader()
+        {
+            memset(this, 0, sizeof(CCmvHeader));
+            memcpy(magic, "CMV\x1a", 4);
+            version = CMV_VERSION;
+        }
+
+        bool valid() const { return memcmp(magic, "CMV\x1a", 4) == 0 && version == CMV_VERSION; }
+    };
+
+    /*!
+     *  \brief CCmvBlock, a block of wedges or triangles and where its bytes are
+     */
+    struct CCmvBlock
+    {
+        uint64_t first;
+        uint64_t count;
+        /*! the bytes, from the offset of the coded bytes */
+        uint64_t offset;
+        uint64_t size;
+        /*! of a triangle block, the next new vertex and extra wedge at its start */
+        uint64_t next_vertex;
+        uint64_t next_extra;
+    };
+
+    /*!
+     *  \brief CCmvMesh, a triangle mesh as the arrays a .cmv file holds
+     */
+    struct CCmvMesh
+    {
+        /*! 3 per vertex */
+        std::vector<double>   positions;
+        /*! 2 per wedge, empty without CMV_UV */
+        std::vector<float>    uvs;
+        /*! 3 per wedge, empty without CMV_NORMAL */
+        std::vector<float>    normals;
+        /*! the vertex of every wedge */
+        std::vector<uint32_t> wedge_vertex;
+        /*! 3 wedges per triangle */
+        std::vector<uint32_t> wedges;
+
+        size_t num_vertices() const { return positions.size() / 3; }
+        size_t num_wedges() const { return wedge_vertex.size(); }
+        size_t num_triangles() const { return wedges.size() / 3; }
+    };
+
+    /*!
+     *  \brief CCmvCodec class, encodes and decodes .cmv files
+     */
+    class CCmvCodec
+    {
+    public:
+        /*! bits of a point coordinate, of a uv coordinate and of each of the two octahedral normal coordinates */
+        int position_bits = 16;
+        int uv_bits = 16;
+        int normal_bits = 12;
+        /*! wedges and triangles per block */
+        size_t block = 1 << 16;
+
+        /*!
+         *  Write mesh, in any order, its wedges are renumbered
+         *  \return false if the file cannot be written
+         */
+        bool write(const std::string & filename, const CCmvMesh & mesh, int threads = 0) const;
+        /*!
+         *  Read a .cmv file, the blocks are decoded in parallel
+         *  \return false if the file is missing or damaged
+         */
+        static bool read(const std::string & filename, CCmvMesh & mesh, int threads = 0);
+        /*! the header of a .cmv file, false if it is missing or not one */
+        static bool header(const std::string & filename, CCmvHeader & header);
+
+    protected:
+        static void _put(std::string & out, uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                out.push_back((char)(v | 0x80));
+                v >>= 7;
+            }
+            out.push_back((char)v);
+        }
+        static void _put_delta(std::string & out, int64_t v, int64_t & prev)
+        {
+            const int64_t d = v - prev;
+            prev = v;
+            _put(out, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+        }
+        /*! the next varint, ok is cleared past the end */
+        static uint64_t _get(const uint8_t * &p, const uint8_t * end, bool & ok)
+        {
+            uint64_t v = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (p >= end)
+                {
+                    ok = false;
+                    return 0;
+                }
+                const uint8_t b = *p++;
+                v |= (uint64_t)(b & 0x7f) << shift;
+                if (b < 0x80) return v;
+            }
+            ok = false;
+            return v;
+        }
+        static int64_t _get_delta(const uint8_t * &p, const uint8_t * end, bool & ok, int64_t & prev)
+        {
+            const uint64_t z = _get(p, end, ok);
+            prev += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+            return prev;
+        }
+
+        /*! the octahedral map of a normal, each coordinate in [0, 2^bits - 1] */
+        static void _octahedral(const float * n, int bits, int64_t * q)
+        {
+            const double l = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+            double x = l > 0 ? n[0] / l : 0, y = l > 0 ? n[1] / l : 0;
+            if (n[2] < 0)
+            {
+                const double ox = x;
+                x = (1 - std::fabs(y)) * (ox >= 0 ? 1 : -1);
+                y = (1 - std::fabs(ox)) * (y >= 0 ? 1 : -1);
+            }
+            const double m = (double)((1 << bits) - 1);
+            q[0] = (int64_t)std::llround((x * 0.5 + 0.5) * m);
+            q[1] = (int64_t)std::llround((y * 0.5 + 0.5) * m);
+        }
+        static void _unoctahedral(const int64_t * q, int bits, float * n)
+        {
+            const double m = (double)((1 << bits) - 1);
+            double x = q[0] / m * 2 - 1, y = q[1] / m * 2 - 1;
+            const double z = 1 - std::fabs(x) - std::fabs(y);
+            if (z < 0)
+            {
+                const double ox = x;
+                x = (1 - std::fabs(y)) * (ox >= 0 ? 1 : -1);
+                y = (1 - std::fabs(ox)) * (y >= 0 ? 1 : -1);
+            }
+            const double l = std::sqrt(x * x + y * y + z * z);
+            n[0] = (float)(x / l);
+            n[1] = (float)(y / l);
+            n[2] = (float)(z / l);
+        }
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CCmvCodec::write(const std::string & filename, const CCmvMesh & mesh, int threads) const
+    {
+        const size_t nv = mesh.num_vertices();
+        const size_t nt = mesh.num_triangles();
+        const bool with_uv = !mesh.uvs.empty();
+        const bool with_normal = !mesh.normals.empty();
+        const size_t blk = std::max<size_t>(block, 1);
+
+        // vertices and wedges by first use, wedges of vertices no triangle uses are dropped
+        std::vector<uint32_t> vertex_order(nv, UINT32_MAX), wedge_order(mesh.num_wedges(), UINT32_MAX);
+        std::vector<uint32_t> primary;
+        std::vector<uint32_t> extras;
+        std::vector<uint32_t> corners(3 * nt);
+        std::vector<CCmvBlock> triangle_blocks;
+        uint32_t next_vertex = 0;
+        for (size_t c = 0; c < 3 * nt; c++)
+        {
+            if (c % (3 * blk) == 0)
+            {
+                CCmvBlock b = CCmvBlock();
+                b.first = c / 3;
+                b.count = std::min(blk, nt - c / 3);
+                b.next_vertex = next_vertex;
+                b.next_extra = extras.size();
+                triangle_blocks.push_back(b);
+            }
+            const uint32_t w = mesh.wedges[c];
+            if (wedge_order[w] == UINT32_MAX)
+            {
+                const uint32_t v = mesh.wedge_vertex[w];
+                if (vertex_order[v] == UINT32_MAX)
+                {
+                    vertex_order[v] = next_vertex++;
+                    primary.push_back(w);
+                    wedge_order[w] = vertex_order[v];
+                }
+                else
+                {
+                    wedge_order[w] = UINT32_MAX - 1 - (uint32_t)extras.size();
+                    extras.push_back(w);
+                }
+            }
+            corners[c] = w;
+        }
+        for (size_t v = 0; v < nv; v++)
+        {
+            if (vertex_order[v] != UINT32_MAX) continue;
+            vertex_order[v] = next_vertex++;
+            primary.push_back(UINT32_MAX);
+        }
+        // the extra wedges follow the vertices
+        for (size_t k = 0; k < extras.size(); k++) wedge_order[extras[k]] = (uint32_t)(nv + k);
+        std::vector<uint32_t> vertex_of(nv);
+        for (size_t v = 0; v < nv; v++) vertex_of[vertex_order[v]] = (uint32_t)v;
+
+        const size_t nw = nv + extras.size();
+        CCmvHeader header;
+        header.flags = (with_uv ? CMV_UV : 0) | (with_normal ? CMV_NORMAL : 0);
+        header.position_bits = (uint8_t)std::max(1, std::min(position_bits, 31));
+        header.uv_bits = (uint8_t)std::max(1, std::min(uv_bits, 31));
+        header.normal_bits = (uint8_t)std::max(2, std::min(normal_bits, 30));
+        header.num_vertices = nv;
+        header.num_wedges = nw;
+        header.num_triangles = nt;
+
+        // the grids over the bounds
+        double hi[3] = { 0, 0, 0 }, uv_hi[2] = { 0, 0 };
+        for (int k = 0; k < 3; k++) header.lo[k] = nv ? mesh.positions[k] : 0, hi[k] = header.lo[k];
+        for (size_t i = 0; i < nv; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                header.lo[k] = std::min(header.lo[k], mesh.positions[3 * i + k]);
+                hi[k] = std::max(hi[k], mesh.positions[3 * i + k]);
+            }
+        }
+        double extent = std::max(hi[0] - header.lo[0], std::max(hi[1] - header.lo[1], hi[2] - header.lo[2]));
+        header.step = extent > 0 ? extent / (double)(((uint64_t)1 << header.position_bits) - 1) : 1;
+        if (with_uv)
+        {
+            for (int k = 0; k < 2; k++) header.uv_lo[k] = uv_hi[k] = mesh.uvs.empty() ? 0 : mesh.uvs[k];
+            for (size_t i = 0; 2 * i < mesh.uvs.size(); i++)
+            {
+                for (int k = 0; k < 2; k++)
+                {
+                    header.uv_lo[k] = std::min(header.uv_lo[k], (double)mesh.uvs[2 * i + k]);
+                    uv_hi[k] = std::max(uv_hi[k], (double)mesh.uvs[2 * i + k]);
+                }
+            }
+            extent = std::max(uv_hi[0] - header.uv_lo[0], uv_hi[1] - header.uv_lo[1]);
+            header.uv_step = extent > 0 ? extent / (double)(((uint64_t)1 << header.uv_bits) - 1) : 1;
+        }
+
+        std::vector<CCmvBlock> wedge_blocks;
+        for (size_t w = 0; w < nw; w += blk)
+        {
+            CCmvBlock b = CCmvBlock();
+            b.first = w;
+            b.count = std::min(blk, nw - w);
+            wedge_blocks.push_back(b);
+        }
+        std::vector<std::string> bytes(wedge_blocks.size() + triangle_blocks.size());
+
+        parallel_for(wedge_blocks.size(), threads, [&](size_t bb, size_t be)
+        {
+            for (size_t i = bb; i < be; i++)
+            {
+                const CCmvBlock & b = wedge_blocks[i];
+                std::string & out = bytes[i];
+                int64_t prev[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+                for (uint64_t w = b.first; w < b.first + b.count; w++)
+                {
+                    // the original wedge, if any, whose attributes w has
+                    uint32_t source;
+                    if (w < nv)
+                    {
+                        const uint32_t v = vertex_of[w];
+                        for (int k = 0; k < 3; k++)
+                        {
+                            const double q = std::floor((mesh.positions[3 * v + k] - header.lo[k]) / header.step + 0.5);
+                            _put_delta(out, (int64_t)q, prev[k]);
+                        }
+                        source = primary[w];
+                    }
+                    else
+                    {
+                        source = extras[w - nv];
+                        _put_delta(out, vertex_order[mesh.wedge_vertex[source]], prev[3]);
+                    }
+                    if (with_uv)
+                    {
+                        for (int k = 0; k < 2; k++)
+                        {
+                            const double t = source == UINT32_MAX ? header.uv_lo[k] : mesh.uvs[2 * source + k];
+                            _put_delta(out, (int64_t)std::floor((t - header.uv_lo[k]) / header.uv_step + 0.5), prev[4 + k]);
+                        }
+                    }
+                    if (with_normal)
+                    {
+                        static const float up[3] = { 0, 0, 1 };
+                        int64_t q[2];
+                        _octahedral(source == UINT32_MAX ? up : &mesh.normals[3 * source], header.normal_bits, q);
+                        for (int k = 0; k < 2; k++) _put_delta(out, q[k], prev[6 + k]);
+                    }
+                }
+            }
+        }, 1);
+
+        parallel_for(triangle_blocks.size(), threads, [&](size_t bb, size_t be)
+        {
+            for (size_t i = bb; i < be; i++)
+            {
+                const CCmvBlock & b = triangle_blocks[i];
+                std::string & out = bytes[wedge_blocks.size() + i];
+                uint64_t next_v = b.next_vertex, next_x = nv + b.next_extra;
+                for (uint64_t c = 3 * b.first; c < 3 * (b.first + b.count); c++)
+                {
+                    const uint64_t w = wedge_order[corners[c]];
+                    if (w < nv && w == next_v) { _put(out, 0); next_v++; }
+                    else if (w == next_x) { _put(out, 1); next_x++; }
+                    else if (w < nv) _put(out, 2 * (next_v - w));
+                    else _put(out, 2 * (next_x - w) + 1);
+                }
+            }
+        }, 1);
+
+        header.num_wedge_blocks = (uint32_t)wedge_blocks.size();
+        header.num_triangle_blocks = (uint32_t)triangle_blocks.size();
+        header.offset[0] = sizeof(CCmvHeader);
+        header.offset[1] = header.offset[0] + sizeof(CCmvBlock) * wedge_blocks.size();
+        header.offset[2] = header.offset[1] + sizeof(CCmvBlock) * triangle_blocks.size();
+        uint64_t pos = 0;
+        for (size_t i = 0; i < bytes.size(); i++)
+        {
+            CCmvBlock & b = i < wedge_blocks.size() ? wedge_blocks[i] : triangle_blocks[i - wedge_blocks.size()];
+            b.offset = pos;
+            b.size = bytes[i].size();
+            pos += b.size;
+        }
+
+        FILE * fp = fopen(filename.c_str(), "wb");
+        if (fp == NULL) return false;
+        bool ok = fwrite(&header, sizeof(CCmvHeader), 1, fp) == 1;
+        ok = ok && (wedge_blocks.empty() || fwrite(wedge_blocks.data(), sizeof(CCmvBlock), wedge_blocks.size(), fp) == wedge_blocks.size());
+        ok = ok && (triangle_blocks.empty() || fwrite(triangle_blocks.data(), sizeof(CCmvBlock), triangle_blocks.size(), fp) == triangle_blocks.size());
+        for (size_t i = 0; i < bytes.size() && ok; i++) ok = bytes[i].empty() || fwrite(bytes[i].data(), 1, bytes[i].size(), fp) == bytes[i].size();
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) remove(filename.c_str());
+        return ok;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CCmvCodec::header(const std::string & filename, CCmvHeader & header)
+    {
+        FILE * fp = fopen(filename.c_str(), "rb");
+        if (fp == NULL) return false;
+        const bool ok = fread(&header, sizeof(CCmvHeader), 1, fp) == 1;
+        fclose(fp);
+        return ok && header.valid();
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CCmvCodec::read(const std::string & filename, CCmvMesh & mesh, int threads)
+    {
+        CMappedFile file(filename);
+        if (!file.is_open() || file.size() < sizeof(CCmvHeader)) return false;
+        CCmvHeader header;
+        memcpy(&header, file.begin(), sizeof(CCmvHeader));
+        if (!header.valid() || header.position_bits > 31 || header.uv_bits > 31 || header.normal_bits < 2 || header.normal_bits > 30) return false;
+        if (header.num_wedges < header.num_vertices || header.num_wedges > UINT32_MAX) return false;
+
+        const uint64_t tables = sizeof(CCmvBlock) * ((uint64_t)header.num_wedge_blocks + header.num_triangle_blocks);
+        if (header.offset[0] != sizeof(CCmvHeader) || header.offset[2] != header.offset[0] + tables || header.offset[2] > file.size()) return false;
+        std::vector<CCmvBlock> blocks(header.num_wedge_blocks + header.num_triangle_blocks);
+        if (!blocks.empty()) memcpy(&blocks[0], file.begin() + header.offset[0], tables);
+        const uint64_t data_size = file.size() - header.offset[2];
+        uint64_t wedges = 0, triangles = 0;
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            const CCmvBlock & b = blocks[i];
+            if (b.offset > data_size || b.size > data_size - b.offset) return false;
+            const bool wedge = i < header.num_wedge_blocks;
+            if (b.first != (wedge ? wedges : triangles)) return false;
+            (wedge ? wedges : triangles) += b.count;
+            if (!wedge && (b.next_vertex > header.num_vertices || header.num_vertices + b.next_extra > header.num_wedges)) return false;
+        }
+        if (wedges != header.num_wedges || triangles != header.num_triangles) return false;
+
+        const size_t nv = (size_t)header.num_vertices;
+        const size_t nw = (size_t)header.num_wedges;
+        const bool with_uv = (header.flags & CMV_UV) != 0;
+        const bool with_normal = (header.flags & CMV_NORMAL) != 0;
+        mesh.positions.resize(3 * nv);
+        mesh.uvs.assign(with_uv ? 2 * nw : 0, 0.0f);
+        mesh.normals.assign(with_normal ? 3 * nw : 0, 0.0f);
+        mesh.wedge_vertex.resize(nw);
+        mesh.wedges.resize(3 * (size_t)header.num_triangles);
+
+        const uint8_t * data = (const uint8_t *)file.begin() + header.offset[2];
+        std::atomic<bool> failed(false);
+        parallel_for(blocks.size(), threads, [&](size_t bb, size_t be)
+        {
+            for (size_t i = bb; i < be; i++)
+            {
+                const CCmvBlock & b = blocks[i];
+                const uint8_t * p = data + b.offset;
+                const uint8_t * end = p + b.size;
+                bool ok = true;
+                if (i < header.num_wedge_blocks)
+                {
+                    int64_t prev[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+                    for (uint64_t w = b.first; w < b.first + b.count && ok; w++)
+                    {
+                        if (w < nv)
+                        {
+                            for (int k = 0; k < 3; k++) mesh.positions[3 * w + k] = header.lo[k] + (double)_get_delta(p, end, ok, prev[k]) * header.step;
+                            mesh.wedge_vertex[w] = (uint32_t)w;
+                        }
+                        else
+                        {
+                            const int64_t v = _get_delta(p, end, ok, prev[3]);
+                            ok = ok && v >= 0 && (uint64_t)v < nv;
+                            mesh.wedge_vertex[w] = (uint32_t)v;
+                        }
+                        if (with_uv)
+                        {
+                            for (int k = 0; k < 2; k++) mesh.uvs[2 * w + k] = (float)(header.uv_lo[k] + (double)_get_delta(p, end, ok, prev[4 + k]) * header.uv_step);
+                        }
+                        if (with_normal)
+                        {
+                            int64_t q[2];
+                            for (int k = 0; k < 2; k++) q[k] = _get_delta(p, end, ok, prev[6 + k]);
+                            _unoctahedral(q, header.normal_bits, &mesh.normals[3 * w]);
+                        }
+                    }
+                }
+                else
+                {
+                    uint64_t next_v = b.next_vertex, next_x = nv + b.next_extra;
+                    for (uint64_t c = 3 * b.first; c < 3 * (b.first + b.count) && ok; c++)
+                    {
+                        const uint64_t code = _get(p, end, ok);
+                        uint64_t w;
+                        if (code == 0) w = next_v++;
+                        else if (code == 1) w = next_x++;
+                        else if (code & 1) w = next_x - (code - 1) / 2;
+                        else w = next_v - code / 2;
+                        // a distance past the start wraps around and is caught here
+                        ok = ok && w < nw && next_v <= nv && next_x <= nw && (w < nv ? w < next_v : w >= nv && w < next_x);
+                        mesh.wedges[c] = (uint32_t)w;
+                    }
+                }
+                if (!ok) failed = true;
+            }
+        }, 1);
+        return !failed;
+    };
+
+}; //namespace
+
+#endif
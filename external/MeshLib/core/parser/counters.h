@@ -0,0 +1,208 @@
+/*!
+*      \file counters.h
+*      \brief Named performance counters, read live by a panel or a monitoring agent
+*
+*      A counter is looked up by name once, MESHLIB_COUNTER_ADD("name", n)
+*      keeps it in a static of the call site, and from then on an add is a
+*      relaxed fetch_add on the shard of the calling thread, so threads adding
+*      to the same counter do not share a cache line. A count only grows, a
+*      reader takes rates from two snapshots; a gauge is a level, bytes in use
+*      say, raised and lowered by adds or set outright. With
+*      MESHLIB_NO_COUNTERS defined the macros compile to nothing.
+*/
+
+#ifndef _MESHLIB_COUNTERS_H_
+#define _MESHLIB_COUNTERS_H_
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CCounter class, a 64 bit value summed over per-thread shards
+     */
+    class CCounter
+    {
+    public:
+        enum Kind { COUNT, GAUGE };
+
+        CCounter(const std::string & name, Kind kind) : m_name(name), m_kind(kind)
+        {
+            for (CShard & s : m_shards) s.value.store(0, std::memory_order_relaxed);
+        }
+
+        const std::string & name() const { return m_name; }
+        Kind kind() const { return m_kind; }
+
+        void add(int64_t n) { m_shards[_shard()].value.fetch_add(n, std::memory_order_relaxed); }
+        /*! the value of a gauge, racing adds of other threads may be lost */
+        void set(int64_t v)
+        {
+            for (int i = 1; i < s_shards; i++) m_shards[i].value.store(0, std::memory_order_relaxed);
+            m_shards[0].value.store(v, std::memory_order_relaxed);
+        }
+        int64_t value() const
+        {
+            int64_t sum = 0;
+            for (const CShard & s : m_shards) sum += s.value.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+    protected:
+        static const int s_shards = 16;
+
+        //! padded to a cache line
+        struct CShard
+        {
+            std::atomic<int64_t> value;
+            char pad[64 - sizeof(std::atomic<int64_t>)];
+        };
+
+        /*! the shard of the calling thread, threads take them round robin */
+        static int _shard()
+        {
+            static std::atomic<int> next(0);
+            static thread_local int shard = next.fetch_add(1, std::memory_order_relaxed) % s_shards;
+            return shard;
+        }
+
+        std::string m_name;
+        Kind        m_kind;
+        CShard      m_shards[s_shards];
+    };
+
+    /*!
+     *  \brief CCounters class, the registry of all counters of the process
+     */
+    class CCounters
+    {
+    public:
+        struct CValue
+        {
+            std::string    name;
+            CCounter::Kind kind;
+            int64_t        value;
+        };
+
+        /*! the count of a name, created on first use, it lives as long as the process */
+        static CCounter & count(const std::string & name) { return _get(name, CCounter::COUNT); }
+        /*! the gauge of a name, created on first use */
+        static CCounter & gauge(const std::string & name) { return _get(name, CCounter::GAUGE); }
+
+        /*! the values of all counters, sorted by name */
+        static std::vector<CValue> snapshot()
+        {
+            CState & s = _state();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            std::vector<CValue> values;
+            for (auto & c : s.names) values.push_back(CValue{ c.first, c.second->kind(), c.second->value() });
+            return values;
+        }
+
+        /*! milliseconds since the first use of the registry */
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _state().origin).count();
+        }
+
+        /*! {"time_ms": t, "counts": {name: value, ...}, "gauges": {name: value, ...}} */
+        static std::string json()
+        {
+            const std::vector<CValue> values = snapshot();
+            std::string text = "{\"time_ms\":" + std::to_string(now());
+            for (int kind = CCounter::COUNT; kind <= CCounter::GAUGE; kind++)
+            {
+                text += kind == CCounter::COUNT ? ",\"counts\":{" : ",\"gauges\":{";
+                bool first = true;
+                for (const CValue & v : values)
+                {
+                    if (v.kind != kind) continue;
+                    text += (first ? "\"" : ",\"") + _escape(v.name) + "\":" + std::to_string(v.value);
+                    first = false;
+                }
+                text += "}";
+            }
+            return text + "}\n";
+        }
+
+        /*!
+         *  Write json() to a file, through a temporary one renamed over it so
+         *  that a reader never sees half of it
+         *  \return false if the file cannot be written
+         */
+        static bool write_json(const std::string & filename)
+        {
+            const std::string temporary = filename + ".tmp";
+            FILE * fp = fopen(temporary.c_str(), "w");
+            if (!fp) return false;
+            const std::string text = json();
+            const bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+            if (fclose(fp) != 0 || !ok) return false;
+            std::remove(filename.c_str());
+            return std::rename(temporary.c_str(), filename.c_str()) == 0;
+        }
+
+    protected:
+        struct CState
+        {
+            std::mutex                            mutex;
+            std::deque<std::unique_ptr<CCounter>> counters;
+            std::map<std::string, CCounter *>     names;
+            std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        };
+
+        static CState & _state()
+        {
+            static CState * state = new CState();   //the statics of the call sites keep pointers into it
+            return *state;
+        }
+
+        static CCounter & _get(const std::string & name, CCounter::Kind kind)
+        {
+            CState & s = _state();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            auto found = s.names.find(name);
+            if (found != s.names.end()) return *found->second;
+            s.counters.emplace_back(new CCounter(name, kind));
+            s.names[name] = s.counters.back().get();
+            return *s.counters.back();
+        }
+
+        static std::string _escape(const std::string & text)
+        {
+            std::string out;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\') out += '\\';
+                out += c;
+            }
+            return out;
+        }
+    };
+
+}; //namespace
+
+#ifndef MESHLIB_NO_COUNTERS
+//! adds n to the count name, a string literal
+#define MESHLIB_COUNTER_ADD(name, n) do { static MeshLib::CCounter & meshlib_counter = MeshLib::CCounters::count(name); meshlib_counter.add((int64_t)(n)); } while (0)
+//! adds n, negative to lower it, to the gauge name
+#define MESHLIB_GAUGE_ADD(name, n) do { static MeshLib::CCounter & meshlib_gauge = MeshLib::CCounters::gauge(name); meshlib_gauge.add((int64_t)(n)); } while (0)
+//! sets the gauge name to v
+#define MESHLIB_GAUGE_SET(name, v) do { static MeshLib::CCounter & meshlib_gauge = MeshLib::CCounters::gauge(name); meshlib_gauge.set((int64_t)(v)); } while (0)
+#else
+#define MESHLIB_COUNTER_ADD(name, n) ((void)0)
+#define MESHLIB_GAUGE_ADD(name, n) ((void)0)
+#define MESHLIB_GAUGE_SET(name, v) ((void)0)
+#endif
+
+#endif
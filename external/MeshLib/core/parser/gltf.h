@@ -0,0 +1,451 @@
+/*!
+*      \file gltf.h
+*      \brief Binary glTF 2.0 files (.glb)
+*
+*      A .glb is a 12 byte header, a JSON chunk describing the scene and a
+*      binary chunk holding the arrays:
+*
+*          magic "glTF", version 2, total length
+*          chunk length, "JSON", the JSON text padded with spaces
+*          chunk length, "BIN\0", the buffer padded with zeros
+*
+*      An accessor of the JSON, POSITION of a mesh primitive say, is a typed,
+*      strided view into a buffer view of the binary chunk. CGlbFile maps the
+*      file and converts accessors straight from the mapping, in parallel.
+*/
+
+#ifndef _MESHLIB_GLTF_H_
+#define _MESHLIB_GLTF_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "mmap.h"
+#include "numparse.h"
+#include "parallel.h"
+
+#define GLTF_BYTE           5120
+#define GLTF_UNSIGNED_BYTE  5121
+#define GLTF_SHORT          5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT   5125
+#define GLTF_FLOAT          5126
+
+#define GLTF_TRIANGLES      4
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CJsonValue class, a parsed JSON value
+     *
+     *  Missing members and items read as null, so paths such as
+     *  json["meshes"][0]["primitives"] need no checks on the way.
+     */
+    class CJsonValue
+    {
+    public:
+        enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+        Type type = NUL;
+        double number = 0;
+        std::string string;
+        /*! the items of an array, the member values of an object */
+        std::vector<CJsonValue> items;
+        /*! the member names of an object */
+        std::vector<std::string> keys;
+
+        bool is_null() const { return type == NUL; }
+        size_t size() const { return items.size(); }
+
+        const CJsonValue & operator[](size_t i) const { return i < items.size() ? items[i] : _null(); }
+        const CJsonValue & operator[](const char * key) const
+        {
+            for (size_t i = 0; i < keys.size(); i++) if (keys[i] == key) return items[i];
+            return _null();
+        }
+        /*! the number, def if it is not one */
+        double as_double(double def = 0) const { return type == NUMBER ? number : def; }
+        long long as_int(long long def = -1) const { return type == NUMBER ? (long long)number : def; }
+
+        /*!
+         *  Parse the JSON text [p, end)
+         *  \return false if it is not valid JSON
+         */
+        static bool parse(const char * p, const char * end, CJsonValue & value)
+        {
+            if (!_value(p, end, value, 0)) return false;
+            _blank(p, end);
+            return p == end;
+        }
+
+    protected:
+        static const CJsonValue & _null()
+        {
+            static const CJsonValue null;
+            return null;
+        }
+        static void _blank(const char * &p, const char * end)
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == '\0')) p++;
+        }
+        static bool _word(const char * &p, const char * end, const char * word)
+        {
+            const size_t n = strlen(word);
+            if ((size_t)(end - p) < n || memcmp(p, word, n) != 0) return false;
+            p += n;
+            return true;
+        }
+        static void _utf8(std::string & s, unsigned c)
+        {
+            if (c < 0x80) s += (char)c;
+            else if (c < 0x800) { s += (char)(0xc0 | (c >> 6)); s += (char)(0x80 | (c & 0x3f)); }
+            else if (c < 0x10000) { s += (char)(0xe0 | (c >> 12)); s += (char)(0x80 | ((c >> 6) & 0x3f)); s += (char)(0x80 | (c & 0x3f)); }
+            else
+            {
+                s += (char)(0xf0 | (c >> 18)); s += (char)(0x80 | ((c >> 12) & 0x3f));
+                s += (char)(0x80 | ((c >> 6) & 0x3f)); s += (char)(0x80 | (c & 0x3f));
+            }
+        }
+        static bool _string(const char * &p, const char * end, std::string & s)
+        {
+            if (p >= end || *p != '"') return false;
+            p++;
+            while (p < end && *p != '"')
+            {
+                if (*p != '\\') { s += *p++; continue; }
+                if (++p >= end) return false;
+                const char c = *p++;
+                switch (c)
+                {
+                case 'b': s += '\b'; break;
+                case 'f': s += '\f'; break;
+                case 'n': s += '\n'; break;
+                case 'r': s += '\r'; break;
+                case 't': s += '\t'; break;
+                case 'u':
+                {
+                    if (end - p < 4) return false;
+                    char hex[5] = { p[0], p[1], p[2], p[3], 0 };
+                    char * e;
+                    unsigned u = (unsigned)strtoul(hex, &e, 16);
+                    if (e != hex + 4) return false;
+                    p += 4;
+                    // a surrogate pair is one code point
+                    if (u >= 0xd800 && u < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                    {
+                        char low[5] = { p[2], p[3], p[4], p[5], 0 };
+                        const unsigned l = (unsigned)strtoul(low, &e, 16);
+                        if (e == low + 4 && l >= 0xdc00 && l < 0xe000)
+                        {
+                            u = 0x10000 + ((u - 0xd800) << 10) + (l - 0xdc00);
+                            p += 6;
+                        }
+                    }
+                    _utf8(s, u);
+                    break;
+                }
+                default: s += c;
+                }
+            }
+            if (p >= end) return false;
+            p++;
+            return true;
+        }
+        static bool _value(const char * &p, const char * end, CJsonValue & v, int depth)
+        {
+            _blank(p, end);
+            if (p >= end || depth > 256) return false;
+            switch (*p)
+            {
+            case '{':
+                v.type = OBJECT;
+                p++;
+                _blank(p, end);
+                if (p < end && *p == '}') { p++; return true; }
+                for (;;)
+                {
+                    _blank(p, end);
+                    v.keys.push_back(std::string());
+                    if (!_string(p, end, v.keys.back())) return false;
+                    _blank(p, end);
+                    if (p >= end || *p++ != ':') return false;
+                    v.items.push_back(CJsonValue());
+                    if (!_value(p, end, v.items.back(), depth + 1)) return false;
+                    _blank(p, end);
+                    if (p >= end) return false;
+                    if (*p == '}') { p++; return true; }
+                    if (*p++ != ',') return false;
+                }
+            case '[':
+                v.type = ARRAY;
+                p++;
+                _blank(p, end);
+                if (p < end && *p == ']') { p++; return true; }
+                for (;;)
+                {
+                    v.items.push_back(CJsonValue());
+                    if (!_value(p, end, v.items.back(), depth + 1)) return false;
+                    _blank(p, end);
+                    if (p >= end) return false;
+                    if (*p == ']') { p++; return true; }
+                    if (*p++ != ',') return false;
+                }
+            case '"':
+                v.type = STRING;
+                return _string(p, end, v.string);
+            case 't':
+                v.type = BOOL;
+                v.number = 1;
+                return _word(p, end, "true");
+            case 'f':
+                v.type = BOOL;
+                return _word(p, end, "false");
+            case 'n':
+                return _word(p, end, "null");
+            default:
+                v.type = NUMBER;
+                return CNumParser::scan_double(p, end, v.number);
+            }
+        }
+    };
+
+    /*!
+     *  \brief CGlbAccessor, a typed, strided view of an accessor in the mapped binary chunk
+     */
+    struct CGlbAccessor
+    {
+        const char * data = NULL;
+        size_t count = 0;
+        /*! 1 for SCALAR, 2 for VEC2, ... */
+        int components = 0;
+        int component_type = 0;
+        size_t stride = 0;
+        bool normalized = false;
+
+        static size_t size(int component_type)
+        {
+            switch (component_type)
+            {
+            case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+            case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+            case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+            default: return 0;
+            }
+        }
+    };
+
+    /*!
+     *  \brief CGlbFile class, a mapped .glb file
+     *
+     *  Buffers are the binary chunk only, buffers of other files or data
+     *  uris are not read.
+     */
+    class CGlbFile
+    {
+    public:
+        CGlbFile() {}
+        CGlbFile(const std::string & filename) { open(filename); }
+
+        /*!
+         *  Map the file and parse its JSON chunk
+         *  \return false if the file is missing or not a glTF 2.0 binary
+         */
+        bool open(const std::string & filename)
+        {
+            close();
+            if (!m_file.open(filename) || m_file.size() < 20) { close(); return false; }
+            const char * p = m_file.begin();
+            const uint32_t version = _u32(p + 4), length = _u32(p + 8);
+            if (memcmp(p, "glTF", 4) != 0 || version != 2 || length > m_file.size()) { close(); return false; }
+
+            // the chunks, JSON first
+            const char * end = p + length;
+            p += 12;
+            bool json = false;
+            while (end - p >= 8)
+            {
+                const uint32_t size = _u32(p);
+                if ((size_t)(end - p - 8) < size) { close(); return false; }
+                if (memcmp(p + 4, "JSON", 4) == 0 && !json)
+                {
+                    if (!CJsonValue::parse(p + 8, p + 8 + size, m_json)) { close(); return false; }
+                    json = true;
+                }
+                else if (memcmp(p + 4, "BIN\0", 4) == 0 && m_bin == NULL)
+                {
+                    m_bin = p + 8;
+                    m_bin_size = size;
+                }
+                p += 8 + size;
+            }
+            if (!json) { close(); return false; }
+            m_ok = true;
+            return true;
+        }
+
+        void close() { m_file.close(); m_json = CJsonValue(); m_bin = NULL; m_bin_size = 0; m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        const CJsonValue & json() const { return m_json; }
+
+        /*!
+         *  The view of accessor i
+         *  \return false if it is missing, sparse, not in the binary chunk or out of its bounds
+         */
+        bool accessor(long long i, CGlbAccessor & a) const
+        {
+            if (i < 0) return false;
+            const CJsonValue & acc = m_json["accessors"][(size_t)i];
+            if (acc.is_null() || !acc["sparse"].is_null() || acc["bufferView"].as_int() < 0) return false;
+            const CJsonValue & view = m_json["bufferViews"][(size_t)acc["bufferView"].as_int()];
+            if (view.is_null() || view["buffer"].as_int(0) != 0 || m_bin == NULL) return false;
+
+            static const char * types[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+            a = CGlbAccessor();
+            for (int k = 0; k < 4; k++) if (acc["type"].string == types[k]) a.components = k + 1;
+            a.component_type = (int)acc["componentType"].as_int(0);
+            a.count = (size_t)acc["count"].as_int(0);
+            a.normalized = acc["normalized"].type == CJsonValue::BOOL && acc["normalized"].number != 0;
+            const size_t element = a.components * CGlbAccessor::size(a.component_type);
+            a.stride = view["byteStride"].is_null() ? element : (size_t)view["byteStride"].as_int(0);
+            if (element == 0 || a.stride < element) return false;
+
+            const long long offset = view["byteOffset"].as_int(0) + acc["byteOffset"].as_int(0);
+            const long long length = view["byteLength"].as_int(0);
+            if (offset < 0 || length < 0 || (uint64_t)view["byteOffset"].as_int(0) + (uint64_t)length > m_bin_size) return false;
+            if (a.count && (uint64_t)acc["byteOffset"].as_int(0) + (a.count - 1) * a.stride + element > (uint64_t)length) return false;
+            a.data = m_bin + offset;
+            return true;
+        }
+
+        /*!
+         *  Convert an accessor, element i gives out[i * components + k], normalized integers to [0, 1] or [-1, 1]
+         */
+        template<typename T>
+        static void read(const CGlbAccessor & a, T * out, int threads = 0)
+        {
+            parallel_for(a.count, threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++)
+                {
+                    const char * p = a.data + i * a.stride;
+                    for (int k = 0; k < a.components; k++) out[i * a.components + k] = (T)_component(p, k, a);
+                }
+            }, 1 << 14);
+        }
+
+    protected:
+        static uint32_t _u32(const char * p)
+        {
+            const unsigned char * u = (const unsigned char *)p;
+            return (uint32_t)u[0] | ((uint32_t)u[1] << 8) | ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+        }
+        /*! component k of the element at p, the bytes are little endian */
+        static double _component(const char * p, int k, const CGlbAccessor & a)
+        {
+            const size_t n = CGlbAccessor::size(a.component_type);
+            const unsigned char * u = (const unsigned char *)p + k * n;
+            uint32_t bits = 0;
+            for (size_t i = 0; i < n; i++) bits |= (uint32_t)u[i] << (8 * i);
+            switch (a.component_type)
+            {
+            case GLTF_BYTE:           return a.normalized ? std::max((int8_t)bits / 127.0, -1.0) : (int8_t)bits;
+            case GLTF_UNSIGNED_BYTE:  return a.normalized ? bits / 255.0 : bits;
+            case GLTF_SHORT:          return a.normalized ? std::max((int16_t)bits / 32767.0, -1.0) : (int16_t)bits;
+            case GLTF_UNSIGNED_SHORT: return a.normalized ? bits / 65535.0 : bits;
+            case GLTF_UNSIGNED_INT:   return bits;
+            case GLTF_FLOAT:          { float f; memcpy(&f, &bits, 4); return f; }
+            default:                  return 0;
+            }
+        }
+
+        CMappedFile  m_file;
+        CJsonValue   m_json;
+        const char * m_bin = NULL;
+        size_t       m_bin_size = 0;
+        bool         m_ok = false;
+    };
+
+    /*!
+     *  Write a .glb file of one triangle mesh
+     *  \param positions 3 per vertex
+     *  \param normals, uvs 3 and 2 per vertex, may be NULL
+     *  \param indices   3 per triangle
+     *  \return false if the file cannot be written
+     */
+    inline bool write_glb_file(const std::string & filename, size_t num_vertices, const float * positions,
+        const float * normals, const float * uvs, size_t num_triangles, const uint32_t * indices)
+    {
+        const uint16_t one = 1;
+        if (*(const char *)&one != 1) return false;
+
+        // the binary chunk, the arrays one after the other, all sizes are multiples of 4
+        const size_t sizes[4] = { 12 * num_vertices, normals ? 12 * num_vertices : 0, uvs ? 8 * num_vertices : 0, 12 * num_triangles };
+        const void * data[4] = { positions, normals, uvs, indices };
+
+        float lo[3] = { 0, 0, 0 }, hi[3] = { 0, 0, 0 };
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                lo[k] = i ? std::min(lo[k], positions[3 * i + k]) : positions[k];
+                hi[k] = i ? std::max(hi[k], positions[3 * i + k]) : positions[k];
+            }
+        }
+
+        char number[64];
+        std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"MeshLib\"},\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],";
+        json += "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0";
+        int next = 1;
+        if (normals) json += ",\"NORMAL\":" + std::to_string(next++);
+        if (uvs) json += ",\"TEXCOORD_0\":" + std::to_string(next++);
+        json += "},\"indices\":" + std::to_string(next) + ",\"mode\":4}]}],";
+
+        std::string views = "\"bufferViews\":[", accessors = "\"accessors\":[";
+        size_t offset = 0;
+        int view = 0;
+        static const char * types[4] = { "VEC3", "VEC3", "VEC2", "SCALAR" };
+        for (int i = 0; i < 4; i++)
+        {
+            if (!data[i]) continue;
+            if (view) { views += ","; accessors += ","; }
+            views += "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) + ",\"byteLength\":" + std::to_string(sizes[i]) +
+                ",\"target\":" + (i == 3 ? "34963" : "34962") + "}";
+            accessors += "{\"bufferView\":" + std::to_string(view++) + ",\"componentType\":" + (i == 3 ? "5125" : "5126") +
+                ",\"count\":" + std::to_string(i == 3 ? 3 * num_triangles : num_vertices) + ",\"type\":\"" + types[i] + "\"";
+            if (i == 0 && num_vertices)
+            {
+                snprintf(number, sizeof(number), "%.9g,%.9g,%.9g", lo[0], lo[1], lo[2]);
+                accessors += std::string(",\"min\":[") + number + "]";
+                snprintf(number, sizeof(number), "%.9g,%.9g,%.9g", hi[0], hi[1], hi[2]);
+                accessors += std::string(",\"max\":[") + number + "]";
+            }
+            accessors += "}";
+            offset += sizes[i];
+        }
+        json += views + "]," + accessors + "],\"buffers\":[{\"byteLength\":" + std::to_string(offset) + "}]}";
+        while (json.size() % 4) json += ' ';
+
+        FILE * fp = fopen(filename.c_str(), "wb");
+        if (fp == NULL) return false;
+        const uint32_t header[5] = { 0x46546c67, 2, (uint32_t)(12 + 8 + json.size() + 8 + offset), (uint32_t)json.size(), 0x4e4f534a };
+        const uint32_t bin[2] = { (uint32_t)offset, 0x004e4942 };
+        bool ok = fwrite(header, 4, 5, fp) == 5;
+        ok = ok && fwrite(json.data(), 1, json.size(), fp) == json.size();
+        ok = ok && fwrite(bin, 4, 2, fp) == 2;
+        for (int i = 0; i < 4 && ok; i++) ok = !data[i] || sizes[i] == 0 || fwrite(data[i], 1, sizes[i], fp) == sizes[i];
+
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) remove(filename.c_str());
+        return ok;
+    }
+
+}; //namespace
+
+#endif
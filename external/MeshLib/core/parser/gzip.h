@@ -0,0 +1,574 @@
+/*!
+*      \file gzip.h
+*      \brief Decoder of gzip files (.gz), RFC 1951 and 1952
+*
+*      A gzip file is one or more members, each a header, a deflate stream
+*      and the crc and size of its bytes. Plain gzip writes one member,
+*      bgzip (BGZF) blocks of at most 64 KB that carry their compressed size
+*      in the header, so their members are found without decoding and are
+*      decoded in parallel.
+*/
+
+#ifndef _MESHLIB_GZIP_H_
+#define _MESHLIB_GZIP_H_
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <new>
+#include <atomic>
+#include <algorithm>
+
+#include "parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CInflate class, decoder of a raw deflate stream
+     */
+    class CInflate
+    {
+    public:
+        /*!
+         *  Decode the deflate stream at in
+         *  \param used     the bytes of in the stream took
+         *  \param out      the output, written from out[pos] on
+         *  \param pos      advanced past the decoded bytes
+         *  \param grow     whether out may grow, up to s_max_ratio times the size of in, or the stream has to fit
+         *  \param on_block called with pos after every deflate block, stops the decode on false
+         *  \return false if the stream is damaged or does not fit
+         */
+        template<typename Fn>
+        static bool decode(const uint8_t * in, size_t size, size_t & used,
+            std::vector<char> & out, size_t & pos, bool grow, Fn on_block)
+        {
+            CBits bits(in, size);
+            const size_t start = pos;
+            // a damaged stream decodes to no more than a whole one would
+            const size_t limit = grow ? pos + s_max_ratio * std::max<size_t>(size, 1) : 0;
+            bool last = false;
+            while (!last)
+            {
+                last = bits.get(1) != 0;
+                const uint32_t type = bits.get(2);
+                bool ok;
+                if (type == 0) ok = _stored(bits, out, pos, limit);
+                else if (type == 1) ok = _codes(bits, _fixed_lengths(), _fixed_distances(), out, start, pos, limit);
+                else if (type == 2)
+                {
+                    CHuffman lengths, distances;
+                    ok = _dynamic(bits, lengths, distances) && _codes(bits, lengths, distances, out, start, pos, limit);
+                }
+                else ok = false;
+                if (!ok || bits.overrun() || !on_block(pos)) return false;
+            }
+            used = bits.consumed();
+            return true;
+        }
+
+        //! the most a deflate stream inflates, a match of 258 bytes from a code of a little over two bits
+        static constexpr size_t s_max_ratio = 1032;
+
+    protected:
+        //! bits of the codes looked up at once
+        static const int s_fast_bits = 9;
+
+        /*! least significant bit first reader over the input */
+        struct CBits
+        {
+            CBits(const uint8_t * in, size_t size) : in(in), size(size) {}
+
+            void refill()
+            {
+                // bytes past the end read as zero, overrun() tells
+                while (n <= 56)
+                {
+                    buffer |= (uint64_t)(next < size ? in[next] : 0) << n;
+                    next++;
+                    n += 8;
+                }
+            }
+            uint32_t get(int k)
+            {
+                if (n < k) refill();
+                const uint32_t v = (uint32_t)(buffer & ((1ull << k) - 1));
+                buffer >>= k;
+                n -= k;
+                return v;
+            }
+            void align() { get(n & 7); }
+            size_t consumed() const { return next - (size_t)(n / 8); }
+            bool overrun() const { return consumed() > size; }
+
+            const uint8_t * in;
+            size_t   size;
+            size_t   next = 0;
+            uint64_t buffer = 0;
+            int      n = 0;
+        };
+
+        /*! canonical Huffman code, a table for the short codes and the ranges of the long ones */
+        struct CHuffman
+        {
+            bool build(const uint8_t * lengths, int num)
+            {
+                int count[17] = { 0 }, next_code[16];
+                memset(fast, 0, sizeof(fast));
+                memset(size, 0, sizeof(size));
+                for (int i = 0; i < num; i++) count[lengths[i]]++;
+                count[0] = 0;
+                int code = 0, k = 0;
+                for (int i = 1; i < 16; i++)
+                {
+                    if (count[i] > (1 << i)) return false;
+                    next_code[i] = code;
+                    first_code[i] = (uint16_t)code;
+                    first_symbol[i] = (uint16_t)k;
+                    code += count[i];
+                    if (count[i] && code - 1 >= (1 << i)) return false;
+                    max_code[i] = code << (16 - i);
+                    code <<= 1;
+                    k += count[i];
+                }
+                max_code[16] = 0x10000;
+                for (int i = 0; i < num; i++)
+                {
+                    const int s = lengths[i];
+                    if (s == 0) continue;
+                    const int c = next_code[s] - first_code[s] + first_symbol[s];
+                    size[c] = (uint8_t)s;
+                    value[c] = (uint16_t)i;
+                    if (s <= s_fast_bits)
+                    {
+                        for (int j = _reverse(next_code[s], s); j < (1 << s_fast_bits); j += 1 << s)
+                            fast[j] = (uint16_t)((s << 9) | i);
+                    }
+                    next_code[s]++;
+                }
+                return true;
+            }
+
+            /*! the next symbol, -1 for a code not in the table */
+            int decode(CBits & bits) const
+            {
+                if (bits.n < 16) bits.refill();
+                const int f = fast[bits.buffer & ((1 << s_fast_bits) - 1)];
+                if (f)
+                {
+                    const int s = f >> 9;
+                    bits.buffer >>= s;
+                    bits.n -= s;
+                    return f & 511;
+                }
+                const int k = _reverse((int)(bits.buffer & 0xffff), 16);
+                int s = s_fast_bits + 1;
+                while (s < 16 && k >= max_code[s]) s++;
+                if (s >= 16) return -1;
+                const int c = (k >> (16 - s)) - first_code[s] + first_symbol[s];
+                if (c >= 288 || size[c] != s) return -1;
+                bits.buffer >>= s;
+                bits.n -= s;
+                return value[c];
+            }
+
+            uint16_t fast[1 << s_fast_bits];
+            uint16_t first_code[16];
+            uint16_t first_symbol[16];
+            int      max_code[17];
+            uint8_t  size[288];
+            uint16_t value[288];
+        };
+
+        static int _reverse(int v, int bits)
+        {
+            int r = 0;
+            for (int i = 0; i < bits; i++, v >>= 1) r = (r << 1) | (v & 1);
+            return r;
+        }
+
+        static const CHuffman & _fixed_lengths()
+        {
+            static const CHuffman h = []
+            {
+                uint8_t l[288];
+                for (int i = 0; i < 288; i++) l[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+                CHuffman t;
+                t.build(l, 288);
+                return t;
+            }();
+            return h;
+        }
+        static const CHuffman & _fixed_distances()
+        {
+            static const CHuffman h = []
+            {
+                uint8_t l[30];
+                for (int i = 0; i < 30; i++) l[i] = 5;
+                CHuffman t;
+                t.build(l, 30);
+                return t;
+            }();
+            return h;
+        }
+
+        /*! make room for n more bytes at pos, growing out up to limit, 0 if it may not grow */
+        static bool _reserve(std::vector<char> & out, size_t pos, size_t n, size_t limit)
+        {
+            if (pos + n <= out.size()) return true;
+            if (pos + n > limit) return false;
+            out.resize(std::min(limit, std::max(pos + n, out.size() * 2 + (1 << 16))));
+            return true;
+        }
+
+        static bool _stored(CBits & bits, std::vector<char> & out, size_t & pos, size_t limit)
+        {
+            bits.align();
+            const uint32_t len = bits.get(16);
+            const uint32_t nlen = bits.get(16);
+            if (bits.overrun() || (len ^ 0xffff) != nlen) return false;
+            // the bit buffer holds whole bytes now, copy from the input directly
+            const size_t at = bits.consumed();
+            if (at + len > bits.size || !_reserve(out, pos, len, limit)) return false;
+            memcpy(out.data() + pos, bits.in + at, len);
+            pos += len;
+            bits.next = at + len;
+            bits.buffer = 0;
+            bits.n = 0;
+            return true;
+        }
+
+        static bool _dynamic(CBits & bits, CHuffman & lengths, CHuffman & distances)
+        {
+            static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            const int hlit = (int)bits.get(5) + 257;
+            const int hdist = (int)bits.get(5) + 1;
+            const int hclen = (int)bits.get(4) + 4;
+            if (hlit > 286 || hdist > 30) return false;
+
+            uint8_t code_lengths[19] = { 0 };
+            for (int i = 0; i < hclen; i++) code_lengths[order[i]] = (uint8_t)bits.get(3);
+            CHuffman codes;
+            if (bits.overrun() || !codes.build(code_lengths, 19)) return false;
+
+            // the lengths of both codes run on as one sequence
+            uint8_t l[286 + 30];
+            int n = 0;
+            while (n < hlit + hdist)
+            {
+                const int c = codes.decode(bits);
+                if (c < 0 || bits.overrun()) return false;
+                if (c < 16) { l[n++] = (uint8_t)c; continue; }
+                int repeat;
+                uint8_t fill = 0;
+                if (c == 16)
+                {
+                    if (n == 0) return false;
+                    repeat = 3 + (int)bits.get(2);
+                    fill = l[n - 1];
+                }
+                else if (c == 17) repeat = 3 + (int)bits.get(3);
+                else repeat = 11 + (int)bits.get(7);
+                if (n + repeat > hlit + hdist) return false;
+                memset(l + n, fill, (size_t)repeat);
+                n += repeat;
+            }
+            if (l[256] == 0) return false;
+            return lengths.build(l, hlit) && distances.build(l + hlit, hdist);
+        }
+
+        static bool _codes(CBits & bits, const CHuffman & lengths, const CHuffman & distances,
+            std::vector<char> & out, size_t start, size_t & pos, size_t limit)
+        {
+            static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+            static const uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+            char * o = out.data();
+            while (true)
+            {
+                // the bits past the end of the input read as zero, and may decode forever
+                if (bits.next > bits.size && bits.overrun()) return false;
+                int c = lengths.decode(bits);
+                if (c < 256)
+                {
+                    if (c < 0) return false;
+                    if (pos >= out.size())
+                    {
+                        if (!_reserve(out, pos, 1, limit)) return false;
+                        o = out.data();
+                    }
+                    o[pos++] = (char)c;
+                    continue;
+                }
+                if (c == 256) return true;
+
+                c -= 257;
+                if (c >= 29) return false;
+                const size_t len = length_base[c] + bits.get(length_extra[c]);
+                const int d = distances.decode(bits);
+                if (d < 0 || d >= 30) return false;
+                const size_t dist = distance_base[d] + bits.get(distance_extra[d]);
+                if (dist > pos - start) return false;
+                if (pos + len > out.size())
+                {
+                    if (!_reserve(out, pos, len, limit)) return false;
+                    o = out.data();
+                }
+                const char * src = o + pos - dist;
+                if (dist >= len) memcpy(o + pos, src, len);
+                else for (size_t i = 0; i < len; i++) o[pos + i] = src[i];
+                pos += len;
+            }
+        }
+    };
+
+    /*!
+     *  \brief CGzip class, decoder of gzip files
+     */
+    class CGzip
+    {
+    public:
+        /*! a member of the file */
+        struct CMember
+        {
+            size_t   begin = 0;    //!< offset of the member
+            size_t   end = 0;      //!< one past its trailer, 0 while unknown
+            size_t   deflate = 0;  //!< offset of its deflate stream
+            size_t   output = 0;   //!< offset of its bytes in the output
+            uint32_t size = 0;     //!< its decoded size, modulo 2^32
+        };
+
+        /*! whether the data starts like a gzip file */
+        static bool is_gzip(const char * data, size_t size)
+        {
+            return size >= 18 && (uint8_t)data[0] == 0x1f && (uint8_t)data[1] == 0x8b && data[2] == 8;
+        }
+
+        /*!
+         *  Find the members and their place in the output without decoding
+         *  \param members the members, of a plain gzip file only the first with its end unknown
+         *  \return the decoded size, or (size_t)-1 if it cannot be known before decoding
+         */
+        static size_t members(const char * data, size_t size, std::vector<CMember> & members)
+        {
+            members.clear();
+            const uint8_t * p = (const uint8_t *)data;
+            size_t at = 0, output = 0;
+            while (at < size)
+            {
+                CMember m;
+                size_t block;
+                if (!_header(p + at, size - at, m.deflate, block)) return (size_t)-1;
+                m.begin = at;
+                m.deflate += at;
+                m.output = output;
+                if (block == 0)
+                {
+                    // a plain member, its end is found by decoding it
+                    members.push_back(m);
+                    if (at != 0) return (size_t)-1;
+                    // a single member, as gzip writes them, ends with the size of the file, unless
+                    // more follow, then it is the size of the last, see decode
+                    if (size < m.deflate + 8) return (size_t)-1;
+                    m.size = _le32(p + size - 4);
+                    if (!_plausible(m.size, size - m.deflate - 8)) return (size_t)-1;
+                    members.back().size = m.size;
+                    return m.size;
+                }
+                m.end = at + block;
+                if (m.end > size || m.end < m.deflate + 8) return (size_t)-1;
+                m.size = _le32(p + m.end - 4);
+                if (!_plausible(m.size, m.end - 8 - m.deflate)) return (size_t)-1;
+                output += m.size;
+                members.push_back(m);
+                at = m.end;
+            }
+            return members.empty() ? (size_t)-1 : output;
+        }
+
+        /*!
+         *  Decode a gzip file
+         *  \param threads the workers for the members of bgzip files, 0 for all cores
+         *  \return false if the file is damaged, or its output does not fit in memory
+         */
+        static bool decode(const char * data, size_t size, std::vector<char> & out, int threads = 0)
+        {
+            std::vector<CMember> m;
+            const size_t total = members(data, size, m);
+            try
+            {
+                if (total != (size_t)-1 && (m.size() > 1 || m[0].end != 0))
+                {
+                    out.resize(total);
+                    return decode(data, size, m, out, [](size_t) { return true; }, threads);
+                }
+
+                // plain members follow one another, each decoded to find where the next starts and
+                // checked against its own size, the size at the end of the file is only a first guess
+                out.clear();
+                size_t at = 0, pos = 0;
+                if (total != (size_t)-1) out.resize(total);
+                while (at < size)
+                {
+                    if (!_member(data, size, at, out, pos, true, [](size_t) { return true; })) return false;
+                }
+                out.resize(pos);
+                return true;
+            }
+            catch (const std::bad_alloc &)
+            {
+                std::vector<char>().swap(out);
+                return false;
+            }
+        }
+
+        /*!
+         *  Decode into out, sized to the total of members(), in order
+         *  \param on_output called with the bytes decoded from the start on, stops the decode on false
+         */
+        template<typename Fn>
+        static bool decode(const char * data, size_t size, const std::vector<CMember> & members,
+            std::vector<char> & out, Fn on_output, int threads = 0)
+        {
+            if (members.empty()) return false;
+            if (members.size() == 1 && members[0].end == 0)
+            {
+                // a single plain member, reported block by block
+                size_t at = 0, pos = 0;
+                return _member(data, size, at, out, pos, false, on_output) && at == size && pos == out.size();
+            }
+
+            // bgzip blocks are small, decode them in rounds of many blocks per worker
+            const size_t round = (size_t)resolve_threads(threads) * 64;
+            for (size_t r = 0; r < members.size(); r += round)
+            {
+                const size_t e = std::min(members.size(), r + round);
+                std::atomic<bool> ok(true);
+                parallel_for(e - r, threads, [&](size_t b, size_t f)
+                {
+                    for (size_t i = r + b; i < r + f && ok; i++)
+                    {
+                        const CMember & m = members[i];
+                        const size_t next = i + 1 < members.size() ? members[i + 1].output : out.size();
+                        if (next - m.output != m.size || !_inflate(data, m, out)) ok = false;
+                    }
+                }, 4);
+                if (!ok || !on_output(e < members.size() ? members[e].output : out.size())) return false;
+            }
+            return true;
+        }
+
+    protected:
+        /*! whether a member of packed bytes of deflate stream may decode to size, a damaged trailer
+            claims up to 4GB */
+        static bool _plausible(uint32_t size, size_t packed)
+        {
+            return size / CInflate::s_max_ratio <= packed;
+        }
+
+        static uint32_t _le32(const uint8_t * p)
+        {
+            return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        }
+
+        static const uint32_t * _crc_table()
+        {
+            static const std::vector<uint32_t> table = []
+            {
+                std::vector<uint32_t> t(256);
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    t[i] = c;
+                }
+                return t;
+            }();
+            return table.data();
+        }
+        static uint32_t _crc32(const char * p, size_t n)
+        {
+            const uint32_t * t = _crc_table();
+            uint32_t c = 0xffffffffu;
+            for (size_t i = 0; i < n; i++) c = t[(c ^ (uint8_t)p[i]) & 0xff] ^ (c >> 8);
+            return c ^ 0xffffffffu;
+        }
+
+        /*!
+         *  Read a member header
+         *  \param deflate the offset of the deflate stream
+         *  \param block   the size of a bgzip member, 0 for a plain one
+         */
+        static bool _header(const uint8_t * p, size_t size, size_t & deflate, size_t & block)
+        {
+            block = 0;
+            if (!is_gzip((const char *)p, size)) return false;
+            const uint8_t flags = p[3];
+            size_t at = 10;
+            if (flags & 4)
+            {
+                if (at + 2 > size) return false;
+                const size_t xlen = p[at] | (p[at + 1] << 8);
+                at += 2;
+                if (at + xlen > size) return false;
+                // subfields, BC holds the size of a bgzip member less one
+                for (size_t s = at; s + 4 <= at + xlen; )
+                {
+                    const size_t slen = p[s + 2] | (p[s + 3] << 8);
+                    if (p[s] == 'B' && p[s + 1] == 'C' && slen == 2 && s + 6 <= at + xlen)
+                        block = (size_t)(p[s + 4] | (p[s + 5] << 8)) + 1;
+                    s += 4 + slen;
+                }
+                at += xlen;
+            }
+            for (int f = 8; f <= 16; f <<= 1)
+            {
+                if (!(flags & f)) continue;
+                // zero terminated name or comment
+                while (at < size && p[at] != 0) at++;
+                at++;
+            }
+            if (flags & 2) at += 2;
+            if (at > size) return false;
+            deflate = at;
+            return true;
+        }
+
+        /*! decode the member at `at` to out[pos], then step past it */
+        template<typename Fn>
+        static bool _member(const char * data, size_t size, size_t & at, std::vector<char> & out, size_t & pos,
+            bool grow, Fn on_output)
+        {
+            size_t deflate, block, used;
+            if (!_header((const uint8_t *)data + at, size - at, deflate, block)) return false;
+            deflate += at;
+            const size_t start = pos;
+            if (!CInflate::decode((const uint8_t *)data + deflate, size - deflate, used, out, pos, grow, on_output))
+                return false;
+            at = deflate + used + 8;
+            if (at > size) return false;
+            const uint8_t * t = (const uint8_t *)data + at - 8;
+            return _le32(t) == _crc32(out.data() + start, pos - start) && _le32(t + 4) == (uint32_t)(pos - start);
+        }
+
+        /*! decode a bgzip member in place */
+        static bool _inflate(const char * data, const CMember & m, std::vector<char> & out)
+        {
+            size_t used, pos = m.output;
+            // the output is not grown, no other worker moves it
+            if (!CInflate::decode((const uint8_t *)data + m.deflate, m.end - 8 - m.deflate, used, out, pos, false,
+                [](size_t) { return true; })) return false;
+            const uint8_t * t = (const uint8_t *)data + m.end - 8;
+            return pos - m.output == m.size && _le32(t) == _crc32(out.data() + m.output, m.size);
+        }
+    };
+
+}; //namespace
+
+#endif
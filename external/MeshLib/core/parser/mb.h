@@ -0,0 +1,491 @@
+/*!
+*      \file mb.h
+*      \brief Binary .m format (.mb)
+*
+*      The elements of an .m file as tables and its traits as typed columns,
+*      little endian and meant to be mapped straight into memory:
+*
+*          CMbHeader
+*          vertex ids      int32     per vertex
+*          points          double[3] per vertex
+*          face ids        int32     per face
+*          face offsets    uint64    per face and one, into the face indices
+*          face indices    uint32    per face corner, vertex indices
+*          edges           uint32[2] per edge with traits, vertex indices
+*          corners         uint32[2] per corner with traits, vertex and face index
+*          columns         CMbColumnHeader per column
+*          names           the column names, not terminated
+*
+*      followed by the sections of the columns. A column is one key of the
+*      trait strings of one kind of element: a flag such as `sharp`, int32 or
+*      double tuples written key=(a b c), or, for anything else, the text
+*      after the key verbatim. A byte per row tells whether the row has it.
+*      A key that appears twice in a string has a second column by the same
+*      name. Every section starts on a 16 byte boundary.
+*/
+
+#ifndef _MESHLIB_MB_H_
+#define _MESHLIB_MB_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+
+#include "mmap.h"
+#include "parser.h"
+
+#define MB_VERSION 1
+
+// the elements a column belongs to
+#define MB_VERTEX   0
+#define MB_EDGE     1
+#define MB_FACE     2
+#define MB_CORNER   3
+
+// the types of the values of a column
+#define MB_FLAG     0
+#define MB_INT      1
+#define MB_REAL     2
+#define MB_TEXT     3
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMbHeader, the first bytes of an .mb file
+     */
+    struct CMbHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t num_columns;
+        uint64_t num_vertices;
+        uint64_t num_faces;
+        uint64_t num_face_indices;
+        uint64_t num_edges;
+        uint64_t num_corners;
+        /*! byte offsets of the vertex ids, points, face ids, face offsets, face indices, edges, corners, columns and names */
+        uint64_t offset[9];
+
+        CMbHeader()
+        {
+            memcpy(magic, "MB\x1a\x00", 4);
+            version = MB_VERSION;
+            flags = 0;
+            num_columns = 0;
+            num_vertices = num_faces = num_face_indices = num_edges = num_corners = 0;
+            for (int i = 0; i < 9; i++) offset[i] = 0;
+        }
+
+        bool valid() const { return memcmp(magic, "MB\x1a\x00", 4) == 0 && version == MB_VERSION; }
+    };
+
+    /*!
+     *  \brief CMbColumnHeader, the entry of a column in the directory of an .mb file
+     */
+    struct CMbColumnHeader
+    {
+        uint32_t element;
+        uint32_t type;
+        /*! values per row of an MB_INT or MB_REAL column */
+        uint32_t arity;
+        uint32_t name_size;
+        /*! offset of the name in the names section */
+        uint64_t name;
+        uint64_t rows;
+        /*! byte offset of the uint8 per row, 1 if the row has the key */
+        uint64_t present;
+        /*! byte offset of the arity values per row, or of the rows + 1 uint64 text offsets of an MB_TEXT column */
+        uint64_t data;
+        /*! byte offset and size of the characters of an MB_TEXT column */
+        uint64_t text;
+        uint64_t text_size;
+    };
+
+    /*!
+     *  \brief CMbColumn class, a column of a mapped .mb file
+     */
+    class CMbColumn
+    {
+    public:
+        CMbColumn() {}
+        CMbColumn(const CMbColumnHeader * header, const char * base, const char * names) : m_header(header), m_base(base), m_names(names) {}
+
+        bool valid() const { return m_header != NULL; }
+        int element() const { return (int)m_header->element; }
+        int type() const { return (int)m_header->type; }
+        int arity() const { return (int)m_header->arity; }
+        size_t rows() const { return (size_t)m_header->rows; }
+        std::string name() const { return std::string(m_names + m_header->name, m_header->name_size); }
+        bool is(const std::string & name) const { return name.size() == m_header->name_size && memcmp(m_names + m_header->name, name.data(), name.size()) == 0; }
+
+        /*! whether row i has the key */
+        bool present(size_t i) const { return m_base[m_header->present + i] != 0; }
+        /*! the values of row i, arity() of them */
+        const int32_t * ints(size_t i) const { return (const int32_t *)(m_base + m_header->data) + i * m_header->arity; }
+        const double * reals(size_t i) const { return (const double *)(m_base + m_header->data) + i * m_header->arity; }
+        /*! the text of row i, after the key, n characters */
+        const char * text(size_t i, size_t & n) const
+        {
+            const uint64_t * offsets = (const uint64_t *)(m_base + m_header->data);
+            n = (size_t)(offsets[i + 1] - offsets[i]);
+            return m_base + m_header->text + offsets[i];
+        }
+
+        /*! the token of row i as the trait string had it, doubles in their shortest exact form */
+        void format(size_t i, CFormatBuffer & b) const
+        {
+            b.append(m_names + m_header->name, m_names + m_header->name + m_header->name_size);
+            switch (m_header->type)
+            {
+            case MB_INT:
+            case MB_REAL:
+                b << "=(";
+                for (uint32_t k = 0; k < m_header->arity; k++)
+                {
+                    if (k > 0) b << ' ';
+                    if (m_header->type == MB_INT) b << (int)ints(i)[k];
+                    else b.exact(reals(i)[k]);
+                }
+                b << ')';
+                break;
+            case MB_TEXT:
+            {
+                size_t n;
+                const char * t = text(i, n);
+                b.append(t, t + n);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+    protected:
+        const CMbColumnHeader * m_header = NULL;
+        const char * m_base = NULL;
+        const char * m_names = NULL;
+    };
+
+    /*!
+     *  \brief CMbFile class, a mapped, read-only .mb file
+     *
+     *  All tables and columns point into the mapping, nothing is copied and
+     *  only the pages of the columns that are read are loaded.
+     */
+    class CMbFile
+    {
+    public:
+        CMbFile() {}
+        CMbFile(const std::string & filename) { open(filename); }
+
+        bool open(const std::string & filename)
+        {
+            m_ok = false;
+            if (!m_file.open(filename)) return false;
+            if (m_file.size() < sizeof(CMbHeader)) { m_file.close(); return false; }
+
+            memcpy(&m_header, m_file.begin(), sizeof(CMbHeader));
+            if (!m_header.valid() || !_check()) { m_file.close(); return false; }
+            m_ok = true;
+            return true;
+        }
+
+        void close() { m_file.close(); m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        const CMbHeader & header() const { return m_header; }
+        size_t num_vertices() const { return (size_t)m_header.num_vertices; }
+        size_t num_faces()    const { return (size_t)m_header.num_faces; }
+        size_t num_edges()    const { return (size_t)m_header.num_edges; }
+        size_t num_corners()  const { return (size_t)m_header.num_corners; }
+
+        const int32_t  * vertex_ids()   const { return (const int32_t *)_section(0); }
+        const double   * points()       const { return (const double *)_section(1); }
+        const int32_t  * face_ids()     const { return (const int32_t *)_section(2); }
+        const uint64_t * face_offsets() const { return (const uint64_t *)_section(3); }
+        const uint32_t * face_indices() const { return (const uint32_t *)_section(4); }
+        const uint32_t * edges()        const { return (const uint32_t *)_section(5); }
+        const uint32_t * corners()      const { return (const uint32_t *)_section(6); }
+
+        size_t num_columns() const { return m_header.num_columns; }
+        CMbColumn column(size_t i) const { return CMbColumn((const CMbColumnHeader *)_section(7) + i, m_file.begin(), _section(8)); }
+        /*! the first column named name of the element, invalid if there is none */
+        CMbColumn find(const std::string & name, int element) const
+        {
+            for (size_t i = 0; i < num_columns(); i++)
+            {
+                CMbColumn c = column(i);
+                if (c.element() == element && c.is(name)) return c;
+            }
+            return CMbColumn();
+        }
+
+    protected:
+        const char * _section(int i) const
+        {
+            return m_ok ? m_file.begin() + m_header.offset[i] : NULL;
+        }
+        bool _fits(uint64_t offset, uint64_t size) const
+        {
+            return offset <= m_file.size() && size <= m_file.size() - offset;
+        }
+
+        /*! the sections and the columns lie within the file */
+        bool _check() const
+        {
+            const CMbHeader & h = m_header;
+            uint64_t sizes[9] = { 4 * h.num_vertices, 24 * h.num_vertices, 4 * h.num_faces, 8 * (h.num_faces + 1),
+                4 * h.num_face_indices, 8 * h.num_edges, 8 * h.num_corners, sizeof(CMbColumnHeader) * (uint64_t)h.num_columns, 0 };
+            for (int i = 0; i < 9; i++)
+            {
+                if (!h.offset[i] || !_fits(h.offset[i], sizes[i])) return false;
+            }
+            const uint64_t * offsets = (const uint64_t *)(m_file.begin() + h.offset[3]);
+            if (offsets[h.num_faces] != h.num_face_indices) return false;
+
+            const CMbColumnHeader * columns = (const CMbColumnHeader *)(m_file.begin() + h.offset[7]);
+            const uint64_t rows[4] = { h.num_vertices, h.num_edges, h.num_faces, h.num_corners };
+            for (uint32_t i = 0; i < h.num_columns; i++)
+            {
+                const CMbColumnHeader & c = columns[i];
+                if (c.element > MB_CORNER || c.type > MB_TEXT || c.rows != rows[c.element]) return false;
+                if (!_fits(h.offset[8] + c.name, c.name_size) || !_fits(c.present, c.rows)) return false;
+                if (c.type == MB_INT && !_fits(c.data, 4 * c.rows * c.arity)) return false;
+                if (c.type == MB_REAL && !_fits(c.data, 8 * c.rows * c.arity)) return false;
+                if (c.type == MB_TEXT)
+                {
+                    if (!_fits(c.data, 8 * (c.rows + 1)) || !_fits(c.text, c.text_size)) return false;
+                    if (((const uint64_t *)(m_file.begin() + c.data))[c.rows] != c.text_size) return false;
+                }
+            }
+            return true;
+        }
+
+        CMappedFile m_file;
+        CMbHeader   m_header;
+        bool        m_ok = false;
+    };
+
+    /*!
+     *  \brief CMbTraitTable class, the trait strings of one kind of element as .mb columns
+     *
+     *  Every string is scanned twice, once to find the columns and their
+     *  types, then to store the values, the rows in increasing order.
+     */
+    class CMbTraitTable
+    {
+    public:
+        /*! a column being built */
+        struct CColumn
+        {
+            std::string name;
+            uint32_t type = MB_FLAG;
+            uint32_t arity = 0;
+            bool typed = false;
+            std::vector<uint8_t> present;
+            std::vector<int32_t> ints;
+            std::vector<double> reals;
+            std::vector<uint64_t> offsets;
+            std::string text;
+        };
+
+        /*! rows elements of the kind element, only the keys in keys if it is not empty */
+        CMbTraitTable(int element, size_t rows, const std::set<std::string> & keys) : m_element(element), m_rows(rows), m_keys(keys) {}
+
+        int element() const { return m_element; }
+        std::vector<CColumn> & columns() { return m_columns; }
+        /*! the columns in the order they are written, a new one goes right after the one of the token before it */
+        const std::vector<size_t> & order() const { return m_order; }
+
+        /*! the first pass over the trait string [b, e) */
+        void scan(const char * b, const char * e)
+        {
+            _tokens(b, e, [this](CColumn & c, const CTraitToken & token)
+            {
+                uint32_t type, arity;
+                _classify(token, type, arity);
+                if (!c.typed)
+                {
+                    c.type = type;
+                    c.arity = arity;
+                    c.typed = true;
+                }
+                else if (c.type != type || c.arity != arity)
+                {
+                    const bool numbers = (c.type == MB_INT || c.type == MB_REAL) && (type == MB_INT || type == MB_REAL) && c.arity == arity;
+                    c.type = numbers ? MB_REAL : MB_TEXT;
+                }
+            });
+        }
+
+        /*! size the columns, after all strings were scanned */
+        void allocate()
+        {
+            for (CColumn & c : m_columns)
+            {
+                if (c.type == MB_FLAG || c.type == MB_TEXT) c.arity = 0;
+                c.present.assign(m_rows, 0);
+                if (c.type == MB_INT) c.ints.assign(m_rows * c.arity, 0);
+                if (c.type == MB_REAL) c.reals.assign(m_rows * c.arity, 0.0);
+                if (c.type == MB_TEXT) c.offsets.assign(m_rows + 1, 0);
+            }
+        }
+
+        /*! the second pass, the trait string [b, e) of row */
+        void fill(size_t row, const char * b, const char * e)
+        {
+            _tokens(b, e, [this, row](CColumn & c, const CTraitToken & token)
+            {
+                c.present[row] = 1;
+                const char * p = token.value;
+                for (uint32_t k = 0; k < c.arity; k++)
+                {
+                    CNumParser::skip_blank(p, token.value_end);
+                    if (c.type == MB_INT) CNumParser::scan_int(p, token.value_end, c.ints[row * c.arity + k]);
+                    else CNumParser::scan_double(p, token.value_end, c.reals[row * c.arity + k]);
+                }
+                if (c.type == MB_TEXT)
+                {
+                    c.text.append(token.key_end, token.end);
+                    c.offsets[row + 1] = c.text.size();
+                }
+            });
+        }
+
+        /*! the text offsets of the rows without the key, after the last fill */
+        void finish()
+        {
+            for (CColumn & c : m_columns)
+            {
+                for (size_t i = 1; i < c.offsets.size(); i++) c.offsets[i] = std::max(c.offsets[i], c.offsets[i - 1]);
+            }
+        }
+
+    protected:
+        int m_element;
+        size_t m_rows;
+        const std::set<std::string> & m_keys;
+        std::vector<CColumn> m_columns;
+        std::vector<size_t> m_order;
+        /*! the columns of each name, the k-th for the k-th token of that name in a string */
+        std::unordered_map<std::string, std::vector<size_t>> m_index;
+        /*! the columns used by the string at hand */
+        std::vector<size_t> m_seen;
+
+        /*! fn(column, token) for the tokens of [b, e) that are kept */
+        template<typename Fn>
+        void _tokens(const char * b, const char * e, Fn fn)
+        {
+            m_seen.clear();
+            CTraitParser parser(b, e);
+            CTraitToken token;
+            std::string key;
+            size_t before = 0;
+            while (parser.next(token))
+            {
+                key.assign(token.begin, token.key_end);
+                if (!m_keys.empty() && !m_keys.count(key)) continue;
+                std::vector<size_t> & named = m_index[key];
+                size_t k = 0;
+                for (size_t s : m_seen) if (m_columns[s].name == key) k++;
+                if (k == named.size())
+                {
+                    named.push_back(m_columns.size());
+                    m_order.insert(m_order.begin() + before, m_columns.size());
+                    m_columns.push_back(CColumn());
+                    m_columns.back().name = key;
+                }
+                m_seen.push_back(named[k]);
+                before = (size_t)(std::find(m_order.begin(), m_order.end(), named[k]) - m_order.begin()) + 1;
+                fn(m_columns[named[k]], token);
+            }
+        }
+
+        /*! the type a token alone would give its column */
+        static void _classify(const CTraitToken & token, uint32_t & type, uint32_t & arity)
+        {
+            type = MB_TEXT;
+            arity = 0;
+            if (!token.has_value())
+            {
+                type = MB_FLAG;
+                return;
+            }
+            // only a closed (...) of numbers, anything else is kept as text
+            if (token.value[-1] != '(' || token.value_end >= token.end) return;
+            bool integers = true;
+            const char * p = token.value;
+            while (true)
+            {
+                CNumParser::skip_blank(p, token.value_end);
+                if (p >= token.value_end) break;
+                const char * q = p;
+                double d;
+                int i;
+                if (!CNumParser::scan_double(q, token.value_end, d)) return;
+                if (q < token.value_end && !CNumParser::is_blank(*q)) return;
+                const char * r = p;
+                integers = integers && CNumParser::scan_int(r, token.value_end, i) && r == q && q - p <= 9;
+                p = q;
+                arity++;
+            }
+            if (arity > 0) type = integers ? MB_INT : MB_REAL;
+        }
+    };
+
+    /*!
+     *  \brief CMbWriter class, lays out and writes the sections of an .mb file
+     */
+    class CMbWriter
+    {
+    public:
+        /*! place n bytes at p after the previous section, they are read by write() */
+        uint64_t add(const void * p, size_t n)
+        {
+            const uint64_t offset = m_pos;
+            m_sections.push_back(CSection{ p, n, offset });
+            m_pos = (m_pos + n + 15) & ~(uint64_t)15;
+            return offset;
+        }
+
+        /*! the header and the sections, false if the file cannot be written */
+        bool write(const std::string & filename, const CMbHeader & header) const
+        {
+            FILE * fp = fopen(filename.c_str(), "wb");
+            if (fp == NULL) return false;
+            bool ok = fwrite(&header, sizeof(CMbHeader), 1, fp) == 1;
+            uint64_t written = sizeof(CMbHeader);
+            static const char zeros[16] = { 0 };
+            for (const CSection & s : m_sections)
+            {
+                if (!ok) break;
+                ok = fwrite(zeros, 1, (size_t)(s.offset - written), fp) == s.offset - written;
+                ok = ok && (s.size == 0 || fwrite(s.data, 1, s.size, fp) == s.size);
+                written = s.offset + s.size;
+            }
+            ok = (fclose(fp) == 0) && ok;
+            if (!ok) remove(filename.c_str());
+            return ok;
+        }
+
+    protected:
+        struct CSection
+        {
+            const void * data;
+            size_t size;
+            uint64_t offset;
+        };
+        std::vector<CSection> m_sections;
+        uint64_t m_pos = (sizeof(CMbHeader) + 15) & ~(uint64_t)15;
+    };
+
+}; //namespace
+
+#endif
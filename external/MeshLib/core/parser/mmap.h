@@ -0,0 +1,348 @@
+/*!
+*      \file mmap.h
+*      \brief Read-only memory mapped file
+*
+*      Maps a whole file into the address space so that the readers can
+*      tokenize it in place, without copying lines into std::string.
+*
+*      Mapped pages are faulted in as the parser touches them, which is slow
+*      on network mounts. The FETCH mode reads the file instead, in large
+*      sequential blocks on a thread of its own, so that a progressive parser
+*      works on the blocks already there while the next ones arrive. Files
+*      whose suffix has a decoder are fetched and decoded. Gzip files (.gz)
+*      are decoded by CGzip unless a decoder is set for them, on a thread
+*      as well, so the parser runs on the bytes decoded so far.
+*/
+
+#ifndef _MESHLIB_MMAP_H_
+#define _MESHLIB_MMAP_H_
+
+#include <string>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <memory>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+#include "gzip.h"
+
+#ifdef _WIN32
+#include "win32.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMappedFile class, a read-only view of a whole file
+     *
+     *  The view stays valid until the object is destroyed or close() is called.
+     */
+    class CMappedFile
+    {
+    public:
+        /*! how a file is brought into memory */
+        enum Mode { MAP, FETCH };
+        /*! turns the bytes of a file into the view, false if they are damaged */
+        typedef std::function<bool(const char * data, size_t size, std::vector<char> & out)> CDecoder;
+
+        CMappedFile() {}
+        CMappedFile(const std::string & filename) { open(filename); }
+        ~CMappedFile() { close(); }
+
+        CMappedFile(const CMappedFile &) = delete;
+        CMappedFile & operator=(const CMappedFile &) = delete;
+
+        /*! the mode of open(filename), MAP unless the application sets it, for a network store say */
+        static Mode & default_mode()
+        {
+            static Mode mode = MAP;
+            return mode;
+        }
+        /*!
+         *  Decode the files ending in suffix, e.g. ".zst" with libzstd, MeshLib only decodes gzip itself
+         *  \param decoder an empty function removes the decoder
+         */
+        static void set_decoder(const std::string & suffix, CDecoder decoder)
+        {
+            std::lock_guard<std::mutex> lock(_decoders_mutex());
+            if (decoder) _decoders()[suffix] = decoder;
+            else _decoders().erase(suffix);
+        }
+
+        /*!
+         *  Map the file
+         *  \param filename the input file name
+         *  \return true if the file is mapped, an empty file is mapped as an empty view
+         */
+        bool open(const std::string & filename) { return open(filename, default_mode()); }
+
+        /*!
+         *  Map or fetch the file
+         *  \param mode  FETCH reads it in blocks on a thread, MAP maps it
+         *  \param wait  false returns once a fetch has started, the bytes are then
+         *               there as wait() and available() say, see CObjParser::parse_progressive
+         *  \return false if the file cannot be opened, read or decoded
+         */
+        bool open(const std::string & filename, Mode mode, bool wait = true)
+        {
+            close();
+            CDecoder decoder = _decoder(filename);
+            const bool gzip = !decoder && _ends_with(filename, ".gz");
+            if (decoder || gzip || mode == FETCH)
+            {
+                if (!_fetch(filename)) return false;
+                if (!decoder && !gzip && !wait) return true;
+                this->wait(m_size);
+                _join();
+                if (m_failed) { close(); return false; }
+                if (gzip) return _gunzip(wait);
+                if (!decoder) return true;
+
+                std::vector<char> out;
+                if (!decoder(m_data, m_size, out)) { close(); return false; }
+                m_buffer.swap(out);
+                m_data = m_buffer.data();
+                m_size = m_buffer.size();
+                m_available = m_size;
+                return true;
+            }
+#ifdef _WIN32
+            // through parser/win32.cpp, windows.h stays out of the includers of this header
+            if (!win32::map_file(filename.c_str(), m_file, m_mapping, m_data, m_size)) return false;
+            m_open = true;
+            m_available = m_size;
+#else
+            m_fd = ::open(filename.c_str(), O_RDONLY);
+            if (m_fd < 0) return false;
+
+            struct stat st;
+            if (fstat(m_fd, &st) != 0) { close(); return false; }
+            m_size = (size_t)st.st_size;
+            m_open = true;
+            m_available = m_size;
+            if (m_size == 0) return true;
+
+            void * p = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+            if (p == MAP_FAILED) { close(); return false; }
+            m_data = (const char *)p;
+            madvise(p, m_size, MADV_SEQUENTIAL);
+#endif
+            return true;
+        }
+
+        /*!
+         *  Unmap the file
+         */
+        void close()
+        {
+            m_cancel = true;
+            _join();
+            m_cancel = false;
+            m_failed = false;
+            if (m_fetched)
+            {
+                std::vector<char>().swap(m_buffer);
+                m_fetched = false;
+                m_data = NULL;
+            }
+#ifdef _WIN32
+            win32::unmap_file(m_file, m_mapping, m_data);
+            m_mapping = NULL;
+            m_file = NULL;
+#else
+            if (m_data) munmap((void *)m_data, m_size);
+            if (m_fd >= 0) ::close(m_fd);
+            m_fd = -1;
+#endif
+            m_data = NULL;
+            m_size = 0;
+            m_available = 0;
+            m_open = false;
+        }
+
+        /*! whether the file is mapped */
+        bool is_open() const { return m_open; }
+        /*! first byte of the file */
+        const char * begin() const { return m_data; }
+        /*! one past the last byte of the file */
+        const char * end() const { return m_data + m_size; }
+        /*! size of the file in bytes */
+        size_t size() const { return m_size; }
+
+        /*! bytes from begin() on that are in memory, size() unless a fetch is running */
+        size_t available() const { return m_available; }
+        /*!
+         *  Wait for the first n bytes of a fetch
+         *  \return the bytes in memory, fewer than n only if the fetch failed
+         */
+        size_t wait(size_t n) const
+        {
+            n = std::min(n, m_size);
+            if (m_available >= n) return m_available;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_arrived.wait(lock, [&] { return m_available >= n || m_failed || !m_fetching; });
+            return m_available;
+        }
+        /*! whether a fetch stopped at a read error */
+        bool failed() const { return m_failed; }
+
+    protected:
+        //! bytes per read of a fetch
+        static constexpr size_t s_block_size = 8 << 20;
+
+        static std::map<std::string, CDecoder> & _decoders()
+        {
+            static std::map<std::string, CDecoder> decoders;
+            return decoders;
+        }
+        static std::mutex & _decoders_mutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+        static CDecoder _decoder(const std::string & filename)
+        {
+            std::lock_guard<std::mutex> lock(_decoders_mutex());
+            for (auto & d : _decoders())
+            {
+                if (_ends_with(filename, d.first)) return d.second;
+            }
+            return CDecoder();
+        }
+        static bool _ends_with(const std::string & s, const std::string & suffix)
+        {
+            return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        /*! start reading the file into m_buffer on a thread */
+        bool _fetch(const std::string & filename)
+        {
+            FILE * fp = fopen(filename.c_str(), "rb");
+            if (fp == NULL) return false;
+            // the blocks go straight into the buffer
+            setvbuf(fp, NULL, _IONBF, 0);
+            if (fseek(fp, 0, SEEK_END) != 0) { fclose(fp); return false; }
+#ifdef _WIN32
+            const long long size = _ftelli64(fp);
+#else
+            const long long size = (long long)ftello(fp);
+#endif
+            if (size < 0 || fseek(fp, 0, SEEK_SET) != 0) { fclose(fp); return false; }
+
+            m_buffer.resize((size_t)size);
+            m_data = m_buffer.data();
+            m_size = (size_t)size;
+            m_fetched = true;
+            m_open = true;
+            m_available = 0;
+            m_fetching = true;
+            m_thread = std::thread([this, fp]()
+            {
+                // a copy, std::min takes its arguments by reference
+                const size_t block = s_block_size;
+                size_t done = 0;
+                while (done < m_size && !m_cancel)
+                {
+                    const size_t n = fread(m_buffer.data() + done, 1, std::min(block, m_size - done), fp);
+                    if (n == 0) break;
+                    done += n;
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_available = done;
+                    m_arrived.notify_all();
+                }
+                fclose(fp);
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_failed = done < m_size;
+                m_fetching = false;
+                m_arrived.notify_all();
+            });
+            return true;
+        }
+        /*! decode the fetched gzip file, on a thread unless wait is set or its size is not known up front */
+        bool _gunzip(bool wait)
+        {
+            std::vector<char> packed;
+            packed.swap(m_buffer);
+            std::vector<CGzip::CMember> members;
+            const size_t size = CGzip::members(packed.data(), packed.size(), members);
+            if (wait || size == (size_t)-1)
+            {
+                if (!CGzip::decode(packed.data(), packed.size(), m_buffer)) { close(); return false; }
+                m_data = m_buffer.data();
+                m_size = m_buffer.size();
+                m_available = m_size;
+                return true;
+            }
+
+            try
+            {
+                m_buffer.resize(size);
+            }
+            catch (const std::bad_alloc &)
+            {
+                close();
+                return false;
+            }
+            m_data = m_buffer.data();
+            m_size = size;
+            m_available = 0;
+            m_fetching = true;
+            m_thread = std::thread([this, packed = std::move(packed), members = std::move(members)]()
+            {
+                const bool ok = CGzip::decode(packed.data(), packed.size(), members, m_buffer, [this](size_t n)
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_available = n;
+                    m_arrived.notify_all();
+                    return !m_cancel;
+                });
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_failed = !ok;
+                m_fetching = false;
+                m_arrived.notify_all();
+            });
+            return true;
+        }
+        void _join()
+        {
+            if (m_thread.joinable()) m_thread.join();
+        }
+
+        const char * m_data = NULL;
+        size_t       m_size = 0;
+        bool         m_open = false;
+#ifdef _WIN32
+        void *       m_file = NULL;
+        void *       m_mapping = NULL;
+#else
+        int          m_fd = -1;
+#endif
+
+        // a fetch, or a decoded file, is held in m_buffer, which a fetch or a decode fills up to m_available
+        std::vector<char>               m_buffer;
+        bool                            m_fetched = false;
+        std::thread                     m_thread;
+        std::atomic<size_t>             m_available{ 0 };
+        std::atomic<bool>               m_fetching{ false };
+        std::atomic<bool>               m_failed{ false };
+        std::atomic<bool>               m_cancel{ false };
+        mutable std::mutex              m_mutex;
+        mutable std::condition_variable m_arrived;
+    };
+
+}; //namespace
+
+#endif
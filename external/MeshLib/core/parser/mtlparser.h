@@ -0,0 +1,194 @@
+/*!
+*      \file mtlparser.h
+*      \brief Reader of the Wavefront .mtl material libraries an .obj names
+*
+*      The colors, the shininess and the opacity of every newmtl record, and
+*      the files of its texture maps, map_Kd and friends. Map options such as
+*      -s 1 1 1 or -clamp on are skipped, the file name is the rest of the
+*      line and may hold blanks. Unknown records are ignored.
+*/
+
+#ifndef _MESHLIB_MTL_PARSER_H_
+#define _MESHLIB_MTL_PARSER_H_
+
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include "../Geometry/Point.h"
+#include "mmap.h"
+#include "numparse.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMtlMaterial, a newmtl record, the maps are empty when absent
+     */
+    struct CMtlMaterial
+    {
+        std::string name;
+        CPoint ambient  = CPoint(0, 0, 0);     //!< Ka
+        CPoint diffuse  = CPoint(1, 1, 1);     //!< Kd
+        CPoint specular = CPoint(0, 0, 0);     //!< Ks
+        CPoint emissive = CPoint(0, 0, 0);     //!< Ke
+        double shininess = 0;                  //!< Ns
+        double opacity = 1;                    //!< d, or 1 - Tr
+        int    illum = 2;
+
+        std::string ambient_map;               //!< map_Ka
+        std::string diffuse_map;               //!< map_Kd
+        std::string specular_map;              //!< map_Ks
+        std::string shininess_map;             //!< map_Ns
+        std::string opacity_map;               //!< map_d
+        std::string bump_map;                  //!< map_Bump, bump
+        std::string normal_map;                //!< norm, map_Kn
+        std::string displacement_map;          //!< disp
+    };
+
+    /*!
+     *  \brief CMtlParser class, the records are read with the CNumParser scanners
+     */
+    class CMtlParser : public CNumParser
+    {
+    public:
+        /*!
+         *  Parse an .mtl file, appending its materials
+         *  \return false if the file cannot be opened
+         */
+        static bool parse_file(const std::string & filename, std::vector<CMtlMaterial> & materials)
+        {
+            CMappedFile file(filename);
+            if (!file.is_open()) return false;
+            parse(file.begin(), file.end(), materials);
+            return true;
+        }
+
+        /*!
+         *  Parse an .mtl buffer, appending its materials. The records before the
+         *  first newmtl are ignored.
+         */
+        static void parse(const char * p, const char * end, std::vector<CMtlMaterial> & materials)
+        {
+            const size_t first = materials.size();
+            while (p < end)
+            {
+                skip_blank(p, end);
+                const char * key = p;
+                while (p < end && !is_blank(*p) && *p != '\n') p++;
+                const std::string keyword(key, p);
+                if (keyword == "newmtl")
+                {
+                    materials.push_back(CMtlMaterial());
+                    materials.back().name = _rest(p, end);
+                }
+                else if (materials.size() > first && !keyword.empty() && keyword[0] != '#')
+                {
+                    _record(keyword, p, end, materials.back());
+                }
+                skip_line(p, end);
+            }
+        }
+
+    protected:
+        static void _record(const std::string & keyword, const char * p, const char * end, CMtlMaterial & m)
+        {
+            if (keyword == "Ka") _color(p, end, m.ambient);
+            else if (keyword == "Kd") _color(p, end, m.diffuse);
+            else if (keyword == "Ks") _color(p, end, m.specular);
+            else if (keyword == "Ke") _color(p, end, m.emissive);
+            else if (keyword == "Ns") _number(p, end, m.shininess);
+            else if (keyword == "d") _number(p, end, m.opacity);
+            else if (keyword == "Tr")
+            {
+                double t = 0;
+                if (_number(p, end, t)) m.opacity = 1 - t;
+            }
+            else if (keyword == "illum")
+            {
+                skip_blank(p, end);
+                scan_int(p, end, m.illum);
+            }
+            else if (keyword == "map_Ka") m.ambient_map = _map(p, end);
+            else if (keyword == "map_Kd") m.diffuse_map = _map(p, end);
+            else if (keyword == "map_Ks") m.specular_map = _map(p, end);
+            else if (keyword == "map_Ns") m.shininess_map = _map(p, end);
+            else if (keyword == "map_d") m.opacity_map = _map(p, end);
+            else if (keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump") m.bump_map = _map(p, end);
+            else if (keyword == "norm" || keyword == "map_Kn") m.normal_map = _map(p, end);
+            else if (keyword == "disp") m.displacement_map = _map(p, end);
+        }
+
+        static bool _number(const char * p, const char * end, double & value)
+        {
+            skip_blank(p, end);
+            return scan_double(p, end, value);
+        }
+
+        /*! r g b, a single value is gray, spectral and xyz colors are ignored */
+        static void _color(const char * p, const char * end, CPoint & color)
+        {
+            double c[3];
+            int n = 0;
+            for (; n < 3; n++)
+            {
+                skip_blank(p, end);
+                if (!scan_double(p, end, c[n])) break;
+            }
+            if (n == 1) color = CPoint(c[0], c[0], c[0]);
+            else if (n == 3) color = CPoint(c[0], c[1], c[2]);
+        }
+
+        /*! the rest of the line, trimmed */
+        static std::string _rest(const char * p, const char * end)
+        {
+            skip_blank(p, end);
+            const char * e = p;
+            while (e < end && *e != '\n') e++;
+            while (e > p && is_blank(e[-1])) e--;
+            return std::string(p, e);
+        }
+
+        /*! the file of a map, after its options */
+        static std::string _map(const char * p, const char * end)
+        {
+            while (true)
+            {
+                skip_blank(p, end);
+                if (p + 1 >= end || p[0] != '-' || is_digit(p[1])) break;
+                const char * o = p;
+                while (p < end && !is_blank(*p) && *p != '\n') p++;
+                const int values = _option_values(std::string(o, p));
+                // -o, -s and -t take up to three numbers
+                for (int k = 0; k < (values < 0 ? 3 : values); k++)
+                {
+                    skip_blank(p, end);
+                    const char * v = p;
+                    while (p < end && !is_blank(*p) && *p != '\n') p++;
+                    if (values < 0)
+                    {
+                        double x;
+                        const char * n = v;
+                        if (!scan_double(n, p, x) || n != p)
+                        {
+                            p = v;
+                            break;
+                        }
+                    }
+                }
+            }
+            return _rest(p, end);
+        }
+
+        /*! the number of values of a map option, -1 for up to three numbers */
+        static int _option_values(const std::string & option)
+        {
+            if (option == "-o" || option == "-s" || option == "-t") return -1;
+            if (option == "-mm") return 2;
+            return 1;   // -blendu, -blendv, -bm, -boost, -cc, -clamp, -imfchan, -texres, -type
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,395 @@
+/*!
+*      \file mtx.h
+*      \brief Tiled levels of detail of a mesh (.mtx)
+*
+*      A versioned, little endian file of a hierarchy of mesh tiles, meant to
+*      be mapped into memory and read tile by tile, so that a viewer keeps
+*      only the tiles it draws:
+*
+*          CMtxHeader
+*          tile data   the tiles in the order they were made, finest first
+*          CMtxNode    header.nodes of them at header.node_offset
+*
+*      The triangles are cut by an octree of their bounds until a cell holds
+*      at most leaf_triangles of them, a leaf tile keeps them as they are. An
+*      inner tile is its children merged and simplified back to about
+*      leaf_triangles, see CMeshSimplifier, so every level of the tree covers
+*      the whole surface. The simplifier keeps the borders of a tile in
+*      place, and every border of a tile lies on the border of a cell, so
+*      tiles of any levels next to each other meet without cracks.
+*
+*      The nodes are breadth first, the root is node 0 and the children of a
+*      node are consecutive. The data of a tile is its vertices, 8 floats
+*      each, the point, the normal and the uv, then 3 uint32_t indices of
+*      those per triangle, starting on a 16 byte boundary.
+*/
+
+#ifndef _MESHLIB_MTX_H_
+#define _MESHLIB_MTX_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "mmap.h"
+#include "parallel.h"
+#include "../Geometry/MeshSimplifier.h"
+
+#define MTX_VERSION 1
+
+#define MTX_MAX_DEPTH 24
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMtxHeader, the first bytes of a .mtx file
+     */
+    struct CMtxHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t nodes;
+        /*! 1 if the uvs of the vertices are meaningful */
+        uint32_t with_uv;
+        /*! bounds of the points */
+        float    lo[3];
+        float    hi[3];
+        /*! byte offset of node 0 */
+        uint64_t node_offset;
+
+        CMtxHeader()
+        {
+            memcpy(magic, "MTX\x1a", 4);
+            version = MTX_VERSION;
+            nodes = 0;
+            with_uv = 0;
+            for (int i = 0; i < 3; i++) lo[i] = hi[i] = 0;
+            node_offset = 0;
+        }
+
+        bool valid() const
+        {
+            return memcmp(magic, "MTX\x1a", 4) == 0 && version == MTX_VERSION && nodes > 0;
+        }
+    };
+
+    /*!
+     *  \brief CMtxNode, a tile of the hierarchy
+     */
+    struct CMtxNode
+    {
+        /*! sphere around the points of the tile */
+        float    center[3];
+        float    radius;
+        /*! distance to the full mesh the tile may be off by, in the units of the points, 0 for a leaf */
+        float    error;
+        uint32_t first_child;
+        uint32_t children;
+        uint32_t vertices;
+        uint32_t triangles;
+        uint32_t reserved;
+        /*! byte offset of the data of the tile */
+        uint64_t offset;
+
+        /*! bytes of the data of the tile */
+        size_t bytes() const { return (size_t)vertices * 8 * sizeof(float) + (size_t)triangles * 3 * sizeof(uint32_t); }
+    };
+
+    /*!
+     *  \brief CMtxFile class, a mapped, read-only .mtx file
+     */
+    class CMtxFile
+    {
+    public:
+        CMtxFile() {}
+        CMtxFile(const std::string & filename) { open(filename); }
+
+        bool open(const std::string & filename)
+        {
+            m_ok = false;
+            if (!m_file.open(filename)) return false;
+            if (m_file.size() < sizeof(CMtxHeader)) { m_file.close(); return false; }
+
+            memcpy(&m_header, m_file.begin(), sizeof(CMtxHeader));
+            if (!m_header.valid() || m_header.node_offset + (uint64_t)m_header.nodes * sizeof(CMtxNode) > m_file.size())
+            {
+                m_file.close();
+                return false;
+            }
+            const CMtxNode * nodes = (const CMtxNode *)((const char *)m_file.begin() + m_header.node_offset);
+            m_nodes.assign(nodes, nodes + m_header.nodes);
+            for (const CMtxNode & n : m_nodes)
+            {
+                if (n.offset + n.bytes() > m_file.size() || (n.children && (n.first_child == 0 ||
+                    (uint64_t)n.first_child + n.children > m_header.nodes)))
+                {
+                    m_file.close();
+                    m_nodes.clear();
+                    return false;
+                }
+            }
+            m_ok = true;
+            return true;
+        }
+
+        void close() { m_file.close(); m_nodes.clear(); m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        const CMtxHeader & header() const { return m_header; }
+        const std::vector<CMtxNode> & nodes() const { return m_nodes; }
+
+        /*! the data of tile i, its vertices then its indices */
+        const uint8_t * tile(size_t i) const
+        {
+            return m_ok ? (const uint8_t *)m_file.begin() + m_nodes[i].offset : NULL;
+        }
+
+    protected:
+        CMappedFile           m_file;
+        CMtxHeader            m_header;
+        std::vector<CMtxNode> m_nodes;
+        bool                  m_ok = false;
+    };
+
+    /*!
+     *  Cut an indexed triangle list into a hierarchy of tiles and write them.
+     *  The tiles of a level are made on all threads, a few at a time, and
+     *  written as they are done, so besides the input no more than the tiles
+     *  being made and the simplified triangles of one level are held
+     *  \param indices        three vertex indices per triangle
+     *  \param n              number of indices
+     *  \param vertices       8 floats per vertex, the point, the normal and the uv
+     *  \param nv             number of vertices
+     *  \param with_uv        whether the uvs are meaningful, the seams should then be borders, each
+     *                        side with vertices of its own, as CVertexWelder makes them
+     *  \param leaf_triangles triangles of a tile
+     *  \return false if the file cannot be written
+     */
+    inline bool write_mtx_file(const std::string & filename, const uint32_t * indices, size_t n, const float * vertices, size_t nv,
+        bool with_uv, uint32_t leaf_triangles = 1 << 15, int threads = 0)
+    {
+        const size_t nt = n / 3;
+        if (!indices || !vertices || nt == 0 || nv == 0 || leaf_triangles == 0) return false;
+
+        // the octree, breadth first: every node splits its triangles by their centroids
+        struct CCell
+        {
+            float lo[3], hi[3];
+            size_t begin, end;
+            int depth;
+            uint32_t first_child, children;
+        };
+        std::vector<uint32_t> order(nt);
+        for (size_t t = 0; t < nt; t++) order[t] = (uint32_t)t;
+        CMtxHeader header;
+        header.with_uv = with_uv ? 1 : 0;
+        for (int d = 0; d < 3; d++)
+        {
+            header.lo[d] = vertices[d];
+            header.hi[d] = vertices[d];
+        }
+        for (size_t v = 0; v < nv; v++)
+        {
+            for (int d = 0; d < 3; d++)
+            {
+                header.lo[d] = std::min(header.lo[d], vertices[8 * v + d]);
+                header.hi[d] = std::max(header.hi[d], vertices[8 * v + d]);
+            }
+        }
+        auto centroid = [&](uint32_t t, int d)
+        {
+            const uint32_t * c = indices + 3 * (size_t)t;
+            return vertices[8 * (size_t)c[0] + d] + vertices[8 * (size_t)c[1] + d] + vertices[8 * (size_t)c[2] + d];
+        };
+
+        std::vector<CCell> cells;
+        CCell root = { { header.lo[0], header.lo[1], header.lo[2] }, { header.hi[0], header.hi[1], header.hi[2] }, 0, nt, 0, 0, 0 };
+        cells.push_back(root);
+        for (size_t i = 0; i < cells.size(); i++)
+        {
+            CCell cell = cells[i];
+            if (cell.end - cell.begin <= leaf_triangles || cell.depth >= MTX_MAX_DEPTH) continue;
+            float mid[3];
+            for (int d = 0; d < 3; d++) mid[d] = (cell.lo[d] + cell.hi[d]) / 2;
+            // the eight octants in place, split along x, then y, then z
+            size_t bounds[9];
+            bounds[0] = cell.begin;
+            bounds[8] = cell.end;
+            uint32_t * o = order.data();
+            bounds[4] = std::partition(o + bounds[0], o + bounds[8], [&](uint32_t t) { return centroid(t, 0) < 3 * mid[0]; }) - o;
+            for (int h = 0; h < 8; h += 4)
+                bounds[h + 2] = std::partition(o + bounds[h], o + bounds[h + 4], [&](uint32_t t) { return centroid(t, 1) < 3 * mid[1]; }) - o;
+            for (int q = 0; q < 8; q += 2)
+                bounds[q + 1] = std::partition(o + bounds[q], o + bounds[q + 2], [&](uint32_t t) { return centroid(t, 2) < 3 * mid[2]; }) - o;
+
+            cells[i].first_child = (uint32_t)cells.size();
+            for (int k = 0; k < 8; k++)
+            {
+                if (bounds[k] == bounds[k + 1]) continue;
+                CCell child;
+                for (int d = 0; d < 3; d++)
+                {
+                    const bool upper = ((k >> (2 - d)) & 1) != 0;
+                    child.lo[d] = upper ? mid[d] : cell.lo[d];
+                    child.hi[d] = upper ? cell.hi[d] : mid[d];
+                }
+                child.begin = bounds[k];
+                child.end = bounds[k + 1];
+                child.depth = cell.depth + 1;
+                child.first_child = child.children = 0;
+                cells.push_back(child);
+                cells[i].children++;
+            }
+        }
+        header.nodes = (uint32_t)cells.size();
+
+        FILE * fp = fopen(filename.c_str(), "wb");
+        if (fp == NULL) return false;
+        static const char zeros[16] = { 0 };
+        uint64_t written = (sizeof(CMtxHeader) + 15) & ~(uint64_t)15;
+        bool ok = fwrite(&header, sizeof(CMtxHeader), 1, fp) == 1;
+        ok = ok && fwrite(zeros, 1, (size_t)(written - sizeof(CMtxHeader)), fp) == written - sizeof(CMtxHeader);
+
+        // the levels deepest first, an inner tile from the simplified triangles of its children,
+        // kept until their parents are made
+        std::vector<CMtxNode> nodes(cells.size());
+        std::vector<std::vector<uint32_t>> simplified(cells.size());
+        const int workers = resolve_threads(threads);
+        std::vector<std::vector<uint8_t>> data;
+        size_t end = cells.size();
+        while (end > 0 && ok)
+        {
+            size_t begin = end;
+            while (begin > 0 && cells[begin - 1].depth == cells[end - 1].depth) begin--;
+            for (size_t from = begin; from < end && ok; from += 2 * workers)
+            {
+                const size_t to = std::min(end, from + 2 * (size_t)workers);
+                data.assign(to - from, std::vector<uint8_t>());
+                parallel_for(to - from, threads, [&](size_t b, size_t e)
+                {
+                    std::vector<uint32_t> tris, local, map;
+                    std::vector<float> positions;
+                    for (size_t k = b; k < e; k++)
+                    {
+                        const size_t i = from + k;
+                        const CCell & cell = cells[i];
+                        CMtxNode & node = nodes[i];
+                        node.first_child = cell.first_child;
+                        node.children = cell.children;
+                        node.error = 0;
+                        node.reserved = 0;
+                        tris.clear();
+                        if (cell.children == 0)
+                        {
+                            for (size_t j = cell.begin; j < cell.end; j++) tris.insert(tris.end(), indices + 3 * (size_t)order[j], indices + 3 * (size_t)order[j] + 3);
+                        }
+                        else
+                        {
+                            for (uint32_t c = cell.first_child; c < cell.first_child + cell.children; c++)
+                            {
+                                node.error = std::max(node.error, nodes[c].error);
+                                if (cells[c].children)
+                                {
+                                    tris.insert(tris.end(), simplified[c].begin(), simplified[c].end());
+                                    std::vector<uint32_t>().swap(simplified[c]);
+                                }
+                                else for (size_t j = cells[c].begin; j < cells[c].end; j++) tris.insert(tris.end(), indices + 3 * (size_t)order[j], indices + 3 * (size_t)order[j] + 3);
+                            }
+                        }
+
+                        // the vertices of the tile, numbered as they are first used
+                        map.clear();
+                        local.resize(tris.size());
+                        for (size_t j = 0; j < tris.size(); j++) map.push_back(tris[j]);
+                        std::sort(map.begin(), map.end());
+                        map.erase(std::unique(map.begin(), map.end()), map.end());
+                        for (size_t j = 0; j < tris.size(); j++) local[j] = (uint32_t)(std::lower_bound(map.begin(), map.end(), tris[j]) - map.begin());
+
+                        if (cell.children)
+                        {
+                            positions.resize(3 * map.size());
+                            for (size_t v = 0; v < map.size(); v++)
+                                for (int d = 0; d < 3; d++) positions[3 * v + d] = vertices[8 * (size_t)map[v] + d];
+                            CMeshSimplifier simplifier(local.data(), local.size(), positions.data(), map.size(), 1);
+                            simplifier.simplify(leaf_triangles, 1);
+                            node.error += simplifier.error();
+                            simplifier.triangles(local);
+                            // what the parent merges, in the numbers of the input
+                            std::vector<uint32_t> & mine = simplified[i];
+                            mine.resize(local.size());
+                            for (size_t j = 0; j < local.size(); j++) mine[j] = map[local[j]];
+
+                            // the vertices left, in the order of the triangles
+                            std::vector<uint32_t> number(map.size(), uint32_t(-1));
+                            std::vector<uint32_t> used;
+                            for (uint32_t & v : local)
+                            {
+                                if (number[v] == uint32_t(-1))
+                                {
+                                    number[v] = (uint32_t)used.size();
+                                    used.push_back(map[v]);
+                                }
+                                v = number[v];
+                            }
+                            map.swap(used);
+                        }
+
+                        node.vertices = (uint32_t)map.size();
+                        node.triangles = (uint32_t)(local.size() / 3);
+                        float lo[3], hi[3];
+                        for (int d = 0; d < 3; d++)
+                        {
+                            lo[d] = map.empty() ? 0 : vertices[8 * (size_t)map[0] + d];
+                            hi[d] = lo[d];
+                        }
+                        std::vector<uint8_t> & out = data[k];
+                        out.resize(node.bytes());
+                        float * v = (float *)out.data();
+                        for (uint32_t m : map)
+                        {
+                            memcpy(v, vertices + 8 * (size_t)m, 8 * sizeof(float));
+                            for (int d = 0; d < 3; d++)
+                            {
+                                lo[d] = std::min(lo[d], v[d]);
+                                hi[d] = std::max(hi[d], v[d]);
+                            }
+                            v += 8;
+                        }
+                        memcpy(v, local.data(), local.size() * sizeof(uint32_t));
+                        float r2 = 0;
+                        for (int d = 0; d < 3; d++)
+                        {
+                            node.center[d] = (lo[d] + hi[d]) / 2;
+                            r2 += (hi[d] - lo[d]) * (hi[d] - lo[d]) / 4;
+                        }
+                        node.radius = std::sqrt(r2);
+                    }
+                }, 1);
+
+                for (size_t k = 0; k < data.size() && ok; k++)
+                {
+                    nodes[from + k].offset = written;
+                    const size_t pad = (16 - data[k].size() % 16) % 16;
+                    ok = fwrite(data[k].data(), 1, data[k].size(), fp) == data[k].size() && fwrite(zeros, 1, pad, fp) == pad;
+                    written += data[k].size() + pad;
+                }
+            }
+            end = begin;
+        }
+
+        header.node_offset = written;
+        ok = ok && fwrite(nodes.data(), sizeof(CMtxNode), nodes.size(), fp) == nodes.size();
+        ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(CMtxHeader), 1, fp) == 1;
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) remove(filename.c_str());
+        return ok;
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,255 @@
+/*!
+*      \file numparse.h
+*      \brief In-place scanners for the numeric fields of the mesh readers
+*
+*      Integers and doubles are read straight from a character range without
+*      copying tokens. Doubles take a correctly rounded fast path whenever the
+*      decimal mantissa and the power of ten are exact in double precision and
+*      fall back to strtod otherwise, long digit runs are classified with
+*      SSE2/AVX2 and converted eight digits at a time.
+*
+*      Define MESHLIB_USE_STRTOD to convert every double with strtod.
+*/
+
+#ifndef _MESHLIB_NUMPARSE_H_
+#define _MESHLIB_NUMPARSE_H_
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLIB_NUMPARSE_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CNumParser class, scanners working in place, they never read past `end`
+     *
+     *  A successful scan advances `p` past the number, a failed scan leaves it alone.
+     */
+    class CNumParser
+    {
+    public:
+        static inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+        static inline bool is_digit(char c) { return (unsigned char)(c - '0') < 10; }
+
+        static inline void skip_blank(const char * &p, const char * end)
+        {
+            while (p < end && is_blank(*p)) p++;
+        }
+
+        static inline void skip_line(const char * &p, const char * end)
+        {
+            const char * q = (const char *)memchr(p, '\n', (size_t)(end - p));
+            p = q ? q + 1 : end;
+        }
+
+        /*! number of consecutive decimal digits from p on */
+        static inline size_t digit_run(const char * p, const char * end)
+        {
+            const char * q = p;
+#if defined(__AVX2__)
+            const __m256i zero8 = _mm256_set1_epi8('0'), nine8 = _mm256_set1_epi8(9);
+            while (end - q >= 32)
+            {
+                __m256i d = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i *)q), zero8);
+                // d is a digit iff max(d, 9) == 9 as unsigned bytes
+                __m256i digit = _mm256_cmpeq_epi8(_mm256_max_epu8(d, nine8), nine8);
+                uint32_t other = ~(uint32_t)_mm256_movemask_epi8(digit);
+                if (other) return (size_t)(q - p) + _ctz(other);
+                q += 32;
+            }
+#endif
+#ifdef MESHLIB_NUMPARSE_SSE2
+            const __m128i zero16 = _mm_set1_epi8('0'), nine16 = _mm_set1_epi8(9);
+            while (end - q >= 16)
+            {
+                __m128i d = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)q), zero16);
+                __m128i digit = _mm_cmpeq_epi8(_mm_max_epu8(d, nine16), nine16);
+                uint32_t other = ~(uint32_t)_mm_movemask_epi8(digit) & 0xffff;
+                if (other) return (size_t)(q - p) + _ctz(other);
+                q += 16;
+            }
+#endif
+            while (q < end && is_digit(*q)) q++;
+            return (size_t)(q - p);
+        }
+
+        static inline bool scan_int(const char * &p, const char * end, int & value)
+        {
+            const char * q = p;
+            bool neg = false;
+            if (q < end && (*q == '-' || *q == '+')) neg = (*q++ == '-');
+            if (q >= end || !is_digit(*q)) return false;
+            int v = 0;
+            while (q < end && is_digit(*q)) v = v * 10 + (*q++ - '0');
+            value = neg ? -v : v;
+            p = q;
+            return true;
+        }
+
+        static inline bool scan_double(const char * &p, const char * end, double & value)
+        {
+            const char * q = p;
+            bool neg = false;
+            if (q < end && (*q == '-' || *q == '+')) neg = (*q++ == '-');
+
+            Mantissa m;
+            size_t n = digit_run(q, end);
+            m.add(q, n, false);
+            q += n;
+            size_t nf = 0;
+            if (q < end && *q == '.')
+            {
+                q++;
+                nf = digit_run(q, end);
+                m.add(q, nf, true);
+                q += nf;
+            }
+            if (n + nf == 0) return false;
+
+            int exponent = m.exponent;
+            if (q < end && (*q == 'e' || *q == 'E'))
+            {
+                const char * r = q + 1;
+                int e;
+                if (scan_int(r, end, e)) { exponent += e; q = r; }
+            }
+
+#ifndef MESHLIB_USE_STRTOD
+            double v;
+            if (!m.inexact && _fast_path(m.value, exponent, v))
+            {
+                value = neg ? -v : v;
+                p = q;
+                return true;
+            }
+#endif
+            value = _strtod(p, q);
+            p = q;
+            return true;
+        }
+
+        /*! convenience overload for null terminated strings, e.g. a line buffer */
+        static inline bool scan_double(const char * &p, double & value) { return scan_double(p, p + strlen(p), value); }
+        static inline bool scan_int(const char * &p, int & value) { return scan_int(p, p + strlen(p), value); }
+
+    protected:
+        /*! up to 19 significant decimal digits, and the power of ten they are scaled by */
+        struct Mantissa
+        {
+            uint64_t value = 0;
+            int digits = 0;
+            int exponent = 0;
+            /*! nonzero digits were dropped, the fast path cannot be exact */
+            bool inexact = false;
+
+            void add(const char * s, size_t n, bool fraction)
+            {
+                size_t i = 0;
+                // leading zeros are not significant
+                while (i < n && value == 0 && s[i] == '0') { i++; if (fraction) exponent--; }
+                while (i < n)
+                {
+                    if (n - i >= 8 && digits + 8 <= 19)
+                    {
+                        value = value * 100000000u + _eight_digits(s + i);
+                        digits += 8;
+                        i += 8;
+                        if (fraction) exponent -= 8;
+                        continue;
+                    }
+                    if (digits < 19)
+                    {
+                        value = value * 10 + (s[i] - '0');
+                        digits++;
+                        if (fraction) exponent--;
+                    }
+                    else
+                    {
+                        if (s[i] != '0') inexact = true;
+                        if (!fraction) exponent++;
+                    }
+                    i++;
+                }
+            }
+        };
+
+        /*! the eight ascii digits at s as an integer, SWAR on a little endian load */
+        static inline uint32_t _eight_digits(const char * s)
+        {
+            uint64_t v;
+            memcpy(&v, s, 8);
+            v -= 0x3030303030303030ull;
+            v = (v * 10) + (v >> 8);
+            v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+                (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >> 32;
+            return (uint32_t)v;
+        }
+
+        /*!
+         *  Clinger's fast path, mantissa and 10^|e| are exact doubles so a single
+         *  rounding step gives the correctly rounded result.
+         */
+        static inline bool _fast_path(uint64_t mantissa, int e, double & v)
+        {
+            static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+            const uint64_t exact = 1ull << 53;
+
+            if (mantissa == 0) { v = 0; return true; }
+            if (mantissa > exact) return false;
+            if (e < -22) return false;
+            if (e < 0) { v = (double)mantissa / pow10[-e]; return true; }
+            if (e <= 22) { v = (double)mantissa * pow10[e]; return true; }
+            // 123e30 = 123000000000e22, fine while the mantissa stays exact
+            if (e > 22 + 15) return false;
+            uint64_t m = mantissa;
+            for (int i = 22; i < e; i++)
+            {
+                m *= 10;
+                if (m > exact) return false;
+            }
+            v = (double)m * 1e22;
+            return true;
+        }
+
+        static inline double _strtod(const char * b, const char * e)
+        {
+            char buffer[64];
+            size_t n = (size_t)(e - b);
+            if (n < sizeof(buffer))
+            {
+                memcpy(buffer, b, n);
+                buffer[n] = 0;
+                return strtod(buffer, NULL);
+            }
+            return strtod(std::string(b, e).c_str(), NULL);
+        }
+
+        static inline unsigned _ctz(uint32_t x)
+        {
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanForward(&i, x);
+            return (unsigned)i;
+#else
+            return (unsigned)__builtin_ctz(x);
+#endif
+        }
+    };
+
+}; //namespace
+
+#endif
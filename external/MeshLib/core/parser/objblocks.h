@@ -0,0 +1,123 @@
+/*!
+*      \file objblocks.h
+*      \brief Hashes of the records of a parsed .obj file in blocks, to tell what an edit changed
+*
+*      An asset exported again after a small edit mostly moves some of its
+*      points, and the normals around them, and keeps its faces. The points
+*      and the normals are hashed in blocks of records, everything else, the
+*      faces, the uvs, the materials and the counts, into a single key of
+*      the layout. Two files of the same layout differ in the blocks whose
+*      hashes differ, a reader moves those points in place instead of
+*      building the mesh again; any other change needs the full build.
+*/
+
+#ifndef _MESHLIB_OBJ_BLOCKS_H_
+#define _MESHLIB_OBJ_BLOCKS_H_
+
+#include <vector>
+#include <string>
+#include <utility>
+
+#include "objparser.h"
+#include "store.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CObjBlocks class, the keys of the blocks of a CObjData
+     */
+    class CObjBlocks
+    {
+    public:
+        typedef std::vector<std::pair<size_t, size_t>> CRanges;
+
+        //! records of a block
+        static const size_t s_block = 1 << 12;
+
+        /*! the keys of the blocks of the points and normals, s_block records each, and of the rest */
+        std::vector<CStoreKey> points;
+        std::vector<CStoreKey> normals;
+        CStoreKey layout;
+        size_t num_points = 0;
+        size_t num_normals = 0;
+
+        bool empty() const { return points.empty(); }
+        void clear()
+        {
+            points.clear();
+            normals.clear();
+            layout = CStoreKey();
+            num_points = num_normals = 0;
+        }
+
+        /*! hash the records of obj, the blocks in parallel */
+        void build(const CObjData & obj, int threads = 0)
+        {
+            MESHLIB_TRACE_ZONE("hash obj blocks");
+            num_points = obj.points.size();
+            num_normals = obj.normals.size();
+            _hash(obj.points.data(), obj.points.size(), points, threads);
+            _hash(obj.normals.data(), obj.normals.size(), normals, threads);
+
+            // the faces and uvs in blocks too, then the keys of their blocks with the names and counts
+            std::vector<CStoreKey> faces, uvs;
+            _hash(obj.corners.data(), obj.corners.size(), faces, threads);
+            _hash(obj.uvs.data(), obj.uvs.size(), uvs, threads);
+            const size_t counts[5] = { obj.points.size(), obj.uvs.size(), obj.normals.size(), obj.corners.size(), obj.face_offsets.size() };
+            CStoreKey key = CContentStore::hash(counts, sizeof(counts));
+            if (!faces.empty()) key = CContentStore::hash(faces.data(), faces.size() * sizeof(CStoreKey), key);
+            if (!uvs.empty()) key = CContentStore::hash(uvs.data(), uvs.size() * sizeof(CStoreKey), key);
+            if (!obj.face_offsets.empty()) key = CContentStore::hash(obj.face_offsets.data(), obj.face_offsets.size() * sizeof(int), key);
+            if (!obj.material_runs.empty()) key = CContentStore::hash(obj.material_runs.data(), obj.material_runs.size() * sizeof(CObjMaterialRun), key);
+            for (const std::string & name : obj.materials) key = CContentStore::hash("usemtl " + name, key);
+            for (const std::string & name : obj.mtllibs) key = CContentStore::hash("mtllib " + name, key);
+            layout = key;
+        }
+
+        /*!
+         *  The records of the blocks that differ from those of before, as sorted half open ranges
+         *  of points and of normals, adjacent blocks in one range
+         *  \return false if the layouts differ, the ranges are left empty then
+         */
+        bool changed(const CObjBlocks & before, CRanges & point_ranges, CRanges & normal_ranges) const
+        {
+            point_ranges.clear();
+            normal_ranges.clear();
+            if (layout != before.layout || points.size() != before.points.size() || normals.size() != before.normals.size()) return false;
+            _ranges(points, before.points, num_points, point_ranges);
+            _ranges(normals, before.normals, num_normals, normal_ranges);
+            return true;
+        }
+
+    protected:
+        /*! a key per block of s_block records of data */
+        template<typename T>
+        static void _hash(const T * data, size_t n, std::vector<CStoreKey> & keys, int threads)
+        {
+            keys.assign((n + s_block - 1) / s_block, CStoreKey());
+            parallel_for(keys.size(), threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++)
+                {
+                    const size_t first = i * s_block, count = std::min(s_block, n - first);
+                    keys[i] = CContentStore::hash(data + first, count * sizeof(T));
+                }
+            }, 16);
+        }
+
+        static void _ranges(const std::vector<CStoreKey> & now, const std::vector<CStoreKey> & before, size_t n, CRanges & ranges)
+        {
+            for (size_t i = 0; i < now.size(); i++)
+            {
+                if (now[i] == before[i]) continue;
+                const size_t first = i * s_block, last = std::min(first + s_block, n);
+                if (!ranges.empty() && ranges.back().second == first) ranges.back().second = last;
+                else ranges.push_back(std::make_pair(first, last));
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,543 @@
+/*!
+*      \file objparser.h
+*      \brief In-place, chunk-parallel parser for Wavefront .obj files
+*
+*      The file is split at newline boundaries, every chunk is parsed into
+*      thread local arrays, and the chunks are merged in file order with a
+*      prefix sum over the record counts, so the result does not depend on
+*      the number of threads.
+*/
+
+#ifndef _MESHLIB_OBJ_PARSER_H_
+#define _MESHLIB_OBJ_PARSER_H_
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "../Geometry/Point.h"
+#include "../Geometry/Point2.h"
+#include "mmap.h"
+#include "numparse.h"
+#include "parallel.h"
+#include "pipeline.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CObjCorner, indices of one face corner, 0-based, -1 if absent
+     */
+    struct CObjCorner
+    {
+        int v = -1;
+        int t = -1;
+        int n = -1;
+    };
+
+    /*!
+     *  \brief CObjMaterialRun, the faces from `face` on use `material`, an index
+     *  into CObjData::materials, until the next run
+     */
+    struct CObjMaterialRun
+    {
+        int face;
+        int material;
+    };
+
+    /*!
+     *  \brief CObjData, flat arrays of the records of an .obj file
+     *
+     *  Face i owns the corners [face_offsets[i], face_offsets[i+1]). The faces
+     *  before the first material run have no material.
+     */
+    struct CObjData
+    {
+        std::vector<CPoint>     points;
+        std::vector<CPoint2>    uvs;
+        std::vector<CPoint>     normals;
+        std::vector<CObjCorner> corners;
+        std::vector<int>        face_offsets;
+        //! the files of the mtllib records, as written
+        std::vector<std::string>     mtllibs;
+        //! the names of the usemtl records, each once, in the order of their first use
+        std::vector<std::string>     materials;
+        std::vector<CObjMaterialRun> material_runs;
+
+        int  num_faces() const { return face_offsets.empty() ? 0 : (int)face_offsets.size() - 1; }
+        bool with_uv() const { return !uvs.empty(); }
+        bool with_normal() const { return !normals.empty(); }
+
+        /*! the material of every face, -1 for none */
+        void face_materials(std::vector<int> & out) const
+        {
+            out.assign(num_faces(), -1);
+            for (size_t r = 0; r < material_runs.size(); r++)
+            {
+                const int last = r + 1 < material_runs.size() ? material_runs[r + 1].face : num_faces();
+                std::fill(out.begin() + std::min(material_runs[r].face, last), out.begin() + last, material_runs[r].material);
+            }
+        }
+
+        void clear()
+        {
+            points.clear(); uvs.clear(); normals.clear(); corners.clear(); face_offsets.clear();
+            mtllibs.clear(); materials.clear(); material_runs.clear();
+        }
+    };
+
+    /*!
+     *  \brief CObjParser class, numbers are read with the CNumParser scanners
+     */
+    class CObjParser : public CNumParser
+    {
+    public:
+        /*!
+         *  Parse an .obj file
+         *  \param filename input file name
+         *  \param data     output arrays
+         *  \param threads  number of worker threads, 0 uses all hardware threads
+         *  \return false if the file cannot be opened, or the job of the thread was cancelled, see CJob
+         */
+        static bool parse_file(const std::string & filename, CObjData & data, int threads = 0)
+        {
+            CMappedFile file(filename);
+            if (!file.is_open()) return false;
+            parse(file.begin(), file.end(), data, threads);
+            return !job_cancelled();
+        }
+
+        /*!
+         *  Parse an .obj buffer
+         *  \param begin    first byte of the buffer
+         *  \param end      one past the last byte of the buffer
+         *  \param data     output arrays
+         *  \param threads  number of worker threads, 0 uses all hardware threads
+         *  A cancelled job of the calling thread, see CJob, leaves data incomplete
+         */
+        static void parse(const char * begin, const char * end, CObjData & data, int threads = 0)
+        {
+            MESHLIB_TRACE_ZONE("parse obj");
+            data.clear();
+
+            threads = resolve_threads(threads);
+            // do not bother spawning threads for small files
+            size_t size = (size_t)(end - begin);
+            MESHLIB_COUNTER_ADD("meshlib.obj_bytes_parsed", size);
+            threads = (int)std::min<size_t>(threads, std::max<size_t>(1, size / s_min_chunk_size));
+
+            std::vector<const char *> cuts(threads + 1);
+            cuts[0] = begin;
+            cuts[threads] = end;
+            for (int i = 1; i < threads; i++)
+            {
+                const char * p = std::max(cuts[i - 1], begin + size / threads * i);
+                while (p < end && *p != '\n') p++;
+                if (p < end) p++;
+                cuts[i] = p;
+            }
+
+            std::vector<Chunk> chunks(threads);
+            parallel_run(threads, [&](int i)
+            {
+                MESHLIB_TRACE_ZONE("parse obj chunk");
+                _parse_chunk(cuts[i], cuts[i + 1], chunks[i]);
+            });
+
+            // prefix sum over the record counts of the chunks
+            std::vector<size_t> np(threads + 1, 0), nt(threads + 1, 0), nn(threads + 1, 0);
+            std::vector<size_t> nc(threads + 1, 0), nf(threads + 1, 0);
+            for (int i = 0; i < threads; i++)
+            {
+                np[i + 1] = np[i] + chunks[i].data.points.size();
+                nt[i + 1] = nt[i] + chunks[i].data.uvs.size();
+                nn[i + 1] = nn[i] + chunks[i].data.normals.size();
+                nc[i + 1] = nc[i] + chunks[i].data.corners.size();
+                nf[i + 1] = nf[i] + chunks[i].data.face_offsets.size();
+            }
+
+            data.points.resize(np[threads]);
+            data.uvs.resize(nt[threads]);
+            data.normals.resize(nn[threads]);
+            data.corners.resize(nc[threads]);
+            data.face_offsets.resize(nf[threads] + 1);
+            data.face_offsets[nf[threads]] = (int)nc[threads];
+
+            parallel_run(threads, [&](int i)
+            {
+                MESHLIB_TRACE_ZONE("merge obj chunk");
+                CObjData & c = chunks[i].data;
+                std::copy(c.points.begin(), c.points.end(), data.points.begin() + np[i]);
+                std::copy(c.uvs.begin(), c.uvs.end(), data.uvs.begin() + nt[i]);
+                std::copy(c.normals.begin(), c.normals.end(), data.normals.begin() + nn[i]);
+
+                std::copy(c.corners.begin(), c.corners.end(), data.corners.begin() + nc[i]);
+                // relative indices were resolved against the chunk, shift them by the
+                // number of records in the previous chunks
+                for (size_t r : chunks[i].relative)
+                {
+                    CObjCorner & cr = data.corners[nc[i] + r / 3];
+                    switch (r % 3)
+                    {
+                    case 0: cr.v += (int)np[i]; break;
+                    case 1: cr.t += (int)nt[i]; break;
+                    default: cr.n += (int)nn[i]; break;
+                    }
+                }
+                for (size_t k = 0; k < c.face_offsets.size(); k++)
+                {
+                    data.face_offsets[nf[i] + k] = c.face_offsets[k] + (int)nc[i];
+                }
+            });
+
+            if (nf[threads] == 0) data.face_offsets.clear();
+            // few records, merged in file order
+            for (int i = 0; i < threads; i++) _append_materials(chunks[i].data, (int)nf[i], data);
+        }
+
+        /*!
+         *  Parse an .obj buffer front to back in batches of about `batch_size` bytes.
+         *  After every batch `on_batch(data, first_face)` is called, the faces from
+         *  `first_face` on are the new ones. The result equals the one of parse().
+         *  The next batches are parsed on another thread while on_batch runs.
+         *  \param on_batch returns false to stop parsing
+         *  \return false if on_batch stopped the parse, or the job of the thread was cancelled
+         */
+        template<typename Fn>
+        static bool parse_progressive(const char * begin, const char * end, CObjData & data, Fn on_batch,
+            size_t batch_size = s_min_chunk_size)
+        {
+            return _parse_progressive(begin, end, data, on_batch, batch_size, [end](const char *) { return end; });
+        }
+
+        /*!
+         *  Parse a file opened without waiting for its fetch, see CMappedFile::open,
+         *  every batch is parsed as soon as its bytes are there
+         *  \return false if on_batch stopped the parse or the fetch failed
+         */
+        template<typename Fn>
+        static bool parse_progressive(const CMappedFile & file, CObjData & data, Fn on_batch,
+            size_t batch_size = s_min_chunk_size)
+        {
+            const char * begin = file.begin();
+            return _parse_progressive(begin, file.end(), data, on_batch, batch_size, [&file, begin](const char * q)
+            {
+                return begin + file.wait((size_t)(q - begin));
+            });
+        }
+
+        /*!
+         *  The mtllib files of an .obj file without parsing it, those named before
+         *  its first face, where exporters write them
+         *  \return false if the file cannot be opened
+         */
+        static bool scan_mtllibs(const std::string & filename, std::vector<std::string> & mtllibs)
+        {
+            mtllibs.clear();
+            CMappedFile file;
+            if (!file.open(filename, CMappedFile::default_mode(), false)) return false;
+            // the bytes of a fetch or a gzip stream arrive in blocks, only whole lines are read
+            const char * begin = file.begin();
+            size_t at = 0, there = file.wait(1 << 16);
+            while (at < there)
+            {
+                const char * line = begin + at;
+                const char * eol = (const char *)memchr(line, '\n', there - at);
+                if (!eol)
+                {
+                    const size_t more = file.wait(there + (1 << 16));
+                    if (more > there)
+                    {
+                        there = more;
+                        continue;
+                    }
+                    eol = begin + there;
+                }
+                const char * q = line;
+                skip_blank(q, eol);
+                if (q + 1 < eol && q[0] == 'f' && is_blank(q[1])) break;
+                if (_keyword(q, eol, "mtllib")) _names(q, eol, mtllibs);
+                at = (size_t)(eol - begin) + 1;
+            }
+            return true;
+        }
+
+    protected:
+        /*! whether the line at p starts with the keyword, p is moved past it */
+        static bool _keyword(const char * &p, const char * end, const char * keyword)
+        {
+            const size_t n = strlen(keyword);
+            if ((size_t)(end - p) <= n || strncmp(p, keyword, n) != 0 || !is_blank(p[n])) return false;
+            p += n;
+            return true;
+        }
+
+        /*! the rest of the line up to a comment, trimmed */
+        static std::string _rest(const char * p, const char * end)
+        {
+            skip_blank(p, end);
+            const char * e = p;
+            while (e < end && *e != '\n' && *e != '#') e++;
+            while (e > p && is_blank(e[-1])) e--;
+            return std::string(p, e);
+        }
+
+        /*! the file names of an mtllib line, split at blanks as other readers do */
+        static void _names(const char * p, const char * end, std::vector<std::string> & names)
+        {
+            const std::string rest = _rest(p, end);
+            const char * q = rest.data(), * e = q + rest.size();
+            while (q < e)
+            {
+                skip_blank(q, e);
+                const char * b = q;
+                while (q < e && !is_blank(*q)) q++;
+                if (q > b) names.push_back(std::string(b, q));
+            }
+        }
+
+        /*!
+         *  parse_progressive, ready(q) waits for the bytes before q and returns the end of the bytes there.
+         *  The batches are waited for and parsed on a thread of their own, up to s_batches_ahead ahead of
+         *  the calling thread, which appends them and runs on_batch meanwhile.
+         */
+        template<typename Fn, typename Ready>
+        static bool _parse_progressive(const char * begin, const char * end, CObjData & data, Fn on_batch,
+            size_t batch_size, Ready ready)
+        {
+            data.clear();
+            CBoundedQueue<Chunk> parsed(s_batches_ahead);
+            bool arrived = true;
+            CJob * job = CJob::current();
+            std::thread reader([&]
+            {
+                MESHLIB_TRACE_THREAD("obj reader");
+                CJobScope scope(job);
+                const char * p = begin;
+                while (p < end && arrived && !job_cancelled())
+                {
+                    const char * q = p + std::min(batch_size, (size_t)(end - p));
+                    const char * there = ready(q);
+                    if (there < q)
+                    {
+                        arrived = false;
+                        break;
+                    }
+                    // the batch ends with a line, whose end may still be on its way
+                    while (q < end)
+                    {
+                        if (q == there && (there = ready(std::min(q + (1 << 16), end))) == q)
+                        {
+                            arrived = false;
+                            break;
+                        }
+                        if (*q == '\n') break;
+                        q++;
+                    }
+                    if (!arrived) break;
+                    if (q < end) q++;
+
+                    Chunk chunk;
+                    _parse_chunk(p, q, chunk);
+                    MESHLIB_COUNTER_ADD("meshlib.obj_bytes_parsed", q - p);
+                    p = q;
+                    if (!parsed.push(std::move(chunk))) break;
+                }
+                parsed.close();
+            });
+
+            // the batches parsed before the bytes stopped arriving are still handed on
+            bool stopped = false;
+            Chunk chunk;
+            while (!stopped && parsed.pop(chunk))
+            {
+                int first = data.num_faces();
+                _append(chunk, data);
+                stopped = job_cancelled() || !on_batch((const CObjData &)data, first);
+            }
+            if (stopped) parsed.cancel();
+            reader.join();
+            return !stopped && arrived;
+        }
+
+        struct Chunk
+        {
+            CObjData data;
+            /*! corner components (corner * 3 + {v,t,n}) holding relative indices */
+            std::vector<size_t> relative;
+        };
+
+        /*!
+         *  Move the material runs of a chunk, numbered by its own names and its own
+         *  faces, to data, numbered by the names of data and after its first `faces`.
+         *  A run of the material already in use is dropped.
+         */
+        static void _append_materials(const CObjData & c, int faces, CObjData & data)
+        {
+            data.mtllibs.insert(data.mtllibs.end(), c.mtllibs.begin(), c.mtllibs.end());
+            for (const CObjMaterialRun & run : c.material_runs)
+            {
+                const std::string & name = c.materials[run.material];
+                int m = (int)(std::find(data.materials.begin(), data.materials.end(), name) - data.materials.begin());
+                if (m == (int)data.materials.size()) data.materials.push_back(name);
+                // a later run of the same first face replaces the earlier one
+                if (!data.material_runs.empty() && data.material_runs.back().face == run.face + faces) data.material_runs.pop_back();
+                if (!data.material_runs.empty() && data.material_runs.back().material == m) continue;
+                data.material_runs.push_back(CObjMaterialRun{ run.face + faces, m });
+            }
+        }
+
+        //! chunks smaller than this are not worth a thread
+        static const size_t s_min_chunk_size = 1 << 20;
+        //! parsed batches waiting for the caller of parse_progressive
+        static const size_t s_batches_ahead = 2;
+
+        /*!
+         *  Append a parsed chunk to the records read so far
+         */
+        static void _append(Chunk & chunk, CObjData & data)
+        {
+            CObjData & c = chunk.data;
+            size_t np = data.points.size(), nt = data.uvs.size(), nn = data.normals.size();
+            size_t nc = data.corners.size();
+
+            data.points.insert(data.points.end(), c.points.begin(), c.points.end());
+            data.uvs.insert(data.uvs.end(), c.uvs.begin(), c.uvs.end());
+            data.normals.insert(data.normals.end(), c.normals.begin(), c.normals.end());
+            data.corners.insert(data.corners.end(), c.corners.begin(), c.corners.end());
+            _append_materials(c, data.num_faces(), data);
+            for (size_t r : chunk.relative)
+            {
+                CObjCorner & cr = data.corners[nc + r / 3];
+                switch (r % 3)
+                {
+                case 0: cr.v += (int)np; break;
+                case 1: cr.t += (int)nt; break;
+                default: cr.n += (int)nn; break;
+                }
+            }
+
+            if (c.face_offsets.empty()) return;
+            if (!data.face_offsets.empty()) data.face_offsets.pop_back();
+            for (int f : c.face_offsets) data.face_offsets.push_back(f + (int)nc);
+            data.face_offsets.push_back((int)data.corners.size());
+        }
+
+        /*!
+         *  Convert an .obj index read inside a chunk to 0-based. Relative (negative)
+         *  indices are resolved against the records of the chunk, and remembered so
+         *  that the merge can shift them by the records of the previous chunks.
+         */
+        static inline int _local(int id, size_t count, size_t slot, Chunk & chunk)
+        {
+            if (id > 0) return id - 1;
+            if (id == 0) return -1;
+            chunk.relative.push_back(slot);
+            return (int)count + id;
+        }
+
+        static void _parse_chunk(const char * p, const char * end, Chunk & chunk)
+        {
+            CObjData & d = chunk.data;
+
+            size_t lines = 0;
+            while (p < end)
+            {
+                // a cancelled job is seen every few thousand lines
+                if ((++lines & 4095) == 0 && job_cancelled()) break;
+                skip_blank(p, end);
+                if (p >= end) break;
+
+                if (p[0] == 'v' && p + 1 < end && is_blank(p[1]))
+                {
+                    p++;
+                    CPoint pt;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        skip_blank(p, end);
+                        if (!scan_double(p, end, pt[i])) break;
+                    }
+                    d.points.push_back(pt);
+                    skip_line(p, end);
+                    continue;
+                }
+
+                if (p[0] == 'v' && p + 2 < end && p[1] == 't' && is_blank(p[2]))
+                {
+                    p += 2;
+                    CPoint2 uv;
+                    for (int i = 0; i < 2; i++)
+                    {
+                        skip_blank(p, end);
+                        if (!scan_double(p, end, uv[i])) break;
+                    }
+                    d.uvs.push_back(uv);
+                    skip_line(p, end);
+                    continue;
+                }
+
+                if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && is_blank(p[2]))
+                {
+                    p += 2;
+                    CPoint n;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        skip_blank(p, end);
+                        if (!scan_double(p, end, n[i])) break;
+                    }
+                    d.normals.push_back(n);
+                    skip_line(p, end);
+                    continue;
+                }
+
+                if (p[0] == 'f' && p + 1 < end && is_blank(p[1]))
+                {
+                    p++;
+                    size_t first = d.corners.size();
+                    while (true)
+                    {
+                        skip_blank(p, end);
+                        int ids[3] = { 0, 0, 0 };
+                        if (!scan_int(p, end, ids[0])) break;
+                        for (int k = 1; k < 3 && p < end && *p == '/'; k++)
+                        {
+                            p++;
+                            scan_int(p, end, ids[k]);
+                        }
+                        // skip whatever is left of a malformed corner
+                        while (p < end && !is_blank(*p) && *p != '\n') p++;
+
+                        size_t slot = d.corners.size() * 3;
+                        CObjCorner c;
+                        c.v = _local(ids[0], d.points.size(), slot, chunk);
+                        c.t = _local(ids[1], d.uvs.size(), slot + 1, chunk);
+                        c.n = _local(ids[2], d.normals.size(), slot + 2, chunk);
+                        d.corners.push_back(c);
+                    }
+                    skip_line(p, end);
+
+                    if (d.corners.size() > first) d.face_offsets.push_back((int)first);
+                    continue;
+                }
+
+                const char * q = p;
+                if (_keyword(q, end, "usemtl"))
+                {
+                    const std::string name = _rest(q, end);
+                    int m = (int)(std::find(d.materials.begin(), d.materials.end(), name) - d.materials.begin());
+                    if (m == (int)d.materials.size()) d.materials.push_back(name);
+                    d.material_runs.push_back(CObjMaterialRun{ (int)d.face_offsets.size(), m });
+                }
+                else if (_keyword(q, end, "mtllib")) _names(q, end, d.mtllibs);
+
+                // comments, groups etc.
+                skip_line(p, end);
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
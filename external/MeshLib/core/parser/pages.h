@@ -0,0 +1,261 @@
+/*!
+*      \file pages.h
+*      \brief Placement of the large blocks of the mesh arenas and property arrays
+*
+*      On a machine of several sockets a parallel pass over a mesh is slowed
+*      by the threads reading memory of the other socket, and on meshes of
+*      tens of gigabytes by the page walks of 4K pages. The policy here maps
+*      the blocks of at least 2 MB, the slabs of CBlockArena and
+*      CConcurrentPool and the arrays of CProperty, on their own: on huge
+*      pages, explicit ones from the reserved pool or transparent ones, and
+*      either interleaved over the nodes or touched first by the threads of
+*      parallel_for in the ranges it hands out, so that each page lands on
+*      the node of the thread that works on it. Smaller blocks, and all of
+*      them until the application sets the policy, come from the heap as
+*      before. On Windows the blocks are committed through parser/win32.cpp,
+*      huge pages are large pages, which need the lock pages privilege, and
+*      transparent ones are the small pages, there are none.
+*/
+
+#ifndef _MESHLIB_PAGES_H_
+#define _MESHLIB_PAGES_H_
+
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+
+#include "parallel.h"
+#include "counters.h"
+
+#ifdef _WIN32
+#include "win32.h"
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMemoryPolicy class, how the blocks of CPages are mapped
+     */
+    struct CMemoryPolicy
+    {
+        /*! the pages of a block */
+        enum Pages
+        {
+            SMALL_PAGES,        //!< the pages of the system
+            TRANSPARENT_PAGES,  //!< aligned to 2 MB and advised as huge, the kernel merges them
+            HUGE_PAGES          //!< from the reserved huge pages, transparent ones when none are left
+        };
+
+        Pages pages = SMALL_PAGES;
+        /*! spread the pages of a block over the nodes round robin */
+        bool interleave = false;
+        /*! fault the pages in on the threads of parallel_for, each range by the thread that takes it */
+        bool first_touch = false;
+        /*! threads of the first touch, 0 for all */
+        int threads = 0;
+
+        /*! whether any block is mapped */
+        bool mapped() const { return pages != SMALL_PAGES || interleave || first_touch; }
+    };
+
+    /*!
+     *  \brief CPages class, blocks placed by the policy
+     */
+    class CPages
+    {
+    public:
+        /*! the policy of the blocks allocated from now on, the heap unless the application sets it */
+        static CMemoryPolicy & policy()
+        {
+            static CMemoryPolicy p;
+            return p;
+        }
+
+        //! blocks below this many bytes are left to the heap, the size of a huge page
+        static const size_t s_min_bytes = 2 << 20;
+
+        /*!
+         *  A block of bytes, of elements of unit bytes each as far as the first touch goes, the
+         *  ranges of parallel_for over them touch their pages. A caller holding a lock the tasks
+         *  of the pool may take leaves touch off, the thread waiting for the touch runs them
+         */
+        static void * allocate(size_t bytes, size_t unit = 1, bool touch = true)
+        {
+            const CMemoryPolicy p = policy();
+            if (bytes >= s_min_bytes && p.mapped())
+            {
+                size_t length = 0;
+                void * block = _map(bytes, p, length);
+                if (block != NULL)
+                {
+                    if (p.interleave) _interleave(block, length);
+                    if (p.first_touch && touch) _touch(block, bytes, unit, p.threads);
+                    {
+                        std::lock_guard<std::mutex> lock(_mutex());
+                        _blocks()[block] = length;
+                    }
+                    MESHLIB_COUNTER_ADD("pages.mapped_bytes", length);
+                    return block;
+                }
+            }
+            return ::operator new(bytes);
+        }
+
+        /*! give back a block of allocate(bytes) */
+        static void release(void * block, size_t bytes)
+        {
+            if (block == NULL) return;
+            if (bytes >= s_min_bytes)
+            {
+                size_t length = 0;
+                {
+                    std::lock_guard<std::mutex> lock(_mutex());
+                    auto it = _blocks().find(block);
+                    if (it != _blocks().end())
+                    {
+                        length = it->second;
+                        _blocks().erase(it);
+                    }
+                }
+                if (length)
+                {
+#ifdef _WIN32
+                    win32::unmap_pages(block);
+#else
+                    munmap(block, length);
+#endif
+                    return;
+                }
+            }
+            ::operator delete(block);
+        }
+
+    protected:
+        /*! the mapped blocks and their lengths */
+        static std::unordered_map<void *, size_t> & _blocks()
+        {
+            static std::unordered_map<void *, size_t> blocks;
+            return blocks;
+        }
+        static std::mutex & _mutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+#ifdef _WIN32
+        /*! bytes rounded up to pages, large ones for huge, committed over the nodes for interleave */
+        static void * _map(size_t bytes, const CMemoryPolicy & p, size_t & length)
+        {
+            if (p.pages == CMemoryPolicy::HUGE_PAGES)
+            {
+                void * block = win32::map_pages(bytes, true, 0, length);
+                if (block != NULL) return block;
+                MESHLIB_COUNTER_ADD("pages.huge_fallbacks", 1);
+            }
+            return win32::map_pages(bytes, false, p.interleave ? s_min_bytes : 0, length);
+        }
+
+        /*! done by _map, the pages are committed on their nodes */
+        static void _interleave(void *, size_t) {}
+
+        static size_t _page_size() { return win32::page_size(); }
+#else
+        /*! bytes rounded up to huge pages, from the reserved ones or aligned to them */
+        static void * _map(size_t bytes, const CMemoryPolicy & p, size_t & length)
+        {
+            length = (bytes + s_min_bytes - 1) / s_min_bytes * s_min_bytes;
+#ifdef MAP_HUGETLB
+            if (p.pages == CMemoryPolicy::HUGE_PAGES)
+            {
+                void * block = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (block != MAP_FAILED) return block;
+                MESHLIB_COUNTER_ADD("pages.huge_fallbacks", 1);
+            }
+#endif
+            if (p.pages == CMemoryPolicy::SMALL_PAGES)
+            {
+                void * block = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                return block == MAP_FAILED ? NULL : block;
+            }
+
+            // a huge page more, the ends cut off so that the block starts on one
+            char * raw = (char *)mmap(NULL, length + s_min_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == (char *)MAP_FAILED) return NULL;
+            char * block = (char *)(((uintptr_t)raw + s_min_bytes - 1) / s_min_bytes * s_min_bytes);
+            if (block > raw) munmap(raw, block - raw);
+            if (raw + s_min_bytes > block) munmap(block + length, raw + s_min_bytes - block);
+#ifdef MADV_HUGEPAGE
+            madvise(block, length, MADV_HUGEPAGE);
+#endif
+            return block;
+        }
+
+        /*! the pages round robin over every node the process may use, as numactl --interleave=all */
+        static void _interleave(void * block, size_t length)
+        {
+#ifdef SYS_mbind
+            const int interleave = 3;  // MPOL_INTERLEAVE of numaif.h, without linking libnuma
+            unsigned long nodes[16];
+            memset(nodes, 0xff, sizeof(nodes));
+            syscall(SYS_mbind, block, length, interleave, nodes, (unsigned long)(8 * sizeof(nodes)), 0);
+#else
+            (void)block;
+            (void)length;
+#endif
+        }
+
+        static size_t _page_size() { return (size_t)sysconf(_SC_PAGESIZE); }
+#endif
+
+        /*! a byte of every page written in the ranges parallel_for gives the elements by default */
+        static void _touch(void * block, size_t bytes, size_t unit, int threads)
+        {
+            const size_t page = _page_size();
+            char * begin = (char *)block;
+            unit = std::max<size_t>(unit, 1);
+            parallel_for(bytes / unit, threads, [&](size_t b, size_t e)
+            {
+                // the page of the first byte of a range goes with the range that starts in it
+                size_t first = (b * unit + page - 1) / page * page;
+                if (b == 0) first = 0;
+                for (size_t at = first; at < e * unit; at += page) begin[at] = 0;
+            });
+        }
+    };
+
+    /*!
+     *  \brief CPageAllocator class, a std allocator whose large blocks come from CPages
+     */
+    template<typename T>
+    class CPageAllocator
+    {
+    public:
+        typedef T value_type;
+
+        CPageAllocator() {}
+        template<typename U>
+        CPageAllocator(const CPageAllocator<U> &) {}
+
+        T * allocate(size_t n) { return (T *)CPages::allocate(n * sizeof(T), sizeof(T)); }
+        void deallocate(T * p, size_t n) { CPages::release(p, n * sizeof(T)); }
+
+        template<typename U>
+        bool operator==(const CPageAllocator<U> &) const { return true; }
+        template<typename U>
+        bool operator!=(const CPageAllocator<U> &) const { return false; }
+    };
+
+}; //namespace
+
+#endif
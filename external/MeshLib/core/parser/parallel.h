@@ -0,0 +1,533 @@
+/*!
+*      \file parallel.h
+*      \brief Fork-join helpers shared by the parallel readers, writers and mesh algorithms
+*
+*      All helpers run on one work stealing pool, CThreadPool::instance(),
+*      started on first use. A thread waiting for its tasks runs queued tasks
+*      meanwhile, so the helpers may be nested.
+*
+*      The work of a thread can belong to a CJob, set by a CJobScope: its
+*      tasks are queued at the priority of the job, and the workers take the
+*      tasks of what is visible now before those of prefetches and those
+*      before batch work, each level within the threads and the memory the
+*      pool grants it. A cancelled job stops handing out the ranges of
+*      parallel_for, and the loops of the readers and the builders check
+*      job_cancelled() on the way, so a job nobody waits for any more ends
+*      soon instead of holding the workers.
+*/
+
+#ifndef _MESHLIB_PARALLEL_H_
+#define _MESHLIB_PARALLEL_H_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <chrono>
+
+#include "trace.h"
+#include "counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  The number of threads a request of 0 stands for, 0 for all hardware
+     *  threads. Set it before the first parallel call, the shared pool is
+     *  sized by it then.
+     */
+    inline int & default_threads()
+    {
+        static int threads = 0;
+        return threads;
+    }
+
+    /*!
+     *  Number of workers to use
+     *  \param threads requested number, 0 or less uses default_threads()
+     */
+    inline int resolve_threads(int threads)
+    {
+        if (threads > 0) return threads;
+        if (default_threads() > 0) return default_threads();
+        return (int)std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /*! the order the pool runs the tasks of jobs in, see CJob */
+    enum CPriority
+    {
+        PRIORITY_VISIBLE,   //!< what is on screen now, the work outside of any job
+        PRIORITY_PREFETCH,  //!< what the view is likely to need next
+        PRIORITY_BATCH,     //!< offline processing, for whatever the others leave
+        PRIORITY_LEVELS
+    };
+
+    /*!
+     *  \brief CJob class, the priority and the cancellation of a piece of work, shared by the
+     *  tasks it spreads over the pool. It outlives the CJobScope it is run in
+     */
+    class CJob
+    {
+    public:
+        explicit CJob(CPriority priority = PRIORITY_VISIBLE) : m_priority(priority) {}
+
+        CPriority priority() const { return m_priority; }
+        /*! ask the work to stop, from any thread, the loops see it at their next check */
+        void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+        bool cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+        /*! the job the calling thread works for, NULL outside of any */
+        static CJob * current() { return _current(); }
+
+    protected:
+        friend class CJobScope;
+        friend class CThreadPool;
+        static CJob *& _current()
+        {
+            static thread_local CJob * job = NULL;
+            return job;
+        }
+
+        CPriority         m_priority;
+        std::atomic<bool> m_cancelled{ false };
+    };
+
+    /*!
+     *  \brief CJobScope class, the calling thread works for a job while the scope lives,
+     *  the tasks it submits to the pool are queued for the job, nested scopes restore
+     *  the job before them
+     */
+    class CJobScope
+    {
+    public:
+        explicit CJobScope(CJob * job) : m_previous(CJob::_current()) { CJob::_current() = job; }
+        ~CJobScope() { CJob::_current() = m_previous; }
+
+    private:
+        CJobScope(const CJobScope &);
+        CJobScope & operator=(const CJobScope &);
+        CJob * m_previous;
+    };
+
+    /*! whether the job of the calling thread was cancelled, for the loops to stop early */
+    inline bool job_cancelled()
+    {
+        const CJob * job = CJob::current();
+        return job != NULL && job->cancelled();
+    }
+
+    /*!
+     *  \brief CThreadPool class, worker threads with one task deque per priority each
+     *
+     *  A worker takes the tasks of the highest priority that waits and that
+     *  is within its budget of workers, of that its newest task first, and
+     *  steals the oldest task of another worker when its own deque is empty.
+     *  Tasks submitted by other threads are spread over the deques round robin.
+     *  A thread waiting in run() takes any task, its own may be among them.
+     */
+    class CThreadPool
+    {
+    public:
+        /*! the pool shared by the library, one worker less than resolve_threads(0) */
+        static CThreadPool & instance()
+        {
+            static CThreadPool pool(resolve_threads(0) - 1);
+            return pool;
+        }
+
+        explicit CThreadPool(int workers)
+        {
+            m_queues.resize((size_t)std::max(1, workers));
+            for (auto & q : m_queues) q.reset(new CQueue());
+            for (int i = 0; i < workers; i++) m_workers.emplace_back([this, i] { _work(i); });
+        }
+
+        ~CThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            for (std::thread & t : m_workers) t.join();
+        }
+
+        /*! number of worker threads, the threads waiting in run() come on top */
+        int size() const { return (int)m_workers.size(); }
+
+        /*!
+         *  At most this many workers run the tasks of a priority at once, 0 for all of them,
+         *  so that batch work leaves workers free for what is on screen. The threads that
+         *  started the jobs and wait for them are not counted
+         */
+        void set_budget(CPriority priority, int workers)
+        {
+            m_budget[priority].store(std::max(0, workers));
+            m_wake.notify_all();
+        }
+        int budget(CPriority priority) const { return m_budget[priority].load(); }
+
+        /*!
+         *  The jobs of a priority hold at most this many bytes at once, 0 for no limit, see
+         *  CMemoryGrant. A job of a larger size alone is granted it
+         */
+        void set_memory(CPriority priority, size_t bytes)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_memory_mutex);
+                m_memory[priority] = bytes;
+            }
+            m_memory_freed.notify_all();
+        }
+
+        /*!
+         *  Wait until the jobs of the priority of the calling thread may hold bytes more, then
+         *  count them, or until its job is cancelled. A thread that holds bytes already, a task
+         *  it took while it waits in run() for instance, is granted more at once, it would wait
+         *  for itself otherwise
+         *  \return false if the job was cancelled first, nothing is counted then
+         */
+        bool acquire_memory(size_t bytes)
+        {
+            const CPriority p = _priority(CJob::current());
+            std::unique_lock<std::mutex> lock(m_memory_mutex);
+            while (_holding() == 0 && m_memory[p] > 0 && m_held[p] > 0 && m_held[p] + bytes > m_memory[p])
+            {
+                if (job_cancelled()) return false;
+                // a cancel does not notify, it is seen within a wait
+                m_memory_freed.wait_for(lock, std::chrono::milliseconds(20));
+            }
+            m_held[p] += bytes;
+            _holding() += bytes;
+            return true;
+        }
+        /*! give back bytes acquire_memory counted, on the thread and for the priority it counted them at */
+        void release_memory(CPriority priority, size_t bytes)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_memory_mutex);
+                m_held[priority] -= std::min(bytes, m_held[priority]);
+            }
+            _holding() -= std::min(bytes, _holding());
+            m_memory_freed.notify_all();
+        }
+
+        /*!
+         *  Run fn(0), ..., fn(n - 1) and wait for all of them. The calling
+         *  thread runs fn(0) and then helps with queued tasks.
+         */
+        template<typename Fn>
+        void run(int n, Fn & fn)
+        {
+            if (n <= 1 || m_workers.empty())
+            {
+                for (int i = 0; i < n; i++) fn(i);
+                return;
+            }
+
+            std::atomic<int> pending(n - 1);
+            CJob * job = CJob::current();
+            for (int i = 1; i < n; i++) _push(CTask{ &_call<Fn>, &fn, i, &pending, job });
+            fn(0);
+            while (pending.load(std::memory_order_acquire) > 0)
+            {
+                CTask task;
+                int level;
+                if (_pop(_self(), task, false, level)) _execute(task);
+                else std::this_thread::yield();
+            }
+        }
+
+    protected:
+        struct CTask
+        {
+            void (*call)(void *, int);
+            void * fn;
+            int    index;
+            std::atomic<int> * pending;
+            //! the job of the thread that submitted it, the worker works for it meanwhile
+            CJob * job;
+        };
+
+        struct CQueue
+        {
+            std::mutex        mutex;
+            std::deque<CTask> tasks[PRIORITY_LEVELS];
+        };
+
+        template<typename Fn>
+        static void _call(void * fn, int i) { (*(Fn *)fn)(i); }
+
+        static CPriority _priority(const CJob * job) { return job ? job->priority() : PRIORITY_VISIBLE; }
+
+        static void _execute(CTask & task)
+        {
+            CJobScope scope(task.job);
+            task.call(task.fn, task.index);
+            task.pending->fetch_sub(1, std::memory_order_release);
+        }
+
+        /*! deque index of the calling thread, -1 outside of this pool */
+        int _self() const { return _current().pool == this ? _current().worker : -1; }
+
+        /*! the pool and deque of the calling thread */
+        struct CCurrent
+        {
+            const CThreadPool * pool;
+            int                 worker;
+        };
+        static CCurrent & _current()
+        {
+            static thread_local CCurrent current = { NULL, -1 };
+            return current;
+        }
+
+        /*! the bytes of acquire_memory the calling thread holds, of any pool */
+        static size_t & _holding()
+        {
+            static thread_local size_t bytes = 0;
+            return bytes;
+        }
+
+        void _push(const CTask & task)
+        {
+            int self = _self();
+            size_t q = self >= 0 ? (size_t)self : m_next++ % m_queues.size();
+            const CPriority p = _priority(task.job);
+            {
+                std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+                m_queues[q]->tasks[p].push_back(task);
+            }
+            m_waiting[p].fetch_add(1);
+            m_queued.fetch_add(1);
+            {
+                std::lock_guard<std::mutex> lock(m_sleep);
+            }
+            m_wake.notify_one();
+        }
+
+        /*!
+         *  A task of the highest priority waiting, own newest task, else the oldest task of another
+         *  deque. A budgeted worker takes a level only within its budget, the worker then holds
+         *  one of its places until it is done with the task, level tells which
+         */
+        bool _pop(int self, CTask & task, bool budgeted, int & level)
+        {
+            if (m_queued.load() == 0) return false;
+            const size_t n = m_queues.size();
+            size_t first = self >= 0 ? (size_t)self : 0;
+            for (int p = 0; p < PRIORITY_LEVELS; p++)
+            {
+                if (m_waiting[p].load() == 0) continue;
+                const int budget = m_budget[p].load();
+                const bool limited = budgeted && budget > 0;
+                if (limited && m_running[p].fetch_add(1) >= budget)
+                {
+                    m_running[p].fetch_sub(1);
+                    continue;
+                }
+                for (size_t k = 0; k < n; k++)
+                {
+                    CQueue & q = *m_queues[(first + k) % n];
+                    std::lock_guard<std::mutex> lock(q.mutex);
+                    std::deque<CTask> & tasks = q.tasks[p];
+                    if (tasks.empty()) continue;
+                    if (k == 0 && self >= 0)
+                    {
+                        task = tasks.back();
+                        tasks.pop_back();
+                    }
+                    else
+                    {
+                        task = tasks.front();
+                        tasks.pop_front();
+                    }
+                    m_waiting[p].fetch_sub(1);
+                    m_queued.fetch_sub(1);
+                    level = limited ? p : -1;
+                    return true;
+                }
+                if (limited) m_running[p].fetch_sub(1);
+            }
+            return false;
+        }
+
+        /*! whether a task waits that a worker may take within the budgets */
+        bool _ready() const
+        {
+            for (int p = 0; p < PRIORITY_LEVELS; p++)
+            {
+                const int budget = m_budget[p].load();
+                if (m_waiting[p].load() > 0 && (budget == 0 || m_running[p].load() < budget)) return true;
+            }
+            return false;
+        }
+
+        void _work(int i)
+        {
+            _current().pool = this;
+            _current().worker = i;
+            MESHLIB_TRACE_THREAD("worker " + std::to_string(i));
+            for (;;)
+            {
+                CTask task;
+                int level;
+                if (_pop(i, task, true, level))
+                {
+                    _execute(task);
+                    if (level < 0) continue;
+                    // a place of the budget is free, for a worker that left a task of the level waiting
+                    m_running[level].fetch_sub(1);
+                    {
+                        std::lock_guard<std::mutex> lock(m_sleep);
+                    }
+                    m_wake.notify_one();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(m_sleep);
+                m_wake.wait(lock, [this] { return m_stop || _ready(); });
+                if (m_stop) return;
+            }
+        }
+
+        std::vector<std::unique_ptr<CQueue>> m_queues;
+        std::vector<std::thread>             m_workers;
+        std::atomic<size_t>                  m_queued{ 0 };
+        //! the tasks queued, the workers running them within a budget and the budgets, by priority
+        std::atomic<size_t>                  m_waiting[PRIORITY_LEVELS] = {};
+        std::atomic<int>                     m_running[PRIORITY_LEVELS] = {};
+        std::atomic<int>                     m_budget[PRIORITY_LEVELS] = {};
+        //! the bytes the jobs of every priority hold and may hold, see acquire_memory
+        std::mutex                           m_memory_mutex;
+        std::condition_variable              m_memory_freed;
+        size_t                               m_held[PRIORITY_LEVELS] = {};
+        size_t                               m_memory[PRIORITY_LEVELS] = {};
+        std::atomic<size_t>                  m_next{ 0 };
+        std::mutex                           m_sleep;
+        std::condition_variable              m_wake;
+        bool                                 m_stop = false;
+    };
+
+    /*!
+     *  \brief CMemoryGrant class, bytes of the memory budget of the priority of the calling
+     *  thread, see CThreadPool::set_memory, held while it lives. It waits for them as it is
+     *  made, granted() is false if the job was cancelled meanwhile
+     */
+    class CMemoryGrant
+    {
+    public:
+        explicit CMemoryGrant(size_t bytes)
+            : m_priority(CJob::current() ? CJob::current()->priority() : PRIORITY_VISIBLE), m_bytes(bytes)
+        {
+            m_granted = CThreadPool::instance().acquire_memory(bytes);
+        }
+        ~CMemoryGrant()
+        {
+            if (m_granted) CThreadPool::instance().release_memory(m_priority, m_bytes);
+        }
+        bool granted() const { return m_granted; }
+
+    private:
+        CMemoryGrant(const CMemoryGrant &);
+        CMemoryGrant & operator=(const CMemoryGrant &);
+        CPriority m_priority;
+        size_t    m_bytes;
+        bool      m_granted;
+    };
+
+    /*!
+     *  Run fn(0), ..., fn(threads - 1) on the shared pool and wait for all of
+     *  them, the calling thread runs fn(0). The calls may run one after the
+     *  other, they must not wait for each other.
+     */
+    template<typename Fn>
+    inline void parallel_run(int threads, Fn fn)
+    {
+        CThreadPool::instance().run(threads, fn);
+    }
+
+    /*!
+     *  Number of workers for n items, ranges smaller than `grain` are not worth a thread
+     */
+    inline int resolve_threads(int threads, size_t n, size_t grain)
+    {
+        return (int)std::min<size_t>(resolve_threads(threads), std::max<size_t>(1, n / std::max<size_t>(1, grain)));
+    }
+
+    /*!
+     *  Split [0, n) into ranges of about `grain` items and run fn(begin, end)
+     *  on each, at most `threads` ranges at a time. Workers take the next range
+     *  when they are done, so uneven ranges balance out. No range starts once the
+     *  job of the calling thread is cancelled, the result is incomplete then.
+     */
+    template<typename Fn>
+    inline void parallel_for(size_t n, int threads, Fn fn, size_t grain = 1 << 14)
+    {
+        if (n == 0) return;
+        grain = std::max<size_t>(1, grain);
+        const size_t chunks = std::max<size_t>(1, n / grain);
+        threads = resolve_threads(threads, n, grain);
+        std::atomic<size_t> next(0);
+        parallel_run(threads, [&](int)
+        {
+            for (size_t c = next++; c < chunks && !job_cancelled(); c = next++) fn(n * c / chunks, n * (c + 1) / chunks);
+        });
+    }
+
+    /*!
+     *  Reduce [0, n) in parallel. fn(begin, end, acc) folds a range into acc,
+     *  which starts as `identity`, combine(a, b) joins two partial results.
+     *  The ranges only depend on n and grain and are joined in order, so a
+     *  floating point result does not change with the number of threads.
+     */
+    template<typename T, typename Fn, typename Combine>
+    inline T parallel_reduce(size_t n, int threads, const T & identity, Fn fn, Combine combine, size_t grain = 1 << 14)
+    {
+        grain = std::max<size_t>(1, grain);
+        const size_t chunks = std::max<size_t>(1, n / grain);
+        std::vector<T> partial(chunks, identity);
+        parallel_for(chunks, threads, [&](size_t b, size_t e)
+        {
+            for (size_t c = b; c < e; c++) fn(n * c / chunks, n * (c + 1) / chunks, partial[c]);
+        }, 1);
+        T result = identity;
+        for (const T & p : partial) result = combine(result, p);
+        return result;
+    }
+
+    /*!
+     *  Sort [first, last) by less in parallel: a run per thread is sorted on the
+     *  pool, then neighbouring runs are merged, the pairs of a round in parallel
+     */
+    template<typename It, typename Less>
+    inline void parallel_sort(It first, It last, int threads, Less less, size_t grain = 1 << 16)
+    {
+        const size_t n = (size_t)(last - first);
+        const int runs = resolve_threads(threads, n, grain);
+        if (runs <= 1)
+        {
+            std::sort(first, last, less);
+            return;
+        }
+        std::vector<size_t> bounds(runs + 1);
+        for (int i = 0; i <= runs; i++) bounds[i] = n * i / runs;
+        parallel_run(runs, [&](int i) { std::sort(first + bounds[i], first + bounds[i + 1], less); });
+        for (int width = 1; width < runs; width *= 2)
+        {
+            parallel_run((runs + 2 * width - 1) / (2 * width), [&](int pair)
+            {
+                const int lo = 2 * width * pair;
+                const int mid = std::min(lo + width, runs), hi = std::min(lo + 2 * width, runs);
+                if (mid < hi) std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi], less);
+            });
+        }
+    }
+
+}; //namespace
+
+#endif
@@ -12,7 +12,12 @@
 #include <string>
 #include <assert.h>
 #include <list>
+#include <vector>
 #include <sstream>
+#include <cstring>
+
+#include "numparse.h"
+#include "writer.h"
 
 namespace MeshLib
 {
@@ -168,6 +173,7 @@ namespace MeshLib
                 CToken * token = *iter;
                 if (token->key() == key)
                 {
+                    delete token;
                     m_tokens.erase(iter);
                     return;
                 }
@@ -223,5 +229,225 @@ namespace MeshLib
     };
 
 
+    /*!
+     *  \brief CTraitToken class, one key=(value) of a trait string, as pointers into it
+     *
+     *  The value is the text between the parentheses, or the word after '=',
+     *  a flag such as `sharp` has none.
+     */
+    class CTraitToken
+    {
+    public:
+        const char * begin = NULL;      //!< first character of the key
+        const char * key_end = NULL;    //!< past the key
+        const char * value = NULL;      //!< first character of the value, NULL for a flag
+        const char * value_end = NULL;  //!< past the value
+        const char * end = NULL;        //!< past the token, its ')' included
+
+        bool has_value() const { return value != NULL; }
+        /*! whether the key of the token is `key` */
+        bool is(const char * key) const
+        {
+            const size_t n = strlen(key);
+            return (size_t)(key_end - begin) == n && memcmp(begin, key, n) == 0;
+        }
+        std::string key() const { return std::string(begin, key_end); }
+
+        /*! the first n numbers of the value, false if there are fewer */
+        bool numbers(double * v, int n) const
+        {
+            if (value == NULL) return false;
+            const char * p = value;
+            for (int i = 0; i < n; i++)
+            {
+                CNumParser::skip_blank(p, value_end);
+                if (!CNumParser::scan_double(p, value_end, v[i])) return false;
+            }
+            return true;
+        }
+        /*! the value as an integer */
+        bool number(int & v) const
+        {
+            if (value == NULL) return false;
+            const char * p = value;
+            CNumParser::skip_blank(p, value_end);
+            return CNumParser::scan_int(p, value_end, v);
+        }
+    };
+
+    /*!
+     *  \brief CTraitParser class, reads the tokens of a trait string where they are
+     *
+     *  Nothing is copied or allocated, the string has to outlive the parser.
+     *  Lookups scan the string from its start, a trait string has a few tokens.
+     */
+    class CTraitParser
+    {
+    public:
+        CTraitParser(const std::string & str) : m_begin(str.data()), m_end(str.data() + str.size()), m_pt(m_begin) {}
+        CTraitParser(const char * b, const char * e) : m_begin(b), m_end(e), m_pt(b) {}
+
+        /*! the next token, false past the last one */
+        bool next(CTraitToken & token)
+        {
+            const char * p = m_pt;
+            while (p < m_end && CNumParser::is_blank(*p)) p++;
+            if (p >= m_end) return false;
+
+            token.begin = p;
+            while (p < m_end && *p != '=' && !CNumParser::is_blank(*p)) p++;
+            token.key_end = p;
+            token.value = token.value_end = NULL;
+            if (p < m_end && *p == '=')
+            {
+                p++;
+                if (p < m_end && *p == '(')
+                {
+                    const char * q = (const char *)memchr(p, ')', (size_t)(m_end - p));
+                    token.value = p + 1;
+                    token.value_end = q ? q : m_end;
+                    p = q ? q + 1 : m_end;
+                }
+                else
+                {
+                    token.value = p;
+                    while (p < m_end && !CNumParser::is_blank(*p)) p++;
+                    token.value_end = p;
+                }
+            }
+            token.end = p;
+            m_pt = p;
+            return true;
+        }
+
+        /*! the first token named key */
+        bool find(const char * key, CTraitToken & token) const
+        {
+            CTraitParser parser(m_begin, m_end);
+            while (parser.next(token))
+            {
+                if (token.is(key)) return true;
+            }
+            return false;
+        }
+        /*! whether a token is named key, a flag or not */
+        bool has(const char * key) const
+        {
+            CTraitToken token;
+            return find(key, token);
+        }
+
+        /*! the first n numbers of the value of key, false if there are fewer */
+        bool get(const char * key, double * v, int n) const
+        {
+            CTraitToken token;
+            return find(key, token) && token.numbers(v, n);
+        }
+        bool get(const char * key, double & v) const { return get(key, &v, 1); }
+        bool get(const char * key, CPoint & v) const { return get(key, &v[0], 3); }
+        bool get(const char * key, CPoint2 & v) const { return get(key, &v[0], 2); }
+        bool get(const char * key, int & v) const
+        {
+            CTraitToken token;
+            return find(key, token) && token.number(v);
+        }
+
+    protected:
+        const char * m_begin;
+        const char * m_end;
+        /*! where next() goes on */
+        const char * m_pt;
+    };
+
+    /*!
+     *  \brief CTraitWriter class, rebuilds trait strings in a buffer that is reused
+     *
+     *  One writer serves all the elements of a mesh, e.g.
+     *
+     *      writer.reset(v->string(), "uv").add("uv", v->uv()).assign(v->string());
+     *
+     *  Numbers are written as std::ostream writes them, see CFormatBuffer.
+     */
+    class CTraitWriter
+    {
+    public:
+        /*! start over with the tokens of str, but the one named drop if given */
+        CTraitWriter & reset(const std::string & str, const char * drop = NULL)
+        {
+            return reset_if(str, [drop](const CTraitToken & token) { return drop != NULL && token.is(drop); });
+        }
+        /*! start over with the tokens of str for which drop(token) is false */
+        template<typename Pred>
+        CTraitWriter & reset_if(const std::string & str, Pred drop)
+        {
+            m_buffer.clear();
+            CTraitParser parser(str);
+            CTraitToken token;
+            while (parser.next(token))
+            {
+                if (drop(token)) continue;
+                _separate();
+                m_buffer.append(token.begin, token.end);
+            }
+            return *this;
+        }
+
+        /*! a token without a value */
+        CTraitWriter & flag(const char * key)
+        {
+            _separate();
+            m_buffer << key;
+            return *this;
+        }
+        /*! key=(v[0] ... v[n - 1]) */
+        CTraitWriter & add(const char * key, const double * v, int n)
+        {
+            _separate();
+            m_buffer << key << "=(";
+            for (int i = 0; i < n; i++)
+            {
+                if (i > 0) m_buffer << ' ';
+                m_buffer << v[i];
+            }
+            m_buffer << ')';
+            return *this;
+        }
+        CTraitWriter & add(const char * key, double v) { return add(key, &v, 1); }
+        CTraitWriter & add(const char * key, const CPoint & v)
+        {
+            const double c[3] = { v[0], v[1], v[2] };
+            return add(key, c, 3);
+        }
+        CTraitWriter & add(const char * key, const CPoint2 & v)
+        {
+            const double c[2] = { v[0], v[1] };
+            return add(key, c, 2);
+        }
+        CTraitWriter & add(const char * key, int v)
+        {
+            _separate();
+            m_buffer << key << "=(" << v << ')';
+            return *this;
+        }
+
+        /*! start a token, the caller formats it into the buffer returned */
+        CFormatBuffer & token()
+        {
+            _separate();
+            return m_buffer;
+        }
+
+        /*! copy the string to out, whose capacity is reused */
+        void assign(std::string & out) const { out.assign(m_buffer.data(), m_buffer.size()); }
+        const char * data() const { return m_buffer.data(); }
+        size_t size() const { return m_buffer.size(); }
+
+    protected:
+        CFormatBuffer m_buffer;
+
+        void _separate() { if (m_buffer.size() > 0) m_buffer << ' '; }
+    };
+
+
 }; //namespace
 #endif
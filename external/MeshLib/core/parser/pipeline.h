@@ -0,0 +1,120 @@
+/*!
+*      \file pipeline.h
+*      \brief Bounded queues between the stages of a streaming pipeline
+*
+*      A loader reads bytes, parses them, builds from what was parsed and
+*      hands it on, and each of these steps only needs the output of the one
+*      before it. Run as stages on their own threads, joined by queues, the
+*      steps overlap: the next bytes are read and parsed while the last ones
+*      are appended and shown. A queue holds a few items, so a fast stage
+*      waits for a slow one instead of running ahead with all of the memory.
+*      Either side may stop the pipeline: the producer closes the queue when
+*      it is done, the consumer cancels it when it no longer wants items, and
+*      both wake up whoever waits on the other side.
+*/
+
+#ifndef _MESHLIB_PIPELINE_H_
+#define _MESHLIB_PIPELINE_H_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+
+#include "counters.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CBoundedQueue class, items passed from one stage to the next, at most capacity() at a time
+     *  \tparam T the item, moved through the queue
+     */
+    template<typename T>
+    class CBoundedQueue
+    {
+    public:
+        explicit CBoundedQueue(size_t capacity) : m_capacity(std::max<size_t>(1, capacity)) {}
+
+        size_t capacity() const { return m_capacity; }
+
+        /*!
+         *  Hand item to the consumer, waiting while the queue is full
+         *  \return false if the queue was cancelled, item is dropped then
+         */
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_items.size() >= m_capacity && !m_cancelled) MESHLIB_COUNTER_ADD("pipeline.producer_waits", 1);
+            m_space.wait(lock, [this] { return m_cancelled || m_items.size() < m_capacity; });
+            if (m_cancelled || m_closed) return false;
+            m_items.push_back(std::move(item));
+            m_ready.notify_one();
+            return true;
+        }
+
+        /*!
+         *  The oldest item, waiting while the queue is empty
+         *  \return false once the queue is closed and empty, or cancelled
+         */
+        bool pop(T & item)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_items.empty() && !m_closed && !m_cancelled) MESHLIB_COUNTER_ADD("pipeline.consumer_waits", 1);
+            m_ready.wait(lock, [this] { return m_cancelled || m_closed || !m_items.empty(); });
+            if (m_cancelled || m_items.empty()) return false;
+            item = std::move(m_items.front());
+            m_items.pop_front();
+            m_space.notify_one();
+            return true;
+        }
+
+        /*! the oldest item if there is one, for a consumer that must not wait, a frame loop say */
+        bool try_pop(T & item)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_cancelled || m_items.empty()) return false;
+            item = std::move(m_items.front());
+            m_items.pop_front();
+            m_space.notify_one();
+            return true;
+        }
+
+        /*! no more items, the consumer takes those still queued */
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            m_ready.notify_all();
+        }
+
+        /*! stop both sides, the queued items are dropped */
+        void cancel()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cancelled = true;
+            m_items.clear();
+            m_space.notify_all();
+            m_ready.notify_all();
+        }
+
+        bool cancelled() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_cancelled;
+        }
+
+    protected:
+        const size_t            m_capacity;
+        mutable std::mutex      m_mutex;
+        std::condition_variable m_space, m_ready;
+        std::deque<T>           m_items;
+        bool                    m_closed = false;
+        bool                    m_cancelled = false;
+    };
+
+}; //namespace
+
+#endif
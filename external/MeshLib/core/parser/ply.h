@@ -0,0 +1,478 @@
+/*!
+*      \file ply.h
+*      \brief Stanford polygon files (.ply)
+*
+*      The header names the elements, their row counts and typed properties,
+*      the rows follow as text or as little or big endian binary:
+*
+*          ply
+*          format binary_little_endian 1.0
+*          element vertex 8
+*          property float x
+*          ...
+*          element face 6
+*          property list uchar int vertex_indices
+*          end_header
+*
+*      CPlyFile maps the file and reads columns straight from the rows. The
+*      rows of a binary element without lists are found by their stride, the
+*      others by one scan when the file is opened, then columns are converted
+*      in parallel.
+*/
+
+#ifndef _MESHLIB_PLY_H_
+#define _MESHLIB_PLY_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+#include "mmap.h"
+#include "numparse.h"
+#include "parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CPlyProperty, a column of an element, a list if count_type is set
+     */
+    struct CPlyProperty
+    {
+        enum Type { NONE, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+        std::string name;
+        Type type = NONE;
+        Type count_type = NONE;
+
+        bool is_list() const { return count_type != NONE; }
+
+        static size_t size(Type t)
+        {
+            static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+            return sizes[t];
+        }
+        /*! the type of a header name, both spellings of the spec */
+        static Type type_of(const std::string & s)
+        {
+            if (s == "char" || s == "int8") return INT8;
+            if (s == "uchar" || s == "uint8") return UINT8;
+            if (s == "short" || s == "int16") return INT16;
+            if (s == "ushort" || s == "uint16") return UINT16;
+            if (s == "int" || s == "int32") return INT32;
+            if (s == "uint" || s == "uint32") return UINT32;
+            if (s == "float" || s == "float32") return FLOAT32;
+            if (s == "double" || s == "float64") return FLOAT64;
+            return NONE;
+        }
+    };
+
+    /*!
+     *  \brief CPlyElement, an element of the header and where its rows are
+     */
+    struct CPlyElement
+    {
+        std::string name;
+        size_t count = 0;
+        std::vector<CPlyProperty> properties;
+        /*! bytes per row of a binary element without lists, 0 otherwise */
+        size_t stride = 0;
+        /*! the first row */
+        const char * begin = NULL;
+        /*! the start of every row, if the rows are not found by their stride */
+        std::vector<const char *> rows;
+
+        /*! the index of the property, -1 if there is none */
+        int find(const char * name) const
+        {
+            for (size_t i = 0; i < properties.size(); i++) if (properties[i].name == name) return (int)i;
+            return -1;
+        }
+    };
+
+    /*!
+     *  \brief CPlyFile class, a mapped .ply file
+     */
+    class CPlyFile
+    {
+    public:
+        enum Format { ASCII, BINARY_LE, BINARY_BE };
+
+        CPlyFile() {}
+        CPlyFile(const std::string & filename) { open(filename); }
+
+        /*!
+         *  Map the file, parse the header and locate the rows
+         *  \return false if the file is missing or damaged
+         */
+        bool open(const std::string & filename);
+        void close() { m_file.close(); m_elements.clear(); m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        Format format() const { return m_format; }
+        const std::vector<CPlyElement> & elements() const { return m_elements; }
+        /*! the element of that name, NULL if there is none */
+        const CPlyElement * element(const char * name) const
+        {
+            for (const CPlyElement & e : m_elements) if (e.name == name) return &e;
+            return NULL;
+        }
+
+        /*!
+         *  Read scalar columns of an element, row i gives out[i * n + k] from property props[k]
+         *  \return false if a property is missing or a list, or a text row is short
+         */
+        template<typename T>
+        bool read(const CPlyElement & e, const int * props, int n, T * out, int threads = 0) const;
+        /*!
+         *  Read a list column of an element, row i gives values[offsets[i], offsets[i+1])
+         *  \return false if the property is not a list or a text row is short
+         */
+        template<typename T>
+        bool read_lists(const CPlyElement & e, int prop, std::vector<T> & values, std::vector<int> & offsets, int threads = 0) const;
+
+    protected:
+        /*! the value at p of type t, advancing p past it */
+        double _binary(const char * &p, CPlyProperty::Type t) const
+        {
+            char b[8];
+            const size_t n = CPlyProperty::size(t);
+            if (m_swap) for (size_t i = 0; i < n; i++) b[i] = p[n - 1 - i];
+            else memcpy(b, p, n);
+            p += n;
+            switch (t)
+            {
+            case CPlyProperty::INT8:    { int8_t v; memcpy(&v, b, 1); return v; }
+            case CPlyProperty::UINT8:   { uint8_t v; memcpy(&v, b, 1); return v; }
+            case CPlyProperty::INT16:   { int16_t v; memcpy(&v, b, 2); return v; }
+            case CPlyProperty::UINT16:  { uint16_t v; memcpy(&v, b, 2); return v; }
+            case CPlyProperty::INT32:   { int32_t v; memcpy(&v, b, 4); return v; }
+            case CPlyProperty::UINT32:  { uint32_t v; memcpy(&v, b, 4); return v; }
+            case CPlyProperty::FLOAT32: { float v; memcpy(&v, b, 4); return v; }
+            case CPlyProperty::FLOAT64: { double v; memcpy(&v, b, 8); return v; }
+            default: return 0;
+            }
+        }
+        /*! the next value of a text row, false at its end */
+        static bool _text(const char * &p, const char * end, double & v)
+        {
+            CNumParser::skip_blank(p, end);
+            return CNumParser::scan_double(p, end, v);
+        }
+        /*! the end of the row at p, for binary rows the end of the mapping must be checked by the caller */
+        const char * _row_end(const char * p, const CPlyElement & e) const
+        {
+            if (m_format == ASCII)
+            {
+                const char * q = (const char *)memchr(p, '\n', (size_t)(m_file.end() - p));
+                return q ? q + 1 : m_file.end();
+            }
+            for (const CPlyProperty & prop : e.properties)
+            {
+                if (!prop.is_list())
+                {
+                    p += CPlyProperty::size(prop.type);
+                    continue;
+                }
+                if (m_file.end() - p < (ptrdiff_t)CPlyProperty::size(prop.count_type)) return NULL;
+                const double count = _binary(p, prop.count_type);
+                if (count < 0 || (double)(m_file.end() - p) < count * CPlyProperty::size(prop.type)) return NULL;
+                p += (size_t)count * CPlyProperty::size(prop.type);
+            }
+            return p;
+        }
+        const char * _row(const CPlyElement & e, size_t i) const { return e.stride ? e.begin + i * e.stride : e.rows[i]; }
+
+        CMappedFile              m_file;
+        Format                   m_format = ASCII;
+        bool                     m_swap = false;
+        std::vector<CPlyElement> m_elements;
+        bool                     m_ok = false;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    inline bool CPlyFile::open(const std::string & filename)
+    {
+        close();
+        if (!m_file.open(filename)) return false;
+        const char * p = m_file.begin();
+        const char * end = m_file.end();
+        if (m_file.size() < 4 || memcmp(p, "ply", 3) != 0) { close(); return false; }
+
+        // the header, a line at a time
+        bool header = false;
+        while (p < end && !header)
+        {
+            const char * q = (const char *)memchr(p, '\n', (size_t)(end - p));
+            if (q == NULL) break;
+            std::vector<std::string> words;
+            for (const char * w = p; w < q;)
+            {
+                while (w < q && (CNumParser::is_blank(*w))) w++;
+                const char * s = w;
+                while (w < q && !CNumParser::is_blank(*w)) w++;
+                if (w > s) words.push_back(std::string(s, w));
+            }
+            p = q + 1;
+            if (words.empty()) continue;
+            if (words[0] == "format" && words.size() > 1)
+            {
+                if (words[1] == "ascii") m_format = ASCII;
+                else if (words[1] == "binary_little_endian") m_format = BINARY_LE;
+                else if (words[1] == "binary_big_endian") m_format = BINARY_BE;
+                else { close(); return false; }
+            }
+            else if (words[0] == "element" && words.size() > 2)
+            {
+                CPlyElement e;
+                e.name = words[1];
+                e.count = (size_t)strtoull(words[2].c_str(), NULL, 10);
+                m_elements.push_back(e);
+            }
+            else if (words[0] == "property" && words.size() > 2 && !m_elements.empty())
+            {
+                CPlyProperty prop;
+                if (words[1] == "list" && words.size() > 4)
+                {
+                    prop.count_type = CPlyProperty::type_of(words[2]);
+                    prop.type = CPlyProperty::type_of(words[3]);
+                    prop.name = words[4];
+                    if (prop.count_type == CPlyProperty::NONE) { close(); return false; }
+                }
+                else
+                {
+                    prop.type = CPlyProperty::type_of(words[1]);
+                    prop.name = words[2];
+                }
+                if (prop.type == CPlyProperty::NONE) { close(); return false; }
+                m_elements.back().properties.push_back(prop);
+            }
+            else if (words[0] == "end_header") header = true;
+        }
+        if (!header) { close(); return false; }
+
+        const uint16_t one = 1;
+        const bool little = *(const char *)&one == 1;
+        m_swap = m_format != ASCII && (m_format == BINARY_LE) != little;
+
+        // the rows, an element starts where the one before ends
+        for (CPlyElement & e : m_elements)
+        {
+            e.begin = p;
+            bool fixed = m_format != ASCII;
+            size_t stride = 0;
+            for (const CPlyProperty & prop : e.properties)
+            {
+                fixed = fixed && !prop.is_list();
+                stride += CPlyProperty::size(prop.type);
+            }
+            if (fixed)
+            {
+                if (stride && (size_t)(end - p) / stride < e.count) { close(); return false; }
+                e.stride = stride;
+                p += e.count * stride;
+                continue;
+            }
+            e.rows.resize(e.count);
+            for (size_t i = 0; i < e.count; i++)
+            {
+                if (m_format == ASCII) while (p < end && (*p == '\n' || CNumParser::is_blank(*p))) p++;
+                if (p >= end && !e.properties.empty()) { close(); return false; }
+                e.rows[i] = p;
+                p = _row_end(p, e);
+                if (p == NULL) { close(); return false; }
+            }
+        }
+        m_ok = true;
+        return true;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename T>
+    inline bool CPlyFile::read(const CPlyElement & e, const int * props, int n, T * out, int threads) const
+    {
+        for (int k = 0; k < n; k++)
+        {
+            if (props[k] < 0 || props[k] >= (int)e.properties.size() || e.properties[props[k]].is_list()) return false;
+        }
+        // the position of every property in a binary row without lists
+        std::vector<size_t> offsets(e.properties.size() + 1, 0);
+        for (size_t j = 0; j < e.properties.size(); j++) offsets[j + 1] = offsets[j] + CPlyProperty::size(e.properties[j].type);
+
+        std::atomic<bool> failed(false);
+        parallel_for(e.count, threads, [&](size_t b, size_t end)
+        {
+            std::vector<double> row(e.properties.size());
+            for (size_t i = b; i < end; i++)
+            {
+                const char * p = _row(e, i);
+                if (e.stride)
+                {
+                    for (int k = 0; k < n; k++)
+                    {
+                        const char * q = p + offsets[props[k]];
+                        out[i * n + k] = (T)_binary(q, e.properties[props[k]].type);
+                    }
+                    continue;
+                }
+                // rows with lists before the columns, and text rows, are walked
+                const char * row_end = m_format == ASCII ? _row_end(p, e) : m_file.end();
+                for (size_t j = 0; j < e.properties.size(); j++)
+                {
+                    const CPlyProperty & prop = e.properties[j];
+                    size_t count = 1;
+                    if (prop.is_list())
+                    {
+                        double c = 0;
+                        if (m_format != ASCII) c = _binary(p, prop.count_type);
+                        else if (!_text(p, row_end, c)) { failed = true; return; }
+                        count = (size_t)c;
+                    }
+                    for (size_t m = 0; m < count; m++)
+                    {
+                        double v = 0;
+                        if (m_format == ASCII) { if (!_text(p, row_end, v)) { failed = true; return; } }
+                        else v = _binary(p, prop.type);
+                        if (!prop.is_list()) row[j] = v;
+                    }
+                }
+                for (int k = 0; k < n; k++) out[i * n + k] = (T)row[props[k]];
+            }
+        }, 1 << 12);
+        return !failed;
+    };
+
+    /*---------------------------------------------------------------------------*/
+    template<typename T>
+    inline bool CPlyFile::read_lists(const CPlyElement & e, int prop, std::vector<T> & values, std::vector<int> & offsets, int threads) const
+    {
+        if (prop < 0 || prop >= (int)e.properties.size() || !e.properties[prop].is_list()) return false;
+        const CPlyProperty & list = e.properties[prop];
+
+        // the list of row i starts at starts[i], its length from there
+        std::vector<const char *> starts(e.count);
+        offsets.assign(e.count + 1, 0);
+        std::atomic<bool> failed(false);
+        parallel_for(e.count, threads, [&](size_t b, size_t end)
+        {
+            for (size_t i = b; i < end; i++)
+            {
+                const char * p = _row(e, i);
+                const char * row_end = m_format == ASCII ? _row_end(p, e) : m_file.end();
+                double v = 0, count = 0;
+                for (int j = 0; j <= prop; j++)
+                {
+                    const CPlyProperty & pj = e.properties[j];
+                    const bool is_list = pj.is_list();
+                    if (m_format == ASCII)
+                    {
+                        if (!_text(p, row_end, v)) { failed = true; return; }
+                        if (j == prop) break;
+                        for (size_t m = 0; is_list && m < (size_t)v; m++)
+                        {
+                            double w;
+                            if (!_text(p, row_end, w)) { failed = true; return; }
+                        }
+                    }
+                    else if (is_list)
+                    {
+                        v = _binary(p, pj.count_type);
+                        if (j == prop) break;
+                        p += (size_t)v * CPlyProperty::size(pj.type);
+                    }
+                    else p += CPlyProperty::size(pj.type);
+                }
+                count = v;
+                starts[i] = p;
+                offsets[i + 1] = (int)count;
+            }
+        }, 1 << 12);
+        if (failed) return false;
+
+        for (size_t i = 0; i < e.count; i++) offsets[i + 1] += offsets[i];
+        values.resize((size_t)offsets[e.count]);
+        parallel_for(e.count, threads, [&](size_t b, size_t end)
+        {
+            for (size_t i = b; i < end; i++)
+            {
+                const char * p = starts[i];
+                const char * row_end = m_format == ASCII ? _row_end(_row(e, i), e) : m_file.end();
+                for (int c = offsets[i]; c < offsets[i + 1]; c++)
+                {
+                    double v = 0;
+                    if (m_format == ASCII) { if (!_text(p, row_end, v)) { failed = true; return; } }
+                    else v = _binary(p, list.type);
+                    values[c] = (T)v;
+                }
+            }
+        }, 1 << 12);
+        return !failed;
+    };
+
+    /*!
+     *  Write a binary little endian .ply file of a vertex and a face element
+     *  \param num_vertices number of vertices, n rows of x y z and optionally nx ny nz and s t
+     *  \param positions    3 per vertex
+     *  \param normals, uvs 3 and 2 per vertex, may be NULL
+     *  \param indices      0-based vertex indices, face j owns [offsets[j], offsets[j+1])
+     *  \return false if the file cannot be written
+     */
+    inline bool write_ply_file(const std::string & filename, size_t num_vertices, const double * positions,
+        const double * normals, const double * uvs, size_t num_faces, const uint32_t * indices, const uint32_t * offsets)
+    {
+        FILE * fp = fopen(filename.c_str(), "wb");
+        if (fp == NULL) return false;
+
+        std::string header = "ply\nformat binary_little_endian 1.0\ncomment MeshLib\n";
+        header += "element vertex " + std::to_string(num_vertices) + "\n";
+        header += "property double x\nproperty double y\nproperty double z\n";
+        if (normals) header += "property double nx\nproperty double ny\nproperty double nz\n";
+        if (uvs) header += "property double s\nproperty double t\n";
+        header += "element face " + std::to_string(num_faces) + "\n";
+        header += "property list uchar uint vertex_indices\nend_header\n";
+        bool ok = fwrite(header.data(), 1, header.size(), fp) == header.size();
+
+        const uint16_t one = 1;
+        const bool little = *(const char *)&one == 1;
+        // the rows a block at a time, swapped on big endian hosts
+        std::vector<char> buffer;
+        auto put = [&](const void * v, size_t n)
+        {
+            const char * c = (const char *)v;
+            if (little) buffer.insert(buffer.end(), c, c + n);
+            else for (size_t i = 0; i < n; i++) buffer.push_back(c[n - 1 - i]);
+        };
+        auto flush = [&](bool last)
+        {
+            if (buffer.size() < (1 << 20) && !last) return;
+            ok = ok && (buffer.empty() || fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size());
+            buffer.clear();
+        };
+        for (size_t i = 0; i < num_vertices; i++)
+        {
+            for (int k = 0; k < 3; k++) put(&positions[3 * i + k], 8);
+            if (normals) for (int k = 0; k < 3; k++) put(&normals[3 * i + k], 8);
+            if (uvs) for (int k = 0; k < 2; k++) put(&uvs[2 * i + k], 8);
+            flush(false);
+        }
+        for (size_t j = 0; j < num_faces; j++)
+        {
+            const uint8_t n = (uint8_t)std::min<uint32_t>(offsets[j + 1] - offsets[j], 255);
+            put(&n, 1);
+            for (uint32_t c = offsets[j]; c < offsets[j] + n; c++) put(&indices[c], 4);
+            flush(false);
+        }
+        flush(true);
+
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) remove(filename.c_str());
+        return ok;
+    }
+
+}; //namespace
+
+#endif
@@ -0,0 +1,239 @@
+/*!
+*      \file smv.h
+*      \brief Binary mesh cache format (.smv)
+*
+*      A versioned, little endian triangle mesh image meant to be mapped
+*      straight into memory:
+*
+*          CSmvHeader
+*          positions   float[3] per vertex
+*          uvs         float[2] per corner         (SMV_UV)
+*          normals     float[3] per corner         (SMV_NORMAL)
+*          indices     uint32   per corner
+*          twins       int32    per corner, -1 on the boundary (SMV_TWIN)
+*          outgoing    int32    per vertex, see CCompactMesh::v_he (SMV_OUTGOING)
+*          report      CMeshReport of the mesh the cache was written from (SMV_REPORT)
+*
+*      Corner 3*j+k is the k-th corner of triangle j, its halfedge points to
+*      the vertex indices[3*j+k]. Every section starts on a 16 byte boundary.
+*/
+
+#ifndef _MESHLIB_SMV_H_
+#define _MESHLIB_SMV_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mmap.h"
+
+#define SMV_VERSION 3
+
+#define SMV_UV      (0x01<<0)
+#define SMV_NORMAL  (0x01<<1)
+#define SMV_TWIN    (0x01<<2)
+#define SMV_OUTGOING (0x01<<3)
+#define SMV_REPORT  (0x01<<4)
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CMeshReport, what an intake check wants to know of a mesh, see CMeshAnalysis
+     *
+     *  Plain data of fixed size, so that it is stored as is in the .smv cache.
+     *  The Euler characteristic, the components and the genus leave the
+     *  isolated vertices out, they are counted on their own.
+     */
+    struct CMeshReport
+    {
+        //! number of valences the histogram tells apart, the last bin holds the higher ones
+        static const int s_valences = 16;
+
+        uint64_t vertices = 0;
+        uint64_t edges = 0;
+        uint64_t faces = 0;
+        uint64_t halfedges = 0;
+        uint64_t triangles = 0;
+        uint64_t isolated_vertices = 0;
+        uint64_t boundary_vertices = 0;
+        uint64_t boundary_edges = 0;
+        uint64_t boundary_loops = 0;
+        uint64_t components = 0;
+        //! V - E + F
+        int64_t  euler = 0;
+        //! (2 components - boundary loops - euler) / 2, summed over the components
+        int64_t  genus = 0;
+        uint32_t valence_min = 0;
+        uint32_t valence_max = 0;
+        double   valence_mean = 0;
+        //! vertices by their number of edges
+        uint64_t valence[s_valences] = {};
+        double   area = 0;
+        float    lo[3] = { 0, 0, 0 };
+        float    hi[3] = { 0, 0, 0 };
+
+        /*! one line, "V 8 E 18 F 12 (12 tri) C 1 chi 2 genus 0 loops 0 ..." */
+        std::string to_string() const
+        {
+            char text[512];
+            snprintf(text, sizeof(text),
+                "V %llu E %llu F %llu (%llu tri) C %llu chi %lld genus %lld loops %llu boundary %llu/%llu isolated %llu"
+                " valence %u..%u mean %.2f area %.6g box [%g %g %g]-[%g %g %g]",
+                (unsigned long long)vertices, (unsigned long long)edges, (unsigned long long)faces,
+                (unsigned long long)triangles, (unsigned long long)components, (long long)euler, (long long)genus,
+                (unsigned long long)boundary_loops, (unsigned long long)boundary_edges,
+                (unsigned long long)boundary_vertices, (unsigned long long)isolated_vertices,
+                valence_min, valence_max, valence_mean, area, lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+            return text;
+        }
+    };
+
+    /*!
+     *  \brief CSmvHeader, the first bytes of an .smv file
+     */
+    struct CSmvHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t num_vertices;
+        uint64_t num_triangles;
+        /*! byte offsets of positions, uvs, normals, indices, twins, outgoing halfedges and the report, 0 if absent */
+        uint64_t offset[7];
+
+        CSmvHeader()
+        {
+            memcpy(magic, "SMV\x1a", 4);
+            version = SMV_VERSION;
+            flags = 0;
+            reserved = 0;
+            num_vertices = 0;
+            num_triangles = 0;
+            for (int i = 0; i < 7; i++) offset[i] = 0;
+        }
+
+        bool valid() const { return memcmp(magic, "SMV\x1a", 4) == 0 && version == SMV_VERSION; }
+    };
+
+    /*!
+     *  \brief CSmvFile class, a mapped, read-only .smv file
+     *
+     *  All arrays point into the mapping, nothing is copied.
+     */
+    class CSmvFile
+    {
+    public:
+        CSmvFile() {}
+        CSmvFile(const std::string & filename) { open(filename); }
+
+        bool open(const std::string & filename)
+        {
+            m_ok = false;
+            if (!m_file.open(filename)) return false;
+            if (m_file.size() < sizeof(CSmvHeader)) { m_file.close(); return false; }
+
+            memcpy(&m_header, m_file.begin(), sizeof(CSmvHeader));
+            if (!m_header.valid()) { m_file.close(); return false; }
+
+            // every vertex and triangle takes 12 bytes at least, larger counts would overflow the sizes
+            const uint64_t file = m_file.size();
+            if (m_header.num_vertices > file / 12 || m_header.num_triangles > file / 12) { m_file.close(); return false; }
+            uint64_t nc = 3 * m_header.num_triangles;
+            uint64_t sizes[7] = { 12 * m_header.num_vertices, 8 * nc, 12 * nc, 4 * nc, 4 * nc, 4 * m_header.num_vertices,
+                sizeof(CMeshReport) };
+            for (int i = 0; i < 7; i++)
+            {
+                // the offset first, offset + size may wrap, and aligned as written, the arrays are read in place
+                if (m_header.offset[i] && (m_header.offset[i] % 16 != 0 || m_header.offset[i] > file || sizes[i] > file - m_header.offset[i]))
+                {
+                    m_file.close();
+                    return false;
+                }
+            }
+            if (!m_header.offset[0] || !m_header.offset[3]) { m_file.close(); return false; }
+            m_ok = true;
+            return true;
+        }
+
+        void close() { m_file.close(); m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        const CSmvHeader & header() const { return m_header; }
+        size_t num_vertices()  const { return (size_t)m_header.num_vertices; }
+        size_t num_triangles() const { return (size_t)m_header.num_triangles; }
+
+        const float    * positions() const { return (const float *)_section(0); }
+        const float    * uvs()       const { return (const float *)_section(1); }
+        const float    * normals()   const { return (const float *)_section(2); }
+        const uint32_t * indices()   const { return (const uint32_t *)_section(3); }
+        const int32_t  * twins()     const { return (const int32_t *)_section(4); }
+        const int32_t  * outgoing()  const { return (const int32_t *)_section(5); }
+        const CMeshReport * report() const { return (const CMeshReport *)_section(6); }
+
+    protected:
+        const char * _section(int i) const
+        {
+            return (m_ok && m_header.offset[i]) ? m_file.begin() + m_header.offset[i] : NULL;
+        }
+
+        CMappedFile m_file;
+        CSmvHeader  m_header;
+        bool        m_ok = false;
+    };
+
+    /*!
+     *  Write an .smv file, the arrays are laid out as described above.
+     *  \param uvs, normals, twins, outgoing, report may be NULL
+     *  \return false if the file cannot be written
+     */
+    inline bool write_smv_file(const std::string & filename, size_t num_vertices, size_t num_triangles,
+        const float * positions, const float * uvs, const float * normals,
+        const uint32_t * indices, const int32_t * twins, const int32_t * outgoing = NULL, const CMeshReport * report = NULL)
+    {
+        FILE * fp = fopen(filename.c_str(), "wb");
+        if (fp == NULL) return false;
+
+        CSmvHeader header;
+        header.num_vertices = num_vertices;
+        header.num_triangles = num_triangles;
+        if (uvs) header.flags |= SMV_UV;
+        if (normals) header.flags |= SMV_NORMAL;
+        if (twins) header.flags |= SMV_TWIN;
+        if (outgoing) header.flags |= SMV_OUTGOING;
+        if (report) header.flags |= SMV_REPORT;
+
+        size_t nc = 3 * num_triangles;
+        const void * data[7] = { positions, uvs, normals, indices, twins, outgoing, report };
+        size_t sizes[7] = { 12 * num_vertices, 8 * nc, 12 * nc, 4 * nc, 4 * nc, 4 * num_vertices, sizeof(CMeshReport) };
+
+        uint64_t pos = (sizeof(CSmvHeader) + 15) & ~(uint64_t)15;
+        for (int i = 0; i < 7; i++)
+        {
+            if (!data[i]) continue;
+            header.offset[i] = pos;
+            pos = (pos + sizes[i] + 15) & ~(uint64_t)15;
+        }
+
+        bool ok = fwrite(&header, sizeof(CSmvHeader), 1, fp) == 1;
+        uint64_t written = sizeof(CSmvHeader);
+        static const char zeros[16] = { 0 };
+        for (int i = 0; i < 7 && ok; i++)
+        {
+            if (!data[i]) continue;
+            ok = fwrite(zeros, 1, (size_t)(header.offset[i] - written), fp) == header.offset[i] - written;
+            ok = ok && fwrite(data[i], 1, sizes[i], fp) == sizes[i];
+            written = header.offset[i] + sizes[i];
+        }
+
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) remove(filename.c_str());
+        return ok;
+    }
+
+}; //namespace
+
+#endif
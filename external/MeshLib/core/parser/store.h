@@ -0,0 +1,270 @@
+/*!
+*      \file store.h
+*      \brief Content addressed store of the outputs of processing stages
+*
+*      An output is filed under a key, the hash of the bytes of its inputs
+*      and of the parameters of the stage that made it, so an unchanged
+*      asset processed the same way finds its output whatever its name, its
+*      path or its time stamps. The keys of a chain of stages are chained: a
+*      stage hashes the key of the stage before it with its own parameters.
+*
+*      The store is a local directory and optionally a shared one, a network
+*      mount all nodes see. A lookup tries the local directory, then the
+*      shared one, whose hit is copied to the local one for the next time.
+*      An output is written to a temporary file and renamed into place, in
+*      both directories, so readers never see half of it and writers racing
+*      on one key leave one of their equal copies.
+*/
+
+#ifndef _MESHLIB_STORE_H_
+#define _MESHLIB_STORE_H_
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+#include "mmap.h"
+#include "parallel.h"
+#include "counters.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief a 128 bit key, two independent 64 bit hashes
+     */
+    struct CStoreKey
+    {
+        uint64_t h[2] = { 0, 0 };
+
+        /*! 32 hex digits */
+        std::string hex() const
+        {
+            static const char digits[] = "0123456789abcdef";
+            std::string s(32, '0');
+            for (int i = 0; i < 2; i++)
+                for (int d = 0; d < 16; d++) s[16 * i + d] = digits[(h[i] >> (60 - 4 * d)) & 15];
+            return s;
+        }
+        bool operator==(const CStoreKey & o) const { return h[0] == o.h[0] && h[1] == o.h[1]; }
+        bool operator!=(const CStoreKey & o) const { return !(*this == o); }
+    };
+
+    /*!
+     *  \brief CContentStore class
+     */
+    class CContentStore
+    {
+    public:
+        //! the directory on this machine, no store if empty
+        std::string local;
+        //! a directory all nodes share, none if empty
+        std::string shared;
+
+        bool enabled() const { return !local.empty() || !shared.empty(); }
+
+        /*! the key of bytes, chained onto a key */
+        static CStoreKey hash(const void * data, size_t bytes, const CStoreKey & chain = CStoreKey())
+        {
+            CStoreKey k;
+            for (int i = 0; i < 2; i++) k.h[i] = _hash((const uint8_t *)data, bytes, chain.h[i] ^ _seed(i));
+            return k;
+        }
+        /*! the key of a string, the name and the parameters of a stage say */
+        static CStoreKey hash(const std::string & text, const CStoreKey & chain = CStoreKey())
+        {
+            return hash(text.data(), text.size(), chain);
+        }
+
+        /*!
+         *  The key of the bytes of a file, hashed in blocks in parallel and the
+         *  hashes of the blocks in order, the same for any number of threads
+         *  \return false if the file cannot be read
+         */
+        static bool hash_file(const std::string & filename, CStoreKey & key, int threads = 0)
+        {
+            CMappedFile file;
+            if (!file.open(filename)) return false;
+            const size_t block = (size_t)1 << 22;
+            const size_t blocks = (file.size() + block - 1) / block;
+            std::vector<CStoreKey> keys(blocks);
+            parallel_for(blocks, threads, [&](size_t b, size_t e)
+            {
+                for (size_t i = b; i < e; i++)
+                {
+                    const size_t begin = i * block, end = std::min(file.size(), begin + block);
+                    keys[i] = hash(file.begin() + begin, end - begin);
+                }
+            }, 1);
+            const uint64_t size = file.size();
+            key = hash(&size, sizeof(size));
+            if (!keys.empty()) key = hash(keys.data(), keys.size() * sizeof(CStoreKey), key);
+            MESHLIB_COUNTER_ADD("store.hashed_bytes", file.size());
+            return true;
+        }
+
+        /*!
+         *  Look an output up, the local directory first
+         *  \param ext  the extension of the output, ".smv" say, part of its name
+         *  \param path the file to read then, in the local directory if there is one
+         *  \return false on a miss
+         */
+        bool find(const CStoreKey & key, const std::string & ext, std::string & path) const
+        {
+            if (!local.empty() && _exists(path = _path(local, key, ext)))
+            {
+                MESHLIB_COUNTER_ADD("store.hits", 1);
+                return true;
+            }
+            if (!shared.empty() && _exists(path = _path(shared, key, ext)))
+            {
+                MESHLIB_COUNTER_ADD("store.hits", 1);
+                // the next lookup of this node stays local, the shared copy serves if that fails
+                std::string copy;
+                if (!local.empty() && _install(local, key, ext, [&](const std::string & tmp) { return _copy(path, tmp); }, copy))
+                    path = copy;
+                return true;
+            }
+            MESHLIB_COUNTER_ADD("store.misses", 1);
+            return false;
+        }
+
+        /*!
+         *  File an output under key
+         *  \param write write(path) writes the output to path, false if it failed
+         *  \param path  where it is then, in the local directory if there is one
+         *  \return false if write failed or no directory took the output
+         */
+        bool put(const CStoreKey & key, const std::string & ext, std::function<bool(const std::string &)> write, std::string & path) const
+        {
+            std::string first;
+            if (!local.empty() && !_install(local, key, ext, write, first)) return false;
+            if (!shared.empty())
+            {
+                // the local copy goes up, a shared directory out of reach leaves the output local
+                std::string copy;
+                if (!first.empty()) _install(shared, key, ext, [&](const std::string & tmp) { return _copy(first, tmp); }, copy);
+                else if (_install(shared, key, ext, write, copy)) first = copy;
+            }
+            if (first.empty()) return false;
+            path = first;
+            return true;
+        }
+
+        /*! file a copy of a file under key */
+        bool put_file(const CStoreKey & key, const std::string & ext, const std::string & filename) const
+        {
+            std::string path;
+            return put(key, ext, [&](const std::string & tmp) { return _copy(filename, tmp); }, path);
+        }
+
+        /*! copy a file, false if it cannot be read or written */
+        static bool copy_file(const std::string & from, const std::string & to) { return _copy(from, to); }
+
+    protected:
+        static uint64_t _seed(int i) { return i ? 0xC2B2AE3D27D4EB4FULL : 0x9E3779B97F4A7C15ULL; }
+
+        /*! a 64 bit multiply and xor shift hash over 8 byte words, the tail padded with its length */
+        static uint64_t _hash(const uint8_t * p, size_t n, uint64_t seed)
+        {
+            const uint64_t m = 0x9FB21C651E98DF25ULL;
+            uint64_t h = seed ^ (n * m);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                uint64_t w;
+                std::memcpy(&w, p + i, 8);
+                h = _mix(h ^ w * m);
+            }
+            uint64_t tail = (uint64_t)(n - i) << 56;
+            for (size_t k = 0; i + k < n; k++) tail |= (uint64_t)p[i + k] << (8 * k);
+            return _mix(_mix(h ^ tail * m) ^ seed);
+        }
+        static uint64_t _mix(uint64_t x)
+        {
+            x ^= x >> 31; x *= 0x7FB5D329728EA185ULL;
+            x ^= x >> 27; x *= 0x81DADEF4BC2DD44DULL;
+            return x ^ (x >> 33);
+        }
+
+        /*! root/ab/abcdef...ext, the first two digits fan the outputs out */
+        static std::string _path(const std::string & root, const CStoreKey & key, const std::string & ext)
+        {
+            const std::string hex = key.hex();
+            return root + "/" + hex.substr(0, 2) + "/" + hex + ext;
+        }
+
+        static bool _exists(const std::string & path)
+        {
+            FILE * fp = fopen(path.c_str(), "rb");
+            if (fp) fclose(fp);
+            return fp != NULL;
+        }
+
+        static void _make_dir(const std::string & dir)
+        {
+#ifdef _WIN32
+            _mkdir(dir.c_str());
+#else
+            mkdir(dir.c_str(), 0777);
+#endif
+        }
+
+        /*! write through a temporary file of this process and thread, renamed into place */
+        static bool _install(const std::string & root, const CStoreKey & key, const std::string & ext,
+            const std::function<bool(const std::string &)> & write, std::string & path)
+        {
+            path = _path(root, key, ext);
+            _make_dir(root);
+            _make_dir(path.substr(0, path.find_last_of('/')));
+            static std::atomic<unsigned> counter(0);
+            const size_t self = std::hash<std::thread::id>()(std::this_thread::get_id());
+            const std::string tmp = path + "." + std::to_string(self) + "." + std::to_string(counter++) + ".tmp";
+            if (!write(tmp))
+            {
+                std::remove(tmp.c_str());
+                return false;
+            }
+            if (std::rename(tmp.c_str(), path.c_str()) == 0) return true;
+            // another writer was first, its output is the same
+            std::remove(tmp.c_str());
+            return _exists(path);
+        }
+
+        static bool _copy(const std::string & from, const std::string & to)
+        {
+            FILE * in = fopen(from.c_str(), "rb");
+            if (!in) return false;
+            FILE * out = fopen(to.c_str(), "wb");
+            if (!out)
+            {
+                fclose(in);
+                return false;
+            }
+            std::vector<char> buffer((size_t)1 << 20);
+            bool ok = true;
+            size_t n;
+            while (ok && (n = fread(buffer.data(), 1, buffer.size(), in)) > 0) ok = fwrite(buffer.data(), 1, n, out) == n;
+            ok = ok && !ferror(in);
+            fclose(in);
+            return fclose(out) == 0 && ok;
+        }
+    };
+
+}; //namespace
+
+#endif
@@ -3,6 +3,9 @@
 *      \brief std::string utilities
 *      \date Documented on 10/08/2010
 *
+*      parseString and toString convert numbers with std::from_chars and
+*      std::to_chars where the library has them, the text is that of the
+*      streams they fall back to: doubles with 6 significant digits.
 */
 
 #pragma once
@@ -12,6 +15,16 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <type_traits>
+#include <cctype>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#define STRUTIL_CHARCONV
+#endif
+#endif
+#endif
 
 // declaration
 namespace strutil {
@@ -94,13 +107,55 @@ namespace strutil {
     };
 
 
-    template<class T> T parseString(const std::string& str) {
+    // the numbers from_chars and to_chars take, not bool or the characters
+    template<class T> struct isNumber : std::integral_constant<bool, std::is_arithmetic<T>::value
+        && !std::is_same<T, bool>::value && !std::is_same<T, char>::value && !std::is_same<T, signed char>::value
+        && !std::is_same<T, unsigned char>::value && !std::is_same<T, wchar_t>::value
+        && !std::is_same<T, char16_t>::value && !std::is_same<T, char32_t>::value> {};
+
+    template<class T> T _parseStream(const std::string& str) {
         T value;
         std::istringstream iss(str);
         iss >> value;
         return value;
     };
 
+    template<class T> T _parseNumber(const std::string& str, std::true_type /*integral*/) {
+#ifdef STRUTIL_CHARCONV
+        // the stream skips white space and takes a '+', from_chars does not
+        const char * p = str.data();
+        const char * e = p + str.size();
+        while (p < e && isspace((unsigned char)*p)) p++;
+        if (p < e && *p == '+') p++;
+        T value = T();
+        std::from_chars(p, e, value);
+        return value;
+#else
+        return _parseStream<T>(str);
+#endif
+    };
+
+    template<class T> T _parseNumber(const std::string& str, std::false_type /*floating point*/) {
+#if defined(STRUTIL_CHARCONV) && defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        const char * p = str.data();
+        const char * e = p + str.size();
+        while (p < e && isspace((unsigned char)*p)) p++;
+        if (p < e && *p == '+') p++;
+        T value = T();
+        std::from_chars(p, e, value);
+        return value;
+#else
+        return _parseStream<T>(str);
+#endif
+    };
+
+    template<class T> T _parseString(const std::string& str, std::true_type /*number*/) { return _parseNumber<T>(str, std::is_integral<T>()); };
+    template<class T> T _parseString(const std::string& str, std::false_type) { return _parseStream<T>(str); };
+
+    template<class T> T parseString(const std::string& str) {
+        return _parseString<T>(str, isNumber<T>());
+    };
+
     template<class T> T parseHexString(const std::string& str) {
         T value;
         std::istringstream iss(str);
@@ -108,12 +163,39 @@ namespace strutil {
         return value;
     };
 
-    template<class T> std::string toString(const T& value) {
+    template<class T> std::string _toStream(const T& value) {
         std::ostringstream oss;
         oss << value;
         return oss.str();
     };
 
+    template<class T> std::string _toNumber(const T& value, std::true_type /*integral*/) {
+#ifdef STRUTIL_CHARCONV
+        char buffer[24];
+        return std::string(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+#else
+        return _toStream(value);
+#endif
+    };
+
+    template<class T> std::string _toNumber(const T& value, std::false_type /*floating point*/) {
+#if defined(STRUTIL_CHARCONV) && defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        // inf and nan are spelled as the stream spells them
+        if (value == value && value - value == 0) {
+            char buffer[64];
+            return std::string(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 6).ptr);
+        }
+#endif
+        return _toStream(value);
+    };
+
+    template<class T> std::string _toString(const T& value, std::true_type /*number*/) { return _toNumber(value, std::is_integral<T>()); };
+    template<class T> std::string _toString(const T& value, std::false_type) { return _toStream(value); };
+
+    template<class T> std::string toString(const T& value) {
+        return _toString(value, isNumber<T>());
+    };
+
     template<class T> std::string toHexString(const T& value, int width) {
         std::ostringstream oss;
         oss << hex;
@@ -0,0 +1,157 @@
+/*!
+*      \file stx.h
+*      \brief Binary texture cache format (.stx)
+*
+*      A versioned, little endian mip chain ready for upload, meant to be
+*      mapped straight into memory:
+*
+*          CStxHeader
+*          level 0     width x height, RGBA8 rows or BC1 block rows, in upload order
+*          level 1     half the size, rounded down, at least 1
+*          ...
+*
+*      Every level starts on a 16 byte boundary.
+*/
+
+#ifndef _MESHLIB_STX_H_
+#define _MESHLIB_STX_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mmap.h"
+
+#define STX_VERSION 1
+
+#define STX_RGBA8   0
+#define STX_BC1     1
+
+#define STX_MAX_LEVELS 32
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CStxHeader, the first bytes of an .stx file
+     */
+    struct CStxHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t format;
+        uint32_t levels;
+        uint32_t width;
+        uint32_t height;
+        /*! byte offsets and sizes of the levels */
+        uint64_t offset[STX_MAX_LEVELS];
+        uint64_t size[STX_MAX_LEVELS];
+
+        CStxHeader()
+        {
+            memcpy(magic, "STX\x1a", 4);
+            version = STX_VERSION;
+            format = STX_RGBA8;
+            levels = 0;
+            width = 0;
+            height = 0;
+            for (int i = 0; i < STX_MAX_LEVELS; i++) offset[i] = size[i] = 0;
+        }
+
+        bool valid() const
+        {
+            return memcmp(magic, "STX\x1a", 4) == 0 && version == STX_VERSION &&
+                levels > 0 && levels <= STX_MAX_LEVELS && (format == STX_RGBA8 || format == STX_BC1);
+        }
+    };
+
+    /*!
+     *  \brief CStxFile class, a mapped, read-only .stx file
+     */
+    class CStxFile
+    {
+    public:
+        CStxFile() {}
+        CStxFile(const std::string & filename) { open(filename); }
+
+        bool open(const std::string & filename)
+        {
+            m_ok = false;
+            if (!m_file.open(filename)) return false;
+            if (m_file.size() < sizeof(CStxHeader)) { m_file.close(); return false; }
+
+            memcpy(&m_header, m_file.begin(), sizeof(CStxHeader));
+            if (!m_header.valid()) { m_file.close(); return false; }
+            for (uint32_t i = 0; i < m_header.levels; i++)
+            {
+                if (m_header.offset[i] < sizeof(CStxHeader) || m_header.offset[i] + m_header.size[i] > m_file.size())
+                {
+                    m_file.close();
+                    return false;
+                }
+            }
+            m_ok = true;
+            return true;
+        }
+
+        void close() { m_file.close(); m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        const CStxHeader & header() const { return m_header; }
+        int levels() const { return (int)m_header.levels; }
+
+        const uint8_t * level(int i) const { return m_ok ? (const uint8_t *)m_file.begin() + m_header.offset[i] : NULL; }
+        size_t level_size(int i) const { return (size_t)m_header.size[i]; }
+
+    protected:
+        CMappedFile m_file;
+        CStxHeader  m_header;
+        bool        m_ok = false;
+    };
+
+    /*!
+     *  Write an .stx file
+     *  \param data, sizes the levels, finest first
+     *  \return false if the file cannot be written
+     */
+    inline bool write_stx_file(const std::string & filename, uint32_t format, uint32_t width, uint32_t height,
+        const std::vector<const uint8_t *> & data, const std::vector<size_t> & sizes)
+    {
+        if (data.empty() || data.size() > STX_MAX_LEVELS || data.size() != sizes.size()) return false;
+        FILE * fp = fopen(filename.c_str(), "wb");
+        if (fp == NULL) return false;
+
+        CStxHeader header;
+        header.format = format;
+        header.levels = (uint32_t)data.size();
+        header.width = width;
+        header.height = height;
+
+        uint64_t pos = (sizeof(CStxHeader) + 15) & ~(uint64_t)15;
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            header.offset[i] = pos;
+            header.size[i] = sizes[i];
+            pos = (pos + sizes[i] + 15) & ~(uint64_t)15;
+        }
+
+        bool ok = fwrite(&header, sizeof(CStxHeader), 1, fp) == 1;
+        uint64_t written = sizeof(CStxHeader);
+        static const char zeros[16] = { 0 };
+        for (size_t i = 0; i < data.size() && ok; i++)
+        {
+            ok = fwrite(zeros, 1, (size_t)(header.offset[i] - written), fp) == header.offset[i] - written;
+            ok = ok && fwrite(data[i], 1, sizes[i], fp) == sizes[i];
+            written = header.offset[i] + sizes[i];
+        }
+
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) remove(filename.c_str());
+        return ok;
+    }
+
+}; //namespace
+
+#endif
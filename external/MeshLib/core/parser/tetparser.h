@@ -0,0 +1,335 @@
+/*!
+*      \file tetparser.h
+*      \brief In-place, chunk-parallel parser for .tet and .t volume meshes
+*
+*      A .tet file is a line "n vertices", a line "m tets", n lines of vertex
+*      coordinates and m lines "4 v0 v1 v2 v3". The lines are counted per
+*      chunk first, so that every chunk knows which record its lines are and
+*      writes them in place. A .t file has "Vertex id x y z {traits}",
+*      "Tet id v0 v1 v2 v3 {traits}" and "Edge id1 id2 {traits}" lines; its
+*      chunks are parsed into local arrays and merged in file order, as the
+*      .obj parser does.
+*/
+
+#ifndef _MESHLIB_TET_PARSER_H_
+#define _MESHLIB_TET_PARSER_H_
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include "../Geometry/Point.h"
+#include "mmap.h"
+#include "numparse.h"
+#include "parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CTetData, flat arrays of the records of a volume mesh file
+     *
+     *  Tet i has the vertex ids tets[4i].. tets[4i + 3]. The trait strings
+     *  are kept only for the records that have one, with the record's index.
+     */
+    struct CTetData
+    {
+        std::vector<CPoint> points;
+        std::vector<int>    vertex_ids;
+        std::vector<int>    tets;
+        std::vector<int>    tet_ids;
+        /*! two vertex ids per edge record */
+        std::vector<int>    edges;
+
+        std::vector<std::pair<size_t, std::string>> vertex_traits;
+        std::vector<std::pair<size_t, std::string>> tet_traits;
+        std::vector<std::pair<size_t, std::string>> edge_traits;
+
+        size_t num_vertices() const { return points.size(); }
+        size_t num_tets() const { return tet_ids.size(); }
+
+        void clear()
+        {
+            points.clear(); vertex_ids.clear(); tets.clear(); tet_ids.clear(); edges.clear();
+            vertex_traits.clear(); tet_traits.clear(); edge_traits.clear();
+        }
+    };
+
+    /*!
+     *  \brief CTetParser class, numbers are read with the CNumParser scanners
+     */
+    class CTetParser : public CNumParser
+    {
+    public:
+        /*!
+         *  Parse a .tet file
+         *  \param threads number of worker threads, 0 uses all hardware threads
+         *  \return false if the file cannot be opened or its header is malformed
+         */
+        static bool parse_tet_file(const std::string & filename, CTetData & data, int threads = 0)
+        {
+            CMappedFile file(filename);
+            if (!file.is_open()) return false;
+            return parse_tet(file.begin(), file.end(), data, threads);
+        }
+
+        /*! parse a .t file, false if it cannot be opened */
+        static bool parse_t_file(const std::string & filename, CTetData & data, int threads = 0)
+        {
+            CMappedFile file(filename);
+            if (!file.is_open()) return false;
+            parse_t(file.begin(), file.end(), data, threads);
+            return true;
+        }
+
+        /*! parse a .tet buffer, false if the header lines are malformed */
+        static bool parse_tet(const char * begin, const char * end, CTetData & data, int threads = 0)
+        {
+            data.clear();
+
+            int counts[2] = { 0, 0 };
+            const char * words[2] = { "vertices", "tets" };
+            const char * p = begin;
+            for (int i = 0; i < 2; i++)
+            {
+                const char * eol = _line_end(p, end);
+                skip_blank(p, eol);
+                if (!scan_int(p, eol, counts[i]) || counts[i] < 0) return false;
+                skip_blank(p, eol);
+                const size_t n = strlen(words[i]);
+                if ((size_t)(eol - p) < n || strncmp(p, words[i], n) != 0) return false;
+                p = eol < end ? eol + 1 : end;
+            }
+            const size_t nv = (size_t)counts[0], nt = (size_t)counts[1];
+
+            std::vector<const char *> cuts;
+            threads = _cut(p, end, threads, cuts);
+
+            // the lines before every chunk
+            std::vector<size_t> lines(threads + 1, 0);
+            parallel_run(threads, [&](int i)
+            {
+                size_t n = 0;
+                for (const char * q = cuts[i]; q < cuts[i + 1]; n++)
+                {
+                    q = (const char *)memchr(q, '\n', (size_t)(cuts[i + 1] - q));
+                    if (q == NULL) break;
+                    q++;
+                }
+                lines[i + 1] = n;
+            });
+            for (int i = 0; i < threads; i++) lines[i + 1] += lines[i];
+
+            // records missing at the end of the file are dropped below
+            data.points.resize(nv);
+            data.vertex_ids.resize(nv);
+            data.tets.resize(4 * nt);
+            data.tet_ids.resize(nt);
+            std::vector<size_t> found(threads, 0);
+            std::vector<CTetData> traits(threads);
+
+            parallel_run(threads, [&](int i)
+            {
+                size_t line = lines[i];
+                const char * q = cuts[i];
+                while (q < cuts[i + 1] && line < nv + nt)
+                {
+                    const char * eol = _line_end(q, cuts[i + 1]);
+                    const char * r = q;
+                    if (line < nv)
+                    {
+                        CPoint & pt = data.points[line];
+                        for (int k = 0; k < 3; k++)
+                        {
+                            skip_blank(r, eol);
+                            scan_double(r, eol, pt[k]);
+                        }
+                        data.vertex_ids[line] = (int)line;
+                        std::string s;
+                        if (_trait(r, eol, s)) traits[i].vertex_traits.push_back(std::make_pair(line, s));
+                    }
+                    else
+                    {
+                        const size_t t = line - nv;
+                        int skip;
+                        skip_blank(r, eol);
+                        scan_int(r, eol, skip);
+                        for (int k = 0; k < 4; k++)
+                        {
+                            skip_blank(r, eol);
+                            scan_int(r, eol, data.tets[4 * t + k]);
+                        }
+                        data.tet_ids[t] = (int)t;
+                    }
+                    found[i]++;
+                    line++;
+                    q = eol < cuts[i + 1] ? eol + 1 : cuts[i + 1];
+                }
+            });
+
+            size_t records = 0;
+            for (int i = 0; i < threads; i++)
+            {
+                records += found[i];
+                for (auto & t : traits[i].vertex_traits) data.vertex_traits.push_back(std::move(t));
+            }
+            if (records < nv + nt)
+            {
+                data.points.resize(std::min(records, nv));
+                data.vertex_ids.resize(std::min(records, nv));
+                data.tet_ids.resize(records > nv ? records - nv : 0);
+                data.tets.resize(4 * data.tet_ids.size());
+            }
+            return true;
+        }
+
+        /*! parse a .t buffer */
+        static void parse_t(const char * begin, const char * end, CTetData & data, int threads = 0)
+        {
+            data.clear();
+
+            std::vector<const char *> cuts;
+            threads = _cut(begin, end, threads, cuts);
+            std::vector<CTetData> chunks(threads);
+            parallel_run(threads, [&](int i) { _parse_t_chunk(cuts[i], cuts[i + 1], chunks[i]); });
+
+            // prefix sums over the record counts of the chunks
+            std::vector<size_t> nv(threads + 1, 0), nt(threads + 1, 0), ne(threads + 1, 0);
+            for (int i = 0; i < threads; i++)
+            {
+                nv[i + 1] = nv[i] + chunks[i].points.size();
+                nt[i + 1] = nt[i] + chunks[i].tet_ids.size();
+                ne[i + 1] = ne[i] + chunks[i].edges.size() / 2;
+            }
+            data.points.resize(nv[threads]);
+            data.vertex_ids.resize(nv[threads]);
+            data.tets.resize(4 * nt[threads]);
+            data.tet_ids.resize(nt[threads]);
+            data.edges.resize(2 * ne[threads]);
+
+            parallel_run(threads, [&](int i)
+            {
+                CTetData & c = chunks[i];
+                std::copy(c.points.begin(), c.points.end(), data.points.begin() + nv[i]);
+                std::copy(c.vertex_ids.begin(), c.vertex_ids.end(), data.vertex_ids.begin() + nv[i]);
+                std::copy(c.tets.begin(), c.tets.end(), data.tets.begin() + 4 * nt[i]);
+                std::copy(c.tet_ids.begin(), c.tet_ids.end(), data.tet_ids.begin() + nt[i]);
+                std::copy(c.edges.begin(), c.edges.end(), data.edges.begin() + 2 * ne[i]);
+            });
+
+            for (int i = 0; i < threads; i++)
+            {
+                for (auto & t : chunks[i].vertex_traits) data.vertex_traits.push_back(std::make_pair(t.first + nv[i], std::move(t.second)));
+                for (auto & t : chunks[i].tet_traits) data.tet_traits.push_back(std::make_pair(t.first + nt[i], std::move(t.second)));
+                for (auto & t : chunks[i].edge_traits) data.edge_traits.push_back(std::make_pair(t.first + ne[i], std::move(t.second)));
+            }
+        }
+
+    protected:
+        //! chunks smaller than this are not worth a thread
+        static const size_t s_min_chunk_size = 1 << 20;
+
+        static const char * _line_end(const char * p, const char * end)
+        {
+            const char * q = (const char *)memchr(p, '\n', (size_t)(end - p));
+            return q ? q : end;
+        }
+
+        /*! split begin, end at newlines into at most threads chunks, returns their number */
+        static int _cut(const char * begin, const char * end, int threads, std::vector<const char *> & cuts)
+        {
+            threads = resolve_threads(threads);
+            const size_t size = (size_t)(end - begin);
+            threads = (int)std::min<size_t>(threads, std::max<size_t>(1, size / s_min_chunk_size));
+
+            cuts.assign(threads + 1, begin);
+            cuts[threads] = end;
+            for (int i = 1; i < threads; i++)
+            {
+                const char * p = std::max(cuts[i - 1], begin + size / threads * i);
+                while (p < end && *p != '\n') p++;
+                if (p < end) p++;
+                cuts[i] = p;
+            }
+            return threads;
+        }
+
+        /*! the text between the first '{' from p on and the next '}' on the line */
+        static bool _trait(const char * p, const char * eol, std::string & s)
+        {
+            const char * sp = (const char *)memchr(p, '{', (size_t)(eol - p));
+            if (sp == NULL) return false;
+            const char * ep = (const char *)memchr(sp, '}', (size_t)(eol - sp));
+            if (ep == NULL) return false;
+            s.assign(sp + 1, ep);
+            return true;
+        }
+
+        static bool _keyword(const char * &p, const char * end, const char * word)
+        {
+            const size_t n = strlen(word);
+            if ((size_t)(end - p) < n || strncmp(p, word, n) != 0) return false;
+            if (p + n < end && !is_blank(p[n])) return false;
+            p += n;
+            return true;
+        }
+
+        static void _parse_t_chunk(const char * p, const char * end, CTetData & d)
+        {
+            std::string s;
+            while (p < end)
+            {
+                const char * eol = _line_end(p, end);
+                const char * q = p;
+                p = eol < end ? eol + 1 : end;
+                skip_blank(q, eol);
+
+                int id = 0;
+                if (_keyword(q, eol, "Vertex"))
+                {
+                    skip_blank(q, eol);
+                    scan_int(q, eol, id);
+                    CPoint pt;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        skip_blank(q, eol);
+                        scan_double(q, eol, pt[k]);
+                    }
+                    if (_trait(q, eol, s)) d.vertex_traits.push_back(std::make_pair(d.points.size(), s));
+                    d.points.push_back(pt);
+                    d.vertex_ids.push_back(id);
+                }
+                else if (_keyword(q, eol, "Tet"))
+                {
+                    skip_blank(q, eol);
+                    scan_int(q, eol, id);
+                    int v[4] = { 0, 0, 0, 0 };
+                    for (int k = 0; k < 4; k++)
+                    {
+                        skip_blank(q, eol);
+                        scan_int(q, eol, v[k]);
+                    }
+                    if (_trait(q, eol, s)) d.tet_traits.push_back(std::make_pair(d.tet_ids.size(), s));
+                    d.tets.insert(d.tets.end(), v, v + 4);
+                    d.tet_ids.push_back(id);
+                }
+                else if (_keyword(q, eol, "Edge"))
+                {
+                    int v[2] = { 0, 0 };
+                    for (int k = 0; k < 2; k++)
+                    {
+                        skip_blank(q, eol);
+                        scan_int(q, eol, v[k]);
+                    }
+                    if (_trait(q, eol, s)) d.edge_traits.push_back(std::make_pair(d.edges.size() / 2, s));
+                    d.edges.insert(d.edges.end(), v, v + 2);
+                }
+            }
+        }
+    };
+
+}; //namespace
+
+#endif
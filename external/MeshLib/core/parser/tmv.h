@@ -0,0 +1,217 @@
+/*!
+*      \file tmv.h
+*      \brief Binary tet mesh cache format (.tmv)
+*
+*      A versioned, little endian image of a tetrahedral mesh meant to be
+*      mapped straight into memory, the volume counterpart of .smv:
+*
+*          CTmvHeader
+*          positions   double[3] per vertex
+*          vertex ids  int32     per vertex
+*          tets        int32[4]  per tet, vertex ids
+*          tet ids     int32     per tet
+*
+*      Every section starts on a 16 byte boundary. Trait strings are not kept.
+*/
+
+#ifndef _MESHLIB_TMV_H_
+#define _MESHLIB_TMV_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+#include "mmap.h"
+
+#define TMV_VERSION 1
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CTmvHeader, the first bytes of a .tmv file
+     */
+    struct CTmvHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t reserved;
+        uint64_t num_vertices;
+        uint64_t num_tets;
+        /*! byte offsets of positions, vertex ids, tets and tet ids */
+        uint64_t offset[4];
+
+        CTmvHeader()
+        {
+            memcpy(magic, "TMV\x1a", 4);
+            version = TMV_VERSION;
+            flags = 0;
+            reserved = 0;
+            num_vertices = 0;
+            num_tets = 0;
+            for (int i = 0; i < 4; i++) offset[i] = 0;
+        }
+
+        bool valid() const { return memcmp(magic, "TMV\x1a", 4) == 0 && version == TMV_VERSION; }
+    };
+
+    /*!
+     *  \brief CTmvFile class, a mapped, read-only .tmv file
+     *
+     *  All arrays point into the mapping, nothing is copied.
+     */
+    class CTmvFile
+    {
+    public:
+        CTmvFile() {}
+        CTmvFile(const std::string & filename) { open(filename); }
+
+        bool open(const std::string & filename)
+        {
+            m_ok = false;
+            if (!m_file.open(filename)) return false;
+            if (m_file.size() < sizeof(CTmvHeader)) { m_file.close(); return false; }
+
+            memcpy(&m_header, m_file.begin(), sizeof(CTmvHeader));
+            if (!m_header.valid()) { m_file.close(); return false; }
+
+            const uint64_t sizes[4] = { 24 * m_header.num_vertices, 4 * m_header.num_vertices, 16 * m_header.num_tets, 4 * m_header.num_tets };
+            for (int i = 0; i < 4; i++)
+            {
+                if (!m_header.offset[i] || m_header.offset[i] + sizes[i] > m_file.size())
+                {
+                    m_file.close();
+                    return false;
+                }
+            }
+            m_ok = true;
+            return true;
+        }
+
+        void close() { m_file.close(); m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        const CTmvHeader & header() const { return m_header; }
+        size_t num_vertices() const { return (size_t)m_header.num_vertices; }
+        size_t num_tets()     const { return (size_t)m_header.num_tets; }
+
+        const double  * positions()  const { return (const double *)_section(0); }
+        const int32_t * vertex_ids() const { return (const int32_t *)_section(1); }
+        const int32_t * tets()       const { return (const int32_t *)_section(2); }
+        const int32_t * tet_ids()    const { return (const int32_t *)_section(3); }
+
+    protected:
+        const char * _section(int i) const
+        {
+            return m_ok ? m_file.begin() + m_header.offset[i] : NULL;
+        }
+
+        CMappedFile m_file;
+        CTmvHeader  m_header;
+        bool        m_ok = false;
+    };
+
+    /*!
+     *  \brief CTmvWriter class, writes the sections of a .tmv file piece by piece
+     *
+     *  The layout follows from the counts given to open(), so the sections
+     *  can be filled in any order and in parts, for meshes that are never
+     *  in memory at once.
+     */
+    class CTmvWriter
+    {
+    public:
+        ~CTmvWriter() { if (m_fp) close(); }
+
+        /*! create the file and write the header */
+        bool open(const std::string & filename, size_t num_vertices, size_t num_tets)
+        {
+            m_filename = filename;
+            m_fp = fopen(filename.c_str(), "wb");
+            if (m_fp == NULL) return false;
+
+            m_header = CTmvHeader();
+            m_header.num_vertices = num_vertices;
+            m_header.num_tets = num_tets;
+            const uint64_t sizes[4] = { 24 * (uint64_t)num_vertices, 4 * (uint64_t)num_vertices, 16 * (uint64_t)num_tets, 4 * (uint64_t)num_tets };
+            uint64_t pos = (sizeof(CTmvHeader) + 15) & ~(uint64_t)15;
+            for (int i = 0; i < 4; i++)
+            {
+                m_header.offset[i] = pos;
+                pos = (pos + sizes[i] + 15) & ~(uint64_t)15;
+            }
+            m_end = m_header.offset[3] + sizes[3];
+            m_written = sizeof(CTmvHeader);
+            m_ok = fwrite(&m_header, sizeof(CTmvHeader), 1, m_fp) == 1;
+            return m_ok;
+        }
+
+        /*!
+         *  Write bytes into a section
+         *  \param section 0 positions, 1 vertex ids, 2 tets, 3 tet ids
+         *  \param offset byte offset inside the section
+         */
+        bool write(int section, uint64_t offset, const void * data, size_t bytes)
+        {
+            if (!m_ok || bytes == 0) return m_ok;
+            const uint64_t pos = m_header.offset[section] + offset;
+            m_ok = _seek(pos) && fwrite(data, 1, bytes, m_fp) == bytes;
+            m_written = std::max(m_written, pos + bytes);
+            return m_ok;
+        }
+
+        /*! close the file, removing it if any write failed */
+        bool close()
+        {
+            if (m_fp == NULL) return false;
+            // the gaps read as zeros, the file still has to reach the end of the last section
+            static const char zero = 0;
+            if (m_ok && m_written < m_end) m_ok = _seek(m_end - 1) && fwrite(&zero, 1, 1, m_fp) == 1;
+            bool ok = (fclose(m_fp) == 0) && m_ok;
+            m_fp = NULL;
+            if (!ok) remove(m_filename.c_str());
+            return ok;
+        }
+
+        const CTmvHeader & header() const { return m_header; }
+
+    protected:
+        bool _seek(uint64_t pos)
+        {
+#ifdef _WIN32
+            return _fseeki64(m_fp, (__int64)pos, SEEK_SET) == 0;
+#else
+            return fseeko(m_fp, (off_t)pos, SEEK_SET) == 0;
+#endif
+        }
+
+        FILE *      m_fp = NULL;
+        std::string m_filename;
+        CTmvHeader  m_header;
+        uint64_t    m_end = 0;
+        uint64_t    m_written = 0;
+        bool        m_ok = false;
+    };
+
+    /*!
+     *  Write a .tmv file, the arrays are laid out as described above.
+     *  \return false if the file cannot be written
+     */
+    inline bool write_tmv_file(const std::string & filename, size_t num_vertices, size_t num_tets,
+        const double * positions, const int32_t * vertex_ids, const int32_t * tets, const int32_t * tet_ids)
+    {
+        CTmvWriter writer;
+        if (!writer.open(filename, num_vertices, num_tets)) return false;
+        writer.write(0, 0, positions, 24 * num_vertices);
+        writer.write(1, 0, vertex_ids, 4 * num_vertices);
+        writer.write(2, 0, tets, 16 * num_tets);
+        writer.write(3, 0, tet_ids, 4 * num_tets);
+        return writer.close();
+    }
+
+}; //namespace
+
+#endif
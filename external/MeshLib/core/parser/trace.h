@@ -0,0 +1,192 @@
+/*!
+*      \file trace.h
+*      \brief Scoped trace zones, written as a Chrome trace / Perfetto JSON file
+*
+*      MESHLIB_TRACE_ZONE("name") times the rest of its scope as a zone of the
+*      calling thread, the name a string literal. The zones are compiled in
+*      only with MESHLIB_TRACE defined, and recorded only between
+*      CTrace::start() and CTrace::stop(), so a build without it pays nothing
+*      and one with it a flag test per zone while not tracing. Every thread
+*      appends to a buffer of its own, write() turns each buffer into a track,
+*      named by MESHLIB_TRACE_THREAD("name"), in a file chrome://tracing and
+*      ui.perfetto.dev open.
+*/
+
+#ifndef _MESHLIB_TRACE_H_
+#define _MESHLIB_TRACE_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CTrace class, the zones of all threads since start()
+     */
+    class CTrace
+    {
+    public:
+        /*! drop the zones recorded so far and record from now on */
+        static void start()
+        {
+            CState & s = _state();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (auto & b : s.buffers)
+            {
+                std::lock_guard<std::mutex> hold(b->mutex);
+                b->events.clear();
+            }
+            s.recording.store(true, std::memory_order_release);
+        }
+        /*! stop recording, the zones running now are dropped */
+        static void stop() { _state().recording.store(false, std::memory_order_release); }
+        static bool recording() { return _state().recording.load(std::memory_order_relaxed); }
+
+        /*! the name of the track of the calling thread */
+        static void name_thread(const std::string & name)
+        {
+            CBuffer & b = _buffer();
+            std::lock_guard<std::mutex> lock(b.mutex);
+            b.name = name;
+        }
+
+        /*! nanoseconds since the first use of the trace */
+        static int64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _state().origin).count();
+        }
+
+        /*! a zone of the calling thread, name must outlive the trace */
+        static void record(const char * name, int64_t begin, int64_t end)
+        {
+            CBuffer & b = _buffer();
+            std::lock_guard<std::mutex> lock(b.mutex);
+            b.events.push_back(CEvent{ name, begin, end });
+        }
+
+        /*!
+         *  Write the zones recorded so far, complete events in microseconds
+         *  \return false if the file cannot be written
+         */
+        static bool write(const std::string & filename)
+        {
+            FILE * fp = fopen(filename.c_str(), "w");
+            if (!fp) return false;
+            CState & s = _state();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+            bool first = true;
+            for (size_t t = 0; t < s.buffers.size(); t++)
+            {
+                CBuffer & b = *s.buffers[t];
+                std::lock_guard<std::mutex> hold(b.mutex);
+                const std::string name = b.name.empty() ? "thread " + std::to_string(t) : b.name;
+                fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",", (int)t, _escape(name).c_str());
+                fprintf(fp, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}", (int)t, (int)t);
+                first = false;
+                for (const CEvent & e : b.events)
+                {
+                    fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                        _escape(e.name).c_str(), (int)t, e.begin * 1e-3, (e.end - e.begin) * 1e-3);
+                }
+            }
+            fprintf(fp, "\n]}\n");
+            return fclose(fp) == 0;
+        }
+
+        /*!
+         *  \brief CZone class, records its scope while the trace is recording
+         */
+        class CZone
+        {
+        public:
+            explicit CZone(const char * name) : m_name(name), m_begin(recording() ? now() : -1) {}
+            ~CZone()
+            {
+                if (m_begin >= 0 && recording()) record(m_name, m_begin, now());
+            }
+
+        protected:
+            const char * m_name;
+            int64_t      m_begin;
+        };
+
+    protected:
+        struct CEvent
+        {
+            const char * name;
+            int64_t      begin;
+            int64_t      end;
+        };
+
+        //! the zones of one thread, locked only against write()
+        struct CBuffer
+        {
+            std::mutex          mutex;
+            std::string         name;
+            std::vector<CEvent> events;
+        };
+
+        struct CState
+        {
+            std::mutex                            mutex;
+            std::vector<std::shared_ptr<CBuffer>> buffers;
+            std::atomic<bool>                     recording{ false };
+            std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        };
+
+        static CState & _state()
+        {
+            static CState * state = new CState();   //outlives the thread_local buffers
+            return *state;
+        }
+
+        /*! the buffer of the calling thread, kept by the state after the thread ends */
+        static CBuffer & _buffer()
+        {
+            static thread_local std::shared_ptr<CBuffer> buffer;
+            if (!buffer)
+            {
+                buffer = std::make_shared<CBuffer>();
+                CState & s = _state();
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.buffers.push_back(buffer);
+            }
+            return *buffer;
+        }
+
+        static std::string _escape(const std::string & text)
+        {
+            std::string out;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\') out += '\\';
+                out += c;
+            }
+            return out;
+        }
+    };
+
+}; //namespace
+
+#ifdef MESHLIB_TRACE
+#define MESHLIB_TRACE_CONCAT_(a, b) a##b
+#define MESHLIB_TRACE_CONCAT(a, b) MESHLIB_TRACE_CONCAT_(a, b)
+//! times the rest of the scope, name a string literal
+#define MESHLIB_TRACE_ZONE(name) MeshLib::CTrace::CZone MESHLIB_TRACE_CONCAT(meshlib_trace_zone_, __LINE__)(name)
+//! names the track of the calling thread
+#define MESHLIB_TRACE_THREAD(name) MeshLib::CTrace::name_thread(name)
+#else
+#define MESHLIB_TRACE_ZONE(name) ((void)0)
+#define MESHLIB_TRACE_THREAD(name) ((void)0)
+#endif
+
+#endif
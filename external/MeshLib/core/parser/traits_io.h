@@ -3,22 +3,23 @@
  *  \author David Gu
  *  \date   documented on 6/23/2011
  *
+ *  A trait is a column of the elements, rgb=(r g b) of the vertices say,
+ *  selected by its flag below. CTraitIO reads all the selected columns of an
+ *  element from one scan of its trait string, and writes them with one
+ *  rebuild of it, the elements in parallel. A column is typed by its
+ *  accessor, e.g. CVertex::uv(), and skipped by elements that lack it.
  */
 
 #ifndef _TRAITS_IO_H_
 #define _TRAITS_IO_H_
 
-#include <map>
 #include <vector>
+#include <complex>
+#include <utility>
 
-#include "mesh/mesh.h"
-#include "mesh/vertex.h"
-#include "mesh/halfedge.h"
-#include "mesh/edge.h"
-#include "mesh/face.h"
-#include "mesh/iterators.h"
-#include "mesh/boundary.h"
-#include "Parser/parser.h"
+#include "parser.h"
+#include "parallel.h"
+#include "traitstr.h"
 
 #define VERTEX_RGB     (0x01<<0)
 #define VERTEX_UV      (0x01<<1)
@@ -39,416 +40,216 @@
 
 namespace MeshLib
 {
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _write_vertex_uv(M * pMesh)
-    {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CPoint2 uv = pV->uv();
-
-            CParser parser(pV->string());
-            parser._removeToken("uv");
-
-            parser._toString(pV->string());
-
-            std::stringstream iss;
+    /*!
+     *  \brief CTraitColumn, the key and the accessor of the trait of a flag
+     */
+    template<int Flag> struct CTraitColumn;
 
-            iss << "uv=(" << uv[0] << " " << uv[1] << ")";
-
-            if (pV->string().size() > 0)
-            {
-                pV->string() += " ";
-            }
-            pV->string() += iss.str();
-        }
+    template<> struct CTraitColumn<VERTEX_RGB>
+    {
+        static const char * key() { return "rgb"; }
+        template<typename T> static auto at(T & e) -> decltype((e.rgb())) { return e.rgb(); }
     };
-
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_vertex_uv(M * pMesh)
+    template<> struct CTraitColumn<VERTEX_UV>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "uv")
-                {
-                    CPoint2 uv;
-                    token->m_value >> uv;
-                    pV->uv() = uv;
-                }
-            }
-        }
+        static const char * key() { return "uv"; }
+        template<typename T> static auto at(T & e) -> decltype((e.uv())) { return e.uv(); }
     };
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_vertex_z(M * pMesh)
+    template<> struct CTraitColumn<VERTEX_Z>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "z")
-                {
-                    CPoint2 uv;
-                    token->m_value >> uv;
-                    pV->z() = std::complex<double>(uv[0], uv[1]);
-                }
-            }
-        }
+        static const char * key() { return "z"; }
+        template<typename T> static auto at(T & e) -> decltype((e.z())) { return e.z(); }
     };
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_vertex_father(M * pMesh)
+    template<> struct CTraitColumn<VERTEX_MU>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "father")
-                {
-                    std::string line = strutil::trim(token->m_value, "()");
-                    pV->father() = strutil::parseString<int>(line);
-                }
-            }
-        }
+        static const char * key() { return "mu"; }
+        template<typename T> static auto at(T & e) -> decltype((e.mu())) { return e.mu(); }
     };
-
-
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_vertex_mu(M * pMesh)
+    template<> struct CTraitColumn<VERTEX_FATHER>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "mu")
-                {
-                    CPoint2 uv;
-                    token->m_value >> uv;
-                    pV->mu() = std::complex<double>(uv[0], uv[1]);
-                }
-            }
-        }
+        static const char * key() { return "father"; }
+        template<typename T> static auto at(T & e) -> decltype((e.father())) { return e.father(); }
     };
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_vertex_normal(M * pMesh)
+    template<> struct CTraitColumn<VERTEX_LAMBDA>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "normal")
-                {
-                    CPoint normal;
-                    token->m_value >> normal;
-                    pV->normal() = normal;
-                }
-            }
-        }
+        static const char * key() { return "lambda"; }
+        template<typename T> static auto at(T & e) -> decltype((e.lambda())) { return e.lambda(); }
     };
-
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_vertex_rgb(M * pMesh)
+    template<> struct CTraitColumn<VERTEX_NORMAL>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "rgb")
-                {
-                    CPoint rgb;
-                    token->m_value >> rgb;
-                    pV->rgb() = rgb;
-                }
-            }
-        }
+        static const char * key() { return "normal"; }
+        template<typename T> static auto at(T & e) -> decltype((e.normal())) { return e.normal(); }
     };
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_edge_length(M * pMesh)
+    template<> struct CTraitColumn<VERTEX_U>
     {
-        for (M::MeshEdgeIterator eiter(pMesh); !eiter.end(); eiter++)
-        {
-            E * pE = *eiter;
-
-            CParser parser(pE->string());
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "l")
-                {
-                    std::string line = strutil::trim(token->m_value, "()");
-                    pE->length() = strutil::parseString<double>(line);
-                }
-            }
-        }
+        static const char * key() { return "u"; }
+        template<typename T> static auto at(T & e) -> decltype((e.u())) { return e.u(); }
     };
-
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _read_edge_sharp(M * pMesh)
+    template<> struct CTraitColumn<EDGE_LENGTH>
     {
-        for (M::MeshEdgeIterator eiter(pMesh); !eiter.end(); eiter++)
-        {
-            E * pE = *eiter;
-
-            CParser parser(pE->string());
-            pE->sharp() = false;
-
-            for (std::list<CToken*>::iterator iter = parser.tokens().begin(); iter != parser.tokens().end(); ++iter)
-            {
-                CToken * token = *iter;
-                if (token->m_key == "sharp")
-                {
-                    pE->sharp() = true;
-                }
-            }
-        }
+        static const char * key() { return "l"; }
+        template<typename T> static auto at(T & e) -> decltype((e.length())) { return e.length(); }
     };
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _write_vertex_z(M * pMesh)
+    template<> struct CTraitColumn<EDGE_SHARP>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-            parser._removeToken("z");
-
-            parser._toString(pV->string());
-
-            std::stringstream iss;
-
-            iss << "z=(" << pV->z().real() << " " << pV->z().imag() << ")";
-
-            if (pV->string().size() > 0)
-            {
-                pV->string() += " ";
-            }
-            pV->string() += iss.str();
-        }
+        static const char * key() { return "sharp"; }
+        template<typename T> static auto at(T & e) -> decltype((e.sharp())) { return e.sharp(); }
     };
-
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _write_vertex_mu(M * pMesh)
+    template<> struct CTraitColumn<EDGE_DU>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CParser parser(pV->string());
-            parser._removeToken("mu");
-
-            parser._toString(pV->string());
-
-            std::stringstream iss;
-
-            iss << "mu=(" << pV->mu().real() << " " << pV->mu().imag() << ")";
-
-            if (pV->string().size() > 0)
-            {
-                pV->string() += " ";
-            }
-            pV->string() += iss.str();
-        }
+        static const char * key() { return "du"; }
+        template<typename T> static auto at(T & e) -> decltype((e.du())) { return e.du(); }
     };
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _write_vertex_u(M * pMesh)
+    template<> struct CTraitColumn<EDGE_DUV>
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CPoint rgb = pV->rgb();
-
-            CParser parser(pV->string());
-            parser._removeToken("u");
-            parser._toString(pV->string());
-            CPoint u = pV->u();
-            std::stringstream iss;
-            iss << "u=(" << u[0] << " " << u[1] << " " << u[2] << ")";
-
-            if (pV->string().size() > 0)
-            {
-                pV->string() += " ";
-            }
-            pV->string() += iss.str();
-        }
+        static const char * key() { return "duv"; }
+        template<typename T> static auto at(T & e) -> decltype((e.duv())) { return e.duv(); }
     };
+    template<> struct CTraitColumn<FACE_RGB> : CTraitColumn<VERTEX_RGB> {};
+    template<> struct CTraitColumn<FACE_NORMAL> : CTraitColumn<VERTEX_NORMAL> {};
 
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _write_vertex_rgb(M * pMesh)
+    /*!
+     *  \brief CTraitIO class, reads and writes the flagged traits of a CBaseMesh
+     *
+     *  The values are parsed by CNumParser and printed by CFormatBuffer, a
+     *  flag without a value such as `sharp` is a bool. Tokens of other keys,
+     *  and of columns an element has no accessor for, are kept as they are.
+     */
+    template<typename M>
+    class CTraitIO
     {
-        for (M::MeshVertexIterator viter(pMesh); !viter.end(); viter++)
-        {
-            V * pV = *viter;
-            CPoint rgb = pV->rgb();
-
-            CParser parser(pV->string());
-            parser._removeToken("rgb");
+    public:
+        using CVertex = typename M::CVertex;
+        using CEdge = typename M::CEdge;
+        using CFace = typename M::CFace;
 
-            parser._toString(pV->string());
-
-            std::stringstream iss;
-
-            iss << "rgb=(" << rgb[0] << " " << rgb[1] << " " << rgb[2] << ")";
-
-            if (pV->string().size() > 0)
+        /*! set the flagged traits of all elements from their strings, absent ones are left alone */
+        static void read(M & mesh, unsigned long long flags, int threads = 0)
+        {
+            _each(mesh.vertices().data(), threads, [flags](CVertex * v, CTraitWriter &)
             {
-                pV->string() += " ";
-            }
-            pV->string() += iss.str();
+                _read<VERTEX_RGB, VERTEX_UV, VERTEX_Z, VERTEX_MU, VERTEX_FATHER, VERTEX_LAMBDA, VERTEX_NORMAL, VERTEX_U>(*v, flags);
+            });
+            _each(mesh.edges().data(), threads, [flags](CEdge * e, CTraitWriter &)
+            {
+                _read<EDGE_LENGTH, EDGE_SHARP, EDGE_DU, EDGE_DUV>(*e, flags);
+            });
+            _each(mesh.faces().data(), threads, [flags](CFace * f, CTraitWriter &)
+            {
+                _read<FACE_RGB, FACE_NORMAL>(*f, flags);
+            });
         }
-    };
 
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _write_edge_sharp(M * pMesh)
-    {
-        for (M::MeshEdgeIterator eiter(pMesh); !eiter.end(); eiter++)
+        /*! replace the flagged traits in the strings of all elements by their values */
+        static void write(M & mesh, unsigned long long flags, int threads = 0)
         {
-            E * pE = *eiter;
-            CParser parser(pE->string());
-            parser._removeToken("sharp");
-            parser._toString(pE->string());
-
-            std::string line;
-            std::stringstream iss(line);
-            if (pE->sharp())
+            _each(mesh.vertices().data(), threads, [flags](CVertex * v, CTraitWriter & writer)
             {
-                iss << "sharp";
-            }
-            if (pE->string().length() > 0)
+                _write<VERTEX_RGB, VERTEX_UV, VERTEX_Z, VERTEX_MU, VERTEX_FATHER, VERTEX_LAMBDA, VERTEX_NORMAL, VERTEX_U>(*v, flags, writer);
+            });
+            _each(mesh.edges().data(), threads, [flags](CEdge * e, CTraitWriter & writer)
             {
-                pE->string() += " ";
-            }
-            pE->string() += iss.str();
-
-        };
-    };
-
-
-
-
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _write_edge_du(M * pMesh)
-    {
-        for (M::MeshEdgeIterator eiter(pMesh); !eiter.end(); eiter++)
-        {
-            E * pE = *eiter;
-            CParser parser(pE->string());
-            parser._removeToken("du");
-
-            parser._toString(pE->string());
-
-            std::stringstream iss;
-
-            iss << "du=(" << pE->du() << ")";
-
-            if (pE->string().size() > 0)
+                _write<EDGE_LENGTH, EDGE_SHARP, EDGE_DU, EDGE_DUV>(*e, flags, writer);
+            });
+            _each(mesh.faces().data(), threads, [flags](CFace * f, CTraitWriter & writer)
             {
-                pE->string() += " ";
-            }
-            pE->string() += iss.str();
+                _write<FACE_RGB, FACE_NORMAL>(*f, flags, writer);
+            });
         }
-    };
-
 
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _input_traits(M * pMesh)
-    {
-        if (M->m_input_traits |= VERTEX_UV)
+    protected:
+        /*! fn(t, writer) for the elements, a writer per block */
+        template<typename T, typename Fn>
+        static void _each(const std::vector<T*> & data, int threads, Fn fn)
         {
-            _read_vertex_uv<M, V, E, F, H>(pMesh);
+            parallel_for(data.size(), threads, [&](size_t b, size_t e)
+            {
+                CTraitWriter writer;
+                for (size_t i = b; i < e; i++) if (data[i]) fn(data[i], writer);
+            }, 1 << 12);
         }
 
-        if (M->m_input_traits |= VERTEX_NORMAL)
+        template<int... Flag, typename Elem>
+        static void _read(Elem & e, unsigned long long flags)
         {
-            _read_vertex_normal<M, V, E, F, H>(pMesh);
+            // a bool is false unless its key is there
+            int cleared[] = { 0, ((flags & Flag) ? _clear<Flag>(e, 0) : 0)... };
+            (void)cleared;
+            const CTraitString & str = e.trait_string();
+            CTraitParser parser(str.data(), str.data() + str.size());
+            CTraitToken token;
+            while (parser.next(token))
+            {
+                int read[] = { 0, ((flags & Flag) && token.is(CTraitColumn<Flag>::key()) ? _scan<Flag>(e, token, 0) : 0)... };
+                (void)read;
+            }
         }
 
-        if (M->m_input_traits |= VERTEX_RGB)
+        template<int... Flag, typename Elem>
+        static void _write(Elem & e, unsigned long long flags, CTraitWriter & writer)
         {
-            _read_vertex_rgb(pMesh);
+            writer.reset_if(e.string(), [&e, flags](const CTraitToken & token)
+            {
+                bool drop = false;
+                int owned[] = { 0, (drop = drop || ((flags & Flag) && _has<Flag>(e, 0) && token.is(CTraitColumn<Flag>::key())), 0)... };
+                (void)owned;
+                return drop;
+            });
+            int printed[] = { 0, ((flags & Flag) ? _print<Flag>(e, writer, 0) : 0)... };
+            (void)printed;
+            writer.assign(e.string());
         }
 
-        if (M->m_input_traits |= EDGE_LENGTH)
-        {
-            _read_edge_length(pMesh);
-        }
+        // the columns of an element, the overloads taking long are for elements without the accessor
+        template<int Flag, typename Elem>
+        static auto _has(Elem & e, int) -> decltype(CTraitColumn<Flag>::at(e), bool()) { return true; }
+        template<int Flag, typename Elem>
+        static bool _has(Elem &, long) { return false; }
 
-        if (M->m_input_traits |= EDGE_SHARP)
-        {
-            _read_edge_sharp(pMesh);
-        }
+        template<int Flag, typename Elem>
+        static auto _clear(Elem & e, int) -> decltype(CTraitColumn<Flag>::at(e), int()) { _value_clear(CTraitColumn<Flag>::at(e)); return 0; }
+        template<int Flag, typename Elem>
+        static int _clear(Elem &, long) { return 0; }
 
-    };
+        template<int Flag, typename Elem>
+        static auto _scan(Elem & e, const CTraitToken & token, int) -> decltype(CTraitColumn<Flag>::at(e), int()) { _value_scan(token, CTraitColumn<Flag>::at(e)); return 0; }
+        template<int Flag, typename Elem>
+        static int _scan(Elem &, const CTraitToken &, long) { return 0; }
 
-    template<typename M, typename V, typename E, typename F, typename H>
-    void _output_traits(M * pMesh)
-    {
-        if (M->m_m_output_traits |= VERTEX_UV)
-        {
-            _write_vertex_uv<M, V, E, F, H>(pMesh);
-        }
+        template<int Flag, typename Elem>
+        static auto _print(Elem & e, CTraitWriter & writer, int) -> decltype(CTraitColumn<Flag>::at(e), int()) { _value_print(writer, CTraitColumn<Flag>::key(), CTraitColumn<Flag>::at(e)); return 0; }
+        template<int Flag, typename Elem>
+        static int _print(Elem &, CTraitWriter &, long) { return 0; }
 
-        if (M->m_m_output_traits |= VERTEX_MU)
-        {
-            _write_vertex_mu<M, V, E, F, H>(pMesh);
-        }
+        // the value types
+        template<typename T> static void _value_clear(T &) {}
+        static void _value_clear(bool & v) { v = false; }
 
-        if (M->m_m_output_traits |= VERTEX_RGB)
+        static void _value_scan(const CTraitToken & token, double & v) { token.numbers(&v, 1); }
+        static void _value_scan(const CTraitToken & token, int & v) { token.number(v); }
+        static void _value_scan(const CTraitToken & token, bool & v) { v = true; }
+        static void _value_scan(const CTraitToken & token, CPoint & v)
         {
-            _write_vertex_rgb<M, V, E, F, H>(pMesh);
+            double c[3];
+            if (token.numbers(c, 3)) v = CPoint(c[0], c[1], c[2]);
         }
-
-        if (M->m_m_output_traits |= VERTEX_U)
+        static void _value_scan(const CTraitToken & token, CPoint2 & v)
         {
-            _write_vertex_u<M, V, E, F, H>(pMesh);
+            double c[2];
+            if (token.numbers(c, 2)) v = CPoint2(c[0], c[1]);
         }
-
-        if (M->m_m_output_traits |= EDGE_DU)
+        static void _value_scan(const CTraitToken & token, std::complex<double> & v)
         {
-            _write_edge_du<M, V, E, F, H>(pMesh);
+            double c[2];
+            if (token.numbers(c, 2)) v = std::complex<double>(c[0], c[1]);
         }
 
-        if (M->m_m_output_traits |= EDGE_SHARP)
-        {
-            _write_edge_sharp<M, V, E, F, H>(pMesh);
-        }
+        template<typename T>
+        static void _value_print(CTraitWriter & writer, const char * key, const T & v) { writer.add(key, v); }
+        static void _value_print(CTraitWriter & writer, const char * key, bool v) { if (v) writer.flag(key); }
+        static void _value_print(CTraitWriter & writer, const char * key, const std::complex<double> & v) { writer.add(key, CPoint2(v.real(), v.imag())); }
     };
 
 }
 
-#endif  _TRAITS_IO_H_
+#endif  //_TRAITS_IO_H_
@@ -0,0 +1,101 @@
+/*!
+*      \file traitstr.h
+*      \brief Trait strings that stay in the mapped input file until they are used
+*/
+
+#ifndef _MESHLIB_TRAITSTR_H_
+#define _MESHLIB_TRAITSTR_H_
+
+#include <string>
+#include <set>
+#include <cstring>
+#include <cstdint>
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CTraitString class, the trait string of a mesh element
+     *
+     *  read_m only records where the trait text is in the mapped file, the
+     *  std::string is built when str() is first called. The mapping has to
+     *  outlive the element, CBaseMesh keeps it for that.
+     */
+    class CTraitString
+    {
+    public:
+        /*! the trait string, built from the file on first access */
+        std::string & str()
+        {
+            if (m_view)
+            {
+                m_string.assign(m_view, m_size);
+                m_view = NULL;
+            }
+            return m_string;
+        }
+
+        /*! refer to n bytes at b instead of holding a copy */
+        void view(const char * b, size_t n)
+        {
+            m_string.clear();
+            m_view = n ? b : NULL;
+            m_size = (uint32_t)n;
+        }
+
+        /*! length of the trait text, without building the string */
+        size_t size() const { return m_view ? m_size : m_string.size(); }
+        /*! the trait text, in the file or in the string, size() characters */
+        const char * data() const { return m_view ? m_view : m_string.data(); }
+        /*! bytes on the heap, none for text left in the file or short enough to fit the string itself */
+        size_t memory() const
+        {
+            static const size_t local = std::string().capacity();
+            return m_string.capacity() > local ? m_string.capacity() + 1 : 0;
+        }
+
+        /*!
+         *  Keep only the traits named in `keys` of the `key=value` list [b, e),
+         *  a value is a word or a parenthesized group
+         */
+        static std::string select(const char * b, const char * e, const std::set<std::string> & keys)
+        {
+            std::string out;
+            const char * p = b;
+            while (p < e)
+            {
+                while (p < e && (*p == ' ' || *p == '\t')) p++;
+                if (p >= e) break;
+
+                const char * kb = p;
+                while (p < e && *p != '=' && *p != ' ' && *p != '\t') p++;
+                const char * ke = p;
+                if (p < e && *p == '=')
+                {
+                    p++;
+                    if (p < e && *p == '(')
+                    {
+                        const char * q = (const char *)memchr(p, ')', (size_t)(e - p));
+                        p = q ? q + 1 : e;
+                    }
+                    while (p < e && *p != ' ' && *p != '\t') p++;
+                }
+
+                if (keys.count(std::string(kb, ke)))
+                {
+                    if (!out.empty()) out += ' ';
+                    out.append(kb, p);
+                }
+            }
+            return out;
+        }
+
+    protected:
+        std::string  m_string;
+        const char * m_view = NULL;
+        uint32_t     m_size = 0;
+    };
+
+}; //namespace
+
+#endif
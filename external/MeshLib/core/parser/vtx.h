@@ -0,0 +1,212 @@
+/*!
+*      \file vtx.h
+*      \brief Tiled mip chain of a virtual texture (.vtx)
+*
+*      A versioned, little endian file of equally sized tiles meant to be
+*      mapped into memory and read tile by tile:
+*
+*          CVtxHeader
+*          level 0     grid_width(0) x grid_height(0) tiles, a row of tiles after the other
+*          level 1     the level of half the size, rounded down, at least 1
+*          ...
+*
+*      A tile is (tile + 2 border)^2 RGBA8 texels, rows in upload order. The
+*      border repeats the texels of the neighbouring tiles, clamped at the
+*      edge of the level, so a tile can be filtered on its own. The tiles
+*      start on a 16 byte boundary.
+*/
+
+#ifndef _MESHLIB_VTX_H_
+#define _MESHLIB_VTX_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "mmap.h"
+#include "parallel.h"
+#include "../Geometry/TextureCompressor.h"
+
+#define VTX_VERSION 1
+
+#define VTX_MAX_LEVELS 32
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CVtxHeader, the first bytes of a .vtx file
+     */
+    struct CVtxHeader
+    {
+        char     magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t tile;
+        uint32_t border;
+        uint32_t levels;
+        uint32_t reserved;
+        /*! index of the first tile of every level */
+        uint64_t first[VTX_MAX_LEVELS];
+        /*! byte offset of tile 0 */
+        uint64_t data;
+
+        CVtxHeader()
+        {
+            memcpy(magic, "VTX\x1a", 4);
+            version = VTX_VERSION;
+            width = height = 0;
+            tile = border = 0;
+            levels = 0;
+            reserved = 0;
+            for (int i = 0; i < VTX_MAX_LEVELS; i++) first[i] = 0;
+            data = 0;
+        }
+
+        bool valid() const
+        {
+            return memcmp(magic, "VTX\x1a", 4) == 0 && version == VTX_VERSION &&
+                levels > 0 && levels <= VTX_MAX_LEVELS && tile > 0 && width > 0 && height > 0;
+        }
+
+        /*! texels of level l */
+        uint32_t level_width(int l) const { return std::max(1u, width >> l); }
+        uint32_t level_height(int l) const { return std::max(1u, height >> l); }
+        /*! tiles of level l */
+        uint32_t grid_width(int l) const { return (level_width(l) + tile - 1) / tile; }
+        uint32_t grid_height(int l) const { return (level_height(l) + tile - 1) / tile; }
+        /*! bytes of a tile with its border */
+        size_t tile_bytes() const { return (size_t)4 * (tile + 2 * border) * (tile + 2 * border); }
+        uint64_t num_tiles() const { return first[levels - 1] + (uint64_t)grid_width(levels - 1) * grid_height(levels - 1); }
+
+        /*! lays out the levels of a width x height texture, down to the first that fits in one tile */
+        void layout(uint32_t w, uint32_t h, uint32_t t, uint32_t b)
+        {
+            width = w;
+            height = h;
+            tile = t;
+            border = b;
+            levels = 0;
+            uint64_t n = 0;
+            while (levels < VTX_MAX_LEVELS)
+            {
+                first[levels] = n;
+                n += (uint64_t)grid_width(levels) * grid_height(levels);
+                levels++;
+                if (grid_width(levels - 1) == 1 && grid_height(levels - 1) == 1) break;
+            }
+            data = (sizeof(CVtxHeader) + 15) & ~(uint64_t)15;
+        }
+    };
+
+    /*!
+     *  \brief CVtxFile class, a mapped, read-only .vtx file
+     */
+    class CVtxFile
+    {
+    public:
+        CVtxFile() {}
+        CVtxFile(const std::string & filename) { open(filename); }
+
+        bool open(const std::string & filename)
+        {
+            m_ok = false;
+            if (!m_file.open(filename)) return false;
+            if (m_file.size() < sizeof(CVtxHeader)) { m_file.close(); return false; }
+
+            memcpy(&m_header, m_file.begin(), sizeof(CVtxHeader));
+            if (!m_header.valid() || m_header.data < sizeof(CVtxHeader) ||
+                m_header.data + m_header.num_tiles() * m_header.tile_bytes() > m_file.size())
+            {
+                m_file.close();
+                return false;
+            }
+            m_ok = true;
+            return true;
+        }
+
+        void close() { m_file.close(); m_ok = false; }
+        bool is_open() const { return m_ok; }
+
+        const CVtxHeader & header() const { return m_header; }
+
+        /*! texels of tile i, tiles are numbered level by level, row by row */
+        const uint8_t * tile(uint64_t i) const
+        {
+            return m_ok ? (const uint8_t *)m_file.begin() + m_header.data + i * m_header.tile_bytes() : NULL;
+        }
+
+    protected:
+        CMappedFile m_file;
+        CVtxHeader  m_header;
+        bool        m_ok = false;
+    };
+
+    /*!
+     *  Cut an RGBA8 image and its mip chain into tiles and write them
+     *  \param rgba     width x height texels, rows in upload order
+     *  \param tile     texels of a tile without its border
+     *  \param border   texels repeated on every side
+     *  \return false if the file cannot be written
+     */
+    inline bool write_vtx_file(const std::string & filename, const uint8_t * rgba, uint32_t width, uint32_t height,
+        uint32_t tile = 128, uint32_t border = 1, int threads = 0)
+    {
+        if (!rgba || width == 0 || height == 0 || tile == 0) return false;
+        FILE * fp = fopen(filename.c_str(), "wb");
+        if (fp == NULL) return false;
+
+        CVtxHeader header;
+        header.layout(width, height, tile, border);
+        bool ok = fwrite(&header, sizeof(CVtxHeader), 1, fp) == 1;
+        static const char zeros[16] = { 0 };
+        ok = ok && fwrite(zeros, 1, (size_t)(header.data - sizeof(CVtxHeader)), fp) == header.data - sizeof(CVtxHeader);
+
+        // one row of tiles at a time, every level made from the one before
+        const int side = (int)(tile + 2 * border);
+        const size_t bytes = header.tile_bytes();
+        std::vector<uint8_t> row, level, next;
+        const uint8_t * src = rgba;
+        for (int l = 0; l < (int)header.levels && ok; l++)
+        {
+            const int w = (int)header.level_width(l), h = (int)header.level_height(l);
+            const int gw = (int)header.grid_width(l);
+            row.resize(bytes * gw);
+            for (int ty = 0; ty < (int)header.grid_height(l) && ok; ty++)
+            {
+                parallel_for((size_t)gw, threads, [&](size_t b, size_t e)
+                {
+                    for (size_t tx = b; tx < e; tx++)
+                    {
+                        uint8_t * out = row.data() + bytes * tx;
+                        for (int y = 0; y < side; y++)
+                        {
+                            const int sy = std::max(0, std::min(h - 1, ty * (int)tile + y - (int)border));
+                            for (int x = 0; x < side; x++)
+                            {
+                                const int sx = std::max(0, std::min(w - 1, (int)tx * (int)tile + x - (int)border));
+                                memcpy(out + 4 * (side * y + x), src + 4 * ((size_t)w * sy + sx), 4);
+                            }
+                        }
+                    }
+                }, 4);
+                ok = fwrite(row.data(), 1, row.size(), fp) == row.size();
+            }
+            if (l + 1 == (int)header.levels) break;
+            CTextureCompressor::downsample(src, w, h, next, threads);
+            level.swap(next);
+            src = level.data();
+        }
+
+        ok = (fclose(fp) == 0) && ok;
+        if (!ok) remove(filename.c_str());
+        return ok;
+    }
+
+}; //namespace
+
+#endif
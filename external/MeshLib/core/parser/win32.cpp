@@ -0,0 +1,102 @@
+#ifdef _WIN32
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <algorithm>
+
+#include "win32.h"
+
+namespace MeshLib
+{
+    namespace win32
+    {
+        bool map_file(const char * filename, void *& file, void *& mapping, const char *& data, size_t & size)
+        {
+            file = mapping = NULL;
+            data = NULL;
+            size = 0;
+            HANDLE f = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            if (f == INVALID_HANDLE_VALUE) return false;
+
+            LARGE_INTEGER bytes;
+            if (!GetFileSizeEx(f, &bytes)) { CloseHandle(f); return false; }
+            if (bytes.QuadPart == 0)
+            {
+                file = f;
+                return true;
+            }
+
+            HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+            const char * p = m ? (const char *)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0) : NULL;
+            if (p == NULL)
+            {
+                unmap_file(f, m, NULL);
+                return false;
+            }
+            file = f;
+            mapping = m;
+            data = p;
+            size = (size_t)bytes.QuadPart;
+            return true;
+        }
+
+        void unmap_file(void * file, void * mapping, const char * data)
+        {
+            if (data) UnmapViewOfFile(data);
+            if (mapping) CloseHandle(mapping);
+            if (file) CloseHandle(file);
+        }
+
+        size_t page_size()
+        {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return (size_t)info.dwPageSize;
+        }
+
+        void * map_pages(size_t bytes, bool large, size_t chunk, size_t & length)
+        {
+            if (large)
+            {
+                const size_t page = GetLargePageMinimum();
+                if (page == 0) return NULL;
+                length = (bytes + page - 1) / page * page;
+                return VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            }
+            const size_t page = page_size();
+            length = (bytes + page - 1) / page * page;
+            ULONG highest = 0;
+            if (chunk == 0 || !GetNumaHighestNodeNumber(&highest) || highest == 0)
+                return VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+            // the address range first, then its runs committed on the nodes in turn
+            char * block = (char *)VirtualAlloc(NULL, length, MEM_RESERVE, PAGE_READWRITE);
+            if (block == NULL) return NULL;
+            for (size_t at = 0, run = 0; at < length; at += chunk, run++)
+            {
+                const size_t n = std::min(chunk, length - at);
+                if (!VirtualAllocExNuma(GetCurrentProcess(), block + at, n, MEM_COMMIT, PAGE_READWRITE, (DWORD)(run % (highest + 1))))
+                {
+                    VirtualFree(block, 0, MEM_RELEASE);
+                    return NULL;
+                }
+            }
+            return block;
+        }
+
+        void unmap_pages(void * block)
+        {
+            VirtualFree(block, 0, MEM_RELEASE);
+        }
+
+        bool replace_file(const char * from, const char * to)
+        {
+            return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+        }
+    };
+};
+
+#endif
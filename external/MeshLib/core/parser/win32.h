@@ -0,0 +1,52 @@
+/*!
+*      \file win32.h
+*      \brief The Win32 calls of the parsers, as functions of their own
+*
+*      windows.h defines near, far, min, max, ERROR, DIFFERENCE and many more
+*      as macros. Included by a header it would reach every includer of
+*      mesh.h, so only win32.cpp includes it, which a Windows build compiles
+*      along with MeshLib, and the handles are passed around as void *.
+*/
+
+#ifndef _MESHLIB_WIN32_H_
+#define _MESHLIB_WIN32_H_
+
+#ifdef _WIN32
+
+#include <cstddef>
+
+namespace MeshLib
+{
+    namespace win32
+    {
+        /*!
+         *  Map a file read-only
+         *  \param file, mapping its handles for unmap_file, mapping NULL for an empty file
+         *  \param data its first byte, NULL for an empty file
+         *  \return false if it cannot be opened or mapped, nothing is left open then
+         */
+        bool map_file(const char * filename, void *& file, void *& mapping, const char *& data, size_t & size);
+        /*! unmap and close what map_file opened, any of them NULL */
+        void unmap_file(void * file, void * mapping, const char * data);
+
+        /*! bytes of a page of the system */
+        size_t page_size();
+        /*!
+         *  Committed pages of at least bytes, see CPages
+         *  \param large   on large pages, which need the lock pages privilege, NULL without it
+         *  \param chunk   committed round robin over the NUMA nodes in runs of chunk bytes, 0 for
+         *                 wherever the first thread to touch a page runs, not with large
+         *  \param length  the bytes mapped
+         */
+        void * map_pages(size_t bytes, bool large, size_t chunk, size_t & length);
+        /*! give back a block of map_pages */
+        void unmap_pages(void * block);
+
+        /*! move from over to, replacing it in one step, written through to the disk */
+        bool replace_file(const char * from, const char * to);
+    };
+};
+
+#endif
+
+#endif
@@ -0,0 +1,190 @@
+/*!
+*      \file writer.h
+*      \brief Buffered, block parallel text writer for the mesh formats
+*
+*      Records are formatted into per-thread buffers, block after block, and
+*      the buffers are written in record order with a few large writes. The
+*      text equals what std::ostream produces with its default flags: doubles
+*      as "%g" with 6 significant digits, integers in decimal.
+*/
+
+#ifndef _MESHLIB_WRITER_H_
+#define _MESHLIB_WRITER_H_
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+#endif
+
+#include "../Geometry/Point.h"
+#include "../Geometry/Point2.h"
+#include "parallel.h"
+
+namespace MeshLib
+{
+
+    /*!
+     *  \brief CFormatBuffer class, an append-only text buffer with stream-like formatting
+     */
+    class CFormatBuffer
+    {
+    public:
+        void clear() { m_data.clear(); }
+        const char * data() const { return m_data.data(); }
+        size_t size() const { return m_data.size(); }
+        /*! append the characters [b, e) */
+        void append(const char * b, const char * e) { m_data.append(b, e); }
+
+        CFormatBuffer & operator<<(char c) { m_data.push_back(c); return *this; }
+        CFormatBuffer & operator<<(const char * s) { m_data.append(s); return *this; }
+        CFormatBuffer & operator<<(const std::string & s) { m_data.append(s); return *this; }
+
+        CFormatBuffer & operator<<(int v) { return _signed(v); }
+        CFormatBuffer & operator<<(long v) { return _signed(v); }
+        CFormatBuffer & operator<<(long long v) { return _signed(v); }
+        CFormatBuffer & operator<<(unsigned v) { return _unsigned(v); }
+        CFormatBuffer & operator<<(unsigned long v) { return _unsigned(v); }
+        CFormatBuffer & operator<<(unsigned long long v) { return _unsigned(v); }
+
+        /*! same text as std::ostream << v with the default precision 6 */
+        CFormatBuffer & operator<<(double v)
+        {
+            char buffer[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+            if (v == v && v - v == 0)
+            {
+                char * e = std::to_chars(buffer, buffer + sizeof(buffer), v, std::chars_format::general, 6).ptr;
+                m_data.append(buffer, e);
+                return *this;
+            }
+#endif
+            int n = snprintf(buffer, sizeof(buffer), "%g", v);
+            m_data.append(buffer, (size_t)n);
+            return *this;
+        }
+
+        /*! the shortest text that reads back as v, for binary to text conversions that lose nothing */
+        CFormatBuffer & exact(double v)
+        {
+            char buffer[32];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+            if (v == v && v - v == 0)
+            {
+                char * e = std::to_chars(buffer, buffer + sizeof(buffer), v).ptr;
+                m_data.append(buffer, e);
+                return *this;
+            }
+#endif
+            int n = snprintf(buffer, sizeof(buffer), "%.17g", v);
+            m_data.append(buffer, (size_t)n);
+            return *this;
+        }
+
+        CFormatBuffer & operator<<(const CPoint & p) { return *this << p[0] << ' ' << p[1] << ' ' << p[2]; }
+        CFormatBuffer & operator<<(const CPoint2 & p) { return *this << p[0] << ' ' << p[1]; }
+
+    protected:
+        template<typename T>
+        CFormatBuffer & _signed(T v)
+        {
+            if (v < 0)
+            {
+                m_data.push_back('-');
+                return _unsigned((unsigned long long)0 - (unsigned long long)v);
+            }
+            return _unsigned((unsigned long long)v);
+        }
+
+        template<typename T>
+        CFormatBuffer & _unsigned(T v)
+        {
+            char buffer[24];
+            char * e = buffer + sizeof(buffer);
+            char * p = e;
+            unsigned long long u = (unsigned long long)v;
+            do {
+                *--p = (char)('0' + u % 10);
+                u /= 10;
+            } while (u);
+            m_data.append(p, e);
+            return *this;
+        }
+
+        std::string m_data;
+    };
+
+    /*!
+     *  \brief CTextWriter class, writes a text file from formatted blocks
+     *
+     *  The file is opened in text mode, like std::fstream, so the line endings
+     *  match the stream writers on every platform.
+     */
+    class CTextWriter
+    {
+    public:
+        CTextWriter(const std::string & filename) { m_fp = fopen(filename.c_str(), "w"); }
+        ~CTextWriter() { close(); }
+
+        CTextWriter(const CTextWriter &) = delete;
+        CTextWriter & operator=(const CTextWriter &) = delete;
+
+        bool is_open() const { return m_fp != NULL; }
+
+        /*! close the file, false if any write failed */
+        bool close()
+        {
+            if (m_fp && fclose(m_fp) != 0) m_ok = false;
+            m_fp = NULL;
+            return m_ok;
+        }
+
+        void write(const CFormatBuffer & buffer)
+        {
+            if (m_fp && buffer.size() && fwrite(buffer.data(), 1, buffer.size(), m_fp) != buffer.size()) m_ok = false;
+        }
+
+        /*!
+         *  Write n records, fn(i, buffer) formats record i into buffer.
+         *  \param threads number of workers, 0 uses all hardware threads
+         */
+        template<typename Fn>
+        void records(size_t n, int threads, Fn fn)
+        {
+            threads = resolve_threads(threads);
+            threads = (int)std::min<size_t>(threads, std::max<size_t>(1, n / s_block_size));
+            if ((int)m_buffers.size() < threads) m_buffers.resize(threads);
+
+            // one block per worker at a time keeps the buffers bounded
+            for (size_t begin = 0; begin < n; begin += threads * s_block_size)
+            {
+                parallel_run(threads, [&](int t)
+                {
+                    CFormatBuffer & b = m_buffers[t];
+                    b.clear();
+                    size_t first = begin + t * s_block_size;
+                    size_t last = std::min(n, first + s_block_size);
+                    for (size_t i = first; i < last; i++) fn(i, b);
+                });
+                for (int t = 0; t < threads; t++) write(m_buffers[t]);
+            }
+        }
+
+    protected:
+        //! records formatted by a worker at a time
+        static const size_t s_block_size = 1 << 15;
+
+        FILE * m_fp = NULL;
+        bool   m_ok = true;
+        std::vector<CFormatBuffer> m_buffers;
+    };
+
+}; //namespace
+
+#endif
@@ -0,0 +1,261 @@
+// Compares a candidate benchmark run against a baseline, e.g.
+//   bench_compare --baseline before.json --candidate after.json
+//   bench_compare --baseline a1.csv --baseline a2.csv --candidate b1.csv --candidate b2.csv
+// The inputs are the JSON of bench_mesh --json, {"benchmarks": [{"name",
+// "unit", "higher_is_better", "samples": [...]}]}, the CSV of Qt_app1
+// --startup, the stages from launch to the first complete frame, one launch
+// a file, and the CSV of Qt_app1 --path-log, the frame, CPU and GPU times of
+// a camera path. The samples of the files of a side are pooled by name.
+//
+// Every benchmark of both sides gets a Mann-Whitney U test of its samples,
+// exact when there are no ties and few samples, the normal approximation
+// with the tie correction otherwise. It is slower or faster when the
+// p-value is below --alpha and the medians differ by more than --threshold,
+// the same otherwise, and inconclusive when there are too few samples for
+// any p-value below --alpha. The output depends on the inputs only, the
+// benchmarks in the order of their names. The exit code is 2 if any
+// benchmark is slower.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "parser/gltf.h"
+
+using namespace std;
+
+struct CSeries
+{
+    string unit;
+    bool higher_is_better = false;
+    vector<double> samples;
+};
+
+using CRun = map<string, CSeries>;
+
+vector<string> split(const string & line)
+{
+    vector<string> out;
+    stringstream in(line);
+    string item;
+    while (getline(in, item, ',')) out.push_back(item);
+    return out;
+}
+
+void add(CRun & run, const string & name, const string & unit, bool higher_is_better, double sample)
+{
+    CSeries & s = run[name];
+    s.unit = unit;
+    s.higher_is_better = higher_is_better;
+    s.samples.push_back(sample);
+}
+
+// a file of bench_mesh --json, Qt_app1 --startup or --path-log, pooled into run
+bool read(const string & file, CRun & run)
+{
+    ifstream in(file, ios::binary);
+    if (!in) return false;
+    const string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const size_t first = text.find_first_not_of(" \t\r\n");
+    if (first != string::npos && text[first] == '{')
+    {
+        MeshLib::CJsonValue json;
+        if (!MeshLib::CJsonValue::parse(text.data(), text.data() + text.size(), json)) return false;
+        const MeshLib::CJsonValue & benchmarks = json["benchmarks"];
+        for (size_t i = 0; i < benchmarks.size(); i++)
+        {
+            const MeshLib::CJsonValue & b = benchmarks[i];
+            const MeshLib::CJsonValue & samples = b["samples"];
+            for (size_t k = 0; k < samples.size(); k++)
+                if (samples[k].type == MeshLib::CJsonValue::NUMBER)
+                    add(run, b["name"].string, b["unit"].string, b["higher_is_better"].type == MeshLib::CJsonValue::BOOL && b["higher_is_better"].number != 0, samples[k].number);
+        }
+        return true;
+    }
+
+    stringstream lines(text);
+    string line;
+    getline(lines, line);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line == "stage,thread,start_ms,end_ms,duration_ms")
+    {
+        // a stage that runs more than once in a launch is summed, a launch is a sample
+        map<string, double> launch;
+        while (getline(lines, line))
+        {
+            const vector<string> f = split(line);
+            if (f.size() == 5) launch["startup/" + f[0]] += atof(f[4].c_str());
+        }
+        for (auto & s : launch) add(run, s.first, "ms", false, s.second);
+        return true;
+    }
+    if (line == "frame,alpha,beta,distance,frame_ms,cpu_ms,gpu_ms")
+    {
+        static const char * names[] = { "render/frame_ms", "render/cpu_ms", "render/gpu_ms" };
+        while (getline(lines, line))
+        {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            const vector<string> f = split(line);
+            // a frame the profiler did not finish has no cpu and gpu times
+            for (int k = 0; k < 3; k++)
+                if (4 + k < (int)f.size() && !f[4 + k].empty()) add(run, names[k], "ms", false, atof(f[4 + k].c_str()));
+        }
+        return true;
+    }
+    return false;
+}
+
+double median(vector<double> v)
+{
+    sort(v.begin(), v.end());
+    const size_t n = v.size();
+    return n == 0 ? 0 : n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// the exact two sided p-value of U, n1 x n2 samples without ties
+double exact_p(double u, int n1, int n2)
+{
+    // ways[i][j][k], the orders of i samples of the first and j of the second with U = k,
+    // rolled over i
+    const int m = n1 * n2;
+    vector<vector<double>> prev(n2 + 1, vector<double>(m + 1, 0)), cur = prev;
+    for (int j = 0; j <= n2; j++) prev[j][0] = 1;
+    for (int i = 1; i <= n1; i++)
+    {
+        for (int j = 0; j <= n2; j++)
+            for (int k = 0; k <= m; k++)
+            {
+                // the largest sample is of the first, beating the j of the second, or of the second
+                cur[j][k] = (k >= j ? prev[j][k - j] : 0) + (j > 0 ? cur[j - 1][k] : 0);
+            }
+        swap(prev, cur);
+    }
+    double total = 0, below = 0, above = 0;
+    for (int k = 0; k <= m; k++)
+    {
+        total += prev[n2][k];
+        if (k <= u + 1e-9) below += prev[n2][k];
+        if (k >= u - 1e-9) above += prev[n2][k];
+    }
+    return min(1.0, 2 * min(below, above) / total);
+}
+
+// the two sided p-value of the Mann-Whitney U test of a against b
+double mann_whitney(const vector<double> & a, const vector<double> & b)
+{
+    const int n1 = (int)a.size(), n2 = (int)b.size(), n = n1 + n2;
+    if (n1 == 0 || n2 == 0) return 1;
+    vector<pair<double, int>> all;
+    for (double x : a) all.push_back(make_pair(x, 0));
+    for (double x : b) all.push_back(make_pair(x, 1));
+    sort(all.begin(), all.end());
+    // average ranks over ties
+    double r1 = 0, ties = 0;
+    for (int i = 0; i < n;)
+    {
+        int j = i;
+        while (j < n && all[j].first == all[i].first) j++;
+        const double rank = 0.5 * (i + 1 + j), t = j - i;
+        for (int k = i; k < j; k++) if (all[k].second == 0) r1 += rank;
+        ties += t * t * t - t;
+        i = j;
+    }
+    const double u = r1 - n1 * (n1 + 1) / 2.0;
+    if (ties == 0 && n <= 40) return exact_p(u, n1, n2);
+    const double mu = n1 * n2 / 2.0;
+    const double sigma = sqrt(n1 * n2 / 12.0 * ((n + 1) - ties / ((double)n * (n - 1))));
+    if (sigma == 0) return 1;
+    const double z = max(0.0, fabs(u - mu) - 0.5) / sigma;
+    return erfc(z / sqrt(2.0));
+}
+
+// the smallest p-value n1 and n2 samples can give, both samples apart
+double min_p(int n1, int n2)
+{
+    const double log_orders = lgamma(n1 + n2 + 1.0) - lgamma(n1 + 1.0) - lgamma(n2 + 1.0);
+    return min(1.0, 2 * exp(-log_orders));
+}
+
+void usage()
+{
+    cerr << "usage: bench_compare --baseline file [--baseline file ...] --candidate file [--candidate file ...] [options]" << endl
+         << "  --alpha a        significance level (0.05)" << endl
+         << "  --threshold t    smallest relative change of the medians that counts (0.02)" << endl;
+}
+
+int main(int argc, char * argv[])
+{
+    vector<string> baseline_files, candidate_files;
+    double alpha = 0.05, threshold = 0.02;
+    for (int i = 1; i < argc; i++)
+    {
+        const string a = argv[i];
+        const bool value = i + 1 < argc;
+        if (a == "--baseline" && value) baseline_files.push_back(argv[++i]);
+        else if (a == "--candidate" && value) candidate_files.push_back(argv[++i]);
+        else if (a == "--alpha" && value) alpha = atof(argv[++i]);
+        else if (a == "--threshold" && value) threshold = atof(argv[++i]);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (baseline_files.empty() || candidate_files.empty())
+    {
+        usage();
+        return 1;
+    }
+    CRun baseline, candidate;
+    for (const string & f : baseline_files)
+        if (!read(f, baseline))
+        {
+            cerr << "cannot read " << f << endl;
+            return 1;
+        }
+    for (const string & f : candidate_files)
+        if (!read(f, candidate))
+        {
+            cerr << "cannot read " << f << endl;
+            return 1;
+        }
+
+    map<string, int> names;
+    for (auto & s : baseline) names[s.first] |= 1;
+    for (auto & s : candidate) names[s.first] |= 2;
+
+    printf("%-40s %5s %4s %4s %12s %12s %9s %8s  %s\n", "benchmark", "unit", "n0", "n1", "baseline", "candidate", "change", "p", "verdict");
+    int slower = 0, faster = 0;
+    for (auto & name : names)
+    {
+        if (name.second != 3)
+        {
+            printf("%-40s only in the %s\n", name.first.c_str(), name.second == 1 ? "baseline" : "candidate");
+            continue;
+        }
+        const CSeries & a = baseline[name.first];
+        const CSeries & b = candidate[name.first];
+        const double m0 = median(a.samples), m1 = median(b.samples);
+        const double change = m0 != 0 ? m1 / m0 - 1 : 0;
+        const double p = mann_whitney(a.samples, b.samples);
+        const int n0 = (int)a.samples.size(), n1 = (int)b.samples.size();
+        const char * verdict = "same";
+        if (min_p(n0, n1) >= alpha) verdict = "inconclusive";
+        else if (p < alpha && fabs(change) > threshold)
+        {
+            // a lower time or a higher throughput is faster
+            const bool better = a.higher_is_better ? change > 0 : change < 0;
+            verdict = better ? "faster" : "slower";
+            (better ? faster : slower)++;
+        }
+        printf("%-40s %5s %4d %4d %12.4g %12.4g %+8.1f%% %8.2g  %s\n", name.first.c_str(), a.unit.c_str(), n0, n1, m0, m1,
+               change * 100, p, verdict);
+    }
+    printf("%d slower, %d faster\n", slower, faster);
+    return slower ? 2 : 0;
+}
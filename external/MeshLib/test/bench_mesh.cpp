@@ -0,0 +1,475 @@
+// Microbenchmarks of the core mesh operations, on synthetic meshes and on
+// mesh files given on the command line, e.g.
+//   bench_mesh 256 "data/yoda/Yoda Bust.obj" data/eight.m
+// The first argument, if a number, is the size of the synthetic meshes.
+// Every benchmark runs a few times and reports the best, as elements per
+// second and bytes allocated per element. With --json file the throughput
+// of every run is kept as well, for bench_compare, and --runs n sets the
+// number of runs, 5 by default.
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <random>
+#include "Mesh/mesh.h"
+#include "Mesh/dynamicmesh.h"
+#include "Mesh/adjacency.h"
+#include "Mesh/snapshot.h"
+#include "Geometry/PoissonSampler.h"
+#include "Geometry/MeshBoolean.h"
+
+using namespace std;
+
+// every allocation is counted, the arenas of the mesh included
+static atomic<size_t> s_allocated(0);
+
+void * operator new(size_t size)
+{
+    s_allocated += size;
+    if (void * p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+// the array and sized forms alike, so every new is paired with a delete that frees it. gcc takes a
+// free() inlined after an operator new for a mismatched pair, the deletes are kept calls
+#ifdef __GNUC__
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+void * operator new[](size_t size) { return operator new(size); }
+NOINLINE void operator delete(void * p) noexcept { free(p); }
+NOINLINE void operator delete[](void * p) noexcept { free(p); }
+NOINLINE void operator delete(void * p, size_t) noexcept { free(p); }
+NOINLINE void operator delete[](void * p, size_t) noexcept { free(p); }
+
+using CMesh = MeshLib::CBaseMesh<>;
+using CDynamicMesh = MeshLib::CDynamicMesh<>;
+using CVertex = typename CMesh::CVertex;
+using CEdge = typename CMesh::CEdge;
+using CFace = typename CMesh::CFace;
+using CPoint = MeshLib::CPoint;
+
+static int s_runs = 5;
+
+// the throughput of every run of every benchmark, in M/s
+struct CResult
+{
+    string name;
+    vector<double> samples;
+};
+static vector<CResult> s_results;
+
+struct CShape
+{
+    string name;
+    vector<CPoint> points;
+    vector<int> triangles;
+};
+
+// n x n quads, two triangles each
+CShape grid(int n)
+{
+    CShape s{ "grid " + to_string(n), {}, {} };
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++) s.points.push_back(CPoint(i, j, 0));
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < n; i++)
+        {
+            const int a = j * (n + 1) + i, b = a + 1, c = a + n + 1, d = c + 1;
+            s.triangles.insert(s.triangles.end(), { a, b, d, a, d, c });
+        }
+    return s;
+}
+
+// n rings of 2n vertices and the poles, closed, the poles have valence 2n
+CShape sphere(int n)
+{
+    CShape s{ "sphere " + to_string(n), {}, {} };
+    const int m = 2 * n;
+    s.points.push_back(CPoint(0, 0, 1));
+    for (int j = 1; j <= n; j++)
+        for (int i = 0; i < m; i++)
+        {
+            const double theta = M_PI * j / (n + 1), phi = 2 * M_PI * i / m;
+            s.points.push_back(CPoint(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta)));
+        }
+    s.points.push_back(CPoint(0, 0, -1));
+    const int south = (int)s.points.size() - 1;
+    for (int i = 0; i < m; i++)
+    {
+        const int k = (i + 1) % m;
+        s.triangles.insert(s.triangles.end(), { 0, 1 + i, 1 + k });
+        s.triangles.insert(s.triangles.end(), { south, 1 + (n - 1) * m + k, 1 + (n - 1) * m + i });
+        for (int j = 0; j + 1 < n; j++)
+        {
+            const int a = 1 + j * m + i, b = 1 + j * m + k;
+            s.triangles.insert(s.triangles.end(), { a, a + m, b, b, a + m, b + m });
+        }
+    }
+    return s;
+}
+
+// n disks of valence n around their centers, side by side
+CShape fans(int n)
+{
+    CShape s{ "fans " + to_string(n), {}, {} };
+    for (int f = 0; f < n; f++)
+    {
+        const int c = (int)s.points.size();
+        s.points.push_back(CPoint(3 * f, 0, 0));
+        for (int i = 0; i < n; i++) s.points.push_back(CPoint(3 * f + cos(2 * M_PI * i / n), sin(2 * M_PI * i / n), 0));
+        for (int i = 0; i < n; i++) s.triangles.insert(s.triangles.end(), { c, c + 1 + i, c + 1 + (i + 1) % n });
+    }
+    return s;
+}
+
+template<typename Mesh>
+void build(Mesh & mesh, const CShape & s)
+{
+    vector<typename Mesh::CVertex*> vs(s.points.size());
+    for (size_t i = 0; i < vs.size(); i++)
+    {
+        vs[i] = mesh.create_vertex((int)i + 1);
+        vs[i]->point() = s.points[i];
+    }
+    for (size_t t = 0; t < s.triangles.size() / 3; t++)
+        mesh.create_triangle(vs[s.triangles[3 * t]], vs[s.triangles[3 * t + 1]], vs[s.triangles[3 * t + 2]], (int)t + 1);
+    mesh.label_boundary();
+}
+
+// times the part of a run between start() and stop(), with the bytes allocated in it
+class CTimer
+{
+public:
+    void start()
+    {
+        m_bytes = s_allocated;
+        m_start = chrono::steady_clock::now();
+    }
+    void stop()
+    {
+        m_seconds += chrono::duration<double>(chrono::steady_clock::now() - m_start).count();
+        m_bytes = s_allocated - m_bytes;
+    }
+    double seconds() const { return m_seconds; }
+    size_t bytes() const { return m_bytes; }
+
+protected:
+    chrono::steady_clock::time_point m_start;
+    double m_seconds = 0;
+    size_t m_bytes = 0;
+};
+
+template<typename Fn>
+void bench(const string & shape, const string & name, Fn fn)
+{
+    double best = 0;
+    size_t elements = 0, bytes = 0;
+    s_results.push_back(CResult{ shape + "/" + name, {} });
+    for (int run = 0; run < s_runs; run++)
+    {
+        CTimer timer;
+        elements = fn(timer);
+        s_results.back().samples.push_back(timer.seconds() > 0 ? elements / timer.seconds() / 1e6 : 0);
+        if (run == 0 || timer.seconds() < best)
+        {
+            best = timer.seconds();
+            bytes = timer.bytes();
+        }
+    }
+    cout << left << setw(20) << shape << setw(26) << name << right
+         << setw(10) << elements
+         << setw(14) << fixed << setprecision(3) << (best > 0 ? elements / best / 1e6 : 0) << " M/s"
+         << setw(12) << setprecision(1) << (elements ? (double)bytes / elements : 0) << " B/elem" << endl;
+}
+
+// the neighbors of every vertex, what the layout of the elements in memory shows most in
+void bench_circulator(const string & shape, const string & name, CMesh & mesh)
+{
+    bench(shape, name, [&](CTimer & timer)
+    {
+        size_t steps = 0;
+        int sum = 0;
+        timer.start();
+        for (CVertex * v : mesh.vertices())
+            for (CVertex * w : v->vertices_range())
+            {
+                sum += w->id();
+                steps++;
+            }
+        timer.stop();
+        if (sum == -1) cout << sum;
+        return steps;
+    });
+}
+
+// the operations that only need a mesh, built or read
+void bench_mesh(const string & shape, CMesh & mesh)
+{
+    bench(shape, "create_edge (found)", [&](CTimer & timer)
+    {
+        vector<pair<CVertex*, CVertex*>> ends;
+        for (CEdge * e : mesh.edges()) ends.push_back(make_pair(e->halfedge(0)->source(), e->halfedge(0)->target()));
+        timer.start();
+        size_t found = 0;
+        for (auto & p : ends) found += mesh.create_edge(p.first, p.second) != NULL;
+        timer.stop();
+        return found;
+    });
+    bench(shape, "label_boundary", [&](CTimer & timer)
+    {
+        timer.start();
+        mesh.label_boundary(1);
+        timer.stop();
+        return (size_t)mesh.num_vertices();
+    });
+    bench_circulator(shape, "vertex circulator", mesh);
+    bench(shape, "adjacency build", [&](CTimer & timer)
+    {
+        MeshLib::CAdjacency<CMesh> adjacency(mesh);
+        timer.start();
+        adjacency.build(1);
+        timer.stop();
+        return adjacency.vertex_vertices().inner.size();
+    });
+    bench(shape, "adjacency one ring", [&](CTimer & timer)
+    {
+        MeshLib::CAdjacency<CMesh> adjacency(mesh);
+        adjacency.build(1);
+        const MeshLib::CAdjacencyRows & rows = adjacency.vertex_vertices();
+        vector<int> ids(adjacency.num_vertices());
+        for (size_t i = 0; i < ids.size(); i++) ids[i] = adjacency.vertex(i)->id();
+        int sum = 0;
+        timer.start();
+        for (size_t i = 0; i < rows.size(); i++)
+            for (const int * p = rows.begin(i); p != rows.end(i); p++) sum += ids[*p];
+        timer.stop();
+        if (sum == -1) cout << sum;
+        return rows.inner.size();
+    });
+    bench(shape, "read_m", [&](CTimer & timer)
+    {
+        const string file = "bench_mesh.tmp.m";
+        mesh.write_m(file);
+        CMesh read;
+        timer.start();
+        read.read_m(file, {}, 1);
+        timer.stop();
+        remove(file.c_str());
+        return (size_t)read.num_faces();
+    });
+    bench(shape, "read_obj", [&](CTimer & timer)
+    {
+        const string file = "bench_mesh.tmp.obj";
+        mesh.write_obj(file);
+        CMesh read;
+        timer.start();
+        read.read_obj(file);
+        timer.stop();
+        remove(file.c_str());
+        return (size_t)read.num_faces();
+    });
+    // the radius the side of a square of the mean area of a face, a little over half as many samples as faces
+    bench(shape, "poisson samples", [&](CTimer & timer)
+    {
+        double area = 0;
+        for (CFace * f : mesh.faces())
+        {
+            CPoint p[3];
+            int k = 0;
+            for (CVertex * v : f->vertices_range()) if (k < 3) p[k++] = v->point();
+            area += ((p[1] - p[0]) ^ (p[2] - p[0])).norm() / 2;
+        }
+        vector<MeshLib::CSample> samples;
+        timer.start();
+        MeshLib::CPoissonSampler::sample_faces(mesh, sqrt(area / mesh.num_faces()), samples);
+        timer.stop();
+        return samples.size();
+    });
+    bench(shape, "swapEdge", [&](CTimer & timer)
+    {
+        CDynamicMesh dynamic(&mesh);
+        vector<CDynamicMesh::CEdge*> edges(dynamic.edges().begin(), dynamic.edges().end());
+        size_t swaps = 0;
+        timer.start();
+        for (CDynamicMesh::CEdge * e : edges)
+        {
+            if (!dynamic.swapable(e)) continue;
+            dynamic.swapEdge(e);
+            swaps++;
+        }
+        timer.stop();
+        return swaps;
+    });
+}
+
+void bench_shape(const CShape & s)
+{
+    bench(s.name, "create_face", [&](CTimer & timer)
+    {
+        CMesh mesh;
+        timer.start();
+        build(mesh, s);
+        timer.stop();
+        return (size_t)mesh.num_faces();
+    });
+    // a state of the mesh for a reader, laid out whole or after a few edits by the chunks they touched
+    bench(s.name, "snapshot (whole)", [&](CTimer & timer)
+    {
+        CDynamicMesh dynamic;
+        build(dynamic, s);
+        timer.start();
+        MeshLib::CMeshSnapshots<CDynamicMesh> snapshots(dynamic, 1);
+        timer.stop();
+        return snapshots.snapshot()->num_faces();
+    });
+    bench(s.name, "snapshot (100 edits)", [&](CTimer & timer)
+    {
+        CDynamicMesh dynamic;
+        build(dynamic, s);
+        MeshLib::CMeshSnapshots<CDynamicMesh> snapshots(dynamic, 1);
+        size_t swaps = 0;
+        for (CDynamicMesh::CEdge * e : dynamic.edges())
+        {
+            if (swaps == 100) break;
+            if (dynamic.swapable(e))
+            {
+                dynamic.swapEdge(e);
+                swaps++;
+            }
+        }
+        timer.start();
+        snapshots.publish(1);
+        timer.stop();
+        return snapshots.snapshot()->num_faces();
+    });
+    CMesh mesh;
+    build(mesh, s);
+    bench_mesh(s.name, mesh);
+}
+
+// the shape in a random order, as scanners and sculpting tools write their files, built as it
+// is and laid out along the Morton curve, see CBaseMesh::reorder_input
+void bench_order(const CShape & s)
+{
+    CShape shuffled{ s.name + " shuffled", {}, {} };
+    vector<int> vertices(s.points.size()), faces(s.triangles.size() / 3);
+    for (size_t i = 0; i < vertices.size(); i++) vertices[i] = (int)i;
+    for (size_t i = 0; i < faces.size(); i++) faces[i] = (int)i;
+    mt19937 random(1);
+    shuffle(vertices.begin(), vertices.end(), random);
+    shuffle(faces.begin(), faces.end(), random);
+    shuffled.points.resize(s.points.size());
+    for (size_t i = 0; i < vertices.size(); i++) shuffled.points[vertices[i]] = s.points[i];
+    for (int f : faces)
+        for (int k = 0; k < 3; k++) shuffled.triangles.push_back(vertices[s.triangles[3 * f + k]]);
+
+    for (int reorder = 0; reorder < 2; reorder++)
+    {
+        const string name = reorder ? "build_from_arrays reorder" : "build_from_arrays";
+        bench(shuffled.name, name, [&](CTimer & timer)
+        {
+            CMesh mesh;
+            mesh.reorder_input() = reorder != 0;
+            timer.start();
+            mesh.build_from_arrays(shuffled.points, {}, {}, shuffled.triangles);
+            timer.stop();
+            return (size_t)mesh.num_faces();
+        });
+        CMesh mesh;
+        mesh.reorder_input() = reorder != 0;
+        mesh.build_from_arrays(shuffled.points, {}, {}, shuffled.triangles);
+        bench_circulator(shuffled.name, reorder ? "vertex circulator reorder" : "vertex circulator", mesh);
+    }
+}
+
+// the union and the difference of a closed shape and a copy of it, moved and turned a little
+void bench_boolean(const CShape & s)
+{
+    CShape moved = s;
+    for (CPoint & p : moved.points)
+        p = CPoint(p[0] * cos(0.3) - p[1] * sin(0.3) + 0.5, p[0] * sin(0.3) + p[1] * cos(0.3) + 0.2, p[2] + 0.1);
+    for (int op = 0; op < 2; op++)
+    {
+        bench(s.name, op ? "boolean difference" : "boolean union", [&](CTimer & timer)
+        {
+            MeshLib::CMeshBoolean boolean;
+            timer.start();
+            boolean._compute(s.points, s.triangles, moved.points, moved.triangles,
+                             op ? MeshLib::CMeshBoolean::OP_DIFFERENCE : MeshLib::CMeshBoolean::OP_UNION);
+            timer.stop();
+            return boolean.indices().size() / 3;
+        });
+    }
+}
+
+// {"benchmarks": [{"name", "unit", "higher_is_better", "samples": [...]}, ...]}
+bool write_json(const string & file)
+{
+    ofstream out(file);
+    out << "{\"benchmarks\":[";
+    for (size_t i = 0; i < s_results.size(); i++)
+    {
+        string name;
+        for (char c : s_results[i].name) name += c == '"' || c == '\\' ? string("\\") + c : string(1, c);
+        out << (i ? ",\n" : "\n") << "{\"name\":\"" << name << "\",\"unit\":\"M/s\",\"higher_is_better\":true,\"samples\":[";
+        for (size_t k = 0; k < s_results[i].samples.size(); k++) out << (k ? "," : "") << setprecision(9) << s_results[i].samples[k];
+        out << "]}";
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+int main(int argc, char * argv[])
+{
+    int n = 256;
+    string json;
+    vector<string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        const string a = argv[i];
+        if (a == "--json" && i + 1 < argc) json = argv[++i];
+        else if (a == "--runs" && i + 1 < argc) s_runs = max(1, atoi(argv[++i]));
+        else if (i == 1 && atoi(argv[1]) > 0) n = atoi(argv[1]);
+        else files.push_back(a);
+    }
+
+    cout << left << setw(20) << "mesh" << setw(26) << "operation" << right
+         << setw(10) << "elements" << setw(18) << "throughput" << setw(19) << "allocated" << endl;
+    bench_shape(grid(n));
+    bench_shape(sphere(n));
+    bench_shape(fans(n));
+    bench_order(grid(n));
+    bench_order(sphere(n));
+    bench_boolean(sphere(n));
+
+    for (const string & file : files)
+    {
+        const string ext = file.substr(file.find_last_of('.') + 1);
+        CMesh mesh;
+        if (ext == "m") mesh.read_m(file);
+        else if (ext == "obj") mesh.read_obj(file);
+        else if (ext == "off") mesh.read_off(file);
+        if (mesh.num_faces() == 0)
+        {
+            cerr << "error in reading file " << file << endl;
+            continue;
+        }
+        const string name = file.substr(file.find_last_of("/\\") + 1);
+        bench_mesh(name, mesh);
+    }
+    if (!json.empty() && !write_json(json))
+    {
+        cerr << "cannot write " << json << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,526 @@
+// Synthetic meshes of a given size, topology and valence distribution for
+// the scaling tests, e.g.
+//   gen_mesh --faces 10000000 --genus 3 --boundaries 4 --fans 8 big.obj big.mb
+//   gen_mesh --faces 1000 --fins 2 --texture checker.ppm nonmanifold.obj
+// Every sheet is a grid of quads split in two triangles: a sphere for genus
+// 0, a chain of tori joined by tubes otherwise. The boundaries are strips of
+// quads cut out, the fans strips replaced by a triangle fan around a new
+// vertex, the fins triangles added on interior edges, three faces an edge.
+// Every corner has a uv of the grid, so a texture maps over each sheet.
+//
+// .obj and .off are written straight from the generator, in parallel blocks,
+// without a mesh in memory, the way to the largest sizes. .m, .mb, .smv,
+// .cmv, .ply and .glb go through CBaseMesh::build_from_arrays and the mesh
+// writers, which cannot take the non-manifold fins.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <random>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include "Mesh/mesh.h"
+#include "parser/writer.h"
+
+using namespace std;
+
+using CMesh = MeshLib::CBaseMesh<>;
+using CPoint = MeshLib::CPoint;
+using CPoint2 = MeshLib::CPoint2;
+
+struct COptions
+{
+    size_t faces = 100000;
+    int genus = 0;
+    int boundaries = 0;
+    int hole_size = 1;         // quads per boundary strip
+    int fans = 0;
+    int fan_valence = 64;
+    int fins = 0;
+    bool random_diagonals = false;
+    unsigned seed = 1;
+    int threads = 0;
+    string texture;
+    int texture_size = 512;
+};
+
+// a triangle outside the quad grid, its vertex and uv indices
+struct CTriangle
+{
+    int v[3];
+    int t[3];
+};
+
+class CGenerator
+{
+public:
+    CGenerator(const COptions & o) : m_o(o)
+    {
+        m_sheets = max(1, o.genus);
+        m_torus = o.genus > 0;
+        const double per_sheet = (double)o.faces / m_sheets;
+        // C = 2R columns, about 4R^2 faces a sheet
+        m_rows = max(m_torus ? 4 : 3, (int)llround(sqrt(per_sheet / 4)));
+        m_cols = 2 * m_rows;
+        m_sheet_points = m_torus ? (size_t)m_rows * m_cols : (size_t)(m_rows - 1) * m_cols + 2;
+        m_sheet_uvs = (size_t)(m_rows + 1) * (m_cols + 1);
+    }
+
+    /*! lays out the tubes, boundaries, fans and fins, false if they do not fit */
+    bool layout()
+    {
+        if ((double)m_sheets * m_sheet_points + m_o.fans + m_o.fins > INT_MAX
+            || (double)m_sheets * m_sheet_uvs + m_o.fans > INT_MAX)
+        {
+            cerr << "more than " << INT_MAX << " vertices, the indices are int" << endl;
+            return false;
+        }
+        mt19937_64 random(m_o.seed);
+
+        // a tube from the +x side of torus s to the -x side of torus s + 1
+        for (int s = 0; s + 1 < m_sheets; s++)
+        {
+            _reserve(s, 0, 0, 1);
+            _reserve(s + 1, 0, m_cols / 2, 1);
+            _tube(s, 0, 0, s + 1, 0, m_cols / 2);
+        }
+        for (int i = 0; i < m_o.boundaries; i++)
+        {
+            int s, r, c;
+            if (!_place(random, m_o.hole_size, s, r, c)) return false;
+            _reserve(s, r, c, m_o.hole_size);
+        }
+        const int strip = max(1, (m_o.fan_valence - 2) / 2);
+        for (int i = 0; i < m_o.fans; i++)
+        {
+            int s, r, c;
+            if (!_place(random, strip, s, r, c)) return false;
+            _reserve(s, r, c, strip);
+            _fan(s, r, c, strip);
+        }
+        for (int i = 0; i < m_o.fins; i++)
+        {
+            int s, r, c;
+            if (!_place(random, 1, s, r, c)) return false;
+            _fin(s, r, c);
+        }
+        return true;
+    }
+
+    size_t num_points() const { return m_sheets * m_sheet_points + m_points.size(); }
+    size_t num_uvs() const { return m_sheets * m_sheet_uvs + m_uvs.size(); }
+    size_t num_faces() const
+    {
+        const size_t quads = (size_t)m_sheets * m_rows * m_cols;
+        const size_t poles = m_torus ? 0 : 2 * (size_t)m_cols * m_sheets;
+        return 2 * quads - poles - 2 * m_removed.size() + m_triangles.size();
+    }
+    /*! the records of the faces, a quad of the grids or a triangle outside them */
+    size_t num_records() const { return (size_t)m_sheets * m_rows * m_cols + m_triangles.size(); }
+
+    CPoint point(size_t i) const
+    {
+        if (i >= m_sheets * m_sheet_points) return m_points[i - m_sheets * m_sheet_points];
+        const int s = (int)(i / m_sheet_points);
+        size_t k = i % m_sheet_points;
+        if (m_torus) return _position(s, (int)(k / m_cols), (int)(k % m_cols));
+        if (k == 0) return _position(s, 0, 0);
+        if (k == m_sheet_points - 1) return _position(s, m_rows, 0);
+        k--;
+        return _position(s, (int)(k / m_cols) + 1, (int)(k % m_cols));
+    }
+
+    CPoint2 uv(size_t i) const
+    {
+        if (i >= m_sheets * m_sheet_uvs) return m_uvs[i - m_sheets * m_sheet_uvs];
+        const size_t k = i % m_sheet_uvs;
+        return CPoint2((double)(k % (m_cols + 1)) / m_cols, (double)(k / (m_cols + 1)) / m_rows);
+    }
+
+    /*! fn(v, t) with the 0-based vertex and uv indices of each triangle of record i */
+    template<typename Fn>
+    void record(size_t i, Fn fn) const
+    {
+        const size_t quads = (size_t)m_sheets * m_rows * m_cols;
+        if (i >= quads)
+        {
+            const CTriangle & t = m_triangles[i - quads];
+            fn(t.v, t.t);
+            return;
+        }
+        if (m_removed.count(i)) return;
+        const int s = (int)(i / ((size_t)m_rows * m_cols));
+        const int r = (int)(i / m_cols % m_rows), c = (int)(i % m_cols);
+        const int v[4] = { _vertex(s, r, c), _vertex(s, r, c + 1), _vertex(s, r + 1, c + 1), _vertex(s, r + 1, c) };
+        const int t[4] = { _uv(s, r, c), _uv(s, r, c + 1), _uv(s, r + 1, c + 1), _uv(s, r + 1, c) };
+        // the diagonal 0-2 gives valence 6 everywhere, a random one valences 4 to 8
+        static const int split[2][6] = { { 0, 1, 2, 0, 2, 3 }, { 0, 1, 3, 1, 2, 3 } };
+        const int * corners = split[m_o.random_diagonals ? _hash(i) & 1 : 0];
+        for (int k = 0; k < 6; k += 3)
+        {
+            const int tv[3] = { v[corners[k]], v[corners[k + 1]], v[corners[k + 2]] };
+            const int tt[3] = { t[corners[k]], t[corners[k + 1]], t[corners[k + 2]] };
+            // the quads next to a pole are triangles
+            if (tv[0] == tv[1] || tv[1] == tv[2] || tv[2] == tv[0]) continue;
+            fn(tv, tt);
+        }
+    }
+
+protected:
+    /*! the point at row r, column c of sheet s, sphere or torus */
+    CPoint _position(int s, int r, int c) const
+    {
+        const double u = 2 * M_PI * c / m_cols;
+        if (!m_torus)
+        {
+            // row 0 is the south pole, so the quads face outwards
+            const double theta = M_PI * (1.0 - (double)r / m_rows);
+            return CPoint(sin(theta) * cos(u), sin(theta) * sin(u), cos(theta));
+        }
+        const double v = 2 * M_PI * r / m_rows;
+        const double radius = 2 + cos(v);
+        return CPoint(7.0 * s + radius * cos(u), radius * sin(u), sin(v));
+    }
+
+    int _vertex(int s, int r, int c) const
+    {
+        const size_t base = s * m_sheet_points;
+        c %= m_cols;
+        if (m_torus) return (int)(base + (size_t)(r % m_rows) * m_cols + c);
+        if (r == 0) return (int)base;
+        if (r == m_rows) return (int)(base + m_sheet_points - 1);
+        return (int)(base + 1 + (size_t)(r - 1) * m_cols + c);
+    }
+
+    int _uv(int s, int r, int c) const { return (int)(s * m_sheet_uvs + (size_t)r * (m_cols + 1) + c); }
+
+    size_t _quad(int s, int r, int c) const
+    {
+        return ((size_t)s * m_rows + (r + m_rows) % m_rows) * m_cols + (c + m_cols) % m_cols;
+    }
+
+    static uint64_t _hash(uint64_t x)
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    /*! a random strip of n quads in a row that keeps a quad away from the others, rows 0 and R-1 of a sphere excluded */
+    bool _place(mt19937_64 & random, int n, int & s, int & r, int & c)
+    {
+        if (n + 2 > m_cols || m_rows < 5) return _full();
+        for (int attempt = 0; attempt < 1000; attempt++)
+        {
+            s = (int)(random() % m_sheets);
+            r = 2 + (int)(random() % (m_rows - 4));
+            c = (int)(random() % (m_cols - n - 1)) + 1;
+            bool free = true;
+            for (int dr = -1; dr <= 1 && free; dr++)
+                for (int dc = -1; dc <= n && free; dc++) free = !m_reserved.count(_quad(s, r + dr, c + dc));
+            if (free) return true;
+        }
+        return _full();
+    }
+
+    bool _full() const
+    {
+        cerr << "the boundaries, fans and fins do not fit, ask for more faces" << endl;
+        return false;
+    }
+
+    /*! removes the strip of n quads from (r, c) on, and keeps the ring around it for itself */
+    void _reserve(int s, int r, int c, int n)
+    {
+        for (int k = 0; k < n; k++) m_removed.insert(_quad(s, r, c + k));
+        for (int dr = -1; dr <= 1; dr++)
+            for (int dc = -1; dc <= n; dc++) m_reserved.insert(_quad(s, r + dr, c + dc));
+    }
+
+    /*! the corners of the strip of n quads from (r, c) on, in the order of its faces */
+    void _loop(int r, int c, int n, vector<pair<int, int>> & loop) const
+    {
+        loop.clear();
+        for (int k = 0; k < n; k++) loop.push_back(make_pair(r, c + k));
+        loop.push_back(make_pair(r, c + n));
+        for (int k = n; k > 0; k--) loop.push_back(make_pair(r + 1, c + k));
+        loop.push_back(make_pair(r + 1, c));
+    }
+
+    /*! joins the holes at (r0, c0) of sheet s0 and (r1, c1) of sheet s1 by four quads */
+    void _tube(int s0, int r0, int c0, int s1, int r1, int c1)
+    {
+        vector<pair<int, int>> a, b;
+        _loop(r0, c0, 1, a);
+        _loop(r1, c1, 1, b);
+        // the loops run the same way on both surfaces, so b is walked backwards, from the corner facing a[0]
+        int shift = 0;
+        double best = -1;
+        for (int k = 0; k < 4; k++)
+        {
+            double d = 0;
+            for (int i = 0; i < 4; i++)
+                d += (_position(s0, a[i].first, a[i].second) - _position(s1, b[(k + 4 - i) % 4].first, b[(k + 4 - i) % 4].second)).norm();
+            if (best < 0 || d < best)
+            {
+                best = d;
+                shift = k;
+            }
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            const pair<int, int> & a0 = a[i], & a1 = a[(i + 1) % 4];
+            const pair<int, int> & b0 = b[(shift + 4 - i) % 4], & b1 = b[(shift + 3 - i) % 4];
+            const int v[4] = { _vertex(s0, a0.first, a0.second), _vertex(s0, a1.first, a1.second),
+                               _vertex(s1, b1.first, b1.second), _vertex(s1, b0.first, b0.second) };
+            const int t[4] = { _uv(s0, a0.first, a0.second), _uv(s0, a1.first, a1.second),
+                               _uv(s1, b1.first, b1.second), _uv(s1, b0.first, b0.second) };
+            m_triangles.push_back(CTriangle{ { v[0], v[1], v[2] }, { t[0], t[1], t[2] } });
+            m_triangles.push_back(CTriangle{ { v[0], v[2], v[3] }, { t[0], t[2], t[3] } });
+        }
+    }
+
+    /*! the strip of n quads at (r, c) as a fan around a new vertex of valence 2n + 2 */
+    void _fan(int s, int r, int c, int n)
+    {
+        const int center = (int)num_points(), center_uv = (int)num_uvs();
+        vector<pair<int, int>> loop;
+        _loop(r, c, n, loop);
+        CPoint p(0, 0, 0);
+        for (auto & k : loop) p += _position(s, k.first, k.second);
+        m_points.push_back(p / (double)loop.size());
+        m_uvs.push_back((uv(_uv(s, r, c)) + uv(_uv(s, r + 1, c + n))) * 0.5);
+        for (size_t i = 0; i < loop.size(); i++)
+        {
+            const pair<int, int> & a = loop[i], & b = loop[(i + 1) % loop.size()];
+            m_triangles.push_back(CTriangle{ { _vertex(s, a.first, a.second), _vertex(s, b.first, b.second), center },
+                                             { _uv(s, a.first, a.second), _uv(s, b.first, b.second), center_uv } });
+        }
+    }
+
+    /*! a third face on the edge from (r, c) to (r, c + 1), standing out of the surface */
+    void _fin(int s, int r, int c)
+    {
+        const CPoint a = _position(s, r, c), b = _position(s, r, c + 1), d = _position(s, r + 1, c);
+        const CPoint normal = (b - a) ^ (d - a);
+        m_points.push_back((a + b) * 0.5 + normal / normal.norm() * (b - a).norm());
+        m_reserved.insert(_quad(s, r, c));
+        m_triangles.push_back(CTriangle{ { _vertex(s, r, c), _vertex(s, r, c + 1), (int)num_points() - 1 },
+                                         { _uv(s, r, c), _uv(s, r, c + 1), _uv(s, r + 1, c) } });
+    }
+
+    const COptions & m_o;
+    int    m_sheets;
+    bool   m_torus;
+    int    m_rows;
+    int    m_cols;
+    size_t m_sheet_points;
+    size_t m_sheet_uvs;
+
+    unordered_set<size_t> m_removed;    // the quads cut out
+    unordered_set<size_t> m_reserved;   // the quads taken, with a ring around the cut ones
+    vector<CPoint>        m_points;     // the points after the sheets
+    vector<CPoint2>       m_uvs;        // the uvs after the sheets
+    vector<CTriangle>     m_triangles;  // the tubes, fans and fins
+};
+
+bool write_obj(const CGenerator & g, const string & file, int threads)
+{
+    MeshLib::CTextWriter writer(file);
+    if (!writer.is_open()) return false;
+    writer.records(g.num_points(), threads, [&](size_t i, MeshLib::CFormatBuffer & b)
+    {
+        const CPoint p = g.point(i);
+        b << "v " << p[0] << ' ' << p[1] << ' ' << p[2] << '\n';
+    });
+    writer.records(g.num_uvs(), threads, [&](size_t i, MeshLib::CFormatBuffer & b)
+    {
+        const CPoint2 t = g.uv(i);
+        b << "vt " << t[0] << ' ' << t[1] << '\n';
+    });
+    writer.records(g.num_records(), threads, [&](size_t i, MeshLib::CFormatBuffer & b)
+    {
+        g.record(i, [&](const int * v, const int * t)
+        {
+            b << 'f';
+            for (int k = 0; k < 3; k++) b << ' ' << v[k] + 1 << '/' << t[k] + 1;
+            b << '\n';
+        });
+    });
+    return writer.close();
+}
+
+bool write_off(const CGenerator & g, const string & file, int threads)
+{
+    MeshLib::CTextWriter writer(file);
+    if (!writer.is_open()) return false;
+    MeshLib::CFormatBuffer header;
+    header << "OFF\n" << (unsigned long long)g.num_points() << ' ' << (unsigned long long)g.num_faces() << " 0\n";
+    writer.write(header);
+    writer.records(g.num_points(), threads, [&](size_t i, MeshLib::CFormatBuffer & b)
+    {
+        const CPoint p = g.point(i);
+        b << p[0] << ' ' << p[1] << ' ' << p[2] << '\n';
+    });
+    writer.records(g.num_records(), threads, [&](size_t i, MeshLib::CFormatBuffer & b)
+    {
+        g.record(i, [&](const int * v, const int *)
+        {
+            b << "3 " << v[0] << ' ' << v[1] << ' ' << v[2] << '\n';
+        });
+    });
+    return writer.close();
+}
+
+// the generated arrays through the bulk builder, the uvs per corner
+void build(const CGenerator & g, CMesh & mesh)
+{
+    vector<CPoint> points(g.num_points());
+    vector<CPoint2> uvs(g.num_uvs());
+    for (size_t i = 0; i < points.size(); i++) points[i] = g.point(i);
+    for (size_t i = 0; i < uvs.size(); i++) uvs[i] = g.uv(i);
+    vector<int> indices, uv_indices;
+    indices.reserve(3 * g.num_faces());
+    uv_indices.reserve(3 * g.num_faces());
+    for (size_t i = 0; i < g.num_records(); i++)
+        g.record(i, [&](const int * v, const int * t)
+        {
+            indices.insert(indices.end(), v, v + 3);
+            uv_indices.insert(uv_indices.end(), t, t + 3);
+        });
+    mesh.build_from_arrays(points, uvs, vector<CPoint>(), indices, vector<int>(), uv_indices, vector<int>());
+}
+
+// a checkerboard of 8 x 8 cells, red and green ramps over the uv square
+bool write_texture(const string & file, int size)
+{
+    FILE * fp = fopen(file.c_str(), "wb");
+    if (!fp) return false;
+    fprintf(fp, "P6\n%d %d\n255\n", size, size);
+    vector<unsigned char> row(3 * size);
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            const bool dark = ((x * 8 / size) + (y * 8 / size)) & 1;
+            row[3 * x] = (unsigned char)(255 * x / size);
+            row[3 * x + 1] = (unsigned char)(255 * (size - 1 - y) / size);
+            row[3 * x + 2] = dark ? 64 : 224;
+        }
+        fwrite(row.data(), 1, row.size(), fp);
+    }
+    return fclose(fp) == 0;
+}
+
+void usage()
+{
+    cerr << "usage: gen_mesh [options] output..." << endl
+         << "  --faces n         about n triangles (100000)" << endl
+         << "  --genus g         a sphere for 0, g tori joined by tubes otherwise (0)" << endl
+         << "  --boundaries b    cut b boundary loops (0)" << endl
+         << "  --hole-size n     quads a boundary loop cuts out, in a row (1)" << endl
+         << "  --fans n          n vertices of high valence (0)" << endl
+         << "  --fan-valence k   their valence (64)" << endl
+         << "  --fins n          n non-manifold edges of three faces, .obj and .off only (0)" << endl
+         << "  --random          random diagonals, valences 4 to 8 instead of 6" << endl
+         << "  --seed s          seed of the placement (1)" << endl
+         << "  --threads t       formatting threads, 0 all hardware threads (0)" << endl
+         << "  --texture f.ppm   write a checker texture for the uvs" << endl
+         << "  --texture-size n  its width and height (512)" << endl
+         << "the outputs by extension: .obj .off .m .mb .smv .cmv .ply .glb" << endl;
+}
+
+int main(int argc, char * argv[])
+{
+    COptions o;
+    vector<string> outputs;
+    for (int i = 1; i < argc; i++)
+    {
+        const string a = argv[i];
+        const bool value = i + 1 < argc;
+        if (a == "--faces" && value) o.faces = strtoull(argv[++i], NULL, 10);
+        else if (a == "--genus" && value) o.genus = atoi(argv[++i]);
+        else if (a == "--boundaries" && value) o.boundaries = atoi(argv[++i]);
+        else if (a == "--hole-size" && value) o.hole_size = max(1, atoi(argv[++i]));
+        else if (a == "--fans" && value) o.fans = atoi(argv[++i]);
+        else if (a == "--fan-valence" && value) o.fan_valence = max(4, atoi(argv[++i]));
+        else if (a == "--fins" && value) o.fins = atoi(argv[++i]);
+        else if (a == "--random") o.random_diagonals = true;
+        else if (a == "--seed" && value) o.seed = (unsigned)atoi(argv[++i]);
+        else if (a == "--threads" && value) o.threads = atoi(argv[++i]);
+        else if (a == "--texture" && value) o.texture = argv[++i];
+        else if (a == "--texture-size" && value) o.texture_size = max(1, atoi(argv[++i]));
+        else if (a.size() > 2 && a.compare(0, 2, "--") == 0)
+        {
+            usage();
+            return 1;
+        }
+        else outputs.push_back(a);
+    }
+    if (outputs.empty() || o.genus < 0 || o.boundaries < 0 || o.fans < 0 || o.fins < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    CGenerator g(o);
+    if (!g.layout()) return 1;
+    cout << g.num_points() << " vertices, " << g.num_faces() << " faces, genus " << o.genus
+         << ", " << o.boundaries << " boundaries" << endl;
+
+    CMesh mesh;
+    bool built = false;
+    int result = 0;
+    for (const string & file : outputs)
+    {
+        const string ext = file.substr(file.find_last_of('.') + 1);
+        bool ok;
+        if (ext == "obj") ok = write_obj(g, file, o.threads);
+        else if (ext == "off") ok = write_off(g, file, o.threads);
+        else
+        {
+            if (o.fins > 0)
+            {
+                cerr << file << ": the fins are non-manifold, only .obj and .off keep them" << endl;
+                result = 1;
+                continue;
+            }
+            if (!built)
+            {
+                build(g, mesh);
+                built = true;
+            }
+            if (ext == "m")
+            {
+                mesh.write_m(file, {}, o.threads);
+                ok = true;
+            }
+            else if (ext == "mb") ok = mesh.write_mb(file, {}, o.threads);
+            else if (ext == "smv") ok = mesh.write_smv(file, true, false);
+            else if (ext == "cmv") ok = mesh.write_cmv(file, true, false, 16, o.threads);
+            else if (ext == "ply") ok = mesh.write_ply(file, true, false);
+            else if (ext == "glb") ok = mesh.write_glb(file, true, false);
+            else
+            {
+                cerr << file << ": unknown format" << endl;
+                result = 1;
+                continue;
+            }
+        }
+        if (!ok)
+        {
+            cerr << "error in writing file " << file << endl;
+            result = 1;
+        }
+    }
+    if (!o.texture.empty() && !write_texture(o.texture, o.texture_size))
+    {
+        cerr << "error in writing file " << o.texture << endl;
+        result = 1;
+    }
+    return result;
+}
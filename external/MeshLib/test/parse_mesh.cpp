@@ -0,0 +1,261 @@
+// Correctness and throughput of the .obj, .off and .m readers on a corpus of
+// pathological files, e.g.
+//   parse_mesh --baseline parse_baseline.csv
+//   parse_mesh --save parse_baseline.csv
+// Every case is written to a temporary file and read back, its vertex and
+// face counts checked, malformed files must be read without a crash to the
+// faces that are valid. The large cases are timed, best of a few runs, in MB
+// per second; with --baseline a case slower than its baseline by more than
+// --tolerance fails. The exit code is 1 if a count is wrong, 2 if only the
+// throughput regressed. Build it with -fsanitize=address to catch reads out
+// of bounds as well.
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include "Mesh/mesh.h"
+
+using namespace std;
+
+using CMesh = MeshLib::CBaseMesh<>;
+
+struct CCase
+{
+    string name;
+    string ext;
+    string text;
+    int vertices;
+    int faces;
+    bool timed;
+};
+
+static const int s_runs = 3;
+
+// n x n quads, as .obj with uvs and normals, polygons or triangles
+string grid_obj(int n, bool quads, const string & eol = "\n")
+{
+    ostringstream s;
+    s.precision(8);
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++) s << "v " << i * 0.01 << ' ' << j * 0.01 << " 0.125" << eol;
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++) s << "vt " << (double)i / n << ' ' << (double)j / n << eol;
+    s << "vn 0 0 1" << eol;
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < n; i++)
+        {
+            const int a = j * (n + 1) + i + 1, b = a + 1, c = a + n + 1, d = c + 1;
+            if (quads) s << "f " << a << '/' << a << "/1 " << b << '/' << b << "/1 " << d << '/' << d << "/1 " << c << '/' << c << "/1" << eol;
+            else s << "f " << a << '/' << a << "/1 " << b << '/' << b << "/1 " << d << '/' << d << "/1" << eol
+                   << "f " << a << '/' << a << "/1 " << d << '/' << d << "/1 " << c << '/' << c << "/1" << eol;
+        }
+    return s.str();
+}
+
+string grid_off(int n)
+{
+    ostringstream s;
+    s << "OFF\n" << (n + 1) * (n + 1) << ' ' << n * n << " 0\n";
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++) s << i * 0.01 << ' ' << j * 0.01 << " 0.125\n";
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < n; i++)
+        {
+            const int a = j * (n + 1) + i, b = a + 1, c = a + n + 1, d = c + 1;
+            s << "4 " << a << ' ' << b << ' ' << d << ' ' << c << '\n';
+        }
+    return s.str();
+}
+
+string grid_m(int n)
+{
+    ostringstream s;
+    for (int j = 0; j <= n; j++)
+        for (int i = 0; i <= n; i++)
+            s << "Vertex " << j * (n + 1) + i + 1 << ' ' << i * 0.01 << ' ' << j * 0.01 << " 0.125 {uv=(" << (double)i / n << ' ' << (double)j / n << ")}\n";
+    int f = 1;
+    for (int j = 0; j < n; j++)
+        for (int i = 0; i < n; i++)
+        {
+            const int a = j * (n + 1) + i + 1, b = a + 1, c = a + n + 1, d = c + 1;
+            s << "Face " << f++ << ' ' << a << ' ' << b << ' ' << d << '\n';
+            s << "Face " << f++ << ' ' << a << ' ' << d << ' ' << c << '\n';
+        }
+    return s.str();
+}
+
+vector<CCase> corpus()
+{
+    const string tri = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+    const string square = "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n";
+    vector<CCase> c;
+
+    c.push_back({ "obj_triangle", "obj", tri, 3, 1, false });
+    c.push_back({ "obj_crlf", "obj", "v 0 0 0\r\nv 1 0 0\r\nv 1 1 0\r\nv 0 1 0\r\nf 1 2 3\r\nf 1 3 4\r\n", 4, 2, false });
+    c.push_back({ "obj_no_final_newline", "obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3", 3, 1, false });
+    c.push_back({ "obj_ngon", "obj", "v 1 0 0\nv 0.5 0.87 0\nv -0.5 0.87 0\nv -1 0 0\nv -0.5 -0.87 0\nv 0.5 -0.87 0\nf 1 2 3 4 5 6\n", 6, 1, false });
+    c.push_back({ "obj_negative_indices", "obj", square + "f -4 -3 -2\nv 2 0 0\nf -4 -1 -3\n", 4, 2, false });
+    c.push_back({ "obj_missing_vt", "obj", square + "vt 0 0\nvt 1 0\nvt 1 1\nf 1/1 2/2 3/3\nf 1 3 4\n", 4, 2, false });
+    c.push_back({ "obj_normals_only", "obj", square + "vn 0 0 1\nf 1//1 2//1 3//1\nf 1//1 3//1 4//1\n", 4, 2, false });
+    c.push_back({ "obj_out_of_range", "obj", square + "f 1 2 3\nf 1 3 9\nf 0 1 2\nf 1 -7 2\n", 3, 1, false });
+    c.push_back({ "obj_uv_out_of_range", "obj", square + "vt 0 0\nf 1/1 2/5 3/-4\n", 3, 1, false });
+    c.push_back({ "obj_degenerate_faces", "obj", square + "f 1 2\nf 1\nf\nf 1 2 3\n", 3, 1, false });
+    c.push_back({ "obj_whitespace_comments", "obj",
+        "# header\n\n  v\t0 0 0 \nv  1  0  0\n\tv 0 1 0\no part\ng group\ns off\nusemtl m\nmtllib m.mtl\nf 1 2 3 # trailing\n", 3, 1, false });
+    c.push_back({ "obj_numbers", "obj", "v 1e-3 +2. -.5\nv 1E+2 0.0e0 -0\nv 3 4 5e1\nf 1 2 3\n", 3, 1, false });
+    c.push_back({ "obj_huge_comment", "obj", "# " + string(1 << 24, 'x') + "\n" + tri, 3, 1, false });
+    c.push_back({ "obj_huge_face", "obj", [] {
+        string s;
+        for (int i = 0; i < 20000; i++) s += "v " + to_string(i) + " " + to_string(i % 7) + " 0\n";
+        s += "f";
+        for (int i = 1; i <= 20000; i++) s += " " + to_string(i);
+        return s + "\n";
+    }(), 20000, 1, false });
+    c.push_back({ "obj_empty", "obj", "", 0, 0, false });
+    c.push_back({ "obj_garbage", "obj", [] {
+        string s;
+        unsigned x = 12345;
+        for (int i = 0; i < 1 << 16; i++)
+        {
+            x = x * 1103515245 + 12345;
+            s += (char)(x >> 16);
+        }
+        return s;
+    }(), -1, -1, false });
+
+    c.push_back({ "off_quad", "off", "OFF\n# comment\n\n4 1 0\n0 0 0\n1 0 0\n1 1 0\n0 1 0\n4 0 1 2 3\n", 4, 1, false });
+    c.push_back({ "off_crlf", "off", "OFF\r\n3 1 0\r\n0 0 0\r\n1 0 0\r\n0 1 0\r\n3 0 1 2\r\n", 3, 1, false });
+    c.push_back({ "off_counts_on_keyword_line", "off", "OFF 3 1 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 2\n", 3, 1, false });
+    c.push_back({ "off_colors", "off", "COFF\n3 1 0\n0 0 0 255 0 0 255\n1 0 0 0 255 0 255\n0 1 0 0 0 255 255\n3 0 1 2 255 255 255\n", 3, 1, false });
+    c.push_back({ "off_out_of_range", "off", "OFF\n3 2 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 2\n3 0 1 7\n", 0, 0, false });
+    c.push_back({ "off_truncated", "off", "OFF\n3 2 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 2\n", 0, 0, false });
+    c.push_back({ "off_negative_counts", "off", "OFF\n-3 1 0\n0 0 0\n", 0, 0, false });
+
+    c.push_back({ "m_triangle", "m", "Vertex 1 0 0 0\nVertex 2 1 0 0\nVertex 3 0 1 0\nFace 1 1 2 3\n", 3, 1, false });
+    c.push_back({ "m_crlf", "m", "Vertex 1 0 0 0\r\nVertex 2 1 0 0\r\nVertex 3 0 1 0\r\nFace 1 1 2 3\r\n", 3, 1, false });
+    c.push_back({ "m_traits", "m",
+        "Vertex 1 0 0 0 {uv=(0 0) normal=(0 0 1)}\nVertex 2 1 0 0 {uv=(1 0)}\nVertex 3 0 1 0 {uv=(0 1)}\nFace 1 1 2 3 {rgb=(1 0 0)}\n"
+        "Edge 1 2 {sharp}\nCorner 1 1 {uv=(0 0)}\n", 3, 1, false });
+    c.push_back({ "m_sparse_ids", "m", "Vertex 10 0 0 0\nVertex 20 1 0 0\nVertex 30 0 1 0\nFace 7 10 20 30\n", 3, 1, false });
+    c.push_back({ "m_undefined_vertex", "m", "Vertex 1 0 0 0\nVertex 2 1 0 0\nVertex 3 0 1 0\nFace 1 1 2 3\nFace 2 1 3 9\n", 3, 1, false });
+    c.push_back({ "m_short_face", "m", "Vertex 1 0 0 0\nVertex 2 1 0 0\nVertex 3 0 1 0\nFace 1 1 2 3\nFace 2 1 2\nFace 3\n", 3, 1, false });
+    c.push_back({ "m_edge_undefined", "m", "Vertex 1 0 0 0\nVertex 2 1 0 0\nVertex 3 0 1 0\nFace 1 1 2 3\nEdge 1 9 {sharp}\nEdge 2 3 {sharp}\n", 3, 1, false });
+    c.push_back({ "m_corner_undefined", "m", "Vertex 1 0 0 0\nVertex 2 1 0 0\nVertex 3 0 1 0\nFace 1 1 2 3\nCorner 9 1 {uv=(0 0)}\nCorner 1 5 {uv=(0 0)}\n", 3, 1, false });
+    c.push_back({ "m_huge_trait", "m", "Vertex 1 0 0 0 {note=(" + string(1 << 22, 'a') + ")}\nVertex 2 1 0 0\nVertex 3 0 1 0\nFace 1 1 2 3\n", 3, 1, false });
+
+    // the throughput cases, a few tens of MB each
+    c.push_back({ "obj_grid_triangles", "obj", grid_obj(700, false), 701 * 701, 2 * 700 * 700, true });
+    c.push_back({ "obj_grid_quads", "obj", grid_obj(700, true), 701 * 701, 700 * 700, true });
+    c.push_back({ "obj_grid_crlf", "obj", grid_obj(700, false, "\r\n"), 701 * 701, 2 * 700 * 700, true });
+    c.push_back({ "off_grid_quads", "off", grid_off(1000), 1001 * 1001, 1000 * 1000, true });
+    c.push_back({ "m_grid_triangles", "m", grid_m(700), 701 * 701, 2 * 700 * 700, true });
+    return c;
+}
+
+void read(CMesh & mesh, const CCase & c, const string & file)
+{
+    if (c.ext == "obj") mesh.read_obj(file);
+    else if (c.ext == "off") mesh.read_off(file);
+    else mesh.read_m(file);
+}
+
+map<string, double> read_baseline(const string & file)
+{
+    map<string, double> baseline;
+    ifstream in(file);
+    string line;
+    while (getline(in, line))
+    {
+        const size_t comma = line.find(',');
+        if (comma == string::npos) continue;
+        const double mbs = atof(line.c_str() + comma + 1);
+        if (mbs > 0) baseline[line.substr(0, comma)] = mbs;
+    }
+    return baseline;
+}
+
+int main(int argc, char * argv[])
+{
+    string baseline_file, save_file;
+    double tolerance = 0.2;
+    for (int i = 1; i < argc; i++)
+    {
+        const string a = argv[i];
+        if (a == "--baseline" && i + 1 < argc) baseline_file = argv[++i];
+        else if (a == "--save" && i + 1 < argc) save_file = argv[++i];
+        else if (a == "--tolerance" && i + 1 < argc) tolerance = atof(argv[++i]);
+        else
+        {
+            cerr << "usage: parse_mesh [--baseline file.csv] [--save file.csv] [--tolerance 0.2]" << endl;
+            return 1;
+        }
+    }
+    const map<string, double> baseline = read_baseline(baseline_file);
+    if (!baseline_file.empty() && baseline.empty()) cerr << "no baseline in " << baseline_file << endl;
+
+    int wrong = 0, slow = 0;
+    ofstream save;
+    if (!save_file.empty()) save.open(save_file);
+
+    cout << left << setw(28) << "case" << right << setw(10) << "vertices" << setw(10) << "faces"
+         << setw(10) << "MB" << setw(10) << "MB/s" << setw(12) << "baseline" << endl;
+    for (const CCase & c : corpus())
+    {
+        const string file = "parse_mesh.tmp." + c.ext;
+        {
+            ofstream out(file, ios::binary);
+            out << c.text;
+        }
+        double best = 0;
+        int vertices = 0, faces = 0;
+        for (int run = 0; run < (c.timed ? s_runs : 1); run++)
+        {
+            CMesh mesh;
+            const auto start = chrono::steady_clock::now();
+            read(mesh, c, file);
+            const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (run == 0 || seconds < best) best = seconds;
+            vertices = (int)mesh.num_vertices();
+            faces = (int)mesh.num_faces();
+        }
+        remove(file.c_str());
+
+        // a negative count only asks for no crash
+        const bool ok = (c.vertices < 0 || vertices == c.vertices) && (c.faces < 0 || faces == c.faces);
+        const double mb = c.text.size() / 1048576.0;
+        const double mbs = c.timed && best > 0 ? mb / best : 0;
+        cout << left << setw(28) << c.name << right << setw(10) << vertices << setw(10) << faces
+             << setw(10) << fixed << setprecision(2) << mb;
+        if (c.timed) cout << setw(10) << setprecision(1) << mbs;
+        else cout << setw(10) << "";
+        auto found = baseline.find(c.name);
+        bool regressed = false;
+        if (c.timed && found != baseline.end())
+        {
+            regressed = mbs < found->second * (1 - tolerance);
+            cout << setw(12) << setprecision(1) << found->second;
+        }
+        if (!ok)
+        {
+            cout << "  wrong, expected " << c.vertices << " vertices " << c.faces << " faces";
+            wrong++;
+        }
+        if (regressed)
+        {
+            cout << "  slower than the baseline";
+            slow++;
+        }
+        cout << endl;
+        if (save.is_open() && c.timed) save << c.name << ',' << mbs << endl;
+    }
+
+    if (wrong) cout << wrong << " case" << (wrong > 1 ? "s" : "") << " read wrong" << endl;
+    if (slow) cout << slow << " case" << (slow > 1 ? "s" : "") << " slower than the baseline by more than " << tolerance * 100 << "%" << endl;
+    return wrong ? 1 : slow ? 2 : 0;
+}
@@ -0,0 +1,283 @@
+// Scaling of the parallel stages over thread counts and mesh sizes, e.g.
+//   scale_mesh --sizes 100000,4000000 --threads 1,2,4,8,16,32,64 --pin spread
+// Every stage runs on spheres of about the given face counts at every thread
+// count, best of a few runs, and reports its speedup over one thread and its
+// efficiency, the speedup per thread. Stages below --min-efficiency at a
+// thread count are flagged, and the exit code is 2 if any is, so a scaling
+// regression fails a scripted run.
+//
+// With --pin every thread of the pool is bound to a CPU, compact fills the
+// CPUs in order, spread takes them round robin from the NUMA nodes, and the
+// two side by side show what crossing the nodes costs. The meshes are built
+// by the main thread, so their memory is on its node. A run with t threads
+// uses the calling thread and whichever pool threads take its tasks, so the
+// pinning fixes where the pool runs, not which of its threads a run gets.
+// Pinning needs Linux.
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include "Mesh/mesh.h"
+#include "Mesh/smoothing.h"
+#include "parser/objparser.h"
+
+using namespace std;
+
+using CMesh = MeshLib::CBaseMesh<>;
+using CPoint = MeshLib::CPoint;
+
+struct COptions
+{
+    vector<size_t> sizes{ 100000, 1000000 };
+    vector<int> threads;
+    int runs = 3;
+    string pin = "none";
+    double min_efficiency = 0.5;
+    vector<string> stages;
+    string csv;
+};
+
+// a sphere of n rings of 2n vertices, about 4n^2 faces
+void sphere(CMesh & mesh, size_t faces)
+{
+    const int n = max(3, (int)llround(sqrt(faces / 4.0))), m = 2 * n;
+    vector<CPoint> points;
+    vector<int> triangles;
+    points.push_back(CPoint(0, 0, 1));
+    for (int j = 1; j <= n; j++)
+        for (int i = 0; i < m; i++)
+        {
+            const double theta = M_PI * j / (n + 1), phi = 2 * M_PI * i / m;
+            points.push_back(CPoint(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta)));
+        }
+    points.push_back(CPoint(0, 0, -1));
+    const int south = (int)points.size() - 1;
+    for (int i = 0; i < m; i++)
+    {
+        const int k = (i + 1) % m;
+        triangles.insert(triangles.end(), { 0, 1 + i, 1 + k });
+        triangles.insert(triangles.end(), { south, 1 + (n - 1) * m + k, 1 + (n - 1) * m + i });
+        for (int j = 0; j + 1 < n; j++)
+        {
+            const int a = 1 + j * m + i, b = 1 + j * m + k;
+            triangles.insert(triangles.end(), { a, a + m, b, b, a + m, b + m });
+        }
+    }
+    mesh.build_from_arrays(points, {}, {}, triangles);
+}
+
+// a parallel stage, prepare runs untimed before every timed run
+struct CStage
+{
+    string name;
+    function<void(CMesh &)> prepare;
+    function<void(CMesh &, int)> run;
+};
+
+vector<CStage> stages()
+{
+    static const string obj = "scale_mesh.tmp.obj", m = "scale_mesh.tmp.m";
+    return {
+        { "parse_obj", [](CMesh & mesh) { mesh.write_obj(obj); },
+          [](CMesh &, int t) { MeshLib::CObjData data; MeshLib::CObjParser::parse_file(obj, data, t); } },
+        { "read_m", [](CMesh & mesh) { mesh.write_m(m); },
+          [](CMesh &, int t) { CMesh read; read.read_m(m, {}, t); } },
+        { "write_obj", [](CMesh &) {},
+          [](CMesh & mesh, int t) { mesh.write_obj(obj, t); } },
+        { "label_boundary", [](CMesh &) {},
+          [](CMesh & mesh, int t) { mesh.label_boundary(t); } },
+        { "compute_normals", [](CMesh &) {},
+          [](CMesh & mesh, int t) { mesh.compute_normals(t); } },
+        { "smooth", [](CMesh &) {},
+          [](CMesh & mesh, int t) { MeshLib::CSmoother<CMesh> smoother(mesh, t); smoother.laplacian(5); } },
+    };
+}
+
+// the NUMA node of every CPU, all 0 where it cannot be told
+vector<int> numa_nodes(int cpus)
+{
+    vector<int> node(cpus, 0);
+#ifdef __linux__
+    for (int c = 0; c < cpus; c++)
+        for (int k = 0; k < 256; k++)
+        {
+            const string path = "/sys/devices/system/cpu/cpu" + to_string(c) + "/node" + to_string(k);
+            if (access(path.c_str(), F_OK) == 0)
+            {
+                node[c] = k;
+                break;
+            }
+        }
+#endif
+    return node;
+}
+
+// binds the calling thread and every pool thread to a CPU of order, false if it cannot
+bool pin(const vector<int> & order)
+{
+#ifdef __linux__
+    // every task waits until all have started, so each runs on a thread of its own
+    const int n = min((int)order.size(), MeshLib::CThreadPool::instance().size() + 1);
+    atomic<int> started(0), failed(0);
+    MeshLib::parallel_run(n, [&](int i)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(order[i], &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) failed++;
+        started++;
+        while (started.load() < n) this_thread::yield();
+    });
+    return failed == 0;
+#else
+    (void)order;
+    return false;
+#endif
+}
+
+vector<string> split(const string & list)
+{
+    vector<string> out;
+    stringstream in(list);
+    string item;
+    while (getline(in, item, ',')) if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+void usage()
+{
+    cerr << "usage: scale_mesh [options]" << endl
+         << "  --sizes a,b,...        face counts (100000,1000000)" << endl
+         << "  --threads a,b,...      thread counts (1, 2, 4, ... up to the hardware threads)" << endl
+         << "  --runs n               runs per point, the best counts (3)" << endl
+         << "  --stages a,b,...       parse_obj, read_m, write_obj, label_boundary, compute_normals, smooth (all)" << endl
+         << "  --pin none|compact|spread  bind the pool threads to CPUs (none)" << endl
+         << "  --min-efficiency e     flag efficiencies below e (0.5)" << endl
+         << "  --csv file             write the table as CSV too" << endl;
+}
+
+int main(int argc, char * argv[])
+{
+    COptions o;
+    for (int i = 1; i < argc; i++)
+    {
+        const string a = argv[i];
+        const bool value = i + 1 < argc;
+        if (a == "--sizes" && value)
+        {
+            o.sizes.clear();
+            for (const string & s : split(argv[++i])) o.sizes.push_back(strtoull(s.c_str(), NULL, 10));
+        }
+        else if (a == "--threads" && value)
+        {
+            for (const string & s : split(argv[++i])) o.threads.push_back(max(1, atoi(s.c_str())));
+        }
+        else if (a == "--runs" && value) o.runs = max(1, atoi(argv[++i]));
+        else if (a == "--stages" && value) o.stages = split(argv[++i]);
+        else if (a == "--pin" && value) o.pin = argv[++i];
+        else if (a == "--min-efficiency" && value) o.min_efficiency = atof(argv[++i]);
+        else if (a == "--csv" && value) o.csv = argv[++i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    const int hardware = MeshLib::resolve_threads(0);
+    if (o.threads.empty())
+    {
+        for (int t = 1; t < hardware; t *= 2) o.threads.push_back(t);
+        o.threads.push_back(hardware);
+    }
+    // the speedup is over one thread
+    if (o.threads.front() != 1) o.threads.insert(o.threads.begin(), 1);
+
+    const vector<int> node = numa_nodes(hardware);
+    int nodes = 0;
+    for (int n : node) nodes = max(nodes, n + 1);
+    cout << hardware << " hardware threads, " << nodes << " NUMA node" << (nodes > 1 ? "s" : "") << ", pinning " << o.pin << endl;
+    if (o.pin == "compact" || o.pin == "spread")
+    {
+        vector<int> order;
+        if (o.pin == "compact")
+            for (int c = 0; c < hardware; c++) order.push_back(c);
+        else
+            for (int k = 0; (int)order.size() < hardware; k++)
+                for (int n = 0; n < nodes; n++)
+                {
+                    // the k-th CPU of node n
+                    int seen = 0;
+                    for (int c = 0; c < hardware; c++)
+                        if (node[c] == n && seen++ == k) order.push_back(c);
+                }
+        if (!pin(order)) cerr << "cannot pin the threads, running unpinned" << endl;
+    }
+    else if (o.pin != "none")
+    {
+        usage();
+        return 1;
+    }
+
+    ofstream csv;
+    if (!o.csv.empty())
+    {
+        csv.open(o.csv);
+        csv << "stage,faces,threads,seconds,speedup,efficiency,flagged" << endl;
+    }
+    cout << left << setw(18) << "stage" << right << setw(12) << "faces" << setw(9) << "threads"
+         << setw(12) << "seconds" << setw(10) << "speedup" << setw(12) << "efficiency" << endl;
+
+    int flagged = 0;
+    for (size_t faces : o.sizes)
+    {
+        CMesh mesh;
+        sphere(mesh, faces);
+        for (const CStage & stage : stages())
+        {
+            if (!o.stages.empty() && find(o.stages.begin(), o.stages.end(), stage.name) == o.stages.end()) continue;
+            double serial = 0;
+            for (int t : o.threads)
+            {
+                double best = 0;
+                for (int run = 0; run < o.runs; run++)
+                {
+                    stage.prepare(mesh);
+                    const auto start = chrono::steady_clock::now();
+                    stage.run(mesh, t);
+                    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                    if (run == 0 || seconds < best) best = seconds;
+                }
+                if (t == 1) serial = best;
+                const double speedup = best > 0 ? serial / best : 0;
+                const double efficiency = speedup / t;
+                const bool low = t > 1 && efficiency < o.min_efficiency;
+                flagged += low;
+                cout << left << setw(18) << stage.name << right << setw(12) << mesh.num_faces() << setw(9) << t
+                     << setw(12) << fixed << setprecision(4) << best << setw(10) << setprecision(2) << speedup
+                     << setw(12) << setprecision(2) << efficiency << (low ? "  below " + to_string(o.min_efficiency).substr(0, 4) : "") << endl;
+                if (csv.is_open())
+                    csv << stage.name << ',' << mesh.num_faces() << ',' << t << ',' << best << ',' << speedup << ','
+                        << efficiency << ',' << (low ? 1 : 0) << endl;
+            }
+        }
+    }
+    remove("scale_mesh.tmp.obj");
+    remove("scale_mesh.tmp.m");
+    if (flagged) cout << flagged << " point" << (flagged > 1 ? "s" : "") << " below efficiency " << o.min_efficiency << endl;
+    return flagged ? 2 : 0;
+}
@@ -7,6 +7,8 @@
 using namespace std;
 using namespace TMeshLib;
 
+typedef CBaseTMesh<> CTMesh;
+
 int main()
 {
 	char filename[] = "data/eight.t";
@@ -18,12 +20,12 @@ int main()
 	CTMesh * tmesh = new CTMesh();
 	tmesh->_load_t(filename);
 	
-	cout << "#tets = " << tmesh->numTets() << endl;
+	cout << "#tets = " << tmesh->num_tets() << endl;
 	
 	cout << "traverse all edges: " << endl;
-	for (TMeshEdgeIterator eit(tmesh); !eit.end(); ++eit)
+	for (TMeshEdgeIterator<CTMesh> eit(tmesh); !eit.end(); ++eit)
 	{
-		CEdge * e = *eit;
+		CTMesh::CEdge * e = *eit;
 		cout << "(" << e->vertex1()->id() << ", " << e->vertex2()->id() << ")" << endl;
 	}
 	cout << "done" << endl;
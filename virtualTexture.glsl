@@ -0,0 +1,53 @@
+// virtual texture sampling, prepended to fragment shaders drawn with a tiled texture
+// the page table holds, for every tile of every level, the slot of the physical texture
+// and the level of the finest resident tile covering it
+
+//! [0]
+uniform sampler2D pageTable;
+uniform sampler2D physicalTexture;
+// texels of level 0, and the levels in the tile file
+uniform vec2 virtualSize;
+uniform int virtualLevels;
+// first page table row of every level
+uniform int pageRows[32];
+// texels of a tile without, and with its border on both sides, and of the physical texture
+uniform float tileSize;
+uniform float slotSize;
+uniform float physicalSize;
+
+vec2 levelSize(int level)
+{
+    return max(vec2(1.0), floor(virtualSize / exp2(float(level))));
+}
+
+// the level a pixel samples, bias in levels
+int virtualLevel(vec2 uv, float bias)
+{
+    vec2 t = uv * virtualSize;
+    vec2 dx = dFdx(t), dy = dFdy(t);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + bias;
+    return int(clamp(floor(lod), 0.0, float(virtualLevels - 1)));
+}
+
+ivec2 virtualTile(vec2 uv, int level)
+{
+    vec2 size = levelSize(level);
+    vec2 grid = ceil(size / tileSize);
+    return ivec2(min(floor(clamp(uv, 0.0, 1.0) * size / tileSize), grid - 1.0));
+}
+
+vec4 virtualTexture(vec2 uv)
+{
+    int level = virtualLevel(uv, 0.0);
+    ivec2 tile = virtualTile(uv, level);
+    vec4 entry = floor(texelFetch(pageTable, ivec2(tile.x, pageRows[level] + tile.y), 0) * 255.0 + 0.5);
+    if (entry.a == 0.0) return vec4(0.5, 0.5, 0.5, 1.0);
+
+    // the position in the resident tile, which may be coarser than the one asked for
+    int held = int(entry.z);
+    vec2 texel = clamp(uv, 0.0, 1.0) * levelSize(held);
+    vec2 local = texel - vec2(virtualTile(uv, held)) * tileSize;
+    vec2 p = entry.xy * slotSize + (slotSize - tileSize) * 0.5 + local;
+    return textureLod(physicalTexture, p / physicalSize, 0.0);
+}
+//! [0]